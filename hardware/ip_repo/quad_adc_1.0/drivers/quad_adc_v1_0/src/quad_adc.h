@@ -11,6 +11,10 @@
 #define QUAD_ADC_S00_AXI_SLV_REG1_OFFSET 4
 #define QUAD_ADC_S00_AXI_SLV_REG2_OFFSET 8
 #define QUAD_ADC_S00_AXI_SLV_REG3_OFFSET 12
+#define QUAD_ADC_S00_AXI_SLV_REG4_OFFSET 16
+#define QUAD_ADC_S00_AXI_SLV_REG5_OFFSET 20
+#define QUAD_ADC_S00_AXI_SLV_REG6_OFFSET 24
+#define QUAD_ADC_S00_AXI_SLV_REG7_OFFSET 28
 
 
 /**************************** Type Definitions *****************************/
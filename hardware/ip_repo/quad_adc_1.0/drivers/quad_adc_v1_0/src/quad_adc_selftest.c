@@ -46,9 +46,9 @@ XStatus QUAD_ADC_Reg_SelfTest(void * baseaddr_p)
 	 */
 	xil_printf("User logic slave module test...\n\r");
 
-	for (write_loop_index = 0 ; write_loop_index < 4; write_loop_index++)
+	for (write_loop_index = 0 ; write_loop_index < 8; write_loop_index++)
 	  QUAD_ADC_mWriteReg (baseaddr, write_loop_index*4, (write_loop_index+1)*READ_WRITE_MUL_FACTOR);
-	for (read_loop_index = 0 ; read_loop_index < 4; read_loop_index++)
+	for (read_loop_index = 0 ; read_loop_index < 8; read_loop_index++)
 	  if ( QUAD_ADC_mReadReg (baseaddr, read_loop_index*4) != (read_loop_index+1)*READ_WRITE_MUL_FACTOR){
 	    xil_printf ("Error reading register value at address %x\n", (int)baseaddr + read_loop_index*4);
 	    return XST_FAILURE;
@@ -0,0 +1,162 @@
+
+`timescale 1 ns / 1 ps
+
+    module adc_decimator #
+    (
+        // Right shift of the DC estimate update. The DC blocker corner is
+        // near fs / (2 * pi * 2^DC_SHIFT), or about 780 Hz at 5 Msps.
+        parameter integer DC_SHIFT = 10
+    )
+    (
+        input wire CLK,
+        input wire RESET_N,
+
+        // Offset binary sample from the ADC, taken when SAMPLE_STROBE is high.
+        input wire [13 : 0] SAMPLE_IN,
+        input wire SAMPLE_STROBE,
+
+        // Asserted with SAMPLE_STROBE on the last input sample of each output.
+        input wire DECIMATE,
+
+        // Decimation rate as log2(R), from 0 (no decimation) to 5.
+        input wire [2 : 0] RATE_LOG2,
+        input wire DC_BLOCK,
+
+        // Offset binary output sample, updated when SAMPLE_OUT_VALID pulses.
+        output wire [13 : 0] SAMPLE_OUT,
+        output wire SAMPLE_OUT_VALID
+    );
+
+    // Each stage runs one cycle after the previous stage on a delayed copy of
+    // the input strobe. The combs and compensation filter only run on samples
+    // that complete an output.
+    reg [3:0] strobe_pipe = 4'b0;
+    reg [3:0] decimate_pipe = 4'b0;
+
+    always @(posedge CLK) begin
+        if (!RESET_N) begin
+            strobe_pipe <= 4'b0;
+            decimate_pipe <= 4'b0;
+        end
+        else begin
+            strobe_pipe <= {strobe_pipe[2:0], SAMPLE_STROBE};
+            decimate_pipe <= {decimate_pipe[2:0], SAMPLE_STROBE & DECIMATE};
+        end
+    end
+
+    // DC blocker
+    // The DC estimate is a leaky average of the input with 16 fractional
+    // bits, which is subtracted from every sample when enabled.
+    wire signed [31:0] sample_signed = $signed({18'b0, SAMPLE_IN}) - 32'sd8192;
+
+    reg signed [31:0] dc_estimate = 32'sd0;
+    reg signed [31:0] blocked = 32'sd0;
+
+    always @(posedge CLK) begin
+        if (!RESET_N) begin
+            dc_estimate <= 32'sd0;
+            blocked <= 32'sd0;
+        end
+        else if (SAMPLE_STROBE) begin
+            dc_estimate <= dc_estimate + (((sample_signed <<< 16) - dc_estimate) >>> DC_SHIFT);
+            blocked <= (DC_BLOCK)? sample_signed - (dc_estimate >>> 16) : sample_signed;
+        end
+    end
+
+    // Third order CIC decimator
+    // The integrators run at the input rate and the combs at the output rate.
+    // The gain of R^3 grows the 15-bit input by at most 15 bits, and the
+    // registers wrap harmlessly in two's complement.
+    reg signed [31:0] integrator_1 = 32'sd0;
+    reg signed [31:0] integrator_2 = 32'sd0;
+    reg signed [31:0] integrator_3 = 32'sd0;
+
+    always @(posedge CLK) begin
+        if (!RESET_N) begin
+            integrator_1 <= 32'sd0;
+            integrator_2 <= 32'sd0;
+            integrator_3 <= 32'sd0;
+        end
+        else if (strobe_pipe[0]) begin
+            integrator_1 <= integrator_1 + blocked;
+            integrator_2 <= integrator_2 + integrator_1;
+            integrator_3 <= integrator_3 + integrator_2;
+        end
+    end
+
+    reg signed [31:0] comb_delay_1 = 32'sd0;
+    reg signed [31:0] comb_delay_2 = 32'sd0;
+    reg signed [31:0] comb_delay_3 = 32'sd0;
+    reg signed [31:0] comb_1 = 32'sd0;
+    reg signed [31:0] comb_2 = 32'sd0;
+    reg signed [31:0] comb_3 = 32'sd0;
+
+    always @(posedge CLK) begin
+        if (!RESET_N) begin
+            comb_delay_1 <= 32'sd0;
+            comb_delay_2 <= 32'sd0;
+            comb_delay_3 <= 32'sd0;
+            comb_1 <= 32'sd0;
+            comb_2 <= 32'sd0;
+            comb_3 <= 32'sd0;
+        end
+        else if (decimate_pipe[1]) begin
+            comb_delay_1 <= integrator_3;
+            comb_1 <= integrator_3 - comb_delay_1;
+            comb_delay_2 <= comb_1;
+            comb_2 <= comb_1 - comb_delay_2;
+            comb_delay_3 <= comb_2;
+            comb_3 <= comb_2 - comb_delay_3;
+        end
+    end
+
+    // Compensation filter
+    // The CIC gain is removed with a shift, and its passband droop is
+    // corrected by the 3-tap FIR [-1, 10, -1] / 8. The FIR is bypassed when
+    // not decimating so the stream passes through unchanged.
+    wire signed [31:0] scaled = comb_3 >>> (3 * RATE_LOG2);
+
+    reg signed [31:0] tap_1 = 32'sd0;
+    reg signed [31:0] tap_2 = 32'sd0;
+    reg signed [31:0] tap_3 = 32'sd0;
+
+    always @(posedge CLK) begin
+        if (!RESET_N) begin
+            tap_1 <= 32'sd0;
+            tap_2 <= 32'sd0;
+            tap_3 <= 32'sd0;
+        end
+        else if (decimate_pipe[2]) begin
+            tap_1 <= scaled;
+            tap_2 <= tap_1;
+            tap_3 <= tap_2;
+        end
+    end
+
+    wire signed [31:0] compensated = (RATE_LOG2 == 3'd0)? tap_1 :
+        ((tap_2 <<< 3) + (tap_2 <<< 1) - tap_1 - tap_3) >>> 3;
+
+    wire signed [31:0] offset_sample = compensated + 32'sd8192;
+
+    reg [13:0] sample_out = 14'd8192;
+    reg sample_out_valid = 1'b0;
+
+    always @(posedge CLK) begin
+        if (!RESET_N) begin
+            sample_out <= 14'd8192;
+            sample_out_valid <= 1'b0;
+        end
+        else begin
+            sample_out_valid <= decimate_pipe[3];
+            if (decimate_pipe[3]) begin
+                sample_out <= (offset_sample < 0)? 14'd0 :
+                              (offset_sample > 32'sd16383)? 14'd16383 :
+                              offset_sample[13:0];
+            end
+        end
+    end
+
+    assign SAMPLE_OUT = sample_out;
+    assign SAMPLE_OUT_VALID = sample_out_valid;
+
+    endmodule
@@ -1,4 +1,3 @@
-
 `timescale 1 ns / 1 ps
 
 module adc_encode_clk_gen #
@@ -6,21 +5,34 @@ module adc_encode_clk_gen #
 
 )
 (
-    input wire AXI_CLK,
     input wire RESET_N,
+    input wire REF_CLK, // the reconfigurable MMCM output that is divided down
     input wire [31:0] CLOCK_DIV, // note: actual divider will by 2*CLOCK_DIV
     output wire ENCODE_CLK
 );
 
+    // The divider is written from the AXI clock domain while the stream is
+    // stopped, so it is only resynchronized rather than handshaken.
+    (* ASYNC_REG = "TRUE" *) reg [31:0] clock_div_meta, clock_div_sync;
+    (* ASYNC_REG = "TRUE" *) reg reset_meta, reset_sync;
+
     reg [31:0] counter;
     reg clk_track;
 
-    always @(posedge AXI_CLK) begin
-        if (!RESET_N) begin
+    always @(posedge REF_CLK) begin
+        clock_div_meta <= CLOCK_DIV;
+        clock_div_sync <= clock_div_meta;
+        reset_meta <= RESET_N;
+        reset_sync <= reset_meta;
+    end
+
+    // A counter past a newly lowered divider restarts rather than wrapping.
+    always @(posedge REF_CLK) begin
+        if (!reset_sync) begin
             counter <= 0;
             clk_track <= 1'b0;
         end
-        else if (counter == CLOCK_DIV - 1) begin
+        else if (counter >= clock_div_sync - 1) begin
             counter <= 0;
             clk_track <= ~clk_track;
         end
@@ -33,6 +33,22 @@
     reg adc_data_valid;
     reg data_read;
 
+    // The handshake flags are synchronized into the domain that samples them.
+    // The channel data is held stable from the frame until the read is
+    // acknowledged, so it crosses without synchronizers at any ratio of
+    // AXI_CLK to DATA_CLK.
+    (* ASYNC_REG = "TRUE" *) reg data_read_meta, data_read_sync;
+    (* ASYNC_REG = "TRUE" *) reg adc_data_valid_meta, adc_data_valid_sync;
+
+    always @(posedge DATA_CLK) begin
+        data_read_meta <= data_read;
+        data_read_sync <= data_read_meta;
+    end
+
+    always @(posedge AXI_CLK) begin
+        adc_data_valid_meta <= adc_data_valid;
+        adc_data_valid_sync <= adc_data_valid_meta;
+    end
 
 
     // data_valid generation
@@ -53,7 +69,10 @@
         else
             case (adc_state)
                 ADC_IDLE_STATE: begin
-                    if (FRAME_CLK == 0)
+                    // Wait for the previous read to be released before the
+                    // next frame, so that a sample is never acknowledged by
+                    // the read of the one before it.
+                    if (FRAME_CLK == 0 && data_read_sync == 0)
                         adc_state <= ADC_WAIT_FOR_FRAME_STATE;
                 end
 
@@ -69,7 +88,7 @@
                 end
 
                 ADC_WAIT_FOR_DATA_READ_STATE: begin
-                    if (data_read == 1) begin
+                    if (data_read_sync == 1) begin
                         adc_data_valid <= 0;
                         adc_state <= ADC_IDLE_STATE;
                     end
@@ -95,7 +114,7 @@
         else
             case(axi_state)
                 AXI_IDLE_STATE: begin
-                    if (adc_data_valid == 1) begin
+                    if (adc_data_valid_sync == 1) begin
                         AXI_CH_1_DATA_REG <= ADC_CH_1_DATA_REG;
                         AXI_CH_2_DATA_REG <= ADC_CH_2_DATA_REG;
                         AXI_CH_3_DATA_REG <= ADC_CH_3_DATA_REG;
@@ -108,7 +127,7 @@
 
                 AXI_HANDSHAKE_STATE: begin
                     axi_data_valid <= 0;
-                    if (adc_data_valid == 0) begin
+                    if (adc_data_valid_sync == 0) begin
                         data_read <= 0;
                         axi_state <= AXI_IDLE_STATE;
                     end
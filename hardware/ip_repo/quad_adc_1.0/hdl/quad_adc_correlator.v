@@ -0,0 +1,296 @@
+
+`timescale 1 ns / 1 ps
+
+    module quad_adc_correlator #
+    (
+        // Number of address bits of the window buffer, which limits the
+        // number of samples correlated.
+        parameter integer WINDOW_ADDR_BITS = 12,
+
+        // Number of address bits of the lag index. At most 2^LAG_ADDR_BITS
+        // lags are correlated.
+        parameter integer LAG_ADDR_BITS = 8
+    )
+    (
+        input wire CLK,
+        input wire RESET_N,
+
+        // Samples of the triggered window as they are streamed, packed as
+        // {CH_D, CH_C, CH_B, CH_A} with 16 bits per channel. WINDOW_LAST is
+        // asserted with the final sample.
+        input wire [63 : 0] WINDOW_SAMPLE,
+        input wire WINDOW_VALID,
+        input wire WINDOW_LAST,
+
+        // Correlator control: [7:0] largest shift, [21:8] offset removed
+        // from every sample, [31] enable. The correlator is one-shot and is
+        // re-armed by clearing and setting enable.
+        input wire [31 : 0] CORRELATOR_CONTROL,
+
+        // Results are read in the RESULT_CLK domain. RESULT_INDEX selects the
+        // word {lag, channel}, and RESULT_DATA follows it one cycle later.
+        input wire RESULT_CLK,
+        input wire [LAG_ADDR_BITS+1 : 0] RESULT_INDEX,
+        output wire [31 : 0] RESULT_DATA,
+
+        // Status in the RESULT_CLK domain: [29] busy, [30] done.
+        output wire [31 : 0] CORRELATOR_STATUS
+    );
+
+    localparam integer WINDOW_DEPTH = 1 << WINDOW_ADDR_BITS;
+    localparam integer MAX_SHIFT = 1 << (LAG_ADDR_BITS - 1);
+
+    parameter [2:0] IDLE_STATE       = 3'b000, // Disabled
+                    CAPTURE_STATE    = 3'b001, // Buffering the window
+                    LAG_START_STATE  = 3'b010, // Setting up the next lag
+                    ACCUMULATE_STATE = 3'b011, // Multiplying the overlap
+                    FLUSH_STATE      = 3'b100, // Draining the multipliers
+                    STORE_STATE      = 3'b101, // Writing the lag results
+                    DONE_STATE       = 3'b110; // Results ready, waiting for re-arm
+
+    // The control register is written from the AXI-lite clock domain and is
+    // only changed while the correlator is idle or done.
+    reg [31:0] control_meta = 32'b0;
+    reg [31:0] control = 32'b0;
+    always @(posedge CLK) begin
+        control_meta <= CORRELATOR_CONTROL;
+        control <= control_meta;
+    end
+
+    wire enable = control[31];
+    wire [15:0] requested_shift = (control[7:0] > MAX_SHIFT)? MAX_SHIFT : control[7:0];
+    wire signed [15:0] offset = {2'b0, control[21:8]};
+
+    reg [2:0] state = IDLE_STATE;
+    reg [15:0] window_len = 16'b0;
+    reg [15:0] num_lags = 16'b0;
+    reg [15:0] lag = 16'b0;
+    reg signed [15:0] lshift = 16'sd0;
+    reg [15:0] index = 16'b0;
+    reg [15:0] index_end = 16'b0;
+    reg [1:0] store_channel = 2'b0;
+
+    // Window buffer (inferred as block RAM)
+    // One port reads the reference channel and the other reads the shifted
+    // channels, so one product per channel is formed every cycle.
+    reg [55:0] window [0 : WINDOW_DEPTH-1];
+    reg [55:0] reference_out;
+    reg [55:0] shifted_out;
+
+    wire window_write = (state == CAPTURE_STATE) && WINDOW_VALID && (window_len < WINDOW_DEPTH);
+    wire issue = (state == ACCUMULATE_STATE) && (index < index_end);
+    wire [15:0] shifted_index = index + lshift;
+
+    always @(posedge CLK) begin
+        if (window_write) begin
+            window[window_len[WINDOW_ADDR_BITS-1:0]] <= {WINDOW_SAMPLE[61:48], WINDOW_SAMPLE[45:32],
+                                                         WINDOW_SAMPLE[29:16], WINDOW_SAMPLE[13:0]};
+        end
+        reference_out <= window[index[WINDOW_ADDR_BITS-1:0]];
+    end
+
+    always @(posedge CLK) begin
+        shifted_out <= window[shifted_index[WINDOW_ADDR_BITS-1:0]];
+    end
+
+    // Multiply-accumulate pipeline
+    // The offset is removed so the correlation is not dominated by the DC
+    // level of the channels. The products of a window of 2^12 samples need
+    // at most 41 bits.
+    function signed [15:0] centered;
+        input [13:0] sample;
+        input signed [15:0] offset;
+        centered = $signed({2'b0, sample}) - offset;
+    endfunction
+
+    reg issue_d1 = 1'b0;
+    reg product_valid = 1'b0;
+    reg signed [31:0] product_b = 32'sd0;
+    reg signed [31:0] product_c = 32'sd0;
+    reg signed [31:0] product_d = 32'sd0;
+    reg signed [47:0] accumulator_b = 48'sd0;
+    reg signed [47:0] accumulator_c = 48'sd0;
+    reg signed [47:0] accumulator_d = 48'sd0;
+
+    always @(posedge CLK) begin
+        if (!RESET_N) begin
+            issue_d1 <= 1'b0;
+            product_valid <= 1'b0;
+        end
+        else begin
+            issue_d1 <= issue;
+            product_valid <= issue_d1;
+        end
+
+        product_b <= centered(reference_out[13:0], offset) * centered(shifted_out[27:14], offset);
+        product_c <= centered(reference_out[13:0], offset) * centered(shifted_out[41:28], offset);
+        product_d <= centered(reference_out[13:0], offset) * centered(shifted_out[55:42], offset);
+
+        if (state == LAG_START_STATE) begin
+            accumulator_b <= 48'sd0;
+            accumulator_c <= 48'sd0;
+            accumulator_d <= 48'sd0;
+        end
+        else if (product_valid) begin
+            accumulator_b <= accumulator_b + product_b;
+            accumulator_c <= accumulator_c + product_c;
+            accumulator_d <= accumulator_d + product_d;
+        end
+    end
+
+    // Result buffer (inferred as dual-clock block RAM)
+    // Results are scaled down by 2^14 to match the software correlation,
+    // rounding towards negative infinity.
+    reg [31:0] results [0 : (1 << (LAG_ADDR_BITS + 2)) - 1];
+    reg [31:0] result_out;
+
+    wire signed [47:0] store_accumulator = (store_channel == 2'd0)? accumulator_b :
+                                           (store_channel == 2'd1)? accumulator_c :
+                                           accumulator_d;
+
+    always @(posedge CLK) begin
+        if (state == STORE_STATE) begin
+            results[{lag[LAG_ADDR_BITS-1:0], store_channel}] <= store_accumulator[45:14];
+        end
+    end
+
+    always @(posedge RESULT_CLK) begin
+        result_out <= results[RESULT_INDEX];
+    end
+
+    assign RESULT_DATA = result_out;
+
+    // Lags are correlated in the order of the software correlation: from the
+    // largest left shift down to one past the negated largest shift.
+    always @(posedge CLK) begin
+        if (!RESET_N) begin
+            state <= IDLE_STATE;
+            window_len <= 16'b0;
+            num_lags <= 16'b0;
+            lag <= 16'b0;
+            lshift <= 16'sd0;
+            index <= 16'b0;
+            index_end <= 16'b0;
+            store_channel <= 2'b0;
+        end
+        else begin
+            case (state)
+                IDLE_STATE:
+                begin
+                    if (enable) begin
+                        window_len <= 16'b0;
+                        state <= CAPTURE_STATE;
+                    end
+                end
+
+                CAPTURE_STATE:
+                begin
+                    if (!enable) begin
+                        state <= IDLE_STATE;
+                    end
+                    else if (WINDOW_VALID) begin
+                        if (window_write) begin
+                            window_len <= window_len + 1'b1;
+                        end
+
+                        if (WINDOW_LAST) begin
+                            // The shift is limited by the window length.
+                            if (requested_shift >= window_len + window_write) begin
+                                lshift <= window_len + window_write - 1'b1;
+                                num_lags <= (window_len + window_write - 1'b1) << 1;
+                            end
+                            else begin
+                                lshift <= requested_shift;
+                                num_lags <= requested_shift << 1;
+                            end
+                            lag <= 16'b0;
+                            state <= LAG_START_STATE;
+                        end
+                    end
+                end
+
+                LAG_START_STATE:
+                begin
+                    if (lag >= num_lags) begin
+                        state <= DONE_STATE;
+                    end
+                    else begin
+                        if (lshift >= 0) begin
+                            index <= 16'b0;
+                            index_end <= window_len - lshift;
+                        end
+                        else begin
+                            index <= -lshift;
+                            index_end <= window_len;
+                        end
+                        state <= ACCUMULATE_STATE;
+                    end
+                end
+
+                ACCUMULATE_STATE:
+                begin
+                    if (issue) begin
+                        index <= index + 1'b1;
+                    end
+                    else begin
+                        state <= FLUSH_STATE;
+                    end
+                end
+
+                FLUSH_STATE:
+                begin
+                    if (!issue_d1 && !product_valid) begin
+                        store_channel <= 2'b0;
+                        state <= STORE_STATE;
+                    end
+                end
+
+                STORE_STATE:
+                begin
+                    if (store_channel == 2'd2) begin
+                        lag <= lag + 1'b1;
+                        lshift <= lshift - 1'b1;
+                        state <= LAG_START_STATE;
+                    end
+                    else begin
+                        store_channel <= store_channel + 1'b1;
+                    end
+                end
+
+                DONE_STATE:
+                begin
+                    if (!enable) begin
+                        state <= IDLE_STATE;
+                    end
+                end
+
+                default:
+                begin
+                    state <= IDLE_STATE;
+                end
+            endcase
+        end
+    end
+
+    // The status only changes once per window, so it is passed to the
+    // AXI-lite clock domain through a pair of registers.
+    wire busy = (state == LAG_START_STATE) || (state == ACCUMULATE_STATE) ||
+                (state == FLUSH_STATE) || (state == STORE_STATE);
+    wire done = (state == DONE_STATE);
+
+    reg [31:0] status = 32'b0;
+    reg [31:0] status_meta = 32'b0;
+    reg [31:0] status_sync = 32'b0;
+
+    always @(posedge CLK) begin
+        status <= {1'b0, done, busy, 29'b0};
+    end
+
+    always @(posedge RESULT_CLK) begin
+        status_meta <= status;
+        status_sync <= status_meta;
+    end
+
+    assign CORRELATOR_STATUS = status_sync;
+
+    endmodule
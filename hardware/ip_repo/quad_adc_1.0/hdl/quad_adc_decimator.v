@@ -0,0 +1,134 @@
+
+`timescale 1 ns / 1 ps
+
+    module quad_adc_decimator #
+    (
+        // The number of clock cycles that the regenerated frame is held high
+        // after each output sample.
+        parameter integer FRAME_HIGH_CYCLES = 4
+    )
+    (
+        input wire CLK,
+        input wire RESET_N,
+
+        // Raw ADC samples, which are updated on the rising edge of FRAME_CLK.
+        input wire FRAME_CLK,
+        input wire [13 : 0] CH_1_IN,
+        input wire [13 : 0] CH_2_IN,
+        input wire [13 : 0] CH_3_IN,
+        input wire [13 : 0] CH_4_IN,
+
+        // Decimation control: [2:0] log2 of the decimation rate (0 to 5),
+        // [8] enable DC removal.
+        input wire [31 : 0] DECIMATION_CONTROL,
+
+        // Filtered samples and a frame signal in the CLK domain that rises
+        // once per output sample.
+        output wire [13 : 0] CH_1_OUT,
+        output wire [13 : 0] CH_2_OUT,
+        output wire [13 : 0] CH_3_OUT,
+        output wire [13 : 0] CH_4_OUT,
+        output wire SAMPLE_FRAME
+    );
+
+    // The ADC frame clock is asynchronous to CLK. Samples are taken a few
+    // cycles after its rising edge, while the interface outputs are stable.
+    reg [2:0] frame_sync = 3'b0;
+    always @(posedge CLK) begin
+        frame_sync <= {frame_sync[1:0], FRAME_CLK};
+    end
+
+    wire frame_rise = frame_sync[1] & ~frame_sync[2];
+
+    // The control register is written from the AXI-lite clock domain and is
+    // only changed while the stream is not being captured.
+    reg [31:0] control_meta = 32'b0;
+    reg [31:0] control = 32'b0;
+    always @(posedge CLK) begin
+        control_meta <= DECIMATION_CONTROL;
+        control <= control_meta;
+    end
+
+    wire [2:0] rate_log2 = (control[2:0] > 3'd5)? 3'd5 : control[2:0];
+    wire dc_block = control[8];
+
+    // Count input samples so every R-th sample completes an output.
+    wire [5:0] last_phase = (6'd1 << rate_log2) - 1'b1;
+    reg [5:0] phase = 6'b0;
+
+    always @(posedge CLK) begin
+        if (!RESET_N) begin
+            phase <= 6'b0;
+        end
+        else if (frame_rise) begin
+            phase <= (phase >= last_phase)? 6'b0 : phase + 1'b1;
+        end
+    end
+
+    wire decimate = (phase >= last_phase);
+
+    wire [3:0] output_valid;
+
+    adc_decimator decimator_ch_1 (
+        .CLK(CLK),
+        .RESET_N(RESET_N),
+        .SAMPLE_IN(CH_1_IN),
+        .SAMPLE_STROBE(frame_rise),
+        .DECIMATE(decimate),
+        .RATE_LOG2(rate_log2),
+        .DC_BLOCK(dc_block),
+        .SAMPLE_OUT(CH_1_OUT),
+        .SAMPLE_OUT_VALID(output_valid[0])
+    );
+    adc_decimator decimator_ch_2 (
+        .CLK(CLK),
+        .RESET_N(RESET_N),
+        .SAMPLE_IN(CH_2_IN),
+        .SAMPLE_STROBE(frame_rise),
+        .DECIMATE(decimate),
+        .RATE_LOG2(rate_log2),
+        .DC_BLOCK(dc_block),
+        .SAMPLE_OUT(CH_2_OUT),
+        .SAMPLE_OUT_VALID(output_valid[1])
+    );
+    adc_decimator decimator_ch_3 (
+        .CLK(CLK),
+        .RESET_N(RESET_N),
+        .SAMPLE_IN(CH_3_IN),
+        .SAMPLE_STROBE(frame_rise),
+        .DECIMATE(decimate),
+        .RATE_LOG2(rate_log2),
+        .DC_BLOCK(dc_block),
+        .SAMPLE_OUT(CH_3_OUT),
+        .SAMPLE_OUT_VALID(output_valid[2])
+    );
+    adc_decimator decimator_ch_4 (
+        .CLK(CLK),
+        .RESET_N(RESET_N),
+        .SAMPLE_IN(CH_4_IN),
+        .SAMPLE_STROBE(frame_rise),
+        .DECIMATE(decimate),
+        .RATE_LOG2(rate_log2),
+        .DC_BLOCK(dc_block),
+        .SAMPLE_OUT(CH_4_OUT),
+        .SAMPLE_OUT_VALID(output_valid[3])
+    );
+
+    // Regenerate a frame signal so the stream state machine emits one sample
+    // per output. Every channel shares the same latency.
+    reg [3:0] frame_count = 4'b0;
+    always @(posedge CLK) begin
+        if (!RESET_N) begin
+            frame_count <= 4'b0;
+        end
+        else if (output_valid[0]) begin
+            frame_count <= FRAME_HIGH_CYCLES;
+        end
+        else if (frame_count != 0) begin
+            frame_count <= frame_count - 1'b1;
+        end
+    end
+
+    assign SAMPLE_FRAME = (frame_count != 0);
+
+    endmodule
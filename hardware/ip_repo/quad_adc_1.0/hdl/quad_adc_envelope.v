@@ -0,0 +1,271 @@
+
+`timescale 1 ns / 1 ps
+
+    module quad_adc_envelope #
+    (
+        // Number of address bits of the envelope FIFO. The FIFO holds
+        // 2^FIFO_ADDR_BITS envelope samples of all four channels.
+        parameter integer FIFO_ADDR_BITS = 10
+    )
+    (
+        input wire CLK,
+        input wire RESET_N,
+
+        // Filtered samples and the frame signal that rises once per sample,
+        // as they are streamed, and the count of samples streamed.
+        input wire SAMPLE_FRAME,
+        input wire [13 : 0] CH_1_IN,
+        input wire [13 : 0] CH_2_IN,
+        input wire [13 : 0] CH_3_IN,
+        input wire [13 : 0] CH_4_IN,
+        input wire [63 : 0] SAMPLE_COUNT,
+
+        // Envelope control: [13:0] offset removed from every sample, [19:16]
+        // base two logarithm of the smoothing time constant in samples,
+        // [27:24] right shift of the smoothed power to 16 bits, [31] enable.
+        // Clearing enable empties the FIFO and clears the overflow.
+        input wire [31 : 0] ENVELOPE_CONTROL,
+
+        // The number of samples per envelope sample, at least one.
+        input wire [15 : 0] ENVELOPE_DECIMATION,
+
+        // The FIFO is read in the READ_CLK domain. READ_DATA holds the oldest
+        // envelope sample, packed as {CH_4, CH_3, CH_2, CH_1} with 16 bits
+        // per channel, whenever READ_LEVEL is nonzero. A pulse of READ_POP
+        // discards it, and READ_DATA follows one cycle later.
+        input wire READ_CLK,
+        input wire READ_POP,
+        output wire [63 : 0] READ_DATA,
+        output wire [FIFO_ADDR_BITS : 0] READ_LEVEL,
+
+        // Status in the READ_CLK domain: [29] the envelope is disabled and
+        // the FIFO is empty on both sides, [30] envelope samples were dropped
+        // because the FIFO was full.
+        output wire [31 : 0] ENVELOPE_STATUS,
+
+        // The sample count at the first envelope sample after enable, in the
+        // READ_CLK domain. It holds still until the envelope is re-enabled.
+        output wire [63 : 0] ENVELOPE_START
+    );
+
+    localparam integer FIFO_DEPTH = 1 << FIFO_ADDR_BITS;
+
+    // The control registers are written from the AXI-lite clock domain and
+    // are only changed while the envelope is disabled.
+    reg [31:0] control_meta = 32'b0;
+    reg [31:0] control = 32'b0;
+    reg [15:0] decimation_meta = 16'b0;
+    reg [15:0] decimation = 16'b0;
+    always @(posedge CLK) begin
+        control_meta <= ENVELOPE_CONTROL;
+        control <= control_meta;
+        decimation_meta <= ENVELOPE_DECIMATION;
+        decimation <= decimation_meta;
+    end
+
+    wire enable = control[31] & RESET_N;
+    wire signed [15:0] offset = {2'b0, control[13:0]};
+    wire [3:0] smoothing_shift = control[19:16];
+    wire [3:0] output_shift = control[27:24];
+    wire [15:0] last_phase = (decimation == 0)? 16'b0 : decimation - 1'b1;
+    wire [4:0] envelope_shift = {1'b0, smoothing_shift} + {1'b0, output_shift};
+
+    // A sample is taken on each rising edge of the frame, while the channels
+    // are held still.
+    reg frame_d1 = 1'b0;
+    always @(posedge CLK) begin
+        frame_d1 <= SAMPLE_FRAME;
+    end
+
+    wire sample_strobe = SAMPLE_FRAME & ~frame_d1;
+
+    // Power pipeline
+    // Each channel is centered, squared, and smoothed by a single pole low
+    // pass, y += (x^2 - y) / 2^k, which is kept with k fractional bits. The
+    // square of a centered 14-bit sample needs at most 28 bits.
+    function signed [15:0] centered;
+        input [13:0] sample;
+        input signed [15:0] offset;
+        centered = $signed({2'b0, sample}) - offset;
+    endfunction
+
+    function [15:0] saturate;
+        input [43:0] value;
+        saturate = (value[43:16] != 0)? 16'hFFFF : value[15:0];
+    endfunction
+
+    reg [2:0] strobe_pipe = 3'b0;
+    reg signed [15:0] centered_1 = 16'sd0, centered_2 = 16'sd0, centered_3 = 16'sd0, centered_4 = 16'sd0;
+    reg [31:0] power_1 = 32'b0, power_2 = 32'b0, power_3 = 32'b0, power_4 = 32'b0;
+    reg [43:0] smoothed_1 = 44'b0, smoothed_2 = 44'b0, smoothed_3 = 44'b0, smoothed_4 = 44'b0;
+
+    always @(posedge CLK) begin
+        strobe_pipe <= {strobe_pipe[1:0], sample_strobe & enable};
+
+        if (sample_strobe) begin
+            centered_1 <= centered(CH_1_IN, offset);
+            centered_2 <= centered(CH_2_IN, offset);
+            centered_3 <= centered(CH_3_IN, offset);
+            centered_4 <= centered(CH_4_IN, offset);
+        end
+
+        if (strobe_pipe[0]) begin
+            power_1 <= centered_1 * centered_1;
+            power_2 <= centered_2 * centered_2;
+            power_3 <= centered_3 * centered_3;
+            power_4 <= centered_4 * centered_4;
+        end
+
+        if (!enable) begin
+            smoothed_1 <= 44'b0;
+            smoothed_2 <= 44'b0;
+            smoothed_3 <= 44'b0;
+            smoothed_4 <= 44'b0;
+        end
+        else if (strobe_pipe[1]) begin
+            smoothed_1 <= smoothed_1 + power_1 - (smoothed_1 >> smoothing_shift);
+            smoothed_2 <= smoothed_2 + power_2 - (smoothed_2 >> smoothing_shift);
+            smoothed_3 <= smoothed_3 + power_3 - (smoothed_3 >> smoothing_shift);
+            smoothed_4 <= smoothed_4 + power_4 - (smoothed_4 >> smoothing_shift);
+        end
+    end
+
+    // Decimation
+    // Every decimation-th smoothed sample is scaled to 16 bits, saturating,
+    // and written to the FIFO.
+    reg [15:0] phase = 16'b0;
+    reg envelope_valid = 1'b0;
+    reg [63:0] envelope = 64'b0;
+    reg started = 1'b0;
+    reg [63:0] start_count = 64'b0;
+
+    always @(posedge CLK) begin
+        envelope_valid <= 1'b0;
+        if (!enable) begin
+            phase <= 16'b0;
+            started <= 1'b0;
+        end
+        else if (strobe_pipe[2]) begin
+            if (phase >= last_phase) begin
+                phase <= 16'b0;
+                envelope_valid <= 1'b1;
+                envelope <= {saturate(smoothed_4 >> envelope_shift),
+                             saturate(smoothed_3 >> envelope_shift),
+                             saturate(smoothed_2 >> envelope_shift),
+                             saturate(smoothed_1 >> envelope_shift)};
+                if (!started) begin
+                    started <= 1'b1;
+                    start_count <= SAMPLE_COUNT;
+                end
+            end
+            else begin
+                phase <= phase + 1'b1;
+            end
+        end
+    end
+
+    // Envelope FIFO (inferred as dual-clock block RAM)
+    // The pointers carry one bit more than the address so a full FIFO is
+    // distinguished from an empty one, and cross the clock domains in Gray
+    // code. Both sides are held empty while the envelope is disabled.
+    function [FIFO_ADDR_BITS:0] to_gray;
+        input [FIFO_ADDR_BITS:0] value;
+        to_gray = value ^ (value >> 1);
+    endfunction
+
+    function [FIFO_ADDR_BITS:0] from_gray;
+        input [FIFO_ADDR_BITS:0] value;
+        integer i;
+        begin
+            from_gray[FIFO_ADDR_BITS] = value[FIFO_ADDR_BITS];
+            for (i = FIFO_ADDR_BITS - 1; i >= 0; i = i - 1) begin
+                from_gray[i] = from_gray[i + 1] ^ value[i];
+            end
+        end
+    endfunction
+
+    reg [63:0] fifo [0 : FIFO_DEPTH-1];
+    reg [FIFO_ADDR_BITS:0] write_ptr = 0;
+    reg [FIFO_ADDR_BITS:0] write_gray = 0;
+    reg [FIFO_ADDR_BITS:0] read_ptr = 0;
+    reg [FIFO_ADDR_BITS:0] read_gray = 0;
+    (* ASYNC_REG = "TRUE" *) reg [FIFO_ADDR_BITS:0] read_gray_meta = 0, read_gray_sync = 0;
+    (* ASYNC_REG = "TRUE" *) reg [FIFO_ADDR_BITS:0] write_gray_meta = 0, write_gray_sync = 0;
+    reg overflow = 1'b0;
+    reg idle = 1'b1;
+
+    always @(posedge CLK) begin
+        read_gray_meta <= read_gray;
+        read_gray_sync <= read_gray_meta;
+    end
+
+    wire [FIFO_ADDR_BITS:0] write_level = write_ptr - from_gray(read_gray_sync);
+    wire fifo_full = (write_level >= FIFO_DEPTH);
+
+    always @(posedge CLK) begin
+        idle <= !enable;
+        if (!enable) begin
+            write_ptr <= 0;
+            write_gray <= 0;
+            overflow <= 1'b0;
+        end
+        else if (envelope_valid) begin
+            if (fifo_full) begin
+                overflow <= 1'b1;
+            end
+            else begin
+                fifo[write_ptr[FIFO_ADDR_BITS-1:0]] <= envelope;
+                write_ptr <= write_ptr + 1'b1;
+                write_gray <= to_gray(write_ptr + 1'b1);
+            end
+        end
+    end
+
+    // The read side is held in reset by the enable bit, which is written in
+    // the READ_CLK domain. The write side follows two cycles of CLK later,
+    // so the envelope is only re-enabled once the idle status shows that
+    // both pointers are zero.
+    reg read_enable = 1'b0;
+    reg [63:0] read_out = 64'b0;
+
+    always @(posedge READ_CLK) begin
+        write_gray_meta <= write_gray;
+        write_gray_sync <= write_gray_meta;
+        read_enable <= ENVELOPE_CONTROL[31];
+    end
+
+    wire [FIFO_ADDR_BITS:0] read_level = from_gray(write_gray_sync) - read_ptr;
+
+    always @(posedge READ_CLK) begin
+        if (!read_enable) begin
+            read_ptr <= 0;
+            read_gray <= 0;
+        end
+        else if (READ_POP && read_level != 0) begin
+            read_ptr <= read_ptr + 1'b1;
+            read_gray <= to_gray(read_ptr + 1'b1);
+        end
+        read_out <= fifo[read_ptr[FIFO_ADDR_BITS-1:0]];
+    end
+
+    assign READ_DATA = read_out;
+    assign READ_LEVEL = (read_enable)? read_level : 0;
+
+    // The flags and the start count only change once per enable, so they are
+    // passed to the READ_CLK domain through a pair of registers.
+    reg [31:0] status_meta = 32'b0;
+    reg [31:0] status_sync = 32'b0;
+    reg [63:0] start_meta = 64'b0;
+    reg [63:0] start_sync = 64'b0;
+
+    always @(posedge READ_CLK) begin
+        status_meta <= {1'b0, overflow, idle, 29'b0};
+        status_sync <= status_meta;
+        start_meta <= start_count;
+        start_sync <= start_meta;
+    end
+
+    assign ENVELOPE_STATUS = status_sync;
+    assign ENVELOPE_START = start_sync;
+
+    endmodule
@@ -0,0 +1,94 @@
+`timescale 1 ns / 1 ps
+
+// Latches the stream sample count on the edge of a sync pulse shared by the
+// boards of an array. The board that drives the pulse latches its own edge
+// as it leaves, so every board holds the number of the sample it was taking
+// when the pulse arrived, and the software of each board compares its own
+// latch against the others to align the timestamps of their streams.
+module quad_adc_sync #
+(
+    // The length of the pulse driven on SYNC_OUT, in clocks. It must outlast
+    // the synchronizers of the slowest board on the sync line.
+    parameter integer PULSE_CYCLES = 64
+)
+(
+    input wire CLK,
+    input wire RESET_N,
+
+    // The sync line. SYNC_OUT is only driven while OUTPUT_ENABLE is set, and
+    // the pulse on it is latched in place of SYNC_IN.
+    input wire SYNC_IN,
+    output wire SYNC_OUT,
+
+    // Written from the AXI clock domain. A toggle of FIRE_REQUEST sends a
+    // pulse when the output is enabled.
+    input wire OUTPUT_ENABLE,
+    input wire FIRE_REQUEST,
+
+    // The live sample count of the stream.
+    input wire [63 : 0] SAMPLE_COUNT,
+
+    // The sample count at the latest sync edge, which holds still until the
+    // next edge, and a toggle for each edge. Edges must be further apart
+    // than the synchronizer of the reading clock domain.
+    output reg [63 : 0] SYNC_SAMPLE = 64'b0,
+    output reg SYNC_TOGGLE = 1'b0
+);
+
+    (* ASYNC_REG = "TRUE" *) reg [1:0] output_enable_sync = 2'b0;
+    (* ASYNC_REG = "TRUE" *) reg [2:0] fire_request_sync = 3'b0;
+    (* ASYNC_REG = "TRUE" *) reg [2:0] sync_in_sync = 3'b0;
+
+    wire output_enable = output_enable_sync[1];
+    wire fire = fire_request_sync[2] ^ fire_request_sync[1];
+
+    reg [15:0] pulse_remaining = 16'b0;
+    reg pulse = 1'b0;
+
+    always @(posedge CLK) begin
+        output_enable_sync <= {output_enable_sync[0], OUTPUT_ENABLE};
+        fire_request_sync <= {fire_request_sync[1:0], FIRE_REQUEST};
+    end
+
+    always @(posedge CLK) begin
+        if (!RESET_N) begin
+            pulse_remaining <= 16'b0;
+            pulse <= 1'b0;
+        end
+        else if (fire && output_enable && !pulse) begin
+            pulse_remaining <= PULSE_CYCLES - 1;
+            pulse <= 1'b1;
+        end
+        else if (pulse_remaining != 0) begin
+            pulse_remaining <= pulse_remaining - 1'b1;
+        end
+        else begin
+            pulse <= 1'b0;
+        end
+    end
+
+    assign SYNC_OUT = output_enable & pulse;
+
+    // The outgoing pulse passes through the same synchronizer as an incoming
+    // one, so the driving board latches with the same delay as the boards it
+    // drives, less the propagation along the line.
+    wire sync_source = (output_enable)? pulse : SYNC_IN;
+
+    always @(posedge CLK) begin
+        sync_in_sync <= {sync_in_sync[1:0], sync_source};
+    end
+
+    wire sync_rise = sync_in_sync[1] & ~sync_in_sync[2];
+
+    always @(posedge CLK) begin
+        if (!RESET_N) begin
+            SYNC_SAMPLE <= 64'b0;
+            SYNC_TOGGLE <= 1'b0;
+        end
+        else if (sync_rise) begin
+            SYNC_SAMPLE <= SAMPLE_COUNT;
+            SYNC_TOGGLE <= ~SYNC_TOGGLE;
+        end
+    end
+
+endmodule
@@ -0,0 +1,56 @@
+`timescale 1 ns / 1 ps
+
+// Drives the external trigger output over a window of stream samples, so that
+// other sensors are told exactly when a capture is listening. The window is
+// planned ahead by software in the timestamps of the stream.
+module quad_adc_trigger_out
+(
+    input wire CLK,
+    input wire RESET_N,
+
+    // The live sample count of the stream.
+    input wire [63 : 0] SAMPLE_COUNT,
+
+    // Written from the AXI clock domain. A toggle of WINDOW_REQUEST loads the
+    // window, which must hold still from before the toggle until the next,
+    // and FORCE holds the output high regardless of the window.
+    input wire [63 : 0] WINDOW_START,
+    input wire [63 : 0] WINDOW_END,
+    input wire WINDOW_REQUEST,
+    input wire FORCE,
+
+    // High from the first sample of the window until before its end.
+    output reg TRIGGER_OUT = 1'b0
+);
+
+    (* ASYNC_REG = "TRUE" *) reg [2:0] window_request_sync = 3'b0;
+    (* ASYNC_REG = "TRUE" *) reg [1:0] force_sync = 2'b0;
+
+    always @(posedge CLK) begin
+        window_request_sync <= {window_request_sync[1:0], WINDOW_REQUEST};
+        force_sync <= {force_sync[0], FORCE};
+    end
+
+    wire load = window_request_sync[2] ^ window_request_sync[1];
+
+    reg [63:0] window_start = 64'b0;
+    reg [63:0] window_end = 64'b0;
+
+    always @(posedge CLK) begin
+        if (!RESET_N) begin
+            window_start <= 64'b0;
+            window_end <= 64'b0;
+            TRIGGER_OUT <= 1'b0;
+        end
+        else begin
+            if (load) begin
+                window_start <= WINDOW_START;
+                window_end <= WINDOW_END;
+            end
+
+            TRIGGER_OUT <= force_sync[1] ||
+                    (SAMPLE_COUNT >= window_start && SAMPLE_COUNT < window_end);
+        end
+    end
+
+endmodule
@@ -11,7 +11,7 @@
 
         // Parameters of Axi Slave Bus Interface S00_AXI
         parameter integer C_S00_AXI_DATA_WIDTH  = 32,
-        parameter integer C_S00_AXI_ADDR_WIDTH  = 4,
+        parameter integer C_S00_AXI_ADDR_WIDTH  = 7,
 
         // Parameters of Axi Master Bus Interface M00_AXIS
         parameter integer C_M00_AXIS_TDATA_WIDTH    = 32,
@@ -31,6 +31,7 @@
 
         //ADC
         output wire ENCODE_CLK,
+        input wire ENCODE_REF_CLK,
         input wire DATA_CLK,
         input wire FRAME_CLK,
         input wire CH_1_A, CH_1_B,
@@ -38,6 +39,14 @@
         input wire CH_3_A, CH_3_B,
         input wire CH_4_A, CH_4_B,
 
+        // Sync line shared by the boards of an array
+        input wire SYNC_IN,
+        output wire SYNC_OUT,
+
+        // External trigger input and the output raised during captures
+        input wire TRIGGER_IN,
+        output wire TRIGGER_OUT,
+
         // User ports ends
         // Do not modify the ports beyond this line
 
@@ -101,8 +110,37 @@
 
     // interconnects
     wire [13:0] ADC_CH_1_DATA, ADC_CH_2_DATA, ADC_CH_3_DATA, ADC_CH_4_DATA;
+    wire [13:0] FILTERED_CH_1_DATA, FILTERED_CH_2_DATA, FILTERED_CH_3_DATA, FILTERED_CH_4_DATA;
+    wire SAMPLE_FRAME;
     wire [C_S00_AXI_DATA_WIDTH-1 : 0] ENCODE_CLK_DIV;
     wire [C_S00_AXI_DATA_WIDTH-1 : 0] SAMPLES_PER_PACKET;
+    wire [C_S00_AXI_DATA_WIDTH-1 : 0] TRIGGER_CONTROL;
+    wire [C_S00_AXI_DATA_WIDTH-1 : 0] TRIGGER_WINDOW;
+    wire [C_S00_AXI_DATA_WIDTH-1 : 0] STREAM_CONTROL;
+    wire [C_S00_AXI_DATA_WIDTH-1 : 0] DECIMATION_CONTROL;
+    wire [C_S00_AXI_DATA_WIDTH-1 : 0] CORRELATOR_CONTROL;
+    wire [C_S00_AXI_DATA_WIDTH-1 : 0] CORRELATOR_INDEX;
+    wire [C_S00_AXI_DATA_WIDTH-1 : 0] CORRELATOR_STATUS;
+    wire [C_S00_AXI_DATA_WIDTH-1 : 0] CORRELATOR_RESULT;
+    wire [63:0] WINDOW_SAMPLE;
+    wire WINDOW_VALID, WINDOW_LAST;
+    wire SNAPSHOT_REQUEST, CLEAR_REQUEST, SNAPSHOT_ACK;
+    wire STREAM_OVERRUN;
+    wire [31:0] STREAM_DROPPED_SAMPLES;
+    wire [63:0] STREAM_TOTAL_SAMPLES;
+    wire [63:0] SAMPLE_COUNT;
+    wire SYNC_OUTPUT_ENABLE, SYNC_FIRE_REQUEST, SYNC_TOGGLE;
+    wire [63:0] SYNC_SAMPLE;
+    wire TRIGGER_IN_INVERT, TRIGGER_IN_TOGGLE;
+    wire [63:0] TRIGGER_IN_SAMPLE;
+    wire TRIGGER_OUT_FORCE, TRIGGER_OUT_REQUEST;
+    wire [63:0] TRIGGER_OUT_START, TRIGGER_OUT_END;
+    wire [C_S00_AXI_DATA_WIDTH-1 : 0] ENVELOPE_CONTROL;
+    wire [C_S00_AXI_DATA_WIDTH-1 : 0] ENVELOPE_STATUS;
+    wire [15:0] ENVELOPE_DECIMATION;
+    wire [10:0] ENVELOPE_LEVEL;
+    wire [63:0] ENVELOPE_DATA, ENVELOPE_START;
+    wire ENVELOPE_POP;
 
 // Instantiation of Axi Bus Interface S00_AXI
     quad_adc_v1_0_S00_AXI # (
@@ -112,6 +150,38 @@
         // output registers
         .ENCODE_CLK_DIV(ENCODE_CLK_DIV),
         .SAMPLES_PER_PACKET(SAMPLES_PER_PACKET),
+        .TRIGGER_CONTROL(TRIGGER_CONTROL),
+        .TRIGGER_WINDOW(TRIGGER_WINDOW),
+        .STREAM_CONTROL(STREAM_CONTROL),
+        .DECIMATION_CONTROL(DECIMATION_CONTROL),
+        .CORRELATOR_CONTROL(CORRELATOR_CONTROL),
+        .CORRELATOR_INDEX(CORRELATOR_INDEX),
+        .CORRELATOR_STATUS(CORRELATOR_STATUS),
+        .CORRELATOR_RESULT(CORRELATOR_RESULT),
+        .SNAPSHOT_REQUEST(SNAPSHOT_REQUEST),
+        .CLEAR_REQUEST(CLEAR_REQUEST),
+        .SNAPSHOT_ACK(SNAPSHOT_ACK),
+        .STREAM_OVERRUN(STREAM_OVERRUN),
+        .STREAM_DROPPED_SAMPLES(STREAM_DROPPED_SAMPLES),
+        .STREAM_TOTAL_SAMPLES(STREAM_TOTAL_SAMPLES),
+        .SYNC_OUTPUT_ENABLE(SYNC_OUTPUT_ENABLE),
+        .SYNC_FIRE_REQUEST(SYNC_FIRE_REQUEST),
+        .SYNC_TOGGLE(SYNC_TOGGLE),
+        .SYNC_SAMPLE(SYNC_SAMPLE),
+        .TRIGGER_IN_INVERT(TRIGGER_IN_INVERT),
+        .TRIGGER_IN_TOGGLE(TRIGGER_IN_TOGGLE),
+        .TRIGGER_IN_SAMPLE(TRIGGER_IN_SAMPLE),
+        .TRIGGER_OUT_FORCE(TRIGGER_OUT_FORCE),
+        .TRIGGER_OUT_REQUEST(TRIGGER_OUT_REQUEST),
+        .TRIGGER_OUT_START(TRIGGER_OUT_START),
+        .TRIGGER_OUT_END(TRIGGER_OUT_END),
+        .ENVELOPE_CONTROL(ENVELOPE_CONTROL),
+        .ENVELOPE_DECIMATION(ENVELOPE_DECIMATION),
+        .ENVELOPE_STATUS(ENVELOPE_STATUS),
+        .ENVELOPE_LEVEL({5'b0, ENVELOPE_LEVEL}),
+        .ENVELOPE_DATA(ENVELOPE_DATA),
+        .ENVELOPE_START(ENVELOPE_START),
+        .ENVELOPE_POP(ENVELOPE_POP),
 
         // axi bus ports
         .S_AXI_ACLK(s00_axi_aclk),
@@ -142,12 +212,25 @@
         .C_M_AXIS_TDATA_WIDTH(C_M00_AXIS_TDATA_WIDTH)
     ) quad_adc_v1_0_M00_AXIS_inst (
         // user ports
-        .CH_A_DATA_IN({2'b0,ADC_CH_1_DATA}),
-        .CH_B_DATA_IN({2'b0,ADC_CH_2_DATA}),
-        .CH_C_DATA_IN({2'b0,ADC_CH_3_DATA}),
-        .CH_D_DATA_IN({2'b0,ADC_CH_4_DATA}),
-        .FRAME_CLK(FRAME_CLK),
+        .CH_A_DATA_IN({2'b0,FILTERED_CH_1_DATA}),
+        .CH_B_DATA_IN({2'b0,FILTERED_CH_2_DATA}),
+        .CH_C_DATA_IN({2'b0,FILTERED_CH_3_DATA}),
+        .CH_D_DATA_IN({2'b0,FILTERED_CH_4_DATA}),
+        .SAMPLE_FRAME(SAMPLE_FRAME),
         .SAMPLES_PER_PACKET(SAMPLES_PER_PACKET),
+        .TRIGGER_CONTROL(TRIGGER_CONTROL),
+        .TRIGGER_WINDOW(TRIGGER_WINDOW),
+        .STREAM_CONTROL(STREAM_CONTROL),
+        .WINDOW_SAMPLE(WINDOW_SAMPLE),
+        .WINDOW_VALID(WINDOW_VALID),
+        .WINDOW_LAST(WINDOW_LAST),
+        .SNAPSHOT_REQUEST(SNAPSHOT_REQUEST),
+        .CLEAR_REQUEST(CLEAR_REQUEST),
+        .SNAPSHOT_ACK(SNAPSHOT_ACK),
+        .STREAM_OVERRUN(STREAM_OVERRUN),
+        .STREAM_DROPPED_SAMPLES(STREAM_DROPPED_SAMPLES),
+        .STREAM_TOTAL_SAMPLES(STREAM_TOTAL_SAMPLES),
+        .SAMPLE_COUNT(SAMPLE_COUNT),
 
         // axi bus ports
         .M_AXIS_ACLK(m00_axis_aclk),
@@ -225,10 +308,105 @@
         .CH_X_DATA(ADC_CH_4_DATA)
     );
 
+    // DC removal and decimation, which pass samples through unchanged when
+    // disabled.
+    quad_adc_decimator quad_adc_decimator_inst (
+        .CLK(m00_axis_aclk),
+        .RESET_N(m00_axis_aresetn),
+        .FRAME_CLK(FRAME_CLK),
+        .CH_1_IN(ADC_CH_1_DATA),
+        .CH_2_IN(ADC_CH_2_DATA),
+        .CH_3_IN(ADC_CH_3_DATA),
+        .CH_4_IN(ADC_CH_4_DATA),
+        .DECIMATION_CONTROL(DECIMATION_CONTROL),
+        .CH_1_OUT(FILTERED_CH_1_DATA),
+        .CH_2_OUT(FILTERED_CH_2_DATA),
+        .CH_3_OUT(FILTERED_CH_3_DATA),
+        .CH_4_OUT(FILTERED_CH_4_DATA),
+        .SAMPLE_FRAME(SAMPLE_FRAME)
+    );
+
+    // Lag search over the triggered window for the time difference of
+    // arrival between the reference and the other channels.
+    quad_adc_correlator quad_adc_correlator_inst (
+        .CLK(m00_axis_aclk),
+        .RESET_N(m00_axis_aresetn),
+        .WINDOW_SAMPLE(WINDOW_SAMPLE),
+        .WINDOW_VALID(WINDOW_VALID),
+        .WINDOW_LAST(WINDOW_LAST),
+        .CORRELATOR_CONTROL(CORRELATOR_CONTROL),
+        .RESULT_CLK(s00_axi_aclk),
+        .RESULT_INDEX(CORRELATOR_INDEX[9:0]),
+        .RESULT_DATA(CORRELATOR_RESULT),
+        .CORRELATOR_STATUS(CORRELATOR_STATUS)
+    );
+
+    // Smoothed power of each channel at a low rate, so that pings can be
+    // detected without reading the full rate stream.
+    quad_adc_envelope #(
+        .FIFO_ADDR_BITS(10)
+    ) quad_adc_envelope_inst (
+        .CLK(m00_axis_aclk),
+        .RESET_N(m00_axis_aresetn),
+        .SAMPLE_FRAME(SAMPLE_FRAME),
+        .CH_1_IN(FILTERED_CH_1_DATA),
+        .CH_2_IN(FILTERED_CH_2_DATA),
+        .CH_3_IN(FILTERED_CH_3_DATA),
+        .CH_4_IN(FILTERED_CH_4_DATA),
+        .SAMPLE_COUNT(SAMPLE_COUNT),
+        .ENVELOPE_CONTROL(ENVELOPE_CONTROL),
+        .ENVELOPE_DECIMATION(ENVELOPE_DECIMATION),
+        .READ_CLK(s00_axi_aclk),
+        .READ_POP(ENVELOPE_POP),
+        .READ_DATA(ENVELOPE_DATA),
+        .READ_LEVEL(ENVELOPE_LEVEL),
+        .ENVELOPE_STATUS(ENVELOPE_STATUS),
+        .ENVELOPE_START(ENVELOPE_START)
+    );
+
+    // Latch of the stream sample count on the edges of the sync line.
+    quad_adc_sync quad_adc_sync_inst (
+        .CLK(m00_axis_aclk),
+        .RESET_N(m00_axis_aresetn),
+        .SYNC_IN(SYNC_IN),
+        .SYNC_OUT(SYNC_OUT),
+        .OUTPUT_ENABLE(SYNC_OUTPUT_ENABLE),
+        .FIRE_REQUEST(SYNC_FIRE_REQUEST),
+        .SAMPLE_COUNT(SAMPLE_COUNT),
+        .SYNC_SAMPLE(SYNC_SAMPLE),
+        .SYNC_TOGGLE(SYNC_TOGGLE)
+    );
+
+    // The trigger input latches the sample count the same way as the sync
+    // line, but is never driven.
+    quad_adc_sync quad_adc_trigger_in_inst (
+        .CLK(m00_axis_aclk),
+        .RESET_N(m00_axis_aresetn),
+        .SYNC_IN(TRIGGER_IN ^ TRIGGER_IN_INVERT),
+        .SYNC_OUT(),
+        .OUTPUT_ENABLE(1'b0),
+        .FIRE_REQUEST(1'b0),
+        .SAMPLE_COUNT(SAMPLE_COUNT),
+        .SYNC_SAMPLE(TRIGGER_IN_SAMPLE),
+        .SYNC_TOGGLE(TRIGGER_IN_TOGGLE)
+    );
+
+    // Trigger output over the planned capture windows.
+    quad_adc_trigger_out quad_adc_trigger_out_inst (
+        .CLK(m00_axis_aclk),
+        .RESET_N(m00_axis_aresetn),
+        .SAMPLE_COUNT(SAMPLE_COUNT),
+        .WINDOW_START(TRIGGER_OUT_START),
+        .WINDOW_END(TRIGGER_OUT_END),
+        .WINDOW_REQUEST(TRIGGER_OUT_REQUEST),
+        .FORCE(TRIGGER_OUT_FORCE),
+        .TRIGGER_OUT(TRIGGER_OUT)
+    );
+
     // Encode CLK Generator
     adc_encode_clk_gen adc_encode_clk_gen_inst (
-        .AXI_CLK(s00_axi_aclk),
         .RESET_N(s00_axi_aresetn),
+        .REF_CLK(ENCODE_REF_CLK),
         .CLOCK_DIV(ENCODE_CLK_DIV),
         .ENCODE_CLK(ENCODE_CLK)
     );
@@ -4,10 +4,22 @@
     (
         // Users to add parameters here
 
+        // Number of address bits of the pre-trigger history buffer. Each
+        // entry holds one sample of all four channels.
+        parameter integer HISTORY_ADDR_BITS = 12,
+
+        // Number of address bits of the longest packet that may be sent as
+        // planar channels. Each packet is buffered while the one before it is
+        // sent, so the buffer holds two of them.
+        parameter integer PLANAR_ADDR_BITS = 9,
+
         // User parameters ends
         // Do not modify the parameters beyond this line
 
-        // Width of S_AXIS address bus. The slave accepts the read and write addresses of width C_M_AXIS_TDATA_WIDTH.
+        // Width of the sample stream. At 32 bits each sample is sent as two
+        // beats, {CH_B, CH_A} then {CH_D, CH_C}. At 64 bits each sample is
+        // one beat of {CH_D, CH_C, CH_B, CH_A}, which lands in memory with
+        // the same layout.
         parameter integer C_M_AXIS_TDATA_WIDTH  = 32
     )
     (
@@ -16,9 +28,49 @@
         input wire [15 : 0] CH_B_DATA_IN,
         input wire [15 : 0] CH_C_DATA_IN,
         input wire [15 : 0] CH_D_DATA_IN,
-        input wire FRAME_CLK,
+        // Rises once per sample in the M_AXIS_ACLK domain. The channel data
+        // is stable while it is high.
+        input wire SAMPLE_FRAME,
         input wire [31 : 0] SAMPLES_PER_PACKET,
 
+        // Trigger control: [13:0] threshold, [29:16] baseline, [31] enable.
+        input wire [31 : 0] TRIGGER_CONTROL,
+
+        // Trigger window: [15:0] pre-trigger samples, [31:16] post-trigger
+        // samples (including the sample that crossed the threshold).
+        input wire [31 : 0] TRIGGER_WINDOW,
+
+        // Stream control: [0] embed sample timestamps and packet headers,
+        // [1] pack the samples of a continuous 64-bit stream to 12 bits,
+        // [2] send each packet of a continuous 64-bit stream as planar
+        // channels, [3] append the statistics of each packet of a
+        // continuous 64-bit stream as a trailer,
+        // [7:4] the channels of a continuous 64-bit stream that are sent,
+        // with zero sending all four.
+        input wire [31 : 0] STREAM_CONTROL,
+
+        // Samples of the triggered window as they are transmitted, packed as
+        // {CH_D, CH_C, CH_B, CH_A}. WINDOW_LAST marks the final sample.
+        output wire [63 : 0] WINDOW_SAMPLE,
+        output wire WINDOW_VALID,
+        output wire WINDOW_LAST,
+
+        // Stream counters, passed to the AXI-lite clock domain on request. A
+        // toggle of SNAPSHOT_REQUEST copies the counters to the STREAM_*
+        // outputs, which then hold still until the next request, and is
+        // answered by a toggle of SNAPSHOT_ACK. A toggle of CLEAR_REQUEST
+        // clears the overrun flag and the dropped sample count.
+        input wire SNAPSHOT_REQUEST,
+        input wire CLEAR_REQUEST,
+        output reg SNAPSHOT_ACK = 1'b0,
+        output reg STREAM_OVERRUN = 1'b0,
+        output reg [31 : 0] STREAM_DROPPED_SAMPLES = 32'b0,
+        output reg [63 : 0] STREAM_TOTAL_SAMPLES = 64'b0,
+
+        // The number of the sample being sent, as embedded in the stream,
+        // which the sync latch copies on a sync edge.
+        output wire [63 : 0] SAMPLE_COUNT,
+
         // User ports ends
         // Do not modify the ports beyond this line
 
@@ -37,13 +89,6 @@
     reg [15:0] CH_C_DATA_REG;
     reg [15:0] CH_D_DATA_REG;
 
-    always @(posedge FRAME_CLK) begin
-        CH_A_DATA_REG <= CH_A_DATA_IN;
-        CH_D_DATA_REG <= CH_D_DATA_IN;
-        CH_C_DATA_REG <= CH_C_DATA_IN;
-        CH_B_DATA_REG <= CH_B_DATA_IN;
-    end
-
     // hookup TDATA to its output
     //assign M_AXIS_TDATA  = stream_data_out;
 
@@ -59,6 +104,12 @@
                     WAIT_FOR_DATA_STATE = 2'b11; // Wait for new data
 
     wire [31:0] samples_per_packet = SAMPLES_PER_PACKET - 1;
+
+    // A 64-bit stream sends each sample in the TX_AB_STATE beat alone.
+    localparam WIDE_STREAM = (C_M_AXIS_TDATA_WIDTH == 64);
+
+    // The state in which the last beat of a sample is sent.
+    localparam [1:0] LAST_BEAT_STATE = (WIDE_STREAM)? TX_AB_STATE : TX_CD_STATE;
    
     // State variable
     reg [1:0] state = IDLE_STATE;
@@ -66,6 +117,16 @@
     //Contains the number of samples sent in the current packet.
     reg [31:0] samples = 32'b0;
 
+    // Latch the channels as the state machine starts on a new sample.
+    always @(posedge M_AXIS_ACLK) begin
+        if (state == WAIT_FOR_DATA_STATE && SAMPLE_FRAME == 1'b1) begin
+            CH_A_DATA_REG <= CH_A_DATA_IN;
+            CH_D_DATA_REG <= CH_D_DATA_IN;
+            CH_C_DATA_REG <= CH_C_DATA_IN;
+            CH_B_DATA_REG <= CH_B_DATA_IN;
+        end
+    end
+
     // Control state machine implementation
     always @(posedge M_AXIS_ACLK)
     begin
@@ -79,41 +140,609 @@
         case (state)
           IDLE_STATE:
           begin
-            if (FRAME_CLK == 1'b0) begin
+            if (SAMPLE_FRAME == 1'b0) begin
                 state <= WAIT_FOR_DATA_STATE;
             end
           end
           WAIT_FOR_DATA_STATE:
           begin
-            if (FRAME_CLK == 1'b1) begin
+            if (SAMPLE_FRAME == 1'b1) begin
                 state  <= TX_AB_STATE;
             end
           end
 
-          TX_AB_STATE:
+          TX_AB_STATE, TX_CD_STATE:
           begin
-            state <= TX_CD_STATE;
+            if (state == LAST_BEAT_STATE) begin
+                state <= IDLE_STATE;
+                samples <= (samples >= samples_per_packet)? 32'b0 : samples + 1'b1;
+            end
+            else begin
+                state <= TX_CD_STATE;
+            end
           end
 
-          TX_CD_STATE:
-          begin
-            state <= IDLE_STATE;
-            samples <= (samples >= samples_per_packet)? 32'b0 : samples + 1'b1;
+        endcase
+    end
+
+
+    // Sample timestamps
+    // Every sample produced by the ADC is counted. When enabled, the index of
+    // the first sample of a packet is embedded in the two unused upper bits of
+    // each channel over the first eight samples of the packet, one byte per
+    // sample and least significant byte first. Channel A carries bits [1:0],
+    // channel B [3:2], channel C [5:4] and channel D [7:6] of each byte.
+    reg [1:0] timestamp_enable_sync = 2'b0;
+    always @(posedge M_AXIS_ACLK) begin
+        timestamp_enable_sync <= {timestamp_enable_sync[0], STREAM_CONTROL[0]};
+    end
+
+    wire timestamp_enable = timestamp_enable_sync[1];
+
+    reg [63:0] sample_count = 64'b0;
+    reg [63:0] packet_timestamp = 64'b0;
+
+    always @(posedge M_AXIS_ACLK)
+    begin
+      if (!M_AXIS_ARESETN)
+        begin
+          sample_count <= 64'b0;
+          packet_timestamp <= 64'b0;
+        end
+      else
+        begin
+          if (state == TX_AB_STATE && samples == 0) begin
+              packet_timestamp <= sample_count;
           end
 
-        endcase
+          if (state == LAST_BEAT_STATE) begin
+              sample_count <= sample_count + 1'b1;
+          end
+        end
+    end
+
+    wire [63:0] current_timestamp = (samples == 0)? sample_count : packet_timestamp;
+
+    assign SAMPLE_COUNT = sample_count;
+
+    // Packed samples
+    // When enabled on a continuous 64-bit stream, every sample after the
+    // header samples of a packet is cut to the upper 12 bits of each 14-bit
+    // channel and packed into 48 bits, {CH_D, CH_C, CH_B, CH_A}. Each group
+    // of four samples is sent as three beats, so the packed samples land in
+    // memory as consecutive 6-byte records. The first sample of a group is
+    // held until the second completes a beat, and the number of samples after
+    // the header must be a multiple of four so the packet ends on a beat.
+    localparam integer HEADER_SAMPLES = 16;
+
+    reg [1:0] pack_enable_sync = 2'b0;
+    always @(posedge M_AXIS_ACLK) begin
+        pack_enable_sync <= {pack_enable_sync[0], STREAM_CONTROL[1]};
+    end
+
+    // Masking one or two channels takes precedence over packing.
+    wire masking;
+    wire mask_selected;
+    wire packing = WIDE_STREAM && pack_enable_sync[1] && !mask_selected && (samples >= HEADER_SAMPLES);
+
+    wire [47:0] packed_sample = {CH_D_DATA_REG[13:2], CH_C_DATA_REG[13:2],
+                                 CH_B_DATA_REG[13:2], CH_A_DATA_REG[13:2]};
+    reg [47:0] pack_residual = 48'b0;
+
+    // The headers start on a group boundary, so the position of a sample in
+    // its group is the low bits of its index.
+    wire [1:0] pack_phase = samples[1:0];
+
+    always @(posedge M_AXIS_ACLK) begin
+        if (state == TX_AB_STATE && packing) begin
+            case (pack_phase)
+                2'd0: pack_residual <= packed_sample;
+                2'd1: pack_residual <= {16'b0, packed_sample[47:16]};
+                2'd2: pack_residual <= {32'b0, packed_sample[47:32]};
+                2'd3: pack_residual <= 48'b0;
+            endcase
+        end
+    end
+
+    wire [63:0] packed_beat =
+        (pack_phase == 2'd1)? {packed_sample[15:0], pack_residual[47:0]} :
+        (pack_phase == 2'd2)? {packed_sample[31:0], pack_residual[31:0]} :
+        {packed_sample[47:0], pack_residual[15:0]};
+
+    // Channel mask
+    // When one or two channels are enabled on a continuous 64-bit stream,
+    // every sample after the header samples of a packet carries only the
+    // enabled channels, in ascending order and 16 bits each, and consecutive
+    // samples are gathered into beats. A single channel sends four samples
+    // per beat and two channels send two, so the number of samples after the
+    // header must be a multiple of four or two. Any other mask sends every
+    // channel. The header samples always carry all four channels so that the
+    // embedded timestamps are unchanged. The mask is latched as the first
+    // sample of each packet is sent, so a packet is never partly masked.
+    reg [3:0] channel_mask_meta = 4'b0;
+    reg [3:0] channel_mask_sync = 4'b0;
+    reg [3:0] channel_mask = 4'b0;
+    always @(posedge M_AXIS_ACLK) begin
+        channel_mask_meta <= STREAM_CONTROL[7:4];
+        channel_mask_sync <= channel_mask_meta;
+        if (state == TX_AB_STATE && samples == 0) begin
+            channel_mask <= channel_mask_sync;
+        end
+    end
+
+    wire [2:0] enabled_channels = {2'b0, channel_mask[0]} + {2'b0, channel_mask[1]} +
+                                  {2'b0, channel_mask[2]} + {2'b0, channel_mask[3]};
+    wire single_channel = (enabled_channels == 3'd1);
+    assign mask_selected = WIDE_STREAM && (single_channel || enabled_channels == 3'd2);
+    assign masking = mask_selected && (samples >= HEADER_SAMPLES);
+
+    // The lowest and highest enabled channels, which are the same channel
+    // when only one is enabled.
+    wire [15:0] low_channel = (channel_mask[0])? CH_A_DATA_REG :
+                              (channel_mask[1])? CH_B_DATA_REG :
+                              (channel_mask[2])? CH_C_DATA_REG : CH_D_DATA_REG;
+    wire [15:0] high_channel = (channel_mask[3])? CH_D_DATA_REG :
+                               (channel_mask[2])? CH_C_DATA_REG :
+                               (channel_mask[1])? CH_B_DATA_REG : CH_A_DATA_REG;
+
+    // The headers start on a beat boundary, so the position of a sample in
+    // its beat is the low bits of its index.
+    wire [1:0] mask_phase = (single_channel)? samples[1:0] : {1'b0, samples[0]};
+    wire mask_beat_done = (single_channel)? (mask_phase == 2'd3) : (mask_phase == 2'd1);
+    reg [47:0] mask_residual = 48'b0;
+
+    always @(posedge M_AXIS_ACLK) begin
+        if (state == TX_AB_STATE && masking) begin
+            if (mask_beat_done) begin
+                mask_residual <= 48'b0;
+            end
+            else if (single_channel) begin
+                mask_residual[mask_phase*16 +: 16] <= low_channel;
+            end
+            else begin
+                mask_residual[31:0] <= {high_channel, low_channel};
+            end
+        end
+    end
+
+    wire [63:0] masked_beat = (single_channel)? {low_channel, mask_residual[47:0]} :
+        {high_channel, low_channel, mask_residual[31:0]};
+
+    // Packet headers
+    // The next eight samples of each packet carry a header word in the same
+    // bits: [31:0] the sequence number of the packet, which counts every
+    // packet sent since reset, and [39:32] status bits. Status bit 0 is set
+    // if a sample was lost to a full FIFO since the previous packet began,
+    // and bit 1 is set for a triggered window. The header is latched as the
+    // first beat of a packet is sent.
+    reg [31:0] packet_sequence = 32'b0;
+    reg [7:0] packet_status = 8'b0;
+    reg lost_since_packet = 1'b0;
+
+    wire [63:0] packet_header = {24'b0, packet_status, packet_sequence};
+
+    wire [127:0] stream_header_bits = {packet_header, current_timestamp};
+    wire [7:0] stream_timestamp_byte = (timestamp_enable && samples < 16)?
+        stream_header_bits[samples[3:0]*8 +: 8] : 8'b0;
+
+    // Replaces the upper two bits of both channels in a beat.
+    function [31:0] embed_timestamp;
+        input [31:0] beat;
+        input [3:0] bits;
+        embed_timestamp = {bits[3:2], beat[29:16], bits[1:0], beat[13:0]};
+    endfunction
+
+    // Packs a sample with its timestamp bits into the beat of the stream
+    // width, selecting the half of a 32-bit stream sent in the given beat.
+    function [C_M_AXIS_TDATA_WIDTH-1:0] stream_beat;
+        input [63:0] sample;
+        input [7:0] bits;
+        input second_beat;
+        reg [63:0] embedded;
+        begin
+            embedded = {embed_timestamp(sample[63:32], bits[7:4]),
+                        embed_timestamp(sample[31:0], bits[3:0])};
+            stream_beat = (WIDE_STREAM)? embedded[C_M_AXIS_TDATA_WIDTH-1:0] :
+                (second_beat)? embedded[63:32] : embedded[31:0];
+        end
+    endfunction
+
+    // Threshold trigger
+    // When enabled, every sample is written into a circular history buffer and
+    // nothing is streamed until a channel deviates from the baseline by more
+    // than the threshold. The window around the crossing is then streamed out
+    // of the history buffer as a single packet with TLAST on the final beat.
+    // The trigger is one-shot and is re-armed by clearing and setting enable.
+    localparam integer HISTORY_DEPTH = 1 << HISTORY_ADDR_BITS;
+
+    parameter [2:0] TRIG_DISABLED_STATE = 3'b000, // Continuous streaming
+                    TRIG_ARMED_STATE    = 3'b001, // Waiting for a crossing
+                    TRIG_READ_STATE     = 3'b010, // Waiting for history data
+                    TRIG_TX_AB_STATE    = 3'b011, // Transmitting CH_A and CH_B data
+                    TRIG_TX_CD_STATE    = 3'b100, // Transmitting CH_C and CH_D data
+                    TRIG_DONE_STATE     = 3'b101; // Window sent, waiting for re-arm
+
+    localparam [2:0] TRIG_LAST_BEAT_STATE = (WIDE_STREAM)? TRIG_TX_AB_STATE : TRIG_TX_CD_STATE;
+
+    // The trigger configuration is written from the AXI-lite clock domain, so
+    // synchronize the enable bit before using it.
+    reg [1:0] trigger_enable_sync = 2'b0;
+    always @(posedge M_AXIS_ACLK) begin
+        trigger_enable_sync <= {trigger_enable_sync[0], TRIGGER_CONTROL[31]};
+    end
+
+    wire trigger_enable = trigger_enable_sync[1];
+    wire [15:0] trigger_threshold = {2'b0, TRIGGER_CONTROL[13:0]};
+    wire [15:0] trigger_baseline = {2'b0, TRIGGER_CONTROL[29:16]};
+    wire [15:0] post_trigger_samples = TRIGGER_WINDOW[31:16];
+
+    // Leave a margin so the writer never laps the start of the window.
+    wire [15:0] pre_trigger_samples =
+        (TRIGGER_WINDOW[15:0] > HISTORY_DEPTH - 16)? HISTORY_DEPTH - 16 : TRIGGER_WINDOW[15:0];
+
+    function [15:0] deviation;
+        input [15:0] sample;
+        input [15:0] baseline;
+        deviation = (sample > baseline)? sample - baseline : baseline - sample;
+    endfunction
+
+    wire threshold_exceeded =
+        (deviation(CH_A_DATA_REG, trigger_baseline) > trigger_threshold) ||
+        (deviation(CH_B_DATA_REG, trigger_baseline) > trigger_threshold) ||
+        (deviation(CH_C_DATA_REG, trigger_baseline) > trigger_threshold) ||
+        (deviation(CH_D_DATA_REG, trigger_baseline) > trigger_threshold);
+
+    // A new sample is available once per frame.
+    wire frame_strobe = (state == TX_AB_STATE);
+
+    reg [2:0] trigger_state = TRIG_DISABLED_STATE;
+    reg [HISTORY_ADDR_BITS-1:0] write_address = 0;
+    reg [HISTORY_ADDR_BITS-1:0] read_address = 0;
+    reg [15:0] history_fill = 16'b0;
+    reg [16:0] window_remaining = 17'b0;
+    reg [16:0] window_position = 17'b0;
+    reg [63:0] window_timestamp = 64'b0;
+
+    // History buffer (inferred as block RAM)
+    reg [63:0] history [0 : HISTORY_DEPTH-1];
+    reg [63:0] history_out;
+
+    always @(posedge M_AXIS_ACLK)
+    begin
+      if (frame_strobe) begin
+          history[write_address] <= {CH_D_DATA_REG, CH_C_DATA_REG, CH_B_DATA_REG, CH_A_DATA_REG};
+      end
+      history_out <= history[read_address];
+    end
+
+    always @(posedge M_AXIS_ACLK)
+    begin
+      if (!M_AXIS_ARESETN)
+        begin
+          trigger_state <= TRIG_DISABLED_STATE;
+          write_address <= 0;
+          read_address <= 0;
+          history_fill <= 16'b0;
+          window_remaining <= 17'b0;
+          window_position <= 17'b0;
+          window_timestamp <= 64'b0;
+        end
+      else
+        begin
+          if (frame_strobe) begin
+              write_address <= write_address + 1'b1;
+          end
+
+          case (trigger_state)
+            TRIG_DISABLED_STATE:
+            begin
+              history_fill <= 16'b0;
+              if (trigger_enable) begin
+                  trigger_state <= TRIG_ARMED_STATE;
+              end
+            end
+
+            TRIG_ARMED_STATE:
+            begin
+              if (!trigger_enable) begin
+                  trigger_state <= TRIG_DISABLED_STATE;
+              end
+              else if (frame_strobe) begin
+                  // Only trigger once the full pre-trigger window is buffered.
+                  if (history_fill >= pre_trigger_samples && threshold_exceeded) begin
+                      read_address <= write_address - pre_trigger_samples[HISTORY_ADDR_BITS-1:0];
+                      window_remaining <= pre_trigger_samples + post_trigger_samples - 1'b1;
+                      window_position <= 17'b0;
+                      window_timestamp <= sample_count - pre_trigger_samples;
+                      trigger_state <= TRIG_READ_STATE;
+                  end
+                  else if (history_fill != 16'hFFFF) begin
+                      history_fill <= history_fill + 1'b1;
+                  end
+              end
+            end
+
+            TRIG_READ_STATE:
+            begin
+              // A sample takes at most three cycles to drain and at least
+              // four to arrive, so the reader catches up to live data and then
+              // follows the writer.
+              if (read_address != write_address) begin
+                  trigger_state <= TRIG_TX_AB_STATE;
+              end
+            end
+
+            TRIG_TX_AB_STATE, TRIG_TX_CD_STATE:
+            begin
+              if (trigger_state != TRIG_LAST_BEAT_STATE) begin
+                  trigger_state <= TRIG_TX_CD_STATE;
+              end
+              else begin
+                  read_address <= read_address + 1'b1;
+                  window_position <= window_position + 1'b1;
+                  if (window_remaining == 0) begin
+                      trigger_state <= TRIG_DONE_STATE;
+                  end
+                  else begin
+                      window_remaining <= window_remaining - 1'b1;
+                      trigger_state <= TRIG_READ_STATE;
+                  end
+              end
+            end
+
+            TRIG_DONE_STATE:
+            begin
+              if (!trigger_enable) begin
+                  trigger_state <= TRIG_DISABLED_STATE;
+              end
+            end
+
+            default:
+            begin
+              trigger_state <= TRIG_DISABLED_STATE;
+            end
+          endcase
+        end
+    end
+
+    wire trigger_mode = trigger_enable || (trigger_state != TRIG_DISABLED_STATE);
+
+    // Planar packets
+    // When enabled on a continuous 64-bit stream whose samples are neither
+    // packed nor masked, each packet is sent transposed: every sample of
+    // channel A, then those of channels B, C and D, four samples of one
+    // channel per beat. The DMA engine then writes a packet through one
+    // descriptor per channel, so that each channel lands in its own region
+    // of memory. Each packet is buffered as it arrives and sent while the
+    // next one arrives, one beat per sample, so the stream keeps its rate
+    // and runs one packet behind. The packet length must be a multiple of
+    // four and at most PLANAR_MAX_SAMPLES. The mode is latched as the first
+    // sample of each packet arrives. The first planar packet after the mode
+    // is enabled sends nothing while it is buffered, and the packet buffered
+    // when it is disabled is not sent. Samples keep their embedded headers.
+    localparam integer PLANAR_MAX_SAMPLES = 1 << PLANAR_ADDR_BITS;
+    localparam integer PLANAR_GROUP_BITS = PLANAR_ADDR_BITS - 2;
+
+    reg [1:0] planar_enable_sync = 2'b0;
+    always @(posedge M_AXIS_ACLK) begin
+        planar_enable_sync <= {planar_enable_sync[0], STREAM_CONTROL[2]};
+    end
+
+    wire planar_allowed = WIDE_STREAM && planar_enable_sync[1] && !pack_enable_sync[1] &&
+                          !mask_selected && !trigger_mode;
+
+    // Whether the packet arriving is sent planar, whether the packet before
+    // it was buffered and is being sent, and the half of the buffer that the
+    // packet arriving is written to.
+    reg planar_packet = 1'b0;
+    reg planar_buffered = 1'b0;
+    reg planar_bank = 1'b0;
+    wire planar_sending = (samples == 0)? planar_allowed : planar_packet;
+
+    // The next beat of the buffered packet, as a group of four samples of a
+    // channel. Each channel holds the packet length over four groups.
+    reg [PLANAR_GROUP_BITS-1:0] planar_group = 0;
+    reg [1:0] planar_channel = 2'b0;
+    wire [PLANAR_GROUP_BITS-1:0] planar_last_group = samples_per_packet[PLANAR_ADDR_BITS-1:2];
+    wire planar_last_beat = (planar_channel == 2'd3) && (planar_group == planar_last_group);
+
+    wire [63:0] planar_sample = {embed_timestamp({CH_D_DATA_REG, CH_C_DATA_REG}, stream_timestamp_byte[7:4]),
+                                 embed_timestamp({CH_B_DATA_REG, CH_A_DATA_REG}, stream_timestamp_byte[3:0])};
+    wire [PLANAR_GROUP_BITS:0] planar_write_address = {planar_bank, samples[PLANAR_ADDR_BITS-1:2]};
+    wire [PLANAR_GROUP_BITS:0] planar_read_address = {~planar_bank, planar_group};
+
+    // Packet buffer (inferred as block RAM), with a memory per channel whose
+    // entries hold four consecutive samples. Every sample of a 64-bit stream
+    // is written, so the packet before a change to the mode is buffered.
+    wire [63:0] planar_out [0:3];
+    genvar planar_index;
+    generate
+        for (planar_index = 0; planar_index < 4; planar_index = planar_index + 1) begin : planar_buffers
+            reg [63:0] buffer [0 : (1 << (PLANAR_GROUP_BITS + 1)) - 1];
+            reg [63:0] buffer_out = 64'b0;
+
+            always @(posedge M_AXIS_ACLK) begin
+                if (WIDE_STREAM && frame_strobe) begin
+                    case (samples[1:0])
+                        2'd0: buffer[planar_write_address][15:0] <= planar_sample[planar_index*16 +: 16];
+                        2'd1: buffer[planar_write_address][31:16] <= planar_sample[planar_index*16 +: 16];
+                        2'd2: buffer[planar_write_address][47:32] <= planar_sample[planar_index*16 +: 16];
+                        2'd3: buffer[planar_write_address][63:48] <= planar_sample[planar_index*16 +: 16];
+                    endcase
+                end
+                buffer_out <= buffer[planar_read_address];
+            end
+
+            assign planar_out[planar_index] = buffer_out;
+        end
+    endgenerate
+
+    wire [63:0] planar_beat = planar_out[planar_channel];
+
+    always @(posedge M_AXIS_ACLK)
+    begin
+      if (!M_AXIS_ARESETN)
+        begin
+          planar_packet <= 1'b0;
+          planar_buffered <= 1'b0;
+          planar_bank <= 1'b0;
+          planar_group <= 0;
+          planar_channel <= 2'b0;
+        end
+      else if (frame_strobe)
+        begin
+          if (samples == 0) begin
+              planar_packet <= planar_allowed;
+          end
+
+          if (planar_group == planar_last_group) begin
+              planar_group <= 0;
+              planar_channel <= planar_channel + 1'b1;
+          end
+          else begin
+              planar_group <= planar_group + 1'b1;
+          end
+
+          // Once the last sample of a packet is written, the packet is sent
+          // from the start while the next one is written to the other half.
+          if (samples >= samples_per_packet) begin
+              planar_buffered <= planar_sending;
+              planar_bank <= ~planar_bank;
+              planar_group <= 0;
+              planar_channel <= 2'b0;
+          end
+        end
     end
 
+    // Packet statistics
+    // When enabled on a continuous 64-bit stream whose packets are neither
+    // packed, masked nor planar, each packet is followed by a trailer of two
+    // beats per channel, channel A first, that summarizes the 14-bit samples
+    // of the packet before their headers are embedded:
+    //   beat 0: [47:0] the sum of squares, [63:48] the samples at either
+    //           rail, saturating
+    //   beat 1: [31:0] the sum, [47:32] the minimum, [63:48] the maximum
+    // TLAST then marks the last beat of the trailer. The trailer is sent in
+    // the cycles between samples, so it must be sent before the next sample
+    // arrives: the sample period must exceed TRAILER_BEATS cycles by the
+    // handshake of the sample frame. The sums are exact for packets of up to
+    // 65536 samples. The mode is latched as the first sample of each packet
+    // arrives.
+    localparam integer TRAILER_BEATS = 8;
+
+    reg [1:0] stats_enable_sync = 2'b0;
+    always @(posedge M_AXIS_ACLK) begin
+        stats_enable_sync <= {stats_enable_sync[0], STREAM_CONTROL[3]};
+    end
+
+    wire stats_allowed = WIDE_STREAM && stats_enable_sync[1] && !pack_enable_sync[1] &&
+                         !mask_selected && !planar_allowed && !trigger_mode;
+
+    reg stats_packet = 1'b0;
+    wire stats_sending = (samples == 0)? stats_allowed : stats_packet;
+
+    // The beats of the trailer being sent, and the number left to send.
+    wire [63:0] trailer [0:TRAILER_BEATS-1];
+    reg [3:0] trailer_remaining = 4'b0;
+
+    wire [13:0] stats_sample [0:3];
+    assign stats_sample[0] = CH_A_DATA_REG[13:0];
+    assign stats_sample[1] = CH_B_DATA_REG[13:0];
+    assign stats_sample[2] = CH_C_DATA_REG[13:0];
+    assign stats_sample[3] = CH_D_DATA_REG[13:0];
+
+    // The trailer is only offered between the beats of samples.
+    wire trailer_beat = (trailer_remaining != 0) && (state != TX_AB_STATE);
+    wire [2:0] trailer_index = TRAILER_BEATS - trailer_remaining;
+
+    genvar stats_index;
+    generate
+        for (stats_index = 0; stats_index < 4; stats_index = stats_index + 1) begin : packet_stats
+            // The running statistics of the channel over the packet.
+            reg [31:0] sum = 32'b0;
+            reg [47:0] squares = 48'b0;
+            reg [13:0] min = 14'b0;
+            reg [13:0] max = 14'b0;
+            reg [15:0] clipped = 16'b0;
+            reg [63:0] trailer_squares = 64'b0;
+            reg [63:0] trailer_sum = 64'b0;
+
+            wire [13:0] value = stats_sample[stats_index];
+            wire first = (samples == 0);
+            wire rail = (value == 14'd0) || (value == 14'h3FFF);
+            wire [31:0] sum_next = ((first)? 32'b0 : sum) + value;
+            wire [47:0] squares_next = ((first)? 48'b0 : squares) + value * value;
+            wire [13:0] min_next = (first || value < min)? value : min;
+            wire [13:0] max_next = (first || value > max)? value : max;
+            wire [15:0] clipped_base = (first)? 16'b0 : clipped;
+            wire [15:0] clipped_next = (rail && clipped_base != 16'hFFFF)? clipped_base + 1'b1 : clipped_base;
+
+            always @(posedge M_AXIS_ACLK) begin
+                if (WIDE_STREAM && frame_strobe) begin
+                    sum <= sum_next;
+                    squares <= squares_next;
+                    min <= min_next;
+                    max <= max_next;
+                    clipped <= clipped_next;
+
+                    if (samples >= samples_per_packet && stats_sending) begin
+                        trailer_squares <= {clipped_next, squares_next};
+                        trailer_sum <= {2'b0, max_next, 2'b0, min_next, sum_next};
+                    end
+                end
+            end
+
+            assign trailer[2*stats_index] = trailer_squares;
+            assign trailer[2*stats_index+1] = trailer_sum;
+        end
+    endgenerate
+
+    always @(posedge M_AXIS_ACLK)
+    begin
+      if (!M_AXIS_ARESETN)
+        begin
+          stats_packet <= 1'b0;
+          trailer_remaining <= 4'b0;
+        end
+      else
+        begin
+          if (frame_strobe && samples == 0) begin
+              stats_packet <= stats_allowed;
+          end
+
+          if (frame_strobe && samples >= samples_per_packet && stats_sending) begin
+              trailer_remaining <= TRAILER_BEATS;
+          end
+          else if (trailer_beat) begin
+              trailer_remaining <= trailer_remaining - 1'b1;
+          end
+        end
+    end
 
     // output drive logic
     //assign q = ( select == 0 )? d[0] : ( select == 1 )? d[1] : ( select == 2 )? d[2] : d[3];
 
-    assign M_AXIS_TDATA =
-        (state == IDLE_STATE)  ? {(C_M_AXIS_TDATA_WIDTH){1'b0}} :
-        (state == TX_AB_STATE) ? {CH_B_DATA_REG,CH_A_DATA_REG} :
-        (state == TX_CD_STATE) ? {CH_D_DATA_REG,CH_C_DATA_REG} :
-        (state == WAIT_FOR_DATA_STATE) ? {(C_M_AXIS_TDATA_WIDTH){1'b0}} :
+    wire [C_M_AXIS_TDATA_WIDTH-1 : 0] stream_tdata =
+        (trailer_beat) ? trailer[trailer_index][C_M_AXIS_TDATA_WIDTH-1:0] :
+        (state == TX_AB_STATE && planar_sending) ? planar_beat[C_M_AXIS_TDATA_WIDTH-1:0] :
+        (state == TX_AB_STATE && masking) ? masked_beat[C_M_AXIS_TDATA_WIDTH-1:0] :
+        (state == TX_AB_STATE && packing) ? packed_beat[C_M_AXIS_TDATA_WIDTH-1:0] :
+        (state == TX_AB_STATE || state == TX_CD_STATE) ?
+            stream_beat({CH_D_DATA_REG, CH_C_DATA_REG, CH_B_DATA_REG, CH_A_DATA_REG},
+                        stream_timestamp_byte, (state == TX_CD_STATE)) :
+        {(C_M_AXIS_TDATA_WIDTH){1'b0}};
+
+    // The timestamp of a triggered window is the index of its first sample.
+    wire [127:0] trigger_header_bits = {packet_header, window_timestamp};
+    wire [7:0] trigger_timestamp_byte = (timestamp_enable && window_position < 16)?
+        trigger_header_bits[window_position[3:0]*8 +: 8] : 8'b0;
+
+    wire [C_M_AXIS_TDATA_WIDTH-1 : 0] trigger_tdata =
+        (trigger_state == TRIG_TX_AB_STATE || trigger_state == TRIG_TX_CD_STATE) ?
+            stream_beat(history_out, trigger_timestamp_byte, (trigger_state == TRIG_TX_CD_STATE)) :
         {(C_M_AXIS_TDATA_WIDTH){1'b0}};
+
+    assign M_AXIS_TDATA = (trigger_mode)? trigger_tdata : stream_tdata;
     /* always @ (*) begin */
     /*     case (state) */
     /*         IDLE_STATE: M_AXIS_TDATA = 32'hFABC; //{(C_M_AXIS_TDATA_WIDTH){1'b0}}; */
@@ -125,11 +754,123 @@
     //tvalid generation
     //axis_tvalid is asserted when the control state machine's state is SEND_STREAM and
     //number of output streaming data is less than the NUMBER_OF_OUTPUT_WORDS.
-    assign M_AXIS_TVALID = ((state == TX_AB_STATE) ||  (state == TX_CD_STATE));
+    // The first sample of a packed group does not complete a beat, and
+    // neither does any masked sample but the last of its beat. A planar
+    // packet sends a beat for each sample once the packet before it is
+    // buffered. The beats of a trailer are sent between samples.
+    assign M_AXIS_TVALID = (trigger_mode)?
+        ((trigger_state == TRIG_TX_AB_STATE) || (trigger_state == TRIG_TX_CD_STATE)) :
+        (planar_sending)? (state == TX_AB_STATE && planar_buffered) :
+        ((state == TX_AB_STATE && !(packing && pack_phase == 2'd0) && !(masking && !mask_beat_done)) ||
+         (state == TX_CD_STATE) || trailer_beat);
 
     // AXI tlast generation
     // axis_tlast is asserted number of output streaming data is NUMBER_OF_OUTPUT_WORDS-1
     // (0 to NUMBER_OF_OUTPUT_WORDS-1)
-    assign M_AXIS_TLAST = (samples == samples_per_packet) && (state == TX_CD_STATE);
+    // In trigger mode, tlast marks the final beat of the window, in planar
+    // mode the final beat of channel D, and with statistics the final beat
+    // of the trailer.
+    assign M_AXIS_TLAST = (trigger_mode)?
+        ((window_remaining == 0) && (trigger_state == TRIG_LAST_BEAT_STATE)) :
+        (trailer_beat)? (trailer_remaining == 1) :
+        (planar_sending)? planar_last_beat && (state == TX_AB_STATE) :
+        ((samples == samples_per_packet) && (state == LAST_BEAT_STATE) && !stats_sending);
+
+    // Overrun detection
+    // The stream does not wait for TREADY, so a beat offered while the FIFO
+    // is full is lost and its sample is corrupt. Such samples are counted and
+    // raise a sticky overrun flag. Every sample produced by the ADC is counted
+    // by sample_count. A lost beat of packed or masked samples is counted as
+    // one sample, although it spans parts of several. A lost beat of a
+    // trailer shortens its packet, which the DMA engine reports, but loses
+    // no sample.
+    wire last_beat = (trigger_mode)?
+        (trigger_state == TRIG_LAST_BEAT_STATE) : (state == LAST_BEAT_STATE);
+    wire beat_lost = M_AXIS_TVALID && !M_AXIS_TREADY && !(trailer_beat && !trigger_mode);
+    reg sample_lost = 1'b0;
+    wire sample_dropped = M_AXIS_TVALID && last_beat && (sample_lost || beat_lost);
+
+    reg [2:0] snapshot_request_sync = 3'b0;
+    reg [2:0] clear_request_sync = 3'b0;
+    always @(posedge M_AXIS_ACLK) begin
+        snapshot_request_sync <= {snapshot_request_sync[1:0], SNAPSHOT_REQUEST};
+        clear_request_sync <= {clear_request_sync[1:0], CLEAR_REQUEST};
+    end
+
+    wire snapshot = snapshot_request_sync[2] ^ snapshot_request_sync[1];
+    wire clear = clear_request_sync[2] ^ clear_request_sync[1];
+
+    reg overrun = 1'b0;
+    reg [31:0] dropped_samples = 32'b0;
+
+    always @(posedge M_AXIS_ACLK)
+    begin
+      if (!M_AXIS_ARESETN)
+        begin
+          sample_lost <= 1'b0;
+          overrun <= 1'b0;
+          dropped_samples <= 32'b0;
+        end
+      else
+        begin
+          if (M_AXIS_TVALID) begin
+              sample_lost <= (last_beat)? 1'b0 : (sample_lost || beat_lost);
+          end
+
+          if (clear) begin
+              overrun <= 1'b0;
+              dropped_samples <= 32'b0;
+          end
+          else if (sample_dropped) begin
+              overrun <= 1'b1;
+              dropped_samples <= dropped_samples + 1'b1;
+          end
+        end
+    end
+
+    // Each packet latches its status as its first beat is sent, and the
+    // sequence number advances as its last beat is sent.
+    wire packet_start = (trigger_mode)?
+        ((trigger_state == TRIG_TX_AB_STATE) && (window_position == 0)) :
+        ((state == TX_AB_STATE) && (samples == 0));
+
+    always @(posedge M_AXIS_ACLK)
+    begin
+      if (!M_AXIS_ARESETN)
+        begin
+          packet_sequence <= 32'b0;
+          packet_status <= 8'b0;
+          lost_since_packet <= 1'b0;
+        end
+      else
+        begin
+          if (packet_start) begin
+              packet_status <= {6'b0, trigger_mode, lost_since_packet};
+              lost_since_packet <= sample_dropped;
+          end
+          else if (sample_dropped) begin
+              lost_since_packet <= 1'b1;
+          end
+
+          if (M_AXIS_TVALID && M_AXIS_TLAST) begin
+              packet_sequence <= packet_sequence + 1'b1;
+          end
+        end
+    end
+
+    always @(posedge M_AXIS_ACLK) begin
+        if (snapshot) begin
+            STREAM_OVERRUN <= overrun;
+            STREAM_DROPPED_SAMPLES <= dropped_samples;
+            STREAM_TOTAL_SAMPLES <= sample_count;
+            SNAPSHOT_ACK <= snapshot_request_sync[1];
+        end
+    end
+
+    // The window is presented to the correlator as the last beat of each
+    // sample is transmitted.
+    assign WINDOW_SAMPLE = history_out;
+    assign WINDOW_VALID = (trigger_state == TRIG_LAST_BEAT_STATE);
+    assign WINDOW_LAST = (window_remaining == 0) && (trigger_state == TRIG_LAST_BEAT_STATE);
 
     endmodule
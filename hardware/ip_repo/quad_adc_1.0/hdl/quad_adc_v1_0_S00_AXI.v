@@ -13,12 +13,66 @@
         // Width of S_AXI data bus
         parameter integer C_S_AXI_DATA_WIDTH    = 32,
         // Width of S_AXI address bus
-        parameter integer C_S_AXI_ADDR_WIDTH    = 4
+        parameter integer C_S_AXI_ADDR_WIDTH    = 7
     )
     (
         // Users to add ports here
         output wire [C_S_AXI_DATA_WIDTH-1 : 0] ENCODE_CLK_DIV,
         output wire [C_S_AXI_DATA_WIDTH-1 : 0] SAMPLES_PER_PACKET,
+        output wire [C_S_AXI_DATA_WIDTH-1 : 0] TRIGGER_CONTROL,
+        output wire [C_S_AXI_DATA_WIDTH-1 : 0] TRIGGER_WINDOW,
+        output wire [C_S_AXI_DATA_WIDTH-1 : 0] STREAM_CONTROL,
+        output wire [C_S_AXI_DATA_WIDTH-1 : 0] DECIMATION_CONTROL,
+        output wire [C_S_AXI_DATA_WIDTH-1 : 0] CORRELATOR_CONTROL,
+        output wire [C_S_AXI_DATA_WIDTH-1 : 0] CORRELATOR_INDEX,
+
+        // Correlator status and the result selected by CORRELATOR_INDEX,
+        // which are read back in place of the written registers.
+        input wire [C_S_AXI_DATA_WIDTH-1 : 0] CORRELATOR_STATUS,
+        input wire [C_S_AXI_DATA_WIDTH-1 : 0] CORRELATOR_RESULT,
+
+        // Stream counters. SNAPSHOT_REQUEST and CLEAR_REQUEST toggle to
+        // request a snapshot of the counters or to clear them, and
+        // SNAPSHOT_ACK follows SNAPSHOT_REQUEST once the snapshot is held
+        // still on the counter inputs.
+        output reg SNAPSHOT_REQUEST,
+        output reg CLEAR_REQUEST,
+        input wire SNAPSHOT_ACK,
+        input wire STREAM_OVERRUN,
+        input wire [31 : 0] STREAM_DROPPED_SAMPLES,
+        input wire [63 : 0] STREAM_TOTAL_SAMPLES,
+
+        // Board sync. SYNC_OUTPUT_ENABLE lets this board drive the sync line
+        // and SYNC_FIRE_REQUEST toggles to send a pulse on it. SYNC_SAMPLE
+        // is the sample count latched at the latest sync edge, which holds
+        // still from each toggle of SYNC_TOGGLE until the next.
+        output wire SYNC_OUTPUT_ENABLE,
+        output reg SYNC_FIRE_REQUEST,
+        input wire SYNC_TOGGLE,
+        input wire [63 : 0] SYNC_SAMPLE,
+
+        // External trigger. TRIGGER_IN_SAMPLE is the sample count latched at
+        // the latest edge of the trigger input, which holds still from each
+        // toggle of TRIGGER_IN_TOGGLE until the next. A toggle of
+        // TRIGGER_OUT_REQUEST loads the output window, which holds still
+        // until the next.
+        output wire TRIGGER_IN_INVERT,
+        input wire TRIGGER_IN_TOGGLE,
+        input wire [63 : 0] TRIGGER_IN_SAMPLE,
+        output wire TRIGGER_OUT_FORCE,
+        output reg TRIGGER_OUT_REQUEST,
+        output wire [63 : 0] TRIGGER_OUT_START,
+        output wire [63 : 0] TRIGGER_OUT_END,
+
+        // Envelope side channel. ENVELOPE_POP pulses as the upper word of the
+        // oldest envelope sample is read, to discard it from the FIFO.
+        output wire [C_S_AXI_DATA_WIDTH-1 : 0] ENVELOPE_CONTROL,
+        output wire [15 : 0] ENVELOPE_DECIMATION,
+        input wire [C_S_AXI_DATA_WIDTH-1 : 0] ENVELOPE_STATUS,
+        input wire [15 : 0] ENVELOPE_LEVEL,
+        input wire [63 : 0] ENVELOPE_DATA,
+        input wire [63 : 0] ENVELOPE_START,
+        output reg ENVELOPE_POP,
 
         // User ports ends
         // Do not modify the ports beyond this line
@@ -103,15 +157,27 @@
     // ADDR_LSB = 2 for 32 bits (n downto 2)
     // ADDR_LSB = 3 for 64 bits (n downto 3)
     localparam integer ADDR_LSB = (C_S_AXI_DATA_WIDTH/32) + 1;
-    localparam integer OPT_MEM_ADDR_BITS = 1;
+    localparam integer OPT_MEM_ADDR_BITS = 4;
     //----------------------------------------------
     //-- Signals for user logic register space example
     //------------------------------------------------
-    //-- Number of Slave Registers 4
+    //-- Number of Slave Registers 24
     reg [C_S_AXI_DATA_WIDTH-1:0]    slv_reg0 = DEFAULT_ENCODE_CLK_DIV;
     reg [C_S_AXI_DATA_WIDTH-1:0]    slv_reg1 = DEFAULT_SAMPLES_PER_PACKET;
     reg [C_S_AXI_DATA_WIDTH-1:0]    slv_reg2;
     reg [C_S_AXI_DATA_WIDTH-1:0]    slv_reg3;
+    reg [C_S_AXI_DATA_WIDTH-1:0]    slv_reg4;
+    reg [C_S_AXI_DATA_WIDTH-1:0]    slv_reg5;
+    reg [C_S_AXI_DATA_WIDTH-1:0]    slv_reg6;
+    reg [C_S_AXI_DATA_WIDTH-1:0]    slv_reg7;
+    reg [C_S_AXI_DATA_WIDTH-1:0]    slv_reg12;
+    reg [C_S_AXI_DATA_WIDTH-1:0]    slv_reg16;
+    reg [C_S_AXI_DATA_WIDTH-1:0]    slv_reg20;
+    reg [C_S_AXI_DATA_WIDTH-1:0]    slv_reg21;
+    reg [C_S_AXI_DATA_WIDTH-1:0]    slv_reg22;
+    reg [C_S_AXI_DATA_WIDTH-1:0]    slv_reg23;
+    reg [C_S_AXI_DATA_WIDTH-1:0]    slv_reg24;
+    reg [C_S_AXI_DATA_WIDTH-1:0]    slv_reg25;
     wire     slv_reg_rden;
     wire     slv_reg_wren;
     reg [C_S_AXI_DATA_WIDTH-1:0]     reg_data_out;
@@ -228,44 +294,151 @@
           slv_reg1 <= DEFAULT_SAMPLES_PER_PACKET;
           slv_reg2 <= 0;
           slv_reg3 <= 0;
+          slv_reg4 <= 0;
+          slv_reg5 <= 0;
+          slv_reg6 <= 0;
+          slv_reg7 <= 0;
+          slv_reg12 <= 0;
+          slv_reg16 <= 0;
+          slv_reg20 <= 0;
+          slv_reg21 <= 0;
+          slv_reg22 <= 0;
+          slv_reg23 <= 0;
+          slv_reg24 <= 0;
+          slv_reg25 <= 0;
+          SNAPSHOT_REQUEST <= 1'b0;
+          CLEAR_REQUEST <= 1'b0;
+          SYNC_FIRE_REQUEST <= 1'b0;
+          TRIGGER_OUT_REQUEST <= 1'b0;
         end
       else begin
         if (slv_reg_wren)
           begin
             case ( axi_awaddr[ADDR_LSB+OPT_MEM_ADDR_BITS:ADDR_LSB] )
-              2'h0:
+              4'h0:
                 for ( byte_index = 0; byte_index <= (C_S_AXI_DATA_WIDTH/8)-1; byte_index = byte_index+1 )
                   if ( S_AXI_WSTRB[byte_index] == 1 ) begin
                     // Respective byte enables are asserted as per write strobes
                     // Slave register 0
                     slv_reg0[(byte_index*8) +: 8] <= S_AXI_WDATA[(byte_index*8) +: 8];
                   end
-              2'h1:
+              4'h1:
                 for ( byte_index = 0; byte_index <= (C_S_AXI_DATA_WIDTH/8)-1; byte_index = byte_index+1 )
                   if ( S_AXI_WSTRB[byte_index] == 1 ) begin
                     // Respective byte enables are asserted as per write strobes
                     // Slave register 1
                     slv_reg1[(byte_index*8) +: 8] <= S_AXI_WDATA[(byte_index*8) +: 8];
                   end
-              2'h2:
+              4'h2:
                 for ( byte_index = 0; byte_index <= (C_S_AXI_DATA_WIDTH/8)-1; byte_index = byte_index+1 )
                   if ( S_AXI_WSTRB[byte_index] == 1 ) begin
                     // Respective byte enables are asserted as per write strobes
                     // Slave register 2
                     slv_reg2[(byte_index*8) +: 8] <= S_AXI_WDATA[(byte_index*8) +: 8];
                   end
-              2'h3:
+              4'h3:
                 for ( byte_index = 0; byte_index <= (C_S_AXI_DATA_WIDTH/8)-1; byte_index = byte_index+1 )
                   if ( S_AXI_WSTRB[byte_index] == 1 ) begin
                     // Respective byte enables are asserted as per write strobes
                     // Slave register 3
                     slv_reg3[(byte_index*8) +: 8] <= S_AXI_WDATA[(byte_index*8) +: 8];
                   end
+              4'h4:
+                for ( byte_index = 0; byte_index <= (C_S_AXI_DATA_WIDTH/8)-1; byte_index = byte_index+1 )
+                  if ( S_AXI_WSTRB[byte_index] == 1 ) begin
+                    // Respective byte enables are asserted as per write strobes
+                    // Slave register 4
+                    slv_reg4[(byte_index*8) +: 8] <= S_AXI_WDATA[(byte_index*8) +: 8];
+                  end
+              4'h5:
+                for ( byte_index = 0; byte_index <= (C_S_AXI_DATA_WIDTH/8)-1; byte_index = byte_index+1 )
+                  if ( S_AXI_WSTRB[byte_index] == 1 ) begin
+                    // Respective byte enables are asserted as per write strobes
+                    // Slave register 5
+                    slv_reg5[(byte_index*8) +: 8] <= S_AXI_WDATA[(byte_index*8) +: 8];
+                  end
+              4'h6:
+                for ( byte_index = 0; byte_index <= (C_S_AXI_DATA_WIDTH/8)-1; byte_index = byte_index+1 )
+                  if ( S_AXI_WSTRB[byte_index] == 1 ) begin
+                    // Respective byte enables are asserted as per write strobes
+                    // Slave register 6
+                    slv_reg6[(byte_index*8) +: 8] <= S_AXI_WDATA[(byte_index*8) +: 8];
+                  end
+              4'h7:
+                for ( byte_index = 0; byte_index <= (C_S_AXI_DATA_WIDTH/8)-1; byte_index = byte_index+1 )
+                  if ( S_AXI_WSTRB[byte_index] == 1 ) begin
+                    // Respective byte enables are asserted as per write strobes
+                    // Slave register 7
+                    slv_reg7[(byte_index*8) +: 8] <= S_AXI_WDATA[(byte_index*8) +: 8];
+                  end
+              4'h8:
+                if ( S_AXI_WSTRB[0] == 1 ) begin
+                  // Stream status: writing bit 0 takes a snapshot of the
+                  // stream counters and writing bit 1 clears them.
+                  if (S_AXI_WDATA[0]) begin
+                      SNAPSHOT_REQUEST <= ~SNAPSHOT_REQUEST;
+                  end
+                  if (S_AXI_WDATA[1]) begin
+                      CLEAR_REQUEST <= ~CLEAR_REQUEST;
+                  end
+                end
+              4'hC:
+                // Sync control: [0] drive the sync line, and a write of [1]
+                // sends a pulse on it.
+                if ( S_AXI_WSTRB[0] == 1 ) begin
+                  slv_reg12 <= {31'b0, S_AXI_WDATA[0]};
+                  if (S_AXI_WDATA[1]) begin
+                      SYNC_FIRE_REQUEST <= ~SYNC_FIRE_REQUEST;
+                  end
+                end
+              5'h10:
+                // Trigger control: [0] invert the input, [1] hold the output
+                // high, and a write of [2] loads the output window.
+                if ( S_AXI_WSTRB[0] == 1 ) begin
+                  slv_reg16 <= {30'b0, S_AXI_WDATA[1:0]};
+                  if (S_AXI_WDATA[2]) begin
+                      TRIGGER_OUT_REQUEST <= ~TRIGGER_OUT_REQUEST;
+                  end
+                end
+              5'h14:
+                for ( byte_index = 0; byte_index <= (C_S_AXI_DATA_WIDTH/8)-1; byte_index = byte_index+1 )
+                  if ( S_AXI_WSTRB[byte_index] == 1 ) begin
+                    slv_reg20[(byte_index*8) +: 8] <= S_AXI_WDATA[(byte_index*8) +: 8];
+                  end
+              5'h15:
+                for ( byte_index = 0; byte_index <= (C_S_AXI_DATA_WIDTH/8)-1; byte_index = byte_index+1 )
+                  if ( S_AXI_WSTRB[byte_index] == 1 ) begin
+                    slv_reg21[(byte_index*8) +: 8] <= S_AXI_WDATA[(byte_index*8) +: 8];
+                  end
+              5'h16:
+                for ( byte_index = 0; byte_index <= (C_S_AXI_DATA_WIDTH/8)-1; byte_index = byte_index+1 )
+                  if ( S_AXI_WSTRB[byte_index] == 1 ) begin
+                    slv_reg22[(byte_index*8) +: 8] <= S_AXI_WDATA[(byte_index*8) +: 8];
+                  end
+              5'h17:
+                for ( byte_index = 0; byte_index <= (C_S_AXI_DATA_WIDTH/8)-1; byte_index = byte_index+1 )
+                  if ( S_AXI_WSTRB[byte_index] == 1 ) begin
+                    slv_reg23[(byte_index*8) +: 8] <= S_AXI_WDATA[(byte_index*8) +: 8];
+                  end
+              5'h18:
+                for ( byte_index = 0; byte_index <= (C_S_AXI_DATA_WIDTH/8)-1; byte_index = byte_index+1 )
+                  if ( S_AXI_WSTRB[byte_index] == 1 ) begin
+                    slv_reg24[(byte_index*8) +: 8] <= S_AXI_WDATA[(byte_index*8) +: 8];
+                  end
+              5'h19:
+                for ( byte_index = 0; byte_index <= (C_S_AXI_DATA_WIDTH/8)-1; byte_index = byte_index+1 )
+                  if ( S_AXI_WSTRB[byte_index] == 1 ) begin
+                    slv_reg25[(byte_index*8) +: 8] <= S_AXI_WDATA[(byte_index*8) +: 8];
+                  end
               default : begin
                           slv_reg0 <= slv_reg0;
                           slv_reg1 <= slv_reg1;
                           slv_reg2 <= slv_reg2;
                           slv_reg3 <= slv_reg3;
+                          slv_reg4 <= slv_reg4;
+                          slv_reg5 <= slv_reg5;
+                          slv_reg6 <= slv_reg6;
+                          slv_reg7 <= slv_reg7;
                         end
             endcase
           end
@@ -366,6 +539,58 @@
         end
     end
 
+    // The snapshot is pending until its acknowledgement crosses back from
+    // the stream clock domain.
+    reg [1:0] snapshot_ack_sync = 2'b0;
+    always @( posedge S_AXI_ACLK )
+    begin
+      snapshot_ack_sync <= {snapshot_ack_sync[0], SNAPSHOT_ACK};
+    end
+
+    wire snapshot_pending = (snapshot_ack_sync[1] != SNAPSHOT_REQUEST);
+
+    // Each sync edge is counted, and its latched sample count copied, once
+    // its toggle crosses from the stream clock domain. The latch held still
+    // from the toggle, so the copy is consistent.
+    (* ASYNC_REG = "TRUE" *) reg [2:0] sync_toggle_sync = 3'b0;
+    reg [31:0] sync_count = 32'b0;
+    reg [63:0] sync_sample = 64'b0;
+
+    always @( posedge S_AXI_ACLK )
+    begin
+      sync_toggle_sync <= {sync_toggle_sync[1:0], SYNC_TOGGLE};
+      if ( S_AXI_ARESETN == 1'b0 )
+        begin
+          sync_count <= 32'b0;
+          sync_sample <= 64'b0;
+        end
+      else if (sync_toggle_sync[2] != sync_toggle_sync[1])
+        begin
+          sync_count <= sync_count + 1'b1;
+          sync_sample <= SYNC_SAMPLE;
+        end
+    end
+
+    // Edges of the trigger input are counted and copied the same way.
+    (* ASYNC_REG = "TRUE" *) reg [2:0] trigger_in_toggle_sync = 3'b0;
+    reg [31:0] trigger_in_count = 32'b0;
+    reg [63:0] trigger_in_sample = 64'b0;
+
+    always @( posedge S_AXI_ACLK )
+    begin
+      trigger_in_toggle_sync <= {trigger_in_toggle_sync[1:0], TRIGGER_IN_TOGGLE};
+      if ( S_AXI_ARESETN == 1'b0 )
+        begin
+          trigger_in_count <= 32'b0;
+          trigger_in_sample <= 64'b0;
+        end
+      else if (trigger_in_toggle_sync[2] != trigger_in_toggle_sync[1])
+        begin
+          trigger_in_count <= trigger_in_count + 1'b1;
+          trigger_in_sample <= TRIGGER_IN_SAMPLE;
+        end
+    end
+
     // Implement memory mapped register select and read logic generation
     // Slave register read enable is asserted when valid address is available
     // and the slave is ready to accept the read address.
@@ -374,14 +599,48 @@
     begin
           // Address decoding for reading registers
           case ( axi_araddr[ADDR_LSB+OPT_MEM_ADDR_BITS:ADDR_LSB] )
-            2'h0   : reg_data_out <= slv_reg0;
-            2'h1   : reg_data_out <= slv_reg1;
-            2'h2   : reg_data_out <= slv_reg2;
-            2'h3   : reg_data_out <= slv_reg3;
+            4'h0   : reg_data_out <= slv_reg0;
+            4'h1   : reg_data_out <= slv_reg1;
+            4'h2   : reg_data_out <= slv_reg2;
+            4'h3   : reg_data_out <= slv_reg3;
+            4'h4   : reg_data_out <= slv_reg4;
+            4'h5   : reg_data_out <= slv_reg5;
+            4'h6   : reg_data_out <= {slv_reg6[31], CORRELATOR_STATUS[30:29], slv_reg6[28:0]};
+            4'h7   : reg_data_out <= CORRELATOR_RESULT;
+            4'h8   : reg_data_out <= {29'b0, STREAM_OVERRUN, 1'b0, snapshot_pending};
+            4'h9   : reg_data_out <= STREAM_DROPPED_SAMPLES;
+            4'hA   : reg_data_out <= STREAM_TOTAL_SAMPLES[31:0];
+            4'hB   : reg_data_out <= STREAM_TOTAL_SAMPLES[63:32];
+            4'hC   : reg_data_out <= slv_reg12;
+            4'hD   : reg_data_out <= sync_count;
+            4'hE   : reg_data_out <= sync_sample[31:0];
+            4'hF   : reg_data_out <= sync_sample[63:32];
+            5'h10  : reg_data_out <= slv_reg16;
+            5'h11  : reg_data_out <= trigger_in_count;
+            5'h12  : reg_data_out <= trigger_in_sample[31:0];
+            5'h13  : reg_data_out <= trigger_in_sample[63:32];
+            5'h14  : reg_data_out <= slv_reg20;
+            5'h15  : reg_data_out <= slv_reg21;
+            5'h16  : reg_data_out <= slv_reg22;
+            5'h17  : reg_data_out <= slv_reg23;
+            5'h18  : reg_data_out <= slv_reg24;
+            5'h19  : reg_data_out <= slv_reg25;
+            5'h1A  : reg_data_out <= {ENVELOPE_STATUS[31:16], ENVELOPE_LEVEL};
+            5'h1B  : reg_data_out <= ENVELOPE_DATA[31:0];
+            5'h1C  : reg_data_out <= ENVELOPE_DATA[63:32];
+            5'h1D  : reg_data_out <= ENVELOPE_START[31:0];
+            5'h1E  : reg_data_out <= ENVELOPE_START[63:32];
             default : reg_data_out <= 0;
           endcase
     end
 
+    // Reading the upper word of the envelope sample discards it, so the
+    // lower word must be read first.
+    always @( posedge S_AXI_ACLK )
+    begin
+      ENVELOPE_POP <= slv_reg_rden && (axi_araddr[ADDR_LSB+OPT_MEM_ADDR_BITS:ADDR_LSB] == 5'h1C);
+    end
+
     // Output register or memory read data
     always @( posedge S_AXI_ACLK )
     begin
@@ -404,6 +663,19 @@
     // Add user logic here
     assign ENCODE_CLK_DIV = slv_reg0;
     assign SAMPLES_PER_PACKET = slv_reg1;
+    assign TRIGGER_CONTROL = slv_reg2;
+    assign TRIGGER_WINDOW = slv_reg3;
+    assign STREAM_CONTROL = slv_reg4;
+    assign DECIMATION_CONTROL = slv_reg5;
+    assign CORRELATOR_CONTROL = slv_reg6;
+    assign CORRELATOR_INDEX = slv_reg7;
+    assign SYNC_OUTPUT_ENABLE = slv_reg12[0];
+    assign TRIGGER_IN_INVERT = slv_reg16[0];
+    assign TRIGGER_OUT_FORCE = slv_reg16[1];
+    assign TRIGGER_OUT_START = {slv_reg21, slv_reg20};
+    assign TRIGGER_OUT_END = {slv_reg23, slv_reg22};
+    assign ENVELOPE_CONTROL = slv_reg24;
+    assign ENVELOPE_DECIMATION = slv_reg25[15:0];
 
     // User logic ends
 
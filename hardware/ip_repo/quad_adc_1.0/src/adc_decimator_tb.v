@@ -0,0 +1,58 @@
+`timescale 1ns / 1ps
+module adc_decimator_tb();
+
+    reg CLK;
+    reg RESET_N;
+    reg [13 : 0] SAMPLE_IN;
+    reg SAMPLE_STROBE;
+    reg DECIMATE;
+    reg [2 : 0] RATE_LOG2;
+    reg DC_BLOCK;
+    wire [13 : 0] SAMPLE_OUT;
+    wire SAMPLE_OUT_VALID;
+
+    //declare the unit under test
+    adc_decimator  UUT(
+        .CLK(CLK),
+        .RESET_N(RESET_N),
+        .SAMPLE_IN(SAMPLE_IN),
+        .SAMPLE_STROBE(SAMPLE_STROBE),
+        .DECIMATE(DECIMATE),
+        .RATE_LOG2(RATE_LOG2),
+        .DC_BLOCK(DC_BLOCK),
+        .SAMPLE_OUT(SAMPLE_OUT),
+        .SAMPLE_OUT_VALID(SAMPLE_OUT_VALID)
+            );
+
+// clock signal generation
+initial begin
+    CLK <= 0;
+    forever #5 CLK = ~CLK;
+end
+
+// A 30 kHz tone sampled at 5 Msps on top of a DC offset, decimated by 8.
+integer n;
+real phase;
+initial begin
+    RESET_N <= 0;
+    SAMPLE_IN <= 14'd8192;
+    SAMPLE_STROBE <= 0;
+    DECIMATE <= 0;
+    RATE_LOG2 <= 3'd3;
+    DC_BLOCK <= 1;
+    #20
+    RESET_N <= 1;
+
+    for (n = 0; n < 40000; n = n + 1) begin
+        phase = 6.283185307 * 30000.0 * n / 5000000.0;
+        @(posedge CLK);
+        SAMPLE_IN <= 14'd9000 + $rtoi(2000.0 * $sin(phase));
+        SAMPLE_STROBE <= 1;
+        DECIMATE <= ((n % 8) == 7);
+        @(posedge CLK);
+        SAMPLE_STROBE <= 0;
+        repeat (18) @(posedge CLK);
+    end
+end
+
+endmodule
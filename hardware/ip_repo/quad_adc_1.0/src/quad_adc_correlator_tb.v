@@ -0,0 +1,85 @@
+`timescale 1ns / 1ps
+module quad_adc_correlator_tb();
+
+    reg CLK;
+    reg RESULT_CLK;
+    reg RESET_N;
+    reg [63 : 0] WINDOW_SAMPLE;
+    reg WINDOW_VALID;
+    reg WINDOW_LAST;
+    reg [31 : 0] CORRELATOR_CONTROL;
+    reg [9 : 0] RESULT_INDEX;
+    wire [31 : 0] RESULT_DATA;
+    wire [31 : 0] CORRELATOR_STATUS;
+
+    //declare the unit under test
+    quad_adc_correlator  UUT(
+        .CLK(CLK),
+        .RESET_N(RESET_N),
+        .WINDOW_SAMPLE(WINDOW_SAMPLE),
+        .WINDOW_VALID(WINDOW_VALID),
+        .WINDOW_LAST(WINDOW_LAST),
+        .CORRELATOR_CONTROL(CORRELATOR_CONTROL),
+        .RESULT_CLK(RESULT_CLK),
+        .RESULT_INDEX(RESULT_INDEX),
+        .RESULT_DATA(RESULT_DATA),
+        .CORRELATOR_STATUS(CORRELATOR_STATUS)
+            );
+
+// clock signal generation
+initial begin
+    CLK <= 0;
+    forever #5 CLK = ~CLK;
+end
+
+initial begin
+    RESULT_CLK <= 0;
+    forever #4 RESULT_CLK = ~RESULT_CLK;
+end
+
+// A 30 kHz tone at 5 Msps that reaches channels B, C, and D 3, 7, and -5
+// samples after the reference, correlated over 16 lags each way. The peaks
+// are near lag indices 13, 9, and 21.
+integer n;
+integer lag;
+real phase;
+initial begin
+    RESET_N <= 0;
+    WINDOW_SAMPLE <= 64'b0;
+    WINDOW_VALID <= 0;
+    WINDOW_LAST <= 0;
+    CORRELATOR_CONTROL <= 32'b0;
+    RESULT_INDEX <= 10'b0;
+    #20
+    RESET_N <= 1;
+    CORRELATOR_CONTROL <= 32'h80000000 | (32'd8192 << 8) | 32'd16;
+    repeat (10) @(posedge CLK);
+
+    for (n = 0; n < 1024; n = n + 1) begin
+        @(posedge CLK);
+        phase = 6.283185307 * 30000.0 / 5000000.0;
+        WINDOW_SAMPLE <= {2'b0, 14'd8192 + $rtoi(4000.0 * $sin(phase * (n + 5))),
+                          2'b0, 14'd8192 + $rtoi(4000.0 * $sin(phase * (n - 7))),
+                          2'b0, 14'd8192 + $rtoi(4000.0 * $sin(phase * (n - 3))),
+                          2'b0, 14'd8192 + $rtoi(4000.0 * $sin(phase * n))};
+        WINDOW_VALID <= 1;
+        WINDOW_LAST <= (n == 1023);
+        @(posedge CLK);
+        WINDOW_VALID <= 0;
+        WINDOW_LAST <= 0;
+        repeat (6) @(posedge CLK);
+    end
+
+    wait (CORRELATOR_STATUS[30]);
+
+    for (lag = 0; lag < 32; lag = lag + 1) begin
+        @(posedge RESULT_CLK);
+        RESULT_INDEX <= {lag[7:0], 2'd0};
+        repeat (2) @(posedge RESULT_CLK);
+        $display("%d %d", lag, $signed(RESULT_DATA));
+    end
+
+    CORRELATOR_CONTROL <= 32'b0;
+end
+
+endmodule
@@ -0,0 +1,118 @@
+`timescale 1ns / 1ps
+// Runs the throughput bench over the configurations the firmware uses and the
+// ones at the edge of what the stream sustains, side by side. Compare the
+// reports between revisions of the stream logic or the FIFO depth.
+module quad_adc_throughput_sweep_tb();
+
+    // The normal acquisition rate with a sink that always keeps up.
+    quad_adc_throughput_tb #(
+        .NAME("nominal_5msps"),
+        .FINISH(0)
+    ) nominal_5msps();
+
+    // Five clocks per frame leaves the regenerated frame low for one cycle.
+    quad_adc_throughput_tb #(
+        .NAME("fast_20msps"),
+        .FRAME_PERIOD_NS(50.0),
+        .RUN_SAMPLES(80000),
+        .FINISH(0)
+    ) fast_20msps();
+
+    // Four clocks per frame holds the regenerated frame high, which the state
+    // machine waits to fall before each sample.
+    quad_adc_throughput_tb #(
+        .NAME("fast_25msps"),
+        .FRAME_PERIOD_NS(40.0),
+        .RUN_SAMPLES(100000),
+        .FINISH(0)
+    ) fast_25msps();
+
+    // A 64-bit stream sends one beat per sample.
+    quad_adc_throughput_tb #(
+        .NAME("wide_20msps"),
+        .C_M_AXIS_TDATA_WIDTH(64),
+        .FRAME_PERIOD_NS(50.0),
+        .RUN_SAMPLES(80000),
+        .FINISH(0)
+    ) wide_20msps();
+
+    quad_adc_throughput_tb #(
+        .NAME("packed_20msps"),
+        .C_M_AXIS_TDATA_WIDTH(64),
+        .PACKED(1),
+        .FRAME_PERIOD_NS(50.0),
+        .RUN_SAMPLES(80000),
+        .READY_PERCENT(80),
+        .FIFO_DEPTH(64),
+        .FINISH(0)
+    ) packed_20msps();
+
+    // A sink that is often busy but keeps up on average.
+    quad_adc_throughput_tb #(
+        .NAME("random_ready"),
+        .READY_PERCENT(30),
+        .FIFO_DEPTH(64),
+        .FINISH(0)
+    ) random_ready();
+
+    // Long stalls, as when the DMA waits on a descriptor, overflow a small
+    // FIFO but not a large one.
+    quad_adc_throughput_tb #(
+        .NAME("stall_small_fifo"),
+        .STALL_PERIOD(20000),
+        .STALL_CYCLES(4000),
+        .FIFO_DEPTH(256),
+        .FINISH(0)
+    ) stall_small_fifo();
+
+    quad_adc_throughput_tb #(
+        .NAME("stall_large_fifo"),
+        .STALL_PERIOD(20000),
+        .STALL_CYCLES(4000),
+        .FIFO_DEPTH(512),
+        .FINISH(0)
+    ) stall_large_fifo();
+
+    // No FIFO, so every cycle the sink is not ready loses a beat.
+    quad_adc_throughput_tb #(
+        .NAME("no_fifo"),
+        .FIFO_DEPTH(0),
+        .READY_PERCENT(95),
+        .FINISH(0)
+    ) no_fifo();
+
+    quad_adc_throughput_tb #(
+        .NAME("short_packets"),
+        .SAMPLES_PER_PACKET(64),
+        .READY_PERCENT(50),
+        .FIFO_DEPTH(16),
+        .FINISH(0)
+    ) short_packets();
+
+    quad_adc_throughput_tb #(
+        .NAME("decimate_8"),
+        .DECIMATION_LOG2(3),
+        .DC_BLOCK(1),
+        .RUN_SAMPLES(80000),
+        .READY_PERCENT(10),
+        .FIFO_DEPTH(16),
+        .FINISH(0)
+    ) decimate_8();
+
+    quad_adc_throughput_tb #(
+        .NAME("triggered"),
+        .TRIGGER(1),
+        .READY_PERCENT(50),
+        .FIFO_DEPTH(64),
+        .FINISH(0)
+    ) triggered();
+
+initial begin
+    wait (nominal_5msps.done && fast_20msps.done && fast_25msps.done &&
+          wide_20msps.done && packed_20msps.done && random_ready.done &&
+          stall_small_fifo.done && stall_large_fifo.done && no_fifo.done &&
+          short_packets.done && decimate_8.done && triggered.done);
+    $finish;
+end
+
+endmodule
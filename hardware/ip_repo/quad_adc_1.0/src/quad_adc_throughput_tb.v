@@ -0,0 +1,374 @@
+`timescale 1ns / 1ps
+// Measures the sustained throughput of the decimator and stream state machine
+// into a FIFO drained by a sink that applies backpressure.
+//
+// The stream does not wait for TREADY, so the FIFO stands in for the AXI
+// stream FIFO ahead of the DMA and the sink for the S2MM side of the DMA.
+// TREADY is high while the FIFO has space, and the sink accepts a beat with
+// a random probability and not at all during periodic stalls. A FIFO depth of
+// zero drives TREADY from the sink directly.
+//
+// The ADC channels count up by one each frame, so within a packet of an
+// unpacked and undecimated stream channel A must also count up by one. Each
+// run prints a summary whose lines start with the name of the configuration.
+module quad_adc_throughput_tb #
+(
+    parameter NAME = "default",
+    parameter integer C_M_AXIS_TDATA_WIDTH = 32,
+    parameter integer SAMPLES_PER_PACKET = 1024,
+
+    // The periods of the stream clock and of the ADC frame clock.
+    parameter real AXIS_PERIOD_NS = 10.0,
+    parameter real FRAME_PERIOD_NS = 200.0,
+
+    parameter integer DECIMATION_LOG2 = 0,
+    parameter integer DC_BLOCK = 0,
+    parameter integer TIMESTAMPS = 1,
+    parameter integer PACKED = 0,
+
+    // Triggered windows are re-armed as soon as each one is sent.
+    parameter integer TRIGGER = 0,
+    parameter integer TRIGGER_PRE = 256,
+    parameter integer TRIGGER_POST = 768,
+
+    // The sink accepts a beat with the given probability, and accepts none
+    // for STALL_CYCLES of every STALL_PERIOD cycles.
+    parameter integer FIFO_DEPTH = 512,
+    parameter integer READY_PERCENT = 100,
+    parameter integer STALL_PERIOD = 0,
+    parameter integer STALL_CYCLES = 0,
+    parameter integer SEED = 1,
+
+    // The number of ADC frames generated, the most cycles allowed to drain
+    // the FIFO afterwards, and whether the simulation ends with the run.
+    parameter integer RUN_SAMPLES = 20000,
+    parameter integer DRAIN_CYCLES = 100000,
+    parameter integer FINISH = 1
+)
+();
+
+    localparam integer W = C_M_AXIS_TDATA_WIDTH;
+    localparam integer FIFO_SLOTS = (FIFO_DEPTH > 0)? FIFO_DEPTH : 1;
+    localparam CHECK_SEQUENCE = (PACKED == 0 || W != 64) && DECIMATION_LOG2 == 0 && DC_BLOCK == 0;
+
+    localparam [2:0] RATE_LOG2 = DECIMATION_LOG2;
+    localparam [0:0] DC_BLOCK_BIT = DC_BLOCK;
+    localparam [0:0] TIMESTAMP_BIT = TIMESTAMPS;
+    localparam [0:0] PACKED_BIT = PACKED;
+    localparam [15:0] PRE_SAMPLES = TRIGGER_PRE;
+    localparam [15:0] POST_SAMPLES = TRIGGER_POST;
+
+    // The trigger fires whenever a channel is far from mid-scale, which the
+    // ramp almost always is, so windows are sent back to back.
+    localparam [13:0] TRIGGER_THRESHOLD = 14'd1000;
+    localparam [13:0] TRIGGER_BASELINE = 14'd8192;
+
+    // States of the stream and trigger state machines.
+    localparam [1:0] IDLE_STATE = 2'b00;
+    localparam [1:0] LAST_BEAT_STATE = (W == 64)? 2'b01 : 2'b10;
+    localparam [2:0] TRIG_DISABLED_STATE = 3'b000;
+    localparam [2:0] TRIG_DONE_STATE = 3'b101;
+
+    reg clk;
+    reg resetn;
+    reg frame_clk;
+    reg frame_run;
+
+    reg [31:0] adc_count;
+    wire [13:0] ch_1 = adc_count[13:0];
+    wire [13:0] ch_2 = adc_count[13:0] + 14'h1000;
+    wire [13:0] ch_3 = adc_count[13:0] + 14'h2000;
+    wire [13:0] ch_4 = adc_count[13:0] + 14'h3000;
+
+    wire [13:0] dec_1;
+    wire [13:0] dec_2;
+    wire [13:0] dec_3;
+    wire [13:0] dec_4;
+    wire sample_frame;
+
+    reg trigger_enable;
+    wire [31:0] trigger_control = {trigger_enable, 1'b0, TRIGGER_BASELINE, 2'b0, TRIGGER_THRESHOLD};
+
+    wire m_axis_tvalid;
+    wire [W-1 : 0] m_axis_tdata;
+    wire [(W/8)-1 : 0] m_axis_tstrb;
+    wire m_axis_tlast;
+    wire m_axis_tready;
+
+    quad_adc_decimator dec(
+        .CLK(clk),
+        .RESET_N(resetn),
+        .FRAME_CLK(frame_clk),
+        .CH_1_IN(ch_1),
+        .CH_2_IN(ch_2),
+        .CH_3_IN(ch_3),
+        .CH_4_IN(ch_4),
+        .DECIMATION_CONTROL({23'b0, DC_BLOCK_BIT, 5'b0, RATE_LOG2}),
+        .CH_1_OUT(dec_1),
+        .CH_2_OUT(dec_2),
+        .CH_3_OUT(dec_3),
+        .CH_4_OUT(dec_4),
+        .SAMPLE_FRAME(sample_frame)
+    );
+
+    quad_adc_v1_0_M00_AXIS #(
+        .C_M_AXIS_TDATA_WIDTH(W)
+    ) uut(
+        .CH_A_DATA_IN({2'b0, dec_1}),
+        .CH_B_DATA_IN({2'b0, dec_2}),
+        .CH_C_DATA_IN({2'b0, dec_3}),
+        .CH_D_DATA_IN({2'b0, dec_4}),
+        .SAMPLE_FRAME(sample_frame),
+        .SAMPLES_PER_PACKET(SAMPLES_PER_PACKET),
+        .TRIGGER_CONTROL(trigger_control),
+        .TRIGGER_WINDOW({POST_SAMPLES, PRE_SAMPLES}),
+        .STREAM_CONTROL({30'b0, PACKED_BIT, TIMESTAMP_BIT}),
+        .WINDOW_SAMPLE(),
+        .WINDOW_VALID(),
+        .WINDOW_LAST(),
+        .SNAPSHOT_REQUEST(1'b0),
+        .CLEAR_REQUEST(1'b0),
+        .SNAPSHOT_ACK(),
+        .STREAM_OVERRUN(),
+        .STREAM_DROPPED_SAMPLES(),
+        .STREAM_TOTAL_SAMPLES(),
+        .M_AXIS_ACLK(clk),
+        .M_AXIS_ARESETN(resetn),
+        .M_AXIS_TVALID(m_axis_tvalid),
+        .M_AXIS_TDATA(m_axis_tdata),
+        .M_AXIS_TSTRB(m_axis_tstrb),
+        .M_AXIS_TLAST(m_axis_tlast),
+        .M_AXIS_TREADY(m_axis_tready)
+    );
+
+// clock generation
+initial begin
+    clk <= 0;
+    forever #(AXIS_PERIOD_NS / 2.0) clk = ~clk;
+end
+
+// The frame clock stops low once the run has generated its samples.
+initial begin
+    frame_clk = 0;
+    forever begin
+        #(FRAME_PERIOD_NS / 2.0);
+        frame_clk = (frame_run)? ~frame_clk : 1'b0;
+    end
+end
+
+always @(posedge frame_clk) begin
+    adc_count <= adc_count + 1;
+end
+
+// Re-arm the trigger once each window is sent. The state machine only leaves
+// the done state after it sees the enable cleared.
+always @(posedge clk) begin
+    if (!resetn) begin
+        trigger_enable <= (TRIGGER != 0);
+    end
+    else if (TRIGGER != 0) begin
+        if (trigger_enable && uut.trigger_state == TRIG_DONE_STATE) begin
+            trigger_enable <= 1'b0;
+        end
+        else if (!trigger_enable && uut.trigger_state == TRIG_DISABLED_STATE) begin
+            trigger_enable <= 1'b1;
+        end
+    end
+end
+
+// The sink
+integer seed = SEED;
+integer cycle = 0;
+reg sink_ready = 1'b0;
+
+always @(posedge clk) begin
+    cycle = cycle + 1;
+    if (STALL_PERIOD > 0 && (cycle % STALL_PERIOD) < STALL_CYCLES) begin
+        sink_ready <= 1'b0;
+    end
+    else begin
+        sink_ready <= ($unsigned($random(seed)) % 100) < READY_PERCENT;
+    end
+end
+
+// The FIFO
+reg [W-1 : 0] fifo_data [0 : FIFO_SLOTS-1];
+reg fifo_last [0 : FIFO_SLOTS-1];
+integer fifo_count = 0;
+integer write_index;
+integer read_index;
+
+assign m_axis_tready = (FIFO_DEPTH == 0)? sink_ready : (fifo_count < FIFO_DEPTH);
+
+wire push = m_axis_tvalid && m_axis_tready;
+wire pop = (FIFO_DEPTH == 0)? push : (fifo_count > 0 && sink_ready);
+
+// Statistics
+reg measuring;
+integer run_cycles = 0;
+integer input_samples = 0;
+integer streamed_samples = 0;
+integer offered_beats = 0;
+integer lost_beats = 0;
+integer offered_packets = 0;
+integer lossy_packets = 0;
+integer delivered_beats = 0;
+integer run_delivered_beats = 0;
+integer delivered_packets = 0;
+integer sequence_errors = 0;
+integer max_occupancy = 0;
+real occupancy_sum = 0.0;
+reg packet_lossy = 1'b0;
+
+reg beat_phase = 1'b0;
+reg have_previous = 1'b0;
+reg [13:0] previous_a;
+
+// Checks a beat taken by the sink.
+task consume;
+    input [W-1 : 0] data;
+    input last;
+    begin
+        delivered_beats = delivered_beats + 1;
+        if (measuring) begin
+            run_delivered_beats = run_delivered_beats + 1;
+        end
+
+        if (CHECK_SEQUENCE && (W == 64 || beat_phase == 1'b0)) begin
+            if (have_previous && data[13:0] != previous_a + 1'b1) begin
+                sequence_errors = sequence_errors + 1;
+            end
+            previous_a = data[13:0];
+            have_previous = 1'b1;
+        end
+        beat_phase = (W == 64)? 1'b0 : ~beat_phase;
+
+        if (last) begin
+            delivered_packets = delivered_packets + 1;
+            beat_phase = 1'b0;
+            have_previous = 1'b0;
+        end
+    end
+endtask
+
+always @(posedge clk) begin
+    if (!resetn) begin
+        fifo_count <= 0;
+        write_index = 0;
+        read_index = 0;
+    end
+    else begin
+        if (FIFO_DEPTH == 0) begin
+            if (push) begin
+                consume(m_axis_tdata, m_axis_tlast);
+            end
+        end
+        else begin
+            if (pop) begin
+                consume(fifo_data[read_index], fifo_last[read_index]);
+                read_index = (read_index + 1) % FIFO_SLOTS;
+            end
+            if (push) begin
+                fifo_data[write_index] = m_axis_tdata;
+                fifo_last[write_index] = m_axis_tlast;
+                write_index = (write_index + 1) % FIFO_SLOTS;
+            end
+            fifo_count <= fifo_count + push - pop;
+        end
+    end
+end
+
+always @(posedge clk) begin
+    if (resetn && measuring) begin
+        run_cycles = run_cycles + 1;
+        occupancy_sum = occupancy_sum + fifo_count;
+        if (fifo_count > max_occupancy) begin
+            max_occupancy = fifo_count;
+        end
+
+        if (dec.output_valid[0]) begin
+            input_samples = input_samples + 1;
+        end
+        if (uut.state == LAST_BEAT_STATE) begin
+            streamed_samples = streamed_samples + 1;
+        end
+
+        if (m_axis_tvalid) begin
+            offered_beats = offered_beats + 1;
+            if (!m_axis_tready) begin
+                lost_beats = lost_beats + 1;
+                packet_lossy = 1'b1;
+            end
+            if (m_axis_tlast) begin
+                offered_packets = offered_packets + 1;
+                if (packet_lossy) begin
+                    lossy_packets = lossy_packets + 1;
+                end
+                packet_lossy = 1'b0;
+            end
+        end
+    end
+end
+
+// simulation
+real beats_per_sample;
+real input_rate;
+real streamed_rate;
+real offered_rate;
+real delivered_rate;
+integer drain;
+reg done = 1'b0;
+
+initial begin
+    resetn <= 0;
+    frame_run = 1'b1;
+    measuring = 1'b0;
+    adc_count <= 0;
+    repeat (10) @(posedge clk);
+    resetn <= 1;
+    @(posedge clk);
+    measuring = 1'b1;
+
+    wait (adc_count >= RUN_SAMPLES);
+    @(posedge clk);
+    measuring = 1'b0;
+    frame_run = 1'b0;
+
+    drain = 0;
+    while ((fifo_count != 0 || uut.state != IDLE_STATE || m_axis_tvalid) && drain < DRAIN_CYCLES) begin
+        @(posedge clk);
+        drain = drain + 1;
+    end
+
+    beats_per_sample = (W == 64)? ((PACKED != 0)? 0.75 : 1.0) : 2.0;
+    input_rate = input_samples / (run_cycles * 1.0);
+    streamed_rate = streamed_samples / (run_cycles * 1.0);
+    offered_rate = offered_beats / (beats_per_sample * run_cycles);
+    delivered_rate = run_delivered_beats / (beats_per_sample * run_cycles);
+
+    $display("%0s: %0d-bit stream, %0d samples/packet, %0.1f ns frames, decimation %0d, trigger %0d, packed %0d",
+        NAME, W, SAMPLES_PER_PACKET, FRAME_PERIOD_NS, 1 << DECIMATION_LOG2, TRIGGER, PACKED);
+    $display("%0s: fifo %0d beats, sink ready %0d%%, stalls %0d of every %0d cycles",
+        NAME, FIFO_DEPTH, READY_PERCENT, STALL_CYCLES, STALL_PERIOD);
+    $display("%0s: samples/clock %f input, %f streamed, %f offered, %f delivered",
+        NAME, input_rate, streamed_rate, offered_rate, delivered_rate);
+    $display("%0s: %0d samples skipped by the state machine, %0d dropped at TREADY",
+        NAME, input_samples - streamed_samples, uut.dropped_samples);
+    $display("%0s: beats %0d offered, %0d lost, %0d delivered; packets %0d offered, %0d with loss, %0d delivered",
+        NAME, offered_beats, lost_beats, delivered_beats, offered_packets, lossy_packets, delivered_packets);
+    $display("%0s: fifo occupancy %0d max, %f mean",
+        NAME, max_occupancy, occupancy_sum / run_cycles);
+    if (CHECK_SEQUENCE) begin
+        $display("%0s: %0d samples out of sequence", NAME, sequence_errors);
+    end
+    if (drain >= DRAIN_CYCLES) begin
+        $display("%0s: fifo did not drain within %0d cycles", NAME, DRAIN_CYCLES);
+    end
+
+    done = 1'b1;
+    if (FINISH != 0) begin
+        $finish;
+    end
+end
+
+endmodule
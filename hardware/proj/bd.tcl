@@ -51,6 +51,55 @@ if { $list_projs eq "" } {
 # CHANGE DESIGN NAME HERE
 set design_name design_1
 
+# The PS slave port that the AXI DMA writes samples through. HP0 bypasses the
+# CPU caches, so software must maintain them around every buffer. ACP snoops
+# the caches, and the firmware must then be built with
+# DMA_COHERENCY=DMA_COHERENT. Set dma_port before sourcing this script to
+# override it.
+if { ![info exists dma_port] } {
+   set dma_port HP0
+}
+
+# The width in bits of the sample stream from the quad ADC through the FIFO
+# and the AXI DMA into the PS. At 64 bits each four-channel sample is a
+# single beat, which doubles the sample rate the pipeline sustains over 32
+# bits. The samples land in memory in the same layout at either width. Set
+# stream_width before sourcing this script to override it.
+if { ![info exists stream_width] } {
+   set stream_width 64
+}
+
+# The longest burst, in beats, that the AXI DMA writes samples in. The HP
+# port accepts AXI3 bursts of at most 16 beats, so longer bursts are split
+# by the interconnect, but they reach the port back to back and S2MM issues
+# fewer commands, which keeps it from stalling behind CPU and EMAC traffic to
+# DDR at high sample rates. The firmware must be built with a matching
+# DMA_S2MM_BURST_SIZE. Set s2mm_burst_size before sourcing this script to
+# override it.
+if { ![info exists s2mm_burst_size] } {
+   set s2mm_burst_size 64
+}
+
+# The width in bits of the HP port and its write FIFO, 32 or 64. The firmware
+# reads the width back from the port and expects DMA_HP_DATA_WIDTH. The QoS
+# priority of the port is a PS register rather than a property of the
+# bitstream, and is written by the firmware from DMA_HP_WRITE_QOS. Set
+# hp_data_width before sourcing this script to override it.
+if { ![info exists hp_data_width] } {
+   set hp_data_width 64
+}
+
+# The clock in MHz of the stream path from the read side of the sample FIFO
+# through the AXI DMA and its interconnect into the PS. At 100 MHz the path
+# shares FCLK_CLK0 with the AXI-lite peripherals. Raised to 150 to 200 MHz it
+# runs on FCLK_CLK1 for headroom at higher sample rates and channel counts;
+# the FIFO crosses the samples from the ADC data clock at either rate, the
+# DMA crosses its control registers from FCLK_CLK0, and AXI-lite stays at
+# 100 MHz. Set stream_clk_mhz before sourcing this script to override it.
+if { ![info exists stream_clk_mhz] } {
+   set stream_clk_mhz 100
+}
+
 # If you do not already have an existing IP Integrator design open,
 # you can create a design using the following command:
 #    create_bd_design $design_name
@@ -127,6 +176,15 @@ if { $nRet != 0 } {
 proc create_root_design { parentCell } {
 
   variable script_folder
+  variable dma_port
+  variable stream_width
+  variable s2mm_burst_size
+  variable hp_data_width
+  variable stream_clk_mhz
+
+  # The FIFO holds the same number of bytes at either stream width.
+  set stream_bytes [expr {$stream_width / 8}]
+  set fifo_depth [expr {32768 * 4 / $stream_bytes}]
 
   if { $parentCell eq "" } {
      set parentCell [get_bd_cells /]
@@ -196,18 +254,32 @@ CONFIG.FREQ_HZ {5000000} \
   set miso [ create_bd_port -dir I -type data miso ]
   set mosi [ create_bd_port -dir O -type data mosi ]
   set sck [ create_bd_port -dir O sck ]
+  set sync_in [ create_bd_port -dir I -type data sync_in ]
+  set sync_out [ create_bd_port -dir O -type data sync_out ]
+  set trigger_in [ create_bd_port -dir I -type data trigger_in ]
+  set trigger_out [ create_bd_port -dir O -type data trigger_out ]
 
   # Create instance: axi_dma_0, and set properties
   set axi_dma_0 [ create_bd_cell -type ip -vlnv xilinx.com:ip:axi_dma:7.1 axi_dma_0 ]
   set_property -dict [ list \
 CONFIG.c_include_mm2s {0} \
 CONFIG.c_include_s2mm {1} \
-CONFIG.c_include_sg {0} \
+CONFIG.c_include_sg {1} \
 CONFIG.c_micro_dma {0} \
 CONFIG.c_sg_include_stscntrl_strm {0} \
 CONFIG.c_sg_length_width {23} \
+CONFIG.c_s_axis_s2mm_tdata_width $stream_width \
+CONFIG.c_m_axi_s2mm_data_width $stream_width \
+CONFIG.c_s2mm_burst_size $s2mm_burst_size \
  ] $axi_dma_0
 
+  if { $stream_clk_mhz != 100 } {
+     # The control registers are on FCLK_CLK0 and the data path on FCLK_CLK1.
+     set_property -dict [ list \
+CONFIG.c_prmry_is_aclk_async {1} \
+ ] $axi_dma_0
+  }
+
   # Create instance: axi_quad_spi_0, and set properties
   set axi_quad_spi_0 [ create_bd_cell -type ip -vlnv xilinx.com:ip:axi_quad_spi:3.2 axi_quad_spi_0 ]
   set_property -dict [ list \
@@ -225,14 +297,29 @@ CONFIG.Multiples16 {1} \
   # Create instance: axi_smc, and set properties
   set axi_smc [ create_bd_cell -type ip -vlnv xilinx.com:ip:smartconnect:1.0 axi_smc ]
   set_property -dict [ list \
-CONFIG.NUM_SI {1} \
+CONFIG.NUM_SI {2} \
  ] $axi_smc
 
+  # Create instance: clk_wiz_0, and set properties
+  # The encode clock is divided down from this reference, which the firmware
+  # retunes through the dynamic reconfiguration port to reach fractional
+  # sample rates. It starts at 100 MHz so the default divider gives 5 Msps.
+  set clk_wiz_0 [ create_bd_cell -type ip -vlnv xilinx.com:ip:clk_wiz:5.4 clk_wiz_0 ]
+  set_property -dict [ list \
+CONFIG.USE_DYN_RECONFIG {true} \
+CONFIG.INTERFACE_SELECTION {Enable_AXI} \
+CONFIG.PRIM_SOURCE {Global_buffer} \
+CONFIG.PRIM_IN_FREQ {100.000} \
+CONFIG.CLKOUT1_REQUESTED_OUT_FREQ {100.000} \
+CONFIG.USE_LOCKED {true} \
+CONFIG.USE_RESET {false} \
+ ] $clk_wiz_0
+
   # Create instance: fifo_generator_0, and set properties
   set fifo_generator_0 [ create_bd_cell -type ip -vlnv xilinx.com:ip:fifo_generator:13.1 fifo_generator_0 ]
   set_property -dict [ list \
 CONFIG.Clock_Type_AXI {Independent_Clock} \
-CONFIG.Empty_Threshold_Assert_Value_axis {32765} \
+CONFIG.Empty_Threshold_Assert_Value_axis [expr {$fifo_depth - 3}] \
 CONFIG.Empty_Threshold_Assert_Value_rach {13} \
 CONFIG.Empty_Threshold_Assert_Value_rdch {1021} \
 CONFIG.Empty_Threshold_Assert_Value_wach {13} \
@@ -249,17 +336,17 @@ CONFIG.FIFO_Implementation_wrch {Independent_Clocks_Distributed_RAM} \
 CONFIG.Fifo_Implementation {Independent_Clocks_Block_RAM} \
 CONFIG.Full_Flags_Reset_Value {1} \
 CONFIG.Full_Threshold_Assert_Value {1021} \
-CONFIG.Full_Threshold_Assert_Value_axis {32767} \
+CONFIG.Full_Threshold_Assert_Value_axis [expr {$fifo_depth - 1}] \
 CONFIG.Full_Threshold_Assert_Value_rach {15} \
 CONFIG.Full_Threshold_Assert_Value_wach {15} \
 CONFIG.Full_Threshold_Assert_Value_wrch {15} \
 CONFIG.Full_Threshold_Negate_Value {1020} \
 CONFIG.INTERFACE_TYPE {AXI_STREAM} \
-CONFIG.Input_Depth_axis {32768} \
+CONFIG.Input_Depth_axis $fifo_depth \
 CONFIG.Reset_Type {Asynchronous_Reset} \
-CONFIG.TDATA_NUM_BYTES {4} \
-CONFIG.TKEEP_WIDTH {4} \
-CONFIG.TSTRB_WIDTH {4} \
+CONFIG.TDATA_NUM_BYTES $stream_bytes \
+CONFIG.TKEEP_WIDTH $stream_bytes \
+CONFIG.TSTRB_WIDTH $stream_bytes \
  ] $fifo_generator_0
 
   # Create instance: ila_1, and set properties
@@ -490,9 +577,29 @@ CONFIG.PCW_USB0_RESET_IO {MIO 7} \
 CONFIG.PCW_USB0_USB0_IO {MIO 28 .. 39} \
 CONFIG.PCW_USE_M_AXI_GP0 {1} \
 CONFIG.PCW_USE_M_AXI_GP1 {0} \
+CONFIG.PCW_USE_FABRIC_INTERRUPT {1} \
+CONFIG.PCW_IRQ_F2P_INTR {1} \
 CONFIG.PCW_USE_S_AXI_HP0 {1} \
+CONFIG.PCW_S_AXI_HP0_DATA_WIDTH $hp_data_width \
  ] $processing_system7_0
 
+  if { $dma_port eq "ACP" } {
+     # Drive AxUSER high so that every DMA access is treated as coherent.
+     set_property -dict [ list \
+CONFIG.PCW_USE_S_AXI_HP0 {0} \
+CONFIG.PCW_USE_S_AXI_ACP {1} \
+CONFIG.PCW_USE_DEFAULT_ACP_USER_VAL {1} \
+ ] $processing_system7_0
+  }
+
+  if { $stream_clk_mhz != 100 } {
+     set_property -dict [ list \
+CONFIG.PCW_EN_CLK1_PORT {1} \
+CONFIG.PCW_FCLK_CLK1_BUF {TRUE} \
+CONFIG.PCW_FPGA1_PERIPHERAL_FREQMHZ $stream_clk_mhz \
+ ] $processing_system7_0
+  }
+
   # Create instance: ps7_0_axi_periph, and set properties
   set ps7_0_axi_periph [ create_bd_cell -type ip -vlnv xilinx.com:ip:axi_interconnect:2.1 ps7_0_axi_periph ]
   set_property -dict [ list \
@@ -501,10 +608,19 @@ CONFIG.NUM_MI {5} \
 
   # Create instance: quad_adc_0, and set properties
   set quad_adc_0 [ create_bd_cell -type ip -vlnv user.org:user:quad_adc:1.3 quad_adc_0 ]
+  set_property -dict [ list \
+CONFIG.C_M00_AXIS_TDATA_WIDTH $stream_width \
+ ] $quad_adc_0
 
   # Create instance: rst_ps7_0_100M, and set properties
   set rst_ps7_0_100M [ create_bd_cell -type ip -vlnv xilinx.com:ip:proc_sys_reset:5.0 rst_ps7_0_100M ]
 
+  # Create instance: rst_ps7_0_stream, which resets the interconnect of the
+  # stream clock when it is separate.
+  if { $stream_clk_mhz != 100 } {
+     set rst_ps7_0_stream [ create_bd_cell -type ip -vlnv xilinx.com:ip:proc_sys_reset:5.0 rst_ps7_0_stream ]
+  }
+
   # Create instance: util_ds_buf_0, and set properties
   set util_ds_buf_0 [ create_bd_cell -type ip -vlnv xilinx.com:ip:util_ds_buf:2.1 util_ds_buf_0 ]
 
@@ -560,7 +676,8 @@ CONFIG.VCCINT_ALARM {false} \
 
   # Create interface connections
   connect_bd_intf_net -intf_net axi_dma_0_M_AXI_S2MM [get_bd_intf_pins axi_dma_0/M_AXI_S2MM] [get_bd_intf_pins axi_smc/S00_AXI]
-  connect_bd_intf_net -intf_net axi_smc_M00_AXI [get_bd_intf_pins axi_smc/M00_AXI] [get_bd_intf_pins processing_system7_0/S_AXI_HP0]
+  connect_bd_intf_net -intf_net axi_dma_0_M_AXI_SG [get_bd_intf_pins axi_dma_0/M_AXI_SG] [get_bd_intf_pins axi_smc/S01_AXI]
+  connect_bd_intf_net -intf_net axi_smc_M00_AXI [get_bd_intf_pins axi_smc/M00_AXI] [get_bd_intf_pins processing_system7_0/S_AXI_$dma_port]
   connect_bd_intf_net -intf_net fifo_generator_0_M_AXIS [get_bd_intf_pins axi_dma_0/S_AXIS_S2MM] [get_bd_intf_pins fifo_generator_0/M_AXIS]
 connect_bd_intf_net -intf_net [get_bd_intf_nets fifo_generator_0_M_AXIS] [get_bd_intf_pins fifo_generator_0/M_AXIS] [get_bd_intf_pins ila_1/SLOT_0_AXIS]
   connect_bd_intf_net -intf_net processing_system7_0_DDR [get_bd_intf_ports DDR] [get_bd_intf_pins processing_system7_0/DDR]
@@ -570,6 +687,7 @@ connect_bd_intf_net -intf_net [get_bd_intf_nets fifo_generator_0_M_AXIS] [get_bd
   connect_bd_intf_net -intf_net ps7_0_axi_periph_M01_AXI [get_bd_intf_pins ps7_0_axi_periph/M01_AXI] [get_bd_intf_pins xadc_wiz_0/s_axi_lite]
   connect_bd_intf_net -intf_net ps7_0_axi_periph_M02_AXI [get_bd_intf_pins axi_dma_0/S_AXI_LITE] [get_bd_intf_pins ps7_0_axi_periph/M02_AXI]
   connect_bd_intf_net -intf_net ps7_0_axi_periph_M03_AXI [get_bd_intf_pins ps7_0_axi_periph/M03_AXI] [get_bd_intf_pins quad_adc_0/S00_AXI]
+  connect_bd_intf_net -intf_net ps7_0_axi_periph_M04_AXI [get_bd_intf_pins clk_wiz_0/s_axi_lite] [get_bd_intf_pins ps7_0_axi_periph/M04_AXI]
   connect_bd_intf_net -intf_net quad_adc_0_M00_AXIS [get_bd_intf_pins fifo_generator_0/S_AXIS] [get_bd_intf_pins quad_adc_0/M00_AXIS]
 
   # Create port connections
@@ -582,6 +700,7 @@ connect_bd_intf_net -intf_net [get_bd_intf_nets fifo_generator_0_M_AXIS] [get_bd
   connect_bd_net -net CH_4_A [get_bd_pins quad_adc_0/CH_4_A] [get_bd_pins util_ds_buf_8/IBUF_OUT]
   connect_bd_net -net CH_4_B [get_bd_pins quad_adc_0/CH_4_B] [get_bd_pins util_ds_buf_9/IBUF_OUT]
   connect_bd_net -net DATA_CLK [get_bd_pins fifo_generator_0/s_aclk] [get_bd_pins quad_adc_0/DATA_CLK] [get_bd_pins quad_adc_0/m00_axis_aclk] [get_bd_pins util_ds_buf_0/IBUF_OUT]
+  connect_bd_net -net ENCODE_REF_CLK [get_bd_pins clk_wiz_0/clk_out1] [get_bd_pins quad_adc_0/ENCODE_REF_CLK]
   connect_bd_net -net ENCODE_CLK [get_bd_pins quad_adc_0/ENCODE_CLK] [get_bd_pins util_ds_buf_10/OBUF_IN]
   connect_bd_net -net FRAME_CLK [get_bd_pins quad_adc_0/FRAME_CLK] [get_bd_pins util_ds_buf_1/IBUF_OUT]
   connect_bd_net -net IBUF_DS_N_1_1 [get_bd_ports fr_clk_n] [get_bd_pins util_ds_buf_1/IBUF_DS_N]
@@ -604,21 +723,41 @@ connect_bd_intf_net -intf_net [get_bd_intf_nets fifo_generator_0_M_AXIS] [get_bd
   connect_bd_net -net IBUF_DS_P_7_1 [get_bd_ports in3b_p] [get_bd_pins util_ds_buf_7/IBUF_DS_P]
   connect_bd_net -net IBUF_DS_P_8_1 [get_bd_ports in4a_p] [get_bd_pins util_ds_buf_8/IBUF_DS_P]
   connect_bd_net -net IBUF_DS_P_9_1 [get_bd_ports in4b_p] [get_bd_pins util_ds_buf_9/IBUF_DS_P]
+  connect_bd_net -net axi_dma_0_s2mm_introut [get_bd_pins axi_dma_0/s2mm_introut] [get_bd_pins processing_system7_0/IRQ_F2P]
   connect_bd_net -net axi_quad_spi_0_io0_o [get_bd_ports mosi] [get_bd_pins axi_quad_spi_0/io0_o]
   connect_bd_net -net axi_quad_spi_0_sck_o [get_bd_ports sck] [get_bd_pins axi_quad_spi_0/sck_o]
   connect_bd_net -net axi_quad_spi_0_ss_o [get_bd_ports cs] [get_bd_pins axi_quad_spi_0/ss_o]
   connect_bd_net -net miso_1 [get_bd_ports miso] [get_bd_pins axi_quad_spi_0/io1_i]
-  connect_bd_net -net processing_system7_0_FCLK_CLK0 [get_bd_pins axi_dma_0/m_axi_s2mm_aclk] [get_bd_pins axi_dma_0/s_axi_lite_aclk] [get_bd_pins axi_quad_spi_0/ext_spi_clk] [get_bd_pins axi_quad_spi_0/s_axi_aclk] [get_bd_pins axi_smc/aclk] [get_bd_pins fifo_generator_0/m_aclk] [get_bd_pins ila_1/clk] [get_bd_pins processing_system7_0/FCLK_CLK0] [get_bd_pins processing_system7_0/M_AXI_GP0_ACLK] [get_bd_pins processing_system7_0/S_AXI_HP0_ACLK] [get_bd_pins ps7_0_axi_periph/ACLK] [get_bd_pins ps7_0_axi_periph/M00_ACLK] [get_bd_pins ps7_0_axi_periph/M01_ACLK] [get_bd_pins ps7_0_axi_periph/M02_ACLK] [get_bd_pins ps7_0_axi_periph/M03_ACLK] [get_bd_pins ps7_0_axi_periph/M04_ACLK] [get_bd_pins ps7_0_axi_periph/S00_ACLK] [get_bd_pins quad_adc_0/s00_axi_aclk] [get_bd_pins rst_ps7_0_100M/slowest_sync_clk] [get_bd_pins xadc_wiz_0/s_axi_aclk]
+  # The stream path runs on FCLK_CLK1 when its clock is raised.
+  set stream_clk_pins [list [get_bd_pins axi_dma_0/m_axi_s2mm_aclk] [get_bd_pins axi_dma_0/m_axi_sg_aclk] [get_bd_pins axi_smc/aclk] [get_bd_pins fifo_generator_0/m_aclk] [get_bd_pins ila_1/clk] [get_bd_pins processing_system7_0/S_AXI_${dma_port}_ACLK]]
+  if { $stream_clk_mhz == 100 } {
+     connect_bd_net -net processing_system7_0_FCLK_CLK0 [get_bd_pins axi_dma_0/s_axi_lite_aclk] [get_bd_pins axi_quad_spi_0/ext_spi_clk] [get_bd_pins axi_quad_spi_0/s_axi_aclk] [get_bd_pins clk_wiz_0/clk_in1] [get_bd_pins clk_wiz_0/s_axi_aclk] [get_bd_pins processing_system7_0/FCLK_CLK0] [get_bd_pins processing_system7_0/M_AXI_GP0_ACLK] [get_bd_pins ps7_0_axi_periph/ACLK] [get_bd_pins ps7_0_axi_periph/M00_ACLK] [get_bd_pins ps7_0_axi_periph/M01_ACLK] [get_bd_pins ps7_0_axi_periph/M02_ACLK] [get_bd_pins ps7_0_axi_periph/M03_ACLK] [get_bd_pins ps7_0_axi_periph/M04_ACLK] [get_bd_pins ps7_0_axi_periph/S00_ACLK] [get_bd_pins quad_adc_0/s00_axi_aclk] [get_bd_pins rst_ps7_0_100M/slowest_sync_clk] [get_bd_pins xadc_wiz_0/s_axi_aclk] {*}$stream_clk_pins
+  } else {
+     connect_bd_net -net processing_system7_0_FCLK_CLK0 [get_bd_pins axi_dma_0/s_axi_lite_aclk] [get_bd_pins axi_quad_spi_0/ext_spi_clk] [get_bd_pins axi_quad_spi_0/s_axi_aclk] [get_bd_pins clk_wiz_0/clk_in1] [get_bd_pins clk_wiz_0/s_axi_aclk] [get_bd_pins processing_system7_0/FCLK_CLK0] [get_bd_pins processing_system7_0/M_AXI_GP0_ACLK] [get_bd_pins ps7_0_axi_periph/ACLK] [get_bd_pins ps7_0_axi_periph/M00_ACLK] [get_bd_pins ps7_0_axi_periph/M01_ACLK] [get_bd_pins ps7_0_axi_periph/M02_ACLK] [get_bd_pins ps7_0_axi_periph/M03_ACLK] [get_bd_pins ps7_0_axi_periph/M04_ACLK] [get_bd_pins ps7_0_axi_periph/S00_ACLK] [get_bd_pins quad_adc_0/s00_axi_aclk] [get_bd_pins rst_ps7_0_100M/slowest_sync_clk] [get_bd_pins xadc_wiz_0/s_axi_aclk]
+     connect_bd_net -net processing_system7_0_FCLK_CLK1 [get_bd_pins processing_system7_0/FCLK_CLK1] [get_bd_pins rst_ps7_0_stream/slowest_sync_clk] {*}$stream_clk_pins
+  }
+  connect_bd_net -net quad_adc_0_SYNC_OUT [get_bd_ports sync_out] [get_bd_pins quad_adc_0/SYNC_OUT]
+  connect_bd_net -net sync_in_1 [get_bd_ports sync_in] [get_bd_pins quad_adc_0/SYNC_IN]
+  connect_bd_net -net quad_adc_0_TRIGGER_OUT [get_bd_ports trigger_out] [get_bd_pins quad_adc_0/TRIGGER_OUT]
+  connect_bd_net -net trigger_in_1 [get_bd_ports trigger_in] [get_bd_pins quad_adc_0/TRIGGER_IN]
   connect_bd_net -net processing_system7_0_FCLK_RESET0_N [get_bd_pins processing_system7_0/FCLK_RESET0_N] [get_bd_pins rst_ps7_0_100M/ext_reset_in]
   connect_bd_net -net rst_ps7_0_100M_interconnect_aresetn [get_bd_pins ps7_0_axi_periph/ARESETN] [get_bd_pins rst_ps7_0_100M/interconnect_aresetn]
-  connect_bd_net -net rst_ps7_0_100M_peripheral_aresetn [get_bd_pins axi_dma_0/axi_resetn] [get_bd_pins axi_quad_spi_0/s_axi_aresetn] [get_bd_pins axi_smc/aresetn] [get_bd_pins fifo_generator_0/s_aresetn] [get_bd_pins ps7_0_axi_periph/M00_ARESETN] [get_bd_pins ps7_0_axi_periph/M01_ARESETN] [get_bd_pins ps7_0_axi_periph/M02_ARESETN] [get_bd_pins ps7_0_axi_periph/M03_ARESETN] [get_bd_pins ps7_0_axi_periph/M04_ARESETN] [get_bd_pins ps7_0_axi_periph/S00_ARESETN] [get_bd_pins quad_adc_0/m00_axis_aresetn] [get_bd_pins quad_adc_0/s00_axi_aresetn] [get_bd_pins rst_ps7_0_100M/peripheral_aresetn] [get_bd_pins xadc_wiz_0/s_axi_aresetn]
+  if { $stream_clk_mhz == 100 } {
+     connect_bd_net -net rst_ps7_0_100M_peripheral_aresetn [get_bd_pins axi_dma_0/axi_resetn] [get_bd_pins axi_quad_spi_0/s_axi_aresetn] [get_bd_pins axi_smc/aresetn] [get_bd_pins clk_wiz_0/s_axi_aresetn] [get_bd_pins fifo_generator_0/s_aresetn] [get_bd_pins ps7_0_axi_periph/M00_ARESETN] [get_bd_pins ps7_0_axi_periph/M01_ARESETN] [get_bd_pins ps7_0_axi_periph/M02_ARESETN] [get_bd_pins ps7_0_axi_periph/M03_ARESETN] [get_bd_pins ps7_0_axi_periph/M04_ARESETN] [get_bd_pins ps7_0_axi_periph/S00_ARESETN] [get_bd_pins quad_adc_0/m00_axis_aresetn] [get_bd_pins quad_adc_0/s00_axi_aresetn] [get_bd_pins rst_ps7_0_100M/peripheral_aresetn] [get_bd_pins xadc_wiz_0/s_axi_aresetn]
+  } else {
+     connect_bd_net -net rst_ps7_0_100M_peripheral_aresetn [get_bd_pins axi_dma_0/axi_resetn] [get_bd_pins axi_quad_spi_0/s_axi_aresetn] [get_bd_pins clk_wiz_0/s_axi_aresetn] [get_bd_pins fifo_generator_0/s_aresetn] [get_bd_pins ps7_0_axi_periph/M00_ARESETN] [get_bd_pins ps7_0_axi_periph/M01_ARESETN] [get_bd_pins ps7_0_axi_periph/M02_ARESETN] [get_bd_pins ps7_0_axi_periph/M03_ARESETN] [get_bd_pins ps7_0_axi_periph/M04_ARESETN] [get_bd_pins ps7_0_axi_periph/S00_ARESETN] [get_bd_pins quad_adc_0/m00_axis_aresetn] [get_bd_pins quad_adc_0/s00_axi_aresetn] [get_bd_pins rst_ps7_0_100M/peripheral_aresetn] [get_bd_pins xadc_wiz_0/s_axi_aresetn]
+     connect_bd_net -net [get_bd_nets processing_system7_0_FCLK_RESET0_N] [get_bd_pins processing_system7_0/FCLK_RESET0_N] [get_bd_pins rst_ps7_0_stream/ext_reset_in]
+     connect_bd_net -net rst_ps7_0_stream_interconnect_aresetn [get_bd_pins axi_smc/aresetn] [get_bd_pins rst_ps7_0_stream/interconnect_aresetn]
+  }
   connect_bd_net -net util_ds_buf_10_OBUF_DS_N [get_bd_ports enc_n] [get_bd_pins util_ds_buf_10/OBUF_DS_N]
   connect_bd_net -net util_ds_buf_10_OBUF_DS_P [get_bd_ports enc_p] [get_bd_pins util_ds_buf_10/OBUF_DS_P]
 
   # Create address segments
-  create_bd_addr_seg -range 0x40000000 -offset 0x00000000 [get_bd_addr_spaces axi_dma_0/Data_S2MM] [get_bd_addr_segs processing_system7_0/S_AXI_HP0/HP0_DDR_LOWOCM] SEG_processing_system7_0_HP0_DDR_LOWOCM
+  create_bd_addr_seg -range 0x40000000 -offset 0x00000000 [get_bd_addr_spaces axi_dma_0/Data_S2MM] [get_bd_addr_segs processing_system7_0/S_AXI_$dma_port/${dma_port}_DDR_LOWOCM] SEG_processing_system7_0_HP0_DDR_LOWOCM
+  create_bd_addr_seg -range 0x40000000 -offset 0x00000000 [get_bd_addr_spaces axi_dma_0/Data_SG] [get_bd_addr_segs processing_system7_0/S_AXI_$dma_port/${dma_port}_DDR_LOWOCM] SEG_processing_system7_0_HP0_DDR_LOWOCM_SG
   create_bd_addr_seg -range 0x00010000 -offset 0x40400000 [get_bd_addr_spaces processing_system7_0/Data] [get_bd_addr_segs axi_dma_0/S_AXI_LITE/Reg] SEG_axi_dma_0_Reg
   create_bd_addr_seg -range 0x00010000 -offset 0x41E00000 [get_bd_addr_spaces processing_system7_0/Data] [get_bd_addr_segs axi_quad_spi_0/AXI_LITE/Reg] SEG_axi_quad_spi_0_Reg
+  create_bd_addr_seg -range 0x00010000 -offset 0x43C20000 [get_bd_addr_spaces processing_system7_0/Data] [get_bd_addr_segs clk_wiz_0/s_axi_lite/Reg] SEG_clk_wiz_0_Reg
   create_bd_addr_seg -range 0x00010000 -offset 0x43C10000 [get_bd_addr_spaces processing_system7_0/Data] [get_bd_addr_segs quad_adc_0/S00_AXI/S00_AXI_reg] SEG_quad_adc_0_S00_AXI_reg
   create_bd_addr_seg -range 0x00010000 -offset 0x43C00000 [get_bd_addr_spaces processing_system7_0/Data] [get_bd_addr_segs xadc_wiz_0/s_axi_lite/Reg] SEG_xadc_wiz_0_Reg
 
@@ -0,0 +1,1021 @@
+/*
+ * Bridges the HydroZynq to ROS.
+ *
+ * One event loop waits on the result, correlation, and silence request
+ * sockets and on a timer for the thruster silence window, replacing
+ * result_transmitter.py, correlation_receiver.py, and silence.py. The board
+ * clock is synchronized as time_sync.py does, so that silence windows and
+ * result stamps are absolute.
+ *
+ * Parameters:
+ *   ~hostname                   The host address to bind to.
+ *   ~multicast                  A multicast group to receive the result and
+ *                               correlation streams from, or empty.
+ *   ~publish_correlation_deltas Publishes the delays of the correlation
+ *                               stream in place of the result stream.
+ *   ~publish_tracked_deltas     Publishes the delays filtered by the board
+ *                               once its tracker is locked, and drops the
+ *                               pings it rejects as outliers.
+ *   ~sampling_frequency         The sample rate of the correlations in Hz.
+ *   ~hydrozynq                  The HydroZynq address to synchronize with.
+ */
+#include "ros/ros.h"
+#include "robosub/HydrophoneDeltas.h"
+#include "std_srvs/SetBool.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/**
+ * The ports of the HydroZynq streams. These must match system_params.h.
+ */
+static const uint16_t RESULT_PORT = 3002;
+static const uint16_t XCORR_PORT = 3003;
+static const uint16_t SILENT_REQUEST_PORT = 3005;
+static const uint16_t COMMAND_PORT = 3000;
+
+/**
+ * The binary command header fields of clock synchronization. These must
+ * match command_protocol.h.
+ */
+static const uint16_t COMMAND_MAGIC = 0xC0DE;
+static const uint8_t COMMAND_VERSION = 1;
+static const uint8_t COMMAND_TIME_SYNC = 3;
+static const uint8_t COMMAND_TIME_SYNC_REPLY = 4;
+
+/**
+ * The interval between clock synchronization requests and the number of
+ * recent exchanges from which the one with the shortest round trip is used.
+ */
+static const int TIME_SYNC_PERIOD_MS = 1000;
+static const size_t TIME_SYNC_SAMPLES = 8;
+
+/**
+ * The version of the result record. This must match RESULT_RECORD_VERSION.
+ */
+static const uint16_t RESULT_RECORD_VERSION = 8;
+
+/**
+ * The time without correlation datagrams after which a partial transfer is
+ * published.
+ */
+static const int XCORR_IDLE_TIMEOUT_MS = 100;
+
+/**
+ * Defines the result record sent for each ping. It must match
+ * result_record_t in transmission_util.h.
+ */
+struct __attribute__((packed)) result_record_t
+{
+    uint16_t version;
+    uint16_t length;
+    uint32_t sequence;
+    uint32_t frequency;
+    uint64_t timestamp_us;
+    int32_t channel_delay_ns[3];
+    int16_t peak_amplitude[4];
+    float confidence[3];
+    uint32_t filter_duration_us;
+    uint32_t correlation_duration_us;
+    float bearing_deg;
+    float elevation_deg;
+    float direction_norm;
+    float quality;
+    int32_t averaged_delay_ns[3];
+    float averaged_confidence[3];
+    uint32_t averaged_pings;
+    uint64_t trigger_sample;
+    uint64_t trigger_timestamp_us;
+    uint32_t trigger_count;
+    float tracked_delay_ns[3];
+    float tracked_delay_rate_ns_per_s[3];
+    float tracked_delay_variance_ns2[3];
+    float tracked_bearing_deg;
+    float tracked_elevation_deg;
+    uint16_t track_flags;
+    uint16_t track_outliers;
+    uint32_t capture_latency_us;
+    uint32_t window_latency_us;
+    uint32_t process_latency_us;
+    uint32_t solve_latency_us;
+    uint32_t queue_latency_us;
+    uint32_t delay_source;
+    float edge_uncertainty_ns;
+};
+
+/**
+ * The marker that begins a datagram of batched messages, and the type of a
+ * batched result record. These must match stream_format.h.
+ */
+static const uint16_t MESSAGE_BATCH_MARKER = 0xBA7C;
+static const uint16_t MESSAGE_RESULT = 1;
+
+/**
+ * Defines the header of a datagram of batched messages and of each message
+ * in it. They must match message_batch_header_t and message_header_t in
+ * stream_format.h.
+ */
+struct __attribute__((packed)) message_batch_header_t
+{
+    uint16_t marker;
+    uint16_t count;
+};
+
+struct __attribute__((packed)) message_header_t
+{
+    uint16_t type;
+    uint16_t length;
+};
+
+/**
+ * The flags of the bearing tracker estimate. These must match
+ * BEARING_TRACK_LOCKED and BEARING_TRACK_OUTLIER in types.h.
+ */
+static const uint16_t BEARING_TRACK_LOCKED = 1 << 0;
+static const uint16_t BEARING_TRACK_OUTLIER = 1 << 1;
+
+/**
+ * Defines the header of every streamed datagram. It must match
+ * stream_header_t in transmission_util.h.
+ */
+struct __attribute__((packed)) stream_header_t
+{
+    int32_t packet_number;
+    uint32_t first_element;
+    uint16_t element_size;
+    uint16_t element_count;
+    uint16_t encoding;
+    uint16_t transfer_id;
+    uint32_t total_elements;
+};
+
+/**
+ * Defines a correlation at one shift. It must match correlation_t in types.h.
+ */
+struct __attribute__((packed)) correlation_t
+{
+    int32_t left_shift;
+    int32_t result[3];
+};
+
+/**
+ * Defines the silence request sent ahead of each ping. It must match
+ * silence_request_t in transmission_util.h.
+ */
+struct __attribute__((packed)) silence_request_t
+{
+    int32_t when_ms;
+    int32_t duration_ms;
+    uint64_t start_us;
+    uint32_t duration_us;
+};
+
+/**
+ * Defines a clock synchronization datagram. It must match command_header_t
+ * followed by command_time_sync_t in command_protocol.h.
+ */
+struct __attribute__((packed)) time_sync_t
+{
+    uint16_t magic;
+    uint8_t version;
+    uint8_t type;
+    uint32_t sequence;
+    uint32_t param_set_version;
+    uint16_t status;
+    uint16_t error_param;
+    uint16_t length;
+    uint16_t reserved;
+    uint64_t host_transmit_ns;
+    uint64_t board_receive_us;
+    uint64_t board_transmit_us;
+};
+
+/**
+ * Defines one clock synchronization exchange.
+ */
+struct time_sync_sample_t
+{
+    double offset;
+    double round_trip;
+};
+
+/**
+ * Defines the reassembly state of a correlation transfer.
+ */
+struct xcorr_transfer_t
+{
+    bool active;
+    uint16_t transfer_id;
+    std::vector<correlation_t> correlations;
+    std::vector<bool> filled;
+    std::vector<bool> packets;
+    size_t received;
+};
+
+/**
+ * Defines the state of the thruster silence window.
+ */
+enum silence_state_t
+{
+    SILENCE_IDLE,
+    SILENCE_PENDING,
+    SILENCE_ACTIVE
+};
+
+class HydroZynqBridge
+{
+public:
+    HydroZynqBridge(ros::NodeHandle &node, ros::NodeHandle &private_node);
+    ~HydroZynqBridge();
+
+    bool open();
+    void run();
+
+private:
+    int open_socket(const uint16_t port, const bool multicast);
+    bool add_to_loop(const int fd);
+    void arm_timer(const int fd, const double seconds);
+
+    void receive_result();
+    void publish_result(const uint8_t *data, const size_t len);
+    void receive_xcorr();
+    void receive_silence_request();
+    void service_silence_timer();
+    void finish_xcorr();
+    void publish_deltas(const ros::Time &stamp, const double x, const double y, const double z);
+
+    void send_time_sync();
+    void receive_time_sync();
+    bool board_to_host(const uint64_t board_us, double *host) const;
+
+    ros::NodeHandle &node;
+    ros::Publisher delta_pub;
+    ros::ServiceClient silence_client;
+
+    std::string hostname;
+    std::string multicast;
+    bool publish_correlation_deltas;
+    bool publish_tracked_deltas;
+    int sampling_frequency;
+
+    int epoll_fd;
+    int result_fd;
+    int xcorr_fd;
+    int silence_fd;
+    int silence_timer_fd;
+    int xcorr_timer_fd;
+    int sync_fd;
+    int sync_timer_fd;
+
+    std::string hydrozynq;
+    uint32_t sync_sequence;
+    std::vector<time_sync_sample_t> sync_samples;
+    size_t next_sync_sample;
+
+    silence_state_t silence_state;
+    double silence_duration;
+
+    xcorr_transfer_t xcorr;
+    uint64_t xcorr_lost;
+    uint64_t malformed;
+
+    uint8_t buffer[65536];
+};
+
+HydroZynqBridge::HydroZynqBridge(ros::NodeHandle &node, ros::NodeHandle &private_node) :
+    node(node),
+    epoll_fd(-1),
+    result_fd(-1),
+    xcorr_fd(-1),
+    silence_fd(-1),
+    silence_timer_fd(-1),
+    xcorr_timer_fd(-1),
+    sync_fd(-1),
+    sync_timer_fd(-1),
+    sync_sequence(0),
+    next_sync_sample(0),
+    silence_state(SILENCE_IDLE),
+    silence_duration(0),
+    xcorr_lost(0),
+    malformed(0)
+{
+    private_node.param<std::string>("hostname", hostname, "192.168.0.2");
+    private_node.param<std::string>("multicast", multicast, "");
+    private_node.param("publish_correlation_deltas", publish_correlation_deltas, false);
+    private_node.param("publish_tracked_deltas", publish_tracked_deltas, false);
+    private_node.param("sampling_frequency", sampling_frequency, 5000000);
+    private_node.param<std::string>("hydrozynq", hydrozynq, "192.168.0.7");
+
+    delta_pub = node.advertise<robosub::HydrophoneDeltas>("hydrophones/30khz/delta", 1);
+    silence_client = node.serviceClient<std_srvs::SetBool>("control/silence", true);
+
+    xcorr.active = false;
+    xcorr.transfer_id = 0;
+    xcorr.received = 0;
+}
+
+HydroZynqBridge::~HydroZynqBridge()
+{
+    const int fds[] = {result_fd, xcorr_fd, silence_fd, silence_timer_fd, xcorr_timer_fd,
+                       sync_fd, sync_timer_fd, epoll_fd};
+    for (const int fd : fds)
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+}
+
+/**
+ * Opens a socket that receives a HydroZynq stream.
+ *
+ * @param port The port to bind to.
+ * @param multicast Specified true if the stream may be received from the
+ *        multicast group.
+ *
+ * @return The socket, or -1 on failure.
+ */
+int HydroZynqBridge::open_socket(const uint16_t port, const bool multicast)
+{
+    const int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    const int receive_buffer = 4 * 1024 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &receive_buffer, sizeof(receive_buffer));
+
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+
+    const bool join = multicast && !this->multicast.empty();
+    if (join)
+    {
+        const int reuse = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+    }
+    else if (inet_pton(AF_INET, hostname.c_str(), &address.sin_addr) != 1)
+    {
+        ROS_ERROR("Invalid hostname %s", hostname.c_str());
+        close(fd);
+        return -1;
+    }
+
+    if (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0)
+    {
+        ROS_ERROR("Failed to bind port %u: %s", port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    if (join)
+    {
+        ip_mreq membership;
+        if (inet_pton(AF_INET, this->multicast.c_str(), &membership.imr_multiaddr) != 1 ||
+            inet_pton(AF_INET, hostname.c_str(), &membership.imr_interface) != 1 ||
+            setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) != 0)
+        {
+            ROS_ERROR("Failed to join multicast group %s", this->multicast.c_str());
+            close(fd);
+            return -1;
+        }
+    }
+
+    return fd;
+}
+
+/**
+ * Adds a descriptor to the event loop.
+ *
+ * @param fd The descriptor to wait on.
+ *
+ * @return True on success.
+ */
+bool HydroZynqBridge::add_to_loop(const int fd)
+{
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+
+    return (fd >= 0 && epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == 0)? true : false;
+}
+
+/**
+ * Arms a one shot timer.
+ *
+ * @param fd The timer.
+ * @param seconds The time until the timer expires, or a negative time to
+ *        disarm it.
+ *
+ * @return None.
+ */
+void HydroZynqBridge::arm_timer(const int fd, const double seconds)
+{
+    itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    if (seconds > 0)
+    {
+        spec.it_value.tv_sec = static_cast<time_t>(seconds);
+        spec.it_value.tv_nsec = static_cast<long>((seconds - spec.it_value.tv_sec) * 1e9);
+
+    }
+
+    /*
+     * A zero value disarms the timer, so a due timer fires immediately.
+     */
+    if (seconds >= 0 && spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0)
+    {
+        spec.it_value.tv_nsec = 1;
+    }
+
+    timerfd_settime(fd, 0, &spec, NULL);
+}
+
+/**
+ * Opens every socket and timer.
+ *
+ * @return True on success.
+ */
+bool HydroZynqBridge::open()
+{
+    epoll_fd = epoll_create1(0);
+    result_fd = open_socket(RESULT_PORT, true);
+    xcorr_fd = open_socket(XCORR_PORT, true);
+    silence_fd = open_socket(SILENT_REQUEST_PORT, false);
+    silence_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    xcorr_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    sync_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    sync_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+
+    if (sync_timer_fd >= 0)
+    {
+        itimerspec spec;
+        spec.it_interval.tv_sec = TIME_SYNC_PERIOD_MS / 1000;
+        spec.it_interval.tv_nsec = (TIME_SYNC_PERIOD_MS % 1000) * 1000000;
+        spec.it_value.tv_sec = 0;
+        spec.it_value.tv_nsec = 1;
+        timerfd_settime(sync_timer_fd, 0, &spec, NULL);
+    }
+
+    return (epoll_fd >= 0 &&
+            add_to_loop(result_fd) &&
+            add_to_loop(xcorr_fd) &&
+            add_to_loop(silence_fd) &&
+            add_to_loop(silence_timer_fd) &&
+            add_to_loop(xcorr_timer_fd) &&
+            add_to_loop(sync_fd) &&
+            add_to_loop(sync_timer_fd))? true : false;
+}
+
+/**
+ * Reads the host clock that board times are converted to.
+ *
+ * @return The time in seconds since the epoch.
+ */
+static double host_time()
+{
+    timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/**
+ * Sends a clock synchronization request to the HydroZynq.
+ *
+ * @return None.
+ */
+void HydroZynqBridge::send_time_sync()
+{
+    sockaddr_in board;
+    memset(&board, 0, sizeof(board));
+    board.sin_family = AF_INET;
+    board.sin_port = htons(COMMAND_PORT);
+    if (inet_pton(AF_INET, hydrozynq.c_str(), &board.sin_addr) != 1)
+    {
+        ROS_WARN_THROTTLE(10, "Invalid HydroZynq address %s", hydrozynq.c_str());
+        return;
+    }
+
+    time_sync_t request;
+    memset(&request, 0, sizeof(request));
+    request.magic = COMMAND_MAGIC;
+    request.version = COMMAND_VERSION;
+    request.type = COMMAND_TIME_SYNC;
+    request.sequence = ++sync_sequence;
+    request.length = 3 * sizeof(uint64_t);
+    request.host_transmit_ns = static_cast<uint64_t>(host_time() * 1e9);
+
+    sendto(sync_fd, &request, sizeof(request), 0, reinterpret_cast<sockaddr *>(&board), sizeof(board));
+}
+
+/**
+ * Records the offset of every clock synchronization reply that has arrived.
+ *
+ * @return None.
+ */
+void HydroZynqBridge::receive_time_sync()
+{
+    ssize_t len;
+    while ((len = recv(sync_fd, buffer, sizeof(buffer), 0)) >= 0)
+    {
+        const double t4 = host_time();
+        time_sync_t reply;
+        if (static_cast<size_t>(len) < sizeof(reply))
+        {
+            continue;
+        }
+
+        memcpy(&reply, buffer, sizeof(reply));
+        if (reply.magic != COMMAND_MAGIC || reply.type != COMMAND_TIME_SYNC_REPLY ||
+            reply.sequence != sync_sequence)
+        {
+            continue;
+        }
+
+        const double t1 = reply.host_transmit_ns / 1e9;
+        const double t2 = reply.board_receive_us / 1e6;
+        const double t3 = reply.board_transmit_us / 1e6;
+
+        time_sync_sample_t sample;
+        sample.offset = ((t1 - t2) + (t4 - t3)) / 2;
+        sample.round_trip = (t4 - t1) - (t3 - t2);
+        if (sync_samples.size() < TIME_SYNC_SAMPLES)
+        {
+            sync_samples.push_back(sample);
+        }
+        else
+        {
+            sync_samples[next_sync_sample] = sample;
+            next_sync_sample = (next_sync_sample + 1) % TIME_SYNC_SAMPLES;
+        }
+    }
+}
+
+/**
+ * Converts a board time to host time.
+ *
+ * @param board_us The board time in microseconds since boot.
+ * @param[out] host The host time in seconds since the epoch.
+ *
+ * @return True if the clocks are synchronized.
+ */
+bool HydroZynqBridge::board_to_host(const uint64_t board_us, double *host) const
+{
+    if (sync_samples.empty())
+    {
+        return false;
+    }
+
+    /*
+     * The exchange with the shortest round trip was delayed least, so its
+     * offset is the most accurate.
+     */
+    const time_sync_sample_t *best = &sync_samples[0];
+    for (const time_sync_sample_t &sample : sync_samples)
+    {
+        if (sample.round_trip < best->round_trip)
+        {
+            best = &sample;
+        }
+    }
+
+    *host = board_us / 1e6 + best->offset;
+
+    return true;
+}
+
+/**
+ * Publishes the delays of a ping.
+ *
+ * @param stamp The time of the ping.
+ * @param x The delay of the first channel pair.
+ * @param y The delay of the second channel pair.
+ * @param z The delay of the third channel pair.
+ *
+ * @return None.
+ */
+void HydroZynqBridge::publish_deltas(const ros::Time &stamp, const double x, const double y, const double z)
+{
+    robosub::HydrophoneDeltas msg;
+    msg.header.stamp = stamp;
+    msg.header.frame_id = "hydrophone_array";
+    msg.xDelta = ros::Duration(x);
+    msg.yDelta = ros::Duration(y);
+    msg.zDelta = ros::Duration(z);
+
+    delta_pub.publish(msg);
+}
+
+/**
+ * Publishes every result record that has arrived, which may be batched
+ * several to a datagram.
+ *
+ * @return None.
+ */
+void HydroZynqBridge::receive_result()
+{
+    ssize_t len;
+    while ((len = recv(result_fd, buffer, sizeof(buffer), 0)) >= 0)
+    {
+        message_batch_header_t batch;
+        if (static_cast<size_t>(len) < sizeof(batch))
+        {
+            malformed++;
+            continue;
+        }
+
+        memcpy(&batch, buffer, sizeof(batch));
+        if (batch.marker != MESSAGE_BATCH_MARKER)
+        {
+            publish_result(buffer, len);
+            continue;
+        }
+
+        size_t offset = sizeof(batch);
+        for (uint16_t i = 0; i < batch.count; ++i)
+        {
+            message_header_t header;
+            if (offset + sizeof(header) > static_cast<size_t>(len))
+            {
+                malformed++;
+                break;
+            }
+
+            memcpy(&header, &buffer[offset], sizeof(header));
+            offset += sizeof(header);
+            if (offset + header.length > static_cast<size_t>(len))
+            {
+                malformed++;
+                break;
+            }
+
+            if (header.type == MESSAGE_RESULT)
+            {
+                publish_result(&buffer[offset], header.length);
+            }
+            offset += header.length;
+        }
+    }
+}
+
+/**
+ * Publishes a result record.
+ *
+ * @param data The record.
+ * @param len The length of the record.
+ *
+ * @return None.
+ */
+void HydroZynqBridge::publish_result(const uint8_t *data, const size_t len)
+{
+    result_record_t record;
+    if (len < sizeof(record))
+    {
+        malformed++;
+        return;
+    }
+
+    memcpy(&record, data, sizeof(record));
+    if (record.version != RESULT_RECORD_VERSION || record.length != sizeof(record))
+    {
+        ROS_WARN_THROTTLE(1, "Received invalid HydroZynq result record");
+        malformed++;
+        return;
+    }
+
+    /*
+     * Results for additional pingers of the filter bank are not
+     * published on the primary pinger topic.
+     */
+    if (record.frequency != 0 || publish_correlation_deltas)
+    {
+        return;
+    }
+
+    if (record.direction_norm > 0)
+    {
+        ROS_DEBUG("Bearing: %.1f deg, elevation: %.1f deg", record.bearing_deg, record.elevation_deg);
+    }
+
+    /*
+     * The delays are published in the same units as
+     * result_transmitter.py.
+     */
+    double arrival;
+    const ros::Time stamp = (board_to_host(record.timestamp_us, &arrival))? ros::Time(arrival) : ros::Time::now();
+    if (record.queue_latency_us)
+    {
+        ROS_DEBUG("Ping %u published %.1f ms after it arrived (%.1f ms on the board)",
+                  record.sequence,
+                  (ros::Time::now() - stamp).toSec() * 1e3,
+                  record.queue_latency_us / 1e3);
+    }
+    if (publish_tracked_deltas && (record.track_flags & BEARING_TRACK_LOCKED))
+    {
+        if (record.track_flags & BEARING_TRACK_OUTLIER)
+        {
+            ROS_DEBUG("Dropped a ping the tracker rejected (%u consecutive)", record.track_outliers);
+            return;
+        }
+
+        publish_deltas(stamp, record.tracked_delay_ns[0], record.tracked_delay_ns[1], record.tracked_delay_ns[2]);
+        return;
+    }
+
+    publish_deltas(stamp, record.channel_delay_ns[0], record.channel_delay_ns[1], record.channel_delay_ns[2]);
+}
+
+/**
+ * Publishes the delays of the correlation transfer being reassembled.
+ *
+ * @return None.
+ */
+void HydroZynqBridge::finish_xcorr()
+{
+    if (!xcorr.active)
+    {
+        return;
+    }
+
+    xcorr.active = false;
+    arm_timer(xcorr_timer_fd, -1);
+    xcorr_lost += xcorr.correlations.size() - xcorr.received;
+    if (xcorr.received == 0)
+    {
+        return;
+    }
+
+    size_t peaks[3] = {0, 0, 0};
+    bool found = false;
+    for (size_t i = 0; i < xcorr.correlations.size(); ++i)
+    {
+        if (!xcorr.filled[i])
+        {
+            continue;
+        }
+
+        for (size_t k = 0; k < 3; ++k)
+        {
+            if (!found || xcorr.correlations[i].result[k] > xcorr.correlations[peaks[k]].result[k])
+            {
+                peaks[k] = i;
+            }
+        }
+        found = true;
+    }
+
+    ROS_DEBUG("Correlation transfer %u: %zu correlations, %lu lost so far",
+              xcorr.transfer_id, xcorr.received, static_cast<unsigned long>(xcorr_lost));
+
+    if (publish_correlation_deltas)
+    {
+        publish_deltas(ros::Time::now(),
+                       static_cast<double>(xcorr.correlations[peaks[0]].left_shift) / sampling_frequency,
+                       static_cast<double>(xcorr.correlations[peaks[1]].left_shift) / sampling_frequency,
+                       static_cast<double>(xcorr.correlations[peaks[2]].left_shift) / sampling_frequency);
+    }
+}
+
+/**
+ * Reassembles every correlation datagram that has arrived.
+ *
+ * @return None.
+ */
+void HydroZynqBridge::receive_xcorr()
+{
+    ssize_t len;
+    while ((len = recv(xcorr_fd, buffer, sizeof(buffer), 0)) >= 0)
+    {
+        stream_header_t header;
+        if (static_cast<size_t>(len) < sizeof(header))
+        {
+            malformed++;
+            continue;
+        }
+
+        memcpy(&header, buffer, sizeof(header));
+        const size_t count = header.element_count;
+        if (header.element_size != sizeof(correlation_t) || header.encoding != 0 ||
+            static_cast<size_t>(len) < sizeof(header) + count * sizeof(correlation_t) ||
+            header.packet_number < 0 ||
+            header.first_element + count > header.total_elements)
+        {
+            malformed++;
+            continue;
+        }
+
+        if (xcorr.active && (header.transfer_id != xcorr.transfer_id ||
+                             header.total_elements != xcorr.correlations.size()))
+        {
+            finish_xcorr();
+        }
+
+        if (!xcorr.active)
+        {
+            xcorr.active = true;
+            xcorr.transfer_id = header.transfer_id;
+            xcorr.correlations.assign(header.total_elements, correlation_t());
+            xcorr.filled.assign(header.total_elements, false);
+            xcorr.packets.assign(header.total_elements, false);
+            xcorr.received = 0;
+        }
+
+        const size_t number = header.packet_number;
+        if (number >= xcorr.packets.size() || xcorr.packets[number])
+        {
+            continue;
+        }
+        xcorr.packets[number] = true;
+
+        memcpy(&xcorr.correlations[header.first_element], &buffer[sizeof(header)], count * sizeof(correlation_t));
+        for (size_t i = 0; i < count; ++i)
+        {
+            xcorr.filled[header.first_element + i] = true;
+        }
+        xcorr.received += count;
+
+        if (xcorr.received == xcorr.correlations.size())
+        {
+            finish_xcorr();
+        }
+        else
+        {
+            arm_timer(xcorr_timer_fd, XCORR_IDLE_TIMEOUT_MS / 1000.0);
+        }
+    }
+}
+
+/**
+ * Schedules the silence window of every request that has arrived.
+ *
+ * @return None.
+ */
+void HydroZynqBridge::receive_silence_request()
+{
+    ssize_t len;
+    while ((len = recv(silence_fd, buffer, sizeof(buffer), 0)) >= 0)
+    {
+        silence_request_t request;
+        if (static_cast<size_t>(len) != sizeof(request))
+        {
+            ROS_WARN("Received invalid packet size.");
+            continue;
+        }
+
+        memcpy(&request, buffer, sizeof(request));
+
+        /*
+         * The absolute start is used once the clocks are synchronized, so
+         * network latency does not delay the window.
+         */
+        double when = request.when_ms / 1000.0;
+        double duration = request.duration_ms / 1000.0;
+        double start;
+        if (board_to_host(request.start_us, &start))
+        {
+            when = start - host_time();
+            duration = request.duration_us / 1e6;
+        }
+
+        /*
+         * A request that arrives during a window extends it rather than
+         * ending it early.
+         */
+        if (silence_state == SILENCE_ACTIVE)
+        {
+            silence_duration = when + duration;
+            arm_timer(silence_timer_fd, (silence_duration > 0)? silence_duration : 0);
+            continue;
+        }
+
+        silence_state = SILENCE_PENDING;
+        silence_duration = duration;
+        arm_timer(silence_timer_fd, (when > 0)? when : 0);
+    }
+}
+
+/**
+ * Starts or ends the silence window when its timer expires.
+ *
+ * @return None.
+ */
+void HydroZynqBridge::service_silence_timer()
+{
+    std_srvs::SetBool srv;
+    if (silence_state == SILENCE_PENDING)
+    {
+        ROS_INFO("Silencing thrusters for ping.");
+        srv.request.data = true;
+        silence_state = SILENCE_ACTIVE;
+        arm_timer(silence_timer_fd, silence_duration);
+    }
+    else if (silence_state == SILENCE_ACTIVE)
+    {
+        srv.request.data = false;
+        silence_state = SILENCE_IDLE;
+        ROS_INFO("Disabling silence");
+    }
+    else
+    {
+        return;
+    }
+
+    if (!silence_client.call(srv))
+    {
+        ROS_WARN_THROTTLE(1, "Thruster silence service call failed");
+    }
+}
+
+/**
+ * Runs the event loop until ROS shuts down.
+ *
+ * @return None.
+ */
+void HydroZynqBridge::run()
+{
+    epoll_event events[8];
+    while (ros::ok())
+    {
+        /*
+         * The timeout bounds how long a shutdown request waits.
+         */
+        const int ready = epoll_wait(epoll_fd, events, 8, 100);
+        for (int i = 0; i < ready; ++i)
+        {
+            const int fd = events[i].data.fd;
+            if (fd == result_fd)
+            {
+                receive_result();
+            }
+            else if (fd == xcorr_fd)
+            {
+                receive_xcorr();
+            }
+            else if (fd == silence_fd)
+            {
+                receive_silence_request();
+            }
+            else if (fd == sync_fd)
+            {
+                receive_time_sync();
+            }
+            else
+            {
+                uint64_t expirations;
+                if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+                {
+                    continue;
+                }
+
+                if (fd == silence_timer_fd)
+                {
+                    service_silence_timer();
+                }
+                else if (fd == xcorr_timer_fd)
+                {
+                    finish_xcorr();
+                }
+                else if (fd == sync_timer_fd)
+                {
+                    send_time_sync();
+                }
+            }
+        }
+
+        ros::spinOnce();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "hydrozynq_bridge");
+    ros::NodeHandle node;
+    ros::NodeHandle private_node("~");
+
+    HydroZynqBridge bridge(node, private_node);
+    if (!bridge.open())
+    {
+        ROS_FATAL("Failed to open the HydroZynq sockets");
+        return 1;
+    }
+
+    bridge.run();
+
+    return 0;
+}
@@ -0,0 +1,150 @@
+#!/usr/bin/python
+
+import argparse
+import socket
+import struct
+
+# Must match src/command_protocol.h.
+COMMAND_PORT = 3000
+MAGIC = 0xC0DE
+VERSION = 1
+
+SET = 1
+ACK = 2
+
+STATUS = {0: 'ok', 1: 'malformed', 2: 'unknown parameter', 3: 'invalid value', 4: 'stale'}
+
+HEADER_FORMAT = '<HBBIIHHHH'
+HEADER_SIZE = struct.calcsize(HEADER_FORMAT)
+TLV_FORMAT = '<HH'
+TLV_SIZE = struct.calcsize(TLV_FORMAT)
+
+# Parameter name: (id, kind), where kind is 'u32', 'bool', 'u32[]', 'f32[]', or 'str'.
+PARAMS = {
+    'threshold': (1, 'u32'),
+    'ping_frequency': (2, 'u32'),
+    'pinger_frequencies': (3, 'u32[]'),
+    'filter': (4, 'bool'),
+    'planar': (5, 'bool'),
+    'hw_trigger': (6, 'bool'),
+    'hw_correlate': (7, 'bool'),
+    'reference': (8, 'u32'),
+    'all_pairs': (9, 'bool'),
+    'trigger_any': (10, 'bool'),
+    'window_normalize': (11, 'bool'),
+    'noise_threshold': (12, 'u32'),
+    'pre_ping_duration_us': (13, 'u32'),
+    'post_ping_duration_us': (14, 'u32'),
+    'samples_per_packet': (15, 'u32'),
+    'decimation': (16, 'u32'),
+    'xcorr_stream': (17, 'bool'),
+    'debug': (18, 'bool'),
+    'preview': (19, 'bool'),
+    'record': (20, 'bool'),
+    'min_ping_quality': (21, 'u32'),
+    'phat': (22, 'bool'),
+    'envelope_onset': (23, 'bool'),
+    'average_pings': (24, 'u32'),
+    'average_exponential': (25, 'bool'),
+    'coarse_search': (26, 'bool'),
+    'track_lags': (27, 'bool'),
+    'filter_sections': (28, 'f32[]'),
+    'sample_rate_hz': (29, 'u32'),
+    'cfar_threshold': (30, 'u32'),
+    'matched_threshold': (31, 'u32'),
+    'dsp_decimation': (32, 'u32'),
+    'hw_envelope': (33, 'bool'),
+    'profile': (34, 'str'),
+    'fast_tdoa': (35, 'u32'),
+    'lazy_filter': (36, 'bool'),
+    'dual_rate': (37, 'bool'),
+    'masked_sync': (38, 'bool'),
+    'continuous_capture': (39, 'bool'),
+    'dma_irq_threshold': (40, 'u32'),
+    'dma_irq_delay_us': (41, 'u32'),
+    'accelerator_module': (42, 'u32'),
+}
+NAMES = {param_id: (name, kind) for name, (param_id, kind) in PARAMS.items()}
+
+
+def encode_param(name, value):
+    """Encodes a name=value setting as a TLV."""
+    param_id, kind = PARAMS[name]
+    if kind == 'bool':
+        payload = struct.pack('<B', 1 if value.lower() in ('1', 'true', 'on') else 0)
+    elif kind == 'u32[]':
+        payload = b''.join(struct.pack('<I', int(v)) for v in value.split(',') if v)
+    elif kind == 'f32[]':
+        payload = b''.join(struct.pack('<f', float(v)) for v in value.split(',') if v)
+    elif kind == 'str':
+        payload = value.encode()
+    else:
+        payload = struct.pack('<I', int(value))
+    return struct.pack(TLV_FORMAT, param_id, len(payload)) + payload
+
+
+def decode_params(data):
+    """Decodes every TLV of an acknowledgement."""
+    params = {}
+    offset = 0
+    while offset + TLV_SIZE <= len(data):
+        param_id, length = struct.unpack(TLV_FORMAT, data[offset:offset + TLV_SIZE])
+        value = data[offset + TLV_SIZE:offset + TLV_SIZE + length]
+        offset += TLV_SIZE + length
+
+        name, kind = NAMES.get(param_id, (str(param_id), 'raw'))
+        if kind == 'bool':
+            params[name] = bool(value[0])
+        elif kind == 'u32':
+            params[name] = struct.unpack('<I', value)[0]
+        elif kind == 'u32[]':
+            params[name] = list(struct.unpack('<{}I'.format(length // 4), value))
+        elif kind == 'f32[]':
+            params[name] = list(struct.unpack('<{}f'.format(length // 4), value))
+        else:
+            params[name] = value
+    return params
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Sets a batch of parameters on the HydroZynq atomically.')
+    parser.add_argument('settings', nargs='*', help='Settings as name=value. Pinger frequencies and filter '
+                        'coefficients (b0,b1,b2,a0,a1,a2 per section) are comma separated. profile=name '
+                        'sets the parameters of a processing profile, which later settings override.')
+    parser.add_argument('--hostname', type=str, default='192.168.0.7', help='Specifies the address of the board')
+    parser.add_argument('--expect-version', type=int, default=0,
+                        help='Specifies the parameter set version the batch applies to, or 0 for any')
+    parser.add_argument('--sequence', type=int, default=1, help='Specifies the sequence number of the command')
+    parser.add_argument('--timeout', type=float, default=1.0, help='Specifies the acknowledgement timeout in seconds')
+    args = parser.parse_args()
+
+    tlvs = b''
+    for setting in args.settings:
+        name, value = setting.split('=', 1)
+        tlvs += encode_param(name, value)
+
+    header = struct.pack(HEADER_FORMAT, MAGIC, VERSION, SET, args.sequence,
+                         args.expect_version, 0, 0, len(tlvs), 0)
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.settimeout(args.timeout)
+    sock.sendto(header + tlvs, (args.hostname, COMMAND_PORT))
+
+    try:
+        data = sock.recv(2048)
+    except socket.timeout:
+        print('No acknowledgement received')
+        exit(1)
+
+    magic, version, kind, sequence, param_set_version, status, error_param, length, _ = \
+        struct.unpack(HEADER_FORMAT, data[:HEADER_SIZE])
+    if magic != MAGIC or kind != ACK or sequence != args.sequence:
+        print('Unexpected reply')
+        exit(1)
+
+    print('Status: {}'.format(STATUS.get(status, status)))
+    if status:
+        print('Parameter: {}'.format(NAMES.get(error_param, (error_param,))[0]))
+    print('Parameter set version: {}'.format(param_set_version))
+    for name, value in sorted(decode_params(data[HEADER_SIZE:HEADER_SIZE + length]).items()):
+        print('    {}: {}'.format(name, value))
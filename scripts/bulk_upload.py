@@ -0,0 +1,94 @@
+#!/usr/bin/python
+
+import argparse
+import random
+import socket
+import struct
+import time
+
+# Must match src/bulk_upload.h.
+UPLOAD_PORT = 3015
+VERSION = 1
+
+TARGETS = {'template': 0, 'filter': 1, 'accelerator': 2}
+
+HEADER_FORMAT = '<HBBIII'
+ACK_FORMAT = '<HBBII'
+ACK_SIZE = struct.calcsize(ACK_FORMAT)
+
+STATUS_RECEIVING = 0
+STATUS_COMPLETE = 1
+STATUS_REJECTED = 2
+
+# Keeps each datagram within one receive buffer of the HydroZynq.
+PAYLOAD_BYTES = 1400
+
+# The firmware acknowledges every 16 datagrams, so a window of two batches
+# keeps the link busy while an acknowledgement is in flight.
+WINDOW_DATAGRAMS = 32
+
+
+def read_floats(filename):
+    """Reads numbers separated by whitespace, commas or '/' as floats."""
+    with open(filename) as f:
+        text = f.read()
+    values = [float(v) for v in text.replace(',', ' ').replace('/', ' ').split()]
+    return struct.pack('<{}f'.format(len(values)), *values)
+
+
+def upload(sock, address, target, data, timeout, slot=0):
+    """Uploads data to a slot of a target, resuming from the acknowledged
+    offset after a loss, and returns the time taken."""
+    transfer = random.randint(1, 0xFFFFFFFF)
+    start = time.time()
+    acked = 0
+    sock.settimeout(timeout)
+    while True:
+        offset = acked
+        for _ in range(WINDOW_DATAGRAMS):
+            if offset >= len(data):
+                break
+            payload = data[offset:offset + PAYLOAD_BYTES]
+            sock.sendto(struct.pack(HEADER_FORMAT, VERSION, target, slot, transfer,
+                                    offset, len(data)) + payload, address)
+            offset += len(payload)
+
+        try:
+            while True:
+                version, _, status, number, received = struct.unpack(
+                        ACK_FORMAT, sock.recv(ACK_SIZE))
+                if version != VERSION or number != transfer:
+                    continue
+                if status == STATUS_REJECTED:
+                    raise RuntimeError('HydroZynq rejected the upload')
+                acked = max(acked, received)
+                if status == STATUS_COMPLETE:
+                    return time.time() - start
+                if acked >= offset:
+                    break
+        except socket.timeout:
+            pass
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Uploads a matched filter template, capture filter or accelerator module to the HydroZynq')
+    parser.add_argument('target', choices=sorted(TARGETS.keys()), help='Specifies what is uploaded')
+    parser.add_argument('file', help='Specifies a file of the template samples, of six coefficients per filter section as b0, b1, b2, a0, a1, a2, or a partial bitstream (.bit or .bin)')
+    parser.add_argument('--hostname', type=str, default='192.168.0.7', help='Specifies the HydroZynq address')
+    parser.add_argument('--slot', type=int, default=1, help='Specifies the number of the accelerator module a partial bitstream replaces')
+    parser.add_argument('--timeout', type=float, default=0.2, help='Specifies the time waited for an acknowledgement in seconds')
+    args = parser.parse_args()
+
+    slot = 0
+    if args.target == 'accelerator':
+        with open(args.file, 'rb') as f:
+            data = f.read()
+        slot = args.slot
+    else:
+        data = read_floats(args.file)
+    if not data:
+        raise SystemExit('{}: no values'.format(args.file))
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    elapsed = upload(sock, (args.hostname, UPLOAD_PORT), TARGETS[args.target], data, args.timeout, slot)
+    print('Uploaded {} bytes of {} in {:.3f} s'.format(len(data), args.target, elapsed))
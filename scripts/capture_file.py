@@ -0,0 +1,124 @@
+#!/usr/bin/python
+"""Reads and writes HydroZynq capture files.
+
+A capture file holds a header, the samples of every ping back to back as
+interleaved little-endian int16 values of channels A to D, and an index of
+the pings. It must match software/host/capture_file.h.
+"""
+
+import argparse
+import numpy
+import struct
+import time
+
+MAGIC = 0x50435A48
+VERSION = 1
+HEADER_BYTES = 256
+
+HEADER_FORMAT = '<IHHIIIHH4BiIIIII4IQQI'
+HEADER_FIELDS = ['magic', 'version', 'header_bytes', 'sampling_frequency',
+                 'clk_div', 'decimation', 'channels', 'sample_bytes']
+PARAM_FIELDS = ['ping_threshold', 'ping_frequency', 'noise_threshold',
+                'pre_ping_duration_us', 'post_ping_duration_us', 'num_pingers']
+
+PING_FORMAT = '<QIIQQ'
+PING_FIELDS = ['first_sample', 'sample_count', 'transfer_id', 'hw_timestamp', 'host_time_ns']
+PING_DTYPE = numpy.dtype([(name, '<u8' if code == 'Q' else '<u4')
+                          for name, code in zip(PING_FIELDS, PING_FORMAT[1:])])
+
+SAMPLE_DTYPE = numpy.dtype('<i2')
+
+
+class CaptureFile:
+    """A capture file whose samples are mapped rather than read."""
+
+    def __init__(self, filename):
+        with open(filename, 'rb') as f:
+            header = f.read(HEADER_BYTES)
+            values = struct.unpack(HEADER_FORMAT, header[:struct.calcsize(HEADER_FORMAT)])
+
+            self.header = dict(zip(HEADER_FIELDS, values[:8]))
+            if self.header['magic'] != MAGIC or self.header['version'] != VERSION:
+                raise ValueError('{} is not a version {} capture file'.format(filename, VERSION))
+
+            self.channel_map = list(values[8:12])
+            self.params = dict(zip(PARAM_FIELDS, values[12:18]))
+            self.params['pinger_frequencies'] = list(values[18:22])[:self.params['num_pingers']]
+            self.total_samples, index_offset, num_pings = values[22:25]
+
+            f.seek(index_offset)
+            self.index = numpy.frombuffer(f.read(num_pings * PING_DTYPE.itemsize), dtype=PING_DTYPE)
+
+        self.sampling_frequency = self.header['sampling_frequency']
+        if self.total_samples:
+            self.samples = numpy.memmap(filename, dtype=SAMPLE_DTYPE, mode='r',
+                                        offset=self.header['header_bytes'],
+                                        shape=(self.total_samples, 4))
+        else:
+            self.samples = numpy.zeros((0, 4), dtype=SAMPLE_DTYPE)
+
+    def __len__(self):
+        return len(self.index)
+
+    def ping(self, i):
+        """Returns the samples of a ping as an (n, 4) array view."""
+        entry = self.index[i]
+        first = int(entry['first_sample'])
+        return self.samples[first:first + int(entry['sample_count'])]
+
+
+class CaptureWriter:
+    """Appends pings to a new capture file."""
+
+    def __init__(self, filename, sampling_frequency=5000000, clk_div=0, decimation=1,
+                 channel_map=(0, 1, 2, 3), params=None):
+        params = params or {}
+        pingers = list(params.get('pinger_frequencies', []))[:4]
+        self.fixed = [sampling_frequency, clk_div, decimation, 4, 8] + list(channel_map) + \
+            [params.get(name, 0) for name in PARAM_FIELDS[:5]] + [len(pingers)] + \
+            pingers + [0] * (4 - len(pingers))
+        self.index = []
+        self.total_samples = 0
+        self.f = open(filename, 'w+b')
+        self._write_index()
+
+    def _write_index(self):
+        self.f.seek(HEADER_BYTES + self.total_samples * 8)
+        for entry in self.index:
+            self.f.write(struct.pack(PING_FORMAT, *entry))
+        header = struct.pack(HEADER_FORMAT, MAGIC, VERSION, HEADER_BYTES, *(self.fixed + [
+            self.total_samples, HEADER_BYTES + self.total_samples * 8, len(self.index)]))
+        self.f.seek(0)
+        self.f.write(header + b'\0' * (HEADER_BYTES - len(header)))
+        self.f.flush()
+
+    def append(self, samples, transfer_id=0, hw_timestamp=0, host_time_ns=None):
+        """Appends the (n, 4) samples of a ping."""
+        samples = numpy.ascontiguousarray(samples, dtype=SAMPLE_DTYPE).reshape(-1, 4)
+        if host_time_ns is None:
+            host_time_ns = int(time.time() * 1e9)
+        self.f.seek(HEADER_BYTES + self.total_samples * 8)
+        self.f.write(samples.tobytes())
+        self.index.append((self.total_samples, len(samples), transfer_id, hw_timestamp, host_time_ns))
+        self.total_samples += len(samples)
+        self._write_index()
+
+    def close(self):
+        self.f.close()
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Summarizes a HydroZynq capture file')
+    parser.add_argument('filename', help='Specifies the capture file')
+    args = parser.parse_args()
+
+    capture = CaptureFile(args.filename)
+    print('{} Hz, clk_div {}, decimation {}, channel map {}'.format(
+        capture.sampling_frequency, capture.header['clk_div'],
+        capture.header['decimation'], capture.channel_map))
+    print('Parameters: {}'.format(capture.params))
+    print('{} pings, {} samples'.format(len(capture), capture.total_samples))
+    for i, entry in enumerate(capture.index):
+        print('    {}: transfer {}, {} samples at {}, hardware timestamp {}'.format(
+            i, entry['transfer_id'], entry['sample_count'], entry['first_sample'],
+            entry['hw_timestamp']))
@@ -1,5 +1,6 @@
 import socket
-import struct
+import stream_decode
+import stream_socket
 import sys
 import argparse
 import numpy
@@ -8,33 +9,89 @@ import math
 import rospy
 from robosub.msg import HydrophoneDeltas
 
-class Sample:
-    def __init__(self, data):
-        self.channel = [None] * 3
-        [self.lshift, self.channel[0], self.channel[1], self.channel[2]] = struct.unpack('<iiii', data)
+CORRELATION_DTYPE = stream_decode.CORRELATION_DTYPE
 
+# Time without datagrams after which a partial transfer is published.
+IDLE_TIMEOUT = 0.1
 
-class Packet:
-    def __init__(self, data):
-        [self.number] = struct.unpack('<i', data[:4])
-        self.samples = []
-        self.data = data
 
+class Transfer:
+    """Reassembles the datagrams of one correlation transfer."""
 
-    def _parse(self):
-        for i in range(4, len(self.data), 16):
-            self.samples.append(Sample(self.data[i:i + 16]))
+    def __init__(self, transfer_id, total):
+        self.transfer_id = transfer_id
+        self.correlations = numpy.zeros(total, dtype=CORRELATION_DTYPE)
+        self.filled = numpy.zeros(total, dtype=bool)
+        self.packets = set()
+        self.received = 0
 
+    def add(self, number, first, correlations):
+        count = len(correlations)
+        if number in self.packets or first + count > len(self.correlations):
+            return
+        self.packets.add(number)
+        self.correlations[first:first + count] = correlations
+        self.filled[first:first + count] = True
+        self.received += count
+
+    def complete(self):
+        return self.received == len(self.correlations)
+
+    def to_numpy(self, sampling_frequency):
+        """Returns the received correlations as [shift in s, r1, r2, r3] rows."""
+        correlations = self.correlations[self.filled]
+        data = numpy.empty((len(correlations), 4))
+        data[:, 0] = correlations['lshift'] / float(sampling_frequency)
+        data[:, 1:] = correlations['result']
+        return data
+
+
+class Reassembler:
+    """Reassembles correlation transfers from a stream without ever rebinding.
+
+    A transfer is finished once every correlation has arrived, when a
+    datagram of another transfer arrives, or when the stream goes idle.
+    """
+
+    def __init__(self):
+        self.transfer = None
+        self.malformed = 0
+        self.lost = 0
+
+    def receive(self, data):
+        """Adds a datagram and returns any transfers that it finished."""
+        finished = []
+        try:
+            header, correlations = stream_decode.decode_correlations(data)
+        except stream_decode.DecodeError:
+            self.malformed += 1
+            return finished
+
+        transfer_id = int(header['transfer_id'])
+        total = int(header['total_elements'])
+
+        if self.transfer is not None and self.transfer.transfer_id != transfer_id:
+            finished.extend(self.flush())
+
+        if self.transfer is None:
+            self.transfer = Transfer(transfer_id, total)
+
+        self.transfer.add(int(header['packet_number']), int(header['first_element']), correlations)
+        if self.transfer.complete():
+            finished.extend(self.flush())
+
+        return finished
+
+    def flush(self):
+        """Finishes the current transfer, even if correlations were lost."""
+        if self.transfer is None:
+            return []
+
+        transfer = self.transfer
+        self.transfer = None
+        self.lost += len(transfer.correlations) - transfer.received
+        return [transfer] if transfer.received else []
 
-def to_numpy(packets):
-    array_list = []
-    for packet in packets:
-        for sample in packet.samples:
-            sub_list = [sample.lshift / 5000000.0]
-            for x in xrange(3):
-                sub_list.append(sample.channel[x])
-            array_list.append(sub_list)
-    return numpy.array(array_list)
 
 def pub_deltas(pub, data):
     delta_msg = HydrophoneDeltas()
@@ -76,65 +133,39 @@ def calc_bearing(data):
 
 
 
-def write_to_csv(packets, filename):
-    low_index = 0
-    high_index = 0
-
-    with open(filename, 'w') as f:
-        f.write('Left Shift, C1, C2, C3\n')
-        for packet in packets:
-            for sample in packet.samples:
-                f.write('{}, {}, {}, {}\n'.format(sample.lshift, sample.channel[0], sample.channel[1], sample.channel[2]))
+def write_to_csv(data, filename):
+    numpy.savetxt(filename, data, delimiter=', ', header='Shift (s), C1, C2, C3', comments='')
 
 
 if __name__ == '__main__':
     parser = argparse.ArgumentParser()
     parser.add_argument('--output', type=str, help='Specifies output file name')
     parser.add_argument('--hostname', type=str, default='192.168.0.2', help='Specifies the hostname to bind to')
+    parser.add_argument('--multicast', type=str, help='Specifies a multicast group to receive the stream from')
+    parser.add_argument('--sampling-frequency', type=int, default=5000000, help='Specifies the sample rate of the correlations in Hz')
     args = parser.parse_args()
 
     rospy.init_node("hydrozynq_interface")
     delta_pub = rospy.Publisher('hydrophones/30khz/delta', HydrophoneDeltas,
             queue_size=1)
 
-    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
-    sock.bind((args.hostname, 3003))
-
-    channels = [0,1]
-    labels = {}
-    for channel in channels:
-        labels[channel] = "Ch0-Ch{}".format(channel+1)
-
-    whole_data = []
-    started = False
-
-    while True:
-        data, addr = sock.recvfrom(16 * 300 + 4)
-
-        packet = Packet(data);
-        if packet.number is 0:
-            if started:
-                for packet in whole_data:
-                    packet._parse()
-                print('Got data: {} long'.format(len(whole_data)))
-                np_array = to_numpy(whole_data)
-                calc_bearing(np_array)
-                pub_deltas(pub=delta_pub, data=np_array)
-# plot_data.plot_correlations(np_array, channels, labels, split=False)
-                if args.output is not None:
-                    write_to_csv(whole_data, args.output)
-                    print('Written')
-
-                # Reset and prepare for next batch of data.
-                sock.close()
-                sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
-                sock.bind((args.hostname, 3003))
-                whole_data = []
-                started = False
-
-            else:
-                started = True
-
-        if started:
-            whole_data.append(packet)
-
+    sock = stream_socket.open_stream_socket(args.hostname, 3003, args.multicast)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 4 * 1024 * 1024)
+    sock.settimeout(IDLE_TIMEOUT)
+
+    reassembler = Reassembler()
+    while not rospy.is_shutdown():
+        try:
+            data = sock.recv(65535)
+            finished = reassembler.receive(data)
+        except socket.timeout:
+            finished = reassembler.flush()
+
+        for transfer in finished:
+            np_array = transfer.to_numpy(args.sampling_frequency)
+            pub_deltas(pub=delta_pub, data=np_array)
+            calc_bearing(np_array)
+            print('Transfer {}: {} correlations, {} lost and {} malformed so far'.format(
+                transfer.transfer_id, len(np_array), reassembler.lost, reassembler.malformed))
+            if args.output is not None:
+                write_to_csv(np_array, args.output)
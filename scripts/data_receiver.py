@@ -1,59 +1,135 @@
 import socket
-import struct
+import stream_decode
+import stream_socket
 import sys
 import argparse
+import capture_file
 import os
 import numpy
 import plot_data
 import zipfile
 import progressbar
 
-class Sample:
-    def __init__(self, data):
-        self.channel = [None] * 4
-        [self.channel[0], self.channel[1], self.channel[2], self.channel[3]] = struct.unpack('<hhhh', data)
-
-
 class Packet:
     def __init__(self, data):
-        [self.number] = struct.unpack('<i', data[:4])
-        self.samples = []
+        header = stream_decode.decode_header(data)
+        self.number = int(header['packet_number'])
+        self.first_sample = int(header['first_element'])
+        self.sample_size = int(header['element_size'])
+        self.sample_count = int(header['element_count'])
+        self.encoding = int(header['encoding'])
+        self.transfer_id = int(header['transfer_id'])
+        self.total_samples = int(header['total_elements'])
+        self.samples = None
         self.data = data
 
 
     def _parse(self):
-        for i in range(4, len(self.data), 8):
-            self.samples.append(Sample(self.data[i:i + 8]))
+        _, self.samples = stream_decode.decode_samples(self.data)
 
 
 def to_numpy(packets):
+    """Returns the samples of the packets as [time in s, C1, C2, C3, C4] rows."""
+    rows = []
     for packet in packets:
-        if packet.number is 0:
-            samples_per_packet = len(packet.samples)
+        block = numpy.empty((len(packet.samples), 5))
+        block[:, 0] = (packet.first_sample + numpy.arange(len(packet.samples))) / 5000000.0
+        block[:, 1:] = packet.samples
+        rows.append(block)
+    return numpy.concatenate(rows) if rows else numpy.zeros((0, 5))
+
+
+# Longest retransmit request accepted by the HydroZynq command buffer.
+MAX_REQUEST_LENGTH = 1000
+
+
+def format_resend_requests(transfer_id, missing):
+    """Formats missing packet numbers as one or more retransmit requests."""
+    ranges = []
+    for number in sorted(missing):
+        if ranges and ranges[-1][1] == number - 1:
+            ranges[-1][1] = number
+        else:
+            ranges.append([number, number])
+
+    requests = []
+    request = 'resend:{}'.format(transfer_id)
+    for first, last in ranges:
+        entry = '/{}'.format(first) if first == last else '/{}-{}'.format(first, last)
+        if len(request) + len(entry) > MAX_REQUEST_LENGTH:
+            requests.append(request)
+            request = 'resend:{}'.format(transfer_id)
+        request += entry
+    requests.append(request)
+
+    return requests
+
+
+def receive_reliable(sock, command_address, timeout=0.1):
+    """Receives a whole transfer, requesting lost packets until it completes."""
+    command_sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    packets = {}
+    transfer_id = None
+    sock.settimeout(None)
 
-    array_list = []
-    for packet in packets:
-        sample_index = 0
-        for sample in packet.samples:
-            sample_number = sample_index + packet.number * samples_per_packet
-            sample_index += 1
-            sub_list = [sample_number / 5000000.0]
-            for x in xrange(4):
-                sub_list.append(sample.channel[x])
-            array_list.append(sub_list)
-    return numpy.array(array_list)
+    while True:
+        try:
+            data, addr = sock.recvfrom(65535)
+        except socket.timeout:
+            per_packet = max(p.sample_count for p in packets.values())
+            num_packets = (total_samples + per_packet - 1) // per_packet
+            missing = [n for n in range(num_packets) if n not in packets]
+            if not missing:
+                break
+
+            print('Requesting {} missing packets'.format(len(missing)))
+            for request in format_resend_requests(transfer_id, missing):
+                command_sock.sendto(request.encode(), command_address)
+            continue
+
+        packet = Packet(data)
+        if packet.transfer_id != transfer_id:
+            packets = {}
+            transfer_id = packet.transfer_id
+            total_samples = packet.total_samples
+
+        packets[packet.number] = packet
+        sock.settimeout(timeout)
+
+    command_sock.sendto('ack:{}'.format(transfer_id).encode(), command_address)
+    command_sock.close()
+
+    return [packets[n] for n in sorted(packets)]
+
+
+def write_capture(packets, filename, sampling_frequency):
+    """Appends the packets of a transfer to a capture file as one ping."""
+    samples, _ = stream_decode.assemble_transfer([packet.data for packet in packets],
+                                                 packets[0].total_samples)
+
+    writer = capture_file.CaptureWriter(filename, sampling_frequency=sampling_frequency)
+    writer.append(samples, transfer_id=packets[0].transfer_id)
+    writer.close()
+
+
+def write_output(packets, filename, sampling_frequency):
+    """Writes a transfer as zipped CSV if a .csv file is named, or else as a capture file."""
+    if os.path.splitext(filename)[1].lower() == '.csv':
+        for packet in packets:
+            if packet.samples is None:
+                packet._parse()
+        write_to_csv(packets, filename)
+        print('CSV data written to {}.zip'.format(os.path.splitext(filename)[0]))
+    else:
+        write_capture(packets, filename, sampling_frequency)
+        print('Capture written to {}'.format(filename))
 
 
 def write_to_csv(packets, filename):
     low_index = 0
     high_index = 0
 
-    print 'Searching for start packet...'
-    for packet in packets:
-        if packet.number is 0:
-            samples_per_packet = len(packet.samples)
-            print('Samples per packet: {}'.format(len(packet.samples)))
-            break
+    print('Samples per packet: {}'.format(packets[0].sample_count))
 
     with open(filename, 'w') as f:
         f.write('Sample number, C1, C2, C3, C4\n')
@@ -61,11 +137,8 @@ def write_to_csv(packets, filename):
         bar = progressbar.ProgressBar(max_value=len(packets))
         for i, packet in enumerate(packets):
             bar.update(i)
-            sample_index = 0
-            for sample in packet.samples:
-                sample_number = sample_index + packet.number * samples_per_packet
-                sample_index += 1
-                f.write('{}, {}, {}, {}, {}\n'.format(sample_number, sample.channel[0], sample.channel[1], sample.channel[2], sample.channel[3]))
+            for i, sample in enumerate(packet.samples):
+                f.write('{}, {}, {}, {}, {}\n'.format(packet.first_sample + i, *sample))
         bar.update(len(packets))
 
     archive = zipfile.ZipFile('{}.zip'.format(os.path.splitext(filename)[0]), 'w', zipfile.ZIP_DEFLATED)
@@ -76,12 +149,15 @@ def write_to_csv(packets, filename):
 
 if __name__ == '__main__':
     parser = argparse.ArgumentParser()
-    parser.add_argument('--output', type=str, help='Specifies output file name')
+    parser.add_argument('--output', type=str, help='Specifies the output capture file, or a .csv file for zipped CSV')
+    parser.add_argument('--sampling-frequency', type=int, default=5000000, help='Specifies the sample rate recorded in capture files in Hz')
     parser.add_argument('--hostname', type=str, default='192.168.0.2', help='Specifies the hostname to bind to')
+    parser.add_argument('--multicast', type=str, help='Specifies a multicast group to receive the stream from')
+    parser.add_argument('--reliable', action='store_true', help='Requests retransmission of lost packets')
+    parser.add_argument('--hydrozynq', type=str, default='192.168.0.7', help='Specifies the HydroZynq address for retransmit requests')
     args = parser.parse_args()
 
-    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
-    sock.bind((args.hostname, 3001))
+    sock = stream_socket.open_stream_socket(args.hostname, 3001, args.multicast)
 
     whole_data = []
     started = False
@@ -92,9 +168,20 @@ if __name__ == '__main__':
         labels[channel] = "Ch{}".format(channel)
 
 
+    while args.reliable:
+        whole_data = receive_reliable(sock, (args.hydrozynq, 3000))
+        print('Received transfer {} of {} packets'.format(whole_data[0].transfer_id, len(whole_data)))
+        if args.output is not None:
+            write_output(whole_data, args.output, args.sampling_frequency)
+            sys.exit(0)
+
+        for packet in whole_data:
+            packet._parse()
+        plot_data.plot_samples(to_numpy(whole_data), channels, labels, split=False)
+
     bar = progressbar.ProgressBar(max_value=progressbar.UnknownLength)
     while True:
-        data, addr = sock.recvfrom(8 * 3000 + 4)
+        data, addr = sock.recvfrom(65535)
 
         packet = Packet(data);
 
@@ -102,6 +189,10 @@ if __name__ == '__main__':
             bar.update(packet.number)
 
         if packet.number is 0:
+            if started and args.output is not None:
+                write_output(whole_data, args.output, args.sampling_frequency)
+                sys.exit(0)
+
             if started:
                 print 'Starting parse.'
                 parse_bar = progressbar.ProgressBar(max_value=len(whole_data))
@@ -110,17 +201,11 @@ if __name__ == '__main__':
                     packet._parse()
                 parse_bar.update(len(whole_data))
                 np_array = to_numpy(whole_data)
-                if args.output is not None:
-                    write_to_csv(whole_data, args.output)
-                    print('CSV data written to {}.zip'.format(os.path.splitext(args.output)[0]))
-                    sys.exit(0)
-
                 plot_data.plot_samples(np_array, channels, labels, split=False)
 
                 # Reset and prepare for next batch of data.
                 sock.close()
-                sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
-                sock.bind((args.hostname, 3001))
+                sock = stream_socket.open_stream_socket(args.hostname, 3001, args.multicast)
                 whole_data = []
                 started = False
 
@@ -1,15 +1,130 @@
 #!/usr/bin/python
 import socket
 import argparse
+import re
+import struct
+
+# The first byte of a deferred log record, and its header of marker, level,
+# length, and the address of its format in the firmware image.
+LOG_RECORD_MARKER = '\x1e'
+LOG_RECORD_HEADER = struct.Struct('<BBHI')
+
+CONVERSION = re.compile(r'%([-+ 0#]*)(\d*)(?:\.(\d+))?(hh|h|ll|l|z|j|t)?([diuxXcspfFeEgG%])')
+
+
+class FirmwareImage(object):
+    """
+    The allocated sections of a firmware ELF image, to read the formats of
+    deferred log records from.
+    """
+    def __init__(self, filename):
+        with open(filename, 'rb') as f:
+            self.data = f.read()
+
+        shoff, = struct.unpack_from('<I', self.data, 0x20)
+        shentsize, shnum = struct.unpack_from('<HH', self.data, 0x2e)
+        self.sections = []
+        for i in range(shnum):
+            _, sh_type, _, addr, offset, size = struct.unpack_from('<IIIIII', self.data, shoff + i * shentsize)
+
+            # Sections without file contents, such as .bss, hold no formats.
+            if addr and sh_type != 8:
+                self.sections.append((addr, offset, size))
+
+    def string(self, address):
+        for addr, offset, size in self.sections:
+            if addr <= address < addr + size:
+                start = offset + address - addr
+                end = self.data.index('\0', start)
+                return self.data[start:end]
+
+        return None
+
+
+def render(fmt, args):
+    """
+    Formats a deferred record from its format and its encoded arguments.
+    """
+    out = []
+    pos = 0
+    offset = 0
+    for match in CONVERSION.finditer(fmt):
+        out.append(fmt[pos:match.start()])
+        pos = match.end()
+        flags, width, precision, length, kind = match.groups()
+        if kind == '%':
+            out.append('%')
+            continue
+
+        spec = '%' + flags + width + ('.' + precision if precision is not None else '')
+        if kind == 's':
+            end = args.index('\0', offset)
+            value = args[offset:end]
+            offset = end + 1
+        elif kind in 'fFeEgG':
+            value, = struct.unpack_from('<d', args, offset)
+            offset += 8
+        elif length in ('ll', 'j'):
+            value, = struct.unpack_from('<q' if kind in 'di' else '<Q', args, offset)
+            offset += 8
+        else:
+            value, = struct.unpack_from('<i' if kind in 'di' else '<I', args, offset)
+            offset += 4
+
+        if kind == 'u':
+            kind = 'd'
+        elif kind == 'p':
+            spec = '0x' + spec
+            kind = 'x'
+        elif kind in 'di' and length in ('h', 'hh'):
+            value = struct.unpack('<h' if length == 'h' else '<b',
+                                  struct.pack('<H' if length == 'h' else '<B',
+                                              value & (0xFFFF if length == 'h' else 0xFF)))[0]
+
+        out.append((spec + kind) % value)
+
+    out.append(fmt[pos:])
+    return ''.join(out)
+
+
+def print_datagram(data, image):
+    """
+    Prints the text lines and deferred records of a datagram.
+    """
+    while data:
+        if data[0] != LOG_RECORD_MARKER:
+            end = data.find(LOG_RECORD_MARKER)
+            end = len(data) if end < 0 else end
+            print data[:end],
+            data = data[end:]
+            continue
+
+        if len(data) < LOG_RECORD_HEADER.size:
+            break
+
+        _, level, length, address = LOG_RECORD_HEADER.unpack_from(data)
+        args = data[LOG_RECORD_HEADER.size:length]
+        data = data[length:]
+
+        fmt = image.string(address) if image else None
+        if fmt is None:
+            print '[format 0x{:08x}: {}]'.format(address, args.encode('hex'))
+        else:
+            print render(fmt, args),
+
 
 if __name__ == "__main__":
     parser = argparse.ArgumentParser(description="Displays console output from hydro-zynq board")
     parser.add_argument('--hostname', type=str, default='192.168.0.2', help='Specifies the hostname to bind to')
+    parser.add_argument('--elf', type=str, default=None,
+                        help='Specifies the firmware image to format deferred log records from')
     args = parser.parse_args()
 
+    image = FirmwareImage(args.elf) if args.elf else None
+
     sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
     sock.bind((args.hostname, 3004))
 
     while True:
-        data = sock.recv(1024)
-        print data,
+        data = sock.recv(2048)
+        print_datagram(data, image)
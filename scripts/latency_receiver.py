@@ -0,0 +1,120 @@
+#!/usr/bin/python
+"""Measures the latency from the arrival of each ping to its result on the host.
+
+The result records carry the time after the arrival of the ping at which each
+stage of its processing finished on the board. With the board clock
+synchronized, the time the record reached the host and the time it was
+decoded complete the path, and each stage is reported as a histogram.
+"""
+
+import argparse
+import socket
+import time
+
+import stream_decode
+import stream_socket
+import time_sync
+
+STAGES = ['capture', 'window', 'process', 'solve', 'queue', 'network', 'decode', 'total']
+HISTOGRAM_BINS = 24
+
+# Seconds between clock synchronization bursts.
+SYNC_INTERVAL = 10.0
+
+
+class StageHistogram(object):
+    """Counts the durations of a stage in bins of log2(microseconds)."""
+
+    def __init__(self):
+        self.count = 0
+        self.total = 0.0
+        self.max = 0.0
+        self.bins = [0] * HISTOGRAM_BINS
+
+    def add(self, us):
+        us = max(us, 0.0)
+        self.count += 1
+        self.total += us
+        self.max = max(self.max, us)
+        self.bins[min(int(us).bit_length(), HISTOGRAM_BINS - 1)] += 1
+
+
+def stage_durations(record, received, decoded, clock):
+    """
+    Finds the duration of each stage of a ping in microseconds, or None for a
+    stage that was not timed.
+    """
+    marks = [int(record[field]) for field in
+             ('capture_latency_us', 'window_latency_us', 'process_latency_us',
+              'solve_latency_us', 'queue_latency_us')]
+    durations = []
+    previous = 0
+    for mark in marks:
+        durations.append(mark - previous if mark else None)
+        previous = mark or previous
+
+    arrival = clock.to_host(int(record['timestamp_us'])) if clock.synced() else None
+    if arrival is None or not marks[-1]:
+        return durations + [None, (decoded - received) * 1e6, None]
+
+    queued = arrival + marks[-1] / 1e6
+    return durations + [(received - queued) * 1e6, (decoded - received) * 1e6, (decoded - arrival) * 1e6]
+
+
+def print_histograms(histograms):
+    print '{:>10} {:>8} {:>12} {:>12}'.format('stage', 'count', 'mean us', 'max us')
+    for name in STAGES:
+        histogram = histograms[name]
+        if histogram.count == 0:
+            print '{:>10} {:>8}'.format(name, 0)
+            continue
+
+        print '{:>10} {:>8} {:>12.1f} {:>12.1f}'.format(
+                name, histogram.count, histogram.total / histogram.count, histogram.max)
+        bins = ['{}:{}'.format(b, n) for b, n in enumerate(histogram.bins) if n]
+        print '{:>10} log2(us) {}'.format('', ' '.join(bins))
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Displays the ping-to-result latency of the HydroZynq')
+    parser.add_argument('--hostname', type=str, default='192.168.0.2', help='Specifies the hostname to bind to')
+    parser.add_argument('--multicast', type=str, help='Specifies a multicast group to receive the stream from')
+    parser.add_argument('--hydrozynq', type=str, default='192.168.0.7', help='Specifies the HydroZynq address to synchronize with')
+    parser.add_argument('--pings', type=int, default=20, help='Specifies the pings between reports')
+    args = parser.parse_args()
+
+    sock = stream_socket.open_stream_socket(args.hostname, 3002, args.multicast)
+    sock.settimeout(SYNC_INTERVAL)
+
+    clock = time_sync.TimeSync(args.hydrozynq)
+    last_sync = None
+    histograms = dict((name, StageHistogram()) for name in STAGES)
+    pings = 0
+
+    while True:
+        if last_sync is None or time.time() > last_sync + SYNC_INTERVAL:
+            if not clock.sync():
+                print 'HydroZynq clock synchronization failed.'
+            last_sync = time.time()
+
+        try:
+            data = sock.recv(2048)
+        except socket.timeout:
+            continue
+        received = time.time()
+
+        try:
+            results = stream_decode.decode_results(data)
+        except Exception as e:
+            print 'Received invalid HydroZynq datagram: {}'.format(e)
+            continue
+        decoded = time.time()
+
+        for record in results:
+            for name, us in zip(STAGES, stage_durations(record, received, decoded, clock)):
+                if us is not None:
+                    histograms[name].add(us)
+
+            pings += 1
+            if pings % args.pings == 0:
+                print_histograms(histograms)
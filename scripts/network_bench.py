@@ -0,0 +1,176 @@
+#!/usr/bin/python
+
+import argparse
+import socket
+import struct
+import time
+
+# Must match app/network_bench_bin.c.
+BENCH_PORT = 3008
+VERSION = 1
+
+STREAM_REQUEST = 1
+ECHO = 2
+DATA = 3
+SUMMARY = 4
+
+PATHS = {'copy': 0, 'ref': 1}
+
+HEADER_FORMAT = '<HHI'
+HEADER_SIZE = struct.calcsize(HEADER_FORMAT)
+REQUEST_FORMAT = HEADER_FORMAT + 'IIIHH'
+DATA_FORMAT = HEADER_FORMAT + 'IQ'
+DATA_SIZE = struct.calcsize(DATA_FORMAT)
+SUMMARY_FORMAT = HEADER_FORMAT + 'IIQIIII'
+SUMMARY_SIZE = struct.calcsize(SUMMARY_FORMAT)
+
+
+class StreamResult:
+    """Outcome of one stream as seen by both ends."""
+
+    def __init__(self, payload_bytes, rate, path):
+        self.payload_bytes = payload_bytes
+        self.rate = rate
+        self.path = path
+        self.received = 0
+        self.reordered = 0
+        self.first_rx = None
+        self.last_rx = None
+        self.summary = None
+
+    def goodput(self):
+        if self.received < 2 or self.last_rx == self.first_rx:
+            return 0
+        return (self.received - 1) * self.payload_bytes / (self.last_rx - self.first_rx)
+
+    def loss(self):
+        if not self.summary or self.summary['sent'] == 0:
+            return 1.0
+        return 1.0 - float(self.received) / self.summary['sent']
+
+    def __str__(self):
+        rate = '{:.1f} MB/s'.format(self.rate / 1e6) if self.rate else 'unpaced'
+        if not self.summary:
+            return '{:>4} {:>5} B {:>12}: no summary, {} received'.format(
+                self.path, self.payload_bytes, rate, self.received)
+
+        s = self.summary
+        return ('{:>4} {:>5} B {:>12}: goodput {:7.2f} MB/s, loss {:6.2%}, '
+                'reordered {}, send failures {}, pbuf pool errors {} (max {}), '
+                'heap errors {}, ref waits {}').format(
+                    self.path, self.payload_bytes, rate, self.goodput() / 1e6,
+                    self.loss(), self.reordered, s['send_failures'],
+                    s['pbuf_pool_errors'], s['pbuf_pool_max'], s['heap_errors'],
+                    s['ref_waits'])
+
+
+def run_stream(sock, board, test_id, payload_bytes, rate, path, count, timeout):
+    """Requests a stream from the board and measures its reception."""
+    result = StreamResult(payload_bytes, rate, path)
+    request = struct.pack(REQUEST_FORMAT, VERSION, STREAM_REQUEST, test_id,
+                          payload_bytes, rate, count, PATHS[path], 0)
+    sock.sendto(request, board)
+
+    last_sequence = -1
+    sock.settimeout(timeout)
+    while True:
+        try:
+            data = sock.recv(65535)
+        except socket.timeout:
+            break
+
+        now = time.time()
+        if len(data) < HEADER_SIZE:
+            continue
+
+        version, kind, packet_id = struct.unpack(HEADER_FORMAT, data[:HEADER_SIZE])
+        if version != VERSION or packet_id != test_id:
+            continue
+
+        if kind == DATA and len(data) >= DATA_SIZE:
+            sequence = struct.unpack(DATA_FORMAT, data[:DATA_SIZE])[3]
+            if sequence < last_sequence:
+                result.reordered += 1
+            last_sequence = max(last_sequence, sequence)
+            result.received += 1
+            if result.first_rx is None:
+                result.first_rx = now
+            result.last_rx = now
+        elif kind == SUMMARY and len(data) >= SUMMARY_SIZE:
+            fields = struct.unpack(SUMMARY_FORMAT, data[:SUMMARY_SIZE])
+            result.summary = dict(zip(['sent', 'send_failures', 'elapsed_us',
+                                       'pbuf_pool_errors', 'pbuf_pool_max',
+                                       'heap_errors', 'ref_waits'], fields[3:]))
+
+            # The summary follows the data, but a few datagrams may still be
+            # in flight behind it.
+            sock.settimeout(0.05)
+
+    return result
+
+
+def measure_rtt(sock, board, test_id, payload_bytes, count, timeout):
+    """Measures the echo round-trip time for a payload size."""
+    rtts = []
+    lost = 0
+    sock.settimeout(timeout)
+    for sequence in range(count):
+        request = struct.pack(HEADER_FORMAT + 'I', VERSION, ECHO, test_id, sequence)
+        request += b'\0' * max(0, payload_bytes - len(request))
+        start = time.time()
+        sock.sendto(request, board)
+
+        while True:
+            try:
+                data = sock.recv(65535)
+            except socket.timeout:
+                lost += 1
+                break
+
+            if len(data) >= HEADER_SIZE + 4 and data[:HEADER_SIZE + 4] == request[:HEADER_SIZE + 4]:
+                rtts.append(time.time() - start)
+                break
+
+    return rtts, lost
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Benchmarks the HydroZynq network path')
+    parser.add_argument('--hostname', type=str, default='192.168.0.2', help='Specifies the hostname to bind to')
+    parser.add_argument('--board', type=str, default='192.168.0.7', help='Specifies the address of the board')
+    parser.add_argument('--sizes', type=int, nargs='+', default=[64, 512, 1024, 1400, 4096, 8192],
+                        help='Specifies the payload sizes in bytes')
+    parser.add_argument('--rates', type=int, nargs='+', default=[1000000, 10000000, 40000000, 0],
+                        help='Specifies the pacing rates in bytes per second, or 0 for unpaced')
+    parser.add_argument('--paths', type=str, nargs='+', default=['copy', 'ref'], choices=PATHS.keys(),
+                        help='Specifies the transmit paths to benchmark')
+    parser.add_argument('--count', type=int, default=2000, help='Specifies the datagrams per stream')
+    parser.add_argument('--pings', type=int, default=200, help='Specifies the echoes per size')
+    parser.add_argument('--timeout', type=float, default=1.0, help='Specifies the receive timeout in seconds')
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 8 * 1024 * 1024)
+    sock.bind((args.hostname, 0))
+    board = (args.board, BENCH_PORT)
+
+    test_id = int(time.time()) & 0xFFFF0000
+
+    print('Round-trip time')
+    for size in args.sizes:
+        test_id += 1
+        rtts, lost = measure_rtt(sock, board, test_id, min(size, 1400), args.pings, args.timeout)
+        if rtts:
+            rtts.sort()
+            print('{:>5} B: min {:.1f} us, median {:.1f} us, p99 {:.1f} us, {} lost'.format(
+                min(size, 1400), rtts[0] * 1e6, rtts[len(rtts) // 2] * 1e6,
+                rtts[int(len(rtts) * 0.99)] * 1e6, lost))
+        else:
+            print('{:>5} B: no replies'.format(size))
+
+    print('Streaming')
+    for path in args.paths:
+        for size in args.sizes:
+            for rate in args.rates:
+                test_id += 1
+                print(run_stream(sock, board, test_id, size, rate, path, args.count, args.timeout))
@@ -0,0 +1,162 @@
+#!/usr/bin/python
+
+import argparse
+import bisect
+import socket
+import struct
+import subprocess
+
+MAGIC = 0x53505A48
+VERSION = 1
+
+HEADER_FORMAT = '<IHHIII2III'
+ENTRY_FORMAT = '<IIB3x'
+
+CPUS = ['CPU0', 'CPU1 (DSP)']
+
+
+def receive_dump(sock):
+    """Collects the datagrams of a PC sample dump and returns its header and entries."""
+    header_size = struct.calcsize(HEADER_FORMAT)
+    entry_size = struct.calcsize(ENTRY_FORMAT)
+    entries = {}
+    header = None
+
+    while header is None or len(entries) < header['total']:
+        try:
+            data = sock.recv(65535)
+        except socket.timeout:
+            break
+
+        # Periodic telemetry shares the port, so skip other datagrams.
+        if len(data) < header_size:
+            continue
+        magic, version, num_entries, period_us, first, total, samples0, samples1, unavailable, dropped = \
+                struct.unpack(HEADER_FORMAT, data[:header_size])
+        if magic != MAGIC:
+            continue
+        if version != VERSION:
+            raise RuntimeError('Unsupported PC sample version {}'.format(version))
+
+        header = {'period_us': period_us, 'total': total, 'samples': [samples0, samples1],
+                  'unavailable': unavailable, 'dropped': dropped}
+        for i in range(num_entries):
+            offset = header_size + i * entry_size
+            entries[first + i] = struct.unpack(ENTRY_FORMAT, data[offset:offset + entry_size])
+
+    if header is not None and len(entries) < header['total']:
+        print('Missing {} of {} entries'.format(header['total'] - len(entries), header['total']))
+
+    return header, entries.values()
+
+
+class Symbols(object):
+    """
+    The functions of a firmware ELF image, read from its symbol table.
+    """
+    def __init__(self, filename):
+        with open(filename, 'rb') as f:
+            data = f.read()
+
+        shoff, = struct.unpack_from('<I', data, 0x20)
+        shentsize, shnum = struct.unpack_from('<HH', data, 0x2e)
+        sections = [struct.unpack_from('<IIIIIIIIII', data, shoff + i * shentsize) for i in range(shnum)]
+
+        functions = []
+        for _, sh_type, _, _, offset, size, link, _, _, entsize in sections:
+            # Only the full symbol table carries the static functions.
+            if sh_type != 2:
+                continue
+
+            strtab_offset = sections[link][4]
+            for i in range(size / entsize):
+                name, value, length, info, _, _ = struct.unpack_from('<IIIBBH', data, offset + i * entsize)
+                if info & 0xf != 2:
+                    continue
+
+                end = data.index('\0', strtab_offset + name)
+                functions.append((value & ~1, length, data[strtab_offset + name:end]))
+
+        functions.sort()
+        self.starts = [start for start, _, _ in functions]
+        self.functions = functions
+
+    def function(self, pc):
+        i = bisect.bisect_right(self.starts, pc) - 1
+        if i >= 0:
+            start, length, name = self.functions[i]
+            if pc < start + max(length, 4):
+                return name
+
+        return '0x{:08x}'.format(pc)
+
+
+def source_lines(addr2line, elf, pcs):
+    """Maps each address to its source line with the toolchain's addr2line."""
+    pcs = sorted(pcs)
+    try:
+        output = subprocess.check_output([addr2line, '-e', elf] + ['0x{:x}'.format(pc) for pc in pcs])
+    except (OSError, subprocess.CalledProcessError) as e:
+        print('Lines are not available: {}'.format(e))
+        return {}
+
+    return dict(zip(pcs, output.splitlines()))
+
+
+def print_table(title, counts, total, limit):
+    print('{}'.format(title))
+    for name, count in sorted(counts.items(), key=lambda item: -item[1])[:limit]:
+        print('  {:>7.2f}% {:>8}  {}'.format(100.0 * count / total, count, name))
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Dumps and symbolizes the HydroZynq PC samples')
+    parser.add_argument('elf', help='Specifies the firmware image that is running, such as build/profile/app.elf')
+    parser.add_argument('--hostname', type=str, default='192.168.0.2', help='Specifies the hostname to bind to')
+    parser.add_argument('--hydrozynq', type=str, default='192.168.0.7', help='Specifies the address of the HydroZynq')
+    parser.add_argument('--lines', action='store_true', help='Also lists the hottest source lines')
+    parser.add_argument('--addr2line', type=str, default='arm-none-eabi-addr2line',
+                        help='Specifies the addr2line of the firmware toolchain')
+    parser.add_argument('--limit', type=int, default=25, help='Specifies the number of rows listed per table')
+    parser.add_argument('--restart', action='store_true', help='Starts sampling again once the dump is received')
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind((args.hostname, 3007))
+    sock.settimeout(2)
+
+    sock.sendto('pc_sample:dump', (args.hydrozynq, 3000))
+    header, entries = receive_dump(sock)
+    if header is None:
+        raise RuntimeError('No PC sample dump was received')
+
+    print('Sampled every {} us: {} samples on CPU0, {} on CPU1, {} unavailable, {} dropped'.format(
+            header['period_us'], header['samples'][0], header['samples'][1],
+            header['unavailable'], header['dropped']))
+
+    symbols = Symbols(args.elf)
+    lines = source_lines(args.addr2line, args.elf, set(pc for pc, _, _ in entries)) if args.lines else {}
+
+    for cpu, name in enumerate(CPUS):
+        total = sum(count for _, count, entry_cpu in entries if entry_cpu == cpu)
+        if not total:
+            continue
+
+        functions = {}
+        source = {}
+        for pc, count, entry_cpu in entries:
+            if entry_cpu != cpu:
+                continue
+            function = symbols.function(pc)
+            functions[function] = functions.get(function, 0) + count
+            if pc in lines:
+                line = '{} ({})'.format(lines[pc], function)
+                source[line] = source.get(line, 0) + count
+
+        print('')
+        print_table('{} functions'.format(name), functions, total, args.limit)
+        if source:
+            print_table('{} lines'.format(name), source, total, args.limit)
+
+    if args.restart:
+        sock.sendto('pc_sample:start', (args.hydrozynq, 3000))
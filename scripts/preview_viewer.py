@@ -0,0 +1,123 @@
+#!/usr/bin/python
+
+import argparse
+import select
+import socket
+import struct
+
+import matplotlib.pyplot as plt
+
+# Must match preview_header_t and preview_point_t in software/src/stream_format.h.
+PREVIEW_PORT = 3010
+PREVIEW_VERSION = 1
+
+HEADER_FORMAT = '<HHIQIIHHHH'
+HEADER_SIZE = struct.calcsize(HEADER_FORMAT)
+POINT_FORMAT = '<4h4h'
+POINT_SIZE = struct.calcsize(POINT_FORMAT)
+
+CHANNEL_LABELS = ['Channel A', 'Channel B', 'Channel C', 'Channel D']
+
+
+class Preview:
+    """The envelope of one capture, filled in as its datagrams arrive."""
+
+    def __init__(self, sequence, timestamp_us, capture_samples, samples_per_point, total_points):
+        self.sequence = sequence
+        self.timestamp_us = timestamp_us
+        self.capture_samples = capture_samples
+        self.samples_per_point = samples_per_point
+        self.mins = [[None] * total_points for _ in range(4)]
+        self.maxs = [[None] * total_points for _ in range(4)]
+
+    def add(self, first_point, points):
+        for i, point in enumerate(points):
+            for k in range(4):
+                self.mins[k][first_point + i] = point[k]
+                self.maxs[k][first_point + i] = point[k + 4]
+
+
+def parse_datagram(data):
+    """Splits a preview datagram into its header fields and points."""
+    if len(data) < HEADER_SIZE:
+        return None
+
+    (version, length, sequence, timestamp_us, capture_samples, samples_per_point,
+     total_points, first_point, point_count, _) = struct.unpack(HEADER_FORMAT, data[:HEADER_SIZE])
+    if version != PREVIEW_VERSION or len(data) < length + point_count * POINT_SIZE:
+        return None
+    if first_point + point_count > total_points:
+        return None
+
+    points = [struct.unpack_from(POINT_FORMAT, data, length + i * POINT_SIZE)
+              for i in range(point_count)]
+    return (sequence, timestamp_us, capture_samples, samples_per_point, total_points,
+            first_point, points)
+
+
+class Viewer:
+    """Draws the envelope of each channel and redraws it as points arrive."""
+
+    def __init__(self, sampling_frequency):
+        self.sampling_frequency = sampling_frequency
+        plt.ion()
+        self.figure, self.axes = plt.subplots(4, 1, sharex=True)
+        for axis, label in zip(self.axes, CHANNEL_LABELS):
+            axis.set_ylabel(label)
+            axis.grid(True)
+        self.axes[-1].set_xlabel('Time (ms)')
+        self.fills = [None] * 4
+        self.figure.show()
+
+    def draw(self, preview):
+        span_ms = preview.samples_per_point * 1000.0 / self.sampling_frequency
+        for k, axis in enumerate(self.axes):
+            times, lows, highs = [], [], []
+            for i, (low, high) in enumerate(zip(preview.mins[k], preview.maxs[k])):
+                if low is not None:
+                    times.append(i * span_ms)
+                    lows.append(low)
+                    highs.append(high)
+
+            if self.fills[k] is not None:
+                self.fills[k].remove()
+            self.fills[k] = axis.fill_between(times, lows, highs, step='post', color='C{}'.format(k))
+            axis.relim()
+            axis.autoscale_view()
+
+        self.axes[0].set_title('Capture {} at {:.3f} s ({} samples)'.format(
+            preview.sequence, preview.timestamp_us / 1e6, preview.capture_samples))
+        self.figure.canvas.draw_idle()
+        self.figure.canvas.flush_events()
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Plots the HydroZynq preview stream live')
+    parser.add_argument('--hostname', type=str, default='192.168.0.2', help='Specifies the hostname to bind to')
+    parser.add_argument('--port', type=int, default=PREVIEW_PORT, help='Specifies the port to bind to')
+    parser.add_argument('--sampling-frequency', type=float, default=5e6, help='Specifies the sampling frequency in Hz')
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind((args.hostname, args.port))
+
+    viewer = Viewer(args.sampling_frequency)
+    preview = None
+    while plt.fignum_exists(viewer.figure.number):
+        ready, _, _ = select.select([sock], [], [], 0.05)
+        if not ready:
+            viewer.figure.canvas.flush_events()
+            continue
+
+        fields = parse_datagram(sock.recv(65535))
+        if fields is None:
+            continue
+
+        sequence, timestamp_us, capture_samples, samples_per_point, total_points, first_point, points = fields
+        if preview is None or preview.sequence != sequence:
+            preview = Preview(sequence, timestamp_us, capture_samples, samples_per_point, total_points)
+
+        # Redraw each datagram as it arrives, so that a lost datagram leaves
+        # a gap rather than hiding the capture.
+        preview.add(first_point, points)
+        viewer.draw(preview)
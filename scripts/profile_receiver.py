@@ -0,0 +1,75 @@
+#!/usr/bin/python
+
+import argparse
+import socket
+import struct
+
+STAGES = ['record', 'normalize', 'filter', 'truncate', 'correlate', 'send']
+HISTOGRAM_BINS = 16
+HISTOGRAM_MIN_LOG2 = 14
+
+HEADER_FORMAT = '<HHI'
+STAGE_FORMAT = '<IIQQQ{}I'.format(HISTOGRAM_BINS)
+VERSION = 1
+
+
+def print_profile(data):
+    header_size = struct.calcsize(HEADER_FORMAT)
+    stage_size = struct.calcsize(STAGE_FORMAT)
+
+    version, num_stages, clock_hz = struct.unpack(HEADER_FORMAT, data[:header_size])
+    if version != VERSION:
+        print 'Unsupported profile version {}'.format(version)
+        return
+
+    print '{:>10} {:>8} {:>12} {:>12} {:>12} {:>6}'.format(
+            'stage', 'count', 'mean us', 'max us', 'misses', 'IPC')
+
+    for i in range(num_stages):
+        offset = header_size + i * stage_size
+        fields = struct.unpack(STAGE_FORMAT, data[offset:offset + stage_size])
+        count, max_cycles, cycles, misses, instructions = fields[:5]
+        histogram = fields[5:]
+
+        name = STAGES[i] if i < len(STAGES) else str(i)
+        if count == 0:
+            print '{:>10} {:>8}'.format(name, 0)
+            continue
+
+        print '{:>10} {:>8} {:>12.1f} {:>12.1f} {:>12} {:>6.2f}'.format(
+                name,
+                count,
+                cycles * 1e6 / clock_hz / count,
+                max_cycles * 1e6 / clock_hz,
+                misses / count,
+                float(instructions) / cycles if cycles else 0)
+
+        bins = ['{}:{}'.format(HISTOGRAM_MIN_LOG2 + b, n)
+                for b, n in enumerate(histogram) if n]
+        print '{:>10} log2(cycles) {}'.format('', ' '.join(bins))
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Requests and displays HydroZynq stage profiles')
+    parser.add_argument('--hostname', type=str, default='192.168.0.2', help='Specifies the hostname to bind to')
+    parser.add_argument('--hydrozynq', type=str, default='192.168.0.7', help='Specifies the address of the HydroZynq')
+    parser.add_argument('--reset', action='store_true', help='Clears the profile after it is reported')
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind((args.hostname, 3007))
+    sock.settimeout(2)
+
+    sock.sendto('profile:report', (args.hydrozynq, 3000))
+
+    # Periodic telemetry shares the port, so skip datagrams of other sizes.
+    expected = struct.calcsize(HEADER_FORMAT) + len(STAGES) * struct.calcsize(STAGE_FORMAT)
+    while True:
+        data = sock.recv(65535)
+        if len(data) == expected:
+            break
+
+    print_profile(data)
+
+    if args.reset:
+        sock.sendto('profile:reset', (args.hydrozynq, 3000))
@@ -0,0 +1,112 @@
+#!/usr/bin/python
+"""Receives the HydroZynq data stream sent as raw Ethernet frames.
+
+The frames carry EtherType 0x88B5 and are read from a packet socket bound to
+the interface of the dedicated link, which needs root or CAP_NET_RAW. The
+layout must match raw_frame_header_t in software/src/stream_format.h.
+"""
+
+import argparse
+import capture_file
+import numpy
+import socket
+import stream_decode
+import struct
+
+# Must match RAW_FRAME_ETHERTYPE, RAW_FRAME_VERSION and RAW_FRAME_LAST.
+RAW_FRAME_ETHERTYPE = 0x88B5
+RAW_FRAME_VERSION = 1
+RAW_FRAME_LAST = 1 << 0
+
+ETHERNET_HEADER_SIZE = 14
+
+# Must match raw_frame_header_t.
+RAW_HEADER = struct.Struct('<BBHIII')
+
+
+class Transfer:
+    """The sample bytes of one transfer, placed by the offset of each frame."""
+    def __init__(self, transfer_id, total_bytes):
+        self.transfer_id = transfer_id
+        self.data = bytearray(total_bytes)
+        self.received = 0
+        self.frames = 0
+
+    def add(self, offset, payload):
+        self.data[offset:offset + len(payload)] = payload
+        self.received += len(payload)
+        self.frames += 1
+
+    def complete(self):
+        return self.received >= len(self.data)
+
+    def samples(self):
+        """Returns the samples as rows of the four channels."""
+        return numpy.frombuffer(bytes(self.data), dtype=stream_decode.SAMPLE_DTYPE).reshape(-1, 4)
+
+
+def open_raw_socket(interface):
+    sock = socket.socket(socket.AF_PACKET, socket.SOCK_RAW, socket.htons(RAW_FRAME_ETHERTYPE))
+    sock.bind((interface, RAW_FRAME_ETHERTYPE))
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 16 * 1024 * 1024)
+    return sock
+
+
+def receive_transfer(sock):
+    """Receives frames until a transfer ends, and returns it with the number
+    of frames lost within it."""
+    transfer = None
+    lost = 0
+    sequence = None
+
+    while True:
+        frame = sock.recv(65535)
+        if len(frame) < ETHERNET_HEADER_SIZE + RAW_HEADER.size:
+            continue
+
+        version, flags, transfer_id, number, offset, total_bytes = \
+            RAW_HEADER.unpack_from(frame, ETHERNET_HEADER_SIZE)
+        if version != RAW_FRAME_VERSION:
+            continue
+
+        if sequence is not None and number != sequence:
+            lost += (number - sequence) & 0xFFFFFFFF
+        sequence = (number + 1) & 0xFFFFFFFF
+
+        if transfer is None or transfer.transfer_id != transfer_id:
+            transfer = Transfer(transfer_id, total_bytes)
+
+        payload = frame[ETHERNET_HEADER_SIZE + RAW_HEADER.size:]
+        transfer.add(offset, payload[:total_bytes - offset])
+
+        if flags & RAW_FRAME_LAST:
+            return transfer, lost
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--interface', type=str, default='eth0', help='Specifies the interface of the link to the HydroZynq')
+    parser.add_argument('--output', type=str, help='Specifies a capture file to append transfers to')
+    parser.add_argument('--sampling-frequency', type=int, default=5000000, help='Specifies the sample rate recorded in capture files in Hz')
+    parser.add_argument('--count', type=int, default=0, help='Specifies the number of transfers to receive, or 0 for no limit')
+    args = parser.parse_args()
+
+    sock = open_raw_socket(args.interface)
+
+    writer = None
+    if args.output is not None:
+        writer = capture_file.CaptureWriter(args.output, sampling_frequency=args.sampling_frequency)
+
+    received = 0
+    try:
+        while args.count == 0 or received < args.count:
+            transfer, lost = receive_transfer(sock)
+            received += 1
+            print 'Transfer {}: {} frames, {} of {} bytes, {} frames lost'.format(
+                transfer.transfer_id, transfer.frames, transfer.received, len(transfer.data), lost)
+
+            if writer is not None and transfer.complete():
+                writer.append(transfer.samples(), transfer_id=transfer.transfer_id)
+    finally:
+        if writer is not None:
+            writer.close()
@@ -0,0 +1,140 @@
+#!/usr/bin/python
+
+import argparse
+import capture_file
+import os
+import socket
+import struct
+import time
+import zipfile
+
+# Must match src/replay.h.
+REPLAY_PORT = 3009
+COMMAND_PORT = 3000
+VERSION = 1
+
+HEADER_FORMAT = '<HHII'
+SUMMARY_FORMAT = '<HBBIII3i3fffIIII'
+SUMMARY_SIZE = struct.calcsize(SUMMARY_FORMAT)
+SUMMARY_FIELDS = ['version', 'located', 'status', 'sequence', 'start_index',
+                  'end_index', 'delay_1', 'delay_2', 'delay_3', 'confidence_1',
+                  'confidence_2', 'confidence_3', 'bearing_deg', 'elevation_deg',
+                  'receive_us', 'processing_us', 'filter_us', 'correlation_us']
+
+SAMPLE_FORMAT = '<hhhh'
+
+
+def read_csv_lines(lines):
+    """Packs the samples of a capture written by data_receiver.py."""
+    data = bytearray()
+    for line in lines:
+        fields = line.strip().split(',')
+        if len(fields) < 5 or not fields[0].strip().isdigit():
+            continue
+        data.extend(struct.pack(SAMPLE_FORMAT, *[int(v) for v in fields[1:5]]))
+    return bytes(data)
+
+
+def read_pings(filename, sampling_frequency):
+    """Reads the pings of a capture as (name, samples, sampling frequency)."""
+    if os.path.splitext(filename)[1].lower() == '.hzc':
+        capture = capture_file.CaptureFile(filename)
+        for i in range(len(capture)):
+            yield ('{}[{}]'.format(os.path.basename(filename), i),
+                   capture.ping(i).tobytes(), capture.sampling_frequency)
+        return
+
+    yield (os.path.basename(filename), read_capture(filename), sampling_frequency)
+
+
+def read_capture(filename):
+    """Reads a capture from a CSV file, a zipped CSV file, or raw samples."""
+    extension = os.path.splitext(filename)[1].lower()
+    if extension == '.zip':
+        with zipfile.ZipFile(filename) as archive:
+            name = archive.namelist()[0]
+            return read_csv_lines(archive.read(name).decode().splitlines())
+    elif extension == '.csv':
+        with open(filename) as f:
+            return read_csv_lines(f)
+
+    # Raw samples as recorded by tcp_receiver.py.
+    with open(filename, 'rb') as f:
+        data = f.read()
+    return data[:len(data) // 8 * 8]
+
+
+def receive_exactly(sock, length):
+    data = bytearray()
+    while len(data) < length:
+        chunk = sock.recv(length - len(data))
+        if not chunk:
+            raise EOFError('HydroZynq closed the replay connection')
+        data.extend(chunk)
+    return bytes(data)
+
+
+def replay(sock, data, sampling_frequency):
+    """Replays a capture and returns the summary of its processing."""
+    start = time.time()
+    sock.sendall(struct.pack(HEADER_FORMAT, VERSION, 0, len(data) // 8, sampling_frequency))
+    sock.sendall(data)
+    summary = dict(zip(SUMMARY_FIELDS, struct.unpack(SUMMARY_FORMAT,
+            receive_exactly(sock, SUMMARY_SIZE))))
+    summary['round_trip_s'] = time.time() - start
+    return summary
+
+
+def format_summary(name, s):
+    if not s['status']:
+        outcome = 'processing failed'
+    elif not s['located']:
+        outcome = 'ping not found'
+    else:
+        outcome = ('ping at [{}, {}), delays {} {} {} ns, confidence {:.2f} {:.2f} {:.2f}, '
+                   'bearing {:.1f} deg, elevation {:.1f} deg').format(
+                        s['start_index'], s['end_index'], s['delay_1'], s['delay_2'],
+                        s['delay_3'], s['confidence_1'], s['confidence_2'],
+                        s['confidence_3'], s['bearing_deg'], s['elevation_deg'])
+
+    return ('{} #{}: {}; received in {} us, processed in {} us (filter {} us, '
+            'correlation {} us), round trip {:.3f} s').format(
+                name, s['sequence'], outcome, s['receive_us'], s['processing_us'],
+                s['filter_us'], s['correlation_us'], s['round_trip_s'])
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Replays recorded captures through the HydroZynq DSP pipeline')
+    parser.add_argument('captures', nargs='+', help='Specifies capture (.hzc), CSV, zipped CSV, or raw sample files to replay')
+    parser.add_argument('--hostname', type=str, default='192.168.0.7', help='Specifies the HydroZynq address')
+    parser.add_argument('--sampling-frequency', type=int, default=5000000, help='Specifies the sample rate of captures that do not record it in Hz')
+    parser.add_argument('--repeat', type=int, default=1, help='Specifies the number of times each capture is replayed')
+    parser.add_argument('--keep-replay', action='store_true', help='Leaves replay enabled once every capture has been replayed')
+    args = parser.parse_args()
+
+    command_sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    command = (args.hostname, COMMAND_PORT)
+    command_sock.sendto(b'replay:1', command)
+
+    sock = socket.create_connection((args.hostname, REPLAY_PORT))
+    try:
+        for filename in args.captures:
+            for name, data, sampling_frequency in read_pings(filename, args.sampling_frequency):
+                if not data:
+                    print('{}: no samples'.format(name))
+                    continue
+
+                processing = []
+                for _ in range(args.repeat):
+                    summary = replay(sock, data, sampling_frequency)
+                    processing.append(summary['processing_us'])
+                    print(format_summary(name, summary))
+
+                if args.repeat > 1:
+                    processing.sort()
+                    print('{}: processing min {} us, median {} us, max {} us'.format(
+                        name, processing[0], processing[len(processing) // 2], processing[-1]))
+    finally:
+        sock.close()
+        if not args.keep_replay:
+            command_sock.sendto(b'replay:0', command)
@@ -2,52 +2,116 @@
 
 import argparse
 import rospy
-import re
 import socket
+import stream_decode
+import stream_socket
+import time_sync
 from robosub.msg import HydrophoneDeltas
 
 
-class DeltaPacket:
-    def __init__(self, data):
-        matches = re.search(r'.*1: (-?\d+) 2: (-?\d+) 3: (-?\d+).*', data)
-        if not matches:
-            raise Exception('Invalid result string')
+class ResultRecord:
+    """Binary result record sent by the HydroZynq for each ping."""
 
-        if len(matches.groups()) != 3:
-            raise Exception('Valid number of groups')
+    def __init__(self, record):
+        self.sequence = int(record['sequence'])
+        self.frequency = int(record['frequency'])
+        self.timestamp_us = int(record['timestamp_us'])
+        self.channel_delay_ns = list(record['channel_delay_ns'])
+        self.peak_amplitude = list(record['peak_amplitude'])
+        self.confidence = list(record['confidence'])
+        self.filter_duration_us = int(record['filter_duration_us'])
+        self.correlation_duration_us = int(record['correlation_duration_us'])
+        self.bearing_deg = float(record['bearing_deg'])
+        self.elevation_deg = float(record['elevation_deg'])
+        self.direction_norm = float(record['direction_norm'])
+        self.quality = float(record['quality'])
+        self.averaged_delay_ns = list(record['averaged_delay_ns'])
+        self.averaged_confidence = list(record['averaged_confidence'])
+        self.averaged_pings = int(record['averaged_pings'])
+        self.trigger_sample = int(record['trigger_sample'])
+        self.trigger_timestamp_us = int(record['trigger_timestamp_us'])
+        self.trigger_count = int(record['trigger_count'])
+        self.tracked_delay_ns = list(record['tracked_delay_ns'])
+        self.tracked_delay_rate_ns_per_s = list(record['tracked_delay_rate_ns_per_s'])
+        self.tracked_delay_variance_ns2 = list(record['tracked_delay_variance_ns2'])
+        self.tracked_bearing_deg = float(record['tracked_bearing_deg'])
+        self.tracked_elevation_deg = float(record['tracked_elevation_deg'])
+        self.track_flags = int(record['track_flags'])
+        self.track_outliers = int(record['track_outliers'])
+        self.capture_latency_us = int(record['capture_latency_us'])
+        self.window_latency_us = int(record['window_latency_us'])
+        self.process_latency_us = int(record['process_latency_us'])
+        self.solve_latency_us = int(record['solve_latency_us'])
+        self.queue_latency_us = int(record['queue_latency_us'])
+        self.delay_source = int(record['delay_source'])
+        self.edge_uncertainty_ns = float(record['edge_uncertainty_ns'])
 
-        self.x = int(matches.group(1))
-        self.y = int(matches.group(2))
-        self.z = int(matches.group(3))
+        [self.x, self.y, self.z] = self.channel_delay_ns
+
+
+def unpack_results(data):
+    """Splits a datagram into result records, which may be batched."""
+    return [ResultRecord(record) for record in stream_decode.decode_results(data)]
+
+
+# Seconds between clock synchronization bursts.
+SYNC_INTERVAL = 10.0
 
 
 if __name__ == '__main__':
     parser = argparse.ArgumentParser()
     parser.add_argument('--hostname', type=str, default='192.168.0.2', help='Specifies the hostname to bind to')
+    parser.add_argument('--multicast', type=str, help='Specifies a multicast group to receive the stream from')
+    parser.add_argument('--hydrozynq', type=str, default='192.168.0.7', help='Specifies the HydroZynq address to synchronize with')
     args = parser.parse_args()
 
-    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
-    sock.bind((args.hostname, 3002))
+    sock = stream_socket.open_stream_socket(args.hostname, 3002, args.multicast)
 
     rospy.init_node('hydrophone_interface')
     delta_pub = rospy.Publisher('hydrophones/30khz/delta', HydrophoneDeltas,
             queue_size=1)
 
+    # Results are stamped with the time the ping arrived at the board.
+    clock = time_sync.TimeSync(args.hydrozynq, clock=rospy.get_time)
+    last_sync = None
+    sock.settimeout(SYNC_INTERVAL)
+
     while not rospy.is_shutdown():
-        data = sock.recv(1024)
+        if last_sync is None or rospy.get_time() > last_sync + SYNC_INTERVAL:
+            if not clock.sync():
+                rospy.logwarn('HydroZynq clock synchronization failed.')
+            last_sync = rospy.get_time()
 
         try:
-            deltas = DeltaPacket(data)
+            data = sock.recv(2048)
+        except socket.timeout:
+            continue
+
+        try:
+            results = unpack_results(data)
         except Exception as e:
             rospy.logwarn('Received invalid HydroZynq datagram: {}'.format(e))
             continue
 
-        msg = HydrophoneDeltas()
+        for deltas in results:
+            # Results for additional pingers of the filter bank are not
+            # published on the primary pinger topic.
+            if deltas.frequency != 0:
+                continue
+
+            if deltas.direction_norm > 0:
+                rospy.logdebug('Bearing: {:.1f} deg, elevation: {:.1f} deg'.format(
+                        deltas.bearing_deg, deltas.elevation_deg))
+
+            msg = HydrophoneDeltas()
 
-        msg.header.stamp = rospy.Time.now()
-        msg.header.frame_id = 'hydrophone_array'
-        msg.xDelta = rospy.Duration(deltas.x)
-        msg.yDelta = rospy.Duration(deltas.y)
-        msg.zDelta = rospy.Duration(deltas.z)
+            if clock.synced():
+                msg.header.stamp = rospy.Time.from_sec(clock.to_host(deltas.timestamp_us))
+            else:
+                msg.header.stamp = rospy.Time.now()
+            msg.header.frame_id = 'hydrophone_array'
+            msg.xDelta = rospy.Duration(deltas.x)
+            msg.yDelta = rospy.Duration(deltas.y)
+            msg.zDelta = rospy.Duration(deltas.z)
 
-        delta_pub.publish(msg)
+            delta_pub.publish(msg)
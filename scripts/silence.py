@@ -4,12 +4,18 @@ import argparse
 import rospy
 import socket
 import struct
+import time_sync
 from std_srvs.srv import SetBool
 
 
+# Seconds between clock synchronization bursts.
+SYNC_INTERVAL = 10.0
+
+
 if __name__ == '__main__':
     parser = argparse.ArgumentParser()
     parser.add_argument('--hostname', type=str, default='192.168.0.2', help='Specifies the hostname to bind to')
+    parser.add_argument('--hydrozynq', type=str, default='192.168.0.7', help='Specifies the HydroZynq address to synchronize with')
     args = parser.parse_args()
 
     sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
@@ -19,25 +25,43 @@ if __name__ == '__main__':
 
     control_shutdown_srv = rospy.ServiceProxy('control/silence', SetBool)
 
+    # Absolute window times are converted with the board clock offset, so
+    # network latency does not skew the window.
+    clock = time_sync.TimeSync(args.hydrozynq, clock=rospy.get_time)
+    last_sync = None
+
     while not rospy.is_shutdown():
-        data = sock.recv(1024)
+        if last_sync is None or rospy.get_time() > last_sync + SYNC_INTERVAL:
+            if not clock.sync():
+                rospy.logwarn('HydroZynq clock synchronization failed.')
+            last_sync = rospy.get_time()
+
+        sock.settimeout(SYNC_INTERVAL)
+        try:
+            data = sock.recv(1024)
+        except socket.timeout:
+            continue
+
         recv_time = rospy.get_time()
-        if len(data) != 8:
+        if len(data) == 20 and clock.synced():
+            start_us, duration_us = struct.unpack('<QI', data[8:20])
+            start = clock.to_host(start_us)
+            duration = duration_us / 1e6
+        elif len(data) in (8, 20):
+            when, duration = struct.unpack('<ii', data[:8])
+            start = recv_time + when / 1000.0
+            duration = duration / 1000.0
+        else:
             rospy.logwarn('Received invalid packet size.')
             continue
 
-        when, duration = struct.unpack('<ii', data)
-
-
-        while rospy.get_time() < recv_time + (when / 1000.0):
-            continue
+        if start > rospy.get_time():
+            rospy.sleep(start - rospy.get_time())
 
         rospy.loginfo('Silencing thrusters for ping.')
         control_shutdown_srv(True)
 
-        shutdown_time = rospy.get_time()
-        while rospy.get_time() < shutdown_time + (duration / 1000.0):
-            continue
+        rospy.sleep(max(0.0, start + duration - rospy.get_time()))
 
         control_shutdown_srv(False)
         rospy.loginfo('Disabling silence')
@@ -0,0 +1,326 @@
+#!/usr/bin/python
+"""Decodes the HydroZynq streams into numpy arrays.
+
+The layouts must match software/src/stream_format.h. Datagrams are decoded by
+software/build/host/libstream_decode.so, which ./mk_host builds, straight into
+numpy arrays. Raw payloads are returned as views of the datagram without a
+copy. Without the library the same results are produced in Python, only more
+slowly.
+"""
+
+import ctypes
+import numpy
+import os
+import struct
+
+# Must match stream_header_t.
+HEADER_DTYPE = numpy.dtype([('packet_number', '<i4'), ('first_element', '<u4'),
+                            ('element_size', '<u2'), ('element_count', '<u2'),
+                            ('encoding', '<u2'), ('transfer_id', '<u2'),
+                            ('total_elements', '<u4')])
+HEADER_SIZE = HEADER_DTYPE.itemsize
+
+ENCODING_RAW = 0
+ENCODING_DELTA = 1
+
+# Number of residuals of each channel that share a bit width.
+DELTA_BLOCK = 32
+
+# Must match sample_t and correlation_t in src/types.h.
+SAMPLE_DTYPE = numpy.dtype('<i2')
+SAMPLE_SIZE = 4 * SAMPLE_DTYPE.itemsize
+CORRELATION_DTYPE = numpy.dtype([('lshift', '<i4'), ('result', '<i4', 3)])
+
+# Must match result_record_t.
+RESULT_VERSION = 8
+RESULT_DTYPE = numpy.dtype([
+    ('version', '<u2'), ('length', '<u2'), ('sequence', '<u4'), ('frequency', '<u4'),
+    ('timestamp_us', '<u8'), ('channel_delay_ns', '<i4', 3), ('peak_amplitude', '<i2', 4),
+    ('confidence', '<f4', 3), ('filter_duration_us', '<u4'), ('correlation_duration_us', '<u4'),
+    ('bearing_deg', '<f4'), ('elevation_deg', '<f4'), ('direction_norm', '<f4'), ('quality', '<f4'),
+    ('averaged_delay_ns', '<i4', 3), ('averaged_confidence', '<f4', 3), ('averaged_pings', '<u4'),
+    ('trigger_sample', '<u8'), ('trigger_timestamp_us', '<u8'), ('trigger_count', '<u4'),
+    ('tracked_delay_ns', '<f4', 3), ('tracked_delay_rate_ns_per_s', '<f4', 3),
+    ('tracked_delay_variance_ns2', '<f4', 3), ('tracked_bearing_deg', '<f4'),
+    ('tracked_elevation_deg', '<f4'), ('track_flags', '<u2'), ('track_outliers', '<u2'),
+    ('capture_latency_us', '<u4'), ('window_latency_us', '<u4'), ('process_latency_us', '<u4'),
+    ('solve_latency_us', '<u4'), ('queue_latency_us', '<u4'), ('delay_source', '<u4'),
+    ('edge_uncertainty_ns', '<f4')])
+
+# Begins a datagram of several batched messages in place of a record version.
+BATCH_MARKER = 0xBA7C
+MESSAGE_RESULT = 1
+
+# Must match preview_header_t and preview_point_t.
+PREVIEW_VERSION = 1
+PREVIEW_HEADER_DTYPE = numpy.dtype([
+    ('version', '<u2'), ('length', '<u2'), ('sequence', '<u4'), ('timestamp_us', '<u8'),
+    ('capture_samples', '<u4'), ('samples_per_point', '<u4'), ('total_points', '<u2'),
+    ('first_point', '<u2'), ('point_count', '<u2'), ('reserved', '<u2')])
+PREVIEW_POINT_DTYPE = numpy.dtype([('min', '<i2', 4), ('max', '<i2', 4)])
+
+# Must match survey_header_t. Each bin is in hundredths of a decibel.
+SURVEY_VERSION = 1
+SURVEY_HEADER_DTYPE = numpy.dtype([
+    ('version', '<u2'), ('length', '<u2'), ('sequence', '<u4'), ('timestamp_us', '<u8'),
+    ('sampling_frequency', '<u4'), ('fft_len', '<u4'), ('segments', '<u4'), ('channel', '<u2'),
+    ('total_bins', '<u2'), ('first_bin', '<u2'), ('bin_count', '<u2')])
+SURVEY_BIN_DTYPE = numpy.dtype('<i2')
+
+LIBRARY_NAME = 'libstream_decode.so'
+DEFAULT_LIBRARY = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                               '..', 'software', 'build', 'host', LIBRARY_NAME)
+
+
+class DecodeError(Exception):
+    pass
+
+
+class _Header(ctypes.Structure):
+    _pack_ = 1
+    _fields_ = [(name, {'<i4': ctypes.c_int32, '<u4': ctypes.c_uint32, '<u2': ctypes.c_uint16}[
+                    HEADER_DTYPE.fields[name][0].str]) for name in HEADER_DTYPE.names]
+
+
+def _load_library():
+    """Loads the native decoder named by HYDROZYNQ_DECODE_LIB or built by mk_host."""
+    path = os.environ.get('HYDROZYNQ_DECODE_LIB', DEFAULT_LIBRARY)
+    try:
+        library = ctypes.CDLL(path)
+    except OSError:
+        return None
+
+    pointer = ctypes.c_void_p
+    size = ctypes.c_size_t
+    header = ctypes.POINTER(_Header)
+    signatures = {
+        'stream_decode_samples': [pointer, size, header, pointer, size],
+        'stream_place_samples': [pointer, size, header, pointer, size],
+        'stream_place_datagrams': [pointer, pointer, size, pointer, size, pointer, ctypes.POINTER(size)],
+        'stream_decode_results': [pointer, size, pointer, size, ctypes.POINTER(size)],
+    }
+    for name, argtypes in signatures.items():
+        function = getattr(library, name)
+        function.argtypes = argtypes
+        function.restype = ctypes.c_int
+
+    return library
+
+
+_library = _load_library()
+
+
+def native():
+    """Returns True if datagrams are decoded by the native library."""
+    return _library is not None
+
+
+def _address(array):
+    return array.ctypes.data_as(ctypes.c_void_p)
+
+
+def _buffer(data):
+    """Returns a read-only byte array over a datagram without copying it."""
+    return numpy.frombuffer(data, dtype=numpy.uint8)
+
+
+def decode_header(data):
+    """Returns the stream header of a data or correlation datagram."""
+    if len(data) < HEADER_SIZE:
+        raise DecodeError('Truncated stream header')
+    return numpy.frombuffer(data, dtype=HEADER_DTYPE, count=1)[0]
+
+
+def decode_delta(data, count):
+    """Decodes samples compressed by encode_samples() on the HydroZynq in Python."""
+    data = bytearray(data)
+    samples = numpy.empty((count, 4), dtype=SAMPLE_DTYPE)
+    if count == 0:
+        return samples
+    current = list(struct.unpack('<hhhh', bytes(data[:8])))
+    samples[0] = current
+    offset = 8
+
+    index = 1
+    while index < count:
+        block = min(count - index, DELTA_BLOCK)
+        for channel in range(4):
+            width = data[offset]
+            offset += 1
+            length = (block * width + 7) // 8
+
+            accumulator = 0
+            for i, byte in enumerate(data[offset:offset + length]):
+                accumulator |= byte << (8 * i)
+            offset += length
+
+            mask = (1 << width) - 1
+            for i in range(block):
+                value = (accumulator >> (i * width)) & mask
+                current[channel] += (value >> 1) ^ -(value & 1)
+                samples[index + i, channel] = current[channel]
+
+        index += block
+
+    return samples
+
+
+def decode_samples(data):
+    """Returns the header and the (n, 4) int16 samples of a data datagram.
+
+    Raw samples are a view of the datagram.
+    """
+    header = decode_header(data)
+    count = int(header['element_count'])
+    if header['element_size'] != SAMPLE_SIZE:
+        raise DecodeError('Unexpected sample size {}'.format(header['element_size']))
+
+    if header['encoding'] == ENCODING_RAW:
+        if len(data) < HEADER_SIZE + count * SAMPLE_SIZE:
+            raise DecodeError('Truncated samples')
+        return header, numpy.frombuffer(data, dtype=SAMPLE_DTYPE, count=count * 4,
+                                        offset=HEADER_SIZE).reshape(-1, 4)
+
+    if header['encoding'] != ENCODING_DELTA:
+        raise DecodeError('Unknown encoding {}'.format(header['encoding']))
+
+    if _library is None:
+        return header, decode_delta(data[HEADER_SIZE:], count)
+
+    samples = numpy.empty((count, 4), dtype=SAMPLE_DTYPE)
+    buf = _buffer(data)
+    if count and not _library.stream_decode_samples(_address(buf), len(buf), ctypes.byref(_Header()),
+                                                    _address(samples), count):
+        raise DecodeError('Malformed delta encoding')
+    return header, samples
+
+
+def place_samples(data, transfer):
+    """Decodes the samples of a data datagram into an (n, 4) int16 transfer
+    array at their index and returns the header."""
+    if _library is None:
+        header, samples = decode_samples(data)
+        first = int(header['first_element'])
+        if first + len(samples) > len(transfer):
+            raise DecodeError('Samples lie outside of the transfer')
+        transfer[first:first + len(samples)] = samples
+        return header
+
+    assert transfer.dtype == SAMPLE_DTYPE and transfer.flags['C_CONTIGUOUS']
+    buf = _buffer(data)
+    native_header = _Header()
+    if not _library.stream_place_samples(_address(buf), len(buf), ctypes.byref(native_header),
+                                         _address(transfer), len(transfer)):
+        raise DecodeError('Malformed data datagram')
+    return decode_header(data)
+
+
+def assemble_transfer(datagrams, total=None):
+    """Decodes the data datagrams of one transfer into an (n, 4) int16 array
+    and a mask of the samples that were received."""
+    if not datagrams:
+        return numpy.zeros((0, 4), dtype=SAMPLE_DTYPE), numpy.zeros(0, dtype=bool)
+
+    if total is None:
+        total = int(decode_header(datagrams[0])['total_elements'])
+
+    transfer = numpy.zeros((total, 4), dtype=SAMPLE_DTYPE)
+    received = numpy.zeros(total, dtype=numpy.uint8)
+    if _library is None:
+        for data in datagrams:
+            try:
+                header = place_samples(data, transfer)
+            except DecodeError:
+                continue
+            first = int(header['first_element'])
+            received[first:first + int(header['element_count'])] = 1
+        return transfer, received.astype(bool)
+
+    buf = numpy.frombuffer(b''.join(datagrams), dtype=numpy.uint8)
+    lengths = numpy.array([len(data) for data in datagrams], dtype=numpy.uint32)
+    placed = ctypes.c_size_t()
+    _library.stream_place_datagrams(_address(buf), _address(lengths), len(lengths),
+                                    _address(transfer), total, _address(received), ctypes.byref(placed))
+    return transfer, received.astype(bool)
+
+
+def decode_correlations(data):
+    """Returns the header and the correlations of a correlation datagram as a
+    view of it."""
+    header = decode_header(data)
+    count = int(header['element_count'])
+    if header['element_size'] != CORRELATION_DTYPE.itemsize or header['encoding'] != ENCODING_RAW or \
+            len(data) < HEADER_SIZE + count * CORRELATION_DTYPE.itemsize:
+        raise DecodeError('Malformed correlation datagram')
+    return header, numpy.frombuffer(data, dtype=CORRELATION_DTYPE, count=count, offset=HEADER_SIZE)
+
+
+def decode_results(data):
+    """Returns the result records of a result datagram, which may be batched."""
+    if _library is not None:
+        capacity = max(1, len(data) // RESULT_DTYPE.itemsize)
+        records = numpy.empty(capacity, dtype=RESULT_DTYPE)
+        count = ctypes.c_size_t()
+        buf = _buffer(data)
+        if not _library.stream_decode_results(_address(buf), len(buf), _address(records),
+                                              capacity, ctypes.byref(count)):
+            raise DecodeError('Malformed result datagram')
+        return records[:count.value]
+
+    if len(data) < 4:
+        raise DecodeError('Truncated result datagram')
+
+    marker, count = struct.unpack('<HH', data[:4])
+    messages = [(MESSAGE_RESULT, 0, len(data))]
+    if marker == BATCH_MARKER:
+        messages = []
+        offset = 4
+        for _ in range(count):
+            if offset + 4 > len(data):
+                raise DecodeError('Truncated message batch')
+            message_type, length = struct.unpack('<HH', data[offset:offset + 4])
+            messages.append((message_type, offset + 4, length))
+            offset += 4 + length
+
+    records = []
+    for message_type, offset, length in messages:
+        if message_type != MESSAGE_RESULT:
+            continue
+        if length < RESULT_DTYPE.itemsize or offset + length > len(data):
+            raise DecodeError('Truncated result record')
+        record = numpy.frombuffer(data, dtype=RESULT_DTYPE, count=1, offset=offset)
+        if record['version'][0] != RESULT_VERSION or record['length'][0] != RESULT_DTYPE.itemsize:
+            raise DecodeError('Unsupported result record version {}'.format(record['version'][0]))
+        records.append(record)
+
+    if not records:
+        return numpy.zeros(0, dtype=RESULT_DTYPE)
+    return numpy.concatenate(records)
+
+
+def decode_preview(data):
+    """Returns the header and the points of a preview datagram as views of it."""
+    if len(data) < PREVIEW_HEADER_DTYPE.itemsize:
+        raise DecodeError('Truncated preview header')
+    header = numpy.frombuffer(data, dtype=PREVIEW_HEADER_DTYPE, count=1)[0]
+    count = int(header['point_count'])
+    if header['version'] != PREVIEW_VERSION or \
+            len(data) < header['length'] + count * PREVIEW_POINT_DTYPE.itemsize:
+        raise DecodeError('Malformed preview datagram')
+    return header, numpy.frombuffer(data, dtype=PREVIEW_POINT_DTYPE, count=count, offset=int(header['length']))
+
+
+def decode_survey(data):
+    """Returns the header and the bins of a survey datagram as views of it."""
+    if len(data) < SURVEY_HEADER_DTYPE.itemsize:
+        raise DecodeError('Truncated survey header')
+    header = numpy.frombuffer(data, dtype=SURVEY_HEADER_DTYPE, count=1)[0]
+    count = int(header['bin_count'])
+    if header['version'] != SURVEY_VERSION or \
+            len(data) < header['length'] + count * SURVEY_BIN_DTYPE.itemsize:
+        raise DecodeError('Malformed survey datagram')
+    return header, numpy.frombuffer(data, dtype=SURVEY_BIN_DTYPE, count=count, offset=int(header['length']))
+
+
+assert HEADER_SIZE == 20
+assert RESULT_DTYPE.itemsize == struct.calcsize('<HHIIQ3i4h3fII4f3i3fIQQI3f3f3f2fHH5IIf')
@@ -0,0 +1,22 @@
+import socket
+import struct
+
+
+def open_stream_socket(hostname, port, group=None):
+    """Opens a socket that receives a HydroZynq stream.
+
+    If a multicast group is given, the socket joins it on the interface with
+    the given address, so that several consumers can receive the same stream.
+    """
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+
+    if group is None:
+        sock.bind((hostname, port))
+        return sock
+
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    sock.bind(('', port))
+    membership = struct.pack('4s4s', socket.inet_aton(group), socket.inet_aton(hostname))
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_ADD_MEMBERSHIP, membership)
+
+    return sock
@@ -0,0 +1,121 @@
+#!/usr/bin/python
+
+import argparse
+import socket
+import struct
+import time
+
+import matplotlib.pyplot as plt
+
+# Must match survey_header_t in software/src/stream_format.h.
+SURVEY_PORT = 3012
+SURVEY_VERSION = 1
+
+HEADER_FORMAT = '<HHIQIIIHHHH'
+HEADER_SIZE = struct.calcsize(HEADER_FORMAT)
+
+CHANNEL_LABELS = ['Channel A', 'Channel B', 'Channel C', 'Channel D']
+
+
+class Survey:
+    """The densities of each channel of one survey, filled in as its datagrams arrive."""
+
+    def __init__(self, sequence, timestamp_us, sampling_frequency, fft_len, segments, total_bins):
+        self.sequence = sequence
+        self.timestamp_us = timestamp_us
+        self.sampling_frequency = sampling_frequency
+        self.fft_len = fft_len
+        self.segments = segments
+        self.densities = [[None] * total_bins for _ in range(4)]
+
+    def add(self, channel, first_bin, densities):
+        for i, density in enumerate(densities):
+            self.densities[channel][first_bin + i] = density / 100.0
+
+    def complete(self):
+        return all(d is not None for channel in self.densities for d in channel)
+
+    def frequencies(self):
+        return [k * float(self.sampling_frequency) / self.fft_len for k in range(len(self.densities[0]))]
+
+
+def parse_datagram(data):
+    """Splits a survey datagram into its header fields and densities."""
+    if len(data) < HEADER_SIZE:
+        return None
+
+    (version, length, sequence, timestamp_us, sampling_frequency, fft_len, segments,
+     channel, total_bins, first_bin, bin_count) = struct.unpack(HEADER_FORMAT, data[:HEADER_SIZE])
+    if version != SURVEY_VERSION or len(data) < length + bin_count * 2:
+        return None
+    if channel >= 4 or first_bin + bin_count > total_bins:
+        return None
+
+    densities = struct.unpack_from('<{}h'.format(bin_count), data, length)
+    return (sequence, timestamp_us, sampling_frequency, fft_len, segments, total_bins,
+            channel, first_bin, densities)
+
+
+def receive_survey(sock, timeout):
+    """Collects the datagrams of the next survey until it is complete or the timeout passes."""
+    survey = None
+    deadline = time.time() + timeout
+    while time.time() < deadline and (survey is None or not survey.complete()):
+        sock.settimeout(max(deadline - time.time(), 0.01))
+        try:
+            data = sock.recv(65535)
+        except socket.timeout:
+            break
+
+        fields = parse_datagram(data)
+        if fields is None:
+            continue
+
+        sequence, timestamp_us, sampling_frequency, fft_len, segments, total_bins, channel, first_bin, densities = fields
+        if survey is None or survey.sequence != sequence:
+            survey = Survey(sequence, timestamp_us, sampling_frequency, fft_len, segments, total_bins)
+        survey.add(channel, first_bin, densities)
+
+    return survey
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Requests a spectral survey from the HydroZynq and plots it')
+    parser.add_argument('--board', type=str, default='192.168.0.7', help='Specifies the address of the board')
+    parser.add_argument('--hostname', type=str, default='192.168.0.2', help='Specifies the hostname to bind to')
+    parser.add_argument('--port', type=int, default=SURVEY_PORT, help='Specifies the port to bind to')
+    parser.add_argument('--duration-ms', type=int, default=5000, help='Specifies the duration of the survey')
+    parser.add_argument('--fft-len', type=int, default=1024, help='Specifies the length of each segment')
+    parser.add_argument('--csv', type=str, help='Writes the densities to a CSV file instead of plotting them')
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind((args.hostname, args.port))
+
+    command = 'survey:{}/{}'.format(args.duration_ms, args.fft_len)
+    sock.sendto(command.encode('ascii'), (args.board, 3000))
+
+    survey = receive_survey(sock, args.duration_ms / 1000.0 + 5)
+    if survey is None:
+        raise SystemExit('No survey was received')
+    if not survey.complete():
+        print('Some datagrams of the survey were lost')
+
+    frequencies = survey.frequencies()
+    if args.csv:
+        with open(args.csv, 'w') as f:
+            f.write('frequency_hz,' + ','.join(CHANNEL_LABELS) + '\n')
+            for k, frequency in enumerate(frequencies):
+                row = ['' if d[k] is None else '{:.2f}'.format(d[k]) for d in survey.densities]
+                f.write('{:.1f},'.format(frequency) + ','.join(row) + '\n')
+    else:
+        for label, densities in zip(CHANNEL_LABELS, survey.densities):
+            points = [(f, d) for f, d in zip(frequencies, densities) if d is not None]
+            plt.plot([p[0] / 1000.0 for p in points], [p[1] for p in points], label=label)
+        plt.title('Survey of {} segments of {} samples at {:.3f} s'.format(
+            survey.segments, survey.fft_len, survey.timestamp_us / 1e6))
+        plt.xlabel('Frequency (kHz)')
+        plt.ylabel('Density (dB re 1 count^2/Hz)')
+        plt.grid(True)
+        plt.legend()
+        plt.show()
@@ -0,0 +1,51 @@
+import socket
+import struct
+import argparse
+
+# Block sequence number and sample count.
+BLOCK_HEADER_FORMAT = '<II'
+BLOCK_HEADER_SIZE = struct.calcsize(BLOCK_HEADER_FORMAT)
+
+SAMPLE_SIZE = 8
+
+
+def receive_exactly(sock, length):
+    data = bytearray()
+    while len(data) < length:
+        chunk = sock.recv(min(length - len(data), 1 << 20))
+        if not chunk:
+            raise EOFError('HydroZynq closed the stream')
+        data.extend(chunk)
+    return bytes(data)
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Records the continuous HydroZynq TCP capture stream.')
+    parser.add_argument('output', help='Specifies the file that raw samples are appended to.')
+    parser.add_argument('--hostname', type=str, default='192.168.0.7', help='Specifies the HydroZynq address')
+    parser.add_argument('--port', type=int, default=3006, help='Specifies the capture stream port')
+    args = parser.parse_args()
+
+    sock = socket.create_connection((args.hostname, args.port))
+
+    # Enable streaming once the connection is up.
+    command_sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    command_sock.sendto(b'tcp_stream:1', (args.hostname, 3000))
+
+    expected = 0
+    with open(args.output, 'wb') as f:
+        try:
+            while True:
+                sequence, sample_count = struct.unpack(BLOCK_HEADER_FORMAT,
+                        receive_exactly(sock, BLOCK_HEADER_SIZE))
+                if sequence != expected:
+                    print('Expected block {} but received {}'.format(expected, sequence))
+                expected = sequence + 1
+
+                f.write(receive_exactly(sock, sample_count * SAMPLE_SIZE))
+                print('Block {}: {} samples'.format(sequence, sample_count))
+        except (KeyboardInterrupt, EOFError) as e:
+            print('Stopping: {}'.format(e))
+        finally:
+            command_sock.sendto(b'tcp_stream:0', (args.hostname, 3000))
+            sock.close()
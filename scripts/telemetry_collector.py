@@ -0,0 +1,343 @@
+#!/usr/bin/python
+"""Collects the telemetry, trace and latency records of the HydroZynq during a run.
+
+Each kind of record is stored as a fixed-size ring file of numpy records in
+the storage directory, so that a run of any length takes bounded space and the
+latest history can be loaded with load_series() while the collector runs.
+Result datagrams are decoded by the shared native decoder of stream_decode.
+Regressions are reported as alerts, which are printed and appended to
+alerts.log in the storage directory:
+  - counters of faults that must not rise, such as DMA errors, FIFO drops and
+    pbuf pool exhaustion
+  - the FPGA temperature above a limit
+  - the per-ping latency rising well above the latency since the board booted
+"""
+
+import argparse
+import numpy
+import os
+import select
+import socket
+import struct
+import time
+
+import latency_receiver
+import stream_decode
+import stream_socket
+import telemetry_receiver
+import time_sync
+import trace_receiver
+
+# Must match the layout of the ring files.
+RING_MAGIC = 'HZTS'
+RING_VERSION = 1
+RING_HEADER_FORMAT = '<4sHHIQ'
+RING_HEADER_SIZE = 32
+
+TELEMETRY_DTYPE = numpy.dtype([
+    ('host_time', '<f8'), ('sequence', '<u4'), ('uptime_us', '<u8'),
+    ('samples_captured', '<u8'), ('short_packets', '<u4'), ('dma_errors', '<u4'),
+    ('fifo_dropped_samples', '<u8'), ('pings_found', '<u4'), ('pings_missed', '<u4'),
+    ('stage_mean_us', '<u4', 6), ('stage_max_us', '<u4', 6),
+    ('pbuf_pool_used', '<u4'), ('pbuf_pool_errors', '<u4'), ('heap_used', '<u4'),
+    ('heap_errors', '<u4'), ('tx_pool_misses', '<u4'), ('udp_send_failures', '<u4'),
+    ('stream_dropped', '<u4', 4), ('results_lost', '<u4'), ('deadline_overruns', '<u4', 3),
+    ('fpga_temperature_c', '<f4'), ('idle_percent', '<f4'), ('shed_level', '<u1')])
+
+# Each stage of latency_receiver in microseconds, or NaN when it was not timed.
+LATENCY_DTYPE = numpy.dtype([
+    ('host_time', '<f8'), ('sequence', '<u4'), ('stage_us', '<f4', len(latency_receiver.STAGES))])
+
+# Must match trace_receiver.EVENT_FORMAT.
+TRACE_EVENT_DTYPE = numpy.dtype([
+    ('timestamp', '<u4'), ('event', '<u2'), ('phase', '<u1'), ('cpu', '<u1'),
+    ('arg0', '<u4'), ('arg1', '<u4')])
+TRACE_DTYPE = numpy.dtype([('host_time', '<f8')] + TRACE_EVENT_DTYPE.descr)
+
+# The counters of telemetry_receiver.TelemetryReport that are reported
+# whenever they rise, and what a rise means.
+FAULT_COUNTERS = [
+    ('dma_errors', 'DMA errors'),
+    ('fifo_dropped_samples', 'samples dropped by the ADC FIFO'),
+    ('pbuf_pool_errors', 'pbuf pool exhausted'),
+    ('heap_errors', 'lwIP heap exhausted'),
+    ('tx_pool_misses', 'transmit pool exhausted'),
+    ('udp_send_failures', 'failed UDP sends'),
+    ('results_lost', 'results lost'),
+]
+
+# The stage whose latency is watched when the board clock is synchronized.
+# Otherwise the time from the ping to its result being queued, which the
+# board times alone, is watched.
+LATENCY_STAGE = latency_receiver.STAGES.index('total')
+
+
+class RingSeries(object):
+    """A time series of fixed-size records kept in a ring file that is mapped into memory."""
+
+    def __init__(self, path, dtype, capacity):
+        self.dtype = dtype
+        self.capacity = capacity
+
+        header = None
+        expected = RING_HEADER_SIZE + dtype.itemsize * capacity
+        if os.path.exists(path) and os.path.getsize(path) == expected:
+            with open(path, 'rb') as f:
+                header = struct.unpack(RING_HEADER_FORMAT, f.read(struct.calcsize(RING_HEADER_FORMAT)))
+
+        # A ring of another layout is started again rather than misread.
+        if header is None or header[:4] != (RING_MAGIC, RING_VERSION, dtype.itemsize, capacity):
+            with open(path, 'wb') as f:
+                f.truncate(expected)
+            header = (RING_MAGIC, RING_VERSION, dtype.itemsize, capacity, 0)
+
+        self.header = numpy.memmap(path, dtype=numpy.uint8, mode='r+', shape=(RING_HEADER_SIZE,))
+        self.records = numpy.memmap(path, dtype=dtype, mode='r+', offset=RING_HEADER_SIZE, shape=(capacity,))
+        self.written = header[4]
+        self._write_header()
+
+    def _write_header(self):
+        header = struct.pack(RING_HEADER_FORMAT, RING_MAGIC, RING_VERSION, self.dtype.itemsize,
+                             self.capacity, self.written)
+        self.header[:len(header)] = numpy.frombuffer(header, dtype=numpy.uint8)
+
+    def append(self, records):
+        """Appends an array of records, overwriting the oldest once the ring is full."""
+        for record in records[-self.capacity:]:
+            self.records[self.written % self.capacity] = record
+            self.written += 1
+        self._write_header()
+
+    def latest(self, count=None):
+        """Returns up to count of the newest records, oldest first."""
+        stored = min(self.written, self.capacity)
+        count = stored if count is None else min(count, stored)
+        indices = numpy.arange(self.written - count, self.written) % self.capacity
+        return numpy.array(self.records[indices])
+
+    def flush(self):
+        self.header.flush()
+        self.records.flush()
+
+
+def load_series(path, dtype):
+    """Loads the records of a ring file, oldest first."""
+    with open(path, 'rb') as f:
+        magic, version, itemsize, capacity, written = struct.unpack(
+                RING_HEADER_FORMAT, f.read(struct.calcsize(RING_HEADER_FORMAT)))
+        if magic != RING_MAGIC or version != RING_VERSION or itemsize != dtype.itemsize:
+            raise Exception('{} is not a ring of the given records'.format(path))
+        f.seek(RING_HEADER_SIZE)
+        records = numpy.fromfile(f, dtype=dtype, count=capacity)
+
+    stored = min(written, capacity)
+    return records[numpy.arange(written - stored, written) % capacity]
+
+
+def telemetry_record(report, host_time):
+    """Packs the fields of a telemetry report that are kept over a run."""
+    record = numpy.zeros(1, dtype=TELEMETRY_DTYPE)
+    record['host_time'] = host_time
+    for name in TELEMETRY_DTYPE.names[1:]:
+        record[name] = getattr(report, name)
+    return record
+
+
+class Alerts(object):
+    """Reports alerts, holding back repeats of one kind for a while."""
+
+    def __init__(self, path, holdoff):
+        self.log = open(path, 'a')
+        self.holdoff = holdoff
+        self.last = {}
+
+    def raise_alert(self, kind, message, now):
+        if kind in self.last and now < self.last[kind] + self.holdoff:
+            return
+
+        self.last[kind] = now
+        line = '{} {}: {}'.format(time.strftime('%Y-%m-%dT%H:%M:%S', time.localtime(now)), kind, message)
+        print 'ALERT ' + line
+        self.log.write(line + '\n')
+        self.log.flush()
+
+
+class RegressionWatch(object):
+    """Raises alerts on telemetry and latency records as they are collected."""
+
+    def __init__(self, alerts, args):
+        self.alerts = alerts
+        self.max_temperature = args.max_temperature
+        self.baseline_pings = args.baseline_pings
+        self.window = args.latency_window
+        self.factor = args.latency_factor
+        self.margin_us = args.latency_margin_us
+        self.previous = None
+        self.reset_latency()
+
+    def reset_latency(self):
+        self.baseline = []
+        self.recent = []
+
+    def add_telemetry(self, report, now):
+        previous = self.previous
+        self.previous = report
+
+        # Every counter starts again when the board restarts.
+        if previous is not None and report.uptime_us < previous.uptime_us:
+            self.alerts.raise_alert('restart', 'the board restarted after {:.0f} s'.format(
+                    previous.uptime_us / 1e6), now)
+            self.reset_latency()
+            previous = None
+
+        if report.fpga_temperature_c > self.max_temperature:
+            self.alerts.raise_alert('temperature', 'FPGA at {:.1f} C'.format(report.fpga_temperature_c), now)
+
+        if previous is None:
+            return
+
+        for name, description in FAULT_COUNTERS:
+            rise = getattr(report, name) - getattr(previous, name)
+            if rise > 0:
+                self.alerts.raise_alert(name, '{} {} since the last report'.format(rise, description), now)
+
+        if report.watchdog_reset and not previous.watchdog_reset:
+            self.alerts.raise_alert('watchdog', 'the last reset was caused by the watchdog', now)
+
+    def add_latency(self, us, now):
+        """Watches the latency of a ping, comparing the median of the latest pings with that of the first."""
+        if len(self.baseline) < self.baseline_pings:
+            self.baseline.append(us)
+            return
+
+        self.recent.append(us)
+        if len(self.recent) > self.window:
+            self.recent.pop(0)
+        if len(self.recent) < self.window:
+            return
+
+        baseline = numpy.median(self.baseline)
+        recent = numpy.median(self.recent)
+        if recent > baseline * self.factor and recent - baseline > self.margin_us:
+            self.alerts.raise_alert('latency', 'median ping latency {:.0f} us against {:.0f} us at first'.format(
+                    recent, baseline), now)
+
+
+def trace_records(data, host_time):
+    """Decodes the events of a trace dump datagram, or returns None for any other datagram."""
+    header_size = struct.calcsize(trace_receiver.HEADER_FORMAT)
+    if len(data) < header_size:
+        return None
+
+    magic, version, num_events = struct.unpack('<IHH', data[:8])
+    if magic != trace_receiver.MAGIC or version != trace_receiver.VERSION:
+        return None
+
+    if header_size + num_events * TRACE_EVENT_DTYPE.itemsize > len(data):
+        return None
+
+    events = numpy.frombuffer(data, dtype=TRACE_EVENT_DTYPE, count=num_events, offset=header_size)
+    records = numpy.zeros(len(events), dtype=TRACE_DTYPE)
+    records['host_time'] = host_time
+    for name in TRACE_EVENT_DTYPE.names:
+        records[name] = events[name]
+    return records
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Collects HydroZynq telemetry and raises alerts on regressions')
+    parser.add_argument('directory', help='Specifies the directory to keep the ring files and alert log in')
+    parser.add_argument('--hostname', type=str, default='192.168.0.2', help='Specifies the hostname to bind to')
+    parser.add_argument('--multicast', type=str, help='Specifies a multicast group to receive the results from')
+    parser.add_argument('--hydrozynq', type=str, default='192.168.0.7', help='Specifies the HydroZynq address')
+    parser.add_argument('--telemetry-records', type=int, default=86400, help='Specifies the telemetry reports kept')
+    parser.add_argument('--latency-records', type=int, default=100000, help='Specifies the ping latencies kept')
+    parser.add_argument('--trace-records', type=int, default=100000, help='Specifies the trace events kept')
+    parser.add_argument('--trace-interval', type=float, default=0, help='Specifies the seconds between trace dumps, or 0 for none')
+    parser.add_argument('--sync-interval', type=float, default=10.0, help='Specifies the seconds between clock synchronizations')
+    parser.add_argument('--flush-interval', type=float, default=5.0, help='Specifies the seconds between writes to disk')
+    parser.add_argument('--max-temperature', type=float, default=85.0, help='Specifies the FPGA temperature to alert above')
+    parser.add_argument('--baseline-pings', type=int, default=50, help='Specifies the pings that set the expected latency')
+    parser.add_argument('--latency-window', type=int, default=20, help='Specifies the pings whose median latency is watched')
+    parser.add_argument('--latency-factor', type=float, default=1.5, help='Specifies the rise of the latency to alert at')
+    parser.add_argument('--latency-margin-us', type=float, default=1000, help='Specifies the least rise of the latency to alert at')
+    parser.add_argument('--alert-holdoff', type=float, default=60, help='Specifies the seconds before an alert is repeated')
+    args = parser.parse_args()
+
+    if not os.path.isdir(args.directory):
+        os.makedirs(args.directory)
+
+    telemetry = RingSeries(os.path.join(args.directory, 'telemetry.ring'), TELEMETRY_DTYPE, args.telemetry_records)
+    latency = RingSeries(os.path.join(args.directory, 'latency.ring'), LATENCY_DTYPE, args.latency_records)
+    trace = RingSeries(os.path.join(args.directory, 'trace.ring'), TRACE_DTYPE, args.trace_records)
+    alerts = Alerts(os.path.join(args.directory, 'alerts.log'), args.alert_holdoff)
+    watch = RegressionWatch(alerts, args)
+
+    if not stream_decode.native():
+        print 'The native stream decoder was not found, so results are decoded in Python.'
+
+    # Telemetry, trace dumps and profile reports share the telemetry port.
+    telemetry_sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    telemetry_sock.bind((args.hostname, 3007))
+    result_sock = stream_socket.open_stream_socket(args.hostname, 3002, args.multicast)
+
+    clock = time_sync.TimeSync(args.hydrozynq)
+    last_sync = last_trace = last_flush = None
+
+    while True:
+        now = time.time()
+        if last_sync is None or now > last_sync + args.sync_interval:
+            clock.sync()
+            last_sync = now
+
+        if args.trace_interval and (last_trace is None or now > last_trace + args.trace_interval):
+            telemetry_sock.sendto('trace:dump', (args.hydrozynq, 3000))
+            telemetry_sock.sendto('trace:start', (args.hydrozynq, 3000))
+            last_trace = now
+
+        if last_flush is None or now > last_flush + args.flush_interval:
+            for series in (telemetry, latency, trace):
+                series.flush()
+            last_flush = now
+
+        readable, _, _ = select.select([telemetry_sock, result_sock], [], [], 1.0)
+        for sock in readable:
+            data = sock.recv(65535)
+            received = time.time()
+
+            if sock is result_sock:
+                try:
+                    results = stream_decode.decode_results(data)
+                except stream_decode.DecodeError:
+                    continue
+                decoded = time.time()
+
+                records = numpy.zeros(len(results), dtype=LATENCY_DTYPE)
+                records['host_time'] = received
+                records['sequence'] = results['sequence']
+                for i, result in enumerate(results):
+                    durations = latency_receiver.stage_durations(result, received, decoded, clock)
+                    records['stage_us'][i] = [numpy.nan if us is None else us for us in durations]
+
+                    watched = durations[LATENCY_STAGE]
+                    if watched is None and result['queue_latency_us']:
+                        watched = float(result['queue_latency_us'])
+                    if watched is not None:
+                        watch.add_latency(watched, received)
+                latency.append(records)
+                continue
+
+            events = trace_records(data, received)
+            if events is not None:
+                trace.append(events)
+                continue
+
+            if len(data) < 4 or struct.unpack('<H', data[2:4])[0] != telemetry_receiver.TelemetryReport.SIZE:
+                continue
+            try:
+                report = telemetry_receiver.TelemetryReport(data)
+            except Exception as e:
+                print 'Invalid telemetry: {}'.format(e)
+                continue
+            telemetry.append(telemetry_record(report, received))
+            watch.add_telemetry(report, received)
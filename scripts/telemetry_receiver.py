@@ -0,0 +1,170 @@
+#!/usr/bin/python
+
+import argparse
+import socket
+import struct
+
+STAGES = ['record', 'normalize', 'filter', 'truncate', 'correlate', 'send']
+DEADLINES = ['capture', 'DSP', 'send']
+STREAMS = ['results', 'samples', 'correlations', 'preview']
+CHANNEL_FAULTS = ['stuck', 'dead', 'saturated', 'noisy']
+ADC_TEST_FAULTS = ['pattern', 'order', 'overrun', 'rate']
+SHED_LEVELS = ['nothing', 'data stream', 'correlation stream', 'full-rate lag search', 'filtering']
+
+
+def health_flags(flags):
+    """Names the faults that a channel is flagged with."""
+    names = [name for bit, name in enumerate(CHANNEL_FAULTS) if flags & (1 << bit)]
+    return '+'.join(names) if names else 'ok'
+
+
+def adc_test_result(flags):
+    """Names the faults that the ADC self test found."""
+    if not flags & 1:
+        return 'not run'
+    names = [name for bit, name in enumerate(ADC_TEST_FAULTS) if flags & (2 << bit)]
+    return 'failed ' + '+'.join(names) if names else 'passed'
+
+
+def link_state(flags, speed_mbps):
+    """Describes the Ethernet link from its flags and speed."""
+    if not flags & 1:
+        return 'down'
+    duplex = 'full' if flags & 2 else 'half'
+    source = '' if flags & 4 else ' (no PHY found)'
+    return 'up at {} Mbit/s {} duplex{}'.format(speed_mbps, duplex, source)
+
+
+class TelemetryReport:
+    """Periodic health and throughput report sent by the HydroZynq."""
+
+    VERSION = 12
+    FORMAT = '<HHIQQII4I6I6I6I5I3If3I3IIQQIQf4I4IIQQI4B4I4f4h4IIB8IB4IBHII'
+    SIZE = struct.calcsize(FORMAT)
+
+    def __init__(self, data):
+        if len(data) < 4:
+            raise Exception('Truncated telemetry report')
+
+        version, length = struct.unpack('<HH', data[:4])
+        if version != TelemetryReport.VERSION:
+            raise Exception('Unsupported telemetry version {}'.format(version))
+
+        if length != TelemetryReport.SIZE or len(data) < length:
+            raise Exception('Invalid telemetry length {}'.format(length))
+
+        fields = list(struct.unpack(TelemetryReport.FORMAT, data[:TelemetryReport.SIZE]))
+        self.sequence, self.uptime_us = fields[2:4]
+        self.samples_captured, self.short_packets, self.dma_errors = fields[4:7]
+        (self.sync_attempts, self.pings_found, self.pings_missed,
+                self.pings_rejected) = fields[7:11]
+        self.stage_mean_us = fields[11:17]
+        self.stage_max_us = fields[17:23]
+        (self.pbuf_pool_used, self.pbuf_pool_max, self.pbuf_pool_errors,
+                self.heap_used, self.heap_max, self.heap_errors) = fields[23:29]
+        (self.tx_pool_used, self.tx_pool_max, self.tx_pool_misses,
+                self.ref_pool_used, self.ref_pool_max) = fields[29:34]
+        self.udp_send_failures, self.log_dropped, self.uart_dropped = fields[34:37]
+        self.fpga_temperature_c = fields[37]
+        self.deadline_overruns = fields[38:41]
+        self.deadline_max_overrun_us = fields[41:44]
+        self.watchdog_reset = fields[44]
+        self.adc_samples, self.fifo_dropped_samples, self.overrun_captures = fields[45:48]
+        self.idle_us, self.idle_percent = fields[48:50]
+        self.stream_dropped = fields[50:54]
+        (self.results_deferred, self.results_retried, self.results_pending,
+                self.results_lost) = fields[54:58]
+        (self.trigger_count, self.trigger_sample, self.trigger_timestamp_us,
+                self.trigger_timeouts) = fields[58:62]
+        self.channel_flags = fields[62:66]
+        self.channel_faults = fields[66:70]
+        self.channel_rms = fields[70:74]
+        self.channel_offset = fields[74:78]
+        self.channel_clipped = fields[78:82]
+        self.pings_excluded = fields[82]
+        (self.adc_test_flags, self.adc_test_clk_div, self.adc_test_expected_hz,
+                self.adc_test_measured_hz, self.adc_test_capture_hz, self.adc_test_samples,
+                self.adc_test_pattern_errors, self.adc_test_discontinuities,
+                self.adc_test_dropped_samples) = fields[83:92]
+        (self.shed_level, self.shed_count, self.restore_count, self.ping_cost_us,
+                self.ping_budget_us) = fields[92:97]
+        (self.link_flags, self.link_speed_mbps, self.link_changes,
+                self.transmit_rate_bytes_per_second) = fields[97:101]
+
+    def __str__(self):
+        lines = [
+            '#{} uptime {:.1f} s, FPGA {:.1f} C, idle {:.1f}%'.format(
+                self.sequence, self.uptime_us / 1e6, self.fpga_temperature_c,
+                self.idle_percent),
+            '  samples {} short packets {} DMA errors {}'.format(
+                self.samples_captured, self.short_packets, self.dma_errors),
+            '  ADC samples {} FIFO dropped {} in {} captures'.format(
+                self.adc_samples, self.fifo_dropped_samples, self.overrun_captures),
+            '  sync attempts {} pings found {} missed {} rejected {}'.format(
+                self.sync_attempts, self.pings_found, self.pings_missed, self.pings_rejected),
+            '  pbuf pool {}/{} errors {} heap {}/{} errors {}'.format(
+                self.pbuf_pool_used, self.pbuf_pool_max, self.pbuf_pool_errors,
+                self.heap_used, self.heap_max, self.heap_errors),
+            '  tx pool {}/{} misses {} ref pool {}/{}'.format(
+                self.tx_pool_used, self.tx_pool_max, self.tx_pool_misses,
+                self.ref_pool_used, self.ref_pool_max),
+            '  dropped: udp {} log {} uart {}'.format(
+                self.udp_send_failures, self.log_dropped, self.uart_dropped),
+            '  backpressure dropped: ' + ', '.join(
+                '{} {}'.format(name, count) for name, count in
+                zip(STREAMS, self.stream_dropped)),
+            '  results deferred {} retried {} waiting {} lost {}'.format(
+                self.results_deferred, self.results_retried, self.results_pending,
+                self.results_lost),
+            '  external trigger edges {} last at {:.6f} s timeouts {}'.format(
+                self.trigger_count, self.trigger_timestamp_us / 1e6,
+                self.trigger_timeouts),
+            '  channels (flags/RMS/offset/clipped/times flagged): ' + ', '.join(
+                '{} {}/{:.1f}/{}/{}/{}'.format(name, health_flags(flags), rms, offset, clipped, faults)
+                for name, flags, rms, offset, clipped, faults in
+                zip('ABCD', self.channel_flags, self.channel_rms, self.channel_offset,
+                    self.channel_clipped, self.channel_faults)),
+            '  pings not correlated for unhealthy channels {}'.format(self.pings_excluded),
+            '  ADC self test {}: clock div {} rate {}/{} Hz captured at {} Hz, '
+            '{} samples, {} pattern errors, {} breaks, {} dropped'.format(
+                adc_test_result(self.adc_test_flags), self.adc_test_clk_div,
+                self.adc_test_measured_hz, self.adc_test_expected_hz, self.adc_test_capture_hz,
+                self.adc_test_samples, self.adc_test_pattern_errors,
+                self.adc_test_discontinuities, self.adc_test_dropped_samples),
+            '  load governor shed {} (level {}), {} sheds {} restores, ping cost {}/{} us'.format(
+                ', '.join(SHED_LEVELS[1:self.shed_level + 1]) or 'nothing', self.shed_level,
+                self.shed_count, self.restore_count, self.ping_cost_us, self.ping_budget_us),
+            '  ethernet link {}, {} changes, streams limited to {} bytes/s'.format(
+                link_state(self.link_flags, self.link_speed_mbps), self.link_changes,
+                self.transmit_rate_bytes_per_second or 'unlimited'),
+            '  stage us (mean/max): ' + ', '.join(
+                '{} {}/{}'.format(name, mean, worst) for name, mean, worst in
+                zip(STAGES, self.stage_mean_us, self.stage_max_us)),
+            '  deadline overruns (count/worst us): ' + ', '.join(
+                '{} {}/{}'.format(name, count, worst) for name, count, worst in
+                zip(DEADLINES, self.deadline_overruns, self.deadline_max_overrun_us)),
+        ]
+        if self.watchdog_reset:
+            lines.append('  last reset was caused by the watchdog')
+        return '\n'.join(lines)
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Displays HydroZynq telemetry')
+    parser.add_argument('--hostname', type=str, default='192.168.0.2', help='Specifies the hostname to bind to')
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind((args.hostname, 3007))
+
+    while True:
+        data = sock.recv(65535)
+
+        # Profile reports share the port.
+        if len(data) < 4 or struct.unpack('<H', data[2:4])[0] != TelemetryReport.SIZE:
+            continue
+
+        try:
+            print TelemetryReport(data)
+        except Exception as e:
+            print 'Invalid telemetry: {}'.format(e)
@@ -0,0 +1,110 @@
+#!/usr/bin/python
+"""Synchronizes a host clock with the HydroZynq clock.
+
+Requests carrying the host transmit time are answered by the board with its
+receive and transmit times, as in NTP. The sample with the shortest round
+trip in each burst gives the offset, and the offsets of successive bursts
+give the drift, so board times can be converted to host times between
+bursts.
+"""
+
+import argparse
+import socket
+import struct
+import time
+
+# Must match src/command_protocol.h.
+COMMAND_PORT = 3000
+MAGIC = 0xC0DE
+VERSION = 1
+TIME_SYNC = 3
+TIME_SYNC_REPLY = 4
+
+HEADER_FORMAT = '<HBBIIHHHH'
+HEADER_SIZE = struct.calcsize(HEADER_FORMAT)
+SYNC_FORMAT = '<QQQ'
+SYNC_SIZE = struct.calcsize(SYNC_FORMAT)
+
+
+class TimeSync:
+    """Converts between board time in microseconds since boot and host time in seconds."""
+
+    def __init__(self, board, port=COMMAND_PORT, clock=time.time):
+        self.board = (board, port)
+        self.clock = clock
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sequence = 0
+        self.offset = None
+        self.reference = None
+        self.drift = 0.0
+        self.round_trip = None
+
+    def _exchange(self, timeout):
+        self.sequence += 1
+        t1 = self.clock()
+        request = struct.pack(HEADER_FORMAT, MAGIC, VERSION, TIME_SYNC, self.sequence,
+                              0, 0, 0, SYNC_SIZE, 0)
+        request += struct.pack(SYNC_FORMAT, int(t1 * 1e9), 0, 0)
+        self.sock.settimeout(timeout)
+        self.sock.sendto(request, self.board)
+
+        while True:
+            data = self.sock.recv(1024)
+            t4 = self.clock()
+            if len(data) < HEADER_SIZE + SYNC_SIZE:
+                continue
+
+            magic, _, kind, sequence = struct.unpack(HEADER_FORMAT, data[:HEADER_SIZE])[:4]
+            if magic != MAGIC or kind != TIME_SYNC_REPLY or sequence != self.sequence:
+                continue
+
+            _, t2, t3 = struct.unpack(SYNC_FORMAT, data[HEADER_SIZE:HEADER_SIZE + SYNC_SIZE])
+            t2 /= 1e6
+            t3 /= 1e6
+            return ((t1 - t2) + (t4 - t3)) / 2, (t4 - t1) - (t3 - t2), t3
+
+    def sync(self, count=8, timeout=0.1):
+        """Measures the offset from a burst of exchanges. Returns False if none were answered."""
+        best = None
+        for _ in range(count):
+            try:
+                sample = self._exchange(timeout)
+            except socket.timeout:
+                continue
+            if best is None or sample[1] < best[1]:
+                best = sample
+
+        if best is None:
+            return False
+
+        offset, round_trip, board_time = best
+        if self.offset is not None and board_time > self.reference:
+            self.drift = (offset - self.offset) / (board_time - self.reference)
+        self.offset = offset
+        self.reference = board_time
+        self.round_trip = round_trip
+        return True
+
+    def synced(self):
+        return self.offset is not None
+
+    def to_host(self, board_us):
+        """Converts a board time in microseconds since boot to host time in seconds."""
+        board = board_us / 1e6
+        return board + self.offset + self.drift * (board - self.reference)
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Measures the HydroZynq clock offset')
+    parser.add_argument('--hostname', type=str, default='192.168.0.7', help='Specifies the HydroZynq address')
+    parser.add_argument('--interval', type=float, default=1.0, help='Specifies the seconds between bursts')
+    args = parser.parse_args()
+
+    sync = TimeSync(args.hostname)
+    while True:
+        if sync.sync():
+            print('Offset {:.6f} s, round trip {:.1f} us, drift {:.2f} ppm'.format(
+                sync.offset, sync.round_trip * 1e6, sync.drift * 1e6))
+        else:
+            print('No reply')
+        time.sleep(args.interval)
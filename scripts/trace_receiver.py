@@ -0,0 +1,132 @@
+#!/usr/bin/python
+
+import argparse
+import json
+import socket
+import struct
+
+MAGIC = 0x52545A48
+VERSION = 1
+
+HEADER_FORMAT = '<IHHIIII'
+EVENT_FORMAT = '<IHBB2I'
+
+EVENTS = ['dma_complete', 'dma_error', 'stage', 'network_dispatch',
+          'udp_send', 'udp_send_ref', 'silence_request', 'ping', 'copy_start', 'copy_done']
+STAGES = ['record', 'normalize', 'filter', 'truncate', 'correlate', 'send']
+ARGS = {
+    'dma_complete': ['completions', 'status'],
+    'dma_error': ['errors', 'status'],
+    'network_dispatch': ['frames', None],
+    'udp_send': ['bytes', 'sent'],
+    'udp_send_ref': ['bytes', 'sent'],
+    'silence_request': ['lead_us', 'duration_us'],
+    'ping': ['sequence', None],
+    'copy_start': ['channel', 'bytes'],
+    'copy_done': ['channel', 'bytes'],
+}
+
+INSTANT, BEGIN, END, COMPLETE = range(4)
+
+
+def receive_dump(sock):
+    """Collects the datagrams of a trace dump and returns its events in order."""
+    header_size = struct.calcsize(HEADER_FORMAT)
+    event_size = struct.calcsize(EVENT_FORMAT)
+    events = {}
+    total = None
+    timer_clock_hz = cycle_clock_hz = None
+
+    while total is None or len(events) < total:
+        try:
+            data = sock.recv(65535)
+        except socket.timeout:
+            break
+
+        # Periodic telemetry shares the port, so skip other datagrams.
+        if len(data) < header_size:
+            continue
+        magic, version, num_events, timer_clock_hz, cycle_clock_hz, first, total = \
+                struct.unpack(HEADER_FORMAT, data[:header_size])
+        if magic != MAGIC:
+            continue
+        if version != VERSION:
+            raise RuntimeError('Unsupported trace version {}'.format(version))
+
+        for i in range(num_events):
+            offset = header_size + i * event_size
+            events[first + i] = struct.unpack(EVENT_FORMAT, data[offset:offset + event_size])
+
+    if total is not None and len(events) < total:
+        print('Missing {} of {} events'.format(total - len(events), total))
+
+    return [events[i] for i in sorted(events)], timer_clock_hz, cycle_clock_hz
+
+
+def to_chrome_trace(events, timer_clock_hz, cycle_clock_hz):
+    """Converts trace events to the Chrome trace event format."""
+    trace_events = []
+    if not events:
+        return {'traceEvents': trace_events}
+
+    # The timestamps are the low word of the global timer, so wraps are
+    # undone assuming consecutive events are less than half a wrap apart.
+    base = events[0][0]
+    offset = 0
+    previous = base
+    for timestamp, event_id, phase, cpu, arg0, arg1 in events:
+        if timestamp < previous and previous - timestamp > 1 << 31:
+            offset += 1 << 32
+        previous = timestamp
+        ts = (offset + timestamp - base) * 1e6 / timer_clock_hz
+
+        name = EVENTS[event_id] if event_id < len(EVENTS) else str(event_id)
+        event = {'pid': 0, 'tid': cpu, 'ts': ts, 'name': name}
+        if name == 'stage':
+            event['name'] = STAGES[arg0] if arg0 < len(STAGES) else 'stage {}'.format(arg0)
+            event['args'] = {'cycles': arg1}
+        else:
+            event['args'] = dict((key, value) for key, value in zip(ARGS.get(name, ['arg0', 'arg1']), [arg0, arg1])
+                                 if key)
+
+        if phase == COMPLETE:
+            event['ph'] = 'X'
+            event['dur'] = arg1 * 1e6 / cycle_clock_hz
+            event['ts'] = ts - event['dur']
+        elif phase == BEGIN:
+            event['ph'] = 'B'
+        elif phase == END:
+            event['ph'] = 'E'
+        else:
+            event['ph'] = 'i'
+            event['s'] = 't'
+        trace_events.append(event)
+
+    for cpu in range(2):
+        trace_events.append({'pid': 0, 'tid': cpu, 'ph': 'M', 'name': 'thread_name',
+                             'args': {'name': 'CPU{}'.format(cpu)}})
+
+    return {'traceEvents': trace_events, 'displayTimeUnit': 'ns'}
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Dumps the HydroZynq event trace as Chrome trace JSON')
+    parser.add_argument('output', help='Specifies the JSON file to write, which chrome://tracing or Perfetto opens')
+    parser.add_argument('--hostname', type=str, default='192.168.0.2', help='Specifies the hostname to bind to')
+    parser.add_argument('--hydrozynq', type=str, default='192.168.0.7', help='Specifies the address of the HydroZynq')
+    parser.add_argument('--restart', action='store_true', help='Starts a new trace once the dump is received')
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind((args.hostname, 3007))
+    sock.settimeout(2)
+
+    sock.sendto('trace:dump', (args.hydrozynq, 3000))
+    events, timer_clock_hz, cycle_clock_hz = receive_dump(sock)
+
+    with open(args.output, 'w') as f:
+        json.dump(to_chrome_trace(events, timer_clock_hz, cycle_clock_hz), f)
+    print('Wrote {} events to {}'.format(len(events), args.output))
+
+    if args.restart:
+        sock.sendto('trace:start', (args.hydrozynq, 3000))
@@ -0,0 +1,89 @@
+#!/usr/bin/python
+
+import argparse
+import struct
+import sys
+
+import numpy
+import usb.core
+
+import capture_file
+
+# The pid.codes test identifiers that the HydroZynq enumerates with, and its
+# bulk IN endpoint.
+VENDOR_ID = 0x1209
+PRODUCT_ID = 0x0001
+ENDPOINT = 0x81
+
+# Packet number, first element index, element size, element count, encoding,
+# transfer identifier and total number of elements in the transfer.
+HEADER_FORMAT = '<iIHHHHI'
+HEADER_SIZE = struct.calcsize(HEADER_FORMAT)
+
+ENCODING_RAW = 0
+
+# Each header is sent as its own short USB packet, so a read of one packet
+# returns exactly the header.
+MAX_PACKET = 512
+
+
+def read_exact(device, length, timeout):
+    """Reads a payload that may span several USB packets."""
+    data = bytearray()
+    while len(data) < length:
+        data += device.read(ENDPOINT, length - len(data), timeout)
+    return bytes(data)
+
+
+def receive_transfers(device, timeout):
+    """Yields the samples of each complete transfer streamed over USB."""
+    transfer_id = None
+    samples = None
+    received = 0
+
+    while True:
+        header = bytes(device.read(ENDPOINT, MAX_PACKET, timeout))
+        if len(header) != HEADER_SIZE:
+            print('Skipped {} bytes while looking for a header'.format(len(header)))
+            continue
+
+        (number, first, element_size, count, encoding, header_transfer_id,
+                total) = struct.unpack(HEADER_FORMAT, header)
+        payload = read_exact(device, element_size * count, timeout)
+        if encoding != ENCODING_RAW or element_size != 8:
+            continue
+
+        if number == 0 or header_transfer_id != transfer_id:
+            transfer_id = header_transfer_id
+            samples = numpy.zeros((total, 4), dtype=capture_file.SAMPLE_DTYPE)
+            received = 0
+
+        samples[first:first + count] = numpy.frombuffer(payload, dtype=capture_file.SAMPLE_DTYPE).reshape(-1, 4)
+        received += count
+        if received == total:
+            yield transfer_id, samples
+            transfer_id = None
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Receives HydroZynq captures over USB')
+    parser.add_argument('filename', help='Specifies the capture file to write')
+    parser.add_argument('--sampling-frequency', type=int, default=5000000,
+                        help='Specifies the sampling frequency recorded in the file')
+    parser.add_argument('--timeout', type=int, default=5000, help='Specifies the read timeout in ms')
+    args = parser.parse_args()
+
+    device = usb.core.find(idVendor=VENDOR_ID, idProduct=PRODUCT_ID)
+    if device is None:
+        sys.exit('No HydroZynq found on USB')
+    device.set_configuration()
+
+    writer = capture_file.CaptureWriter(args.filename, sampling_frequency=args.sampling_frequency)
+    try:
+        for transfer_id, samples in receive_transfers(device, args.timeout):
+            writer.append(samples, transfer_id=transfer_id)
+            print('Transfer {}: {} samples'.format(transfer_id, len(samples)))
+    except KeyboardInterrupt:
+        pass
+    finally:
+        writer.close()
@@ -20,7 +20,7 @@ result_t go()
      * Initialize SPI with the device.
      */
     spi_driver_t spi;
-    AbortIfNot(init_spi(&spi, SPI_BASE_ADDRESS), fail);
+    AbortIfNot(init_spi(&spi, SPI_BASE_ADDRESS, true), fail);
 
     /*
      * Initialize the ADC.
@@ -0,0 +1,265 @@
+#include "abort.h"
+#include "adc.h"
+#include "capture_arena.h"
+#include "db.h"
+#include "dma.h"
+#include "lwip/ip.h"
+#include "network_stack.h"
+#include "sample_util.h"
+#include "spi.h"
+#include "system.h"
+#include "system_params.h"
+#include "time_util.h"
+#include "types.h"
+#include "uart.h"
+
+#include "adc_dma_addresses.h"
+
+#include <string.h>
+
+/**
+ * The number of scatter-gather descriptors in the DMA capture ring, which
+ * matches the main application.
+ */
+#define DMA_SG_DESCRIPTORS 64
+
+/**
+ * The number of samples recorded for each setting.
+ */
+#define BENCH_CAPTURE_SAMPLES (1 << 20)
+
+/**
+ * The number of captures recorded for each setting.
+ */
+#define BENCH_CAPTURES 4
+
+/**
+ * The ADC clock dividers that are swept, from 5 Msps up to 25 Msps.
+ */
+static const uint32_t bench_clk_divs[] = {10, 8, 6, 5, 4, 3, 2};
+
+#define BENCH_NUM_CLK_DIVS (sizeof(bench_clk_divs) / sizeof(bench_clk_divs[0]))
+
+/**
+ * The packet lengths that are swept, in samples.
+ */
+static const uint32_t bench_packet_samples[] = {256, 512, 1024, 2048, 4096, 8192, 16384};
+
+#define BENCH_NUM_PACKET_SAMPLES (sizeof(bench_packet_samples) / sizeof(bench_packet_samples[0]))
+
+#ifndef DMA_COHERENCY
+#define DMA_COHERENCY DMA_CACHED
+#endif
+
+dma_engine_t dma;
+dma_descriptor_t dma_descriptors[DMA_SG_DESCRIPTORS];
+adc_driver_t adc;
+spi_driver_t adc_spi;
+capture_arena_t capture_arena;
+
+/**
+ * Defines the totals of the captures recorded for one setting.
+ */
+typedef struct bench_result_t
+{
+    uint64_t samples;
+    uint64_t dropped_samples;
+    uint64_t fifo_dropped_samples;
+    uint32_t discontinuities;
+    uint32_t short_packets;
+    uint32_t dma_errors;
+    uint32_t failed_captures;
+    tick_t streaming_ticks;
+    tick_t cache_maintenance_ticks;
+} bench_result_t;
+
+/**
+ * Records the captures of one setting.
+ *
+ * @param data The capture buffer.
+ * @param timing The timing record used to find dropped packets.
+ * @param[out] result The totals of the captures.
+ *
+ * @return Success or fail.
+ */
+static result_t run_setting(sample_t *data, sample_timing_t *timing, bench_result_t *result)
+{
+    const size_t samples_per_packet = adc.regs->samples_per_packet;
+    const size_t sample_count = BENCH_CAPTURE_SAMPLES / samples_per_packet * samples_per_packet;
+
+    memset(result, 0, sizeof(*result));
+
+    /*
+     * Packets already in the stream keep their previous length, so one
+     * packet is recorded and discarded after the change.
+     */
+    AbortIfNot(record(&dma, data, samples_per_packet, adc), fail);
+
+    sample_stats_t stats_before, stats_after;
+    for (size_t i = 0; i < BENCH_CAPTURES; ++i)
+    {
+        get_sample_stats(&stats_before);
+        const uint32_t errors_before = dma.errors;
+        const tick_t cache_before = dma.cache_maintenance_ticks;
+
+        capture_t capture;
+        result_t ret = start_capture(&capture, &dma, data, sample_count, adc);
+        if (ret == success)
+        {
+            ret = wait_for_capture(&capture);
+        }
+        AbortIfNot(set_dma_callback(&dma, NULL, NULL), fail);
+
+        get_sample_stats(&stats_after);
+        result->short_packets += stats_after.short_packets - stats_before.short_packets;
+        result->fifo_dropped_samples += stats_after.dropped_samples - stats_before.dropped_samples;
+        result->dma_errors += dma.errors - errors_before;
+        result->cache_maintenance_ticks += dma.cache_maintenance_ticks - cache_before;
+
+        if (ret != success)
+        {
+            result->failed_captures++;
+            AbortIfNot(reset_dma_sg_ring(&dma), fail);
+            continue;
+        }
+
+        /*
+         * The first packet waited for the stream to reach the start of a
+         * packet, so the sustained rate is measured from its arrival.
+         */
+        result->samples += sample_count - samples_per_packet;
+        result->streaming_ticks += capture.last_progress - capture.first_packet_time;
+
+        AbortIfNot(extract_timestamps(timing, data, sample_count, samples_per_packet, capture.last_progress), fail);
+        result->discontinuities += timing->discontinuities;
+        result->dropped_samples += timing->dropped_samples;
+    }
+
+    return success;
+}
+
+/**
+ * Prints the totals of one setting.
+ *
+ * @param result The totals to print.
+ *
+ * @return None.
+ */
+static void print_result(const bench_result_t *result)
+{
+    const float seconds = ticks_to_seconds(result->streaming_ticks);
+    const float msps = (seconds > 0)? result->samples / seconds / 1000000 : 0;
+    const float cache_percent = (result->streaming_ticks)?
+        100.0f * result->cache_maintenance_ticks / result->streaming_ticks : 0;
+    const uint64_t expected = result->samples + result->dropped_samples;
+    const float drop_ppm = (expected)? 1000000.0f * result->dropped_samples / expected : 0;
+
+    dbprintf("clk_div %d (%d Hz), %d samples/packet: %d.%03d Msps, "
+            "%d ppm dropped in %d gaps, %d dropped by the FIFO, %d short packets, %d DMA errors, "
+            "%d failed captures, %d.%02d%% cache maintenance\n",
+            adc.regs->clk_div,
+            get_adc_sampling_frequency(&adc),
+            adc.regs->samples_per_packet,
+            (int)msps, (int)(msps * 1000) % 1000,
+            (int)drop_ppm,
+            result->discontinuities,
+            (int)result->fifo_dropped_samples,
+            result->short_packets,
+            result->dma_errors,
+            result->failed_captures,
+            (int)cache_percent, (int)(cache_percent * 100) % 100);
+    flush_log();
+}
+
+/**
+ * Sweeps the sample rate and packet length of the DMA capture path.
+ *
+ * @return Success or fail.
+ */
+result_t go()
+{
+    AbortIfNot(init_system(), fail);
+    AbortIfNot(init_capture_arena(&capture_arena), fail);
+
+    struct ip_addr our_ip, netmask, gateway;
+    IP4_ADDR(&our_ip, 192, 168, 0, 7);
+    IP4_ADDR(&netmask, 255, 255, 255, 0);
+    IP4_ADDR(&gateway, 192, 168, 1, 1);
+
+    macaddr_t mac_address = {
+        .addr = {0x00, 0x0a, 0x35, 0x00, 0x01, 0x02}
+    };
+
+    AbortIfNot(init_network_stack(our_ip, netmask, gateway, mac_address), fail);
+    AbortIfNot(dbinit(), fail);
+    dbprintf("Beginning HydroZynq DMA benchmark\n");
+
+    AbortIfNot(initialize_dma(&dma, DMA_BASE_ADDRESS), fail);
+    AbortIfNot(set_dma_length_width(&dma, DMA_LENGTH_WIDTH), fail);
+    AbortIfNot(set_dma_coherency(&dma, DMA_COHERENCY), fail);
+    AbortIfNot(dma_sg_included(&dma), fail);
+    AbortIfNot(init_dma_sg_ring(&dma, dma_descriptors, DMA_SG_DESCRIPTORS), fail);
+    AbortIfNot(enable_dma_interrupts(&dma, DMA_S2MM_IRQ_ID), fail);
+    AbortIfNot(enable_uart_interrupts(), fail);
+
+    AbortIfNot(init_spi(&adc_spi, SPI_BASE_ADDRESS, true), fail);
+    AbortIfNot(init_adc(&adc, &adc_spi, ADC_BASE_ADDRESS, false, false), fail);
+    adc.regs->stream_control = ADC_STREAM_TIMESTAMPS;
+
+    /*
+     * Buffers are allocated as in the main application so the cost of cache
+     * maintenance matches.
+     */
+    sample_t *data;
+    if (dma.coherency == DMA_NONCACHEABLE)
+    {
+        data = capture_arena_alloc_mapped(&capture_arena,
+                                          BENCH_CAPTURE_SAMPLES * sizeof(sample_t),
+                                          CAPTURE_MEMORY_WRITE_COMBINING);
+    }
+    else
+    {
+        data = capture_arena_alloc(&capture_arena, BENCH_CAPTURE_SAMPLES * sizeof(sample_t));
+    }
+    AbortIfNot(data, fail);
+
+    const size_t max_packets = BENCH_CAPTURE_SAMPLES / bench_packet_samples[0];
+    uint64_t *timestamps = capture_arena_alloc(&capture_arena, max_packets * sizeof(uint64_t));
+    AbortIfNot(timestamps, fail);
+
+    sample_timing_t timing;
+    AbortIfNot(init_sample_timing(&timing, timestamps, max_packets), fail);
+
+    while (1)
+    {
+        for (size_t i = 0; i < BENCH_NUM_CLK_DIVS; ++i)
+        {
+            adc.regs->clk_div = bench_clk_divs[i];
+            for (size_t j = 0; j < BENCH_NUM_PACKET_SAMPLES; ++j)
+            {
+                const uint32_t samples_per_packet = bench_packet_samples[j];
+                if (samples_per_packet * sizeof(sample_t) > dma.max_transfer_bytes)
+                {
+                    continue;
+                }
+
+                adc.regs->samples_per_packet = samples_per_packet;
+
+                bench_result_t result;
+                AbortIfNot(run_setting(data, &timing, &result), fail);
+                print_result(&result);
+                dispatch_network_stack();
+            }
+        }
+
+        dbprintf("DMA benchmark complete\n");
+        flush_log();
+    }
+}
+
+int main()
+{
+    go();
+
+    while (1);
+}
@@ -21,7 +21,7 @@ result_t go()
     AbortIfNot(initialize_dma(&dma, DMA_BASE_ADDRESS), fail);
 
     spi_driver_t adc_spi;
-    AbortIfNot(init_spi(&adc_spi, SPI_BASE_ADDRESS), fail);
+    AbortIfNot(init_spi(&adc_spi, SPI_BASE_ADDRESS, true), fail);
 
     adc_driver_t adc;
     AbortIfNot(init_adc(&adc, &adc_spi, ADC_BASE_ADDRESS, false, true), fail);
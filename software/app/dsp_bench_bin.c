@@ -0,0 +1,386 @@
+#include "abort.h"
+#include "capture_arena.h"
+#include "correlation_util.h"
+#include "db.h"
+#include "lwip/ip.h"
+#include "network_stack.h"
+#include "profile.h"
+#include "sample_ops.h"
+#include "system.h"
+#include "system_params.h"
+#include "time_util.h"
+#include "types.h"
+
+#include "xil_cache.h"
+
+#include <math.h>
+#include <string.h>
+
+#define PI 3.14159265358979323846
+
+/**
+ * The sampling frequency of the synthetic captures.
+ */
+#define BENCH_SAMPLING_FREQUENCY 5000000
+
+/**
+ * The number of timed runs of every kernel at each size.
+ */
+#define BENCH_REPEATS 10
+
+/**
+ * The offset, ping amplitude, and noise amplitude of the synthetic captures
+ * in ADC counts.
+ */
+#define BENCH_OFFSET 8192
+#define BENCH_PING_AMPLITUDE 2000
+#define BENCH_NOISE_AMPLITUDE 50
+
+/**
+ * The capture sizes that every kernel is run over, from a size that fits in
+ * the L1 data cache to a full ping period at the default sampling frequency.
+ */
+static const size_t bench_sizes[] = {2048, 16384, 131072, 1048576};
+
+#define BENCH_NUM_SIZES (sizeof(bench_sizes) / sizeof(bench_sizes[0]))
+
+/**
+ * The delay of each synthetic channel in samples.
+ */
+static const int32_t bench_delays[4] = {0, 3, 7, 5};
+
+/**
+ * The highpass filter applied by the main application.
+ */
+static filter_coefficients_t highpass_iir[5] = {
+    {{0.976572753292004, -1.953145506584008, 0.976572753292004,
+        1.000000000000000, -1.998354115074282, 0.998926104509836}},
+    {{0.975206721477597, -1.950413442955194, 0.975206721477597,
+        1.000000000000000, -1.995495119158081, 0.996193697294377}},
+    {{0.972451482822301, -1.944902965644602, 0.972451482822301,
+        1.000000000000000, -1.989660620860693, 0.990750529959661}},
+    {{0.963669622248601, -1.927339244497202, 0.963669622248601,
+        1.000000000000000, -1.970992420143032, 0.973473065140308}},
+    {{0.906313647059524, -1.812627294119048, 0.906313647059524,
+        1.000000000000000, -1.848974099452832, 0.860723515924862}}};
+
+typedef enum bench_kernel_t
+{
+    BENCH_NORMALIZE = 0,
+    BENCH_FILTER,
+    BENCH_DEINTERLEAVE,
+    BENCH_TRUNCATE,
+    BENCH_CORRELATE,
+    BENCH_CORRELATE_PAIRS,
+    BENCH_KERNELS
+} bench_kernel_t;
+
+static const char *bench_kernel_names[BENCH_KERNELS] = {
+    "normalize",
+    "filter",
+    "deinterleave",
+    "truncate",
+    "cross_correlate",
+    "cross_correlate_pairs"};
+
+/**
+ * Defines the buffers that the kernels run on.
+ */
+typedef struct bench_buffers_t
+{
+    sample_t *source;
+    sample_t *data;
+    planar_samples_t planar;
+    correlation_t *correlations;
+    correlation_t *cross_correlations;
+    size_t correlation_len;
+} bench_buffers_t;
+
+/**
+ * Defines the totals of the timed runs of a kernel.
+ */
+typedef struct bench_timing_t
+{
+    tick_t ticks;
+    uint64_t cycles;
+    uint64_t data_cache_misses;
+    size_t samples;
+} bench_timing_t;
+
+capture_arena_t capture_arena;
+
+/**
+ * Operating parameters of the kernels.
+ */
+HydroZynqParams params;
+
+/**
+ * Generates a capture with a ping in the middle on top of an offset and noise.
+ *
+ * @param[out] data The samples to generate.
+ * @param len The number of samples.
+ *
+ * @return None.
+ */
+static void generate_capture(sample_t *data, const size_t len)
+{
+    const size_t ping_start = len / 2;
+    const float w = 2 * PI * (float)INITIAL_PING_FREQUENCY_HZ / BENCH_SAMPLING_FREQUENCY;
+
+    uint32_t noise = 1;
+    for (size_t i = 0; i < len; ++i)
+    {
+        for (size_t k = 0; k < 4; ++k)
+        {
+            noise = noise * 1664525 + 1013904223;
+
+            const int32_t n = (int32_t)i - (int32_t)ping_start - bench_delays[k];
+            float value = BENCH_OFFSET + BENCH_NOISE_AMPLITUDE * ((float)noise / UINT32_MAX * 2 - 1);
+            if (n >= 0)
+            {
+                value += BENCH_PING_AMPLITUDE * sinf(w * n);
+            }
+
+            data[i].sample[k] = value;
+        }
+    }
+}
+
+/**
+ * Runs a kernel once.
+ *
+ * @note Kernels that correlate first locate the ping in a normalized copy of
+ *       the capture, which is not timed.
+ *
+ * @param kernel The kernel to run.
+ * @param buffers The buffers to run the kernel on.
+ * @param len The number of samples in the capture.
+ * @param cold Specified true if the data cache is cleaned and invalidated
+ *        before the kernel is run.
+ * @param[in,out] timing The totals to add the run to.
+ *
+ * @return Success or fail.
+ */
+static result_t run_kernel(const bench_kernel_t kernel,
+                           bench_buffers_t *buffers,
+                           const size_t len,
+                           const bool cold,
+                           bench_timing_t *timing)
+{
+    memcpy(buffers->data, buffers->source, len * sizeof(sample_t));
+
+    channel_view_t view;
+    size_t start_index = 0, end_index = 0;
+    bool located = false;
+    if (kernel == BENCH_TRUNCATE ||
+        kernel == BENCH_CORRELATE ||
+        kernel == BENCH_CORRELATE_PAIRS)
+    {
+        AbortIfNot(normalize(buffers->data, len), fail);
+        interleaved_view(buffers->data, len, &view);
+    }
+
+    if (kernel == BENCH_CORRELATE || kernel == BENCH_CORRELATE_PAIRS)
+    {
+        AbortIfNot(truncate_channels(&view,
+                                     &start_index,
+                                     &end_index,
+                                     NULL,
+                                     &located,
+                                     NULL,
+                                     params,
+                                     NULL,
+                                     BENCH_SAMPLING_FREQUENCY), fail);
+        AbortIfNot(located, fail);
+        AbortIfNot(end_index > start_index, fail);
+        interleaved_view(&buffers->data[start_index], end_index - start_index, &view);
+    }
+
+    if (cold)
+    {
+        Xil_DCacheFlush();
+    }
+
+    size_t samples = len;
+    size_t num_correlations = 0;
+    correlation_result_t result;
+
+    profile_mark_t start, end;
+    const tick_t start_time = get_system_time();
+    profile_begin(&start);
+    switch (kernel)
+    {
+        case BENCH_NORMALIZE:
+            AbortIfNot(normalize(buffers->data, len), fail);
+            break;
+
+        case BENCH_FILTER:
+            AbortIfNot(filter(buffers->data, len, highpass_iir, 5), fail);
+            break;
+
+        case BENCH_DEINTERLEAVE:
+            AbortIfNot(deinterleave_samples(buffers->data, len, &buffers->planar), fail);
+            break;
+
+        case BENCH_TRUNCATE:
+            AbortIfNot(truncate_channels(&view,
+                                         &start_index,
+                                         &end_index,
+                                         NULL,
+                                         &located,
+                                         NULL,
+                                         params,
+                                         NULL,
+                                         BENCH_SAMPLING_FREQUENCY), fail);
+            samples = (located)? end_index : len;
+            break;
+
+        case BENCH_CORRELATE:
+        case BENCH_CORRELATE_PAIRS:
+            AbortIfNot(cross_correlate_pairs(&view,
+                                             0,
+                                             NULL,
+                                             buffers->correlations,
+                                             (kernel == BENCH_CORRELATE_PAIRS)? buffers->cross_correlations : NULL,
+                                             buffers->correlation_len,
+                                             &num_correlations,
+                                             &result,
+                                             BENCH_SAMPLING_FREQUENCY), fail);
+            samples = view.len;
+            break;
+
+        default:
+            return fail;
+    }
+    profile_begin(&end);
+    const tick_t duration = get_system_time() - start_time;
+
+    timing->ticks += duration;
+    timing->cycles += end.cycles - start.cycles;
+    timing->data_cache_misses += end.data_cache_misses - start.data_cache_misses;
+    timing->samples += samples;
+
+    return success;
+}
+
+/**
+ * Benchmarks every kernel over a capture.
+ *
+ * @param buffers The buffers to run the kernels on.
+ * @param len The number of samples in the capture.
+ *
+ * @return Success or fail.
+ */
+static result_t run_benchmarks(bench_buffers_t *buffers, const size_t len)
+{
+    generate_capture(buffers->source, len);
+
+    for (size_t kernel = 0; kernel < BENCH_KERNELS; ++kernel)
+    {
+        for (size_t cache = 0; cache < 2; ++cache)
+        {
+            const bool cold = (cache == 1)? true : false;
+
+            /*
+             * One untimed run warms the caches and branch predictors.
+             */
+            bench_timing_t timing;
+            memset(&timing, 0, sizeof(timing));
+            AbortIfNot(run_kernel(kernel, buffers, len, cold, &timing), fail);
+
+            memset(&timing, 0, sizeof(timing));
+            for (size_t r = 0; r < BENCH_REPEATS; ++r)
+            {
+                AbortIfNot(run_kernel(kernel, buffers, len, cold, &timing), fail);
+            }
+
+            const float seconds = ticks_to_seconds(timing.ticks);
+            const float msps = (seconds > 0)? timing.samples / seconds / 1000000 : 0;
+            const float cycles_per_sample = (float)timing.cycles / timing.samples;
+            const float misses_per_sample = (float)timing.data_cache_misses / timing.samples;
+            dbprintf("%s %d %s: %d.%03d Msps, %d.%02d cycles/sample, %d.%03d misses/sample\n",
+                    bench_kernel_names[kernel],
+                    len,
+                    (cold)? "cold" : "warm",
+                    (int)msps, (int)(msps * 1000) % 1000,
+                    (int)cycles_per_sample, (int)(cycles_per_sample * 100) % 100,
+                    (int)misses_per_sample, (int)(misses_per_sample * 1000) % 1000);
+            flush_log();
+        }
+    }
+
+    return success;
+}
+
+/**
+ * Runs the DSP benchmark.
+ *
+ * @return Success or fail.
+ */
+result_t go()
+{
+    AbortIfNot(init_system(), fail);
+    init_profiler();
+    AbortIfNot(init_capture_arena(&capture_arena), fail);
+
+    struct ip_addr our_ip, netmask, gateway;
+    IP4_ADDR(&our_ip, 192, 168, 0, 7);
+    IP4_ADDR(&netmask, 255, 255, 255, 0);
+    IP4_ADDR(&gateway, 192, 168, 1, 1);
+
+    macaddr_t mac_address = {
+        .addr = {0x00, 0x0a, 0x35, 0x00, 0x01, 0x02}
+    };
+
+    AbortIfNot(init_network_stack(our_ip, netmask, gateway, mac_address), fail);
+    AbortIfNot(dbinit(), fail);
+    dbprintf("Beginning HydroZynq DSP benchmark\n");
+
+    memset(&params, 0, sizeof(params));
+    params.ping_threshold = INITIAL_ADC_THRESHOLD;
+    params.ping_frequency = INITIAL_PING_FREQUENCY_HZ;
+    params.pre_ping_duration = micros_to_ticks(100);
+    params.post_ping_duration = micros_to_ticks(50);
+
+    /*
+     * Allocate buffers for the largest capture.
+     */
+    const size_t max_len = bench_sizes[BENCH_NUM_SIZES - 1];
+    bench_buffers_t buffers;
+    buffers.source = capture_arena_alloc(&capture_arena, max_len * sizeof(sample_t));
+    buffers.data = capture_arena_alloc(&capture_arena, max_len * sizeof(sample_t));
+    AbortIfNot(buffers.source, fail);
+    AbortIfNot(buffers.data, fail);
+    for (size_t k = 0; k < 4; ++k)
+    {
+        buffers.planar.channel[k] = capture_arena_alloc(&capture_arena, max_len * sizeof(analog_sample_t));
+        AbortIfNot(buffers.planar.channel[k], fail);
+    }
+    buffers.planar.capacity = max_len;
+    buffers.planar.len = 0;
+
+    buffers.correlation_len = correlation_capacity(BENCH_SAMPLING_FREQUENCY);
+    buffers.correlations = capture_arena_alloc(&capture_arena, buffers.correlation_len * sizeof(correlation_t));
+    buffers.cross_correlations = capture_arena_alloc(&capture_arena, buffers.correlation_len * sizeof(correlation_t));
+    AbortIfNot(buffers.correlations, fail);
+    AbortIfNot(buffers.cross_correlations, fail);
+
+    while (1)
+    {
+        for (size_t i = 0; i < BENCH_NUM_SIZES; ++i)
+        {
+            AbortIfNot(run_benchmarks(&buffers, bench_sizes[i]), fail);
+            dispatch_network_stack();
+        }
+
+        dbprintf("DSP benchmark complete\n");
+        flush_log();
+    }
+}
+
+int main()
+{
+    go();
+
+    while (1);
+}
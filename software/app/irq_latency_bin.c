@@ -0,0 +1,510 @@
+#include "abort.h"
+#include "adc.h"
+#include "capture_arena.h"
+#include "db.h"
+#include "dma.h"
+#include "lwip/ip.h"
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+#include "network_stack.h"
+#include "profile.h"
+#include "regs/system_registers.h"
+#include "sample_util.h"
+#include "spi.h"
+#include "system.h"
+#include "system_params.h"
+#include "time_util.h"
+#include "types.h"
+#include "uart.h"
+#include "udp.h"
+
+#include "adc_dma_addresses.h"
+
+#include <string.h>
+
+/**
+ * The number of scatter-gather descriptors in the DMA capture ring, which
+ * matches the main application.
+ */
+#define DMA_SG_DESCRIPTORS 64
+
+/**
+ * The period of the timer interrupt and the time each load is measured over.
+ */
+#define IRQ_BENCH_PERIOD_US 50
+#define IRQ_BENCH_DURATION_MS 10000
+
+/**
+ * The number of bins of each histogram and the width of each bin. The last
+ * bin also holds every longer latency or larger deviation.
+ */
+#define IRQ_BENCH_BINS 64
+#define IRQ_BENCH_LATENCY_BIN_NS 100
+#define IRQ_BENCH_JITTER_BIN_NS 100
+
+/**
+ * The port that the transmit load is sent to on the host and that inbound
+ * load is discarded on, and the length of each transmitted datagram.
+ */
+#define IRQ_BENCH_PORT 3013
+#define IRQ_BENCH_DATAGRAM_BYTES 1472
+
+/**
+ * The packet length of the captures that load the DMA path and the length of
+ * each capture.
+ */
+#define IRQ_BENCH_PACKET_SAMPLES 4096
+#define IRQ_BENCH_CAPTURE_SAMPLES (1 << 20)
+
+#ifndef DMA_COHERENCY
+#define DMA_COHERENCY DMA_CACHED
+#endif
+
+/**
+ * Defines a load that the latency is measured under. A clock divider of zero
+ * runs no captures and a rate of zero sends no datagrams.
+ */
+typedef struct bench_load_t
+{
+    const char *name;
+    uint32_t clk_div;
+    uint32_t transmit_bytes_per_second;
+} bench_load_t;
+
+static const bench_load_t bench_loads[] = {
+    {"idle", 0, 0},
+    {"DMA 5 Msps", 10, 0},
+    {"DMA 25 Msps", 2, 0},
+    {"EMAC 10 MB/s", 0, 10000000},
+    {"EMAC 40 MB/s", 0, 40000000},
+    {"DMA 25 Msps and EMAC 40 MB/s", 2, 40000000},
+};
+
+#define BENCH_NUM_LOADS (sizeof(bench_loads) / sizeof(bench_loads[0]))
+
+dma_engine_t dma;
+dma_descriptor_t dma_descriptors[DMA_SG_DESCRIPTORS];
+adc_driver_t adc;
+spi_driver_t adc_spi;
+capture_arena_t capture_arena;
+
+/**
+ * Defines a histogram of durations in ticks of its own clock.
+ */
+typedef struct histogram_t
+{
+    uint32_t bin_ticks;
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t bins[IRQ_BENCH_BINS];
+} histogram_t;
+
+/**
+ * The histograms of the latency from the timer expiring to the entry of its
+ * handler, in timer ticks, and of the deviation of the interval between
+ * entries from the timer period, in CPU cycles. Both are written by the
+ * handler while the measurement runs.
+ */
+static volatile histogram_t latency;
+static volatile histogram_t jitter;
+static volatile uint32_t last_entry_cycles;
+static volatile bool have_last_entry = false;
+
+/**
+ * The number of datagrams of inbound load discarded.
+ */
+static volatile uint32_t received_datagrams = 0;
+
+/**
+ * The datagram of the transmit load.
+ */
+static uint8_t datagram[IRQ_BENCH_DATAGRAM_BYTES];
+
+/**
+ * Reads the cycle counter of the calling core.
+ *
+ * @return The number of cycles counted.
+ */
+static inline uint32_t read_cycle_counter()
+{
+    uint32_t value;
+    __asm volatile("mrc p15, 0, %0, c9, c13, 0" : "=r"(value));
+
+    return value;
+}
+
+/**
+ * Empties a histogram.
+ *
+ * @param histogram The histogram to empty.
+ * @param bin_ticks The width of each bin.
+ *
+ * @return None.
+ */
+static void reset_histogram(volatile histogram_t *histogram, const uint32_t bin_ticks)
+{
+    histogram->bin_ticks = bin_ticks;
+    histogram->count = 0;
+    histogram->min = UINT32_MAX;
+    histogram->max = 0;
+    histogram->sum = 0;
+    for (size_t i = 0; i < IRQ_BENCH_BINS; ++i)
+    {
+        histogram->bins[i] = 0;
+    }
+}
+
+/**
+ * Adds a duration to a histogram.
+ *
+ * @param histogram The histogram.
+ * @param value The duration.
+ *
+ * @return None.
+ */
+static inline void add_to_histogram(volatile histogram_t *histogram, const uint32_t value)
+{
+    const uint32_t bin = value / histogram->bin_ticks;
+    histogram->bins[(bin < IRQ_BENCH_BINS)? bin : IRQ_BENCH_BINS - 1]++;
+    histogram->count++;
+    histogram->sum += value;
+    if (value < histogram->min)
+    {
+        histogram->min = value;
+    }
+    if (value > histogram->max)
+    {
+        histogram->max = value;
+    }
+}
+
+/**
+ * Records the latency of a timer interrupt.
+ *
+ * @note The counter is read first. It counts down from the load value at the
+ *       rate of the global timer and reloads as it expires, so the ticks
+ *       elapsed since it expired are the load value less the count.
+ *
+ * @param arg Unused.
+ *
+ * @return None.
+ */
+static void timer_handler(void *arg)
+{
+    const uint32_t count = private_timer_regs->Counter_Register;
+    const uint32_t cycles = read_cycle_counter();
+    private_timer_regs->Interrupt_Status_Register = PRIVATE_TIMER_EVENT_FLAG;
+
+    add_to_histogram(&latency, private_timer_regs->Load_Register - count);
+
+    if (have_last_entry)
+    {
+        const int32_t period_cycles = (private_timer_regs->Load_Register + 1) *
+            (ARM_CLK_PLL / CPU_CLOCK_HZ);
+        const int32_t deviation = (int32_t)(cycles - last_entry_cycles) - period_cycles;
+        add_to_histogram(&jitter, (deviation < 0)? -deviation : deviation);
+    }
+    last_entry_cycles = cycles;
+    have_last_entry = true;
+}
+
+/**
+ * Discards a datagram of inbound load.
+ *
+ * @return None.
+ */
+static void receive_load(void *arg, struct udp_pcb *upcb, struct pbuf *p, struct ip_addr *addr, uint16_t port)
+{
+    received_datagrams++;
+    pbuf_free(p);
+}
+
+/**
+ * Finds the duration below which a fraction of a histogram lies.
+ *
+ * @param histogram The histogram.
+ * @param per_mille The fraction, in thousandths.
+ *
+ * @return The upper edge of the bin that reaches the fraction, or the largest
+ *         duration if that is the last bin.
+ */
+static uint32_t histogram_percentile(const volatile histogram_t *histogram, const uint32_t per_mille)
+{
+    const uint64_t target = ((uint64_t)histogram->count * per_mille + 999) / 1000;
+    uint64_t total = 0;
+    for (size_t i = 0; i < IRQ_BENCH_BINS - 1; ++i)
+    {
+        total += histogram->bins[i];
+        if (total >= target)
+        {
+            const uint32_t edge = (i + 1) * histogram->bin_ticks;
+            return (edge < histogram->max)? edge : histogram->max;
+        }
+    }
+
+    return histogram->max;
+}
+
+/**
+ * Prints the summary and the occupied bins of a histogram.
+ *
+ * @param label The quantity the histogram holds.
+ * @param histogram The histogram.
+ * @param clock_hz The rate of the clock the histogram counts.
+ *
+ * @return None.
+ */
+static void print_histogram(const char *label,
+                            const volatile histogram_t *histogram,
+                            const uint32_t clock_hz)
+{
+    const uint32_t ns_per_tick_x1000 = 1000000000000ull / clock_hz;
+    const uint32_t mean = (histogram->count)? histogram->sum / histogram->count : 0;
+    const uint32_t min = (histogram->count)? histogram->min : 0;
+
+    dbprintf("  %s: %d samples, min %d ns, mean %d ns, p50 %d ns, p99 %d ns, "
+            "p99.9 %d ns, max %d ns\n",
+            label,
+            histogram->count,
+            (int)((uint64_t)min * ns_per_tick_x1000 / 1000),
+            (int)((uint64_t)mean * ns_per_tick_x1000 / 1000),
+            (int)((uint64_t)histogram_percentile(histogram, 500) * ns_per_tick_x1000 / 1000),
+            (int)((uint64_t)histogram_percentile(histogram, 990) * ns_per_tick_x1000 / 1000),
+            (int)((uint64_t)histogram_percentile(histogram, 999) * ns_per_tick_x1000 / 1000),
+            (int)((uint64_t)histogram->max * ns_per_tick_x1000 / 1000));
+
+    for (size_t i = 0; i < IRQ_BENCH_BINS; ++i)
+    {
+        if (!histogram->bins[i])
+        {
+            continue;
+        }
+
+        const uint32_t start_ns = (uint64_t)i * histogram->bin_ticks * ns_per_tick_x1000 / 1000;
+        if (i == IRQ_BENCH_BINS - 1)
+        {
+            dbprintf("    >= %d ns: %d\n", start_ns, histogram->bins[i]);
+        }
+        else
+        {
+            const uint32_t end_ns = (uint64_t)(i + 1) * histogram->bin_ticks * ns_per_tick_x1000 / 1000;
+            dbprintf("    %d-%d ns: %d\n", start_ns, end_ns, histogram->bins[i]);
+        }
+        flush_log();
+    }
+}
+
+/**
+ * Measures the latency of the timer interrupt under one load.
+ *
+ * @param load The load to apply.
+ * @param socket The socket that the transmit load is sent over.
+ * @param data The capture buffer.
+ *
+ * @return Success or fail.
+ */
+static result_t run_load(const bench_load_t *load, udp_socket_t *socket, sample_t *data)
+{
+    if (load->clk_div)
+    {
+        adc.regs->clk_div = load->clk_div;
+
+        /*
+         * Packets already in the stream keep their previous length, so one
+         * packet is recorded and discarded after the change.
+         */
+        AbortIfNot(record(&dma, data, IRQ_BENCH_PACKET_SAMPLES, adc), fail);
+    }
+
+    const size_t sample_count = IRQ_BENCH_CAPTURE_SAMPLES / IRQ_BENCH_PACKET_SAMPLES * IRQ_BENCH_PACKET_SAMPLES;
+    const tick_t interval = (load->transmit_bytes_per_second)?
+        (uint64_t)IRQ_BENCH_DATAGRAM_BYTES * CPU_CLOCK_HZ / load->transmit_bytes_per_second : 0;
+
+    /*
+     * The timer is stopped while the histograms are emptied so that the
+     * handler does not race the reset.
+     */
+    private_timer_regs->Control_Register = 0;
+    private_timer_regs->Interrupt_Status_Register = PRIVATE_TIMER_EVENT_FLAG;
+    reset_histogram(&latency, ns_to_ticks(IRQ_BENCH_LATENCY_BIN_NS));
+    reset_histogram(&jitter, (uint64_t)IRQ_BENCH_JITTER_BIN_NS * ARM_CLK_PLL / 1000000000);
+    have_last_entry = false;
+    const uint32_t received_before = received_datagrams;
+
+    private_timer_regs->Load_Register = micros_to_ticks(IRQ_BENCH_PERIOD_US) - 1;
+    private_timer_regs->Control_Register = PRIVATE_TIMER_ENABLE |
+                                           PRIVATE_TIMER_AUTO_RELOAD |
+                                           PRIVATE_TIMER_IRQ_ENABLE;
+
+    capture_t capture;
+    bool capturing = false;
+    uint32_t captures = 0, capture_failures = 0, sent = 0;
+    const tick_t start = get_system_time();
+    tick_t next_send = start;
+    while (get_system_time() - start < ms_to_ticks(IRQ_BENCH_DURATION_MS))
+    {
+        if (load->clk_div && !capturing)
+        {
+            AbortIfNot(start_capture(&capture, &dma, data, sample_count, adc), fail);
+            capturing = true;
+        }
+
+        if (capturing && capture_done(&capture))
+        {
+            const result_t ret = wait_for_capture(&capture);
+            AbortIfNot(set_dma_callback(&dma, NULL, NULL), fail);
+            if (ret == success)
+            {
+                captures++;
+            }
+            else
+            {
+                capture_failures++;
+                AbortIfNot(reset_dma_sg_ring(&dma), fail);
+            }
+            capturing = false;
+        }
+
+        /*
+         * Datagrams are paced by their scheduled send time so that a late
+         * send is followed by a burst that restores the average rate.
+         */
+        if (interval && get_system_time() >= next_send)
+        {
+            if (send_udp(socket, (char *)datagram, sizeof(datagram)) == success)
+            {
+                sent++;
+            }
+            next_send += interval;
+        }
+
+        dispatch_network_stack();
+    }
+    const tick_t elapsed = get_system_time() - start;
+
+    private_timer_regs->Control_Register = 0;
+    private_timer_regs->Interrupt_Status_Register = PRIVATE_TIMER_EVENT_FLAG;
+
+    if (capturing)
+    {
+        const result_t ret = wait_for_capture(&capture);
+        AbortIfNot(set_dma_callback(&dma, NULL, NULL), fail);
+        if (ret != success)
+        {
+            capture_failures++;
+            AbortIfNot(reset_dma_sg_ring(&dma), fail);
+        }
+    }
+
+    const uint32_t sent_kbps = (uint64_t)sent * IRQ_BENCH_DATAGRAM_BYTES / 1000 *
+        CPU_CLOCK_HZ / elapsed;
+    dbprintf("%s: %d us timer period, %d captures, %d failed, %d KB/s sent, %d datagrams received\n",
+            load->name,
+            IRQ_BENCH_PERIOD_US,
+            captures,
+            capture_failures,
+            (int)sent_kbps,
+            received_datagrams - received_before);
+    print_histogram("Entry latency", &latency, CPU_CLOCK_HZ);
+    print_histogram("Period jitter", &jitter, ARM_CLK_PLL);
+    flush_log();
+
+    return success;
+}
+
+/**
+ * Measures the latency and jitter of a periodic timer interrupt while the
+ * DMA capture path and the network interface are loaded.
+ *
+ * @note Inbound load may be sent to IRQ_BENCH_PORT by the host, for example
+ *       with a UDP stream from iperf, and is counted and discarded.
+ *
+ * @return Success or fail.
+ */
+result_t go()
+{
+    AbortIfNot(init_system(), fail);
+    AbortIfNot(init_capture_arena(&capture_arena), fail);
+
+    struct ip_addr our_ip, netmask, gateway;
+    IP4_ADDR(&our_ip, 192, 168, 0, 7);
+    IP4_ADDR(&netmask, 255, 255, 255, 0);
+    IP4_ADDR(&gateway, 192, 168, 1, 1);
+
+    macaddr_t mac_address = {
+        .addr = {0x00, 0x0a, 0x35, 0x00, 0x01, 0x02}
+    };
+
+    AbortIfNot(init_network_stack(our_ip, netmask, gateway, mac_address), fail);
+    AbortIfNot(dbinit(), fail);
+    dbprintf("Beginning HydroZynq interrupt latency benchmark\n");
+
+    AbortIfNot(initialize_dma(&dma, DMA_BASE_ADDRESS), fail);
+    AbortIfNot(set_dma_length_width(&dma, DMA_LENGTH_WIDTH), fail);
+    AbortIfNot(set_dma_coherency(&dma, DMA_COHERENCY), fail);
+    AbortIfNot(dma_sg_included(&dma), fail);
+    AbortIfNot(init_dma_sg_ring(&dma, dma_descriptors, DMA_SG_DESCRIPTORS), fail);
+    AbortIfNot(enable_dma_interrupts(&dma, DMA_S2MM_IRQ_ID), fail);
+    AbortIfNot(enable_uart_interrupts(), fail);
+
+    AbortIfNot(init_spi(&adc_spi, SPI_BASE_ADDRESS, true), fail);
+    AbortIfNot(init_adc(&adc, &adc_spi, ADC_BASE_ADDRESS, false, false), fail);
+    adc.regs->stream_control = ADC_STREAM_TIMESTAMPS;
+    adc.regs->samples_per_packet = IRQ_BENCH_PACKET_SAMPLES;
+
+    sample_t *data;
+    if (dma.coherency == DMA_NONCACHEABLE)
+    {
+        data = capture_arena_alloc_mapped(&capture_arena,
+                                          IRQ_BENCH_CAPTURE_SAMPLES * sizeof(sample_t),
+                                          CAPTURE_MEMORY_WRITE_COMBINING);
+    }
+    else
+    {
+        data = capture_arena_alloc(&capture_arena, IRQ_BENCH_CAPTURE_SAMPLES * sizeof(sample_t));
+    }
+    AbortIfNot(data, fail);
+
+    for (size_t i = 0; i < sizeof(datagram); ++i)
+    {
+        datagram[i] = i;
+    }
+
+    struct ip_addr dest_ip;
+    IP4_ADDR(&dest_ip, 192, 168, 0, 2);
+    udp_socket_t load_socket, receive_socket;
+    AbortIfNot(init_udp(&load_socket), fail);
+    AbortIfNot(connect_udp(&load_socket, &dest_ip, IRQ_BENCH_PORT), fail);
+    AbortIfNot(init_udp(&receive_socket), fail);
+    AbortIfNot(bind_udp(&receive_socket, IP_ADDR_ANY, IRQ_BENCH_PORT, receive_load), fail);
+
+    /*
+     * The cycle counter that the intervals between entries are measured with
+     * is started by the profiler.
+     */
+    init_profiler();
+    private_timer_regs->Control_Register = 0;
+    private_timer_regs->Interrupt_Status_Register = PRIVATE_TIMER_EVENT_FLAG;
+    AbortIfNot(register_interrupt(PRIVATE_TIMER_IRQ_ID, timer_handler, NULL, IRQ_PRIORITY_CAPTURE), fail);
+    set_interrupts(true);
+
+    while (1)
+    {
+        for (size_t i = 0; i < BENCH_NUM_LOADS; ++i)
+        {
+            AbortIfNot(run_load(&bench_loads[i], &load_socket, data), fail);
+        }
+
+        dbprintf("Interrupt latency benchmark complete\n");
+        flush_log();
+    }
+}
+
+int main()
+{
+    go();
+
+    while (1);
+}
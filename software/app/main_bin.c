@@ -6,20 +6,64 @@
  */
 
 #include "abort.h"
+#include "accelerator.h"
 #include "adc.h"
+#include "adc_self_test.h"
+#include "amp.h"
+#include "bearing.h"
+#include "bearing_tracker.h"
+#include "channel_calibration.h"
+#include "channel_health.h"
+#include "board_sync.h"
+#include "bulk_upload.h"
+#include "capture_arena.h"
+#include "command_protocol.h"
+#include "correlation_average.h"
+#include "copy_engine.h"
+#include "cycle_counter.h"
 #include "correlation_util.h"
 #include "dma.h"
+#include "dsp.h"
+#include "fir_filter.h"
+#include "global_timer.h"
+#include "hp_port.h"
+#include "l2_lockdown.h"
+#include "lag_tracker.h"
+#include "load_governor.h"
 #include "lwip/ip.h"
 #include "lwip/udp.h"
+#include "matched_filter.h"
+#include "net_core.h"
 #include "network_stack.h"
+#include "param_store.h"
+#include "pc_sampler.h"
+#include "ping_context.h"
+#include "ping_history.h"
+#include "ping_synth.h"
+#include "ping_tracker.h"
+#include "pinger_bank.h"
+#include "profile.h"
+#include "replay.h"
+#include "sample_clock.h"
 #include "sample_util.h"
+#include "scheduler.h"
+#include "sd_recorder.h"
 #include "spi.h"
+#include "spectral_survey.h"
+#include "spsc_queue.h"
+#include "stream_subscription.h"
 #include "system.h"
 #include "system_params.h"
+#include "tcp.h"
+#include "telemetry.h"
 #include "time_util.h"
+#include "trace.h"
 #include "transmission_util.h"
 #include "types.h"
+#include "uart.h"
 #include "udp.h"
+#include "usb_stream.h"
+#include "watchdog.h"
 #include "db.h"
 
 #include "adc_dma_addresses.h"
@@ -31,6 +75,89 @@
  */
 dma_engine_t dma;
 
+/**
+ * The number of scatter-gather descriptors in the DMA capture ring.
+ */
+#define DMA_SG_DESCRIPTORS 64
+
+/**
+ * The scatter-gather descriptor ring used for gap-free sample capture.
+ */
+dma_descriptor_t dma_descriptors[DMA_SG_DESCRIPTORS];
+
+/**
+ * How capture buffers are kept coherent with the data cache. DMA_COHERENT
+ * requires a bitstream built with the DMA on the accelerator coherency port.
+ */
+#ifndef DMA_COHERENCY
+#define DMA_COHERENCY DMA_CACHED
+#endif
+
+/**
+ * The static QoS priority, from 0 to 15, of the capture writes through the
+ * HP port, which favours them over the CPU and EMAC in DDR arbitration once
+ * the load rises. It does not apply to a DMA on the coherency port.
+ */
+#ifndef DMA_HP_WRITE_QOS
+#define DMA_HP_WRITE_QOS 15
+#endif
+
+/**
+ * Specified nonzero to capture the triggered window into on-chip memory,
+ * which the DMA engine writes without any cache maintenance and the
+ * correlation reads without a round trip to DDR.
+ */
+#ifndef OCM_TRIGGER_WINDOW
+#define OCM_TRIGGER_WINDOW 1
+#endif
+
+/**
+ * Specified nonzero to let the DMA and capture timer interrupts preempt the
+ * handlers of the network, console and other background interrupts.
+ */
+#ifndef IRQ_NESTING
+#define IRQ_NESTING 1
+#endif
+
+/**
+ * Specified nonzero to skip the SPI loop-back and ADC datapath self tests at
+ * boot, which shortens the time from a reset to the first capture.
+ */
+#ifndef FAST_BOOT
+#define FAST_BOOT 0
+#endif
+
+/**
+ * Specified nonzero to give CPU1 the network stack rather than the
+ * processing, so that acquisition and processing on CPU0 are never stalled
+ * by network traffic.
+ */
+#ifndef NETWORK_CORE
+#define NETWORK_CORE 0
+#endif
+
+/**
+ * The number of boot steps that can be timed.
+ */
+#define MAX_BOOT_STEPS 16
+
+/**
+ * Defines the time at which a step of the boot completed.
+ */
+typedef struct boot_step_t
+{
+    const char *name;
+    tick_t tick;
+} boot_step_t;
+
+/**
+ * The steps of the boot that have completed, and whether they have been
+ * reported.
+ */
+boot_step_t boot_steps[MAX_BOOT_STEPS];
+size_t num_boot_steps = 0;
+bool boot_reported = false;
+
 /**
  * The SPI driver for controlling the ADC.
  */
@@ -42,359 +169,6444 @@ spi_driver_t adc_spi;
 adc_driver_t adc;
 
 /**
- * The maximum number of samples for 2.2 seconds at 65Msps.
+ * The reconfigurable reference that the ADC encode clock is divided from.
  */
-#define MAX_SAMPLES 45000 * 2200
+encode_clock_t encode_clock;
 
 /**
- * The array of current samples.
+ * The duration of the longest capture, which is taken while syncing and
+ * debugging.
  */
-sample_t samples[MAX_SAMPLES];
+#define CAPTURE_WINDOW_MS 2200
 
 /**
- * The array of correlation results for the cross correlation.
+ * The time to wait for the FPGA to correlate a triggered window after its last
+ * sample has been received.
  */
-correlation_t correlations[50000];
+#define HW_CORRELATION_TIMEOUT_MS 50
 
 /**
- * Specifies that the stream is in debug mode and transmits extra information.
+ * The arena that the sample, timestamp, and correlation buffers are carved
+ * from once the sample rate is known.
  */
-bool debug_stream = false;
+capture_arena_t capture_arena;
 
 /**
- * Specifies that the ping has been synced on.
+ * The arena over the free on-chip memory, which is only initialized when
+ * OCM_TRIGGER_WINDOW is set.
  */
-bool sync = false;
+capture_arena_t ocm_arena;
 
 /**
- * Specifies the current operating parameters of the application.
+ * The array of current samples and the number of samples it holds.
  */
-HydroZynqParams params;
+sample_t *samples = NULL;
+size_t capture_samples = 0;
 
-typedef struct KeyValuePair
-{
-    char *key;
-    char *value;
-} KeyValuePair;
+/**
+ * The buffer that the two packets of the triggered window are captured into,
+ * which is in on-chip memory when it fits and otherwise in the sample array.
+ */
+sample_t *trigger_window = NULL;
 
 /**
- * Defines the highpass IIR filter coefficients. These were generated by Matlab
- * using the designfilt function.
+ * The hardware timestamp of each packet of the most recent capture. Packets
+ * hold at least the eight samples that carry the embedded timestamp.
  */
-filter_coefficients_t highpass_iir[5] = {
-    {{0.976572753292004, -1.953145506584008, 0.976572753292004,
-        1.000000000000000, -1.998354115074282, 0.998926104509836}},
-    {{0.975206721477597, -1.950413442955194, 0.975206721477597,
-        1.000000000000000, -1.995495119158081, 0.996193697294377}},
-    {{0.972451482822301, -1.944902965644602, 0.972451482822301,
-        1.000000000000000, -1.989660620860693, 0.990750529959661}},
-    {{0.963669622248601, -1.927339244497202, 0.963669622248601,
-        1.000000000000000, -1.970992420143032, 0.973473065140308}},
-    {{0.906313647059524, -1.812627294119048, 0.906313647059524,
-        1.000000000000000, -1.848974099452832, 0.860723515924862}}};
+uint64_t *packet_timestamps = NULL;
+size_t capture_packets = 0;
 
 /**
- * Parses an argument packet into key-value pairs.
- *
- * @param data The data to parse.
- * @param len The length of the memory pointed to by data.
- * @param[out] pairs A list of key-value pairs to store the parsed results in.
- * @param max_pairs The maximum number of key-value pairs allowed.
- * @param[out] num_pairs The number of key-value pairs found in the string.
+ * The statistics trailer of each packet of a planned window, and the
+ * statistics of the window totalled from them.
+ */
+adc_packet_trailer_t *packet_trailers = NULL;
+channel_stats_t window_stats;
+
+/**
+ * The hardware timing of the most recent capture.
+ */
+sample_timing_t timing;
+
+/**
+ * The number of samples available to each half of the sample array when
+ * capture and processing are pipelined.
  *
- * @return Success or fail.
+ * @note Each capture starts at the base of its half and is clamped to the
+ *       half, so a ping window never wraps and is handed to the DSP and the
+ *       network stack as a pointer into the capture without being copied.
  */
-result_t parse_packet(char *data,
-                      const size_t len,
-                      KeyValuePair *pairs,
-                      const size_t max_pairs,
-                      size_t *num_pairs)
+#define PING_BUFFER_SAMPLES (capture_samples / 2)
+
+/**
+ * Defines a ping capture that is scheduled to begin while the previous ping
+ * is still being processed.
+ */
+typedef struct ping_schedule_t
 {
-    AbortIfNot(data, fail);
-    AbortIfNot(pairs, fail);
-    AbortIfNot(num_pairs, fail);
+    /*
+     * Specified true when a capture has been scheduled and specified true once
+     * the capture has been started, which may be from the timer alarm.
+     */
+    bool armed;
+    volatile bool started;
 
-    *num_pairs = 0;
-    char *last_start = data;
-    for (int i = 0; i < len && *num_pairs < max_pairs; ++i)
-    {
-        if (data[i] == ',' || data[i] == 0)
-        {
-            pairs[*num_pairs].key = last_start;
-            data[i] = 0;
-            (*num_pairs) = *num_pairs + 1;
-            last_start = &(data[i + 1]);
-        }
+    /*
+     * The system time at which the capture should begin, and where it should
+     * be stored.
+     */
+    tick_t start_tick;
+    sample_t *buffer;
+    size_t num_samples;
+} ping_schedule_t;
 
-        if (data[i] == 0)
-        {
-            break;
-        }
-    }
+/**
+ * The background sends of the samples and correlations of the previous ping.
+ */
+stream_job_t data_stream_job;
+stream_job_t xcorr_stream_job;
 
-    for (int i = 0; i < *num_pairs; ++i)
-    {
-        pairs[i].value = NULL;
-        for (int j = 0; j < strlen(pairs[i].key); ++j)
-        {
-            if (pairs[i].key[j] == ':')
-            {
-                pairs[i].key[j] = 0;
-                pairs[i].value = &(pairs[i].key[j + 1]);
-                break;
-            }
-        }
+/**
+ * The number of blocks of the sample array used as a ring when captures are
+ * streamed over TCP.
+ */
+#define TCP_STREAM_BLOCKS 8
 
-        AbortIfNot(pairs[i].value, fail);
-    }
+/**
+ * The number of samples captured into each block of a TCP stream, which is
+ * rounded up to whole ADC packets.
+ */
+#define TCP_STREAM_BLOCK_SAMPLES 131072
 
-    return success;
-}
+/**
+ * Defines the state of a block of the TCP stream ring.
+ */
+typedef enum stream_block_state_t
+{
+    STREAM_BLOCK_FREE,
+    STREAM_BLOCK_CAPTURING,
+    STREAM_BLOCK_CAPTURED,
+    STREAM_BLOCK_SENT
+} stream_block_state_t;
 
 /**
- * Callback for receiving a UDP packet.
- *
- * @return None.
+ * Defines a block of the TCP stream ring.
  */
-void receive_command(void *arg, struct udp_pcb *upcb, struct pbuf *p, struct ip_addr *addr, uint16_t port)
+typedef struct stream_block_t
 {
-    KeyValuePair pairs[10];
-    size_t num_entries = 0;
+    stream_block_state_t state;
+    sample_t *data;
 
-    char data[1024];
-    if (p->len > (sizeof(data) - 1))
-    {
-        pbuf_free(p);
-        dbprintf("Packet too long! Length was %d but internal buffer is %d\n",
-                p->len, sizeof(data));
-        return;
-    }
+    /*
+     * The header sent ahead of the samples, and the number of bytes of the
+     * header and samples that have been queued.
+     */
+    stream_block_header_t header;
+    size_t queued;
 
-    memcpy(data, p->payload, p->len);
-    pbuf_free(p);
-    data[p->len] = 0;
+    /*
+     * The stream offset that must be acknowledged before the block is reused.
+     */
+    uint64_t end_offset;
+} stream_block_t;
 
-    AbortIfNot(parse_packet(data, p->len + 1, pairs, 10, &num_entries), );
+/**
+ * The socket over which continuous captures are streamed, and whether
+ * streaming is enabled.
+ */
+tcp_socket_t capture_stream_socket;
+bool tcp_stream = false;
 
-    for (int i = 0; i < num_entries; ++i)
-    {
-        dbprintf("Key: '%s' Value: '%s'\n", pairs[i].key, pairs[i].value);
-        if (strcmp(pairs[i].key, "threshold") == 0)
-        {
-            unsigned int threshold;
-            AbortIfNot(sscanf(pairs[i].value, "%u", &threshold), );
-            params.ping_threshold = threshold;
-            sync = false;
-            dbprintf("Ping threshold has been set to %d\n", params.ping_threshold);
-        }
-        else if (strcmp(pairs[i].key, "filter") == 0)
-        {
-            unsigned int debug = 0;
-            AbortIfNot(sscanf(pairs[i].value, "%u", &debug), );
-            params.filter = (debug == 0)? false : true;
-            dbprintf("Filtering is: %s\n",
-                    (debug_stream)? "Enabled" : "Disabled");
-        }
-        else if (strcmp(pairs[i].key, "debug") == 0)
-        {
-            unsigned int debug = 0;
-            AbortIfNot(sscanf(pairs[i].value, "%u", &debug), );
-            debug_stream = (debug == 0)? false : true;
-            dbprintf("Debug stream is: %s\n",
-                    (debug_stream)? "Enabled" : "Disabled");
-        }
-        else if (strcmp(pairs[i].key, "pre_ping_duration_us") == 0)
-        {
-            unsigned int duration = 0;
-            AbortIfNot(sscanf(pairs[i].value, "%u", &duration), );
+/**
+ * The receiver of recorded captures that are processed in place of the ADC,
+ * whether replay is enabled, and the number of captures replayed.
+ */
+replay_receiver_t replay;
+bool replay_mode = false;
+uint32_t replay_sequence = 0;
 
-            params.pre_ping_duration = micros_to_ticks(duration);
-            dbprintf("Pre-ping duration is %u us.\n", duration);
-        }
-        else if (strcmp(pairs[i].key, "post_ping_duration_us") == 0)
-        {
-            unsigned int duration = 0;
-            AbortIfNot(sscanf(pairs[i].value, "%u", &duration), );
+/**
+ * The synthetic pinger whose pings are processed in place of the ADC while
+ * synthetic pings are enabled, the pinger it is configured as, the tracker of
+ * its pings, and the consecutive windows that missed a ping.
+ */
+ping_synth_t ping_synth;
+ping_synth_config_t synth_config;
+ping_tracker_t synth_tracker;
+bool synthetic_mode = false;
+bool synthetic_restart = false;
+uint32_t synth_misses = 0;
 
-            params.post_ping_duration = micros_to_ticks(duration);
-            dbprintf("Post-ping duration is %u us.\n", duration);
-        }
-        else if (strcmp(pairs[i].key, "reset") == 0)
-        {
-            /*
-             * Trigger a software reset of the Zynq.
-             */
-            dbprintf("Resetting Zynq...");
-            give_up();
-        }
-    }
-}
+/**
+ * The capture of the next ping, which is recorded into alternating halves of
+ * the sample array.
+ */
+capture_t ping_capture;
 
 /**
- * Issue a request for thruster silent running for clean hydrophone readings.
- *
- * @param socket The socket to make the request on.
- * @param ticks The time in the future that thrusters should be shut down at.
- * @param duration The duration that thrusters should be shut down for.
- *
- * @return Success or fail.
+ * The schedule for the next ping capture.
  */
-result_t request_thruster_shutdown(udp_socket_t *socket,
-                                   const tick_t future_ticks,
-                                   const tick_t duration)
-{
-    char msg[8];
-    int32_t when_ms = ticks_to_ms(future_ticks - get_system_time());
-    int32_t duration_ms = ticks_to_ms(duration);
-    memcpy(msg, &when_ms, 4);
-    memcpy(&msg[4], &duration_ms, 4);
+ping_schedule_t ping_schedule;
 
-    AbortIfNot(send_udp(socket, msg, 8), fail);
+/**
+ * The capture that records into the start of the sample array at all times
+ * in continuous mode, the timing of the packets in its ring, and the number
+ * of samples of the ring. The window of each ping is copied out of the ring
+ * into the rest of the sample array.
+ */
+continuous_capture_t continuous_capture;
+sample_timing_t continuous_timing;
+size_t continuous_ring_samples = 0;
 
-    return success;
-}
+/**
+ * The estimate of the ping period and phase used to schedule captures.
+ */
+ping_tracker_t ping_tracker;
 
 /**
- * Application process.
- *
- * @return Success or fail.
+ * The number of consecutive captures in which the ping was not found.
  */
-result_t go()
-{
-    /*
-     * Initialize the system.
-     */
-    AbortIfNot(init_system(), fail);
+uint32_t capture_misses = 0;
 
-    dbprintf("Beginning HydroZynq main application\n");
+/**
+ * The sync of the sample stream with the other boards of an array.
+ */
+board_sync_t board_sync;
 
-    /*
-     * Initialize the network stack with the specified IP address.
-     */
-    struct ip_addr our_ip, netmask, gateway;
-    IP4_ADDR(&our_ip, 192, 168, 0, 7);
-    IP4_ADDR(&netmask, 255, 255, 255, 0);
-    IP4_ADDR(&gateway, 192, 168, 1, 1);
+/**
+ * The receiver of templates and filters uploaded in bulk, and the slots of
+ * the capture arena they are written into.
+ */
+bulk_upload_t bulk_upload;
+float *template_upload = NULL;
+filter_coefficients_t *filter_upload = NULL;
 
-    macaddr_t mac_address = {
-        .addr = {0x00, 0x0a, 0x35, 0x00, 0x01, 0x02}
-    };
+/**
+ * The accelerator modules of the reconfigurable region of the fabric, and
+ * the buffer their partial bitstreams are uploaded into. The buffer stays
+ * outside the capture arena so that modules survive its reallocation.
+ */
+accelerator_manager_t accelerators;
+NO_INIT static uint8_t accelerator_upload[ACCELERATOR_MODULE_MAX_BYTES] __attribute__((aligned(CAPTURE_ARENA_ALIGNMENT)));
 
-    AbortIfNot(init_network_stack(our_ip, netmask, gateway, mac_address), fail);
-    AbortIfNot(dbinit(), fail);
-    dbprintf("Network stack initialized\n");
+/**
+ * Defines the drive of the external trigger output.
+ */
+typedef enum trigger_output_t
+{
+    TRIGGER_OUTPUT_OFF = 0,
+    TRIGGER_OUTPUT_WINDOWS = 1,
+    TRIGGER_OUTPUT_FORCED = 2
+} trigger_output_t;
 
-    /*
-     * Initialize the DMA engine for reading samples.
-     */
-     AbortIfNot(initialize_dma(&dma, DMA_BASE_ADDRESS), fail);
+/**
+ * Whether captures wait for an edge of the external trigger input instead of
+ * tracking the pinger, and whether the external trigger output is driven over
+ * each capture window or held high.
+ */
+bool trigger_gate = false;
+unsigned int trigger_output = TRIGGER_OUTPUT_OFF;
+
+/**
+ * The filter bank that separates additional pingers from each capture, and
+ * whether it must be reconfigured before its next use.
+ */
+pinger_bank_t pinger_bank;
+bool pinger_bank_stale = true;
+
+/**
+ * The array of correlation results for the cross correlation and the number
+ * of results it holds.
+ */
+correlation_t *correlations = NULL;
+size_t correlation_len = 0;
+
+/**
+ * The correlations between the channels other than the reference, which hold
+ * correlation_len results when all pairs are correlated.
+ */
+correlation_t *cross_correlations = NULL;
+
+/**
+ * The geometry of the hydrophone array used to solve the pinger direction.
+ */
+hydrophone_array_t hydrophone_array;
+
+/**
+ * Specified true if the correlations of each ping are streamed. The direction
+ * is solved on board, so the stream can be disabled in production.
+ */
+bool xcorr_stream = true;
+
+/**
+ * The per-channel copy of the capture used by the DSP stages, and whether the
+ * stages use it rather than the interleaved samples.
+ */
+planar_samples_t planar_samples;
+bool planar_dsp = false;
+
+/**
+ * Specified true if planned windows are recorded by the FPGA straight into
+ * the per-channel copy whenever nothing needs the interleaved capture.
+ */
+bool planar_capture = false;
+
+/**
+ * Specified true if the ADC measures the statistics of each packet of a
+ * planned window as it is streamed, so that they are not measured again
+ * while the window is normalized.
+ */
+bool packet_stats = false;
+
+/**
+ * Specifies that the stream is in debug mode and transmits extra information.
+ */
+bool debug_stream = false;
+
+/**
+ * Specified true if the debug stream sends each capture unprocessed, from
+ * the buffer it was captured into.
+ */
+bool raw_debug_stream = false;
+
+/**
+ * Specified true if the envelope of each capture is streamed for live
+ * plotting. The envelope is a few kilobytes per capture.
+ */
+bool preview_stream = true;
+
+/**
+ * Specified true if a window around each located ping is recorded and
+ * streamed in the background while tracking continues, and the queue of
+ * windows waiting to be streamed.
+ */
+bool record_stream = false;
+record_queue_t record_queue;
+
+/**
+ * The DMA controller that copies ping windows out of the sample array while
+ * the processor carries on with the next capture.
+ */
+copy_engine_t copy_engine;
+
+/**
+ * The matched filter that searches for the uploaded pinger waveform while
+ * acquiring sync, with the storage of its template and transforms.
+ */
+matched_filter_t matched_filter;
+static float matched_template[MATCHED_TEMPLATE_MAX];
+NO_INIT static complex_t matched_spectrum[MATCHED_FILTER_FFT_LEN(MATCHED_TEMPLATE_MAX)];
+NO_INIT static complex_t matched_work[MATCHED_FILTER_FFT_LEN(MATCHED_TEMPLATE_MAX)];
+NO_INIT static float matched_input[MATCHED_FILTER_FFT_LEN(MATCHED_TEMPLATE_MAX)];
+
+/**
+ * Specified true if the window of each located ping is streamed. Otherwise
+ * only the results are streamed, and the most recent pings are kept on board
+ * to be fetched by sequence number.
+ */
+bool data_stream = true;
+ping_history_t ping_history;
+
+/**
+ * The contexts of the pings that are moving through the loop, which are
+ * passed between its stages, and to the DSP core, by handle.
+ */
+ping_context_pool_t ping_contexts;
+
+/**
+ * The recorder that writes pings or whole captures to the SD card at full
+ * rate without using the network.
+ */
+sd_recorder_t sd_recorder;
+
+/**
+ * Specified true if captures are streamed over USB rather than the data
+ * stream while a host has the USB device configured, and the USB device.
+ */
+bool usb_capture_stream = false;
+usb_stream_t usb_stream;
+
+/**
+ * The rate limit applied to the data and correlation streams.
+ */
+uint32_t transmit_rate_bytes_per_second = INITIAL_TRANSMIT_RATE_BYTES_PER_SECOND;
+uint32_t transmit_burst_bytes = INITIAL_TRANSMIT_BURST_BYTES;
+
+/**
+ * The rate limit in effect, which is the configured limit capped to the
+ * share of the Ethernet link the streams may use.
+ */
+uint32_t effective_transmit_rate = INITIAL_TRANSMIT_RATE_BYTES_PER_SECOND;
+
+/**
+ * The destination of the data, correlation, result, preview, record, and
+ * survey streams, which may be a unicast, broadcast, or multicast address. The
+ * streams are reconnected when the destination is stale.
+ */
+struct ip_addr stream_destination;
+bool stream_destination_stale = false;
+
+/**
+ * The consumers of the data and correlation streams, and the destination of
+ * the default subscriptions that follow the stream destination.
+ */
+stream_subscriptions_t stream_subscriptions;
+struct ip_addr subscribed_destination;
+
+/**
+ * A number of samples per ADC packet, a decimation rate and a sampling
+ * frequency requested by command, which are applied between captures. Zero if
+ * no change is pending.
+ */
+size_t requested_samples_per_packet = 0;
+uint32_t requested_decimation = 0;
+uint32_t requested_sampling_frequency = 0;
+
+/**
+ * Whether the stream should carry packed samples, which is applied between
+ * captures when it is stale.
+ */
+bool packed_samples = false;
+bool packed_samples_stale = false;
+
+/**
+ * The duration of a spectral survey requested by command, which is run
+ * between captures, and the length of its segments. Zero if no survey is
+ * pending.
+ */
+uint32_t requested_survey_ms = 0;
+size_t survey_fft_len = SURVEY_DEFAULT_FFT_LEN;
+
+/**
+ * Defines what is done with a processing profile requested by a text
+ * command.
+ */
+typedef enum profile_action_t
+{
+    PROFILE_NONE,
+    PROFILE_SWITCH,
+    PROFILE_SAVE,
+    PROFILE_DELETE
+} profile_action_t;
+
+/**
+ * A processing profile requested by a text command, which is switched to,
+ * saved from the configuration, or deleted once every pending command has
+ * been applied.
+ */
+profile_action_t requested_profile_action = PROFILE_NONE;
+char requested_profile[PROFILE_NAME_LEN];
+
+/**
+ * Defines a predefined processing profile, whose parameters are listed as
+ * those of encode_command_config().
+ */
+typedef struct builtin_profile_t
+{
+    const char *name;
+    const uint32_t (*values)[2];
+    size_t num_values;
+    const uint8_t (*flags)[2];
+    size_t num_flags;
+} builtin_profile_t;
+
+/**
+ * Locates the ping on channels decimated by four, or filters only its window
+ * at the full rate, takes the delays of most pings from their leading edges,
+ * searches only around the tracked lags when correlating, and streams
+ * nothing but the results.
+ */
+static const uint32_t low_latency_values[][2] = {
+    {PARAM_DSP_DECIMATION, 4},
+    {PARAM_AVERAGE_PINGS, 0},
+    {PARAM_FAST_TDOA, 8}};
+static const uint8_t low_latency_flags[][2] = {
+    {PARAM_COARSE_SEARCH, true},
+    {PARAM_TRACK_LAGS, true},
+    {PARAM_LAZY_FILTER, true},
+    {PARAM_PHAT, false},
+    {PARAM_ALL_PAIRS, false},
+    {PARAM_ENVELOPE_ONSET, false},
+    {PARAM_XCORR_STREAM, false},
+    {PARAM_DEBUG, false},
+    {PARAM_PREVIEW, false},
+    {PARAM_RECORD, false}};
+
+/**
+ * Correlates every pair of channels at the full rate with GCC-PHAT from the
+ * onset of the direct path, and averages the correlations of recent pings.
+ */
+static const uint32_t high_accuracy_values[][2] = {
+    {PARAM_DSP_DECIMATION, 1},
+    {PARAM_AVERAGE_PINGS, 8},
+    {PARAM_FAST_TDOA, 0}};
+static const uint8_t high_accuracy_flags[][2] = {
+    {PARAM_FILTER, true},
+    {PARAM_LAZY_FILTER, false},
+    {PARAM_PHAT, true},
+    {PARAM_ALL_PAIRS, true},
+    {PARAM_ENVELOPE_ONSET, true},
+    {PARAM_AVERAGE_EXPONENTIAL, false},
+    {PARAM_COARSE_SEARCH, false},
+    {PARAM_TRACK_LAGS, false}};
+
+/**
+ * Acquires sync from the envelope streamed by the FPGA rather than from
+ * captures, processes decimated channels, and streams only the results.
+ */
+static const uint32_t low_power_values[][2] = {
+    {PARAM_DSP_DECIMATION, 4},
+    {PARAM_AVERAGE_PINGS, 0}};
+static const uint8_t low_power_flags[][2] = {
+    {PARAM_HW_ENVELOPE, true},
+    {PARAM_COARSE_SEARCH, true},
+    {PARAM_TRACK_LAGS, true},
+    {PARAM_PHAT, false},
+    {PARAM_ALL_PAIRS, false},
+    {PARAM_ENVELOPE_ONSET, false},
+    {PARAM_PLANAR, false},
+    {PARAM_XCORR_STREAM, false},
+    {PARAM_DEBUG, false},
+    {PARAM_PREVIEW, false},
+    {PARAM_RECORD, false}};
+
+#define BUILTIN_PROFILE(name, prefix) \
+    {name, \
+     prefix##_values, sizeof(prefix##_values) / sizeof(prefix##_values[0]), \
+     prefix##_flags, sizeof(prefix##_flags) / sizeof(prefix##_flags[0])}
+
+static const builtin_profile_t builtin_profiles[] = {
+    BUILTIN_PROFILE("low-latency", low_latency),
+    BUILTIN_PROFILE("high-accuracy", high_accuracy),
+    BUILTIN_PROFILE("low-power", low_power)};
+
+/**
+ * Finds a predefined processing profile.
+ *
+ * @param name The name of the profile.
+ *
+ * @return The profile, or NULL if none is of that name.
+ */
+const builtin_profile_t *find_builtin_profile(const char *name)
+{
+    for (size_t i = 0; i < sizeof(builtin_profiles) / sizeof(builtin_profiles[0]); ++i)
+    {
+        if (strcmp(builtin_profiles[i].name, name) == 0)
+        {
+            return &builtin_profiles[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * The storage of the spectral survey.
+ */
+static float survey_window[SURVEY_MAX_FFT_LEN];
+NO_INIT static complex_t survey_work[SURVEY_MAX_FFT_LEN];
+static float survey_power[4 * SURVEY_BINS(SURVEY_MAX_FFT_LEN)];
+
+/**
+ * The number of pings that have been located, which identifies each result.
+ */
+uint32_t ping_sequence = 0;
+
+/**
+ * The number of accepted pings whose delays were taken from their leading
+ * edges since a ping was last correlated.
+ */
+static uint32_t pings_since_correlation = 0;
+
+/**
+ * The socket that profiling and health reports are sent over.
+ */
+udp_socket_t telemetry_socket;
+
+/**
+ * The sockets that commands are received on, that thruster shutdowns are
+ * requested on, and that the result, preview, record, and survey streams are
+ * sent over.
+ */
+udp_socket_t command_socket;
+udp_socket_t silent_request_socket;
+udp_socket_t result_socket;
+udp_socket_t preview_socket;
+udp_socket_t record_socket;
+udp_socket_t survey_socket;
+
+/**
+ * The recovery applied after a fault in the main loop, in increasing order of
+ * cost. Each level also applies the levels below it.
+ */
+typedef enum recovery_level_t
+{
+    RECOVER_DMA = 0,
+    RECOVER_ADC,
+    RECOVER_NETWORK,
+    RECOVER_RESET
+} recovery_level_t;
+
+static const char *recovery_level_names[RECOVER_RESET] = {
+    "DMA",
+    "DMA and ADC",
+    "DMA, ADC, and network"};
+
+/**
+ * A fault within this time of the previous fault escalates to the next
+ * recovery level, and a fault at the last level resets the processor.
+ */
+#define RECOVERY_WINDOW_MS 10000
+
+/**
+ * The time to wait for the DSP core to return a job that was in progress when
+ * a fault occurred.
+ */
+#define RECOVERY_DSP_TIMEOUT_MS 500
+
+/**
+ * Specified true once the processor has been initialized. The parameters and
+ * ping tracker are kept across warm restarts, which only reinitialize the
+ * hardware that faulted.
+ */
+bool booted = false;
+
+/**
+ * The number of warm restarts, the recovery level of the most recent one, and
+ * the time of the most recent fault.
+ */
+uint32_t warm_restarts = 0;
+recovery_level_t recovery_level = RECOVER_DMA;
+tick_t last_fault_tick = 0;
+
+/**
+ * Specified true while a job has been submitted to the DSP core and not yet
+ * returned.
+ */
+bool dsp_job_pending = false;
+
+/**
+ * Counters of ping acquisition reported over telemetry.
+ */
+ping_stats_t ping_stats;
+
+/**
+ * The governor that sheds features while processing a ping overruns the ping
+ * period.
+ */
+load_governor_t load_governor;
+
+/**
+ * The correlations of recent pings averaged together, which are reported
+ * next to the result of each ping.
+ */
+correlation_average_t correlation_average;
+
+/**
+ * The predictor of the lags of each pair from recent pings.
+ */
+lag_tracker_t lag_tracker;
+
+/**
+ * The filter of the delays of consecutive pings of the primary pinger, which
+ * rejects multipath outliers and whose prediction the lag search follows.
+ */
+bearing_tracker_t bearing_tracker;
+
+/**
+ * The monitor of the hydrophone channels, and whether pings are kept off the
+ * channels that it flags.
+ */
+channel_health_t channel_health;
+
+/**
+ * The result of the ADC test pattern self test at boot.
+ */
+adc_self_test_t adc_self_test;
+bool exclude_unhealthy = false;
+
+/**
+ * The calibration of the channel delays and gains, and the run that measures
+ * a new one.
+ */
+channel_calibration_t channel_calibration;
+calibration_run_t calibration_run;
+
+/**
+ * The private watchdog, which resets the processor if the main loop stops
+ * making progress, and the deadlines of the main loop stages.
+ */
+watchdog_t watchdog;
+
+/**
+ * The system monitor used to read the FPGA temperature.
+ */
+xsystem_monitor_t system_monitor;
+
+/**
+ * The scheduler of the background tasks that run between the stages of the
+ * main loop.
+ */
+scheduler_t scheduler;
+
+/**
+ * Specifies that the ping has been synced on.
+ */
+bool sync = false;
+
+/**
+ * Specifies the current operating parameters of the application.
+ */
+HydroZynqParams params;
+
+/**
+ * The store that keeps the operating parameters in flash across reboots.
+ */
+param_store_t param_store;
+
+/**
+ * The number of received commands that may be waiting to be applied.
+ */
+#define COMMAND_QUEUE_DEPTH 4
+
+/**
+ * Defines a command received on the command socket.
+ */
+typedef struct command_t
+{
+    char text[1024];
+
+    /*
+     * Specified true for a binary command, which holds len bytes and whose
+     * acknowledgement is returned to the sender.
+     */
+    bool binary;
+    size_t len;
+    struct ip_addr addr;
+    uint16_t port;
+} command_t;
+
+/**
+ * Defines the configuration that binary commands set, which is staged and
+ * validated in full before any of it is applied.
+ */
+typedef struct command_config_t
+{
+    HydroZynqParams params;
+    bool planar_dsp;
+    bool xcorr_stream;
+    bool debug_stream;
+    bool preview_stream;
+    bool record_stream;
+    uint32_t samples_per_packet;
+    uint32_t decimation;
+    uint32_t sampling_frequency;
+    filter_coefficients_t filter_sections[MAX_FILTER_SECTIONS];
+    uint32_t num_filter_sections;
+} command_config_t;
+
+/**
+ * The version of the parameter set, which is incremented by every binary
+ * command that changes the configuration.
+ */
+uint32_t param_set_version = 1;
+
+/**
+ * The largest acknowledgement of a binary command.
+ */
+#define COMMAND_ACK_BYTES 512
+
+/**
+ * The queue of commands handed from the network stack to the main loop,
+ * which resides in on-chip memory.
+ */
+spsc_queue_t command_queue __attribute__((section(".ocm")));
+command_t command_storage[COMMAND_QUEUE_DEPTH] __attribute__((section(".ocm")));
+
+typedef struct KeyValuePair
+{
+    char *key;
+    char *value;
+} KeyValuePair;
+
+/**
+ * Defines the highpass IIR filter coefficients. These were generated by Matlab
+ * using the designfilt function.
+ */
+filter_coefficients_t highpass_iir[5] = {
+    {{0.976572753292004, -1.953145506584008, 0.976572753292004,
+        1.000000000000000, -1.998354115074282, 0.998926104509836}},
+    {{0.975206721477597, -1.950413442955194, 0.975206721477597,
+        1.000000000000000, -1.995495119158081, 0.996193697294377}},
+    {{0.972451482822301, -1.944902965644602, 0.972451482822301,
+        1.000000000000000, -1.989660620860693, 0.990750529959661}},
+    {{0.963669622248601, -1.927339244497202, 0.963669622248601,
+        1.000000000000000, -1.970992420143032, 0.973473065140308}},
+    {{0.906313647059524, -1.812627294119048, 0.906313647059524,
+        1.000000000000000, -1.848974099452832, 0.860723515924862}}};
+
+/**
+ * The coefficients of the capture filter, which start as the highpass filter
+ * and may be replaced by commands, and the filter prepared from them.
+ */
+filter_coefficients_t filter_sections[MAX_FILTER_SECTIONS];
+size_t num_filter_sections;
+HOT_DATA biquad_cascade_t capture_filter;
+
+/**
+ * The decimator of the filtered channels, which is designed again whenever
+ * the decimation, the ping frequency, or the sampling frequency changes.
+ */
+HOT_DATA decimator_t capture_decimator;
+uint8_t capture_decimator_factor;
+uint32_t capture_decimator_max_hz;
+
+/**
+ * The FIR filter that replaces the capture filter when a bandpass is
+ * designed, with the storage of its spectrum and blocks. The design is kept
+ * so that the taps are designed again whenever the sampling frequency
+ * changes.
+ */
+fir_filter_t capture_fir;
+static float capture_fir_taps[FIR_FILTER_MAX_TAPS];
+NO_INIT static complex_t capture_fir_spectrum[FIR_FILTER_FFT_LEN(FIR_FILTER_MAX_TAPS)];
+NO_INIT static complex_t capture_fir_work[2 * FIR_FILTER_FFT_LEN(FIR_FILTER_MAX_TAPS)];
+NO_INIT static complex_t capture_fir_history[2 * FIR_FILTER_MAX_TAPS];
+uint32_t capture_fir_num_taps;
+uint32_t capture_fir_low_hz;
+uint32_t capture_fir_high_hz;
+uint32_t capture_fir_sampling_frequency;
+
+/**
+ * Replaces the capture filter.
+ *
+ * @param sections The biquad coefficients of each section as b0, b1, b2, a0,
+ *        a1, a2.
+ * @param count The number of sections.
+ *
+ * @return Success or fail.
+ */
+result_t set_capture_filter(const filter_coefficients_t *sections, const size_t count)
+{
+    AbortIfNot(sections, fail);
+    AbortIfNot(count > 0 && count <= MAX_FILTER_SECTIONS, fail);
+
+    biquad_cascade_t prepared;
+    AbortIfNot(init_biquad_cascade(&prepared, sections, count), fail);
+
+    capture_filter = prepared;
+    memset(filter_sections, 0, sizeof(filter_sections));
+    memcpy(filter_sections, sections, count * sizeof(filter_coefficients_t));
+    num_filter_sections = count;
+
+    return success;
+}
+
+/**
+ * Finds the calibration that pings are corrected by. Pings are measured as
+ * they are while a calibration run is in progress.
+ *
+ * @return The calibration, or NULL.
+ */
+const channel_calibration_t *active_calibration()
+{
+    return (calibration_run.active)? NULL : &channel_calibration;
+}
+
+/**
+ * Prints the calibration of the channels.
+ *
+ * @return None.
+ */
+void report_channel_calibration()
+{
+    dbprintf("Calibration skews: %d %d %d ps, gains: %d %d %d permille\n",
+            (int32_t)(channel_calibration.delay_ns[1] * 1000),
+            (int32_t)(channel_calibration.delay_ns[2] * 1000),
+            (int32_t)(channel_calibration.delay_ns[3] * 1000),
+            (int32_t)(channel_calibration.gain[1] * 1000),
+            (int32_t)(channel_calibration.gain[2] * 1000),
+            (int32_t)(channel_calibration.gain[3] * 1000));
+}
+
+/**
+ * Replaces the calibration of the channels. The trackers follow delays
+ * measured with the previous calibration, so they are restarted.
+ *
+ * @param calibration The new calibration.
+ *
+ * @return Success or fail.
+ */
+result_t set_channel_calibration(const channel_calibration_t *calibration)
+{
+    AbortIfNot(calibration, fail);
+
+    channel_calibration = *calibration;
+    AbortIfNot(reset_lag_tracker(&lag_tracker), fail);
+    AbortIfNot(reset_bearing_tracker(&bearing_tracker), fail);
+    report_channel_calibration();
+
+    return success;
+}
+
+/**
+ * Adds the result of a ping to the calibration run in progress, and applies
+ * the calibration once the run has averaged its pings.
+ *
+ * @param result The result of the ping, measured without calibration.
+ *
+ * @return Success or fail.
+ */
+result_t record_calibration_ping(const correlation_result_t *result)
+{
+    AbortIfNot(result, fail);
+
+    if (!calibration_run.active)
+    {
+        return success;
+    }
+
+    bool complete = false;
+    AbortIfNot(add_calibration_ping(&calibration_run, result, &complete), fail);
+    if (!complete)
+    {
+        return success;
+    }
+
+    dbprintf("Calibration averaged %u pings (%u rejected), spread %d %d %d ns\n",
+            calibration_run.pings,
+            calibration_run.rejected,
+            (int32_t)calibration_spread_ns(&calibration_run, 0),
+            (int32_t)calibration_spread_ns(&calibration_run, 1),
+            (int32_t)calibration_spread_ns(&calibration_run, 2));
+
+    channel_calibration_t measured;
+    if (!finish_calibration(&calibration_run, &measured))
+    {
+        dblog(LOG_WARN, "Calibration is beyond its limits and was discarded.\n");
+        return success;
+    }
+    AbortIfNot(set_channel_calibration(&measured), fail);
+
+    return success;
+}
+
+/**
+ * Gets the decimator of the filtered channels at a sampling frequency,
+ * designing it again if the parameters changed since it was designed.
+ *
+ * @param sampling_frequency The sampling frequency of the capture.
+ *
+ * @return The decimator, or NULL if the channels are processed at the full
+ *         rate or planar processing is disabled.
+ */
+const decimator_t *prepare_capture_decimator(const uint32_t sampling_frequency)
+{
+    if (params.dsp_decimation <= 1 || !planar_dsp)
+    {
+        return NULL;
+    }
+
+    const uint32_t max_hz = (params.ping_frequency)?
+            params.ping_frequency + PINGER_BANDWIDTH_HZ / 2 : COARSE_SEARCH_MAX_PINGER_HZ;
+    if (capture_decimator_factor != params.dsp_decimation ||
+        capture_decimator_max_hz != max_hz ||
+        capture_decimator.sampling_frequency != sampling_frequency)
+    {
+        if (!init_decimator(&capture_decimator, params.dsp_decimation, max_hz, sampling_frequency))
+        {
+            return NULL;
+        }
+
+        capture_decimator_factor = params.dsp_decimation;
+        capture_decimator_max_hz = max_hz;
+        dbprintf("Decimating the filtered channels by %u, %u taps.\n",
+                (unsigned int)capture_decimator.factor,
+                (unsigned int)capture_decimator.num_taps);
+    }
+
+    return (capture_decimator.factor > 1)? &capture_decimator : NULL;
+}
+
+/**
+ * Gets the FIR filter of the captures at a sampling frequency, designing its
+ * taps again if the sampling frequency changed since they were designed.
+ *
+ * @param sampling_frequency The sampling frequency of the capture.
+ *
+ * @return The filter, or NULL if captures are filtered by the biquad cascade.
+ */
+fir_filter_t *prepare_capture_fir(const uint32_t sampling_frequency)
+{
+    if (!capture_fir_num_taps)
+    {
+        return NULL;
+    }
+
+    if (capture_fir_sampling_frequency != sampling_frequency || !capture_fir.ready)
+    {
+        capture_fir_sampling_frequency = sampling_frequency;
+        if (!design_fir_bandpass(capture_fir_taps,
+                                 capture_fir_num_taps,
+                                 capture_fir_low_hz,
+                                 capture_fir_high_hz,
+                                 sampling_frequency) ||
+            !set_fir_taps(&capture_fir, capture_fir_taps, capture_fir_num_taps))
+        {
+            dblog(LOG_WARN, "The FIR bandpass cannot be designed at %u Hz.\n",
+                    (unsigned int)sampling_frequency);
+            set_fir_taps(&capture_fir, NULL, 0);
+            return NULL;
+        }
+
+        dbprintf("FIR bandpass of %u taps uses %u point transforms.\n",
+                (unsigned int)capture_fir.num_taps,
+                (unsigned int)capture_fir.fft_len);
+    }
+
+    return &capture_fir;
+}
+
+/**
+ * Captures the ADC test patterns through the datapath and reports whether it
+ * holds the patterns, keeps the samples in order and keeps up with the rate
+ * of the clock divider. A fault is reported in telemetry rather than stopping
+ * the boot.
+ *
+ * @return None.
+ */
+void test_adc_datapath()
+{
+    const size_t samples_per_packet = adc.regs->samples_per_packet;
+    size_t len = (uint64_t)get_adc_sampling_frequency(&adc) * ADC_SELF_TEST_MS / 1000;
+    len = (len + samples_per_packet - 1) / samples_per_packet * samples_per_packet;
+    if (len > capture_samples)
+    {
+        len = capture_samples / samples_per_packet * samples_per_packet;
+    }
+    if (len > timing.max_packets * samples_per_packet)
+    {
+        len = timing.max_packets * samples_per_packet;
+    }
+
+    if (!run_adc_self_test(&dma, &adc, samples, len, &timing, &adc_self_test))
+    {
+        dblog(LOG_WARN, "ADC self test could not run.\n");
+        return;
+    }
+
+    if (adc_self_test.flags != ADC_SELF_TEST_RAN)
+    {
+        dblog(LOG_WARN, "ADC self test failed (flags 0x%x): %u pattern errors, %u breaks, %u dropped, "
+                "%u Hz measured for %u Hz, captured at %u Hz.\n",
+                adc_self_test.flags,
+                adc_self_test.pattern_errors,
+                adc_self_test.discontinuities,
+                adc_self_test.dropped_samples,
+                adc_self_test.measured_hz,
+                adc_self_test.expected_hz,
+                adc_self_test.capture_hz);
+        return;
+    }
+
+    dbprintf("ADC self test passed: %u samples at %u Hz (clock div %u), captured at %u Hz.\n",
+            adc_self_test.samples,
+            adc_self_test.measured_hz,
+            adc_self_test.clk_div,
+            adc_self_test.capture_hz);
+}
+
+/**
+ * Reads back the configuration of the port that captures are written
+ * through and warns if it does not match the firmware build.
+ *
+ * @return None.
+ */
+void report_capture_port()
+{
+    if (DMA_COHERENCY == DMA_COHERENT)
+    {
+        dbprintf("Capture port: ACP, %u beat bursts.\n", DMA_S2MM_BURST_SIZE);
+        return;
+    }
+
+    hp_port_config_t config;
+    if (!read_hp_port_config(DMA_HP_PORT, &config))
+    {
+        dblog(LOG_WARN, "Capture port could not be read.\n");
+        return;
+    }
+
+    dbprintf("Capture port: HP%u, %u bits, %u beat bursts, QoS %u%s, %u outstanding writes.\n",
+            DMA_HP_PORT,
+            config.data_width,
+            DMA_S2MM_BURST_SIZE,
+            config.write_qos,
+            (config.fabric_qos)? " (fabric)" : "",
+            config.issuing_cap);
+
+    if (config.data_width != DMA_HP_DATA_WIDTH)
+    {
+        dblog(LOG_WARN, "Capture port is %u bits but the firmware expects %u.\n",
+                config.data_width,
+                DMA_HP_DATA_WIDTH);
+    }
+
+    if (config.fabric_qos || config.write_qos != DMA_HP_WRITE_QOS)
+    {
+        dblog(LOG_WARN, "Capture port QoS is %u but the firmware expects %u.\n",
+                config.write_qos,
+                DMA_HP_WRITE_QOS);
+    }
+}
+
+/**
+ * Records the completion of a boot step.
+ *
+ * @param name The name of the step.
+ *
+ * @return None.
+ */
+void mark_boot_step(const char *name)
+{
+    if (num_boot_steps < MAX_BOOT_STEPS)
+    {
+        boot_steps[num_boot_steps].name = name;
+        boot_steps[num_boot_steps].tick = get_system_time();
+        num_boot_steps++;
+    }
+}
+
+/**
+ * Reports the duration of each boot step once the first capture has been
+ * taken.
+ *
+ * @note Times are measured from the start of the application, so the boot
+ *       ROM, FSBL, and bitstream load are not included.
+ *
+ * @return None.
+ */
+void report_boot_timeline()
+{
+    if (boot_reported)
+    {
+        return;
+    }
+
+    mark_boot_step("first capture");
+    boot_reported = true;
+
+    tick_t previous = 0;
+    for (size_t i = 0; i < num_boot_steps; ++i)
+    {
+        dbprintf("Boot: %s at %u us (+%u us)\n",
+                boot_steps[i].name,
+                (uint32_t)ticks_to_micros(boot_steps[i].tick),
+                (uint32_t)ticks_to_micros(boot_steps[i].tick - previous));
+        previous = boot_steps[i].tick;
+    }
+}
+
+/**
+ * Starts or stops recording to the SD card with the current acquisition
+ * parameters.
+ *
+ * @param mode What to record, or SD_RECORD_OFF to finish the recording.
+ *
+ * @return Success or fail.
+ */
+result_t set_sd_recording(const sd_record_mode_t mode)
+{
+    if (mode == SD_RECORD_OFF)
+    {
+        AbortIfNot(stop_sd_recorder(&sd_recorder), fail);
+        return success;
+    }
+
+    capture_file_header_t header;
+    init_capture_file_header(&header);
+    header.sampling_frequency = get_adc_sampling_frequency(&adc);
+    header.clk_div = adc.regs->clk_div;
+    header.decimation = get_adc_decimation(&adc);
+    header.ping_threshold = params.ping_threshold;
+    header.ping_frequency = params.ping_frequency;
+    header.noise_threshold = params.noise_threshold;
+    header.pre_ping_duration_us = ticks_to_micros(params.pre_ping_duration);
+    header.post_ping_duration_us = ticks_to_micros(params.post_ping_duration);
+    header.num_pingers = params.num_pingers;
+    memcpy(header.pinger_frequencies, params.pinger_frequencies, sizeof(header.pinger_frequencies));
+
+    AbortIfNot(start_sd_recorder(&sd_recorder, mode, &header), fail);
+
+    return success;
+}
+
+/**
+ * Selects the subscribers of a stream that a ping is sent to.
+ *
+ * @param stream The stream that carries the ping.
+ * @param all Specified true to send to every subscriber regardless of its
+ *        rate, as for a ping that was requested explicitly.
+ * @param[out] sockets The sockets of the selected subscribers.
+ *
+ * @return The number of subscribers selected.
+ */
+size_t select_subscribers(const subscribed_stream_t stream, const bool all, udp_socket_t **sockets)
+{
+    if (all)
+    {
+        return get_stream_subscribers(&stream_subscriptions, stream, sockets, STREAM_MAX_SUBSCRIBERS);
+    }
+
+    return select_stream_subscribers(&stream_subscriptions,
+                                     stream,
+                                     get_system_time(),
+                                     sockets,
+                                     STREAM_MAX_SUBSCRIBERS);
+}
+
+/**
+ * Sends samples to the subscribers of the data stream.
+ *
+ * @param data The samples to send.
+ * @param count The number of samples.
+ * @param all Specified true to send to every subscriber regardless of its
+ *        rate.
+ *
+ * @return Success or fail.
+ */
+result_t publish_data(sample_t *data, const size_t count, const bool all)
+{
+    /*
+     * A raw stream on a dedicated link takes the place of the subscribers.
+     */
+    if (raw_stream_enabled())
+    {
+        return send_raw_data(data, count);
+    }
+
+    udp_socket_t *sockets[STREAM_MAX_SUBSCRIBERS];
+    const size_t num_sockets = select_subscribers(SUBSCRIBED_DATA, all, sockets);
+    for (size_t i = 0; i < num_sockets; ++i)
+    {
+        AbortIfNot(send_data(sockets[i], data, count), fail);
+    }
+
+    return success;
+}
+
+/**
+ * Sends correlations to the subscribers of the correlation stream.
+ *
+ * @param correlations The correlations to send.
+ * @param count The number of correlations.
+ * @param all Specified true to send to every subscriber regardless of its
+ *        rate.
+ *
+ * @return Success or fail.
+ */
+result_t publish_xcorr(correlation_t *correlations, const size_t count, const bool all)
+{
+    udp_socket_t *sockets[STREAM_MAX_SUBSCRIBERS];
+    const size_t num_sockets = select_subscribers(SUBSCRIBED_XCORR, all, sockets);
+    for (size_t i = 0; i < num_sockets; ++i)
+    {
+        AbortIfNot(send_xcorr(sockets[i], correlations, count), fail);
+    }
+
+    return success;
+}
+
+/**
+ * Starts the background send of samples to the subscribers of the data
+ * stream that are due.
+ *
+ * @note Only the first subscriber is sent in the background. Any others are
+ *       sent before it returns, since the samples are only kept until the
+ *       next capture is processed.
+ *
+ * @param data The samples to send.
+ * @param count The number of samples.
+ *
+ * @return Success or fail.
+ */
+result_t start_publish_data(sample_t *data, const size_t count)
+{
+    if (raw_stream_enabled())
+    {
+        return send_raw_data(data, count);
+    }
+
+    udp_socket_t *sockets[STREAM_MAX_SUBSCRIBERS];
+    const size_t num_sockets = select_subscribers(SUBSCRIBED_DATA, false, sockets);
+    for (size_t i = 1; i < num_sockets; ++i)
+    {
+        AbortIfNot(send_data(sockets[i], data, count), fail);
+    }
+
+    if (num_sockets)
+    {
+        AbortIfNot(start_send_data(&data_stream_job, sockets[0], data, count), fail);
+    }
+
+    return success;
+}
+
+/**
+ * Starts the background send of correlations to the subscribers of the
+ * correlation stream that are due.
+ *
+ * @note Only the first subscriber is sent in the background, as for the data
+ *       stream.
+ *
+ * @param correlations The correlations to send.
+ * @param count The number of correlations.
+ *
+ * @return Success or fail.
+ */
+result_t start_publish_xcorr(correlation_t *correlations, const size_t count)
+{
+    udp_socket_t *sockets[STREAM_MAX_SUBSCRIBERS];
+    const size_t num_sockets = select_subscribers(SUBSCRIBED_XCORR, false, sockets);
+    for (size_t i = 1; i < num_sockets; ++i)
+    {
+        AbortIfNot(send_xcorr(sockets[i], correlations, count), fail);
+    }
+
+    if (num_sockets)
+    {
+        AbortIfNot(start_send_xcorr(&xcorr_stream_job, sockets[0], correlations, count), fail);
+    }
+
+    return success;
+}
+
+/**
+ * Moves the default subscriptions of the data and correlation streams to the
+ * stream destination. A default subscription that was removed by a consumer
+ * is not restored.
+ *
+ * @return None.
+ */
+void follow_stream_destination()
+{
+    if (ip_addr_cmp(&subscribed_destination, &stream_destination))
+    {
+        return;
+    }
+
+    if (unsubscribe_stream(&stream_subscriptions, SUBSCRIBED_DATA, &subscribed_destination, DATA_STREAM_PORT) &&
+        !subscribe_stream(&stream_subscriptions, SUBSCRIBED_DATA, &stream_destination, DATA_STREAM_PORT, 1, 0))
+    {
+        dblog(LOG_WARN, "Failed to move the data stream.\n");
+    }
+
+    if (unsubscribe_stream(&stream_subscriptions, SUBSCRIBED_XCORR, &subscribed_destination, XCORR_STREAM_PORT) &&
+        !subscribe_stream(&stream_subscriptions, SUBSCRIBED_XCORR, &stream_destination, XCORR_STREAM_PORT, 1, 0))
+    {
+        dblog(LOG_WARN, "Failed to move the correlation stream.\n");
+    }
+
+    subscribed_destination = stream_destination;
+}
+
+/**
+ * Parses the destination and rate of a subscription command, with the
+ * fields <address>/<port>/<decimation>/<min interval ms>. The address may be
+ * left out to subscribe the sender of the command, and the rate defaults to
+ * every ping.
+ *
+ * @param value The value of the command.
+ * @param command The command, whose sender is the default address.
+ * @param[out] address The address of the subscriber.
+ * @param[out] port The port of the subscriber.
+ * @param[out] decimation The subscriber is sent every decimation-th ping.
+ * @param[out] min_interval The least time between the pings sent.
+ *
+ * @return Success or fail.
+ */
+result_t parse_subscription(const char *value,
+                            const command_t *command,
+                            struct ip_addr *address,
+                            uint16_t *port,
+                            uint32_t *decimation,
+                            tick_t *min_interval)
+{
+    char address_text[16];
+    unsigned int port_value = 0;
+    unsigned int decimation_value = 1;
+    unsigned int interval_ms = 0;
+
+    const char *separator = strchr(value, '/');
+    const char *dot = strchr(value, '.');
+    if (dot && (!separator || dot < separator))
+    {
+        AbortIfNot(sscanf(value, "%15[^/]/%u/%u/%u",
+                          address_text,
+                          &port_value,
+                          &decimation_value,
+                          &interval_ms) >= 2, fail);
+        AbortIfNot(ipaddr_aton(address_text, address), fail);
+    }
+    else
+    {
+        AbortIfNot(sscanf(value, "%u/%u/%u", &port_value, &decimation_value, &interval_ms) >= 1, fail);
+        *address = command->addr;
+    }
+
+    AbortIfNot(port_value && port_value <= 0xFFFF, fail);
+    AbortIfNot(decimation_value, fail);
+
+    *port = port_value;
+    *decimation = decimation_value;
+    *min_interval = ms_to_ticks(interval_ms);
+
+    return success;
+}
+
+/**
+ * Streams a ping kept in the ping history. Its result is sent again with its
+ * sequence number, followed by its correlations and its window.
+ *
+ * @param sequence The sequence number of the ping.
+ *
+ * @return Success or fail.
+ */
+result_t fetch_ping(const uint32_t sequence)
+{
+    const ping_record_t *record = find_ping_history(&ping_history, sequence);
+    if (!record)
+    {
+        dbprintf("Ping %u is not in the history.\n", sequence);
+        return success;
+    }
+
+    /*
+     * The streams of the current ping are finished first so that their
+     * packets are not interleaved with those of the fetched ping.
+     */
+    AbortIfNot(finish_stream_job(&data_stream_job), fail);
+    AbortIfNot(finish_stream_job(&xcorr_stream_job), fail);
+    AbortIfNot(finish_ping_history_copies(&ping_history), fail);
+    if (!record->valid)
+    {
+        dbprintf("Ping %u could not be kept.\n", sequence);
+        return success;
+    }
+
+    AbortIfNot(send_result(&result_socket,
+                           0,
+                           record->sequence,
+                           record->ping_tick,
+                           &record->trigger,
+                           &record->track,
+                           &record->result,
+                           NULL,
+                           0,
+                           0,
+                           0,
+                           NULL), fail);
+    AbortIfNot(flush_results(), fail);
+    if (record->num_correlations)
+    {
+        AbortIfNot(publish_xcorr(record->correlations, record->num_correlations, true), fail);
+    }
+    AbortIfNot(publish_data(record->samples, record->num_samples, true), fail);
+    dbprintf("Fetched ping %u: %u samples, %u correlations.\n",
+            sequence,
+            record->num_samples,
+            record->num_correlations);
+
+    return success;
+}
+
+/**
+ * Parses an argument packet into key-value pairs.
+ *
+ * @param data The data to parse.
+ * @param len The length of the memory pointed to by data.
+ * @param[out] pairs A list of key-value pairs to store the parsed results in.
+ * @param max_pairs The maximum number of key-value pairs allowed.
+ * @param[out] num_pairs The number of key-value pairs found in the string.
+ *
+ * @return Success or fail.
+ */
+result_t parse_packet(char *data,
+                      const size_t len,
+                      KeyValuePair *pairs,
+                      const size_t max_pairs,
+                      size_t *num_pairs)
+{
+    AbortIfNot(data, fail);
+    AbortIfNot(pairs, fail);
+    AbortIfNot(num_pairs, fail);
+
+    *num_pairs = 0;
+    char *last_start = data;
+    for (int i = 0; i < len && *num_pairs < max_pairs; ++i)
+    {
+        if (data[i] == ',' || data[i] == 0)
+        {
+            pairs[*num_pairs].key = last_start;
+            data[i] = 0;
+            (*num_pairs) = *num_pairs + 1;
+            last_start = &(data[i + 1]);
+        }
+
+        if (data[i] == 0)
+        {
+            break;
+        }
+    }
+
+    for (int i = 0; i < *num_pairs; ++i)
+    {
+        pairs[i].value = NULL;
+        for (int j = 0; j < strlen(pairs[i].key); ++j)
+        {
+            if (pairs[i].key[j] == ':')
+            {
+                pairs[i].key[j] = 0;
+                pairs[i].value = &(pairs[i].key[j + 1]);
+                break;
+            }
+        }
+
+        AbortIfNot(pairs[i].value, fail);
+    }
+
+    return success;
+}
+
+/**
+ * Answers a clock synchronization request.
+ *
+ * @param command The received command.
+ * @param receive_tick The time the command was received.
+ *
+ * @return True if the command was a clock synchronization request.
+ */
+bool answer_time_sync(command_t *command, const tick_t receive_tick)
+{
+    command_header_t header;
+    command_time_sync_t sync;
+    if (!parse_command_header(command->text, command->len, &header) ||
+        header.type != COMMAND_TIME_SYNC)
+    {
+        return false;
+    }
+
+    if (header.length != sizeof(sync))
+    {
+        return true;
+    }
+
+    memcpy(&sync, &command->text[sizeof(header)], sizeof(sync));
+    sync.board_receive_us = ticks_to_micros(receive_tick);
+
+    uint8_t reply[sizeof(header) + sizeof(sync)];
+    header.type = COMMAND_TIME_SYNC_REPLY;
+    header.status = COMMAND_OK;
+    sync.board_transmit_us = ticks_to_micros(get_system_time());
+    memcpy(reply, &header, sizeof(header));
+    memcpy(&reply[sizeof(header)], &sync, sizeof(sync));
+
+    send_udp_to(&command_socket, &command->addr, command->port, reply, sizeof(reply));
+
+    return true;
+}
+
+/**
+ * Callback for receiving a UDP packet.
+ *
+ * @note The network stack is dispatched from within acquisition and
+ *       processing loops, so commands are queued and applied by the main loop
+ *       rather than changing parameters in the middle of a stage.
+ *
+ * @return None.
+ */
+void receive_command(void *arg, struct udp_pcb *upcb, struct pbuf *p, struct ip_addr *addr, uint16_t port)
+{
+    const tick_t receive_tick = get_system_time();
+    command_t command;
+    if (p->len > (sizeof(command.text) - 1))
+    {
+        dbprintf("Packet too long! Length was %d but internal buffer is %d\n",
+                p->len, sizeof(command.text));
+        pbuf_free(p);
+        return;
+    }
+
+    memcpy(command.text, p->payload, p->len);
+    command.text[p->len] = 0;
+    command.len = p->len;
+    command.binary = is_binary_command(command.text, command.len);
+    command.addr = *addr;
+    command.port = port;
+    pbuf_free(p);
+
+    /*
+     * Transfer acknowledgements are handled immediately because the transfer
+     * they refer to is still in progress.
+     */
+    if (!command.binary && handle_transfer_command(command.text))
+    {
+        return;
+    }
+
+    /*
+     * Clock synchronization requests are answered immediately so that the
+     * main loop does not add to the measured round trip.
+     */
+    if (command.binary && answer_time_sync(&command, receive_tick))
+    {
+        return;
+    }
+
+    if (!spsc_push(&command_queue, &command))
+    {
+        dbprintf("Command queue full. Dropping command.\n");
+    }
+}
+
+/**
+ * Applies the configured rate limit of the streams, capped to the share of
+ * the Ethernet link they may use so that a link that negotiated below
+ * gigabit is not overrun.
+ *
+ * @return Success or fail.
+ */
+result_t apply_transmit_rate()
+{
+    const uint32_t link_rate = (uint32_t)((uint64_t)get_link_bytes_per_second() *
+            NETWORK_LINK_TRANSMIT_PERCENT / 100);
+
+    effective_transmit_rate = transmit_rate_bytes_per_second;
+    if (link_rate && (!effective_transmit_rate || effective_transmit_rate > link_rate))
+    {
+        effective_transmit_rate = link_rate;
+    }
+
+    AbortIfNot(set_transmit_rate(effective_transmit_rate, transmit_burst_bytes), fail);
+
+    return success;
+}
+
+/**
+ * Applies a received command to the operating parameters.
+ *
+ * @param command The command to apply.
+ *
+ * @return None.
+ */
+void apply_command(command_t *command)
+{
+    KeyValuePair pairs[10];
+    size_t num_entries = 0;
+
+    char *data = command->text;
+
+    AbortIfNot(parse_packet(data, strlen(data) + 1, pairs, 10, &num_entries), );
+
+    for (int i = 0; i < num_entries; ++i)
+    {
+        dbprintf("Key: '%s' Value: '%s'\n", pairs[i].key, pairs[i].value);
+        if (strcmp(pairs[i].key, "threshold") == 0)
+        {
+            unsigned int threshold;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &threshold), );
+            params.ping_threshold = threshold;
+            sync = false;
+            dbprintf("Ping threshold has been set to %d\n", params.ping_threshold);
+        }
+        else if (strcmp(pairs[i].key, "ping_frequency_hz") == 0)
+        {
+            unsigned int frequency;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &frequency), );
+            AbortIfNot(frequency < get_adc_sampling_frequency(&adc) / 2, );
+            params.ping_frequency = frequency;
+            sync = false;
+            dbprintf("Ping frequency has been set to %u Hz\n", params.ping_frequency);
+        }
+        else if (strcmp(pairs[i].key, "pinger_frequencies_hz") == 0)
+        {
+            /*
+             * Frequencies are separated by '/'. A value of zero clears the
+             * filter bank.
+             */
+            uint32_t frequencies[MAX_PINGERS];
+            size_t count = 0;
+            char *value = pairs[i].value;
+            while (*value && count < MAX_PINGERS)
+            {
+                unsigned int frequency = 0;
+                AbortIfNot(sscanf(value, "%u", &frequency), );
+                AbortIfNot(frequency < get_adc_sampling_frequency(&adc) / 2, );
+                if (frequency)
+                {
+                    frequencies[count++] = frequency;
+                }
+
+                while (*value && *value != '/')
+                {
+                    value++;
+                }
+
+                if (*value == '/')
+                {
+                    value++;
+                }
+            }
+
+            memcpy(params.pinger_frequencies, frequencies, count * sizeof(uint32_t));
+            params.num_pingers = count;
+            pinger_bank_stale = true;
+            dbprintf("Filter bank has %u pingers\n", params.num_pingers);
+        }
+        else if (strcmp(pairs[i].key, "filter") == 0)
+        {
+            unsigned int debug = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &debug), );
+            params.filter = (debug == 0)? false : true;
+            dbprintf("Filtering is: %s\n",
+                    (debug_stream)? "Enabled" : "Disabled");
+        }
+        else if (strcmp(pairs[i].key, "filter_sections") == 0)
+        {
+            /*
+             * Coefficients are separated by '/', six to a section as b0, b1,
+             * b2, a0, a1, a2.
+             */
+            filter_coefficients_t sections[MAX_FILTER_SECTIONS];
+            size_t count = 0;
+            char *value = pairs[i].value;
+            while (*value && count < MAX_FILTER_SECTIONS * 6)
+            {
+                float coefficient = 0;
+                AbortIfNot(sscanf(value, "%f", &coefficient), );
+                sections[count / 6].coefficients[count % 6] = coefficient;
+                count++;
+
+                while (*value && *value != '/')
+                {
+                    value++;
+                }
+
+                if (*value == '/')
+                {
+                    value++;
+                }
+            }
+
+            AbortIfNot(count && count % 6 == 0, );
+            AbortIfNot(set_capture_filter(sections, count / 6), );
+            dbprintf("Filter has %u sections\n", num_filter_sections);
+        }
+        else if (strcmp(pairs[i].key, "planar") == 0)
+        {
+            unsigned int enable = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &enable), );
+            planar_dsp = (enable == 0)? false : true;
+            dbprintf("Planar DSP is: %s\n",
+                    (planar_dsp)? "Enabled" : "Disabled");
+        }
+        else if (strcmp(pairs[i].key, "planar_capture") == 0)
+        {
+            unsigned int enable = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &enable), );
+            planar_capture = (enable == 0)? false : true;
+            dbprintf("Planar capture is: %s\n",
+                    (planar_capture)? "Enabled" : "Disabled");
+        }
+        else if (strcmp(pairs[i].key, "quiet_windows") == 0)
+        {
+            unsigned int enable = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &enable), );
+            set_transmit_quiet_enabled((enable == 0)? false : true);
+            dbprintf("Streams held around capture windows: %s\n",
+                    (enable)? "Enabled" : "Disabled");
+        }
+        else if (strcmp(pairs[i].key, "packet_stats") == 0)
+        {
+            unsigned int enable = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &enable), );
+            packet_stats = (enable == 0)? false : true;
+            dbprintf("Packet statistics are: %s\n",
+                    (packet_stats)? "Enabled" : "Disabled");
+        }
+        else if (strcmp(pairs[i].key, "hw_trigger") == 0)
+        {
+            unsigned int enable = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &enable), );
+
+            /*
+             * The first packet of the triggered window is the pre-trigger
+             * history, which the core cannot hold for longer packets.
+             */
+            const size_t samples_per_packet = (requested_samples_per_packet)?
+                    requested_samples_per_packet : params.samples_per_packet;
+            AbortIf(enable && samples_per_packet > ADC_TRIGGER_MAX_PRE_SAMPLES, );
+
+            params.hw_trigger = (enable == 0)? false : true;
+            sync = false;
+            dbprintf("Hardware trigger is: %s\n",
+                    (params.hw_trigger)? "Enabled" : "Disabled");
+        }
+        else if (strcmp(pairs[i].key, "hw_envelope") == 0)
+        {
+            unsigned int enable = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &enable), );
+            params.hw_envelope = (enable == 0)? false : true;
+            sync = false;
+            dbprintf("Hardware envelope is: %s\n",
+                    (params.hw_envelope)? "Enabled" : "Disabled");
+        }
+        else if (strcmp(pairs[i].key, "dual_rate") == 0)
+        {
+            unsigned int enable = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &enable), );
+            params.dual_rate = (enable == 0)? false : true;
+            sync = false;
+            dbprintf("Dual-rate sync is: %s\n",
+                    (params.dual_rate)? "Enabled" : "Disabled");
+        }
+        else if (strcmp(pairs[i].key, "masked_sync") == 0)
+        {
+            unsigned int enable = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &enable), );
+            params.masked_sync = (enable == 0)? false : true;
+            dbprintf("Masked sync is: %s\n",
+                    (params.masked_sync)? "Enabled" : "Disabled");
+        }
+        else if (strcmp(pairs[i].key, "continuous_capture") == 0)
+        {
+            unsigned int enable = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &enable), );
+            params.continuous_capture = (enable == 0)? false : true;
+            sync = false;
+            dbprintf("Continuous capture is: %s\n",
+                    (params.continuous_capture)? "Enabled" : "Disabled");
+        }
+        else if (strcmp(pairs[i].key, "dma_irq_threshold") == 0)
+        {
+            unsigned int threshold = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &threshold), );
+            AbortIfNot(threshold >= 1 && threshold <= 255, );
+            params.dma_irq_threshold = threshold;
+            dbprintf("DMA interrupts coalesce %u completions\n", params.dma_irq_threshold);
+        }
+        else if (strcmp(pairs[i].key, "dma_irq_delay_us") == 0)
+        {
+            unsigned int delay = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &delay), );
+            AbortIfNot(delay <= DMA_IRQ_DELAY_MAX_US, );
+            params.dma_irq_delay_us = delay;
+            dbprintf("DMA interrupt delay has been set to %u us\n", params.dma_irq_delay_us);
+        }
+        else if (strcmp(pairs[i].key, "accelerator") == 0)
+        {
+            unsigned int module = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &module), );
+            AbortIfNot(module <= ACCELERATOR_MAX_MODULES, );
+            params.accelerator_module = module;
+            dbprintf("Accelerator module %u requested\n", params.accelerator_module);
+        }
+        else if (strcmp(pairs[i].key, "hydrophone_spacing") == 0)
+        {
+            /*
+             * Place channels A, B, and C along the x, y, and z axes, with the
+             * spacing given in micrometers.
+             */
+            unsigned int spacing = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &spacing), );
+            AbortIfNot(init_hydrophone_array(&hydrophone_array, spacing / 1000000.0f), );
+            dbprintf("Hydrophone spacing is %u um.\n", spacing);
+        }
+        else if (strcmp(pairs[i].key, "position_a") == 0 ||
+                 strcmp(pairs[i].key, "position_b") == 0 ||
+                 strcmp(pairs[i].key, "position_c") == 0)
+        {
+            /*
+             * The position is given as x/y/z in micrometers.
+             */
+            int x = 0, y = 0, z = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%d/%d/%d", &x, &y, &z) == 3, );
+            const float position[3] = {x / 1000000.0f, y / 1000000.0f, z / 1000000.0f};
+            const size_t channel = pairs[i].key[strlen("position_")] - 'a';
+            AbortIfNot(set_hydrophone_position(&hydrophone_array, channel, position), );
+            dbprintf("Hydrophone %c is at %d/%d/%d um.\n", 'A' + channel, x, y, z);
+        }
+        else if (strcmp(pairs[i].key, "xcorr_stream") == 0)
+        {
+            unsigned int enable = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &enable), );
+            xcorr_stream = (enable == 0)? false : true;
+            dbprintf("Correlation stream is: %s\n",
+                    (xcorr_stream)? "Enabled" : "Disabled");
+        }
+        else if (strcmp(pairs[i].key, "preview") == 0)
+        {
+            unsigned int enable = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &enable), );
+            preview_stream = (enable == 0)? false : true;
+            dbprintf("Preview stream is: %s\n",
+                    (preview_stream)? "Enabled" : "Disabled");
+        }
+        else if (strcmp(pairs[i].key, "record") == 0)
+        {
+            unsigned int enable = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &enable), );
+            record_stream = (enable == 0)? false : true;
+            dbprintf("Record stream is: %s\n",
+                    (record_stream)? "Enabled" : "Disabled");
+        }
+        else if (strcmp(pairs[i].key, "data_stream") == 0)
+        {
+            unsigned int enable = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &enable), );
+            data_stream = (enable == 0)? false : true;
+            dbprintf("Data stream is: %s\n",
+                    (data_stream)? "Enabled" : "Disabled");
+        }
+        else if (strcmp(pairs[i].key, "fetch_ping") == 0)
+        {
+            unsigned int sequence = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &sequence), );
+            AbortIfNot(fetch_ping(sequence), );
+        }
+        else if (strcmp(pairs[i].key, "usb_stream") == 0)
+        {
+            unsigned int enable = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &enable), );
+            usb_capture_stream = (enable == 0)? false : true;
+            dbprintf("USB capture stream is: %s\n",
+                    (usb_capture_stream)? "Enabled" : "Disabled");
+        }
+        else if (strcmp(pairs[i].key, "sd_record") == 0)
+        {
+            unsigned int mode = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &mode), );
+            AbortIfNot(mode <= SD_RECORD_CAPTURES, );
+            AbortIfNot(set_sd_recording((sd_record_mode_t)mode), );
+            dbprintf("SD card recording is: %s\n",
+                    (mode == SD_RECORD_PINGS)? "Pings" : (mode == SD_RECORD_CAPTURES)? "Captures" : "Disabled");
+        }
+        else if (strcmp(pairs[i].key, "reference") == 0)
+        {
+            unsigned int reference = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &reference), );
+            AbortIfNot(reference < 4, );
+            params.reference_channel = reference;
+            dbprintf("Reference channel is: %u\n", reference);
+        }
+        else if (strcmp(pairs[i].key, "all_pairs") == 0)
+        {
+            unsigned int enable = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &enable), );
+            params.all_pairs = (enable == 0)? false : true;
+            dbprintf("All pairs correlation is: %s\n",
+                    (params.all_pairs)? "Enabled" : "Disabled");
+        }
+        else if (strcmp(pairs[i].key, "phat") == 0)
+        {
+            unsigned int enable = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &enable), );
+            params.phat = (enable == 0)? false : true;
+            dbprintf("PHAT correlation is: %s\n",
+                    (params.phat)? "Enabled" : "Disabled");
+        }
+        else if (strcmp(pairs[i].key, "envelope_onset") == 0)
+        {
+            unsigned int enable = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &enable), );
+            params.envelope_onset = (enable == 0)? false : true;
+            dbprintf("Envelope onset trimming is: %s\n",
+                    (params.envelope_onset)? "Enabled" : "Disabled");
+        }
+        else if (strcmp(pairs[i].key, "average_pings") == 0)
+        {
+            unsigned int count = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &count), );
+            AbortIfNot(count <= CORRELATION_AVERAGE_MAX_PINGS, );
+            params.average_pings = count;
+            dbprintf("Correlations are averaged over %d pings\n", params.average_pings);
+        }
+        else if (strcmp(pairs[i].key, "fast_tdoa") == 0)
+        {
+            /*
+             * Pings between full correlations whose delays are taken from
+             * their leading edges, or zero to correlate every ping.
+             */
+            unsigned int interval = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &interval), );
+            AbortIfNot(interval <= UINT8_MAX, );
+            params.fast_tdoa_interval = interval;
+            pings_since_correlation = 0;
+            dbprintf("Pings are correlated every %u pings\n", (interval > 1)? interval : 1);
+        }
+        else if (strcmp(pairs[i].key, "average_exponential") == 0)
+        {
+            unsigned int enable = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &enable), );
+            params.average_exponential = (enable == 0)? false : true;
+            dbprintf("Exponential correlation averaging is: %s\n",
+                    (params.average_exponential)? "Enabled" : "Disabled");
+        }
+        else if (strcmp(pairs[i].key, "coarse_search") == 0)
+        {
+            unsigned int enable = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &enable), );
+            params.coarse_search = (enable == 0)? false : true;
+            dbprintf("Coarse lag search is: %s\n",
+                    (params.coarse_search)? "Enabled" : "Disabled");
+        }
+        else if (strcmp(pairs[i].key, "track_lags") == 0)
+        {
+            unsigned int enable = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &enable), );
+            params.track_lags = (enable == 0)? false : true;
+            dbprintf("Lag tracking is: %s\n",
+                    (params.track_lags)? "Enabled" : "Disabled");
+        }
+        else if (strcmp(pairs[i].key, "exclude_unhealthy") == 0)
+        {
+            /*
+             * Locate pings on a healthy reference and skip the correlation
+             * of pings while any channel is flagged.
+             */
+            unsigned int enable = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &enable), );
+            exclude_unhealthy = (enable == 0)? false : true;
+            dbprintf("Unhealthy channel exclusion is: %s\n",
+                    (exclude_unhealthy)? "Enabled" : "Disabled");
+        }
+        else if (strcmp(pairs[i].key, "channel_health") == 0)
+        {
+            if (strcmp(pairs[i].value, "reset") == 0)
+            {
+                AbortIfNot(init_channel_health(&channel_health), );
+                dbprintf("Channel health reset.\n");
+            }
+            else
+            {
+                for (size_t k = 0; k < 4; ++k)
+                {
+                    dbprintf("Channel %c: flags 0x%x (latest 0x%x), RMS %d, offset %d, %u clipped, flagged %u times\n",
+                            'A' + (int)k,
+                            channel_health.flags[k],
+                            channel_health.observed[k],
+                            (int)channel_health.latest.rms[k],
+                            channel_health.latest.offset[k],
+                            channel_health.latest.clipped_samples[k],
+                            channel_health.faults[k]);
+                }
+            }
+        }
+        else if (strcmp(pairs[i].key, "calibrate") == 0)
+        {
+            /*
+             * Average the given number of pings from a source at
+             * bearing/elevation in degrees, or from a signal common to every
+             * channel when no direction is given.
+             */
+            unsigned int pings = 0;
+            int bearing = 0, elevation = 0;
+            const int fields = sscanf(pairs[i].value, "%u/%d/%d", &pings, &bearing, &elevation);
+            AbortIfNot(fields == 1 || fields == 3, );
+            AbortIfNot(start_calibration(&calibration_run,
+                                         pings,
+                                         (fields == 3)? &hydrophone_array : NULL,
+                                         bearing,
+                                         elevation), );
+            if (fields == 3)
+            {
+                dbprintf("Calibrating over %u pings from %d deg, elevation %d deg.\n", pings, bearing, elevation);
+            }
+            else
+            {
+                dbprintf("Calibrating over %u pings of a common signal.\n", pings);
+            }
+        }
+        else if (strcmp(pairs[i].key, "calibration") == 0)
+        {
+            if (strcmp(pairs[i].value, "clear") == 0)
+            {
+                channel_calibration_t cleared;
+                init_channel_calibration(&cleared);
+                calibration_run.active = false;
+                AbortIfNot(set_channel_calibration(&cleared), );
+            }
+            else if (strcmp(pairs[i].value, "cancel") == 0)
+            {
+                calibration_run.active = false;
+                dbprintf("Calibration cancelled.\n");
+            }
+            else
+            {
+                report_channel_calibration();
+                if (calibration_run.active)
+                {
+                    dbprintf("Calibration has averaged %u of %u pings.\n",
+                            calibration_run.pings,
+                            calibration_run.target_pings);
+                }
+            }
+        }
+        else if (strcmp(pairs[i].key, "calibration_a") == 0 ||
+                 strcmp(pairs[i].key, "calibration_b") == 0 ||
+                 strcmp(pairs[i].key, "calibration_c") == 0)
+        {
+            /*
+             * The calibration is given as the skew from the reference in
+             * picoseconds and the gain in thousandths.
+             */
+            int skew = 0;
+            unsigned int gain = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%d/%u", &skew, &gain) == 2, );
+            AbortIfNot(skew >= -1 * CALIBRATION_MAX_SKEW_NS * 1000 && skew <= CALIBRATION_MAX_SKEW_NS * 1000, );
+            AbortIfNot(gain * CALIBRATION_MAX_GAIN >= 1000 && gain <= CALIBRATION_MAX_GAIN * 1000, );
+            channel_calibration_t calibration = channel_calibration;
+            const size_t channel = pairs[i].key[strlen("calibration_")] - 'a' + 1;
+            calibration.delay_ns[channel] = skew / 1000.0f;
+            calibration.gain[channel] = gain / 1000.0f;
+            AbortIfNot(set_channel_calibration(&calibration), );
+        }
+        else if (strcmp(pairs[i].key, "trigger_any") == 0)
+        {
+            unsigned int enable = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &enable), );
+            params.trigger_any_channel = (enable == 0)? false : true;
+            dbprintf("Trigger on any channel is: %s\n",
+                    (params.trigger_any_channel)? "Enabled" : "Disabled");
+        }
+        else if (strcmp(pairs[i].key, "window_normalize") == 0)
+        {
+            unsigned int enable = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &enable), );
+            params.window_normalize = (enable == 0)? false : true;
+            dbprintf("Window normalization is: %s\n",
+                    (params.window_normalize)? "Enabled" : "Disabled");
+        }
+        else if (strcmp(pairs[i].key, "lazy_filter") == 0)
+        {
+            unsigned int enable = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &enable), );
+            params.lazy_filter = (enable == 0)? false : true;
+            dbprintf("Filtering only the located window is: %s\n",
+                    (params.lazy_filter)? "Enabled" : "Disabled");
+        }
+        else if (strcmp(pairs[i].key, "noise_threshold") == 0)
+        {
+            unsigned int multiple = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &multiple), );
+            AbortIfNot(multiple <= UINT8_MAX, );
+            params.noise_threshold = multiple;
+            dbprintf("Noise threshold has been set to %d times the noise RMS\n", params.noise_threshold);
+        }
+        else if (strcmp(pairs[i].key, "cfar_threshold") == 0)
+        {
+            unsigned int multiple = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &multiple), );
+            AbortIfNot(multiple <= UINT8_MAX, );
+            params.cfar_threshold = multiple;
+            dbprintf("CFAR threshold has been set to %d times the noise floor\n", params.cfar_threshold);
+        }
+        else if (strcmp(pairs[i].key, "matched_threshold") == 0)
+        {
+            unsigned int percent = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &percent), );
+            AbortIfNot(percent <= 100, );
+            params.matched_threshold = percent;
+            dbprintf("Matched filter threshold has been set to %d%%\n", params.matched_threshold);
+        }
+        else if (strcmp(pairs[i].key, "dsp_decimation") == 0)
+        {
+            /*
+             * The decimation needs the planar storage, and is reduced if the
+             * decimated rate would be too low for the ping frequency.
+             */
+            unsigned int factor = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &factor), );
+            AbortIfNot(factor <= MAX_DECIMATION, );
+            params.dsp_decimation = factor;
+            dbprintf("Processing decimation has been set to %d%s\n",
+                    params.dsp_decimation,
+                    (planar_dsp || factor <= 1)? "" : " (needs planar processing)");
+        }
+        else if (strcmp(pairs[i].key, "fir_bandpass") == 0)
+        {
+            /*
+             * The number of taps, then the edges of the band in Hz, separated
+             * by '/'. Zero taps returns to the biquad cascade.
+             */
+            unsigned int taps = 0, low_hz = 0, high_hz = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u/%u/%u", &taps, &low_hz, &high_hz) >= 1, );
+            AbortIfNot(taps <= FIR_FILTER_MAX_TAPS, );
+            AbortIfNot(taps == 0 || (taps % 2 == 1 && low_hz < high_hz), );
+            capture_fir_num_taps = taps;
+            capture_fir_low_hz = low_hz;
+            capture_fir_high_hz = high_hz;
+            capture_fir_sampling_frequency = 0;
+            AbortIfNot(set_fir_taps(&capture_fir, NULL, 0), );
+            if (taps)
+            {
+                dbprintf("FIR bandpass has been set to %u taps from %u to %u Hz\n", taps, low_hz, high_hz);
+            }
+            else
+            {
+                dbprintf("FIR bandpass has been disabled\n");
+            }
+        }
+        else if (strcmp(pairs[i].key, "matched_template") == 0)
+        {
+            /*
+             * The offset of the first sample in the template, then samples,
+             * separated by '/'. A long template is uploaded in order over
+             * several commands, and an offset of zero alone clears it.
+             */
+            unsigned int offset = 0;
+            char *value = pairs[i].value;
+            AbortIfNot(sscanf(value, "%u", &offset), );
+            while (*value && *value != '/')
+            {
+                value++;
+            }
+
+            if (*value == '/')
+            {
+                value++;
+            }
+
+            /*
+             * Each sample takes at least two characters of the command.
+             */
+            float samples[sizeof(((command_t *)0)->text) / 2];
+            size_t count = 0;
+            while (*value && count < sizeof(samples) / sizeof(float))
+            {
+                float sample = 0;
+                AbortIfNot(sscanf(value, "%f", &sample), );
+                samples[count++] = sample;
+
+                while (*value && *value != '/')
+                {
+                    value++;
+                }
+
+                if (*value == '/')
+                {
+                    value++;
+                }
+            }
+
+            AbortIfNot(set_matched_template(&matched_filter, samples, offset, count), );
+            dbprintf("Matched filter template has %u samples\n", matched_filter.template_len);
+        }
+        else if (strcmp(pairs[i].key, "min_ping_quality") == 0)
+        {
+            unsigned int percent = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &percent), );
+            AbortIfNot(percent <= 100, );
+            params.min_ping_quality = percent;
+            dbprintf("Minimum ping quality has been set to %d%%\n", params.min_ping_quality);
+        }
+        else if (strcmp(pairs[i].key, "hw_correlate") == 0)
+        {
+            unsigned int enable = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &enable), );
+            params.hw_correlate = (enable == 0)? false : true;
+            sync = false;
+            dbprintf("Hardware correlation is: %s\n",
+                    (params.hw_correlate)? "Enabled" : "Disabled");
+        }
+        else if (strcmp(pairs[i].key, "debug") == 0)
+        {
+            unsigned int debug = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &debug), );
+            debug_stream = (debug == 0)? false : true;
+            raw_debug_stream = (debug == 2)? true : false;
+            dbprintf("Debug stream is: %s\n",
+                    (raw_debug_stream)? "Raw" : (debug_stream)? "Enabled" : "Disabled");
+        }
+        else if (strcmp(pairs[i].key, "compress") == 0)
+        {
+            unsigned int compress = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &compress), );
+            set_data_encoding((compress == 0)? STREAM_ENCODING_RAW : STREAM_ENCODING_DELTA);
+            dbprintf("Data stream compression is: %s\n",
+                    (compress)? "Enabled" : "Disabled");
+        }
+        else if (strcmp(pairs[i].key, "xcorr_decimation") == 0)
+        {
+            /*
+             * Stream every Nth correlation lag, or every lag for one or zero.
+             */
+            unsigned int factor = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &factor), );
+            AbortIfNot(set_xcorr_view((factor > 1)? XCORR_VIEW_DECIMATED : XCORR_VIEW_FULL,
+                                      factor), );
+            dbprintf("Correlation decimation is %u.\n", factor);
+        }
+        else if (strcmp(pairs[i].key, "xcorr_peak_radius") == 0)
+        {
+            /*
+             * Stream only the lags around each correlation peak, or every lag
+             * for zero.
+             */
+            unsigned int radius = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &radius), );
+            AbortIfNot(set_xcorr_view((radius)? XCORR_VIEW_PEAK : XCORR_VIEW_FULL, radius), );
+            dbprintf("Correlation peak radius is %u lags.\n", radius);
+        }
+        else if (strcmp(pairs[i].key, "reliable") == 0)
+        {
+            unsigned int reliable = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &reliable), );
+            set_reliable_transfer((reliable == 0)? false : true);
+            dbprintf("Reliable data transfer is: %s\n",
+                    (reliable)? "Enabled" : "Disabled");
+        }
+        else if (strcmp(pairs[i].key, "tcp_stream") == 0)
+        {
+            unsigned int enable = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &enable), );
+            /*
+             * The TCP stream is written from CPU0, so it needs the network
+             * stack there.
+             */
+            if (enable && network_core_running())
+            {
+                dbprintf("TCP capture stream is unavailable while CPU1 owns the network.\n");
+                continue;
+            }
+
+            tcp_stream = (enable == 0)? false : true;
+            dbprintf("TCP capture stream is: %s\n",
+                    (tcp_stream)? "Enabled" : "Disabled");
+        }
+        else if (strcmp(pairs[i].key, "replay") == 0)
+        {
+            unsigned int enable = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &enable), );
+            replay_mode = (enable == 0)? false : true;
+            dbprintf("Capture replay is: %s\n",
+                    (replay_mode)? "Enabled" : "Disabled");
+        }
+        else if (strcmp(pairs[i].key, "synthetic") == 0)
+        {
+            unsigned int enable = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &enable), );
+            synthetic_mode = (enable == 0)? false : true;
+            synthetic_restart = true;
+            dbprintf("Synthetic pings are: %s\n",
+                    (synthetic_mode)? "Enabled" : "Disabled");
+        }
+        else if (strcmp(pairs[i].key, "synth_ping") == 0)
+        {
+            /*
+             * The period of the synthetic pinger in ms, then optionally the
+             * drift of its clock in ppm and the jitter of each period in us.
+             */
+            unsigned int period = 0;
+            int drift = 0;
+            unsigned int jitter = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u/%d/%u", &period, &drift, &jitter) >= 1, );
+            AbortIfNot(period, );
+            synth_config.period_ms = period;
+            synth_config.drift_ppm = drift;
+            synth_config.jitter_us = jitter;
+            synthetic_restart = true;
+            dbprintf("Synthetic pings every %u ms, drift %d ppm, jitter %u us\n", period, drift, jitter);
+        }
+        else if (strcmp(pairs[i].key, "synth_delays") == 0)
+        {
+            int delays[3] = {0};
+            AbortIfNot(sscanf(pairs[i].value, "%d/%d/%d", &delays[0], &delays[1], &delays[2]) == 3, );
+            for (size_t k = 0; k < 3; ++k)
+            {
+                synth_config.delays_ns[k] = delays[k];
+            }
+            synthetic_restart = true;
+            dbprintf("Synthetic delays: %d %d %d ns\n", delays[0], delays[1], delays[2]);
+        }
+        else if (strcmp(pairs[i].key, "synth_level") == 0)
+        {
+            /*
+             * The peak amplitude of the ping and of the noise in ADC codes.
+             */
+            unsigned int amplitude = 0;
+            unsigned int noise = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u/%u", &amplitude, &noise) == 2, );
+            AbortIfNot(amplitude <= INT16_MAX && noise <= INT16_MAX, );
+            synth_config.amplitude = amplitude;
+            synth_config.noise_amplitude = noise;
+            synthetic_restart = true;
+            dbprintf("Synthetic ping amplitude %u, noise %u\n", amplitude, noise);
+        }
+        else if (strcmp(pairs[i].key, "synth_echo") == 0)
+        {
+            /*
+             * The delay of the echo behind the ping in us and its amplitude in
+             * percent of the ping. Zero percent removes the echo.
+             */
+            unsigned int delay = 0;
+            unsigned int percent = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u/%u", &delay, &percent) == 2, );
+            AbortIfNot(percent <= 100, );
+            synth_config.echo_delay_us = delay;
+            synth_config.echo_percent = percent;
+            synthetic_restart = true;
+            dbprintf("Synthetic echo %u us behind at %u%%\n", delay, percent);
+        }
+        else if (strcmp(pairs[i].key, "subscribe_data") == 0 ||
+                 strcmp(pairs[i].key, "subscribe_xcorr") == 0)
+        {
+            /*
+             * Subscribes a consumer to a stream, or changes its rate with
+             * <address>/<port>/<decimation>/<min interval ms>.
+             */
+            const subscribed_stream_t stream = (strcmp(pairs[i].key, "subscribe_data") == 0)?
+                    SUBSCRIBED_DATA : SUBSCRIBED_XCORR;
+            struct ip_addr address;
+            uint16_t port;
+            uint32_t decimation;
+            tick_t min_interval;
+            AbortIfNot(parse_subscription(pairs[i].value,
+                                          command,
+                                          &address,
+                                          &port,
+                                          &decimation,
+                                          &min_interval), );
+            AbortIfNot(subscribe_stream(&stream_subscriptions,
+                                        stream,
+                                        &address,
+                                        port,
+                                        decimation,
+                                        min_interval), );
+            dbprintf("Subscribed %s:%u to the %s stream every %u pings.\n",
+                    ipaddr_ntoa(&address), port,
+                    (stream == SUBSCRIBED_DATA)? "data" : "correlation",
+                    decimation);
+        }
+        else if (strcmp(pairs[i].key, "unsubscribe_data") == 0 ||
+                 strcmp(pairs[i].key, "unsubscribe_xcorr") == 0)
+        {
+            const subscribed_stream_t stream = (strcmp(pairs[i].key, "unsubscribe_data") == 0)?
+                    SUBSCRIBED_DATA : SUBSCRIBED_XCORR;
+            struct ip_addr address;
+            uint16_t port;
+            uint32_t decimation;
+            tick_t min_interval;
+            AbortIfNot(parse_subscription(pairs[i].value,
+                                          command,
+                                          &address,
+                                          &port,
+                                          &decimation,
+                                          &min_interval), );
+            AbortIfNot(unsubscribe_stream(&stream_subscriptions, stream, &address, port), );
+            dbprintf("Unsubscribed %s:%u from the %s stream.\n",
+                    ipaddr_ntoa(&address), port,
+                    (stream == SUBSCRIBED_DATA)? "data" : "correlation");
+        }
+        else if (strcmp(pairs[i].key, "stream_destination") == 0)
+        {
+            struct ip_addr destination;
+            AbortIfNot(ipaddr_aton(pairs[i].value, &destination), );
+
+            stream_destination = destination;
+            stream_destination_stale = true;
+            dbprintf("Stream destination is %s (%s).\n", pairs[i].value,
+                    (ip_addr_ismulticast(&destination))? "multicast" : "unicast");
+        }
+        else if (strcmp(pairs[i].key, "raw_stream") == 0)
+        {
+            /*
+             * The data stream is sent as raw frames to the MAC address
+             * given, or over UDP again for zero.
+             */
+            if (strcmp(pairs[i].value, "0") == 0)
+            {
+                set_raw_stream(false, NULL);
+                dbprintf("Raw data stream is: Disabled\n");
+            }
+            else
+            {
+                unsigned int mac[6];
+                AbortIfNot(sscanf(pairs[i].value, "%x:%x:%x:%x:%x:%x",
+                                  &mac[0], &mac[1], &mac[2], &mac[3], &mac[4], &mac[5]) == 6, );
+                uint8_t destination[6];
+                for (size_t k = 0; k < 6; ++k)
+                {
+                    AbortIfNot(mac[k] <= 0xFF, );
+                    destination[k] = mac[k];
+                }
+                set_raw_stream(true, destination);
+                dbprintf("Raw data stream is: Enabled to %s\n", pairs[i].value);
+            }
+        }
+        else if (strcmp(pairs[i].key, "samples_per_packet") == 0)
+        {
+            unsigned int samples_per_packet = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &samples_per_packet), );
+            AbortIfNot(samples_per_packet >= ADC_HEADER_SAMPLES, );
+            AbortIfNot(samples_per_packet * sizeof(sample_t) <= dma.max_transfer_bytes, );
+            AbortIfNot(dma.ring.descriptors, );
+            AbortIf(packed_samples &&
+                    (samples_per_packet - ADC_HEADER_SAMPLES) % ADC_PACKED_GROUP_SAMPLES, );
+            AbortIf(params.hw_trigger && samples_per_packet > ADC_TRIGGER_MAX_PRE_SAMPLES, );
+
+            requested_samples_per_packet = samples_per_packet;
+            dbprintf("Samples per packet will be set to %u.\n", samples_per_packet);
+        }
+        else if (strcmp(pairs[i].key, "decimation") == 0)
+        {
+            unsigned int rate = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &rate), );
+            AbortIfNot(rate && (rate & (rate - 1)) == 0, );
+            AbortIfNot(rate <= (1 << ADC_MAX_DECIMATION_RATE_LOG2), );
+
+            requested_decimation = rate;
+            dbprintf("Decimation will be set to %u.\n", rate);
+        }
+        else if (strcmp(pairs[i].key, "sample_rate") == 0)
+        {
+            unsigned int frequency = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &frequency), );
+            AbortIfNot(frequency >= ADC_MIN_SAMPLING_FREQUENCY, );
+            AbortIfNot(frequency <= ADC_MAX_SAMPLING_FREQUENCY, );
+            AbortIfNot(adc.encode_clock, );
+
+            requested_sampling_frequency = frequency;
+            dbprintf("Sampling frequency will be set to %u Hz.\n", frequency);
+        }
+        else if (strcmp(pairs[i].key, "packed_samples") == 0)
+        {
+            unsigned int enable = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &enable), );
+
+            const size_t samples_per_packet = (requested_samples_per_packet)?
+                    requested_samples_per_packet : params.samples_per_packet;
+            AbortIf(enable && (samples_per_packet - ADC_HEADER_SAMPLES) % ADC_PACKED_GROUP_SAMPLES, );
+
+            packed_samples = (enable == 0)? false : true;
+            packed_samples_stale = true;
+            dbprintf("Packed samples will be: %s\n",
+                    (packed_samples)? "Enabled" : "Disabled");
+        }
+        else if (strcmp(pairs[i].key, "survey") == 0)
+        {
+            /*
+             * The duration in milliseconds, optionally followed by '/' and
+             * the segment length. A duration of zero stops a survey.
+             */
+            unsigned int duration = 0;
+            unsigned int fft_len = survey_fft_len;
+            AbortIfNot(sscanf(pairs[i].value, "%u/%u", &duration, &fft_len) >= 1, );
+            AbortIfNot(duration <= SURVEY_MAX_DURATION_MS, );
+            AbortIfNot(fft_len >= 64 && fft_len <= SURVEY_MAX_FFT_LEN && fft_size(fft_len) == fft_len, );
+            requested_survey_ms = duration;
+            survey_fft_len = fft_len;
+            dbprintf("Survey of %u ms with %u point segments requested.\n", duration, fft_len);
+        }
+        else if (strcmp(pairs[i].key, "sync") == 0)
+        {
+            /*
+             * The role of the board in the sync of an array: 0 takes no
+             * part, 1 follows the master, and 2 is the master.
+             */
+            unsigned int role = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &role), );
+            AbortIfNot(set_board_sync_role(&board_sync, (board_sync_role_t)role), );
+            dbprintf("Board sync role is: %s\n",
+                    (role == BOARD_SYNC_MASTER)? "Master" : (role == BOARD_SYNC_FOLLOWER)? "Follower" : "Off");
+        }
+        else if (strcmp(pairs[i].key, "ext_trigger") == 0)
+        {
+            /*
+             * The use of the external trigger input: 0 only marks its edges
+             * in the results, and 1 starts a capture on each edge.
+             */
+            unsigned int gate = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &gate), );
+            trigger_gate = (gate)? true : false;
+            dbprintf("External trigger input: %s\n",
+                    (trigger_gate)? "Starts captures" : "Marks results");
+        }
+        else if (strcmp(pairs[i].key, "trigger_invert") == 0)
+        {
+            unsigned int invert = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &invert), );
+            AbortIfNot(set_adc_ext_trigger_inverted(&adc, (invert)? true : false), );
+            dbprintf("External trigger input is: %s\n",
+                    (invert)? "Falling edge" : "Rising edge");
+        }
+        else if (strcmp(pairs[i].key, "trigger_output") == 0)
+        {
+            /*
+             * The external trigger output: 0 is low, 1 is high over each
+             * capture window, and 2 is held high.
+             */
+            unsigned int output = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &output), );
+            AbortIfNot(output <= TRIGGER_OUTPUT_FORCED, );
+            AbortIfNot(set_adc_ext_output_forced(&adc, (output == TRIGGER_OUTPUT_FORCED)? true : false), );
+            if (output == TRIGGER_OUTPUT_OFF)
+            {
+                AbortIfNot(set_adc_ext_output_window(&adc, 0, 0), );
+            }
+            trigger_output = output;
+            dbprintf("External trigger output is: %s\n",
+                    (output == TRIGGER_OUTPUT_FORCED)? "Forced" :
+                    (output == TRIGGER_OUTPUT_WINDOWS)? "Capture windows" : "Off");
+        }
+        else if (strcmp(pairs[i].key, "dc_block") == 0)
+        {
+            unsigned int enable = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &enable), );
+            AbortIfNot(set_adc_dc_block(&adc, (enable)? true : false), );
+            dbprintf("FPGA DC removal is: %s\n",
+                    (enable)? "Enabled" : "Disabled");
+        }
+        else if (strcmp(pairs[i].key, "pre_ping_duration_us") == 0)
+        {
+            unsigned int duration = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &duration), );
+
+            params.pre_ping_duration = micros_to_ticks(duration);
+            dbprintf("Pre-ping duration is %u us.\n", duration);
+        }
+        else if (strcmp(pairs[i].key, "post_ping_duration_us") == 0)
+        {
+            unsigned int duration = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &duration), );
+
+            params.post_ping_duration = micros_to_ticks(duration);
+            dbprintf("Post-ping duration is %u us.\n", duration);
+        }
+        else if (strcmp(pairs[i].key, "transmit_rate_bytes_per_second") == 0)
+        {
+            unsigned int rate = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &rate), );
+
+            transmit_rate_bytes_per_second = rate;
+            AbortIfNot(apply_transmit_rate(), );
+            dbprintf("Transmit rate is %u bytes/s.\n", effective_transmit_rate);
+        }
+        else if (strcmp(pairs[i].key, "transmit_burst_bytes") == 0)
+        {
+            unsigned int burst = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &burst), );
+            AbortIfNot(burst, );
+
+            transmit_burst_bytes = burst;
+            AbortIfNot(apply_transmit_rate(), );
+            dbprintf("Transmit burst is %u bytes.\n", burst);
+        }
+        else if (strcmp(pairs[i].key, "result_batch_ms") == 0)
+        {
+            /*
+             * Results wait at most this long to share a datagram, or are sent
+             * alone for zero.
+             */
+            unsigned int delay = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &delay), );
+
+            AbortIfNot(set_result_batch_delay(delay), );
+            dbprintf("Result batch delay is %u ms.\n", delay);
+        }
+        else if (strcmp(pairs[i].key, "network_stats") == 0)
+        {
+            network_dispatch_stats_t stats;
+            get_network_dispatch_stats(&stats);
+            dbprintf("Network dispatch: %u calls, %u packets, max %u packets / %u us per call, %u over budget, "
+                    "%u ARP requests\n",
+                    stats.calls,
+                    stats.packets,
+                    stats.max_packets,
+                    (uint32_t)(stats.max_ticks * 1000000 / CPU_CLOCK_HZ),
+                    stats.budget_exhausted,
+                    stats.arp_requests);
+            reset_network_dispatch_stats();
+
+            if (network_core_running())
+            {
+                net_core_stats_t core;
+                get_network_core_stats(&core);
+                dbprintf("Network core: %u requests posted, %u dropped, %u completed, %u failed, "
+                        "%u transmit stalls\n",
+                        core.posted,
+                        core.dropped,
+                        core.completed,
+                        core.failed,
+                        core.stalls);
+            }
+        }
+        else if (strcmp(pairs[i].key, "accelerators") == 0)
+        {
+            for (uint32_t module = 1; module <= ACCELERATOR_MAX_MODULES; ++module)
+            {
+                const accelerator_module_t *entry = get_accelerator_module(&accelerators, module);
+                if (entry)
+                {
+                    dbprintf("Accelerator module %u: %s, %u bytes%s\n",
+                            module,
+                            entry->name,
+                            entry->num_words * sizeof(uint32_t),
+                            (module == accelerators.loaded)? ", loaded" : "");
+                }
+            }
+
+            dbprintf("Accelerator loads: %u completed, %u failed, last %u us\n",
+                    accelerators.loads,
+                    accelerators.failures,
+                    accelerators.last_load_us);
+        }
+        else if (strcmp(pairs[i].key, "irq_stats") == 0)
+        {
+            for (uint32_t id = 0; id < NUM_INTERRUPT_IDS; ++id)
+            {
+                irq_stats_t stats;
+                if (get_interrupt_stats(id, &stats) && stats.count)
+                {
+                    dbprintf("IRQ %u: %u calls, %u nested, max %u us, total %u us\n",
+                            id,
+                            stats.count,
+                            stats.nested,
+                            (uint32_t)(stats.max_ticks * 1000000 / CPU_CLOCK_HZ),
+                            (uint32_t)(stats.total_ticks * 1000000 / CPU_CLOCK_HZ));
+                }
+            }
+            reset_interrupt_stats();
+        }
+        else if (strcmp(pairs[i].key, "profile") == 0)
+        {
+            /*
+             * Report the processing stage counters, or clear them.
+             */
+            if (strcmp(pairs[i].value, "reset") == 0)
+            {
+                reset_profile();
+                dbprintf("Profile reset.\n");
+            }
+            else
+            {
+                AbortIfNot(send_profile(&telemetry_socket), );
+            }
+        }
+        else if (strcmp(pairs[i].key, "trace") == 0)
+        {
+            /*
+             * Start recording events, stop recording them, or send the events
+             * held.
+             */
+            if (strcmp(pairs[i].value, "start") == 0)
+            {
+                start_trace();
+                dbprintf("Trace started.\n");
+            }
+            else if (strcmp(pairs[i].value, "stop") == 0)
+            {
+                stop_trace();
+                dbprintf("Trace stopped.\n");
+            }
+            else
+            {
+                AbortIfNot(send_trace(&telemetry_socket), );
+            }
+        }
+        else if (strcmp(pairs[i].key, "pc_sample") == 0)
+        {
+            /*
+             * Start sampling the program counters, optionally at a period in
+             * microseconds, stop sampling them, or send the samples held.
+             */
+            unsigned int period_us = PC_SAMPLE_DEFAULT_PERIOD_US;
+            if (strcmp(pairs[i].value, "start") == 0 || sscanf(pairs[i].value, "%u", &period_us) == 1)
+            {
+                AbortIfNot(start_pc_sampling(period_us), );
+                dbprintf("PC sampling started every %u us.\n", period_us);
+            }
+            else if (strcmp(pairs[i].value, "stop") == 0)
+            {
+                AbortIfNot(stop_pc_sampling(), );
+                dbprintf("PC sampling stopped.\n");
+            }
+            else
+            {
+                AbortIfNot(send_pc_samples(&telemetry_socket), );
+            }
+        }
+        else if (strcmp(pairs[i].key, "processing_profile") == 0 ||
+                 strcmp(pairs[i].key, "profile_save") == 0 ||
+                 strcmp(pairs[i].key, "profile_delete") == 0)
+        {
+            /*
+             * The predefined profiles are low-latency, high-accuracy and
+             * low-power, and cannot be replaced. The value list prints the
+             * saved profiles.
+             */
+            if (strcmp(pairs[i].key, "processing_profile") == 0 && strcmp(pairs[i].value, "list") == 0)
+            {
+                for (size_t p = 0; p < param_store.num_profiles; ++p)
+                {
+                    dbprintf("Profile %s: %u bytes\n",
+                            param_store.profiles[p].name,
+                            param_store.profiles[p].length);
+                }
+                continue;
+            }
+
+            AbortIfNot(*pairs[i].value && strlen(pairs[i].value) < PROFILE_NAME_LEN, );
+            AbortIf(strcmp(pairs[i].key, "processing_profile") != 0 && find_builtin_profile(pairs[i].value), );
+
+            requested_profile_action = (strcmp(pairs[i].key, "profile_save") == 0)? PROFILE_SAVE :
+                    (strcmp(pairs[i].key, "profile_delete") == 0)? PROFILE_DELETE : PROFILE_SWITCH;
+            strcpy(requested_profile, pairs[i].value);
+        }
+        else if (strcmp(pairs[i].key, "param_store") == 0)
+        {
+            /*
+             * Save the parameters now rather than once they settle, or erase
+             * them so that the defaults are used at the next boot.
+             */
+            if (strcmp(pairs[i].value, "clear") == 0)
+            {
+                AbortIfNot(clear_param_store(&param_store, &params), );
+                dbprintf("Parameter store cleared.\n");
+            }
+            else if (strcmp(pairs[i].value, "save") == 0)
+            {
+                AbortIfNot(service_param_store(&param_store, &params, true), );
+            }
+        }
+        else if (strcmp(pairs[i].key, "log_level") == 0)
+        {
+            unsigned int level = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &level), );
+            AbortIfNot(level <= LOG_DEBUG, );
+
+            set_log_level((log_level_t)level);
+            dbprintf("Log level is %u.\n", level);
+        }
+        else if (strcmp(pairs[i].key, "log_deferred") == 0)
+        {
+            /*
+             * Deferred messages are formatted by the host from the firmware
+             * image, see scripts/debug_console.py --elf.
+             */
+            unsigned int enable = 0;
+            AbortIfNot(sscanf(pairs[i].value, "%u", &enable), );
+
+            dbprintf("Log formatting is %s.\n", (enable)? "deferred to the host" : "on the board");
+            set_log_deferred((enable)? true : false);
+        }
+        else if (strcmp(pairs[i].key, "reset") == 0)
+        {
+            /*
+             * Trigger a software reset of the Zynq.
+             */
+            dbprintf("Resetting Zynq...");
+            flush_log();
+            give_up();
+        }
+    }
+}
+
+/**
+ * Reads the configuration that binary commands set.
+ *
+ * @param[out] config The current configuration, including any packet length,
+ *             decimation or sampling frequency change that has not yet been
+ *             applied.
+ *
+ * @return None.
+ */
+void get_command_config(command_config_t *config)
+{
+    /*
+     * Configurations are compared whole, so padding must be cleared.
+     */
+    memset(config, 0, sizeof(*config));
+    config->params = params;
+    config->planar_dsp = planar_dsp;
+    config->xcorr_stream = xcorr_stream;
+    config->debug_stream = debug_stream;
+    config->preview_stream = preview_stream;
+    config->record_stream = record_stream;
+    config->samples_per_packet = (requested_samples_per_packet)?
+            requested_samples_per_packet : params.samples_per_packet;
+    config->decimation = (requested_decimation)?
+            requested_decimation : get_adc_decimation(&adc);
+    config->sampling_frequency = (requested_sampling_frequency)?
+            requested_sampling_frequency : params.sampling_frequency;
+    memcpy(config->filter_sections, filter_sections, num_filter_sections * sizeof(filter_coefficients_t));
+    config->num_filter_sections = num_filter_sections;
+}
+
+/**
+ * Reads the parameters of a predefined or saved processing profile.
+ *
+ * @param name The name of the profile.
+ * @param[out] data The parameters, encoded as those of a binary command.
+ * @param capacity The size of the buffer.
+ * @param[out] len The length of the parameters.
+ *
+ * @return Success or fail if no profile is of that name.
+ */
+result_t read_processing_profile(const char *name, uint8_t *data, const size_t capacity, size_t *len)
+{
+    *len = 0;
+    const builtin_profile_t *builtin = find_builtin_profile(name);
+    if (builtin)
+    {
+        for (size_t i = 0; i < builtin->num_values; ++i)
+        {
+            AbortIfNot(append_command_tlv(data, capacity, len, builtin->values[i][0],
+                                          &builtin->values[i][1], sizeof(uint32_t)), fail);
+        }
+
+        for (size_t i = 0; i < builtin->num_flags; ++i)
+        {
+            AbortIfNot(append_command_tlv(data, capacity, len, builtin->flags[i][0],
+                                          &builtin->flags[i][1], sizeof(uint8_t)), fail);
+        }
+
+        return success;
+    }
+
+    const stored_profile_t *stored = find_profile(&param_store, name);
+    if (!stored)
+    {
+        return fail;
+    }
+
+    AbortIfNot(stored->length <= capacity, fail);
+    memcpy(data, stored->params, stored->length);
+    *len = stored->length;
+
+    return success;
+}
+
+/**
+ * Validates a parameter of a binary command and sets it in a staged
+ * configuration. The limits match those of the text commands.
+ *
+ * @param[in,out] config The staged configuration.
+ * @param tlv The parameter to set.
+ *
+ * @return The status of the parameter.
+ */
+command_status_t stage_command_param(command_config_t *config, const command_tlv_t *tlv)
+{
+    const uint32_t nyquist = get_adc_sampling_frequency(&adc) / 2;
+    uint32_t value = 0;
+    bool enable = false;
+
+    switch (tlv->type)
+    {
+        case PARAM_THRESHOLD:
+            AbortIfNot(read_tlv_u32(tlv, &value), COMMAND_MALFORMED);
+            AbortIfNot(value <= INT16_MAX, COMMAND_INVALID_VALUE);
+            config->params.ping_threshold = value;
+            break;
+
+        case PARAM_PING_FREQUENCY_HZ:
+            AbortIfNot(read_tlv_u32(tlv, &value), COMMAND_MALFORMED);
+            AbortIfNot(value < nyquist, COMMAND_INVALID_VALUE);
+            config->params.ping_frequency = value;
+            break;
+
+        case PARAM_PINGER_FREQUENCIES_HZ:
+        {
+            /*
+             * An array of frequencies, of which zeros are dropped.
+             */
+            AbortIfNot(tlv->length % sizeof(uint32_t) == 0, COMMAND_MALFORMED);
+            AbortIfNot(tlv->length <= MAX_PINGERS * sizeof(uint32_t), COMMAND_INVALID_VALUE);
+
+            size_t count = 0;
+            memset(config->params.pinger_frequencies, 0, sizeof(config->params.pinger_frequencies));
+            for (size_t i = 0; i < tlv->length / sizeof(uint32_t); ++i)
+            {
+                memcpy(&value, &tlv->value[i * sizeof(uint32_t)], sizeof(value));
+                AbortIfNot(value < nyquist, COMMAND_INVALID_VALUE);
+                if (value)
+                {
+                    config->params.pinger_frequencies[count++] = value;
+                }
+            }
+            config->params.num_pingers = count;
+            break;
+        }
+
+        case PARAM_FILTER_SECTIONS:
+        {
+            /*
+             * An array of sections of six floats each, which must form a
+             * stable filter.
+             */
+            const size_t section_bytes = sizeof(filter_coefficients_t);
+            AbortIfNot(tlv->length && tlv->length % section_bytes == 0, COMMAND_MALFORMED);
+            AbortIfNot(tlv->length <= MAX_FILTER_SECTIONS * section_bytes, COMMAND_INVALID_VALUE);
+
+            const size_t count = tlv->length / section_bytes;
+            filter_coefficients_t sections[MAX_FILTER_SECTIONS];
+            memset(sections, 0, sizeof(sections));
+            memcpy(sections, tlv->value, tlv->length);
+
+            biquad_cascade_t prepared;
+            AbortIfNot(init_biquad_cascade(&prepared, sections, count), COMMAND_INVALID_VALUE);
+            memcpy(config->filter_sections, sections, sizeof(sections));
+            config->num_filter_sections = count;
+            break;
+        }
+
+        case PARAM_REFERENCE:
+            AbortIfNot(read_tlv_u32(tlv, &value), COMMAND_MALFORMED);
+            AbortIfNot(value < 4, COMMAND_INVALID_VALUE);
+            config->params.reference_channel = value;
+            break;
+
+        case PARAM_NOISE_THRESHOLD:
+            AbortIfNot(read_tlv_u32(tlv, &value), COMMAND_MALFORMED);
+            AbortIfNot(value <= UINT8_MAX, COMMAND_INVALID_VALUE);
+            config->params.noise_threshold = value;
+            break;
+
+        case PARAM_CFAR_THRESHOLD:
+            AbortIfNot(read_tlv_u32(tlv, &value), COMMAND_MALFORMED);
+            AbortIfNot(value <= UINT8_MAX, COMMAND_INVALID_VALUE);
+            config->params.cfar_threshold = value;
+            break;
+
+        case PARAM_MATCHED_THRESHOLD:
+            AbortIfNot(read_tlv_u32(tlv, &value), COMMAND_MALFORMED);
+            AbortIfNot(value <= 100, COMMAND_INVALID_VALUE);
+            config->params.matched_threshold = value;
+            break;
+
+        case PARAM_DSP_DECIMATION:
+            AbortIfNot(read_tlv_u32(tlv, &value), COMMAND_MALFORMED);
+            AbortIfNot(value <= MAX_DECIMATION, COMMAND_INVALID_VALUE);
+            config->params.dsp_decimation = value;
+            break;
+
+        case PARAM_MIN_PING_QUALITY:
+            AbortIfNot(read_tlv_u32(tlv, &value), COMMAND_MALFORMED);
+            AbortIfNot(value <= 100, COMMAND_INVALID_VALUE);
+            config->params.min_ping_quality = value;
+            break;
+
+        case PARAM_PRE_PING_DURATION_US:
+            AbortIfNot(read_tlv_u32(tlv, &value), COMMAND_MALFORMED);
+            config->params.pre_ping_duration = micros_to_ticks(value);
+            break;
+
+        case PARAM_POST_PING_DURATION_US:
+            AbortIfNot(read_tlv_u32(tlv, &value), COMMAND_MALFORMED);
+            config->params.post_ping_duration = micros_to_ticks(value);
+            break;
+
+        case PARAM_SAMPLES_PER_PACKET:
+            AbortIfNot(read_tlv_u32(tlv, &value), COMMAND_MALFORMED);
+            AbortIfNot(value >= ADC_HEADER_SAMPLES, COMMAND_INVALID_VALUE);
+            AbortIfNot(value * sizeof(sample_t) <= dma.max_transfer_bytes, COMMAND_INVALID_VALUE);
+            AbortIfNot(dma.ring.descriptors || value == params.samples_per_packet, COMMAND_INVALID_VALUE);
+            AbortIf(packed_samples && (value - ADC_HEADER_SAMPLES) % ADC_PACKED_GROUP_SAMPLES,
+                    COMMAND_INVALID_VALUE);
+            AbortIf(config->params.hw_trigger && value > ADC_TRIGGER_MAX_PRE_SAMPLES, COMMAND_INVALID_VALUE);
+            config->samples_per_packet = value;
+            break;
+
+        case PARAM_DECIMATION:
+            AbortIfNot(read_tlv_u32(tlv, &value), COMMAND_MALFORMED);
+            AbortIfNot(value && (value & (value - 1)) == 0, COMMAND_INVALID_VALUE);
+            AbortIfNot(value <= (1 << ADC_MAX_DECIMATION_RATE_LOG2), COMMAND_INVALID_VALUE);
+            config->decimation = value;
+            break;
+
+        case PARAM_SAMPLE_RATE_HZ:
+            AbortIfNot(read_tlv_u32(tlv, &value), COMMAND_MALFORMED);
+            AbortIfNot(value >= ADC_MIN_SAMPLING_FREQUENCY, COMMAND_INVALID_VALUE);
+            AbortIfNot(value <= ADC_MAX_SAMPLING_FREQUENCY, COMMAND_INVALID_VALUE);
+            AbortIfNot(adc.encode_clock || value == params.sampling_frequency, COMMAND_INVALID_VALUE);
+            config->sampling_frequency = value;
+            break;
+
+        case PARAM_FILTER:
+            AbortIfNot(read_tlv_bool(tlv, &enable), COMMAND_MALFORMED);
+            config->params.filter = enable;
+            break;
+
+        case PARAM_PLANAR:
+            AbortIfNot(read_tlv_bool(tlv, &enable), COMMAND_MALFORMED);
+            config->planar_dsp = enable;
+            break;
+
+        case PARAM_HW_TRIGGER:
+            AbortIfNot(read_tlv_bool(tlv, &enable), COMMAND_MALFORMED);
+            AbortIf(enable && config->samples_per_packet > ADC_TRIGGER_MAX_PRE_SAMPLES, COMMAND_INVALID_VALUE);
+            config->params.hw_trigger = enable;
+            break;
+
+        case PARAM_HW_CORRELATE:
+            AbortIfNot(read_tlv_bool(tlv, &enable), COMMAND_MALFORMED);
+            config->params.hw_correlate = enable;
+            break;
+
+        case PARAM_HW_ENVELOPE:
+            AbortIfNot(read_tlv_bool(tlv, &enable), COMMAND_MALFORMED);
+            config->params.hw_envelope = enable;
+            break;
+
+        case PARAM_DUAL_RATE:
+            AbortIfNot(read_tlv_bool(tlv, &enable), COMMAND_MALFORMED);
+            config->params.dual_rate = enable;
+            break;
+
+        case PARAM_MASKED_SYNC:
+            AbortIfNot(read_tlv_bool(tlv, &enable), COMMAND_MALFORMED);
+            config->params.masked_sync = enable;
+            break;
+
+        case PARAM_CONTINUOUS_CAPTURE:
+            AbortIfNot(read_tlv_bool(tlv, &enable), COMMAND_MALFORMED);
+            config->params.continuous_capture = enable;
+            break;
+
+        case PARAM_DMA_IRQ_THRESHOLD:
+            AbortIfNot(read_tlv_u32(tlv, &value), COMMAND_MALFORMED);
+            AbortIfNot(value >= 1 && value <= 255, COMMAND_INVALID_VALUE);
+            config->params.dma_irq_threshold = value;
+            break;
+
+        case PARAM_DMA_IRQ_DELAY_US:
+            AbortIfNot(read_tlv_u32(tlv, &value), COMMAND_MALFORMED);
+            AbortIfNot(value <= DMA_IRQ_DELAY_MAX_US, COMMAND_INVALID_VALUE);
+            config->params.dma_irq_delay_us = value;
+            break;
+
+        case PARAM_ACCELERATOR_MODULE:
+            AbortIfNot(read_tlv_u32(tlv, &value), COMMAND_MALFORMED);
+            AbortIfNot(value <= ACCELERATOR_MAX_MODULES, COMMAND_INVALID_VALUE);
+            config->params.accelerator_module = value;
+            break;
+
+        case PARAM_PROFILE:
+        {
+            /*
+             * The name of a processing profile, whose parameters are staged
+             * in its place. Later parameters of the command override them.
+             */
+            AbortIfNot(tlv->length && tlv->length < PROFILE_NAME_LEN, COMMAND_INVALID_VALUE);
+            char name[PROFILE_NAME_LEN];
+            memcpy(name, tlv->value, tlv->length);
+            name[tlv->length] = 0;
+
+            uint8_t profile[PROFILE_PARAM_BYTES];
+            size_t len = 0;
+            if (!read_processing_profile(name, profile, sizeof(profile), &len))
+            {
+                return COMMAND_INVALID_VALUE;
+            }
+
+            size_t offset = 0;
+            while (true)
+            {
+                command_tlv_t param;
+                bool found = false;
+                AbortIfNot(next_command_tlv(profile, len, &offset, &param, &found), COMMAND_MALFORMED);
+                if (!found)
+                {
+                    break;
+                }
+
+                AbortIf(param.type == PARAM_PROFILE, COMMAND_INVALID_VALUE);
+                const command_status_t status = stage_command_param(config, &param);
+                if (status != COMMAND_OK)
+                {
+                    return status;
+                }
+            }
+            break;
+        }
+
+        case PARAM_ALL_PAIRS:
+            AbortIfNot(read_tlv_bool(tlv, &enable), COMMAND_MALFORMED);
+            config->params.all_pairs = enable;
+            break;
+
+        case PARAM_PHAT:
+            AbortIfNot(read_tlv_bool(tlv, &enable), COMMAND_MALFORMED);
+            config->params.phat = enable;
+            break;
+
+        case PARAM_ENVELOPE_ONSET:
+            AbortIfNot(read_tlv_bool(tlv, &enable), COMMAND_MALFORMED);
+            config->params.envelope_onset = enable;
+            break;
+
+        case PARAM_AVERAGE_PINGS:
+            AbortIfNot(read_tlv_u32(tlv, &value), COMMAND_MALFORMED);
+            AbortIfNot(value <= CORRELATION_AVERAGE_MAX_PINGS, COMMAND_INVALID_VALUE);
+            config->params.average_pings = value;
+            break;
+
+        case PARAM_FAST_TDOA:
+            AbortIfNot(read_tlv_u32(tlv, &value), COMMAND_MALFORMED);
+            AbortIfNot(value <= UINT8_MAX, COMMAND_INVALID_VALUE);
+            config->params.fast_tdoa_interval = value;
+            break;
+
+        case PARAM_AVERAGE_EXPONENTIAL:
+            AbortIfNot(read_tlv_bool(tlv, &enable), COMMAND_MALFORMED);
+            config->params.average_exponential = enable;
+            break;
+
+        case PARAM_COARSE_SEARCH:
+            AbortIfNot(read_tlv_bool(tlv, &enable), COMMAND_MALFORMED);
+            config->params.coarse_search = enable;
+            break;
+
+        case PARAM_TRACK_LAGS:
+            AbortIfNot(read_tlv_bool(tlv, &enable), COMMAND_MALFORMED);
+            config->params.track_lags = enable;
+            break;
+
+        case PARAM_TRIGGER_ANY:
+            AbortIfNot(read_tlv_bool(tlv, &enable), COMMAND_MALFORMED);
+            config->params.trigger_any_channel = enable;
+            break;
+
+        case PARAM_WINDOW_NORMALIZE:
+            AbortIfNot(read_tlv_bool(tlv, &enable), COMMAND_MALFORMED);
+            config->params.window_normalize = enable;
+            break;
+
+        case PARAM_LAZY_FILTER:
+            AbortIfNot(read_tlv_bool(tlv, &enable), COMMAND_MALFORMED);
+            config->params.lazy_filter = enable;
+            break;
+
+        case PARAM_XCORR_STREAM:
+            AbortIfNot(read_tlv_bool(tlv, &enable), COMMAND_MALFORMED);
+            config->xcorr_stream = enable;
+            break;
+
+        case PARAM_DEBUG:
+            AbortIfNot(read_tlv_bool(tlv, &enable), COMMAND_MALFORMED);
+            config->debug_stream = enable;
+            break;
+
+        case PARAM_PREVIEW:
+            AbortIfNot(read_tlv_bool(tlv, &enable), COMMAND_MALFORMED);
+            config->preview_stream = enable;
+            break;
+
+        case PARAM_RECORD:
+            AbortIfNot(read_tlv_bool(tlv, &enable), COMMAND_MALFORMED);
+            config->record_stream = enable;
+            break;
+
+        default:
+            return COMMAND_UNKNOWN_PARAM;
+    }
+
+    return COMMAND_OK;
+}
+
+/**
+ * Applies a staged configuration. Sync is lost at most once, and only if a
+ * parameter that sync depends on changed.
+ *
+ * @param config The configuration to apply.
+ *
+ * @return True if the configuration changed.
+ */
+bool commit_command_config(const command_config_t *config)
+{
+    command_config_t current;
+    get_command_config(&current);
+    if (memcmp(&current, config, sizeof(current)) == 0)
+    {
+        return false;
+    }
+
+    const HydroZynqParams *next = &config->params;
+    if (next->ping_threshold != params.ping_threshold ||
+        next->ping_frequency != params.ping_frequency ||
+        next->hw_trigger != params.hw_trigger ||
+        next->hw_correlate != params.hw_correlate ||
+        next->hw_envelope != params.hw_envelope ||
+        next->dual_rate != params.dual_rate ||
+        next->continuous_capture != params.continuous_capture)
+    {
+        sync = false;
+    }
+
+    if (next->num_pingers != params.num_pingers ||
+        memcmp(next->pinger_frequencies, params.pinger_frequencies, sizeof(params.pinger_frequencies)) != 0)
+    {
+        pinger_bank_stale = true;
+    }
+
+    /*
+     * The packet length, decimation and sampling frequency are applied by the
+     * main loop, which also updates the parameters.
+     */
+    const uint32_t samples_per_packet = params.samples_per_packet;
+    const uint32_t sampling_frequency = params.sampling_frequency;
+    params = *next;
+    params.samples_per_packet = samples_per_packet;
+    params.sampling_frequency = sampling_frequency;
+    if (config->samples_per_packet != current.samples_per_packet)
+    {
+        requested_samples_per_packet = config->samples_per_packet;
+    }
+
+    if (config->decimation != current.decimation)
+    {
+        requested_decimation = config->decimation;
+    }
+
+    if (config->sampling_frequency != current.sampling_frequency)
+    {
+        requested_sampling_frequency = config->sampling_frequency;
+    }
+
+    if (config->num_filter_sections != current.num_filter_sections ||
+        memcmp(config->filter_sections, current.filter_sections, sizeof(current.filter_sections)) != 0)
+    {
+        if (!set_capture_filter(config->filter_sections, config->num_filter_sections))
+        {
+            dbprintf("Filter could not be prepared.\n");
+        }
+    }
+
+    planar_dsp = config->planar_dsp;
+    xcorr_stream = config->xcorr_stream;
+    debug_stream = config->debug_stream;
+    raw_debug_stream = (debug_stream)? raw_debug_stream : false;
+    preview_stream = config->preview_stream;
+    record_stream = config->record_stream;
+
+    return true;
+}
+
+/**
+ * Encodes every parameter of a configuration except the capture filter, as a
+ * processing profile holds them.
+ *
+ * @param config The configuration to encode.
+ * @param data The buffer to encode into.
+ * @param capacity The size of the buffer.
+ * @param[in,out] len The number of bytes in the buffer.
+ *
+ * @return Success or fail.
+ */
+result_t encode_command_settings(const command_config_t *config,
+                                 uint8_t *data,
+                                 const size_t capacity,
+                                 size_t *len)
+{
+    const HydroZynqParams *p = &config->params;
+    const uint32_t values[][2] = {
+        {PARAM_THRESHOLD, p->ping_threshold},
+        {PARAM_PING_FREQUENCY_HZ, p->ping_frequency},
+        {PARAM_REFERENCE, p->reference_channel},
+        {PARAM_NOISE_THRESHOLD, p->noise_threshold},
+        {PARAM_CFAR_THRESHOLD, p->cfar_threshold},
+        {PARAM_MATCHED_THRESHOLD, p->matched_threshold},
+        {PARAM_DSP_DECIMATION, p->dsp_decimation},
+        {PARAM_MIN_PING_QUALITY, p->min_ping_quality},
+        {PARAM_AVERAGE_PINGS, p->average_pings},
+        {PARAM_FAST_TDOA, p->fast_tdoa_interval},
+        {PARAM_PRE_PING_DURATION_US, ticks_to_micros(p->pre_ping_duration)},
+        {PARAM_POST_PING_DURATION_US, ticks_to_micros(p->post_ping_duration)},
+        {PARAM_SAMPLES_PER_PACKET, config->samples_per_packet},
+        {PARAM_DECIMATION, config->decimation},
+        {PARAM_SAMPLE_RATE_HZ, config->sampling_frequency}};
+    const uint8_t flags[][2] = {
+        {PARAM_FILTER, p->filter},
+        {PARAM_PLANAR, config->planar_dsp},
+        {PARAM_HW_TRIGGER, p->hw_trigger},
+        {PARAM_HW_CORRELATE, p->hw_correlate},
+        {PARAM_HW_ENVELOPE, p->hw_envelope},
+        {PARAM_ALL_PAIRS, p->all_pairs},
+        {PARAM_PHAT, p->phat},
+        {PARAM_ENVELOPE_ONSET, p->envelope_onset},
+        {PARAM_AVERAGE_EXPONENTIAL, p->average_exponential},
+        {PARAM_COARSE_SEARCH, p->coarse_search},
+        {PARAM_TRACK_LAGS, p->track_lags},
+        {PARAM_TRIGGER_ANY, p->trigger_any_channel},
+        {PARAM_WINDOW_NORMALIZE, p->window_normalize},
+        {PARAM_LAZY_FILTER, p->lazy_filter},
+        {PARAM_DUAL_RATE, p->dual_rate},
+        {PARAM_MASKED_SYNC, p->masked_sync},
+        {PARAM_CONTINUOUS_CAPTURE, p->continuous_capture},
+        {PARAM_DMA_IRQ_THRESHOLD, p->dma_irq_threshold},
+        {PARAM_DMA_IRQ_DELAY_US, p->dma_irq_delay_us},
+        {PARAM_ACCELERATOR_MODULE, p->accelerator_module},
+        {PARAM_XCORR_STREAM, config->xcorr_stream},
+        {PARAM_DEBUG, config->debug_stream},
+        {PARAM_PREVIEW, config->preview_stream},
+        {PARAM_RECORD, config->record_stream}};
+
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); ++i)
+    {
+        AbortIfNot(append_command_tlv(data, capacity, len, values[i][0],
+                                      &values[i][1], sizeof(uint32_t)), fail);
+    }
+
+    for (size_t i = 0; i < sizeof(flags) / sizeof(flags[0]); ++i)
+    {
+        AbortIfNot(append_command_tlv(data, capacity, len, flags[i][0],
+                                      &flags[i][1], sizeof(uint8_t)), fail);
+    }
+
+    AbortIfNot(append_command_tlv(data, capacity, len, PARAM_PINGER_FREQUENCIES_HZ,
+                                  p->pinger_frequencies, p->num_pingers * sizeof(uint32_t)), fail);
+
+    return success;
+}
+
+/**
+ * Encodes every parameter of a configuration.
+ *
+ * @param config The configuration to encode.
+ * @param data The buffer to encode into.
+ * @param capacity The size of the buffer.
+ * @param[in,out] len The number of bytes in the buffer.
+ *
+ * @return Success or fail.
+ */
+result_t encode_command_config(const command_config_t *config,
+                               uint8_t *data,
+                               const size_t capacity,
+                               size_t *len)
+{
+    AbortIfNot(encode_command_settings(config, data, capacity, len), fail);
+    AbortIfNot(append_command_tlv(data, capacity, len, PARAM_FILTER_SECTIONS,
+                                  config->filter_sections,
+                                  config->num_filter_sections * sizeof(filter_coefficients_t)), fail);
+
+    return success;
+}
+
+/**
+ * Applies a binary command and acknowledges it with the configuration as
+ * applied. Either every parameter of the command is applied or none is.
+ *
+ * @param command The command to apply.
+ *
+ * @return None.
+ */
+void apply_binary_command(command_t *command)
+{
+    command_header_t request;
+    if (!parse_command_header(command->text, command->len, &request) ||
+        request.type != COMMAND_SET)
+    {
+        dbprintf("Malformed binary command dropped.\n");
+        return;
+    }
+
+    command_config_t config;
+    get_command_config(&config);
+
+    command_status_t status = COMMAND_OK;
+    uint16_t error_param = 0;
+    if (request.param_set_version && request.param_set_version != param_set_version)
+    {
+        status = COMMAND_STALE;
+    }
+
+    const uint8_t *tlvs = (const uint8_t *)&command->text[sizeof(request)];
+    size_t offset = 0;
+    while (status == COMMAND_OK)
+    {
+        command_tlv_t tlv;
+        bool found = false;
+        if (!next_command_tlv(tlvs, request.length, &offset, &tlv, &found))
+        {
+            status = COMMAND_MALFORMED;
+            break;
+        }
+
+        if (!found)
+        {
+            break;
+        }
+
+        status = stage_command_param(&config, &tlv);
+        error_param = tlv.type;
+    }
+
+    if (status == COMMAND_OK)
+    {
+        error_param = 0;
+        if (commit_command_config(&config))
+        {
+            param_set_version++;
+            dbprintf("Parameter set %u applied.\n", param_set_version);
+        }
+    }
+    else
+    {
+        dbprintf("Binary command %u rejected: status %u, parameter %u\n",
+                request.sequence, status, error_param);
+    }
+
+    /*
+     * The acknowledgement carries the configuration as it now stands, so a
+     * rejected command reports what is still in effect.
+     */
+    static uint8_t ack[COMMAND_ACK_BYTES];
+    command_header_t header;
+    header.magic = COMMAND_MAGIC;
+    header.version = COMMAND_VERSION;
+    header.type = COMMAND_ACK;
+    header.sequence = request.sequence;
+    header.param_set_version = param_set_version;
+    header.status = status;
+    header.error_param = error_param;
+    header.reserved = 0;
+
+    size_t len = sizeof(header);
+    get_command_config(&config);
+    AbortIfNot(encode_command_config(&config, ack, sizeof(ack), &len), );
+    header.length = len - sizeof(header);
+    memcpy(ack, &header, sizeof(header));
+
+    AbortIfNot(send_udp_to(&command_socket, &command->addr, command->port, ack, len), );
+}
+
+/**
+ * Switches to, saves or deletes the processing profile requested by a text
+ * command. A switch is applied as a single binary command would be, so either
+ * every parameter of the profile is applied or none is.
+ *
+ * @return Success or fail.
+ */
+result_t apply_requested_profile()
+{
+    const profile_action_t action = requested_profile_action;
+    requested_profile_action = PROFILE_NONE;
+
+    command_config_t config;
+    get_command_config(&config);
+    if (action == PROFILE_SWITCH)
+    {
+        command_tlv_t tlv;
+        tlv.type = PARAM_PROFILE;
+        tlv.length = strlen(requested_profile);
+        tlv.value = (const uint8_t *)requested_profile;
+
+        const command_status_t status = stage_command_param(&config, &tlv);
+        if (status != COMMAND_OK)
+        {
+            dbprintf("Profile %s rejected: status %u\n", requested_profile, status);
+            return fail;
+        }
+
+        if (commit_command_config(&config))
+        {
+            param_set_version++;
+        }
+        dbprintf("Profile %s applied as parameter set %u.\n", requested_profile, param_set_version);
+    }
+    else if (action == PROFILE_SAVE)
+    {
+        uint8_t profile[PROFILE_PARAM_BYTES];
+        size_t len = 0;
+        AbortIfNot(encode_command_settings(&config, profile, sizeof(profile), &len), fail);
+        AbortIfNot(save_profile(&param_store, requested_profile, profile, len), fail);
+        dbprintf("Profile %s saved.\n", requested_profile);
+    }
+    else if (action == PROFILE_DELETE)
+    {
+        AbortIfNot(find_profile(&param_store, requested_profile), fail);
+        AbortIfNot(save_profile(&param_store, requested_profile, NULL, 0), fail);
+        dbprintf("Profile %s deleted.\n", requested_profile);
+    }
+
+    return success;
+}
+
+/**
+ * Registers the upload slots of the capture arena with the bulk upload
+ * receiver. Uploads in progress start over, since their slots moved.
+ *
+ * @return Success or fail.
+ */
+result_t register_upload_targets()
+{
+    AbortIfNot(set_upload_target(&bulk_upload,
+                                 UPLOAD_MATCHED_TEMPLATE,
+                                 template_upload,
+                                 MATCHED_TEMPLATE_MAX * sizeof(float)), fail);
+    AbortIfNot(set_upload_target(&bulk_upload,
+                                 UPLOAD_FILTER_SECTIONS,
+                                 filter_upload,
+                                 MAX_FILTER_SECTIONS * sizeof(filter_coefficients_t)), fail);
+    AbortIfNot(set_upload_target(&bulk_upload,
+                                 UPLOAD_ACCELERATOR_MODULE,
+                                 accelerator_upload,
+                                 sizeof(accelerator_upload)), fail);
+
+    return success;
+}
+
+/**
+ * Applies the templates and filters whose bulk upload completed.
+ *
+ * @return None.
+ */
+void apply_bulk_uploads()
+{
+    size_t len = 0;
+    if (take_bulk_upload(&bulk_upload, UPLOAD_MATCHED_TEMPLATE, &len, NULL))
+    {
+        if (len % sizeof(float) ||
+            !set_matched_template(&matched_filter, template_upload, 0, len / sizeof(float)))
+        {
+            dblog(LOG_WARN, "Uploaded template of %u bytes was not applied.\n", len);
+        }
+        else
+        {
+            dbprintf("Matched filter template has %u samples\n", matched_filter.template_len);
+        }
+    }
+
+    if (take_bulk_upload(&bulk_upload, UPLOAD_FILTER_SECTIONS, &len, NULL))
+    {
+        if (len % sizeof(filter_coefficients_t) ||
+            !set_capture_filter(filter_upload, len / sizeof(filter_coefficients_t)))
+        {
+            dblog(LOG_WARN, "Uploaded filter of %u bytes was not applied.\n", len);
+        }
+        else
+        {
+            dbprintf("Filter has %u sections\n", num_filter_sections);
+        }
+    }
+
+    uint8_t module = 0;
+    if (take_bulk_upload(&bulk_upload, UPLOAD_ACCELERATOR_MODULE, &len, &module))
+    {
+        if (!register_accelerator_module(&accelerators, module, accelerator_upload, len))
+        {
+            dblog(LOG_WARN, "Uploaded accelerator module %u of %u bytes was not registered.\n", module, len);
+        }
+        else
+        {
+            dbprintf("Accelerator module %u is %s\n",
+                    module, get_accelerator_module(&accelerators, module)->name);
+        }
+    }
+}
+
+/**
+ * Applies every command received since the last call.
+ *
+ * @note Commands are received by the network stack and applied here so that
+ *       parameters only change between processing stages.
+ *
+ * @return None.
+ */
+void apply_pending_commands()
+{
+    command_t command;
+    while (spsc_pop(&command_queue, &command))
+    {
+        if (command.binary)
+        {
+            apply_binary_command(&command);
+        }
+        else
+        {
+            apply_command(&command);
+        }
+    }
+
+    apply_bulk_uploads();
+
+    if (requested_profile_action != PROFILE_NONE)
+    {
+        apply_requested_profile();
+    }
+}
+
+/**
+ * Reports a background send of a ping that failed.
+ *
+ * @param job The stream job that completed.
+ * @param result The outcome of the job.
+ * @param arg The name of the stream.
+ *
+ * @return None.
+ */
+void ping_send_complete(stream_job_t *job, const result_t result, void *arg)
+{
+    if (result != success)
+    {
+        dblog(LOG_WARN, "Failed to stream %s.\n", (const char *)arg);
+    }
+}
+
+/**
+ * Finishes the background sends and copies of the previous ping so that the
+ * buffers they read from may be reused.
+ *
+ * @return Success or fail.
+ */
+result_t finish_ping_sends()
+{
+    AbortIfNot(finish_stream_job(&data_stream_job), fail);
+    AbortIfNot(finish_stream_job(&xcorr_stream_job), fail);
+    AbortIfNot(finish_record_copies(&record_queue), fail);
+    AbortIfNot(finish_ping_history_copies(&ping_history), fail);
+
+    return success;
+}
+
+/**
+ * Carves the capture buffers from the capture arena for a sample rate.
+ *
+ * @note Any buffers previously allocated are released, so no capture or DSP
+ *       job may be in progress.
+ *
+ * @param sampling_frequency The ADC sample rate in Hz.
+ * @param samples_per_packet The number of samples in each ADC packet.
+ *
+ * @return Success or fail.
+ */
+result_t allocate_capture_buffers(const uint32_t sampling_frequency,
+                                  const size_t samples_per_packet)
+{
+    AbortIfNot(sampling_frequency, fail);
+    AbortIfNot(samples_per_packet, fail);
+
+    /*
+     * Recordings still waiting to be streamed are lost with their storage,
+     * and sends from the old buffers are finished first. A continuous
+     * capture records into the old buffers, so it is stopped.
+     */
+    AbortIfNot(stop_continuous_capture(&continuous_capture), fail);
+    AbortIfNot(finish_ping_sends(), fail);
+    AbortIfNot(flush_record_queue(&record_queue), fail);
+    reset_capture_arena(&capture_arena);
+
+    /*
+     * Size the sample array for the longest capture, rounded so that each
+     * half of a pipelined capture holds whole packets.
+     */
+    const size_t pair = 2 * samples_per_packet;
+    capture_samples = (uint64_t)sampling_frequency * CAPTURE_WINDOW_MS / 1000;
+    capture_samples = (capture_samples + pair - 1) / pair * pair;
+    capture_packets = capture_samples / 8;
+
+    if (dma.coherency == DMA_NONCACHEABLE)
+    {
+        samples = capture_arena_alloc_mapped(&capture_arena,
+                                             capture_samples * sizeof(sample_t),
+                                             CAPTURE_MEMORY_WRITE_COMBINING);
+    }
+    else
+    {
+        samples = capture_arena_alloc(&capture_arena, capture_samples * sizeof(sample_t));
+    }
+    AbortIfNot(samples, fail);
+
+    /*
+     * The triggered window falls back to the start of the sample array when
+     * its two packets do not fit in on-chip memory.
+     */
+    trigger_window = samples;
+    if (ocm_arena.base)
+    {
+        reset_capture_arena(&ocm_arena);
+        sample_t *window = capture_arena_alloc(&ocm_arena, 2 * samples_per_packet * sizeof(sample_t));
+        if (window)
+        {
+            trigger_window = window;
+        }
+    }
+
+    packet_timestamps = capture_arena_alloc(&capture_arena, capture_packets * sizeof(uint64_t));
+    AbortIfNot(packet_timestamps, fail);
+
+    packet_trailers = capture_arena_alloc(&capture_arena,
+                                          capture_samples / ADC_STATS_MIN_PACKET_SAMPLES *
+                                          sizeof(adc_packet_trailer_t));
+    AbortIfNot(packet_trailers, fail);
+
+    correlation_len = correlation_capacity(sampling_frequency);
+    correlations = capture_arena_alloc(&capture_arena, correlation_len * sizeof(correlation_t));
+    AbortIfNot(correlations, fail);
+    cross_correlations = capture_arena_alloc(&capture_arena, correlation_len * sizeof(correlation_t));
+    AbortIfNot(cross_correlations, fail);
+
+    float *average_storage = capture_arena_alloc(&capture_arena,
+                                                 CORRELATION_AVERAGE_STORAGE(correlation_len) * sizeof(float));
+    AbortIfNot(average_storage, fail);
+    AbortIfNot(init_correlation_average(&correlation_average, average_storage, correlation_len), fail);
+
+    for (size_t k = 0; k < 4; ++k)
+    {
+        planar_samples.channel[k] = capture_arena_alloc(&capture_arena,
+                                                        capture_samples * sizeof(analog_sample_t));
+        AbortIfNot(planar_samples.channel[k], fail);
+    }
+    planar_samples.capacity = capture_samples;
+    planar_samples.len = 0;
+
+    /*
+     * Recordings and the windows of the ping history are copied in once by
+     * the copy engine and then only read by the Ethernet DMA, so they are
+     * kept out of the caches. The sample array is cleaned before the engine
+     * reads it unless it is also uncached.
+     */
+    const uint32_t copy_flags = (dma.coherency == DMA_NONCACHEABLE)? 0 : COPY_CLEAN_SOURCE;
+    const size_t record_capacity = (uint64_t)sampling_frequency * RECORD_WINDOW_US / 1000000;
+    sample_t *record_buffer = capture_arena_alloc_mapped(&capture_arena,
+                                                         RECORD_QUEUE_DEPTH * record_capacity * sizeof(sample_t),
+                                                         CAPTURE_MEMORY_WRITE_COMBINING);
+    AbortIfNot(record_buffer, fail);
+    AbortIfNot(init_record_queue(&record_queue,
+                                 &record_socket,
+                                 record_buffer,
+                                 record_capacity,
+                                 &copy_engine,
+                                 copy_flags), fail);
+
+    const size_t history_window = (uint64_t)sampling_frequency * PING_HISTORY_WINDOW_US / 1000000;
+    sample_t *history_samples = capture_arena_alloc_mapped(&capture_arena,
+                                                           PING_HISTORY_DEPTH * history_window * sizeof(sample_t),
+                                                           CAPTURE_MEMORY_WRITE_COMBINING);
+    AbortIfNot(history_samples, fail);
+    correlation_t *history_correlations = capture_arena_alloc(&capture_arena,
+                                                              PING_HISTORY_DEPTH * correlation_len * sizeof(correlation_t));
+    AbortIfNot(history_correlations, fail);
+    AbortIfNot(init_ping_history(&ping_history,
+                                 history_samples,
+                                 history_window,
+                                 history_correlations,
+                                 correlation_len,
+                                 &copy_engine,
+                                 copy_flags), fail);
+
+    AbortIfNot(init_sample_timing(&timing, packet_timestamps, capture_packets), fail);
+    AbortIfNot(set_sample_timing_rate(&timing, sampling_frequency), fail);
+
+    /*
+     * The ring of a continuous capture takes at most half of the sample
+     * array, leaving the rest for the window of each ping.
+     */
+    continuous_ring_samples = (uint64_t)sampling_frequency * CONTINUOUS_RING_MS / 1000;
+    if (continuous_ring_samples > capture_samples / 2)
+    {
+        continuous_ring_samples = capture_samples / 2;
+    }
+    continuous_ring_samples -= continuous_ring_samples % samples_per_packet;
+    const size_t ring_packets = continuous_ring_samples / samples_per_packet;
+    uint64_t *ring_timestamps = capture_arena_alloc(&capture_arena, ring_packets * sizeof(uint64_t));
+    AbortIfNot(ring_timestamps, fail);
+    AbortIfNot(init_sample_timing(&continuous_timing, ring_timestamps, ring_packets), fail);
+    AbortIfNot(set_sample_timing_rate(&continuous_timing, sampling_frequency), fail);
+
+    template_upload = capture_arena_alloc(&capture_arena, MATCHED_TEMPLATE_MAX * sizeof(float));
+    AbortIfNot(template_upload, fail);
+    filter_upload = capture_arena_alloc(&capture_arena, MAX_FILTER_SECTIONS * sizeof(filter_coefficients_t));
+    AbortIfNot(filter_upload, fail);
+    AbortIfNot(register_upload_targets(), fail);
+
+    dbprintf("Capture arena: %u of %u KB used for %u samples\n",
+            capture_arena.used / 1024,
+            capture_arena.size / 1024,
+            capture_samples);
+    for (size_t i = 0; i < capture_arena.num_regions; ++i)
+    {
+        dbprintf("Capture arena: %u KB mapped %s\n",
+                capture_arena.regions[i].size / 1024,
+                capture_memory_name(capture_arena.regions[i].memory));
+    }
+    dbprintf("Trigger window: %u KB in %s memory\n",
+            (2 * samples_per_packet * sizeof(sample_t)) / 1024,
+            (trigger_window != samples)? "on-chip" : "DDR");
+
+    return success;
+}
+
+/**
+ * Changes the number of samples in each ADC packet, the decimation rate of
+ * the stream and the sampling frequency of the ADC, and resizes the capture
+ * buffers to match.
+ *
+ * @note Packets already in the stream keep their previous length and rate,
+ *       so one packet is recorded and discarded after the change. Changing
+ *       the packet length requires the descriptor ring because it splits a
+ *       stale packet that is longer than a descriptor rather than faulting.
+ *       The encode clock is only retuned when the sampling frequency changes,
+ *       since the stream stalls while it relocks.
+ *
+ * @param samples_per_packet The number of samples in each packet.
+ * @param decimation The decimation rate of the stream.
+ * @param sampling_frequency The sampling frequency of the ADC in Hz.
+ * @param packed Specified true to pack the samples of the stream.
+ *
+ * @return Success or fail.
+ */
+result_t reconfigure_stream(const size_t samples_per_packet,
+                            const uint32_t decimation,
+                            const uint32_t sampling_frequency,
+                            const bool packed)
+{
+    AbortIfNot(samples_per_packet >= ADC_HEADER_SAMPLES, fail);
+    AbortIfNot(samples_per_packet * sizeof(sample_t) <= dma.max_transfer_bytes, fail);
+    AbortIf(samples_per_packet != params.samples_per_packet && !dma.ring.descriptors, fail);
+
+    if (sampling_frequency != params.sampling_frequency)
+    {
+        AbortIfNot(set_adc_sampling_frequency(&adc, sampling_frequency), fail);
+        params.sampling_frequency = sampling_frequency;
+    }
+
+    AbortIfNot(set_adc_decimation(&adc, decimation), fail);
+    adc.regs->samples_per_packet = samples_per_packet;
+    params.samples_per_packet = samples_per_packet;
+    AbortIfNot(set_adc_packed_samples(&adc, packed), fail);
+    AbortIfNot(allocate_capture_buffers(get_adc_sampling_frequency(&adc),
+                                        samples_per_packet), fail);
+    AbortIfNot(record(&dma, samples, samples_per_packet, adc), fail);
+
+    dbprintf("ADC samples per packet: %u, sampling frequency: %u Hz (clock div %u), %s samples\n",
+            samples_per_packet, get_adc_sampling_frequency(&adc), adc.regs->clk_div,
+            (packed)? "packed" : "whole");
+
+    return success;
+}
+
+/**
+ * Narrows the stream to the reference channel while searching for sync, or
+ * restores every channel for the capture of a ping. Sync only locates the
+ * start of the ping, so the other channels are not needed until then.
+ *
+ * @note As with the packet length in reconfigure_stream, packets already in
+ *       the stream keep their previous length, so the change requires the
+ *       descriptor ring and one packet is recorded and discarded after it.
+ *       The stream is left unchanged if the bitstream cannot mask it.
+ *
+ * @param masked Specified true to stream only the reference channel.
+ */
+void set_sync_channels(const bool masked)
+{
+    const uint32_t mask = (masked)? ADC_CHANNEL_A : ADC_ALL_CHANNELS;
+    if (mask == get_adc_channel_mask(&adc) || !dma.ring.descriptors)
+    {
+        return;
+    }
+
+    if (!set_adc_channel_mask(&adc, mask) ||
+        !record(&dma, samples, params.samples_per_packet, adc))
+    {
+        dblog(LOG_WARN, "Failed to %s the sync channel mask.\n", (masked)? "set" : "clear");
+    }
+}
+
+/**
+ * Sends each packet as planar channels for the capture of a planned window,
+ * or restores interleaved packets for every other capture.
+ *
+ * @note As in set_sync_channels, packets already in the stream keep their
+ *       previous format, so one packet is recorded and discarded after the
+ *       change.
+ *
+ * @param planar Specified true to send planar packets.
+ *
+ * @return Success or fail.
+ */
+result_t set_planar_packets(const bool planar)
+{
+    const bool enabled = (adc.regs->stream_control & ADC_STREAM_PLANAR)? true : false;
+    if (planar == enabled)
+    {
+        return success;
+    }
+
+    AbortIfNot(set_adc_planar_packets(&adc, planar), fail);
+    AbortIfNot(record(&dma, samples, params.samples_per_packet, adc), fail);
+
+    return success;
+}
+
+/**
+ * Checks if a planned window may be recorded as planar channels, which the
+ * DSP stages then work on where they lie.
+ *
+ * @note Only the window around a located ping is copied back into the
+ *       interleaved samples, so the capture is interleaved whenever the
+ *       whole of it is previewed, recorded or searched for other pingers,
+ *       and whenever it is filtered or decimated.
+ *
+ * @return True if the window may be recorded as planar channels.
+ */
+bool planar_window_usable()
+{
+    return (planar_capture &&
+            dma.ring.descriptors &&
+            !debug_stream &&
+            !preview_stream &&
+            sd_recorder.mode != SD_RECORD_CAPTURES &&
+            !params.filter &&
+            params.dsp_decimation <= 1 &&
+            params.num_pingers == 0 &&
+            !params.hw_trigger &&
+            params.samples_per_packet % ADC_PLANAR_GROUP_SAMPLES == 0 &&
+            params.samples_per_packet <= ADC_PLANAR_MAX_SAMPLES &&
+            !adc_samples_packed(&adc) &&
+            get_adc_channel_mask(&adc) == ADC_ALL_CHANNELS)? true : false;
+}
+
+/**
+ * Appends the statistics trailer to each packet for the capture of a planned
+ * window, or restores packets without them for every other capture.
+ *
+ * @note As in set_planar_packets, one packet is recorded and discarded after
+ *       the change.
+ *
+ * @param stats Specified true to append the trailers.
+ *
+ * @return Success or fail.
+ */
+result_t set_stats_packets(const bool stats)
+{
+    const bool enabled = adc_packets_have_stats(&adc);
+    if (stats == enabled)
+    {
+        return success;
+    }
+
+    AbortIfNot(set_adc_packet_stats(&adc, stats), fail);
+    if (stats)
+    {
+        AbortIfNot(record_with_stats(&dma, samples, packet_trailers, params.samples_per_packet, adc), fail);
+    }
+    else
+    {
+        AbortIfNot(record(&dma, samples, params.samples_per_packet, adc), fail);
+    }
+
+    return success;
+}
+
+/**
+ * Checks if a planned window may be recorded with the statistics trailers
+ * of the ADC.
+ *
+ * @note The trailers are sent between samples, so the sampling rate must
+ *       leave the FPGA enough cycles per sample to send them.
+ *
+ * @param planar_window Specified true if the window is recorded as planar
+ *        channels, which are measured as they are normalized instead.
+ *
+ * @return True if the window may be recorded with the trailers.
+ */
+bool stats_window_usable(const bool planar_window)
+{
+    return (packet_stats &&
+            !planar_window &&
+            dma.ring.descriptors &&
+            !params.hw_trigger &&
+            params.samples_per_packet >= ADC_STATS_MIN_PACKET_SAMPLES &&
+            params.samples_per_packet <= ADC_STATS_MAX_SAMPLES &&
+            (uint64_t)get_adc_sampling_frequency(&adc) * ADC_STATS_MIN_PERIOD_CYCLES <= FPGA_CLK &&
+            !adc_samples_packed(&adc) &&
+            get_adc_channel_mask(&adc) == ADC_ALL_CHANNELS)? true : false;
+}
+
+/**
+ * Determines the number of samples to capture for a duration.
+ *
+ * @param duration The duration of the capture.
+ * @param sampling_frequency The sampling frequency of acquisition.
+ * @param max_samples The number of samples available for the capture.
+ *
+ * @return The number of samples to capture, rounded to whole packets.
+ */
+size_t get_capture_length(const tick_t duration,
+                          const uint32_t sampling_frequency,
+                          const size_t max_samples)
+{
+    size_t num_samples = ticks_to_samples(duration, sampling_frequency);
+    if (num_samples % params.samples_per_packet)
+    {
+        num_samples += (params.samples_per_packet - (num_samples % params.samples_per_packet));
+    }
+
+    if (num_samples > max_samples)
+    {
+        num_samples = max_samples - (max_samples % params.samples_per_packet);
+    }
+
+    return num_samples;
+}
+
+/**
+ * Issue a request for thruster silent running for clean hydrophone readings.
+ *
+ * @param socket The socket to make the request on.
+ * @param ticks The time in the future that thrusters should be shut down at.
+ * @param duration The duration that thrusters should be shut down for.
+ *
+ * @return Success or fail.
+ */
+result_t request_thruster_shutdown(udp_socket_t *socket,
+                                   const tick_t future_ticks,
+                                   const tick_t duration)
+{
+    silence_request_t request;
+    request.when_ms = ticks_to_ms(future_ticks - get_system_time());
+    request.duration_ms = ticks_to_ms(duration);
+    request.start_us = ticks_to_micros(future_ticks);
+    request.duration_us = ticks_to_micros(duration);
+    trace(TRACE_SILENCE_REQUEST,
+          TRACE_INSTANT,
+          ticks_to_micros(future_ticks - get_system_time()),
+          request.duration_us);
+
+    /*
+     * The request is sent alone at once rather than batched, since the
+     * thrusters must hear it before the window opens.
+     */
+    AbortIfNot(send_udp(socket, (char *)&request, sizeof(request)), fail);
+
+    return success;
+}
+
+/**
+ * Reads the latest edge of the external trigger input and relates its stream
+ * timestamp to the system time.
+ *
+ * @param[out] mark The latest edge, with a count of zero if there was none.
+ *
+ * @return Success or fail.
+ */
+result_t read_trigger_mark(trigger_mark_t *mark)
+{
+    AbortIfNot(mark, fail);
+
+    adc_sync_latch_t latch;
+    uint64_t now_sample;
+    tick_t now;
+    AbortIfNot(read_adc_ext_trigger(&adc, &latch), fail);
+    AbortIfNot(read_adc_stream_time(&adc, &now_sample, &now), fail);
+
+    mark->count = latch.count;
+    mark->sample = latch.sample;
+    mark->tick = 0;
+    if (latch.count && latch.sample <= now_sample)
+    {
+        mark->tick = now - samples_to_ticks(now_sample - latch.sample, get_adc_sampling_frequency(&adc));
+    }
+
+    return success;
+}
+
+/**
+ * Drives the external trigger output over a capture window, so that other
+ * sensors are told when the hydrophones listen without a network round trip.
+ *
+ * @param window The window to signal.
+ *
+ * @return Success or fail.
+ */
+result_t signal_capture_window(const ping_window_t *window)
+{
+    AbortIfNot(window, fail);
+
+    uint64_t now_sample;
+    tick_t now;
+    AbortIfNot(read_adc_stream_time(&adc, &now_sample, &now), fail);
+
+    const uint32_t sampling_frequency = get_adc_sampling_frequency(&adc);
+    const tick_t lead = (window->start_tick > now)? window->start_tick - now : 0;
+    const uint64_t start = now_sample + ticks_to_samples(lead, sampling_frequency);
+    const uint64_t end = start + ticks_to_samples(window->silence_duration, sampling_frequency);
+    AbortIfNot(set_adc_ext_output_window(&adc, start, end), fail);
+
+    return success;
+}
+
+/**
+ * Plans the capture window around the next ping. A follower captures the
+ * window shared by its master so that every board of the array records the
+ * same ping, and the master shares each window it plans.
+ *
+ * @param after The time after which the window may open.
+ * @param[out] window The planned window.
+ *
+ * @return Success or fail.
+ */
+result_t plan_capture_window(const tick_t after, ping_window_t *window)
+{
+    if (take_board_window(&board_sync, &window->start_tick, &window->duration, &window->ping_tick))
+    {
+        window->silence_duration = window->duration;
+    }
+    else
+    {
+        AbortIfNot(plan_ping_window(&ping_tracker, after, capture_misses, window), fail);
+
+        if (board_sync.role == BOARD_SYNC_MASTER &&
+            !share_board_window(&board_sync, window->start_tick, window->duration, window->ping_tick))
+        {
+            dblog(LOG_WARN, "Failed to share the capture window.\n");
+        }
+    }
+
+    if (trigger_output == TRIGGER_OUTPUT_WINDOWS && !signal_capture_window(window))
+    {
+        dblog(LOG_WARN, "Failed to signal the capture window.\n");
+    }
+
+    schedule_transmit_quiet(window->start_tick, window->start_tick + window->duration);
+
+    return success;
+}
+
+/**
+ * Waits for a new edge of the external trigger input and opens a capture
+ * window at it.
+ *
+ * @param[out] window The window opened at the edge.
+ * @param[out] found Whether an edge arrived in time.
+ *
+ * @return Success or fail.
+ */
+result_t wait_for_trigger_gate(ping_window_t *window, bool *found)
+{
+    AbortIfNot(window, fail);
+    AbortIfNot(found, fail);
+
+    *found = false;
+    const uint32_t last_count = ping_stats.trigger.count;
+    const tick_t wait_start = get_system_time();
+    trigger_mark_t mark;
+    while (get_system_time() - wait_start < ms_to_ticks(TRIGGER_GATE_TIMEOUT_MS))
+    {
+        AbortIfNot(read_trigger_mark(&mark), fail);
+        if (mark.count != last_count)
+        {
+            *found = true;
+            break;
+        }
+
+        kick_watchdog(&watchdog);
+        AbortIfNot(run_tasks(&scheduler, TASKS_ALL), fail);
+        apply_pending_commands();
+        wait_for_interrupt();
+    }
+
+    if (!*found)
+    {
+        ping_stats.trigger_timeouts++;
+        return success;
+    }
+
+    ping_stats.trigger = mark;
+    window->start_tick = get_system_time();
+    window->duration = ms_to_ticks(TRIGGER_GATE_WINDOW_MS);
+    window->silence_duration = window->duration;
+    window->ping_tick = window->start_tick;
+
+    if (trigger_output == TRIGGER_OUTPUT_WINDOWS && !signal_capture_window(window))
+    {
+        dblog(LOG_WARN, "Failed to signal the capture window.\n");
+    }
+
+    return success;
+}
+
+/**
+ * Drives or follows the sync line shared with the other boards of an array.
+ *
+ * @param arg Unused.
+ *
+ * @return Success or fail.
+ */
+result_t board_sync_task(void *arg)
+{
+    return service_board_sync(&board_sync);
+}
+
+/**
+ * Starts the scheduled ping capture once its start time has arrived.
+ *
+ * @note This runs as the acquisition task of the scheduler between processing
+ *       stages, in case the alarm of the schedule was missed.
+ *
+ * @param schedule The ping schedule to service.
+ *
+ * @return Success or fail.
+ */
+result_t service_ping_schedule(ping_schedule_t *schedule)
+{
+    AbortIfNot(schedule, fail);
+
+    if (!schedule->armed)
+    {
+        return success;
+    }
+
+    if (!schedule->started)
+    {
+        if (get_system_time() >= schedule->start_tick)
+        {
+            /*
+             * The alarm normally starts the capture. Interrupts are masked so
+             * that an alarm that is late does not start it a second time.
+             */
+            set_interrupts(false);
+            cancel_global_timer_alarm();
+            result_t ret = success;
+            if (!schedule->started)
+            {
+                ret = start_capture_from_interrupt(&ping_capture,
+                                                   &dma,
+                                                   schedule->buffer,
+                                                   schedule->num_samples,
+                                                   adc);
+                schedule->started = true;
+            }
+            set_interrupts(true);
+            AbortIfNot(ret, fail);
+        }
+    }
+    else if (!dma.interrupts_enabled)
+    {
+        AbortIfNot(service_capture(&ping_capture), fail);
+    }
+
+    /*
+     * Streams held for the window resume as soon as it has been captured.
+     */
+    if (schedule->started && !ping_capture.active)
+    {
+        end_transmit_quiet();
+    }
+
+    return success;
+}
+
+/**
+ * Starts the scheduled ping capture from the global timer alarm, so that it
+ * begins on time regardless of what the main loop is processing.
+ *
+ * @param arg The ping schedule.
+ *
+ * @return None.
+ */
+void ping_schedule_alarm(void *arg)
+{
+    ping_schedule_t *schedule = (ping_schedule_t *)arg;
+    if (!schedule->armed || schedule->started)
+    {
+        return;
+    }
+
+    /*
+     * A failure cannot be reported from the interrupt, so the capture is
+     * marked failed for wait_for_capture().
+     */
+    if (start_capture_from_interrupt(&ping_capture,
+                                     &dma,
+                                     schedule->buffer,
+                                     schedule->num_samples,
+                                     adc) != success)
+    {
+        ping_capture.error = true;
+    }
+    schedule->started = true;
+}
+
+/**
+ * Cancels the scheduled ping capture, stopping it if it is in progress.
+ *
+ * @param schedule The ping schedule to cancel.
+ *
+ * @return Success or fail.
+ */
+result_t cancel_ping_schedule(ping_schedule_t *schedule)
+{
+    AbortIfNot(schedule, fail);
+
+    cancel_global_timer_alarm();
+
+    if (schedule->armed && schedule->started)
+    {
+        AbortIfNot(abort_capture(&ping_capture), fail);
+    }
+
+    schedule->armed = false;
+    schedule->started = false;
+
+    return success;
+}
+
+/**
+ * Waits for the continuous capture to detect a ping and copies the window
+ * around it out of the ring, starting the capture if it is not running.
+ *
+ * @note The background tasks and commands are serviced while waiting, and
+ *       the wait ends after a ring of samples without a ping so that the
+ *       main loop can follow a change of mode.
+ *
+ * @param[out] ping_samples The window of the ping.
+ * @param[out] num_samples The number of samples of the window.
+ * @param[out] end_tick The time at which the window was extracted.
+ * @param[out] extracted Specified true if a window was extracted.
+ *
+ * @return Success or fail.
+ */
+result_t wait_for_continuous_ping(sample_t **ping_samples,
+                                  size_t *num_samples,
+                                  tick_t *end_tick,
+                                  bool *extracted)
+{
+    AbortIfNot(ping_samples, fail);
+    AbortIfNot(num_samples, fail);
+    AbortIfNot(end_tick, fail);
+    AbortIfNot(extracted, fail);
+
+    *extracted = false;
+    if (!continuous_capture.capture.active)
+    {
+        AbortIfNot(start_continuous_capture(&continuous_capture,
+                                            &dma,
+                                            samples,
+                                            continuous_ring_samples,
+                                            adc,
+                                            get_adc_sampling_frequency(&adc),
+                                            &params,
+                                            &capture_filter,
+                                            &continuous_timing), fail);
+        dbprintf("Continuous capture started with %u ms of history\n", CONTINUOUS_RING_MS);
+        sync = true;
+    }
+
+    const tick_t start_time = get_system_time();
+    begin_deadline(&watchdog, DEADLINE_CAPTURE, ms_to_ticks(CONTINUOUS_RING_MS + DEADLINE_CAPTURE_SLACK_MS));
+    while (!continuous_ping_ready(&continuous_capture))
+    {
+        if (!sync || get_system_time() - start_time > ms_to_ticks(CONTINUOUS_RING_MS))
+        {
+            end_deadline(&watchdog, DEADLINE_CAPTURE);
+            return success;
+        }
+
+        AbortIfNot(run_tasks(&scheduler, TASKS_ALL), fail);
+        apply_pending_commands();
+        if (dma.interrupts_enabled && !continuous_ping_ready(&continuous_capture))
+        {
+            wait_for_interrupt();
+        }
+    }
+    end_deadline(&watchdog, DEADLINE_CAPTURE);
+
+    sample_t *window = &samples[continuous_ring_samples];
+    AbortIfNot(extract_continuous_ping(&continuous_capture,
+                                       window,
+                                       capture_samples - continuous_ring_samples,
+                                       &timing,
+                                       num_samples,
+                                       extracted), fail);
+    *ping_samples = window;
+    *end_tick = get_system_time();
+
+    return success;
+}
+
+/**
+ * Sends a telemetry report immediately.
+ *
+ * @note A report that cannot be sent is skipped rather than failing
+ *       acquisition.
+ *
+ * @return None.
+ */
+void report_telemetry()
+{
+    if (!send_telemetry(&telemetry_socket, &ping_stats, &dma, &watchdog, &channel_health, &adc_self_test, &load_governor, &system_monitor))
+    {
+        dblog(LOG_WARN, "Failed to send telemetry.\n");
+    }
+}
+
+
+/**
+ * Calculates the time a capture takes.
+ *
+ * @param num_samples The number of samples in the capture.
+ * @param sampling_frequency The ADC sample rate in Hz.
+ *
+ * @return The duration of the capture.
+ */
+tick_t capture_ticks(const size_t num_samples, const uint32_t sampling_frequency)
+{
+    return samples_to_ticks(num_samples, sampling_frequency);
+}
+
+/**
+ * Calculates the deadline of sending data at the stream rate limit, allowing
+ * for the streams being held around the next capture window.
+ *
+ * @param bytes The number of bytes to send.
+ *
+ * @return The time the data may take to send.
+ */
+tick_t send_budget(const uint64_t bytes)
+{
+    tick_t budget = ms_to_ticks(DEADLINE_SEND_SLACK_MS) + get_transmit_quiet_remaining();
+    if (effective_transmit_rate)
+    {
+        budget += bytes * CPU_CLOCK_HZ / effective_transmit_rate;
+    }
+
+    return budget;
+}
+
+/**
+ * Streams the next datagrams of the queued recordings and reports any that
+ * were dropped.
+ *
+ * @return None.
+ */
+void service_recording()
+{
+    static uint32_t reported_drops = 0;
+
+    if (!service_record_queue(&record_queue))
+    {
+        dblog(LOG_WARN, "Failed to stream a recording.\n");
+    }
+
+    if (record_queue.dropped != reported_drops)
+    {
+        dblog(LOG_WARN, "Dropped %u recordings.\n", record_queue.dropped - reported_drops);
+        reported_drops = record_queue.dropped;
+    }
+}
+
+/**
+ * Services the watchdog, the ping schedule, telemetry, and recordings while a
+ * stream waits for the link.
+ *
+ * @param arg Unused.
+ *
+ * @return Success or fail.
+ */
+result_t service_transmit_idle(void *arg)
+{
+    /*
+     * Every datagram is bounded by the release timeout, so a stream that is
+     * still waiting is still making progress.
+     */
+    kick_watchdog(&watchdog);
+
+    /*
+     * The network stack is already being dispatched by the stream, and the
+     * log would compete with it for the link.
+     */
+    return run_tasks(&scheduler, TASK_MASK(TASK_ACQUISITION) | TASK_MASK(TASK_DEBUG_TX));
+}
+
+/**
+ * Streams samples over USB if the USB capture stream is enabled and a host
+ * has configured the device.
+ *
+ * @note A capture that fails to stream over USB is not resent on the data
+ *       stream.
+ *
+ * @param data The samples to send.
+ * @param count The number of samples.
+ *
+ * @return True if the samples were handled by the USB stream.
+ */
+bool send_usb_samples(const sample_t *data, const size_t count)
+{
+    if (!usb_capture_stream || !usb_stream_ready(&usb_stream))
+    {
+        return false;
+    }
+
+    if (!send_usb_array(&usb_stream, data, sizeof(sample_t), count, service_transmit_idle, NULL))
+    {
+        dblog(LOG_WARN, "Failed to stream samples over USB.\n");
+    }
+
+    return true;
+}
+
+/**
+ * Starts the scheduled ping capture once its start time has arrived.
+ *
+ * @param arg The ping schedule.
+ *
+ * @return Success or fail.
+ */
+result_t ping_schedule_task(void *arg)
+{
+    return service_ping_schedule((ping_schedule_t *)arg);
+}
+
+/**
+ * Searches the samples that reached the ring of the continuous capture, so
+ * that pings are detected while the previous ping is processed and sent.
+ *
+ * @param arg The continuous capture.
+ *
+ * @return Success or fail if the running capture stopped.
+ */
+result_t continuous_capture_task(void *arg)
+{
+    continuous_capture_t *continuous = (continuous_capture_t *)arg;
+    if (!continuous->capture.active)
+    {
+        return success;
+    }
+
+    return service_continuous_capture(continuous);
+}
+
+/**
+ * Runs tasks of a parallel loop opened by the DSP core.
+ *
+ * @param arg Unused.
+ *
+ * @return Success.
+ */
+result_t dsp_help_task(void *arg)
+{
+    help_dsp_core();
+
+    return success;
+}
+
+/**
+ * Pushes received network traffic into the network stack and runs its timers.
+ *
+ * @param arg Unused.
+ *
+ * @return Success.
+ */
+result_t network_task(void *arg)
+{
+    dispatch_network_stack();
+
+    return success;
+}
+
+/**
+ * Streams the next datagrams of the queued recordings.
+ *
+ * @param arg Unused.
+ *
+ * @return Success.
+ */
+result_t recording_task(void *arg)
+{
+    service_recording();
+
+    return success;
+}
+
+/**
+ * Resends the results that the link could not take, and sends those that have
+ * waited long enough to share a datagram.
+ *
+ * @param arg Unused.
+ *
+ * @return Success or fail.
+ */
+result_t result_retry_task(void *arg)
+{
+    AbortIfNot(service_result_retries(), fail);
+
+    return service_result_batch();
+}
+
+/**
+ * Writes the next staged chunk of the SD card recording.
+ *
+ * @param arg Unused.
+ *
+ * @return Success.
+ */
+result_t sd_record_task(void *arg)
+{
+    if (!service_sd_recorder(&sd_recorder))
+    {
+        dblog(LOG_WARN, "SD card recording stopped after a failed write.\n");
+    }
+
+    return success;
+}
+
+/**
+ * Sends the next datagrams of the background sends of the previous ping.
+ *
+ * @param arg Unused.
+ *
+ * @return Success or fail.
+ */
+result_t ping_send_task(void *arg)
+{
+    AbortIfNot(service_stream_job(&xcorr_stream_job), fail);
+    AbortIfNot(service_stream_job(&data_stream_job), fail);
+
+    return success;
+}
+
+/**
+ * Sends the periodic telemetry report.
+ *
+ * @param arg Unused.
+ *
+ * @return Success.
+ */
+result_t telemetry_task(void *arg)
+{
+    report_telemetry();
+
+    return success;
+}
+
+/**
+ * Polls the state of the Ethernet link, and limits the streams to the rate
+ * of the link when it changes.
+ *
+ * @param arg Unused.
+ *
+ * @return Success or fail.
+ */
+result_t network_link_task(void *arg)
+{
+    bool changed = false;
+    AbortIfNot(service_network_link(&changed), fail);
+    if (changed)
+    {
+        AbortIfNot(apply_transmit_rate(), fail);
+    }
+
+    return success;
+}
+
+/**
+ * Drains part of the log to its outputs.
+ *
+ * @param arg Unused.
+ *
+ * @return Success.
+ */
+result_t log_task(void *arg)
+{
+    service_log(LOG_DRAIN_BYTES_PER_CALL);
+
+    return success;
+}
+
+/**
+ * Runs the processing of a capture, on the DSP core if it is available.
+ *
+ * @note The network stack and scheduled captures are serviced while the DSP
+ *       core works.
+ *
+ * @param job The job to run. The outcome is stored in the job.
+ *
+ * @return Success or fail.
+ */
+result_t process_capture(dsp_job_t *job)
+{
+    AbortIfNot(job, fail);
+
+    if (dsp_core_running())
+    {
+        /*
+         * The correlation is shared with this core, which runs its tasks
+         * between servicing the network.
+         */
+        job->parallel_for = share_dsp_work;
+        AbortIfNot(submit_dsp_job(job), fail);
+        dsp_job_pending = true;
+        dsp_job_t *completed = NULL;
+        while (!receive_dsp_job(&completed))
+        {
+            help_dsp_core();
+            AbortIfNot(run_tasks(&scheduler, TASKS_ALL), fail);
+        }
+        dsp_job_pending = false;
+        AbortIfNot(completed == job, fail);
+    }
+    else
+    {
+        job->parallel_for = NULL;
+        AbortIfNot(run_dsp_job(job), fail);
+    }
+
+    AbortIfNot(job->status, fail);
+
+    return success;
+}
+
+/**
+ * Checks if a block of the TCP stream ring can be captured into.
+ *
+ * @param block The block to check.
+ *
+ * @return True if the block has been acknowledged by the client.
+ */
+bool stream_block_free(stream_block_t *block)
+{
+    if (block->state == STREAM_BLOCK_SENT &&
+        tcp_acknowledged(&capture_stream_socket, block->end_offset))
+    {
+        block->state = STREAM_BLOCK_FREE;
+    }
+
+    return (block->state == STREAM_BLOCK_FREE)? true : false;
+}
+
+/**
+ * Queues as much of a captured block as the TCP send window allows.
+ *
+ * @note The samples are referenced rather than copied, so the block is only
+ *       released once the client acknowledges it.
+ *
+ * @param block The block to send.
+ *
+ * @return Success or fail.
+ */
+result_t stream_block(stream_block_t *block)
+{
+    const size_t header_len = sizeof(block->header);
+    const size_t data_len = block->header.sample_count * sizeof(sample_t);
+
+    size_t written = 1;
+    while (written && block->queued < header_len + data_len)
+    {
+        if (block->queued < header_len)
+        {
+            AbortIfNot(send_tcp(&capture_stream_socket,
+                                (uint8_t *)&block->header + block->queued,
+                                header_len - block->queued,
+                                true,
+                                &written), fail);
+        }
+        else
+        {
+            const size_t offset = block->queued - header_len;
+            AbortIfNot(send_tcp(&capture_stream_socket,
+                                (uint8_t *)block->data + offset,
+                                data_len - offset,
+                                false,
+                                &written), fail);
+        }
+
+        block->queued += written;
+    }
+
+    if (block->queued == header_len + data_len)
+    {
+        block->end_offset = capture_stream_socket.written;
+        block->state = STREAM_BLOCK_SENT;
+    }
+
+    return success;
+}
+
+/**
+ * Continuously captures into a ring of blocks and streams them to the
+ * connected TCP client.
+ *
+ * @note A block is only captured into again once the client has acknowledged
+ *       it, so the TCP send window paces acquisition. Samples that arrive
+ *       while the ring is full are lost, which appears as a gap in the
+ *       embedded hardware timestamps.
+ *
+ * @return Success or fail.
+ */
+result_t stream_captures_tcp()
+{
+    const size_t block_packets = (TCP_STREAM_BLOCK_SAMPLES + params.samples_per_packet - 1) /
+            params.samples_per_packet;
+    const size_t block_samples = params.samples_per_packet * block_packets;
+    AbortIfNot(block_samples * TCP_STREAM_BLOCKS <= capture_samples, fail);
+
+    stream_block_t blocks[TCP_STREAM_BLOCKS];
+    for (size_t i = 0; i < TCP_STREAM_BLOCKS; ++i)
+    {
+        blocks[i].state = STREAM_BLOCK_FREE;
+        blocks[i].data = &samples[i * block_samples];
+    }
+
+    dbprintf("Streaming captures over TCP.\n");
+
+    uint32_t sequence = 0;
+    size_t capture_block = 0, send_block = 0;
+    bool capturing = false;
+    result_t ret = success;
+    while (ret == success && tcp_stream && tcp_connected(&capture_stream_socket))
+    {
+        AbortIfNot(run_tasks(&scheduler, TASKS_ALL), fail);
+        apply_pending_commands();
+
+        if (capturing)
+        {
+            if (!dma.interrupts_enabled)
+            {
+                ret = service_capture(&ping_capture);
+            }
+
+            if (ping_capture.error)
+            {
+                ret = fail;
+            }
+            else if (ping_capture.complete)
+            {
+                stream_block_t *block = &blocks[capture_block];
+                block->header.sequence = sequence++;
+                block->header.sample_count = block_samples;
+                block->queued = 0;
+                block->state = STREAM_BLOCK_CAPTURED;
+                capture_block = (capture_block + 1) % TCP_STREAM_BLOCKS;
+                capturing = false;
+            }
+        }
+
+        if (ret == success && !capturing && stream_block_free(&blocks[capture_block]))
+        {
+            blocks[capture_block].state = STREAM_BLOCK_CAPTURING;
+            ret = start_capture(&ping_capture,
+                                &dma,
+                                blocks[capture_block].data,
+                                block_samples,
+                                adc);
+            capturing = (ret == success)? true : false;
+        }
+
+        if (ret == success && blocks[send_block].state == STREAM_BLOCK_CAPTURED)
+        {
+            ret = stream_block(&blocks[send_block]);
+            if (blocks[send_block].state == STREAM_BLOCK_SENT)
+            {
+                send_block = (send_block + 1) % TCP_STREAM_BLOCKS;
+            }
+        }
+    }
+
+    if (capturing)
+    {
+        abort_capture(&ping_capture);
+    }
+
+    /*
+     * Blocks that are still referenced by queued segments must not be
+     * overwritten, so the connection is dropped with them.
+     */
+    for (size_t i = 0; i < TCP_STREAM_BLOCKS; ++i)
+    {
+        if (blocks[i].state == STREAM_BLOCK_SENT && !stream_block_free(&blocks[i]))
+        {
+            AbortIfNot(close_tcp(&capture_stream_socket), fail);
+            break;
+        }
+    }
+
+    dbprintf("TCP stream stopped.\n");
+    AbortIfNot(ret, fail);
+
+    return success;
+}
+
+/**
+ * Captures as many samples as the sample array holds in a transmit layout and
+ * sends them unprocessed to the subscribers of the data stream.
+ *
+ * @note Each datagram is sent from where its samples were captured, so the
+ *       capture is neither normalized nor filtered and keeps its embedded
+ *       timestamps.
+ *
+ * @return Success or fail.
+ */
+result_t stream_raw_capture()
+{
+    const uint32_t sampling_frequency = get_adc_sampling_frequency(&adc);
+
+    /*
+     * Raw frames carry no header ahead of their samples, so the capture is
+     * recorded contiguously for them.
+     */
+    if (raw_stream_enabled())
+    {
+        const size_t count = capture_samples / params.samples_per_packet * params.samples_per_packet;
+        begin_deadline(&watchdog, DEADLINE_CAPTURE, capture_ticks(count, sampling_frequency) +
+                       ms_to_ticks(DEADLINE_CAPTURE_SLACK_MS));
+        AbortIfNot(record(&dma, samples, count, adc), fail);
+        end_deadline(&watchdog, DEADLINE_CAPTURE);
+
+        begin_deadline(&watchdog, DEADLINE_SEND, send_budget((uint64_t)count * sizeof(sample_t)));
+        AbortIfNot(send_raw_data(samples, count), fail);
+        end_deadline(&watchdog, DEADLINE_SEND);
+
+        return success;
+    }
+
+    segmented_layout_t layout;
+    AbortIfNot(init_transmit_layout(&layout,
+                                    samples,
+                                    capture_samples * sizeof(sample_t),
+                                    params.samples_per_packet), fail);
+    const size_t count = layout.num_segments * layout.segment_samples;
+
+    begin_deadline(&watchdog, DEADLINE_CAPTURE, capture_ticks(count, sampling_frequency) +
+                   ms_to_ticks(DEADLINE_CAPTURE_SLACK_MS));
+    AbortIfNot(record_segmented(&dma, &layout, count, adc), fail);
+    end_deadline(&watchdog, DEADLINE_CAPTURE);
+
+    udp_socket_t *sockets[STREAM_MAX_SUBSCRIBERS];
+    const size_t num_sockets = select_subscribers(SUBSCRIBED_DATA, false, sockets);
+    begin_deadline(&watchdog, DEADLINE_SEND, send_budget(num_sockets * (uint64_t)count * sizeof(sample_t)));
+    for (size_t i = 0; i < num_sockets; ++i)
+    {
+        AbortIfNot(send_segmented_data(sockets[i], &layout, count), fail);
+    }
+    end_deadline(&watchdog, DEADLINE_SEND);
+
+    return success;
+}
+
+/**
+ * Captures samples for the requested duration and streams their averaged
+ * power spectra.
+ *
+ * @note When the descriptor ring is available, each half of the sample array
+ *       is captured into while the other is averaged. Samples that arrive
+ *       while both halves are busy are not surveyed.
+ *
+ * @return Success or fail.
+ */
+result_t run_survey()
+{
+    const size_t samples_per_packet = params.samples_per_packet;
+    size_t block_samples = (capture_samples / 2 < SURVEY_BLOCK_SAMPLES)?
+            capture_samples / 2 : SURVEY_BLOCK_SAMPLES;
+    block_samples -= block_samples % samples_per_packet;
+    AbortIfNot(block_samples >= survey_fft_len, fail);
+
+    sample_t *blocks[2] = {samples, &samples[block_samples]};
+    const uint32_t sampling_frequency = get_adc_sampling_frequency(&adc);
+    const uint64_t target_samples = (uint64_t)requested_survey_ms * sampling_frequency / 1000;
+
+    spectral_survey_t survey;
+    AbortIfNot(init_spectral_survey(&survey, survey_fft_len, survey_window, survey_work, survey_power), fail);
+
+    dbprintf("Surveying for %u ms.\n", requested_survey_ms);
+
+    tick_t start_tick = get_system_time();
+    uint64_t surveyed = 0;
+    size_t block = 0;
+    bool capturing = false;
+    result_t ret = success;
+    if (dma.ring.descriptors)
+    {
+        ret = start_capture(&ping_capture, &dma, blocks[block], block_samples, adc);
+        capturing = (ret == success)? true : false;
+        start_tick = ping_capture.start_time;
+    }
+
+    while (ret == success && requested_survey_ms && surveyed < target_samples)
+    {
+        if (capturing)
+        {
+            ret = wait_for_capture(&ping_capture);
+            capturing = false;
+        }
+        else
+        {
+            ret = record(&dma, blocks[block], block_samples, adc);
+        }
+
+        /*
+         * Clear the embedded timestamps before the samples are averaged.
+         */
+        if (ret == success)
+        {
+            ret = extract_timestamps(&timing, blocks[block], block_samples, samples_per_packet, get_system_time());
+        }
+
+        surveyed += block_samples;
+        if (ret == success && dma.ring.descriptors && surveyed < target_samples)
+        {
+            ret = start_capture(&ping_capture, &dma, blocks[1 - block], block_samples, adc);
+            capturing = (ret == success)? true : false;
+        }
+
+        if (ret == success)
+        {
+            ret = add_survey_samples(&survey, blocks[block], block_samples);
+        }
+
+        block = 1 - block;
+        kick_watchdog(&watchdog);
+        AbortIfNot(run_tasks(&scheduler, TASKS_ALL), fail);
+        apply_pending_commands();
+    }
+
+    if (capturing)
+    {
+        abort_capture(&ping_capture);
+    }
+
+    requested_survey_ms = 0;
+    AbortIfNot(ret, fail);
+
+    dbprintf("Survey averaged %u segments.\n", survey.segments);
+    if (survey.segments)
+    {
+        AbortIfNot(send_survey(&survey_socket, &survey, start_tick, sampling_frequency), fail);
+    }
+
+    return success;
+}
+
+/**
+ * Processes a capture received from the replay client through the same DSP
+ * job as a recorded ping, and relays the outcome on the result streams and
+ * to the client.
+ *
+ * @note Replayed captures carry no hardware timestamps, so the ping tracker
+ *       and pipelined captures are not used.
+ *
+ * @param result_socket The socket to relay the result on.
+ *
+ * @return Success or fail.
+ */
+result_t process_replay(udp_socket_t *result_socket)
+{
+    AbortIfNot(replay_ready(&replay), fail);
+
+    const size_t num_samples = replay.header.sample_count;
+    const uint32_t sampling_frequency = replay.header.sampling_frequency;
+    replay_sequence++;
+
+    dsp_job_t job;
+    job.data = replay.buffer;
+    job.len = num_samples;
+    job.params = params;
+    job.sampling_frequency = sampling_frequency;
+    job.filter = &capture_filter;
+    job.decimator = prepare_capture_decimator(sampling_frequency);
+    job.fir = prepare_capture_fir(sampling_frequency);
+    job.correlate = true;
+    job.correlations = correlations;
+    job.correlation_len = correlation_len;
+    job.cross_correlations = cross_correlations;
+    job.planar = (planar_dsp)? &planar_samples : NULL;
+    job.planar_input = false;
+    job.measured_stats = NULL;
+    job.average = NULL;
+    job.lag_tracker = NULL;
+    job.bearing_tracker = NULL;
+    job.excluded_channels = 0;
+    job.calibration = &channel_calibration;
+    job.fast_tdoa = false;
+
+    const tick_t processing_start = get_system_time();
+    const result_t ret = process_capture(&job);
+    const tick_t processing_duration = get_system_time() - processing_start;
+
+    replay_summary_t summary;
+    memset(&summary, 0, sizeof(summary));
+    summary.version = REPLAY_VERSION;
+    summary.status = (ret == success)? 1 : 0;
+    summary.located = (ret == success && job.located && job.accepted)? 1 : 0;
+    summary.sequence = replay_sequence;
+    summary.receive_duration_us = ticks_to_micros(replay.end_tick - replay.start_tick);
+    summary.processing_duration_us = ticks_to_micros(processing_duration);
+    summary.filter_duration_us = ticks_to_micros(job.filter_duration);
+    summary.correlation_duration_us = ticks_to_micros(job.correlation_duration);
+
+    if (summary.located)
+    {
+        AbortIfNot(job.end_index > job.start_index, fail);
+        AbortIfNot(solve_bearing(&hydrophone_array, &job.result), fail);
+
+        summary.start_index = job.start_index;
+        summary.end_index = job.end_index;
+        memcpy(summary.channel_delay_ns, job.result.channel_delay_ns, sizeof(summary.channel_delay_ns));
+        memcpy(summary.confidence, job.result.confidence, sizeof(summary.confidence));
+        summary.bearing_deg = job.result.bearing_deg;
+        summary.elevation_deg = job.result.elevation_deg;
+    }
+
+    dbprintf("Replay %u: %u samples at %u Hz received in %u us, processed in %u us "
+            "(filter %u us, correlation %u us)\n",
+            replay_sequence,
+            num_samples,
+            sampling_frequency,
+            summary.receive_duration_us,
+            summary.processing_duration_us,
+            summary.filter_duration_us,
+            summary.correlation_duration_us);
+
+    /*
+     * The summary is returned before the streams are sent so that the client
+     * measures the processing rather than the transmit rate limit.
+     */
+    AbortIfNot(finish_replay(&replay, &summary), fail);
+
+    /*
+     * A recorded capture that cannot be processed is reported rather than
+     * resetting the board.
+     */
+    if (ret != success)
+    {
+        dbprintf("Replay %u: processing failed.\n", replay_sequence);
+        return success;
+    }
+
+    if (!summary.located)
+    {
+        if (job.located)
+        {
+            dbprintf("Replay %u: rejected the ping with quality %d%%.\n",
+                    replay_sequence, (int)(job.quality.score * 100));
+        }
+        else
+        {
+            dbprintf("Replay %u: failed to find the ping.\n", replay_sequence);
+        }
+        return success;
+    }
+
+    dbprintf("Correlation results: %d %d %d\n", job.result.channel_delay_ns[0], job.result.channel_delay_ns[1], job.result.channel_delay_ns[2]);
+
+    /*
+     * The ping time is relative to the start of the replayed capture.
+     */
+    const tick_t ping_tick = samples_to_ticks(job.start_index, sampling_frequency);
+    AbortIfNot(send_result(result_socket,
+                           0,
+                           replay_sequence,
+                           ping_tick,
+                           NULL,
+                           NULL,
+                           &job.result,
+                           NULL,
+                           0,
+                           job.filter_duration,
+                           job.correlation_duration,
+                           NULL), fail);
+    AbortIfNot(flush_results(), fail);
+    if (xcorr_stream)
+    {
+        AbortIfNot(publish_xcorr(correlations, job.num_correlations, false), fail);
+    }
+    AbortIfNot(publish_data(&replay.buffer[job.start_index],
+                            job.end_index - job.start_index,
+                            false), fail);
+
+    return success;
+}
+
+/**
+ * Applies the coalescing of the DMA completion interrupts when its
+ * parameters change. Parameters the engine rejects are reverted to those it
+ * runs with.
+ *
+ * @return None.
+ */
+void apply_dma_coalescing()
+{
+    if (dma.irq_threshold == params.dma_irq_threshold && dma.irq_delay_us == params.dma_irq_delay_us)
+    {
+        return;
+    }
+
+    if (!set_dma_interrupt_coalescing(&dma, params.dma_irq_threshold, params.dma_irq_delay_us))
+    {
+        dblog(LOG_WARN, "DMA interrupts cannot coalesce %u completions with a %u us delay.\n",
+                params.dma_irq_threshold, params.dma_irq_delay_us);
+        params.dma_irq_threshold = dma.irq_threshold;
+        params.dma_irq_delay_us = dma.irq_delay_us;
+        return;
+    }
+
+    dbprintf("DMA interrupts coalesce %u completions with a %u us delay\n",
+            dma.irq_threshold, dma.irq_delay_us);
+}
+
+/**
+ * Loads the accelerator module of the parameters into the reconfigurable
+ * region when it changes. A module that does not load is reverted to the one
+ * the region holds.
+ *
+ * @note This runs between captures, since the outputs of the region are
+ *       undefined while it is reconfigured.
+ *
+ * @return None.
+ */
+void apply_accelerator()
+{
+    if (params.accelerator_module == ACCELERATOR_MODULE_NONE ||
+        params.accelerator_module == accelerators.loaded)
+    {
+        return;
+    }
+
+    if (!load_accelerator_module(&accelerators, params.accelerator_module))
+    {
+        dblog(LOG_WARN, "Accelerator module %u could not be loaded.\n", params.accelerator_module);
+        params.accelerator_module = accelerators.loaded;
+        return;
+    }
+
+    dbprintf("Accelerator module %u (%s) loaded in %u us\n",
+            accelerators.loaded,
+            get_accelerator_module(&accelerators, accelerators.loaded)->name,
+            accelerators.last_load_us);
+}
+
+/**
+ * Processes the next window of the synthetic pinger through the same DSP job
+ * as a recorded ping, relays the outcome on the result stream, and adds it to
+ * the totals of the soak run.
+ *
+ * @note Windows are planned by a tracker of the synthetic pings and are only
+ *       generated once they close, so scheduling, tracking, and the DSP keep
+ *       the pace of the synthetic pinger. The latency of a ping is measured
+ *       from when its window is generated.
+ *
+ * @param result_socket The socket to relay the result on.
+ *
+ * @return Success or fail.
+ */
+result_t process_synthetic_ping(udp_socket_t *result_socket)
+{
+    const uint32_t sampling_frequency = get_adc_sampling_frequency(&adc);
+    if (synthetic_restart)
+    {
+        AbortIfNot(init_ping_synth(&ping_synth, &synth_config, get_system_time()), fail);
+        AbortIfNot(init_ping_tracker(&synth_tracker, ms_to_ticks(synth_config.period_ms)), fail);
+        synth_misses = 0;
+        synthetic_restart = false;
+    }
+
+    ping_window_t window;
+    AbortIfNot(plan_ping_window(&synth_tracker, get_system_time(), synth_misses, &window), fail);
+    size_t num_samples = ticks_to_samples(window.duration, sampling_frequency);
+    if (num_samples > capture_samples)
+    {
+        num_samples = capture_samples;
+    }
+
+    const tick_t window_end = window.start_tick + samples_to_ticks(num_samples, sampling_frequency);
+    while (get_system_time() < window_end)
+    {
+        AbortIfNot(run_tasks(&scheduler, TASKS_ALL), fail);
+        wait_for_interrupt();
+    }
+
+    bool contains = false;
+    tick_t true_ping_tick = 0;
+    AbortIfNot(synthesize_ping_window(&ping_synth,
+                                      samples,
+                                      num_samples,
+                                      window.start_tick,
+                                      sampling_frequency,
+                                      (params.ping_frequency)? params.ping_frequency : INITIAL_PING_FREQUENCY_HZ,
+                                      &contains,
+                                      &true_ping_tick), fail);
+    const tick_t generated = get_system_time();
+
+    dsp_job_t job;
+    job.data = samples;
+    job.len = num_samples;
+    job.params = params;
+    job.sampling_frequency = sampling_frequency;
+    job.filter = &capture_filter;
+    job.decimator = prepare_capture_decimator(sampling_frequency);
+    job.fir = prepare_capture_fir(sampling_frequency);
+    job.correlate = true;
+    job.correlations = correlations;
+    job.correlation_len = correlation_len;
+    job.cross_correlations = cross_correlations;
+    job.planar = (planar_dsp)? &planar_samples : NULL;
+    job.planar_input = false;
+    job.measured_stats = NULL;
+    job.average = NULL;
+    job.lag_tracker = NULL;
+    job.bearing_tracker = NULL;
+    job.excluded_channels = 0;
+    job.calibration = &channel_calibration;
+    job.fast_tdoa = false;
+
+    const result_t ret = process_capture(&job);
+    const bool located = (ret == success && job.located && job.accepted)? true : false;
+    if (located)
+    {
+        AbortIfNot(solve_bearing(&hydrophone_array, &job.result), fail);
+        const tick_t ping_tick = window.start_tick + samples_to_ticks(job.start_index, sampling_frequency);
+        AbortIfNot(update_ping_tracker(&synth_tracker, ping_tick), fail);
+        synth_misses = 0;
+
+        AbortIfNot(send_result(result_socket,
+                               0,
+                               ping_synth.pings,
+                               ping_tick,
+                               NULL,
+                               NULL,
+                               &job.result,
+                               NULL,
+                               0,
+                               job.filter_duration,
+                               job.correlation_duration,
+                               NULL), fail);
+        AbortIfNot(flush_results(), fail);
+    }
+    else
+    {
+        synth_misses++;
+    }
+
+    /*
+     * A window the tracker placed between pings has nothing to score, and
+     * the ping it missed is counted as skipped.
+     */
+    if (contains)
+    {
+        AbortIfNot(score_synthetic_ping(&ping_synth,
+                                        ret == success,
+                                        located,
+                                        job.result.channel_delay_ns,
+                                        get_system_time() - generated), fail);
+        const uint32_t scored = ping_synth.located + ping_synth.missed + ping_synth.failed;
+        if (scored % SYNTH_REPORT_PINGS == 0)
+        {
+            const uint32_t delays = 3 * ping_synth.located;
+            dbprintf("Synthetic soak: %u pings in %u s, %u located, %u missed, %u skipped, %u failed, "
+                    "latency mean %u us max %u us, delay error mean %u ns max %u ns\n",
+                    ping_synth.pings,
+                    ticks_to_ms(get_system_time() - ping_synth.start_tick) / 1000,
+                    ping_synth.located,
+                    ping_synth.missed,
+                    ping_synth.skipped,
+                    ping_synth.failed,
+                    (uint32_t)(ping_synth.latency_total_us / scored),
+                    ping_synth.latency_max_us,
+                    (uint32_t)((delays)? ping_synth.delay_error_total_ns / delays : 0),
+                    ping_synth.delay_error_max_ns);
+        }
+    }
+
+    return success;
+}
+
+/**
+ * Resets the DMA engine and configures it for capture.
+ *
+ * @return Success or fail.
+ */
+result_t init_capture_dma()
+{
+    AbortIfNot(initialize_dma(&dma, DMA_BASE_ADDRESS), fail);
+    AbortIfNot(set_dma_length_width(&dma, DMA_LENGTH_WIDTH), fail);
+    AbortIfNot(set_dma_coherency(&dma, DMA_COHERENCY), fail);
+    AbortIfNot(set_dma_uncached_range(&dma, ocm_arena.base, ocm_arena.size), fail);
+    if (DMA_COHERENCY != DMA_COHERENT)
+    {
+        AbortIfNot(set_hp_port_write_qos(DMA_HP_PORT, DMA_HP_WRITE_QOS), fail);
+    }
+
+    /*
+     * If the bitstream includes the scatter-gather engine, capture through a
+     * descriptor ring so the S2MM channel never idles between packets.
+     */
+    if (dma_sg_included(&dma))
+    {
+        AbortIfNot(init_dma_sg_ring(&dma, dma_descriptors, DMA_SG_DESCRIPTORS), fail);
+    }
+
+    /*
+     * Complete DMA transfers from the S2MM interrupt rather than polling the
+     * status register.
+     */
+    AbortIfNot(enable_dma_interrupts(&dma, DMA_S2MM_IRQ_ID), fail);
+
+    return success;
+}
+
+/**
+ * Reinitializes the hardware after a fault in the main loop without resetting
+ * the processor, so that the parameters and ping tracker are kept.
+ *
+ * @param level The recovery to apply.
+ *
+ * @return Success or fail.
+ */
+result_t recover(const recovery_level_t level)
+{
+    /*
+     * The faulted capture may not stop cleanly, so it is abandoned without
+     * checking the result.
+     */
+    cancel_global_timer_alarm();
+    finish_ping_sends();
+    if (ping_schedule.armed && ping_schedule.started)
+    {
+        abort_capture(&ping_capture);
+    }
+    ping_schedule.armed = false;
+    ping_schedule.started = false;
+    stop_continuous_capture(&continuous_capture);
+
+    /*
+     * A job still on the DSP core would be mistaken for the next one.
+     */
+    if (dsp_job_pending)
+    {
+        dsp_job_t *job;
+        const tick_t start_time = get_system_time();
+        while (!receive_dsp_job(&job))
+        {
+            AbortIf(get_system_time() - start_time > ms_to_ticks(RECOVERY_DSP_TIMEOUT_MS), fail);
+        }
+        dsp_job_pending = false;
+    }
+
+    AbortIfNot(init_capture_dma(), fail);
+
+    /*
+     * A fault during sync may leave the stream narrowed to the reference
+     * channel.
+     */
+    AbortIfNot(set_adc_channel_mask(&adc, ADC_ALL_CHANNELS), fail);
+
+    /*
+     * Resetting the ADC clears the decimation settings of the stream.
+     */
+    if (level >= RECOVER_ADC)
+    {
+        const uint32_t decimation_control = adc.regs->decimation_control;
+        encode_clock_t *clock = adc.encode_clock;
+        AbortIfNot(init_spi(&adc_spi, SPI_BASE_ADDRESS, true), fail);
+        AbortIfNot(init_adc(&adc, &adc_spi, ADC_BASE_ADDRESS, false, false), fail);
+        adc.regs->decimation_control = decimation_control;
+        adc.encode_clock = clock;
+    }
+
+    /*
+     * Drop the TCP clients, which reconnect, and reconnect the UDP streams.
+     */
+    if (level >= RECOVER_NETWORK)
+    {
+        AbortIfNot(close_tcp(&capture_stream_socket), fail);
+        AbortIfNot(close_tcp(&replay.socket), fail);
+
+        struct ip_addr dest_ip;
+        IP4_ADDR(&dest_ip, 192, 168, 0, 2);
+        AbortIfNot(connect_udp(&telemetry_socket, &dest_ip, TELEMETRY_PORT), fail);
+        AbortIfNot(connect_udp(&silent_request_socket, &dest_ip, SILENT_REQUEST_PORT), fail);
+        stream_destination_stale = true;
+    }
+
+    /*
+     * Discard the first packet, as at boot, and continue from the tracked
+     * ping rather than syncing again.
+     */
+    AbortIfNot(record(&dma, samples, params.samples_per_packet, adc), fail);
+    sync = (ping_tracker.locked)? true : false;
+    capture_misses = 0;
+
+    return success;
+}
+
+/**
+ * Attempts to recover from a fault in the main loop. Faults that recur within
+ * RECOVERY_WINDOW_MS escalate to a more thorough recovery.
+ *
+ * @return True if the main loop can continue, or false if the processor must
+ *         be reset.
+ */
+bool warm_restart()
+{
+    if (!booted)
+    {
+        return false;
+    }
+
+    const tick_t now = get_system_time();
+    if (warm_restarts && now - last_fault_tick < ms_to_ticks(RECOVERY_WINDOW_MS))
+    {
+        recovery_level++;
+    }
+    else
+    {
+        recovery_level = RECOVER_DMA;
+    }
+    last_fault_tick = now;
+
+    /*
+     * A recovery that fails escalates immediately.
+     */
+    while (recovery_level < RECOVER_RESET)
+    {
+        warm_restarts++;
+        dbprintf("Warm restart %u: recovering %s\n",
+                warm_restarts, recovery_level_names[recovery_level]);
+
+        if (recover(recovery_level) == success)
+        {
+            dbprintf("Recovered in %u us\n",
+                    (uint32_t)ticks_to_micros(get_system_time() - now));
+            return true;
+        }
+
+        recovery_level++;
+    }
+
+    return false;
+}
+
+/**
+ * Initializes the system, the network stack, the capture hardware, and the
+ * operating parameters.
+ *
+ * @return Success or fail.
+ */
+result_t boot()
+{
+    /*
+     * Initialize the system.
+     */
+    AbortIfNot(init_system(), fail);
+    init_profiler();
+    AbortIfNot(init_cycle_counter(), fail);
+    AbortIfNot(init_capture_arena(&capture_arena), fail);
+    if (OCM_TRIGGER_WINDOW)
+    {
+        AbortIfNot(init_ocm_capture_arena(&ocm_arena), fail);
+    }
+
+    /*
+     * Keep the DSP and network hot paths resident in the L2 cache while
+     * captures stream through it.
+     */
+    AbortIfNot(lock_hot_section(), fail);
+    mark_boot_step("system");
+
+    dbprintf("Beginning HydroZynq main application\n");
+
+    /*
+     * Initialize the network stack with the specified IP address.
+     */
+    struct ip_addr our_ip, netmask, gateway;
+    IP4_ADDR(&our_ip, 192, 168, 0, 7);
+    IP4_ADDR(&netmask, 255, 255, 255, 0);
+    IP4_ADDR(&gateway, 192, 168, 1, 1);
+
+    macaddr_t mac_address = {
+        .addr = {0x00, 0x0a, 0x35, 0x00, 0x01, 0x02}
+    };
+
+    AbortIfNot(init_network_stack(our_ip, netmask, gateway, mac_address), fail);
+    AbortIfNot(dbinit(), fail);
+    mark_boot_step("network");
+    dbprintf("Network stack initialized\n");
+
+    /*
+     * Initialize the DMA engine for reading samples.
+     */
+    AbortIfNot(init_capture_dma(), fail);
+    if (dma.ring.descriptors)
+    {
+        dbprintf("DMA scatter-gather ring enabled\n");
+    }
+
+    /*
+     * Drain console output from the UART interrupt so that printing never
+     * stalls acquisition.
+     */
+    AbortIfNot(enable_uart_interrupts(), fail);
+
+    /*
+     * Scheduled ping captures are started from the global timer comparator.
+     */
+    AbortIfNot(enable_global_timer_interrupts(), fail);
+
+    /*
+     * Bound how long the core sleeps while it waits for an interrupt.
+     */
+    AbortIfNot(enable_idle_wakeup(), fail);
+
+    /*
+     * Ping windows are copied by the processor if the DMA controller cannot
+     * be started.
+     */
+    if (!init_copy_engine(&copy_engine))
+    {
+        dbprintf("Copy engine failed to start.\n");
+    }
+    report_capture_port();
+    mark_boot_step("dma");
+
+    /*
+     * Configure the ADC.
+     */
+    AbortIfNot(init_spi(&adc_spi, SPI_BASE_ADDRESS, (FAST_BOOT)? false : true), fail);
+
+    bool verify_write = false;
+    bool use_test_pattern = false;
+    AbortIfNot(init_adc(&adc, &adc_spi, ADC_BASE_ADDRESS, verify_write, use_test_pattern), fail);
+    mark_boot_step("adc");
+
+    /*
+     * Set the initial sample rate, which is divided from the reconfigurable
+     * encode clock reference.
+     */
+    AbortIfNot(init_encode_clock(&encode_clock, ENCODE_CLOCK_BASE_ADDRESS), fail);
+    adc.encode_clock = &encode_clock;
+    AbortIfNot(set_adc_sampling_frequency(&adc, INITIAL_SAMPLING_FREQUENCY_HZ), fail);
+    dbprintf("ADC sampling frequency: %d Hz (reference %d Hz, clock div %d)\n",
+            get_adc_sampling_frequency(&adc), encode_clock.frequency, adc.regs->clk_div);
+    dbprintf("ADC samples per packet: %d\n", adc.regs->samples_per_packet);
+
+    /*
+     * Embed hardware sample timestamps in the stream so ping times do not
+     * depend on when software started the DMA.
+     */
+    AbortIfNot(allocate_capture_buffers(get_adc_sampling_frequency(&adc),
+                                        adc.regs->samples_per_packet), fail);
+    adc.regs->stream_control = ADC_STREAM_TIMESTAMPS;
+
+    /*
+     * Bind the command port, data stream port, and the result output port.
+     */
+    struct ip_addr dest_ip;
+    IP4_ADDR(&dest_ip, 192, 168, 0, 2);
+    stream_destination = dest_ip;
+
+    AbortIfNot(init_spsc_queue(&command_queue,
+                               command_storage,
+                               sizeof(command_t),
+                               COMMAND_QUEUE_DEPTH), fail);
+
+    AbortIfNot(init_udp(&command_socket), fail);
+    AbortIfNot(bind_udp(&command_socket, IP_ADDR_ANY, COMMAND_SOCKET_PORT, receive_command), fail);
+
+    AbortIfNot(init_xsystem_monitor(&system_monitor, XADC_BASE_ADDRESS), fail);
+
+    AbortIfNot(init_udp(&telemetry_socket), fail);
+    AbortIfNot(connect_udp(&telemetry_socket, &dest_ip, TELEMETRY_PORT), fail);
+
+    AbortIfNot(init_udp(&silent_request_socket), fail);
+    AbortIfNot(connect_udp(&silent_request_socket, &dest_ip, SILENT_REQUEST_PORT), fail);
+
+    AbortIfNot(init_stream_subscriptions(&stream_subscriptions), fail);
+    subscribed_destination = stream_destination;
+    AbortIfNot(subscribe_stream(&stream_subscriptions,
+                                SUBSCRIBED_DATA,
+                                &stream_destination,
+                                DATA_STREAM_PORT,
+                                1,
+                                0), fail);
+    AbortIfNot(subscribe_stream(&stream_subscriptions,
+                                SUBSCRIBED_XCORR,
+                                &stream_destination,
+                                XCORR_STREAM_PORT,
+                                1,
+                                0), fail);
+
+    AbortIfNot(init_udp(&result_socket), fail);
+    AbortIfNot(connect_udp(&result_socket, &stream_destination, RESULT_PORT), fail);
+
+    AbortIfNot(init_udp(&preview_socket), fail);
+    AbortIfNot(connect_udp(&preview_socket, &stream_destination, PREVIEW_PORT), fail);
+
+    AbortIfNot(init_udp(&record_socket), fail);
+    AbortIfNot(connect_udp(&record_socket, &stream_destination, RECORD_PORT), fail);
+
+    AbortIfNot(init_udp(&survey_socket), fail);
+    AbortIfNot(connect_udp(&survey_socket, &stream_destination, SURVEY_PORT), fail);
+
+    /*
+     * Resolve the destinations now so that the first burst is not held
+     * behind ARP.
+     */
+    AbortIfNot(add_arp_destination(&dest_ip), fail);
+    AbortIfNot(add_arp_destination(&stream_destination), fail);
+
+    AbortIfNot(init_tcp(&capture_stream_socket), fail);
+    AbortIfNot(listen_tcp(&capture_stream_socket, CAPTURE_STREAM_PORT), fail);
+
+    AbortIfNot(init_replay(&replay, REPLAY_PORT), fail);
+
+    AbortIfNot(init_board_sync(&board_sync, &adc, BOARD_SYNC_PORT), fail);
+
+    AbortIfNot(init_accelerators(&accelerators), fail);
+    AbortIfNot(init_bulk_upload(&bulk_upload, UPLOAD_PORT), fail);
+    AbortIfNot(register_upload_targets(), fail);
+    mark_boot_step("sockets");
+
+    /*
+     * The USB stream is only used on the bench, so the board runs without it.
+     */
+    if (!init_usb_stream(&usb_stream))
+    {
+        dbprintf("USB device failed to start.\n");
+    }
+    mark_boot_step("usb");
+
+    AbortIfNot(apply_transmit_rate(), fail);
+    set_transmit_idle(service_transmit_idle, NULL);
+
+    /*
+     * Background tasks run between the stages of the main loop, acquisition
+     * first and logging last.
+     */
+    set_stream_job_callbacks(&data_stream_job, NULL, ping_send_complete, "samples");
+    set_stream_job_callbacks(&xcorr_stream_job, NULL, ping_send_complete, "correlations");
+
+    AbortIfNot(init_scheduler(&scheduler), fail);
+    AbortIfNot(add_task(&scheduler, "ping schedule", TASK_ACQUISITION, 0,
+                        ping_schedule_task, &ping_schedule), fail);
+    AbortIfNot(add_task(&scheduler, "continuous capture", TASK_ACQUISITION, 0,
+                        continuous_capture_task, &continuous_capture), fail);
+    AbortIfNot(add_task(&scheduler, "board sync", TASK_ACQUISITION, 0, board_sync_task, NULL), fail);
+    AbortIfNot(add_task(&scheduler, "dsp help", TASK_DSP, 0, dsp_help_task, NULL), fail);
+    AbortIfNot(add_task(&scheduler, "network", TASK_RESULT_TX, 0, network_task, NULL), fail);
+    AbortIfNot(add_task(&scheduler, "result retries", TASK_RESULT_TX, 0, result_retry_task, NULL), fail);
+    AbortIfNot(add_task(&scheduler, "recording", TASK_DEBUG_TX, 0, recording_task, NULL), fail);
+    AbortIfNot(add_task(&scheduler, "ping sends", TASK_DEBUG_TX, 0, ping_send_task, NULL), fail);
+    AbortIfNot(add_task(&scheduler, "sd recorder", TASK_DEBUG_TX, 0, sd_record_task, NULL), fail);
+    AbortIfNot(add_task(&scheduler, "telemetry", TASK_DEBUG_TX, ms_to_ticks(TELEMETRY_PERIOD_MS),
+                        telemetry_task, NULL), fail);
+    AbortIfNot(add_task(&scheduler, "network link", TASK_DEBUG_TX, ms_to_ticks(NETWORK_LINK_POLL_MS),
+                        network_link_task, NULL), fail);
+    AbortIfNot(add_task(&scheduler, "log", TASK_LOGGING, 0, log_task, NULL), fail);
+
+    /*
+     * Release the second core to process captures, or to own the network
+     * stack. Either stays on this core if it does not start.
+     */
+    if (NETWORK_CORE)
+    {
+        if (!start_network_core())
+        {
+            dbprintf("Network core failed to start. Networking on CPU0.\n");
+        }
+        mark_boot_step("network core");
+    }
+    else
+    {
+        if (!start_dsp_core())
+        {
+            dbprintf("DSP core failed to start. Processing on CPU0.\n");
+        }
+        mark_boot_step("dsp core");
+    }
+
+    dbprintf("System initialization complete. Start time: %d ms\n",
+            ticks_to_ms(get_system_time()));
+
+    set_interrupt_nesting(IRQ_NESTING);
+    set_interrupts(true);
+
+    /*
+     * Read the first sample from the ADC and ignore it - the ADC always has an
+     * invalid measurement as the first reading.
+     */
+    AbortIfNot(record(&dma, samples, adc.regs->samples_per_packet, adc), fail);
+    mark_boot_step("first packet");
+
+    if (!FAST_BOOT)
+    {
+        test_adc_datapath();
+        mark_boot_step("adc self test");
+    }
+
+    /*
+     * Set up the initial parameters.
+     */
+    params.sampling_frequency = INITIAL_SAMPLING_FREQUENCY_HZ;
+    params.samples_per_packet = adc.regs->samples_per_packet;
+    params.ping_threshold = INITIAL_ADC_THRESHOLD;
+    params.ping_frequency = INITIAL_PING_FREQUENCY_HZ;
+
+    /*
+     * Perform a correlation for two wavelengths after the threshold is
+     * encountered. Before the threshold will be either the initial wavefronts
+     * or white noise floor. Because the noise floor is small, it will not
+     * affect the correlation.
+     */
+    params.pre_ping_duration = micros_to_ticks(100);
+    params.post_ping_duration = micros_to_ticks(50);
+    params.filter = false;
+    params.hw_trigger = false;
+    params.hw_correlate = false;
+    params.hw_envelope = false;
+    params.reference_channel = 0;
+    AbortIfNot(init_hydrophone_array(&hydrophone_array, HYDROPHONE_SPACING_METERS), fail);
+    params.all_pairs = false;
+    params.phat = false;
+    params.envelope_onset = false;
+    params.average_pings = 0;
+    params.average_exponential = false;
+    params.fast_tdoa_interval = 0;
+    params.coarse_search = false;
+    params.track_lags = false;
+    params.trigger_any_channel = false;
+    params.window_normalize = false;
+    params.lazy_filter = false;
+    params.dual_rate = true;
+    params.masked_sync = false;
+    params.continuous_capture = false;
+    params.dma_irq_threshold = DMA_IRQ_THRESHOLD;
+    params.dma_irq_delay_us = DMA_IRQ_DELAY_US;
+    params.accelerator_module = ACCELERATOR_MODULE_NONE;
+    params.noise_threshold = 0;
+    params.cfar_threshold = 0;
+    params.matched_threshold = 0;
+    params.dsp_decimation = 0;
+    AbortIfNot(init_matched_filter(&matched_filter,
+                                   matched_template,
+                                   MATCHED_TEMPLATE_MAX,
+                                   matched_spectrum,
+                                   matched_work,
+                                   matched_input,
+                                   MATCHED_FILTER_FFT_LEN(MATCHED_TEMPLATE_MAX)), fail);
+    AbortIfNot(init_fir_filter(&capture_fir,
+                               capture_fir_spectrum,
+                               capture_fir_work,
+                               capture_fir_history,
+                               FIR_FILTER_MAX_TAPS,
+                               FIR_FILTER_FFT_LEN(FIR_FILTER_MAX_TAPS)), fail);
+    params.min_ping_quality = 0;
+    params.num_pingers = 0;
+
+    /*
+     * Replace the defaults with the parameters saved before the last reboot.
+     * The packet length and sampling frequency are changed through the main
+     * loop.
+     */
+    bool params_found = false;
+    if (init_param_store(&param_store) &&
+        load_params(&param_store, &params, &params_found))
+    {
+        if (params_found)
+        {
+            dbprintf("Loaded parameters from record %u\n", param_store.sequence);
+            if (params.samples_per_packet != adc.regs->samples_per_packet)
+            {
+                requested_samples_per_packet = params.samples_per_packet;
+            }
+            if (params.sampling_frequency != INITIAL_SAMPLING_FREQUENCY_HZ &&
+                params.sampling_frequency >= ADC_MIN_SAMPLING_FREQUENCY &&
+                params.sampling_frequency <= ADC_MAX_SAMPLING_FREQUENCY)
+            {
+                requested_sampling_frequency = params.sampling_frequency;
+            }
+            params.samples_per_packet = adc.regs->samples_per_packet;
+            params.sampling_frequency = INITIAL_SAMPLING_FREQUENCY_HZ;
+        }
+
+        if (load_profiles(&param_store) && param_store.num_profiles)
+        {
+            dbprintf("Loaded %u processing profiles\n", param_store.num_profiles);
+        }
+    }
+    else
+    {
+        dbprintf("Parameter store unavailable. Using defaults.\n");
+    }
+    mark_boot_step("params");
+
+    AbortIfNot(init_ping_tracker(&ping_tracker, ms_to_ticks(PING_PERIOD_MS)), fail);
+
+    synth_config.period_ms = PING_PERIOD_MS;
+    synth_config.amplitude = SYNTH_AMPLITUDE;
+    synth_config.noise_amplitude = SYNTH_NOISE_AMPLITUDE;
+    synthetic_restart = true;
+    AbortIfNot(init_lag_tracker(&lag_tracker), fail);
+    AbortIfNot(init_load_governor(&load_governor), fail);
+    AbortIfNot(init_bearing_tracker(&bearing_tracker), fail);
+    AbortIfNot(init_channel_health(&channel_health), fail);
+    init_channel_calibration(&channel_calibration);
+    AbortIfNot(init_calibration_run(&calibration_run), fail);
+    AbortIfNot(set_capture_filter(highpass_iir, sizeof(highpass_iir) / sizeof(highpass_iir[0])), fail);
+
+    /*
+     * The watchdog is started last so that a slow boot is not mistaken for a
+     * hang.
+     */
+    AbortIfNot(init_watchdog(&watchdog, SCU_WATCHDOG_BASE_ADDRESS, WATCHDOG_TIMEOUT_MS), fail);
+    if (watchdog.caused_reset)
+    {
+        dblog(LOG_WARN, "The last reset was caused by the watchdog.\n");
+    }
+    mark_boot_step("watchdog");
+
+    return success;
+}
+
+/**
+ * Application process. Each iteration captures, processes and sends one ping
+ * as a blocking foreground sequence, and the background services run from
+ * the scheduler at its waits and stage boundaries.
+ *
+ * @note The processor is initialized by the first call. Later calls follow a
+ *       warm restart and continue with the parameters and ping tracker of the
+ *       previous call.
+ *
+ * @return Success or fail.
+ */
+result_t go()
+{
+    if (!booted)
+    {
+        AbortIfNot(boot(), fail);
+        booted = true;
+    }
+
+    tick_t previous_ping_tick = get_system_time();
+    uint64_t previous_ping_sample = 0;
+
+    /*
+     * The handle of the ping that the loop is working on. Contexts that were
+     * held when the loop was last left are abandoned with it.
+     */
+    init_ping_context_pool(&ping_contexts);
+    ping_handle_t ping = PING_HANDLE_NONE;
+    while (1)
+    {
+        const uint32_t sampling_frequency = get_adc_sampling_frequency(&adc);
+
+        /*
+         * The ping of the previous iteration has left the loop.
+         */
+        release_ping_context(&ping_contexts, ping);
+        ping = PING_HANDLE_NONE;
+
+        /*
+         * Check the stages of the previous iteration. A stage that keeps
+         * overrunning is reported before the loop is restarted.
+         */
+        kick_watchdog(&watchdog);
+        if (!check_deadlines(&watchdog, DEADLINE_MAX_CONSECUTIVE_OVERRUNS))
+        {
+            report_telemetry();
+            return fail;
+        }
+
+        /*
+         * Run the background tasks, which push received network traffic into
+         * the network stack, before the commands it carried are applied.
+         */
+        AbortIfNot(run_tasks(&scheduler, TASKS_ALL), fail);
+        apply_pending_commands();
+
+        /*
+         * A failure to save the parameters does not affect acquisition, so it
+         * is only reported.
+         */
+        if (!service_param_store(&param_store, &params, false))
+        {
+            dbprintf("Failed to save parameters.\n");
+        }
+
+        apply_dma_coalescing();
+        apply_accelerator();
+
+        /*
+         * Resize the ADC packets or change the stream rate between captures.
+         * Sync is lost because the capture buffers are reallocated, and the
+         * lag ranges and capture lengths follow the new rate.
+         */
+        if (requested_samples_per_packet || requested_decimation || requested_sampling_frequency ||
+            packed_samples_stale)
+        {
+            AbortIfNot(cancel_ping_schedule(&ping_schedule), fail);
+            AbortIfNot(reconfigure_stream((requested_samples_per_packet)?
+                                                  requested_samples_per_packet :
+                                                  params.samples_per_packet,
+                                          (requested_decimation)?
+                                                  requested_decimation :
+                                                  get_adc_decimation(&adc),
+                                          (requested_sampling_frequency)?
+                                                  requested_sampling_frequency :
+                                                  params.sampling_frequency,
+                                          packed_samples), fail);
+            requested_samples_per_packet = 0;
+            requested_decimation = 0;
+            requested_sampling_frequency = 0;
+            packed_samples_stale = false;
+            sync = false;
+            continue;
+        }
+
+        /*
+         * Point the streams at a new destination. Multicast groups need no
+         * membership to be sent to, so consumers subscribe on their own.
+         */
+        if (stream_destination_stale)
+        {
+            follow_stream_destination();
+            AbortIfNot(connect_udp(&result_socket, &stream_destination, RESULT_PORT), fail);
+            AbortIfNot(connect_udp(&preview_socket, &stream_destination, PREVIEW_PORT), fail);
+            AbortIfNot(connect_udp(&record_socket, &stream_destination, RECORD_PORT), fail);
+            AbortIfNot(connect_udp(&survey_socket, &stream_destination, SURVEY_PORT), fail);
+            if (!add_arp_destination(&stream_destination))
+            {
+                dblog(LOG_WARN, "Too many destinations to keep resolved.\n");
+            }
+            stream_destination_stale = false;
+        }
+
+        /*
+         * Stream continuous captures instead of locating pings while a TCP
+         * client is connected and streaming is enabled.
+         */
+        if (tcp_stream && tcp_connected(&capture_stream_socket) && dma.ring.descriptors)
+        {
+            AbortIfNot(cancel_ping_schedule(&ping_schedule), fail);
+            AbortIfNot(stop_continuous_capture(&continuous_capture), fail);
+            AbortIfNot(finish_ping_sends(), fail);
+            AbortIfNot(stream_captures_tcp(), fail);
+            sync = false;
+            continue;
+        }
+
+        /*
+         * Process recorded captures from the replay client instead of the ADC
+         * while replay is enabled.
+         */
+        if (replay_mode)
+        {
+            AbortIfNot(cancel_ping_schedule(&ping_schedule), fail);
+            AbortIfNot(stop_continuous_capture(&continuous_capture), fail);
+            AbortIfNot(finish_ping_sends(), fail);
+            AbortIfNot(arm_replay(&replay, samples, capture_samples), fail);
+            if (replay_ready(&replay))
+            {
+                AbortIfNot(process_replay(&result_socket), fail);
+            }
+            sync = false;
+            continue;
+        }
+        disarm_replay(&replay);
+
+        /*
+         * Process synthetic pings instead of the ADC while they are enabled.
+         */
+        if (synthetic_mode)
+        {
+            AbortIfNot(cancel_ping_schedule(&ping_schedule), fail);
+            AbortIfNot(stop_continuous_capture(&continuous_capture), fail);
+            AbortIfNot(finish_ping_sends(), fail);
+            AbortIfNot(process_synthetic_ping(&result_socket), fail);
+            sync = false;
+            continue;
+        }
+
+        /*
+         * Survey the spectra of the channels instead of locating pings while
+         * a survey is pending.
+         */
+        if (requested_survey_ms)
+        {
+            AbortIfNot(cancel_ping_schedule(&ping_schedule), fail);
+            AbortIfNot(stop_continuous_capture(&continuous_capture), fail);
+            AbortIfNot(finish_ping_sends(), fail);
+            AbortIfNot(run_survey(), fail);
+            sync = false;
+            continue;
+        }
 
-    /*
-     * Configure the ADC.
-     */
-    AbortIfNot(init_spi(&adc_spi, SPI_BASE_ADDRESS), fail);
+        /*
+         * Raw debug captures skip processing entirely, so they are sent in
+         * place rather than through a DSP job.
+         */
+        if (raw_debug_stream && dma.ring.descriptors)
+        {
+            AbortIfNot(cancel_ping_schedule(&ping_schedule), fail);
+            AbortIfNot(stop_continuous_capture(&continuous_capture), fail);
+            AbortIfNot(finish_ping_sends(), fail);
+            AbortIfNot(stream_raw_capture(), fail);
+            sync = false;
+            continue;
+        }
 
-    bool verify_write = false;
-    bool use_test_pattern = false;
-    AbortIfNot(init_adc(&adc, &adc_spi, ADC_BASE_ADDRESS, verify_write, use_test_pattern), fail);
+        /*
+         * Capture and processing are overlapped when the descriptor ring is
+         * available. Debug captures span the entire sample array and are
+         * always taken synchronously.
+         */
+        const bool pipelined = (dma.ring.descriptors && !debug_stream && !trigger_gate)? true : false;
 
-    /*
-     * Set the sample rate to 5MHz.
-     */
-    adc.regs->clk_div = 10;
-    dbprintf("ADC clock div: %d\n", adc.regs->clk_div);
-    dbprintf("ADC samples per packet: %d\n", adc.regs->samples_per_packet);
+        /*
+         * In continuous mode the ring is recorded into at all times and each
+         * ping is cut from its history, so nothing is scheduled.
+         */
+        const bool continuous = (params.continuous_capture && pipelined && !params.hw_trigger)? true : false;
 
-    /*
-     * Bind the command port, data stream port, and the result output port.
-     */
-    udp_socket_t command_socket, data_stream_socket, result_socket, xcorr_stream_socket, silent_request_socket;
+        /*
+         * Drop a scheduled capture if sync was lost or the mode changed.
+         */
+        if (ping_schedule.armed && (!sync || !pipelined || continuous))
+        {
+            AbortIfNot(cancel_ping_schedule(&ping_schedule), fail);
+        }
 
-    struct ip_addr dest_ip;
-    IP4_ADDR(&dest_ip, 192, 168, 0, 2);
+        /*
+         * Restart the continuous capture when sync is lost, so that its
+         * detector follows the new parameters, and stop it with its mode.
+         */
+        if (continuous_capture.capture.active && (!sync || !continuous))
+        {
+            AbortIfNot(stop_continuous_capture(&continuous_capture), fail);
+        }
 
-    AbortIfNot(init_udp(&command_socket), fail);
-    AbortIfNot(bind_udp(&command_socket, IP_ADDR_ANY, COMMAND_SOCKET_PORT, receive_command), fail);
+        /*
+         * Only a capture scheduled into the other half of the sample array
+         * may overlap the sends of the previous ping.
+         */
+        if (!ping_schedule.armed)
+        {
+            AbortIfNot(finish_ping_sends(), fail);
+        }
 
-    AbortIfNot(init_udp(&silent_request_socket), fail);
-    AbortIfNot(connect_udp(&silent_request_socket, &dest_ip, SILENT_REQUEST_PORT), fail);
+        /*
+         * When the FPGA correlates the triggered window, every ping is taken
+         * by the trigger and only its correlations are read back.
+         */
+        if (params.hw_trigger && params.hw_correlate && dma.ring.descriptors && !debug_stream && !trigger_gate)
+        {
+            AbortIfNot(cancel_ping_schedule(&ping_schedule), fail);
+            AbortIfNot(acquire_ping_context(&ping_contexts, &ping), fail);
+            ping_context_t *context = get_ping_context(&ping_contexts, ping);
 
-    AbortIfNot(init_udp(&data_stream_socket), fail);
-    AbortIfNot(connect_udp(&data_stream_socket, &dest_ip, DATA_STREAM_PORT), fail);
+            bool found = false;
+            analog_sample_t max_value;
+            ping_stats.sync_attempts++;
+            AbortIfNot(acquire_triggered_sync(&dma,
+                                              trigger_window,
+                                              &previous_ping_tick,
+                                              &found,
+                                              &max_value,
+                                              adc,
+                                              &params,
+                                              &timing), fail);
+            context->stages.capture_complete = get_system_time();
+            report_boot_timeline();
 
-    AbortIfNot(init_udp(&xcorr_stream_socket), fail);
-    AbortIfNot(connect_udp(&xcorr_stream_socket, &dest_ip, XCORR_STREAM_PORT), fail);
+            AbortIfNot(run_tasks(&scheduler, TASKS_ALL), fail);
+            apply_pending_commands();
 
-    AbortIfNot(init_udp(&result_socket), fail);
-    AbortIfNot(connect_udp(&result_socket, &dest_ip, RESULT_PORT), fail);
+            const tick_t correlation_start_time = get_system_time();
+            while (found && !adc_correlator_done(&adc))
+            {
+                if (get_system_time() - correlation_start_time > ms_to_ticks(HW_CORRELATION_TIMEOUT_MS))
+                {
+                    dbprintf("Hardware correlation timed out.\n");
+                    found = false;
+                }
+            }
 
-    dbprintf("System initialization complete. Start time: %d ms\n",
-            ticks_to_ms(get_system_time()));
+            if (!found)
+            {
+                ping_stats.pings_missed++;
+                dbprintf("Failed to find the triggered ping - MaxVal: %d\n", max_value);
+                continue;
+            }
 
-    set_interrupts(true);
+            /*
+             * The trigger window spans one packet on either side of the
+             * crossing.
+             */
+            context->samples = trigger_window;
+            context->num_samples = adc.regs->samples_per_packet * 2;
+            context->sampling_frequency = sampling_frequency;
+            context->start_index = 0;
+            context->end_index = context->num_samples;
+            context->ping_tick = previous_ping_tick;
 
-    /*
-     * Read the first sample from the ADC and ignore it - the ADC always has an
-     * invalid measurement as the first reading.
-     */
-    AbortIfNot(record(&dma, samples, adc.regs->samples_per_packet, adc), fail);
+            const size_t correlated_len = (context->num_samples > ADC_CORRELATOR_MAX_WINDOW)?
+                    ADC_CORRELATOR_MAX_WINDOW : context->num_samples;
+            dsp_job_t *job = &context->job;
+            job->correlations = correlations;
+            job->correlation_len = correlation_len;
+            AbortIfNot(read_adc_correlations(&adc,
+                                             context->num_samples,
+                                             job->correlations,
+                                             job->correlation_len,
+                                             &job->num_correlations), fail);
+            context->stages.window_located = get_system_time();
 
-    /*
-     * Set up the initial parameters.
-     */
-    params.sample_clk_div = adc.regs->clk_div;
-    params.samples_per_packet = adc.regs->samples_per_packet;
-    params.ping_threshold = INITIAL_ADC_THRESHOLD;
+            channel_view_t view;
+            interleaved_view(trigger_window, correlated_len, &view);
+            AbortIfNot(evaluate_correlations(&view,
+                                             job->correlations,
+                                             job->num_correlations,
+                                             active_calibration(),
+                                             &job->result,
+                                             sampling_frequency), fail);
+            context->stages.processed = get_system_time();
+            AbortIfNot(record_calibration_ping(&job->result), fail);
+            context->result = job->result;
+            AbortIfNot(solve_bearing(&hydrophone_array, &context->result), fail);
+            job->correlation_duration = get_system_time() - correlation_start_time;
+            AbortIfNot(read_trigger_mark(&ping_stats.trigger), fail);
 
-    /*
-     * Perform a correlation for two wavelengths after the threshold is
-     * encountered. Before the threshold will be either the initial wavefronts
-     * or white noise floor. Because the noise floor is small, it will not
-     * affect the correlation.
-     */
-    params.pre_ping_duration = micros_to_ticks(100);
-    params.post_ping_duration = micros_to_ticks(50);
-    params.filter = false;
+            context->sequence = ++ping_sequence;
+            ping_stats.pings_found++;
+            AbortIfNot(update_ping_tracker(&ping_tracker, context->ping_tick), fail);
+            dbprintf("Correlation results: %d %d %d\n",
+                    context->result.channel_delay_ns[0],
+                    context->result.channel_delay_ns[1],
+                    context->result.channel_delay_ns[2]);
 
-    tick_t previous_ping_tick = get_system_time();
-    while (1)
-    {
-        const uint32_t sampling_frequency = FPGA_CLK / (params.sample_clk_div * 2);
+            AbortIfNot(update_bearing_tracker(&bearing_tracker,
+                                              &hydrophone_array,
+                                              context->ping_tick,
+                                              &context->result,
+                                              &context->track), fail);
+            context->stages.solved = get_system_time();
 
-        /*
-         * Push received network traffic into the network stack.
-         */
-        dispatch_network_stack();
+            AbortIfNot(send_result(&result_socket,
+                                   0,
+                                   context->sequence,
+                                   context->ping_tick,
+                                   &ping_stats.trigger,
+                                   &context->track,
+                                   &context->result,
+                                   NULL,
+                                   0,
+                                   0,
+                                   job->correlation_duration,
+                                   &context->stages), fail);
+            AbortIfNot(flush_results(), fail);
+            AbortIfNot(push_ping_history(&ping_history,
+                                         context->sequence,
+                                         context->ping_tick,
+                                         &ping_stats.trigger,
+                                         &context->track,
+                                         &context->result,
+                                         context->samples,
+                                         context->num_samples,
+                                         job->correlations,
+                                         job->num_correlations), fail);
+            trace(TRACE_PING, TRACE_INSTANT, context->sequence, 0);
+            if (xcorr_stream)
+            {
+                AbortIfNot(publish_xcorr(job->correlations, job->num_correlations, false), fail);
+            }
+            if (record_stream)
+            {
+                AbortIfNot(push_record(&record_queue, context->samples,
+                                       (context->num_samples < record_queue.capacity)?
+                                               context->num_samples : record_queue.capacity), fail);
+            }
+            else if (data_stream && !send_usb_samples(context->samples, context->num_samples))
+            {
+                AbortIfNot(publish_data(context->samples, context->num_samples, false), fail);
+            }
+            continue;
+        }
 
         /*
-         * Find sync for the start of a ping if we are not debugging.
+         * Find sync for the start of a ping if we are not debugging. A
+         * follower that holds a window shared by its master captures it
+         * instead, and a gated capture waits for the external trigger.
          */
-        if (!sync && !debug_stream)
+        if (!sync && !continuous && !debug_stream && !trigger_gate && !board_window_pending(&board_sync))
         {
             bool found = false;
             int sync_attempts = 0;
             analog_sample_t max_value;
+            if (params.masked_sync && !params.hw_envelope && !params.hw_trigger)
+            {
+                set_sync_channels(true);
+            }
+
             while (!found && !debug_stream)
             {
-                uint32_t sample_duration_ms = 2100;
-                uint32_t samples_to_take = sample_duration_ms / 1000.0 * sampling_frequency;
-                AbortIfNot(acquire_sync(&dma,
-                                        samples,
-                                        samples_to_take,
-                                        &previous_ping_tick,
-                                        &found,
-                                        &max_value,
-                                        adc,
-                                        sampling_frequency,
-                                        &params,
-                                        highpass_iir,
-                                        5), fail);
+                ping_stats.sync_attempts++;
+                if (params.hw_envelope && dma.ring.descriptors)
+                {
+                    AbortIfNot(acquire_envelope_sync(&dma,
+                                                     samples,
+                                                     &previous_ping_tick,
+                                                     &found,
+                                                     &max_value,
+                                                     adc,
+                                                     &params,
+                                                     &timing), fail);
+                }
+                else if (params.hw_trigger && dma.ring.descriptors)
+                {
+                    AbortIfNot(acquire_triggered_sync(&dma,
+                                                      trigger_window,
+                                                      &previous_ping_tick,
+                                                      &found,
+                                                      &max_value,
+                                                      adc,
+                                                      &params,
+                                                      &timing), fail);
+                }
+                else if (params.dual_rate && dma.ring.descriptors)
+                {
+                    AbortIfNot(acquire_dual_rate_sync(&dma,
+                                                      samples,
+                                                      capture_samples,
+                                                      &previous_ping_tick,
+                                                      &found,
+                                                      &max_value,
+                                                      adc,
+                                                      sampling_frequency,
+                                                      &params,
+                                                      &capture_filter,
+                                                      &matched_filter,
+                                                      &timing), fail);
+                }
+                else
+                {
+                    uint32_t sample_duration_ms = 2100;
+                    uint32_t samples_to_take = sample_duration_ms / 1000.0 * sampling_frequency;
+                    AbortIfNot(acquire_sync(&dma,
+                                            samples,
+                                            samples_to_take,
+                                            &previous_ping_tick,
+                                            &found,
+                                            &max_value,
+                                            adc,
+                                            sampling_frequency,
+                                            &params,
+                                            &capture_filter,
+                                            &matched_filter,
+                                            &timing), fail);
+                }
+
+                report_boot_timeline();
 
                 /*
                  * Dispatch the network stack during sync to ensure messages
-                 * are properly transmitted.
+                 * are properly transmitted. Each attempt is bounded, so sync
+                 * is progress.
                  */
-                dispatch_network_stack();
+                kick_watchdog(&watchdog);
+                AbortIfNot(run_tasks(&scheduler, TASKS_ALL), fail);
+                apply_pending_commands();
 
                 if (!found)
                 {
@@ -402,69 +6614,287 @@ result_t go()
                 }
             }
 
+            set_sync_channels(false);
+
             if (found)
             {
                 dbprintf("Synced: %f s - MaxVal: %d\n", ticks_to_seconds(previous_ping_tick), max_value);
+                AbortIfNot(update_ping_tracker(&ping_tracker, previous_ping_tick), fail);
+                capture_misses = 0;
                 sync = true;
             }
         }
 
         /*
-         * Fast forward the previous ping tick until the most likely time
-         * of the most recent ping.
+         * Record the ping.
          */
-        if (!debug_stream)
+        ping_window_t window;
+        tick_t sample_duration = ms_to_ticks(2100);
+        if (!debug_stream && trigger_gate)
         {
-            tick_t next_ping_tick = previous_ping_tick;
-            while (get_system_time() > (next_ping_tick - ms_to_ticks(50)))
+            bool found = false;
+            AbortIfNot(wait_for_trigger_gate(&window, &found), fail);
+            if (!found)
             {
-                next_ping_tick += ms_to_ticks(2000);
+                dbprintf("No external trigger in %u ms.\n", TRIGGER_GATE_TIMEOUT_MS);
+                continue;
             }
+            sample_duration = window.duration;
+        }
+        else if (!debug_stream && !ping_schedule.armed && !continuous)
+        {
+            AbortIfNot(plan_capture_window(get_system_time(), &window), fail);
+            sample_duration = window.duration;
+        }
 
+        const size_t max_samples = (pipelined)? PING_BUFFER_SAMPLES : capture_samples;
+        size_t num_samples = get_capture_length(sample_duration, sampling_frequency, max_samples);
+
+        sample_t *ping_samples = samples;
+        tick_t sample_end_tick;
+        bool planar_window = false;
+        bool stats_window = false;
+        if (continuous)
+        {
+            bool extracted = false;
+            AbortIfNot(wait_for_continuous_ping(&ping_samples, &num_samples, &sample_end_tick, &extracted), fail);
+            if (!extracted)
+            {
+                continue;
+            }
+        }
+        else if (ping_schedule.armed)
+        {
             /*
-             * Request that thrusters enter shutdown at the next ping tick.
+             * The capture was scheduled while the previous ping was being
+             * processed. Begin it if it has not yet started and wait for it
+             * to complete.
              */
-            AbortIfNot(request_thruster_shutdown(
-                        &silent_request_socket,
-                        (next_ping_tick - ms_to_ticks(50)),
-                        ms_to_ticks(100)), fail);
+            const tick_t now = get_system_time();
+            const tick_t lead = (ping_schedule.start_tick > now)? ping_schedule.start_tick - now : 0;
+            begin_deadline(&watchdog, DEADLINE_CAPTURE, lead +
+                           capture_ticks(ping_schedule.num_samples, sampling_frequency) +
+                           ms_to_ticks(DEADLINE_CAPTURE_SLACK_MS));
+            while (!ping_schedule.started)
+            {
+                AbortIfNot(run_tasks(&scheduler, TASKS_ALL), fail);
+                if (!ping_schedule.started)
+                {
+                    wait_for_interrupt();
+                }
+            }
 
+            result_t ret = wait_for_capture(&ping_capture);
+            ping_schedule.armed = false;
+            end_transmit_quiet();
+            end_deadline(&watchdog, DEADLINE_CAPTURE);
+            AbortIfNot(ret, fail);
+
+            ping_samples = ping_schedule.buffer;
+            num_samples = ping_schedule.num_samples;
+            sample_end_tick = ping_capture.last_progress;
+        }
+        else
+        {
             /*
-             * Wait until the ping is about to come (100ms before).
+             * Capture the window planned around the next predicted ping. The
+             * stream is switched to planar packets before the window opens,
+             * so that the packet discarded after the change is not taken from
+             * the window.
              */
-            while (get_system_time() < (next_ping_tick - ms_to_ticks(50)));
+            planar_window = planar_window_usable();
+            stats_window = stats_window_usable(planar_window);
+            AbortIfNot(set_planar_packets(planar_window), fail);
+            AbortIfNot(set_stats_packets(stats_window), fail);
+            if (!debug_stream)
+            {
+                /*
+                 * Request that thrusters enter shutdown for the window.
+                 */
+                if (!request_thruster_shutdown(&silent_request_socket,
+                                               window.start_tick,
+                                               window.silence_duration))
+                {
+                    dblog(LOG_WARN, "Failed to request thruster silence.\n");
+                }
+
+                /*
+                 * Wait until the window opens.
+                 */
+                while (get_system_time() < window.start_tick)
+                {
+                    AbortIfNot(run_tasks(&scheduler, TASKS_ALL), fail);
+                    wait_for_interrupt();
+                }
+            }
+
+            profile_mark_t record_mark;
+            profile_begin(&record_mark);
+            begin_deadline(&watchdog, DEADLINE_CAPTURE, capture_ticks(num_samples, sampling_frequency) +
+                           ms_to_ticks(DEADLINE_CAPTURE_SLACK_MS));
+            if (planar_window)
+            {
+                AbortIfNot(record_planar(&dma, &planar_samples, num_samples, adc), fail);
+            }
+            else if (stats_window)
+            {
+                AbortIfNot(record_with_stats(&dma, samples, packet_trailers, num_samples, adc), fail);
+            }
+            else
+            {
+                AbortIfNot(record(&dma, samples, num_samples, adc), fail);
+            }
+            sample_end_tick = get_system_time();
+            end_deadline(&watchdog, DEADLINE_CAPTURE);
+            profile_end(PROFILE_RECORD, &record_mark);
+            AbortIfNot(set_planar_packets(false), fail);
+            AbortIfNot(set_stats_packets(false), fail);
+            end_transmit_quiet();
+
+            if (stats_window)
+            {
+                AbortIfNot(sum_adc_packet_stats(packet_trailers,
+                                                num_samples / params.samples_per_packet,
+                                                params.samples_per_packet,
+                                                &window_stats), fail);
+            }
         }
 
         /*
-         * Record the ping.
+         * Mark the capture with the latest edge of the external trigger.
+         */
+        AbortIfNot(read_trigger_mark(&ping_stats.trigger), fail);
+
+        /*
+         * Recover the hardware timestamps before the data is processed and
+         * report any packets that were lost. The timestamps of a window cut
+         * from the continuous capture were recovered as it arrived.
          */
-        uint32_t sample_duration_ms = (debug_stream)? 2100 : 300;
-        uint32_t num_samples = sample_duration_ms / 1000.0 * sampling_frequency;
-        if (num_samples % params.samples_per_packet)
+        if (planar_window)
         {
-            num_samples += (params.samples_per_packet - (num_samples % params.samples_per_packet));
+            AbortIfNot(extract_planar_timestamps(&timing,
+                                                 &planar_samples,
+                                                 num_samples,
+                                                 params.samples_per_packet,
+                                                 sample_end_tick), fail);
         }
-
-        if (num_samples > MAX_SAMPLES)
+        else if (!continuous)
+        {
+            AbortIfNot(extract_timestamps(&timing,
+                                          ping_samples,
+                                          num_samples,
+                                          params.samples_per_packet,
+                                          sample_end_tick), fail);
+        }
+        if (timing.discontinuities || timing.lost_packets || timing.overrun_packets)
         {
-            num_samples = MAX_SAMPLES - (MAX_SAMPLES % adc.regs->samples_per_packet);
+            dbprintf("Capture dropped %d samples across %d gaps, "
+                    "%d whole packets, %d packets after a FIFO overrun\n",
+                    (uint32_t)timing.dropped_samples, timing.discontinuities,
+                    timing.lost_packets, timing.overrun_packets);
         }
+        report_boot_timeline();
+
+        /*
+         * Normalize and filter the received signal and, unless debugging,
+         * locate and correlate the ping.
+         */
+        AbortIfNot(acquire_ping_context(&ping_contexts, &ping), fail);
+        ping_context_t *context = get_ping_context(&ping_contexts, ping);
+        context->samples = ping_samples;
+        context->num_samples = num_samples;
+        context->sampling_frequency = sampling_frequency;
+        context->stages.capture_complete = sample_end_tick;
+        const tick_t held_at_capture = get_transmit_held_ticks();
 
-        tick_t sample_start_tick = get_system_time();
-        AbortIfNot(record(&dma, samples, num_samples, adc), fail);
+        dsp_job_t *job = &context->job;
+        job->data = ping_samples;
+        job->len = num_samples;
+        job->params = params;
+        job->sampling_frequency = sampling_frequency;
+        job->filter = &capture_filter;
+        job->decimator = prepare_capture_decimator(sampling_frequency);
+        job->fir = prepare_capture_fir(sampling_frequency);
+        job->correlate = (debug_stream)? false : true;
+        job->correlations = correlations;
+        job->correlation_len = correlation_len;
+        job->cross_correlations = cross_correlations;
+        job->planar = (planar_dsp || planar_window)? &planar_samples : NULL;
+        job->planar_input = planar_window;
+        job->measured_stats = (stats_window)? &window_stats : NULL;
+        job->average = &correlation_average;
+        job->lag_tracker = &lag_tracker;
+        job->bearing_tracker = &bearing_tracker;
+        job->excluded_channels = 0;
+        job->calibration = active_calibration();
+        job->fast_tdoa = (params.fast_tdoa_interval > 1 &&
+                          pings_since_correlation + 1 < params.fast_tdoa_interval &&
+                          !calibration_run.active)? true : false;
+        if (exclude_unhealthy)
+        {
+            job->params.reference_channel = select_reference_channel(&channel_health, params.reference_channel);
+            job->excluded_channels = unhealthy_channels(&channel_health);
+        }
+        if (!debug_stream && load_shed(&load_governor, SHED_FULL_SEARCH))
+        {
+            job->params.coarse_search = true;
+        }
+        if (!debug_stream && load_shed(&load_governor, SHED_FILTER))
+        {
+            job->params.filter = false;
+        }
+        begin_deadline(&watchdog, DEADLINE_DSP, ms_to_ticks(DEADLINE_DSP_MIN_MS) +
+                       DEADLINE_DSP_CAPTURE_FACTOR * capture_ticks(num_samples, sampling_frequency));
+        AbortIfNot(finish_ping_sends(), fail);
+        AbortIfNot(process_capture(job), fail);
+        context->stages.processed = get_system_time();
 
-        AbortIfNot(normalize(samples, num_samples), fail);
+        /*
+         * The window is cut from the capture just before it is correlated.
+         */
+        context->stages.window_located = context->stages.processed - job->correlation_duration;
+        end_deadline(&watchdog, DEADLINE_DSP);
+        AbortIfNot(update_channel_health(&channel_health, &job->channel_stats), fail);
 
         /*
-         * Filter the received signal.
+         * A planar window is only interleaved where it is relayed: the ping,
+         * or with recordings everything from shortly before the ping.
          */
+        if (planar_window && job->located)
+        {
+            const size_t pre_samples = (record_stream)?
+                    (uint64_t)sampling_frequency * RECORD_PRE_PING_US / 1000000 : 0;
+            const size_t relay_start = (job->start_index > pre_samples)? job->start_index - pre_samples : 0;
+            const size_t relay_end = (record_stream)? num_samples : job->end_index;
+            AbortIfNot(interleave_samples(&planar_samples,
+                                          relay_start,
+                                          relay_end - relay_start,
+                                          &ping_samples[relay_start]), fail);
+        }
+
         if (params.filter)
         {
-            const tick_t filter_start_time = get_system_time();
-            AbortIfNot(filter(samples, num_samples, highpass_iir, 5), fail);
+            dbprintf("Filtering took %lf seconds.\n", ticks_to_seconds(job->filter_duration));
+        }
+
+        /*
+         * Preview the whole window before anything larger is streamed so that
+         * the envelope reaches the operator immediately.
+         */
+        if (preview_stream)
+        {
+            const tick_t start_tick = sample_index_to_tick(&timing,
+                                                           get_sample_index(&timing, 0),
+                                                           sampling_frequency);
+            AbortIfNot(send_preview(&preview_socket, start_tick, ping_samples, num_samples), fail);
+        }
 
-            dbprintf("Filtering took %lf seconds.\n",
-                    ticks_to_seconds(get_system_time() - filter_start_time));
+        if (sd_recorder.mode == SD_RECORD_CAPTURES)
+        {
+            const tick_t start_tick = sample_index_to_tick(&timing,
+                                                           get_sample_index(&timing, 0),
+                                                           sampling_frequency);
+            AbortIfNot(push_sd_record(&sd_recorder, ping_samples, num_samples, start_tick), fail);
         }
 
         /*
@@ -473,58 +6903,330 @@ result_t go()
          */
         if (debug_stream)
         {
-            AbortIfNot(send_data(&data_stream_socket, samples, num_samples), fail);
+            begin_deadline(&watchdog, DEADLINE_SEND, send_budget((uint64_t)num_samples * sizeof(sample_t)));
+            if (!send_usb_samples(ping_samples, num_samples))
+            {
+                AbortIfNot(publish_data(ping_samples, num_samples, false), fail);
+            }
+            end_deadline(&watchdog, DEADLINE_SEND);
             continue;
         }
 
-        /*
-         * Truncate the data around the ping.
-         */
-        size_t start_index, end_index;
-        bool located = false;
-        AbortIfNot(truncate(samples, num_samples, &start_index, &end_index, &located, params, sampling_frequency), fail);
-
-        sync = located;
-        if (!sync)
+        context->start_index = job->start_index;
+        context->end_index = job->end_index;
+        if (!job->located && continuous)
+        {
+            ping_stats.pings_missed++;
+            dbprintf("Failed to locate the detected ping.\n");
+            continue;
+        }
+        else if (!job->located)
         {
-            dbprintf("Failed to find the ping.\n");
+            /*
+             * Widen the window around the tracked ping, then open it around
+             * the phase of the last ping received, before falling back to a
+             * full sync. A tracker with a single ping still predicts from
+             * the nominal period.
+             */
+            capture_misses++;
+            ping_stats.pings_missed++;
+            const uint32_t max_misses = (ping_tracker.locked)? CAPTURE_REACQUIRE_MISSES : CAPTURE_MAX_MISSES;
+            sync = (ping_tracker.count > 0 && capture_misses <= max_misses)? true : false;
+            dbprintf("Failed to find the ping (%u consecutive), %s.\n", capture_misses,
+                    (!sync)? "resyncing" : (capture_misses > CAPTURE_MAX_MISSES)? "re-acquiring" : "widening");
+            previous_ping_sample = 0;
             continue;
         }
 
-        tick_t offset = start_index * (CPU_CLOCK_HZ / sampling_frequency);
-        previous_ping_tick = sample_start_tick + offset;
+        sync = true;
+        capture_misses = 0;
+        context->sequence = ++ping_sequence;
+        ping_stats.pings_found++;
+
+        /*
+         * Locate the ping from its hardware sample index and track the period
+         * between consecutive pings in samples.
+         */
+        const uint64_t ping_sample = get_sample_index(&timing, context->start_index);
+        previous_ping_tick = sample_index_to_tick(&timing, ping_sample, sampling_frequency);
+        context->ping_sample = ping_sample;
+        context->ping_tick = previous_ping_tick;
         dbprintf("Found ping: %f s\n", ticks_to_seconds(previous_ping_tick));
+        AbortIfNot(update_ping_tracker(&ping_tracker, previous_ping_tick), fail);
+        if (ping_tracker.locked)
+        {
+            dbprintf("Tracked period: %d us +/- %d us\n",
+                    (uint32_t)(ping_tracker.period * 1000000 / CPU_CLOCK_HZ),
+                    (uint32_t)(ping_tracker.residual * 1000000 / CPU_CLOCK_HZ));
+        }
+
+        if (previous_ping_sample)
+        {
+            const uint64_t period = ping_sample - previous_ping_sample;
+            dbprintf("Ping period: %d us\n",
+                    (uint32_t)(period * 1000000 / sampling_frequency));
+        }
+        previous_ping_sample = ping_sample;
 
         /*
-         * Locate the ping samples.
+         * Schedule the capture of the next ping into the other half of the
+         * sample array so that it is recorded while this ping is processed
+         * and transmitted.
          */
-        AbortIfNot(end_index > start_index, fail);
-        sample_t *ping_start = &samples[start_index];
-        size_t ping_length = end_index - start_index;
+        if (pipelined && !continuous)
+        {
+            ping_window_t next_window;
+            AbortIfNot(plan_capture_window(get_system_time(), &next_window), fail);
+
+            ping_schedule.armed = true;
+            ping_schedule.started = false;
+            ping_schedule.start_tick = next_window.start_tick;
+            ping_schedule.buffer = (ping_samples == samples)?
+                    &samples[PING_BUFFER_SAMPLES] : samples;
+            ping_schedule.num_samples = get_capture_length(next_window.duration,
+                                                           sampling_frequency,
+                                                           PING_BUFFER_SAMPLES);
+            AbortIfNot(set_global_timer_alarm(ping_schedule.start_tick,
+                                              ping_schedule_alarm,
+                                              &ping_schedule), fail);
+
+            if (!request_thruster_shutdown(&silent_request_socket,
+                                           next_window.start_tick,
+                                           next_window.silence_duration))
+            {
+                dblog(LOG_WARN, "Failed to request thruster silence.\n");
+            }
+        }
 
         /*
-         * Perform the correlation on the data.
+         * A rejected ping still tracks the pinger, but it is neither
+         * correlated nor relayed.
          */
-        correlation_result_t result;
-        size_t num_correlations;
+        if (job->excluded)
+        {
+            ping_stats.pings_excluded++;
+            dbprintf("Ping not correlated: unhealthy channels 0x%x\n", job->excluded_channels);
+        }
+        else if (!job->accepted)
+        {
+            ping_stats.pings_rejected++;
+            uint32_t rail_samples = 0;
+            for (size_t k = 0; k < 4; ++k)
+            {
+                rail_samples += job->channel_stats.clipped_samples[k];
+            }
+
+            dbprintf("Rejected ping: quality %d%%, SNR %d dB, %u clipped samples (%u at the ADC rails), onset %d%%\n",
+                    (int)(job->quality.score * 100),
+                    (int)job->quality.snr_db,
+                    job->quality.clipped_samples,
+                    rail_samples,
+                    (int)(job->quality.onset_sharpness * 100));
+        }
+        else
+        {
+            /*
+             * Locate the ping samples.
+             */
+            AbortIfNot(context->end_index > context->start_index, fail);
+            sample_t *ping_start = &context->samples[context->start_index];
+            size_t ping_length = context->end_index - context->start_index;
+
+            AbortIfNot(record_calibration_ping(&job->result), fail);
+            context->result = job->result;
+            correlation_result_t *result = &context->result;
+            AbortIfNot(solve_bearing(&hydrophone_array, result), fail);
+
+            if (result->leading_edge)
+            {
+                pings_since_correlation++;
+                dbprintf("Delays from leading edges, uncertain by %d ns\n", (int32_t)result->edge_uncertainty_ns);
+            }
+            else
+            {
+                pings_since_correlation = 0;
+                dbprintf("Correlation took %d ms\n", ticks_to_ms(job->correlation_duration));
+            }
+            dbprintf("Correlation results: %d %d %d\n", result->channel_delay_ns[0], result->channel_delay_ns[1], result->channel_delay_ns[2]);
+            dbprintf("Bearing: %d deg, elevation: %d deg\n", (int32_t)result->bearing_deg, (int32_t)result->elevation_deg);
+
+            AbortIfNot(update_bearing_tracker(&bearing_tracker,
+                                              &hydrophone_array,
+                                              context->ping_tick,
+                                              result,
+                                              &context->track), fail);
+
+            context->stages.solved = get_system_time();
+            if (context->track.flags & BEARING_TRACK_OUTLIER)
+            {
+                dbprintf("Ping is outside the tracked bearing (%u consecutive).\n", context->track.outliers);
+            }
+
+            /*
+             * Relay the result.
+             */
+            profile_mark_t send_mark;
+            profile_begin(&send_mark);
+            const bool send_xcorr = (xcorr_stream && !load_shed(&load_governor, SHED_XCORR_STREAM))? true : false;
+            const bool send_data = (data_stream && !load_shed(&load_governor, SHED_DATA_STREAM))? true : false;
+            const uint64_t send_bytes = ((send_xcorr)? job->num_correlations * sizeof(correlation_t) : 0) +
+                    ((record_stream || !send_data)? 0 : ping_length * sizeof(sample_t));
+            begin_deadline(&watchdog, DEADLINE_SEND, send_budget(send_bytes));
+            AbortIfNot(send_result(&result_socket,
+                                   0,
+                                   context->sequence,
+                                   context->ping_tick,
+                                   &ping_stats.trigger,
+                                   &context->track,
+                                   result,
+                                   &job->average_result,
+                                   job->averaged_pings,
+                                   job->filter_duration,
+                                   job->correlation_duration,
+                                   &context->stages), fail);
+            AbortIfNot(flush_results(), fail);
+            AbortIfNot(push_ping_history(&ping_history,
+                                         context->sequence,
+                                         context->ping_tick,
+                                         &ping_stats.trigger,
+                                         &context->track,
+                                         result,
+                                         ping_start,
+                                         ping_length,
+                                         job->correlations,
+                                         job->num_correlations), fail);
+            trace(TRACE_PING, TRACE_INSTANT, context->sequence, 0);
+            AbortIfNot(run_tasks(&scheduler, TASKS_ALL), fail);
+
+            /*
+             * Send the data for the correlation portion and the correlation result.
+             */
+            if (send_xcorr)
+            {
+                AbortIfNot(start_publish_xcorr(job->correlations, job->num_correlations), fail);
+                AbortIfNot(run_tasks(&scheduler, TASKS_ALL), fail);
+            }
 
-        tick_t start_time = get_system_time();
-        AbortIfNot(cross_correlate(ping_start, ping_length, correlations, MAX_SAMPLES * 2, &num_correlations, &result, sampling_frequency), fail);
+            /*
+             * Recordings are copied out of the capture, which the next scheduled
+             * capture may overwrite, and streamed while the next ping is awaited.
+             * Otherwise, if the data stream is enabled, the samples are sent in
+             * the background until the next capture is processed, which is
+             * recorded into the other half of the sample array.
+             */
+            if (record_stream)
+            {
+                const size_t pre_samples = (uint64_t)sampling_frequency * RECORD_PRE_PING_US / 1000000;
+                const size_t record_start = (context->start_index > pre_samples)?
+                        context->start_index - pre_samples : 0;
+                const size_t record_len = (context->num_samples - record_start < record_queue.capacity)?
+                        context->num_samples - record_start : record_queue.capacity;
+                AbortIfNot(push_record(&record_queue, &context->samples[record_start], record_len), fail);
+            }
+            else if (send_data && !send_usb_samples(ping_start, ping_length))
+            {
+                AbortIfNot(start_publish_data(ping_start, ping_length), fail);
+            }
+            end_deadline(&watchdog, DEADLINE_SEND);
+            profile_end(PROFILE_SEND, &send_mark);
 
-        tick_t duration_time = get_system_time() - start_time;
-        dbprintf("Correlation took %d ms\n", ticks_to_ms(duration_time));
-        dbprintf("Correlation results: %d %d %d\n", result.channel_delay_ns[0], result.channel_delay_ns[1], result.channel_delay_ns[2]);
+            if (sd_recorder.mode == SD_RECORD_PINGS)
+            {
+                AbortIfNot(push_sd_record(&sd_recorder, ping_start, ping_length, context->ping_tick), fail);
+            }
+        }
 
         /*
-         * Relay the result.
+         * Separate any additional pingers from the same capture and relay a
+         * result for each one that was heard.
          */
-        AbortIfNot(send_result(&result_socket, &result), fail);
+        if (params.num_pingers)
+        {
+            if (pinger_bank_stale || pinger_bank.sampling_frequency != sampling_frequency)
+            {
+                AbortIfNot(init_pinger_bank(&pinger_bank,
+                                            params.pinger_frequencies,
+                                            params.num_pingers,
+                                            sampling_frequency), fail);
+                pinger_bank_stale = false;
+            }
+
+            AbortIfNot(run_pinger_bank(&pinger_bank, context->samples, context->num_samples, params, &timing), fail);
+
+            /*
+             * The correlations of each pinger overwrite those being sent.
+             */
+            AbortIfNot(finish_stream_job(&xcorr_stream_job), fail);
+            AbortIfNot(run_tasks(&scheduler, TASKS_ALL), fail);
+
+            for (size_t p = 0; p < pinger_bank.num_pingers; ++p)
+            {
+                pinger_channel_t *pinger = &pinger_bank.pingers[p];
+                if (!pinger->found || pinger->window_len < 2)
+                {
+                    dbprintf("Pinger %u Hz not heard - MaxVal: %d\n",
+                            pinger->frequency, pinger->max_amplitude);
+                    continue;
+                }
+
+                const tick_t correlation_start_time = get_system_time();
+                size_t num_correlations = 0;
+                AbortIfNot(cross_correlate(pinger->window,
+                                           pinger->window_len,
+                                           correlations,
+                                           correlation_len,
+                                           &num_correlations,
+                                           &pinger->result,
+                                           sampling_frequency), fail);
+                ping_stages_t stages;
+                stages.capture_complete = context->stages.capture_complete;
+                stages.window_located = correlation_start_time;
+                stages.processed = get_system_time();
+                AbortIfNot(solve_bearing(&hydrophone_array, &pinger->result), fail);
+                stages.solved = get_system_time();
+                AbortIfNot(send_result(&result_socket,
+                                       pinger->frequency,
+                                       context->sequence,
+                                       context->ping_tick,
+                                       &ping_stats.trigger,
+                                       NULL,
+                                       &pinger->result,
+                                       NULL,
+                                       0,
+                                       0,
+                                       stages.solved - correlation_start_time,
+                                       &stages), fail);
+                AbortIfNot(run_tasks(&scheduler, TASKS_ALL), fail);
+            }
+
+            /*
+             * The results of the pingers share datagrams until the last is
+             * sent.
+             */
+            AbortIfNot(flush_results(), fail);
+        }
 
         /*
-         * Send the data for the correlation portion and the correlation result.
+         * Account the cost of the ping, from its capture to the end of its
+         * relay, against the period of the pinger. The time its streams were
+         * held for the next capture window is not work of its own.
          */
-        AbortIfNot(send_xcorr(&xcorr_stream_socket, correlations, num_correlations), fail);
-        AbortIfNot(send_data(&data_stream_socket, ping_start, ping_length), fail);
+        const shed_level_t shed_level = load_governor.level;
+        const tick_t held = get_transmit_held_ticks() - held_at_capture;
+        AbortIfNot(update_load_governor(&load_governor,
+                                        get_system_time() - context->stages.capture_complete - held,
+                                        (tick_t)ping_tracker.period), fail);
+        if (load_governor.level > shed_level)
+        {
+            dblog(LOG_WARN, "Ping took %u of %u us, shedding the %s.\n",
+                    (uint32_t)ticks_to_micros(load_governor.cost),
+                    (uint32_t)ticks_to_micros(load_governor.budget),
+                    shed_level_name(load_governor.level));
+        }
+        else if (load_governor.level < shed_level)
+        {
+            dblog(LOG_INFO, "Load has eased, restoring the %s.\n", shed_level_name(shed_level));
+        }
     }
 }
 
@@ -535,7 +7237,11 @@ result_t go()
  */
 int main()
 {
-    go();
+    /*
+     * Recover from faults in the main loop without a reset where possible.
+     */
+    while (go() != success && warm_restart());
+    flush_log();
 
     /*
      * If go fails, we need to trigger a processor reset.
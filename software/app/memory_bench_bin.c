@@ -0,0 +1,445 @@
+#include "abort.h"
+#include "adc.h"
+#include "capture_arena.h"
+#include "db.h"
+#include "dma.h"
+#include "l2_events.h"
+#include "lwip/ip.h"
+#include "network_stack.h"
+#include "sample_util.h"
+#include "spi.h"
+#include "system.h"
+#include "system_params.h"
+#include "time_util.h"
+#include "types.h"
+#include "uart.h"
+#include "xil_cache.h"
+
+#include "adc_dma_addresses.h"
+
+#include <string.h>
+
+/**
+ * The number of scatter-gather descriptors in the DMA capture ring, which
+ * matches the main application.
+ */
+#define DMA_SG_DESCRIPTORS 64
+
+/**
+ * The size of each of the two buffers that are read, written and copied
+ * between. Both exceed the L2 cache many times over.
+ */
+#define BENCH_BUFFER_BYTES (8 << 20)
+
+/**
+ * The least number of bytes moved for each measurement, so that the shortest
+ * runs are long against the resolution of the timer.
+ */
+#define BENCH_MIN_BYTES (64 << 20)
+
+/**
+ * The working sets that bandwidth is measured over, which fit in the L1
+ * cache, fit in the L2 cache, and only fit in DDR.
+ */
+static const size_t bench_bandwidth_bytes[] = {16 << 10, 256 << 10, 4 << 20};
+
+#define BENCH_NUM_BANDWIDTH_SIZES (sizeof(bench_bandwidth_bytes) / sizeof(bench_bandwidth_bytes[0]))
+
+/**
+ * The ranges that cache maintenance is timed over.
+ */
+static const size_t bench_maintenance_bytes[] = {4 << 10, 32 << 10, 256 << 10, 1 << 20, 4 << 20};
+
+#define BENCH_NUM_MAINTENANCE_SIZES (sizeof(bench_maintenance_bytes) / sizeof(bench_maintenance_bytes[0]))
+
+/**
+ * The ADC clock divider and packet length of the capture that contends for
+ * DDR, which streams 25 Msps or 200 MB/s through HP0, and the length of the
+ * capture.
+ */
+#define BENCH_CONTENTION_CLK_DIV 2
+#define BENCH_CONTENTION_PACKET_SAMPLES 4096
+#define BENCH_CAPTURE_SAMPLES (1 << 20)
+
+#ifndef DMA_COHERENCY
+#define DMA_COHERENCY DMA_CACHED
+#endif
+
+dma_engine_t dma;
+dma_descriptor_t dma_descriptors[DMA_SG_DESCRIPTORS];
+adc_driver_t adc;
+spi_driver_t adc_spi;
+capture_arena_t capture_arena;
+
+/**
+ * Defines the memory operations whose bandwidth is measured.
+ */
+typedef enum bench_op_t
+{
+    BENCH_READ,
+    BENCH_WRITE,
+    BENCH_COPY
+} bench_op_t;
+
+static const char *bench_op_names[] = {"read", "write", "copy"};
+
+/**
+ * The sum of the words read, which keeps the reads from being optimized out.
+ */
+volatile uint32_t bench_sink;
+
+/**
+ * Reads a buffer a cache line at a time.
+ *
+ * @param src The buffer to read.
+ * @param len The length of the buffer in bytes, a multiple of a cache line.
+ *
+ * @return None.
+ */
+static void read_buffer(const uint32_t *src, const size_t len)
+{
+    uint32_t sum = 0;
+    for (size_t i = 0; i < len / sizeof(uint32_t); i += 8)
+    {
+        sum += src[i] + src[i + 1] + src[i + 2] + src[i + 3] +
+               src[i + 4] + src[i + 5] + src[i + 6] + src[i + 7];
+    }
+
+    bench_sink = sum;
+}
+
+/**
+ * Writes a buffer a cache line at a time.
+ *
+ * @param dst The buffer to write.
+ * @param len The length of the buffer in bytes, a multiple of a cache line.
+ * @param value The value to write to each word.
+ *
+ * @return None.
+ */
+static void write_buffer(uint32_t *dst, const size_t len, const uint32_t value)
+{
+    for (size_t i = 0; i < len / sizeof(uint32_t); i += 8)
+    {
+        dst[i] = value;
+        dst[i + 1] = value;
+        dst[i + 2] = value;
+        dst[i + 3] = value;
+        dst[i + 4] = value;
+        dst[i + 5] = value;
+        dst[i + 6] = value;
+        dst[i + 7] = value;
+    }
+}
+
+/**
+ * Runs one pass of a memory operation over a working set.
+ *
+ * @param op The operation.
+ * @param dst The destination of writes and copies.
+ * @param src The source of reads and copies.
+ * @param len The size of the working set in bytes.
+ * @param pass The index of the pass.
+ *
+ * @return None.
+ */
+static void run_pass(const bench_op_t op, uint32_t *dst, const uint32_t *src, const size_t len, const size_t pass)
+{
+    switch (op)
+    {
+        case BENCH_READ:
+            read_buffer(src, len);
+            break;
+
+        case BENCH_WRITE:
+            write_buffer(dst, len, pass);
+            break;
+
+        case BENCH_COPY:
+            memcpy(dst, src, len);
+            break;
+    }
+}
+
+/**
+ * Selects the L2 events that show whether an operation is served by the L2
+ * cache: the hits and requests of data reads, or of data writes.
+ *
+ * @param op The operation.
+ * @param[out] events The interval to start.
+ *
+ * @return None.
+ */
+static void start_op_events(const bench_op_t op, l2_events_t *events)
+{
+    if (op == BENCH_WRITE)
+    {
+        start_l2_events(events, XL2CC_DWHIT, XL2CC_DWREQ);
+    }
+    else
+    {
+        start_l2_events(events, XL2CC_DRHIT, XL2CC_DRREQ);
+    }
+}
+
+/**
+ * Prints the bandwidth of a measurement and the L2 hit rate it saw.
+ *
+ * @param label The condition of the measurement.
+ * @param op The operation measured.
+ * @param len The size of the working set in bytes.
+ * @param bytes The total bytes moved.
+ * @param ticks The time taken to move them.
+ * @param events The L2 hits and requests over the measurement.
+ *
+ * @return None.
+ */
+static void print_bandwidth(const char *label,
+                            const bench_op_t op,
+                            const size_t len,
+                            const uint64_t bytes,
+                            const tick_t ticks,
+                            const l2_events_t *events)
+{
+    const float seconds = ticks_to_seconds(ticks);
+    const float mb_per_second = (seconds > 0)? bytes / seconds / 1000000 : 0;
+    const float hit_percent = (events->counts[1])? 100.0f * events->counts[0] / events->counts[1] : 0;
+
+    dbprintf("%s %s of %d KB: %d.%01d MB/s, %u L2 requests, %d.%01d%% L2 hits\n",
+            label,
+            bench_op_names[op],
+            (int)(len >> 10),
+            (int)mb_per_second, (int)(mb_per_second * 10) % 10,
+            events->counts[1],
+            (int)hit_percent, (int)(hit_percent * 10) % 10);
+    flush_log();
+}
+
+/**
+ * Measures the bandwidth of each operation over each working set with
+ * nothing else using DDR.
+ *
+ * @param dst The destination buffer.
+ * @param src The source buffer.
+ *
+ * @return None.
+ */
+static void run_bandwidth(uint32_t *dst, const uint32_t *src)
+{
+    for (bench_op_t op = BENCH_READ; op <= BENCH_COPY; ++op)
+    {
+        for (size_t i = 0; i < BENCH_NUM_BANDWIDTH_SIZES; ++i)
+        {
+            const size_t len = bench_bandwidth_bytes[i];
+            const size_t passes = (BENCH_MIN_BYTES / len)? BENCH_MIN_BYTES / len : 1;
+
+            /*
+             * The first pass warms the caches, so a working set that fits is
+             * measured from them.
+             */
+            run_pass(op, dst, src, len, 0);
+
+            l2_events_t events;
+            start_op_events(op, &events);
+            const tick_t start = get_system_time();
+            for (size_t pass = 0; pass < passes; ++pass)
+            {
+                run_pass(op, dst, src, len, pass);
+            }
+            const tick_t ticks = get_system_time() - start;
+            stop_l2_events(&events);
+
+            print_bandwidth("Idle", op, len, (uint64_t)len * passes, ticks, &events);
+            dispatch_network_stack();
+        }
+    }
+}
+
+/**
+ * Times cleaning and invalidating ranges of the data caches, with the range
+ * dirty and with it already clean.
+ *
+ * @param buffer The buffer to maintain.
+ *
+ * @return None.
+ */
+static void run_maintenance(uint32_t *buffer)
+{
+    for (size_t i = 0; i < BENCH_NUM_MAINTENANCE_SIZES; ++i)
+    {
+        const size_t len = bench_maintenance_bytes[i];
+
+        write_buffer(buffer, len, i);
+        tick_t start = get_system_time();
+        Xil_DCacheFlushRange((INTPTR)buffer, len);
+        const tick_t dirty_flush = get_system_time() - start;
+
+        start = get_system_time();
+        Xil_DCacheFlushRange((INTPTR)buffer, len);
+        const tick_t clean_flush = get_system_time() - start;
+
+        write_buffer(buffer, len, i);
+        start = get_system_time();
+        Xil_DCacheInvalidateRange((INTPTR)buffer, len);
+        const tick_t dirty_invalidate = get_system_time() - start;
+
+        start = get_system_time();
+        Xil_DCacheInvalidateRange((INTPTR)buffer, len);
+        const tick_t clean_invalidate = get_system_time() - start;
+
+        const size_t lines = len / CACHE_LINE_BYTES;
+        dbprintf("Cache maintenance of %d KB: flush %d us dirty (%d ns/line), %d us clean, "
+                "invalidate %d us dirty (%d ns/line), %d us clean\n",
+                (int)(len >> 10),
+                (int)ticks_to_micros(dirty_flush),
+                (int)(ticks_to_ns(dirty_flush) / lines),
+                (int)ticks_to_micros(clean_flush),
+                (int)ticks_to_micros(dirty_invalidate),
+                (int)(ticks_to_ns(dirty_invalidate) / lines),
+                (int)ticks_to_micros(clean_invalidate));
+        flush_log();
+        dispatch_network_stack();
+    }
+}
+
+/**
+ * Measures the bandwidth of each operation over the largest working set
+ * while the AXI DMA writes a capture to DDR through HP0.
+ *
+ * @note Only the passes that complete while the capture streams are counted.
+ *
+ * @param dst The destination buffer.
+ * @param src The source buffer.
+ * @param data The capture buffer.
+ *
+ * @return Success or fail.
+ */
+static result_t run_contention(uint32_t *dst, const uint32_t *src, sample_t *data)
+{
+    const size_t len = bench_bandwidth_bytes[BENCH_NUM_BANDWIDTH_SIZES - 1];
+    const size_t samples_per_packet = adc.regs->samples_per_packet;
+    const size_t sample_count = BENCH_CAPTURE_SAMPLES / samples_per_packet * samples_per_packet;
+
+    /*
+     * Packets already in the stream keep their previous length, so one
+     * packet is recorded and discarded after the change.
+     */
+    AbortIfNot(record(&dma, data, samples_per_packet, adc), fail);
+
+    for (bench_op_t op = BENCH_READ; op <= BENCH_COPY; ++op)
+    {
+        capture_t capture;
+        AbortIfNot(start_capture(&capture, &dma, data, sample_count, adc), fail);
+
+        uint64_t bytes = 0;
+        l2_events_t events;
+        start_op_events(op, &events);
+        const tick_t start = get_system_time();
+        tick_t end = start;
+        for (size_t pass = 0; !capture_done(&capture); ++pass)
+        {
+            if (!dma.interrupts_enabled)
+            {
+                AbortIfNot(service_capture(&capture), fail);
+            }
+
+            run_pass(op, dst, src, len, pass);
+            if (!capture_done(&capture))
+            {
+                bytes += len;
+                end = get_system_time();
+            }
+        }
+        stop_l2_events(&events);
+
+        result_t ret = wait_for_capture(&capture);
+        AbortIfNot(set_dma_callback(&dma, NULL, NULL), fail);
+        AbortIfNot(ret, fail);
+
+        print_bandwidth("DMA streaming", op, len, bytes, end - start, &events);
+        dispatch_network_stack();
+    }
+
+    return success;
+}
+
+/**
+ * Measures the bandwidth of DDR and the caches, the cost of cache
+ * maintenance, and the bandwidth left while the DMA engine streams samples.
+ *
+ * @return Success or fail.
+ */
+result_t go()
+{
+    AbortIfNot(init_system(), fail);
+    AbortIfNot(init_capture_arena(&capture_arena), fail);
+
+    struct ip_addr our_ip, netmask, gateway;
+    IP4_ADDR(&our_ip, 192, 168, 0, 7);
+    IP4_ADDR(&netmask, 255, 255, 255, 0);
+    IP4_ADDR(&gateway, 192, 168, 1, 1);
+
+    macaddr_t mac_address = {
+        .addr = {0x00, 0x0a, 0x35, 0x00, 0x01, 0x02}
+    };
+
+    AbortIfNot(init_network_stack(our_ip, netmask, gateway, mac_address), fail);
+    AbortIfNot(dbinit(), fail);
+    dbprintf("Beginning HydroZynq memory benchmark\n");
+
+    AbortIfNot(initialize_dma(&dma, DMA_BASE_ADDRESS), fail);
+    AbortIfNot(set_dma_length_width(&dma, DMA_LENGTH_WIDTH), fail);
+    AbortIfNot(set_dma_coherency(&dma, DMA_COHERENCY), fail);
+    AbortIfNot(dma_sg_included(&dma), fail);
+    AbortIfNot(init_dma_sg_ring(&dma, dma_descriptors, DMA_SG_DESCRIPTORS), fail);
+    AbortIfNot(enable_dma_interrupts(&dma, DMA_S2MM_IRQ_ID), fail);
+    AbortIfNot(enable_uart_interrupts(), fail);
+
+    AbortIfNot(init_spi(&adc_spi, SPI_BASE_ADDRESS, true), fail);
+    AbortIfNot(init_adc(&adc, &adc_spi, ADC_BASE_ADDRESS, false, false), fail);
+    adc.regs->stream_control = ADC_STREAM_TIMESTAMPS;
+    adc.regs->clk_div = BENCH_CONTENTION_CLK_DIV;
+    adc.regs->samples_per_packet = BENCH_CONTENTION_PACKET_SAMPLES;
+
+    /*
+     * The buffers the processor works on are cacheable, as the sample arrays
+     * of the main application are, and the capture buffer is allocated as in
+     * the main application.
+     */
+    uint32_t *src = capture_arena_alloc(&capture_arena, BENCH_BUFFER_BYTES);
+    uint32_t *dst = capture_arena_alloc(&capture_arena, BENCH_BUFFER_BYTES);
+    AbortIfNot(src, fail);
+    AbortIfNot(dst, fail);
+
+    sample_t *data;
+    if (dma.coherency == DMA_NONCACHEABLE)
+    {
+        data = capture_arena_alloc_mapped(&capture_arena,
+                                          BENCH_CAPTURE_SAMPLES * sizeof(sample_t),
+                                          CAPTURE_MEMORY_WRITE_COMBINING);
+    }
+    else
+    {
+        data = capture_arena_alloc(&capture_arena, BENCH_CAPTURE_SAMPLES * sizeof(sample_t));
+    }
+    AbortIfNot(data, fail);
+
+    write_buffer(src, BENCH_BUFFER_BYTES, 0x5a5a5a5a);
+
+    while (1)
+    {
+        run_bandwidth(dst, src);
+        run_maintenance(dst);
+        AbortIfNot(run_contention(dst, src, data), fail);
+
+        dbprintf("Memory benchmark complete\n");
+        flush_log();
+    }
+}
+
+int main()
+{
+    go();
+
+    while (1);
+}
@@ -0,0 +1,335 @@
+#include "abort.h"
+#include "db.h"
+#include "lwip/ip.h"
+#include "lwip/memp.h"
+#include "lwip/pbuf.h"
+#include "lwip/stats.h"
+#include "lwip/udp.h"
+#include "network_stack.h"
+#include "system.h"
+#include "system_params.h"
+#include "time_util.h"
+#include "types.h"
+#include "udp.h"
+
+#include <string.h>
+
+/**
+ * The port that benchmark requests are received on. Echo requests are
+ * returned from the same port.
+ */
+#define NETWORK_BENCH_PORT 3008
+
+/**
+ * The version of the benchmark datagram layout.
+ */
+#define NETWORK_BENCH_VERSION 1
+
+/**
+ * The largest payload that can be streamed. Larger payloads than the MTU are
+ * fragmented by the IP layer.
+ */
+#define NETWORK_BENCH_MAX_PAYLOAD 8192
+
+/**
+ * The time a zero-copy send may wait for the driver to release a reference
+ * before the stream is abandoned.
+ */
+#define NETWORK_BENCH_REF_TIMEOUT_MS 100
+
+/**
+ * Defines the types of benchmark datagrams.
+ */
+typedef enum bench_message_t
+{
+    BENCH_STREAM_REQUEST = 1,
+    BENCH_ECHO = 2,
+    BENCH_DATA = 3,
+    BENCH_SUMMARY = 4
+} bench_message_t;
+
+/**
+ * Defines the transmit path that a stream is sent through.
+ */
+typedef enum bench_path_t
+{
+    BENCH_PATH_COPY = 0,
+    BENCH_PATH_REF = 1
+} bench_path_t;
+
+typedef struct __attribute__((packed)) bench_header_t
+{
+    uint16_t version;
+    uint16_t type;
+    uint32_t test_id;
+} bench_header_t;
+
+/**
+ * Defines a request to stream datagrams back to the sender.
+ */
+typedef struct __attribute__((packed)) bench_stream_request_t
+{
+    bench_header_t header;
+    uint32_t payload_bytes;
+    uint32_t bytes_per_second;
+    uint32_t count;
+    uint16_t path;
+    uint16_t reserved;
+} bench_stream_request_t;
+
+/**
+ * Defines the header of every streamed datagram.
+ */
+typedef struct __attribute__((packed)) bench_data_header_t
+{
+    bench_header_t header;
+    uint32_t sequence;
+    uint64_t send_time_us;
+} bench_data_header_t;
+
+/**
+ * Defines the report sent once a stream has been sent.
+ */
+typedef struct __attribute__((packed)) bench_summary_t
+{
+    bench_header_t header;
+    uint32_t sent;
+    uint32_t send_failures;
+    uint64_t elapsed_us;
+    uint32_t pbuf_pool_errors;
+    uint32_t pbuf_pool_max;
+    uint32_t heap_errors;
+    uint32_t ref_waits;
+} bench_summary_t;
+
+/**
+ * The most recent stream request and where it came from. The request is
+ * written by the receive callback and consumed by the main loop.
+ */
+static bench_stream_request_t pending_request;
+static struct ip_addr pending_addr;
+static uint16_t pending_port;
+static volatile bool request_pending = false;
+
+/**
+ * The payload of every streamed datagram. It is never modified, so it can be
+ * referenced by datagrams that are still queued in the driver.
+ */
+static uint8_t payload[NETWORK_BENCH_MAX_PAYLOAD];
+
+/**
+ * The staging buffer of the copying path.
+ */
+static uint8_t datagram[sizeof(bench_data_header_t) + NETWORK_BENCH_MAX_PAYLOAD];
+
+/**
+ * Handles a benchmark datagram.
+ *
+ * @note Echo requests are returned immediately so that the round-trip time
+ *       does not include the main loop.
+ *
+ * @return None.
+ */
+void receive_request(void *arg, struct udp_pcb *upcb, struct pbuf *p, struct ip_addr *addr, uint16_t port)
+{
+    bench_header_t header;
+    if (p->len < sizeof(header))
+    {
+        pbuf_free(p);
+        return;
+    }
+
+    memcpy(&header, p->payload, sizeof(header));
+    if (header.version != NETWORK_BENCH_VERSION)
+    {
+        pbuf_free(p);
+        return;
+    }
+
+    if (header.type == BENCH_ECHO)
+    {
+        udp_sendto(upcb, p, addr, port);
+        pbuf_free(p);
+        return;
+    }
+
+    if (header.type == BENCH_STREAM_REQUEST && p->len >= sizeof(pending_request) && !request_pending)
+    {
+        memcpy(&pending_request, p->payload, sizeof(pending_request));
+        pending_addr = *addr;
+        pending_port = port;
+        request_pending = true;
+    }
+
+    pbuf_free(p);
+}
+
+/**
+ * Streams the requested datagrams and reports the outcome.
+ *
+ * @param socket The socket to stream over.
+ * @param request The stream to send.
+ * @param addr The address of the requester.
+ * @param port The port of the requester.
+ *
+ * @return Success or fail.
+ */
+static result_t run_stream(udp_socket_t *socket,
+                           const bench_stream_request_t *request,
+                           struct ip_addr *addr,
+                           const uint16_t port)
+{
+    AbortIfNot(request->payload_bytes <= NETWORK_BENCH_MAX_PAYLOAD, fail);
+    AbortIfNot(request->path == BENCH_PATH_COPY || request->path == BENCH_PATH_REF, fail);
+    AbortIfNot(connect_udp(socket, addr, port), fail);
+
+    const uint32_t failures_before = get_udp_send_failures();
+    const uint32_t pool_errors_before = lwip_stats.memp[MEMP_PBUF_POOL].err;
+    const uint32_t heap_errors_before = lwip_stats.mem.err;
+
+    /*
+     * Datagrams are paced by their scheduled send time so that a late send
+     * is followed by a burst that restores the average rate.
+     */
+    const size_t datagram_bytes = sizeof(bench_data_header_t) + request->payload_bytes;
+    const tick_t interval = (request->bytes_per_second)?
+        (uint64_t)datagram_bytes * CPU_CLOCK_HZ / request->bytes_per_second : 0;
+
+    udp_ref_tracker_t tracker = {0};
+    uint32_t sent = 0, ref_waits = 0;
+    const tick_t start_time = get_system_time();
+    tick_t next_send = start_time;
+    for (uint32_t i = 0; i < request->count; ++i)
+    {
+        while (get_system_time() < next_send)
+        {
+            dispatch_network_stack();
+        }
+        next_send += interval;
+
+        bench_data_header_t header;
+        header.header.version = NETWORK_BENCH_VERSION;
+        header.header.type = BENCH_DATA;
+        header.header.test_id = request->header.test_id;
+        header.sequence = i;
+        header.send_time_us = ticks_to_micros(get_system_time());
+
+        result_t ret;
+        if (request->path == BENCH_PATH_REF)
+        {
+            if (!udp_ref_available())
+            {
+                ref_waits++;
+                const tick_t wait_start = get_system_time();
+                while (!udp_ref_available() &&
+                       get_system_time() - wait_start < ms_to_ticks(NETWORK_BENCH_REF_TIMEOUT_MS))
+                {
+                    dispatch_network_stack();
+                }
+            }
+
+            ret = send_udp_ref(socket, &header, sizeof(header), payload, request->payload_bytes, &tracker);
+        }
+        else
+        {
+            memcpy(datagram, &header, sizeof(header));
+            memcpy(&datagram[sizeof(header)], payload, request->payload_bytes);
+            ret = send_udp(socket, (char *)datagram, datagram_bytes);
+        }
+
+        if (ret == success)
+        {
+            sent++;
+        }
+    }
+    const tick_t elapsed = get_system_time() - start_time;
+
+    /*
+     * Let the driver release every reference before reporting so that the
+     * payload is no longer in flight.
+     */
+    const tick_t drain_start = get_system_time();
+    while (!udp_refs_released(&tracker) &&
+           get_system_time() - drain_start < ms_to_ticks(NETWORK_BENCH_REF_TIMEOUT_MS))
+    {
+        dispatch_network_stack();
+    }
+
+    bench_summary_t summary;
+    summary.header.version = NETWORK_BENCH_VERSION;
+    summary.header.type = BENCH_SUMMARY;
+    summary.header.test_id = request->header.test_id;
+    summary.sent = sent;
+    summary.send_failures = get_udp_send_failures() - failures_before;
+    summary.elapsed_us = ticks_to_micros(elapsed);
+    summary.pbuf_pool_errors = lwip_stats.memp[MEMP_PBUF_POOL].err - pool_errors_before;
+    summary.pbuf_pool_max = lwip_stats.memp[MEMP_PBUF_POOL].max;
+    summary.heap_errors = lwip_stats.mem.err - heap_errors_before;
+    summary.ref_waits = ref_waits;
+    AbortIfNot(send_udp(socket, (char *)&summary, sizeof(summary)), fail);
+
+    dbprintf("Stream %d: %d/%d sent, %d failures, %d ref waits, %d pbuf pool errors\n",
+            request->header.test_id, sent, request->count, summary.send_failures,
+            ref_waits, summary.pbuf_pool_errors);
+
+    return success;
+}
+
+/**
+ * Serves network benchmark requests from scripts/network_bench.py.
+ *
+ * @return Success or fail.
+ */
+result_t go()
+{
+    AbortIfNot(init_system(), fail);
+
+    struct ip_addr our_ip, netmask, gateway;
+    IP4_ADDR(&our_ip, 192, 168, 0, 7);
+    IP4_ADDR(&netmask, 255, 255, 255, 0);
+    IP4_ADDR(&gateway, 192, 168, 1, 1);
+
+    macaddr_t mac_address = {
+        .addr = {0x00, 0x0a, 0x35, 0x00, 0x01, 0x02}
+    };
+
+    AbortIfNot(init_network_stack(our_ip, netmask, gateway, mac_address), fail);
+    AbortIfNot(dbinit(), fail);
+    dbprintf("Beginning HydroZynq network benchmark\n");
+
+    for (size_t i = 0; i < sizeof(payload); ++i)
+    {
+        payload[i] = i;
+    }
+
+    udp_socket_t request_socket, stream_socket;
+    AbortIfNot(init_udp(&request_socket), fail);
+    AbortIfNot(bind_udp(&request_socket, IP_ADDR_ANY, NETWORK_BENCH_PORT, receive_request), fail);
+    AbortIfNot(init_udp(&stream_socket), fail);
+
+    while (1)
+    {
+        dispatch_network_stack();
+        service_log(LOG_DRAIN_BYTES_PER_CALL);
+
+        if (request_pending)
+        {
+            bench_stream_request_t request = pending_request;
+            struct ip_addr addr = pending_addr;
+            const uint16_t port = pending_port;
+            request_pending = false;
+
+            if (!run_stream(&stream_socket, &request, &addr, port))
+            {
+                dbprintf("Stream %d failed\n", request.header.test_id);
+            }
+        }
+    }
+}
+
+int main()
+{
+    go();
+
+    while (1);
+}
@@ -0,0 +1,795 @@
+/*
+ * Benchmarks the ping processing kernels on a host.
+ *
+ * Usage: dsp_bench [-f capture.csv] [-n samples] [-r repeats]
+ *                  [-s sampling frequency] [-t threshold] [-p ping frequency]
+ *                  [-w baseline] [-c baseline] [-T percent] [-v]
+ *
+ * Captures are the CSV files written by data_receiver.py (extracted from the
+ * zip archive). Without a capture, a synthetic ping is generated.
+ *
+ * -w writes the best time of every kernel to a baseline file, and -c compares
+ * the kernels against a baseline and exits with status 2 if any is slower by
+ * more than its threshold. The thresholds are kept in the baseline and may be
+ * edited there, or all replaced with -T. A baseline is only compared against
+ * the capture it was written from.
+ */
+#define _POSIX_C_SOURCE 199309L
+
+#include "abort.h"
+#include "correlation_util.h"
+#include "db.h"
+#include "fir_filter.h"
+#include "sample_ops.h"
+#include "sliding_correlation.h"
+#include "system_params.h"
+#include "types.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define PI 3.14159265358979323846
+
+/**
+ * The defaults of the synthetic capture.
+ */
+#define DEFAULT_SAMPLING_FREQUENCY 5000000
+#define DEFAULT_CAPTURE_SAMPLES 100000
+#define DEFAULT_REPEATS 20
+
+/**
+ * The capacity of the FIR filter, which is one more than its taps.
+ */
+#define BENCH_FIR_TAPS 1024
+
+/**
+ * The version of the baseline file layout.
+ */
+#define BASELINE_VERSION 1
+
+/**
+ * The offset, ping amplitude, and noise amplitude of the synthetic capture
+ * in ADC counts.
+ */
+#define SYNTHETIC_OFFSET 8192
+#define SYNTHETIC_PING_AMPLITUDE 2000
+#define SYNTHETIC_NOISE_AMPLITUDE 50
+
+/**
+ * The delay of each synthetic channel in samples. The ping arrives at channel
+ * A first.
+ */
+static const int32_t synthetic_delays[4] = {0, 3, 7, 5};
+
+/**
+ * The highpass filter applied by the firmware.
+ */
+static filter_coefficients_t highpass_iir[5] = {
+    {{0.976572753292004, -1.953145506584008, 0.976572753292004,
+        1.000000000000000, -1.998354115074282, 0.998926104509836}},
+    {{0.975206721477597, -1.950413442955194, 0.975206721477597,
+        1.000000000000000, -1.995495119158081, 0.996193697294377}},
+    {{0.972451482822301, -1.944902965644602, 0.972451482822301,
+        1.000000000000000, -1.989660620860693, 0.990750529959661}},
+    {{0.963669622248601, -1.927339244497202, 0.963669622248601,
+        1.000000000000000, -1.970992420143032, 0.973473065140308}},
+    {{0.906313647059524, -1.812627294119048, 0.906313647059524,
+        1.000000000000000, -1.848974099452832, 0.860723515924862}}};
+
+/**
+ * Defines the timing of a kernel over every repetition.
+ */
+typedef struct kernel_timing_t
+{
+    const char *name;
+    size_t samples;
+    uint64_t total_ns;
+    uint64_t best_ns;
+    uint32_t runs;
+} kernel_timing_t;
+
+typedef enum kernel_t
+{
+    KERNEL_NORMALIZE = 0,
+    KERNEL_FILTER,
+    KERNEL_FIR_FILTER,
+    KERNEL_DEINTERLEAVE,
+    KERNEL_TRUNCATE,
+    KERNEL_CORRELATE,
+    KERNEL_CORRELATE_PAIRS,
+    KERNEL_CORRELATE_PHAT,
+    KERNEL_CORRELATE_COARSE,
+    KERNEL_CORRELATE_SLIDING,
+    NUM_KERNELS
+} kernel_t;
+
+static kernel_timing_t timings[NUM_KERNELS] = {
+    {"normalize"},
+    {"filter"},
+    {"fir_filter"},
+    {"deinterleave"},
+    {"truncate"},
+    {"cross_correlate"},
+    {"cross_correlate_pairs"},
+    {"cross_correlate_phat"},
+    {"cross_correlate_coarse"},
+    {"slide_correlation"}};
+
+/**
+ * The slowdown of each kernel, in percent of its baseline, that is reported
+ * as a regression. Kernels that only stream memory once vary more from run
+ * to run than those bound by arithmetic.
+ */
+static const uint32_t kernel_thresholds[NUM_KERNELS] = {15, 10, 10, 15, 15, 10, 10, 10, 10, 10};
+
+/**
+ * Reads the monotonic clock.
+ *
+ * @return The current time in nanoseconds.
+ */
+static uint64_t now_ns()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000ull + time.tv_nsec;
+}
+
+/**
+ * Records one run of a kernel.
+ *
+ * @param kernel The kernel that was run.
+ * @param samples The number of samples processed.
+ * @param start The time the kernel started.
+ *
+ * @return None.
+ */
+static void record_timing(const kernel_t kernel, const size_t samples, const uint64_t start)
+{
+    const uint64_t elapsed = now_ns() - start;
+    kernel_timing_t *timing = &timings[kernel];
+    timing->samples = samples;
+    timing->total_ns += elapsed;
+    if (timing->runs == 0 || elapsed < timing->best_ns)
+    {
+        timing->best_ns = elapsed;
+    }
+    timing->runs++;
+}
+
+/**
+ * Generates a capture with a ping in the middle on top of an offset and
+ * uniform noise.
+ *
+ * @param[out] data The samples to generate.
+ * @param len The number of samples.
+ * @param ping_frequency The frequency of the ping in Hz.
+ * @param sampling_frequency The sampling frequency in Hz.
+ *
+ * @return Success or fail.
+ */
+static result_t generate_capture(sample_t *data,
+                                 const size_t len,
+                                 const uint32_t ping_frequency,
+                                 const uint32_t sampling_frequency)
+{
+    AbortIfNot(data, fail);
+    AbortIfNot(sampling_frequency, fail);
+
+    const size_t ping_start = len / 2;
+    const float w = 2 * PI * (float)((ping_frequency)? ping_frequency : INITIAL_PING_FREQUENCY_HZ) /
+        sampling_frequency;
+
+    srand(1);
+    for (size_t i = 0; i < len; ++i)
+    {
+        for (size_t k = 0; k < 4; ++k)
+        {
+            const int32_t n = (int32_t)i - (int32_t)ping_start - synthetic_delays[k];
+            float value = SYNTHETIC_OFFSET;
+            value += SYNTHETIC_NOISE_AMPLITUDE * (2 * (float)rand() / RAND_MAX - 1);
+            if (n >= 0)
+            {
+                value += SYNTHETIC_PING_AMPLITUDE * sinf(w * n);
+            }
+
+            data[i].sample[k] = lroundf(value);
+        }
+    }
+
+    return success;
+}
+
+/**
+ * Loads a capture written by data_receiver.py.
+ *
+ * @param filename The CSV file to read.
+ * @param[out] data The samples, which are allocated and owned by the caller.
+ * @param[out] len The number of samples.
+ *
+ * @return Success or fail.
+ */
+static result_t load_capture(const char *filename, sample_t **data, size_t *len)
+{
+    AbortIfNot(filename, fail);
+    AbortIfNot(data, fail);
+    AbortIfNot(len, fail);
+
+    FILE *file = fopen(filename, "r");
+    AbortIfNot(file, fail);
+
+    size_t capacity = DEFAULT_CAPTURE_SAMPLES;
+    *len = 0;
+    *data = malloc(capacity * sizeof(sample_t));
+    AbortIfNot(*data, fail);
+
+    char line[128];
+    while (fgets(line, sizeof(line), file))
+    {
+        int number, channels[4];
+        if (sscanf(line, "%d, %d, %d, %d, %d", &number, &channels[0], &channels[1],
+                   &channels[2], &channels[3]) != 5)
+        {
+            /*
+             * Skip the header.
+             */
+            continue;
+        }
+
+        if (*len == capacity)
+        {
+            capacity *= 2;
+            sample_t *grown = realloc(*data, capacity * sizeof(sample_t));
+            AbortIfNot(grown, fail);
+            *data = grown;
+        }
+
+        for (size_t k = 0; k < 4; ++k)
+        {
+            (*data)[*len].sample[k] = channels[k];
+        }
+        (*len)++;
+    }
+
+    fclose(file);
+
+    AbortIfNot(*len, fail);
+
+    return success;
+}
+
+/**
+ * Prints the timing of every kernel that ran.
+ *
+ * @return None.
+ */
+static void print_timings()
+{
+    printf("%-24s %10s %8s %14s %14s\n", "kernel", "samples", "runs", "mean ns/sample", "best ns/sample");
+    for (size_t i = 0; i < NUM_KERNELS; ++i)
+    {
+        const kernel_timing_t *timing = &timings[i];
+        if (timing->runs == 0 || timing->samples == 0)
+        {
+            continue;
+        }
+
+        const double mean = (double)timing->total_ns / timing->runs / timing->samples;
+        const double best = (double)timing->best_ns / timing->samples;
+        printf("%-24s %10zu %8u %14.3f %14.3f\n", timing->name, timing->samples, timing->runs, mean, best);
+    }
+}
+
+/**
+ * Hashes the samples of a capture with 64-bit FNV-1a, so that a baseline is
+ * only compared against the capture it was measured on.
+ *
+ * @param data The samples.
+ * @param len The number of samples.
+ *
+ * @return The hash.
+ */
+static uint64_t hash_capture(const sample_t *data, const size_t len)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < len * sizeof(sample_t); ++i)
+    {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+
+    return hash;
+}
+
+/**
+ * Writes the best time of every kernel that ran to a baseline file.
+ *
+ * @param filename The baseline file to write.
+ * @param hash The hash of the capture.
+ * @param len The number of samples in the capture.
+ * @param sampling_frequency The sampling frequency of the capture.
+ *
+ * @return Success or fail.
+ */
+static result_t write_baseline(const char *filename,
+                               const uint64_t hash,
+                               const size_t len,
+                               const uint32_t sampling_frequency)
+{
+    FILE *file = fopen(filename, "w");
+    AbortIfNot(file, fail);
+
+    fprintf(file, "# dsp_bench baseline: kernel, samples, best ns/sample, threshold percent\n");
+    fprintf(file, "version %d\n", BASELINE_VERSION);
+    fprintf(file, "capture %016llx %zu %u\n", (unsigned long long)hash, len, sampling_frequency);
+    for (size_t i = 0; i < NUM_KERNELS; ++i)
+    {
+        const kernel_timing_t *timing = &timings[i];
+        if (timing->runs == 0 || timing->samples == 0)
+        {
+            continue;
+        }
+
+        fprintf(file, "kernel %s %zu %.4f %u\n",
+                timing->name,
+                timing->samples,
+                (double)timing->best_ns / timing->samples,
+                kernel_thresholds[i]);
+    }
+
+    AbortIfNot(fclose(file) == 0, fail);
+
+    return success;
+}
+
+/**
+ * Compares the best time of every kernel that ran against a baseline file and
+ * prints the change of each.
+ *
+ * @param filename The baseline file to read.
+ * @param hash The hash of the capture.
+ * @param len The number of samples in the capture.
+ * @param sampling_frequency The sampling frequency of the capture.
+ * @param threshold_override The threshold in percent that replaces those of
+ *        the baseline, or a negative value to keep them.
+ * @param[out] regressions The number of kernels slower than their threshold
+ *             allows.
+ *
+ * @return Success or fail.
+ */
+static result_t compare_baseline(const char *filename,
+                                 const uint64_t hash,
+                                 const size_t len,
+                                 const uint32_t sampling_frequency,
+                                 const int threshold_override,
+                                 size_t *regressions)
+{
+    FILE *file = fopen(filename, "r");
+    AbortIfNot(file, fail);
+
+    *regressions = 0;
+    bool compared[NUM_KERNELS] = {false};
+    bool matched_capture = false;
+
+    printf("%-24s %14s %14s %9s %9s\n", "kernel", "baseline ns", "current ns", "delta", "limit");
+
+    char line[256];
+    while (fgets(line, sizeof(line), file))
+    {
+        int version = 0;
+        unsigned long long baseline_hash = 0;
+        size_t baseline_len = 0;
+        unsigned int baseline_frequency = 0;
+        char name[64];
+        size_t samples = 0;
+        double baseline_ns = 0;
+        unsigned int threshold = 0;
+
+        if (line[0] == '#')
+        {
+            continue;
+        }
+        else if (sscanf(line, "version %d", &version) == 1)
+        {
+            AbortIfNot(version == BASELINE_VERSION, fail);
+        }
+        else if (sscanf(line, "capture %llx %zu %u", &baseline_hash, &baseline_len, &baseline_frequency) == 3)
+        {
+            if (baseline_hash != hash || baseline_len != len || baseline_frequency != sampling_frequency)
+            {
+                fprintf(stderr, "The baseline was measured on a different capture.\n");
+                fclose(file);
+                return fail;
+            }
+
+            matched_capture = true;
+        }
+        else if (sscanf(line, "kernel %63s %zu %lf %u", name, &samples, &baseline_ns, &threshold) == 4)
+        {
+            AbortIfNot(matched_capture, fail);
+
+            size_t k = 0;
+            while (k < NUM_KERNELS && strcmp(timings[k].name, name) != 0)
+            {
+                k++;
+            }
+
+            const kernel_timing_t *timing = (k < NUM_KERNELS)? &timings[k] : NULL;
+            if (!timing || timing->runs == 0 || timing->samples != samples || baseline_ns <= 0)
+            {
+                printf("%-24s %14.3f %14s %9s %9s\n", name, baseline_ns, "-", "-", "-");
+                continue;
+            }
+
+            compared[k] = true;
+            const double limit = (threshold_override >= 0)? threshold_override : threshold;
+            const double current_ns = (double)timing->best_ns / timing->samples;
+            const double delta = 100 * (current_ns - baseline_ns) / baseline_ns;
+            const bool regressed = (delta > limit)? true : false;
+            if (regressed)
+            {
+                (*regressions)++;
+            }
+
+            printf("%-24s %14.3f %14.3f %+8.1f%% %8.0f%%%s\n",
+                   name, baseline_ns, current_ns, delta, limit,
+                   (regressed)? "  REGRESSED" : "");
+        }
+    }
+
+    fclose(file);
+    AbortIfNot(matched_capture, fail);
+
+    for (size_t i = 0; i < NUM_KERNELS; ++i)
+    {
+        if (!compared[i] && timings[i].runs)
+        {
+            printf("%-24s %14s %14.3f %9s %9s\n",
+                   timings[i].name, "-", (double)timings[i].best_ns / timings[i].samples, "-", "-");
+        }
+    }
+
+    return success;
+}
+
+int main(int argc, char **argv)
+{
+    const char *filename = NULL;
+    const char *write_filename = NULL;
+    const char *compare_filename = NULL;
+    int threshold_override = -1;
+    size_t len = DEFAULT_CAPTURE_SAMPLES;
+    uint32_t repeats = DEFAULT_REPEATS;
+    uint32_t sampling_frequency = DEFAULT_SAMPLING_FREQUENCY;
+
+    HydroZynqParams params;
+    memset(&params, 0, sizeof(params));
+    params.ping_threshold = INITIAL_ADC_THRESHOLD;
+    params.ping_frequency = INITIAL_PING_FREQUENCY_HZ;
+    params.pre_ping_duration = (tick_t)CPU_CLOCK_HZ / 1000000 * 100;
+    params.post_ping_duration = (tick_t)CPU_CLOCK_HZ / 1000000 * 50;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-v") == 0)
+        {
+            set_log_level(LOG_DEBUG);
+            continue;
+        }
+
+        if (i + 1 >= argc)
+        {
+            fprintf(stderr, "Missing value for %s\n", argv[i]);
+            return 1;
+        }
+
+        const char *value = argv[++i];
+        if (strcmp(argv[i - 1], "-f") == 0)
+        {
+            filename = value;
+        }
+        else if (strcmp(argv[i - 1], "-n") == 0)
+        {
+            len = strtoul(value, NULL, 0);
+        }
+        else if (strcmp(argv[i - 1], "-r") == 0)
+        {
+            repeats = strtoul(value, NULL, 0);
+        }
+        else if (strcmp(argv[i - 1], "-s") == 0)
+        {
+            sampling_frequency = strtoul(value, NULL, 0);
+        }
+        else if (strcmp(argv[i - 1], "-t") == 0)
+        {
+            params.ping_threshold = strtol(value, NULL, 0);
+        }
+        else if (strcmp(argv[i - 1], "-p") == 0)
+        {
+            params.ping_frequency = strtoul(value, NULL, 0);
+        }
+        else if (strcmp(argv[i - 1], "-w") == 0)
+        {
+            write_filename = value;
+        }
+        else if (strcmp(argv[i - 1], "-c") == 0)
+        {
+            compare_filename = value;
+        }
+        else if (strcmp(argv[i - 1], "-T") == 0)
+        {
+            threshold_override = strtol(value, NULL, 0);
+        }
+        else
+        {
+            fprintf(stderr, "Unknown option %s\n", argv[i - 1]);
+            return 1;
+        }
+    }
+
+    sample_t *capture = NULL;
+    if (filename)
+    {
+        AbortIfNot(load_capture(filename, &capture, &len), 1);
+    }
+    else
+    {
+        AbortIfNot(len, 1);
+        capture = malloc(len * sizeof(sample_t));
+        AbortIfNot(capture, 1);
+        AbortIfNot(generate_capture(capture, len, params.ping_frequency, sampling_frequency), 1);
+    }
+    const uint64_t capture_hash = hash_capture(capture, len);
+
+    /*
+     * Every repetition processes a fresh copy because the kernels work in
+     * place.
+     */
+    sample_t *data = malloc(len * sizeof(sample_t));
+    AbortIfNot(data, 1);
+
+    planar_samples_t planar;
+    planar.capacity = len;
+    planar.len = 0;
+    for (size_t k = 0; k < 4; ++k)
+    {
+        planar.channel[k] = malloc(len * sizeof(analog_sample_t));
+        AbortIfNot(planar.channel[k], 1);
+    }
+
+    const size_t correlation_len = correlation_capacity(sampling_frequency);
+    correlation_t *correlations = malloc(correlation_len * sizeof(correlation_t));
+    correlation_t *cross_correlations = malloc(correlation_len * sizeof(correlation_t));
+    AbortIfNot(correlations, 1);
+    AbortIfNot(cross_correlations, 1);
+
+    /*
+     * The sliding correlation is fed the whole window, so that it slides over
+     * its last power of two samples.
+     */
+    sliding_correlation_t sliding;
+    sample_t *sliding_history = malloc(len * sizeof(sample_t));
+    int64_t *sliding_sums = malloc(SLIDING_CORRELATION_SUMS(correlation_max_shift(sampling_frequency)) *
+                                   sizeof(int64_t));
+    AbortIfNot(sliding_history, 1);
+    AbortIfNot(sliding_sums, 1);
+
+    /*
+     * The FIR filter is a sharp bandpass around the ping, which is the kind
+     * of filter that is too long to run as biquads.
+     */
+    fir_filter_t fir;
+    float *fir_taps = malloc(BENCH_FIR_TAPS * sizeof(float));
+    complex_t *fir_spectrum = malloc(FIR_FILTER_FFT_LEN(BENCH_FIR_TAPS) * sizeof(complex_t));
+    complex_t *fir_work = malloc(2 * FIR_FILTER_FFT_LEN(BENCH_FIR_TAPS) * sizeof(complex_t));
+    complex_t *fir_history = malloc(2 * BENCH_FIR_TAPS * sizeof(complex_t));
+    AbortIfNot(fir_taps && fir_spectrum && fir_work && fir_history, 1);
+    AbortIfNot(init_fir_filter(&fir,
+                               fir_spectrum,
+                               fir_work,
+                               fir_history,
+                               BENCH_FIR_TAPS,
+                               FIR_FILTER_FFT_LEN(BENCH_FIR_TAPS)), 1);
+    const uint32_t fir_center_hz = (params.ping_frequency)? params.ping_frequency : INITIAL_PING_FREQUENCY_HZ;
+    AbortIfNot(design_fir_bandpass(fir_taps,
+                                   BENCH_FIR_TAPS - 1,
+                                   fir_center_hz - PINGER_BANDWIDTH_HZ / 2,
+                                   fir_center_hz + PINGER_BANDWIDTH_HZ / 2,
+                                   sampling_frequency), 1);
+    AbortIfNot(set_fir_taps(&fir, fir_taps, BENCH_FIR_TAPS - 1), 1);
+
+    bool located = false;
+    correlation_result_t result, phat_result, coarse_result, sliding_result;
+    bool slid = false;
+    for (uint32_t r = 0; r < repeats; ++r)
+    {
+        memcpy(data, capture, len * sizeof(sample_t));
+
+        uint64_t start = now_ns();
+        AbortIfNot(normalize(data, len), 1);
+        record_timing(KERNEL_NORMALIZE, len, start);
+
+        start = now_ns();
+        AbortIfNot(filter(data, len, highpass_iir, 5), 1);
+        record_timing(KERNEL_FILTER, len, start);
+
+        memcpy(data, capture, len * sizeof(sample_t));
+        AbortIfNot(normalize(data, len), 1);
+        start = now_ns();
+        AbortIfNot(apply_fir_filter(&fir, data, len), 1);
+        record_timing(KERNEL_FIR_FILTER, len, start);
+
+        /*
+         * The ping is located and correlated on the unfiltered capture, as
+         * the firmware does by default.
+         */
+        memcpy(data, capture, len * sizeof(sample_t));
+        AbortIfNot(normalize(data, len), 1);
+
+        start = now_ns();
+        AbortIfNot(deinterleave_samples(data, len, &planar), 1);
+        record_timing(KERNEL_DEINTERLEAVE, len, start);
+
+        channel_view_t view;
+        interleaved_view(data, len, &view);
+
+        size_t start_index = 0, end_index = 0;
+        start = now_ns();
+        AbortIfNot(truncate_channels(&view, &start_index, &end_index, NULL, &located, NULL, params, NULL, sampling_frequency), 1);
+        record_timing(KERNEL_TRUNCATE, (located)? end_index : len, start);
+
+        if (!located || end_index <= start_index)
+        {
+            continue;
+        }
+
+        const size_t window_len = end_index - start_index;
+        interleaved_view(&data[start_index], window_len, &view);
+
+        size_t num_correlations = 0;
+        start = now_ns();
+        AbortIfNot(cross_correlate_pairs(&view,
+                                         0,
+                                         NULL,
+                                         correlations,
+                                         NULL,
+                                         correlation_len,
+                                         &num_correlations,
+                                         &result,
+                                         sampling_frequency), 1);
+        record_timing(KERNEL_CORRELATE, window_len, start);
+
+        start = now_ns();
+        AbortIfNot(cross_correlate_pairs(&view,
+                                         0,
+                                         NULL,
+                                         correlations,
+                                         cross_correlations,
+                                         correlation_len,
+                                         &num_correlations,
+                                         &result,
+                                         sampling_frequency), 1);
+        record_timing(KERNEL_CORRELATE_PAIRS, window_len, start);
+
+        correlation_weighting_t weighting;
+        HydroZynqParams phat_params = params;
+        phat_params.phat = true;
+        get_correlation_weighting(&phat_params, &weighting);
+
+        start = now_ns();
+        AbortIfNot(cross_correlate_pairs(&view,
+                                         0,
+                                         &weighting,
+                                         correlations,
+                                         NULL,
+                                         correlation_len,
+                                         &num_correlations,
+                                         &phat_result,
+                                         sampling_frequency), 1);
+        record_timing(KERNEL_CORRELATE_PHAT, window_len, start);
+
+        HydroZynqParams coarse_params = params;
+        coarse_params.coarse_search = true;
+        get_correlation_weighting(&coarse_params, &weighting);
+
+        start = now_ns();
+        AbortIfNot(cross_correlate_pairs(&view,
+                                         0,
+                                         &weighting,
+                                         correlations,
+                                         NULL,
+                                         correlation_len,
+                                         &num_correlations,
+                                         &coarse_result,
+                                         sampling_frequency), 1);
+        record_timing(KERNEL_CORRELATE_COARSE, window_len, start);
+
+        size_t sliding_window = 1;
+        while (sliding_window * 2 <= window_len)
+        {
+            sliding_window *= 2;
+        }
+
+        int32_t sliding_shift = correlation_max_shift(sampling_frequency);
+        if (sliding_shift > (int32_t)sliding_window - 1)
+        {
+            sliding_shift = sliding_window - 1;
+        }
+
+        if (sliding_shift > 0)
+        {
+            AbortIfNot(init_sliding_correlation(&sliding,
+                                                sliding_history,
+                                                sliding_window,
+                                                sliding_sums,
+                                                sliding_shift), 1);
+
+            start = now_ns();
+            AbortIfNot(slide_correlation(&sliding, &view), 1);
+            record_timing(KERNEL_CORRELATE_SLIDING, window_len, start);
+
+            channel_view_t sliding_view;
+            interleaved_view(&data[end_index - sliding_window], sliding_window, &sliding_view);
+            AbortIfNot(get_sliding_correlations(&sliding, correlations, correlation_len, &num_correlations), 1);
+            AbortIfNot(evaluate_correlations(&sliding_view,
+                                             correlations,
+                                             num_correlations,
+                                             NULL,
+                                             &sliding_result,
+                                             sampling_frequency), 1);
+            slid = true;
+        }
+    }
+
+    printf("Capture: %zu samples at %u Hz, %u repetitions\n", len, sampling_frequency, repeats);
+    if (located)
+    {
+        printf("Delays: %d %d %d ns\n",
+               result.channel_delay_ns[0], result.channel_delay_ns[1], result.channel_delay_ns[2]);
+        printf("PHAT delays: %d %d %d ns\n",
+               phat_result.channel_delay_ns[0], phat_result.channel_delay_ns[1], phat_result.channel_delay_ns[2]);
+        printf("Coarse delays: %d %d %d ns\n",
+               coarse_result.channel_delay_ns[0], coarse_result.channel_delay_ns[1], coarse_result.channel_delay_ns[2]);
+        if (slid)
+        {
+            printf("Sliding delays: %d %d %d ns\n",
+                   sliding_result.channel_delay_ns[0],
+                   sliding_result.channel_delay_ns[1],
+                   sliding_result.channel_delay_ns[2]);
+        }
+    }
+    else
+    {
+        printf("No ping was located.\n");
+    }
+
+    print_timings();
+
+    if (write_filename)
+    {
+        AbortIfNot(write_baseline(write_filename, capture_hash, len, sampling_frequency), 1);
+        printf("Baseline written to %s\n", write_filename);
+    }
+
+    if (compare_filename)
+    {
+        size_t regressions = 0;
+        AbortIfNot(compare_baseline(compare_filename,
+                                    capture_hash,
+                                    len,
+                                    sampling_frequency,
+                                    threshold_override,
+                                    &regressions), 1);
+        if (regressions)
+        {
+            printf("%zu kernels regressed.\n", regressions);
+            return 2;
+        }
+
+        printf("No kernel regressed.\n");
+    }
+
+    return 0;
+}
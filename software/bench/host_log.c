@@ -0,0 +1,57 @@
+#include "db.h"
+
+#include "types.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+
+/**
+ * The least severe level that is printed. Kernel messages are hidden by
+ * default so that they do not disturb the timing.
+ */
+static log_level_t log_level = LOG_ERROR;
+
+/**
+ * Sets the least severe level that is printed.
+ *
+ * @param level The level to print at.
+ *
+ * @return None.
+ */
+void set_log_level(const log_level_t level)
+{
+    log_level = level;
+}
+
+/**
+ * Prints a message to the standard error stream.
+ *
+ * @param level The level of the message.
+ * @param fmt The format of the message.
+ * @param args The arguments of the message.
+ *
+ * @return None.
+ */
+static void log_message(const log_level_t level, char fmt[], va_list args)
+{
+    if (level <= log_level)
+    {
+        vfprintf(stderr, fmt, args);
+    }
+}
+
+void dbprintf(char fmt[], ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    log_message(LOG_INFO, fmt, args);
+    va_end(args);
+}
+
+void dblog_message(const log_level_t level, char fmt[], ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    log_message(level, fmt, args);
+    va_end(args);
+}
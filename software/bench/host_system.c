@@ -0,0 +1,44 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include "profile.h"
+#include "system.h"
+#include "system_params.h"
+#include "types.h"
+
+#include <time.h>
+
+/**
+ * Reads the monotonic clock in place of the global timer.
+ *
+ * @return The current time in CPU ticks.
+ */
+tick_t get_system_time()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (tick_t)time.tv_sec * CPU_CLOCK_HZ + (tick_t)time.tv_nsec * CPU_CLOCK_HZ / 1000000000ull;
+}
+
+/**
+ * Stands in for the profiler, which reads the counters of the Cortex-A9.
+ * Host tools time their stages themselves.
+ *
+ * @param mark Unused.
+ *
+ * @return None.
+ */
+void profile_begin(profile_mark_t *mark)
+{
+}
+
+/**
+ * Stands in for the profiler.
+ *
+ * @param stage Unused.
+ * @param mark Unused.
+ *
+ * @return None.
+ */
+void profile_end(const profile_stage_t stage, const profile_mark_t *mark)
+{
+}
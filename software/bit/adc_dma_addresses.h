@@ -7,6 +7,23 @@
 
 #define ADC_BASE_ADDRESS 0x43c10000
 
+#define ENCODE_CLOCK_BASE_ADDRESS 0x43c20000
+
 #define DMA_BASE_ADDRESS 0x40400000
 
+#define DMA_S2MM_IRQ_ID 61
+
+/*
+ * The width of the DMA buffer length register, set by c_sg_length_width.
+ */
+#define DMA_LENGTH_WIDTH 23
+
+/*
+ * The longest S2MM burst in beats, set by s2mm_burst_size, and the HP port
+ * the samples are written through with its width, set by hp_data_width.
+ */
+#define DMA_S2MM_BURST_SIZE 64
+#define DMA_HP_PORT 0
+#define DMA_HP_DATA_WIDTH 64
+
 #endif
@@ -0,0 +1,385 @@
+#define _GNU_SOURCE
+
+#include "capture_file.h"
+
+#include "abort.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Writes the header and index so that the file is complete.
+ *
+ * @param capture The capture file.
+ *
+ * @return Success or fail.
+ */
+static result_t write_capture_index(capture_file_t *capture)
+{
+    AbortIf(fseek(capture->file, capture->header.index_offset, SEEK_SET) != 0, fail);
+    AbortIfNot(fwrite(capture->pings, sizeof(capture_file_ping_t), capture->header.num_pings, capture->file) ==
+               capture->header.num_pings, fail);
+
+    AbortIf(fseek(capture->file, 0, SEEK_SET) != 0, fail);
+    AbortIfNot(fwrite(&capture->header, sizeof(capture->header), 1, capture->file) == 1, fail);
+    AbortIf(fflush(capture->file) != 0, fail);
+
+    return success;
+}
+
+/**
+ * Adds the index entry of a ping whose samples follow the last ping.
+ *
+ * @param capture The capture file.
+ * @param count The number of samples of the ping.
+ * @param ping The index entry of the ping. Its first sample is assigned.
+ *
+ * @return Success or fail.
+ */
+static result_t add_capture_index_entry(capture_file_t *capture, const size_t count, const capture_file_ping_t *ping)
+{
+    if (capture->header.num_pings == capture->capacity)
+    {
+        const size_t capacity = (capture->capacity)? capture->capacity * 2 : 64;
+        capture_file_ping_t *pings = realloc(capture->pings, capacity * sizeof(capture_file_ping_t));
+        AbortIfNot(pings, fail);
+        capture->pings = pings;
+        capture->capacity = capacity;
+    }
+
+    capture_file_ping_t *entry = &capture->pings[capture->header.num_pings++];
+    *entry = *ping;
+    entry->first_sample = capture->header.total_samples;
+    entry->sample_count = count;
+
+    capture->header.total_samples += count;
+    capture->header.index_offset += count * sizeof(sample_t);
+
+    return success;
+}
+
+/**
+ * Creates a capture file without any pings.
+ *
+ * @param[out] capture The capture file.
+ * @param filename The file to create.
+ * @param header The header of the file, which is initialized by
+ *        init_capture_file_header().
+ *
+ * @return Success or fail.
+ */
+result_t create_capture_file(capture_file_t *capture, const char *filename, const capture_file_header_t *header)
+{
+    AbortIfNot(capture, fail);
+    AbortIfNot(filename, fail);
+    AbortIfNot(header, fail);
+
+    memset(capture, 0, sizeof(*capture));
+    capture->header = *header;
+    capture->header.total_samples = 0;
+    capture->header.num_pings = 0;
+    capture->header.index_offset = CAPTURE_FILE_HEADER_BYTES;
+
+    capture->file = fopen(filename, "w+b");
+    AbortIfNot(capture->file, fail);
+
+    return write_capture_index(capture);
+}
+
+/**
+ * Appends a ping to a capture file.
+ *
+ * @note The index is rewritten after the samples, so the file is complete
+ *       after every ping.
+ *
+ * @param capture The capture file.
+ * @param samples The samples of the ping.
+ * @param count The number of samples.
+ * @param ping The index entry of the ping. Its first sample is assigned.
+ *
+ * @return Success or fail.
+ */
+result_t append_capture_ping(capture_file_t *capture,
+                             const sample_t *samples,
+                             const size_t count,
+                             const capture_file_ping_t *ping)
+{
+    AbortIfNot(capture, fail);
+    AbortIfNot(capture->file, fail);
+    AbortIfNot(samples, fail);
+    AbortIfNot(ping, fail);
+
+    AbortIf(capture->mapping, fail);
+
+    /*
+     * The samples overwrite the old index, which follows the last ping.
+     */
+    AbortIf(fseek(capture->file, capture->header.index_offset, SEEK_SET) != 0, fail);
+    AbortIfNot(fwrite(samples, sizeof(sample_t), count, capture->file) == count, fail);
+    AbortIfNot(add_capture_index_entry(capture, count, ping), fail);
+
+    return write_capture_index(capture);
+}
+
+/**
+ * Maps the space of the next ping of a capture file so that its samples may
+ * be received straight into the file.
+ *
+ * @note Only one ping may be mapped at a time. The samples are zero until
+ *       they are written, and the ping is appended by commit_capture_ping().
+ *
+ * @param capture The capture file.
+ * @param count The number of samples of the ping.
+ * @param[out] samples The samples of the ping within the mapping.
+ *
+ * @return Success or fail.
+ */
+result_t map_capture_ping(capture_file_t *capture, const size_t count, sample_t **samples)
+{
+    AbortIfNot(capture, fail);
+    AbortIfNot(capture->file, fail);
+    AbortIfNot(samples, fail);
+    AbortIfNot(count, fail);
+    AbortIf(capture->mapping, fail);
+
+    AbortIf(fflush(capture->file) != 0, fail);
+    const int fd = fileno(capture->file);
+
+    struct stat status;
+    AbortIf(fstat(fd, &status) != 0, fail);
+
+    /*
+     * The samples take the place of the index, which is written again after
+     * them once the ping is committed.
+     */
+    const uint64_t offset = capture->header.index_offset;
+    const size_t bytes = count * sizeof(sample_t);
+    if ((uint64_t)status.st_size < offset + bytes)
+    {
+        AbortIf(ftruncate(fd, offset + bytes) != 0, fail);
+    }
+
+    const uint64_t page = sysconf(_SC_PAGESIZE);
+    const uint64_t start = offset - offset % page;
+    capture->mapping_bytes = offset - start + bytes;
+    void *mapping = mmap(NULL, capture->mapping_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, start);
+    AbortIf(mapping == MAP_FAILED, fail);
+
+    capture->mapping = mapping;
+    capture->mapped_samples = count;
+    *samples = (sample_t *)((uint8_t *)mapping + (offset - start));
+
+    /*
+     * Only the space that the file already held may not be zero.
+     */
+    if ((uint64_t)status.st_size > offset)
+    {
+        const uint64_t stale = status.st_size - offset;
+        memset(*samples, 0, (stale < bytes)? stale : bytes);
+    }
+
+    return success;
+}
+
+/**
+ * Unmaps the ping being received into a capture file.
+ *
+ * @param capture The capture file.
+ *
+ * @return Success or fail.
+ */
+static result_t unmap_capture_ping(capture_file_t *capture)
+{
+    const bool unmapped = (munmap(capture->mapping, capture->mapping_bytes) == 0)? true : false;
+    capture->mapping = NULL;
+    capture->mapping_bytes = 0;
+    capture->mapped_samples = 0;
+
+    return (unmapped)? success : fail;
+}
+
+/**
+ * Appends the ping mapped by map_capture_ping() to a capture file.
+ *
+ * @param capture The capture file.
+ * @param ping The index entry of the ping. Its first sample is assigned.
+ *
+ * @return Success or fail.
+ */
+result_t commit_capture_ping(capture_file_t *capture, const capture_file_ping_t *ping)
+{
+    AbortIfNot(capture, fail);
+    AbortIfNot(capture->file, fail);
+    AbortIfNot(capture->mapping, fail);
+    AbortIfNot(ping, fail);
+
+    const size_t count = capture->mapped_samples;
+    AbortIfNot(unmap_capture_ping(capture), fail);
+    AbortIfNot(add_capture_index_entry(capture, count, ping), fail);
+
+    return write_capture_index(capture);
+}
+
+/**
+ * Releases the ping mapped by map_capture_ping() without appending it.
+ *
+ * @param capture The capture file.
+ *
+ * @return Success or fail.
+ */
+result_t discard_capture_ping(capture_file_t *capture)
+{
+    AbortIfNot(capture, fail);
+    AbortIfNot(capture->mapping, fail);
+
+    return unmap_capture_ping(capture);
+}
+
+/**
+ * Closes a capture file.
+ *
+ * @param capture The capture file.
+ *
+ * @return Success or fail.
+ */
+result_t close_capture_file(capture_file_t *capture)
+{
+    AbortIfNot(capture, fail);
+    AbortIfNot(capture->file, fail);
+
+    if (capture->mapping)
+    {
+        unmap_capture_ping(capture);
+    }
+
+    const bool closed = (fclose(capture->file) == 0)? true : false;
+    capture->file = NULL;
+    free(capture->pings);
+    capture->pings = NULL;
+
+    return (closed)? success : fail;
+}
+
+/**
+ * Reads a whole range of a file.
+ *
+ * @param fd The file.
+ * @param data The memory to read into.
+ * @param len The number of bytes to read.
+ * @param offset The offset in the file to read from.
+ *
+ * @return Success or fail.
+ */
+static result_t read_range(const int fd, void *data, const size_t len, const uint64_t offset)
+{
+    size_t done = 0;
+    while (done < len)
+    {
+        const ssize_t ret = pread(fd, (uint8_t *)data + done, len - done, offset + done);
+        AbortIfNot(ret > 0, fail);
+        done += ret;
+    }
+
+    return success;
+}
+
+/**
+ * Opens a capture file and reads its header and ping index.
+ *
+ * @param[out] capture The capture file.
+ * @param filename The file to open.
+ *
+ * @return Success or fail.
+ */
+result_t open_capture_file(capture_reader_t *capture, const char *filename)
+{
+    AbortIfNot(capture, fail);
+    AbortIfNot(filename, fail);
+
+    memset(capture, 0, sizeof(*capture));
+    capture->fd = open(filename, O_RDONLY);
+    AbortIfNot(capture->fd >= 0, fail);
+
+    capture_file_header_t *header = &capture->header;
+    if (read_range(capture->fd, header, sizeof(*header), 0) != success ||
+        header->magic != CAPTURE_FILE_MAGIC ||
+        header->version != CAPTURE_FILE_VERSION ||
+        header->header_bytes != CAPTURE_FILE_HEADER_BYTES ||
+        header->channels != 4 ||
+        header->sample_bytes != sizeof(sample_t))
+    {
+        close(capture->fd);
+        capture->fd = -1;
+        return fail;
+    }
+
+    if (header->num_pings)
+    {
+        capture->pings = malloc(header->num_pings * sizeof(capture_file_ping_t));
+        if (!capture->pings ||
+            read_range(capture->fd,
+                       capture->pings,
+                       header->num_pings * sizeof(capture_file_ping_t),
+                       header->index_offset) != success)
+        {
+            close_capture_reader(capture);
+            return fail;
+        }
+    }
+
+    return success;
+}
+
+/**
+ * Reads the samples of a ping of a capture file.
+ *
+ * @param capture The capture file.
+ * @param index The index of the ping.
+ * @param[out] samples The samples of the ping.
+ * @param capacity The number of samples that fit in samples, which must hold
+ *        the sample count of the ping.
+ *
+ * @return Success or fail.
+ */
+result_t read_capture_ping(const capture_reader_t *capture,
+                           const size_t index,
+                           sample_t *samples,
+                           const size_t capacity)
+{
+    AbortIfNot(capture, fail);
+    AbortIfNot(samples, fail);
+    AbortIfNot(index < capture->header.num_pings, fail);
+
+    const capture_file_ping_t *ping = &capture->pings[index];
+    AbortIfNot(ping->sample_count <= capacity, fail);
+    AbortIfNot(ping->first_sample + ping->sample_count <= capture->header.total_samples, fail);
+
+    return read_range(capture->fd,
+                      samples,
+                      ping->sample_count * sizeof(sample_t),
+                      CAPTURE_FILE_HEADER_BYTES + ping->first_sample * sizeof(sample_t));
+}
+
+/**
+ * Closes a capture file opened for reading.
+ *
+ * @param capture The capture file.
+ *
+ * @return Success or fail.
+ */
+result_t close_capture_reader(capture_reader_t *capture)
+{
+    AbortIfNot(capture, fail);
+    AbortIfNot(capture->fd >= 0, fail);
+
+    const bool closed = (close(capture->fd) == 0)? true : false;
+    capture->fd = -1;
+    free(capture->pings);
+    capture->pings = NULL;
+
+    return (closed)? success : fail;
+}
@@ -0,0 +1,64 @@
+#ifndef CAPTURE_FILE_H
+#define CAPTURE_FILE_H
+
+#include "capture_format.h"
+#include "types.h"
+
+#include <stdio.h>
+
+/**
+ * Defines a capture file open for writing.
+ */
+typedef struct capture_file_t
+{
+    FILE *file;
+    capture_file_header_t header;
+
+    capture_file_ping_t *pings;
+    size_t capacity;
+
+    /*
+     * The mapping of the file that a ping is being received into, and the
+     * number of samples it holds.
+     */
+    void *mapping;
+    size_t mapping_bytes;
+    size_t mapped_samples;
+} capture_file_t;
+
+result_t create_capture_file(capture_file_t *capture, const char *filename, const capture_file_header_t *header);
+
+result_t append_capture_ping(capture_file_t *capture,
+                             const sample_t *samples,
+                             const size_t count,
+                             const capture_file_ping_t *ping);
+
+result_t map_capture_ping(capture_file_t *capture, const size_t count, sample_t **samples);
+
+result_t commit_capture_ping(capture_file_t *capture, const capture_file_ping_t *ping);
+
+result_t discard_capture_ping(capture_file_t *capture);
+
+result_t close_capture_file(capture_file_t *capture);
+
+/**
+ * Defines a capture file open for reading. The pings are read with pread()
+ * so that processes sharing the descriptor do not disturb each other.
+ */
+typedef struct capture_reader_t
+{
+    int fd;
+    capture_file_header_t header;
+    capture_file_ping_t *pings;
+} capture_reader_t;
+
+result_t open_capture_file(capture_reader_t *capture, const char *filename);
+
+result_t read_capture_ping(const capture_reader_t *capture,
+                           const size_t index,
+                           sample_t *samples,
+                           const size_t capacity);
+
+result_t close_capture_reader(capture_reader_t *capture);
+
+#endif
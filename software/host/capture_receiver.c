@@ -0,0 +1,1109 @@
+/*
+ * Receives captures from the HydroZynq data stream on a host.
+ *
+ * Usage: capture_receiver [-o capture.hzc] [-a bind address] [-p port]
+ *                         [-m multicast group] [-r hydrozynq address]
+ *                         [-n captures] [-b receive buffer bytes]
+ *                         [-s sampling frequency] [-c clk_div]
+ *                         [-d decimation] [-i interface] [-k cpu] [-v]
+ *
+ * Datagrams are received in batches into a preallocated ring and placed
+ * directly at their sample index. Each completed capture is appended to the
+ * output as a ping of a capture file (see capture_file.h), which
+ * scripts/capture_file.py maps with numpy. Captures are received straight
+ * into the mapped space of their ping. With -r, lost datagrams are requested
+ * again from the HydroZynq, as data_receiver.py --reliable does.
+ *
+ * With -i, frames are instead read from a PACKET_MMAP (TPACKET_V3) ring of
+ * the interface, which the kernel fills without a system call per datagram.
+ * Both the UDP stream and raw sample frames (see raw_frame_header_t) are
+ * received that way, which needs CAP_NET_RAW. Fragmented datagrams are not
+ * reassembled, so jumbo datagrams need a link MTU that holds them. With -k,
+ * the receiver is pinned to a core.
+ */
+#define _GNU_SOURCE
+
+#include "abort.h"
+#include "capture_file.h"
+#include "db.h"
+#include "stream_decode.h"
+#include "stream_format.h"
+#include "types.h"
+
+#include <arpa/inet.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/udp.h>
+#include <poll.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * The ports of the data stream and of retransmit requests.
+ */
+#define DATA_PORT 3001
+#define COMMAND_PORT 3000
+
+/**
+ * The number of datagrams received per system call and the size of each slot
+ * of the receive ring.
+ */
+#define RING_DATAGRAMS 256
+#define RING_SLOT_BYTES 9000
+
+/**
+ * The default socket receive buffer, which holds a whole capture at the
+ * full data stream rate while the receiver is descheduled.
+ */
+#define DEFAULT_RECEIVE_BUFFER_BYTES (64 * 1024 * 1024)
+
+/**
+ * The receive buffer of the stream socket while frames are read from the
+ * packet ring. The socket only keeps the port open and the multicast group
+ * joined, so the datagrams it queues are dropped once it is full.
+ */
+#define PACKET_RING_SOCKET_BUFFER_BYTES 4096
+
+/**
+ * The blocks of the packet ring, which together hold several captures at
+ * the full data stream rate, and the time after which the kernel hands over
+ * a block that is partly filled.
+ */
+#define PACKET_RING_BLOCK_BYTES (1 << 20)
+#define PACKET_RING_BLOCKS 256
+#define PACKET_RING_FRAME_BYTES 2048
+#define PACKET_RING_RETIRE_MS 10
+
+/**
+ * The most datagrams handled in one batch, which covers a block of the
+ * packet ring filled with the shortest stream datagrams.
+ */
+#define BATCH_DATAGRAMS 2048
+
+/**
+ * The sampling frequency recorded in the capture file unless one is given.
+ */
+#define DEFAULT_SAMPLING_FREQUENCY 5000000
+
+/**
+ * The time without datagrams after which a capture is considered complete,
+ * or after which lost datagrams are requested.
+ */
+#define IDLE_TIMEOUT_MS 100
+
+/**
+ * The longest retransmit request accepted by the HydroZynq command buffer.
+ */
+#define MAX_REQUEST_LENGTH 1000
+
+/**
+ * Defines a received datagram of the stream, or a raw sample frame in the
+ * form of one.
+ */
+typedef struct datagram_t
+{
+    /*
+     * Cleared if the datagram is too short to hold a header.
+     */
+    bool valid;
+    bool raw;
+
+    stream_header_t header;
+    const uint8_t *payload;
+    size_t payload_len;
+} datagram_t;
+
+/**
+ * Defines a PACKET_MMAP receive ring and the position reached in it.
+ */
+typedef struct packet_ring_t
+{
+    int sock;
+    uint8_t *map;
+    size_t map_bytes;
+    uint16_t port;
+
+    /*
+     * The block being read, the frames left in it, and the next of them. A
+     * block is returned to the kernel once all of its frames are placed.
+     */
+    uint32_t block;
+    uint32_t frames_left;
+    const uint8_t *frame;
+    bool holding_block;
+
+    uint32_t frames_dropped;
+    uint32_t frames_fragmented;
+} packet_ring_t;
+
+/**
+ * Defines the reassembly state of one capture.
+ */
+typedef struct capture_t
+{
+    uint16_t transfer_id;
+    bool active;
+
+    /*
+     * Set if the capture was received as raw frames, which are not
+     * retransmitted.
+     */
+    bool raw;
+    uint32_t total_samples;
+
+    /*
+     * Delta encoded datagrams each hold a different number of samples, so
+     * completion is tracked by the samples received rather than by packet
+     * number.
+     */
+    sample_t *samples;
+    uint8_t *received;
+    uint32_t covered_samples;
+
+    /*
+     * The samples of each packet number, which is only fixed while every
+     * datagram is sent without encoding. Set once a datagram shows it.
+     */
+    bool encoded;
+    uint32_t samples_per_packet;
+
+    uint32_t unique_packets;
+    uint32_t duplicate_packets;
+    uint32_t malformed_packets;
+    uint32_t reordered_packets;
+    uint32_t resend_requests;
+    int32_t last_packet;
+
+    uint64_t first_ns;
+    uint64_t last_ns;
+} capture_t;
+
+/**
+ * The receive ring. Each batch of datagrams is received into it in place.
+ */
+static uint8_t ring[RING_DATAGRAMS][RING_SLOT_BYTES];
+static struct mmsghdr messages[RING_DATAGRAMS];
+static struct iovec vectors[RING_DATAGRAMS];
+
+/**
+ * The datagrams of the batch being placed.
+ */
+static datagram_t batch[BATCH_DATAGRAMS];
+
+/**
+ * Reads the monotonic clock.
+ *
+ * @return The current time in nanoseconds.
+ */
+static uint64_t now_ns()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000ull + time.tv_nsec;
+}
+
+/**
+ * Opens the data stream socket.
+ *
+ * @param address The address to bind to, or NULL for any.
+ * @param port The port to bind to.
+ * @param group The multicast group to join, or NULL.
+ * @param receive_buffer The requested socket receive buffer in bytes.
+ *
+ * @return The socket, or -1 on failure.
+ */
+static int open_stream_socket(const char *address,
+                              const uint16_t port,
+                              const char *group,
+                              const int receive_buffer)
+{
+    const int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    AbortIf(sock < 0, -1);
+
+    /*
+     * SO_RCVBUFFORCE exceeds net.core.rmem_max when permitted.
+     */
+    if (setsockopt(sock, SOL_SOCKET, SO_RCVBUFFORCE, &receive_buffer, sizeof(receive_buffer)) != 0)
+    {
+        setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &receive_buffer, sizeof(receive_buffer));
+    }
+
+    int granted = 0;
+    socklen_t granted_len = sizeof(granted);
+    getsockopt(sock, SOL_SOCKET, SO_RCVBUF, &granted, &granted_len);
+    if (granted < receive_buffer)
+    {
+        fprintf(stderr, "Receive buffer limited to %d bytes; raise net.core.rmem_max\n", granted);
+    }
+
+    struct sockaddr_in bind_address;
+    memset(&bind_address, 0, sizeof(bind_address));
+    bind_address.sin_family = AF_INET;
+    bind_address.sin_port = htons(port);
+    bind_address.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    if (group)
+    {
+        const int reuse = 1;
+        AbortIf(setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0, -1);
+    }
+    else if (address)
+    {
+        AbortIf(inet_pton(AF_INET, address, &bind_address.sin_addr) != 1, -1);
+    }
+
+    AbortIf(bind(sock, (struct sockaddr *)&bind_address, sizeof(bind_address)) != 0, -1);
+
+    if (group)
+    {
+        struct ip_mreq membership;
+        AbortIf(inet_pton(AF_INET, group, &membership.imr_multiaddr) != 1, -1);
+        membership.imr_interface.s_addr = htonl(INADDR_ANY);
+        if (address)
+        {
+            AbortIf(inet_pton(AF_INET, address, &membership.imr_interface) != 1, -1);
+        }
+        AbortIf(setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) != 0, -1);
+    }
+
+    const struct timeval timeout = {0, IDLE_TIMEOUT_MS * 1000};
+    AbortIf(setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) != 0, -1);
+
+    return sock;
+}
+
+/**
+ * Opens a PACKET_MMAP receive ring on an interface.
+ *
+ * @param[out] packet_ring The ring.
+ * @param interface The name of the interface.
+ * @param port The port of the data stream.
+ *
+ * @return Success or fail.
+ */
+static result_t open_packet_ring(packet_ring_t *packet_ring, const char *interface, const uint16_t port)
+{
+    memset(packet_ring, 0, sizeof(*packet_ring));
+    packet_ring->port = port;
+
+    const int sock = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+    AbortIf(sock < 0, fail);
+    packet_ring->sock = sock;
+
+    const int version = TPACKET_V3;
+    AbortIf(setsockopt(sock, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) != 0, fail);
+
+    struct tpacket_req3 request;
+    memset(&request, 0, sizeof(request));
+    request.tp_block_size = PACKET_RING_BLOCK_BYTES;
+    request.tp_block_nr = PACKET_RING_BLOCKS;
+    request.tp_frame_size = PACKET_RING_FRAME_BYTES;
+    request.tp_frame_nr = PACKET_RING_BLOCK_BYTES / PACKET_RING_FRAME_BYTES * PACKET_RING_BLOCKS;
+    request.tp_retire_blk_tov = PACKET_RING_RETIRE_MS;
+    AbortIf(setsockopt(sock, SOL_PACKET, PACKET_RX_RING, &request, sizeof(request)) != 0, fail);
+
+    /*
+     * The ring is populated up front so that the first capture does not
+     * take page faults in the kernel.
+     */
+    packet_ring->map_bytes = (size_t)PACKET_RING_BLOCK_BYTES * PACKET_RING_BLOCKS;
+    void *map = mmap(NULL, packet_ring->map_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, sock, 0);
+    AbortIf(map == MAP_FAILED, fail);
+    packet_ring->map = map;
+
+    struct sockaddr_ll link;
+    memset(&link, 0, sizeof(link));
+    link.sll_family = AF_PACKET;
+    link.sll_protocol = htons(ETH_P_ALL);
+    link.sll_ifindex = if_nametoindex(interface);
+    AbortIf(link.sll_ifindex == 0, fail);
+    AbortIf(bind(sock, (struct sockaddr *)&link, sizeof(link)) != 0, fail);
+
+    return success;
+}
+
+/**
+ * Closes a packet ring and reports the frames it lost.
+ *
+ * @param packet_ring The ring.
+ *
+ * @return None.
+ */
+static void close_packet_ring(packet_ring_t *packet_ring)
+{
+    struct tpacket_stats_v3 stats;
+    socklen_t stats_len = sizeof(stats);
+    if (getsockopt(packet_ring->sock, SOL_PACKET, PACKET_STATISTICS, &stats, &stats_len) == 0)
+    {
+        packet_ring->frames_dropped += stats.tp_drops;
+    }
+
+    printf("Packet ring: %u frames dropped, %u fragmented datagrams ignored\n",
+           packet_ring->frames_dropped,
+           packet_ring->frames_fragmented);
+
+    munmap(packet_ring->map, packet_ring->map_bytes);
+    close(packet_ring->sock);
+}
+
+/**
+ * Describes a stream datagram by its header and payload.
+ *
+ * @param[out] datagram The datagram.
+ * @param data The datagram as received.
+ * @param len The length of the datagram.
+ *
+ * @return None.
+ */
+static void parse_datagram(datagram_t *datagram, const uint8_t *data, const size_t len)
+{
+    memset(datagram, 0, sizeof(*datagram));
+    if (len < sizeof(datagram->header))
+    {
+        return;
+    }
+
+    memcpy(&datagram->header, data, sizeof(datagram->header));
+    datagram->payload = &data[sizeof(datagram->header)];
+    datagram->payload_len = len - sizeof(datagram->header);
+    datagram->valid = true;
+}
+
+/**
+ * Describes a raw sample frame as the stream datagram that would carry the
+ * same samples.
+ *
+ * @param[out] datagram The datagram.
+ * @param data The frame after its Ethernet header.
+ * @param len The length of the frame after its Ethernet header.
+ *
+ * @return None.
+ */
+static void parse_raw_frame(datagram_t *datagram, const uint8_t *data, const size_t len)
+{
+    memset(datagram, 0, sizeof(*datagram));
+    datagram->raw = true;
+
+    raw_frame_header_t raw;
+    if (len < sizeof(raw))
+    {
+        return;
+    }
+
+    memcpy(&raw, data, sizeof(raw));
+    if (raw.version != RAW_FRAME_VERSION ||
+        raw.offset >= raw.total_bytes ||
+        raw.offset % RAW_FRAME_PAYLOAD_MAX)
+    {
+        return;
+    }
+
+    /*
+     * Short frames are padded to the Ethernet minimum.
+     */
+    size_t payload_len = len - sizeof(raw);
+    if (payload_len > raw.total_bytes - raw.offset)
+    {
+        payload_len = raw.total_bytes - raw.offset;
+    }
+
+    datagram->header.packet_number = raw.offset / RAW_FRAME_PAYLOAD_MAX;
+    datagram->header.first_element = raw.offset / sizeof(sample_t);
+    datagram->header.element_size = sizeof(sample_t);
+    datagram->header.element_count = payload_len / sizeof(sample_t);
+    datagram->header.encoding = STREAM_ENCODING_RAW;
+    datagram->header.transfer_id = raw.transfer_id;
+    datagram->header.total_elements = raw.total_bytes / sizeof(sample_t);
+    datagram->payload = &data[sizeof(raw)];
+    datagram->payload_len = payload_len;
+    datagram->valid = true;
+}
+
+/**
+ * Describes a frame of the packet ring as a stream datagram.
+ *
+ * @param packet_ring The ring.
+ * @param frame The frame.
+ * @param[out] datagram The datagram.
+ *
+ * @return True if the frame is a datagram of the stream or a raw sample
+ *         frame, or false if it is other traffic.
+ */
+static bool parse_frame(packet_ring_t *packet_ring, const struct tpacket3_hdr *frame, datagram_t *datagram)
+{
+    const struct sockaddr_ll *link = (const struct sockaddr_ll *)
+            ((const uint8_t *)frame + TPACKET_ALIGN(sizeof(struct tpacket3_hdr)));
+    if (link->sll_pkttype == PACKET_OUTGOING)
+    {
+        return false;
+    }
+
+    const uint8_t *data = (const uint8_t *)frame + frame->tp_mac;
+    const size_t len = frame->tp_snaplen;
+    if (len < ETH_HLEN)
+    {
+        return false;
+    }
+
+    uint16_t ethertype;
+    memcpy(&ethertype, &data[ETH_ALEN * 2], sizeof(ethertype));
+    ethertype = ntohs(ethertype);
+    if (ethertype == RAW_FRAME_ETHERTYPE)
+    {
+        parse_raw_frame(datagram, &data[ETH_HLEN], len - ETH_HLEN);
+        return true;
+    }
+
+    struct iphdr ip;
+    if (ethertype != ETH_P_IP || len < ETH_HLEN + sizeof(ip))
+    {
+        return false;
+    }
+
+    memcpy(&ip, &data[ETH_HLEN], sizeof(ip));
+    const size_t ip_len = ip.ihl * 4;
+    if (ip.protocol != IPPROTO_UDP || ip_len < sizeof(ip))
+    {
+        return false;
+    }
+
+    /*
+     * Only the first fragment holds the UDP header, so fragmented datagrams
+     * cannot be told apart from other traffic.
+     */
+    if (ntohs(ip.frag_off) & (IP_MF | IP_OFFMASK))
+    {
+        packet_ring->frames_fragmented++;
+        return false;
+    }
+
+    struct udphdr udp;
+    if (len < ETH_HLEN + ip_len + sizeof(udp))
+    {
+        return false;
+    }
+
+    memcpy(&udp, &data[ETH_HLEN + ip_len], sizeof(udp));
+    if (ntohs(udp.dest) != packet_ring->port)
+    {
+        return false;
+    }
+
+    const size_t udp_len = ntohs(udp.len);
+    if (udp_len < sizeof(udp) || ETH_HLEN + ip_len + udp_len > len)
+    {
+        memset(datagram, 0, sizeof(*datagram));
+        return true;
+    }
+
+    parse_datagram(datagram, &data[ETH_HLEN + ip_len + sizeof(udp)], udp_len - sizeof(udp));
+    return true;
+}
+
+/**
+ * Reads a batch of datagrams from the packet ring, waiting for the kernel to
+ * hand over a block if none is held.
+ *
+ * @note The datagrams reference the ring, so the block they are in is only
+ *       returned to the kernel by the next call.
+ *
+ * @param packet_ring The ring.
+ * @param[out] datagrams The datagrams read.
+ * @param capacity The number of datagrams that fit in datagrams.
+ *
+ * @return The number of datagrams read, or -1 if the stream went idle.
+ */
+static int read_packet_ring(packet_ring_t *packet_ring, datagram_t *datagrams, const size_t capacity)
+{
+    struct tpacket_block_desc *block = (struct tpacket_block_desc *)
+            &packet_ring->map[(size_t)packet_ring->block * PACKET_RING_BLOCK_BYTES];
+
+    if (packet_ring->holding_block && packet_ring->frames_left == 0)
+    {
+        __atomic_store_n(&block->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+        packet_ring->holding_block = false;
+        packet_ring->block = (packet_ring->block + 1) % PACKET_RING_BLOCKS;
+        block = (struct tpacket_block_desc *)&packet_ring->map[(size_t)packet_ring->block * PACKET_RING_BLOCK_BYTES];
+    }
+
+    if (!packet_ring->holding_block)
+    {
+        if (!(__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER))
+        {
+            struct pollfd waiting = {packet_ring->sock, POLLIN | POLLERR, 0};
+            poll(&waiting, 1, IDLE_TIMEOUT_MS);
+            if (!(__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER))
+            {
+                return -1;
+            }
+        }
+
+        packet_ring->holding_block = true;
+        packet_ring->frames_left = block->hdr.bh1.num_pkts;
+        packet_ring->frame = (const uint8_t *)block + block->hdr.bh1.offset_to_first_pkt;
+    }
+
+    int count = 0;
+    while (packet_ring->frames_left && (size_t)count < capacity)
+    {
+        const struct tpacket3_hdr *frame = (const struct tpacket3_hdr *)packet_ring->frame;
+        if (parse_frame(packet_ring, frame, &datagrams[count]))
+        {
+            count++;
+        }
+
+        packet_ring->frame += frame->tp_next_offset;
+        packet_ring->frames_left--;
+    }
+
+    return count;
+}
+
+/**
+ * Receives a batch of datagrams from the stream socket into the receive
+ * ring.
+ *
+ * @param sock The stream socket.
+ * @param[out] datagrams The datagrams received, which hold at least
+ *             RING_DATAGRAMS.
+ *
+ * @return The number of datagrams received, or -1 if the stream went idle.
+ */
+static int receive_datagrams(const int sock, datagram_t *datagrams)
+{
+    const int received = recvmmsg(sock, messages, RING_DATAGRAMS, MSG_WAITFORONE, NULL);
+    if (received <= 0)
+    {
+        return -1;
+    }
+
+    for (int i = 0; i < received; ++i)
+    {
+        parse_datagram(&datagrams[i], ring[i], messages[i].msg_len);
+    }
+
+    return received;
+}
+
+/**
+ * Starts reassembling a new capture.
+ *
+ * @param capture The capture to start.
+ * @param datagram The first datagram received from it.
+ * @param output The capture file that the capture is received into, or NULL
+ *        to receive it into memory.
+ *
+ * @return Success or fail.
+ */
+static result_t start_capture(capture_t *capture, const datagram_t *datagram, capture_file_t *output)
+{
+    const stream_header_t *header = &datagram->header;
+    AbortIfNot(header->element_size == sizeof(sample_t), fail);
+    AbortIfNot(header->element_count, fail);
+    AbortIfNot(header->total_elements, fail);
+
+    /*
+     * A capture that was abandoned still holds the space of its ping.
+     */
+    if (output && output->mapping)
+    {
+        AbortIfNot(discard_capture_ping(output), fail);
+        capture->samples = NULL;
+    }
+
+    free(capture->samples);
+    free(capture->received);
+    memset(capture, 0, sizeof(*capture));
+
+    capture->transfer_id = header->transfer_id;
+    capture->raw = datagram->raw;
+    capture->total_samples = header->total_elements;
+
+    if (output)
+    {
+        AbortIfNot(map_capture_ping(output, capture->total_samples, &capture->samples), fail);
+    }
+    else
+    {
+        capture->samples = calloc(capture->total_samples, sizeof(sample_t));
+    }
+    capture->received = calloc(capture->total_samples, 1);
+    AbortIfNot(capture->samples, fail);
+    AbortIfNot(capture->received, fail);
+
+    capture->active = true;
+    capture->last_packet = -1;
+    capture->first_ns = now_ns();
+
+    return success;
+}
+
+/**
+ * Places a datagram into its capture.
+ *
+ * @param capture The capture being reassembled.
+ * @param datagram The datagram.
+ * @param[out] next Specified true if the datagram belongs to a new capture,
+ *             which must be started before it is placed.
+ *
+ * @return Success or fail.
+ */
+static result_t place_datagram(capture_t *capture, const datagram_t *datagram, bool *next)
+{
+    *next = false;
+    if (!datagram->valid)
+    {
+        capture->malformed_packets++;
+        return success;
+    }
+
+    const stream_header_t header = datagram->header;
+
+    /*
+     * Retransmissions may still arrive after a capture is finished.
+     */
+    if (!capture->active && capture->total_samples && header.transfer_id == capture->transfer_id)
+    {
+        capture->duplicate_packets++;
+        return success;
+    }
+
+    if (!capture->active || header.transfer_id != capture->transfer_id ||
+        header.total_elements != capture->total_samples || datagram->raw != capture->raw)
+    {
+        *next = true;
+        return success;
+    }
+
+    const uint32_t first = header.first_element;
+    const uint32_t count = header.element_count;
+    if (header.packet_number < 0 ||
+        count == 0 ||
+        first > capture->total_samples ||
+        count > capture->total_samples - first)
+    {
+        capture->malformed_packets++;
+        return success;
+    }
+
+    if (!memchr(&capture->received[first], 0, count))
+    {
+        capture->duplicate_packets++;
+        return success;
+    }
+
+    if (!stream_place_payload(&header,
+                              datagram->payload,
+                              datagram->payload_len,
+                              capture->samples,
+                              capture->total_samples))
+    {
+        capture->malformed_packets++;
+        return success;
+    }
+
+    for (uint32_t i = first; i < first + count; ++i)
+    {
+        if (!capture->received[i])
+        {
+            capture->received[i] = 1;
+            capture->covered_samples++;
+        }
+    }
+
+    /*
+     * The first datagram of a transfer holds a whole packet of samples, and
+     * any later one gives the spacing by its place.
+     */
+    if (header.encoding != STREAM_ENCODING_RAW)
+    {
+        capture->encoded = true;
+    }
+    else if (!capture->samples_per_packet)
+    {
+        capture->samples_per_packet = (header.packet_number > 0)? first / header.packet_number : count;
+    }
+
+    if (header.packet_number < capture->last_packet)
+    {
+        capture->reordered_packets++;
+    }
+    capture->last_packet = header.packet_number;
+    capture->unique_packets++;
+    capture->last_ns = now_ns();
+
+    return success;
+}
+
+/**
+ * Checks if the missing datagrams of a capture may be requested again, which
+ * needs every packet number to cover a known range of samples.
+ *
+ * @note Reliable transfers are always sent without encoding, and raw frames
+ *       are not retransmitted.
+ *
+ * @param capture The capture being reassembled.
+ *
+ * @return True if retransmit requests may be made.
+ */
+static bool capture_retransmittable(const capture_t *capture)
+{
+    return (!capture->raw && !capture->encoded && capture->samples_per_packet)? true : false;
+}
+
+/**
+ * Requests every missing datagram of a capture.
+ *
+ * @param sock The socket to send requests from.
+ * @param hydrozynq The command address of the HydroZynq.
+ * @param capture The capture being reassembled.
+ *
+ * @return Success or fail.
+ */
+static result_t request_missing(const int sock, const struct sockaddr_in *hydrozynq, capture_t *capture)
+{
+    char request[MAX_REQUEST_LENGTH + 32];
+    const int prefix = snprintf(request, sizeof(request), "resend:%u", capture->transfer_id);
+    int len = prefix;
+
+    for (uint32_t sample = 0; sample < capture->total_samples; ++sample)
+    {
+        if (capture->received[sample])
+        {
+            continue;
+        }
+
+        uint32_t end = sample;
+        while (end + 1 < capture->total_samples && !capture->received[end + 1])
+        {
+            end++;
+        }
+
+        const uint32_t first = sample / capture->samples_per_packet;
+        const uint32_t last = end / capture->samples_per_packet;
+        sample = end;
+
+        char entry[32];
+        const int entry_len = (first == last)? snprintf(entry, sizeof(entry), "/%u", first) :
+                snprintf(entry, sizeof(entry), "/%u-%u", first, last);
+        if (len + entry_len > MAX_REQUEST_LENGTH)
+        {
+            AbortIf(sendto(sock, request, len, 0, (const struct sockaddr *)hydrozynq, sizeof(*hydrozynq)) < 0, fail);
+            capture->resend_requests++;
+            len = prefix;
+        }
+
+        memcpy(&request[len], entry, entry_len);
+        len += entry_len;
+    }
+
+    if (len > prefix)
+    {
+        AbortIf(sendto(sock, request, len, 0, (const struct sockaddr *)hydrozynq, sizeof(*hydrozynq)) < 0, fail);
+        capture->resend_requests++;
+    }
+
+    return success;
+}
+
+/**
+ * Acknowledges a complete capture so that the HydroZynq releases it.
+ *
+ * @param sock The socket to send the acknowledgement from.
+ * @param hydrozynq The command address of the HydroZynq.
+ * @param capture The completed capture.
+ *
+ * @return Success or fail.
+ */
+static result_t acknowledge_capture(const int sock, const struct sockaddr_in *hydrozynq, const capture_t *capture)
+{
+    char ack[32];
+    const int len = snprintf(ack, sizeof(ack), "ack:%u", capture->transfer_id);
+    AbortIf(sendto(sock, ack, len, 0, (const struct sockaddr *)hydrozynq, sizeof(*hydrozynq)) < 0, fail);
+
+    return success;
+}
+
+/**
+ * Writes a capture and reports its loss statistics.
+ *
+ * @param capture The capture to finish.
+ * @param output The capture file that the capture was received into, or
+ *        NULL.
+ *
+ * @return Success or fail.
+ */
+static result_t finish_capture(capture_t *capture, capture_file_t *output)
+{
+    const uint32_t lost = capture->total_samples - capture->covered_samples;
+    const double seconds = (capture->last_ns - capture->first_ns) / 1e9;
+    const double rate = (seconds > 0)? capture->covered_samples * (double)sizeof(sample_t) / seconds / 1e6 : 0;
+
+    printf("Transfer %u: %u/%u samples, %u datagrams, %u samples lost (%.3f%%), %u duplicate, "
+           "%u reordered, %u malformed, %u resend requests, %.1f MB/s\n",
+           capture->transfer_id,
+           capture->covered_samples,
+           capture->total_samples,
+           capture->unique_packets,
+           lost,
+           100.0 * lost / capture->total_samples,
+           capture->duplicate_packets,
+           capture->reordered_packets,
+           capture->malformed_packets,
+           capture->resend_requests,
+           rate);
+    fflush(stdout);
+
+    if (output)
+    {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+
+        capture_file_ping_t ping;
+        memset(&ping, 0, sizeof(ping));
+        ping.transfer_id = capture->transfer_id;
+        ping.host_time_ns = (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+        AbortIfNot(commit_capture_ping(output, &ping), fail);
+        capture->samples = NULL;
+    }
+
+    capture->active = false;
+
+    return success;
+}
+
+int main(int argc, char **argv)
+{
+    const char *filename = NULL;
+    const char *address = NULL;
+    const char *group = NULL;
+    const char *hydrozynq_address = NULL;
+    uint16_t port = DATA_PORT;
+    uint32_t max_captures = 0;
+    int receive_buffer = DEFAULT_RECEIVE_BUFFER_BYTES;
+    const char *interface = NULL;
+    int cpu = -1;
+
+    capture_file_header_t file_header;
+    init_capture_file_header(&file_header);
+    file_header.sampling_frequency = DEFAULT_SAMPLING_FREQUENCY;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-v") == 0)
+        {
+            set_log_level(LOG_DEBUG);
+            continue;
+        }
+
+        if (i + 1 >= argc)
+        {
+            fprintf(stderr, "Missing value for %s\n", argv[i]);
+            return 1;
+        }
+
+        const char *value = argv[++i];
+        if (strcmp(argv[i - 1], "-o") == 0)
+        {
+            filename = value;
+        }
+        else if (strcmp(argv[i - 1], "-a") == 0)
+        {
+            address = value;
+        }
+        else if (strcmp(argv[i - 1], "-p") == 0)
+        {
+            port = strtoul(value, NULL, 0);
+        }
+        else if (strcmp(argv[i - 1], "-m") == 0)
+        {
+            group = value;
+        }
+        else if (strcmp(argv[i - 1], "-r") == 0)
+        {
+            hydrozynq_address = value;
+        }
+        else if (strcmp(argv[i - 1], "-n") == 0)
+        {
+            max_captures = strtoul(value, NULL, 0);
+        }
+        else if (strcmp(argv[i - 1], "-b") == 0)
+        {
+            receive_buffer = strtol(value, NULL, 0);
+        }
+        else if (strcmp(argv[i - 1], "-s") == 0)
+        {
+            file_header.sampling_frequency = strtoul(value, NULL, 0);
+        }
+        else if (strcmp(argv[i - 1], "-c") == 0)
+        {
+            file_header.clk_div = strtoul(value, NULL, 0);
+        }
+        else if (strcmp(argv[i - 1], "-d") == 0)
+        {
+            file_header.decimation = strtoul(value, NULL, 0);
+        }
+        else if (strcmp(argv[i - 1], "-i") == 0)
+        {
+            interface = value;
+        }
+        else if (strcmp(argv[i - 1], "-k") == 0)
+        {
+            cpu = strtol(value, NULL, 0);
+        }
+        else
+        {
+            fprintf(stderr, "Unknown option %s\n", argv[i - 1]);
+            return 1;
+        }
+    }
+
+    if (cpu >= 0)
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        AbortIf(sched_setaffinity(0, sizeof(cpus), &cpus) != 0, 1);
+    }
+
+    /*
+     * The stream socket is still opened with a packet ring, so that the
+     * multicast group is joined and datagrams do not draw port unreachable
+     * replies. It also sends the retransmit requests.
+     */
+    const int sock = open_stream_socket(address, port, group,
+                                        (interface)? PACKET_RING_SOCKET_BUFFER_BYTES : receive_buffer);
+    AbortIf(sock < 0, 1);
+
+    packet_ring_t packet_ring;
+    if (interface)
+    {
+        AbortIfNot(open_packet_ring(&packet_ring, interface, port), 1);
+    }
+
+    struct sockaddr_in hydrozynq;
+    memset(&hydrozynq, 0, sizeof(hydrozynq));
+    hydrozynq.sin_family = AF_INET;
+    hydrozynq.sin_port = htons(COMMAND_PORT);
+    if (hydrozynq_address)
+    {
+        AbortIf(inet_pton(AF_INET, hydrozynq_address, &hydrozynq.sin_addr) != 1, 1);
+    }
+
+    for (size_t i = 0; i < RING_DATAGRAMS; ++i)
+    {
+        vectors[i].iov_base = ring[i];
+        vectors[i].iov_len = RING_SLOT_BYTES;
+        messages[i].msg_hdr.msg_iov = &vectors[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    capture_file_t file;
+    capture_file_t *output = NULL;
+    if (filename)
+    {
+        AbortIfNot(create_capture_file(&file, filename, &file_header), 1);
+        output = &file;
+    }
+
+    capture_t capture;
+    memset(&capture, 0, sizeof(capture));
+    uint32_t captures = 0;
+
+    while (max_captures == 0 || captures < max_captures)
+    {
+        const int received = (interface)? read_packet_ring(&packet_ring, batch, BATCH_DATAGRAMS) :
+                receive_datagrams(sock, batch);
+        if (received < 0)
+        {
+            /*
+             * The stream went idle, so the capture is either complete or
+             * has lost datagrams at its end.
+             */
+            if (!capture.active)
+            {
+                continue;
+            }
+
+            if (capture.covered_samples < capture.total_samples && hydrozynq_address &&
+                capture_retransmittable(&capture))
+            {
+                AbortIfNot(request_missing(sock, &hydrozynq, &capture), 1);
+                continue;
+            }
+
+            if (hydrozynq_address && !capture.raw)
+            {
+                AbortIfNot(acknowledge_capture(sock, &hydrozynq, &capture), 1);
+            }
+            AbortIfNot(finish_capture(&capture, output), 1);
+            captures++;
+            continue;
+        }
+
+        for (int i = 0; i < received; ++i)
+        {
+            bool next = false;
+            AbortIfNot(place_datagram(&capture, &batch[i], &next), 1);
+            if (!next)
+            {
+                continue;
+            }
+
+            /*
+             * A datagram of another transfer ends the current capture.
+             */
+            if (capture.active)
+            {
+                AbortIfNot(finish_capture(&capture, output), 1);
+                captures++;
+                if (max_captures && captures >= max_captures)
+                {
+                    break;
+                }
+            }
+
+            if (!start_capture(&capture, &batch[i], output))
+            {
+                capture.malformed_packets++;
+                continue;
+            }
+            AbortIfNot(place_datagram(&capture, &batch[i], &next), 1);
+        }
+
+        /*
+         * A capture is finished as soon as its last datagram arrives.
+         */
+        if (capture.active && capture.covered_samples == capture.total_samples)
+        {
+            if (hydrozynq_address && !capture.raw)
+            {
+                AbortIfNot(acknowledge_capture(sock, &hydrozynq, &capture), 1);
+            }
+            AbortIfNot(finish_capture(&capture, output), 1);
+            captures++;
+        }
+    }
+
+    if (interface)
+    {
+        close_packet_ring(&packet_ring);
+    }
+
+    close(sock);
+    if (output)
+    {
+        AbortIfNot(close_capture_file(output), 1);
+    }
+
+    return 0;
+}
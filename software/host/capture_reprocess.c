@@ -0,0 +1,699 @@
+/*
+ * Reprocesses capture files through the ping pipeline of the firmware on a
+ * host.
+ *
+ * Usage: capture_reprocess [-o summary.csv] [-j workers] [-t threshold]
+ *                          [-p ping frequency] [-r reference channel]
+ *                          [-q min quality percent] [-n noise threshold]
+ *                          [-d decimation] [-F] [-L] [-P] [-A] [-C] [-E]
+ *                          [-W] [-D] [-v]
+ *                          capture.hzc...
+ *
+ * Every ping of every capture file (see capture_file.h) is run through
+ * run_dsp_job() and solve_bearing(), as the replay mode of the firmware runs
+ * a recorded capture. The options set the HydroZynq parameters that the
+ * pings are processed with: -F enables the highpass filter, -L filters only
+ * the located window, -P the phase transform, -A correlates all pairs, -C the
+ * coarse lag search, -E the envelope onset, -W window normalization, and -D
+ * de-interleaves the channels first, which -d also does to decimate the
+ * filtered channels. Parameters that are not given are taken from the header
+ * of each file, or the firmware defaults where the header does not record
+ * them.
+ *
+ * The pings are shared among worker processes, one per core unless -j is
+ * given, which each take the next unprocessed ping. The workers are processes
+ * rather than threads because the kernels keep their working buffers in
+ * static storage, as they do on the board. The summary has one row per ping,
+ * in the order of the files and their pings, with its result and the time of
+ * each stage, and is written to standard output unless -o is given.
+ *
+ * @note Each ping is processed alone, so the lag tracker, the bearing tracker,
+ *       and ping averaging are not applied, and only the primary pinger is
+ *       located.
+ */
+#include "abort.h"
+#include "bearing.h"
+#include "capture_file.h"
+#include "correlation_util.h"
+#include "db.h"
+#include "dsp.h"
+#include "fft.h"
+#include "system.h"
+#include "system_params.h"
+#include "time_util.h"
+#include "types.h"
+#include "worker_pool.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * The pre-ping and post-ping durations of the firmware in microseconds.
+ */
+#define DEFAULT_PRE_PING_DURATION_US 100
+#define DEFAULT_POST_PING_DURATION_US 50
+
+/**
+ * The highpass filter applied by the firmware.
+ */
+static filter_coefficients_t highpass_iir[5] = {
+    {{0.976572753292004, -1.953145506584008, 0.976572753292004,
+        1.000000000000000, -1.998354115074282, 0.998926104509836}},
+    {{0.975206721477597, -1.950413442955194, 0.975206721477597,
+        1.000000000000000, -1.995495119158081, 0.996193697294377}},
+    {{0.972451482822301, -1.944902965644602, 0.972451482822301,
+        1.000000000000000, -1.989660620860693, 0.990750529959661}},
+    {{0.963669622248601, -1.927339244497202, 0.963669622248601,
+        1.000000000000000, -1.970992420143032, 0.973473065140308}},
+    {{0.906313647059524, -1.812627294119048, 0.906313647059524,
+        1.000000000000000, -1.848974099452832, 0.860723515924862}}};
+
+/**
+ * Defines the parameters given on the command line, which replace those of
+ * the capture files. A negative value is not given.
+ */
+typedef struct overrides_t
+{
+    int32_t ping_threshold;
+    int64_t ping_frequency;
+    int32_t noise_threshold;
+} overrides_t;
+
+/**
+ * Defines the outcome of one ping.
+ */
+typedef struct ping_summary_t
+{
+    bool processed;
+    bool status;
+    bool located;
+    bool accepted;
+    uint32_t samples;
+    size_t start_index;
+    size_t end_index;
+    correlation_result_t result;
+    uint64_t read_ns;
+    uint64_t filter_ns;
+    uint64_t correlation_ns;
+    uint64_t processing_ns;
+} ping_summary_t;
+
+/**
+ * Defines the state shared by the workers, which is mapped into every one of
+ * them.
+ */
+typedef struct shared_state_t
+{
+    atomic_size_t next_ping;
+    ping_summary_t summaries[];
+} shared_state_t;
+
+
+/**
+ * Defines the capture files and the pings of all of them, numbered in order.
+ */
+typedef struct archive_t
+{
+    const char **filenames;
+    capture_reader_t *files;
+    size_t *first_ping;
+    size_t num_files;
+    size_t num_pings;
+    size_t max_samples;
+    uint32_t max_sampling_frequency;
+} archive_t;
+
+/**
+ * Defines what every worker is started with.
+ */
+typedef struct worker_args_t
+{
+    shared_state_t *state;
+    const archive_t *archive;
+    HydroZynqParams base;
+    overrides_t overrides;
+    bool planar;
+} worker_args_t;
+
+/**
+ * Defines the working memory of a worker.
+ */
+typedef struct worker_t
+{
+    sample_t *samples;
+    correlation_t *correlations;
+    correlation_t *cross_correlations;
+    size_t correlation_len;
+    planar_samples_t planar;
+    biquad_cascade_t filter;
+    decimator_t decimator;
+    uint32_t decimator_max_hz;
+    hydrophone_array_t array;
+} worker_t;
+
+/**
+ * Finds the file that holds a ping of the archive.
+ *
+ * @param archive The archive.
+ * @param ping The number of the ping within the archive.
+ *
+ * @return The index of the file.
+ */
+static size_t find_file(const archive_t *archive, const size_t ping)
+{
+    size_t low = 0;
+    size_t high = archive->num_files;
+    while (high - low > 1)
+    {
+        const size_t mid = (low + high) / 2;
+        if (archive->first_ping[mid] <= ping)
+        {
+            low = mid;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+/**
+ * Opens every capture file of the archive and numbers their pings.
+ *
+ * @param[out] archive The archive.
+ * @param filenames The capture files.
+ * @param num_files The number of capture files.
+ *
+ * @return Success or fail.
+ */
+static result_t open_archive(archive_t *archive, const char **filenames, const size_t num_files)
+{
+    AbortIfNot(archive, fail);
+    AbortIfNot(filenames, fail);
+    AbortIfNot(num_files, fail);
+
+    memset(archive, 0, sizeof(*archive));
+    archive->filenames = filenames;
+    archive->files = calloc(num_files, sizeof(capture_reader_t));
+    archive->first_ping = calloc(num_files, sizeof(size_t));
+    AbortIfNot(archive->files, fail);
+    AbortIfNot(archive->first_ping, fail);
+
+    for (size_t i = 0; i < num_files; ++i)
+    {
+        capture_reader_t *file = &archive->files[i];
+        if (open_capture_file(file, filenames[i]) != success)
+        {
+            fprintf(stderr, "Failed to open capture file %s\n", filenames[i]);
+            return fail;
+        }
+        archive->num_files++;
+
+        archive->first_ping[i] = archive->num_pings;
+        archive->num_pings += file->header.num_pings;
+        for (size_t p = 0; p < file->header.num_pings; ++p)
+        {
+            if (file->pings[p].sample_count > archive->max_samples)
+            {
+                archive->max_samples = file->pings[p].sample_count;
+            }
+        }
+
+        if (file->header.sampling_frequency > archive->max_sampling_frequency)
+        {
+            archive->max_sampling_frequency = file->header.sampling_frequency;
+        }
+    }
+
+    return success;
+}
+
+/**
+ * Finds the parameters that the pings of a capture file are processed with.
+ *
+ * @param header The header of the capture file.
+ * @param base The parameters set by the command line flags.
+ * @param overrides The values given on the command line.
+ * @param[out] params The parameters of the file.
+ *
+ * @return None.
+ */
+static void file_params(const capture_file_header_t *header,
+                        const HydroZynqParams *base,
+                        const overrides_t *overrides,
+                        HydroZynqParams *params)
+{
+    *params = *base;
+    params->sampling_frequency = header->sampling_frequency;
+    params->ping_threshold = (header->ping_threshold)? header->ping_threshold : INITIAL_ADC_THRESHOLD;
+    params->ping_frequency = (header->ping_frequency)? header->ping_frequency : INITIAL_PING_FREQUENCY_HZ;
+    params->noise_threshold = header->noise_threshold;
+    params->pre_ping_duration = micros_to_ticks((header->pre_ping_duration_us)?
+            header->pre_ping_duration_us : DEFAULT_PRE_PING_DURATION_US);
+    params->post_ping_duration = micros_to_ticks((header->post_ping_duration_us)?
+            header->post_ping_duration_us : DEFAULT_POST_PING_DURATION_US);
+
+    if (overrides->ping_threshold >= 0)
+    {
+        params->ping_threshold = overrides->ping_threshold;
+    }
+
+    if (overrides->ping_frequency >= 0)
+    {
+        params->ping_frequency = overrides->ping_frequency;
+    }
+
+    if (overrides->noise_threshold >= 0)
+    {
+        params->noise_threshold = overrides->noise_threshold;
+    }
+}
+
+/**
+ * Allocates the working memory of a worker.
+ *
+ * @param[out] worker The worker.
+ * @param archive The archive that the worker processes.
+ *
+ * @return Success or fail.
+ */
+static result_t init_worker(worker_t *worker, const archive_t *archive)
+{
+    memset(worker, 0, sizeof(*worker));
+    worker->samples = malloc(archive->max_samples * sizeof(sample_t));
+    worker->correlation_len = correlation_capacity(archive->max_sampling_frequency);
+    worker->correlations = malloc(worker->correlation_len * sizeof(correlation_t));
+    worker->cross_correlations = malloc(worker->correlation_len * sizeof(correlation_t));
+    AbortIfNot(worker->samples, fail);
+    AbortIfNot(worker->correlations, fail);
+    AbortIfNot(worker->cross_correlations, fail);
+
+    worker->planar.capacity = archive->max_samples;
+    for (size_t k = 0; k < 4; ++k)
+    {
+        worker->planar.channel[k] = malloc(archive->max_samples * sizeof(analog_sample_t));
+        AbortIfNot(worker->planar.channel[k], fail);
+    }
+
+    AbortIfNot(init_biquad_cascade(&worker->filter, highpass_iir, sizeof(highpass_iir) / sizeof(highpass_iir[0])), fail);
+    AbortIfNot(init_hydrophone_array(&worker->array, HYDROPHONE_SPACING_METERS), fail);
+
+    return success;
+}
+
+/**
+ * Processes one ping of the archive as the firmware processes a replayed
+ * capture.
+ *
+ * @param worker The worker.
+ * @param archive The archive.
+ * @param ping The number of the ping within the archive.
+ * @param base The parameters set by the command line flags.
+ * @param overrides The values given on the command line.
+ * @param planar Specified true to de-interleave the channels first.
+ * @param[out] summary The outcome of the ping.
+ *
+ * @return Success, or fail if the ping could not be read.
+ */
+static result_t process_ping(worker_t *worker,
+                             const archive_t *archive,
+                             const size_t ping,
+                             const HydroZynqParams *base,
+                             const overrides_t *overrides,
+                             const bool planar,
+                             ping_summary_t *summary)
+{
+    const size_t f = find_file(archive, ping);
+    const capture_reader_t *file = &archive->files[f];
+    const size_t index = ping - archive->first_ping[f];
+    const uint32_t count = file->pings[index].sample_count;
+
+    memset(summary, 0, sizeof(*summary));
+    summary->processed = true;
+    summary->samples = count;
+
+    const tick_t read_start = get_system_time();
+    AbortIfNot(read_capture_ping(file, index, worker->samples, archive->max_samples), fail);
+    summary->read_ns = ticks_to_ns(get_system_time() - read_start);
+
+    dsp_job_t job;
+    memset(&job, 0, sizeof(job));
+    job.data = worker->samples;
+    job.len = count;
+    file_params(&file->header, base, overrides, &job.params);
+    job.sampling_frequency = file->header.sampling_frequency;
+    job.filter = &worker->filter;
+    job.correlate = true;
+    job.correlations = worker->correlations;
+    job.correlation_len = correlation_capacity(job.sampling_frequency);
+    job.cross_correlations = worker->cross_correlations;
+    job.planar = (planar)? &worker->planar : NULL;
+
+    /*
+     * The decimator is designed for the ping and sampling frequency of the
+     * file, as the firmware designs it for the current parameters.
+     */
+    if (planar && job.params.dsp_decimation > 1)
+    {
+        const uint32_t max_hz = (job.params.ping_frequency)?
+                job.params.ping_frequency + PINGER_BANDWIDTH_HZ / 2 : COARSE_SEARCH_MAX_PINGER_HZ;
+        if (worker->decimator.sampling_frequency != job.sampling_frequency ||
+            worker->decimator_max_hz != max_hz)
+        {
+            AbortIfNot(init_decimator(&worker->decimator,
+                                      job.params.dsp_decimation,
+                                      max_hz,
+                                      job.sampling_frequency), fail);
+            worker->decimator_max_hz = max_hz;
+        }
+        job.decimator = &worker->decimator;
+    }
+
+    /*
+     * A capture that the pipeline rejects is reported rather than ending the
+     * run, as the firmware reports a replayed capture.
+     */
+    const tick_t processing_start = get_system_time();
+    const result_t ret = run_dsp_job(&job);
+    summary->status = (ret == success && job.status == success)? true : false;
+    summary->located = (summary->status && job.located)? true : false;
+    summary->accepted = (summary->located && job.accepted)? true : false;
+    if (summary->accepted)
+    {
+        if (solve_bearing(&worker->array, &job.result) != success)
+        {
+            summary->status = false;
+        }
+    }
+    summary->processing_ns = ticks_to_ns(get_system_time() - processing_start);
+    summary->filter_ns = ticks_to_ns(job.filter_duration);
+    summary->correlation_ns = ticks_to_ns(job.correlation_duration);
+
+    if (summary->located)
+    {
+        summary->start_index = job.start_index;
+        summary->end_index = job.end_index;
+        summary->result = job.result;
+    }
+
+    return success;
+}
+
+/**
+ * Processes pings of the archive until none are left.
+ *
+ * @param arg The worker_args_t of the run.
+ *
+ * @return Success or fail.
+ */
+static result_t run_worker(void *arg)
+{
+    const worker_args_t *args = arg;
+    const archive_t *archive = args->archive;
+    shared_state_t *state = args->state;
+
+    worker_t worker;
+    AbortIfNot(init_worker(&worker, archive), fail);
+
+    while (true)
+    {
+        const size_t ping = atomic_fetch_add(&state->next_ping, 1);
+        if (ping >= archive->num_pings)
+        {
+            break;
+        }
+
+        if (process_ping(&worker,
+                         archive,
+                         ping,
+                         &args->base,
+                         &args->overrides,
+                         args->planar,
+                         &state->summaries[ping]) != success)
+        {
+            fprintf(stderr, "Failed to read ping %zu\n", ping);
+        }
+    }
+
+    return success;
+}
+
+/**
+ * Writes the summary table of the archive.
+ *
+ * @param output The stream to write to.
+ * @param state The state shared by the workers.
+ * @param archive The archive.
+ *
+ * @return None.
+ */
+static void write_summary(FILE *output, const shared_state_t *state, const archive_t *archive)
+{
+    fprintf(output,
+            "file,ping,transfer_id,samples,status,located,accepted,quality,start_index,end_index,"
+            "delay_a_ns,delay_b_ns,delay_c_ns,confidence_a,confidence_b,confidence_c,"
+            "bearing_deg,elevation_deg,direction_norm,read_us,filter_us,correlation_us,processing_us\n");
+
+    for (size_t ping = 0; ping < archive->num_pings; ++ping)
+    {
+        const size_t f = find_file(archive, ping);
+        const size_t index = ping - archive->first_ping[f];
+        const ping_summary_t *summary = &state->summaries[ping];
+        const correlation_result_t *result = &summary->result;
+
+        fprintf(output,
+                "%s,%zu,%u,%u,%d,%d,%d,%.3f,%zu,%zu,%d,%d,%d,%.4f,%.4f,%.4f,%.2f,%.2f,%.3f,%.1f,%.1f,%.1f,%.1f\n",
+                archive->filenames[f],
+                index,
+                archive->files[f].pings[index].transfer_id,
+                summary->samples,
+                (summary->processed && summary->status)? 1 : 0,
+                summary->located,
+                summary->accepted,
+                result->quality,
+                summary->start_index,
+                summary->end_index,
+                result->channel_delay_ns[0],
+                result->channel_delay_ns[1],
+                result->channel_delay_ns[2],
+                result->confidence[0],
+                result->confidence[1],
+                result->confidence[2],
+                result->bearing_deg,
+                result->elevation_deg,
+                result->direction_norm,
+                summary->read_ns / 1000.0,
+                summary->filter_ns / 1000.0,
+                summary->correlation_ns / 1000.0,
+                summary->processing_ns / 1000.0);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const char *output_filename = NULL;
+    long workers = count_host_cores();
+    bool planar = false;
+    overrides_t overrides = {-1, -1, -1};
+
+    HydroZynqParams base;
+    memset(&base, 0, sizeof(base));
+
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; ++i)
+    {
+        const char *flag = argv[i];
+        if (strcmp(flag, "-v") == 0)
+        {
+            set_log_level(LOG_DEBUG);
+            continue;
+        }
+        else if (strcmp(flag, "-F") == 0)
+        {
+            base.filter = true;
+            continue;
+        }
+        else if (strcmp(flag, "-L") == 0)
+        {
+            base.lazy_filter = true;
+            continue;
+        }
+        else if (strcmp(flag, "-P") == 0)
+        {
+            base.phat = true;
+            continue;
+        }
+        else if (strcmp(flag, "-A") == 0)
+        {
+            base.all_pairs = true;
+            continue;
+        }
+        else if (strcmp(flag, "-C") == 0)
+        {
+            base.coarse_search = true;
+            continue;
+        }
+        else if (strcmp(flag, "-E") == 0)
+        {
+            base.envelope_onset = true;
+            continue;
+        }
+        else if (strcmp(flag, "-W") == 0)
+        {
+            base.window_normalize = true;
+            continue;
+        }
+        else if (strcmp(flag, "-D") == 0)
+        {
+            planar = true;
+            continue;
+        }
+
+        if (i + 1 >= argc)
+        {
+            fprintf(stderr, "Missing value for %s\n", flag);
+            return 1;
+        }
+
+        const char *value = argv[++i];
+        if (strcmp(flag, "-o") == 0)
+        {
+            output_filename = value;
+        }
+        else if (strcmp(flag, "-j") == 0)
+        {
+            workers = strtol(value, NULL, 0);
+        }
+        else if (strcmp(flag, "-t") == 0)
+        {
+            overrides.ping_threshold = strtol(value, NULL, 0);
+        }
+        else if (strcmp(flag, "-p") == 0)
+        {
+            overrides.ping_frequency = strtol(value, NULL, 0);
+        }
+        else if (strcmp(flag, "-n") == 0)
+        {
+            overrides.noise_threshold = strtol(value, NULL, 0);
+        }
+        else if (strcmp(flag, "-r") == 0)
+        {
+            base.reference_channel = strtoul(value, NULL, 0);
+        }
+        else if (strcmp(flag, "-q") == 0)
+        {
+            base.min_ping_quality = strtoul(value, NULL, 0);
+        }
+        else if (strcmp(flag, "-d") == 0)
+        {
+            const unsigned long factor = strtoul(value, NULL, 0);
+            AbortIfNot(factor <= MAX_DECIMATION, 1);
+            base.dsp_decimation = factor;
+            planar = true;
+        }
+        else
+        {
+            fprintf(stderr, "Unknown option %s\n", flag);
+            return 1;
+        }
+    }
+
+    if (i >= argc)
+    {
+        fprintf(stderr, "No capture files given\n");
+        return 1;
+    }
+    AbortIfNot(base.reference_channel < 4, 1);
+
+    archive_t archive;
+    AbortIfNot(open_archive(&archive, (const char **)&argv[i], argc - i), 1);
+    if (!archive.num_pings)
+    {
+        fprintf(stderr, "The capture files hold no pings\n");
+        return 1;
+    }
+
+    if (workers < 1)
+    {
+        workers = 1;
+    }
+    if ((size_t)workers > archive.num_pings)
+    {
+        workers = archive.num_pings;
+    }
+
+    /*
+     * The twiddle table is computed before the workers are started so that
+     * each inherits it.
+     */
+    init_fft();
+
+    shared_state_t *state = map_shared_memory(sizeof(shared_state_t) +
+                                              archive.num_pings * sizeof(ping_summary_t));
+    AbortIfNot(state, 1);
+    atomic_init(&state->next_ping, 0);
+
+    worker_args_t args;
+    args.state = state;
+    args.archive = &archive;
+    args.base = base;
+    args.overrides = overrides;
+    args.planar = planar;
+
+    const tick_t run_start = get_system_time();
+    const bool workers_failed = (run_workers(workers, run_worker, &args) != success)? true : false;
+    const uint64_t run_ns = ticks_to_ns(get_system_time() - run_start);
+
+    FILE *output = stdout;
+    if (output_filename)
+    {
+        output = fopen(output_filename, "w");
+        AbortIfNot(output, 1);
+    }
+    write_summary(output, state, &archive);
+    if (output != stdout)
+    {
+        AbortIf(fclose(output) != 0, 1);
+    }
+
+    size_t located = 0;
+    size_t accepted = 0;
+    size_t unprocessed = 0;
+    uint64_t processing_ns = 0;
+    for (size_t ping = 0; ping < archive.num_pings; ++ping)
+    {
+        const ping_summary_t *summary = &state->summaries[ping];
+        unprocessed += (summary->processed)? 0 : 1;
+        located += (summary->located)? 1 : 0;
+        accepted += (summary->accepted)? 1 : 0;
+        processing_ns += summary->processing_ns;
+    }
+
+    fprintf(stderr,
+            "%zu pings of %zu files, %zu located, %zu accepted, in %.3f s on %ld workers "
+            "(%.1f us per ping)\n",
+            archive.num_pings,
+            archive.num_files,
+            located,
+            accepted,
+            run_ns / 1e9,
+            workers,
+            processing_ns / 1000.0 / archive.num_pings);
+
+    for (size_t f = 0; f < archive.num_files; ++f)
+    {
+        close_capture_reader(&archive.files[f]);
+    }
+
+    if (workers_failed || unprocessed)
+    {
+        fprintf(stderr, "%zu pings were not processed\n", unprocessed);
+        return 1;
+    }
+
+    return 0;
+}
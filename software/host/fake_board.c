@@ -0,0 +1,825 @@
+/*
+ * Emulates a HydroZynq on a host so that host receivers and ROS bridges can
+ * be load tested without hardware.
+ *
+ * Usage: fake_board [-H host address] [-s sampling frequency]
+ *                   [-f ping frequency] [-t delay1,delay2,delay3]
+ *                   [-a amplitude] [-N noise amplitude] [-P ping period ms]
+ *                   [-n capture samples] [-R bytes per second] [-m mtu]
+ *                   [-d] [-x] [-e] [-v]
+ *
+ * Every ping period a ping is synthesized on four channels, with channels B
+ * to D delayed from channel A by the given delays in nanoseconds. The board
+ * then sends a thruster silence request ahead of the ping, and the preview
+ * envelope and a result record once the capture window closes. The capture
+ * is sent on the data stream if -d is given or debug is enabled by command,
+ * and the correlations are sent if -x is given or xcorr_stream is enabled by
+ * command. -e delta encodes the data stream. Streams are paced at the given
+ * rate in datagrams sized to the MTU, with the same layouts that the firmware
+ * sends.
+ *
+ * Text commands and binary commands are accepted on the command port. Clock
+ * synchronization requests are answered, parameter batches are acknowledged
+ * without being validated, and the text commands that change what is
+ * streamed are applied.
+ */
+#define _GNU_SOURCE
+
+#include "abort.h"
+#include "command_protocol.h"
+#include "db.h"
+#include "sample_ops.h"
+#include "sample_codec.h"
+#include "stream_format.h"
+#include "system_params.h"
+#include "types.h"
+
+#include <arpa/inet.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PI 3.14159265358979323846
+
+/**
+ * The defaults of the synthesized pings.
+ */
+#define DEFAULT_SAMPLING_FREQUENCY 5000000
+#define DEFAULT_CAPTURE_SAMPLES 300000
+#define DEFAULT_AMPLITUDE 2000
+#define DEFAULT_NOISE_AMPLITUDE 50
+#define DEFAULT_MTU 1500
+
+/**
+ * The length of each synthesized ping and the time the silence request is
+ * sent ahead of the capture window.
+ */
+#define PING_LENGTH_US 4000
+#define SILENCE_LEAD_MS 50
+
+/**
+ * The size of the IP and UDP headers, which the MTU must also hold.
+ */
+#define IP_UDP_HEADER_BYTES 28
+
+/**
+ * Defines the state of the emulated board.
+ */
+typedef struct fake_board_t
+{
+    int command_fd;
+    int stream_fd;
+    struct sockaddr_in host;
+
+    uint32_t sampling_frequency;
+    uint32_t ping_frequency;
+    int32_t delays_ns[3];
+    int32_t amplitude;
+    int32_t noise_amplitude;
+    uint32_t ping_period_ms;
+    size_t capture_samples;
+    uint32_t bytes_per_second;
+    size_t mtu;
+
+    bool debug_stream;
+    bool xcorr_stream;
+    bool preview_stream;
+    bool compress;
+
+    uint32_t param_set_version;
+    uint16_t data_transfer_id;
+    uint16_t xcorr_transfer_id;
+    uint32_t sequence;
+    uint32_t preview_sequence;
+    uint32_t noise_state;
+
+    uint64_t start_ns;
+    uint64_t next_send_ns;
+    uint64_t datagrams;
+    uint64_t bytes;
+
+    sample_t *samples;
+    correlation_t *correlations;
+    size_t max_shift;
+    preview_point_t preview[PREVIEW_POINTS];
+    uint8_t datagram[65536];
+} fake_board_t;
+
+/**
+ * Reads the monotonic clock.
+ *
+ * @return The current time in nanoseconds.
+ */
+static uint64_t now_ns()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000ull + time.tv_nsec;
+}
+
+/**
+ * Reads the emulated board clock.
+ *
+ * @param board The board.
+ *
+ * @return The time since the board started in microseconds.
+ */
+static uint64_t board_time_us(const fake_board_t *board)
+{
+    return (now_ns() - board->start_ns) / 1000;
+}
+
+/**
+ * Sends a datagram to a port of the host.
+ *
+ * @param board The board.
+ * @param port The port to send to.
+ * @param data The datagram.
+ * @param len The length of the datagram.
+ *
+ * @return Success or fail.
+ */
+static result_t send_to_host(fake_board_t *board, const uint16_t port, const void *data, const size_t len)
+{
+    struct sockaddr_in destination = board->host;
+    destination.sin_port = htons(port);
+    AbortIf(sendto(board->stream_fd, data, len, 0, (struct sockaddr *)&destination, sizeof(destination)) < 0, fail);
+
+    board->datagrams++;
+    board->bytes += len;
+
+    return success;
+}
+
+/**
+ * Applies a text command.
+ *
+ * @param board The board.
+ * @param text The command, which is modified.
+ *
+ * @return None.
+ */
+static void apply_text_command(fake_board_t *board, char *text)
+{
+    for (char *pair = strtok(text, ","); pair; pair = strtok(NULL, ","))
+    {
+        char *value = strchr(pair, ':');
+        if (!value)
+        {
+            fprintf(stderr, "Malformed command: %s\n", pair);
+            continue;
+        }
+        *value++ = 0;
+
+        const unsigned long number = strtoul(value, NULL, 0);
+        if (strcmp(pair, "debug") == 0)
+        {
+            board->debug_stream = (number)? true : false;
+        }
+        else if (strcmp(pair, "xcorr_stream") == 0)
+        {
+            board->xcorr_stream = (number)? true : false;
+        }
+        else if (strcmp(pair, "preview") == 0)
+        {
+            board->preview_stream = (number)? true : false;
+        }
+        else if (strcmp(pair, "compress") == 0)
+        {
+            board->compress = (number)? true : false;
+        }
+        else if (strcmp(pair, "ping_frequency_hz") == 0 && number < board->sampling_frequency / 2)
+        {
+            board->ping_frequency = number;
+        }
+        else if (strcmp(pair, "transmit_rate_bytes_per_second") == 0)
+        {
+            board->bytes_per_second = number;
+        }
+
+        printf("Command %s: %s\n", pair, value);
+    }
+}
+
+/**
+ * Answers a binary command.
+ *
+ * @param board The board.
+ * @param data The command.
+ * @param len The length of the command.
+ * @param receive_us The board time the command was received.
+ * @param sender The sender of the command.
+ *
+ * @return None.
+ */
+static void apply_binary_command(fake_board_t *board,
+                                 const uint8_t *data,
+                                 const size_t len,
+                                 const uint64_t receive_us,
+                                 const struct sockaddr_in *sender)
+{
+    command_header_t header;
+    if (!parse_command_header(data, len, &header))
+    {
+        return;
+    }
+
+    size_t reply_len = sizeof(header) + header.length;
+    memcpy(board->datagram, data, reply_len);
+
+    if (header.type == COMMAND_TIME_SYNC && header.length == sizeof(command_time_sync_t))
+    {
+        command_time_sync_t sync;
+        memcpy(&sync, &data[sizeof(header)], sizeof(sync));
+        sync.board_receive_us = receive_us;
+        sync.board_transmit_us = board_time_us(board);
+        memcpy(&board->datagram[sizeof(header)], &sync, sizeof(sync));
+        header.type = COMMAND_TIME_SYNC_REPLY;
+    }
+    else if (header.type == COMMAND_SET)
+    {
+        /*
+         * The parameters are echoed as if they had all been applied.
+         */
+        if (header.length)
+        {
+            board->param_set_version++;
+        }
+        header.type = COMMAND_ACK;
+        header.param_set_version = board->param_set_version;
+    }
+    else
+    {
+        return;
+    }
+
+    header.status = COMMAND_OK;
+    header.error_param = 0;
+    memcpy(board->datagram, &header, sizeof(header));
+    sendto(board->command_fd, board->datagram, reply_len, 0, (const struct sockaddr *)sender, sizeof(*sender));
+}
+
+/**
+ * Handles every command that has arrived.
+ *
+ * @param board The board.
+ *
+ * @return None.
+ */
+static void service_commands(fake_board_t *board)
+{
+    char text[2048];
+    struct sockaddr_in sender;
+    socklen_t sender_len = sizeof(sender);
+    ssize_t len;
+    while ((len = recvfrom(board->command_fd, text, sizeof(text) - 1, MSG_DONTWAIT,
+                           (struct sockaddr *)&sender, &sender_len)) >= 0)
+    {
+        const uint64_t receive_us = board_time_us(board);
+        if (is_binary_command(text, len))
+        {
+            apply_binary_command(board, (const uint8_t *)text, len, receive_us, &sender);
+        }
+        else
+        {
+            text[len] = 0;
+            apply_text_command(board, text);
+        }
+        sender_len = sizeof(sender);
+    }
+}
+
+/**
+ * Waits until a time, handling commands in the meantime.
+ *
+ * @param board The board.
+ * @param deadline The monotonic time to wait until in nanoseconds.
+ *
+ * @return None.
+ */
+static void wait_until(fake_board_t *board, const uint64_t deadline)
+{
+    while (1)
+    {
+        service_commands(board);
+
+        const uint64_t now = now_ns();
+        if (now >= deadline)
+        {
+            return;
+        }
+
+        struct pollfd fd = {.fd = board->command_fd, .events = POLLIN};
+        const uint64_t remaining_ms = (deadline - now) / 1000000;
+        if (remaining_ms)
+        {
+            poll(&fd, 1, remaining_ms);
+        }
+        else
+        {
+            const struct timespec pause = {0, deadline - now};
+            nanosleep(&pause, NULL);
+        }
+    }
+}
+
+/**
+ * Sends a streamed datagram once the rate limit allows it.
+ *
+ * @param board The board.
+ * @param port The port to send to.
+ * @param len The length of the datagram in the board's datagram buffer.
+ *
+ * @return Success or fail.
+ */
+static result_t send_paced(fake_board_t *board, const uint16_t port, const size_t len)
+{
+    if (board->bytes_per_second)
+    {
+        const uint64_t now = now_ns();
+        if (board->next_send_ns < now)
+        {
+            board->next_send_ns = now;
+        }
+        wait_until(board, board->next_send_ns);
+        board->next_send_ns += (uint64_t)len * 1000000000ull / board->bytes_per_second;
+    }
+
+    return send_to_host(board, port, board->datagram, len);
+}
+
+/**
+ * Streams an array as numbered datagrams, as send_array() does.
+ *
+ * @param board The board.
+ * @param port The port to stream to.
+ * @param data The array to send.
+ * @param element_size The size of each element in bytes.
+ * @param count The number of elements.
+ * @param transfer_id The identifier of the transfer.
+ *
+ * @return Success or fail.
+ */
+static result_t stream_array(fake_board_t *board,
+                             const uint16_t port,
+                             const void *data,
+                             const size_t element_size,
+                             const size_t count,
+                             const uint16_t transfer_id)
+{
+    const size_t per_packet = (board->mtu - IP_UDP_HEADER_BYTES - sizeof(stream_header_t)) / element_size;
+    AbortIfNot(per_packet, fail);
+
+    for (size_t i = 0, packet = 0; i < count; i += per_packet, ++packet)
+    {
+        const size_t elements = (count - i < per_packet)? count - i : per_packet;
+        const stream_header_t header = {
+            .packet_number = packet,
+            .first_element = i,
+            .element_size = element_size,
+            .element_count = elements,
+            .encoding = STREAM_ENCODING_RAW,
+            .transfer_id = transfer_id,
+            .total_elements = count
+        };
+
+        memcpy(board->datagram, &header, sizeof(header));
+        memcpy(&board->datagram[sizeof(header)], (const uint8_t *)data + i * element_size, elements * element_size);
+        AbortIfNot(send_paced(board, port, sizeof(header) + elements * element_size), fail);
+    }
+
+    return success;
+}
+
+/**
+ * Streams samples compressed by encode_samples(), as the firmware does.
+ *
+ * @param board The board.
+ * @param data The samples to send.
+ * @param count The number of samples.
+ * @param transfer_id The identifier of the transfer.
+ *
+ * @return Success or fail.
+ */
+static result_t stream_encoded_samples(fake_board_t *board,
+                                       const sample_t *data,
+                                       const size_t count,
+                                       const uint16_t transfer_id)
+{
+    const size_t capacity = board->mtu - IP_UDP_HEADER_BYTES - sizeof(stream_header_t);
+
+    size_t i = 0;
+    for (int32_t packet = 0; i < count; ++packet)
+    {
+        size_t consumed, encoded_len;
+        AbortIfNot(encode_samples(&data[i], count - i, &board->datagram[sizeof(stream_header_t)],
+                                  capacity, &consumed, &encoded_len), fail);
+
+        const stream_header_t header = {
+            .packet_number = packet,
+            .first_element = i,
+            .element_size = sizeof(sample_t),
+            .element_count = consumed,
+            .encoding = STREAM_ENCODING_DELTA,
+            .transfer_id = transfer_id,
+            .total_elements = count
+        };
+        memcpy(board->datagram, &header, sizeof(header));
+        AbortIfNot(send_paced(board, DATA_STREAM_PORT, sizeof(header) + encoded_len), fail);
+
+        i += consumed;
+    }
+
+    return success;
+}
+
+/**
+ * Sends the envelope of the capture, as send_preview() does.
+ *
+ * @param board The board.
+ * @param start_us The board time of the first sample.
+ *
+ * @return Success or fail.
+ */
+static result_t send_preview(fake_board_t *board, const uint64_t start_us)
+{
+    const size_t num_points = (board->capture_samples < PREVIEW_POINTS)?
+            board->capture_samples : PREVIEW_POINTS;
+    AbortIfNot(compute_envelope(board->samples, board->capture_samples, board->preview, num_points), fail);
+
+    const size_t per_packet = (board->mtu - IP_UDP_HEADER_BYTES - sizeof(preview_header_t)) / sizeof(preview_point_t);
+    AbortIfNot(per_packet, fail);
+
+    preview_header_t header;
+    header.version = PREVIEW_VERSION;
+    header.length = sizeof(header);
+    header.sequence = board->preview_sequence++;
+    header.timestamp_us = start_us;
+    header.capture_samples = board->capture_samples;
+    header.samples_per_point = board->capture_samples / num_points;
+    header.total_points = num_points;
+    header.reserved = 0;
+
+    for (size_t i = 0; i < num_points; i += per_packet)
+    {
+        header.first_point = i;
+        header.point_count = (num_points - i < per_packet)? num_points - i : per_packet;
+
+        const size_t points_len = header.point_count * sizeof(preview_point_t);
+        memcpy(board->datagram, &header, sizeof(header));
+        memcpy(&board->datagram[sizeof(header)], &board->preview[i], points_len);
+        AbortIfNot(send_to_host(board, PREVIEW_PORT, board->datagram, sizeof(header) + points_len), fail);
+    }
+
+    return success;
+}
+
+/**
+ * Draws uniform noise.
+ *
+ * @param board The board.
+ *
+ * @return A value between -1 and 1.
+ */
+static float next_noise(fake_board_t *board)
+{
+    board->noise_state = board->noise_state * 1664525 + 1013904223;
+    return (float)board->noise_state / UINT32_MAX * 2 - 1;
+}
+
+/**
+ * Synthesizes a capture with a ping after the first third.
+ *
+ * @param board The board.
+ * @param[out] ping_start The index of the first sample of the ping on
+ *             channel A.
+ *
+ * @return None.
+ */
+static void synthesize_capture(fake_board_t *board, size_t *ping_start)
+{
+    const double w = 2 * PI * board->ping_frequency;
+    const size_t ping_len = (uint64_t)board->sampling_frequency * PING_LENGTH_US / 1000000;
+    *ping_start = board->capture_samples / 3;
+
+    for (size_t i = 0; i < board->capture_samples; ++i)
+    {
+        for (size_t k = 0; k < 4; ++k)
+        {
+            const double delay = (k)? board->delays_ns[k - 1] * 1e-9 : 0;
+            const double t = ((double)i - *ping_start) / board->sampling_frequency - delay;
+
+            double value = board->noise_amplitude * next_noise(board);
+            if (t >= 0 && t * board->sampling_frequency < ping_len)
+            {
+                value += board->amplitude * sin(w * t);
+            }
+
+            board->samples[i].sample[k] = (analog_sample_t)value;
+        }
+    }
+}
+
+/**
+ * Correlates channel A of the ping with every other channel.
+ *
+ * @param board The board.
+ * @param ping_start The index of the first sample of the ping.
+ *
+ * @return The number of correlations.
+ */
+static size_t correlate_capture(fake_board_t *board, const size_t ping_start)
+{
+    const size_t ping_len = (uint64_t)board->sampling_frequency * PING_LENGTH_US / 1000000;
+    const int64_t max_shift = board->max_shift;
+
+    size_t count = 0;
+    for (int64_t shift = -max_shift; shift <= max_shift; ++shift)
+    {
+        int64_t sums[3] = {0, 0, 0};
+        for (size_t i = ping_start; i < ping_start + ping_len; ++i)
+        {
+            const int64_t j = (int64_t)i + shift;
+            if (j < 0 || j >= (int64_t)board->capture_samples)
+            {
+                continue;
+            }
+
+            for (size_t k = 0; k < 3; ++k)
+            {
+                sums[k] += (int32_t)board->samples[i].sample[0] * board->samples[j].sample[k + 1];
+            }
+        }
+
+        correlation_t *correlation = &board->correlations[count++];
+        correlation->left_shift = shift;
+        for (size_t k = 0; k < 3; ++k)
+        {
+            correlation->result[k] = sums[k] / (int64_t)ping_len;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * Sends the silence request, the streams, and the result of one ping.
+ *
+ * @param board The board.
+ * @param window_start The monotonic time that the capture window opens.
+ *
+ * @return Success or fail.
+ */
+static result_t emulate_ping(fake_board_t *board, const uint64_t window_start)
+{
+    const uint64_t window_ns = (uint64_t)board->capture_samples * 1000000000ull / board->sampling_frequency;
+
+    wait_until(board, window_start - SILENCE_LEAD_MS * 1000000ull);
+    silence_request_t silence;
+    silence.when_ms = SILENCE_LEAD_MS;
+    silence.duration_ms = window_ns / 1000000;
+    silence.start_us = (window_start - board->start_ns) / 1000;
+    silence.duration_us = window_ns / 1000;
+    AbortIfNot(send_to_host(board, SILENT_REQUEST_PORT, &silence, sizeof(silence)), fail);
+
+    size_t ping_start;
+    synthesize_capture(board, &ping_start);
+    wait_until(board, window_start + window_ns);
+
+    if (board->preview_stream)
+    {
+        AbortIfNot(send_preview(board, (window_start - board->start_ns) / 1000), fail);
+    }
+
+    const uint64_t datagrams_before = board->datagrams;
+    const uint64_t bytes_before = board->bytes;
+    const uint64_t stream_start = now_ns();
+    board->next_send_ns = stream_start;
+
+    if (board->debug_stream)
+    {
+        board->data_transfer_id++;
+        if (board->compress)
+        {
+            AbortIfNot(stream_encoded_samples(board, board->samples, board->capture_samples,
+                                              board->data_transfer_id), fail);
+        }
+        else
+        {
+            AbortIfNot(stream_array(board, DATA_STREAM_PORT, board->samples, sizeof(sample_t),
+                                    board->capture_samples, board->data_transfer_id), fail);
+        }
+    }
+
+    if (board->xcorr_stream)
+    {
+        const size_t count = correlate_capture(board, ping_start);
+        board->xcorr_transfer_id++;
+        AbortIfNot(stream_array(board, XCORR_STREAM_PORT, board->correlations, sizeof(correlation_t),
+                                count, board->xcorr_transfer_id), fail);
+    }
+
+    result_record_t record;
+    memset(&record, 0, sizeof(record));
+    record.version = RESULT_RECORD_VERSION;
+    record.length = sizeof(record);
+    record.sequence = board->sequence++;
+    record.timestamp_us = (window_start - board->start_ns) / 1000 +
+            (uint64_t)ping_start * 1000000 / board->sampling_frequency;
+    for (size_t k = 0; k < 3; ++k)
+    {
+        record.channel_delay_ns[k] = board->delays_ns[k];
+        record.confidence[k] = 1;
+    }
+    for (size_t k = 0; k < 4; ++k)
+    {
+        record.peak_amplitude[k] = board->amplitude;
+    }
+    record.filter_duration_us = 0;
+    record.correlation_duration_us = 0;
+    record.quality = 1;
+    AbortIfNot(send_to_host(board, RESULT_PORT, &record, sizeof(record)), fail);
+
+    const double seconds = (now_ns() - stream_start) / 1e9;
+    dblog(LOG_INFO, "Ping %u: %lu datagrams, %lu bytes in %.3f s (%.1f MB/s)\n",
+          record.sequence,
+          (unsigned long)(board->datagrams - datagrams_before),
+          (unsigned long)(board->bytes - bytes_before),
+          seconds,
+          (seconds > 0)? (board->bytes - bytes_before) / seconds / 1e6 : 0);
+
+    return success;
+}
+
+/**
+ * Parses a list of three delays.
+ *
+ * @param value The comma separated delays in nanoseconds.
+ * @param[out] delays The parsed delays.
+ *
+ * @return Success or fail.
+ */
+static result_t parse_delays(const char *value, int32_t delays[3])
+{
+    char *end;
+    for (size_t k = 0; k < 3; ++k)
+    {
+        delays[k] = strtol(value, &end, 0);
+        AbortIf(end == value, fail);
+        value = (*end == ',')? end + 1 : end;
+    }
+
+    return success;
+}
+
+int main(int argc, char **argv)
+{
+    static fake_board_t board;
+    memset(&board, 0, sizeof(board));
+    board.sampling_frequency = DEFAULT_SAMPLING_FREQUENCY;
+    board.ping_frequency = INITIAL_PING_FREQUENCY_HZ;
+    board.delays_ns[0] = 4000;
+    board.delays_ns[1] = 8000;
+    board.delays_ns[2] = 6000;
+    board.amplitude = DEFAULT_AMPLITUDE;
+    board.noise_amplitude = DEFAULT_NOISE_AMPLITUDE;
+    board.ping_period_ms = PING_PERIOD_MS;
+    board.capture_samples = DEFAULT_CAPTURE_SAMPLES;
+    board.bytes_per_second = INITIAL_TRANSMIT_RATE_BYTES_PER_SECOND;
+    board.mtu = DEFAULT_MTU;
+    board.param_set_version = 1;
+    board.preview_stream = true;
+    board.noise_state = 1;
+
+    const char *host = "127.0.0.1";
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-v") == 0)
+        {
+            set_log_level(LOG_DEBUG);
+            continue;
+        }
+        else if (strcmp(argv[i], "-d") == 0)
+        {
+            board.debug_stream = true;
+            continue;
+        }
+        else if (strcmp(argv[i], "-x") == 0)
+        {
+            board.xcorr_stream = true;
+            continue;
+        }
+        else if (strcmp(argv[i], "-e") == 0)
+        {
+            board.compress = true;
+            continue;
+        }
+
+        if (i + 1 >= argc)
+        {
+            fprintf(stderr, "Missing value for %s\n", argv[i]);
+            return 1;
+        }
+
+        const char *value = argv[++i];
+        if (strcmp(argv[i - 1], "-H") == 0)
+        {
+            host = value;
+        }
+        else if (strcmp(argv[i - 1], "-s") == 0)
+        {
+            board.sampling_frequency = strtoul(value, NULL, 0);
+        }
+        else if (strcmp(argv[i - 1], "-f") == 0)
+        {
+            board.ping_frequency = strtoul(value, NULL, 0);
+        }
+        else if (strcmp(argv[i - 1], "-t") == 0)
+        {
+            AbortIfNot(parse_delays(value, board.delays_ns), 1);
+        }
+        else if (strcmp(argv[i - 1], "-a") == 0)
+        {
+            board.amplitude = strtol(value, NULL, 0);
+        }
+        else if (strcmp(argv[i - 1], "-N") == 0)
+        {
+            board.noise_amplitude = strtol(value, NULL, 0);
+        }
+        else if (strcmp(argv[i - 1], "-P") == 0)
+        {
+            board.ping_period_ms = strtoul(value, NULL, 0);
+        }
+        else if (strcmp(argv[i - 1], "-n") == 0)
+        {
+            board.capture_samples = strtoul(value, NULL, 0);
+        }
+        else if (strcmp(argv[i - 1], "-R") == 0)
+        {
+            board.bytes_per_second = strtoul(value, NULL, 0);
+        }
+        else if (strcmp(argv[i - 1], "-m") == 0)
+        {
+            board.mtu = strtoul(value, NULL, 0);
+        }
+        else
+        {
+            fprintf(stderr, "Unknown option %s\n", argv[i - 1]);
+            return 1;
+        }
+    }
+
+    AbortIfNot(board.sampling_frequency, 1);
+    AbortIfNot(board.capture_samples, 1);
+    AbortIfNot(board.mtu > IP_UDP_HEADER_BYTES + sizeof(stream_header_t) + sizeof(correlation_t), 1);
+    AbortIfNot(board.mtu <= sizeof(board.datagram), 1);
+
+    const uint64_t window_ns = (uint64_t)board.capture_samples * 1000000000ull / board.sampling_frequency;
+    AbortIfNot(window_ns + SILENCE_LEAD_MS * 1000000ull < board.ping_period_ms * 1000000ull, 1);
+
+    board.samples = malloc(board.capture_samples * sizeof(sample_t));
+    board.max_shift = ceil(board.sampling_frequency * MAX_TIME_BETWEEN_PHONES) + 1;
+    board.correlations = malloc((2 * board.max_shift + 1) * sizeof(correlation_t));
+    AbortIfNot(board.samples, 1);
+    AbortIfNot(board.correlations, 1);
+
+    memset(&board.host, 0, sizeof(board.host));
+    board.host.sin_family = AF_INET;
+    AbortIf(inet_pton(AF_INET, host, &board.host.sin_addr) != 1, 1);
+
+    board.stream_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    board.command_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    AbortIf(board.stream_fd < 0, 1);
+    AbortIf(board.command_fd < 0, 1);
+
+    struct sockaddr_in command_address;
+    memset(&command_address, 0, sizeof(command_address));
+    command_address.sin_family = AF_INET;
+    command_address.sin_port = htons(COMMAND_SOCKET_PORT);
+    command_address.sin_addr.s_addr = htonl(INADDR_ANY);
+    AbortIf(bind(board.command_fd, (struct sockaddr *)&command_address, sizeof(command_address)) != 0, 1);
+
+    printf("Emulating a HydroZynq for %s: %u Hz pings every %u ms, delays %d %d %d ns\n",
+           host, board.ping_frequency, board.ping_period_ms,
+           board.delays_ns[0], board.delays_ns[1], board.delays_ns[2]);
+    fflush(stdout);
+
+    /*
+     * Windows are scheduled from the start time rather than from the end of
+     * the previous ping, so a slow host does not shift the ping train.
+     */
+    board.start_ns = now_ns();
+    for (uint64_t ping = 1;; ++ping)
+    {
+        const uint64_t window_start = board.start_ns + ping * board.ping_period_ms * 1000000ull;
+        AbortIfNot(emulate_ping(&board, window_start), 1);
+    }
+
+    return 0;
+}
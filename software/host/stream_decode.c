@@ -0,0 +1,294 @@
+#include "stream_decode.h"
+
+#include "abort.h"
+#include "sample_codec.h"
+#include "stream_format.h"
+#include "types.h"
+
+#include <string.h>
+
+/**
+ * Reads the header of a data or correlation stream datagram.
+ *
+ * @param datagram The datagram.
+ * @param len The length of the datagram in bytes.
+ * @param[out] header The header of the datagram.
+ *
+ * @return Success or fail if the datagram is shorter than its header.
+ */
+result_t stream_decode_header(const uint8_t *datagram, const size_t len, stream_header_t *header)
+{
+    AbortIfNot(datagram, fail);
+    AbortIfNot(header, fail);
+
+    if (len < sizeof(*header))
+    {
+        return fail;
+    }
+
+    memcpy(header, datagram, sizeof(*header));
+
+    return success;
+}
+
+/**
+ * Decodes the samples of a data stream payload in either encoding.
+ *
+ * @param header The header of the datagram that carried the payload.
+ * @param payload The payload that follows the header.
+ * @param payload_len The length of the payload in bytes.
+ * @param[out] out The samples of the datagram.
+ * @param capacity The number of samples that can be stored.
+ *
+ * @return Success or fail if the payload is truncated or malformed or its
+ *         samples do not fit.
+ */
+result_t stream_decode_payload(const stream_header_t *header,
+                               const uint8_t *payload,
+                               const size_t payload_len,
+                               sample_t *out,
+                               const size_t capacity)
+{
+    AbortIfNot(header, fail);
+    AbortIfNot(payload || !payload_len, fail);
+    AbortIfNot(out, fail);
+
+    if (header->element_size != sizeof(sample_t) || header->element_count > capacity)
+    {
+        return fail;
+    }
+
+    const size_t count = header->element_count;
+    if (!count)
+    {
+        return success;
+    }
+
+    if (header->encoding == STREAM_ENCODING_DELTA)
+    {
+        return decode_samples(payload, payload_len, out, count);
+    }
+
+    if (header->encoding == STREAM_ENCODING_RAW && payload_len >= count * sizeof(sample_t))
+    {
+        memcpy(out, payload, count * sizeof(sample_t));
+        return success;
+    }
+
+    return fail;
+}
+
+/**
+ * Decodes the samples of a data stream datagram in either encoding.
+ *
+ * @param datagram The datagram.
+ * @param len The length of the datagram in bytes.
+ * @param[out] header The header of the datagram.
+ * @param[out] out The samples of the datagram.
+ * @param capacity The number of samples that can be stored.
+ *
+ * @return Success or fail if the datagram is truncated or malformed or its
+ *         samples do not fit.
+ */
+result_t stream_decode_samples(const uint8_t *datagram,
+                               const size_t len,
+                               stream_header_t *header,
+                               sample_t *out,
+                               const size_t capacity)
+{
+    if (!stream_decode_header(datagram, len, header))
+    {
+        return fail;
+    }
+
+    return stream_decode_payload(header, &datagram[sizeof(*header)], len - sizeof(*header), out, capacity);
+}
+
+/**
+ * Decodes the samples of a data stream payload at their index within the
+ * samples of its transfer.
+ *
+ * @param header The header of the datagram that carried the payload.
+ * @param payload The payload that follows the header.
+ * @param payload_len The length of the payload in bytes.
+ * @param[out] transfer The samples of the transfer.
+ * @param total The number of samples of the transfer.
+ *
+ * @return Success or fail if the payload is malformed or lies outside of the
+ *         transfer.
+ */
+result_t stream_place_payload(const stream_header_t *header,
+                              const uint8_t *payload,
+                              const size_t payload_len,
+                              sample_t *transfer,
+                              const size_t total)
+{
+    AbortIfNot(header, fail);
+    AbortIfNot(transfer, fail);
+
+    if (header->first_element > total)
+    {
+        return fail;
+    }
+
+    return stream_decode_payload(header,
+                                 payload,
+                                 payload_len,
+                                 &transfer[header->first_element],
+                                 total - header->first_element);
+}
+
+/**
+ * Decodes the samples of a data stream datagram at their index within the
+ * samples of its transfer.
+ *
+ * @param datagram The datagram.
+ * @param len The length of the datagram in bytes.
+ * @param[out] header The header of the datagram.
+ * @param[out] transfer The samples of the transfer.
+ * @param total The number of samples of the transfer.
+ *
+ * @return Success or fail if the datagram is malformed or lies outside of
+ *         the transfer.
+ */
+result_t stream_place_samples(const uint8_t *datagram,
+                              const size_t len,
+                              stream_header_t *header,
+                              sample_t *transfer,
+                              const size_t total)
+{
+    if (!stream_decode_header(datagram, len, header))
+    {
+        return fail;
+    }
+
+    return stream_place_payload(header, &datagram[sizeof(*header)], len - sizeof(*header), transfer, total);
+}
+
+/**
+ * Decodes the samples of a run of data stream datagrams of one transfer, as
+ * they were received or stored back to back, at their index within the
+ * transfer.
+ *
+ * @note Malformed datagrams and datagrams of other transfers are skipped.
+ *
+ * @param data The datagrams.
+ * @param lengths The length of each datagram in bytes.
+ * @param count The number of datagrams.
+ * @param[out] transfer The samples of the transfer.
+ * @param total The number of samples of the transfer.
+ * @param[out] received Set nonzero for each sample that was placed, or NULL.
+ * @param[out] placed The number of datagrams that were placed.
+ *
+ * @return Success or fail.
+ */
+result_t stream_place_datagrams(const uint8_t *data,
+                                const uint32_t *lengths,
+                                const size_t count,
+                                sample_t *transfer,
+                                const size_t total,
+                                uint8_t *received,
+                                size_t *placed)
+{
+    AbortIfNot(data || !count, fail);
+    AbortIfNot(lengths || !count, fail);
+    AbortIfNot(transfer, fail);
+    AbortIfNot(placed, fail);
+
+    *placed = 0;
+    size_t offset = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        stream_header_t header;
+        if (stream_place_samples(&data[offset], lengths[i], &header, transfer, total) &&
+            header.total_elements == total)
+        {
+            if (received)
+            {
+                memset(&received[header.first_element], 1, header.element_count);
+            }
+            (*placed)++;
+        }
+
+        offset += lengths[i];
+    }
+
+    return success;
+}
+
+/**
+ * Reads the result records of a result stream datagram, which may batch
+ * several messages.
+ *
+ * @param datagram The datagram.
+ * @param len The length of the datagram in bytes.
+ * @param[out] out The result records.
+ * @param capacity The number of records that can be stored.
+ * @param[out] count The number of records read.
+ *
+ * @return Success or fail if the datagram is truncated, a record is of
+ *         another version, or the records do not fit.
+ */
+result_t stream_decode_results(const uint8_t *datagram,
+                               const size_t len,
+                               result_record_t *out,
+                               const size_t capacity,
+                               size_t *count)
+{
+    AbortIfNot(datagram, fail);
+    AbortIfNot(out, fail);
+    AbortIfNot(count, fail);
+
+    *count = 0;
+    message_batch_header_t batch;
+    if (len < sizeof(batch))
+    {
+        return fail;
+    }
+
+    memcpy(&batch, datagram, sizeof(batch));
+    const bool batched = (batch.marker == MESSAGE_BATCH_MARKER)? true : false;
+    const size_t messages = (batched)? batch.count : 1;
+    size_t offset = (batched)? sizeof(batch) : 0;
+
+    for (size_t i = 0; i < messages; ++i)
+    {
+        message_header_t message = {MESSAGE_RESULT, (uint16_t)len};
+        if (batched)
+        {
+            if (offset + sizeof(message) > len)
+            {
+                return fail;
+            }
+
+            memcpy(&message, &datagram[offset], sizeof(message));
+            offset += sizeof(message);
+        }
+
+        if (offset + message.length > len)
+        {
+            return fail;
+        }
+
+        if (message.type == MESSAGE_RESULT)
+        {
+            result_record_t record;
+            if (message.length < sizeof(record) || *count >= capacity)
+            {
+                return fail;
+            }
+
+            memcpy(&record, &datagram[offset], sizeof(record));
+            if (record.version != RESULT_RECORD_VERSION || record.length != sizeof(record))
+            {
+                return fail;
+            }
+
+            out[(*count)++] = record;
+        }
+
+        offset += message.length;
+    }
+
+    return success;
+}
@@ -0,0 +1,53 @@
+#ifndef STREAM_DECODE_H
+#define STREAM_DECODE_H
+
+#include "stream_format.h"
+#include "types.h"
+
+/**
+ * Decodes the streams of the HydroZynq on a host. The functions take and
+ * return only plain buffers so that they may be called through ctypes, where
+ * scripts/stream_decode.py passes numpy arrays that are filled in place.
+ */
+
+result_t stream_decode_header(const uint8_t *datagram, const size_t len, stream_header_t *header);
+
+result_t stream_decode_payload(const stream_header_t *header,
+                               const uint8_t *payload,
+                               const size_t payload_len,
+                               sample_t *out,
+                               const size_t capacity);
+
+result_t stream_decode_samples(const uint8_t *datagram,
+                               const size_t len,
+                               stream_header_t *header,
+                               sample_t *out,
+                               const size_t capacity);
+
+result_t stream_place_payload(const stream_header_t *header,
+                              const uint8_t *payload,
+                              const size_t payload_len,
+                              sample_t *transfer,
+                              const size_t total);
+
+result_t stream_place_samples(const uint8_t *datagram,
+                              const size_t len,
+                              stream_header_t *header,
+                              sample_t *transfer,
+                              const size_t total);
+
+result_t stream_place_datagrams(const uint8_t *data,
+                                const uint32_t *lengths,
+                                const size_t count,
+                                sample_t *transfer,
+                                const size_t total,
+                                uint8_t *received,
+                                size_t *placed);
+
+result_t stream_decode_results(const uint8_t *datagram,
+                               const size_t len,
+                               result_record_t *out,
+                               const size_t capacity,
+                               size_t *count);
+
+#endif
@@ -0,0 +1,77 @@
+#define _GNU_SOURCE
+
+#include "worker_pool.h"
+
+#include "abort.h"
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/**
+ * Counts the cores of the host that are online.
+ *
+ * @return The number of cores, which is at least one.
+ */
+size_t count_host_cores()
+{
+    const long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return (cores > 0)? cores : 1;
+}
+
+/**
+ * Maps zeroed memory that is shared with the workers started afterwards.
+ *
+ * @param bytes The size of the memory.
+ *
+ * @return The memory, or NULL if it could not be mapped.
+ */
+void *map_shared_memory(const size_t bytes)
+{
+    void *memory = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    return (memory == MAP_FAILED)? NULL : memory;
+}
+
+/**
+ * Runs work in worker processes and waits for all of them to finish.
+ *
+ * @param workers The number of workers.
+ * @param work The work that each worker runs.
+ * @param arg The argument of the work.
+ *
+ * @return Success, or fail if any worker could not be started or failed.
+ */
+result_t run_workers(const size_t workers, result_t (*work)(void *arg), void *arg)
+{
+    AbortIfNot(work, fail);
+
+    size_t started = 0;
+    result_t ret = success;
+    for (; started < workers; ++started)
+    {
+        const pid_t pid = fork();
+        if (pid < 0)
+        {
+            ret = fail;
+            break;
+        }
+
+        if (pid == 0)
+        {
+            _exit((work(arg) == success)? 0 : 1);
+        }
+    }
+
+    for (size_t i = 0; i < started; ++i)
+    {
+        int status = 0;
+        if (wait(&status) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            ret = fail;
+        }
+    }
+
+    return ret;
+}
@@ -0,0 +1,19 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include "types.h"
+
+/**
+ * Runs work across worker processes on a host. The workers share only the
+ * memory mapped by map_shared_memory() before they are started.
+ *
+ * @note This is kept apart from the DSP headers, whose truncate() clashes
+ *       with the one declared by unistd.h.
+ */
+size_t count_host_cores();
+
+void *map_shared_memory(const size_t bytes);
+
+result_t run_workers(const size_t workers, result_t (*work)(void *arg), void *arg);
+
+#endif
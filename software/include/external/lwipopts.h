@@ -60,6 +60,11 @@
 #define TCP_SYNMAXRTX 4
 #define TCP_QUEUE_OOSEQ 1
 #define TCP_SND_QUEUELEN   16 * TCP_SND_BUF/TCP_MSS
+/*
+ * Checksums are generated and checked by the GEM rather than by lwIP. The
+ * adapter in liblwip4.a is built from these options, so switching to software
+ * checksums requires rebuilding the library with both sets inverted.
+ */
 #define CHECKSUM_GEN_TCP 	0
 #define CHECKSUM_GEN_UDP 	0
 #define CHECKSUM_GEN_IP  	0
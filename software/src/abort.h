@@ -7,7 +7,7 @@
 { \
     if (!(x)) \
     { \
-        dbprintf(__FILE__ ":%d - AbortIfNot()\n", __LINE__); \
+        dblog(LOG_ERROR, __FILE__ ":%d - AbortIfNot()\n", __LINE__); \
         return ret; \
     }\
 }\
@@ -16,7 +16,7 @@
 { \
     if ((x)) \
     { \
-        dbprintf(__FILE__ ":%d - AbortIf()\n", __LINE__); \
+        dblog(LOG_ERROR, __FILE__ ":%d - AbortIf()\n", __LINE__); \
         return ret; \
     }\
 }\
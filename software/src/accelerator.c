@@ -0,0 +1,395 @@
+#include "accelerator.h"
+
+#include "abort.h"
+#include "capture_arena.h"
+#include "system.h"
+#include "system_params.h"
+#include "time_util.h"
+
+#include "xdevcfg_hw.h"
+#include "xil_cache.h"
+#include "xparameters.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * The word that starts the configuration packets of a bitstream, and the
+ * number of words searched for it.
+ */
+#define BITSTREAM_SYNC_WORD 0xAA995566
+#define BITSTREAM_SYNC_SEARCH_WORDS 64
+
+/**
+ * The length of the first field of a bitstream file written by Vivado.
+ */
+#define BIT_HEADER_MAGIC_LEN 9
+
+/**
+ * The bit of the DMA addresses that marks the last transfer of a bitstream.
+ */
+#define PCAP_LAST_TRANSFER 0x1
+
+/**
+ * The configuration words of each module. Every module is written in full
+ * before it is marked valid, so the storage is not cleared at boot.
+ */
+NO_INIT static uint32_t module_words[ACCELERATOR_MAX_MODULES][ACCELERATOR_MODULE_MAX_BYTES / sizeof(uint32_t)]
+        __attribute__((aligned(CAPTURE_ARENA_ALIGNMENT)));
+
+/**
+ * Defines the fields of a bitstream file that a module is checked against.
+ */
+typedef struct bit_header_t
+{
+    const char *name;
+    size_t name_len;
+    const char *part;
+    size_t part_len;
+
+    const uint8_t *data;
+    size_t data_len;
+} bit_header_t;
+
+/**
+ * Reads a big endian field of a bitstream file.
+ *
+ * @param p The first byte of the field.
+ * @param len The length of the field in bytes.
+ *
+ * @return The value of the field.
+ */
+static uint32_t read_bit_field(const uint8_t *p, const size_t len)
+{
+    uint32_t value = 0;
+    for (size_t i = 0; i < len; ++i)
+    {
+        value = (value << 8) | p[i];
+    }
+
+    return value;
+}
+
+/**
+ * Parses the header of a bitstream file written by Vivado, which holds the
+ * design name, the part, the build time and the configuration data as
+ * fields keyed 'a' to 'e'.
+ *
+ * @param bitstream The bitstream file.
+ * @param len The length of the file in bytes.
+ * @param[out] header The fields of the file.
+ *
+ * @return Success, or fail if the file has no such header.
+ */
+static result_t parse_bit_header(const uint8_t *bitstream, const size_t len, bit_header_t *header)
+{
+    memset(header, 0, sizeof(*header));
+
+    /*
+     * A binary without a header is not an error, so it is not reported.
+     */
+    if (len < 2 || read_bit_field(bitstream, 2) != BIT_HEADER_MAGIC_LEN)
+    {
+        return fail;
+    }
+
+    size_t offset = 2 + BIT_HEADER_MAGIC_LEN;
+
+    /*
+     * A field of length one, holding the key of the design name, follows the
+     * magic.
+     */
+    AbortIfNot(offset + 2 <= len && read_bit_field(&bitstream[offset], 2) == 1, fail);
+    offset += 2;
+
+    while (offset < len)
+    {
+        const uint8_t key = bitstream[offset++];
+        if (key == 'e')
+        {
+            AbortIfNot(offset + 4 <= len, fail);
+            const size_t data_len = read_bit_field(&bitstream[offset], 4);
+            offset += 4;
+            AbortIfNot(data_len <= len - offset, fail);
+
+            header->data = &bitstream[offset];
+            header->data_len = data_len;
+            return success;
+        }
+
+        AbortIfNot(key >= 'a' && key <= 'd', fail);
+        AbortIfNot(offset + 2 <= len, fail);
+        const size_t field_len = read_bit_field(&bitstream[offset], 2);
+        offset += 2;
+        AbortIfNot(field_len <= len - offset, fail);
+
+        /*
+         * Strings are terminated within their field.
+         */
+        const char *field = (const char *)&bitstream[offset];
+        const char *end = memchr(field, 0, field_len);
+        const size_t string_len = (end)? (size_t)(end - field) : field_len;
+        if (key == 'a')
+        {
+            header->name = field;
+            header->name_len = string_len;
+        }
+        else if (key == 'b')
+        {
+            header->part = field;
+            header->part_len = string_len;
+        }
+
+        offset += field_len;
+    }
+
+    return fail;
+}
+
+/**
+ * Finds the byte order of the configuration data of a bitstream from its
+ * sync word.
+ *
+ * @param data The configuration data.
+ * @param len The length of the data in bytes.
+ * @param[out] swap Set true if each word must be swapped for the PCAP, as
+ *             it must for a bitstream file, and false for a binary that
+ *             bootgen already swapped.
+ *
+ * @return Success, or fail if no sync word is found.
+ */
+static result_t find_sync_word(const uint8_t *data, const size_t len, bool *swap)
+{
+    for (size_t i = 0; i < BITSTREAM_SYNC_SEARCH_WORDS && (i + 1) * sizeof(uint32_t) <= len; ++i)
+    {
+        uint32_t word;
+        memcpy(&word, &data[i * sizeof(uint32_t)], sizeof(word));
+        if (word == BITSTREAM_SYNC_WORD)
+        {
+            *swap = false;
+            return success;
+        }
+
+        if (word == __builtin_bswap32(BITSTREAM_SYNC_WORD))
+        {
+            *swap = true;
+            return success;
+        }
+    }
+
+    return fail;
+}
+
+/**
+ * Transfers configuration words to the fabric through the PCAP without
+ * clearing it, which reconfigures only the frames the words address.
+ *
+ * @param words The configuration words.
+ * @param num_words The number of words.
+ *
+ * @return Success, or fail if the transfer fails or does not complete in
+ *         time.
+ */
+static result_t pcap_transfer(const uint32_t *words, const size_t num_words)
+{
+    const uint32_t base = XPAR_XDCFG_0_BASEADDR;
+
+    XDcfg_WriteReg(base, XDCFG_UNLOCK_OFFSET, XDCFG_UNLOCK_DATA);
+    XDcfg_WriteReg(base, XDCFG_CTRL_OFFSET, XDcfg_ReadReg(base, XDCFG_CTRL_OFFSET) |
+            XDCFG_CTRL_PCAP_PR_MASK | XDCFG_CTRL_PCAP_MODE_MASK);
+    XDcfg_WriteReg(base, XDCFG_MCTRL_OFFSET,
+            XDcfg_ReadReg(base, XDCFG_MCTRL_OFFSET) & ~XDCFG_MCTRL_PCAP_LPBK_MASK);
+    XDcfg_WriteReg(base, XDCFG_INT_STS_OFFSET, XDCFG_IXR_ALL_MASK);
+    AbortIf(XDcfg_ReadReg(base, XDCFG_STATUS_OFFSET) & XDCFG_STATUS_DMA_CMD_Q_F_MASK, fail);
+
+    Xil_DCacheFlushRange((INTPTR)words, num_words * sizeof(uint32_t));
+
+    /*
+     * The words are written to the PCAP rather than to memory, and the last
+     * transfer flag lets the PCAP report done once the fabric took them.
+     */
+    XDcfg_WriteReg(base, XDCFG_DMA_SRC_ADDR_OFFSET, (uint32_t)(uintptr_t)words | PCAP_LAST_TRANSFER);
+    XDcfg_WriteReg(base, XDCFG_DMA_DEST_ADDR_OFFSET, XDCFG_DMA_INVALID_ADDRESS);
+    XDcfg_WriteReg(base, XDCFG_DMA_SRC_LEN_OFFSET, num_words);
+    XDcfg_WriteReg(base, XDCFG_DMA_DEST_LEN_OFFSET, 0);
+
+    const tick_t start_time = get_system_time();
+    while (1)
+    {
+        const uint32_t status = XDcfg_ReadReg(base, XDCFG_INT_STS_OFFSET);
+        AbortIf(status & XDCFG_IXR_ERROR_FLAGS_MASK, fail);
+        if (status & XDCFG_IXR_D_P_DONE_MASK)
+        {
+            break;
+        }
+
+        AbortIf(get_system_time() - start_time > ms_to_ticks(ACCELERATOR_LOAD_TIMEOUT_MS), fail);
+    }
+
+    XDcfg_WriteReg(base, XDCFG_INT_STS_OFFSET, XDCFG_IXR_ALL_MASK);
+
+    return success;
+}
+
+/**
+ * Initializes the modules of the reconfigurable region. No module is held
+ * until one is registered.
+ *
+ * @param[out] manager The manager to initialize.
+ *
+ * @return Success or fail.
+ */
+result_t init_accelerators(accelerator_manager_t *manager)
+{
+    AbortIfNot(manager, fail);
+
+    memset(manager, 0, sizeof(*manager));
+    for (size_t i = 0; i < ACCELERATOR_MAX_MODULES; ++i)
+    {
+        manager->modules[i].words = module_words[i];
+    }
+    manager->loaded = ACCELERATOR_MODULE_NONE;
+
+    return success;
+}
+
+/**
+ * Registers the partial bitstream of a module, replacing the one it held.
+ *
+ * @note Bitstream files written by Vivado are checked against the part of
+ *       the board. Binaries written by bootgen carry no header and are only
+ *       checked for a sync word.
+ *
+ * @param manager The manager.
+ * @param module The number of the module.
+ * @param bitstream The bitstream, which is copied into the module.
+ * @param len The length of the bitstream in bytes.
+ *
+ * @return Success or fail.
+ */
+result_t register_accelerator_module(accelerator_manager_t *manager,
+                                     const uint32_t module,
+                                     const uint8_t *bitstream,
+                                     const size_t len)
+{
+    AbortIfNot(manager, fail);
+    AbortIfNot(bitstream, fail);
+    AbortIfNot(module != ACCELERATOR_MODULE_NONE && module <= ACCELERATOR_MAX_MODULES, fail);
+
+    accelerator_module_t *slot = &manager->modules[module - 1];
+
+    bit_header_t header;
+    if (!parse_bit_header(bitstream, len, &header))
+    {
+        header.name = NULL;
+        header.data = bitstream;
+        header.data_len = len;
+    }
+    else
+    {
+        const size_t part_len = strlen(ACCELERATOR_PART);
+        AbortIfNot(header.part && header.part_len >= part_len, fail);
+        AbortIfNot(strncmp(header.part, ACCELERATOR_PART, part_len) == 0, fail);
+    }
+
+    AbortIfNot(header.data_len && header.data_len % sizeof(uint32_t) == 0, fail);
+    AbortIfNot(header.data_len <= ACCELERATOR_MODULE_MAX_BYTES, fail);
+
+    bool swap = false;
+    AbortIfNot(find_sync_word(header.data, header.data_len, &swap), fail);
+
+    slot->valid = false;
+    if (module == manager->loaded)
+    {
+        manager->loaded = ACCELERATOR_MODULE_NONE;
+    }
+
+    slot->num_words = header.data_len / sizeof(uint32_t);
+    memcpy(slot->words, header.data, header.data_len);
+    if (swap)
+    {
+        for (size_t i = 0; i < slot->num_words; ++i)
+        {
+            slot->words[i] = __builtin_bswap32(slot->words[i]);
+        }
+    }
+
+    if (header.name)
+    {
+        const size_t name_len = (header.name_len < ACCELERATOR_NAME_LEN)?
+                header.name_len : ACCELERATOR_NAME_LEN - 1;
+        memcpy(slot->name, header.name, name_len);
+        slot->name[name_len] = 0;
+    }
+    else
+    {
+        snprintf(slot->name, ACCELERATOR_NAME_LEN, "module %u", (unsigned int)module);
+    }
+
+    slot->valid = true;
+
+    return success;
+}
+
+/**
+ * Loads a module into the reconfigurable region, unless the region already
+ * holds it.
+ *
+ * @note This blocks until the configuration port completes, which takes
+ *       about a millisecond for every 128 KiB of bitstream.
+ *
+ * @param manager The manager.
+ * @param module The number of the module.
+ *
+ * @return Success or fail.
+ */
+result_t load_accelerator_module(accelerator_manager_t *manager, const uint32_t module)
+{
+    AbortIfNot(manager, fail);
+    AbortIfNot(module != ACCELERATOR_MODULE_NONE && module <= ACCELERATOR_MAX_MODULES, fail);
+
+    const accelerator_module_t *slot = &manager->modules[module - 1];
+    AbortIfNot(slot->valid, fail);
+    if (manager->loaded == module)
+    {
+        return success;
+    }
+
+    /*
+     * A failed load leaves the region in an unknown state, so no module is
+     * considered loaded until one loads.
+     */
+    manager->loaded = ACCELERATOR_MODULE_NONE;
+
+    const tick_t start_time = get_system_time();
+    if (!pcap_transfer(slot->words, slot->num_words))
+    {
+        manager->failures++;
+        return fail;
+    }
+
+    manager->last_load_us = (uint32_t)ticks_to_micros(get_system_time() - start_time);
+    manager->loaded = module;
+    manager->loads++;
+
+    return success;
+}
+
+/**
+ * Gets a module of the reconfigurable region.
+ *
+ * @param manager The manager.
+ * @param module The number of the module.
+ *
+ * @return The module, or NULL if no such module is registered.
+ */
+const accelerator_module_t *get_accelerator_module(const accelerator_manager_t *manager, const uint32_t module)
+{
+    if (!manager || module == ACCELERATOR_MODULE_NONE || module > ACCELERATOR_MAX_MODULES ||
+        !manager->modules[module - 1].valid)
+    {
+        return NULL;
+    }
+
+    return &manager->modules[module - 1];
+}
@@ -0,0 +1,74 @@
+#ifndef ACCELERATOR_H
+#define ACCELERATOR_H
+
+#include "types.h"
+
+/**
+ * The number of accelerator modules that may be held for the reconfigurable
+ * region, which are numbered from one. Module zero leaves the region as it is.
+ */
+#define ACCELERATOR_MAX_MODULES 4
+#define ACCELERATOR_MODULE_NONE 0
+
+/**
+ * The largest partial bitstream of a module in bytes, and the longest design
+ * name kept for it including its terminator.
+ */
+#define ACCELERATOR_MODULE_MAX_BYTES 0x100000
+#define ACCELERATOR_NAME_LEN 32
+
+/**
+ * Defines a partial bitstream of the reconfigurable region, held in the form
+ * the configuration port reads.
+ */
+typedef struct accelerator_module_t
+{
+    bool valid;
+    char name[ACCELERATOR_NAME_LEN];
+
+    /*
+     * The configuration words of the bitstream from its sync word, each in
+     * the byte order the PCAP shifts out.
+     */
+    uint32_t *words;
+    size_t num_words;
+} accelerator_module_t;
+
+/**
+ * Defines the modules of the reconfigurable region and the one it holds.
+ *
+ * @note The static design, including the quad ADC core and the DMA engine,
+ *       keeps running while a module is loaded, but the outputs of the region
+ *       are undefined until the load completes. Modules are therefore only
+ *       swapped between captures.
+ */
+typedef struct accelerator_manager_t
+{
+    accelerator_module_t modules[ACCELERATOR_MAX_MODULES];
+
+    /*
+     * The module the region holds, or ACCELERATOR_MODULE_NONE if it holds
+     * the module of the boot bitstream.
+     */
+    uint32_t loaded;
+
+    /*
+     * The loads completed and failed, and the time the last load took.
+     */
+    uint32_t loads;
+    uint32_t failures;
+    uint32_t last_load_us;
+} accelerator_manager_t;
+
+result_t init_accelerators(accelerator_manager_t *manager);
+
+result_t register_accelerator_module(accelerator_manager_t *manager,
+                                     const uint32_t module,
+                                     const uint8_t *bitstream,
+                                     const size_t len);
+
+result_t load_accelerator_module(accelerator_manager_t *manager, const uint32_t module);
+
+const accelerator_module_t *get_accelerator_module(const accelerator_manager_t *manager, const uint32_t module);
+
+#endif
@@ -5,6 +5,9 @@
 #include "system.h"
 #include "time_util.h"
 #include "db.h"
+#include "system_params.h"
+
+#include <math.h>
 
 result_t init_adc(adc_driver_t *adc, spi_driver_t *spi, uint32_t addr, bool verify, bool test_pattern)
 {
@@ -14,6 +17,8 @@ result_t init_adc(adc_driver_t *adc, spi_driver_t *spi, uint32_t addr, bool veri
     AbortIfNot(adc, fail);
     adc->spi = spi;
     adc->regs = (struct AdcRegs *)addr;
+    adc->regs->decimation_control = 0;
+    adc->encode_clock = NULL;
 
     /*
      * Reset the ADC using a software reset.
@@ -54,6 +59,975 @@ result_t init_adc(adc_driver_t *adc, spi_driver_t *spi, uint32_t addr, bool veri
     return success;
 }
 
+/**
+ * Replaces the samples of every channel with a fixed digital test pattern, or
+ * returns to the converted samples.
+ *
+ * @note Samples already in the stream keep their previous values.
+ *
+ * @param adc The ADC driver.
+ * @param enable Specified true to output the test pattern.
+ * @param pattern The 14-bit pattern.
+ *
+ * @return Success or fail.
+ */
+result_t set_adc_test_pattern(adc_driver_t *adc, const bool enable, const uint16_t pattern)
+{
+    AbortIfNot(adc, fail);
+    AbortIfNot(adc->spi, fail);
+    AbortIfNot(pattern <= ADC_SAMPLE_MASK, fail);
+
+    /*
+     * The upper six bits of the pattern share a register with the enable.
+     */
+    AbortIfNot(write_adc_register(adc, 4, pattern & 0xFF), fail);
+    AbortIfNot(write_adc_register(adc, 3, ((enable)? 0x80 : 0x00) | ((pattern >> 8) & 0x3F)), fail);
+
+    return success;
+}
+
+/**
+ * Sets the rate at which the FPGA decimates the ADC stream.
+ *
+ * @note Every sample in the stream, including the embedded timestamps, is at
+ *       the decimated rate. Samples already in the stream were taken at the
+ *       previous rate.
+ *
+ * @param adc The ADC driver.
+ * @param rate The decimation rate, which must be a power of two.
+ *
+ * @return Success or fail.
+ */
+result_t set_adc_decimation(adc_driver_t *adc, const uint32_t rate)
+{
+    AbortIfNot(adc, fail);
+    AbortIfNot(adc->regs, fail);
+    AbortIfNot(rate && (rate & (rate - 1)) == 0, fail);
+
+    uint32_t rate_log2 = 0;
+    while ((1u << rate_log2) < rate)
+    {
+        rate_log2++;
+    }
+    AbortIfNot(rate_log2 <= ADC_MAX_DECIMATION_RATE_LOG2, fail);
+
+    adc->regs->decimation_control =
+            (adc->regs->decimation_control & ~ADC_DECIMATION_RATE_LOG2_MASK) | rate_log2;
+
+    return success;
+}
+
+/**
+ * Enables or disables removal of the DC offset of each channel in the FPGA.
+ *
+ * @param adc The ADC driver.
+ * @param enable Specified true to remove the DC offset.
+ *
+ * @return Success or fail.
+ */
+result_t set_adc_dc_block(adc_driver_t *adc, const bool enable)
+{
+    AbortIfNot(adc, fail);
+    AbortIfNot(adc->regs, fail);
+
+    if (enable)
+    {
+        adc->regs->decimation_control |= ADC_DECIMATION_DC_BLOCK;
+    }
+    else
+    {
+        adc->regs->decimation_control &= ~ADC_DECIMATION_DC_BLOCK;
+    }
+
+    return success;
+}
+
+/**
+ * Enables or disables packing of the continuous stream to 12 bits per
+ * channel, which reduces the stream by a quarter at the cost of the two least
+ * significant bits of each sample.
+ *
+ * @note The FPGA only packs a 64-bit stream. Packets already in the stream
+ *       keep their previous format.
+ *
+ * @param adc The ADC driver.
+ * @param enable Specified true to pack the samples.
+ *
+ * @return Success or fail.
+ */
+result_t set_adc_packed_samples(adc_driver_t *adc, const bool enable)
+{
+    AbortIfNot(adc, fail);
+    AbortIfNot(adc->regs, fail);
+
+    if (enable)
+    {
+        AbortIfNot(adc->regs->samples_per_packet > ADC_HEADER_SAMPLES, fail);
+        AbortIfNot((adc->regs->samples_per_packet - ADC_HEADER_SAMPLES) %
+                   ADC_PACKED_GROUP_SAMPLES == 0, fail);
+        adc->regs->stream_control |= ADC_STREAM_PACKED;
+    }
+    else
+    {
+        adc->regs->stream_control &= ~ADC_STREAM_PACKED;
+    }
+
+    return success;
+}
+
+/**
+ * Counts the channels selected by a channel mask.
+ *
+ * @param mask The channel mask.
+ *
+ * @return The number of channels.
+ */
+static size_t count_adc_channels(const uint32_t mask)
+{
+    size_t channels = 0;
+    for (size_t k = 0; k < 4; ++k)
+    {
+        channels += (mask >> k) & 1;
+    }
+
+    return channels;
+}
+
+/**
+ * Limits the continuous stream to some of the channels, which reduces the
+ * stream by the share of the channels that are left out. The samples of the
+ * channels that are left out read as zero once they are expanded.
+ *
+ * @note The FPGA only masks a 64-bit stream, and only one or two channels.
+ *       Packets already in the stream keep their previous format.
+ *
+ * @param adc The ADC driver.
+ * @param mask The channels to send, or ADC_ALL_CHANNELS.
+ *
+ * @return Success or fail.
+ */
+result_t set_adc_channel_mask(adc_driver_t *adc, const uint32_t mask)
+{
+    AbortIfNot(adc, fail);
+    AbortIfNot(adc->regs, fail);
+    AbortIfNot(mask && !(mask & ~ADC_ALL_CHANNELS), fail);
+
+    uint32_t field = 0;
+    const size_t channels = count_adc_channels(mask);
+    if (mask != ADC_ALL_CHANNELS)
+    {
+        const size_t group = ADC_MASKED_BEAT_BYTES / (sizeof(analog_sample_t) * channels);
+        AbortIfNot(channels <= ADC_MAX_MASKED_CHANNELS, fail);
+        AbortIfNot(adc->regs->samples_per_packet > ADC_HEADER_SAMPLES, fail);
+        AbortIfNot((adc->regs->samples_per_packet - ADC_HEADER_SAMPLES) % group == 0, fail);
+        field = mask << ADC_STREAM_CHANNEL_SHIFT;
+    }
+
+    adc->regs->stream_control = (adc->regs->stream_control & ~ADC_STREAM_CHANNEL_MASK) | field;
+
+    return success;
+}
+
+/**
+ * Gets the channels carried by the samples after the header of each packet.
+ * Triggered windows always carry every channel.
+ *
+ * @param adc The ADC driver.
+ *
+ * @return The channel mask of the stream.
+ */
+uint32_t get_adc_channel_mask(const adc_driver_t *adc)
+{
+    const uint32_t mask = (adc->regs->stream_control & ADC_STREAM_CHANNEL_MASK) >> ADC_STREAM_CHANNEL_SHIFT;
+    const size_t channels = count_adc_channels(mask);
+    if (!channels || channels > ADC_MAX_MASKED_CHANNELS ||
+        (adc->regs->trigger_control & ADC_TRIGGER_ENABLE))
+    {
+        return ADC_ALL_CHANNELS;
+    }
+
+    return mask;
+}
+
+/**
+ * Checks if the packets of the stream carry packed samples. Triggered
+ * windows are never packed, and neither are masked packets.
+ *
+ * @param adc The ADC driver.
+ *
+ * @return True if the samples after the header of each packet are packed.
+ */
+bool adc_samples_packed(const adc_driver_t *adc)
+{
+    return ((adc->regs->stream_control & ADC_STREAM_PACKED) &&
+            !(adc->regs->trigger_control & ADC_TRIGGER_ENABLE) &&
+            get_adc_channel_mask(adc) == ADC_ALL_CHANNELS)? true : false;
+}
+
+/**
+ * Enables or disables planar packets, which the DMA engine writes to a
+ * separate buffer per channel, so that the channels of a capture need not be
+ * separated by the processor.
+ *
+ * @note The FPGA only sends planar packets on a 64-bit stream of whole
+ *       samples, and the bitstream must be built with the packet buffer.
+ *       Packets already in the stream keep their previous format.
+ *
+ * @param adc The ADC driver.
+ * @param enable Specified true to send planar packets.
+ *
+ * @return Success or fail.
+ */
+result_t set_adc_planar_packets(adc_driver_t *adc, const bool enable)
+{
+    AbortIfNot(adc, fail);
+    AbortIfNot(adc->regs, fail);
+
+    if (enable)
+    {
+        AbortIfNot(adc->regs->samples_per_packet % ADC_PLANAR_GROUP_SAMPLES == 0, fail);
+        AbortIfNot(adc->regs->samples_per_packet <= ADC_PLANAR_MAX_SAMPLES, fail);
+        AbortIf(adc->regs->stream_control & ADC_STREAM_PACKED, fail);
+        AbortIfNot(get_adc_channel_mask(adc) == ADC_ALL_CHANNELS, fail);
+        adc->regs->stream_control |= ADC_STREAM_PLANAR;
+    }
+    else
+    {
+        adc->regs->stream_control &= ~ADC_STREAM_PLANAR;
+    }
+
+    return success;
+}
+
+/**
+ * Checks if the packets of the stream carry planar channels. Triggered
+ * windows, packed and masked packets are never planar.
+ *
+ * @param adc The ADC driver.
+ *
+ * @return True if each packet carries its channels one after another.
+ */
+bool adc_packets_planar(const adc_driver_t *adc)
+{
+    return ((adc->regs->stream_control & ADC_STREAM_PLANAR) &&
+            !(adc->regs->stream_control & ADC_STREAM_PACKED) &&
+            !(adc->regs->trigger_control & ADC_TRIGGER_ENABLE) &&
+            get_adc_channel_mask(adc) == ADC_ALL_CHANNELS)? true : false;
+}
+
+/**
+ * Enables or disables the statistics trailer of each packet, which gives the
+ * sum, sum of squares, extremes and clipping of each channel so that they
+ * need not be measured by a pass over the samples.
+ *
+ * @note The FPGA sends the trailer in the cycles between samples, so the
+ *       sampling frequency is limited. Packets already in the stream keep
+ *       their previous format.
+ *
+ * @param adc The ADC driver.
+ * @param enable Specified true to append the trailer to each packet.
+ *
+ * @return Success or fail.
+ */
+result_t set_adc_packet_stats(adc_driver_t *adc, const bool enable)
+{
+    AbortIfNot(adc, fail);
+    AbortIfNot(adc->regs, fail);
+
+    if (enable)
+    {
+        AbortIfNot(adc->regs->samples_per_packet <= ADC_STATS_MAX_SAMPLES, fail);
+        AbortIfNot((uint64_t)get_adc_sampling_frequency(adc) * ADC_STATS_MIN_PERIOD_CYCLES <= FPGA_CLK, fail);
+        AbortIf(adc->regs->stream_control & (ADC_STREAM_PACKED | ADC_STREAM_PLANAR), fail);
+        AbortIfNot(get_adc_channel_mask(adc) == ADC_ALL_CHANNELS, fail);
+        adc->regs->stream_control |= ADC_STREAM_STATS;
+    }
+    else
+    {
+        adc->regs->stream_control &= ~ADC_STREAM_STATS;
+    }
+
+    return success;
+}
+
+/**
+ * Checks if each packet of the stream is followed by a statistics trailer.
+ * Triggered windows, packed, masked and planar packets never are.
+ *
+ * @param adc The ADC driver.
+ *
+ * @return True if each packet carries a trailer.
+ */
+bool adc_packets_have_stats(const adc_driver_t *adc)
+{
+    return ((adc->regs->stream_control & ADC_STREAM_STATS) &&
+            !(adc->regs->stream_control & (ADC_STREAM_PACKED | ADC_STREAM_PLANAR)) &&
+            !(adc->regs->trigger_control & ADC_TRIGGER_ENABLE) &&
+            get_adc_channel_mask(adc) == ADC_ALL_CHANNELS)? true : false;
+}
+
+/**
+ * Decodes the statistics trailer of a packet.
+ *
+ * @param trailer The trailer as received.
+ * @param[out] stats The statistics of each channel of the packet.
+ *
+ * @return None.
+ */
+void decode_adc_packet_trailer(const adc_packet_trailer_t *trailer, adc_packet_stats_t *stats)
+{
+    for (size_t k = 0; k < 4; ++k)
+    {
+        const uint64_t squares = trailer->word[2 * k];
+        const uint64_t sums = trailer->word[2 * k + 1];
+        stats->squares[k] = squares & ADC_STATS_SQUARES_MASK;
+        stats->clipped[k] = squares >> ADC_STATS_CLIPPED_SHIFT;
+        stats->sum[k] = sums & ADC_STATS_SUM_MASK;
+        stats->min[k] = (sums >> ADC_STATS_MIN_SHIFT) & ADC_SAMPLE_MASK;
+        stats->max[k] = (sums >> ADC_STATS_MAX_SHIFT) & ADC_SAMPLE_MASK;
+    }
+}
+
+/**
+ * Totals the statistics trailers of consecutive packets into the statistics
+ * that normalize_channels() measures over the same samples.
+ *
+ * @param trailers The trailers of the packets.
+ * @param packets The number of packets.
+ * @param samples_per_packet The number of samples in each packet.
+ * @param[out] stats The offset, RMS about the offset, and clipping of each
+ *             channel.
+ *
+ * @return Success or fail.
+ */
+result_t sum_adc_packet_stats(const adc_packet_trailer_t *trailers,
+                              const size_t packets,
+                              const size_t samples_per_packet,
+                              channel_stats_t *stats)
+{
+    AbortIfNot(trailers, fail);
+    AbortIfNot(stats, fail);
+    AbortIfNot(packets, fail);
+    AbortIfNot(samples_per_packet <= ADC_STATS_MAX_SAMPLES, fail);
+
+    int64_t sums[4] = {0, 0, 0, 0};
+    uint64_t squares[4] = {0, 0, 0, 0};
+    uint32_t clipped[4] = {0, 0, 0, 0};
+    for (size_t p = 0; p < packets; ++p)
+    {
+        adc_packet_stats_t packet;
+        decode_adc_packet_trailer(&trailers[p], &packet);
+        for (size_t k = 0; k < 4; ++k)
+        {
+            sums[k] += packet.sum[k];
+            squares[k] += packet.squares[k];
+            clipped[k] += packet.clipped[k];
+        }
+    }
+
+    const size_t len = packets * samples_per_packet;
+    stats->count = len;
+    for (size_t k = 0; k < 4; ++k)
+    {
+        const double mean = (double)sums[k] / len;
+        const double variance = (double)squares[k] / len - mean * mean;
+        stats->offset[k] = sums[k] / (int64_t)len;
+        stats->rms[k] = (variance > 0)? sqrt(variance) : 0;
+        stats->clipped_samples[k] = clipped[k];
+    }
+
+    return success;
+}
+
+/**
+ * Gets the number of bytes that a packet of the stream occupies as it is
+ * received.
+ *
+ * @param adc The ADC driver.
+ * @param samples_per_packet The number of samples in each packet.
+ *
+ * @return The length of a packet in bytes.
+ */
+uint32_t get_adc_packet_bytes(const adc_driver_t *adc, const size_t samples_per_packet)
+{
+    const uint32_t mask = get_adc_channel_mask(adc);
+    if (mask != ADC_ALL_CHANNELS)
+    {
+        return sizeof(sample_t) * ADC_HEADER_SAMPLES +
+               sizeof(analog_sample_t) * count_adc_channels(mask) * (samples_per_packet - ADC_HEADER_SAMPLES);
+    }
+
+    if (adc_packets_have_stats(adc))
+    {
+        return sizeof(sample_t) * samples_per_packet + sizeof(adc_packet_trailer_t);
+    }
+
+    if (!adc_samples_packed(adc))
+    {
+        return sizeof(sample_t) * samples_per_packet;
+    }
+
+    return sizeof(sample_t) * ADC_HEADER_SAMPLES +
+           ADC_PACKED_SAMPLE_BYTES * (samples_per_packet - ADC_HEADER_SAMPLES);
+}
+
+/**
+ * Gets the rate at which the FPGA decimates the ADC stream.
+ *
+ * @param adc The ADC driver.
+ *
+ * @return The decimation rate.
+ */
+uint32_t get_adc_decimation(const adc_driver_t *adc)
+{
+    return 1u << (adc->regs->decimation_control & ADC_DECIMATION_RATE_LOG2_MASK);
+}
+
+/**
+ * Gets the rate of samples in the ADC stream.
+ *
+ * @param adc The ADC driver.
+ *
+ * @return The sampling frequency after decimation in Hz.
+ */
+uint32_t get_adc_sampling_frequency(const adc_driver_t *adc)
+{
+    const uint32_t reference = (adc->encode_clock)? adc->encode_clock->frequency : FPGA_CLK;
+    return reference / (adc->regs->clk_div * 2) / get_adc_decimation(adc);
+}
+
+/**
+ * Sets the rate at which the ADC samples before decimation. The encode clock
+ * reference is retuned so the rate is reached with the smallest divider that
+ * keeps the reference above ADC_MIN_ENCODE_REFERENCE_HZ.
+ *
+ * @note The encode clock stops while the reference is retuned, so the stream
+ *       should be stopped first. The rate that was reached is returned by
+ *       get_adc_sampling_frequency().
+ *
+ * @param adc The ADC driver.
+ * @param frequency The requested sampling frequency in Hz.
+ *
+ * @return Success or fail.
+ */
+result_t set_adc_sampling_frequency(adc_driver_t *adc, const uint32_t frequency)
+{
+    AbortIfNot(adc, fail);
+    AbortIfNot(adc->regs, fail);
+    AbortIfNot(adc->encode_clock, fail);
+    AbortIfNot(frequency >= ADC_MIN_SAMPLING_FREQUENCY && frequency <= ADC_MAX_SAMPLING_FREQUENCY, fail);
+
+    const uint32_t clk_div = (ADC_MIN_ENCODE_REFERENCE_HZ + 2 * frequency - 1) / (2 * frequency);
+    AbortIfNot(set_encode_clock_frequency(adc->encode_clock, 2 * clk_div * frequency), fail);
+    adc->regs->clk_div = clk_div;
+
+    return success;
+}
+
+/**
+ * Arms the FPGA correlator for the next triggered window.
+ *
+ * @note The correlator is one-shot. Arming it discards the results of any
+ *       previous window.
+ *
+ * @param adc The ADC driver.
+ * @param max_shift The largest shift to correlate, in samples.
+ * @param offset The offset to remove from every sample before correlating.
+ *
+ * @return Success or fail.
+ */
+result_t arm_adc_correlator(const adc_driver_t *adc, const int32_t max_shift, const uint32_t offset)
+{
+    AbortIfNot(adc, fail);
+    AbortIfNot(adc->regs, fail);
+    AbortIfNot(max_shift > 0 && max_shift <= ADC_CORRELATOR_MAX_SHIFT, fail);
+
+    adc->regs->correlator_control = 0;
+    adc->regs->correlator_control = ADC_CORRELATOR_ENABLE |
+            ((offset << ADC_CORRELATOR_OFFSET_SHIFT) & ADC_CORRELATOR_OFFSET_MASK) |
+            (max_shift & ADC_CORRELATOR_SHIFT_MASK);
+
+    return success;
+}
+
+/**
+ * Checks if the FPGA correlator has finished the armed window.
+ *
+ * @param adc The ADC driver.
+ *
+ * @return True if the results are ready to be read.
+ */
+bool adc_correlator_done(const adc_driver_t *adc)
+{
+    return (adc->regs->correlator_control & ADC_CORRELATOR_DONE)? true : false;
+}
+
+/**
+ * Reads the correlations of the triggered window from the FPGA.
+ *
+ * @note The results are ordered by decreasing shift, as they are by
+ *       cross_correlate(). Windows longer than ADC_CORRELATOR_MAX_WINDOW are
+ *       correlated over their first ADC_CORRELATOR_MAX_WINDOW samples.
+ *
+ * @param adc The ADC driver.
+ * @param window_len The number of samples in the triggered window.
+ * @param[out] correlations The correlation for each shift.
+ * @param correlation_len The number of correlations that can be stored.
+ * @param[out] num_correlations The number of correlations read.
+ *
+ * @return Success or fail.
+ */
+result_t read_adc_correlations(const adc_driver_t *adc,
+                               const size_t window_len,
+                               correlation_t *correlations,
+                               const size_t correlation_len,
+                               size_t *num_correlations)
+{
+    AbortIfNot(adc, fail);
+    AbortIfNot(adc->regs, fail);
+    AbortIfNot(correlations, fail);
+    AbortIfNot(num_correlations, fail);
+    AbortIfNot(window_len, fail);
+    AbortIfNot(adc_correlator_done(adc), fail);
+
+    /*
+     * The FPGA limits the shift to the correlated length in the same way as
+     * the software correlation.
+     */
+    const size_t len = (window_len > ADC_CORRELATOR_MAX_WINDOW)?
+            ADC_CORRELATOR_MAX_WINDOW : window_len;
+    int32_t max_shift = adc->regs->correlator_control & ADC_CORRELATOR_SHIFT_MASK;
+    if (max_shift > ADC_CORRELATOR_MAX_SHIFT)
+    {
+        max_shift = ADC_CORRELATOR_MAX_SHIFT;
+    }
+    if (max_shift > len - 1)
+    {
+        max_shift = len - 1;
+    }
+
+    const size_t lags = 2 * max_shift;
+    AbortIfNot(lags <= correlation_len, fail);
+
+    /*
+     * Each result is selected by writing its index. The write must complete
+     * before the read is issued, since AXI does not order them.
+     */
+    for (size_t j = 0; j < lags; ++j)
+    {
+        correlations[j].left_shift = max_shift - j;
+        for (size_t k = 0; k < 3; ++k)
+        {
+            adc->regs->correlator_data = j * 4 + k;
+            data_sync_barrier();
+            correlations[j].result[k] = (int32_t)adc->regs->correlator_data;
+        }
+    }
+
+    *num_correlations = lags;
+
+    return success;
+}
+
+/**
+ * Reads a snapshot of the sample stream counters from the FPGA.
+ *
+ * @note The snapshot crosses from the ADC clock domain in a few cycles of
+ *       each clock, so it is waited for by polling.
+ *
+ * @param adc The ADC driver.
+ * @param[out] counters The stream counters.
+ *
+ * @return Success or fail.
+ */
+result_t read_adc_stream_counters(const adc_driver_t *adc, adc_stream_counters_t *counters)
+{
+    AbortIfNot(adc, fail);
+    AbortIfNot(adc->regs, fail);
+    AbortIfNot(counters, fail);
+
+    adc->regs->stream_status = ADC_STREAM_SNAPSHOT;
+    data_sync_barrier();
+
+    uint32_t status = adc->regs->stream_status;
+    for (size_t i = 0; (status & ADC_STREAM_SNAPSHOT) && i < ADC_STREAM_SNAPSHOT_POLLS; ++i)
+    {
+        status = adc->regs->stream_status;
+    }
+    AbortIf(status & ADC_STREAM_SNAPSHOT, fail);
+
+    counters->total_samples = ((uint64_t)adc->regs->total_samples_high << 32) |
+            adc->regs->total_samples_low;
+    counters->dropped_samples = adc->regs->dropped_samples;
+    counters->overrun = (status & ADC_STREAM_OVERRUN)? true : false;
+
+    return success;
+}
+
+/**
+ * Clears the overrun flag and dropped sample count of the FPGA stream.
+ *
+ * @param adc The ADC driver.
+ *
+ * @return Success or fail.
+ */
+result_t clear_adc_stream_counters(const adc_driver_t *adc)
+{
+    AbortIfNot(adc, fail);
+    AbortIfNot(adc->regs, fail);
+
+    adc->regs->stream_status = ADC_STREAM_CLEAR;
+    data_sync_barrier();
+
+    return success;
+}
+
+/**
+ * Sets whether the board drives the sync line shared by the boards of an
+ * array. Only one board may drive it.
+ *
+ * @param adc The ADC driver.
+ * @param enable True to drive the sync line.
+ *
+ * @return Success or fail.
+ */
+result_t set_adc_sync_output(const adc_driver_t *adc, const bool enable)
+{
+    AbortIfNot(adc, fail);
+    AbortIfNot(adc->regs, fail);
+
+    adc->regs->sync_control = (enable)? ADC_SYNC_OUTPUT_ENABLE : 0;
+    data_sync_barrier();
+
+    return success;
+}
+
+/**
+ * Sends a pulse on the sync line, which every board on the line latches the
+ * timestamp of its current sample on.
+ *
+ * @param adc The ADC driver.
+ *
+ * @return Success or fail if the board does not drive the sync line.
+ */
+result_t fire_adc_sync(const adc_driver_t *adc)
+{
+    AbortIfNot(adc, fail);
+    AbortIfNot(adc->regs, fail);
+    AbortIfNot(adc->regs->sync_control & ADC_SYNC_OUTPUT_ENABLE, fail);
+
+    adc->regs->sync_control = ADC_SYNC_OUTPUT_ENABLE | ADC_SYNC_FIRE;
+    data_sync_barrier();
+
+    return success;
+}
+
+/**
+ * Reads a latch of the stream timestamp and the count of edges it was taken
+ * at.
+ *
+ * @note The count and the latched sample are separate registers, so they are
+ *       read again if an edge arrives between them.
+ *
+ * @param count The register of the count of edges.
+ * @param low The register of the low word of the latched sample.
+ * @param high The register of the high word of the latched sample.
+ * @param[out] latch The count of edges and the sample latched at the latest.
+ *
+ * @return Success or fail.
+ */
+static result_t read_adc_latch(volatile uint32_t *count,
+                               volatile uint32_t *low,
+                               volatile uint32_t *high,
+                               adc_sync_latch_t *latch)
+{
+    for (size_t i = 0; i < ADC_STREAM_SNAPSHOT_POLLS; ++i)
+    {
+        const uint32_t first_count = *count;
+        const uint32_t sample_low = *low;
+        const uint32_t sample_high = *high;
+        if (*count == first_count)
+        {
+            latch->count = first_count;
+            latch->sample = ((uint64_t)sample_high << 32) | sample_low;
+            return success;
+        }
+    }
+
+    return fail;
+}
+
+/**
+ * Reads the latest edge of the sync line.
+ *
+ * @param adc The ADC driver.
+ * @param[out] latch The count of edges and the sample latched at the latest.
+ *
+ * @return Success or fail.
+ */
+result_t read_adc_sync(const adc_driver_t *adc, adc_sync_latch_t *latch)
+{
+    AbortIfNot(adc, fail);
+    AbortIfNot(adc->regs, fail);
+    AbortIfNot(latch, fail);
+
+    return read_adc_latch(&adc->regs->sync_count,
+                          &adc->regs->sync_sample_low,
+                          &adc->regs->sync_sample_high,
+                          latch);
+}
+
+/**
+ * Reads the latest edge of the external trigger input.
+ *
+ * @param adc The ADC driver.
+ * @param[out] latch The count of edges and the sample latched at the latest.
+ *
+ * @return Success or fail.
+ */
+result_t read_adc_ext_trigger(const adc_driver_t *adc, adc_sync_latch_t *latch)
+{
+    AbortIfNot(adc, fail);
+    AbortIfNot(adc->regs, fail);
+    AbortIfNot(latch, fail);
+
+    return read_adc_latch(&adc->regs->ext_trigger_count,
+                          &adc->regs->ext_trigger_sample_low,
+                          &adc->regs->ext_trigger_sample_high,
+                          latch);
+}
+
+/**
+ * Sets whether the external trigger input is latched on its falling edges
+ * rather than its rising edges.
+ *
+ * @param adc The ADC driver.
+ * @param invert True to latch falling edges.
+ *
+ * @return Success or fail.
+ */
+result_t set_adc_ext_trigger_inverted(const adc_driver_t *adc, const bool invert)
+{
+    AbortIfNot(adc, fail);
+    AbortIfNot(adc->regs, fail);
+
+    const uint32_t control = adc->regs->ext_trigger_control & ~ADC_EXT_TRIGGER_INVERT;
+    adc->regs->ext_trigger_control = control | ((invert)? ADC_EXT_TRIGGER_INVERT : 0);
+    data_sync_barrier();
+
+    return success;
+}
+
+/**
+ * Sets whether the trigger output is held high outside of its window.
+ *
+ * @param adc The ADC driver.
+ * @param force True to hold the output high.
+ *
+ * @return Success or fail.
+ */
+result_t set_adc_ext_output_forced(const adc_driver_t *adc, const bool force)
+{
+    AbortIfNot(adc, fail);
+    AbortIfNot(adc->regs, fail);
+
+    const uint32_t control = adc->regs->ext_trigger_control & ~ADC_EXT_OUTPUT_FORCE;
+    adc->regs->ext_trigger_control = control | ((force)? ADC_EXT_OUTPUT_FORCE : 0);
+    data_sync_barrier();
+
+    return success;
+}
+
+/**
+ * Raises the trigger output over a window of the stream. The window replaces
+ * any earlier one, and a window that has passed leaves the output low.
+ *
+ * @param adc The ADC driver.
+ * @param start The timestamp of the first sample of the window.
+ * @param end The timestamp of the sample after the window.
+ *
+ * @return Success or fail.
+ */
+result_t set_adc_ext_output_window(const adc_driver_t *adc, const uint64_t start, const uint64_t end)
+{
+    AbortIfNot(adc, fail);
+    AbortIfNot(adc->regs, fail);
+    AbortIfNot(end >= start, fail);
+
+    adc->regs->ext_output_start_low = (uint32_t)start;
+    adc->regs->ext_output_start_high = (uint32_t)(start >> 32);
+    adc->regs->ext_output_end_low = (uint32_t)end;
+    adc->regs->ext_output_end_high = (uint32_t)(end >> 32);
+    data_sync_barrier();
+    adc->regs->ext_trigger_control = adc->regs->ext_trigger_control | ADC_EXT_OUTPUT_LOAD;
+    data_sync_barrier();
+
+    return success;
+}
+
+/**
+ * Reads the timestamp of the sample the stream is taking now.
+ *
+ * @param adc The ADC driver.
+ * @param[out] sample The timestamp of the next sample.
+ * @param[out] tick The system time of the timestamp.
+ *
+ * @return Success or fail.
+ */
+result_t read_adc_stream_time(const adc_driver_t *adc, uint64_t *sample, tick_t *tick)
+{
+    AbortIfNot(sample, fail);
+    AbortIfNot(tick, fail);
+
+    adc_stream_counters_t counters;
+    AbortIfNot(read_adc_stream_counters(adc, &counters), fail);
+    *tick = get_system_time();
+    *sample = counters.total_samples;
+
+    return success;
+}
+
+/**
+ * Starts streaming the envelope of every channel from the FPGA. Any earlier
+ * envelope is discarded.
+ *
+ * @param adc The ADC driver.
+ * @param decimation The number of samples per envelope sample.
+ * @param smoothing_log2 The base two logarithm of the time constant, in
+ *        samples, that the power of each channel is smoothed over.
+ * @param output_shift The right shift of the smoothed power to 16 bits.
+ * @param offset The DC offset of the channels, which is removed before the
+ *        samples are squared.
+ *
+ * @return Success or fail.
+ */
+result_t arm_adc_envelope(const adc_driver_t *adc,
+                          const uint32_t decimation,
+                          const uint32_t smoothing_log2,
+                          const uint32_t output_shift,
+                          const uint32_t offset)
+{
+    AbortIfNot(adc, fail);
+    AbortIfNot(adc->regs, fail);
+    AbortIfNot(decimation && decimation <= ADC_ENVELOPE_MAX_DECIMATION, fail);
+    AbortIfNot(smoothing_log2 <= (ADC_ENVELOPE_SMOOTHING_MASK >> ADC_ENVELOPE_SMOOTHING_SHIFT), fail);
+    AbortIfNot(output_shift <= (ADC_ENVELOPE_OUTPUT_MASK >> ADC_ENVELOPE_OUTPUT_SHIFT), fail);
+
+    /*
+     * The FIFO is emptied in the ADC clock domain, which lags the write, so
+     * the envelope is only enabled again once it reports idle.
+     */
+    AbortIfNot(disarm_adc_envelope(adc), fail);
+
+    adc->regs->envelope_decimation = decimation;
+    adc->regs->envelope_control = (offset & ADC_ENVELOPE_OFFSET_MASK) |
+            (smoothing_log2 << ADC_ENVELOPE_SMOOTHING_SHIFT) |
+            (output_shift << ADC_ENVELOPE_OUTPUT_SHIFT);
+    data_sync_barrier();
+    adc->regs->envelope_control = adc->regs->envelope_control | ADC_ENVELOPE_ENABLE;
+    data_sync_barrier();
+
+    return success;
+}
+
+/**
+ * Stops streaming the envelope and empties the FIFO.
+ *
+ * @param adc The ADC driver.
+ *
+ * @return Success or fail if the FIFO did not empty.
+ */
+result_t disarm_adc_envelope(const adc_driver_t *adc)
+{
+    AbortIfNot(adc, fail);
+    AbortIfNot(adc->regs, fail);
+
+    adc->regs->envelope_control = adc->regs->envelope_control & ~ADC_ENVELOPE_ENABLE;
+    data_sync_barrier();
+
+    uint32_t status = adc->regs->envelope_status;
+    for (size_t i = 0; !(status & ADC_ENVELOPE_IDLE) && i < ADC_STREAM_SNAPSHOT_POLLS; ++i)
+    {
+        status = adc->regs->envelope_status;
+    }
+    AbortIfNot(status & ADC_ENVELOPE_IDLE, fail);
+
+    return success;
+}
+
+/**
+ * Reads the envelope samples waiting in the FIFO, oldest first.
+ *
+ * @param adc The ADC driver.
+ * @param[out] envelope The envelope samples.
+ * @param capacity The number of envelope samples that can be stored.
+ * @param[out] count The number of envelope samples read.
+ * @param[out] overflow True if envelope samples were lost to a full FIFO
+ *             since the envelope was armed.
+ *
+ * @return Success or fail.
+ */
+result_t read_adc_envelope(const adc_driver_t *adc,
+                           adc_envelope_t *envelope,
+                           const size_t capacity,
+                           size_t *count,
+                           bool *overflow)
+{
+    AbortIfNot(adc, fail);
+    AbortIfNot(adc->regs, fail);
+    AbortIfNot(envelope, fail);
+    AbortIfNot(count, fail);
+    AbortIfNot(overflow, fail);
+
+    const uint32_t status = adc->regs->envelope_status;
+    size_t level = status & ADC_ENVELOPE_LEVEL_MASK;
+    if (level > capacity)
+    {
+        level = capacity;
+    }
+
+    /*
+     * Reading the high word discards the sample, so the low word is read
+     * first.
+     */
+    for (size_t i = 0; i < level; ++i)
+    {
+        const uint32_t low = adc->regs->envelope_data_low;
+        const uint32_t high = adc->regs->envelope_data_high;
+        envelope[i].power[0] = low & 0xFFFF;
+        envelope[i].power[1] = low >> 16;
+        envelope[i].power[2] = high & 0xFFFF;
+        envelope[i].power[3] = high >> 16;
+    }
+
+    *count = level;
+    *overflow = (status & ADC_ENVELOPE_OVERFLOW)? true : false;
+
+    return success;
+}
+
+/**
+ * Reads the stream timestamp of the first envelope sample since the envelope
+ * was armed. Later envelope samples follow every decimation samples.
+ *
+ * @note The timestamp is only valid once an envelope sample has been read.
+ *
+ * @param adc The ADC driver.
+ * @param[out] start The timestamp of the first envelope sample.
+ *
+ * @return Success or fail.
+ */
+result_t read_adc_envelope_start(const adc_driver_t *adc, uint64_t *start)
+{
+    AbortIfNot(adc, fail);
+    AbortIfNot(adc->regs, fail);
+    AbortIfNot(start, fail);
+
+    *start = ((uint64_t)adc->regs->envelope_start_high << 32) | adc->regs->envelope_start_low;
+
+    return success;
+}
+
 result_t write_verify_adc_register(adc_driver_t *adc,
                                    const uint8_t reg,
                                    uint8_t data,
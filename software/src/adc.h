@@ -1,18 +1,204 @@
 #ifndef ADC_H
 #define ADC_H
 
+#include "encode_clock.h"
 #include "spi.h"
 #include "types.h"
 #include "regs/AdcRegs.h"
 
+/**
+ * The number of times the stream status is polled for a snapshot of the
+ * stream counters before giving up.
+ */
+#define ADC_STREAM_SNAPSHOT_POLLS 1000
+
+/**
+ * The range of sampling frequencies that the ADC may be run at before
+ * decimation.
+ */
+#define ADC_MIN_SAMPLING_FREQUENCY 1000000
+#define ADC_MAX_SAMPLING_FREQUENCY 25000000
+
+/**
+ * The lowest encode clock reference that a sampling frequency is divided
+ * from. Dividing a faster reference keeps the fractional error of the MMCM
+ * small compared to the encode period.
+ */
+#define ADC_MIN_ENCODE_REFERENCE_HZ 50000000
+
+/**
+ * The samples held by the trigger history buffer of the quad ADC core, which
+ * must match its HISTORY_ADDR_BITS, and the most of them that may precede a
+ * trigger. The core clamps a longer pre-trigger window to the limit, which
+ * keeps its writer from lapping the start of the window.
+ */
+#define ADC_TRIGGER_HISTORY_DEPTH 4096
+#define ADC_TRIGGER_MAX_PRE_SAMPLES (ADC_TRIGGER_HISTORY_DEPTH - 16)
+
 typedef struct adc_driver_t
 {
     spi_driver_t *spi;
     struct AdcRegs *regs;
+
+    /*
+     * The generator of the reference that the encode clock is divided from,
+     * or NULL if the reference is the fabric clock.
+     */
+    encode_clock_t *encode_clock;
 } adc_driver_t;
 
+/**
+ * Defines a snapshot of the sample stream counters of the FPGA.
+ */
+typedef struct adc_stream_counters_t
+{
+    /*
+     * Every sample produced since reset, which is also the timestamp of the
+     * next sample.
+     */
+    uint64_t total_samples;
+
+    /*
+     * The samples lost because the FIFO was full, which wraps, and whether
+     * any was lost since the counters were last cleared.
+     */
+    uint32_t dropped_samples;
+    bool overrun;
+} adc_stream_counters_t;
+
+/**
+ * Defines the latest edge of the sync line shared by the boards of an array,
+ * or of the external trigger input.
+ */
+typedef struct adc_sync_latch_t
+{
+    /*
+     * The number of edges since reset, which wraps.
+     */
+    uint32_t count;
+
+    /*
+     * The timestamp of the sample being taken as the latest edge arrived.
+     */
+    uint64_t sample;
+} adc_sync_latch_t;
+
+/**
+ * Defines one sample of the envelope streamed by the FPGA, which is the
+ * smoothed power of each channel.
+ */
+typedef struct adc_envelope_t
+{
+    uint16_t power[4];
+} adc_envelope_t;
+
+/**
+ * Defines the statistics trailer that follows each packet while packet
+ * statistics are enabled, as it lands in memory.
+ */
+typedef struct adc_packet_trailer_t
+{
+    uint64_t word[ADC_STATS_TRAILER_WORDS];
+} adc_packet_trailer_t;
+
+/**
+ * Defines the statistics of the 14-bit samples of each channel of a packet,
+ * as measured by the FPGA.
+ */
+typedef struct adc_packet_stats_t
+{
+    uint32_t sum[4];
+    uint64_t squares[4];
+    uint16_t min[4];
+    uint16_t max[4];
+    uint16_t clipped[4];
+} adc_packet_stats_t;
+
 result_t init_adc(adc_driver_t *adc, spi_driver_t *spi, uint32_t addr, bool verify, bool test_pattern);
 
+result_t set_adc_test_pattern(adc_driver_t *adc, const bool enable, const uint16_t pattern);
+
+result_t set_adc_decimation(adc_driver_t *adc, const uint32_t rate);
+
+result_t set_adc_dc_block(adc_driver_t *adc, const bool enable);
+
+result_t set_adc_packed_samples(adc_driver_t *adc, const bool enable);
+
+result_t set_adc_channel_mask(adc_driver_t *adc, const uint32_t mask);
+
+uint32_t get_adc_channel_mask(const adc_driver_t *adc);
+
+bool adc_samples_packed(const adc_driver_t *adc);
+
+result_t set_adc_planar_packets(adc_driver_t *adc, const bool enable);
+
+bool adc_packets_planar(const adc_driver_t *adc);
+
+result_t set_adc_packet_stats(adc_driver_t *adc, const bool enable);
+
+bool adc_packets_have_stats(const adc_driver_t *adc);
+
+void decode_adc_packet_trailer(const adc_packet_trailer_t *trailer, adc_packet_stats_t *stats);
+
+result_t sum_adc_packet_stats(const adc_packet_trailer_t *trailers,
+                              const size_t packets,
+                              const size_t samples_per_packet,
+                              channel_stats_t *stats);
+
+uint32_t get_adc_packet_bytes(const adc_driver_t *adc, const size_t samples_per_packet);
+
+uint32_t get_adc_decimation(const adc_driver_t *adc);
+
+uint32_t get_adc_sampling_frequency(const adc_driver_t *adc);
+
+result_t set_adc_sampling_frequency(adc_driver_t *adc, const uint32_t frequency);
+
+result_t arm_adc_correlator(const adc_driver_t *adc, const int32_t max_shift, const uint32_t offset);
+
+bool adc_correlator_done(const adc_driver_t *adc);
+
+result_t read_adc_correlations(const adc_driver_t *adc,
+                               const size_t window_len,
+                               correlation_t *correlations,
+                               const size_t correlation_len,
+                               size_t *num_correlations);
+
+result_t read_adc_stream_counters(const adc_driver_t *adc, adc_stream_counters_t *counters);
+
+result_t clear_adc_stream_counters(const adc_driver_t *adc);
+
+result_t set_adc_sync_output(const adc_driver_t *adc, const bool enable);
+
+result_t fire_adc_sync(const adc_driver_t *adc);
+
+result_t read_adc_sync(const adc_driver_t *adc, adc_sync_latch_t *latch);
+
+result_t read_adc_ext_trigger(const adc_driver_t *adc, adc_sync_latch_t *latch);
+
+result_t set_adc_ext_trigger_inverted(const adc_driver_t *adc, const bool invert);
+
+result_t set_adc_ext_output_forced(const adc_driver_t *adc, const bool force);
+
+result_t set_adc_ext_output_window(const adc_driver_t *adc, const uint64_t start, const uint64_t end);
+
+result_t read_adc_stream_time(const adc_driver_t *adc, uint64_t *sample, tick_t *tick);
+
+result_t arm_adc_envelope(const adc_driver_t *adc,
+                          const uint32_t decimation,
+                          const uint32_t smoothing_log2,
+                          const uint32_t output_shift,
+                          const uint32_t offset);
+
+result_t disarm_adc_envelope(const adc_driver_t *adc);
+
+result_t read_adc_envelope(const adc_driver_t *adc,
+                           adc_envelope_t *envelope,
+                           const size_t capacity,
+                           size_t *count,
+                           bool *overflow);
+
+result_t read_adc_envelope_start(const adc_driver_t *adc, uint64_t *start);
+
 result_t write_adc_register(adc_driver_t *adc, const uint8_t reg, uint8_t data);
 
 result_t read_adc_register(adc_driver_t *adc, const uint8_t reg, uint8_t *data);
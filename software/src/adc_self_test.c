@@ -0,0 +1,189 @@
+#include "adc_self_test.h"
+
+#include "abort.h"
+#include "adc.h"
+#include "db.h"
+#include "dma.h"
+#include "sample_util.h"
+#include "system.h"
+#include "system_params.h"
+#include "types.h"
+
+#include <string.h>
+
+/**
+ * The test patterns, whose alternating bits catch a data line stuck at
+ * either level or shorted to its neighbour.
+ */
+static const uint16_t adc_test_patterns[2] = {0x2AAA, 0x1555};
+
+/**
+ * Captures one test pattern and checks it.
+ *
+ * @param dma The DMA engine of the stream.
+ * @param adc The ADC driver, which streams unpacked and undecimated samples.
+ * @param data Storage for the capture.
+ * @param len The number of samples to capture, which is whole packets.
+ * @param timing Storage for the timestamps of the capture.
+ * @param pattern The pattern.
+ * @param result The result to add the capture to.
+ *
+ * @return Success or fail.
+ */
+static result_t test_adc_pattern(dma_engine_t *dma,
+                                 adc_driver_t *adc,
+                                 sample_t *data,
+                                 const size_t len,
+                                 sample_timing_t *timing,
+                                 const uint16_t pattern,
+                                 adc_self_test_t *result)
+{
+    const size_t samples_per_packet = adc->regs->samples_per_packet;
+    AbortIfNot(set_adc_test_pattern(adc, true, pattern), fail);
+    AbortIfNot(record(dma, data, samples_per_packet * ADC_SELF_TEST_SETTLE_PACKETS, *adc), fail);
+
+    adc_stream_counters_t start;
+    AbortIfNot(read_adc_stream_counters(adc, &start), fail);
+    const tick_t start_tick = get_system_time();
+
+    AbortIfNot(record(dma, data, len, *adc), fail);
+
+    const tick_t end_tick = get_system_time();
+    adc_stream_counters_t end;
+    AbortIfNot(read_adc_stream_counters(adc, &end), fail);
+
+    AbortIfNot(extract_timestamps(timing, data, len, samples_per_packet, end_tick), fail);
+    result->discontinuities += timing->discontinuities + timing->lost_packets;
+    result->dropped_samples += end.dropped_samples - start.dropped_samples;
+    if (timing->overrun_packets)
+    {
+        result->flags |= ADC_SELF_TEST_OVERRUN_FAULT;
+    }
+
+    for (size_t i = 0; i < len; ++i)
+    {
+        for (size_t k = 0; k < 4; ++k)
+        {
+            if ((data[i].sample[k] & ADC_SAMPLE_MASK) != pattern)
+            {
+                result->pattern_errors++;
+                break;
+            }
+        }
+    }
+    result->samples += len;
+
+    /*
+     * The stream counters measure the rate the FPGA produced samples at over
+     * the capture, and the capture itself the rate the datapath kept up with.
+     * The slower pattern is kept.
+     */
+    const tick_t ticks = end_tick - start_tick;
+    AbortIfNot(ticks, fail);
+    const uint32_t measured_hz = (end.total_samples - start.total_samples) * CPU_CLOCK_HZ / ticks;
+    const uint32_t capture_hz = (uint64_t)len * CPU_CLOCK_HZ / ticks;
+    if (!result->measured_hz || measured_hz < result->measured_hz)
+    {
+        result->measured_hz = measured_hz;
+    }
+    if (!result->capture_hz || capture_hz < result->capture_hz)
+    {
+        result->capture_hz = capture_hz;
+    }
+
+    return success;
+}
+
+/**
+ * Captures each ADC test pattern through the real FPGA and DMA datapath, and
+ * checks that every sample holds the pattern, that the timestamps and packet
+ * sequence are unbroken, that no sample was lost to a full FIFO, and that the
+ * stream runs at the rate set by the clock divider.
+ *
+ * @note The stream is tested unpacked, unmasked and undecimated, and the
+ *       decimation, DC block, packing and channel mask are restored
+ *       afterwards. Embedded timestamps must be enabled.
+ *
+ * @param dma The DMA engine of the stream.
+ * @param adc The ADC driver.
+ * @param data Storage for the capture.
+ * @param len The number of samples to capture of each pattern, which is
+ *        whole packets.
+ * @param timing Storage for the timestamps of the capture.
+ * @param[out] result The result of the test.
+ *
+ * @return Success, or fail if the test could not be run. A datapath fault is
+ *         reported in the flags of the result rather than by failing.
+ */
+result_t run_adc_self_test(dma_engine_t *dma,
+                           adc_driver_t *adc,
+                           sample_t *data,
+                           const size_t len,
+                           sample_timing_t *timing,
+                           adc_self_test_t *result)
+{
+    AbortIfNot(dma, fail);
+    AbortIfNot(adc, fail);
+    AbortIfNot(adc->regs, fail);
+    AbortIfNot(data, fail);
+    AbortIfNot(timing, fail);
+    AbortIfNot(result, fail);
+    AbortIfNot(adc->regs->stream_control & ADC_STREAM_TIMESTAMPS, fail);
+
+    memset(result, 0, sizeof(*result));
+
+    const uint32_t decimation_control = adc->regs->decimation_control;
+    const uint32_t stream_control = adc->regs->stream_control;
+    adc->regs->decimation_control = 0;
+    adc->regs->stream_control = stream_control & ~(ADC_STREAM_PACKED | ADC_STREAM_CHANNEL_MASK);
+
+    result->clk_div = adc->regs->clk_div;
+    result->expected_hz = get_adc_sampling_frequency(adc);
+
+    result_t ret = success;
+    for (size_t i = 0; ret == success && i < sizeof(adc_test_patterns) / sizeof(adc_test_patterns[0]); ++i)
+    {
+        ret = test_adc_pattern(dma, adc, data, len, timing, adc_test_patterns[i], result);
+    }
+
+    /*
+     * The converted samples are restored even if a capture failed, and the
+     * packets of the pattern still in the FIFO are discarded.
+     */
+    if (!set_adc_test_pattern(adc, false, 0))
+    {
+        ret = fail;
+    }
+    adc->regs->decimation_control = decimation_control;
+    adc->regs->stream_control = stream_control;
+    if (ret == success)
+    {
+        ret = record(dma, data, adc->regs->samples_per_packet * ADC_SELF_TEST_SETTLE_PACKETS, *adc);
+    }
+    AbortIfNot(ret, fail);
+
+    result->flags |= ADC_SELF_TEST_RAN;
+    if (result->pattern_errors)
+    {
+        result->flags |= ADC_SELF_TEST_PATTERN_FAULT;
+    }
+
+    if (result->discontinuities)
+    {
+        result->flags |= ADC_SELF_TEST_ORDER_FAULT;
+    }
+
+    if (result->dropped_samples)
+    {
+        result->flags |= ADC_SELF_TEST_OVERRUN_FAULT;
+    }
+
+    const uint32_t tolerance_hz = (uint64_t)result->expected_hz * ADC_SELF_TEST_RATE_TOLERANCE_PERCENT / 100;
+    if (result->measured_hz + tolerance_hz < result->expected_hz ||
+        result->measured_hz > result->expected_hz + tolerance_hz)
+    {
+        result->flags |= ADC_SELF_TEST_RATE_FAULT;
+    }
+
+    return success;
+}
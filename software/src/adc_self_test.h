@@ -0,0 +1,58 @@
+#ifndef ADC_SELF_TEST_H
+#define ADC_SELF_TEST_H
+
+#include "adc.h"
+#include "dma.h"
+#include "sample_util.h"
+#include "types.h"
+
+/**
+ * The outcome flags of the ADC self test. Every flag but the first is a fault.
+ */
+#define ADC_SELF_TEST_RAN 0x01
+#define ADC_SELF_TEST_PATTERN_FAULT 0x02
+#define ADC_SELF_TEST_ORDER_FAULT 0x04
+#define ADC_SELF_TEST_OVERRUN_FAULT 0x08
+#define ADC_SELF_TEST_RATE_FAULT 0x10
+
+/**
+ * Defines the result of capturing the ADC test patterns through the FPGA and
+ * DMA datapath.
+ */
+typedef struct adc_self_test_t
+{
+    uint8_t flags;
+
+    /*
+     * The clock divider tested, and the rate it sets and the rate the stream
+     * counters measured in Hz.
+     */
+    uint32_t clk_div;
+    uint32_t expected_hz;
+    uint32_t measured_hz;
+
+    /*
+     * The samples checked, those in which any channel differed from the
+     * pattern, the breaks in the timestamps or packet sequence, and the
+     * samples the FPGA lost to a full FIFO.
+     */
+    uint32_t samples;
+    uint32_t pattern_errors;
+    uint32_t discontinuities;
+    uint32_t dropped_samples;
+
+    /*
+     * The rate at which samples were captured in Hz, which falls short of the
+     * stream rate if the datapath cannot keep up.
+     */
+    uint32_t capture_hz;
+} adc_self_test_t;
+
+result_t run_adc_self_test(dma_engine_t *dma,
+                           adc_driver_t *adc,
+                           sample_t *data,
+                           const size_t len,
+                           sample_timing_t *timing,
+                           adc_self_test_t *result);
+
+#endif
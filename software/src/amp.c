@@ -0,0 +1,391 @@
+#include "amp.h"
+
+#include "abort.h"
+#include "cycle_counter.h"
+#include "db.h"
+#include "dsp.h"
+#include "profile.h"
+#include "spsc_queue.h"
+#include "system.h"
+#include "time_util.h"
+#include "types.h"
+#include "xil_cache.h"
+
+/**
+ * The address polled by CPU1 in the boot ROM for the start of its program.
+ */
+#define CPU1_START_ADDRESS 0xFFFFFFF0
+
+/**
+ * The size of the DSP core stack in bytes.
+ */
+#define DSP_CORE_STACK_SIZE 0x8000
+
+/**
+ * The time to wait for CPU1 to report that it has started.
+ */
+#define DSP_CORE_START_TIMEOUT_MS 100
+
+/**
+ * The mailbox shared with the DSP core, which resides in on-chip memory.
+ */
+dsp_mailbox_t dsp_mailbox __attribute__((section(".ocm")));
+
+/**
+ * The stack of the DSP core. The startup code loads the stack pointer from
+ * dsp_core_stack_top.
+ */
+uint8_t dsp_core_stack[DSP_CORE_STACK_SIZE] __attribute__((aligned(16)));
+uint8_t *dsp_core_stack_top = &dsp_core_stack[DSP_CORE_STACK_SIZE];
+
+/**
+ * The function that CPU1 runs once released, which never returns.
+ */
+void (*cpu1_main)() = NULL;
+
+/**
+ * Main loop of the DSP core. Jobs are run in the order they are submitted.
+ *
+ * @return None.
+ */
+void dsp_core_main()
+{
+    init_profiler();
+    init_cycle_counter();
+
+    dsp_mailbox.running = 1;
+    data_sync_barrier();
+    send_event();
+
+    dsp_job_t *job;
+    while (1)
+    {
+        while (!spsc_pop(&dsp_mailbox.jobs, &job))
+        {
+            wait_for_event();
+        }
+
+        run_dsp_job(job);
+
+        while (!spsc_push(&dsp_mailbox.completions, &job))
+        {
+            wait_for_event();
+        }
+
+        data_sync_barrier();
+        send_event();
+    }
+}
+
+/**
+ * Entry point of CPU1 when it is released from the boot ROM.
+ *
+ * @note CPU1 shares the translation table and exception vectors of CPU0 and
+ *       joins the SMP coherency domain, so memory written by either core is
+ *       visible to the other without cache maintenance. Interrupts remain
+ *       masked on CPU1.
+ *
+ * @return None.
+ */
+__attribute__((naked)) void dsp_core_entry()
+{
+    __asm volatile(
+        "cpsid if, #0x13\n"
+
+        /*
+         * Invalidate the TLBs, instruction cache, and branch predictor.
+         */
+        "mov r0, #0\n"
+        "mcr p15, 0, r0, c8, c7, 0\n"
+        "mcr p15, 0, r0, c7, c5, 0\n"
+        "mcr p15, 0, r0, c7, c5, 6\n"
+
+        /*
+         * Invalidate the 4-way, 256-set L1 data cache by set and way.
+         */
+        "mov r1, #0\n"
+        "1:\n"
+        "mov r2, #0\n"
+        "2:\n"
+        "orr r3, r1, r2\n"
+        "mcr p15, 0, r3, c7, c6, 2\n"
+        "add r2, r2, #(1 << 5)\n"
+        "cmp r2, #(256 << 5)\n"
+        "bne 2b\n"
+        "adds r1, r1, #(1 << 30)\n"
+        "bne 1b\n"
+        "dsb\n"
+
+        /*
+         * Use the translation table of CPU0 with all domains as managers.
+         */
+        "ldr r0, =MMUTable\n"
+        "orr r0, r0, #0x5B\n"
+        "mcr p15, 0, r0, c2, c0, 0\n"
+        "mvn r0, #0\n"
+        "mcr p15, 0, r0, c3, c0, 0\n"
+
+        /*
+         * Join the coherency domain and broadcast cache maintenance.
+         */
+        "mrc p15, 0, r0, c1, c0, 1\n"
+        "orr r0, r0, #0x41\n"
+        "mcr p15, 0, r0, c1, c0, 1\n"
+
+        /*
+         * Share the exception vectors of CPU0.
+         */
+        "ldr r0, =_vector_table\n"
+        "mcr p15, 0, r0, c12, c0, 0\n"
+
+        /*
+         * Enable the MMU, caches, and branch prediction with vectors taken
+         * from VBAR.
+         */
+        "mrc p15, 0, r0, c1, c0, 0\n"
+        "ldr r1, =0x1805\n"
+        "orr r0, r0, r1\n"
+        "bic r0, r0, #(1 << 13)\n"
+        "mcr p15, 0, r0, c1, c0, 0\n"
+        "dsb\n"
+        "isb\n"
+
+        /*
+         * Enable VFP and NEON.
+         */
+        "mrc p15, 0, r0, c1, c0, 2\n"
+        "orr r0, r0, #(0xF << 20)\n"
+        "mcr p15, 0, r0, c1, c0, 2\n"
+        "isb\n"
+        "mov r0, #0x40000000\n"
+        "vmsr fpexc, r0\n"
+
+        "ldr r0, =dsp_core_stack_top\n"
+        "ldr sp, [r0]\n"
+        "ldr r0, =cpu1_main\n"
+        "ldr r0, [r0]\n"
+        "bx r0\n");
+}
+
+/**
+ * Releases CPU1 from the boot ROM to run a main loop, and waits for it to
+ * report that it has started.
+ *
+ * @param main The main loop of CPU1.
+ * @param running The flag that the main loop sets once it has started.
+ *
+ * @return Success or fail.
+ */
+result_t start_cpu1(void (*main)(), volatile uint32_t *running)
+{
+    AbortIfNot(main, fail);
+    AbortIfNot(running, fail);
+    AbortIf(cpu1_main, fail);
+
+    /*
+     * CPU1 reads the main loop once it has joined the coherency domain, but
+     * the boot ROM reads its start address from memory.
+     */
+    cpu1_main = main;
+    *(volatile uint32_t *)CPU1_START_ADDRESS = (uint32_t)dsp_core_entry;
+    Xil_DCacheFlushRange(CPU1_START_ADDRESS, sizeof(uint32_t));
+    data_sync_barrier();
+    send_event();
+
+    const tick_t start_time = get_system_time();
+    while (!*running)
+    {
+        AbortIf(get_system_time() - start_time > ms_to_ticks(DSP_CORE_START_TIMEOUT_MS), fail);
+    }
+
+    return success;
+}
+
+/**
+ * Releases CPU1 from the boot ROM to run DSP jobs.
+ *
+ * @note If CPU1 does not start, jobs must be run on CPU0.
+ *
+ * @return Success or fail.
+ */
+result_t start_dsp_core()
+{
+    dsp_mailbox.running = 0;
+    dsp_mailbox.work.open = 0;
+    dsp_mailbox.work.helpers = 0;
+    AbortIfNot(init_spsc_queue(&dsp_mailbox.jobs,
+                               dsp_mailbox.job_storage,
+                               sizeof(dsp_job_t *),
+                               DSP_QUEUE_DEPTH), fail);
+    AbortIfNot(init_spsc_queue(&dsp_mailbox.completions,
+                               dsp_mailbox.completion_storage,
+                               sizeof(dsp_job_t *),
+                               DSP_QUEUE_DEPTH), fail);
+
+    AbortIfNot(start_cpu1(dsp_core_main, &dsp_mailbox.running), fail);
+
+    return success;
+}
+
+/**
+ * Checks if the DSP core is available to run jobs.
+ *
+ * @return True if CPU1 has started.
+ */
+bool dsp_core_running()
+{
+    return (dsp_mailbox.running)? true : false;
+}
+
+/**
+ * Submits a job to the DSP core.
+ *
+ * @note Only a reference to the job is queued. The job and the buffers it
+ *       references must not be used by CPU0 until the job has been received
+ *       back.
+ *
+ * @param job The job to run.
+ *
+ * @return Success or fail.
+ */
+result_t submit_dsp_job(dsp_job_t *job)
+{
+    AbortIfNot(job, fail);
+    AbortIfNot(dsp_core_running(), fail);
+    AbortIfNot(spsc_push(&dsp_mailbox.jobs, &job), fail);
+
+    data_sync_barrier();
+    send_event();
+
+    return success;
+}
+
+/**
+ * Retrieves the oldest job completed by the DSP core.
+ *
+ * @param[out] job The completed job.
+ *
+ * @return True if a completed job was retrieved.
+ */
+bool receive_dsp_job(dsp_job_t **job)
+{
+    if (!spsc_pop(&dsp_mailbox.completions, job))
+    {
+        return false;
+    }
+
+    /*
+     * The DSP core may be waiting for room in the completion queue.
+     */
+    send_event();
+
+    return true;
+}
+
+/**
+ * Claims and runs indices of the open parallel loop until none remain.
+ *
+ * @param work The loop to run.
+ *
+ * @return True if any index was run.
+ */
+static bool run_dsp_work(dsp_work_t *work)
+{
+    const parallel_task_t task = work->task;
+    void *context = work->context;
+    const uint32_t count = work->count;
+
+    bool ran = false;
+    uint32_t index;
+    while ((index = __atomic_fetch_add(&work->next, 1, __ATOMIC_SEQ_CST)) < count)
+    {
+        if (task(context, index) != success)
+        {
+            work->failed = 1;
+        }
+
+        __atomic_fetch_add(&work->completed, 1, __ATOMIC_SEQ_CST);
+        ran = true;
+    }
+
+    return ran;
+}
+
+/**
+ * Runs a parallel loop on the DSP core, sharing its indices with CPU0 while
+ * CPU0 waits for the job.
+ *
+ * @note Only the DSP core may open a loop, and it returns once every index
+ *       has run, so a task never outlives the call.
+ *
+ * @param task The task to run for each index.
+ * @param context The context passed to each task.
+ * @param count The number of indices.
+ *
+ * @return Success or fail.
+ */
+result_t share_dsp_work(parallel_task_t task, void *context, const size_t count)
+{
+    AbortIfNot(task, fail);
+
+    dsp_work_t *work = &dsp_mailbox.work;
+    work->task = task;
+    work->context = context;
+    work->count = count;
+    work->failed = 0;
+    work->completed = 0;
+    __atomic_store_n(&work->next, 0, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&work->open, 1, __ATOMIC_SEQ_CST);
+    send_event();
+
+    run_dsp_work(work);
+
+    /*
+     * A helper that saw the loop open may still be claiming an index, so the
+     * loop is only reused once every helper has left.
+     */
+    __atomic_store_n(&work->open, 0, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&work->completed, __ATOMIC_SEQ_CST) < count ||
+           __atomic_load_n(&work->helpers, __ATOMIC_SEQ_CST))
+    {
+        wait_for_event();
+    }
+
+    AbortIf(work->failed, fail);
+
+    return success;
+}
+
+/**
+ * Runs tasks of the parallel loop opened by the DSP core, if any.
+ *
+ * @note CPU0 calls this while it waits for a job, and returns once no index
+ *       of the loop is left to claim.
+ *
+ * @return True if any task was run.
+ */
+bool help_dsp_core()
+{
+    dsp_work_t *work = &dsp_mailbox.work;
+    if (!__atomic_load_n(&work->open, __ATOMIC_SEQ_CST))
+    {
+        return false;
+    }
+
+    /*
+     * The loop is checked again once this core is counted as a helper, so
+     * that the DSP core cannot reuse it while its tasks are read.
+     */
+    bool ran = false;
+    __atomic_fetch_add(&work->helpers, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&work->open, __ATOMIC_SEQ_CST))
+    {
+        ran = run_dsp_work(work);
+    }
+    __atomic_fetch_sub(&work->helpers, 1, __ATOMIC_SEQ_CST);
+
+    data_sync_barrier();
+    send_event();
+
+    return ran;
+}
@@ -0,0 +1,78 @@
+#ifndef AMP_H
+#define AMP_H
+
+#include "dsp.h"
+#include "spsc_queue.h"
+#include "types.h"
+
+/**
+ * The number of jobs that may be queued to or from the DSP core.
+ */
+#define DSP_QUEUE_DEPTH 2
+
+/**
+ * Defines a parallel loop opened by the DSP core, whose indices CPU0 claims
+ * while it waits for the job. Indices are claimed and completed atomically.
+ */
+typedef struct dsp_work_t
+{
+    /*
+     * Set while indices of the loop may be claimed.
+     */
+    volatile uint32_t open __attribute__((aligned(32)));
+
+    /*
+     * The number of cores running tasks of the loop other than the DSP core.
+     */
+    volatile uint32_t helpers;
+
+    /*
+     * The next index to claim, and the number of indices that have run.
+     */
+    volatile uint32_t next __attribute__((aligned(32)));
+    volatile uint32_t completed;
+
+    /*
+     * Set if any task failed.
+     */
+    volatile uint32_t failed;
+
+    parallel_task_t task __attribute__((aligned(32)));
+    void *context;
+    uint32_t count;
+} dsp_work_t;
+
+/**
+ * Defines the mailbox through which CPU0 hands DSP jobs to CPU1 and receives
+ * them back once complete. The queues carry references to the jobs, which
+ * stay in the ping contexts that hold them.
+ */
+typedef struct dsp_mailbox_t
+{
+    /*
+     * Set by CPU1 once it has started.
+     */
+    volatile uint32_t running __attribute__((aligned(32)));
+
+    spsc_queue_t jobs;
+    spsc_queue_t completions;
+    dsp_job_t *job_storage[DSP_QUEUE_DEPTH];
+    dsp_job_t *completion_storage[DSP_QUEUE_DEPTH];
+    dsp_work_t work;
+} dsp_mailbox_t;
+
+result_t start_cpu1(void (*main)(), volatile uint32_t *running);
+
+result_t start_dsp_core();
+
+bool dsp_core_running();
+
+result_t submit_dsp_job(dsp_job_t *job);
+
+bool receive_dsp_job(dsp_job_t **job);
+
+result_t share_dsp_work(parallel_task_t task, void *context, const size_t count);
+
+bool help_dsp_core();
+
+#endif
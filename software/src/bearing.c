@@ -0,0 +1,197 @@
+#include "bearing.h"
+
+#include "abort.h"
+#include "system_params.h"
+#include "types.h"
+
+#include <math.h>
+
+#define PI 3.14159265358979323846
+
+/**
+ * The smallest determinant of the array geometry, relative to the cube of its
+ * largest dimension, for which the array is treated as three dimensional.
+ */
+#define BEARING_PLANAR_TOLERANCE 1e-3
+
+/**
+ * Initializes an array with channels A, B, and C spaced along the x, y, and z
+ * axes from the reference hydrophone.
+ *
+ * @param[out] array The array to initialize.
+ * @param spacing The distance of each hydrophone from the reference in
+ *        meters.
+ *
+ * @return Success or fail.
+ */
+result_t init_hydrophone_array(hydrophone_array_t *array, const float spacing)
+{
+    AbortIfNot(array, fail);
+
+    for (size_t k = 0; k < 3; ++k)
+    {
+        const float position[3] = {(k == 0)? spacing : 0,
+                                   (k == 1)? spacing : 0,
+                                   (k == 2)? spacing : 0};
+        AbortIfNot(set_hydrophone_position(array, k, position), fail);
+    }
+
+    array->speed_of_sound = SPEED_SOUND_WATER_METERS_PER_SECOND;
+
+    return success;
+}
+
+/**
+ * Sets the position of a hydrophone relative to the reference.
+ *
+ * @note Correlations only cover the delays of an array up to
+ *       HYDROPHONE_SPACING_METERS across, so hydrophones further from the
+ *       reference are rejected.
+ *
+ * @param array The array to update.
+ * @param channel The channel of the hydrophone, from zero for channel A.
+ * @param position The position of the hydrophone in meters.
+ *
+ * @return Success or fail.
+ */
+result_t set_hydrophone_position(hydrophone_array_t *array,
+                                 const size_t channel,
+                                 const float position[3])
+{
+    AbortIfNot(array, fail);
+    AbortIfNot(position, fail);
+    AbortIfNot(channel < 3, fail);
+
+    const float distance = sqrtf(position[0] * position[0] +
+                                 position[1] * position[1] +
+                                 position[2] * position[2]);
+    AbortIfNot(distance <= HYDROPHONE_SPACING_METERS, fail);
+
+    for (size_t i = 0; i < 3; ++i)
+    {
+        array->positions[channel][i] = position[i];
+    }
+
+    return success;
+}
+
+/**
+ * Finds the determinant of a 3x3 matrix.
+ *
+ * @param m The matrix, by rows.
+ *
+ * @return The determinant.
+ */
+static double determinant(const double m[3][3])
+{
+    return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+           m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+           m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+}
+
+/**
+ * Solves the direction of the pinger from the channel delays of a result.
+ *
+ * @note A plane wave from the direction u reaches the hydrophone at p earlier
+ *       than the reference by p.u / c, so the delays give the linear system
+ *       P u = c d. An array whose hydrophones lie in the x-y plane only
+ *       determines the horizontal part of u, and the pinger is assumed to be
+ *       below it.
+ *
+ * @param array The geometry of the hydrophone array.
+ * @param[in,out] result The result to solve, which receives the bearing,
+ *                elevation, and direction norm.
+ *
+ * @return Success or fail.
+ */
+result_t solve_bearing(const hydrophone_array_t *array, correlation_result_t *result)
+{
+    AbortIfNot(array, fail);
+    AbortIfNot(result, fail);
+
+    result->bearing_deg = 0;
+    result->elevation_deg = 0;
+    result->direction_norm = 0;
+
+    double p[3][3];
+    double b[3];
+    double size = 0;
+    for (size_t k = 0; k < 3; ++k)
+    {
+        for (size_t i = 0; i < 3; ++i)
+        {
+            p[k][i] = array->positions[k][i];
+            size = (fabs(p[k][i]) > size)? fabs(p[k][i]) : size;
+        }
+
+        b[k] = array->speed_of_sound * result->channel_delay_ns[k] * 1e-9;
+    }
+
+    if (size == 0)
+    {
+        return success;
+    }
+
+    double u[3];
+    const double det = determinant(p);
+    if (fabs(det) > BEARING_PLANAR_TOLERANCE * size * size * size)
+    {
+        /*
+         * Solve by Cramer's rule, replacing each column with the path
+         * differences in turn.
+         */
+        for (size_t i = 0; i < 3; ++i)
+        {
+            double m[3][3];
+            for (size_t k = 0; k < 3; ++k)
+            {
+                for (size_t j = 0; j < 3; ++j)
+                {
+                    m[k][j] = (j == i)? b[k] : p[k][j];
+                }
+            }
+
+            u[i] = determinant(m) / det;
+        }
+
+        result->direction_norm = sqrt(u[0] * u[0] + u[1] * u[1] + u[2] * u[2]);
+    }
+    else
+    {
+        /*
+         * Fit the horizontal direction by least squares over the three
+         * hydrophones.
+         */
+        double n[2][2] = {{0}};
+        double r[2] = {0};
+        for (size_t k = 0; k < 3; ++k)
+        {
+            for (size_t i = 0; i < 2; ++i)
+            {
+                r[i] += p[k][i] * b[k];
+                for (size_t j = 0; j < 2; ++j)
+                {
+                    n[i][j] += p[k][i] * p[k][j];
+                }
+            }
+        }
+
+        const double det2 = n[0][0] * n[1][1] - n[0][1] * n[1][0];
+        if (fabs(det2) <= BEARING_PLANAR_TOLERANCE * size * size * size * size)
+        {
+            return success;
+        }
+
+        u[0] = (n[1][1] * r[0] - n[0][1] * r[1]) / det2;
+        u[1] = (n[0][0] * r[1] - n[1][0] * r[0]) / det2;
+
+        const double horizontal = u[0] * u[0] + u[1] * u[1];
+        u[2] = (horizontal < 1)? -1 * sqrt(1 - horizontal) : 0;
+        result->direction_norm = (horizontal < 1)? 1 : sqrt(horizontal);
+    }
+
+    result->bearing_deg = atan2(u[1], u[0]) * 180 / PI;
+    result->elevation_deg = atan2(u[2], sqrt(u[0] * u[0] + u[1] * u[1])) * 180 / PI;
+
+    return success;
+}
@@ -0,0 +1,28 @@
+#ifndef BEARING_H
+#define BEARING_H
+
+#include "types.h"
+
+/**
+ * Defines the geometry of the hydrophone array. Positions are relative to the
+ * reference hydrophone, with x forward, y to the left, and z up.
+ */
+typedef struct hydrophone_array_t
+{
+    /*
+     * The positions of channels A, B, and C in meters.
+     */
+    float positions[3][3];
+
+    float speed_of_sound;
+} hydrophone_array_t;
+
+result_t init_hydrophone_array(hydrophone_array_t *array, const float spacing);
+
+result_t set_hydrophone_position(hydrophone_array_t *array,
+                                 const size_t channel,
+                                 const float position[3]);
+
+result_t solve_bearing(const hydrophone_array_t *array, correlation_result_t *result);
+
+#endif
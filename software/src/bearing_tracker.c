@@ -0,0 +1,309 @@
+#include "bearing_tracker.h"
+
+#include "abort.h"
+#include "lag_tracker.h"
+#include "system_params.h"
+#include "time_util.h"
+#include "types.h"
+
+#include <math.h>
+#include <string.h>
+
+/**
+ * Initializes a bearing tracker.
+ *
+ * @param[out] tracker The tracker to initialize.
+ *
+ * @return Success or fail.
+ */
+result_t init_bearing_tracker(bearing_tracker_t *tracker)
+{
+    AbortIfNot(tracker, fail);
+
+    memset(tracker, 0, sizeof(*tracker));
+
+    return success;
+}
+
+/**
+ * Discards the track of a bearing tracker, so that the next confident ping
+ * starts it again.
+ *
+ * @param tracker The tracker to reset.
+ *
+ * @return Success or fail.
+ */
+result_t reset_bearing_tracker(bearing_tracker_t *tracker)
+{
+    AbortIfNot(tracker, fail);
+
+    tracker->started = false;
+    tracker->updates = 0;
+    tracker->outliers = 0;
+
+    return success;
+}
+
+/**
+ * Checks whether a bearing tracker has followed enough pings for its estimate
+ * and prediction to be used.
+ *
+ * @param tracker The tracker.
+ *
+ * @return True if the tracker is locked.
+ */
+bool bearing_tracker_locked(const bearing_tracker_t *tracker)
+{
+    return (tracker->started && tracker->updates >= BEARING_TRACK_MIN_UPDATES)? true : false;
+}
+
+/**
+ * Finds the time from the latest update of a tracker to a ping.
+ *
+ * @param tracker The tracker.
+ * @param ping_tick The time of the ping.
+ *
+ * @return The interval in seconds, which is zero for a ping that is not
+ *         later than the latest update.
+ */
+static float elapsed_seconds(const bearing_tracker_t *tracker, const tick_t ping_tick)
+{
+    return (ping_tick > tracker->last_tick)? ticks_to_seconds(ping_tick - tracker->last_tick) : 0;
+}
+
+/**
+ * Predicts the state of a delay filter forward in time.
+ *
+ * @param filter The filter to predict from.
+ * @param dt The time to predict over in seconds.
+ * @param[out] predicted The predicted filter.
+ *
+ * @return None.
+ */
+static void predict_delay(const delay_filter_t *filter, const float dt, delay_filter_t *predicted)
+{
+    const float q = (float)BEARING_TRACK_ACCELERATION_NS_PER_S2 * BEARING_TRACK_ACCELERATION_NS_PER_S2;
+    const float dt2 = dt * dt;
+
+    predicted->delay_ns = filter->delay_ns + filter->rate_ns_per_s * dt;
+    predicted->rate_ns_per_s = filter->rate_ns_per_s;
+    predicted->p00 = filter->p00 + 2 * dt * filter->p01 + dt2 * filter->p11 + q * dt2 * dt / 3;
+    predicted->p01 = filter->p01 + dt * filter->p11 + q * dt2 / 2;
+    predicted->p11 = filter->p11 + q * dt;
+}
+
+/**
+ * Finds the variance of a delay measured at a confidence.
+ *
+ * @param confidence The normalized correlation peak of the delay.
+ *
+ * @return The variance in square nanoseconds.
+ */
+static float measurement_variance(const float confidence)
+{
+    const float clamped = (confidence > 0.1f)? confidence : 0.1f;
+    const float sigma = BEARING_TRACK_MEASUREMENT_NS / clamped;
+
+    return sigma * sigma;
+}
+
+/**
+ * Starts the filters of a tracker from the delays of a ping.
+ *
+ * @param tracker The tracker to start.
+ * @param ping_tick The time of the ping.
+ * @param result The result of the ping.
+ *
+ * @return None.
+ */
+static void start_track(bearing_tracker_t *tracker, const tick_t ping_tick, const correlation_result_t *result)
+{
+    const float rate_variance = (float)BEARING_TRACK_INITIAL_RATE_NS_PER_S * BEARING_TRACK_INITIAL_RATE_NS_PER_S;
+
+    for (size_t i = 0; i < 3; ++i)
+    {
+        delay_filter_t *filter = &tracker->filters[i];
+        filter->delay_ns = result->channel_delay_ns[i];
+        filter->rate_ns_per_s = 0;
+        filter->p00 = measurement_variance(result->confidence[i]);
+        filter->p01 = 0;
+        filter->p11 = rate_variance;
+    }
+
+    tracker->started = true;
+    tracker->last_tick = ping_tick;
+    tracker->updates = 1;
+    tracker->outliers = 0;
+}
+
+/**
+ * Adds the delays of a ping to a bearing tracker and gets its estimate. The
+ * delays are rejected if any falls outside the gate around its prediction,
+ * and the track is restarted from them after too many consecutive outliers.
+ * Pings that are not confident leave the track as it is.
+ *
+ * @param tracker The tracker to update.
+ * @param array The geometry of the array to solve the filtered direction
+ *        with.
+ * @param ping_tick The time the ping arrived at.
+ * @param result The result of the ping.
+ * @param[out] estimate The estimate after the ping.
+ *
+ * @return Success or fail.
+ */
+result_t update_bearing_tracker(bearing_tracker_t *tracker,
+                                const hydrophone_array_t *array,
+                                const tick_t ping_tick,
+                                const correlation_result_t *result,
+                                bearing_estimate_t *estimate)
+{
+    AbortIfNot(tracker, fail);
+    AbortIfNot(array, fail);
+    AbortIfNot(result, fail);
+    AbortIfNot(estimate, fail);
+
+    memset(estimate, 0, sizeof(*estimate));
+
+    if (tracker->started &&
+        ping_tick > tracker->last_tick &&
+        ping_tick - tracker->last_tick > ms_to_ticks(BEARING_TRACK_STALE_MS))
+    {
+        AbortIfNot(reset_bearing_tracker(tracker), fail);
+    }
+
+    if (lag_result_confident(result))
+    {
+        if (!tracker->started)
+        {
+            start_track(tracker, ping_tick, result);
+        }
+        else
+        {
+            const float dt = elapsed_seconds(tracker, ping_tick);
+            delay_filter_t predicted[3];
+            float innovation[3];
+            float innovation_variance[3];
+            bool outlier = false;
+            for (size_t i = 0; i < 3; ++i)
+            {
+                predict_delay(&tracker->filters[i], dt, &predicted[i]);
+                innovation[i] = result->channel_delay_ns[i] - predicted[i].delay_ns;
+                innovation_variance[i] = predicted[i].p00 + measurement_variance(result->confidence[i]);
+                if (innovation[i] * innovation[i] >
+                    BEARING_TRACK_GATE_SIGMA * BEARING_TRACK_GATE_SIGMA * innovation_variance[i])
+                {
+                    outlier = true;
+                }
+            }
+
+            if (outlier)
+            {
+                estimate->flags |= BEARING_TRACK_OUTLIER;
+                tracker->outliers++;
+                tracker->total_outliers++;
+                if (tracker->outliers >= BEARING_TRACK_MAX_OUTLIERS)
+                {
+                    start_track(tracker, ping_tick, result);
+                    estimate->flags |= BEARING_TRACK_RESTARTED;
+                    tracker->restarts++;
+                }
+            }
+            else
+            {
+                for (size_t i = 0; i < 3; ++i)
+                {
+                    delay_filter_t *filter = &tracker->filters[i];
+                    const float k0 = predicted[i].p00 / innovation_variance[i];
+                    const float k1 = predicted[i].p01 / innovation_variance[i];
+
+                    filter->delay_ns = predicted[i].delay_ns + k0 * innovation[i];
+                    filter->rate_ns_per_s = predicted[i].rate_ns_per_s + k1 * innovation[i];
+                    filter->p00 = predicted[i].p00 - k0 * predicted[i].p00;
+                    filter->p01 = predicted[i].p01 - k0 * predicted[i].p01;
+                    filter->p11 = predicted[i].p11 - k1 * predicted[i].p01;
+                }
+
+                tracker->last_tick = ping_tick;
+                tracker->updates++;
+                tracker->outliers = 0;
+            }
+        }
+    }
+
+    estimate->outliers = tracker->outliers;
+    if (!bearing_tracker_locked(tracker))
+    {
+        return success;
+    }
+
+    /*
+     * The estimate is reported at the time of the ping.
+     */
+    const float dt = elapsed_seconds(tracker, ping_tick);
+    correlation_result_t filtered = *result;
+    for (size_t i = 0; i < 3; ++i)
+    {
+        delay_filter_t predicted;
+        predict_delay(&tracker->filters[i], dt, &predicted);
+        estimate->delay_ns[i] = predicted.delay_ns;
+        estimate->delay_rate_ns_per_s[i] = predicted.rate_ns_per_s;
+        estimate->delay_variance_ns2[i] = predicted.p00;
+        filtered.channel_delay_ns[i] = (int32_t)lroundf(predicted.delay_ns);
+    }
+
+    AbortIfNot(solve_bearing(array, &filtered), fail);
+    estimate->bearing_deg = filtered.bearing_deg;
+    estimate->elevation_deg = filtered.elevation_deg;
+    estimate->flags |= BEARING_TRACK_LOCKED;
+
+    return success;
+}
+
+/**
+ * Predicts the lag of each channel from the reference at the time of a ping
+ * and sets the window of lags that the correlation searches around it. The
+ * window spans the gate of the tracker, so that it holds every delay that
+ * the tracker would accept.
+ *
+ * @param tracker The tracker to predict from, which must be locked.
+ * @param ping_tick The expected time of the ping.
+ * @param reference The channel that the others are correlated against.
+ * @param sampling_frequency The sampling frequency of the data.
+ * @param[out] weighting The weighting of the correlation to set the window
+ *             of.
+ *
+ * @return Success or fail.
+ */
+result_t predict_tracked_lags(const bearing_tracker_t *tracker,
+                              const tick_t ping_tick,
+                              const size_t reference,
+                              const uint32_t sampling_frequency,
+                              correlation_weighting_t *weighting)
+{
+    AbortIfNot(tracker, fail);
+    AbortIfNot(weighting, fail);
+    AbortIfNot(bearing_tracker_locked(tracker), fail);
+
+    const float dt = elapsed_seconds(tracker, ping_tick);
+    double delay_ns[4] = {0};
+    float max_variance = 0;
+    for (size_t i = 0; i < 3; ++i)
+    {
+        delay_filter_t predicted;
+        predict_delay(&tracker->filters[i], dt, &predicted);
+        delay_ns[i + 1] = predicted.delay_ns;
+        if (predicted.p00 > max_variance)
+        {
+            max_variance = predicted.p00;
+        }
+    }
+
+    /*
+     * A lag relative to any reference combines the errors of two delays.
+     */
+    const double radius_ns = BEARING_TRACK_GATE_SIGMA *
+            sqrt(2 * (max_variance + measurement_variance(1)));
+    AbortIfNot(set_lag_window(delay_ns, reference, radius_ns, sampling_frequency, weighting), fail);
+
+    return success;
+}
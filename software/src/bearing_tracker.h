@@ -0,0 +1,72 @@
+#ifndef BEARING_TRACKER_H
+#define BEARING_TRACKER_H
+
+#include "bearing.h"
+#include "correlation_util.h"
+#include "types.h"
+
+/**
+ * Defines the Kalman filter of the delay of one channel, whose state is the
+ * delay and its rate of change.
+ */
+typedef struct delay_filter_t
+{
+    float delay_ns;
+    float rate_ns_per_s;
+
+    /*
+     * The covariance of the state, which is symmetric.
+     */
+    float p00;
+    float p01;
+    float p11;
+} delay_filter_t;
+
+/**
+ * Defines a tracker of the delays of consecutive pings. Each delay is
+ * filtered with a constant rate model, and the delays of a ping that fall
+ * outside the gate around the prediction are rejected as multipath.
+ *
+ * @note The channels are filtered independently, which costs a few dozen
+ *       floating point operations per ping.
+ */
+typedef struct bearing_tracker_t
+{
+    delay_filter_t filters[3];
+
+    /*
+     * The time of the latest ping that updated the filters, the pings that
+     * updated them since they were started, and the consecutive outliers.
+     */
+    bool started;
+    tick_t last_tick;
+    uint32_t updates;
+    uint32_t outliers;
+
+    /*
+     * The pings rejected and the restarts after losing the pinger, since
+     * boot.
+     */
+    uint32_t total_outliers;
+    uint32_t restarts;
+} bearing_tracker_t;
+
+result_t init_bearing_tracker(bearing_tracker_t *tracker);
+
+result_t reset_bearing_tracker(bearing_tracker_t *tracker);
+
+bool bearing_tracker_locked(const bearing_tracker_t *tracker);
+
+result_t update_bearing_tracker(bearing_tracker_t *tracker,
+                                const hydrophone_array_t *array,
+                                const tick_t ping_tick,
+                                const correlation_result_t *result,
+                                bearing_estimate_t *estimate);
+
+result_t predict_tracked_lags(const bearing_tracker_t *tracker,
+                              const tick_t ping_tick,
+                              const size_t reference,
+                              const uint32_t sampling_frequency,
+                              correlation_weighting_t *weighting);
+
+#endif
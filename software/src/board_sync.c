@@ -0,0 +1,470 @@
+#include "board_sync.h"
+
+#include "abort.h"
+#include "db.h"
+#include "sample_clock.h"
+#include "system.h"
+#include "system_params.h"
+#include "time_util.h"
+
+#include "lwip/ip_addr.h"
+
+#include <string.h>
+
+/**
+ * The sync of this board, which receives the messages of the sync port.
+ */
+static board_sync_t *receiver = NULL;
+
+/**
+ * Receives a board sync message. Messages are only copied here and are acted
+ * on when the sync is next serviced.
+ *
+ * @return None.
+ */
+static void receive_board_sync(void *arg, struct udp_pcb *upcb, struct pbuf *p, struct ip_addr *addr, uint16_t port)
+{
+    board_sync_message_t message;
+    if (!receiver || p->len != sizeof(message))
+    {
+        pbuf_free(p);
+        return;
+    }
+
+    memcpy(&message, p->payload, sizeof(message));
+    pbuf_free(p);
+
+    if (message.version != BOARD_SYNC_VERSION || receiver->role != BOARD_SYNC_FOLLOWER)
+    {
+        return;
+    }
+
+    if (message.type == BOARD_SYNC_ANNOUNCE)
+    {
+        receiver->announce = message;
+        receiver->announce_pending = true;
+        receiver->announce_tick = get_system_time();
+    }
+    else if (message.type == BOARD_SYNC_WINDOW)
+    {
+        receiver->window_message = message;
+        receiver->window_received = true;
+    }
+}
+
+/**
+ * Broadcasts a board sync message to every board and the host.
+ *
+ * @param sync The board sync.
+ * @param message The message, whose version is filled in.
+ *
+ * @return Success or fail.
+ */
+static result_t broadcast_board_sync(board_sync_t *sync, board_sync_message_t *message)
+{
+    message->version = BOARD_SYNC_VERSION;
+    message->reserved = 0;
+    message->sampling_frequency = get_adc_sampling_frequency(sync->adc);
+
+    return send_udp_to(&sync->socket, IP_ADDR_BROADCAST, BOARD_SYNC_PORT, message, sizeof(*message));
+}
+
+/**
+ * Initializes the sync of a board with the others on its sync line. The board
+ * takes no part until it is given a role.
+ *
+ * @param[out] sync The board sync to initialize.
+ * @param adc The ADC driver whose stream is latched.
+ * @param port The UDP port the boards exchange messages on.
+ *
+ * @return Success or fail.
+ */
+result_t init_board_sync(board_sync_t *sync, const adc_driver_t *adc, const uint16_t port)
+{
+    AbortIfNot(sync, fail);
+    AbortIfNot(adc, fail);
+
+    memset(sync, 0, sizeof(*sync));
+    sync->role = BOARD_SYNC_OFF;
+    sync->adc = adc;
+
+    adc_sync_latch_t latch;
+    AbortIfNot(read_adc_sync(adc, &latch), fail);
+    sync->latch_count = latch.count;
+
+    AbortIfNot(set_adc_sync_output(adc, false), fail);
+
+    AbortIfNot(init_udp(&sync->socket), fail);
+    AbortIfNot(bind_udp(&sync->socket, IP_ADDR_ANY, port, receive_board_sync), fail);
+    receiver = sync;
+
+    return success;
+}
+
+/**
+ * Sets the part the board plays in the sync of the array. The board forgets
+ * any alignment it had.
+ *
+ * @param sync The board sync.
+ * @param role The role of the board.
+ *
+ * @return Success or fail.
+ */
+result_t set_board_sync_role(board_sync_t *sync, const board_sync_role_t role)
+{
+    AbortIfNot(sync, fail);
+    AbortIfNot(role <= BOARD_SYNC_MASTER, fail);
+
+    AbortIfNot(set_adc_sync_output(sync->adc, role == BOARD_SYNC_MASTER), fail);
+
+    adc_sync_latch_t latch;
+    AbortIfNot(read_adc_sync(sync->adc, &latch), fail);
+
+    sync->role = role;
+    sync->latch_count = latch.count;
+    sync->next_fire = get_system_time();
+    sync->firing = false;
+    sync->announce_pending = false;
+    sync->aligned = false;
+    sync->rate_known = false;
+    sync->window_received = false;
+    sync->window_pending = false;
+
+    return success;
+}
+
+/**
+ * Drives a pulse on the sync line when one is due, and announces the latch of
+ * the pulse once it has been taken.
+ *
+ * @param sync The board sync of the master.
+ * @param now The current system time.
+ *
+ * @return Success or fail.
+ */
+static result_t service_master(board_sync_t *sync, const tick_t now)
+{
+    adc_sync_latch_t latch;
+    if (!sync->firing)
+    {
+        if (now < sync->next_fire)
+        {
+            return success;
+        }
+
+        AbortIfNot(read_adc_sync(sync->adc, &latch), fail);
+        sync->latch_count = latch.count;
+        AbortIfNot(fire_adc_sync(sync->adc), fail);
+        sync->firing = true;
+        sync->fire_tick = now;
+        sync->next_fire = now + ms_to_ticks(BOARD_SYNC_PERIOD_MS);
+        return success;
+    }
+
+    AbortIfNot(read_adc_sync(sync->adc, &latch), fail);
+    if (latch.count == sync->latch_count)
+    {
+        if (now - sync->fire_tick > ms_to_ticks(BOARD_SYNC_LATCH_TIMEOUT_MS))
+        {
+            sync->firing = false;
+            sync->missed++;
+        }
+        return success;
+    }
+
+    sync->firing = false;
+    sync->latch_count = latch.count;
+    sync->sequence++;
+    sync->pulses++;
+
+    board_sync_message_t message;
+    memset(&message, 0, sizeof(message));
+    message.type = BOARD_SYNC_ANNOUNCE;
+    message.sequence = sync->sequence;
+    message.master_sample = latch.sample;
+    if (!broadcast_board_sync(sync, &message))
+    {
+        dblog(LOG_WARN, "Failed to announce sync pulse %u.\n", sync->sequence);
+    }
+
+    return success;
+}
+
+/**
+ * Pairs an announcement of the master with the latch of the same pulse on
+ * this board, and reports the alignment.
+ *
+ * @note The master announces a pulse only after latching it, and the pulse
+ *       reaches every board at once, so the latest edge latched when an
+ *       announcement arrives is the one it refers to.
+ *
+ * @param sync The board sync of a follower.
+ * @param now The current system time.
+ *
+ * @return Success or fail.
+ */
+static result_t service_follower(board_sync_t *sync, const tick_t now)
+{
+    if (sync->aligned && now - sync->aligned_tick > ms_to_ticks(BOARD_SYNC_STALE_MS))
+    {
+        dblog(LOG_WARN, "Lost sync with the master board.\n");
+        sync->aligned = false;
+        sync->rate_known = false;
+    }
+
+    if (!sync->announce_pending)
+    {
+        return success;
+    }
+
+    adc_sync_latch_t latch;
+    AbortIfNot(read_adc_sync(sync->adc, &latch), fail);
+    if (latch.count == sync->latch_count)
+    {
+        if (now - sync->announce_tick > ms_to_ticks(BOARD_SYNC_LATCH_TIMEOUT_MS))
+        {
+            sync->announce_pending = false;
+            sync->missed++;
+        }
+        return success;
+    }
+
+    sync->announce_pending = false;
+    sync->latch_count = latch.count;
+    sync->pulses++;
+
+    if (sync->announce.sampling_frequency != get_adc_sampling_frequency(sync->adc))
+    {
+        sync->aligned = false;
+        sync->rate_known = false;
+        return success;
+    }
+
+    /*
+     * The spans are only taken across consecutive pulses, so that a pulse
+     * missed on either side does not pair one board's span with another's.
+     */
+    const bool consecutive = sync->aligned && sync->announce.sequence == sync->sequence + 1 &&
+            sync->announce.master_sample > sync->master_sample && latch.sample > sync->board_sample;
+    if (consecutive)
+    {
+        sync->master_span = sync->announce.master_sample - sync->master_sample;
+        sync->board_span = latch.sample - sync->board_sample;
+        sync->rate_known = true;
+    }
+
+    sync->sequence = sync->announce.sequence;
+    sync->master_sample = sync->announce.master_sample;
+    sync->board_sample = latch.sample;
+    sync->aligned_tick = now;
+    sync->aligned = true;
+
+    board_sync_message_t message;
+    memset(&message, 0, sizeof(message));
+    message.type = BOARD_SYNC_REPORT;
+    message.sequence = sync->sequence;
+    message.master_sample = sync->master_sample;
+    message.board_sample = sync->board_sample;
+    if (sync->rate_known)
+    {
+        message.drift_ppb = (int32_t)(((int64_t)sync->board_span - (int64_t)sync->master_span) *
+                1000000000ll / (int64_t)sync->master_span);
+    }
+    if (!broadcast_board_sync(sync, &message))
+    {
+        dblog(LOG_WARN, "Failed to report sync pulse %u.\n", sync->sequence);
+    }
+
+    return success;
+}
+
+/**
+ * Converts a window shared by the master into the system time of this board.
+ *
+ * @param sync The board sync of a follower.
+ *
+ * @return Success or fail.
+ */
+static result_t convert_board_window(board_sync_t *sync)
+{
+    sync->window_received = false;
+    if (!sync->aligned)
+    {
+        return success;
+    }
+
+    const board_sync_message_t *message = &sync->window_message;
+    const uint32_t sampling_frequency = get_adc_sampling_frequency(sync->adc);
+    AbortIfNot(message->sampling_frequency == sampling_frequency, fail);
+
+    uint64_t start_sample;
+    AbortIfNot(master_to_board_sample(sync, message->master_sample, &start_sample), fail);
+
+    uint64_t now_sample;
+    tick_t now;
+    AbortIfNot(read_adc_stream_time(sync->adc, &now_sample, &now), fail);
+
+    /*
+     * A window that has already opened is captured from now.
+     */
+    sync->window_start_tick = (start_sample > now_sample)?
+            now + samples_to_ticks(start_sample - now_sample, sampling_frequency) : now;
+    sync->window_duration = samples_to_ticks(message->duration_samples, sampling_frequency);
+    sync->window_ping_tick = sync->window_start_tick +
+            samples_to_ticks(message->ping_offset_samples, sampling_frequency);
+    sync->window_pending = true;
+
+    return success;
+}
+
+/**
+ * Drives and announces the pulses of the master, or pairs and reports them on
+ * a follower. Called regularly from the main loop.
+ *
+ * @param sync The board sync.
+ *
+ * @return Success or fail.
+ */
+result_t service_board_sync(board_sync_t *sync)
+{
+    AbortIfNot(sync, fail);
+
+    const tick_t now = get_system_time();
+    if (sync->role == BOARD_SYNC_MASTER)
+    {
+        AbortIfNot(service_master(sync, now), fail);
+    }
+    else if (sync->role == BOARD_SYNC_FOLLOWER)
+    {
+        AbortIfNot(service_follower(sync, now), fail);
+        if (sync->window_received)
+        {
+            AbortIfNot(convert_board_window(sync), fail);
+        }
+    }
+
+    return success;
+}
+
+/**
+ * Checks whether the samples of the board are related to the master's. The
+ * master is always aligned with itself.
+ *
+ * @param sync The board sync.
+ *
+ * @return True if master samples may be converted to samples of this board.
+ */
+bool board_sync_aligned(const board_sync_t *sync)
+{
+    return (sync->role == BOARD_SYNC_MASTER) || (sync->role == BOARD_SYNC_FOLLOWER && sync->aligned);
+}
+
+/**
+ * Converts a stream timestamp of the master into a stream timestamp of this
+ * board.
+ *
+ * @param sync The board sync.
+ * @param master_sample The timestamp on the master.
+ * @param[out] board_sample The timestamp of the same instant on this board.
+ *
+ * @return Success or fail if the board is not aligned.
+ */
+result_t master_to_board_sample(const board_sync_t *sync, const uint64_t master_sample, uint64_t *board_sample)
+{
+    AbortIfNot(sync, fail);
+    AbortIfNot(board_sample, fail);
+    AbortIfNot(board_sync_aligned(sync), fail);
+
+    if (sync->role == BOARD_SYNC_MASTER)
+    {
+        *board_sample = master_sample;
+        return success;
+    }
+
+    /*
+     * The distance from the latest pulse is scaled by the ratio of the rates
+     * of the two streams once it is known.
+     */
+    int64_t delta = (int64_t)(master_sample - sync->master_sample);
+    if (sync->rate_known)
+    {
+        delta = delta * (int64_t)sync->board_span / (int64_t)sync->master_span;
+    }
+    *board_sample = sync->board_sample + delta;
+
+    return success;
+}
+
+/**
+ * Shares a capture window planned by the master with the followers.
+ *
+ * @param sync The board sync of the master.
+ * @param start_tick The system time the window opens.
+ * @param duration The length of the window.
+ * @param ping_tick The system time the ping is predicted at.
+ *
+ * @return Success or fail.
+ */
+result_t share_board_window(board_sync_t *sync,
+                            const tick_t start_tick,
+                            const tick_t duration,
+                            const tick_t ping_tick)
+{
+    AbortIfNot(sync, fail);
+    AbortIfNot(sync->role == BOARD_SYNC_MASTER, fail);
+    AbortIfNot(ping_tick >= start_tick, fail);
+
+    const uint32_t sampling_frequency = get_adc_sampling_frequency(sync->adc);
+
+    uint64_t now_sample;
+    tick_t now;
+    AbortIfNot(read_adc_stream_time(sync->adc, &now_sample, &now), fail);
+
+    board_sync_message_t message;
+    memset(&message, 0, sizeof(message));
+    message.type = BOARD_SYNC_WINDOW;
+    message.sequence = sync->sequence;
+    message.master_sample = now_sample +
+            ((start_tick > now)? ticks_to_samples(start_tick - now, sampling_frequency) : 0);
+    message.duration_samples = ticks_to_samples(duration, sampling_frequency);
+    message.ping_offset_samples = ticks_to_samples(ping_tick - start_tick, sampling_frequency);
+
+    return broadcast_board_sync(sync, &message);
+}
+
+/**
+ * Checks whether a window shared by the master waits to be captured.
+ *
+ * @param sync The board sync.
+ *
+ * @return True if a window is pending.
+ */
+bool board_window_pending(const board_sync_t *sync)
+{
+    return sync->role == BOARD_SYNC_FOLLOWER && sync->aligned && sync->window_pending;
+}
+
+/**
+ * Takes the pending window shared by the master.
+ *
+ * @param sync The board sync of a follower.
+ * @param[out] start_tick The system time the window opens.
+ * @param[out] duration The length of the window.
+ * @param[out] ping_tick The system time the master predicted the ping at.
+ *
+ * @return True if a window was pending.
+ */
+bool take_board_window(board_sync_t *sync, tick_t *start_tick, tick_t *duration, tick_t *ping_tick)
+{
+    if (!board_window_pending(sync))
+    {
+        return false;
+    }
+
+    sync->window_pending = false;
+    *start_tick = sync->window_start_tick;
+    *duration = sync->window_duration;
+    *ping_tick = sync->window_ping_tick;
+
+    return true;
+}
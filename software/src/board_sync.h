@@ -0,0 +1,182 @@
+#ifndef BOARD_SYNC_H
+#define BOARD_SYNC_H
+
+#include "adc.h"
+#include "types.h"
+#include "udp.h"
+
+/**
+ * The version of the board sync message layout.
+ */
+#define BOARD_SYNC_VERSION 1
+
+/**
+ * Defines the part a board plays in the sync of an array. The master drives
+ * the sync line and shares its capture windows, and followers align their
+ * streams to it.
+ */
+typedef enum board_sync_role_t
+{
+    BOARD_SYNC_OFF = 0,
+    BOARD_SYNC_FOLLOWER = 1,
+    BOARD_SYNC_MASTER = 2
+} board_sync_role_t;
+
+/**
+ * Defines the messages of the board sync protocol, which are broadcast so
+ * that the host sees the alignment of every board.
+ */
+typedef enum board_sync_type_t
+{
+    /*
+     * Sent by the master once it has latched a pulse it drove on the sync
+     * line, with the timestamp it latched.
+     */
+    BOARD_SYNC_ANNOUNCE = 0,
+
+    /*
+     * Sent by a follower once it has paired an announcement with its own
+     * latch of the same pulse.
+     */
+    BOARD_SYNC_REPORT = 1,
+
+    /*
+     * Sent by the master with the capture window it planned, in its own
+     * samples.
+     */
+    BOARD_SYNC_WINDOW = 2
+} board_sync_type_t;
+
+/**
+ * Defines a board sync message. All fields are little endian and samples are
+ * stream timestamps, as embedded in the captures of each board.
+ */
+typedef struct __attribute__((packed)) board_sync_message_t
+{
+    uint16_t version;
+    uint8_t type;
+    uint8_t reserved;
+
+    /*
+     * The number of the pulse the message refers to, counted by the master.
+     */
+    uint32_t sequence;
+
+    /*
+     * The stream sampling frequency of the sender.
+     */
+    uint32_t sampling_frequency;
+
+    /*
+     * The timestamp the master latched the pulse at, or the first sample of
+     * a shared window.
+     */
+    uint64_t master_sample;
+
+    /*
+     * The timestamp the follower latched the pulse at.
+     */
+    uint64_t board_sample;
+
+    /*
+     * The rate of the follower's stream relative to the master's, in parts
+     * per billion, or zero until two pulses are paired.
+     */
+    int32_t drift_ppb;
+
+    /*
+     * The length of a shared window, and the offset into it of the ping the
+     * master predicted, in samples.
+     */
+    uint32_t duration_samples;
+    uint32_t ping_offset_samples;
+} board_sync_message_t;
+
+/**
+ * Defines the sync of a board with the others sharing its sync line.
+ *
+ * @note A follower relates the samples of the master to its own with the two
+ *       latest pulses it paired, so the drift between the ADC clocks of the
+ *       boards is followed. The host relates the captures of every board the
+ *       same way from the reports to correlate them jointly.
+ */
+typedef struct board_sync_t
+{
+    board_sync_role_t role;
+    udp_socket_t socket;
+    const adc_driver_t *adc;
+
+    /*
+     * The number of the latest pulse, and the count of edges latched by the
+     * FPGA as of the latest pulse handled.
+     */
+    uint32_t sequence;
+    uint32_t latch_count;
+
+    /*
+     * The time the master next drives the sync line, and whether it waits
+     * for its own latch of the pulse it drove since the given time.
+     */
+    tick_t next_fire;
+    bool firing;
+    tick_t fire_tick;
+
+    /*
+     * An announcement received by a follower that is not yet paired with a
+     * latch, and the time it was received.
+     */
+    bool announce_pending;
+    board_sync_message_t announce;
+    tick_t announce_tick;
+
+    /*
+     * The latest pulse paired by a follower, the samples between it and the
+     * pulse paired before it on each board, and when it was paired.
+     */
+    bool aligned;
+    bool rate_known;
+    uint64_t master_sample;
+    uint64_t board_sample;
+    uint64_t master_span;
+    uint64_t board_span;
+    tick_t aligned_tick;
+
+    /*
+     * A window shared by the master that is not yet converted, and the
+     * converted window that waits to be captured.
+     */
+    bool window_received;
+    board_sync_message_t window_message;
+    bool window_pending;
+    tick_t window_start_tick;
+    tick_t window_duration;
+    tick_t window_ping_tick;
+
+    /*
+     * The pulses handled and the pulses whose latch or announcement did not
+     * arrive in time.
+     */
+    uint32_t pulses;
+    uint32_t missed;
+} board_sync_t;
+
+result_t init_board_sync(board_sync_t *sync, const adc_driver_t *adc, const uint16_t port);
+
+result_t set_board_sync_role(board_sync_t *sync, const board_sync_role_t role);
+
+result_t service_board_sync(board_sync_t *sync);
+
+bool board_sync_aligned(const board_sync_t *sync);
+
+result_t master_to_board_sample(const board_sync_t *sync, const uint64_t master_sample, uint64_t *board_sample);
+
+result_t share_board_window(board_sync_t *sync,
+                            const tick_t start_tick,
+                            const tick_t duration,
+                            const tick_t ping_tick);
+
+bool board_window_pending(const board_sync_t *sync);
+
+bool take_board_window(board_sync_t *sync, tick_t *start_tick, tick_t *duration, tick_t *ping_tick);
+
+#endif
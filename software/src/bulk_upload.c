@@ -0,0 +1,208 @@
+#include "bulk_upload.h"
+
+#include "abort.h"
+#include "db.h"
+#include "system_params.h"
+
+#include "lwip/ip_addr.h"
+
+#include <string.h>
+
+/**
+ * The receiver of the upload port.
+ */
+static bulk_upload_t *receiver = NULL;
+
+/**
+ * Acknowledges the bytes of an upload received in order to its sender.
+ *
+ * @param upload The bulk upload receiver.
+ * @param header The header of the datagram acknowledged.
+ * @param status The state of the upload.
+ * @param received The bytes received in order.
+ * @param addr The address of the sender.
+ * @param port The port of the sender.
+ *
+ * @return None.
+ */
+static void ack_bulk_upload(bulk_upload_t *upload,
+                            const bulk_upload_header_t *header,
+                            const bulk_upload_status_t status,
+                            const size_t received,
+                            struct ip_addr *addr,
+                            const uint16_t port)
+{
+    bulk_upload_ack_t ack;
+    ack.version = BULK_UPLOAD_VERSION;
+    ack.target = header->target;
+    ack.status = (uint8_t)status;
+    ack.transfer = header->transfer;
+    ack.received = (uint32_t)received;
+
+    if (!send_udp_to(&upload->socket, addr, port, &ack, sizeof(ack)))
+    {
+        dblog(LOG_WARN, "Failed to acknowledge upload %u.\n", header->transfer);
+    }
+}
+
+/**
+ * Receives a bulk upload datagram, copying its payload from the buffer chain
+ * to its offset in the target.
+ *
+ * @note Datagrams are acknowledged in batches, and at once when the upload
+ *       completes or a datagram arrives ahead of a loss so that the sender
+ *       resumes from the offset received.
+ *
+ * @return None.
+ */
+static void receive_bulk_upload(void *arg, struct udp_pcb *upcb, struct pbuf *p, struct ip_addr *addr, uint16_t port)
+{
+    bulk_upload_header_t header;
+    if (!receiver || p->tot_len < sizeof(header) ||
+        pbuf_copy_partial(p, &header, sizeof(header), 0) != sizeof(header) ||
+        header.version != BULK_UPLOAD_VERSION)
+    {
+        pbuf_free(p);
+        return;
+    }
+
+    bulk_upload_target_t *target = (header.target < BULK_UPLOAD_MAX_TARGETS)?
+            &receiver->targets[header.target] : NULL;
+    const size_t len = p->tot_len - sizeof(header);
+    if (!target || !target->buffer || !header.total || header.total > target->capacity ||
+        header.offset > header.total || len > header.total - header.offset)
+    {
+        pbuf_free(p);
+        receiver->rejected++;
+        ack_bulk_upload(receiver, &header, BULK_UPLOAD_REJECTED, 0, addr, port);
+        return;
+    }
+
+    if (!target->active || header.transfer != target->transfer)
+    {
+        target->active = true;
+        target->transfer = header.transfer;
+        target->slot = header.slot;
+        target->total = header.total;
+        target->received = 0;
+        target->unacked = 0;
+        target->complete = false;
+    }
+
+    if (header.offset > target->received)
+    {
+        pbuf_free(p);
+        receiver->out_of_order++;
+        ack_bulk_upload(receiver, &header, BULK_UPLOAD_RECEIVING, target->received, addr, port);
+        return;
+    }
+
+    const size_t end = header.offset + len;
+    if (end <= target->received)
+    {
+        pbuf_free(p);
+        receiver->duplicates++;
+        if (target->received == target->total)
+        {
+            ack_bulk_upload(receiver, &header, BULK_UPLOAD_COMPLETE, target->received, addr, port);
+        }
+        return;
+    }
+
+    const size_t skip = target->received - header.offset;
+    pbuf_copy_partial(p,
+                      &target->buffer[target->received],
+                      (u16_t)(len - skip),
+                      (u16_t)(sizeof(header) + skip));
+    pbuf_free(p);
+
+    target->received = end;
+    target->unacked++;
+    receiver->datagrams++;
+
+    if (target->received == target->total)
+    {
+        target->complete = true;
+        target->unacked = 0;
+        ack_bulk_upload(receiver, &header, BULK_UPLOAD_COMPLETE, target->received, addr, port);
+    }
+    else if (target->unacked >= BULK_UPLOAD_ACK_BATCH)
+    {
+        target->unacked = 0;
+        ack_bulk_upload(receiver, &header, BULK_UPLOAD_RECEIVING, target->received, addr, port);
+    }
+}
+
+/**
+ * Initializes the receiver of bulk uploads. Uploads are rejected until their
+ * target is registered.
+ *
+ * @param[out] upload The bulk upload receiver to initialize.
+ * @param port The UDP port uploads are received on.
+ *
+ * @return Success or fail.
+ */
+result_t init_bulk_upload(bulk_upload_t *upload, const uint16_t port)
+{
+    AbortIfNot(upload, fail);
+
+    memset(upload, 0, sizeof(*upload));
+
+    AbortIfNot(init_udp(&upload->socket), fail);
+    AbortIfNot(bind_udp(&upload->socket, IP_ADDR_ANY, port, receive_bulk_upload), fail);
+    receiver = upload;
+
+    return success;
+}
+
+/**
+ * Registers the buffer that uploads of a target are written into. An upload
+ * of the target in progress is abandoned, and its sender starts over.
+ *
+ * @param upload The bulk upload receiver.
+ * @param target The number of the target.
+ * @param buffer The buffer, or NULL to reject uploads of the target.
+ * @param capacity The size of the buffer in bytes.
+ *
+ * @return Success or fail.
+ */
+result_t set_upload_target(bulk_upload_t *upload, const uint8_t target, void *buffer, const size_t capacity)
+{
+    AbortIfNot(upload, fail);
+    AbortIfNot(target < BULK_UPLOAD_MAX_TARGETS, fail);
+
+    bulk_upload_target_t *slot = &upload->targets[target];
+    memset(slot, 0, sizeof(*slot));
+    slot->buffer = buffer;
+    slot->capacity = (buffer)? capacity : 0;
+
+    return success;
+}
+
+/**
+ * Takes a completed upload of a target. The upload stays in the buffer of the
+ * target until another upload of it starts.
+ *
+ * @param upload The bulk upload receiver.
+ * @param target The number of the target.
+ * @param[out] len The length of the upload in bytes.
+ * @param[out] slot The slot of the target the upload is for, if not NULL.
+ *
+ * @return True if an upload was completed since it was last taken.
+ */
+bool take_bulk_upload(bulk_upload_t *upload, const uint8_t target, size_t *len, uint8_t *slot)
+{
+    if (!upload || !len || target >= BULK_UPLOAD_MAX_TARGETS || !upload->targets[target].complete)
+    {
+        return false;
+    }
+
+    upload->targets[target].complete = false;
+    *len = upload->targets[target].total;
+    if (slot)
+    {
+        *slot = upload->targets[target].slot;
+    }
+
+    return true;
+}
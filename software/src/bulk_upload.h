@@ -0,0 +1,162 @@
+#ifndef BULK_UPLOAD_H
+#define BULK_UPLOAD_H
+
+#include "types.h"
+#include "udp.h"
+
+/**
+ * The version of the bulk upload message layout.
+ */
+#define BULK_UPLOAD_VERSION 1
+
+/**
+ * The number of buffers that uploads can be written into.
+ */
+#define BULK_UPLOAD_MAX_TARGETS 4
+
+/**
+ * Defines the buffers of the firmware that uploads are written into.
+ */
+typedef enum bulk_upload_target_id_t
+{
+    /*
+     * The template of the matched filter, as floats.
+     */
+    UPLOAD_MATCHED_TEMPLATE = 0,
+
+    /*
+     * The biquad sections of the capture filter, as six floats each of b0,
+     * b1, b2, a0, a1, a2.
+     */
+    UPLOAD_FILTER_SECTIONS = 1,
+
+    /*
+     * A partial bitstream of the reconfigurable region, as a bitstream file
+     * or a binary. The slot of the upload is the number of the accelerator
+     * module it replaces.
+     */
+    UPLOAD_ACCELERATOR_MODULE = 2
+} bulk_upload_target_id_t;
+
+/**
+ * Defines the state of an upload reported by an acknowledgement.
+ */
+typedef enum bulk_upload_status_t
+{
+    /*
+     * The upload is received up to the acknowledged offset.
+     */
+    BULK_UPLOAD_RECEIVING = 0,
+
+    /*
+     * Every byte of the upload is received.
+     */
+    BULK_UPLOAD_COMPLETE = 1,
+
+    /*
+     * The upload is not accepted, because its target is not registered or
+     * it does not fit the target.
+     */
+    BULK_UPLOAD_REJECTED = 2
+} bulk_upload_status_t;
+
+/**
+ * Defines the header of a bulk upload datagram, which is followed by the
+ * bytes of the upload from its offset. All fields are little endian.
+ */
+typedef struct __attribute__((packed)) bulk_upload_header_t
+{
+    uint16_t version;
+    uint8_t target;
+
+    /*
+     * The slot of the target the upload is for, where a target holds several
+     * uploads, and zero otherwise.
+     */
+    uint8_t slot;
+
+    /*
+     * The number the sender gave the upload. A datagram of another number
+     * starts a new upload of the target.
+     */
+    uint32_t transfer;
+
+    /*
+     * The offset of the payload in the upload and the length of the upload,
+     * in bytes.
+     */
+    uint32_t offset;
+    uint32_t total;
+} bulk_upload_header_t;
+
+/**
+ * Defines the acknowledgement of a bulk upload, sent back to the sender.
+ */
+typedef struct __attribute__((packed)) bulk_upload_ack_t
+{
+    uint16_t version;
+    uint8_t target;
+    uint8_t status;
+    uint32_t transfer;
+
+    /*
+     * The number of bytes received in order from the start of the upload.
+     */
+    uint32_t received;
+} bulk_upload_ack_t;
+
+/**
+ * Defines a buffer that uploads are written into and the upload in progress.
+ */
+typedef struct bulk_upload_target_t
+{
+    uint8_t *buffer;
+    size_t capacity;
+
+    bool active;
+    uint32_t transfer;
+    uint8_t slot;
+    size_t total;
+    size_t received;
+
+    /*
+     * The datagrams accepted since the last acknowledgement.
+     */
+    uint32_t unacked;
+
+    /*
+     * Whether an upload is complete and not yet taken.
+     */
+    bool complete;
+} bulk_upload_target_t;
+
+/**
+ * Defines the receiver of bulk uploads.
+ *
+ * @note Each datagram is copied from its buffer chain straight to its offset
+ *       in the target and the chain is freed at once. Only datagrams that
+ *       continue the bytes received in order are kept, so that a sender
+ *       resumes from the acknowledged offset after a loss.
+ */
+typedef struct bulk_upload_t
+{
+    udp_socket_t socket;
+    bulk_upload_target_t targets[BULK_UPLOAD_MAX_TARGETS];
+
+    /*
+     * The datagrams accepted, received again, received ahead of a loss, and
+     * rejected.
+     */
+    uint32_t datagrams;
+    uint32_t duplicates;
+    uint32_t out_of_order;
+    uint32_t rejected;
+} bulk_upload_t;
+
+result_t init_bulk_upload(bulk_upload_t *upload, const uint16_t port);
+
+result_t set_upload_target(bulk_upload_t *upload, const uint8_t target, void *buffer, const size_t capacity);
+
+bool take_bulk_upload(bulk_upload_t *upload, const uint8_t target, size_t *len, uint8_t *slot);
+
+#endif
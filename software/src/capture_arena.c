@@ -0,0 +1,241 @@
+#include "capture_arena.h"
+
+#include "abort.h"
+#include "types.h"
+#include "xil_cache.h"
+#include "xil_mmu.h"
+#include "xpseudo_asm.h"
+#include "xreg_cortexa9.h"
+
+/**
+ * The bounds of the DDR left free after the program image and stacks, which
+ * are provided by the linker script.
+ */
+extern uint8_t __capture_arena_start[];
+extern uint8_t __capture_arena_end[];
+
+/**
+ * The bounds of the on-chip memory left free for capture buffers, which are
+ * provided by the linker script.
+ */
+extern uint8_t __ocm_arena_start[];
+extern uint8_t __ocm_arena_end[];
+
+/**
+ * Initializes an arena over the DDR left free by the program image.
+ *
+ * @param[out] arena The arena to initialize.
+ *
+ * @return Success or fail.
+ */
+result_t init_capture_arena(capture_arena_t *arena)
+{
+    AbortIfNot(arena, fail);
+    uint8_t *start = __capture_arena_start;
+    uint8_t *end = __capture_arena_end;
+    AbortIfNot(end > start, fail);
+
+    arena->base = start;
+    arena->size = end - start;
+    arena->used = 0;
+    arena->num_regions = 0;
+
+    return success;
+}
+
+/**
+ * Allocates a buffer from an arena.
+ *
+ * @note The arena lies beyond the sections that the startup code clears, so
+ *       a buffer holds whatever was left in it before the last reset, and
+ *       its user initializes what it reads.
+ *
+ * @param arena The arena to allocate from.
+ * @param bytes The size of the buffer in bytes.
+ *
+ * @return The buffer, or NULL if the arena is exhausted.
+ */
+void *capture_arena_alloc(capture_arena_t *arena, const size_t bytes)
+{
+    AbortIfNot(arena, NULL);
+    AbortIfNot(arena->base, NULL);
+
+    const size_t start = (arena->used + CAPTURE_ARENA_ALIGNMENT - 1) &
+            ~(CAPTURE_ARENA_ALIGNMENT - 1);
+    AbortIf(start > arena->size || bytes > arena->size - start, NULL);
+
+    arena->used = start + bytes;
+
+    return &arena->base[start];
+}
+
+/**
+ * Gets the translation table attributes of a kind of memory.
+ *
+ * @param memory The kind of memory.
+ *
+ * @return The section attributes.
+ */
+static uint32_t get_section_attributes(const capture_memory_t memory)
+{
+    switch (memory)
+    {
+        case CAPTURE_MEMORY_CACHEABLE:
+            return NORM_WB_CACHE & NON_SHAREABLE;
+        case CAPTURE_MEMORY_WRITE_COMBINING:
+            return NORM_NONCACHE;
+        case CAPTURE_MEMORY_NONCACHEABLE:
+            return DEVICE_MEMORY | EXECUTE_NEVER;
+        case CAPTURE_MEMORY_SHAREABLE:
+        default:
+            return NORM_WB_CACHE;
+    }
+}
+
+/**
+ * Maps whole sections of an arena with new attributes.
+ *
+ * @param base The first section.
+ * @param size The size of the sections in bytes.
+ * @param memory The kind of memory to map them as.
+ *
+ * @return None.
+ */
+static void map_sections(uint8_t *base, const size_t size, const capture_memory_t memory)
+{
+    /*
+     * Write back and discard any lines still held for the sections before
+     * their attributes change, so that no dirty line is later lost and no
+     * stale line is hit once they are cacheable again.
+     */
+    Xil_DCacheFlushRange((INTPTR)base, size);
+    for (size_t offset = 0; offset < size; offset += CAPTURE_ARENA_SECTION_SIZE)
+    {
+        Xil_SetTlbAttributes((INTPTR)&base[offset], get_section_attributes(memory));
+    }
+
+    /*
+     * The DSP core walks the same translation table, so its TLB is
+     * invalidated as well.
+     */
+    mtcp(XREG_CP15_INVAL_TLB_IS, 0);
+    dsb();
+    isb();
+}
+
+/**
+ * Initializes an arena over the free on-chip memory, which is mapped
+ * non-cacheable so that buffers the DMA engine writes into it need no cache
+ * maintenance.
+ *
+ * @note The high on-chip memory occupies a section of its own, which no other
+ *       data shares. Buffers of the arena keep its mapping when it is reset.
+ *
+ * @param[out] arena The arena to initialize.
+ *
+ * @return Success or fail.
+ */
+result_t init_ocm_capture_arena(capture_arena_t *arena)
+{
+    AbortIfNot(arena, fail);
+    uint8_t *start = __ocm_arena_start;
+    uint8_t *end = __ocm_arena_end;
+    AbortIfNot(end > start, fail);
+
+    arena->base = start;
+    arena->size = end - start;
+    arena->used = 0;
+    arena->num_regions = 0;
+    map_sections(start, arena->size, CAPTURE_MEMORY_WRITE_COMBINING);
+
+    return success;
+}
+
+/**
+ * Allocates a buffer from an arena in whole sections that are mapped with
+ * their own memory attributes.
+ *
+ * @param arena The arena to allocate from.
+ * @param bytes The size of the buffer in bytes.
+ * @param memory The kind of memory to map the buffer as.
+ *
+ * @return The buffer, or NULL if the arena is exhausted.
+ */
+void *capture_arena_alloc_mapped(capture_arena_t *arena,
+                                 const size_t bytes,
+                                 const capture_memory_t memory)
+{
+    AbortIfNot(arena, NULL);
+    AbortIfNot(arena->base, NULL);
+    AbortIfNot(arena->num_regions < CAPTURE_ARENA_MAX_REGIONS, NULL);
+
+    const uintptr_t base = (uintptr_t)arena->base;
+    const uintptr_t start = (base + arena->used + CAPTURE_ARENA_SECTION_SIZE - 1) &
+            ~(uintptr_t)(CAPTURE_ARENA_SECTION_SIZE - 1);
+    const size_t size = (bytes + CAPTURE_ARENA_SECTION_SIZE - 1) &
+            ~(size_t)(CAPTURE_ARENA_SECTION_SIZE - 1);
+    AbortIf(start - base > arena->size || size > arena->size - (start - base), NULL);
+
+    capture_region_t *region = &arena->regions[arena->num_regions++];
+    region->base = (uint8_t *)start;
+    region->size = size;
+    region->memory = memory;
+    if (memory != CAPTURE_MEMORY_SHAREABLE)
+    {
+        map_sections(region->base, region->size, memory);
+    }
+
+    arena->used = start - base + size;
+
+    return region->base;
+}
+
+/**
+ * Gets the name of a kind of memory.
+ *
+ * @param memory The kind of memory.
+ *
+ * @return The name.
+ */
+const char *capture_memory_name(const capture_memory_t memory)
+{
+    switch (memory)
+    {
+        case CAPTURE_MEMORY_CACHEABLE:
+            return "cacheable";
+        case CAPTURE_MEMORY_WRITE_COMBINING:
+            return "write-combining";
+        case CAPTURE_MEMORY_NONCACHEABLE:
+            return "non-cacheable";
+        case CAPTURE_MEMORY_SHAREABLE:
+        default:
+            return "shareable";
+    }
+}
+
+/**
+ * Releases every buffer allocated from an arena.
+ *
+ * @note No buffer may be in use by the DMA engine or the DSP core.
+ *
+ * @param arena The arena to reset.
+ *
+ * @return None.
+ */
+void reset_capture_arena(capture_arena_t *arena)
+{
+    /*
+     * Return mapped sections to the default shareable write-back mapping.
+     */
+    for (size_t i = 0; i < arena->num_regions; ++i)
+    {
+        const capture_region_t *region = &arena->regions[i];
+        if (region->memory != CAPTURE_MEMORY_SHAREABLE)
+        {
+            map_sections(region->base, region->size, CAPTURE_MEMORY_SHAREABLE);
+        }
+    }
+
+    arena->num_regions = 0;
+    arena->used = 0;
+}
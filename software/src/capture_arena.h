@@ -0,0 +1,106 @@
+#ifndef CAPTURE_ARENA_H
+#define CAPTURE_ARENA_H
+
+#include "types.h"
+
+/**
+ * The alignment of every allocation, which keeps buffers handed to the DMA
+ * engine from sharing cache lines.
+ */
+#define CAPTURE_ARENA_ALIGNMENT 64
+
+/**
+ * Places a buffer in the section that the startup code does not clear, so
+ * that it does not add to the time of every boot and reset. Only scratch that
+ * is always written before it is read may be placed there.
+ */
+#define NO_INIT __attribute__((section(".noinit")))
+
+/**
+ * The granularity at which the translation table sets memory attributes.
+ */
+#define CAPTURE_ARENA_SECTION_SIZE 0x100000
+
+/**
+ * The most buffers that may be mapped with their own attributes between
+ * resets.
+ */
+#define CAPTURE_ARENA_MAX_REGIONS 4
+
+/**
+ * Defines the memory attributes that a buffer of the arena may be mapped
+ * with.
+ */
+typedef enum capture_memory_t
+{
+    /*
+     * Normal write-back memory kept coherent between both cores, as the
+     * default translation table maps all of DDR. Buffers the DSP core reads
+     * or that the DMA engine writes through the accelerator coherency port
+     * must be shareable.
+     */
+    CAPTURE_MEMORY_SHAREABLE,
+
+    /*
+     * Normal write-back memory that only CPU0 touches, whose lines the snoop
+     * control unit does not need to track.
+     */
+    CAPTURE_MEMORY_CACHEABLE,
+
+    /*
+     * Normal non-cacheable memory. Writes are merged in the store buffer and
+     * reads bypass the caches, which suits buffers that are filled by DMA or
+     * written once by the processor and then read by a DMA engine.
+     */
+    CAPTURE_MEMORY_WRITE_COMBINING,
+
+    /*
+     * Device memory, which every access reaches in program order and without
+     * merging. Only aligned accesses may be made to it.
+     */
+    CAPTURE_MEMORY_NONCACHEABLE
+} capture_memory_t;
+
+/**
+ * Defines a buffer of an arena that is mapped with its own attributes.
+ */
+typedef struct capture_region_t
+{
+    uint8_t *base;
+    size_t size;
+    capture_memory_t memory;
+} capture_region_t;
+
+/**
+ * Defines a region of memory from which capture buffers are carved. Buffers
+ * are released together by resetting the arena.
+ */
+typedef struct capture_arena_t
+{
+    uint8_t *base;
+    size_t size;
+    size_t used;
+
+    /*
+     * The sections that have been mapped with attributes other than the
+     * default.
+     */
+    capture_region_t regions[CAPTURE_ARENA_MAX_REGIONS];
+    size_t num_regions;
+} capture_arena_t;
+
+result_t init_capture_arena(capture_arena_t *arena);
+
+result_t init_ocm_capture_arena(capture_arena_t *arena);
+
+void *capture_arena_alloc(capture_arena_t *arena, const size_t bytes);
+
+void *capture_arena_alloc_mapped(capture_arena_t *arena,
+                                 const size_t bytes,
+                                 const capture_memory_t memory);
+
+const char *capture_memory_name(const capture_memory_t memory);
+
+void reset_capture_arena(capture_arena_t *arena);
+
+#endif
@@ -0,0 +1,28 @@
+#include "capture_format.h"
+
+#include <string.h>
+
+_Static_assert(sizeof(capture_file_header_t) == CAPTURE_FILE_HEADER_BYTES, "Capture file header size");
+
+/**
+ * Initializes a capture file header with the defaults of the HydroZynq.
+ *
+ * @param[out] header The header to initialize.
+ *
+ * @return None.
+ */
+void init_capture_file_header(capture_file_header_t *header)
+{
+    memset(header, 0, sizeof(*header));
+    header->magic = CAPTURE_FILE_MAGIC;
+    header->version = CAPTURE_FILE_VERSION;
+    header->header_bytes = CAPTURE_FILE_HEADER_BYTES;
+    header->decimation = 1;
+    header->channels = 4;
+    header->sample_bytes = sizeof(sample_t);
+    for (uint8_t i = 0; i < 4; ++i)
+    {
+        header->channel_map[i] = i;
+    }
+    header->index_offset = CAPTURE_FILE_HEADER_BYTES;
+}
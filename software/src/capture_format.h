@@ -0,0 +1,98 @@
+#ifndef CAPTURE_FORMAT_H
+#define CAPTURE_FORMAT_H
+
+#include "types.h"
+
+/**
+ * Identifies a capture file. It reads "HZCP" in the first four bytes.
+ */
+#define CAPTURE_FILE_MAGIC 0x50435A48
+
+#define CAPTURE_FILE_VERSION 1
+
+/**
+ * The size of the file header. The samples start at this offset, which is
+ * aligned so that they may be mapped directly.
+ */
+#define CAPTURE_FILE_HEADER_BYTES 256
+
+/**
+ * Defines the header at the start of a capture file. Every field is little
+ * endian.
+ *
+ * @note The file holds the header, the samples of every ping back to back
+ *       as interleaved int16 values of channels A to D, and then the index
+ *       of the pings. The samples form one array, so a ping is a slice of it
+ *       given by its index entry.
+ */
+typedef struct __attribute__((packed)) capture_file_header_t
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_bytes;
+
+    uint32_t sampling_frequency;
+    uint32_t clk_div;
+    uint32_t decimation;
+    uint16_t channels;
+    uint16_t sample_bytes;
+
+    /*
+     * The hydrophone connected to each ADC channel.
+     */
+    uint8_t channel_map[4];
+
+    /*
+     * The operating parameters in effect while the pings were captured.
+     * Durations are in microseconds.
+     */
+    int32_t ping_threshold;
+    uint32_t ping_frequency;
+    uint32_t noise_threshold;
+    uint32_t pre_ping_duration_us;
+    uint32_t post_ping_duration_us;
+    uint32_t num_pingers;
+    uint32_t pinger_frequencies[MAX_PINGERS];
+
+    /*
+     * The total number of samples of every ping.
+     */
+    uint64_t total_samples;
+
+    /*
+     * The offset and number of capture_file_ping_t entries of the index.
+     */
+    uint64_t index_offset;
+    uint32_t num_pings;
+
+    uint8_t reserved[CAPTURE_FILE_HEADER_BYTES - 88];
+} capture_file_header_t;
+
+/**
+ * Defines an entry of the ping index.
+ */
+typedef struct __attribute__((packed)) capture_file_ping_t
+{
+    /*
+     * The index of the first sample of the ping within the sample array.
+     */
+    uint64_t first_sample;
+    uint32_t sample_count;
+    uint32_t transfer_id;
+
+    /*
+     * The hardware timestamp of the first sample in CPU ticks, or zero if
+     * it is not known.
+     */
+    uint64_t hw_timestamp;
+
+    /*
+     * The host time at which the ping was received in nanoseconds since the
+     * Unix epoch.
+     */
+    uint64_t host_time_ns;
+} capture_file_ping_t;
+
+void init_capture_file_header(capture_file_header_t *header);
+
+#endif
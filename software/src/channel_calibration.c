@@ -0,0 +1,193 @@
+#include "channel_calibration.h"
+
+#include "abort.h"
+#include "lag_tracker.h"
+#include "system_params.h"
+#include "types.h"
+
+#include <math.h>
+#include <string.h>
+
+#define PI 3.14159265358979323846
+
+/**
+ * Initializes an idle calibration run.
+ *
+ * @param[out] run The run to initialize.
+ *
+ * @return Success or fail.
+ */
+result_t init_calibration_run(calibration_run_t *run)
+{
+    AbortIfNot(run, fail);
+
+    memset(run, 0, sizeof(*run));
+
+    return success;
+}
+
+/**
+ * Starts a calibration run, discarding any that is in progress.
+ *
+ * @note A plane wave from the direction u reaches the hydrophone at p
+ *       earlier than the reference by p.u / c, which is the delay that
+ *       solve_bearing() inverts.
+ *
+ * @param[out] run The run to start.
+ * @param pings The confident pings to average.
+ * @param array The geometry of the array, or NULL for a signal that reaches
+ *        every channel at once, such as one injected at the front ends.
+ * @param bearing_deg The bearing of the source.
+ * @param elevation_deg The elevation of the source.
+ *
+ * @return Success or fail.
+ */
+result_t start_calibration(calibration_run_t *run,
+                           const uint32_t pings,
+                           const hydrophone_array_t *array,
+                           const float bearing_deg,
+                           const float elevation_deg)
+{
+    AbortIfNot(run, fail);
+    AbortIfNot(pings, fail);
+    AbortIfNot(pings <= CALIBRATION_MAX_PINGS, fail);
+
+    memset(run, 0, sizeof(*run));
+    if (array)
+    {
+        AbortIfNot(array->speed_of_sound > 0, fail);
+
+        const double bearing = bearing_deg * PI / 180;
+        const double elevation = elevation_deg * PI / 180;
+        const double u[3] = {cos(elevation) * cos(bearing),
+                             cos(elevation) * sin(bearing),
+                             sin(elevation)};
+        for (size_t k = 0; k < 3; ++k)
+        {
+            double path = 0;
+            for (size_t i = 0; i < 3; ++i)
+            {
+                path += array->positions[k][i] * u[i];
+            }
+
+            run->expected_ns[k] = path / array->speed_of_sound * 1e9;
+        }
+    }
+
+    run->target_pings = pings;
+    run->active = true;
+
+    return success;
+}
+
+/**
+ * Adds the uncalibrated result of a ping to a calibration run. Pings that
+ * are not confident are counted but not averaged, since a sidelobe would
+ * bias the delays.
+ *
+ * @param run The run to add to.
+ * @param result The result of the ping, measured without calibration.
+ * @param[out] complete Set true once the run has averaged its pings.
+ *
+ * @return Success or fail.
+ */
+result_t add_calibration_ping(calibration_run_t *run, const correlation_result_t *result, bool *complete)
+{
+    AbortIfNot(run, fail);
+    AbortIfNot(result, fail);
+    AbortIfNot(complete, fail);
+
+    *complete = false;
+    AbortIfNot(run->active, fail);
+
+    if (!lag_result_confident(result))
+    {
+        run->rejected++;
+        return success;
+    }
+
+    for (size_t i = 0; i < 3; ++i)
+    {
+        const double delay = result->channel_delay_ns[i];
+        run->delay_sum_ns[i] += delay;
+        run->delay_square_sum_ns2[i] += delay * delay;
+    }
+
+    for (size_t k = 0; k < 4; ++k)
+    {
+        run->peak_sum[k] += result->peak_amplitude[k];
+    }
+
+    run->pings++;
+    *complete = (run->pings >= run->target_pings)? true : false;
+
+    return success;
+}
+
+/**
+ * Ends a calibration run and finds the calibration that it measured. The
+ * skew of each channel is its mean delay less the expected delay, and its
+ * gain scales its mean peak amplitude to the reference's.
+ *
+ * @param run The run to finish, which is idle afterwards.
+ * @param[out] calibration The measured calibration, which is only written
+ *             if the run succeeded.
+ *
+ * @return Success, or fail if the run averaged no pings or measured a
+ *         calibration beyond the limits.
+ */
+result_t finish_calibration(calibration_run_t *run, channel_calibration_t *calibration)
+{
+    AbortIfNot(run, fail);
+    AbortIfNot(calibration, fail);
+
+    const bool active = run->active;
+    run->active = false;
+    AbortIfNot(active, fail);
+    AbortIfNot(run->pings, fail);
+
+    channel_calibration_t measured;
+    init_channel_calibration(&measured);
+    for (size_t i = 0; i < 3; ++i)
+    {
+        const double skew = run->delay_sum_ns[i] / run->pings - run->expected_ns[i];
+        AbortIf(fabs(skew) > CALIBRATION_MAX_SKEW_NS, fail);
+        measured.delay_ns[i + 1] = skew;
+    }
+
+    AbortIfNot(run->peak_sum[0] > 0, fail);
+    for (size_t k = 1; k < 4; ++k)
+    {
+        AbortIfNot(run->peak_sum[k] > 0, fail);
+
+        const double gain = run->peak_sum[0] / run->peak_sum[k];
+        AbortIfNot(gain * CALIBRATION_MAX_GAIN >= 1 && gain <= CALIBRATION_MAX_GAIN, fail);
+        measured.gain[k] = gain;
+    }
+
+    *calibration = measured;
+
+    return success;
+}
+
+/**
+ * Finds the standard deviation of the delays of a channel in a calibration
+ * run, which bounds how well its skew is known.
+ *
+ * @param run The run.
+ * @param channel The channel, where 0 is channel A.
+ *
+ * @return The standard deviation in nanoseconds.
+ */
+float calibration_spread_ns(const calibration_run_t *run, const size_t channel)
+{
+    if (!run->pings || channel >= 3)
+    {
+        return 0;
+    }
+
+    const double mean = run->delay_sum_ns[channel] / run->pings;
+    const double variance = run->delay_square_sum_ns2[channel] / run->pings - mean * mean;
+
+    return (variance > 0)? sqrt(variance) : 0;
+}
@@ -0,0 +1,49 @@
+#ifndef CHANNEL_CALIBRATION_H
+#define CHANNEL_CALIBRATION_H
+
+#include "bearing.h"
+#include "correlation_util.h"
+#include "types.h"
+
+/**
+ * Defines a calibration run, which averages the delays and peak amplitudes
+ * of confident pings from a source at a known direction and compares them
+ * with those that the geometry of the array predicts.
+ */
+typedef struct calibration_run_t
+{
+    bool active;
+    uint32_t target_pings;
+
+    /*
+     * The delays of channels A, B, and C that the direction of the source
+     * gives, which are zero for a signal common to every channel.
+     */
+    double expected_ns[3];
+
+    /*
+     * The pings averaged and rejected, and the sums of their delays, squared
+     * delays, and peak amplitudes.
+     */
+    uint32_t pings;
+    uint32_t rejected;
+    double delay_sum_ns[3];
+    double delay_square_sum_ns2[3];
+    double peak_sum[4];
+} calibration_run_t;
+
+result_t init_calibration_run(calibration_run_t *run);
+
+result_t start_calibration(calibration_run_t *run,
+                           const uint32_t pings,
+                           const hydrophone_array_t *array,
+                           const float bearing_deg,
+                           const float elevation_deg);
+
+result_t add_calibration_ping(calibration_run_t *run, const correlation_result_t *result, bool *complete);
+
+result_t finish_calibration(calibration_run_t *run, channel_calibration_t *calibration);
+
+float calibration_spread_ns(const calibration_run_t *run, const size_t channel);
+
+#endif
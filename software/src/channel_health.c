@@ -0,0 +1,200 @@
+#include "channel_health.h"
+
+#include "abort.h"
+#include "db.h"
+#include "system_params.h"
+#include "types.h"
+
+#include <string.h>
+
+/**
+ * Initializes a channel health monitor with every channel healthy.
+ *
+ * @param[out] health The monitor to initialize.
+ *
+ * @return Success or fail.
+ */
+result_t init_channel_health(channel_health_t *health)
+{
+    AbortIfNot(health, fail);
+
+    memset(health, 0, sizeof(*health));
+
+    return success;
+}
+
+/**
+ * Finds the median RMS of the channels of a capture.
+ *
+ * @param stats The statistics of the capture.
+ *
+ * @return The mean of the two middle RMS values.
+ */
+static float median_rms(const channel_stats_t *stats)
+{
+    float rms[4];
+    memcpy(rms, stats->rms, sizeof(rms));
+    for (size_t i = 1; i < 4; ++i)
+    {
+        for (size_t j = i; j > 0 && rms[j - 1] > rms[j]; --j)
+        {
+            const float swap = rms[j];
+            rms[j] = rms[j - 1];
+            rms[j - 1] = swap;
+        }
+    }
+
+    return (rms[1] + rms[2]) / 2;
+}
+
+/**
+ * Finds the faults of a channel in a capture.
+ *
+ * @param stats The statistics of the capture.
+ * @param k The channel.
+ * @param median The median RMS of the channels.
+ *
+ * @return The faults of the channel.
+ */
+static uint8_t judge_channel(const channel_stats_t *stats, const size_t k, const float median)
+{
+    uint8_t faults = 0;
+    const float rms = stats->rms[k];
+    if (rms < CHANNEL_HEALTH_STUCK_RMS)
+    {
+        faults |= CHANNEL_STUCK;
+    }
+    else if (median >= CHANNEL_HEALTH_STUCK_RMS)
+    {
+        /*
+         * The other channels hear the same water, so a channel is only dead
+         * or noisy relative to them.
+         */
+        if (rms * 100 < median * CHANNEL_HEALTH_DEAD_PERCENT)
+        {
+            faults |= CHANNEL_DEAD;
+        }
+        else if (rms * 100 > median * CHANNEL_HEALTH_NOISY_PERCENT)
+        {
+            faults |= CHANNEL_NOISY;
+        }
+    }
+
+    if ((uint64_t)stats->clipped_samples[k] * 1000000 > (uint64_t)stats->count * CHANNEL_HEALTH_SATURATED_PPM)
+    {
+        faults |= CHANNEL_SATURATED;
+    }
+
+    return faults;
+}
+
+/**
+ * Judges each channel from the statistics of a capture. A channel is flagged
+ * once it has been faulty for CHANNEL_HEALTH_FLAG_CAPTURES captures in a row,
+ * and cleared once it has been healthy for CHANNEL_HEALTH_CLEAR_CAPTURES.
+ *
+ * @param health The monitor to update.
+ * @param stats The statistics of the capture. Captures that were not
+ *        measured, which have no samples, are ignored.
+ *
+ * @return Success or fail.
+ */
+result_t update_channel_health(channel_health_t *health, const channel_stats_t *stats)
+{
+    AbortIfNot(health, fail);
+    AbortIfNot(stats, fail);
+
+    if (!stats->count)
+    {
+        return success;
+    }
+
+    health->latest = *stats;
+    health->captures++;
+
+    const float median = median_rms(stats);
+    for (size_t k = 0; k < 4; ++k)
+    {
+        const uint8_t faults = judge_channel(stats, k, median);
+        health->observed[k] = faults;
+        if (faults)
+        {
+            health->faulty_captures[k]++;
+            health->healthy_captures[k] = 0;
+            if (health->faulty_captures[k] >= CHANNEL_HEALTH_FLAG_CAPTURES && health->flags[k] != faults)
+            {
+                if (!health->flags[k])
+                {
+                    health->faults[k]++;
+                }
+                health->flags[k] = faults;
+                dblog(LOG_WARN, "Channel %c is unhealthy (0x%x): RMS %d, offset %d, %u clipped samples.\n",
+                        'A' + (int)k,
+                        faults,
+                        (int)stats->rms[k],
+                        stats->offset[k],
+                        stats->clipped_samples[k]);
+            }
+        }
+        else
+        {
+            health->healthy_captures[k]++;
+            health->faulty_captures[k] = 0;
+            if (health->flags[k] && health->healthy_captures[k] >= CHANNEL_HEALTH_CLEAR_CAPTURES)
+            {
+                health->flags[k] = 0;
+                dbprintf("Channel %c is healthy again.\n", 'A' + (int)k);
+            }
+        }
+    }
+
+    return success;
+}
+
+/**
+ * Gets the channels that are flagged with any fault.
+ *
+ * @param health The monitor.
+ *
+ * @return A mask with bit k set if channel k is flagged.
+ */
+uint8_t unhealthy_channels(const channel_health_t *health)
+{
+    uint8_t mask = 0;
+    for (size_t k = 0; k < 4; ++k)
+    {
+        if (health->flags[k])
+        {
+            mask |= 1 << k;
+        }
+    }
+
+    return mask;
+}
+
+/**
+ * Selects the channel that pings are located and correlated against.
+ *
+ * @param health The monitor.
+ * @param preferred The configured reference channel.
+ *
+ * @return The configured reference if it is healthy, otherwise the first
+ *         healthy channel, or the configured one if none is healthy.
+ */
+uint8_t select_reference_channel(const channel_health_t *health, const uint8_t preferred)
+{
+    if (preferred >= 4 || !health->flags[preferred])
+    {
+        return preferred;
+    }
+
+    for (uint8_t k = 0; k < 4; ++k)
+    {
+        if (!health->flags[k])
+        {
+            return k;
+        }
+    }
+
+    return preferred;
+}
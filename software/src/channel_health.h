@@ -0,0 +1,54 @@
+#ifndef CHANNEL_HEALTH_H
+#define CHANNEL_HEALTH_H
+
+#include "types.h"
+
+/**
+ * The faults that a channel may be flagged with.
+ */
+#define CHANNEL_STUCK 0x01
+#define CHANNEL_DEAD 0x02
+#define CHANNEL_SATURATED 0x04
+#define CHANNEL_NOISY 0x08
+
+/**
+ * Defines the monitor of the hydrophone channels, which judges each channel
+ * from the statistics that normalization measures of every capture.
+ */
+typedef struct channel_health_t
+{
+    /*
+     * The faults that each channel is flagged with, and those seen in the
+     * latest capture.
+     */
+    uint8_t flags[4];
+    uint8_t observed[4];
+
+    /*
+     * The consecutive captures in which each channel was faulty or healthy.
+     */
+    uint32_t faulty_captures[4];
+    uint32_t healthy_captures[4];
+
+    /*
+     * The times each channel has been flagged, and the captures judged, since
+     * boot.
+     */
+    uint32_t faults[4];
+    uint32_t captures;
+
+    /*
+     * The statistics of the latest capture.
+     */
+    channel_stats_t latest;
+} channel_health_t;
+
+result_t init_channel_health(channel_health_t *health);
+
+result_t update_channel_health(channel_health_t *health, const channel_stats_t *stats);
+
+uint8_t unhealthy_channels(const channel_health_t *health);
+
+uint8_t select_reference_channel(const channel_health_t *health, const uint8_t preferred);
+
+#endif
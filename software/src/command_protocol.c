@@ -0,0 +1,165 @@
+#include "command_protocol.h"
+
+#include "abort.h"
+
+#include <string.h>
+
+/**
+ * Checks if a datagram holds a binary command.
+ *
+ * @param data The datagram.
+ * @param len The length of the datagram.
+ *
+ * @return True if the datagram starts with the binary command magic.
+ */
+bool is_binary_command(const void *data, const size_t len)
+{
+    uint16_t magic = 0;
+    if (len < sizeof(magic))
+    {
+        return false;
+    }
+
+    memcpy(&magic, data, sizeof(magic));
+
+    return (magic == COMMAND_MAGIC)? true : false;
+}
+
+/**
+ * Decodes the header of a binary command.
+ *
+ * @param data The command.
+ * @param len The length of the command.
+ * @param[out] header The decoded header.
+ *
+ * @return Success or fail.
+ */
+result_t parse_command_header(const void *data, const size_t len, command_header_t *header)
+{
+    AbortIfNot(data, fail);
+    AbortIfNot(header, fail);
+    AbortIfNot(len >= sizeof(*header), fail);
+
+    memcpy(header, data, sizeof(*header));
+    AbortIfNot(header->magic == COMMAND_MAGIC, fail);
+    AbortIfNot(header->version == COMMAND_VERSION, fail);
+    AbortIfNot(sizeof(*header) + header->length <= len, fail);
+
+    return success;
+}
+
+/**
+ * Decodes the next parameter of a command.
+ *
+ * @param data The encoded parameters.
+ * @param len The length of the encoded parameters.
+ * @param[in,out] offset The offset of the next parameter, which is advanced
+ *                past it.
+ * @param[out] tlv The decoded parameter.
+ * @param[out] found Specified true if a parameter was decoded, or false if
+ *             none remain.
+ *
+ * @return Success or fail if a parameter is truncated.
+ */
+result_t next_command_tlv(const uint8_t *data,
+                          const size_t len,
+                          size_t *offset,
+                          command_tlv_t *tlv,
+                          bool *found)
+{
+    AbortIfNot(offset, fail);
+    AbortIfNot(tlv, fail);
+    AbortIfNot(found, fail);
+
+    *found = false;
+    if (*offset >= len)
+    {
+        return success;
+    }
+
+    command_tlv_header_t header;
+    AbortIfNot(*offset + sizeof(header) <= len, fail);
+    memcpy(&header, &data[*offset], sizeof(header));
+    AbortIfNot(*offset + sizeof(header) + header.length <= len, fail);
+
+    tlv->type = header.type;
+    tlv->length = header.length;
+    tlv->value = &data[*offset + sizeof(header)];
+    *offset += sizeof(header) + header.length;
+    *found = true;
+
+    return success;
+}
+
+/**
+ * Reads a 32-bit parameter value.
+ *
+ * @param tlv The parameter.
+ * @param[out] value The value.
+ *
+ * @return Success or fail if the parameter is not four bytes.
+ */
+result_t read_tlv_u32(const command_tlv_t *tlv, uint32_t *value)
+{
+    AbortIfNot(tlv, fail);
+    AbortIfNot(value, fail);
+    AbortIfNot(tlv->length == sizeof(*value), fail);
+
+    memcpy(value, tlv->value, sizeof(*value));
+
+    return success;
+}
+
+/**
+ * Reads a boolean parameter value, which is encoded in one byte.
+ *
+ * @param tlv The parameter.
+ * @param[out] value The value.
+ *
+ * @return Success or fail if the parameter is not one byte.
+ */
+result_t read_tlv_bool(const command_tlv_t *tlv, bool *value)
+{
+    AbortIfNot(tlv, fail);
+    AbortIfNot(value, fail);
+    AbortIfNot(tlv->length == 1, fail);
+
+    *value = (tlv->value[0])? true : false;
+
+    return success;
+}
+
+/**
+ * Encodes a parameter.
+ *
+ * @param data The buffer to encode into.
+ * @param capacity The size of the buffer.
+ * @param[in,out] len The number of bytes in the buffer, which is advanced
+ *                past the parameter.
+ * @param type The command_param_t of the parameter.
+ * @param value The value of the parameter.
+ * @param value_len The length of the value.
+ *
+ * @return Success or fail if the buffer is full.
+ */
+result_t append_command_tlv(uint8_t *data,
+                            const size_t capacity,
+                            size_t *len,
+                            const uint16_t type,
+                            const void *value,
+                            const uint16_t value_len)
+{
+    AbortIfNot(data, fail);
+    AbortIfNot(len, fail);
+
+    command_tlv_header_t header;
+    header.type = type;
+    header.length = value_len;
+    AbortIfNot(*len + sizeof(header) + value_len <= capacity, fail);
+
+    memcpy(&data[*len], &header, sizeof(header));
+    memcpy(&data[*len + sizeof(header)], value, value_len);
+    *len += sizeof(header) + value_len;
+
+    return success;
+}
@@ -0,0 +1,208 @@
+#ifndef COMMAND_PROTOCOL_H
+#define COMMAND_PROTOCOL_H
+
+#include "types.h"
+
+/**
+ * Identifies a binary command. The first byte is not printable, so text
+ * commands are never mistaken for binary ones.
+ */
+#define COMMAND_MAGIC 0xC0DE
+
+/**
+ * The version of the binary command layout. This must be incremented
+ * whenever the layout changes.
+ */
+#define COMMAND_VERSION 1
+
+/**
+ * Defines the types of binary command datagrams.
+ */
+typedef enum command_type_t
+{
+    /*
+     * Sets every parameter that it carries, or none of them. A request
+     * without parameters only reads the configuration.
+     */
+    COMMAND_SET = 1,
+
+    /*
+     * The reply to a request, which carries every parameter as applied.
+     */
+    COMMAND_ACK = 2,
+
+    /*
+     * A clock synchronization request, which carries a command_time_sync_t
+     * instead of parameters and is answered as soon as it is received.
+     */
+    COMMAND_TIME_SYNC = 3,
+    COMMAND_TIME_SYNC_REPLY = 4
+} command_type_t;
+
+/**
+ * Defines the outcome of a binary command.
+ */
+typedef enum command_status_t
+{
+    COMMAND_OK = 0,
+    COMMAND_MALFORMED = 1,
+    COMMAND_UNKNOWN_PARAM = 2,
+    COMMAND_INVALID_VALUE = 3,
+
+    /*
+     * The request was made against a parameter set that has since changed.
+     */
+    COMMAND_STALE = 4
+} command_status_t;
+
+/**
+ * Defines the parameters that binary commands can set.
+ */
+typedef enum command_param_t
+{
+    PARAM_THRESHOLD = 1,
+    PARAM_PING_FREQUENCY_HZ = 2,
+    PARAM_PINGER_FREQUENCIES_HZ = 3,
+    PARAM_FILTER = 4,
+    PARAM_PLANAR = 5,
+    PARAM_HW_TRIGGER = 6,
+    PARAM_HW_CORRELATE = 7,
+    PARAM_REFERENCE = 8,
+    PARAM_ALL_PAIRS = 9,
+    PARAM_TRIGGER_ANY = 10,
+    PARAM_WINDOW_NORMALIZE = 11,
+    PARAM_NOISE_THRESHOLD = 12,
+    PARAM_PRE_PING_DURATION_US = 13,
+    PARAM_POST_PING_DURATION_US = 14,
+    PARAM_SAMPLES_PER_PACKET = 15,
+    PARAM_DECIMATION = 16,
+    PARAM_XCORR_STREAM = 17,
+    PARAM_DEBUG = 18,
+    PARAM_PREVIEW = 19,
+    PARAM_RECORD = 20,
+    PARAM_MIN_PING_QUALITY = 21,
+    PARAM_PHAT = 22,
+    PARAM_ENVELOPE_ONSET = 23,
+    PARAM_AVERAGE_PINGS = 24,
+    PARAM_AVERAGE_EXPONENTIAL = 25,
+    PARAM_COARSE_SEARCH = 26,
+    PARAM_TRACK_LAGS = 27,
+    PARAM_FILTER_SECTIONS = 28,
+    PARAM_SAMPLE_RATE_HZ = 29,
+    PARAM_CFAR_THRESHOLD = 30,
+    PARAM_MATCHED_THRESHOLD = 31,
+    PARAM_DSP_DECIMATION = 32,
+    PARAM_HW_ENVELOPE = 33,
+
+    /*
+     * The name of a processing profile, not terminated, whose parameters are
+     * set in its place. It is never acknowledged.
+     */
+    PARAM_PROFILE = 34,
+
+    PARAM_FAST_TDOA = 35,
+    PARAM_LAZY_FILTER = 36,
+    PARAM_DUAL_RATE = 37,
+    PARAM_MASKED_SYNC = 38,
+    PARAM_CONTINUOUS_CAPTURE = 39,
+    PARAM_DMA_IRQ_THRESHOLD = 40,
+    PARAM_DMA_IRQ_DELAY_US = 41,
+    PARAM_ACCELERATOR_MODULE = 42
+} command_param_t;
+
+/**
+ * Defines the header of a binary command and of its acknowledgement. The
+ * header is followed by length bytes of parameters, each encoded as a type,
+ * a length, and a value. All fields are little endian.
+ */
+typedef struct __attribute__((packed)) command_header_t
+{
+    uint16_t magic;
+    uint8_t version;
+    uint8_t type;
+
+    /*
+     * Chosen by the sender and returned in the acknowledgement.
+     */
+    uint32_t sequence;
+
+    /*
+     * In a request, the parameter set version that the request was made
+     * against, or zero to apply it unconditionally. In an acknowledgement,
+     * the version after the request was handled.
+     */
+    uint32_t param_set_version;
+
+    /*
+     * The command_status_t of the request and, if it failed, the parameter
+     * that caused the failure.
+     */
+    uint16_t status;
+    uint16_t error_param;
+
+    uint16_t length;
+    uint16_t reserved;
+} command_header_t;
+
+/**
+ * Defines the payload of a clock synchronization request and its reply. The
+ * host sets its transmit time and the board echoes it with its own receive
+ * and transmit times, from which the host finds the offset between the
+ * clocks as NTP does.
+ */
+typedef struct __attribute__((packed)) command_time_sync_t
+{
+    /*
+     * The host time the request was sent at, in the host's units.
+     */
+    uint64_t host_transmit_time;
+
+    /*
+     * The board times the request was received and the reply sent at, in
+     * microseconds since boot.
+     */
+    uint64_t board_receive_us;
+    uint64_t board_transmit_us;
+} command_time_sync_t;
+
+/**
+ * Defines the header of an encoded parameter.
+ */
+typedef struct __attribute__((packed)) command_tlv_header_t
+{
+    uint16_t type;
+    uint16_t length;
+} command_tlv_header_t;
+
+/**
+ * Defines a decoded parameter, whose value points into the command.
+ */
+typedef struct command_tlv_t
+{
+    uint16_t type;
+    uint16_t length;
+    const uint8_t *value;
+} command_tlv_t;
+
+bool is_binary_command(const void *data, const size_t len);
+
+result_t parse_command_header(const void *data, const size_t len, command_header_t *header);
+
+result_t next_command_tlv(const uint8_t *data,
+                          const size_t len,
+                          size_t *offset,
+                          command_tlv_t *tlv,
+                          bool *found);
+
+result_t read_tlv_u32(const command_tlv_t *tlv, uint32_t *value);
+
+result_t read_tlv_bool(const command_tlv_t *tlv, bool *value);
+
+result_t append_command_tlv(uint8_t *data,
+                            const size_t capacity,
+                            size_t *len,
+                            const uint16_t type,
+                            const void *value,
+                            const uint16_t value_len);
+
+#endif
@@ -0,0 +1,421 @@
+#include "copy_engine.h"
+
+#include "abort.h"
+#include "cycle_counter.h"
+#include "system.h"
+#include "system_params.h"
+#include "time_util.h"
+#include "trace.h"
+#include "types.h"
+#include "xil_cache.h"
+#include "xparameters.h"
+#include "xparameters_ps.h"
+#include "xstatus.h"
+
+#include <string.h>
+
+/**
+ * The width of the controller's AXI master in bytes, which is the largest
+ * beat of a burst, and the most beats in a burst.
+ */
+#define COPY_BURST_SIZE 8
+#define COPY_BURST_LEN 16
+
+/**
+ * The done interrupt of each channel and the driver's handler for it.
+ */
+static const uint32_t done_interrupts[COPY_ENGINE_CHANNELS] = {
+    XPAR_XDMAPS_0_DONE_INTR_0,
+    XPAR_XDMAPS_0_DONE_INTR_1,
+    XPAR_XDMAPS_0_DONE_INTR_2,
+    XPAR_XDMAPS_0_DONE_INTR_3,
+    XPAR_XDMAPS_0_DONE_INTR_4,
+    XPAR_XDMAPS_0_DONE_INTR_5,
+    XPAR_XDMAPS_0_DONE_INTR_6,
+    XPAR_XDMAPS_0_DONE_INTR_7
+};
+
+static void (*const done_isrs[COPY_ENGINE_CHANNELS])(XDmaPs *) = {
+    XDmaPs_DoneISR_0,
+    XDmaPs_DoneISR_1,
+    XDmaPs_DoneISR_2,
+    XDmaPs_DoneISR_3,
+    XDmaPs_DoneISR_4,
+    XDmaPs_DoneISR_5,
+    XDmaPs_DoneISR_6,
+    XDmaPs_DoneISR_7
+};
+
+/**
+ * Records the outcome of a copy and notifies its owner.
+ *
+ * @param job The copy that completed.
+ * @param result The outcome of the copy.
+ *
+ * @return None.
+ */
+static void complete_copy(copy_job_t *job, const result_t result)
+{
+    job->result = result;
+    job->done = true;
+    if (job->complete)
+    {
+        job->complete(job, result, job->callback_arg);
+    }
+}
+
+/**
+ * Starts the next segment of an offloaded copy on its channel.
+ *
+ * @param job The copy to continue.
+ *
+ * @return Success, or fail if the driver did not accept the command.
+ */
+static result_t start_segment(copy_job_t *job)
+{
+    const copy_segment_t *segment = &job->segments[job->next_segment];
+
+    memset(&job->cmd, 0, sizeof(job->cmd));
+    job->cmd.ChanCtrl.SrcBurstSize = COPY_BURST_SIZE;
+    job->cmd.ChanCtrl.SrcBurstLen = COPY_BURST_LEN;
+    job->cmd.ChanCtrl.SrcInc = 1;
+    job->cmd.ChanCtrl.DstBurstSize = COPY_BURST_SIZE;
+    job->cmd.ChanCtrl.DstBurstLen = COPY_BURST_LEN;
+    job->cmd.ChanCtrl.DstInc = 1;
+    job->cmd.BD.SrcAddr = (u32)(uintptr_t)segment->src;
+    job->cmd.BD.DstAddr = (u32)(uintptr_t)segment->dst;
+    job->cmd.BD.Length = segment->len;
+
+    AbortIfNot(XDmaPs_Start(&job->engine->dmac, job->channel, &job->cmd, 0) == XST_SUCCESS, fail);
+
+    return success;
+}
+
+/**
+ * Completes a segment of the copy on a channel and starts the next.
+ *
+ * @note Called by the driver from the done interrupt of the channel.
+ *
+ * @param channel The channel that completed.
+ * @param cmd The command that completed.
+ * @param arg The copy engine.
+ *
+ * @return None.
+ */
+static void copy_done_handler(unsigned int channel, XDmaPs_Cmd *cmd, void *arg)
+{
+    copy_engine_t *engine = (copy_engine_t *)arg;
+    copy_job_t *job = engine->active[channel];
+    if (!job)
+    {
+        return;
+    }
+
+    const copy_segment_t *segment = &job->segments[job->next_segment];
+    if (job->flags & COPY_INVALIDATE_DESTINATION)
+    {
+        Xil_DCacheInvalidateRange((INTPTR)segment->dst, segment->len);
+    }
+    engine->dma_bytes += segment->len;
+    trace(TRACE_COPY_DONE, TRACE_INSTANT, channel, segment->len);
+
+    result_t result = (cmd->DmaStatus == 0)? success : fail;
+    if (result == success && ++job->next_segment < job->num_segments)
+    {
+        if (start_segment(job))
+        {
+            trace(TRACE_COPY_START, TRACE_INSTANT, channel, job->segments[job->next_segment].len);
+            return;
+        }
+        result = fail;
+    }
+
+    engine->active[channel] = NULL;
+    complete_copy(job, result);
+}
+
+/**
+ * Abandons the copy on a channel that faulted.
+ *
+ * @note Called by the driver from the fault interrupt once it has reset the
+ *       channel.
+ *
+ * @param channel The channel that faulted.
+ * @param cmd The command that faulted.
+ * @param arg The copy engine.
+ *
+ * @return None.
+ */
+static void copy_fault_handler(unsigned int channel, XDmaPs_Cmd *cmd, void *arg)
+{
+    copy_engine_t *engine = (copy_engine_t *)arg;
+    engine->faults++;
+
+    copy_job_t *job = engine->active[channel];
+    if (job)
+    {
+        engine->active[channel] = NULL;
+        complete_copy(job, fail);
+    }
+}
+
+/**
+ * Initializes the DMA controller and its interrupts.
+ *
+ * @param[out] engine The copy engine to initialize.
+ *
+ * @return Success or fail.
+ */
+result_t init_copy_engine(copy_engine_t *engine)
+{
+    AbortIfNot(engine, fail);
+
+    engine->ready = false;
+    engine->dma_copies = 0;
+    engine->cpu_copies = 0;
+    engine->faults = 0;
+    engine->dma_bytes = 0;
+    for (size_t i = 0; i < COPY_ENGINE_CHANNELS; ++i)
+    {
+        engine->active[i] = NULL;
+    }
+
+    XDmaPs_Config *config = XDmaPs_LookupConfig(XPAR_XDMAPS_0_DEVICE_ID);
+    AbortIfNot(config, fail);
+    AbortIfNot(XDmaPs_CfgInitialize(&engine->dmac, config, config->BaseAddress) == XST_SUCCESS, fail);
+
+    AbortIfNot(XDmaPs_SetFaultHandler(&engine->dmac, copy_fault_handler, engine) == XST_SUCCESS, fail);
+    AbortIfNot(register_interrupt(XPAR_XDMAPS_0_FAULT_INTR,
+                                  (void (*)(void *))XDmaPs_FaultISR,
+                                  &engine->dmac,
+                                  IRQ_PRIORITY_DEFAULT), fail);
+    for (unsigned int i = 0; i < COPY_ENGINE_CHANNELS; ++i)
+    {
+        AbortIfNot(XDmaPs_SetDoneHandler(&engine->dmac, i, copy_done_handler, engine) == XST_SUCCESS, fail);
+        AbortIfNot(register_interrupt(done_interrupts[i],
+                                      (void (*)(void *))done_isrs[i],
+                                      &engine->dmac,
+                                      IRQ_PRIORITY_DEFAULT), fail);
+    }
+
+    engine->ready = true;
+
+    return success;
+}
+
+/**
+ * Prepares a copy that has not been started, so that it reads as complete.
+ *
+ * @param[out] job The copy to prepare.
+ *
+ * @return None.
+ */
+void init_copy_job(copy_job_t *job)
+{
+    job->engine = NULL;
+    job->num_segments = 0;
+    job->next_segment = 0;
+    job->flags = 0;
+    job->channel = 0;
+    job->done = true;
+    job->result = success;
+    job->complete = NULL;
+    job->callback_arg = NULL;
+}
+
+/**
+ * Claims a free channel of the controller for a copy.
+ *
+ * @param engine The copy engine.
+ * @param job The copy that will run on the channel.
+ *
+ * @return True if a channel was claimed.
+ */
+static bool claim_channel(copy_engine_t *engine, copy_job_t *job)
+{
+    const uint32_t cpsr = save_and_disable_interrupts();
+    for (unsigned int i = 0; i < COPY_ENGINE_CHANNELS; ++i)
+    {
+        if (!engine->active[i])
+        {
+            engine->active[i] = job;
+            job->channel = i;
+            restore_interrupts(cpsr);
+            return true;
+        }
+    }
+    restore_interrupts(cpsr);
+
+    return false;
+}
+
+/**
+ * Starts copying a buffer in the background.
+ *
+ * @param engine The copy engine, or NULL to copy with the processor.
+ * @param job The copy, which must not be in progress.
+ * @param dst The destination buffer.
+ * @param src The source buffer.
+ * @param len The number of bytes to copy.
+ * @param flags The cache maintenance that the buffers need, as copy_flags_t.
+ *
+ * @return Success or fail.
+ */
+result_t start_copy(copy_engine_t *engine,
+                    copy_job_t *job,
+                    void *dst,
+                    const void *src,
+                    const size_t len,
+                    const uint32_t flags)
+{
+    const copy_segment_t segment = {dst, src, len};
+
+    return start_gather(engine, job, &segment, 1, flags);
+}
+
+/**
+ * Starts copying a list of blocks in the background, in order.
+ *
+ * @note Copies that are short or unaligned, or that find every channel busy,
+ *       are made by the processor before returning. Either way the job is
+ *       completed through the same callback, and neither buffer may be
+ *       touched until copy_done() reports the copy complete.
+ *
+ * @param engine The copy engine, or NULL to copy with the processor.
+ * @param job The copy, which must not be in progress.
+ * @param segments The blocks to copy, which are held by the job.
+ * @param num_segments The number of blocks, at most COPY_MAX_SEGMENTS.
+ * @param flags The cache maintenance that the buffers need, as copy_flags_t.
+ *
+ * @return Success or fail.
+ */
+result_t start_gather(copy_engine_t *engine,
+                      copy_job_t *job,
+                      const copy_segment_t *segments,
+                      const size_t num_segments,
+                      const uint32_t flags)
+{
+    AbortIfNot(job, fail);
+    AbortIfNot(job->done, fail);
+    AbortIfNot(segments, fail);
+    AbortIfNot(num_segments, fail);
+    AbortIfNot(num_segments <= COPY_MAX_SEGMENTS, fail);
+
+    /*
+     * The controller moves whole beats, so every block must be aligned to
+     * the width of its bus.
+     */
+    size_t total = 0;
+    bool aligned = true;
+    for (size_t i = 0; i < num_segments; ++i)
+    {
+        AbortIfNot(segments[i].dst, fail);
+        AbortIfNot(segments[i].src, fail);
+        job->segments[i] = segments[i];
+        total += segments[i].len;
+        if (((uintptr_t)segments[i].dst | (uintptr_t)segments[i].src | segments[i].len) % COPY_BURST_SIZE ||
+            !segments[i].len)
+        {
+            aligned = false;
+        }
+    }
+    job->engine = engine;
+    job->num_segments = num_segments;
+    job->next_segment = 0;
+    job->flags = flags;
+    job->result = success;
+
+    if (engine && engine->ready && aligned && total >= COPY_ENGINE_MIN_BYTES && claim_channel(engine, job))
+    {
+        for (size_t i = 0; i < num_segments; ++i)
+        {
+            if (flags & COPY_CLEAN_SOURCE)
+            {
+                Xil_DCacheFlushRange((INTPTR)segments[i].src, segments[i].len);
+            }
+            if (flags & COPY_INVALIDATE_DESTINATION)
+            {
+                Xil_DCacheFlushRange((INTPTR)segments[i].dst, segments[i].len);
+            }
+        }
+
+        job->done = false;
+        if (start_segment(job))
+        {
+            engine->dma_copies++;
+            trace(TRACE_COPY_START, TRACE_INSTANT, job->channel, segments[0].len);
+            return success;
+        }
+
+        /*
+         * The driver refuses a command only before the channel starts, so
+         * the copy can still be made by the processor.
+         */
+        engine->active[job->channel] = NULL;
+        job->done = true;
+    }
+
+    for (size_t i = 0; i < num_segments; ++i)
+    {
+        memcpy(segments[i].dst, segments[i].src, segments[i].len);
+    }
+    if (engine)
+    {
+        engine->cpu_copies++;
+    }
+    complete_copy(job, success);
+
+    return success;
+}
+
+/**
+ * Checks if a copy has completed.
+ *
+ * @param job The copy.
+ *
+ * @return True if the copy is complete or was never started.
+ */
+bool copy_done(const copy_job_t *job)
+{
+    return job->done;
+}
+
+/**
+ * Waits for a copy to complete.
+ *
+ * @note A copy that does not complete in time is stopped and reported as
+ *       failed.
+ *
+ * @param job The copy to wait for.
+ *
+ * @return The outcome of the copy.
+ */
+result_t finish_copy(copy_job_t *job)
+{
+    AbortIfNot(job, fail);
+
+    /*
+     * The wait spins without sleeping, so it is timed by the cycle counter
+     * rather than by reading the global timer on every pass.
+     */
+    const uint32_t start_cycles = read_cycle_counter();
+    const uint32_t timeout_cycles = ticks_to_cycles(ms_to_ticks(COPY_ENGINE_TIMEOUT_MS));
+    while (!job->done)
+    {
+        if (read_cycle_counter() - start_cycles > timeout_cycles)
+        {
+            const uint32_t cpsr = save_and_disable_interrupts();
+            if (!job->done)
+            {
+                copy_engine_t *engine = job->engine;
+                XDmaPs_ResetChannel(&engine->dmac, job->channel);
+                engine->active[job->channel] = NULL;
+                engine->faults++;
+                complete_copy(job, fail);
+            }
+            restore_interrupts(cpsr);
+        }
+    }
+
+    return job->result;
+}
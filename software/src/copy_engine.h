@@ -0,0 +1,120 @@
+#ifndef COPY_ENGINE_H
+#define COPY_ENGINE_H
+
+#include "system_params.h"
+#include "types.h"
+#include "xdmaps.h"
+
+/**
+ * The number of channels of the PL330 DMA controller, each of which runs one
+ * copy at a time.
+ */
+#define COPY_ENGINE_CHANNELS 8
+
+/**
+ * Defines the cache maintenance that a copy needs around the DMA transfer.
+ */
+typedef enum copy_flags_t
+{
+    /*
+     * The source may have dirty lines in the data cache, so it is cleaned
+     * before the controller reads it.
+     */
+    COPY_CLEAN_SOURCE = 1,
+
+    /*
+     * The destination is cacheable, so it is cleaned before the transfer and
+     * invalidated once it completes. The destination must not share a cache
+     * line with data that the CPU writes while the copy is in flight.
+     */
+    COPY_INVALIDATE_DESTINATION = 2
+} copy_flags_t;
+
+/**
+ * Defines one contiguous block of a copy.
+ */
+typedef struct copy_segment_t
+{
+    void *dst;
+    const void *src;
+    size_t len;
+} copy_segment_t;
+
+struct copy_engine_t;
+
+/**
+ * Defines a copy that runs in the background on the DMA controller. The
+ * segments are copied in order on a single channel.
+ */
+typedef struct copy_job_t
+{
+    struct copy_engine_t *engine;
+    copy_segment_t segments[COPY_MAX_SEGMENTS];
+    size_t num_segments;
+    size_t next_segment;
+    uint32_t flags;
+
+    /*
+     * The channel that the copy runs on and the command of the segment in
+     * flight, which the driver uses until the segment completes.
+     */
+    unsigned int channel;
+    XDmaPs_Cmd cmd;
+
+    /*
+     * Specified true once every segment is copied, with the outcome of the
+     * copy. Both are set from the DMA interrupt.
+     */
+    volatile bool done;
+    volatile result_t result;
+
+    /*
+     * Called once the copy completes, from the DMA interrupt if the copy
+     * was offloaded. May be NULL.
+     */
+    void (*complete)(struct copy_job_t *job, const result_t result, void *arg);
+    void *callback_arg;
+} copy_job_t;
+
+/**
+ * Defines the PL330 DMA controller of the processing system, used to copy
+ * buffers between memory regions while the CPU processes captures.
+ */
+typedef struct copy_engine_t
+{
+    XDmaPs dmac;
+    bool ready;
+
+    /*
+     * The copy running on each channel, or NULL if the channel is free.
+     */
+    copy_job_t *volatile active[COPY_ENGINE_CHANNELS];
+
+    uint32_t dma_copies;
+    uint32_t cpu_copies;
+    uint32_t faults;
+    uint64_t dma_bytes;
+} copy_engine_t;
+
+result_t init_copy_engine(copy_engine_t *engine);
+
+void init_copy_job(copy_job_t *job);
+
+result_t start_copy(copy_engine_t *engine,
+                    copy_job_t *job,
+                    void *dst,
+                    const void *src,
+                    const size_t len,
+                    const uint32_t flags);
+
+result_t start_gather(copy_engine_t *engine,
+                      copy_job_t *job,
+                      const copy_segment_t *segments,
+                      const size_t num_segments,
+                      const uint32_t flags);
+
+bool copy_done(const copy_job_t *job);
+
+result_t finish_copy(copy_job_t *job);
+
+#endif
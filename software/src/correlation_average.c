@@ -0,0 +1,247 @@
+#include "correlation_average.h"
+
+#include "abort.h"
+#include "correlation_util.h"
+
+#include <math.h>
+#include <string.h>
+
+/**
+ * Initializes an empty average.
+ *
+ * @param[out] average The average to initialize.
+ * @param storage The storage of the average, which must hold
+ *        CORRELATION_AVERAGE_STORAGE(capacity) floats.
+ * @param capacity The most shifts that a ping may be correlated over.
+ *
+ * @return Success or fail.
+ */
+result_t init_correlation_average(correlation_average_t *average,
+                                  float *storage,
+                                  const size_t capacity)
+{
+    AbortIfNot(average, fail);
+    AbortIfNot(storage, fail);
+    AbortIfNot(capacity, fail);
+
+    average->sum = storage;
+    average->history = &storage[capacity * 3];
+    average->capacity = capacity;
+    reset_correlation_average(average);
+
+    return success;
+}
+
+/**
+ * Discards every ping from an average.
+ *
+ * @param average The average to reset.
+ *
+ * @return None.
+ */
+void reset_correlation_average(correlation_average_t *average)
+{
+    average->count = 0;
+    average->next = 0;
+    average->num_correlations = 0;
+}
+
+/**
+ * Adds the correlations of a ping to an average. The average is restarted if
+ * the correlations were computed differently from the pings it holds.
+ *
+ * @param average The average to add to.
+ * @param view The channels that were correlated.
+ * @param correlations The correlation of the reference with each other
+ *        channel, ordered by decreasing shift.
+ * @param num_correlations The number of correlations.
+ * @param reference The channel that the others were correlated against.
+ * @param phat Specified true if the correlations were whitened.
+ * @param window The number of pings to average over.
+ * @param exponential Specified true for an exponential average with a time
+ *        constant of the window rather than the mean of the window.
+ * @param sampling_frequency The sampling frequency of the data.
+ *
+ * @return Success or fail.
+ */
+result_t accumulate_correlations(correlation_average_t *average,
+                                 const channel_view_t *view,
+                                 const correlation_t *correlations,
+                                 const size_t num_correlations,
+                                 const size_t reference,
+                                 const bool phat,
+                                 const size_t window,
+                                 const bool exponential,
+                                 const uint32_t sampling_frequency)
+{
+    AbortIfNot(average, fail);
+    AbortIfNot(view, fail);
+    AbortIfNot(correlations, fail);
+    AbortIfNot(num_correlations, fail);
+    AbortIfNot(num_correlations <= average->capacity, fail);
+    AbortIfNot(reference < 4, fail);
+    AbortIfNot(window && window <= CORRELATION_AVERAGE_MAX_PINGS, fail);
+
+    if (average->num_correlations != num_correlations ||
+        average->first_shift != correlations[0].left_shift ||
+        average->reference != reference ||
+        average->phat != phat ||
+        average->sampling_frequency != sampling_frequency ||
+        average->window != window ||
+        average->exponential != exponential)
+    {
+        reset_correlation_average(average);
+        average->num_correlations = num_correlations;
+        average->first_shift = correlations[0].left_shift;
+        average->reference = reference;
+        average->phat = phat;
+        average->sampling_frequency = sampling_frequency;
+        average->window = window;
+        average->exponential = exponential;
+    }
+
+    /*
+     * Find the scale of each pair, at which a perfectly coherent pair peaks.
+     */
+    double energy[4];
+    for (size_t k = 0; k < 4; ++k)
+    {
+        int64_t sum = 0;
+        for (size_t i = 0; i < view->len; ++i)
+        {
+            const int32_t value = view->channel[k][i * view->stride];
+            sum += value * value;
+        }
+        energy[k] = sum;
+    }
+
+    float scale[3];
+    for (size_t i = 0, k = 0; k < 4; ++k)
+    {
+        if (k == reference)
+        {
+            continue;
+        }
+
+        const double norm = (phat)? (double)PHAT_CORRELATION_SCALE * (2 << 13) :
+                sqrt(energy[reference] * energy[k]);
+        scale[i++] = (norm > 0)? (2 << 13) / norm : 0;
+    }
+
+    /*
+     * The mean of the window is kept as a running sum, from which the oldest
+     * ping is removed once the window is full.
+     */
+    float *slot = &average->history[average->next * average->capacity * 3];
+    const bool full = (!exponential && average->count == window)? true : false;
+    const float alpha = 1.0f / window;
+    for (size_t j = 0; j < num_correlations; ++j)
+    {
+        for (size_t i = 0; i < 3; ++i)
+        {
+            const size_t index = j * 3 + i;
+            const float value = correlations[j].result[i] * scale[i];
+            if (exponential)
+            {
+                average->sum[index] = (average->count)?
+                        average->sum[index] + alpha * (value - average->sum[index]) : value;
+            }
+            else
+            {
+                const float oldest = (full)? slot[index] : 0;
+                const float previous = (average->count)? average->sum[index] : 0;
+                average->sum[index] = previous - oldest + value;
+                slot[index] = value;
+            }
+        }
+    }
+
+    if (!exponential)
+    {
+        average->next = (average->next + 1) % window;
+    }
+    if (average->count < window)
+    {
+        average->count++;
+    }
+
+    return success;
+}
+
+/**
+ * Converts the peaks of an average into time delays.
+ *
+ * @note The delays and confidences are relative to channel 0, as for a
+ *       single ping. The bearing is not solved.
+ *
+ * @param average The average to evaluate.
+ * @param[out] result The delay and confidence of each channel.
+ *
+ * @return Success or fail.
+ */
+result_t evaluate_correlation_average(const correlation_average_t *average,
+                                      correlation_result_t *result)
+{
+    AbortIfNot(average, fail);
+    AbortIfNot(result, fail);
+    AbortIfNot(average->count, fail);
+
+    memset(result, 0, sizeof(*result));
+    result->quality = 1;
+
+    const size_t num = average->num_correlations;
+    const float mean_scale = (average->exponential)? 1 : 1.0f / average->count;
+
+    /*
+     * Find the delay of each channel from the reference at the peak of its
+     * pair, refined by a parabola through the neighbouring shifts.
+     */
+    double arrival[4] = {0};
+    float confidence[4] = {0};
+    confidence[average->reference] = 1;
+    for (size_t i = 0, k = 0; k < 4; ++k)
+    {
+        if (k == average->reference)
+        {
+            continue;
+        }
+
+        size_t peak = 0;
+        for (size_t j = 1; j < num; ++j)
+        {
+            if (average->sum[j * 3 + i] > average->sum[peak * 3 + i])
+            {
+                peak = j;
+            }
+        }
+
+        double offset = 0;
+        if (peak > 0 && peak + 1 < num)
+        {
+            const double before = average->sum[(peak - 1) * 3 + i];
+            const double center = average->sum[peak * 3 + i];
+            const double after = average->sum[(peak + 1) * 3 + i];
+            const double curvature = before - 2 * center + after;
+            if (curvature < 0)
+            {
+                offset = 0.5 * (before - after) / curvature;
+                offset = (offset > 0.5)? 0.5 : (offset < -0.5)? -0.5 : offset;
+            }
+        }
+
+        const int32_t left_shift = average->first_shift - (int32_t)peak;
+        arrival[k] = -1 * left_shift + offset;
+        confidence[k] = average->sum[peak * 3 + i] * mean_scale;
+        i++;
+    }
+
+    for (size_t i = 0; i < 3; ++i)
+    {
+        const size_t k = i + 1;
+        result->confidence[i] = (confidence[k] < confidence[0])? confidence[k] : confidence[0];
+        result->channel_delay_ns[i] = (arrival[k] - arrival[0]) *
+                                      1000000000.0 / average->sampling_frequency;
+    }
+
+    return success;
+}
@@ -0,0 +1,74 @@
+#ifndef CORRELATION_AVERAGE_H
+#define CORRELATION_AVERAGE_H
+
+#include "types.h"
+
+/**
+ * The most pings that can be averaged over a window.
+ */
+#define CORRELATION_AVERAGE_MAX_PINGS 16
+
+/**
+ * The number of floats of storage that an average of up to capacity shifts
+ * needs.
+ */
+#define CORRELATION_AVERAGE_STORAGE(capacity) ((CORRELATION_AVERAGE_MAX_PINGS + 1) * (capacity) * 3)
+
+/**
+ * Defines a coherent average of the correlations of recent pings. Each ping
+ * is normalized by the energies of its channels so that it contributes as
+ * much as any other, and the average is either the mean of the last window
+ * of pings or an exponential average with a time constant of the window.
+ *
+ * @note The average only applies while the vehicle is stationary. It is
+ *       restarted whenever the correlations are computed differently.
+ */
+typedef struct correlation_average_t
+{
+    /*
+     * The normalized correlations of each ping in the window, and their sum
+     * or exponential average. Each holds capacity shifts of three pairs.
+     */
+    float *history;
+    float *sum;
+    size_t capacity;
+
+    /*
+     * The number of pings in the average and the slot of the next ping.
+     */
+    size_t count;
+    size_t next;
+
+    /*
+     * How the averaged correlations were computed, which every new ping must
+     * match.
+     */
+    size_t num_correlations;
+    int32_t first_shift;
+    size_t reference;
+    bool phat;
+    uint32_t sampling_frequency;
+    size_t window;
+    bool exponential;
+} correlation_average_t;
+
+result_t init_correlation_average(correlation_average_t *average,
+                                  float *storage,
+                                  const size_t capacity);
+
+void reset_correlation_average(correlation_average_t *average);
+
+result_t accumulate_correlations(correlation_average_t *average,
+                                 const channel_view_t *view,
+                                 const correlation_t *correlations,
+                                 const size_t num_correlations,
+                                 const size_t reference,
+                                 const bool phat,
+                                 const size_t window,
+                                 const bool exponential,
+                                 const uint32_t sampling_frequency);
+
+result_t evaluate_correlation_average(const correlation_average_t *average,
+                                      correlation_result_t *result);
+
+#endif
@@ -2,10 +2,1709 @@
 
 #include "types.h"
 #include "abort.h"
+#include "capture_arena.h"
+#include "fft.h"
+#include "l2_lockdown.h"
+#include "sample_clock.h"
+#include "sample_ops.h"
 #include "system_params.h"
 #include "time_util.h"
 #include "db.h"
 
+#include <math.h>
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+#define PI 3.14159265358979323846
+
+/**
+ * Marks a kernel that is inlined into each of its specializations, so that
+ * its constant arguments fold its loops and branches away.
+ */
+#define KERNEL_INLINE static inline __attribute__((always_inline))
+
+/**
+ * Correlates the reference channel against channels A, B, and C for a single
+ * sample shift.
+ *
+ * @note Products are accumulated into 64-bit integers so that the result is
+ *       exact regardless of the correlation length.
+ *
+ * @param view The channels to correlate.
+ * @param start_index The first index of the unshifted reference signal.
+ * @param end_index One past the last index of the unshifted reference signal.
+ * @param lshift The number of samples the channels are shifted left by.
+ * @param[out] correlation The correlation of each channel with the reference.
+ * @param stride The distance between consecutive samples of a channel.
+ *
+ * @return None.
+ */
+KERNEL_INLINE void correlate_shift_kernel(const channel_view_t *view,
+                                          const size_t start_index,
+                                          const size_t end_index,
+                                          const int32_t lshift,
+                                          int64_t correlation[3],
+                                          const size_t stride)
+{
+    size_t i = start_index;
+    const analog_sample_t *reference = view->channel[0];
+
+    for (size_t k = 0; k < 3; ++k)
+    {
+        correlation[k] = 0;
+    }
+
+#ifdef __ARM_NEON
+    int64x2_t accumulators[3] = {vdupq_n_s64(0), vdupq_n_s64(0), vdupq_n_s64(0)};
+    if (stride == 4)
+    {
+        /*
+         * De-interleave four samples at a time so each channel occupies its
+         * own vector, then multiply-accumulate the reference against each
+         * channel.
+         */
+        for (; i + 4 <= end_index; i += 4)
+        {
+            const int16x4x4_t samples = vld4_s16(&reference[i * 4]);
+            const int16x4x4_t shifted = vld4_s16(&reference[(i + lshift) * 4]);
+
+            for (size_t k = 0; k < 3; ++k)
+            {
+                accumulators[k] = vpadalq_s32(accumulators[k],
+                                              vmull_s16(samples.val[0], shifted.val[k + 1]));
+            }
+        }
+    }
+    else if (stride == 1)
+    {
+        /*
+         * Each channel is contiguous, so only the reference and the shifted
+         * channels are loaded.
+         */
+        for (; i + 8 <= end_index; i += 8)
+        {
+            const int16x8_t samples = vld1q_s16(&reference[i]);
+
+            for (size_t k = 0; k < 3; ++k)
+            {
+                const int16x8_t shifted = vld1q_s16(&view->channel[k + 1][i + lshift]);
+                accumulators[k] = vpadalq_s32(accumulators[k],
+                                              vmull_s16(vget_low_s16(samples), vget_low_s16(shifted)));
+                accumulators[k] = vpadalq_s32(accumulators[k],
+                                              vmull_s16(vget_high_s16(samples), vget_high_s16(shifted)));
+            }
+        }
+    }
+
+    for (size_t k = 0; k < 3; ++k)
+    {
+        correlation[k] = vgetq_lane_s64(accumulators[k], 0) +
+                         vgetq_lane_s64(accumulators[k], 1);
+    }
+#endif
+
+    /*
+     * Handle any remaining samples (or all samples without NEON).
+     */
+    for (; i < end_index; ++i)
+    {
+        for (size_t k = 0; k < 3; ++k)
+        {
+            correlation[k] += (int32_t)reference[i * stride] *
+                    view->channel[k + 1][(i + lshift) * stride];
+        }
+    }
+}
+
+/**
+ * Correlates the reference channel against channels A, B, and C for a single
+ * sample shift, with the kernel specialized for contiguous channels.
+ *
+ * @param view The channels to correlate.
+ * @param start_index The first index of the unshifted reference signal.
+ * @param end_index One past the last index of the unshifted reference signal.
+ * @param lshift The number of samples the channels are shifted left by.
+ * @param[out] correlation The correlation of each channel with the reference.
+ *
+ * @return None.
+ */
+HOT_CODE
+static void correlate_shift(const channel_view_t *view,
+                            const size_t start_index,
+                            const size_t end_index,
+                            const int32_t lshift,
+                            int64_t correlation[3])
+{
+    /*
+     * Contiguous channels are specialized so that the remaining samples, or
+     * every sample without NEON, are multiplied in vectors. Interleaved
+     * channels are not, since the compiler would gather them lane by lane.
+     */
+    if (view->stride == 1)
+    {
+        correlate_shift_kernel(view, start_index, end_index, lshift, correlation, 1);
+    }
+    else
+    {
+        correlate_shift_kernel(view, start_index, end_index, lshift, correlation, view->stride);
+    }
+}
+
+/**
+ * Correlates every pair of channels for a single sample shift.
+ *
+ * @note Each sample is loaded once for all six products. The cross pairs are
+ *       channels A and B, A and C, and B and C.
+ *
+ * @param view The channels to correlate.
+ * @param start_index The first index of the unshifted signal.
+ * @param end_index One past the last index of the unshifted signal.
+ * @param lshift The number of samples the channels are shifted left by.
+ * @param[out] correlation The correlation of each channel with the reference.
+ * @param[out] cross The correlation of each cross pair.
+ * @param stride The distance between consecutive samples of a channel.
+ *
+ * @return None.
+ */
+KERNEL_INLINE void correlate_pairs_shift_kernel(const channel_view_t *view,
+                                                const size_t start_index,
+                                                const size_t end_index,
+                                                const int32_t lshift,
+                                                int64_t correlation[3],
+                                                int64_t cross[3],
+                                                const size_t stride)
+{
+    size_t i = start_index;
+    const analog_sample_t *const *channel = view->channel;
+
+    for (size_t k = 0; k < 3; ++k)
+    {
+        correlation[k] = 0;
+        cross[k] = 0;
+    }
+
+#ifdef __ARM_NEON
+    int64x2_t accumulators[3] = {vdupq_n_s64(0), vdupq_n_s64(0), vdupq_n_s64(0)};
+    int64x2_t cross_accumulators[3] = {vdupq_n_s64(0), vdupq_n_s64(0), vdupq_n_s64(0)};
+    if (stride == 4)
+    {
+        for (; i + 4 <= end_index; i += 4)
+        {
+            const int16x4x4_t samples = vld4_s16(&channel[0][i * 4]);
+            const int16x4x4_t shifted = vld4_s16(&channel[0][(i + lshift) * 4]);
+
+            for (size_t k = 0; k < 3; ++k)
+            {
+                accumulators[k] = vpadalq_s32(accumulators[k],
+                                              vmull_s16(samples.val[0], shifted.val[k + 1]));
+            }
+
+            cross_accumulators[0] = vpadalq_s32(cross_accumulators[0],
+                                                vmull_s16(samples.val[1], shifted.val[2]));
+            cross_accumulators[1] = vpadalq_s32(cross_accumulators[1],
+                                                vmull_s16(samples.val[1], shifted.val[3]));
+            cross_accumulators[2] = vpadalq_s32(cross_accumulators[2],
+                                                vmull_s16(samples.val[2], shifted.val[3]));
+        }
+    }
+    else if (stride == 1)
+    {
+        for (; i + 4 <= end_index; i += 4)
+        {
+            int16x4_t samples[3];
+            int16x4_t shifted[3];
+            for (size_t k = 0; k < 3; ++k)
+            {
+                samples[k] = vld1_s16(&channel[k][i]);
+                shifted[k] = vld1_s16(&channel[k + 1][i + lshift]);
+            }
+
+            for (size_t k = 0; k < 3; ++k)
+            {
+                accumulators[k] = vpadalq_s32(accumulators[k],
+                                              vmull_s16(samples[0], shifted[k]));
+            }
+
+            cross_accumulators[0] = vpadalq_s32(cross_accumulators[0],
+                                                vmull_s16(samples[1], shifted[1]));
+            cross_accumulators[1] = vpadalq_s32(cross_accumulators[1],
+                                                vmull_s16(samples[1], shifted[2]));
+            cross_accumulators[2] = vpadalq_s32(cross_accumulators[2],
+                                                vmull_s16(samples[2], shifted[2]));
+        }
+    }
+
+    for (size_t k = 0; k < 3; ++k)
+    {
+        correlation[k] = vgetq_lane_s64(accumulators[k], 0) +
+                         vgetq_lane_s64(accumulators[k], 1);
+        cross[k] = vgetq_lane_s64(cross_accumulators[k], 0) +
+                   vgetq_lane_s64(cross_accumulators[k], 1);
+    }
+#endif
+
+    /*
+     * Handle any remaining samples (or all samples without NEON).
+     */
+    for (; i < end_index; ++i)
+    {
+        const size_t j = i * stride;
+        const size_t shifted = (i + lshift) * stride;
+        for (size_t k = 0; k < 3; ++k)
+        {
+            correlation[k] += (int32_t)channel[0][j] * channel[k + 1][shifted];
+        }
+
+        cross[0] += (int32_t)channel[1][j] * channel[2][shifted];
+        cross[1] += (int32_t)channel[1][j] * channel[3][shifted];
+        cross[2] += (int32_t)channel[2][j] * channel[3][shifted];
+    }
+}
+
+/**
+ * Correlates every pair of channels for a single sample shift, with the
+ * kernel specialized for contiguous channels.
+ *
+ * @param view The channels to correlate.
+ * @param start_index The first index of the unshifted signal.
+ * @param end_index One past the last index of the unshifted signal.
+ * @param lshift The number of samples the channels are shifted left by.
+ * @param[out] correlation The correlation of each channel with the reference.
+ * @param[out] cross The correlation of each cross pair.
+ *
+ * @return None.
+ */
+HOT_CODE
+static void correlate_pairs_shift(const channel_view_t *view,
+                                  const size_t start_index,
+                                  const size_t end_index,
+                                  const int32_t lshift,
+                                  int64_t correlation[3],
+                                  int64_t cross[3])
+{
+    if (view->stride == 1)
+    {
+        correlate_pairs_shift_kernel(view, start_index, end_index, lshift, correlation, cross, 1);
+    }
+    else
+    {
+        correlate_pairs_shift_kernel(view, start_index, end_index, lshift, correlation, cross, view->stride);
+    }
+}
+
+/**
+ * Finds the indices of the unshifted signal that overlap the shifted signal.
+ *
+ * @param len The number of samples of each channel.
+ * @param lshift The number of samples the channels are shifted left by.
+ * @param[out] start_index The first index of the unshifted signal.
+ * @param[out] end_index One past the last index of the unshifted signal.
+ *
+ * @return None.
+ */
+static void lag_bounds(const size_t len,
+                       const int32_t lshift,
+                       size_t *start_index,
+                       size_t *end_index)
+{
+    if (lshift >= 0)
+    {
+        *start_index = 0;
+        *end_index = len - lshift;
+    }
+    else
+    {
+        *start_index = -1 * lshift;
+        *end_index = len;
+    }
+}
+
+/**
+ * Stores the sums of products of one shift as its correlation.
+ *
+ * @param max_shift The largest shift to correlate, which sets the index of
+ *        the result.
+ * @param lshift The number of samples the channels are shifted left by.
+ * @param correlation The sum of products of each channel with the reference.
+ * @param cross The sum of products of each cross pair.
+ * @param[out] correlations The correlation for each shift.
+ * @param[out] cross_correlations The correlation of each cross pair for each
+ *             shift, or NULL to only store against the reference.
+ *
+ * @return None.
+ */
+static void store_lag(const int32_t max_shift,
+                      const int32_t lshift,
+                      const int64_t correlation[3],
+                      const int64_t cross[3],
+                      correlation_t *correlations,
+                      correlation_t *cross_correlations)
+{
+    /*
+     * Scale the analog raw data points to voltage readings to keep them in
+     * range of a 32-bit number. Note that since we multiplied two raw
+     * readings, we need to divide by two raw readings - hence the
+     * multiplication.
+     */
+    const size_t c_index = max_shift - lshift;
+    correlations[c_index].left_shift = lshift;
+    for (size_t k = 0; k < 3; ++k)
+    {
+        correlations[c_index].result[k] = correlation[k] / ((2 << 13));
+    }
+
+    if (cross_correlations)
+    {
+        cross_correlations[c_index].left_shift = lshift;
+        for (size_t k = 0; k < 3; ++k)
+        {
+            cross_correlations[c_index].result[k] = cross[k] / ((2 << 13));
+        }
+    }
+}
+
+/**
+ * Directly computes the correlation of the reference channel against
+ * channels A, B, and C, and optionally the cross pairs, for one shift.
+ *
+ * @param view The channels to correlate.
+ * @param max_shift The largest shift to correlate, which sets the index of
+ *        the result.
+ * @param lshift The number of samples the channels are shifted left by.
+ * @param[out] correlations The correlation for each shift.
+ * @param[out] cross_correlations The correlation of each cross pair for each
+ *             shift, or NULL to only correlate against the reference.
+ *
+ * @return None.
+ */
+static void correlate_lag(const channel_view_t *view,
+                          const int32_t max_shift,
+                          const int32_t lshift,
+                          correlation_t *correlations,
+                          correlation_t *cross_correlations)
+{
+    size_t start_index, end_index;
+    lag_bounds(view->len, lshift, &start_index, &end_index);
+
+    int64_t correlation[3];
+    int64_t cross[3] = {0, 0, 0};
+    if (cross_correlations)
+    {
+        correlate_pairs_shift(view, start_index, end_index, lshift, correlation, cross);
+    }
+    else
+    {
+        correlate_shift(view, start_index, end_index, lshift, correlation);
+    }
+
+    store_lag(max_shift, lshift, correlation, cross, correlations, cross_correlations);
+}
+
+/**
+ * The number of lags that each task of a direct correlation computes.
+ */
+#define DIRECT_CORRELATION_TASK_LAGS 16
+
+/**
+ * The number of samples of each block that a range of lags is correlated
+ * over at a time. Interleaved blocks of the unshifted and shifted channels
+ * fill half of the 32 KB L1 data cache.
+ */
+#define DIRECT_CORRELATION_BLOCK_SAMPLES 1024
+
+/**
+ * Runs a task for every index below a count, either through a parallel loop
+ * or in order on the calling core.
+ *
+ * @param parallel_for The loop to run the tasks through, or NULL.
+ * @param task The task to run.
+ * @param context The context passed to each task.
+ * @param count The number of indices.
+ *
+ * @return Success or fail.
+ */
+static result_t run_tasks(const parallel_for_t parallel_for,
+                          const parallel_task_t task,
+                          void *context,
+                          const size_t count)
+{
+    if (parallel_for)
+    {
+        return parallel_for(task, context, count);
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        AbortIfNot(task(context, i), fail);
+    }
+
+    return success;
+}
+
+/**
+ * Defines the shared inputs and outputs of the tasks of a direct
+ * correlation. Each task fills a distinct range of the correlations.
+ */
+typedef struct direct_task_t
+{
+    const channel_view_t *view;
+    int32_t max_shift;
+    correlation_t *correlations;
+    correlation_t *cross_correlations;
+} direct_task_t;
+
+/**
+ * Requests that a block of samples of every channel is brought into the
+ * cache ahead of its use.
+ *
+ * @param view The channels to prefetch.
+ * @param start The first sample to prefetch.
+ * @param end One past the last sample to prefetch.
+ *
+ * @return None.
+ */
+static void prefetch_block(const channel_view_t *view, const size_t start, const size_t end)
+{
+    /*
+     * Interleaved samples hold every channel in the line of the reference.
+     */
+    const size_t channels = (view->stride == 1)? 4 : 1;
+    const size_t step = CACHE_LINE_BYTES / sizeof(analog_sample_t);
+    for (size_t k = 0; k < channels; ++k)
+    {
+        for (size_t i = start * view->stride; i < end * view->stride; i += step)
+        {
+            __builtin_prefetch(&view->channel[k][i]);
+        }
+    }
+}
+
+/**
+ * Correlates one range of lags of a direct correlation.
+ *
+ * @note The window is tiled into blocks that are correlated against every
+ *       lag of the range while they sit in the L1 cache, so each sample is
+ *       read from memory once per range rather than once per lag. The next
+ *       block is prefetched while the current one is correlated.
+ *
+ * @param context The direct correlation.
+ * @param index The range of lags, counted from the largest shift.
+ *
+ * @return Success or fail.
+ */
+HOT_CODE
+static result_t correlate_lag_range(void *context, const size_t index)
+{
+    const direct_task_t *task = (const direct_task_t *)context;
+    const channel_view_t *view = task->view;
+    const size_t len = view->len;
+    const int32_t first = task->max_shift - (int32_t)(index * DIRECT_CORRELATION_TASK_LAGS);
+    int32_t num_lags = first + task->max_shift;
+    if (num_lags > DIRECT_CORRELATION_TASK_LAGS)
+    {
+        num_lags = DIRECT_CORRELATION_TASK_LAGS;
+    }
+
+    int64_t correlation[DIRECT_CORRELATION_TASK_LAGS][3] = {{0}};
+    int64_t cross[DIRECT_CORRELATION_TASK_LAGS][3] = {{0}};
+    for (size_t block = 0; block < len; block += DIRECT_CORRELATION_BLOCK_SAMPLES)
+    {
+        const size_t block_end = (len - block > DIRECT_CORRELATION_BLOCK_SAMPLES)?
+                block + DIRECT_CORRELATION_BLOCK_SAMPLES : len;
+        const size_t next_end = (len - block_end > DIRECT_CORRELATION_BLOCK_SAMPLES)?
+                block_end + DIRECT_CORRELATION_BLOCK_SAMPLES : len;
+        prefetch_block(view, block_end, next_end);
+
+        for (int32_t j = 0; j < num_lags; ++j)
+        {
+            const int32_t lshift = first - j;
+            size_t start_index, end_index;
+            lag_bounds(len, lshift, &start_index, &end_index);
+            start_index = (start_index > block)? start_index : block;
+            end_index = (end_index < block_end)? end_index : block_end;
+            if (start_index >= end_index)
+            {
+                continue;
+            }
+
+            int64_t partial[3];
+            int64_t partial_cross[3] = {0, 0, 0};
+            if (task->cross_correlations)
+            {
+                correlate_pairs_shift(view, start_index, end_index, lshift, partial, partial_cross);
+            }
+            else
+            {
+                correlate_shift(view, start_index, end_index, lshift, partial);
+            }
+
+            for (size_t k = 0; k < 3; ++k)
+            {
+                correlation[j][k] += partial[k];
+                cross[j][k] += partial_cross[k];
+            }
+        }
+    }
+
+    for (int32_t j = 0; j < num_lags; ++j)
+    {
+        store_lag(task->max_shift,
+                  first - j,
+                  correlation[j],
+                  cross[j],
+                  task->correlations,
+                  task->cross_correlations);
+    }
+
+    return success;
+}
+
+/**
+ * Directly computes the cross correlation of the reference channel against
+ * channels A, B, and C for every shift.
+ *
+ * @note The lags are correlated in ranges that may be split across cores.
+ *
+ * @param view The channels to correlate.
+ * @param max_shift The largest shift to correlate.
+ * @param parallel_for The loop to split the lags across, or NULL.
+ * @param[out] correlations The correlation for each shift.
+ * @param[out] cross_correlations The correlation of each cross pair for each
+ *             shift, or NULL to only correlate against the reference.
+ * @param[out] num_correlations The number of correlations computed.
+ *
+ * @return Success or fail.
+ */
+static result_t direct_correlate(const channel_view_t *view,
+                                 const int32_t max_shift,
+                                 const parallel_for_t parallel_for,
+                                 correlation_t *correlations,
+                                 correlation_t *cross_correlations,
+                                 size_t *num_correlations)
+{
+    direct_task_t task = {
+        .view = view,
+        .max_shift = max_shift,
+        .correlations = correlations,
+        .cross_correlations = cross_correlations,
+    };
+
+    const size_t lags = 2 * max_shift;
+    AbortIfNot(run_tasks(parallel_for,
+                         correlate_lag_range,
+                         &task,
+                         (lags + DIRECT_CORRELATION_TASK_LAGS - 1) / DIRECT_CORRELATION_TASK_LAGS), fail);
+    *num_correlations += lags;
+
+    return success;
+}
+
+/**
+ * The most samples per channel, and the most lags, of the decimated channels
+ * searched by the coarse lag search.
+ */
+#define COARSE_SEARCH_MAX_SAMPLES 8192
+#define COARSE_SEARCH_MAX_LAGS 128
+
+/**
+ * Working buffers for the coarse lag search, which hold the decimated
+ * channels and their correlations.
+ */
+NO_INIT static analog_sample_t coarse_samples[4][COARSE_SEARCH_MAX_SAMPLES];
+NO_INIT static correlation_t coarse_correlations[COARSE_SEARCH_MAX_LAGS];
+
+/**
+ * Finds the factor that the channels can be decimated by for the coarse lag
+ * search.
+ *
+ * @param weighting The weighting of the correlation, or NULL.
+ * @param sampling_frequency The sampling frequency of the data.
+ *
+ * @return The decimation factor, or one if the lags are searched at the full
+ *         rate.
+ */
+static size_t coarse_decimation(const correlation_weighting_t *weighting,
+                                const uint32_t sampling_frequency)
+{
+    if (!weighting || !weighting->coarse_max_hz)
+    {
+        return 1;
+    }
+
+    size_t decimation = sampling_frequency /
+            (COARSE_SEARCH_SAMPLES_PER_CYCLE * weighting->coarse_max_hz);
+    if (decimation > COARSE_SEARCH_MAX_DECIMATION)
+    {
+        decimation = COARSE_SEARCH_MAX_DECIMATION;
+    }
+
+    return (decimation)? decimation : 1;
+}
+
+/**
+ * Checks whether a lag is within the window searched around the expected peak
+ * of any pair.
+ *
+ * @param lshift The number of samples the channels are shifted left by.
+ * @param center The shift of the expected peak of each pair.
+ * @param radius The number of lags searched on each side of an expected peak.
+ *
+ * @return True if the lag is near the expected peak of any pair.
+ */
+static bool near_lag_center(const int32_t lshift, const int32_t center[3], const int32_t radius)
+{
+    for (size_t k = 0; k < 3; ++k)
+    {
+        const int32_t distance = (lshift > center[k])? lshift - center[k] : center[k] - lshift;
+        if (distance <= radius)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Directly computes the correlation of the reference channel against
+ * channels A, B, and C for every shift near the expected peak of any pair.
+ * Each of these shifts is correlated for every pair.
+ *
+ * @param view The channels to correlate.
+ * @param max_shift The largest shift to correlate.
+ * @param center The shift of the expected peak of each pair.
+ * @param radius The number of lags correlated on each side of an expected
+ *        peak.
+ * @param[out] correlations The correlation for each shift, which is only
+ *             set near the expected peaks.
+ * @param[out] num_correlations The number of correlations, including those
+ *             that were not computed.
+ * @param[out] lowest The smallest correlation computed for each pair, or
+ *             INT32_MAX if none were.
+ *
+ * @return None.
+ */
+static void refine_lags(const channel_view_t *view,
+                        const int32_t max_shift,
+                        const int32_t center[3],
+                        const int32_t radius,
+                        correlation_t *correlations,
+                        size_t *num_correlations,
+                        int32_t lowest[3])
+{
+    for (size_t k = 0; k < 3; ++k)
+    {
+        lowest[k] = INT32_MAX;
+    }
+
+    for (int32_t lshift = max_shift; lshift > -1 * max_shift; lshift--)
+    {
+        if (near_lag_center(lshift, center, radius))
+        {
+            const size_t c_index = max_shift - lshift;
+            correlate_lag(view, max_shift, lshift, correlations, NULL);
+            for (size_t k = 0; k < 3; ++k)
+            {
+                if (correlations[c_index].result[k] < lowest[k])
+                {
+                    lowest[k] = correlations[c_index].result[k];
+                }
+            }
+        }
+        (*num_correlations)++;
+    }
+}
+
+/**
+ * Computes the cross correlation of the reference channel against channels
+ * A, B, and C over only the lags around the peak predicted for each pair.
+ * Lags outside the windows hold the smallest correlation of the pair.
+ *
+ * @param view The channels to correlate.
+ * @param max_shift The largest shift to correlate.
+ * @param center The shift of the predicted peak of each pair.
+ * @param radius The number of lags correlated on each side of a predicted
+ *        peak.
+ * @param[out] correlations The correlation for each shift.
+ * @param[out] num_correlations The number of correlations computed.
+ * @param[out] contained Specified true if the peak of every pair is inside
+ *             the searched lags, so that its neighbours were correlated.
+ *
+ * @return Success or fail.
+ */
+static result_t tracked_correlate(const channel_view_t *view,
+                                  const int32_t max_shift,
+                                  const int32_t center[3],
+                                  const int32_t radius,
+                                  correlation_t *correlations,
+                                  size_t *num_correlations,
+                                  bool *contained)
+{
+    int32_t lowest[3];
+    refine_lags(view, max_shift, center, radius, correlations, num_correlations, lowest);
+
+    for (int32_t lshift = max_shift; lshift > -1 * max_shift; lshift--)
+    {
+        if (near_lag_center(lshift, center, radius))
+        {
+            continue;
+        }
+
+        const size_t c_index = max_shift - lshift;
+        correlations[c_index].left_shift = lshift;
+        for (size_t k = 0; k < 3; ++k)
+        {
+            correlations[c_index].result[k] = lowest[k];
+        }
+    }
+
+    /*
+     * A peak at the edge of a window is most likely the slope towards a
+     * peak outside of it.
+     */
+    *contained = true;
+    for (size_t k = 0; k < 3; ++k)
+    {
+        size_t peak = 0;
+        for (size_t j = 1; j < *num_correlations; ++j)
+        {
+            if (correlations[j].result[k] > correlations[peak].result[k])
+            {
+                peak = j;
+            }
+        }
+
+        const int32_t lshift = correlations[peak].left_shift;
+        if (!near_lag_center(lshift, center, radius) ||
+            (peak > 0 && !near_lag_center(lshift + 1, center, radius)) ||
+            (peak + 1 < *num_correlations && !near_lag_center(lshift - 1, center, radius)))
+        {
+            *contained = false;
+        }
+    }
+
+    return success;
+}
+
+/**
+ * Computes the cross correlation of the reference channel against channels
+ * A, B, and C by first correlating decimated channels over every lag and then
+ * correlating the full-rate channels only over the lags around the coarse
+ * peak of each pair.
+ *
+ * @note The channels are low-passed by averaging each group of decimated
+ *       samples. Lags that are not refined hold the coarse correlation,
+ *       scaled to the full rate and limited to the smallest refined value of
+ *       each pair, so that the peak of each pair is always a refined lag.
+ *
+ * @param view The channels to correlate.
+ * @param max_shift The largest shift to correlate.
+ * @param decimation The factor that the channels are decimated by.
+ * @param[out] correlations The correlation for each shift.
+ * @param[out] num_correlations The number of correlations computed.
+ *
+ * @return Success or fail.
+ */
+static result_t coarse_correlate(const channel_view_t *view,
+                                 const int32_t max_shift,
+                                 const size_t decimation,
+                                 correlation_t *correlations,
+                                 size_t *num_correlations)
+{
+    const size_t coarse_len = view->len / decimation;
+    int32_t coarse_shift = (max_shift + decimation - 1) / decimation;
+    if (coarse_shift > (int32_t)coarse_len - 1)
+    {
+        coarse_shift = coarse_len - 1;
+    }
+
+    if (coarse_shift < 2 ||
+        coarse_len > COARSE_SEARCH_MAX_SAMPLES ||
+        2 * coarse_shift > COARSE_SEARCH_MAX_LAGS)
+    {
+        return direct_correlate(view, max_shift, NULL, correlations, NULL, num_correlations);
+    }
+
+    /*
+     * Decimate each channel into a contiguous buffer.
+     */
+    channel_view_t coarse_view;
+    for (size_t k = 0; k < 4; ++k)
+    {
+        for (size_t i = 0; i < coarse_len; ++i)
+        {
+            int32_t sum = 0;
+            for (size_t j = 0; j < decimation; ++j)
+            {
+                sum += view->channel[k][(i * decimation + j) * view->stride];
+            }
+            coarse_samples[k][i] = sum / (int32_t)decimation;
+        }
+        coarse_view.channel[k] = coarse_samples[k];
+    }
+    coarse_view.stride = 1;
+    coarse_view.len = coarse_len;
+
+    size_t num_coarse = 0;
+    AbortIfNot(direct_correlate(&coarse_view,
+                                coarse_shift,
+                                NULL,
+                                coarse_correlations,
+                                NULL,
+                                &num_coarse), fail);
+
+    /*
+     * The correlation of a tone is flat near its peak, so the coarse peak of
+     * each pair may be up to a decimated sample from the true peak once
+     * noise is added.
+     */
+    const int32_t radius = decimation + 1;
+    int32_t center[3];
+    for (size_t k = 0; k < 3; ++k)
+    {
+        size_t peak = 0;
+        for (size_t j = 1; j < num_coarse; ++j)
+        {
+            if (coarse_correlations[j].result[k] > coarse_correlations[peak].result[k])
+            {
+                peak = j;
+            }
+        }
+        center[k] = coarse_correlations[peak].left_shift * (int32_t)decimation;
+    }
+
+    /*
+     * Refine every lag near a coarse peak at the full rate.
+     */
+    int32_t lowest[3];
+    refine_lags(view, max_shift, center, radius, correlations, num_correlations, lowest);
+
+    /*
+     * Fill the remaining lags from the nearest coarse lag. The decimated
+     * channels hold one sample for every decimation samples, so their
+     * correlation is scaled up by the decimation.
+     */
+    for (int32_t lshift = max_shift; lshift > -1 * max_shift; lshift--)
+    {
+        if (near_lag_center(lshift, center, radius))
+        {
+            continue;
+        }
+
+        const int32_t half = decimation / 2;
+        const int32_t coarse_lshift = (lshift >= 0)? (lshift + half) / (int32_t)decimation :
+                -1 * ((half - lshift) / (int32_t)decimation);
+        int32_t coarse_index = coarse_shift - coarse_lshift;
+        if (coarse_index < 0)
+        {
+            coarse_index = 0;
+        }
+        else if (coarse_index >= (int32_t)num_coarse)
+        {
+            coarse_index = num_coarse - 1;
+        }
+
+        const size_t c_index = max_shift - lshift;
+        correlations[c_index].left_shift = lshift;
+        for (size_t k = 0; k < 3; ++k)
+        {
+            const int64_t estimate = (int64_t)coarse_correlations[coarse_index].result[k] * decimation;
+            correlations[c_index].result[k] = (estimate < lowest[k])? estimate : lowest[k];
+        }
+    }
+
+    return success;
+}
+
+/**
+ * Working buffers for the frequency-domain correlation. The first holds the
+ * reference and channel A, the second channels B and C. The third is only
+ * used to correlate the cross pairs.
+ */
+NO_INIT static complex_t fft_buffers[3][FFT_MAX_SIZE];
+
+/**
+ * Defines the bins that the phase transform keeps for a transform size and
+ * band.
+ */
+typedef struct band_plan_t
+{
+    size_t n;
+    uint32_t sampling_frequency;
+    uint32_t low_hz;
+    uint32_t high_hz;
+    size_t low_bin;
+    size_t high_bin;
+} band_plan_t;
+
+/**
+ * The band of the last frequency-domain correlation.
+ */
+static band_plan_t band_plan;
+
+/**
+ * Whitens a cross spectrum bin by the phase transform, keeping only its
+ * phase.
+ *
+ * @param x The bin to whiten.
+ *
+ * @return The bin scaled to unit magnitude, or zero if it has no energy.
+ */
+static complex_t phase_transform(const complex_t x)
+{
+    const float magnitude = sqrtf(x.re * x.re + x.im * x.im);
+    if (magnitude == 0)
+    {
+        return x;
+    }
+
+    const complex_t whitened = {x.re / magnitude, x.im / magnitude};
+    return whitened;
+}
+
+/**
+ * Defines a set of transforms of the same size and direction that are run as
+ * parallel tasks.
+ */
+typedef struct transform_task_t
+{
+    complex_t *data[3];
+    size_t n;
+    bool inverse;
+} transform_task_t;
+
+/**
+ * Runs one transform of a set.
+ *
+ * @param context The set of transforms.
+ * @param index The transform to run.
+ *
+ * @return Success or fail.
+ */
+static result_t transform(void *context, const size_t index)
+{
+    const transform_task_t *task = (const transform_task_t *)context;
+
+    return fft(task->data[index], task->n, task->inverse);
+}
+
+/**
+ * Computes the cross correlation of the reference channel against channels
+ * A, B, and C using FFTs.
+ *
+ * @note Pairs of real signals are packed into the real and imaginary parts of
+ *       a single complex transform, so two forward and two inverse transforms
+ *       are needed in total.
+ *
+ * @note With the phase transform, every cross spectrum in the band is
+ *       whitened before the inverse transform, which leaves a sharp peak at
+ *       the delay that reflections smear far less. The correlations are then
+ *       scaled so that a perfectly coherent pair peaks at
+ *       PHAT_CORRELATION_SCALE.
+ *
+ * @param view The channels to correlate.
+ * @param max_shift The largest shift to correlate.
+ * @param weighting The weighting of the cross spectra, or NULL for none.
+ * @param sampling_frequency The sampling frequency of the data.
+ * @param[out] correlations The correlation for each shift.
+ * @param[out] cross_correlations The correlation of each cross pair for each
+ *             shift, or NULL to only correlate against the reference. The
+ *             cross pairs reuse the forward transforms and need one more
+ *             inverse transform.
+ * @param[out] num_correlations The number of correlations computed.
+ *
+ * @return Success or fail.
+ */
+static result_t fft_correlate(const channel_view_t *view,
+                              const int32_t max_shift,
+                              const correlation_weighting_t *weighting,
+                              const uint32_t sampling_frequency,
+                              correlation_t *correlations,
+                              correlation_t *cross_correlations,
+                              size_t *num_correlations)
+{
+    /*
+     * Zero pad so that circular correlation does not alias for the shifts of
+     * interest.
+     */
+    const size_t len = view->len;
+    const size_t n = fft_size(len + max_shift);
+    AbortIfNot(n <= FFT_MAX_SIZE, fail);
+
+    complex_t *z1 = fft_buffers[0];
+    complex_t *z2 = fft_buffers[1];
+    complex_t *z3 = fft_buffers[2];
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (i < len)
+        {
+            const size_t j = i * view->stride;
+            z1[i].re = view->channel[0][j];
+            z1[i].im = view->channel[1][j];
+            z2[i].re = view->channel[2][j];
+            z2[i].im = view->channel[3][j];
+        }
+        else
+        {
+            z1[i].re = z1[i].im = 0;
+            z2[i].re = z2[i].im = 0;
+        }
+    }
+
+    /*
+     * The packed channels are transformed independently, so the transforms
+     * may run on both cores.
+     */
+    const parallel_for_t parallel_for = (weighting)? weighting->parallel_for : NULL;
+    init_fft();
+
+    transform_task_t transforms = {.data = {z1, z2, z3}, .n = n, .inverse = false};
+    AbortIfNot(run_tasks(parallel_for, transform, &transforms, 2), fail);
+
+    /*
+     * Find the bins of the band that the phase transform keeps. Bins k and
+     * n - k share a frequency. The band is only planned again once the size
+     * or the weighting changes.
+     */
+    const bool phat = (weighting && weighting->phat)? true : false;
+    const uint32_t low_hz = (phat)? weighting->low_hz : 0;
+    const uint32_t high_hz = (phat)? weighting->high_hz : 0;
+    if (band_plan.n != n ||
+        band_plan.sampling_frequency != sampling_frequency ||
+        band_plan.low_hz != low_hz ||
+        band_plan.high_hz != high_hz)
+    {
+        band_plan.n = n;
+        band_plan.sampling_frequency = sampling_frequency;
+        band_plan.low_hz = low_hz;
+        band_plan.high_hz = high_hz;
+        band_plan.low_bin = 0;
+        band_plan.high_bin = n / 2;
+        if (high_hz)
+        {
+            band_plan.low_bin = (uint64_t)low_hz * n / sampling_frequency;
+            band_plan.high_bin = ((uint64_t)high_hz * n + sampling_frequency - 1) / sampling_frequency;
+            band_plan.high_bin = (band_plan.high_bin > n / 2)? n / 2 : band_plan.high_bin;
+        }
+    }
+    const size_t low_bin = band_plan.low_bin, high_bin = band_plan.high_bin;
+    size_t kept_bins = 0;
+
+    /*
+     * Separate the packed spectra and form the cross spectra of each channel
+     * with the reference. Bins k and n - k depend on each other, so they are
+     * computed together.
+     */
+    for (size_t k = 0; k <= n / 2; ++k)
+    {
+        const size_t nk = (n - k) & (n - 1);
+        const complex_t a1 = z1[k], b1 = z1[nk];
+        const complex_t a2 = z2[k], b2 = z2[nk];
+
+        if (phat && (k < low_bin || k > high_bin))
+        {
+            const complex_t zero = {0, 0};
+            z1[k] = z1[nk] = zero;
+            z2[k] = z2[nk] = zero;
+            z3[k] = z3[nk] = zero;
+            continue;
+        }
+        kept_bins += (k == nk)? 1 : 2;
+
+        for (size_t pass = 0; pass < ((k == nk)? 1 : 2); ++pass)
+        {
+            /*
+             * For bin m with mirror bin p: X = (Z[m] + conj(Z[p])) / 2 and
+             * Y = (Z[m] - conj(Z[p])) / 2j.
+             */
+            const complex_t m1 = (pass == 0)? a1 : b1;
+            const complex_t p1 = (pass == 0)? b1 : a1;
+            const complex_t m2 = (pass == 0)? a2 : b2;
+            const complex_t p2 = (pass == 0)? b2 : a2;
+
+            const complex_t ref = {(m1.re + p1.re) / 2, (m1.im - p1.im) / 2};
+            const complex_t ch_a = {(m1.im + p1.im) / 2, (p1.re - m1.re) / 2};
+            const complex_t ch_b = {(m2.re + p2.re) / 2, (m2.im - p2.im) / 2};
+            const complex_t ch_c = {(m2.im + p2.im) / 2, (p2.re - m2.re) / 2};
+
+            /*
+             * conj(ref) * channel
+             */
+            complex_t xa = {ref.re * ch_a.re + ref.im * ch_a.im,
+                            ref.re * ch_a.im - ref.im * ch_a.re};
+            complex_t xb = {ref.re * ch_b.re + ref.im * ch_b.im,
+                            ref.re * ch_b.im - ref.im * ch_b.re};
+            complex_t xc = {ref.re * ch_c.re + ref.im * ch_c.im,
+                            ref.re * ch_c.im - ref.im * ch_c.re};
+            if (phat)
+            {
+                xa = phase_transform(xa);
+                xb = phase_transform(xb);
+                xc = phase_transform(xc);
+            }
+
+            /*
+             * The correlations are real, so channels A and B share one inverse
+             * transform as real and imaginary parts.
+             */
+            const size_t bin = (pass == 0)? k : nk;
+            z1[bin].re = xa.re - xb.im;
+            z1[bin].im = xa.im + xb.re;
+            z2[bin] = xc;
+
+            /*
+             * The cross pairs fill the unused imaginary part of the channel C
+             * transform and one more transform.
+             */
+            if (cross_correlations)
+            {
+                complex_t xab = {ch_a.re * ch_b.re + ch_a.im * ch_b.im,
+                                 ch_a.re * ch_b.im - ch_a.im * ch_b.re};
+                complex_t xac = {ch_a.re * ch_c.re + ch_a.im * ch_c.im,
+                                 ch_a.re * ch_c.im - ch_a.im * ch_c.re};
+                complex_t xbc = {ch_b.re * ch_c.re + ch_b.im * ch_c.im,
+                                 ch_b.re * ch_c.im - ch_b.im * ch_c.re};
+                if (phat)
+                {
+                    xab = phase_transform(xab);
+                    xac = phase_transform(xac);
+                    xbc = phase_transform(xbc);
+                }
+
+                z2[bin].re = xc.re - xbc.im;
+                z2[bin].im = xc.im + xbc.re;
+                z3[bin].re = xab.re - xac.im;
+                z3[bin].im = xab.im + xac.re;
+            }
+        }
+    }
+
+    transforms.inverse = true;
+    AbortIfNot(run_tasks(parallel_for, transform, &transforms, (cross_correlations)? 3 : 2), fail);
+
+    /*
+     * Unpack the shifts in the same order and scale as the direct method. The
+     * inverse transform divides by n, so whitened correlations are rescaled
+     * by the number of bins that were kept.
+     */
+    AbortIf(phat && kept_bins == 0, fail);
+    const float scale = (phat)?
+            (float)n / kept_bins * PHAT_CORRELATION_SCALE : 1.0f / (2 << 13);
+    for (int32_t lshift = max_shift; lshift > -1 * max_shift; lshift--)
+    {
+        (*num_correlations)++;
+        const size_t c_index = max_shift - lshift;
+        const size_t bin = (lshift >= 0)? lshift : n + lshift;
+        correlations[c_index].left_shift = lshift;
+        correlations[c_index].result[0] = z1[bin].re * scale;
+        correlations[c_index].result[1] = z1[bin].im * scale;
+        correlations[c_index].result[2] = z2[bin].re * scale;
+
+        if (cross_correlations)
+        {
+            cross_correlations[c_index].left_shift = lshift;
+            cross_correlations[c_index].result[0] = z3[bin].re * scale;
+            cross_correlations[c_index].result[1] = z3[bin].im * scale;
+            cross_correlations[c_index].result[2] = z2[bin].im * scale;
+        }
+    }
+
+    return success;
+}
+
+/**
+ * Estimates the sub-sample position of a correlation peak by fitting a
+ * parabola through the peak and its neighbouring lags.
+ *
+ * @param correlations The correlation results, ordered by decreasing shift.
+ * @param num_correlations The number of correlation results.
+ * @param peak The index of the maximum correlation.
+ * @param channel The channel of the correlation to refine.
+ *
+ * @return The offset of the true peak from the sampled peak in samples of
+ *         right shift, within half a sample.
+ */
+static double interpolate_peak(const correlation_t *correlations,
+                               const size_t num_correlations,
+                               const size_t peak,
+                               const size_t channel)
+{
+    if (peak == 0 || peak + 1 >= num_correlations)
+    {
+        return 0;
+    }
+
+    const double before = correlations[peak - 1].result[channel];
+    const double center = correlations[peak].result[channel];
+    const double after = correlations[peak + 1].result[channel];
+
+    /*
+     * The parabola only has a maximum if the peak is strictly concave.
+     */
+    const double curvature = before - 2 * center + after;
+    if (curvature >= 0)
+    {
+        return 0;
+    }
+
+    /*
+     * Later indices correspond to larger right shifts.
+     */
+    double offset = 0.5 * (before - after) / curvature;
+    if (offset > 0.5)
+    {
+        offset = 0.5;
+    }
+    else if (offset < -0.5)
+    {
+        offset = -0.5;
+    }
+
+    return offset;
+}
+
+/**
+ * Initializes a calibration that leaves every channel as measured.
+ *
+ * @param[out] calibration The calibration to initialize.
+ *
+ * @return None.
+ */
+void init_channel_calibration(channel_calibration_t *calibration)
+{
+    for (size_t k = 0; k < 4; ++k)
+    {
+        calibration->delay_ns[k] = 0;
+        calibration->gain[k] = 1;
+    }
+}
+
+/**
+ * Finds the skew that the calibration adds to the delay of one channel
+ * relative to another.
+ *
+ * @param calibration The calibration, or NULL.
+ * @param from The channel that the delay is measured from.
+ * @param to The channel whose delay is measured.
+ * @param sampling_frequency The sampling frequency of the data.
+ *
+ * @return The skew in samples.
+ */
+static double calibrated_skew(const channel_calibration_t *calibration,
+                              const size_t from,
+                              const size_t to,
+                              const uint32_t sampling_frequency)
+{
+    if (!calibration)
+    {
+        return 0;
+    }
+
+    return (calibration->delay_ns[to] - calibration->delay_ns[from]) * 1e-9 * sampling_frequency;
+}
+
+/**
+ * Measures the energy and peak of each channel so that correlation peaks can
+ * be normalized into a confidence.
+ *
+ * @note The energy is summed as an integer, which is exact and avoids double
+ *       precision arithmetic for every sample. The confidence does not
+ *       depend on the gain of a channel, so only the peak amplitudes are
+ *       calibrated.
+ *
+ * @param view The channels that were correlated.
+ * @param calibration The calibration of the peak amplitudes, or NULL.
+ * @param[out] energy The sum of the squared samples of each channel.
+ * @param[out] result The result to store the peak amplitudes in. Its
+ *        quality is reset to full until the caller estimates it, and its
+ *        delays are marked as correlated.
+ *
+ * @return None.
+ */
+static void measure_channels(const channel_view_t *view,
+                             const channel_calibration_t *calibration,
+                             double energy[4],
+                             correlation_result_t *result)
+{
+    result->quality = 1;
+    result->leading_edge = false;
+    result->edge_uncertainty_ns = 0;
+
+    for (size_t k = 0; k < 4; ++k)
+    {
+        int64_t sum = 0;
+        result->peak_amplitude[k] = 0;
+
+        for (size_t i = 0; i < view->len; ++i)
+        {
+            const int32_t value = view->channel[k][i * view->stride];
+            const analog_sample_t magnitude = (value < 0)? -1 * value : value;
+            sum += value * value;
+            if (magnitude > result->peak_amplitude[k])
+            {
+                result->peak_amplitude[k] = magnitude;
+            }
+        }
+
+        energy[k] = sum;
+        if (calibration)
+        {
+            const float peak = result->peak_amplitude[k] * calibration->gain[k];
+            result->peak_amplitude[k] = (peak < INT16_MAX)? (analog_sample_t)peak : INT16_MAX;
+        }
+    }
+}
+
+/**
+ * Finds the delay of one pair of channels from its correlation peak. The peak
+ * is refined to a fraction of a sample from its neighbouring lags, and the
+ * calibrated skew of the pair is removed.
+ *
+ * @param correlations The correlation results, ordered by decreasing shift.
+ * @param num_correlations The number of correlation results.
+ * @param channel The channel of the correlation to evaluate.
+ * @param norm The geometric mean of the energies of the pair.
+ * @param skew The skew of the second channel of the pair in samples.
+ * @param[out] delay The delay of the second channel of the pair in samples.
+ * @param[out] confidence The normalized correlation peak.
+ *
+ * @return None.
+ */
+static void evaluate_pair(const correlation_t *correlations,
+                          const size_t num_correlations,
+                          const size_t channel,
+                          const double norm,
+                          const double skew,
+                          double *delay,
+                          float *confidence)
+{
+    size_t peak = 0;
+    for (size_t j = 0; j < num_correlations; ++j)
+    {
+        if (correlations[j].result[channel] > correlations[peak].result[channel])
+        {
+            peak = j;
+        }
+    }
+
+    *confidence = (norm > 0)?
+            correlations[peak].result[channel] * (double)(2 << 13) / norm : 0;
+    *delay = -1 * correlations[peak].left_shift +
+             interpolate_peak(correlations, num_correlations, peak, channel) - skew;
+}
+
+/**
+ * Cross correlates the channels against a chosen reference, and optionally
+ * every other pair of channels, and converts the correlation peaks into time
+ * delays.
+ *
+ * @note The delays and confidences are always relative to channel 0. With a
+ *       different reference, the delay of each channel is the difference of
+ *       its delay and the delay of channel 0 from the reference. With all
+ *       pairs, the six pairwise delays are combined by least squares, which
+ *       for a complete set of pairs is the mean of the delays to each channel.
+ *
+ * @param view The channels to correlate.
+ * @param reference The channel that the others are correlated against.
+ * @param weighting The weighting of the cross spectra, or NULL to correlate
+ *        the samples as they are.
+ * @param[out] correlations The correlation of the reference with each other
+ *             channel in ascending order for each shift.
+ * @param[out] cross_correlations The correlation of the remaining pairs of
+ *             channels for each shift, or NULL to only correlate against the
+ *             reference. The pairs are the first and second, first and third,
+ *             and second and third channels other than the reference.
+ * @param correlation_len The number of correlations that can be stored.
+ * @param[out] num_correlations The number of correlations computed.
+ * @param[out] result The delay and confidence of each channel.
+ * @param sampling_frequency The sampling frequency of the data.
+ *
+ * @return Success or fail.
+ */
+result_t cross_correlate_pairs(const channel_view_t *view,
+                               const size_t reference,
+                               const correlation_weighting_t *weighting,
+                               correlation_t *correlations,
+                               correlation_t *cross_correlations,
+                               const size_t correlation_len,
+                               size_t *num_correlations,
+                               correlation_result_t *result,
+                               const uint32_t sampling_frequency)
+{
+    AbortIfNot(view, fail);
+    AbortIfNot(result, fail);
+    AbortIfNot(view->len, fail);
+    AbortIfNot(correlations, fail);
+    AbortIfNot(num_correlations, fail);
+    AbortIfNot(reference < 4, fail);
+
+    /*
+     * Order the channels so that the reference comes first.
+     */
+    size_t order[4] = {reference};
+    for (size_t k = 0, i = 1; k < 4; ++k)
+    {
+        if (k != reference)
+        {
+            order[i++] = k;
+        }
+    }
+
+    channel_view_t ordered = *view;
+    for (size_t k = 0; k < 4; ++k)
+    {
+        ordered.channel[k] = view->channel[order[k]];
+    }
+
+    const size_t len = view->len;
+    *num_correlations = 0;
+    int32_t max_shift = correlation_max_shift(sampling_frequency);
+    if (max_shift > len - 1)
+    {
+        max_shift = len - 1;
+    }
+
+    /*
+     * Correlate the reference signal with channels A, B, and C. Long
+     * correlations are computed in the frequency domain, as are whitened
+     * correlations unless the window is too long to transform. A coarse
+     * search of the lags against the reference takes precedence over both,
+     * since it correlates only a few lags at the full rate. Tracked lags are
+     * searched first, and every lag is searched if a peak is not among them.
+     */
+    const size_t lags = 2 * max_shift;
+    AbortIfNot(lags <= correlation_len, fail);
+
+    bool phat = (weighting && weighting->phat)? true : false;
+    const bool transformable = (fft_size(len + max_shift) <= FFT_MAX_SIZE)? true : false;
+    if (phat && !transformable)
+    {
+        dbprintf("Window of %d samples is too long for PHAT.\n", len);
+        phat = false;
+    }
+
+    const size_t decimation = coarse_decimation(weighting, sampling_frequency);
+
+    bool searched = false;
+    if (!phat && !cross_correlations && weighting && weighting->track_lags)
+    {
+        AbortIfNot(tracked_correlate(&ordered,
+                                     max_shift,
+                                     weighting->lag_center,
+                                     weighting->lag_radius,
+                                     correlations,
+                                     num_correlations,
+                                     &searched), fail);
+        if (!searched)
+        {
+            dbprintf("Correlation peak is outside of the tracked lags.\n");
+            *num_correlations = 0;
+        }
+    }
+
+    if (!searched && !phat && !cross_correlations && decimation > 1)
+    {
+        AbortIfNot(coarse_correlate(&ordered,
+                                    max_shift,
+                                    decimation,
+                                    correlations,
+                                    num_correlations), fail);
+    }
+    else if (!searched && (phat || lags * len > FFT_CORRELATION_THRESHOLD) && transformable)
+    {
+        AbortIfNot(fft_correlate(&ordered,
+                                 max_shift,
+                                 weighting,
+                                 sampling_frequency,
+                                 correlations,
+                                 cross_correlations,
+                                 num_correlations), fail);
+    }
+    else if (!searched)
+    {
+        AbortIfNot(direct_correlate(&ordered,
+                                    max_shift,
+                                    (weighting)? weighting->parallel_for : NULL,
+                                    correlations,
+                                    cross_correlations,
+                                    num_correlations), fail);
+    }
+
+    const channel_calibration_t *calibration = (weighting)? weighting->calibration : NULL;
+    if (reference == 0 && !cross_correlations && !phat)
+    {
+        return evaluate_correlations(view,
+                                     correlations,
+                                     *num_correlations,
+                                     calibration,
+                                     result,
+                                     sampling_frequency);
+    }
+
+    AbortIfNot(*num_correlations, fail);
+
+    double energy[4];
+    measure_channels(view, calibration, energy, result);
+
+    /*
+     * Collect the delay from each channel to every other channel that was
+     * correlated with it.
+     */
+    double delay[4][4] = {{0}};
+    float confidence[4][4] = {{0}};
+    bool measured[4][4] = {{false}};
+    const size_t cross_pairs[3][2] = {{1, 2}, {1, 3}, {2, 3}};
+
+    for (size_t i = 0; i < 6; ++i)
+    {
+        if (i >= 3 && !cross_correlations)
+        {
+            break;
+        }
+
+        const size_t a = (i < 3)? order[0] : order[cross_pairs[i - 3][0]];
+        const size_t b = (i < 3)? order[i + 1] : order[cross_pairs[i - 3][1]];
+        const correlation_t *pair_correlations = (i < 3)? correlations : cross_correlations;
+
+        /*
+         * Whitened correlations peak at a fixed scale rather than at the
+         * product of the channel energies.
+         */
+        const double norm = (phat)? (double)PHAT_CORRELATION_SCALE * (2 << 13) :
+                sqrt(energy[a] * energy[b]);
+        evaluate_pair(pair_correlations,
+                      *num_correlations,
+                      i % 3,
+                      norm,
+                      calibrated_skew(calibration, a, b, sampling_frequency),
+                      &delay[a][b],
+                      &confidence[a][b]);
+        delay[b][a] = -1 * delay[a][b];
+        confidence[b][a] = confidence[a][b];
+        measured[a][b] = measured[b][a] = true;
+    }
+
+    double arrival[4] = {0};
+    for (size_t k = 0; k < 4; ++k)
+    {
+        if (cross_correlations)
+        {
+            for (size_t j = 0; j < 4; ++j)
+            {
+                arrival[k] += delay[j][k] / 4;
+            }
+        }
+        else
+        {
+            arrival[k] = delay[reference][k];
+        }
+    }
+
+    for (size_t i = 0; i < 3; ++i)
+    {
+        const size_t k = i + 1;
+        if (measured[0][k])
+        {
+            result->confidence[i] = confidence[0][k];
+        }
+        else
+        {
+            result->confidence[i] = (confidence[reference][k] < confidence[reference][0])?
+                    confidence[reference][k] : confidence[reference][0];
+        }
+
+        dbprintf("%d %d - ", i, (int32_t)(arrival[k] - arrival[0]));
+        result->channel_delay_ns[i] = (arrival[k] - arrival[0]) *
+                                      1000000000.0 / sampling_frequency;
+    }
+    dbprintf("\n");
+
+    return success;
+}
+
+/**
+ * Cross correlates the reference channel against channels A, B, and C and
+ * converts the correlation peaks into time delays.
+ *
+ * @param view The channels to correlate.
+ * @param[out] correlations The correlation for each shift.
+ * @param correlation_len The number of correlations that can be stored.
+ * @param[out] num_correlations The number of correlations computed.
+ * @param[out] result The delay and confidence of each channel.
+ * @param sampling_frequency The sampling frequency of the data.
+ *
+ * @return Success or fail.
+ */
+result_t cross_correlate_channels(const channel_view_t *view,
+                                  correlation_t *correlations,
+                                  const size_t correlation_len,
+                                  size_t *num_correlations,
+                                  correlation_result_t *result,
+                                  const uint32_t sampling_frequency)
+{
+    return cross_correlate_pairs(view,
+                                 0,
+                                 NULL,
+                                 correlations,
+                                 NULL,
+                                 correlation_len,
+                                 num_correlations,
+                                 result,
+                                 sampling_frequency);
+}
+
+/**
+ * Converts the correlation peaks of each channel into time delays.
+ *
+ * @param view The channels that were correlated.
+ * @param correlations The correlation for each shift, ordered by decreasing
+ *        shift.
+ * @param num_correlations The number of correlations.
+ * @param calibration The calibration of the channels, or NULL.
+ * @param[out] result The delay and confidence of each channel.
+ * @param sampling_frequency The sampling frequency of the data.
+ *
+ * @return Success or fail.
+ */
+result_t evaluate_correlations(const channel_view_t *view,
+                               const correlation_t *correlations,
+                               const size_t num_correlations,
+                               const channel_calibration_t *calibration,
+                               correlation_result_t *result,
+                               const uint32_t sampling_frequency)
+{
+    AbortIfNot(view, fail);
+    AbortIfNot(view->len, fail);
+    AbortIfNot(correlations, fail);
+    AbortIfNot(num_correlations, fail);
+    AbortIfNot(result, fail);
+
+    double energy[4];
+    measure_channels(view, calibration, energy, result);
+
+    /*
+     * Convert the max correlation index into a time measurement.
+     */
+    for (size_t i = 0; i < 3; ++i)
+    {
+        double delay;
+        evaluate_pair(correlations,
+                      num_correlations,
+                      i,
+                      sqrt(energy[0] * energy[i + 1]),
+                      calibrated_skew(calibration, 0, i + 1, sampling_frequency),
+                      &delay,
+                      &result->confidence[i]);
+        dbprintf("%d %d - ", i, (int32_t)delay);
+        result->channel_delay_ns[i] = delay * 1000000000.0 / sampling_frequency;
+    }
+    dbprintf("\n");
+
+    return success;
+}
+
 result_t cross_correlate(const sample_t *data,
                          const size_t len,
                          correlation_t *correlations,
@@ -15,169 +1714,1182 @@ result_t cross_correlate(const sample_t *data,
                          const uint32_t sampling_frequency)
 {
     AbortIfNot(data, fail);
+
+    channel_view_t view;
+    interleaved_view(data, len, &view);
+
+    return cross_correlate_channels(&view,
+                                    correlations,
+                                    correlation_len,
+                                    num_correlations,
+                                    result,
+                                    sampling_frequency);
+}
+
+/**
+ * Creates a view of the channels of interleaved samples.
+ *
+ * @param data The samples to view.
+ * @param len The number of samples.
+ * @param[out] view The view of the channels.
+ *
+ * @return None.
+ */
+void interleaved_view(const sample_t *data, const size_t len, channel_view_t *view)
+{
+    for (size_t k = 0; k < 4; ++k)
+    {
+        view->channel[k] = &data[0].sample[k];
+    }
+
+    view->stride = 4;
+    view->len = len;
+}
+
+/**
+ * Creates a view of a range of a capture stored per channel.
+ *
+ * @param planar The capture to view.
+ * @param start The first sample of the view.
+ * @param len The number of samples.
+ * @param[out] view The view of the channels.
+ *
+ * @return None.
+ */
+void planar_view(const planar_samples_t *planar,
+                 const size_t start,
+                 const size_t len,
+                 channel_view_t *view)
+{
+    for (size_t k = 0; k < 4; ++k)
+    {
+        view->channel[k] = &planar->channel[k][start];
+    }
+
+    view->stride = 1;
+    view->len = len;
+}
+
+/**
+ * Finds the largest shift between the reference and another hydrophone.
+ *
+ * @param sampling_frequency The sampling frequency of the data.
+ *
+ * @return The largest shift in samples.
+ */
+int32_t correlation_max_shift(const uint32_t sampling_frequency)
+{
+    return MAX_TIME_BETWEEN_PHONES * sampling_frequency;
+}
+
+/**
+ * Finds the number of correlation results produced for a sample rate.
+ *
+ * @param sampling_frequency The sampling frequency of the data.
+ *
+ * @return The number of lags correlated.
+ */
+size_t correlation_capacity(const uint32_t sampling_frequency)
+{
+    return 2 * correlation_max_shift(sampling_frequency);
+}
+
+/**
+ * Selects the weighting of the cross spectra for the operating parameters.
+ * The phase transform keeps only the band around the pinger when its
+ * frequency is known, since whitening would otherwise amplify the noise
+ * outside the band as much as the ping. The coarse lag search likewise keeps
+ * the band of the pinger.
+ *
+ * @param params The operating parameters.
+ * @param[out] weighting The weighting to correlate with.
+ *
+ * @return None.
+ */
+void get_correlation_weighting(const HydroZynqParams *params, correlation_weighting_t *weighting)
+{
+    weighting->phat = params->phat;
+    weighting->low_hz = 0;
+    weighting->high_hz = 0;
+    if (params->ping_frequency)
+    {
+        weighting->low_hz = (params->ping_frequency > PHAT_BANDWIDTH_HZ / 2)?
+                params->ping_frequency - PHAT_BANDWIDTH_HZ / 2 : 0;
+        weighting->high_hz = params->ping_frequency + PHAT_BANDWIDTH_HZ / 2;
+    }
+
+    weighting->track_lags = false;
+    weighting->parallel_for = NULL;
+    weighting->calibration = NULL;
+    weighting->coarse_max_hz = 0;
+    if (params->coarse_search)
+    {
+        weighting->coarse_max_hz = (params->ping_frequency)?
+                params->ping_frequency + PINGER_BANDWIDTH_HZ / 2 : COARSE_SEARCH_MAX_PINGER_HZ;
+    }
+}
+
+/**
+ * The number of samples between renormalizations of the local oscillator.
+ */
+#define TONE_RENORMALIZE_INTERVAL 64
+
+/**
+ * Initializes a narrowband ping detector.
+ *
+ * @param[out] detector The detector to initialize.
+ * @param frequency The frequency of the pinger in Hz, or zero to disable
+ *        narrowband detection.
+ * @param sampling_frequency The sampling frequency of the data.
+ *
+ * @return Success or fail.
+ */
+result_t init_tone_detector(tone_detector_t *detector,
+                            const uint32_t frequency,
+                            const uint32_t sampling_frequency)
+{
+    AbortIfNot(detector, fail);
+    AbortIfNot(sampling_frequency, fail);
+    AbortIfNot(frequency < sampling_frequency / 2, fail);
+
+    const float w = 2 * PI * (float)frequency / sampling_frequency;
+    detector->enabled = (frequency > 0)? true : false;
+    detector->phase_re = 1;
+    detector->phase_im = 0;
+    detector->step_re = cosf(w);
+    detector->step_im = -1 * sinf(w);
+    for (size_t k = 0; k < 2; ++k)
+    {
+        detector->i[k] = 0;
+        detector->q[k] = 0;
+    }
+
+    detector->alpha = 1 - expf(-2 * PI * (float)TONE_DETECTOR_BANDWIDTH_HZ / sampling_frequency);
+    detector->offset = 0;
+
+    return success;
+}
+
+/**
+ * Searches the reference channel for the pinger tone.
+ *
+ * @note The detector keeps its state between calls so that data may be
+ *       supplied in chunks. Detection lags the ping onset by roughly the
+ *       time constant of the detector bandwidth.
+ *
+ * @param detector The detector to run.
+ * @param reference The first sample of the reference channel.
+ * @param stride The distance between consecutive reference samples.
+ * @param len The number of samples.
+ * @param threshold The tone amplitude that denotes a ping.
+ * @param[out] found Specified true if the tone exceeded the threshold.
+ * @param[out] index The index of the first sample above the threshold.
+ * @param[in,out] max_amplitude The largest tone amplitude encountered.
+ *
+ * @return Success or fail.
+ */
+result_t detect_tone_channel(tone_detector_t *detector,
+                             const analog_sample_t *reference,
+                             const size_t stride,
+                             const size_t len,
+                             const analog_sample_t threshold,
+                             bool *found,
+                             size_t *index,
+                             analog_sample_t *max_amplitude)
+{
+    AbortIfNot(detector, fail);
+    AbortIfNot(reference, fail);
+    AbortIfNot(found, fail);
+    AbortIfNot(index, fail);
+    AbortIfNot(max_amplitude, fail);
+
+    *found = false;
+
+    /*
+     * A tone of amplitude A settles at a baseband magnitude of A / 2.
+     */
+    const float threshold_power = (float)threshold * threshold / 4;
+    float max_power = (float)*max_amplitude * *max_amplitude / 4;
+    if (*max_amplitude < 0)
+    {
+        max_power = 0;
+    }
+
+    float phase_re = detector->phase_re, phase_im = detector->phase_im;
+    float i_mix = detector->i[0], q_mix = detector->q[0];
+    float i_filt = detector->i[1], q_filt = detector->q[1];
+    const float alpha = detector->alpha;
+    const float offset = detector->offset;
+    for (size_t n = 0; n < len; ++n)
+    {
+        const float x = reference[n * stride] - offset;
+        i_mix += alpha * (x * phase_re - i_mix);
+        q_mix += alpha * (x * phase_im - q_mix);
+        i_filt += alpha * (i_mix - i_filt);
+        q_filt += alpha * (q_mix - q_filt);
+
+        const float re = phase_re * detector->step_re - phase_im * detector->step_im;
+        phase_im = phase_re * detector->step_im + phase_im * detector->step_re;
+        phase_re = re;
+
+        if (n % TONE_RENORMALIZE_INTERVAL == 0)
+        {
+            const float scale = (3 - (phase_re * phase_re + phase_im * phase_im)) / 2;
+            phase_re *= scale;
+            phase_im *= scale;
+        }
+
+        const float power = i_filt * i_filt + q_filt * q_filt;
+        if (power > max_power)
+        {
+            max_power = power;
+        }
+
+        if (power > threshold_power)
+        {
+            *found = true;
+            *index = n;
+            break;
+        }
+    }
+
+    detector->phase_re = phase_re;
+    detector->phase_im = phase_im;
+    detector->i[0] = i_mix;
+    detector->q[0] = q_mix;
+    detector->i[1] = i_filt;
+    detector->q[1] = q_filt;
+
+    const float amplitude = 2 * sqrtf(max_power);
+    *max_amplitude = (amplitude > INT16_MAX)? INT16_MAX : (analog_sample_t)amplitude;
+
+    return success;
+}
+
+/**
+ * Searches the reference channel of interleaved samples for the pinger tone.
+ *
+ * @see detect_tone_channel()
+ *
+ * @return Success or fail.
+ */
+result_t detect_tone(tone_detector_t *detector,
+                     const sample_t *data,
+                     const size_t len,
+                     const analog_sample_t threshold,
+                     bool *found,
+                     size_t *index,
+                     analog_sample_t *max_amplitude)
+{
+    AbortIfNot(data, fail);
+
+    return detect_tone_channel(detector,
+                               data[0].sample,
+                               4,
+                               len,
+                               threshold,
+                               found,
+                               index,
+                               max_amplitude);
+}
+
+/**
+ * Finds the leading edge of the direct path on each channel, where its
+ * rectified and smoothed envelope first reaches a fraction of its peak. The
+ * crossing is interpolated between the samples on either side of it.
+ *
+ * @param view The channels of the capture.
+ * @param start The first sample of the window.
+ * @param end The last sample of the window.
+ * @param noise The offset of each channel, or NULL if the capture has
+ *        already been normalized.
+ * @param sampling_frequency The sampling frequency of the data.
+ * @param[out] edges The leading edge of each channel.
+ *
+ * @return None.
+ */
+static void find_leading_edges(const channel_view_t *view,
+                               const size_t start,
+                               const size_t end,
+                               const noise_stats_t *noise,
+                               const uint32_t sampling_frequency,
+                               leading_edges_t *edges)
+{
+    const size_t stride = view->stride;
+    const float alpha = 1 - expf(-1.0f / (sampling_frequency * ENVELOPE_SMOOTHING_US * 1e-6f));
+
+    for (size_t k = 0; k < 4; ++k)
+    {
+        const analog_sample_t *channel = view->channel[k];
+        const float offset = (noise)? noise->mean[k] : 0;
+
+        /*
+         * The peak of the envelope is found first so that the leading edge
+         * can be taken relative to it on a second pass.
+         */
+        float envelope = 0, peak = 0;
+        for (size_t i = start; i <= end; ++i)
+        {
+            envelope += alpha * (fabsf(channel[i * stride] - offset) - envelope);
+            peak = (envelope > peak)? envelope : peak;
+        }
+
+        /*
+         * The samples before the crossing are taken as noise, which the
+         * envelope smooths by the square root of alpha / (2 - alpha), so the
+         * timing of the crossing is as uncertain as the smoothed noise is
+         * large against the rise of the envelope.
+         */
+        const float threshold = peak * ENVELOPE_ONSET_PERCENT / 100;
+        const float smoothing = sqrtf(alpha / (2 - alpha));
+        float previous = 0, sum = 0, sum_squares = 0;
+        envelope = 0;
+        edges->index[k] = end;
+        edges->position[k] = end;
+        edges->uncertainty[k] = end - start;
+        for (size_t i = start; i <= end; ++i)
+        {
+            const float magnitude = fabsf(channel[i * stride] - offset);
+            previous = envelope;
+            envelope += alpha * (magnitude - envelope);
+            if (envelope >= threshold)
+            {
+                const float rise = envelope - previous;
+                const size_t count = i - start;
+                const float mean = (count)? sum / count : threshold;
+                const float variance = (count)? sum_squares / count - mean * mean : threshold * threshold;
+                const float noise_level = sqrtf((variance > 0)? variance : 0) * smoothing;
+                edges->index[k] = i;
+                edges->position[k] = (rise > 0)? i - 1 + (threshold - previous) / rise : i;
+                edges->uncertainty[k] = (rise > 0)? noise_level / rise : end - start;
+                break;
+            }
+
+            sum += magnitude;
+            sum_squares += magnitude * magnitude;
+        }
+    }
+}
+
+/**
+ * Trims a window to the direct path of the ping, spanning the leading edges
+ * of the channels.
+ *
+ * @param edges The leading edge of each channel within the window.
+ * @param[in,out] start_index The first sample of the window.
+ * @param[in,out] end_index The last sample of the window.
+ * @param[out] onset_index The earliest leading edge.
+ * @param sampling_frequency The sampling frequency of the data.
+ *
+ * @return Success or fail.
+ */
+static result_t trim_to_onset(const leading_edges_t *edges,
+                              size_t *start_index,
+                              size_t *end_index,
+                              size_t *onset_index,
+                              const uint32_t sampling_frequency)
+{
+    const size_t start = *start_index;
+    const size_t end = *end_index;
+
+    size_t first_onset = end, last_onset = start;
+    for (size_t k = 0; k < 4; ++k)
+    {
+        first_onset = (edges->index[k] < first_onset)? edges->index[k] : first_onset;
+        last_onset = (edges->index[k] > last_onset)? edges->index[k] : last_onset;
+    }
+    AbortIfNot(first_onset <= last_onset, fail);
+
+    const size_t guard = (uint64_t)sampling_frequency * ENVELOPE_GUARD_US / 1000000;
+    const size_t direct_path = (uint64_t)sampling_frequency * ENVELOPE_DIRECT_PATH_US / 1000000;
+    *start_index = (first_onset > start + guard)? first_onset - guard : start;
+    *end_index = (last_onset + direct_path < end)? last_onset + direct_path : end;
+    *onset_index = first_onset;
+
+    return success;
+}
+
+/**
+ * Locates the ping within a capture and selects the window to correlate.
+ *
+ * @note Only the reference channel is read unless the ping may be detected on
+ *       any channel, in which case the earliest detection is used. Trimming
+ *       the window to the envelope onset reads every channel of the window.
+ *
+ * @param view The channels of the capture.
+ * @param[out] start_index The first sample of the window.
+ * @param[out] end_index The last sample of the window.
+ * @param[out] ping_index The sample the ping was detected at, or NULL.
+ * @param[out] found Specified true if the ping was located.
+ * @param[out] edges The leading edge of each channel within the window
+ *             before it is trimmed, or NULL if they are only needed to trim
+ *             it.
+ * @param params The detection thresholds and window durations.
+ * @param noise The offset and noise of each channel, or NULL if the capture
+ *        has already been normalized.
+ * @param sampling_frequency The sampling frequency of the data.
+ *
+ * @return Success or fail.
+ */
+result_t truncate_channels(const channel_view_t *view,
+                           size_t *start_index,
+                           size_t *end_index,
+                           size_t *ping_index,
+                           bool *found,
+                           leading_edges_t *edges,
+                           const HydroZynqParams params,
+                           const noise_stats_t *noise,
+                           const uint32_t sampling_frequency)
+{
+    AbortIfNot(view, fail);
+    AbortIfNot(found, fail);
+    AbortIfNot(start_index, fail);
+    AbortIfNot(end_index, fail);
+
+    AbortIfNot(params.reference_channel < 4, fail);
+
+    const size_t len = view->len;
+    const size_t stride = view->stride;
+    size_t ping_start_index = len;
+    *found = false;
+
+    /*
+     * Search the reference channel, or every channel for the earliest
+     * detection if the reference may be shadowed.
+     */
+    const size_t first_channel = (params.trigger_any_channel)? 0 : params.reference_channel;
+    const size_t last_channel = (params.trigger_any_channel)? 3 : params.reference_channel;
+
+    for (size_t k = first_channel; k <= last_channel; ++k)
+    {
+        const analog_sample_t *channel = view->channel[k];
+
+        /*
+         * Compare against the estimated offset of the channel and, if
+         * requested, a threshold relative to its noise.
+         */
+        analog_sample_t offset = 0;
+        analog_sample_t threshold = params.ping_threshold;
+        if (noise)
+        {
+            offset = lroundf(noise->mean[k]);
+            if (params.noise_threshold)
+            {
+                const float relative = params.noise_threshold * get_noise_rms(noise, k);
+                threshold = (relative > INT16_MAX)? INT16_MAX : (analog_sample_t)relative;
+            }
+        }
+
+        tone_detector_t tone;
+        AbortIfNot(init_tone_detector(&tone, params.ping_frequency, sampling_frequency), fail);
+        tone.offset = offset;
+        if (tone.enabled)
+        {
+            bool detected = false;
+            size_t index = 0;
+            analog_sample_t amplitude = 0;
+            AbortIfNot(detect_tone_channel(&tone,
+                                           channel,
+                                           stride,
+                                           len,
+                                           threshold,
+                                           &detected,
+                                           &index,
+                                           &amplitude), fail);
+            if (detected && index < ping_start_index)
+            {
+                dbprintf("Found tone %d on channel %d at index %d\n", amplitude, k, index);
+                ping_start_index = index;
+                *found = true;
+            }
+
+            continue;
+        }
+
+        /*
+         * A CFAR threshold follows the noise floor of the channel in place
+         * of a fixed level.
+         */
+        if (params.cfar_threshold)
+        {
+            cfar_detector_t cfar;
+            init_cfar_detector(&cfar, params.cfar_threshold, offset);
+
+            bool crossed = false;
+            size_t index = 0;
+            AbortIfNot(run_cfar_detector(&cfar, channel, stride, ping_start_index, &crossed, &index), fail);
+            if (crossed)
+            {
+                dbprintf("Found %d on channel %d index %d above noise level %d\n",
+                        channel[index * stride] - offset, k, index, get_cfar_level(&cfar));
+                ping_start_index = index;
+                *found = true;
+            }
+
+            continue;
+        }
+
+        /*
+         * Only the samples before an earlier detection need to be searched.
+         */
+        const int32_t limit = (int32_t)threshold + offset;
+        if (limit >= INT16_MAX)
+        {
+            continue;
+        }
+
+        bool crossed = false;
+        size_t index = 0;
+        AbortIfNot(scan_channel(channel,
+                                stride,
+                                ping_start_index,
+                                (limit < INT16_MIN)? INT16_MIN : limit,
+                                &crossed,
+                                &index,
+                                NULL), fail);
+        if (crossed)
+        {
+            dbprintf("Found %d on channel %d index %d\n", channel[index * stride] - offset, k, index);
+            ping_start_index = index;
+            *found = true;
+        }
+    }
+
+    if (!*found)
+    {
+        return success;
+    }
+
+    const size_t indices_before_start = ticks_to_samples(params.pre_ping_duration, sampling_frequency);
+    if (indices_before_start > ping_start_index)
+    {
+        *start_index = 0;
+    }
+    else
+    {
+        *start_index = ping_start_index - indices_before_start;
+    }
+
+    *end_index = ping_start_index + ticks_to_samples(params.post_ping_duration, sampling_frequency);
+    if (*end_index >= len)
+    {
+        *end_index = len - 1;
+    }
+
+    if (params.envelope_onset || edges)
+    {
+        leading_edges_t found_edges;
+        find_leading_edges(view, *start_index, *end_index, noise, sampling_frequency, &found_edges);
+        if (edges)
+        {
+            *edges = found_edges;
+        }
+
+        if (params.envelope_onset)
+        {
+            AbortIfNot(trim_to_onset(&found_edges,
+                                     start_index,
+                                     end_index,
+                                     &ping_start_index,
+                                     sampling_frequency), fail);
+        }
+    }
+
+    if (ping_index)
+    {
+        *ping_index = ping_start_index;
+    }
+
+    return success;
+}
+
+result_t truncate(const sample_t *data,
+                  const size_t len,
+                  size_t *start_index,
+                  size_t *end_index,
+                  bool *found,
+                  const HydroZynqParams params,
+                  const uint32_t sampling_frequency)
+{
+    AbortIfNot(data, fail);
+
+    channel_view_t view;
+    interleaved_view(data, len, &view);
+
+    return truncate_channels(&view, start_index, end_index, NULL, found, NULL, params, NULL, sampling_frequency);
+}
+
+/**
+ * Takes the delays of channels A, B, and C from the differences of their
+ * leading edges to that of channel 0, without correlating the channels.
+ *
+ * @note This only reads the window once to measure the peak amplitudes, so
+ *       it is far cheaper than a correlation, but a leading edge is only as
+ *       precise as the envelope rises above the noise and it is moved by a
+ *       reflection that arrives within the rise.
+ *
+ * @param view The channels of the window.
+ * @param edges The leading edge of each channel, in samples of the capture
+ *        that the window was cut from.
+ * @param calibration The calibration of the channels, or NULL.
+ * @param[out] result The delay and confidence of each channel.
+ * @param sampling_frequency The sampling frequency of the data.
+ *
+ * @return Success or fail.
+ */
+result_t estimate_edge_delays(const channel_view_t *view,
+                              const leading_edges_t *edges,
+                              const channel_calibration_t *calibration,
+                              correlation_result_t *result,
+                              const uint32_t sampling_frequency)
+{
+    AbortIfNot(view, fail);
+    AbortIfNot(edges, fail);
     AbortIfNot(result, fail);
-    AbortIfNot(len, fail);
-    AbortIfNot(correlations, fail);
-    AbortIfNot(num_correlations, fail);
+    AbortIfNot(sampling_frequency, fail);
 
-    *num_correlations = 0;
-    int32_t max_shift = MAX_SAMPLES_BETWEEN_PHONES;
-    if (max_shift > len - 1)
+    double energy[4];
+    measure_channels(view, calibration, energy, result);
+
+    float max_uncertainty = 0;
+    for (size_t i = 0; i < 3; ++i)
     {
-        max_shift = len - 1;
+        const size_t k = i + 1;
+        const double delay = edges->position[k] - edges->position[0] -
+                             calibrated_skew(calibration, 0, k, sampling_frequency);
+        const float uncertainty = sqrtf(edges->uncertainty[0] * edges->uncertainty[0] +
+                                        edges->uncertainty[k] * edges->uncertainty[k]);
+
+        result->channel_delay_ns[i] = delay * 1000000000.0 / sampling_frequency;
+        result->confidence[i] = 1 / (1 + uncertainty);
+        max_uncertainty = (uncertainty > max_uncertainty)? uncertainty : max_uncertainty;
     }
 
-    /*
-     * Correlate the reference signal with channels A, B, and C.
-     */
-    for (int32_t lshift = max_shift; lshift > -1 * max_shift; lshift--)
+    result->leading_edge = true;
+    result->edge_uncertainty_ns = max_uncertainty * 1e9f / sampling_frequency;
+
+    return success;
+}
+
+/**
+ * Estimates the quality of a located ping from its truncated window. The
+ * noise is measured before the onset and the signal after it, and flattened
+ * extremes are counted as clipping.
+ *
+ * @note Clipping is detected on the processed samples, so it is found by the
+ *       flat tops that the saturated ADC leaves rather than by the ADC rails.
+ *
+ * @param view The window of samples, with the offset removed.
+ * @param onset The index of the ping onset within the window.
+ * @param reference The channel that the onset is measured on.
+ * @param sampling_frequency The sampling frequency of the data.
+ * @param[out] quality The estimated quality of the ping.
+ *
+ * @return Success or fail.
+ */
+result_t assess_ping(const channel_view_t *view,
+                     const size_t onset,
+                     const size_t reference,
+                     const uint32_t sampling_frequency,
+                     ping_quality_t *quality)
+{
+    AbortIfNot(view, fail);
+    AbortIfNot(quality, fail);
+    AbortIfNot(reference < 4, fail);
+    AbortIfNot(onset < view->len, fail);
+
+    const size_t len = view->len;
+    const size_t stride = view->stride;
+    const bool measure_noise = (onset >= PING_QUALITY_MIN_NOISE_SAMPLES)? true : false;
+
+    size_t onset_end = onset + (uint64_t)sampling_frequency * PING_QUALITY_ONSET_US / 1000000;
+    if (onset_end > len)
     {
-        /*
-         * Grab the start and end indices of the unshifted signal for the
-         * correlation.
-         */
-        (*num_correlations)++;
-        size_t c_index = max_shift - lshift;
-        correlations[c_index].left_shift = lshift;
+        onset_end = len;
+    }
 
-        size_t start_index, end_index;
-        if (lshift >= 0)
-        {
-            start_index = 0;
-            end_index = len - lshift;
-        }
-        else
+    float min_snr_db = 0;
+    quality->clipped_samples = 0;
+    quality->onset_sharpness = 0;
+    for (size_t k = 0; k < 4; ++k)
+    {
+        const analog_sample_t *channel = view->channel[k];
+
+        int64_t noise_energy = 0;
+        for (size_t i = 0; i < onset; ++i)
         {
-            start_index = -1 * lshift;
-            end_index = len;
+            const int32_t value = channel[i * stride];
+            noise_energy += value * value;
         }
 
-        /*
-         * Set the initial correlation values to zero.
-         */
-        for (size_t k = 0; k< 4; ++ k)
+        int64_t signal_energy = 0;
+        analog_sample_t low = channel[onset * stride], high = low;
+        int32_t onset_peak = 0, peak = 0;
+        for (size_t i = onset; i < len; ++i)
         {
-            correlations[c_index].result[k] = 0;
+            const int32_t value = channel[i * stride];
+            const int32_t magnitude = (value < 0)? -1 * value : value;
+            signal_energy += value * value;
+            low = (value < low)? value : low;
+            high = (value > high)? value : high;
+            peak = (magnitude > peak)? magnitude : peak;
+            if (i < onset_end)
+            {
+                onset_peak = peak;
+            }
         }
 
         /*
-         * Perform the actual correlation with the given channel sample
-         * left-shift.
+         * A second pass counts the samples that sit flat at either extreme.
          */
-        double correlation[3] = {0, 0, 0};
-        for (size_t i = start_index; i < end_index; ++i)
+        for (size_t i = onset + 1; i < len; ++i)
         {
-            for (size_t k = 0; k < 3; ++k)
+            const analog_sample_t value = channel[i * stride];
+            if ((value == low || value == high) && value == channel[(i - 1) * stride])
             {
-                correlation[k] += data[i].sample[0] * data[i + lshift].sample[k + 1];
+                quality->clipped_samples++;
             }
         }
 
         /*
-         * Scale the analog raw data points to voltage readings to keep them in
-         * range of a 32-bit number. Note that since we multiplied two raw
-         * readings, we need to divide by two raw readings - hence the
-         * multiplication.
+         * A power of one count squared is added to each side so that a silent
+         * channel has a finite ratio.
          */
-        for (size_t k = 0; k < 3; ++k)
+        if (measure_noise)
         {
-            correlations[c_index].result[k] = correlation[k] / ((2 << 13));
+            const float noise_power = (float)noise_energy / onset + 1;
+            const float signal_power = (float)signal_energy / (len - onset) + 1;
+            const float snr_db = 10 * log10f(signal_power / noise_power);
+            min_snr_db = (k == 0 || snr_db < min_snr_db)? snr_db : min_snr_db;
         }
-    }
 
-    /*
-     * Loop through the results and find the maximum location of the correlation.
-     */
-    int32_t max_correlation_indices[3] = {0};
-    for (int32_t i = max_shift; i > -1 * max_shift; --i)
-    {
-        int j = max_shift - i;
-        for (size_t k = 0; k < 3; ++k)
+        if (k == reference && peak)
         {
-            if (correlations[j].result[k] > correlations[max_correlation_indices[k]].result[k])
-            {
-                max_correlation_indices[k] = j;
-            }
+            quality->onset_sharpness = (float)onset_peak / peak;
         }
     }
+    quality->snr_db = min_snr_db;
 
     /*
-     * Convert the max correlation index into a time measurement.
+     * Each measure scales the score between 0 and 1. The onset only halves
+     * the score, since a ping may build up over several cycles.
      */
-    for (size_t i = 0; i < 3; ++i)
+    float snr_score = 1;
+    if (measure_noise)
     {
-        int32_t num_samples_right_shifted = -1 * correlations[max_correlation_indices[i]].left_shift;
-        dbprintf("%d %d - ", i, num_samples_right_shifted);
-        result->channel_delay_ns[i] = num_samples_right_shifted * 1000000000.0 / sampling_frequency;
+        snr_score = (min_snr_db - PING_QUALITY_FLOOR_SNR_DB) /
+                (PING_QUALITY_FULL_SNR_DB - PING_QUALITY_FLOOR_SNR_DB);
+        snr_score = (snr_score < 0)? 0 : (snr_score > 1)? 1 : snr_score;
     }
-    dbprintf("\n");
+
+    const float clip_score = (quality->clipped_samples >= PING_QUALITY_CLIP_LIMIT)? 0 :
+            1 - (float)quality->clipped_samples / PING_QUALITY_CLIP_LIMIT;
+
+    quality->score = snr_score * clip_score * (0.5f + 0.5f * quality->onset_sharpness);
 
     return success;
 }
 
-size_t ticks_to_samples(tick_t ticks, const uint32_t sampling_frequency)
+/**
+ * The number of fractional bits samples carry inside the filter. The rest of
+ * the 32 bits must hold the peak between sections, which for the highpass
+ * filter reaches about 131 times the input, so 10 bits leave room for any
+ * 14-bit sample. More bits would saturate a normal ping.
+ */
+#define FILTER_SAMPLE_SHIFT 10
+
+/**
+ * Converts a filter coefficient into half-scale Q31.
+ *
+ * @param value The coefficient to convert.
+ *
+ * @return The fixed-point coefficient.
+ */
+static int32_t to_half_q31(const double value)
 {
-    return (size_t)(ticks * sampling_frequency / (float)CPU_CLOCK_HZ);
+    const double scaled = value * (1 << 30);
+    if (scaled >= 2147483647.0)
+    {
+        return INT32_MAX;
+    }
+    else if (scaled <= -2147483648.0)
+    {
+        return INT32_MIN;
+    }
+
+    return (int32_t)((scaled >= 0)? scaled + 0.5 : scaled - 0.5);
 }
 
-result_t truncate(const sample_t *data,
-                  const size_t len,
-                  size_t *start_index,
-                  size_t *end_index,
-                  bool *found,
-                  const HydroZynqParams params,
-                  const uint32_t sampling_frequency)
+#ifndef __ARM_NEON
+/**
+ * Scalar equivalent of the NEON saturating rounding doubling multiply high.
+ *
+ * @param a The first operand.
+ * @param b The second operand.
+ *
+ * @return The rounded high half of 2 * a * b.
+ */
+static int32_t qrdmulh(const int32_t a, const int32_t b)
 {
-    AbortIfNot(data, fail);
-    AbortIfNot(found, fail);
-    AbortIfNot(start_index, fail);
-    AbortIfNot(end_index, fail);
+    const int64_t product = ((int64_t)a * b + (1LL << 30)) >> 31;
+    if (product > INT32_MAX)
+    {
+        return INT32_MAX;
+    }
 
-    size_t ping_start_index;
-    *found = false;
-    for (size_t i = 0; i < len; ++i)
+    return (int32_t)product;
+}
+
+/**
+ * Saturates a 64-bit value into a 32-bit integer.
+ *
+ * @param value The value to saturate.
+ *
+ * @return The saturated value.
+ */
+static int32_t saturate32(const int64_t value)
+{
+    if (value > INT32_MAX)
+    {
+        return INT32_MAX;
+    }
+    else if (value < INT32_MIN)
+    {
+        return INT32_MIN;
+    }
+
+    return (int32_t)value;
+}
+#endif
+
+/**
+ * Prepares a fixed-point biquad cascade from floating point coefficients.
+ * The cascade fails to prepare if a section is unstable or its normalized
+ * coefficients cannot be represented.
+ *
+ * @param[out] cascade The cascade to initialize.
+ * @param coeffs The biquad coefficients of each section as b0, b1, b2, a0, a1,
+ *        a2.
+ * @param filter_order The number of sections.
+ *
+ * @return Success or fail.
+ */
+result_t init_biquad_cascade(biquad_cascade_t *cascade,
+                             const filter_coefficients_t *coeffs,
+                             const size_t filter_order)
+{
+    AbortIfNot(cascade, fail);
+    AbortIfNot(coeffs || filter_order == 0, fail);
+    AbortIfNot(filter_order <= MAX_FILTER_SECTIONS, fail);
+
+    /*
+     * Normalize the filter coefficients by A0 and convert them to fixed point.
+     * Each normalized coefficient must be representable, and the poles of
+     * each section must lie inside the unit circle.
+     */
+    for (size_t f = 0; f < filter_order; ++f)
     {
-        for (size_t k = 0; k < 1; ++k)
+        const double reference_coefficient = coeffs[f].coefficients[3];
+        AbortIfNot(reference_coefficient != 0, fail);
+
+        double normalized[6];
+        for (size_t i = 0; i < 6; ++i)
         {
-            if (!*found && data[i].sample[k] > params.ping_threshold)
-            {
-                dbprintf("Found %d on channel %d index %d\n", data[i].sample[k], k, i);
-                ping_start_index = i;
-                *found = true;
-                break;
-            }
+            normalized[i] = coeffs[f].coefficients[i] / reference_coefficient;
+            AbortIfNot(normalized[i] > -2 && normalized[i] < 2, fail);
         }
+        AbortIfNot(normalized[5] < 1 && fabs(normalized[4]) < 1 + normalized[5], fail);
 
-        if (*found)
+        fixed_biquad_t *section = &cascade->sections[f];
+        section->b0 = to_half_q31(normalized[0]);
+        section->b1 = to_half_q31(normalized[1]);
+        section->b2 = to_half_q31(normalized[2]);
+        section->a1 = to_half_q31(normalized[4]);
+        section->a2 = to_half_q31(normalized[5]);
+    }
+
+    cascade->num_sections = filter_order;
+    reset_biquad_cascade(cascade);
+
+    return success;
+}
+
+/**
+ * Clears the input and output history of a cascade, so that the next samples
+ * are filtered from rest.
+ *
+ * @param cascade The cascade to reset.
+ *
+ * @return None.
+ */
+void reset_biquad_cascade(biquad_cascade_t *cascade)
+{
+    for (size_t f = 0; f < cascade->num_sections; ++f)
+    {
+        fixed_biquad_t *section = &cascade->sections[f];
+        for (size_t c = 0; c < 4; ++c)
         {
-            break;
+            section->x1[c] = section->x2[c] = 0;
+            section->y1[c] = section->y2[c] = 0;
         }
     }
+}
 
-    if (!*found)
+/**
+ * Filters all channels through biquad sections in place, continuing from the
+ * state left in the sections.
+ *
+ * @note Sections are evaluated in fixed point as Direct Form I. All cascade
+ *       sections are applied to each sample in a single pass over memory, and
+ *       with NEON the four channels are filtered in the lanes of one vector.
+ *
+ * @param sections The sections to run.
+ * @param data The samples to filter.
+ * @param len The number of samples.
+ * @param filter_order The number of sections.
+ *
+ * @return None.
+ */
+KERNEL_INLINE void biquad_kernel(fixed_biquad_t *sections,
+                                 sample_t *data,
+                                 const size_t len,
+                                 const size_t filter_order)
+{
+
+#ifdef __ARM_NEON
+    /*
+     * The input and output histories of every section, one channel per lane.
+     */
+    int32x4_t x1[MAX_FILTER_SECTIONS], x2[MAX_FILTER_SECTIONS];
+    int32x4_t y1[MAX_FILTER_SECTIONS], y2[MAX_FILTER_SECTIONS];
+    for (size_t f = 0; f < filter_order; ++f)
     {
-        return success;
+        x1[f] = vld1q_s32(sections[f].x1);
+        x2[f] = vld1q_s32(sections[f].x2);
+        y1[f] = vld1q_s32(sections[f].y1);
+        y2[f] = vld1q_s32(sections[f].y2);
     }
 
-    const size_t indices_before_start = ticks_to_samples(params.pre_ping_duration, sampling_frequency);
-    if (indices_before_start > ping_start_index)
+    for (size_t i = 0; i < len; ++i)
     {
-        *start_index = 0;
+        int32x4_t x = vshlq_n_s32(vmovl_s16(vld1_s16(data[i].sample)), FILTER_SAMPLE_SHIFT);
+
+        for (size_t f = 0; f < filter_order; ++f)
+        {
+            int32x4_t acc = vqrdmulhq_n_s32(x, sections[f].b0);
+            acc = vqaddq_s32(acc, vqrdmulhq_n_s32(x1[f], sections[f].b1));
+            acc = vqaddq_s32(acc, vqrdmulhq_n_s32(x2[f], sections[f].b2));
+            acc = vqsubq_s32(acc, vqrdmulhq_n_s32(y1[f], sections[f].a1));
+            acc = vqsubq_s32(acc, vqrdmulhq_n_s32(y2[f], sections[f].a2));
+
+            /*
+             * Undo the half-scale of the coefficients.
+             */
+            const int32x4_t y = vqshlq_n_s32(acc, 1);
+
+            x2[f] = x1[f];
+            x1[f] = x;
+            y2[f] = y1[f];
+            y1[f] = y;
+            x = y;
+        }
+
+        vst1_s16(data[i].sample, vqrshrn_n_s32(x, FILTER_SAMPLE_SHIFT));
     }
-    else
+
+    for (size_t f = 0; f < filter_order; ++f)
     {
-        *start_index = ping_start_index - indices_before_start;
+        vst1q_s32(sections[f].x1, x1[f]);
+        vst1q_s32(sections[f].x2, x2[f]);
+        vst1q_s32(sections[f].y1, y1[f]);
+        vst1q_s32(sections[f].y2, y2[f]);
     }
-
-    *end_index = ping_start_index + ticks_to_samples(params.post_ping_duration, sampling_frequency);
-    if (*end_index >= len)
+#else
+    for (size_t i = 0; i < len; ++i)
     {
-        *end_index = len - 1;
+        for (size_t c = 0; c < 4; ++c)
+        {
+            int32_t x = (int32_t)data[i].sample[c] * (1 << FILTER_SAMPLE_SHIFT);
+
+            for (size_t f = 0; f < filter_order; ++f)
+            {
+                fixed_biquad_t *section = &sections[f];
+                int64_t acc = qrdmulh(x, section->b0);
+                acc = saturate32(acc + qrdmulh(section->x1[c], section->b1));
+                acc = saturate32(acc + qrdmulh(section->x2[c], section->b2));
+                acc = saturate32(acc - qrdmulh(section->y1[c], section->a1));
+                acc = saturate32(acc - qrdmulh(section->y2[c], section->a2));
+
+                const int32_t y = saturate32(acc * 2);
+
+                section->x2[c] = section->x1[c];
+                section->x1[c] = x;
+                section->y2[c] = section->y1[c];
+                section->y1[c] = y;
+                x = y;
+            }
+
+            /*
+             * Round and saturate back to a 16-bit sample.
+             */
+            const int32_t rounded = (int32_t)(((int64_t)x + (1 << (FILTER_SAMPLE_SHIFT - 1))) >> FILTER_SAMPLE_SHIFT);
+            data[i].sample[c] = (rounded > INT16_MAX)? INT16_MAX :
+                                (rounded < INT16_MIN)? INT16_MIN : rounded;
+        }
     }
+#endif
+}
+
+/**
+ * Defines the kernel of a cascade of a fixed number of sections, whose
+ * loops over the sections are unrolled with the state of every section held
+ * in registers.
+ */
+#define DEFINE_BIQUAD_KERNEL(order) \
+    HOT_CODE \
+    static void biquad_kernel_##order(fixed_biquad_t *sections, sample_t *data, const size_t len) \
+    { \
+        biquad_kernel(sections, data, len, order); \
+    }
+
+DEFINE_BIQUAD_KERNEL(0)
+DEFINE_BIQUAD_KERNEL(1)
+DEFINE_BIQUAD_KERNEL(2)
+DEFINE_BIQUAD_KERNEL(3)
+DEFINE_BIQUAD_KERNEL(4)
+DEFINE_BIQUAD_KERNEL(5)
+DEFINE_BIQUAD_KERNEL(6)
+DEFINE_BIQUAD_KERNEL(7)
+DEFINE_BIQUAD_KERNEL(8)
+
+_Static_assert(MAX_FILTER_SECTIONS == 8, "A biquad kernel must be defined for every cascade length.");
+
+/**
+ * The kernel of each cascade length.
+ */
+static void (*const biquad_kernels[MAX_FILTER_SECTIONS + 1])(fixed_biquad_t *sections,
+                                                             sample_t *data,
+                                                             const size_t len) = {
+    biquad_kernel_0,
+    biquad_kernel_1,
+    biquad_kernel_2,
+    biquad_kernel_3,
+    biquad_kernel_4,
+    biquad_kernel_5,
+    biquad_kernel_6,
+    biquad_kernel_7,
+    biquad_kernel_8};
+
+/**
+ * Filters all channels through a biquad cascade in place, continuing from the
+ * state left by the previous call.
+ *
+ * @note The kernel specialized for the number of sections is used.
+ *
+ * @param cascade The cascade to run.
+ * @param data The samples to filter.
+ * @param len The number of samples.
+ *
+ * @return Success or fail.
+ */
+HOT_CODE
+result_t run_biquad_cascade(biquad_cascade_t *cascade,
+                            sample_t *data,
+                            const size_t len)
+{
+    AbortIfNot(cascade, fail);
+    AbortIfNot(data, fail);
+    AbortIfNot(cascade->num_sections <= MAX_FILTER_SECTIONS, fail);
+
+    biquad_kernels[cascade->num_sections](cascade->sections, data, len);
+
+    return success;
+}
+
+/**
+ * Filters all channels through a prepared cascade in place from rest. The
+ * prepared cascade is left untouched, so that it can be shared between
+ * captures.
+ *
+ * @param prepared The cascade to filter with.
+ * @param data The samples to filter.
+ * @param len The number of samples.
+ *
+ * @return Success or fail.
+ */
+result_t apply_filter(const biquad_cascade_t *prepared,
+                      sample_t *data,
+                      const size_t len)
+{
+    AbortIfNot(prepared, fail);
+    AbortIfNot(data, fail);
+
+    biquad_cascade_t cascade = *prepared;
+    reset_biquad_cascade(&cascade);
+    AbortIfNot(run_biquad_cascade(&cascade, data, len), fail);
 
     return success;
 }
 
+/**
+ * Finds the number of samples that the transient of a cascade started from
+ * rest takes to decay by FILTER_SETTLING_DB, from the slowest pole of each
+ * section.
+ *
+ * @param cascade The cascade.
+ *
+ * @return The number of samples after which the output is settled.
+ */
+size_t filter_settling_samples(const biquad_cascade_t *cascade)
+{
+    const double decay = FILTER_SETTLING_DB * log(10) / 20;
+
+    size_t settling = 0;
+    for (size_t f = 0; f < cascade->num_sections; ++f)
+    {
+        /*
+         * The poles are the roots of z^2 + a1 z + a2.
+         */
+        const double a1 = (double)cascade->sections[f].a1 / (1 << 30);
+        const double a2 = (double)cascade->sections[f].a2 / (1 << 30);
+        const double discriminant = a1 * a1 - 4 * a2;
+
+        double radius = 0;
+        if (discriminant < 0)
+        {
+            radius = sqrt(a2);
+        }
+        else
+        {
+            const double root = sqrt(discriminant);
+            radius = fmax(fabs(-a1 + root), fabs(-a1 - root)) / 2;
+        }
+
+        settling += 2;
+        if (radius > 0)
+        {
+            settling += ceil(decay / -log(radius));
+        }
+    }
+
+    return settling;
+}
+
+/**
+ * Filters all channels through a cascade of biquad sections in place.
+ *
+ * @note The coefficients are normalized on every call. Filters applied to
+ *       many captures should be prepared once with init_biquad_cascade() and
+ *       applied with apply_filter().
+ *
+ * @param data The samples to filter.
+ * @param len The number of samples.
+ * @param coeffs The biquad coefficients of each section as b0, b1, b2, a0, a1,
+ *        a2.
+ * @param filter_order The number of sections.
+ *
+ * @return Success or fail.
+ */
 result_t filter(sample_t *data,
                 const size_t len,
                 filter_coefficients_t *coeffs,
@@ -186,50 +2898,223 @@ result_t filter(sample_t *data,
     AbortIfNot(data, fail);
     AbortIfNot(coeffs, fail);
 
+    biquad_cascade_t cascade;
+    AbortIfNot(init_biquad_cascade(&cascade, coeffs, filter_order), fail);
+    AbortIfNot(run_biquad_cascade(&cascade, data, len), fail);
+
+    return success;
+}
+
+/**
+ * Designs a low-pass decimator. The factor is reduced until the decimated
+ * rate keeps enough samples per cycle of the highest ping frequency for the
+ * sub-sample peak interpolation.
+ *
+ * @note The filter is a Hamming windowed sinc whose cutoff is half the
+ *       decimated rate. Its transition starts above the ping and ends before
+ *       the band that would alias onto it, so the few taps per phase are
+ *       enough.
+ *
+ * @param[out] decimator The decimator to design.
+ * @param factor The requested decimation factor, where one or zero keeps
+ *        the full rate.
+ * @param max_hz The highest frequency of the ping in Hz.
+ * @param sampling_frequency The sampling frequency of the input.
+ *
+ * @return Success or fail.
+ */
+result_t init_decimator(decimator_t *decimator,
+                        const size_t factor,
+                        const uint32_t max_hz,
+                        const uint32_t sampling_frequency)
+{
+    AbortIfNot(decimator, fail);
+    AbortIfNot(factor <= MAX_DECIMATION, fail);
+    AbortIfNot(max_hz, fail);
+    AbortIfNot(sampling_frequency, fail);
+
+    size_t limit = sampling_frequency / (DECIMATION_SAMPLES_PER_CYCLE * max_hz);
+    if (limit < 1)
+    {
+        limit = 1;
+    }
+
+    decimator->factor = (factor > limit)? limit : (factor)? factor : 1;
+    decimator->sampling_frequency = sampling_frequency;
+
     /*
-     * TODO: Implement filtering algorithm.
+     * The decimated rate is kept whole so that lags convert to time exactly.
      */
-    for (size_t f = 0; f < filter_order; ++f)
+    while (decimator->factor > 1 && sampling_frequency % decimator->factor)
     {
-        const double reference_coefficient = coeffs[f].coefficients[3];
+        decimator->factor--;
+    }
 
-        /*
-         * Normalize the filter coefficients by A0.
-         */
-        double coefficients[6];
-        for (int i = 0; i < 6; ++i)
+    if (decimator->factor == 1)
+    {
+        decimator->num_taps = 1;
+        decimator->taps[0] = INT16_MAX;
+        return success;
+    }
+
+    decimator->num_taps = decimator->factor * DECIMATOR_TAPS_PER_PHASE + 1;
+    const int32_t half = decimator->num_taps / 2;
+    const double cutoff = 0.5 / decimator->factor;
+    double taps[DECIMATOR_MAX_TAPS];
+    double sum = 0;
+    for (int32_t k = 0; k < (int32_t)decimator->num_taps; ++k)
+    {
+        const int32_t n = k - half;
+        const double sinc = (n == 0)? 2 * cutoff : sin(2 * PI * cutoff * n) / (PI * n);
+        const double window = 0.54 - 0.46 * cos(2 * PI * k / (decimator->num_taps - 1));
+        taps[k] = sinc * window;
+        sum += taps[k];
+    }
+
+    /*
+     * Normalize to unity gain at DC.
+     */
+    for (size_t k = 0; k < decimator->num_taps; ++k)
+    {
+        decimator->taps[k] = (int16_t)lround(taps[k] / sum * (1 << 15));
+    }
+
+    return success;
+}
+
+/**
+ * Computes one decimated sample of every channel near the ends of a capture,
+ * where the taps outside the capture are taken as zero.
+ *
+ * @param decimator The decimator.
+ * @param data The samples to decimate.
+ * @param len The number of samples.
+ * @param center The input sample that the output is centered on.
+ * @param[out] out The decimated sample.
+ *
+ * @return None.
+ */
+static void decimate_edge(const decimator_t *decimator,
+                          const sample_t *data,
+                          const size_t len,
+                          const size_t center,
+                          sample_t *out)
+{
+    const int32_t half = decimator->num_taps / 2;
+    int32_t acc[4] = {0};
+    for (int32_t k = 0; k < (int32_t)decimator->num_taps; ++k)
+    {
+        const int32_t index = (int32_t)center + half - k;
+        if (index < 0 || index >= (int32_t)len)
+        {
+            continue;
+        }
+
+        for (size_t c = 0; c < 4; ++c)
         {
-            coefficients[i] = coeffs[f].coefficients[i] / reference_coefficient;
+            acc[c] += (int32_t)data[index].sample[c] * decimator->taps[k];
         }
+    }
+
+    for (size_t c = 0; c < 4; ++c)
+    {
+        const int32_t rounded = (acc[c] + (1 << 14)) >> 15;
+        out->sample[c] = (rounded > INT16_MAX)? INT16_MAX :
+                         (rounded < INT16_MIN)? INT16_MIN : rounded;
+    }
+}
+
+/**
+ * Low-pass filters and decimates the channels of a capture into separate
+ * arrays, so that locating and correlating the ping runs at the lower rate.
+ *
+ * @note This is a polyphase decimator, in that only the outputs that are
+ *       kept are computed, from DECIMATOR_TAPS_PER_PHASE multiplies per
+ *       input sample and channel. With NEON the four channels are
+ *       accumulated in the lanes of one vector, as the biquad cascade
+ *       filters them.
+ *
+ * @param decimator The prepared decimator.
+ * @param data The interleaved samples to decimate.
+ * @param len The number of samples.
+ * @param[out] planar The decimated channels, whose length is set to the
+ *             number of decimated samples.
+ *
+ * @return Success or fail.
+ */
+HOT_CODE
+result_t decimate_channels(const decimator_t *decimator,
+                           const sample_t *data,
+                           const size_t len,
+                           planar_samples_t *planar)
+{
+    AbortIfNot(decimator, fail);
+    AbortIfNot(data, fail);
+    AbortIfNot(planar, fail);
+    AbortIfNot(decimator->factor, fail);
 
-        double z1[4] = {0}, z2[4] = {0};
+    const size_t factor = decimator->factor;
+    const size_t num_taps = decimator->num_taps;
+    const size_t half = num_taps / 2;
+    const size_t out_len = (len + factor - 1) / factor;
+    AbortIfNot(out_len <= planar->capacity, fail);
 
-        for (int i = 0; i < len; ++i)
+    for (size_t j = 0; j < out_len; ++j)
+    {
+        const size_t center = j * factor;
+        sample_t out;
+        if (center < half || center + half >= len)
+        {
+            decimate_edge(decimator, data, len, center, &out);
+        }
+        else
         {
-            for (int c = 0; c < 4; ++c)
+            /*
+             * The taps are symmetric, so the samples that share a tap are
+             * added before they are multiplied.
+             */
+            const sample_t *x = &data[center];
+#ifdef __ARM_NEON
+            int32x4_t acc = vmull_n_s16(vld1_s16(x[0].sample), decimator->taps[half]);
+            for (size_t k = 1; k <= half; ++k)
             {
-                const double old_value = data[i].sample[c];
-                const double new_value = coefficients[0] * old_value + z1[c];
-
-                /*
-                 * Update the IIR filter state coefficients for each channel.
-                 */
-                z1[c] = coefficients[1] * old_value + z2[c] -
-                            coefficients[4] * new_value;
+                const int32x4_t pair = vaddl_s16(vld1_s16(x[k].sample), vld1_s16(x[-(int32_t)k].sample));
+                acc = vmlaq_n_s32(acc, pair, decimator->taps[half - k]);
+            }
 
-                z2[c] = coefficients[2] * old_value -
-                            coefficients[5] * new_value;
+            vst1_s16(out.sample, vqrshrn_n_s32(acc, 15));
+#else
+            int32_t acc[4];
+            for (size_t c = 0; c < 4; ++c)
+            {
+                acc[c] = (int32_t)x[0].sample[c] * decimator->taps[half];
+            }
 
+            for (size_t k = 1; k <= half; ++k)
+            {
+                const int16_t tap = decimator->taps[half - k];
+                for (size_t c = 0; c < 4; ++c)
+                {
+                    acc[c] += ((int32_t)x[k].sample[c] + x[-(int32_t)k].sample[c]) * tap;
+                }
+            }
 
-                /*
-                 * Update the new measurement for the current sample after
-                 * filtering.
-                 */
-                data[i].sample[c] = new_value;
+            for (size_t c = 0; c < 4; ++c)
+            {
+                const int32_t rounded = (acc[c] + (1 << 14)) >> 15;
+                out.sample[c] = (rounded > INT16_MAX)? INT16_MAX :
+                                (rounded < INT16_MIN)? INT16_MIN : rounded;
             }
+#endif
+        }
+
+        for (size_t c = 0; c < 4; ++c)
+        {
+            planar->channel[c][j] = out.sample[c];
         }
     }
 
+    planar->len = out_len;
 
     return success;
 }
@@ -3,6 +3,220 @@
 
 #include "types.h"
 
+/**
+ * The maximum number of second-order sections supported by the filter.
+ */
+#define MAX_FILTER_SECTIONS 8
+
+/**
+ * The largest factor that the filtered channels can be decimated by, and the
+ * taps of the low-pass filter per output phase.
+ */
+#define MAX_DECIMATION 32
+#define DECIMATOR_TAPS_PER_PHASE 4
+#define DECIMATOR_MAX_TAPS (MAX_DECIMATION * DECIMATOR_TAPS_PER_PHASE + 1)
+
+/**
+ * The correlation of a perfectly coherent pair of channels after the phase
+ * transform.
+ */
+#define PHAT_CORRELATION_SCALE (1 << 20)
+
+/**
+ * Defines a task that is run for one index of a parallel loop.
+ */
+typedef result_t (*parallel_task_t)(void *context, const size_t index);
+
+/**
+ * Defines a function that runs a task for every index below a count and
+ * returns once all of them have run. The indices may be shared with another
+ * core, so each task must only write storage that belongs to its index.
+ */
+typedef result_t (*parallel_for_t)(parallel_task_t task, void *context, const size_t count);
+
+/**
+ * Defines the calibration of the analog channels, measured from a known
+ * source. The delay of each channel is the fixed skew in nanoseconds that its
+ * front end and ADC add relative to channel 0, which is removed from the
+ * sub-sample delay estimates. The gain of each channel scales its amplitude
+ * to that of channel 0.
+ */
+typedef struct channel_calibration_t
+{
+    float delay_ns[4];
+    float gain[4];
+} channel_calibration_t;
+
+/**
+ * Defines how the cross spectra of the channels are weighted before they are
+ * transformed into correlations, and how the lags are searched.
+ */
+typedef struct correlation_weighting_t
+{
+    /*
+     * Specified true to whiten the cross spectra by the phase transform
+     * (GCC-PHAT).
+     */
+    bool phat;
+
+    /*
+     * The band of frequencies in Hz that the phase transform keeps, or a
+     * high frequency of zero to keep every frequency.
+     */
+    uint32_t low_hz;
+    uint32_t high_hz;
+
+    /*
+     * The highest frequency in Hz that the decimated channels of a coarse
+     * lag search must keep, or zero to search every lag at the full rate.
+     */
+    uint32_t coarse_max_hz;
+
+    /*
+     * Specified true to only search the lags within a radius of the lag
+     * predicted for each channel other than the reference, in ascending
+     * order, which is given as a left shift.
+     */
+    bool track_lags;
+    int32_t lag_center[3];
+    int32_t lag_radius;
+
+    /*
+     * The loop that the direct correlation and the transforms are split
+     * across, or NULL to run them on the calling core.
+     */
+    parallel_for_t parallel_for;
+
+    /*
+     * The calibration that the delays and amplitudes are corrected by, or
+     * NULL to report them as measured.
+     */
+    const channel_calibration_t *calibration;
+} correlation_weighting_t;
+
+/**
+ * Defines a fixed-point biquad section. Coefficients are stored as half of
+ * their value in Q31 so that magnitudes up to two are representable. The
+ * input and output history is kept per channel.
+ */
+typedef struct fixed_biquad_t
+{
+    int32_t b0, b1, b2, a1, a2;
+    int32_t x1[4], x2[4];
+    int32_t y1[4], y2[4];
+} fixed_biquad_t;
+
+/**
+ * Defines a cascade of biquad sections that can filter data in chunks.
+ */
+typedef struct biquad_cascade_t
+{
+    fixed_biquad_t sections[MAX_FILTER_SECTIONS];
+    size_t num_sections;
+} biquad_cascade_t;
+
+/**
+ * Defines a low-pass decimator of the four channels. The taps are in Q15 and
+ * symmetric about the center tap, so that the output is aligned with the
+ * input sample it is centered on. Only every factor-th output is computed.
+ */
+typedef struct decimator_t
+{
+    int16_t taps[DECIMATOR_MAX_TAPS];
+    size_t num_taps;
+    size_t factor;
+
+    /*
+     * The sampling frequency of the input that the filter was designed for.
+     */
+    uint32_t sampling_frequency;
+} decimator_t;
+
+/**
+ * Defines a narrowband detector that measures the amplitude of the reference
+ * channel at the pinger frequency. The signal is mixed to baseband by a local
+ * oscillator and smoothed by a two-pole low-pass filter.
+ */
+typedef struct tone_detector_t
+{
+    /*
+     * Specified false if pings are detected with a broadband threshold.
+     */
+    bool enabled;
+
+    /*
+     * The local oscillator phase and its rotation per sample.
+     */
+    float phase_re, phase_im;
+    float step_re, step_im;
+
+    /*
+     * The baseband signal after each of two cascaded one-pole low-pass
+     * filters, and the smoothing factor of the filters.
+     */
+    float i[2], q[2];
+    float alpha;
+
+    /*
+     * The offset removed from each sample before mixing.
+     */
+    float offset;
+} tone_detector_t;
+
+result_t init_tone_detector(tone_detector_t *detector,
+                            const uint32_t frequency,
+                            const uint32_t sampling_frequency);
+
+result_t detect_tone_channel(tone_detector_t *detector,
+                             const analog_sample_t *reference,
+                             const size_t stride,
+                             const size_t len,
+                             const analog_sample_t threshold,
+                             bool *found,
+                             size_t *index,
+                             analog_sample_t *max_amplitude);
+
+result_t detect_tone(tone_detector_t *detector,
+                     const sample_t *data,
+                     const size_t len,
+                     const analog_sample_t threshold,
+                     bool *found,
+                     size_t *index,
+                     analog_sample_t *max_amplitude);
+
+void interleaved_view(const sample_t *data, const size_t len, channel_view_t *view);
+
+void planar_view(const planar_samples_t *planar,
+                 const size_t start,
+                 const size_t len,
+                 channel_view_t *view);
+
+result_t cross_correlate_pairs(const channel_view_t *view,
+                               const size_t reference,
+                               const correlation_weighting_t *weighting,
+                               correlation_t *correlations,
+                               correlation_t *cross_correlations,
+                               const size_t correlation_len,
+                               size_t *num_correlations,
+                               correlation_result_t *result,
+                               const uint32_t sampling_frequency);
+
+result_t cross_correlate_channels(const channel_view_t *view,
+                                  correlation_t *correlations,
+                                  const size_t correlation_len,
+                                  size_t *num_correlations,
+                                  correlation_result_t *result,
+                                  const uint32_t sampling_frequency);
+
+result_t evaluate_correlations(const channel_view_t *view,
+                               const correlation_t *correlations,
+                               const size_t num_correlations,
+                               const channel_calibration_t *calibration,
+                               correlation_result_t *result,
+                               const uint32_t sampling_frequency);
+
+void init_channel_calibration(channel_calibration_t *calibration);
+
 result_t cross_correlate(const sample_t *data,
                          const size_t len,
                          correlation_t *correlations,
@@ -11,6 +225,16 @@ result_t cross_correlate(const sample_t *data,
                          correlation_result_t *result,
                          const uint32_t sampling_frequency);
 
+result_t truncate_channels(const channel_view_t *view,
+                           size_t *start_index,
+                           size_t *end_index,
+                           size_t *ping_index,
+                           bool *found,
+                           leading_edges_t *edges,
+                           const HydroZynqParams params,
+                           const noise_stats_t *noise,
+                           const uint32_t sampling_frequency);
+
 result_t truncate(const sample_t *data,
         const size_t len,
         size_t *start_index,
@@ -19,9 +243,53 @@ result_t truncate(const sample_t *data,
         const HydroZynqParams params,
         const uint32_t sampling_frequency);
 
+result_t estimate_edge_delays(const channel_view_t *view,
+                              const leading_edges_t *edges,
+                              const channel_calibration_t *calibration,
+                              correlation_result_t *result,
+                              const uint32_t sampling_frequency);
+
+result_t assess_ping(const channel_view_t *view,
+                     const size_t onset,
+                     const size_t reference,
+                     const uint32_t sampling_frequency,
+                     ping_quality_t *quality);
+
+result_t init_biquad_cascade(biquad_cascade_t *cascade,
+                             const filter_coefficients_t *coeffs,
+                             const size_t filter_order);
+
+void reset_biquad_cascade(biquad_cascade_t *cascade);
+
+result_t run_biquad_cascade(biquad_cascade_t *cascade,
+                            sample_t *data,
+                            const size_t len);
+
+result_t apply_filter(const biquad_cascade_t *prepared,
+                      sample_t *data,
+                      const size_t len);
+
+size_t filter_settling_samples(const biquad_cascade_t *cascade);
+
 result_t filter(sample_t *data,
                 const size_t len,
                 filter_coefficients_t *coeffs,
                 const size_t filter_order);
 
+result_t init_decimator(decimator_t *decimator,
+                        const size_t factor,
+                        const uint32_t max_hz,
+                        const uint32_t sampling_frequency);
+
+result_t decimate_channels(const decimator_t *decimator,
+                           const sample_t *data,
+                           const size_t len,
+                           planar_samples_t *planar);
+
+int32_t correlation_max_shift(const uint32_t sampling_frequency);
+
+size_t correlation_capacity(const uint32_t sampling_frequency);
+
+void get_correlation_weighting(const HydroZynqParams *params, correlation_weighting_t *weighting);
+
 #endif
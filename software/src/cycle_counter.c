@@ -0,0 +1,153 @@
+#include "cycle_counter.h"
+
+#include "abort.h"
+#include "db.h"
+#include "sample_clock.h"
+#include "system.h"
+#include "system_params.h"
+#include "time_util.h"
+#include "types.h"
+
+/**
+ * Defines the rate of the cycle counter of one core, as measured against the
+ * global timer.
+ */
+typedef struct cycle_clock_t
+{
+    bool calibrated;
+    uint32_t cycle_clock_hz;
+    clock_ratio_t ns_per_cycle;
+    clock_ratio_t ticks_per_cycle;
+    clock_ratio_t cycles_per_tick;
+} cycle_clock_t;
+
+/**
+ * The calibration of each core, which is only written by its own core.
+ */
+static cycle_clock_t cycle_clocks[2];
+
+/**
+ * Gets the calibration of the calling core.
+ *
+ * @return The calibration.
+ */
+static const cycle_clock_t *current_cycle_clock()
+{
+    return &cycle_clocks[get_cpu_id() & 1];
+}
+
+/**
+ * Starts the cycle counter of the calling core if it is stopped, and
+ * calibrates it against the global timer. A rate within tolerance of the
+ * core clock is taken as exactly the core clock, since both clocks are
+ * derived from the same PLL and the measurement is limited by the reads.
+ *
+ * @note This must be called on every core that converts its cycles. The
+ *       counter is not reset, so spans being timed are not disturbed.
+ *
+ * @return Success or fail.
+ */
+result_t init_cycle_counter()
+{
+    uint32_t pmcr;
+    __asm volatile("mrc p15, 0, %0, c9, c12, 0" : "=r"(pmcr));
+    __asm volatile("mcr p15, 0, %0, c9, c12, 0\n"
+                   "mcr p15, 0, %1, c9, c12, 1\n"
+                   "isb" :: "r"(pmcr | 0x1), "r"(1u << 31));
+
+    const tick_t start_tick = get_system_time();
+    const uint32_t start_cycles = read_cycle_counter();
+    busywait(micros_to_ticks(CYCLE_COUNTER_CALIBRATION_US));
+    const uint32_t cycles = read_cycle_counter() - start_cycles;
+    const tick_t ticks = get_system_time() - start_tick;
+    AbortIfNot(cycles, fail);
+    AbortIfNot(ticks, fail);
+
+    const uint64_t measured_hz = (uint64_t)cycles * CPU_CLOCK_HZ / ticks;
+    const uint64_t error_hz = (measured_hz > ARM_CLK_PLL)? measured_hz - ARM_CLK_PLL : ARM_CLK_PLL - measured_hz;
+
+    cycle_clock_t clock;
+    if (error_hz * 100 <= (uint64_t)ARM_CLK_PLL * CYCLE_COUNTER_TOLERANCE_PERCENT)
+    {
+        clock.cycle_clock_hz = ARM_CLK_PLL;
+        AbortIfNot(init_clock_ratio(&clock.ns_per_cycle, 1000000000, ARM_CLK_PLL), fail);
+        AbortIfNot(init_clock_ratio(&clock.ticks_per_cycle, CPU_CLOCK_HZ, ARM_CLK_PLL), fail);
+        AbortIfNot(init_clock_ratio(&clock.cycles_per_tick, ARM_CLK_PLL, CPU_CLOCK_HZ), fail);
+    }
+    else
+    {
+        AbortIf(ticks > UINT32_MAX, fail);
+        AbortIf(ticks_to_ns(ticks) > UINT32_MAX, fail);
+        dblog(LOG_WARN, "CPU%u cycle counter runs at %u Hz rather than %u Hz.\n",
+                (unsigned int)get_cpu_id(),
+                (unsigned int)measured_hz,
+                (unsigned int)ARM_CLK_PLL);
+        clock.cycle_clock_hz = measured_hz;
+        AbortIfNot(init_clock_ratio(&clock.ns_per_cycle, ticks_to_ns(ticks), cycles), fail);
+        AbortIfNot(init_clock_ratio(&clock.ticks_per_cycle, ticks, cycles), fail);
+        AbortIfNot(init_clock_ratio(&clock.cycles_per_tick, cycles, ticks), fail);
+    }
+    clock.calibrated = true;
+
+    cycle_clocks[get_cpu_id() & 1] = clock;
+
+    return success;
+}
+
+/**
+ * Gets the calibrated rate of the cycle counter of the calling core.
+ *
+ * @return The rate in Hz, which is the core clock until calibrated.
+ */
+uint32_t get_cycle_clock_hz()
+{
+    const cycle_clock_t *clock = current_cycle_clock();
+
+    return (clock->calibrated)? clock->cycle_clock_hz : ARM_CLK_PLL;
+}
+
+/**
+ * Converts cycles of the calling core to nanoseconds.
+ *
+ * @param cycles The number of cycles.
+ *
+ * @return The time in nanoseconds, or zero before calibration.
+ */
+uint64_t cycles_to_ns(const uint32_t cycles)
+{
+    const cycle_clock_t *clock = current_cycle_clock();
+
+    return (clock->calibrated)? scale_clock(&clock->ns_per_cycle, cycles) : 0;
+}
+
+/**
+ * Converts cycles of the calling core to system ticks.
+ *
+ * @param cycles The number of cycles.
+ *
+ * @return The time in ticks, or zero before calibration.
+ */
+tick_t cycles_to_ticks(const uint32_t cycles)
+{
+    const cycle_clock_t *clock = current_cycle_clock();
+
+    return (clock->calibrated)? scale_clock(&clock->ticks_per_cycle, cycles) : 0;
+}
+
+/**
+ * Converts system ticks to cycles of the calling core, for timeouts that are
+ * checked with the cycle counter.
+ *
+ * @param ticks The time in ticks.
+ *
+ * @return The number of cycles, which saturates at the longest span the
+ *         counter can time. Before calibration the core clock is assumed.
+ */
+uint32_t ticks_to_cycles(const tick_t ticks)
+{
+    const cycle_clock_t *clock = current_cycle_clock();
+    const clock_ratio_t nominal = CLOCK_RATIO(ARM_CLK_PLL, CPU_CLOCK_HZ);
+    const uint64_t cycles = scale_clock((clock->calibrated)? &clock->cycles_per_tick : &nominal, ticks);
+
+    return (cycles > UINT32_MAX)? UINT32_MAX : cycles;
+}
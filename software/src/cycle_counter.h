@@ -0,0 +1,36 @@
+#ifndef CYCLE_COUNTER_H
+#define CYCLE_COUNTER_H
+
+#include "types.h"
+
+/**
+ * Reads the cycle counter of the calling core. This is a single coprocessor
+ * read, where the global timer takes three reads over the peripheral bus.
+ *
+ * @note The counters of the two cores are not synchronized and the counter
+ *       does not count while the core sleeps in wait_for_interrupt(), so it
+ *       times spans on one core that do not sleep. The global timer remains
+ *       the absolute time shared by both cores.
+ *
+ * @return The number of cycles counted, which wraps every few seconds, so
+ *         spans are found by unsigned subtraction.
+ */
+static inline uint32_t read_cycle_counter()
+{
+    uint32_t value;
+    __asm volatile("mrc p15, 0, %0, c9, c13, 0" : "=r"(value));
+
+    return value;
+}
+
+result_t init_cycle_counter();
+
+uint32_t get_cycle_clock_hz();
+
+uint64_t cycles_to_ns(const uint32_t cycles);
+
+tick_t cycles_to_ticks(const uint32_t cycles);
+
+uint32_t ticks_to_cycles(const tick_t ticks);
+
+#endif
@@ -4,14 +4,48 @@
 #include "abort.h"
 #include "lwip/ip.h"
 #include "udp.h"
+#include "system.h"
 #include "uart.h"
 #include "system_params.h"
+#include "text_format.h"
 #include "stdarg.h"
 #include "string.h"
-#include "stdio.h"
 
 udp_socket_t db_socket;
 
+/**
+ * Formatted messages waiting to be written out. Messages are buffered once
+ * dbinit() has been called and written synchronously before then.
+ */
+static char log_buffer[LOG_BUFFER_SIZE];
+static volatile size_t log_head = 0;
+static volatile size_t log_tail = 0;
+static volatile uint32_t log_dropped = 0;
+static volatile uint32_t log_dropped_total = 0;
+static bool log_buffered = false;
+
+/**
+ * The least severe level that is currently logged.
+ */
+static log_level_t log_level = LOG_INFO;
+
+/**
+ * Specified true if buffered messages are sent as deferred records for the
+ * host to format.
+ */
+static bool log_deferred = false;
+
+/**
+ * The longest message that can be logged.
+ */
+#define LOG_MESSAGE_LENGTH 256
+
+/**
+ * The buffered lines waiting to share a datagram to the debug port.
+ */
+static char log_datagram[MESSAGE_BATCH_BYTES];
+static size_t log_datagram_len = 0;
+
 result_t dbinit()
 {
     AbortIfNot(init_udp(&db_socket), fail);
@@ -21,28 +55,302 @@ result_t dbinit()
 
     AbortIfNot(connect_udp(&db_socket, &dest_ip, DEBUG_PORT), fail);
 
+    log_buffered = true;
+
     return success;
 }
 
-void dbprintf(char fmt[], ...)
+/**
+ * Sets the least severe level that is logged.
+ *
+ * @param level The level to log at.
+ *
+ * @return None.
+ */
+void set_log_level(const log_level_t level)
 {
-    char str[256];
-    va_list args;
-    va_start(args, fmt);
-    vsprintf(str, fmt, args);
-    va_end(args);
+    log_level = level;
+}
+
+/**
+ * Sets whether buffered messages are formatted on the board or sent as
+ * deferred records for the host to format. Deferred messages cost only the
+ * copy of their arguments, but are not written to the UART.
+ *
+ * @param deferred Specified true to defer formatting to the host.
+ *
+ * @return None.
+ */
+void set_log_deferred(const bool deferred)
+{
+    log_deferred = deferred;
+}
 
+/**
+ * Writes a message to the debug port and the UART.
+ *
+ * @param str The message to write.
+ * @param len The length of the message.
+ *
+ * @return None.
+ */
+static void write_message(char *str, const size_t len)
+{
     /*
      * Send debug data over the UDP port if it's configured.
      */
     if (db_socket.pcb)
     {
-        send_udp(&db_socket, str, strlen(str));
+        send_udp(&db_socket, str, len);
+    }
+
+    for (size_t i = 0; i < len; ++i)
+    {
+        uart_putchar(str[i]);
+    }
+}
+
+/**
+ * Sends the lines waiting to share a datagram to the debug port.
+ *
+ * @return None.
+ */
+static void send_log_datagram()
+{
+    if (log_datagram_len && db_socket.pcb)
+    {
+        send_udp(&db_socket, log_datagram, log_datagram_len);
+    }
+
+    log_datagram_len = 0;
+}
+
+/**
+ * Writes a buffered line to the UART and adds it to the datagram to the debug
+ * port, which is sent first if the line does not fit.
+ *
+ * @param str The line to write.
+ * @param len The length of the line.
+ * @param to_uart Specified true to also write the line to the UART.
+ *
+ * @return None.
+ */
+static void write_batched_message(char *str, const size_t len, const bool to_uart)
+{
+    if (log_datagram_len + len > sizeof(log_datagram))
+    {
+        send_log_datagram();
+    }
+
+    memcpy(&log_datagram[log_datagram_len], str, len);
+    log_datagram_len += len;
+
+    for (size_t i = 0; to_uart && i < len; ++i)
+    {
+        uart_putchar(str[i]);
+    }
+}
+
+/**
+ * Adds a formatted message to the log.
+ *
+ * @param level The level of the message.
+ * @param fmt The format of the message.
+ * @param args The arguments of the format.
+ *
+ * @return None.
+ */
+static void log_message(const log_level_t level, char fmt[], va_list args)
+{
+    /*
+     * The log and UART belong to CPU0, so output from the DSP or network core
+     * is dropped.
+     */
+    if (get_cpu_id() != 0 || level > log_level)
+    {
+        return;
+    }
+
+    /*
+     * A deferred record that does not fit is formatted instead.
+     */
+    char str[LOG_MESSAGE_LENGTH];
+    size_t len = 0;
+    if (log_deferred && log_buffered)
+    {
+        log_record_header_t header;
+        size_t encoded = 0;
+        if (vencode_format_args((uint8_t *)&str[sizeof(header)],
+                                sizeof(str) - sizeof(header),
+                                fmt,
+                                args,
+                                &encoded))
+        {
+            header.marker = LOG_RECORD_MARKER;
+            header.level = level;
+            header.length = sizeof(header) + encoded;
+            header.format = (uint32_t)(uintptr_t)fmt;
+            memcpy(str, &header, sizeof(header));
+            len = header.length;
+        }
+    }
+
+    if (!len)
+    {
+        len = vformat_text(str, sizeof(str), fmt, args);
     }
 
-    size_t i = 0;
-    while (str[i])
+    if (!len)
     {
-        uart_putchar(str[i++]);
+        return;
     }
+
+    if (!log_buffered)
+    {
+        write_message(str, len);
+        return;
+    }
+
+    /*
+     * Messages may be logged from interrupt handlers, so the buffer is only
+     * updated with interrupts masked.
+     */
+    const uint32_t state = save_and_disable_interrupts();
+    const size_t used = (log_head - log_tail) % LOG_BUFFER_SIZE;
+    if (LOG_BUFFER_SIZE - 1 - used < (size_t)len)
+    {
+        log_dropped++;
+        log_dropped_total++;
+    }
+    else
+    {
+        for (size_t i = 0; i < len; ++i)
+        {
+            log_buffer[(log_head + i) % LOG_BUFFER_SIZE] = str[i];
+        }
+
+        log_head = (log_head + len) % LOG_BUFFER_SIZE;
+    }
+    restore_interrupts(state);
+}
+
+void dbprintf(char fmt[], ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    log_message(LOG_INFO, fmt, args);
+    va_end(args);
+}
+
+/**
+ * Logs a message at a given level. This is normally called through dblog()
+ * so that messages above the compiled level are removed.
+ *
+ * @param level The level of the message.
+ * @param fmt The format of the message.
+ *
+ * @return None.
+ */
+void dblog_message(const log_level_t level, char fmt[], ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    log_message(level, fmt, args);
+    va_end(args);
+}
+
+/**
+ * Writes buffered log messages out. This should be called when the system is
+ * otherwise idle. The lines written in one call share datagrams to the debug
+ * port rather than each taking its own.
+ *
+ * @note Whole lines are written, so slightly more than the limit may be
+ *       written to finish a line.
+ *
+ * @param max_bytes The number of bytes after which to stop.
+ *
+ * @return None.
+ */
+void service_log(const size_t max_bytes)
+{
+    if (get_cpu_id() != 0)
+    {
+        return;
+    }
+
+    size_t written = 0;
+    while (written < max_bytes && log_tail != log_head)
+    {
+        char line[LOG_MESSAGE_LENGTH];
+        size_t len = 0;
+
+        /*
+         * Deferred records are added whole, and only to the debug port.
+         */
+        if (log_buffer[log_tail] == LOG_RECORD_MARKER)
+        {
+            log_record_header_t header;
+            for (size_t i = 0; i < sizeof(header); ++i)
+            {
+                ((char *)&header)[i] = log_buffer[(log_tail + i) % LOG_BUFFER_SIZE];
+            }
+
+            while (len < header.length)
+            {
+                line[len++] = log_buffer[log_tail];
+                log_tail = (log_tail + 1) % LOG_BUFFER_SIZE;
+            }
+
+            write_batched_message(line, len, false);
+            written += len;
+            continue;
+        }
+
+        while (log_tail != log_head && len < sizeof(line))
+        {
+            const char c = log_buffer[log_tail];
+            line[len++] = c;
+            log_tail = (log_tail + 1) % LOG_BUFFER_SIZE;
+            if (c == '\n')
+            {
+                break;
+            }
+        }
+
+        write_batched_message(line, len, true);
+        written += len;
+    }
+
+    if (log_dropped && log_tail == log_head)
+    {
+        char str[64];
+        const uint32_t dropped = log_dropped;
+        log_dropped = 0;
+
+        const size_t len = format_text(str, sizeof(str), "Log overflow: %u messages dropped\n", dropped);
+        write_batched_message(str, len, true);
+    }
+
+    send_log_datagram();
+}
+
+/**
+ * Gets the number of log messages dropped because the buffer was full.
+ *
+ * @return The number of dropped messages.
+ */
+uint32_t get_log_dropped()
+{
+    return log_dropped_total;
+}
+
+/**
+ * Writes out every buffered log message.
+ *
+ * @return None.
+ */
+void flush_log()
+{
+    service_log(LOG_BUFFER_SIZE);
+    flush_uart();
 }
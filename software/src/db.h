@@ -3,8 +3,80 @@
 
 #include "types.h"
 
+/**
+ * Defines the severity of a log message. Lower levels are more severe.
+ */
+typedef enum log_level_t
+{
+    LOG_ERROR = 0,
+    LOG_WARN = 1,
+    LOG_INFO = 2,
+    LOG_DEBUG = 3
+} log_level_t;
+
+/**
+ * The least severe level compiled into the firmware. Messages above this
+ * level are removed by the preprocessor.
+ */
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_DEBUG
+#endif
+
+/**
+ * The number of bytes of formatted messages buffered for output.
+ */
+#define LOG_BUFFER_SIZE 8192
+
+/**
+ * The first byte of a deferred log record, which never appears in text.
+ */
+#define LOG_RECORD_MARKER 0x1E
+
+/**
+ * Defines the header of a deferred log record on the debug port. The record
+ * carries the address of its format in the firmware image rather than the
+ * formatted text, followed by its arguments as encoded by
+ * vencode_format_args(), so that the host formats it from the image. All
+ * fields are little endian.
+ */
+typedef struct __attribute__((packed)) log_record_header_t
+{
+    uint8_t marker;
+    uint8_t level;
+
+    /*
+     * The size of the record in bytes, including the header.
+     */
+    uint16_t length;
+
+    uint32_t format;
+} log_record_header_t;
+
+/**
+ * Logs a message at a given level.
+ */
+#define dblog(level, ...) \
+{ \
+    if ((level) <= LOG_COMPILE_LEVEL) \
+    { \
+        dblog_message((level), __VA_ARGS__); \
+    } \
+}\
+
 result_t dbinit();
 
 void dbprintf(char fmt[], ...);
 
+void dblog_message(const log_level_t level, char fmt[], ...);
+
+void set_log_level(const log_level_t level);
+
+void set_log_deferred(const bool deferred);
+
+void service_log(const size_t max_bytes);
+
+void flush_log();
+
+uint32_t get_log_dropped();
+
 #endif
@@ -4,7 +4,10 @@
 #include "regs/DmaRegs.h"
 #include "network_stack.h"
 #include "system.h"
+#include "system_params.h"
 #include "time_util.h"
+#include "trace.h"
+#include "xil_cache.h"
 
 result_t initialize_dma(dma_engine_t *dma, uint32_t base_address)
 {
@@ -17,7 +20,33 @@ result_t initialize_dma(dma_engine_t *dma, uint32_t base_address)
     dma->regs->S2MM_DMACR |= 1 << 2;
     while (dma->regs->S2MM_DMACR & (1 << 2));
 
-    dma->regs->S2MM_DMACR |= 1;
+    dma->ring.descriptors = NULL;
+    dma->ring.count = 0;
+    dma->ring.running = false;
+    dma->coherency = DMA_CACHED;
+    dma->max_transfer_bytes = (1 << DMA_DEFAULT_LENGTH_WIDTH) - 1;
+
+    dma->interrupts_enabled = false;
+    dma->transfer_complete = false;
+    dma->transfer_error = false;
+    dma->completions = 0;
+    dma->irq_threshold = 1;
+    dma->irq_delay_us = 0;
+    dma->errors = 0;
+    dma->cache_maintenance_ticks = 0;
+    dma->uncached_base = NULL;
+    dma->uncached_len = 0;
+    dma->callback = NULL;
+    dma->callback_arg = NULL;
+
+    /*
+     * In scatter-gather mode the engine may only be started once the current
+     * descriptor pointer has been programmed.
+     */
+    if (!dma_sg_included(dma))
+    {
+        dma->regs->S2MM_DMACR |= 1;
+    }
 
     return success;
 }
@@ -30,6 +59,10 @@ result_t init_dma_transfer(dma_engine_t *dma, void *dest, uint32_t len)
     /*
      * Verify that the DMA engine has not encountered any internal errors.
      */
+    if (dma->regs->S2MM_DMASR & (1 << 4))
+    {
+        dma->errors++;
+    }
     AbortIf(dma->regs->S2MM_DMASR & (1 << 4), fail);
 
     /*
@@ -40,13 +73,14 @@ result_t init_dma_transfer(dma_engine_t *dma, void *dest, uint32_t len)
     /*
      * Verify that a positive number of bytes should be transfered.
      */
-    AbortIfNot(len > 0 && len < (2 << (14 - 1)), fail);
+    AbortIfNot(len > 0 && len <= dma->max_transfer_bytes, fail);
 
     /*
      * Verify the DMA engine is started.
      */
     AbortIfNot((dma->regs->S2MM_DMACR & 1) == 1, fail);
 
+    dma->transfer_complete = false;
     dma->regs->S2MM_DA = (uint32_t)dest;
 
     /*
@@ -68,16 +102,565 @@ result_t wait_for_dma_transfer(dma_engine_t *dma)
     const tick_t end_time = get_system_time() + ms_to_ticks(500);
 
     /*
-     * Wait for the IDLE bit to be set.
+     * Wait for the completion interrupt or, without interrupts, for the IDLE
+     * bit to be set.
      */
-    while (get_system_time() < end_time &&
-            dma->regs->S2MM_DMACR & 1 &&
-            (dma->regs->S2MM_DMASR & (1 << 1)) == 0)
+    while (get_system_time() < end_time && !dma_transfer_done(dma))
     {
         dispatch_network_stack();
+        if (dma->interrupts_enabled && !dma_transfer_done(dma))
+        {
+            wait_for_interrupt();
+        }
     }
 
     AbortIf(get_system_time() >= end_time, fail);
+    AbortIf(dma->transfer_error, fail);
+
+    return success;
+}
+
+/**
+ * Check if the most recently started simple-mode transfer has completed.
+ *
+ * @param dma The DMA engine to check.
+ *
+ * @return True if the transfer is complete.
+ */
+bool dma_transfer_done(dma_engine_t *dma)
+{
+    if (!dma || !dma->regs)
+    {
+        return false;
+    }
+
+    if (dma->interrupts_enabled)
+    {
+        return (dma->transfer_complete || dma->transfer_error)? true : false;
+    }
+
+    return ((dma->regs->S2MM_DMACR & DMACR_RUN_STOP) == 0 ||
+            (dma->regs->S2MM_DMASR & DMASR_IDLE))? true : false;
+}
+
+/**
+ * Sets the width of the buffer length register of the engine.
+ *
+ * @note The width is fixed when the bitstream is built by c_sg_length_width
+ *       and cannot be read back from the engine.
+ *
+ * @param dma The DMA engine to configure.
+ * @param width The width of the length register in bits.
+ *
+ * @return Success or fail.
+ */
+result_t set_dma_length_width(dma_engine_t *dma, const uint8_t width)
+{
+    AbortIfNot(dma, fail);
+    AbortIfNot(width >= 8 && width <= DMA_MAX_LENGTH_WIDTH, fail);
+
+    dma->max_transfer_bytes = (1 << width) - 1;
+
+    return success;
+}
+
+/**
+ * Selects how destination buffers are kept coherent with the data cache.
+ *
+ * @note The engine must be idle. DMA_COHERENT is only valid when the engine
+ *       is connected to the accelerator coherency port of the bitstream.
+ *
+ * @param dma The DMA engine to configure.
+ * @param coherency The coherency mode of the destination buffers.
+ *
+ * @return Success or fail.
+ */
+result_t set_dma_coherency(dma_engine_t *dma, const dma_coherency_t coherency)
+{
+    AbortIfNot(dma, fail);
+    AbortIfNot(coherency == DMA_CACHED ||
+               coherency == DMA_NONCACHEABLE ||
+               coherency == DMA_COHERENT, fail);
+    AbortIf(dma->ring.running, fail);
+
+    dma->coherency = coherency;
+
+    return success;
+}
+
+/**
+ * Sets a range of memory that the processor maps uncached, whose buffers are
+ * left out of cache maintenance in every coherency mode.
+ *
+ * @param dma The DMA engine to configure.
+ * @param base The start of the range, or NULL for none.
+ * @param len The length of the range in bytes.
+ *
+ * @return Success or fail.
+ */
+result_t set_dma_uncached_range(dma_engine_t *dma, void *base, const size_t len)
+{
+    AbortIfNot(dma, fail);
+
+    dma->uncached_base = (base)? (uint8_t *)base : NULL;
+    dma->uncached_len = (base)? len : 0;
+
+    return success;
+}
+
+/**
+ * Checks if a buffer lies within the uncached range of an engine.
+ *
+ * @param dma The DMA engine.
+ * @param dest The buffer.
+ * @param len The length of the buffer in bytes.
+ *
+ * @return True if the buffer needs no cache maintenance.
+ */
+static bool dma_buffer_uncached(const dma_engine_t *dma, const void *dest, const size_t len)
+{
+    const uint8_t *start = (const uint8_t *)dest;
+    return (dma->uncached_base && start >= dma->uncached_base &&
+            len <= dma->uncached_len - (size_t)(start - dma->uncached_base))? true : false;
+}
+
+/**
+ * Prepares a destination buffer to be written by the engine.
+ *
+ * @note Cached buffers are written back so that no dirty line can later be
+ *       evicted over the received data. Callers should prepare every buffer
+ *       they are about to queue with a single call.
+ *
+ * @param dma The DMA engine that will write the buffer.
+ * @param dest The destination buffer.
+ * @param len The length of the buffer in bytes.
+ *
+ * @return None.
+ */
+void prepare_dma_buffer(dma_engine_t *dma, void *dest, const size_t len)
+{
+    if (dma->coherency == DMA_CACHED && len && !dma_buffer_uncached(dma, dest, len))
+    {
+        const tick_t start = get_system_time();
+        Xil_DCacheFlushRange((INTPTR)dest, len);
+        dma->cache_maintenance_ticks += get_system_time() - start;
+    }
+}
+
+/**
+ * Makes the data written by the engine into a buffer visible to the CPU.
+ *
+ * @note Cached buffers are invalidated, which also discards any lines that
+ *       were speculatively loaded while the transfer was in flight.
+ *
+ * @param dma The DMA engine that wrote the buffer.
+ * @param dest The destination buffer.
+ * @param len The length of the buffer in bytes.
+ *
+ * @return None.
+ */
+void complete_dma_buffer(dma_engine_t *dma, void *dest, const size_t len)
+{
+    if (dma->coherency == DMA_CACHED && len && !dma_buffer_uncached(dma, dest, len))
+    {
+        const tick_t start = get_system_time();
+        Xil_DCacheInvalidateRange((INTPTR)dest, len);
+        dma->cache_maintenance_ticks += get_system_time() - start;
+    }
+}
+
+/**
+ * Interrupt handler for the S2MM channel.
+ *
+ * @param arg The DMA engine that raised the interrupt.
+ *
+ * @return None.
+ */
+static void dma_interrupt_handler(void *arg)
+{
+    dma_engine_t *dma = (dma_engine_t *)arg;
+
+    /*
+     * Acknowledge all pending interrupt sources.
+     */
+    const uint32_t status = dma->regs->S2MM_DMASR;
+    dma->regs->S2MM_DMASR = status & DMASR_IRQ_MASK;
+
+    if (status & DMASR_ERR_IRQ)
+    {
+        dma->errors++;
+        dma->transfer_error = true;
+        trace(TRACE_DMA_ERROR, TRACE_INSTANT, dma->errors, status);
+    }
+
+    if (status & (DMASR_IOC_IRQ | DMASR_DLY_IRQ))
+    {
+        dma->completions++;
+        dma->transfer_complete = true;
+        trace(TRACE_DMA_COMPLETE, TRACE_INSTANT, dma->completions, status);
+
+        if (dma->callback)
+        {
+            dma->callback(dma, dma->callback_arg);
+        }
+    }
+}
+
+/**
+ * Converts an interrupt delay into units of the delay timer of the engine.
+ *
+ * @param delay_us The delay in microseconds.
+ *
+ * @return The number of units, rounded up.
+ */
+static uint32_t dma_irq_delay_units(const uint32_t delay_us)
+{
+    const uint64_t cycles = (uint64_t)delay_us * FPGA_CLK / 1000000;
+    return (uint32_t)((cycles + DMA_IRQ_DELAY_CYCLES - 1) / DMA_IRQ_DELAY_CYCLES);
+}
+
+/**
+ * Programs the interrupt enables and coalescing of the S2MM channel, which a
+ * reset of the engine clears.
+ *
+ * @param dma The DMA engine.
+ *
+ * @return None.
+ */
+static void write_dma_interrupt_control(dma_engine_t *dma)
+{
+    uint32_t control = dma->regs->S2MM_DMACR & ~(DMACR_IRQ_COALESCE_MASK | DMACR_DLY_IRQ_EN);
+    control |= DMACR_IOC_IRQ_EN | DMACR_ERR_IRQ_EN;
+    control |= dma->irq_threshold << DMACR_IRQ_THRESHOLD_SHIFT;
+
+    const uint32_t delay = dma_irq_delay_units(dma->irq_delay_us);
+    if (delay)
+    {
+        control |= (delay << DMACR_IRQ_DELAY_SHIFT) | DMACR_DLY_IRQ_EN;
+    }
+
+    dma->regs->S2MM_DMACR = control;
+}
+
+/**
+ * Enable the completion and error interrupts of the S2MM channel.
+ *
+ * @note Interrupts must be registered before they are globally enabled with
+ *       set_interrupts().
+ *
+ * @param dma The DMA engine to enable interrupts for.
+ * @param irq_id The GIC interrupt ID of the S2MM interrupt output.
+ *
+ * @return Success or fail.
+ */
+result_t enable_dma_interrupts(dma_engine_t *dma, const uint32_t irq_id)
+{
+    AbortIfNot(dma, fail);
+    AbortIfNot(dma->regs, fail);
+
+    dma->regs->S2MM_DMASR = DMASR_IRQ_MASK;
+    AbortIfNot(register_interrupt(irq_id, dma_interrupt_handler, dma, IRQ_PRIORITY_DMA), fail);
+
+    dma->interrupts_enabled = true;
+    write_dma_interrupt_control(dma);
+
+    return success;
+}
+
+/**
+ * Coalesces the completion interrupts of the descriptor ring, so that the
+ * interrupt rate does not follow the length of each descriptor.
+ *
+ * @note The engine interrupts once the threshold of descriptors completes.
+ *       The delay timer starts after a completion and restarts with each
+ *       packet, so while the stream runs a completion waits at most for the
+ *       threshold of packets, and once it idles for at most the delay. A
+ *       threshold above one therefore requires a delay, or the last
+ *       descriptors of a capture would never be reported.
+ *
+ * @param dma The DMA engine.
+ * @param threshold The number of completions per interrupt.
+ * @param delay_us The longest time a completion waits once the stream
+ *        idles, or zero for no delay timer.
+ *
+ * @return Success or fail.
+ */
+result_t set_dma_interrupt_coalescing(dma_engine_t *dma, const uint32_t threshold, const uint32_t delay_us)
+{
+    AbortIfNot(dma, fail);
+    AbortIfNot(dma->regs, fail);
+    AbortIfNot(threshold >= 1 && threshold <= DMA_IRQ_THRESHOLD_MAX, fail);
+    AbortIfNot(dma_irq_delay_units(delay_us) <= DMA_IRQ_DELAY_MAX, fail);
+    AbortIf(threshold > 1 && !delay_us, fail);
+
+    dma->irq_threshold = threshold;
+    dma->irq_delay_us = delay_us;
+    if (dma->interrupts_enabled)
+    {
+        write_dma_interrupt_control(dma);
+    }
+
+    return success;
+}
+
+/**
+ * Set a callback to be invoked from interrupt context on buffer completion.
+ *
+ * @param dma The DMA engine.
+ * @param callback The callback or NULL to remove the callback.
+ * @param arg The argument provided to the callback.
+ *
+ * @return Success or fail.
+ */
+result_t set_dma_callback(dma_engine_t *dma, dma_callback_t callback, void *arg)
+{
+    AbortIfNot(dma, fail);
+
+    dma->callback_arg = arg;
+    dma->callback = callback;
+
+    return success;
+}
+
+/**
+ * Check if the DMA engine was synthesized with the scatter-gather engine.
+ *
+ * @param dma The DMA engine to check.
+ *
+ * @return True if scatter-gather mode is available.
+ */
+bool dma_sg_included(dma_engine_t *dma)
+{
+    return (dma && dma->regs && (dma->regs->S2MM_DMASR & DMASR_SG_INCLUDED))?
+        true : false;
+}
+
+/**
+ * Initialize a ring of scatter-gather descriptors for the S2MM channel.
+ *
+ * @note The engine is not started until the first descriptor is queued.
+ *
+ * @param dma The DMA engine to configure.
+ * @param descriptors Storage for the descriptor ring.
+ * @param count The number of descriptors in the ring.
+ *
+ * @return Success or fail.
+ */
+result_t init_dma_sg_ring(dma_engine_t *dma,
+                          dma_descriptor_t *descriptors,
+                          const size_t count)
+{
+    AbortIfNot(dma, fail);
+    AbortIfNot(dma->regs, fail);
+    AbortIfNot(descriptors, fail);
+    AbortIfNot(count > 1, fail);
+    AbortIfNot(dma_sg_included(dma), fail);
+    AbortIfNot((uint32_t)descriptors % 64 == 0, fail);
+
+    dma->ring.descriptors = descriptors;
+    dma->ring.count = count;
+
+    AbortIfNot(reset_dma_sg_ring(dma), fail);
+
+    return success;
+}
+
+/**
+ * Reset the DMA engine and return all descriptors in the ring to software.
+ *
+ * @param dma The DMA engine to reset.
+ *
+ * @return Success or fail.
+ */
+result_t reset_dma_sg_ring(dma_engine_t *dma)
+{
+    AbortIfNot(dma, fail);
+    AbortIfNot(dma->regs, fail);
+    AbortIfNot(dma->ring.descriptors, fail);
+
+    /*
+     * Halt and reset the engine so that the current descriptor can be
+     * reprogrammed.
+     */
+    dma->regs->S2MM_DMACR |= 1 << 2;
+    while (dma->regs->S2MM_DMACR & (1 << 2));
+
+    /*
+     * A reset clears the interrupt enables and coalescing, so restore them.
+     */
+    if (dma->interrupts_enabled)
+    {
+        write_dma_interrupt_control(dma);
+    }
+
+    /*
+     * Link the descriptors into a circular list.
+     */
+    dma_sg_ring_t *ring = &dma->ring;
+    for (size_t i = 0; i < ring->count; ++i)
+    {
+        ring->descriptors[i].next_descriptor =
+            (uint32_t)&ring->descriptors[(i + 1) % ring->count];
+        ring->descriptors[i].next_descriptor_msb = 0;
+        ring->descriptors[i].buffer_address = 0;
+        ring->descriptors[i].buffer_address_msb = 0;
+        ring->descriptors[i].control = 0;
+        ring->descriptors[i].status = 0;
+    }
+
+    if (dma->coherency != DMA_COHERENT)
+    {
+        Xil_DCacheFlushRange((INTPTR)ring->descriptors,
+                             sizeof(dma_descriptor_t) * ring->count);
+    }
+
+    ring->head = 0;
+    ring->tail = 0;
+    ring->queued = 0;
+    ring->running = false;
+
+    dma->regs->S2MM_CURDESC = (uint32_t)&ring->descriptors[0];
+    dma->regs->S2MM_CURDESC_MSB = 0;
 
     return success;
 }
+
+/**
+ * Queue a buffer for reception at the head of the descriptor ring.
+ *
+ * @note The destination must be prepared with prepare_dma_buffer() by the
+ *       caller.
+ *
+ * @param dma The DMA engine to queue the buffer on.
+ * @param dest The destination of the transfer.
+ * @param len The length of the destination in bytes.
+ *
+ * @return Success or fail.
+ */
+result_t queue_dma_descriptor(dma_engine_t *dma, void *dest, uint32_t len)
+{
+    AbortIfNot(dma, fail);
+    AbortIfNot(dma->regs, fail);
+    AbortIfNot(dma->ring.descriptors, fail);
+    AbortIfNot((int)dest % 4 == 0, fail);
+    AbortIfNot(len > 0 && len <= dma->max_transfer_bytes, fail);
+    AbortIf(dma->regs->S2MM_DMASR & DMASR_ERROR_MASK, fail);
+
+    dma_sg_ring_t *ring = &dma->ring;
+    AbortIfNot(ring->queued < ring->count, fail);
+
+    dma_descriptor_t *descriptor = &ring->descriptors[ring->head];
+    descriptor->buffer_address = (uint32_t)dest;
+    descriptor->control = len;
+    descriptor->status = 0;
+    if (dma->coherency != DMA_COHERENT)
+    {
+        Xil_DCacheFlushRange((INTPTR)descriptor, sizeof(dma_descriptor_t));
+    }
+
+    ring->head = (ring->head + 1) % ring->count;
+    ring->queued++;
+
+    /*
+     * Start the engine on the first queued descriptor. Writing the tail
+     * descriptor pointer hands all descriptors up to and including it to the
+     * hardware and restarts an idle engine.
+     */
+    if (!ring->running)
+    {
+        dma->regs->S2MM_DMACR |= 1;
+        ring->running = true;
+    }
+
+    dma->regs->S2MM_TAILDESC_MSB = 0;
+    dma->regs->S2MM_TAILDESC = (uint32_t)descriptor;
+
+    return success;
+}
+
+/**
+ * Reclaim the oldest queued descriptor from the ring if it has completed.
+ *
+ * @param dma The DMA engine to reclaim from.
+ * @param[out] complete Specified true if a descriptor was reclaimed.
+ * @param[out] dest The destination buffer of the reclaimed descriptor.
+ * @param[out] len The number of bytes that were transferred.
+ *
+ * @return Success or fail.
+ */
+result_t reclaim_dma_descriptor(dma_engine_t *dma,
+                                bool *complete,
+                                void **dest,
+                                uint32_t *len)
+{
+    AbortIfNot(dma, fail);
+    AbortIfNot(dma->regs, fail);
+    AbortIfNot(dma->ring.descriptors, fail);
+    AbortIfNot(complete, fail);
+    AbortIfNot(dest, fail);
+    AbortIfNot(len, fail);
+
+    *complete = false;
+
+    /*
+     * Verify that the DMA engine has not encountered any internal errors.
+     */
+    AbortIf(dma->regs->S2MM_DMASR & DMASR_ERROR_MASK, fail);
+
+    dma_sg_ring_t *ring = &dma->ring;
+    if (ring->queued == 0)
+    {
+        return success;
+    }
+
+    dma_descriptor_t *descriptor = &ring->descriptors[ring->tail];
+    if (dma->coherency != DMA_COHERENT)
+    {
+        Xil_DCacheInvalidateRange((INTPTR)descriptor, sizeof(dma_descriptor_t));
+    }
+
+    const uint32_t status = descriptor->status;
+    if ((status & DMA_DESC_STATUS_COMPLETE) == 0)
+    {
+        return success;
+    }
+
+    if (status & DMA_DESC_STATUS_ERROR_MASK)
+    {
+        dma->errors++;
+    }
+    AbortIf(status & DMA_DESC_STATUS_ERROR_MASK, fail);
+
+    *dest = (void *)descriptor->buffer_address;
+    *len = status & DMA_DESC_LENGTH_MASK;
+    *complete = true;
+
+    ring->tail = (ring->tail + 1) % ring->count;
+    ring->queued--;
+
+    return success;
+}
+
+/**
+ * Get the number of descriptors currently owned by the hardware.
+ *
+ * @param dma The DMA engine.
+ *
+ * @return The number of queued descriptors.
+ */
+size_t get_dma_queued_descriptors(dma_engine_t *dma)
+{
+    return (dma)? dma->ring.queued : 0;
+}
+
+/**
+ * Get the number of descriptors available for queueing.
+ *
+ * @param dma The DMA engine.
+ *
+ * @return The number of free descriptors.
+ */
+size_t get_dma_free_descriptors(dma_engine_t *dma)
+{
+    return (dma)? dma->ring.count - dma->ring.queued : 0;
+}
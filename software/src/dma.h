@@ -4,9 +4,132 @@
 #include "regs/DmaRegs.h"
 #include "types.h"
 
+/**
+ * Defines an AXI DMA scatter-gather buffer descriptor. The engine requires
+ * descriptors to be aligned to 16 words.
+ */
+typedef struct dma_descriptor_t
+{
+    volatile uint32_t next_descriptor;
+    volatile uint32_t next_descriptor_msb;
+    volatile uint32_t buffer_address;
+    volatile uint32_t buffer_address_msb;
+    uint32_t reserved[2];
+    volatile uint32_t control;
+    volatile uint32_t status;
+    volatile uint32_t app[5];
+    uint32_t padding[3];
+} __attribute__((aligned(64))) dma_descriptor_t;
+
+/**
+ * Defines a ring of scatter-gather descriptors that are continually queued
+ * to the S2MM channel and reclaimed after completion.
+ */
+typedef struct dma_sg_ring_t
+{
+    /*
+     * The descriptor storage and number of descriptors in the ring.
+     */
+    dma_descriptor_t *descriptors;
+    size_t count;
+
+    /*
+     * The next descriptor to queue and the next descriptor to reclaim.
+     */
+    size_t head;
+    size_t tail;
+
+    /*
+     * The number of descriptors owned by the hardware.
+     */
+    size_t queued;
+
+    /*
+     * Specified true once the engine has been started on the ring.
+     */
+    bool running;
+} dma_sg_ring_t;
+
+/**
+ * Defines how the destination buffers of the engine are kept coherent with
+ * the data cache.
+ */
+typedef enum dma_coherency_t
+{
+    /*
+     * Buffers are cacheable and written through S_AXI_HP0, so they are
+     * flushed before being handed to the engine and invalidated once filled.
+     */
+    DMA_CACHED,
+
+    /*
+     * Buffers reside in sections mapped as non-cacheable, so no cache
+     * maintenance is needed.
+     */
+    DMA_NONCACHEABLE,
+
+    /*
+     * The engine writes through the S_AXI_ACP port, which snoops the caches
+     * of both cores. The bitstream must be built with dma_port set to ACP.
+     */
+    DMA_COHERENT
+} dma_coherency_t;
+
+struct dma_engine_t;
+
+/**
+ * Defines a callback invoked from interrupt context when a DMA buffer
+ * completes.
+ */
+typedef void (*dma_callback_t)(struct dma_engine_t *dma, void *arg);
+
 typedef struct dma_engine_t
 {
     struct DmaRegs *regs;
+    dma_sg_ring_t ring;
+    dma_coherency_t coherency;
+
+    /*
+     * The longest buffer the engine can transfer, which is set by the width
+     * of its length register.
+     */
+    uint32_t max_transfer_bytes;
+
+    /*
+     * Interrupt-driven completion state. The completion flag is set by the
+     * interrupt handler and cleared when a new transfer is started.
+     */
+    bool interrupts_enabled;
+    volatile bool transfer_complete;
+    volatile bool transfer_error;
+    volatile uint32_t completions;
+
+    /*
+     * The descriptor completions the engine coalesces into each interrupt,
+     * and how long a completion waits for the rest once the stream idles.
+     */
+    uint32_t irq_threshold;
+    uint32_t irq_delay_us;
+
+    /*
+     * The number of errors reported by the engine or its descriptors.
+     */
+    volatile uint32_t errors;
+
+    /*
+     * The time spent maintaining the data cache for DMA buffers.
+     */
+    volatile tick_t cache_maintenance_ticks;
+
+    /*
+     * A range of memory that the processor maps uncached, such as on-chip
+     * memory, whose buffers need no maintenance in any coherency mode.
+     */
+    uint8_t *uncached_base;
+    size_t uncached_len;
+
+    dma_callback_t callback;
+    void *callback_arg;
 } dma_engine_t;
 
 result_t initialize_dma(dma_engine_t *dma, uint32_t base_address);
@@ -15,4 +138,41 @@ result_t init_dma_transfer(dma_engine_t *dma, void *dest, uint32_t len);
 
 result_t wait_for_dma_transfer(dma_engine_t *dma);
 
+result_t enable_dma_interrupts(dma_engine_t *dma, const uint32_t irq_id);
+
+result_t set_dma_callback(dma_engine_t *dma, dma_callback_t callback, void *arg);
+
+result_t set_dma_interrupt_coalescing(dma_engine_t *dma, const uint32_t threshold, const uint32_t delay_us);
+
+bool dma_transfer_done(dma_engine_t *dma);
+
+result_t set_dma_length_width(dma_engine_t *dma, const uint8_t width);
+
+result_t set_dma_coherency(dma_engine_t *dma, const dma_coherency_t coherency);
+
+result_t set_dma_uncached_range(dma_engine_t *dma, void *base, const size_t len);
+
+void prepare_dma_buffer(dma_engine_t *dma, void *dest, const size_t len);
+
+void complete_dma_buffer(dma_engine_t *dma, void *dest, const size_t len);
+
+bool dma_sg_included(dma_engine_t *dma);
+
+result_t init_dma_sg_ring(dma_engine_t *dma,
+                          dma_descriptor_t *descriptors,
+                          const size_t count);
+
+result_t reset_dma_sg_ring(dma_engine_t *dma);
+
+result_t queue_dma_descriptor(dma_engine_t *dma, void *dest, uint32_t len);
+
+result_t reclaim_dma_descriptor(dma_engine_t *dma,
+                                bool *complete,
+                                void **dest,
+                                uint32_t *len);
+
+size_t get_dma_queued_descriptors(dma_engine_t *dma);
+
+size_t get_dma_free_descriptors(dma_engine_t *dma);
+
 #endif
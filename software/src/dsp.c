@@ -0,0 +1,452 @@
+#include "dsp.h"
+
+#include "abort.h"
+#include "correlation_average.h"
+#include "correlation_util.h"
+#include "db.h"
+#include "lag_tracker.h"
+#include "profile.h"
+#include "sample_clock.h"
+#include "sample_ops.h"
+#include "system.h"
+#include "system_params.h"
+#include "time_util.h"
+#include "types.h"
+
+#include <string.h>
+
+/**
+ * Normalizes, filters, locates, and correlates a ping capture.
+ *
+ * @note This does not use the network stack or any state shared with the
+ *       acquisition loop, so it is safe to run on the DSP core.
+ *
+ * @param job The job to run. The outcome is stored in the job.
+ *
+ * @return Success or fail.
+ */
+result_t run_dsp_job(dsp_job_t *job)
+{
+    AbortIfNot(job, fail);
+
+    job->status = fail;
+    job->located = false;
+    job->accepted = false;
+    job->excluded = false;
+    job->num_correlations = 0;
+    job->averaged_pings = 0;
+    job->correlation_duration = 0;
+
+    /*
+     * The filtered channels are decimated into the planar storage, so that
+     * every later stage works on fewer samples.
+     */
+    const size_t decimation = (job->correlate &&
+                               job->planar &&
+                               job->decimator &&
+                               job->decimator->sampling_frequency == job->sampling_frequency)?
+            job->decimator->factor : 1;
+    const uint32_t sampling_frequency = job->sampling_frequency / decimation;
+    job->processed_frequency = sampling_frequency;
+
+    /*
+     * Only the located window needs to be filtered unless the decimator or
+     * the pinger bank process the whole capture.
+     */
+    const bool lazy_filter = (job->params.lazy_filter &&
+                              job->params.filter &&
+                              job->correlate &&
+                              decimation == 1 &&
+                              job->params.num_pingers == 0)? true : false;
+
+    /*
+     * The offset can be removed from only the correlated window unless the
+     * filter, the decimator or the pinger bank process the whole capture.
+     */
+    const bool window_normalize = (job->params.window_normalize &&
+                                   job->correlate &&
+                                   !job->params.filter &&
+                                   decimation == 1 &&
+                                   job->params.num_pingers == 0)? true : false;
+
+    const bool planar_input = job->planar_input;
+    if (planar_input)
+    {
+        AbortIfNot(job->planar, fail);
+        AbortIfNot(job->planar->len >= job->len, fail);
+        AbortIfNot(job->correlate, fail);
+        AbortIf(job->params.filter || decimation > 1 || job->params.num_pingers, fail);
+    }
+
+    profile_mark_t mark;
+    memset(&job->channel_stats, 0, sizeof(job->channel_stats));
+    if (!window_normalize && !lazy_filter)
+    {
+        profile_begin(&mark);
+        if (planar_input)
+        {
+            AbortIfNot(normalize_planar_channels(job->planar, job->len, &job->channel_stats), fail);
+        }
+        else if (job->measured_stats && job->measured_stats->count == job->len)
+        {
+            job->channel_stats = *job->measured_stats;
+            AbortIfNot(normalize_measured_channels(job->data, job->len, &job->channel_stats), fail);
+        }
+        else
+        {
+            AbortIfNot(normalize_channels(job->data, job->len, &job->channel_stats), fail);
+        }
+        profile_end(PROFILE_NORMALIZE, &mark);
+    }
+
+    const tick_t filter_start_time = get_system_time();
+    if (job->params.filter && !lazy_filter)
+    {
+        profile_begin(&mark);
+        if (job->fir)
+        {
+            AbortIfNot(apply_fir_filter(job->fir, job->data, job->len), fail);
+        }
+        else
+        {
+            AbortIfNot(apply_filter(job->filter, job->data, job->len), fail);
+        }
+        profile_end(PROFILE_FILTER, &mark);
+    }
+
+    if (decimation > 1)
+    {
+        profile_begin(&mark);
+        AbortIfNot(decimate_channels(job->decimator, job->data, job->len, job->planar), fail);
+        profile_end(PROFILE_FILTER, &mark);
+    }
+    job->filter_duration = get_system_time() - filter_start_time;
+
+    if (job->correlate)
+    {
+        /*
+         * Locating the ping usually only reads the reference channel, so it
+         * touches a quarter of the memory once the channels are separated.
+         */
+        channel_view_t view;
+        size_t len = job->len;
+        profile_begin(&mark);
+        if (decimation > 1)
+        {
+            len = job->planar->len;
+            planar_view(job->planar, 0, len, &view);
+        }
+        else if (planar_input)
+        {
+            planar_view(job->planar, 0, job->len, &view);
+        }
+        else if (job->planar && !lazy_filter)
+        {
+            AbortIfNot(deinterleave_samples(job->data, job->len, job->planar), fail);
+            planar_view(job->planar, 0, job->len, &view);
+        }
+        else
+        {
+            interleaved_view(job->data, job->len, &view);
+        }
+
+        /*
+         * Estimate the offset and noise from the start of the capture, which
+         * is planned to precede the ping.
+         */
+        noise_stats_t noise;
+        const bool measure_noise = (window_normalize ||
+                                    lazy_filter ||
+                                    job->params.noise_threshold ||
+                                    job->params.cfar_threshold)? true : false;
+        if (measure_noise)
+        {
+            size_t noise_len = ticks_to_samples(micros_to_ticks(NOISE_ESTIMATE_DURATION_US),
+                                                sampling_frequency);
+            if (noise_len > len)
+            {
+                noise_len = len;
+            }
+
+            init_noise_stats(&noise);
+            AbortIfNot(update_noise_stats(&noise, &view, 0, noise_len), fail);
+        }
+
+        /*
+         * The window is only trimmed and its leading edges found once it is
+         * filtered, so the unfiltered capture is merely searched.
+         */
+        HydroZynqParams locate_params = job->params;
+        locate_params.envelope_onset = (lazy_filter)? false : job->params.envelope_onset;
+
+        size_t start_index = 0;
+        size_t end_index = 0;
+        size_t ping_index = 0;
+        leading_edges_t edges;
+        AbortIfNot(truncate_channels(&view,
+                                     &start_index,
+                                     &end_index,
+                                     &ping_index,
+                                     &job->located,
+                                     (job->fast_tdoa && !lazy_filter)? &edges : NULL,
+                                     locate_params,
+                                     (measure_noise)? &noise : NULL,
+                                     sampling_frequency), fail);
+        profile_end(PROFILE_TRUNCATE, &mark);
+
+        /*
+         * Filter only the window, and the margin before it that the filter
+         * settles over, and locate the ping again on the filtered channels so
+         * that it is held to the same thresholds as a filtered capture. The
+         * window is extended by the pre-ping duration, since the filtered
+         * ping may cross the threshold later than the unfiltered one.
+         */
+        size_t planar_start = 0;
+        if (lazy_filter && job->located)
+        {
+            const size_t settling = (job->fir)? job->fir->num_taps : filter_settling_samples(job->filter);
+            const size_t margin = ticks_to_samples(job->params.pre_ping_duration, sampling_frequency);
+            const size_t region_start = (start_index > settling)? start_index - settling : 0;
+            const size_t region_end = (end_index + 1 + margin < len)? end_index + 1 + margin : len;
+            const size_t region_len = region_end - region_start;
+
+            const tick_t region_start_time = get_system_time();
+            profile_begin(&mark);
+            AbortIfNot(remove_offset(&job->data[region_start], region_len, &noise), fail);
+            profile_end(PROFILE_NORMALIZE, &mark);
+
+            profile_begin(&mark);
+            if (job->fir)
+            {
+                AbortIfNot(apply_fir_filter(job->fir, &job->data[region_start], region_len), fail);
+            }
+            else
+            {
+                AbortIfNot(apply_filter(job->filter, &job->data[region_start], region_len), fail);
+            }
+            profile_end(PROFILE_FILTER, &mark);
+            job->filter_duration += get_system_time() - region_start_time;
+
+            profile_begin(&mark);
+            const size_t settled_start = start_index;
+            const size_t settled_len = region_end - settled_start;
+            if (job->planar)
+            {
+                AbortIfNot(deinterleave_samples(&job->data[settled_start], settled_len, job->planar), fail);
+                planar_view(job->planar, 0, settled_len, &view);
+                planar_start = settled_start;
+            }
+            else
+            {
+                interleaved_view(&job->data[settled_start], settled_len, &view);
+            }
+
+            /*
+             * The noise of the filtered channels is measured over the first
+             * half of the samples before the unfiltered detection, since the
+             * detection may lag the onset of the ping.
+             */
+            const size_t noise_len = (ping_index - settled_start) / 2;
+            if (noise_len)
+            {
+                init_noise_stats(&noise);
+                AbortIfNot(update_noise_stats(&noise, &view, 0, noise_len), fail);
+            }
+
+            AbortIfNot(truncate_channels(&view,
+                                         &start_index,
+                                         &end_index,
+                                         &ping_index,
+                                         &job->located,
+                                         (job->fast_tdoa)? &edges : NULL,
+                                         job->params,
+                                         (noise_len)? &noise : NULL,
+                                         sampling_frequency), fail);
+            profile_end(PROFILE_TRUNCATE, &mark);
+
+            start_index += settled_start;
+            end_index += settled_start;
+            ping_index += settled_start;
+            if (job->located && job->fast_tdoa)
+            {
+                for (size_t k = 0; k < 4; ++k)
+                {
+                    edges.index[k] += settled_start;
+                    edges.position[k] += settled_start;
+                }
+            }
+        }
+
+        /*
+         * The caller relays the window from the full rate data.
+         */
+        job->start_index = start_index * decimation;
+        job->end_index = (end_index * decimation < job->len)? end_index * decimation : job->len;
+
+        if (job->located)
+        {
+            AbortIfNot(end_index > start_index, fail);
+
+            const size_t window_len = end_index - start_index;
+            if (window_normalize)
+            {
+                profile_begin(&mark);
+                if (!planar_input)
+                {
+                    AbortIfNot(remove_offset(&job->data[start_index], window_len, &noise), fail);
+                }
+                if (job->planar)
+                {
+                    AbortIfNot(remove_planar_offset(job->planar, start_index, window_len, &noise), fail);
+                }
+                profile_end(PROFILE_NORMALIZE, &mark);
+            }
+
+            if (job->planar)
+            {
+                planar_view(job->planar, start_index - planar_start, window_len, &view);
+            }
+            else
+            {
+                interleaved_view(&job->data[start_index], window_len, &view);
+            }
+
+            /*
+             * Weak or clipped pings are rejected before the correlation,
+             * which is the most expensive stage, as are pings heard on a
+             * channel that is excluded, since every delay is needed for the
+             * bearing.
+             */
+            memset(&job->quality, 0, sizeof(job->quality));
+            if (job->excluded_channels)
+            {
+                job->excluded = true;
+            }
+            else
+            {
+                profile_begin(&mark);
+                AbortIfNot(assess_ping(&view,
+                                       ping_index - start_index,
+                                       job->params.reference_channel,
+                                       sampling_frequency,
+                                       &job->quality), fail);
+                profile_end(PROFILE_TRUNCATE, &mark);
+
+                job->accepted = (job->quality.score * 100 >= job->params.min_ping_quality)? true : false;
+            }
+
+            /*
+             * The leading edges found while the window was located give the
+             * delays in the time it takes to read the window once, and are
+             * used in place of the correlation when they are precise enough.
+             */
+            bool correlate = job->accepted;
+            if (job->accepted && job->fast_tdoa)
+            {
+                profile_begin(&mark);
+                AbortIfNot(estimate_edge_delays(&view,
+                                                &edges,
+                                                job->calibration,
+                                                &job->result,
+                                                sampling_frequency), fail);
+                profile_end(PROFILE_TRUNCATE, &mark);
+
+                if (job->result.edge_uncertainty_ns <= FAST_TDOA_MAX_UNCERTAINTY_NS)
+                {
+                    correlate = false;
+                }
+                else
+                {
+                    dbprintf("Leading edges are uncertain by %d ns, correlating.\n",
+                            (int32_t)job->result.edge_uncertainty_ns);
+                }
+            }
+
+            if (correlate)
+            {
+                correlation_weighting_t weighting;
+                get_correlation_weighting(&job->params, &weighting);
+                weighting.parallel_for = job->parallel_for;
+                weighting.calibration = job->calibration;
+
+                const bool track_lags = (job->lag_tracker && job->params.track_lags)? true : false;
+                if (track_lags && job->bearing_tracker && bearing_tracker_locked(job->bearing_tracker))
+                {
+                    AbortIfNot(predict_tracked_lags(job->bearing_tracker,
+                                                    get_system_time(),
+                                                    job->params.reference_channel,
+                                                    sampling_frequency,
+                                                    &weighting), fail);
+                }
+                else if (track_lags)
+                {
+                    AbortIfNot(predict_lags(job->lag_tracker,
+                                            job->params.reference_channel,
+                                            sampling_frequency,
+                                            &weighting), fail);
+                }
+
+                const tick_t correlation_start_time = get_system_time();
+                profile_begin(&mark);
+                AbortIfNot(cross_correlate_pairs(&view,
+                                                 job->params.reference_channel,
+                                                 &weighting,
+                                                 job->correlations,
+                                                 (job->params.all_pairs)? job->cross_correlations : NULL,
+                                                 job->correlation_len,
+                                                 &job->num_correlations,
+                                                 &job->result,
+                                                 sampling_frequency), fail);
+
+                /*
+                 * A weak peak among the tracked lags may be a sidelobe, so
+                 * every lag is searched again.
+                 */
+                if (weighting.track_lags && !lag_result_confident(&job->result))
+                {
+                    dbprintf("Tracked lags are not confident, searching every lag.\n");
+                    weighting.track_lags = false;
+                    AbortIfNot(cross_correlate_pairs(&view,
+                                                     job->params.reference_channel,
+                                                     &weighting,
+                                                     job->correlations,
+                                                     (job->params.all_pairs)? job->cross_correlations : NULL,
+                                                     job->correlation_len,
+                                                     &job->num_correlations,
+                                                     &job->result,
+                                                     sampling_frequency), fail);
+                }
+                if (track_lags)
+                {
+                    AbortIfNot(update_lag_tracker(job->lag_tracker, &job->result), fail);
+                }
+
+                /*
+                 * Only the correlations against the reference are averaged,
+                 * since they are computed in every mode.
+                 */
+                if (job->average && job->params.average_pings)
+                {
+                    AbortIfNot(accumulate_correlations(job->average,
+                                                       &view,
+                                                       job->correlations,
+                                                       job->num_correlations,
+                                                       job->params.reference_channel,
+                                                       weighting.phat,
+                                                       job->params.average_pings,
+                                                       job->params.average_exponential,
+                                                       sampling_frequency), fail);
+                    AbortIfNot(evaluate_correlation_average(job->average, &job->average_result), fail);
+                    job->averaged_pings = job->average->count;
+                }
+                profile_end(PROFILE_CORRELATE, &mark);
+                job->correlation_duration = get_system_time() - correlation_start_time;
+            }
+            job->result.quality = job->quality.score;
+        }
+    }
+
+    job->status = success;
+
+    return success;
+}
@@ -0,0 +1,170 @@
+#ifndef DSP_H
+#define DSP_H
+
+#include "bearing_tracker.h"
+#include "correlation_average.h"
+#include "correlation_util.h"
+#include "fir_filter.h"
+#include "lag_tracker.h"
+#include "types.h"
+
+/**
+ * Defines the processing of a single ping capture. The job may be run on
+ * either processor core.
+ */
+typedef struct dsp_job_t
+{
+    /*
+     * The capture to process, which is normalized and filtered in place.
+     */
+    sample_t *data;
+    size_t len;
+
+    HydroZynqParams params;
+    uint32_t sampling_frequency;
+
+    /*
+     * The prepared filter, which is only read so that it can be shared by
+     * every job.
+     */
+    const biquad_cascade_t *filter;
+
+    /*
+     * The FIR filter that is applied by overlap-save convolution in place of
+     * the biquad cascade, or NULL to use the cascade. Its blocks are worked
+     * in its own storage, so only one job may use it at a time.
+     */
+    fir_filter_t *fir;
+
+    /*
+     * The prepared decimator that the filtered channels are reduced by before
+     * the ping is located and correlated, or NULL to process them at the full
+     * rate. It is only used with planar storage and at the sampling frequency
+     * that it was designed for.
+     */
+    const decimator_t *decimator;
+
+    /*
+     * Specified true if the ping should be located and correlated after the
+     * data has been filtered.
+     */
+    bool correlate;
+    correlation_t *correlations;
+    size_t correlation_len;
+
+    /*
+     * Storage for the correlations between the channels other than the
+     * reference, which must hold correlation_len entries when all pairs are
+     * correlated.
+     */
+    correlation_t *cross_correlations;
+
+    /*
+     * Storage to de-interleave the filtered capture into before it is located
+     * and correlated, or NULL to work on the interleaved samples.
+     */
+    planar_samples_t *planar;
+
+    /*
+     * Specified true if the capture was recorded straight into the planar
+     * storage, which is then normalized and searched where it lies, so that
+     * data is neither read nor written. It is only used unfiltered, at the
+     * full rate and with a single pinger, and the caller copies the ranges
+     * it relays back into data.
+     */
+    bool planar_input;
+
+    /*
+     * The statistics of each channel of the whole capture as the ADC
+     * measured them while it was recorded, or NULL to measure them while the
+     * capture is normalized. The offsets are then only subtracted.
+     */
+    const channel_stats_t *measured_stats;
+
+    /*
+     * The average that the correlations of accepted pings are added to, or
+     * NULL to correlate each ping alone.
+     */
+    correlation_average_t *average;
+
+    /*
+     * The tracker that predicts the lags of each pair from recent pings, or
+     * NULL to always search every lag.
+     */
+    lag_tracker_t *lag_tracker;
+
+    /*
+     * The tracker of the delays of recent pings, whose prediction is
+     * searched in place of the lag tracker's once it is locked, or NULL.
+     */
+    const bearing_tracker_t *bearing_tracker;
+
+    /*
+     * A mask of the channels that must not be correlated, with bit k set for
+     * channel k. A located ping is not correlated while any is set.
+     */
+    uint8_t excluded_channels;
+
+    /*
+     * The calibration that the delays and amplitudes of the channels are
+     * corrected by, or NULL to report them as measured.
+     */
+    const channel_calibration_t *calibration;
+
+    /*
+     * Specified true if an accepted ping's delays may be taken from the
+     * leading edges of its channels, which skips the correlation unless the
+     * edges are too uncertain. The result then has its leading_edge set.
+     */
+    bool fast_tdoa;
+
+    /*
+     * The loop that the correlation is split across cores with, or NULL to
+     * correlate on the core that runs the job.
+     */
+    parallel_for_t parallel_for;
+
+    /*
+     * The outcome of the job.
+     */
+    result_t status;
+    bool located;
+
+    /*
+     * The sampling frequency that the ping was located and correlated at,
+     * and which the correlation lags are counted in. The start and end of
+     * the ping are indices of the full rate data.
+     */
+    uint32_t processed_frequency;
+
+    /*
+     * Specified true if the located ping passed the quality gate and was
+     * correlated.
+     */
+    bool accepted;
+    ping_quality_t quality;
+
+    /*
+     * Specified true if the located ping was not correlated because of the
+     * excluded channels.
+     */
+    bool excluded;
+
+    /*
+     * The statistics of each channel of the whole capture, which are only
+     * measured when the whole capture is normalized.
+     */
+    channel_stats_t channel_stats;
+    size_t start_index;
+    size_t end_index;
+    size_t num_correlations;
+    correlation_result_t result;
+    correlation_result_t average_result;
+    uint32_t averaged_pings;
+    tick_t filter_duration;
+    tick_t correlation_duration;
+} dsp_job_t;
+
+result_t run_dsp_job(dsp_job_t *job);
+
+#endif
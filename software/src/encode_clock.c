@@ -0,0 +1,125 @@
+#include "encode_clock.h"
+
+#include "abort.h"
+#include "system.h"
+#include "system_params.h"
+#include "time_util.h"
+
+/*
+ * The limits of the MMCM of the -1 speed grade. The multiplier and divider
+ * are in eighths, which is the resolution of their fractional parts.
+ */
+#define MMCM_VCO_MIN_HZ 600000000ull
+#define MMCM_VCO_MAX_HZ 1200000000ull
+#define MMCM_PFD_MIN_HZ 10000000
+#define MMCM_MULT_MIN_EIGHTHS (2 * 8)
+#define MMCM_MULT_MAX_EIGHTHS (64 * 8)
+#define MMCM_DIVIDE_MIN_EIGHTHS (2 * 8)
+#define MMCM_DIVIDE_MAX_EIGHTHS (128 * 8)
+
+/**
+ * Initializes the encode clock generator. The MMCM starts at the frequency
+ * it was built with, which is the fabric clock.
+ *
+ * @param[out] clock The encode clock to initialize.
+ * @param base_address The address of the clocking wizard.
+ *
+ * @return Success or fail.
+ */
+result_t init_encode_clock(encode_clock_t *clock, uint32_t base_address)
+{
+    AbortIfNot(clock, fail);
+    AbortIfNot(base_address, fail);
+
+    clock->regs = (struct ClkWizRegs *)base_address;
+    clock->frequency = FPGA_CLK;
+
+    return success;
+}
+
+/**
+ * Retunes the encode clock generator to the nearest frequency that the MMCM
+ * can reach from the fabric clock.
+ *
+ * @note The encode clock stops while the MMCM relocks, so the ADC stream
+ *       should be stopped first.
+ *
+ * @param clock The encode clock.
+ * @param frequency The requested frequency in Hz. The frequency that was
+ *        reached is kept in the encode clock.
+ *
+ * @return Success or fail.
+ */
+result_t set_encode_clock_frequency(encode_clock_t *clock, const uint32_t frequency)
+{
+    AbortIfNot(clock, fail);
+    AbortIfNot(clock->regs, fail);
+    AbortIfNot(frequency >= ENCODE_CLOCK_MIN_HZ && frequency <= ENCODE_CLOCK_MAX_HZ, fail);
+
+    /*
+     * The output is FPGA_CLK * mult / (divclk * divide). Each setting is
+     * compared by its error scaled by divclk * divide, so the search stays in
+     * integers.
+     */
+    const uint64_t input = FPGA_CLK;
+    uint32_t best_divclk = 0, best_mult = 0, best_divide = 0;
+    uint64_t best_error = 0, best_scale = 1;
+    for (uint32_t divclk = 1; input / divclk >= MMCM_PFD_MIN_HZ; ++divclk)
+    {
+        for (uint32_t mult = MMCM_MULT_MIN_EIGHTHS; mult <= MMCM_MULT_MAX_EIGHTHS; ++mult)
+        {
+            const uint64_t vco_eighths = input * mult / divclk;
+            if (vco_eighths < MMCM_VCO_MIN_HZ * 8 || vco_eighths > MMCM_VCO_MAX_HZ * 8)
+            {
+                continue;
+            }
+
+            const uint64_t target = (uint64_t)frequency * divclk;
+            uint64_t divide = (input * mult + target / 2) / target;
+            if (divide < MMCM_DIVIDE_MIN_EIGHTHS || divide > MMCM_DIVIDE_MAX_EIGHTHS)
+            {
+                continue;
+            }
+
+            const uint64_t reached = input * mult;
+            const uint64_t error = (reached > target * divide)?
+                    reached - target * divide : target * divide - reached;
+            const uint64_t scale = divclk * divide;
+            if (!best_divclk || error * best_scale < best_error * scale)
+            {
+                best_divclk = divclk;
+                best_mult = mult;
+                best_divide = divide;
+                best_error = error;
+                best_scale = scale;
+            }
+        }
+    }
+    AbortIfNot(best_divclk, fail);
+
+    clock->regs->clock_config = (best_divclk & CLK_WIZ_DIVCLK_MASK) |
+            (((best_mult / 8) << CLK_WIZ_MULT_SHIFT) & CLK_WIZ_MULT_MASK) |
+            ((((best_mult % 8) * 125) << CLK_WIZ_MULT_FRAC_SHIFT) & CLK_WIZ_MULT_FRAC_MASK);
+    clock->regs->feedback_phase = 0;
+    clock->regs->clkout0_divide = ((best_divide / 8) & CLK_WIZ_DIVIDE_MASK) |
+            ((((best_divide % 8) * 125) << CLK_WIZ_DIVIDE_FRAC_SHIFT) & CLK_WIZ_DIVIDE_FRAC_MASK);
+    clock->regs->clkout0_phase = 0;
+    clock->regs->clkout0_duty = CLK_WIZ_DUTY_50_PERCENT;
+    clock->regs->load = CLK_WIZ_LOAD | CLK_WIZ_SADDR;
+
+    /*
+     * Lock drops shortly after the load, so it is only waited for after the
+     * reconfiguration has had time to begin.
+     */
+    busywait(micros_to_ticks(10));
+    const tick_t start_time = get_system_time();
+    while ((clock->regs->SR & CLK_WIZ_LOCKED) == 0)
+    {
+        AbortIf(get_system_time() - start_time > micros_to_ticks(ENCODE_CLOCK_LOCK_TIMEOUT_US), fail);
+    }
+
+    const uint64_t scale = (uint64_t)best_divclk * best_divide;
+    clock->frequency = (input * best_mult + scale / 2) / scale;
+
+    return success;
+}
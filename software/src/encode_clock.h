@@ -0,0 +1,36 @@
+#ifndef ENCODE_CLOCK_H
+#define ENCODE_CLOCK_H
+
+#include "regs/ClkWizRegs.h"
+#include "types.h"
+
+/**
+ * The range of reference frequencies that the encode clock generator may be
+ * tuned to. The upper bound is set by the divider in the fabric.
+ */
+#define ENCODE_CLOCK_MIN_HZ 5000000
+#define ENCODE_CLOCK_MAX_HZ 200000000
+
+/**
+ * The longest time to wait for the MMCM to lock after it is retuned.
+ */
+#define ENCODE_CLOCK_LOCK_TIMEOUT_US 1000
+
+/**
+ * Defines the reconfigurable MMCM that the ADC encode clock is divided from.
+ */
+typedef struct encode_clock_t
+{
+    struct ClkWizRegs *regs;
+
+    /*
+     * The frequency that the MMCM is tuned to, in Hz.
+     */
+    uint32_t frequency;
+} encode_clock_t;
+
+result_t init_encode_clock(encode_clock_t *clock, uint32_t base_address);
+
+result_t set_encode_clock_frequency(encode_clock_t *clock, const uint32_t frequency);
+
+#endif
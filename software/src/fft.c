@@ -0,0 +1,166 @@
+#include "fft.h"
+
+#include "abort.h"
+#include "types.h"
+
+#include <math.h>
+
+#define PI 3.14159265358979323846
+
+/**
+ * Twiddle factors for the largest supported transform. Smaller transforms use
+ * a strided subset of the table.
+ */
+static complex_t twiddles[FFT_MAX_SIZE / 2];
+
+/**
+ * The bit-reversed index of every point of the largest supported transform.
+ * The reordering of a smaller transform of n points shifts these right by
+ * the base-2 logarithm of FFT_MAX_SIZE / n, so one table plans every size.
+ */
+static uint16_t bit_reversed[FFT_MAX_SIZE];
+
+/**
+ * Specified true once the twiddle and bit reversal tables have been
+ * computed.
+ */
+static bool twiddles_initialized = false;
+
+/**
+ * Computes the twiddle and bit reversal tables for the largest supported
+ * transform.
+ *
+ * @return None.
+ */
+static void init_twiddles()
+{
+    for (size_t k = 0; k < FFT_MAX_SIZE / 2; ++k)
+    {
+        const double angle = -2.0 * PI * k / FFT_MAX_SIZE;
+        twiddles[k].re = cos(angle);
+        twiddles[k].im = sin(angle);
+    }
+
+    for (size_t i = 0; i < FFT_MAX_SIZE; ++i)
+    {
+        size_t reversed = 0;
+        for (size_t bit = 0; bit < FFT_MAX_LOG2; ++bit)
+        {
+            reversed |= ((i >> bit) & 1) << (FFT_MAX_LOG2 - 1 - bit);
+        }
+        bit_reversed[i] = reversed;
+    }
+
+    twiddles_initialized = true;
+}
+
+/**
+ * Computes the twiddle and bit reversal tables if they have not been
+ * computed yet.
+ *
+ * @note Transforms may only run on several cores at once after the tables
+ *       have been computed.
+ *
+ * @return None.
+ */
+void init_fft()
+{
+    if (!twiddles_initialized)
+    {
+        init_twiddles();
+    }
+}
+
+/**
+ * Finds the transform size needed to hold a number of points.
+ *
+ * @param len The number of points.
+ *
+ * @return The smallest power of two that is at least len.
+ */
+size_t fft_size(const size_t len)
+{
+    size_t n = 1;
+    while (n < len)
+    {
+        n <<= 1;
+    }
+
+    return n;
+}
+
+/**
+ * Computes an in-place radix-2 complex FFT.
+ *
+ * @note The inverse transform is scaled by 1/n.
+ *
+ * @param data The data to transform.
+ * @param n The number of points. Must be a power of two no larger than
+ *        FFT_MAX_SIZE.
+ * @param inverse Specified true to compute the inverse transform.
+ *
+ * @return Success or fail.
+ */
+result_t fft(complex_t *data, const size_t n, const bool inverse)
+{
+    AbortIfNot(data, fail);
+    AbortIfNot(n > 0 && n <= FFT_MAX_SIZE, fail);
+    AbortIfNot((n & (n - 1)) == 0, fail);
+
+    init_fft();
+
+    /*
+     * Reorder the input into bit-reversed order from the planned indices.
+     */
+    const int shift = FFT_MAX_LOG2 - __builtin_ctz(n);
+    for (size_t i = 1; i < n; ++i)
+    {
+        const size_t j = bit_reversed[i] >> shift;
+        if (i < j)
+        {
+            const complex_t tmp = data[i];
+            data[i] = data[j];
+            data[j] = tmp;
+        }
+    }
+
+    /*
+     * Perform the butterfly stages.
+     */
+    for (size_t len = 2; len <= n; len <<= 1)
+    {
+        const size_t half = len >> 1;
+        const size_t stride = FFT_MAX_SIZE / len;
+        for (size_t i = 0; i < n; i += len)
+        {
+            for (size_t k = 0; k < half; ++k)
+            {
+                const complex_t w = twiddles[k * stride];
+                const float w_im = (inverse)? -w.im : w.im;
+
+                complex_t *a = &data[i + k];
+                complex_t *b = &data[i + k + half];
+
+                const float v_re = b->re * w.re - b->im * w_im;
+                const float v_im = b->re * w_im + b->im * w.re;
+
+                b->re = a->re - v_re;
+                b->im = a->im - v_im;
+                a->re += v_re;
+                a->im += v_im;
+            }
+        }
+    }
+
+    if (inverse)
+    {
+        const float scale = 1.0f / n;
+        for (size_t i = 0; i < n; ++i)
+        {
+            data[i].re *= scale;
+            data[i].im *= scale;
+        }
+    }
+
+    return success;
+}
@@ -0,0 +1,31 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include "types.h"
+
+/**
+ * The base-2 logarithm of the largest supported transform.
+ */
+#define FFT_MAX_LOG2 16
+
+/**
+ * The largest supported transform size.
+ */
+#define FFT_MAX_SIZE (1 << FFT_MAX_LOG2)
+
+/**
+ * Defines a single-precision complex value.
+ */
+typedef struct complex_t
+{
+    float re;
+    float im;
+} complex_t;
+
+void init_fft();
+
+size_t fft_size(const size_t len);
+
+result_t fft(complex_t *data, const size_t n, const bool inverse);
+
+#endif
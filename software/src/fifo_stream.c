@@ -1,9 +1,16 @@
 #include "fifo_stream.h"
 
 #include "abort.h"
+#include "system.h"
+#include "time_util.h"
 #include "types.h"
 #include "regs/fifo_stream_regs.h"
 
+/**
+ * The time the FIFO may take to complete a reset.
+ */
+#define FIFO_RESET_TIMEOUT_MS 10
+
 result_t init_fifo_stream(fifo_stream_t *fifo, uintptr_t base_addr)
 {
     AbortIfNot(fifo, fail);
@@ -43,7 +50,11 @@ result_t reset_fifo_stream(fifo_stream_t *fifo)
     /*
      * Wait for the FIFO reset to complete.
      */
-    while (!(fifo->reg_base->ISR & (1 << 23)));
+    const tick_t start_time = get_system_time();
+    while (!(fifo->reg_base->ISR & (1 << 23)))
+    {
+        AbortIf(get_system_time() - start_time > ms_to_ticks(FIFO_RESET_TIMEOUT_MS), fail);
+    }
 
     return success;
 }
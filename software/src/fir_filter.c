@@ -0,0 +1,241 @@
+#include "fir_filter.h"
+
+#include "abort.h"
+#include "fft.h"
+#include "types.h"
+
+#include <math.h>
+#include <string.h>
+
+#define PI 3.14159265358979323846
+
+/**
+ * Initializes a FIR filter without taps.
+ *
+ * @param[out] filter The filter to initialize.
+ * @param spectrum The storage of the spectrum of the taps, which holds
+ *        fft_capacity values.
+ * @param work The storage of the transformed blocks, which holds twice
+ *        fft_capacity values.
+ * @param history The storage of the inputs kept between blocks, which holds
+ *        twice tap_capacity values.
+ * @param tap_capacity The longest filter, which must be a power of two.
+ * @param fft_capacity The longest transform, which must be at least
+ *        FIR_FILTER_FFT_LEN(tap_capacity).
+ *
+ * @return Success or fail.
+ */
+result_t init_fir_filter(fir_filter_t *filter,
+                         complex_t *spectrum,
+                         complex_t *work,
+                         complex_t *history,
+                         const size_t tap_capacity,
+                         const size_t fft_capacity)
+{
+    AbortIfNot(filter, fail);
+    AbortIfNot(spectrum, fail);
+    AbortIfNot(work, fail);
+    AbortIfNot(history, fail);
+    AbortIfNot(tap_capacity && (tap_capacity & (tap_capacity - 1)) == 0, fail);
+    AbortIfNot(fft_capacity >= FIR_FILTER_FFT_LEN(tap_capacity), fail);
+    AbortIfNot(fft_capacity <= FFT_MAX_SIZE, fail);
+
+    filter->spectrum = spectrum;
+    filter->num_taps = 0;
+    filter->tap_capacity = tap_capacity;
+    filter->fft_len = 0;
+    filter->fft_capacity = fft_capacity;
+    filter->hop = 0;
+    filter->work[0] = work;
+    filter->work[1] = &work[fft_capacity];
+    filter->history[0] = history;
+    filter->history[1] = &history[tap_capacity];
+    filter->ready = false;
+
+    return success;
+}
+
+/**
+ * Sets the taps of a FIR filter and prepares their spectrum.
+ *
+ * @param filter The filter.
+ * @param taps The taps, or NULL with no taps to remove the filter.
+ * @param num_taps The number of taps.
+ *
+ * @return Success or fail.
+ */
+result_t set_fir_taps(fir_filter_t *filter, const float *taps, const size_t num_taps)
+{
+    AbortIfNot(filter, fail);
+    AbortIfNot(taps || !num_taps, fail);
+    AbortIfNot(num_taps <= filter->tap_capacity, fail);
+
+    filter->ready = false;
+    filter->num_taps = num_taps;
+    if (!num_taps)
+    {
+        return success;
+    }
+
+    filter->fft_len = fft_size(FIR_FILTER_FFT_LEN(num_taps));
+    filter->hop = filter->fft_len - num_taps + 1;
+    for (size_t k = 0; k < filter->fft_len; ++k)
+    {
+        filter->spectrum[k].re = (k < num_taps)? taps[k] : 0;
+        filter->spectrum[k].im = 0;
+    }
+    AbortIfNot(fft(filter->spectrum, filter->fft_len, false), fail);
+
+    filter->ready = true;
+
+    return success;
+}
+
+/**
+ * Designs a linear phase bandpass FIR filter as a Blackman windowed
+ * difference of two sincs, with unity gain at the center of the band.
+ *
+ * @note The transition of the Blackman window is about 5.5 times the
+ *       sampling frequency over the number of taps wide, and its stopband is
+ *       74 dB down, so sharp filters need many taps.
+ *
+ * @param[out] taps The taps, which hold num_taps values.
+ * @param num_taps The number of taps, which must be odd so that the filter
+ *        delays every frequency by a whole number of samples.
+ * @param low_hz The lower edge of the band.
+ * @param high_hz The upper edge of the band.
+ * @param sampling_frequency The sampling frequency of the data.
+ *
+ * @return Success or fail.
+ */
+result_t design_fir_bandpass(float *taps,
+                             const size_t num_taps,
+                             const uint32_t low_hz,
+                             const uint32_t high_hz,
+                             const uint32_t sampling_frequency)
+{
+    AbortIfNot(taps, fail);
+    AbortIfNot(num_taps % 2 == 1, fail);
+    AbortIfNot(low_hz < high_hz, fail);
+    AbortIfNot(high_hz * 2 < sampling_frequency, fail);
+
+    const double low = (double)low_hz / sampling_frequency;
+    const double high = (double)high_hz / sampling_frequency;
+    const int32_t half = num_taps / 2;
+    for (int32_t k = 0; k < (int32_t)num_taps; ++k)
+    {
+        const int32_t n = k - half;
+        const double band = (n == 0)? 2 * (high - low) :
+                (sin(2 * PI * high * n) - sin(2 * PI * low * n)) / (PI * n);
+        const double phase = 2 * PI * k / (num_taps - 1);
+        const double window = 0.42 - 0.5 * cos(phase) + 0.08 * cos(2 * phase);
+        taps[k] = band * window;
+    }
+
+    /*
+     * Normalize the gain at the center of the band.
+     */
+    const double center = (low + high) / 2;
+    double re = 0, im = 0;
+    for (int32_t k = 0; k < (int32_t)num_taps; ++k)
+    {
+        re += taps[k] * cos(2 * PI * center * k);
+        im += taps[k] * sin(2 * PI * center * k);
+    }
+
+    const double gain = sqrt(re * re + im * im);
+    AbortIfNot(gain > 0, fail);
+    for (size_t k = 0; k < num_taps; ++k)
+    {
+        taps[k] /= gain;
+    }
+
+    return success;
+}
+
+/**
+ * Rounds and saturates a filtered value back to a sample.
+ *
+ * @param value The filtered value.
+ *
+ * @return The sample.
+ */
+static analog_sample_t to_sample(const float value)
+{
+    const float rounded = roundf(value);
+    return (rounded > INT16_MAX)? INT16_MAX :
+           (rounded < INT16_MIN)? INT16_MIN : (analog_sample_t)rounded;
+}
+
+/**
+ * Filters all channels of a capture through a FIR filter in place from rest.
+ *
+ * @note Each block transforms the hop new samples of two channels after the
+ *       last num_taps - 1 samples of the previous block, and keeps the
+ *       outputs that are free of circular wrap. The inputs that the next
+ *       block needs are kept before the outputs overwrite them.
+ *
+ * @param filter The filter, which must hold taps.
+ * @param data The samples to filter.
+ * @param len The number of samples.
+ *
+ * @return Success or fail.
+ */
+result_t apply_fir_filter(fir_filter_t *filter, sample_t *data, const size_t len)
+{
+    AbortIfNot(filter, fail);
+    AbortIfNot(filter->ready, fail);
+    AbortIfNot(data, fail);
+
+    const size_t n = filter->fft_len;
+    const size_t keep = filter->num_taps - 1;
+    for (size_t p = 0; p < 2; ++p)
+    {
+        memset(filter->history[p], 0, keep * sizeof(complex_t));
+    }
+
+    for (size_t start = 0; start < len; start += filter->hop)
+    {
+        const size_t count = (len - start < filter->hop)? len - start : filter->hop;
+        for (size_t p = 0; p < 2; ++p)
+        {
+            complex_t *work = filter->work[p];
+            memcpy(work, filter->history[p], keep * sizeof(complex_t));
+            for (size_t j = 0; j < count; ++j)
+            {
+                work[keep + j].re = data[start + j].sample[2 * p];
+                work[keep + j].im = data[start + j].sample[2 * p + 1];
+            }
+            for (size_t j = keep + count; j < n; ++j)
+            {
+                work[j].re = work[j].im = 0;
+            }
+
+            /*
+             * The last inputs of a full block begin the next one.
+             */
+            if (count == filter->hop)
+            {
+                memcpy(filter->history[p], &work[count], keep * sizeof(complex_t));
+            }
+
+            AbortIfNot(fft(work, n, false), fail);
+            for (size_t k = 0; k < n; ++k)
+            {
+                const complex_t a = work[k];
+                const complex_t b = filter->spectrum[k];
+                work[k].re = a.re * b.re - a.im * b.im;
+                work[k].im = a.re * b.im + a.im * b.re;
+            }
+            AbortIfNot(fft(work, n, true), fail);
+
+            for (size_t j = 0; j < count; ++j)
+            {
+                data[start + j].sample[2 * p] = to_sample(work[keep + j].re);
+                data[start + j].sample[2 * p + 1] = to_sample(work[keep + j].im);
+            }
+        }
+    }
+
+    return success;
+}
@@ -0,0 +1,65 @@
+#ifndef FIR_FILTER_H
+#define FIR_FILTER_H
+
+#include "fft.h"
+#include "types.h"
+
+/**
+ * The longest transform that a FIR filter of a number of taps uses. The
+ * transform is about four times the filter, so that each block keeps most of
+ * its outputs while its cost per sample stays close to the least.
+ */
+#define FIR_FILTER_FFT_LEN(num_taps) (4 * (num_taps))
+
+/**
+ * Defines a FIR filter of the four channels of a capture that is applied by
+ * overlap-save FFT convolution. Two channels are transformed together, one
+ * in the real part and one in the imaginary part, which the real taps keep
+ * apart. The cost per sample grows with the logarithm of the filter length
+ * rather than with its length.
+ */
+typedef struct fir_filter_t
+{
+    /*
+     * The spectrum of the taps, zero padded to the transform length.
+     */
+    complex_t *spectrum;
+    size_t num_taps;
+    size_t tap_capacity;
+
+    /*
+     * The transform length and the number of new samples in each block.
+     */
+    size_t fft_len;
+    size_t fft_capacity;
+    size_t hop;
+
+    /*
+     * The block of each pair of channels being transformed, and the inputs
+     * of the previous block that the next one starts with, which hold
+     * fft_capacity and tap_capacity values each.
+     */
+    complex_t *work[2];
+    complex_t *history[2];
+
+    bool ready;
+} fir_filter_t;
+
+result_t init_fir_filter(fir_filter_t *filter,
+                         complex_t *spectrum,
+                         complex_t *work,
+                         complex_t *history,
+                         const size_t tap_capacity,
+                         const size_t fft_capacity);
+
+result_t set_fir_taps(fir_filter_t *filter, const float *taps, const size_t num_taps);
+
+result_t design_fir_bandpass(float *taps,
+                             const size_t num_taps,
+                             const uint32_t low_hz,
+                             const uint32_t high_hz,
+                             const uint32_t sampling_frequency);
+
+result_t apply_fir_filter(fir_filter_t *filter, sample_t *data, const size_t len);
+
+#endif
@@ -2,6 +2,13 @@
 #include "regs/system_registers.h"
 
 #include "abort.h"
+#include "system.h"
+
+/**
+ * The handler of the pending alarm and its argument.
+ */
+static global_timer_alarm_t alarm_handler = NULL;
+static void *alarm_arg = NULL;
 
 result_t init_global_timer()
 {
@@ -21,7 +28,7 @@ result_t init_global_timer()
     /*
      * Enable the global timer without a prescaler.
      */
-    global_timer_regs->Control_Register = 1;
+    global_timer_regs->Control_Register = GLOBAL_TIMER_ENABLE;
 
     return success;
 }
@@ -51,3 +58,87 @@ uint64_t get_global_timer_count()
      */
     return ((((uint64_t)upper_portion) << 32) | lower_portion);
 }
+
+/**
+ * Handles the comparator interrupt of the global timer. The alarm is disabled
+ * before its handler is called, so each alarm fires once.
+ *
+ * @param arg Unused.
+ *
+ * @return None.
+ */
+static void global_timer_interrupt_handler(void *arg)
+{
+    global_timer_regs->Control_Register = GLOBAL_TIMER_ENABLE;
+    global_timer_regs->Interrupt_Status_Register = GLOBAL_TIMER_EVENT_FLAG;
+
+    const global_timer_alarm_t handler = alarm_handler;
+    alarm_handler = NULL;
+    if (handler)
+    {
+        handler(alarm_arg);
+    }
+}
+
+/**
+ * Registers the comparator interrupt of the global timer.
+ *
+ * @note Interrupts must be registered before they are globally enabled with
+ *       set_interrupts().
+ *
+ * @return Success or fail.
+ */
+result_t enable_global_timer_interrupts()
+{
+    cancel_global_timer_alarm();
+    AbortIfNot(register_interrupt(GLOBAL_TIMER_IRQ_ID, global_timer_interrupt_handler, NULL, IRQ_PRIORITY_CAPTURE), fail);
+
+    return success;
+}
+
+/**
+ * Arms the comparator to call a handler once the global timer reaches a
+ * count. A count that has already passed fires immediately.
+ *
+ * @note Only one alarm is pending at a time, and arming replaces it.
+ *
+ * @param count The global timer count at which the alarm fires.
+ * @param alarm The handler called from interrupt context.
+ * @param arg The argument provided to the handler.
+ *
+ * @return Success or fail.
+ */
+result_t set_global_timer_alarm(const uint64_t count, global_timer_alarm_t alarm, void *arg)
+{
+    AbortIfNot(alarm, fail);
+
+    /*
+     * The comparator is disabled while both halves are written so that a
+     * partially written value cannot match.
+     */
+    global_timer_regs->Control_Register = GLOBAL_TIMER_ENABLE;
+    global_timer_regs->Interrupt_Status_Register = GLOBAL_TIMER_EVENT_FLAG;
+
+    alarm_handler = alarm;
+    alarm_arg = arg;
+
+    global_timer_regs->Comparator_Value_Register[0] = (uint32_t)count;
+    global_timer_regs->Comparator_Value_Register[1] = (uint32_t)(count >> 32);
+    global_timer_regs->Control_Register = GLOBAL_TIMER_ENABLE |
+                                          GLOBAL_TIMER_COMP_ENABLE |
+                                          GLOBAL_TIMER_IRQ_ENABLE;
+
+    return success;
+}
+
+/**
+ * Disarms the pending global timer alarm, if any.
+ *
+ * @return None.
+ */
+void cancel_global_timer_alarm()
+{
+    global_timer_regs->Control_Register = GLOBAL_TIMER_ENABLE;
+    global_timer_regs->Interrupt_Status_Register = GLOBAL_TIMER_EVENT_FLAG;
+    alarm_handler = NULL;
+}
@@ -3,8 +3,25 @@
 
 #include "types.h"
 
+/**
+ * The private peripheral interrupt of the global timer comparator.
+ */
+#define GLOBAL_TIMER_IRQ_ID 27
+
+/**
+ * Defines the handler of a global timer alarm, which is called from
+ * interrupt context.
+ */
+typedef void (*global_timer_alarm_t)(void *arg);
+
 result_t init_global_timer();
 
 uint64_t get_global_timer_count();
 
+result_t enable_global_timer_interrupts();
+
+result_t set_global_timer_alarm(const uint64_t count, global_timer_alarm_t alarm, void *arg);
+
+void cancel_global_timer_alarm();
+
 #endif
@@ -0,0 +1,61 @@
+#include "hp_port.h"
+
+#include "abort.h"
+#include "regs/afi_regs.h"
+
+/**
+ * Gets the AXI FIFO interface of an HP port.
+ *
+ * @param port The port, from 0 to 3.
+ *
+ * @return The registers of the port.
+ */
+static struct AfiRegs *get_afi_regs(const uint8_t port)
+{
+    return (struct AfiRegs *)(AFI_BASE_ADDRESS + AFI_PORT_STRIDE * port);
+}
+
+/**
+ * Sets a static QoS priority for the writes of an HP port. The AXI DMA does
+ * not drive AWQOS, so the priority of the fabric is replaced.
+ *
+ * @param port The port, from 0 to 3.
+ * @param qos The priority, from 0 to 15, where 15 is the highest.
+ *
+ * @return Success or fail.
+ */
+result_t set_hp_port_write_qos(const uint8_t port, const uint8_t qos)
+{
+    AbortIfNot(port < AFI_PORTS, fail);
+    AbortIfNot(qos <= AFI_QOS_MASK, fail);
+
+    struct AfiRegs *regs = get_afi_regs(port);
+    regs->WRQOS = qos;
+    regs->WRCHAN_CTRL &= ~AFI_CTRL_FABRIC_QOS_EN;
+
+    return success;
+}
+
+/**
+ * Reads back the write channel configuration of an HP port.
+ *
+ * @param port The port, from 0 to 3.
+ * @param[out] config The configuration.
+ *
+ * @return Success or fail.
+ */
+result_t read_hp_port_config(const uint8_t port, hp_port_config_t *config)
+{
+    AbortIfNot(port < AFI_PORTS, fail);
+    AbortIfNot(config, fail);
+
+    struct AfiRegs *regs = get_afi_regs(port);
+    const uint32_t ctrl = regs->WRCHAN_CTRL;
+    config->data_width = (ctrl & AFI_CTRL_32BIT_EN)? 32 : 64;
+    config->fabric_qos = (ctrl & AFI_CTRL_FABRIC_QOS_EN)? true : false;
+    config->write_qos = regs->WRQOS & AFI_QOS_MASK;
+    config->issuing_cap = (regs->WRCHAN_ISSUINGCAP & AFI_ISSUINGCAP_MASK) + 1;
+    config->fifo_level = regs->WRDATAFIFO_LEVEL & AFI_FIFO_LEVEL_MASK;
+
+    return success;
+}
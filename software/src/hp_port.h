@@ -0,0 +1,36 @@
+#ifndef HP_PORT_H
+#define HP_PORT_H
+
+#include "types.h"
+
+/**
+ * Defines the write channel configuration of an S_AXI_HP port as read back
+ * from its AXI FIFO interface.
+ */
+typedef struct hp_port_config_t
+{
+    /*
+     * The width of the port in bits, set by the bitstream.
+     */
+    uint8_t data_width;
+
+    /*
+     * The static QoS priority of writes, and whether the priority is taken
+     * from AWQOS of the fabric master instead.
+     */
+    uint8_t write_qos;
+    bool fabric_qos;
+
+    /*
+     * The most write commands the port keeps outstanding to DDR, and the
+     * 64-bit words waiting in its write FIFO.
+     */
+    uint8_t issuing_cap;
+    uint8_t fifo_level;
+} hp_port_config_t;
+
+result_t set_hp_port_write_qos(const uint8_t port, const uint8_t qos);
+
+result_t read_hp_port_config(const uint8_t port, hp_port_config_t *config);
+
+#endif
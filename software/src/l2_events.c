@@ -0,0 +1,58 @@
+#include "l2_events.h"
+
+#include "system.h"
+#include "types.h"
+#include "xil_io.h"
+#include "xl2cc.h"
+#include "xparameters.h"
+
+/**
+ * The fields of the event counter control register, and the position of the
+ * event source within each counter configuration register.
+ */
+#define L2_EVENT_ENABLE 0x1
+#define L2_EVENT_RESET_COUNTERS 0x6
+#define L2_EVENT_SOURCE_SHIFT 2
+
+/**
+ * Clears both event counters of the L2 cache controller and starts them
+ * counting.
+ *
+ * @note The counters only see requests that reach the L2 cache, which does
+ *       not include DMA transfers through the high-performance ports.
+ *
+ * @param[out] events The interval to start.
+ * @param event0 The XL2CC_* event that the first counter counts.
+ * @param event1 The XL2CC_* event that the second counter counts.
+ *
+ * @return None.
+ */
+void start_l2_events(l2_events_t *events, const uint32_t event0, const uint32_t event1)
+{
+    events->events[0] = event0;
+    events->events[1] = event1;
+    events->counts[0] = 0;
+    events->counts[1] = 0;
+
+    Xil_Out32(XPS_L2CC_BASEADDR + XPS_L2CC_EVNT_CNTRL_OFFSET, L2_EVENT_RESET_COUNTERS);
+    Xil_Out32(XPS_L2CC_BASEADDR + XPS_L2CC_EVNT_CNT0_CTRL_OFFSET, event0 << L2_EVENT_SOURCE_SHIFT);
+    Xil_Out32(XPS_L2CC_BASEADDR + XPS_L2CC_EVNT_CNT1_CTRL_OFFSET, event1 << L2_EVENT_SOURCE_SHIFT);
+    data_sync_barrier();
+    Xil_Out32(XPS_L2CC_BASEADDR + XPS_L2CC_EVNT_CNTRL_OFFSET, L2_EVENT_ENABLE);
+}
+
+/**
+ * Stops the event counters of the L2 cache controller and reads their
+ * counts.
+ *
+ * @param events The interval to stop, which holds the counts once stopped.
+ *
+ * @return None.
+ */
+void stop_l2_events(l2_events_t *events)
+{
+    data_sync_barrier();
+    Xil_Out32(XPS_L2CC_BASEADDR + XPS_L2CC_EVNT_CNTRL_OFFSET, 0);
+    events->counts[0] = Xil_In32(XPS_L2CC_BASEADDR + XPS_L2CC_EVNT_CNT0_VAL_OFFSET);
+    events->counts[1] = Xil_In32(XPS_L2CC_BASEADDR + XPS_L2CC_EVNT_CNT1_VAL_OFFSET);
+}
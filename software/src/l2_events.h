@@ -0,0 +1,21 @@
+#ifndef L2_EVENTS_H
+#define L2_EVENTS_H
+
+#include "types.h"
+#include "xl2cc_counter.h"
+
+/**
+ * Defines the counts of the two event counters of the PL310 L2 cache
+ * controller over an interval.
+ */
+typedef struct l2_events_t
+{
+    uint32_t events[2];
+    uint32_t counts[2];
+} l2_events_t;
+
+void start_l2_events(l2_events_t *events, const uint32_t event0, const uint32_t event1);
+
+void stop_l2_events(l2_events_t *events);
+
+#endif
@@ -0,0 +1,89 @@
+#include "l2_lockdown.h"
+
+#include "abort.h"
+#include "db.h"
+#include "system.h"
+#include "system_params.h"
+#include "types.h"
+#include "xil_cache.h"
+#include "xil_io.h"
+#include "xl2cc.h"
+#include "xparameters.h"
+
+/**
+ * The bounds of the hot section, which are defined by the linker script.
+ */
+extern uint8_t __hot_start;
+extern uint8_t __hot_end;
+
+/**
+ * The number of masters whose allocation into the ways of the L2 cache is
+ * controlled by a pair of data and instruction lockdown registers.
+ */
+#define L2_LOCKDOWN_MASTERS 8
+
+/**
+ * Sets the ways of the L2 cache that no master may allocate new lines into.
+ *
+ * @param ways The mask of the ways to lock.
+ *
+ * @return None.
+ */
+HOT_CODE
+static void set_l2_lockdown(const uint32_t ways)
+{
+    for (size_t i = 0; i < L2_LOCKDOWN_MASTERS; ++i)
+    {
+        const uint32_t offset = XPS_L2CC_CACHE_DLCKDWN_0_WAY_OFFSET + i * 8;
+        Xil_Out32(XPS_L2CC_BASEADDR + offset, ways);
+        Xil_Out32(XPS_L2CC_BASEADDR + offset + 4, ways);
+    }
+
+    Xil_Out32(XPS_L2CC_BASEADDR + XPS_L2CC_CACHE_SYNC_OFFSET, 0);
+    data_sync_barrier();
+}
+
+/**
+ * Loads the hot section into the first ways of the L2 cache and locks those
+ * ways, so that streaming captures cannot evict it.
+ *
+ * @note The section is loaded while new lines may only be allocated into
+ *       the ways being locked, and those ways are then closed to allocation.
+ *       Locked lines still hit and are still written back. The loading code
+ *       is itself in the section so that fetching it allocates nothing else
+ *       into the locked ways. It must run before the DSP core is started,
+ *       and it masks interrupts so that no handler allocates into them.
+ *
+ * @return Success or fail.
+ */
+HOT_CODE
+result_t lock_hot_section()
+{
+    const uint32_t start = (uint32_t)&__hot_start;
+    const uint32_t len = (uint32_t)(&__hot_end - &__hot_start);
+    AbortIfNot(len <= L2_LOCKED_WAYS * L2_WAY_BYTES, fail);
+
+    const uint32_t locked = (1 << L2_LOCKED_WAYS) - 1;
+    const uint32_t all = (1 << L2_WAYS) - 1;
+    const uint32_t cpsr = save_and_disable_interrupts();
+
+    /*
+     * Write the section back and evict it, so that every line is fetched
+     * into the open ways when it is read.
+     */
+    Xil_DCacheFlushRange(start, len);
+    set_l2_lockdown(all & ~locked);
+
+    for (uint32_t address = start & ~(CACHE_LINE_BYTES - 1); address < start + len; address += CACHE_LINE_BYTES)
+    {
+        (void)*(volatile uint32_t *)address;
+    }
+    data_sync_barrier();
+
+    set_l2_lockdown(locked);
+    restore_interrupts(cpsr);
+
+    dbprintf("Locked %u bytes of hot code and data in %u L2 ways.\n", len, L2_LOCKED_WAYS);
+
+    return success;
+}
@@ -0,0 +1,15 @@
+#ifndef L2_LOCKDOWN_H
+#define L2_LOCKDOWN_H
+
+#include "types.h"
+
+/**
+ * Places a function or variable in the hot section, which is kept resident
+ * in the locked ways of the L2 cache while captures stream through the rest.
+ */
+#define HOT_CODE __attribute__((section(".hot_text")))
+#define HOT_DATA __attribute__((section(".hot_data")))
+
+result_t lock_hot_section();
+
+#endif
@@ -0,0 +1,226 @@
+#include "lag_tracker.h"
+
+#include "abort.h"
+#include "system_params.h"
+#include "types.h"
+
+#include <math.h>
+
+/**
+ * The number of confident pings required before the lags are predicted.
+ */
+#define LAG_TRACKER_MIN_PINGS 2
+
+/**
+ * The number of consecutive pings that were not confident after which the
+ * history is assumed to be stale and is discarded.
+ */
+#define LAG_TRACKER_MAX_MISSES 2
+
+/**
+ * Initializes a lag tracker.
+ *
+ * @param[out] tracker The tracker to initialize.
+ *
+ * @return Success or fail.
+ */
+result_t init_lag_tracker(lag_tracker_t *tracker)
+{
+    AbortIfNot(tracker, fail);
+    AbortIfNot(reset_lag_tracker(tracker), fail);
+
+    return success;
+}
+
+/**
+ * Discards the ping history of a lag tracker.
+ *
+ * @param tracker The tracker to reset.
+ *
+ * @return Success or fail.
+ */
+result_t reset_lag_tracker(lag_tracker_t *tracker)
+{
+    AbortIfNot(tracker, fail);
+
+    tracker->count = 0;
+    tracker->next = 0;
+    tracker->misses = 0;
+
+    return success;
+}
+
+/**
+ * Checks whether the delays of a ping are confident enough to predict lags
+ * from, or to be trusted after a search of only the predicted lags.
+ *
+ * @param result The result of the ping.
+ *
+ * @return True if every channel is confident.
+ */
+bool lag_result_confident(const correlation_result_t *result)
+{
+    for (size_t i = 0; i < 3; ++i)
+    {
+        if (result->confidence[i] * 100 < LAG_TRACK_MIN_CONFIDENCE_PERCENT)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Adds the delays of a ping to a lag tracker if they are confident.
+ *
+ * @param tracker The tracker to update.
+ * @param result The result of the ping.
+ *
+ * @return Success or fail.
+ */
+result_t update_lag_tracker(lag_tracker_t *tracker, const correlation_result_t *result)
+{
+    AbortIfNot(tracker, fail);
+    AbortIfNot(result, fail);
+
+    if (!lag_result_confident(result))
+    {
+        tracker->misses++;
+        if (tracker->misses >= LAG_TRACKER_MAX_MISSES)
+        {
+            AbortIfNot(reset_lag_tracker(tracker), fail);
+        }
+        return success;
+    }
+
+    for (size_t i = 0; i < 3; ++i)
+    {
+        tracker->delay_ns[tracker->next][i] = result->channel_delay_ns[i];
+    }
+
+    tracker->next = (tracker->next + 1) % LAG_TRACKER_HISTORY;
+    if (tracker->count < LAG_TRACKER_HISTORY)
+    {
+        tracker->count++;
+    }
+    tracker->misses = 0;
+
+    return success;
+}
+
+/**
+ * Finds the median delay of a channel over the history of a tracker.
+ *
+ * @param tracker The tracker.
+ * @param channel The channel of the delay, from zero for channel A.
+ *
+ * @return The median delay in nanoseconds.
+ */
+static int32_t median_delay(const lag_tracker_t *tracker, const size_t channel)
+{
+    int32_t sorted[LAG_TRACKER_HISTORY];
+    for (size_t i = 0; i < tracker->count; ++i)
+    {
+        const int32_t value = tracker->delay_ns[i][channel];
+        size_t j = i;
+        for (; j > 0 && sorted[j - 1] > value; --j)
+        {
+            sorted[j] = sorted[j - 1];
+        }
+        sorted[j] = value;
+    }
+
+    const size_t middle = tracker->count / 2;
+    return (tracker->count % 2)? sorted[middle] :
+            (int32_t)(((int64_t)sorted[middle - 1] + sorted[middle]) / 2);
+}
+
+/**
+ * Predicts the lag of each channel from the reference and sets the window of
+ * lags that the correlation searches around it. The window is disabled until
+ * the tracker has enough confident pings.
+ *
+ * @param tracker The tracker to predict from.
+ * @param reference The channel that the others are correlated against.
+ * @param sampling_frequency The sampling frequency of the data.
+ * @param[out] weighting The weighting of the correlation to set the window
+ *             of.
+ *
+ * @return Success or fail.
+ */
+result_t predict_lags(const lag_tracker_t *tracker,
+                      const size_t reference,
+                      const uint32_t sampling_frequency,
+                      correlation_weighting_t *weighting)
+{
+    AbortIfNot(tracker, fail);
+    AbortIfNot(weighting, fail);
+    AbortIfNot(reference < 4, fail);
+
+    weighting->track_lags = (tracker->count >= LAG_TRACKER_MIN_PINGS)? true : false;
+    if (!weighting->track_lags)
+    {
+        return success;
+    }
+
+    double delay_ns[4] = {0};
+    for (size_t i = 0; i < 3; ++i)
+    {
+        delay_ns[i + 1] = median_delay(tracker, i);
+    }
+
+    AbortIfNot(set_lag_window(delay_ns, reference, LAG_TRACK_RADIUS_NS, sampling_frequency, weighting), fail);
+
+    return success;
+}
+
+/**
+ * Sets the window of lags that the correlation searches around the predicted
+ * delays of every channel.
+ *
+ * @param delay_ns The predicted delay of each channel from channel 0 in
+ *        nanoseconds, which is zero for channel 0.
+ * @param reference The channel that the others are correlated against.
+ * @param radius_ns The lags searched on each side of the prediction.
+ * @param sampling_frequency The sampling frequency of the data.
+ * @param[out] weighting The weighting of the correlation to set the window
+ *             of.
+ *
+ * @return Success or fail.
+ */
+result_t set_lag_window(const double delay_ns[4],
+                        const size_t reference,
+                        const double radius_ns,
+                        const uint32_t sampling_frequency,
+                        correlation_weighting_t *weighting)
+{
+    AbortIfNot(delay_ns, fail);
+    AbortIfNot(weighting, fail);
+    AbortIfNot(reference < 4, fail);
+
+    weighting->track_lags = true;
+
+    /*
+     * A channel that arrives later than the reference peaks at a right
+     * shift.
+     */
+    for (size_t i = 0, k = 0; k < 4; ++k)
+    {
+        if (k == reference)
+        {
+            continue;
+        }
+
+        const double delay = (delay_ns[k] - delay_ns[reference]) * sampling_frequency / 1000000000.0;
+        weighting->lag_center[i++] = -1 * (int32_t)lround(delay);
+    }
+
+    weighting->lag_radius = (uint64_t)(radius_ns * sampling_frequency / 1000000000.0);
+    if (weighting->lag_radius < LAG_TRACK_MIN_RADIUS)
+    {
+        weighting->lag_radius = LAG_TRACK_MIN_RADIUS;
+    }
+
+    return success;
+}
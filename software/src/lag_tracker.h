@@ -0,0 +1,52 @@
+#ifndef LAG_TRACKER_H
+#define LAG_TRACKER_H
+
+#include "correlation_util.h"
+#include "types.h"
+
+/**
+ * The number of recent confident pings that the lags are predicted from.
+ */
+#define LAG_TRACKER_HISTORY 4
+
+/**
+ * Defines a predictor of the lag of each pair of channels from the delays of
+ * recent pings. Delays are kept in time so that the prediction holds when the
+ * sampling frequency changes.
+ */
+typedef struct lag_tracker_t
+{
+    /*
+     * The delay of channels A, B, and C from channel 0 in nanoseconds for
+     * recent confident pings, and the slot of the next ping.
+     */
+    int32_t delay_ns[LAG_TRACKER_HISTORY][3];
+    size_t count;
+    size_t next;
+
+    /*
+     * The number of consecutive pings that were not confident.
+     */
+    size_t misses;
+} lag_tracker_t;
+
+result_t init_lag_tracker(lag_tracker_t *tracker);
+
+result_t reset_lag_tracker(lag_tracker_t *tracker);
+
+bool lag_result_confident(const correlation_result_t *result);
+
+result_t update_lag_tracker(lag_tracker_t *tracker, const correlation_result_t *result);
+
+result_t predict_lags(const lag_tracker_t *tracker,
+                      const size_t reference,
+                      const uint32_t sampling_frequency,
+                      correlation_weighting_t *weighting);
+
+result_t set_lag_window(const double delay_ns[4],
+                        const size_t reference,
+                        const double radius_ns,
+                        const uint32_t sampling_frequency,
+                        correlation_weighting_t *weighting);
+
+#endif
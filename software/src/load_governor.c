@@ -0,0 +1,121 @@
+#include "load_governor.h"
+
+#include "abort.h"
+#include "system_params.h"
+#include "types.h"
+
+/**
+ * Initializes a load governor with every feature enabled.
+ *
+ * @param[out] governor The governor to initialize.
+ *
+ * @return Success or fail.
+ */
+result_t init_load_governor(load_governor_t *governor)
+{
+    AbortIfNot(governor, fail);
+
+    governor->level = SHED_NONE;
+    governor->cost = 0;
+    governor->smoothed_cost = 0;
+    governor->budget = 0;
+    governor->headroom_pings = 0;
+    governor->sheds = 0;
+    governor->restores = 0;
+
+    return success;
+}
+
+/**
+ * Accounts for the cost of processing a ping and sheds or restores a feature.
+ *
+ * @note A ping that takes more than its share of the period sheds the next
+ *       feature at once, since the following ping would be missed. A feature
+ *       is only restored after the smoothed cost has stayed well within the
+ *       period for several pings, so that the governor does not oscillate
+ *       between two levels.
+ *
+ * @param governor The governor.
+ * @param cost The time from the capture of the ping to the end of its
+ *        processing and relay.
+ * @param period The period of the pinger.
+ *
+ * @return Success or fail.
+ */
+result_t update_load_governor(load_governor_t *governor, const tick_t cost, const tick_t period)
+{
+    AbortIfNot(governor, fail);
+    AbortIfNot(period, fail);
+
+    governor->cost = cost;
+    governor->smoothed_cost = (governor->smoothed_cost)?
+            governor->smoothed_cost + (cost - governor->smoothed_cost) * LOAD_GOVERNOR_SMOOTHING_PERCENT / 100 :
+            cost;
+    governor->budget = (uint64_t)period * LOAD_GOVERNOR_SHED_PERCENT / 100;
+
+    if (cost > governor->budget)
+    {
+        governor->headroom_pings = 0;
+        if (governor->level + 1 < SHED_LEVELS)
+        {
+            governor->level++;
+            governor->sheds++;
+        }
+        return success;
+    }
+
+    const tick_t headroom = (uint64_t)period * LOAD_GOVERNOR_RESTORE_PERCENT / 100;
+    if (governor->level == SHED_NONE || governor->smoothed_cost > headroom)
+    {
+        governor->headroom_pings = 0;
+        return success;
+    }
+
+    if (++governor->headroom_pings >= LOAD_GOVERNOR_RESTORE_PINGS)
+    {
+        governor->level--;
+        governor->restores++;
+        governor->headroom_pings = 0;
+    }
+
+    return success;
+}
+
+/**
+ * Checks if a feature has been shed.
+ *
+ * @param governor The governor.
+ * @param level The level at which the feature is shed.
+ *
+ * @return True if the feature is shed.
+ */
+bool load_shed(const load_governor_t *governor, const shed_level_t level)
+{
+    return (level != SHED_NONE && governor->level >= level)? true : false;
+}
+
+/**
+ * Names the feature shed at a level.
+ *
+ * @param level The level.
+ *
+ * @return The name of the feature.
+ */
+const char *shed_level_name(const shed_level_t level)
+{
+    switch (level)
+    {
+        case SHED_NONE:
+            return "nothing";
+        case SHED_DATA_STREAM:
+            return "data stream";
+        case SHED_XCORR_STREAM:
+            return "correlation stream";
+        case SHED_FULL_SEARCH:
+            return "full-rate lag search";
+        case SHED_FILTER:
+            return "filtering";
+        default:
+            return "unknown";
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef LOAD_GOVERNOR_H
+#define LOAD_GOVERNOR_H
+
+#include "types.h"
+
+/**
+ * Defines the features that are shed as the processing budget of each ping
+ * tightens, in the order that they are shed. Each level also sheds every
+ * level before it.
+ */
+typedef enum shed_level_t
+{
+    SHED_NONE = 0,
+    SHED_DATA_STREAM = 1,
+    SHED_XCORR_STREAM = 2,
+    SHED_FULL_SEARCH = 3,
+    SHED_FILTER = 4,
+    SHED_LEVELS
+} shed_level_t;
+
+/**
+ * Defines a governor that measures the cost of processing each ping against
+ * the ping period and sheds features while the next ping would be missed.
+ */
+typedef struct load_governor_t
+{
+    shed_level_t level;
+
+    /*
+     * The cost of the latest ping, its smoothed cost, and the share of the
+     * period that the latest costs were measured against, in ticks.
+     */
+    tick_t cost;
+    double smoothed_cost;
+    tick_t budget;
+
+    /*
+     * The consecutive pings that left enough headroom to restore a feature.
+     */
+    uint32_t headroom_pings;
+
+    /*
+     * The number of times that a feature was shed and restored.
+     */
+    uint32_t sheds;
+    uint32_t restores;
+} load_governor_t;
+
+result_t init_load_governor(load_governor_t *governor);
+
+result_t update_load_governor(load_governor_t *governor, const tick_t cost, const tick_t period);
+
+bool load_shed(const load_governor_t *governor, const shed_level_t level);
+
+const char *shed_level_name(const shed_level_t level);
+
+#endif
@@ -0,0 +1,301 @@
+#include "matched_filter.h"
+
+#include "abort.h"
+#include "fft.h"
+#include "types.h"
+
+#include <string.h>
+
+/**
+ * Initializes a matched filter without a template.
+ *
+ * @param[out] filter The filter to initialize.
+ * @param template_storage The storage of the template, which holds
+ *        template_capacity samples.
+ * @param template_capacity The longest template, which must be a power of
+ *        two.
+ * @param spectrum The storage of the template spectrum, which holds
+ *        fft_capacity values.
+ * @param work The storage of the transformed block, which holds
+ *        fft_capacity values.
+ * @param input The storage of the block of samples, which holds
+ *        fft_capacity values.
+ * @param fft_capacity The longest transform, which must be at least
+ *        MATCHED_FILTER_FFT_LEN(template_capacity).
+ *
+ * @return Success or fail.
+ */
+result_t init_matched_filter(matched_filter_t *filter,
+                             float *template_storage,
+                             const size_t template_capacity,
+                             complex_t *spectrum,
+                             complex_t *work,
+                             float *input,
+                             const size_t fft_capacity)
+{
+    AbortIfNot(filter, fail);
+    AbortIfNot(template_storage, fail);
+    AbortIfNot(spectrum, fail);
+    AbortIfNot(work, fail);
+    AbortIfNot(input, fail);
+    AbortIfNot(template_capacity && (template_capacity & (template_capacity - 1)) == 0, fail);
+    AbortIfNot(fft_capacity >= MATCHED_FILTER_FFT_LEN(template_capacity), fail);
+    AbortIfNot(fft_capacity <= FFT_MAX_SIZE, fail);
+
+    filter->samples = template_storage;
+    filter->template_len = 0;
+    filter->template_capacity = template_capacity;
+    filter->energy = 0;
+    filter->spectrum = spectrum;
+    filter->fft_len = 0;
+    filter->fft_capacity = fft_capacity;
+    filter->hop = 0;
+    filter->work = work;
+    filter->input = input;
+    filter->ready = false;
+    reset_matched_filter(filter);
+
+    return success;
+}
+
+/**
+ * Writes part of the template of a matched filter and prepares its spectrum.
+ *
+ * @note The template ends with the samples written, so a template is
+ *       uploaded in order from offset zero, and writing no samples at offset
+ *       zero removes it. The stream is restarted.
+ *
+ * @param filter The matched filter.
+ * @param samples The samples of the template to write.
+ * @param offset The index in the template of the first sample.
+ * @param count The number of samples to write.
+ *
+ * @return Success or fail.
+ */
+result_t set_matched_template(matched_filter_t *filter,
+                              const float *samples,
+                              const size_t offset,
+                              const size_t count)
+{
+    AbortIfNot(filter, fail);
+    AbortIfNot(samples || !count, fail);
+    AbortIfNot(offset <= filter->template_len, fail);
+    AbortIfNot(offset + count <= filter->template_capacity, fail);
+
+    memcpy(&filter->samples[offset], samples, count * sizeof(float));
+    filter->template_len = offset + count;
+    filter->ready = false;
+    reset_matched_filter(filter);
+
+    const size_t m = filter->template_len;
+    if (!m)
+    {
+        return success;
+    }
+
+    /*
+     * Correlating with the template is convolving with its reverse, which
+     * the conjugate of its spectrum applies.
+     */
+    filter->fft_len = fft_size(MATCHED_FILTER_FFT_LEN(m));
+    filter->hop = filter->fft_len - m + 1;
+
+    float energy = 0;
+    for (size_t k = 0; k < filter->fft_len; ++k)
+    {
+        const float value = (k < m)? filter->samples[k] : 0;
+        filter->spectrum[k].re = value;
+        filter->spectrum[k].im = 0;
+        energy += value * value;
+    }
+    AbortIfNot(fft(filter->spectrum, filter->fft_len, false), fail);
+    for (size_t k = 0; k < filter->fft_len; ++k)
+    {
+        filter->spectrum[k].im = -filter->spectrum[k].im;
+    }
+
+    filter->energy = energy;
+    filter->ready = (energy > 0)? true : false;
+
+    return success;
+}
+
+/**
+ * Restarts the stream of a matched filter.
+ *
+ * @param filter The matched filter.
+ *
+ * @return None.
+ */
+void reset_matched_filter(matched_filter_t *filter)
+{
+    filter->filled = 0;
+    filter->origin = 0;
+    filter->peaking = false;
+}
+
+/**
+ * Scores every alignment of the template within the block of a matched
+ * filter that the block holds completely.
+ *
+ * @note Partial overlaps with a ping already score highly, so the ping is
+ *       placed at the best alignment within a template length of the first
+ *       one that reaches the threshold.
+ *
+ * @param filter The matched filter, whose block is full.
+ * @param min_score The square of the lowest normalized correlation that
+ *        denotes a ping, scaled by the energy of the template.
+ * @param[out] found Set true once the peak alignment is known.
+ * @param[out] index The index in the stream of the peak alignment.
+ *
+ * @return Success or fail.
+ */
+static result_t score_block(matched_filter_t *filter,
+                            const float min_score,
+                            bool *found,
+                            uint64_t *index)
+{
+    const size_t n = filter->fft_len;
+    const size_t m = filter->template_len;
+    const float *input = filter->input;
+    complex_t *work = filter->work;
+
+    for (size_t k = 0; k < n; ++k)
+    {
+        work[k].re = input[k];
+        work[k].im = 0;
+    }
+    AbortIfNot(fft(work, n, false), fail);
+    for (size_t k = 0; k < n; ++k)
+    {
+        const complex_t a = work[k];
+        const complex_t b = filter->spectrum[k];
+        work[k].re = a.re * b.re - a.im * b.im;
+        work[k].im = a.re * b.im + a.im * b.re;
+    }
+    AbortIfNot(fft(work, n, true), fail);
+
+    /*
+     * Only the first hop lags are free of circular wrap. The energy of the
+     * samples under the template slides with the alignment.
+     */
+    float energy = 0;
+    for (size_t k = 0; k < m; ++k)
+    {
+        energy += input[k] * input[k];
+    }
+
+    for (size_t j = 0; j < filter->hop; ++j)
+    {
+        const uint64_t alignment = filter->origin + j;
+        const float r = work[j].re;
+        if (filter->peaking)
+        {
+            if (alignment >= filter->peak_end)
+            {
+                *found = true;
+                *index = filter->peak_index;
+                return success;
+            }
+
+            const float score = (energy > 0)? r * r / energy : 0;
+            if (score > filter->peak_score)
+            {
+                filter->peak_score = score;
+                filter->peak_index = alignment;
+            }
+        }
+        else if (energy > 0 && r * r > min_score * energy)
+        {
+            filter->peaking = true;
+            filter->peak_end = alignment + m;
+            filter->peak_index = alignment;
+            filter->peak_score = r * r / energy;
+        }
+
+        if (j + m < n)
+        {
+            energy += input[j + m] * input[j + m] - input[j] * input[j];
+        }
+    }
+
+    return success;
+}
+
+/**
+ * Correlates the next samples of a stream against the template and finds
+ * the first alignment whose normalized correlation reaches a threshold.
+ *
+ * @note Samples are scored in blocks of the transform length, and the
+ *       peak is searched for a template length past the first alignment to
+ *       reach the threshold, so a ping is found up to two transform lengths
+ *       after it arrives. The search stops once a ping is found.
+ *
+ * @param filter The matched filter, which must hold a template.
+ * @param channel The first sample of the chunk on the channel.
+ * @param stride The distance between consecutive samples of the channel.
+ * @param len The number of samples in the chunk.
+ * @param threshold_percent The lowest normalized correlation, in percent,
+ *        that denotes a ping.
+ * @param[out] found Set true if a ping was found.
+ * @param[out] index The index in the stream, counted from the last restart,
+ *             of the first sample under the template at the alignment with
+ *             the highest correlation.
+ *
+ * @return Success or fail.
+ */
+result_t run_matched_filter(matched_filter_t *filter,
+                            const analog_sample_t *channel,
+                            const size_t stride,
+                            const size_t len,
+                            const uint32_t threshold_percent,
+                            bool *found,
+                            uint64_t *index)
+{
+    AbortIfNot(filter, fail);
+    AbortIfNot(filter->ready, fail);
+    AbortIfNot(channel, fail);
+    AbortIfNot(stride, fail);
+    AbortIfNot(found, fail);
+    AbortIfNot(index, fail);
+
+    *found = false;
+
+    const float ratio = threshold_percent / 100.0f;
+    const float min_score = ratio * ratio * filter->energy;
+    const size_t keep = filter->template_len - 1;
+
+    size_t i = 0;
+    while (i < len)
+    {
+        const size_t space = filter->fft_len - filter->filled;
+        const size_t take = (len - i < space)? len - i : space;
+        for (size_t j = 0; j < take; ++j)
+        {
+            filter->input[filter->filled + j] = channel[(i + j) * stride];
+        }
+        filter->filled += take;
+        i += take;
+
+        if (filter->filled < filter->fft_len)
+        {
+            break;
+        }
+
+        AbortIfNot(score_block(filter, min_score, found, index), fail);
+        if (*found)
+        {
+            return success;
+        }
+
+        /*
+         * The next block starts with the samples that the last alignments
+         * of this block still need.
+         */
+        memmove(filter->input, &filter->input[filter->hop], keep * sizeof(float));
+        filter->filled = keep;
+        filter->origin += filter->hop;
+    }
+
+    return success;
+}
@@ -0,0 +1,83 @@
+#ifndef MATCHED_FILTER_H
+#define MATCHED_FILTER_H
+
+#include "fft.h"
+#include "types.h"
+
+/**
+ * The transform length that a matched filter needs for a template, which
+ * holds a block of at least as many new samples as the template.
+ */
+#define MATCHED_FILTER_FFT_LEN(template_len) (2 * (template_len))
+
+/**
+ * Defines a matched filter that correlates one channel of a stream against
+ * the template of a pinger waveform by overlap-save FFT convolution. Each
+ * alignment of the template is scored by the normalized correlation of the
+ * template with the samples it covers, so a ping is found at the same score
+ * whatever its amplitude.
+ */
+typedef struct matched_filter_t
+{
+    /*
+     * The template, its energy, and the conjugate of its spectrum.
+     */
+    float *samples;
+    size_t template_len;
+    size_t template_capacity;
+    float energy;
+    complex_t *spectrum;
+
+    /*
+     * The transform length and the number of new samples in each block,
+     * and the storage of the block being transformed.
+     */
+    size_t fft_len;
+    size_t fft_capacity;
+    size_t hop;
+    complex_t *work;
+
+    /*
+     * The samples of the current block, which starts with the end of the
+     * previous block, and the index in the stream of its first sample.
+     */
+    float *input;
+    size_t filled;
+    uint64_t origin;
+
+    /*
+     * Specified true once an alignment has reached the threshold, while the
+     * alignments within a template length of it are searched for the peak.
+     */
+    bool peaking;
+    uint64_t peak_end;
+    uint64_t peak_index;
+    float peak_score;
+
+    bool ready;
+} matched_filter_t;
+
+result_t init_matched_filter(matched_filter_t *filter,
+                             float *template_storage,
+                             const size_t template_capacity,
+                             complex_t *spectrum,
+                             complex_t *work,
+                             float *input,
+                             const size_t fft_capacity);
+
+result_t set_matched_template(matched_filter_t *filter,
+                              const float *samples,
+                              const size_t offset,
+                              const size_t count);
+
+void reset_matched_filter(matched_filter_t *filter);
+
+result_t run_matched_filter(matched_filter_t *filter,
+                            const analog_sample_t *channel,
+                            const size_t stride,
+                            const size_t len,
+                            const uint32_t threshold_percent,
+                            bool *found,
+                            uint64_t *index);
+
+#endif
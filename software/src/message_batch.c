@@ -0,0 +1,229 @@
+#include "message_batch.h"
+
+#include "abort.h"
+#include "system.h"
+
+#include <string.h>
+
+/**
+ * Discards the waiting messages of a batch.
+ *
+ * @param batch The batch.
+ *
+ * @return None.
+ */
+static void clear_message_batch(message_batch_t *batch)
+{
+    batch->len = sizeof(message_batch_header_t);
+    batch->count = 0;
+}
+
+/**
+ * Initializes an empty batch of messages to a destination.
+ *
+ * @param[out] batch The batch to initialize.
+ * @param socket The connected socket of the destination.
+ * @param max_delay The longest a message waits for others to share its
+ *        datagram, or zero to send every message alone.
+ * @param rejected Called with each message that could not be sent, or NULL.
+ *
+ * @return Success or fail.
+ */
+result_t init_message_batch(message_batch_t *batch,
+                            udp_socket_t *socket,
+                            const tick_t max_delay,
+                            void (*rejected)(udp_socket_t *socket,
+                                             const message_type_t type,
+                                             const void *data,
+                                             const size_t len))
+{
+    AbortIfNot(batch, fail);
+    AbortIfNot(socket, fail);
+
+    memset(batch, 0, sizeof(*batch));
+    batch->socket = socket;
+    batch->max_delay = max_delay;
+    batch->rejected = rejected;
+    clear_message_batch(batch);
+
+    return success;
+}
+
+/**
+ * Sends the waiting messages and directs later messages to another
+ * destination.
+ *
+ * @param batch The batch.
+ * @param socket The connected socket of the new destination.
+ *
+ * @return Success or fail.
+ */
+result_t set_message_batch_destination(message_batch_t *batch, udp_socket_t *socket)
+{
+    AbortIfNot(batch, fail);
+    AbortIfNot(socket, fail);
+
+    if (batch->socket == socket)
+    {
+        return success;
+    }
+
+    const result_t ret = flush_message_batch(batch);
+    batch->socket = socket;
+
+    return ret;
+}
+
+/**
+ * Sets the longest a message waits for others to share its datagram.
+ *
+ * @param batch The batch.
+ * @param max_delay The longest delay, or zero to send every message alone.
+ *
+ * @return Success or fail.
+ */
+result_t set_message_batch_delay(message_batch_t *batch, const tick_t max_delay)
+{
+    AbortIfNot(batch, fail);
+
+    batch->max_delay = max_delay;
+    if (!max_delay)
+    {
+        return flush_message_batch(batch);
+    }
+
+    return success;
+}
+
+/**
+ * Adds a message to a batch. The batch is sent first if the message does not
+ * fit, and with the message if it is urgent.
+ *
+ * @param batch The batch to add to.
+ * @param type The type of the message.
+ * @param data The message.
+ * @param len The length of the message, which must fit in an empty batch.
+ * @param urgent Specified true to send the message without waiting.
+ *
+ * @return Success or fail. Messages of a datagram that could not be sent are
+ *         passed to the rejection callback of the batch.
+ */
+result_t add_batched_message(message_batch_t *batch,
+                             const message_type_t type,
+                             const void *data,
+                             const size_t len,
+                             const bool urgent)
+{
+    AbortIfNot(batch, fail);
+    AbortIfNot(data, fail);
+    AbortIfNot(sizeof(message_batch_header_t) + sizeof(message_header_t) + len <= MESSAGE_BATCH_BYTES, fail);
+
+    result_t ret = success;
+    if (batch->len + sizeof(message_header_t) + len > MESSAGE_BATCH_BYTES)
+    {
+        ret = flush_message_batch(batch);
+    }
+
+    if (!batch->count)
+    {
+        batch->opened = get_system_time();
+    }
+
+    message_header_t header;
+    header.type = type;
+    header.length = len;
+    memcpy(&batch->datagram[batch->len], &header, sizeof(header));
+    memcpy(&batch->datagram[batch->len + sizeof(header)], data, len);
+    batch->len += sizeof(header) + len;
+    batch->count++;
+
+    if (urgent || !batch->max_delay)
+    {
+        if (!flush_message_batch(batch))
+        {
+            ret = fail;
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * Sends a batch whose oldest message has waited the longest delay.
+ *
+ * @param batch The batch.
+ *
+ * @return Success or fail.
+ */
+result_t service_message_batch(message_batch_t *batch)
+{
+    AbortIfNot(batch, fail);
+
+    if (batch->count && get_system_time() - batch->opened >= batch->max_delay)
+    {
+        return flush_message_batch(batch);
+    }
+
+    return success;
+}
+
+/**
+ * Sends the waiting messages of a batch. A single message is sent alone,
+ * without the batch header.
+ *
+ * @param batch The batch.
+ *
+ * @return Success or fail. On failure each message is passed to the
+ *         rejection callback of the batch, and the batch is emptied.
+ */
+result_t flush_message_batch(message_batch_t *batch)
+{
+    AbortIfNot(batch, fail);
+
+    if (!batch->count)
+    {
+        return success;
+    }
+
+    result_t ret;
+    if (batch->count == 1)
+    {
+        const size_t offset = sizeof(message_batch_header_t) + sizeof(message_header_t);
+        ret = send_udp(batch->socket, (char *)&batch->datagram[offset], batch->len - offset);
+    }
+    else
+    {
+        message_batch_header_t header;
+        header.marker = MESSAGE_BATCH_MARKER;
+        header.count = batch->count;
+        memcpy(batch->datagram, &header, sizeof(header));
+        ret = send_udp(batch->socket, (char *)batch->datagram, batch->len);
+    }
+
+    if (ret == success)
+    {
+        batch->datagrams++;
+        batch->messages += batch->count;
+        clear_message_batch(batch);
+        return success;
+    }
+
+    batch->failures++;
+    if (batch->rejected)
+    {
+        size_t offset = sizeof(message_batch_header_t);
+        while (offset + sizeof(message_header_t) <= batch->len)
+        {
+            message_header_t header;
+            memcpy(&header, &batch->datagram[offset], sizeof(header));
+            batch->rejected(batch->socket,
+                            (message_type_t)header.type,
+                            &batch->datagram[offset + sizeof(header)],
+                            header.length);
+            offset += sizeof(header) + header.length;
+        }
+    }
+    clear_message_batch(batch);
+
+    return fail;
+}
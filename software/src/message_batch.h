@@ -0,0 +1,64 @@
+#ifndef MESSAGE_BATCH_H
+#define MESSAGE_BATCH_H
+
+#include "stream_format.h"
+#include "system_params.h"
+#include "types.h"
+#include "udp.h"
+
+/**
+ * Defines the small messages waiting to share a datagram to one destination.
+ * The batch is sent once the next message would not fit, once its oldest
+ * message has waited the longest delay, or when it is flushed explicitly.
+ */
+typedef struct message_batch_t
+{
+    udp_socket_t *socket;
+    tick_t max_delay;
+
+    /*
+     * Called with each message of a datagram that could not be sent, or NULL
+     * to lose them.
+     */
+    void (*rejected)(udp_socket_t *socket, const message_type_t type, const void *data, const size_t len);
+
+    /*
+     * The datagram being filled, which begins with the batch header, the
+     * bytes of it in use, and the time its first message was added.
+     */
+    uint8_t datagram[MESSAGE_BATCH_BYTES];
+    size_t len;
+    uint16_t count;
+    tick_t opened;
+
+    /*
+     * The datagrams sent, the messages they held, and the sends that failed.
+     */
+    uint32_t datagrams;
+    uint32_t messages;
+    uint32_t failures;
+} message_batch_t;
+
+result_t init_message_batch(message_batch_t *batch,
+                            udp_socket_t *socket,
+                            const tick_t max_delay,
+                            void (*rejected)(udp_socket_t *socket,
+                                             const message_type_t type,
+                                             const void *data,
+                                             const size_t len));
+
+result_t set_message_batch_destination(message_batch_t *batch, udp_socket_t *socket);
+
+result_t set_message_batch_delay(message_batch_t *batch, const tick_t max_delay);
+
+result_t add_batched_message(message_batch_t *batch,
+                             const message_type_t type,
+                             const void *data,
+                             const size_t len,
+                             const bool urgent);
+
+result_t service_message_batch(message_batch_t *batch);
+
+result_t flush_message_batch(message_batch_t *batch);
+
+#endif
@@ -0,0 +1,305 @@
+#include "net_core.h"
+
+#include "abort.h"
+#include "amp.h"
+#include "cycle_counter.h"
+#include "network_stack.h"
+#include "spsc_queue.h"
+#include "system.h"
+#include "system_params.h"
+#include "time_util.h"
+#include "types.h"
+#include "udp.h"
+
+#include <string.h>
+
+/**
+ * The mailbox shared with the network core, which resides in on-chip memory.
+ */
+net_core_mailbox_t net_core_mailbox __attribute__((section(".ocm")));
+
+/**
+ * The storage of the queued requests. The cores are coherent, so it is kept
+ * in DDR rather than taking on-chip memory.
+ */
+static net_request_t net_request_storage[NET_CORE_QUEUE_DEPTH];
+
+/**
+ * Releases a reference charged to a tracker when the request was posted.
+ *
+ * @param request The request.
+ *
+ * @return None.
+ */
+static void release_request_tracker(const net_request_t *request)
+{
+    if (request->tracker)
+    {
+        __atomic_fetch_sub(&request->tracker->outstanding, 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+/**
+ * Waits for the Ethernet driver to release the transmit resources a request
+ * needs, servicing its interrupts meanwhile.
+ *
+ * @note The wait is bounded, and a send that still lacks resources fails as
+ *       it would have on CPU0.
+ *
+ * @param request The request.
+ *
+ * @return None.
+ */
+static void wait_for_transmit(const net_request_t *request)
+{
+    const bool needs_ref = (request->op == NET_REQUEST_SEND_REF ||
+                            request->op == NET_REQUEST_SEND_RAW)? true : false;
+    if (get_free_tx_descriptors() >= NET_CORE_MIN_FREE_DESCRIPTORS &&
+        (!needs_ref || udp_ref_available()))
+    {
+        return;
+    }
+
+    net_core_mailbox.stats.stalls++;
+    const tick_t start_time = get_system_time();
+    while (get_system_time() - start_time < micros_to_ticks(NET_CORE_SEND_WAIT_US))
+    {
+        poll_network_interrupts();
+        if (get_free_tx_descriptors() >= NET_CORE_MIN_FREE_DESCRIPTORS &&
+            (!needs_ref || udp_ref_available()))
+        {
+            return;
+        }
+    }
+}
+
+/**
+ * Carries out a request of CPU0 on the network stack.
+ *
+ * @param request The request.
+ *
+ * @return Success or fail.
+ */
+static result_t run_network_request(net_request_t *request)
+{
+    result_t ret = fail;
+    switch (request->op)
+    {
+        case NET_REQUEST_SEND:
+            wait_for_transmit(request);
+            ret = (request->addressed)?
+                    send_udp_to(request->socket, &request->addr, request->port,
+                                request->copied, request->copied_len) :
+                    send_udp(request->socket, (char *)request->copied, request->copied_len);
+            break;
+
+        case NET_REQUEST_SEND_REF:
+            wait_for_transmit(request);
+            ret = send_udp_ref(request->socket,
+                               request->copied,
+                               request->copied_len,
+                               request->data,
+                               request->len,
+                               request->tracker);
+            release_request_tracker(request);
+            break;
+
+        case NET_REQUEST_SEND_RAW:
+            wait_for_transmit(request);
+            ret = send_raw_frame_ref(request->copied,
+                                     request->copied_len,
+                                     request->data,
+                                     request->len,
+                                     request->tracker);
+            release_request_tracker(request);
+            break;
+
+        case NET_REQUEST_SEND_IN_PLACE:
+            wait_for_transmit(request);
+            ret = send_udp_in_place(request->socket, (void *)request->data, request->len, request->tracker);
+            release_request_tracker(request);
+            break;
+
+        case NET_REQUEST_CONNECT:
+            ret = connect_udp(request->socket, &request->addr, request->port);
+            break;
+
+        case NET_REQUEST_ADD_ARP:
+            ret = add_arp_destination(&request->addr);
+            break;
+
+        default:
+            release_request_tracker(request);
+            break;
+    }
+
+    net_core_mailbox.stats.completed++;
+    if (!ret)
+    {
+        net_core_mailbox.stats.failed++;
+    }
+
+    return ret;
+}
+
+/**
+ * Main loop of the network core. The Ethernet interrupts are polled rather
+ * than taken, so that the interrupt handling of CPU0 is not shared.
+ *
+ * @return None.
+ */
+static void network_core_main()
+{
+    init_cycle_counter();
+
+    net_core_mailbox.running = 1;
+    data_sync_barrier();
+    send_event();
+
+    /*
+     * Requests are large, so the one being run is kept off the stack.
+     */
+    static net_request_t request;
+    tick_t last_link_poll = get_system_time();
+    while (1)
+    {
+        poll_network_interrupts();
+
+        for (uint32_t i = 0; i < NET_CORE_REQUEST_BATCH && spsc_pop(&net_core_mailbox.requests, &request); ++i)
+        {
+            run_network_request(&request);
+            poll_network_interrupts();
+        }
+
+        dispatch_network_stack();
+
+        const tick_t now = get_system_time();
+        if (now - last_link_poll >= ms_to_ticks(NETWORK_LINK_POLL_MS))
+        {
+            last_link_poll = now;
+            poll_network_link();
+        }
+    }
+}
+
+/**
+ * Releases CPU1 to own the network stack, leaving CPU0 to acquisition and
+ * processing.
+ *
+ * @note This must be called with interrupts disabled on CPU0, once the
+ *       sockets are bound. If CPU1 does not start, the network stack stays
+ *       on CPU0.
+ *
+ * @return Success or fail.
+ */
+result_t start_network_core()
+{
+    net_core_mailbox.running = 0;
+    memset(&net_core_mailbox.stats, 0, sizeof(net_core_mailbox.stats));
+    AbortIfNot(init_spsc_queue(&net_core_mailbox.requests,
+                               net_request_storage,
+                               sizeof(net_request_t),
+                               NET_CORE_QUEUE_DEPTH), fail);
+
+    AbortIfNot(set_network_interrupts(false), fail);
+    if (!start_cpu1(network_core_main, &net_core_mailbox.running))
+    {
+        AbortIfNot(set_network_interrupts(true), fail);
+        return fail;
+    }
+
+    return success;
+}
+
+/**
+ * Checks if the network core owns the network stack.
+ *
+ * @return True if CPU1 has started as the network core.
+ */
+bool network_core_running()
+{
+    return (net_core_mailbox.running)? true : false;
+}
+
+/**
+ * Checks if the network stack may be called directly from this core.
+ *
+ * @return True if this core owns the network stack.
+ */
+bool network_stack_owned()
+{
+    return (!net_core_mailbox.running || get_cpu_id() == NET_CORE_CPU)? true : false;
+}
+
+/**
+ * Queues a request to the network core without waiting for it to be run.
+ *
+ * @note A tracker of the request is charged a reference until the network
+ *       core has sent the datagram, so that the memory it references is not
+ *       reused in the meantime.
+ *
+ * @param request The request, which is copied into the queue.
+ *
+ * @return Success or fail if the queue is full.
+ */
+result_t post_network_request(net_request_t *request)
+{
+    AbortIfNot(request, fail);
+    AbortIfNot(network_core_running(), fail);
+
+    if (request->tracker)
+    {
+        __atomic_fetch_add(&request->tracker->outstanding, 1, __ATOMIC_SEQ_CST);
+    }
+
+    /*
+     * Requests may be posted from interrupt handlers, so pushes are kept
+     * from interleaving.
+     */
+    const uint32_t cpsr = save_and_disable_interrupts();
+    const bool pushed = spsc_push(&net_core_mailbox.requests, request);
+    if (pushed)
+    {
+        net_core_mailbox.stats.posted++;
+    }
+    else
+    {
+        net_core_mailbox.stats.dropped++;
+    }
+    restore_interrupts(cpsr);
+
+    if (!pushed)
+    {
+        release_request_tracker(request);
+        return fail;
+    }
+
+    data_sync_barrier();
+    send_event();
+
+    return success;
+}
+
+/**
+ * Gets the number of requests that may be queued to the network core.
+ *
+ * @return The number of free entries of the queue.
+ */
+uint32_t get_free_network_requests()
+{
+    const spsc_queue_t *queue = &net_core_mailbox.requests;
+
+    return queue->capacity - (queue->head - queue->tail);
+}
+
+/**
+ * Gets the counters of the network core.
+ *
+ * @param[out] stats The counters since the network core started.
+ *
+ * @return None.
+ */
+void get_network_core_stats(net_core_stats_t *stats)
+{
+    *stats = net_core_mailbox.stats;
+}
@@ -0,0 +1,142 @@
+#ifndef NET_CORE_H
+#define NET_CORE_H
+
+#include "spsc_queue.h"
+#include "types.h"
+#include "udp.h"
+
+/**
+ * The number of network requests that may be queued to the network core.
+ */
+#define NET_CORE_QUEUE_DEPTH 32
+
+/**
+ * The CPU that owns the network stack in the network core layout.
+ */
+#define NET_CORE_CPU 1
+
+/**
+ * Defines the operations CPU0 requests of the network core.
+ */
+typedef enum net_request_op_t
+{
+    /*
+     * Sends the payload copied into the request, to the connected
+     * destination or to the address of the request.
+     */
+    NET_REQUEST_SEND = 0,
+
+    /*
+     * Sends the header copied into the request ahead of a payload that stays
+     * in the memory of the caller.
+     */
+    NET_REQUEST_SEND_REF = 1,
+
+    /*
+     * Sends a datagram from the memory it was written to.
+     */
+    NET_REQUEST_SEND_IN_PLACE = 2,
+
+    /*
+     * Connects the socket to the address of the request.
+     */
+    NET_REQUEST_CONNECT = 3,
+
+    /*
+     * Keeps the ARP entry of the address of the request resolved.
+     */
+    NET_REQUEST_ADD_ARP = 4,
+
+    /*
+     * Sends an Ethernet frame whose header, beginning with the Ethernet
+     * header, is copied into the request ahead of a payload that stays in
+     * the memory of the caller.
+     */
+    NET_REQUEST_SEND_RAW = 5
+} net_request_op_t;
+
+/**
+ * Defines a request to the network core.
+ */
+typedef struct net_request_t
+{
+    uint32_t op;
+    udp_socket_t *socket;
+
+    /*
+     * The destination, if addressed, and otherwise the connected destination
+     * of the socket.
+     */
+    bool addressed;
+    struct ip_addr addr;
+    uint16_t port;
+
+    /*
+     * The memory of the caller sent by reference or in place, its length,
+     * and the tracker it is charged to.
+     */
+    const void *data;
+    size_t len;
+    udp_ref_tracker_t *tracker;
+
+    /*
+     * The bytes copied into the request, which are the payload of a copied
+     * send and the header of a send by reference.
+     */
+    size_t copied_len;
+    uint8_t copied[UDP_TX_PAYLOAD_MAX] __attribute__((aligned(8)));
+} net_request_t;
+
+/**
+ * Defines the counters of the network core.
+ */
+typedef struct net_core_stats_t
+{
+    /*
+     * The requests queued by CPU0, those dropped because the queue was full,
+     * and those completed and failed by the network core.
+     */
+    uint32_t posted;
+    uint32_t dropped;
+    uint32_t completed;
+    uint32_t failed;
+
+    /*
+     * The times the network core waited for the Ethernet driver to release
+     * transmit resources before a send.
+     */
+    uint32_t stalls;
+} net_core_stats_t;
+
+/**
+ * Defines the mailbox through which CPU0 hands network requests to CPU1 when
+ * CPU1 owns the network stack.
+ *
+ * @note Received datagrams are handled by their callbacks on the network
+ *       core. Commands are posted back to CPU0 through the command queue,
+ *       which the receive callback already fills.
+ */
+typedef struct net_core_mailbox_t
+{
+    /*
+     * Set by CPU1 once it owns the network stack.
+     */
+    volatile uint32_t running __attribute__((aligned(32)));
+
+    spsc_queue_t requests;
+    net_core_stats_t stats;
+} net_core_mailbox_t;
+
+result_t start_network_core();
+
+bool network_core_running();
+
+bool network_stack_owned();
+
+result_t post_network_request(net_request_t *request);
+
+uint32_t get_free_network_requests();
+
+void get_network_core_stats(net_core_stats_t *stats);
+
+#endif
@@ -1,16 +1,184 @@
 #include "network_stack.h"
 
 #include "netif/xadapter.h"
+#include "netif/xemacpsif.h"
 #include "xparameters.h"
 #include "abort.h"
 #include "abort.h"
+#include "db.h"
+#include "l2_lockdown.h"
 #include "lwip/init.h"
+#include "net_core.h"
+#include "netif/etharp.h"
+#include "regs/slcr_regs.h"
+#include "system.h"
+#include "system_params.h"
+#include "tcp.h"
+#include "time_util.h"
+#include "trace.h"
+
+#include <string.h>
 
 /**
  * The ethernet networking interface used for communication.
  */
 static struct netif ethernet_interface;
 
+/**
+ * The state of the Ethernet link.
+ */
+static network_link_t link = {0};
+
+/*
+ * IEEE 802.3 PHY registers and their bit definitions.
+ */
+#define PHY_BMSR 1
+#define PHY_ID1 2
+#define PHY_ANAR 4
+#define PHY_ANLPAR 5
+#define PHY_1000BT_CONTROL 9
+#define PHY_1000BT_STATUS 10
+
+#define PHY_BMSR_LINK (1 << 2)
+#define PHY_BMSR_AUTONEG_COMPLETE (1 << 5)
+#define PHY_ANAR_10_FULL (1 << 6)
+#define PHY_ANAR_100_HALF (1 << 7)
+#define PHY_ANAR_100_FULL (1 << 8)
+#define PHY_1000BT_CONTROL_HALF (1 << 8)
+#define PHY_1000BT_CONTROL_FULL (1 << 9)
+#define PHY_1000BT_STATUS_HALF (1 << 10)
+#define PHY_1000BT_STATUS_FULL (1 << 11)
+
+/**
+ * Gets the Ethernet MAC driver of the interface.
+ *
+ * @return The driver.
+ */
+static XEmacPs *get_emacps()
+{
+    struct xemac_s *xemac = ethernet_interface.state;
+    xemacpsif_s *emac = xemac->state;
+
+    return &emac->emacps;
+}
+
+/**
+ * Finds the PHY on the management bus of the Ethernet MAC.
+ *
+ * @return None.
+ */
+static void find_phy()
+{
+    XEmacPs *emacps = get_emacps();
+    for (uint32_t address = 0; address < 32; ++address)
+    {
+        u16 id = 0;
+        if (XEmacPs_PhyRead(emacps, address, PHY_ID1, &id) == XST_SUCCESS &&
+            id != 0 && id != 0xFFFF)
+        {
+            link.phy_found = true;
+            link.phy_address = address;
+            return;
+        }
+    }
+}
+
+/**
+ * Reads the state of the link from the PHY, resolving the speed and duplex
+ * from the abilities that both ends advertised.
+ *
+ * @param[out] up Set true if the link is up and negotiated.
+ * @param[out] speed_mbps The speed of the link.
+ * @param[out] full_duplex Set true if the link is full duplex.
+ *
+ * @return Success or fail.
+ */
+static result_t read_phy_link(bool *up, uint32_t *speed_mbps, bool *full_duplex)
+{
+    XEmacPs *emacps = get_emacps();
+    const uint32_t address = link.phy_address;
+    u16 bmsr = 0;
+
+    /*
+     * The link status latches low, so it is read twice to get its current
+     * state.
+     */
+    AbortIfNot(XEmacPs_PhyRead(emacps, address, PHY_BMSR, &bmsr) == XST_SUCCESS, fail);
+    AbortIfNot(XEmacPs_PhyRead(emacps, address, PHY_BMSR, &bmsr) == XST_SUCCESS, fail);
+    *up = ((bmsr & PHY_BMSR_LINK) && (bmsr & PHY_BMSR_AUTONEG_COMPLETE))? true : false;
+    *speed_mbps = 0;
+    *full_duplex = false;
+    if (!*up)
+    {
+        return success;
+    }
+
+    u16 control_1000 = 0;
+    u16 status_1000 = 0;
+    AbortIfNot(XEmacPs_PhyRead(emacps, address, PHY_1000BT_CONTROL, &control_1000) == XST_SUCCESS, fail);
+    AbortIfNot(XEmacPs_PhyRead(emacps, address, PHY_1000BT_STATUS, &status_1000) == XST_SUCCESS, fail);
+    if ((control_1000 & PHY_1000BT_CONTROL_FULL) && (status_1000 & PHY_1000BT_STATUS_FULL))
+    {
+        *speed_mbps = 1000;
+        *full_duplex = true;
+        return success;
+    }
+
+    if ((control_1000 & PHY_1000BT_CONTROL_HALF) && (status_1000 & PHY_1000BT_STATUS_HALF))
+    {
+        *speed_mbps = 1000;
+        return success;
+    }
+
+    u16 advertised = 0;
+    u16 partner = 0;
+    AbortIfNot(XEmacPs_PhyRead(emacps, address, PHY_ANAR, &advertised) == XST_SUCCESS, fail);
+    AbortIfNot(XEmacPs_PhyRead(emacps, address, PHY_ANLPAR, &partner) == XST_SUCCESS, fail);
+    const u16 common = advertised & partner;
+    *speed_mbps = (common & (PHY_ANAR_100_FULL | PHY_ANAR_100_HALF))? 100 : 10;
+    *full_duplex = (common & (PHY_ANAR_100_FULL | PHY_ANAR_10_FULL)) &&
+                   ((*speed_mbps == 10) || (common & PHY_ANAR_100_FULL))? true : false;
+
+    return success;
+}
+
+/**
+ * Runs the Ethernet MAC at the speed and duplex of the link, with its
+ * reference clock divided to match.
+ *
+ * @param speed_mbps The speed of the link.
+ * @param full_duplex Specified true if the link is full duplex.
+ *
+ * @return None.
+ */
+static void set_mac_speed(const uint32_t speed_mbps, const bool full_duplex)
+{
+    XEmacPs *emacps = get_emacps();
+    XEmacPs_SetOperatingSpeed(emacps, speed_mbps);
+
+    uint32_t config = XEmacPs_ReadReg(emacps->Config.BaseAddress, XEMACPS_NWCFG_OFFSET);
+    config = (full_duplex)? config | XEMACPS_NWCFG_FDEN_MASK : config & ~XEMACPS_NWCFG_FDEN_MASK;
+    XEmacPs_WriteReg(emacps->Config.BaseAddress, XEMACPS_NWCFG_OFFSET, config);
+
+    uint32_t divisor0 = XPAR_PS7_ETHERNET_0_ENET_SLCR_1000MBPS_DIV0;
+    uint32_t divisor1 = XPAR_PS7_ETHERNET_0_ENET_SLCR_1000MBPS_DIV1;
+    if (speed_mbps == 100)
+    {
+        divisor0 = XPAR_PS7_ETHERNET_0_ENET_SLCR_100MBPS_DIV0;
+        divisor1 = XPAR_PS7_ETHERNET_0_ENET_SLCR_100MBPS_DIV1;
+    }
+    else if (speed_mbps == 10)
+    {
+        divisor0 = XPAR_PS7_ETHERNET_0_ENET_SLCR_10MBPS_DIV0;
+        divisor1 = XPAR_PS7_ETHERNET_0_ENET_SLCR_10MBPS_DIV1;
+    }
+
+    SLCR->SLCR_UNLOCK = 0xDF0D;
+    SLCR->GEM0_CLK_CTRL = (SLCR->GEM0_CLK_CTRL & ~GEM_CLK_DIVISOR_MASK) |
+                          (divisor0 << GEM_CLK_DIVISOR0_SHIFT) |
+                          (divisor1 << GEM_CLK_DIVISOR1_SHIFT);
+}
+
 result_t init_network_stack(struct ip_addr ip_address, struct ip_addr netmask,
                             struct ip_addr gateway, macaddr_t mac_address)
 {
@@ -33,8 +201,25 @@ result_t init_network_stack(struct ip_addr ip_address, struct ip_addr netmask,
                          mac_address.addr,
                          XPAR_XEMACPS_0_BASEADDR), fail);
 
+    /*
+     * The adapter connects the EMAC interrupt at its own priority. Received
+     * frames are only queued from it, so it must never delay the capture.
+     */
+    AbortIfNot(set_interrupt_priority(XPAR_XEMACPS_0_INTR, IRQ_PRIORITY_NETWORK), fail);
+
     netif_set_default(&ethernet_interface);
 
+    /*
+     * The adapter starts the MAC at the speed it negotiated, which is taken
+     * as the speed of the link if no PHY answers.
+     */
+    link.speed_mbps = XEmacPs_GetOperatingSpeed(get_emacps());
+    link.full_duplex = true;
+    link.up = true;
+    find_phy();
+    bool changed = false;
+    AbortIfNot(service_network_link(&changed), fail);
+
     /*
      * Specify that the ethernet interface is up.
      */
@@ -44,26 +229,496 @@ result_t init_network_stack(struct ip_addr ip_address, struct ip_addr netmask,
 }
 
 /**
- * Forward traffic received from the Ethernet driver into the network stack.
+ * Instrumentation of network stack dispatch.
+ */
+static network_dispatch_stats_t dispatch_stats = {0};
+
+/**
+ * Defines a destination whose ARP entry is kept resolved, so that a burst to
+ * it is never held behind address resolution, and the time of the last
+ * request for it.
+ */
+typedef struct arp_destination_t
+{
+    struct ip_addr address;
+    tick_t last_request;
+} arp_destination_t;
+
+static arp_destination_t arp_destinations[MAX_ARP_DESTINATIONS];
+static size_t num_arp_destinations = 0;
+
+/**
+ * The time that the ARP table was last aged.
+ */
+static tick_t arp_timer_tick = 0;
+
+/**
+ * Checks if datagrams to an address are sent to a resolved hardware address.
+ *
+ * @param address The destination address.
+ *
+ * @return True if the address is resolved by ARP.
+ */
+static bool arp_needed(struct ip_addr *address)
+{
+    return (!ip_addr_isany(address) &&
+            !ip_addr_ismulticast(address) &&
+            !ip_addr_isbroadcast(address, &ethernet_interface))? true : false;
+}
+
+/**
+ * Finds the address that is resolved to reach a destination, which is the
+ * gateway for a destination outside of the subnet.
+ *
+ * @param address The destination address.
+ *
+ * @return The address of the next hop.
+ */
+static struct ip_addr *arp_next_hop(struct ip_addr *address)
+{
+    if (!ip_addr_netcmp(address, &ethernet_interface.ip_addr, &ethernet_interface.netmask))
+    {
+        return &ethernet_interface.gw;
+    }
+
+    return address;
+}
+
+/**
+ * Checks if the ARP table holds a resolved entry for an address.
+ *
+ * @param hop The address of the next hop.
+ *
+ * @return True if the address is resolved.
+ */
+static bool arp_resolved(struct ip_addr *hop)
+{
+    struct eth_addr *eth_address;
+    ip_addr_t *ip_address;
+
+    return (etharp_find_addr(&ethernet_interface, hop, &eth_address, &ip_address) >= 0)? true : false;
+}
+
+/**
+ * Sends an ARP request for an address.
+ *
+ * @param hop The address of the next hop.
  *
  * @return None.
  */
-void dispatch_network_stack()
+static void request_arp(struct ip_addr *hop)
 {
-    uint32_t total_packets = 0;
-    uint32_t packets_rx;
+    etharp_request(&ethernet_interface, hop);
+    dispatch_stats.arp_requests++;
+}
+
+/**
+ * Ages the ARP table, so that unanswered requests are retried and the
+ * datagrams queued behind them freed, and requests the destinations again
+ * before their entries age out.
+ *
+ * @note lwIP timers are not run by the stack itself (NO_SYS_NO_TIMERS).
+ *
+ * @return None.
+ */
+static void service_arp()
+{
+    const tick_t now = get_system_time();
+    if (now - arp_timer_tick >= ms_to_ticks(ARP_TMR_INTERVAL))
+    {
+        arp_timer_tick = now;
+        etharp_tmr();
+    }
+
+    for (size_t i = 0; i < num_arp_destinations; ++i)
+    {
+        arp_destination_t *destination = &arp_destinations[i];
+        const uint32_t interval = (arp_resolved(&destination->address))?
+                ARP_REFRESH_INTERVAL_MS : ARP_RETRY_INTERVAL_MS;
+        if (now - destination->last_request >= ms_to_ticks(interval))
+        {
+            destination->last_request = now;
+            request_arp(&destination->address);
+        }
+    }
+}
+
+/**
+ * Keeps the ARP entry of a destination resolved from now on. A destination
+ * that is not yet resolved is requested immediately.
+ *
+ * @param address The destination address. Destinations outside of the subnet
+ *        keep the gateway resolved.
+ *
+ * @return Success or fail if too many destinations are kept.
+ */
+result_t add_arp_destination(struct ip_addr *address)
+{
+    AbortIfNot(address, fail);
+
+    if (!network_stack_owned())
+    {
+        static net_request_t request;
+        const uint32_t cpsr = save_and_disable_interrupts();
+        memset(&request, 0, sizeof(request));
+        request.op = NET_REQUEST_ADD_ARP;
+        ip_addr_copy(request.addr, *address);
+        const result_t ret = post_network_request(&request);
+        restore_interrupts(cpsr);
+
+        return ret;
+    }
+
+    if (!arp_needed(address))
+    {
+        return success;
+    }
+
+    struct ip_addr *hop = arp_next_hop(address);
+    for (size_t i = 0; i < num_arp_destinations; ++i)
+    {
+        if (ip_addr_cmp(&arp_destinations[i].address, hop))
+        {
+            return success;
+        }
+    }
+
+    if (num_arp_destinations >= MAX_ARP_DESTINATIONS)
+    {
+        return fail;
+    }
+
+    arp_destination_t *destination = &arp_destinations[num_arp_destinations++];
+    ip_addr_copy(destination->address, *hop);
+    destination->last_request = get_system_time();
+    if (!arp_resolved(hop))
+    {
+        request_arp(hop);
+    }
+
+    return success;
+}
+
+/**
+ * Ensures that the ARP entry of a destination is resolved before a burst is
+ * sent to it, waiting on an outstanding request for a bounded time.
+ *
+ * @param address The destination address.
+ * @param timeout_ms The longest time to wait for the destination to answer.
+ * @param[out] resolved Specified true if datagrams to the destination will
+ *             not wait on ARP.
+ *
+ * @return Success or fail.
+ */
+result_t prewarm_arp(struct ip_addr *address, const uint32_t timeout_ms, bool *resolved)
+{
+    AbortIfNot(address, fail);
+    AbortIfNot(resolved, fail);
+
+    *resolved = true;
+    if (!arp_needed(address))
+    {
+        return success;
+    }
+
+    struct ip_addr *hop = arp_next_hop(address);
+    if (arp_resolved(hop))
+    {
+        return success;
+    }
+
+    /*
+     * The network core requests the destination, and this core only watches
+     * the ARP table for the answer.
+     */
+    if (!add_arp_destination(address) && network_stack_owned())
+    {
+        request_arp(hop);
+    }
+
+    const tick_t start_time = get_system_time();
+    while (!arp_resolved(hop))
+    {
+        if (get_system_time() - start_time > ms_to_ticks(timeout_ms))
+        {
+            *resolved = false;
+            return success;
+        }
+
+        dispatch_network_stack();
+    }
+
+    return success;
+}
+
+/**
+ * Services the pending interrupts of the Ethernet MAC without taking them, as
+ * the network core does.
+ *
+ * @return None.
+ */
+HOT_CODE
+void poll_network_interrupts()
+{
+    XEmacPs *emacps = get_emacps();
+    if (XEmacPs_ReadReg(emacps->Config.BaseAddress, XEMACPS_ISR_OFFSET))
+    {
+        XEmacPs_IntrHandler(emacps);
+    }
+}
+
+/**
+ * Enables or disables the interrupt of the Ethernet MAC on CPU0.
+ *
+ * @param enabled Specified true to take the interrupt on CPU0, or false if
+ *        it is polled by the network core.
+ *
+ * @return Success or fail.
+ */
+result_t set_network_interrupts(const bool enabled)
+{
+    if (enabled)
+    {
+        AbortIfNot(enable_interrupt(XPAR_XEMACPS_0_INTR), fail);
+    }
+    else
+    {
+        AbortIfNot(disable_interrupt(XPAR_XEMACPS_0_INTR), fail);
+    }
+
+    return success;
+}
 
+/**
+ * Forward traffic received from the Ethernet driver into the network stack,
+ * stopping once a budget has been spent.
+ *
+ * @note Received frames are queued by the Ethernet interrupt, so frames left
+ *       over when the budget runs out are handled by a later call.
+ *
+ * @param max_packets The maximum number of frames to handle.
+ * @param max_ticks The maximum time to spend handling frames.
+ *
+ * @return The number of frames handled.
+ */
+HOT_CODE
+uint32_t dispatch_network_stack_budget(const uint32_t max_packets, const tick_t max_ticks)
+{
     /*
-     * Continually receive packets until no more are available from the
-     * hardware.
+     * The network core dispatches the stack itself.
      */
-    while ((packets_rx = xemacif_input(&ethernet_interface)))
+    if (!network_stack_owned())
+    {
+        return 0;
+    }
+
+    const tick_t start_time = get_system_time();
+    uint32_t total_packets = 0;
+    uint32_t packets_rx;
+    trace(TRACE_NETWORK_DISPATCH, TRACE_BEGIN, 0, 0);
+
+    while (total_packets < max_packets &&
+           get_system_time() - start_time < max_ticks &&
+           (packets_rx = xemacif_input(&ethernet_interface)))
     {
         total_packets += packets_rx;
     }
 
+    const tick_t duration = get_system_time() - start_time;
+    trace(TRACE_NETWORK_DISPATCH, TRACE_END, total_packets, 0);
+
+    dispatch_stats.calls++;
+    dispatch_stats.packets += total_packets;
+    if (total_packets > dispatch_stats.max_packets)
+    {
+        dispatch_stats.max_packets = total_packets;
+    }
+
+    if (duration > dispatch_stats.max_ticks)
+    {
+        dispatch_stats.max_ticks = duration;
+    }
+
+    if (total_packets >= max_packets || duration >= max_ticks)
+    {
+        dispatch_stats.budget_exhausted++;
+    }
+
     if (total_packets)
     {
-        dbprintf("Received %d packets\n", total_packets);
+        dblog(LOG_DEBUG, "Received %d packets\n", total_packets);
+    }
+
+    service_tcp_timers();
+    service_arp();
+
+    return total_packets;
+}
+
+/**
+ * Forward traffic received from the Ethernet driver into the network stack
+ * within the default budget.
+ *
+ * @return None.
+ */
+HOT_CODE
+void dispatch_network_stack()
+{
+    dispatch_network_stack_budget(NETWORK_DISPATCH_MAX_PACKETS,
+                                  micros_to_ticks(NETWORK_DISPATCH_MAX_US));
+}
+
+/**
+ * Gets the instrumentation of network stack dispatch.
+ *
+ * @param[out] stats The statistics since the last reset.
+ *
+ * @return None.
+ */
+void get_network_dispatch_stats(network_dispatch_stats_t *stats)
+{
+    *stats = dispatch_stats;
+}
+
+/**
+ * Clears the instrumentation of network stack dispatch.
+ *
+ * @return None.
+ */
+void reset_network_dispatch_stats()
+{
+    const network_dispatch_stats_t empty = {0};
+    dispatch_stats = empty;
+}
+
+/**
+ * Gets the number of Ethernet transmit descriptors available to new frames.
+ *
+ * @note Descriptors are returned to the ring by the transmit interrupt. While
+ *       the network core owns the stack, the frames queued to it are ahead
+ *       of any new frame, so no more than the free entries of its queue are
+ *       reported to CPU0.
+ *
+ * @return The number of free descriptors.
+ */
+uint32_t get_free_tx_descriptors()
+{
+    const uint32_t free = XEmacPs_BdRingGetFreeCnt(&XEmacPs_GetTxRing(get_emacps()));
+    if (network_stack_owned())
+    {
+        return free;
+    }
+
+    const uint32_t requests = get_free_network_requests();
+    return (requests < free)? requests : free;
+}
+
+/**
+ * Polls the PHY for the state of the link, and follows a change of speed or
+ * duplex with the MAC.
+ *
+ * @note This is called by the core that owns the network stack.
+ *
+ * @return Success or fail.
+ */
+result_t poll_network_link()
+{
+    if (!link.phy_found)
+    {
+        return success;
+    }
+
+    bool up = false;
+    uint32_t speed_mbps = 0;
+    bool full_duplex = false;
+    AbortIfNot(read_phy_link(&up, &speed_mbps, &full_duplex), fail);
+    if (up == link.up && (!up || (speed_mbps == link.speed_mbps && full_duplex == link.full_duplex)))
+    {
+        return success;
+    }
+
+    if (up)
+    {
+        link.speed_mbps = speed_mbps;
+        link.full_duplex = full_duplex;
+        set_mac_speed(speed_mbps, full_duplex);
+    }
+
+    link.up = up;
+    data_memory_barrier();
+    link.changes++;
+
+    return success;
+}
+
+/**
+ * Polls the state of the link if this core owns the network stack, and
+ * reports a change since the last call.
+ *
+ * @param[out] changed Set true if the link went up or down or changed speed
+ *             or duplex.
+ *
+ * @return Success or fail.
+ */
+result_t service_network_link(bool *changed)
+{
+    AbortIfNot(changed, fail);
+
+    *changed = false;
+    if (network_stack_owned())
+    {
+        AbortIfNot(poll_network_link(), fail);
     }
+
+    static uint32_t reported_changes = 0;
+    const uint32_t changes = link.changes;
+    if (changes == reported_changes)
+    {
+        return success;
+    }
+
+    *changed = true;
+    reported_changes = changes;
+    if (!link.up)
+    {
+        dblog(LOG_WARN, "Ethernet link is down.\n");
+        return success;
+    }
+
+    dblog((link.speed_mbps < 1000)? LOG_WARN : LOG_INFO, "Ethernet link is up at %u Mbit/s, %s duplex.\n",
+            link.speed_mbps, (link.full_duplex)? "full" : "half");
+
+    return success;
+}
+
+/**
+ * Gets the state of the Ethernet link.
+ *
+ * @param[out] state The state of the link.
+ *
+ * @return None.
+ */
+void get_network_link(network_link_t *state)
+{
+    *state = link;
+}
+
+/**
+ * Gets the rate the Ethernet link carries.
+ *
+ * @return The rate in bytes per second, or zero while the link is down.
+ */
+uint32_t get_link_bytes_per_second()
+{
+    return (link.up)? link.speed_mbps * (1000000 / 8) : 0;
+}
+
+/**
+ * Gets the maximum transmission unit of the Ethernet interface.
+ *
+ * @return The MTU in bytes.
+ */
+uint16_t get_network_mtu()
+{
+    return ethernet_interface.mtu;
 }
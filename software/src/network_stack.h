@@ -12,7 +12,86 @@ typedef struct macaddr_t
 result_t init_network_stack(struct ip_addr ip_address, struct ip_addr netmask,
                             struct ip_addr gateway, macaddr_t mac_address);
 
+/**
+ * Defines the instrumentation of network stack dispatch.
+ */
+typedef struct network_dispatch_stats_t
+{
+    uint32_t calls;
+    uint32_t packets;
+
+    /*
+     * The most frames and the longest time spent in a single call.
+     */
+    uint32_t max_packets;
+    tick_t max_ticks;
+
+    /*
+     * The number of calls that stopped with frames possibly still queued.
+     */
+    uint32_t budget_exhausted;
+
+    /*
+     * The ARP requests sent to resolve or refresh the destinations.
+     */
+    uint32_t arp_requests;
+} network_dispatch_stats_t;
+
+/**
+ * Defines the state of the Ethernet link as negotiated by its PHY.
+ */
+typedef struct network_link_t
+{
+    /*
+     * Whether a PHY answered on the management bus, and its address. Without
+     * one, the link is taken to run at the speed the MAC was started at.
+     */
+    bool phy_found;
+    uint32_t phy_address;
+
+    bool up;
+    bool full_duplex;
+    uint32_t speed_mbps;
+
+    /*
+     * The number of times the link went down or changed speed or duplex.
+     */
+    uint32_t changes;
+} network_link_t;
+
+/**
+ * Flags of the state of the Ethernet link.
+ */
+#define NETWORK_LINK_UP (1 << 0)
+#define NETWORK_LINK_FULL_DUPLEX (1 << 1)
+#define NETWORK_LINK_PHY_FOUND (1 << 2)
+
+result_t poll_network_link();
+
+result_t service_network_link(bool *changed);
+
+void get_network_link(network_link_t *link);
+
+uint32_t get_link_bytes_per_second();
+
 void dispatch_network_stack();
 
+void poll_network_interrupts();
+
+result_t set_network_interrupts(const bool enabled);
+
+uint32_t dispatch_network_stack_budget(const uint32_t max_packets, const tick_t max_ticks);
+
+void get_network_dispatch_stats(network_dispatch_stats_t *stats);
+
+void reset_network_dispatch_stats();
+
+uint32_t get_free_tx_descriptors();
+
+uint16_t get_network_mtu();
+
+result_t add_arp_destination(struct ip_addr *address);
+
+result_t prewarm_arp(struct ip_addr *address, const uint32_t timeout_ms, bool *resolved);
 
 #endif
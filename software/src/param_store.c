@@ -0,0 +1,842 @@
+#include "param_store.h"
+
+#include "abort.h"
+#include "db.h"
+#include "system.h"
+#include "time_util.h"
+
+#include "xparameters.h"
+
+#include <string.h>
+
+/**
+ * The time that the parameters must be unchanged before they are saved.
+ */
+#define PARAM_STORE_DELAY_MS 5000
+
+/**
+ * The geometry of the QSPI flash. The boot image is stored at the start of
+ * the flash, and the parameters in its last two sectors.
+ */
+#define QSPI_FLASH_SIZE (16 * 1024 * 1024)
+#define QSPI_SECTOR_SIZE (64 * 1024)
+#define QSPI_PAGE_SIZE 256
+
+#define PARAM_STORE_OFFSET (QSPI_FLASH_SIZE - 2 * QSPI_SECTOR_SIZE)
+
+/**
+ * The processing profiles are stored in the sector before the parameters.
+ */
+#define PROFILE_STORE_OFFSET (PARAM_STORE_OFFSET - QSPI_SECTOR_SIZE)
+
+/**
+ * Each record occupies one page, so that it is written by a single program.
+ */
+#define PARAM_STORE_SLOTS (QSPI_SECTOR_SIZE / QSPI_PAGE_SIZE)
+
+/**
+ * Identifies a parameter record, and is never the value of erased flash.
+ */
+#define PARAM_STORE_MAGIC 0x5350485A
+
+/**
+ * Identifies a profile record, and the version of its layout.
+ */
+#define PROFILE_STORE_MAGIC 0x4650485A
+#define PROFILE_STORE_VERSION 1
+
+/**
+ * The QSPI flash instructions and the busy bit of its status register.
+ */
+#define QSPI_WRITE_ENABLE 0x06
+#define QSPI_READ_STATUS 0x05
+#define QSPI_READ 0x03
+#define QSPI_PAGE_PROGRAM 0x02
+#define QSPI_SECTOR_ERASE 0xD8
+#define QSPI_STATUS_BUSY 0x01
+
+/**
+ * The number of bytes of an instruction and its address.
+ */
+#define QSPI_COMMAND_BYTES 4
+
+/**
+ * The longest time that a page program and a sector erase may take.
+ */
+#define QSPI_PROGRAM_TIMEOUT_MS 10
+#define QSPI_ERASE_TIMEOUT_MS 3000
+
+/**
+ * Defines the header of a stored parameter record. All fields are little
+ * endian.
+ */
+typedef struct __attribute__((packed)) param_record_header_t
+{
+    uint32_t magic;
+    uint16_t version;
+
+    /*
+     * The size of the stored parameters in bytes.
+     */
+    uint16_t length;
+
+    /*
+     * Incremented by every save, so that the latest record in either sector
+     * is found.
+     */
+    uint32_t sequence;
+
+    /*
+     * The CRC-32 of the stored parameters.
+     */
+    uint32_t crc;
+} param_record_header_t;
+
+typedef struct __attribute__((packed)) param_record_t
+{
+    param_record_header_t header;
+    HydroZynqParams params;
+} param_record_t;
+
+/**
+ * Defines a stored profile record. A profile without parameters deletes the
+ * profile of its name.
+ */
+typedef struct __attribute__((packed)) profile_record_t
+{
+    param_record_header_t header;
+    stored_profile_t profile;
+} profile_record_t;
+
+/**
+ * The buffers of QSPI transfers, which hold an instruction and a page.
+ */
+static uint8_t qspi_tx[QSPI_COMMAND_BYTES + QSPI_PAGE_SIZE];
+static uint8_t qspi_rx[QSPI_COMMAND_BYTES + QSPI_PAGE_SIZE];
+
+/**
+ * Computes the CRC-32 of data.
+ *
+ * @param data The data to check.
+ * @param len The number of bytes.
+ *
+ * @return The CRC-32.
+ */
+static uint32_t crc32(const uint8_t *data, const size_t len)
+{
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < len; ++i)
+    {
+        crc ^= data[i];
+        for (size_t bit = 0; bit < 8; ++bit)
+        {
+            crc = (crc >> 1) ^ ((crc & 1)? 0xEDB88320 : 0);
+        }
+    }
+
+    return ~crc;
+}
+
+/**
+ * Determines the flash address of a record slot.
+ *
+ * @param sector The sector of the slot.
+ * @param slot The index of the slot within the sector.
+ *
+ * @return The flash address.
+ */
+static uint32_t slot_address(const size_t sector, const size_t slot)
+{
+    return PARAM_STORE_OFFSET + sector * QSPI_SECTOR_SIZE + slot * QSPI_PAGE_SIZE;
+}
+
+/**
+ * Transfers an instruction with an address, followed by data.
+ *
+ * @param store The parameter store.
+ * @param instruction The instruction to send.
+ * @param address The flash address.
+ * @param data The data to send after the address, or NULL to read.
+ * @param len The number of bytes to send or receive after the address.
+ *
+ * @return Success or fail.
+ */
+static result_t qspi_transfer(param_store_t *store,
+                              const uint8_t instruction,
+                              const uint32_t address,
+                              const void *data,
+                              const size_t len)
+{
+    AbortIfNot(len <= QSPI_PAGE_SIZE, fail);
+
+    qspi_tx[0] = instruction;
+    qspi_tx[1] = address >> 16;
+    qspi_tx[2] = address >> 8;
+    qspi_tx[3] = address;
+    if (data)
+    {
+        memcpy(&qspi_tx[QSPI_COMMAND_BYTES], data, len);
+    }
+    else
+    {
+        memset(&qspi_tx[QSPI_COMMAND_BYTES], 0, len);
+    }
+
+    AbortIfNot(XQspiPs_PolledTransfer(&store->qspi,
+                                      qspi_tx,
+                                      qspi_rx,
+                                      QSPI_COMMAND_BYTES + len) == XST_SUCCESS, fail);
+
+    return success;
+}
+
+/**
+ * Reads from the flash.
+ *
+ * @param store The parameter store.
+ * @param address The flash address to read.
+ * @param[out] data The data read.
+ * @param len The number of bytes to read.
+ *
+ * @return Success or fail.
+ */
+static result_t qspi_read(param_store_t *store, const uint32_t address, void *data, const size_t len)
+{
+    AbortIfNot(qspi_transfer(store, QSPI_READ, address, NULL, len), fail);
+    memcpy(data, &qspi_rx[QSPI_COMMAND_BYTES], len);
+
+    return success;
+}
+
+/**
+ * Sends an instruction without an address.
+ *
+ * @param store The parameter store.
+ * @param instruction The instruction to send.
+ * @param[out] response The byte returned after the instruction, or NULL.
+ *
+ * @return Success or fail.
+ */
+static result_t qspi_instruction(param_store_t *store, const uint8_t instruction, uint8_t *response)
+{
+    qspi_tx[0] = instruction;
+    qspi_tx[1] = 0;
+
+    const size_t len = (response)? 2 : 1;
+    AbortIfNot(XQspiPs_PolledTransfer(&store->qspi, qspi_tx, qspi_rx, len) == XST_SUCCESS, fail);
+
+    if (response)
+    {
+        *response = qspi_rx[1];
+    }
+
+    return success;
+}
+
+/**
+ * Checks if the flash is programming or erasing.
+ *
+ * @param store The parameter store.
+ * @param[out] busy Specified true if the flash is busy.
+ *
+ * @return Success or fail.
+ */
+static result_t qspi_busy(param_store_t *store, bool *busy)
+{
+    uint8_t status = 0;
+    AbortIfNot(qspi_instruction(store, QSPI_READ_STATUS, &status), fail);
+    *busy = (status & QSPI_STATUS_BUSY)? true : false;
+
+    return success;
+}
+
+/**
+ * Waits for the flash to finish programming or erasing.
+ *
+ * @param store The parameter store.
+ * @param timeout_ms The longest time to wait.
+ *
+ * @return Success or fail.
+ */
+static result_t qspi_wait(param_store_t *store, const uint32_t timeout_ms)
+{
+    const tick_t start_time = get_system_time();
+    bool busy = true;
+    while (busy)
+    {
+        AbortIfNot(qspi_busy(store, &busy), fail);
+        AbortIf(busy && get_system_time() - start_time > ms_to_ticks(timeout_ms), fail);
+    }
+
+    return success;
+}
+
+/**
+ * Begins erasing a sector of the flash.
+ *
+ * @param store The parameter store.
+ * @param address The flash address of the sector.
+ *
+ * @return Success or fail.
+ */
+static result_t start_erase(param_store_t *store, const uint32_t address)
+{
+    AbortIfNot(qspi_instruction(store, QSPI_WRITE_ENABLE, NULL), fail);
+    AbortIfNot(qspi_transfer(store, QSPI_SECTOR_ERASE, address, NULL, 0), fail);
+
+    return success;
+}
+
+/**
+ * Reads a record slot.
+ *
+ * @param store The parameter store.
+ * @param sector The sector of the slot.
+ * @param slot The slot to read.
+ * @param[out] record The contents of the slot.
+ * @param[out] valid Specified true if the slot holds a valid record.
+ * @param[out] empty Specified true if the slot is erased.
+ *
+ * @return Success or fail.
+ */
+static result_t read_record(param_store_t *store,
+                            const size_t sector,
+                            const size_t slot,
+                            param_record_t *record,
+                            bool *valid,
+                            bool *empty)
+{
+    AbortIfNot(qspi_read(store, slot_address(sector, slot), record, sizeof(*record)), fail);
+
+    *empty = (record->header.magic == 0xFFFFFFFF)? true : false;
+    *valid = (record->header.magic == PARAM_STORE_MAGIC &&
+              record->header.version == PARAM_STORE_VERSION &&
+              record->header.length == sizeof(record->params) &&
+              record->header.crc == crc32((const uint8_t *)&record->params,
+                                          sizeof(record->params)))? true : false;
+
+    return success;
+}
+
+/**
+ * Finds the number of slots of a sector that have been written. Records are
+ * appended to an erased sector, so the written slots precede the erased ones.
+ *
+ * @param store The parameter store.
+ * @param sector The sector to search.
+ * @param[out] count The number of written slots.
+ *
+ * @return Success or fail.
+ */
+static result_t count_records(param_store_t *store, const size_t sector, size_t *count)
+{
+    size_t low = 0, high = PARAM_STORE_SLOTS;
+    while (low < high)
+    {
+        const size_t mid = (low + high) / 2;
+
+        param_record_t record;
+        bool valid, empty;
+        AbortIfNot(read_record(store, sector, mid, &record, &valid, &empty), fail);
+
+        if (empty)
+        {
+            high = mid;
+        }
+        else
+        {
+            low = mid + 1;
+        }
+    }
+
+    *count = low;
+
+    return success;
+}
+
+/**
+ * Writes the next record and verifies it.
+ *
+ * @param store The parameter store.
+ * @param params The parameters to write.
+ *
+ * @return Success or fail.
+ */
+static result_t write_record(param_store_t *store, const HydroZynqParams *params)
+{
+    AbortIfNot(store->next_slot < PARAM_STORE_SLOTS, fail);
+
+    param_record_t record;
+    record.header.magic = PARAM_STORE_MAGIC;
+    record.header.version = PARAM_STORE_VERSION;
+    record.header.length = sizeof(record.params);
+    record.header.sequence = store->sequence + 1;
+    record.params = *params;
+    record.header.crc = crc32((const uint8_t *)&record.params, sizeof(record.params));
+
+    /*
+     * The slot is consumed even if the write fails, so that a partially
+     * written slot is not programmed again.
+     */
+    const size_t slot = store->next_slot++;
+    AbortIfNot(qspi_instruction(store, QSPI_WRITE_ENABLE, NULL), fail);
+    AbortIfNot(qspi_transfer(store, QSPI_PAGE_PROGRAM, slot_address(store->sector, slot),
+                             &record, sizeof(record)), fail);
+    AbortIfNot(qspi_wait(store, QSPI_PROGRAM_TIMEOUT_MS), fail);
+
+    param_record_t readback;
+    bool valid, empty;
+    AbortIfNot(read_record(store, store->sector, slot, &readback, &valid, &empty), fail);
+    AbortIfNot(valid && readback.header.sequence == record.header.sequence, fail);
+
+    store->sequence = record.header.sequence;
+    store->saved = *params;
+    store->saves++;
+
+    return success;
+}
+
+/**
+ * Initializes the QSPI controller of the parameter store.
+ *
+ * @param store The parameter store to initialize.
+ *
+ * @return Success or fail.
+ */
+result_t init_param_store(param_store_t *store)
+{
+    AbortIfNot(store, fail);
+    AbortIfNot(sizeof(param_record_t) <= QSPI_PAGE_SIZE, fail);
+    AbortIfNot(sizeof(profile_record_t) <= QSPI_PAGE_SIZE, fail);
+
+    memset(store, 0, sizeof(*store));
+    store->state = PARAM_STORE_IDLE;
+
+    XQspiPs_Config *config = XQspiPs_LookupConfig(XPAR_PS7_QSPI_0_DEVICE_ID);
+    AbortIfNot(config, fail);
+    AbortIfNot(XQspiPs_CfgInitialize(&store->qspi, config, config->BaseAddress) == XST_SUCCESS, fail);
+    AbortIfNot(XQspiPs_SetOptions(&store->qspi,
+                                  XQSPIPS_FORCE_SSELECT_OPTION |
+                                  XQSPIPS_MANUAL_START_OPTION |
+                                  XQSPIPS_HOLD_B_DRIVE_OPTION) == XST_SUCCESS, fail);
+    AbortIfNot(XQspiPs_SetClkPrescaler(&store->qspi, XQSPIPS_CLK_PRESCALE_8) == XST_SUCCESS, fail);
+    AbortIfNot(XQspiPs_SetSlaveSelect(&store->qspi) == XST_SUCCESS, fail);
+
+    store->available = true;
+
+    return success;
+}
+
+/**
+ * Loads the latest saved parameters.
+ *
+ * @param store The parameter store.
+ * @param[in,out] params The parameters, which are replaced by the saved
+ *                parameters if any were found.
+ * @param[out] found Specified true if saved parameters were found.
+ *
+ * @return Success or fail.
+ */
+result_t load_params(param_store_t *store, HydroZynqParams *params, bool *found)
+{
+    AbortIfNot(store, fail);
+    AbortIfNot(params, fail);
+    AbortIfNot(found, fail);
+    AbortIfNot(store->available, fail);
+
+    *found = false;
+    store->sector = 0;
+    store->sequence = 0;
+    store->saved = *params;
+
+    size_t counts[2];
+    for (size_t sector = 0; sector < 2; ++sector)
+    {
+        AbortIfNot(count_records(store, sector, &counts[sector]), fail);
+
+        /*
+         * The last record of a sector may have been torn by a power loss,
+         * so earlier records are checked until a valid one is found.
+         */
+        for (size_t slot = counts[sector]; slot > 0; --slot)
+        {
+            param_record_t record;
+            bool valid, empty;
+            AbortIfNot(read_record(store, sector, slot - 1, &record, &valid, &empty), fail);
+            if (!valid)
+            {
+                continue;
+            }
+
+            if (!*found || record.header.sequence > store->sequence)
+            {
+                *found = true;
+                store->sector = sector;
+                store->sequence = record.header.sequence;
+                store->saved = record.params;
+            }
+            break;
+        }
+    }
+
+    store->next_slot = counts[store->sector];
+    if (*found)
+    {
+        *params = store->saved;
+    }
+
+    return success;
+}
+
+/**
+ * Saves the parameters once they have settled. Erasing a full sector takes
+ * hundreds of milliseconds, so it proceeds over later calls.
+ *
+ * @param store The parameter store.
+ * @param params The current parameters.
+ * @param force Specified true to save changed parameters without waiting for
+ *        them to settle.
+ *
+ * @return Success or fail.
+ */
+result_t service_param_store(param_store_t *store, const HydroZynqParams *params, const bool force)
+{
+    AbortIfNot(store, fail);
+    AbortIfNot(params, fail);
+
+    if (!store->available)
+    {
+        return success;
+    }
+
+    if (store->state == PARAM_STORE_ERASING)
+    {
+        bool busy = false;
+        AbortIfNot(qspi_busy(store, &busy), fail);
+        if (busy)
+        {
+            return success;
+        }
+
+        store->state = PARAM_STORE_IDLE;
+        store->sector = (store->sector + 1) % 2;
+        store->next_slot = 0;
+        store->erases++;
+    }
+
+    if (memcmp(params, &store->saved, sizeof(*params)) == 0)
+    {
+        store->save_pending = false;
+        store->save_due = false;
+        return success;
+    }
+
+    if (!store->save_pending || memcmp(params, &store->pending, sizeof(*params)) != 0)
+    {
+        store->pending = *params;
+        store->change_tick = get_system_time();
+        store->save_pending = true;
+    }
+
+    if (force)
+    {
+        store->save_due = true;
+    }
+
+    if (!store->save_due &&
+        get_system_time() - store->change_tick < ms_to_ticks(PARAM_STORE_DELAY_MS))
+    {
+        return success;
+    }
+
+    /*
+     * The other sector is erased once this one is full. Its records are
+     * older than the latest record, which is kept until the next save.
+     */
+    if (store->next_slot >= PARAM_STORE_SLOTS)
+    {
+        AbortIfNot(start_erase(store, slot_address((store->sector + 1) % 2, 0)), fail);
+        store->state = PARAM_STORE_ERASING;
+        return success;
+    }
+
+    store->save_pending = false;
+    store->save_due = false;
+    AbortIfNot(write_record(store, &store->pending), fail);
+    dbprintf("Parameters saved: record %u\n", store->sequence);
+
+    return success;
+}
+
+/**
+ * Erases every saved record, so that the defaults are used at the next boot.
+ *
+ * @param store The parameter store.
+ * @param params The current parameters, which are not saved again until they
+ *        change.
+ *
+ * @return Success or fail.
+ */
+result_t clear_param_store(param_store_t *store, const HydroZynqParams *params)
+{
+    AbortIfNot(store, fail);
+    AbortIfNot(params, fail);
+    AbortIfNot(store->available, fail);
+
+    if (store->state == PARAM_STORE_ERASING)
+    {
+        AbortIfNot(qspi_wait(store, QSPI_ERASE_TIMEOUT_MS), fail);
+        store->state = PARAM_STORE_IDLE;
+    }
+
+    for (size_t sector = 0; sector < 2; ++sector)
+    {
+        AbortIfNot(start_erase(store, slot_address(sector, 0)), fail);
+        AbortIfNot(qspi_wait(store, QSPI_ERASE_TIMEOUT_MS), fail);
+        store->erases++;
+    }
+
+    store->sector = 0;
+    store->next_slot = 0;
+    store->sequence = 0;
+    store->saved = *params;
+    store->save_pending = false;
+    store->save_due = false;
+
+    return success;
+}
+
+/**
+ * Replaces the profile of the same name in the saved profiles, adds it, or
+ * deletes it if it holds no parameters.
+ *
+ * @param store The parameter store.
+ * @param profile The profile.
+ *
+ * @return Success or fail if there is no room for another profile.
+ */
+static result_t apply_profile(param_store_t *store, const stored_profile_t *profile)
+{
+    size_t index = 0;
+    while (index < store->num_profiles &&
+           strncmp(store->profiles[index].name, profile->name, PROFILE_NAME_LEN) != 0)
+    {
+        index++;
+    }
+
+    if (!profile->length)
+    {
+        if (index < store->num_profiles)
+        {
+            store->num_profiles--;
+            memmove(&store->profiles[index],
+                    &store->profiles[index + 1],
+                    (store->num_profiles - index) * sizeof(stored_profile_t));
+        }
+        return success;
+    }
+
+    AbortIfNot(index < MAX_STORED_PROFILES, fail);
+    store->profiles[index] = *profile;
+    if (index == store->num_profiles)
+    {
+        store->num_profiles++;
+    }
+
+    return success;
+}
+
+/**
+ * Reads a profile record slot.
+ *
+ * @param store The parameter store.
+ * @param slot The slot to read.
+ * @param[out] record The contents of the slot.
+ * @param[out] valid Specified true if the slot holds a valid record.
+ * @param[out] empty Specified true if the slot is erased.
+ *
+ * @return Success or fail.
+ */
+static result_t read_profile_record(param_store_t *store,
+                                    const size_t slot,
+                                    profile_record_t *record,
+                                    bool *valid,
+                                    bool *empty)
+{
+    AbortIfNot(qspi_read(store, PROFILE_STORE_OFFSET + slot * QSPI_PAGE_SIZE, record, sizeof(*record)), fail);
+
+    *empty = (record->header.magic == 0xFFFFFFFF)? true : false;
+    *valid = (record->header.magic == PROFILE_STORE_MAGIC &&
+              record->header.version == PROFILE_STORE_VERSION &&
+              record->header.length == sizeof(record->profile) &&
+              record->profile.length <= PROFILE_PARAM_BYTES &&
+              record->header.crc == crc32((const uint8_t *)&record->profile,
+                                          sizeof(record->profile)))? true : false;
+
+    return success;
+}
+
+/**
+ * Appends a profile record and verifies it.
+ *
+ * @param store The parameter store.
+ * @param profile The profile to write.
+ *
+ * @return Success or fail.
+ */
+static result_t write_profile_record(param_store_t *store, const stored_profile_t *profile)
+{
+    AbortIfNot(store->next_profile_slot < PARAM_STORE_SLOTS, fail);
+
+    profile_record_t record;
+    record.header.magic = PROFILE_STORE_MAGIC;
+    record.header.version = PROFILE_STORE_VERSION;
+    record.header.length = sizeof(record.profile);
+    record.header.sequence = store->next_profile_slot;
+    record.profile = *profile;
+    record.header.crc = crc32((const uint8_t *)&record.profile, sizeof(record.profile));
+
+    const size_t slot = store->next_profile_slot++;
+    AbortIfNot(qspi_instruction(store, QSPI_WRITE_ENABLE, NULL), fail);
+    AbortIfNot(qspi_transfer(store, QSPI_PAGE_PROGRAM, PROFILE_STORE_OFFSET + slot * QSPI_PAGE_SIZE,
+                             &record, sizeof(record)), fail);
+    AbortIfNot(qspi_wait(store, QSPI_PROGRAM_TIMEOUT_MS), fail);
+
+    profile_record_t readback;
+    bool valid, empty;
+    AbortIfNot(read_profile_record(store, slot, &readback, &valid, &empty), fail);
+    AbortIfNot(valid, fail);
+
+    store->saves++;
+
+    return success;
+}
+
+/**
+ * Loads the saved processing profiles.
+ *
+ * @param store The parameter store.
+ *
+ * @return Success or fail.
+ */
+result_t load_profiles(param_store_t *store)
+{
+    AbortIfNot(store, fail);
+    AbortIfNot(store->available, fail);
+
+    store->num_profiles = 0;
+    store->next_profile_slot = 0;
+    while (store->next_profile_slot < PARAM_STORE_SLOTS)
+    {
+        profile_record_t record;
+        bool valid, empty;
+        AbortIfNot(read_profile_record(store, store->next_profile_slot, &record, &valid, &empty), fail);
+        if (empty)
+        {
+            break;
+        }
+
+        /*
+         * A torn record is skipped, and its slot is not written again.
+         */
+        store->next_profile_slot++;
+        if (valid)
+        {
+            record.profile.name[PROFILE_NAME_LEN - 1] = 0;
+            if (!apply_profile(store, &record.profile))
+            {
+                dblog(LOG_WARN, "Profile %s could not be loaded.\n", record.profile.name);
+            }
+        }
+    }
+
+    return success;
+}
+
+/**
+ * Saves a processing profile, replacing any profile of the same name.
+ *
+ * @note Once the profile sector is full it is erased and the saved profiles
+ *       are rewritten, which blocks for up to a few seconds.
+ *
+ * @param store The parameter store.
+ * @param name The name of the profile.
+ * @param params The parameters of the profile, encoded as the parameters of
+ *        a binary command.
+ * @param len The length of the parameters, or zero to delete the profile.
+ *
+ * @return Success or fail.
+ */
+result_t save_profile(param_store_t *store, const char *name, const uint8_t *params, const size_t len)
+{
+    AbortIfNot(store, fail);
+    AbortIfNot(name, fail);
+    AbortIfNot(params || !len, fail);
+    AbortIfNot(*name && strlen(name) < PROFILE_NAME_LEN, fail);
+    AbortIfNot(len <= PROFILE_PARAM_BYTES, fail);
+
+    stored_profile_t profile;
+    memset(&profile, 0, sizeof(profile));
+    strcpy(profile.name, name);
+    profile.length = len;
+    if (len)
+    {
+        memcpy(profile.params, params, len);
+    }
+
+    AbortIfNot(apply_profile(store, &profile), fail);
+
+    /*
+     * Without the flash, profiles are kept until the next reboot.
+     */
+    if (!store->available)
+    {
+        return success;
+    }
+
+    if (store->state == PARAM_STORE_ERASING)
+    {
+        AbortIfNot(qspi_wait(store, QSPI_ERASE_TIMEOUT_MS), fail);
+    }
+
+    if (store->next_profile_slot < PARAM_STORE_SLOTS)
+    {
+        AbortIfNot(write_profile_record(store, &profile), fail);
+        return success;
+    }
+
+    AbortIfNot(start_erase(store, PROFILE_STORE_OFFSET), fail);
+    AbortIfNot(qspi_wait(store, QSPI_ERASE_TIMEOUT_MS), fail);
+    store->erases++;
+    store->next_profile_slot = 0;
+    for (size_t i = 0; i < store->num_profiles; ++i)
+    {
+        AbortIfNot(write_profile_record(store, &store->profiles[i]), fail);
+    }
+
+    return success;
+}
+
+/**
+ * Finds a saved processing profile.
+ *
+ * @param store The parameter store.
+ * @param name The name of the profile.
+ *
+ * @return The profile, or NULL if no profile of that name is saved.
+ */
+const stored_profile_t *find_profile(const param_store_t *store, const char *name)
+{
+    AbortIfNot(store, NULL);
+    AbortIfNot(name, NULL);
+
+    for (size_t i = 0; i < store->num_profiles; ++i)
+    {
+        if (strncmp(store->profiles[i].name, name, PROFILE_NAME_LEN) == 0)
+        {
+            return &store->profiles[i];
+        }
+    }
+
+    return NULL;
+}
@@ -0,0 +1,109 @@
+#ifndef PARAM_STORE_H
+#define PARAM_STORE_H
+
+#include "types.h"
+
+#include "xqspips.h"
+
+/**
+ * The version of the stored parameter layout. This must be incremented
+ * whenever HydroZynqParams changes so that stale records are ignored.
+ */
+#define PARAM_STORE_VERSION 18
+
+/**
+ * The number of processing profiles that may be saved, the longest name of a
+ * profile including its terminator, and the most bytes of encoded command
+ * parameters that a profile holds, so that a profile record fits a page.
+ */
+#define MAX_STORED_PROFILES 8
+#define PROFILE_NAME_LEN 16
+#define PROFILE_PARAM_BYTES 220
+
+/**
+ * Defines a named processing profile: a set of parameters encoded as the
+ * parameters of a binary command, which are applied together.
+ */
+typedef struct __attribute__((packed)) stored_profile_t
+{
+    char name[PROFILE_NAME_LEN];
+    uint16_t length;
+    uint8_t params[PROFILE_PARAM_BYTES];
+} stored_profile_t;
+
+/**
+ * Defines the state of the parameter store.
+ */
+typedef enum param_store_state_t
+{
+    PARAM_STORE_IDLE,
+    PARAM_STORE_ERASING
+} param_store_state_t;
+
+/**
+ * Defines a store of the operating parameters in QSPI flash. Each save
+ * appends a record to one of two flash sectors, and a sector is only erased
+ * once the other is full, so that a sector is erased once per several hundred
+ * saves and the latest record survives a power loss during a save.
+ */
+typedef struct param_store_t
+{
+    XQspiPs qspi;
+    bool available;
+    param_store_state_t state;
+
+    /*
+     * The sector that records are appended to, the slot of the next record
+     * within it, and the sequence number of the latest record.
+     */
+    size_t sector;
+    size_t next_slot;
+    uint32_t sequence;
+
+    /*
+     * The parameters of the latest record.
+     */
+    HydroZynqParams saved;
+
+    /*
+     * Parameters that differ from the latest record are saved once they have
+     * not changed for PARAM_STORE_DELAY_MS, so that a burst of commands is
+     * written once.
+     */
+    bool save_pending;
+    HydroZynqParams pending;
+    tick_t change_tick;
+
+    /*
+     * Specified true if the pending parameters are saved without waiting.
+     */
+    bool save_due;
+
+    /*
+     * The saved processing profiles. Profiles are appended to a sector of
+     * their own, where a later record of a name replaces an earlier one, and
+     * the sector is erased and rewritten once it is full.
+     */
+    stored_profile_t profiles[MAX_STORED_PROFILES];
+    size_t num_profiles;
+    size_t next_profile_slot;
+
+    uint32_t saves;
+    uint32_t erases;
+} param_store_t;
+
+result_t init_param_store(param_store_t *store);
+
+result_t load_params(param_store_t *store, HydroZynqParams *params, bool *found);
+
+result_t service_param_store(param_store_t *store, const HydroZynqParams *params, const bool force);
+
+result_t clear_param_store(param_store_t *store, const HydroZynqParams *params);
+
+result_t load_profiles(param_store_t *store);
+
+result_t save_profile(param_store_t *store, const char *name, const uint8_t *params, const size_t len);
+
+const stored_profile_t *find_profile(const param_store_t *store, const char *name);
+
+#endif
@@ -0,0 +1,238 @@
+#include "pc_sampler.h"
+#include "regs/system_registers.h"
+
+#include "abort.h"
+#include "amp.h"
+#include "system.h"
+#include "system_params.h"
+#include "time_util.h"
+#include "types.h"
+#include "udp.h"
+#include "xil_io.h"
+
+#include <string.h>
+
+_Static_assert((PC_SAMPLE_BUCKETS & (PC_SAMPLE_BUCKETS - 1)) == 0,
+               "The number of PC sample buckets must be a power of two.");
+
+/**
+ * The program counter sampling register of the DSP core's debug interface,
+ * which reads as all ones while non-invasive debug is not permitted.
+ */
+#define CPU1_DBGPCSR_ADDR 0xF8892084
+#define DBGPCSR_UNAVAILABLE 0xFFFFFFFF
+
+/**
+ * The number of buckets searched for an instruction before its sample is
+ * dropped.
+ */
+#define PC_SAMPLE_PROBES 16
+
+/**
+ * Defines the count of one sampled instruction. Unused buckets hold a zero
+ * address.
+ */
+typedef struct pc_bucket_t
+{
+    uint32_t pc;
+    uint32_t count;
+} pc_bucket_t;
+
+/**
+ * The counts of the instructions sampled on each core, and the totals of the
+ * current run. They are only written from the sampling interrupt.
+ */
+static pc_bucket_t pc_buckets[2][PC_SAMPLE_BUCKETS];
+static uint32_t pc_samples[2] = {0};
+static uint32_t pc_unavailable = 0;
+static uint32_t pc_dropped = 0;
+static uint32_t pc_period_us = 0;
+static volatile bool pc_sampling = false;
+
+/**
+ * Counts a sample of an instruction.
+ *
+ * @param cpu The core that executed the instruction.
+ * @param pc The address of the instruction.
+ *
+ * @return None.
+ */
+static void count_pc_sample(const uint32_t cpu, const uint32_t pc)
+{
+    pc_samples[cpu]++;
+
+    uint32_t index = (pc >> 2) * 2654435761u;
+    for (uint32_t i = 0; i < PC_SAMPLE_PROBES; ++i, ++index)
+    {
+        pc_bucket_t *bucket = &pc_buckets[cpu][index & (PC_SAMPLE_BUCKETS - 1)];
+        if (bucket->pc == pc || !bucket->pc)
+        {
+            bucket->pc = pc;
+            bucket->count++;
+            return;
+        }
+    }
+
+    pc_dropped++;
+}
+
+/**
+ * Samples the instruction that the private timer interrupted on this core,
+ * and the instruction executing on the DSP core.
+ *
+ * @note The sampling register of the DSP core holds the address of the
+ *       instruction plus eight in ARM state or plus four in Thumb state,
+ *       where bit zero is set.
+ *
+ * @param arg Unused.
+ *
+ * @return None.
+ */
+static void pc_sample_handler(void *arg)
+{
+    private_timer_regs->Interrupt_Status_Register = PRIVATE_TIMER_EVENT_FLAG;
+
+    count_pc_sample(0, get_interrupted_pc());
+
+    if (dsp_core_running())
+    {
+        const uint32_t pcsr = Xil_In32(CPU1_DBGPCSR_ADDR);
+        if (pcsr == DBGPCSR_UNAVAILABLE)
+        {
+            pc_unavailable++;
+        }
+        else
+        {
+            count_pc_sample(1, (pcsr & 0x1)? (pcsr & ~0x1) - 4 : pcsr - 8);
+        }
+    }
+}
+
+/**
+ * Discards the samples held and starts sampling the instructions executed
+ * by both cores from the private timer.
+ *
+ * @note The private timer stops waking an idle core at its usual period
+ *       until sampling is stopped, and instead wakes it at each sample.
+ *
+ * @param period_us The period between samples in microseconds.
+ *
+ * @return Success or fail.
+ */
+result_t start_pc_sampling(const uint32_t period_us)
+{
+    AbortIfNot(period_us, fail);
+
+    private_timer_regs->Control_Register = 0;
+    pc_sampling = false;
+
+    memset(pc_buckets, 0, sizeof(pc_buckets));
+    pc_samples[0] = 0;
+    pc_samples[1] = 0;
+    pc_unavailable = 0;
+    pc_dropped = 0;
+    pc_period_us = period_us;
+
+    private_timer_regs->Interrupt_Status_Register = PRIVATE_TIMER_EVENT_FLAG;
+    AbortIfNot(register_interrupt(PRIVATE_TIMER_IRQ_ID, pc_sample_handler, NULL, IRQ_PRIORITY_PROFILE), fail);
+
+    private_timer_regs->Load_Register = micros_to_ticks(period_us) - 1;
+    private_timer_regs->Control_Register = PRIVATE_TIMER_ENABLE |
+                                           PRIVATE_TIMER_AUTO_RELOAD |
+                                           PRIVATE_TIMER_IRQ_ENABLE;
+    pc_sampling = true;
+
+    return success;
+}
+
+/**
+ * Stops sampling, keeping the samples held, and returns the private timer to
+ * waking an idle core.
+ *
+ * @return Success or fail.
+ */
+result_t stop_pc_sampling()
+{
+    if (!pc_sampling)
+    {
+        return success;
+    }
+
+    pc_sampling = false;
+    AbortIfNot(enable_idle_wakeup(), fail);
+
+    return success;
+}
+
+/**
+ * Stops sampling and sends the count of each sampled instruction.
+ *
+ * @note The datagrams are paced so that the dump does not exhaust the
+ *       transmit buffers.
+ *
+ * @param socket The socket to send the dump on.
+ *
+ * @return Success or fail.
+ */
+result_t send_pc_samples(udp_socket_t *socket)
+{
+    AbortIfNot(socket, fail);
+    AbortIfNot(stop_pc_sampling(), fail);
+
+    static struct __attribute__((packed))
+    {
+        pc_sample_packet_header_t header;
+        pc_sample_entry_t entries[PC_SAMPLE_PACKET_ENTRIES];
+    } packet;
+    memset(&packet, 0, sizeof(packet));
+    packet.header.magic = PC_SAMPLE_MAGIC;
+    packet.header.version = PC_SAMPLE_REPORT_VERSION;
+    packet.header.period_us = pc_period_us;
+    packet.header.samples[0] = pc_samples[0];
+    packet.header.samples[1] = pc_samples[1];
+    packet.header.unavailable = pc_unavailable;
+    packet.header.dropped = pc_dropped;
+
+    for (uint32_t cpu = 0; cpu < 2; ++cpu)
+    {
+        for (uint32_t i = 0; i < PC_SAMPLE_BUCKETS; ++i)
+        {
+            packet.header.total += (pc_buckets[cpu][i].count)? 1 : 0;
+        }
+    }
+
+    /*
+     * An empty dump is still sent as a single datagram of totals.
+     */
+    uint32_t count = 0;
+    for (uint32_t bucket = 0; bucket <= 2 * PC_SAMPLE_BUCKETS; ++bucket)
+    {
+        const bool last = (bucket == 2 * PC_SAMPLE_BUCKETS)? true : false;
+        if (!last)
+        {
+            const pc_bucket_t *entry = &pc_buckets[bucket / PC_SAMPLE_BUCKETS][bucket % PC_SAMPLE_BUCKETS];
+            if (!entry->count)
+            {
+                continue;
+            }
+
+            packet.entries[count].pc = entry->pc;
+            packet.entries[count].count = entry->count;
+            packet.entries[count].cpu = bucket / PC_SAMPLE_BUCKETS;
+            count++;
+        }
+
+        if (count == PC_SAMPLE_PACKET_ENTRIES || (last && (count || !packet.header.total)))
+        {
+            packet.header.num_entries = count;
+            AbortIfNot(send_udp(socket,
+                                (char *)&packet,
+                                sizeof(packet.header) + count * sizeof(pc_sample_entry_t)), fail);
+            busywait(micros_to_ticks(PC_SAMPLE_PACKET_INTERVAL_US));
+            packet.header.first += count;
+            count = 0;
+        }
+    }
+
+    return success;
+}
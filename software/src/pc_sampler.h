@@ -0,0 +1,64 @@
+#ifndef PC_SAMPLER_H
+#define PC_SAMPLER_H
+
+#include "types.h"
+#include "udp.h"
+
+/**
+ * Identifies the datagrams of a PC sample dump on the telemetry port, and
+ * the version of their layout.
+ */
+#define PC_SAMPLE_MAGIC 0x53505A48
+#define PC_SAMPLE_REPORT_VERSION 1
+
+/**
+ * The number of instructions sent in each datagram of a sample dump.
+ */
+#define PC_SAMPLE_PACKET_ENTRIES 128
+
+/**
+ * Defines the number of samples taken of one instruction on one core.
+ */
+typedef struct __attribute__((packed)) pc_sample_entry_t
+{
+    uint32_t pc;
+    uint32_t count;
+    uint8_t cpu;
+    uint8_t reserved[3];
+} pc_sample_entry_t;
+
+/**
+ * Defines the header of each datagram of a sample dump, which is followed by
+ * num_entries entries.
+ */
+typedef struct __attribute__((packed)) pc_sample_packet_header_t
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t num_entries;
+    uint32_t period_us;
+
+    /*
+     * The index of the first entry of the datagram within the dump, and the
+     * number of entries in the dump.
+     */
+    uint32_t first;
+    uint32_t total;
+
+    /*
+     * The samples taken of each core, the samples of the DSP core that could
+     * not be read because non-invasive debug is disabled, and the samples
+     * that were lost because the table of their core was full.
+     */
+    uint32_t samples[2];
+    uint32_t unavailable;
+    uint32_t dropped;
+} pc_sample_packet_header_t;
+
+result_t start_pc_sampling(const uint32_t period_us);
+
+result_t stop_pc_sampling();
+
+result_t send_pc_samples(udp_socket_t *socket);
+
+#endif
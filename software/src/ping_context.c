@@ -0,0 +1,108 @@
+#include "ping_context.h"
+
+#include "abort.h"
+#include "types.h"
+
+#include <string.h>
+
+/**
+ * Initializes a pool with every context free.
+ *
+ * @param[out] pool The pool to initialize.
+ *
+ * @return None.
+ */
+void init_ping_context_pool(ping_context_pool_t *pool)
+{
+    for (size_t i = 0; i < PING_CONTEXT_POOL_SIZE; ++i)
+    {
+        pool->contexts[i].handle = PING_HANDLE_NONE;
+    }
+
+    pool->allocated = 0;
+    pool->exhausted = 0;
+}
+
+/**
+ * Takes a free context from a pool for a new ping. Every field of the
+ * context is cleared.
+ *
+ * @param pool The pool.
+ * @param[out] handle The handle of the context.
+ *
+ * @return Success or fail if every context is in use.
+ */
+result_t acquire_ping_context(ping_context_pool_t *pool, ping_handle_t *handle)
+{
+    AbortIfNot(pool, fail);
+    AbortIfNot(handle, fail);
+
+    *handle = PING_HANDLE_NONE;
+    for (size_t i = 0; i < PING_CONTEXT_POOL_SIZE; ++i)
+    {
+        if (!(pool->allocated & (1u << i)))
+        {
+            ping_context_t *context = &pool->contexts[i];
+            memset(context, 0, sizeof(*context));
+            context->handle = i;
+            pool->allocated |= 1u << i;
+            *handle = i;
+            return success;
+        }
+    }
+
+    pool->exhausted++;
+    return fail;
+}
+
+/**
+ * Looks up the context of a handle.
+ *
+ * @param pool The pool.
+ * @param handle The handle.
+ *
+ * @return The context, or NULL if the handle does not refer to a context in
+ *         use.
+ */
+ping_context_t *get_ping_context(ping_context_pool_t *pool, const ping_handle_t handle)
+{
+    if (handle >= PING_CONTEXT_POOL_SIZE || !(pool->allocated & (1u << handle)))
+    {
+        return NULL;
+    }
+
+    return &pool->contexts[handle];
+}
+
+/**
+ * Returns a context to its pool once its ping has left the pipeline.
+ *
+ * @note Releasing PING_HANDLE_NONE or a free context does nothing.
+ *
+ * @param pool The pool.
+ * @param handle The handle of the context.
+ *
+ * @return None.
+ */
+void release_ping_context(ping_context_pool_t *pool, const ping_handle_t handle)
+{
+    if (handle >= PING_CONTEXT_POOL_SIZE)
+    {
+        return;
+    }
+
+    pool->contexts[handle].handle = PING_HANDLE_NONE;
+    pool->allocated &= ~(1u << handle);
+}
+
+/**
+ * Counts the contexts of a pool that are in use.
+ *
+ * @param pool The pool.
+ *
+ * @return The number of contexts in use.
+ */
+size_t ping_contexts_in_use(const ping_context_pool_t *pool)
+{
+    return __builtin_popcount(pool->allocated);
+}
@@ -0,0 +1,105 @@
+#ifndef PING_CONTEXT_H
+#define PING_CONTEXT_H
+
+#include "dsp.h"
+#include "system_params.h"
+#include "transmission_util.h"
+#include "types.h"
+
+/**
+ * Identifies a ping context within its pool, so that a ping is passed
+ * between stages, queues and cores without copying its state.
+ */
+typedef uint32_t ping_handle_t;
+
+/**
+ * The handle that refers to no ping.
+ */
+#define PING_HANDLE_NONE UINT32_MAX
+
+/**
+ * Defines the state of one ping as it moves through the pipeline, from its
+ * capture to the result that is relayed.
+ */
+typedef struct ping_context_t
+{
+    ping_handle_t handle;
+
+    /*
+     * The sequence number that the result is sent with, or zero until the
+     * ping is located.
+     */
+    uint32_t sequence;
+
+    /*
+     * The capture buffer that the ping was recorded into.
+     */
+    sample_t *samples;
+    size_t num_samples;
+    uint32_t sampling_frequency;
+
+    /*
+     * The hardware sample index of the start of the window and the system
+     * time that it maps to.
+     */
+    uint64_t ping_sample;
+    tick_t ping_tick;
+
+    /*
+     * The window of the ping within the capture buffer.
+     */
+    size_t start_index;
+    size_t end_index;
+
+    /*
+     * The times at which the stages of the ping finished. The capture stage
+     * holds the time that the capture completed.
+     */
+    ping_stages_t stages;
+
+    /*
+     * The processing of the capture, which holds the statistics of the
+     * capture, the correlations and their number, and the measured result.
+     */
+    dsp_job_t job;
+
+    /*
+     * The result with its solved bearing, and the estimate of the bearing
+     * tracker after the ping.
+     */
+    correlation_result_t result;
+    bearing_estimate_t track;
+} ping_context_t;
+
+/**
+ * Defines a fixed pool of ping contexts.
+ *
+ * @note Contexts are acquired and released by CPU0 only. Other cores and
+ *       interrupt handlers may only use the contexts they are handed.
+ */
+typedef struct ping_context_pool_t
+{
+    ping_context_t contexts[PING_CONTEXT_POOL_SIZE];
+
+    /*
+     * A mask of the contexts that are in use, with bit i set for context i.
+     */
+    uint32_t allocated;
+
+    /*
+     * The number of contexts that could not be acquired.
+     */
+    uint32_t exhausted;
+} ping_context_pool_t;
+
+void init_ping_context_pool(ping_context_pool_t *pool);
+
+result_t acquire_ping_context(ping_context_pool_t *pool, ping_handle_t *handle);
+
+ping_context_t *get_ping_context(ping_context_pool_t *pool, const ping_handle_t handle);
+
+void release_ping_context(ping_context_pool_t *pool, const ping_handle_t handle);
+
+size_t ping_contexts_in_use(const ping_context_pool_t *pool);
+
+#endif
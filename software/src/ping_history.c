@@ -0,0 +1,182 @@
+#include "ping_history.h"
+
+#include "abort.h"
+#include "types.h"
+
+#include <string.h>
+
+/**
+ * Initializes an empty ping history over storage for every record.
+ *
+ * @param[out] history The history to initialize.
+ * @param sample_storage Storage for PING_HISTORY_DEPTH windows.
+ * @param window_capacity The number of samples in each window.
+ * @param correlation_storage Storage for PING_HISTORY_DEPTH sets of
+ *        correlations.
+ * @param correlation_capacity The number of correlations in each set.
+ * @param copy_engine The engine that windows are copied in with, or NULL to
+ *        copy them with the processor.
+ * @param copy_flags The cache maintenance that windows need around a copy
+ *        by the engine, as copy_flags_t.
+ *
+ * @return Success or fail.
+ */
+result_t init_ping_history(ping_history_t *history,
+                           sample_t *sample_storage,
+                           const size_t window_capacity,
+                           correlation_t *correlation_storage,
+                           const size_t correlation_capacity,
+                           copy_engine_t *copy_engine,
+                           const uint32_t copy_flags)
+{
+    AbortIfNot(history, fail);
+    AbortIfNot(sample_storage, fail);
+    AbortIfNot(correlation_storage, fail);
+    AbortIfNot(window_capacity, fail);
+
+    for (size_t i = 0; i < PING_HISTORY_DEPTH; ++i)
+    {
+        ping_record_t *record = &history->records[i];
+        record->samples = &sample_storage[i * window_capacity];
+        record->correlations = &correlation_storage[i * correlation_capacity];
+        record->num_samples = 0;
+        record->num_correlations = 0;
+        init_copy_job(&record->copy);
+        record->valid = false;
+    }
+
+    history->next = 0;
+    history->window_capacity = window_capacity;
+    history->correlation_capacity = correlation_capacity;
+    history->copy_engine = copy_engine;
+    history->copy_flags = copy_flags;
+    history->stored = 0;
+
+    return success;
+}
+
+/**
+ * Copies a located ping into the history in place of the oldest record.
+ *
+ * @note The window and the correlations are truncated to the capacity of a
+ *       record, keeping their start. The window may be copied in the
+ *       background, so it must not be overwritten until
+ *       finish_ping_history_copies() returns.
+ *
+ * @param history The ping history.
+ * @param sequence The sequence number that the result was sent with.
+ * @param ping_tick The system time of the ping.
+ * @param trigger The latest edge of the external trigger input.
+ * @param track The estimate of the bearing tracker after the ping.
+ * @param result The result of the ping.
+ * @param samples The window of the ping.
+ * @param num_samples The number of samples in the window.
+ * @param correlations The correlations of the ping, or NULL if none.
+ * @param num_correlations The number of correlations.
+ *
+ * @return Success or fail.
+ */
+result_t push_ping_history(ping_history_t *history,
+                           const uint32_t sequence,
+                           const tick_t ping_tick,
+                           const trigger_mark_t *trigger,
+                           const bearing_estimate_t *track,
+                           const correlation_result_t *result,
+                           const sample_t *samples,
+                           const size_t num_samples,
+                           const correlation_t *correlations,
+                           const size_t num_correlations)
+{
+    AbortIfNot(history, fail);
+    AbortIfNot(history->window_capacity, fail);
+    AbortIfNot(trigger, fail);
+    AbortIfNot(track, fail);
+    AbortIfNot(result, fail);
+    AbortIfNot(samples, fail);
+
+    ping_record_t *record = &history->records[history->next];
+
+    /*
+     * The record is replaced, so its previous copy is waited for whatever its
+     * outcome.
+     */
+    finish_copy(&record->copy);
+    record->sequence = sequence;
+    record->ping_tick = ping_tick;
+    record->trigger = *trigger;
+    record->track = *track;
+    record->result = *result;
+
+    record->num_samples = (num_samples < history->window_capacity)? num_samples : history->window_capacity;
+    AbortIfNot(start_copy(history->copy_engine,
+                          &record->copy,
+                          record->samples,
+                          samples,
+                          record->num_samples * sizeof(sample_t),
+                          history->copy_flags), fail);
+
+    record->num_correlations = 0;
+    if (correlations)
+    {
+        record->num_correlations = (num_correlations < history->correlation_capacity)?
+                num_correlations : history->correlation_capacity;
+        memcpy(record->correlations, correlations, record->num_correlations * sizeof(correlation_t));
+    }
+
+    record->valid = true;
+    history->next = (history->next + 1) % PING_HISTORY_DEPTH;
+    history->stored++;
+
+    return success;
+}
+
+/**
+ * Waits for the windows being copied into the history, so that the buffers
+ * they are copied from may be overwritten and the records may be sent.
+ *
+ * @note A record whose copy failed is dropped from the history.
+ *
+ * @param history The ping history.
+ *
+ * @return Success or fail.
+ */
+result_t finish_ping_history_copies(ping_history_t *history)
+{
+    AbortIfNot(history, fail);
+
+    for (size_t i = 0; i < PING_HISTORY_DEPTH; ++i)
+    {
+        ping_record_t *record = &history->records[i];
+        if (!finish_copy(&record->copy))
+        {
+            init_copy_job(&record->copy);
+            record->valid = false;
+        }
+    }
+
+    return success;
+}
+
+/**
+ * Finds a ping in the history.
+ *
+ * @param history The ping history.
+ * @param sequence The sequence number of the ping.
+ *
+ * @return The record of the ping, or NULL if it is not held.
+ */
+const ping_record_t *find_ping_history(const ping_history_t *history, const uint32_t sequence)
+{
+    AbortIfNot(history, NULL);
+
+    for (size_t i = 0; i < PING_HISTORY_DEPTH; ++i)
+    {
+        const ping_record_t *record = &history->records[i];
+        if (record->valid && record->sequence == sequence)
+        {
+            return record;
+        }
+    }
+
+    return NULL;
+}
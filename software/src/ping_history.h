@@ -0,0 +1,85 @@
+#ifndef PING_HISTORY_H
+#define PING_HISTORY_H
+
+#include "copy_engine.h"
+#include "system_params.h"
+#include "types.h"
+
+/**
+ * Defines a located ping kept on board, with the start of its window and its
+ * correlations.
+ */
+typedef struct ping_record_t
+{
+    uint32_t sequence;
+    tick_t ping_tick;
+    trigger_mark_t trigger;
+    bearing_estimate_t track;
+    correlation_result_t result;
+
+    /*
+     * The samples and correlations, which point into the storage of the
+     * history and are truncated to its capacity.
+     */
+    sample_t *samples;
+    size_t num_samples;
+    correlation_t *correlations;
+    size_t num_correlations;
+
+    /*
+     * The copy of the window, which may still be in progress.
+     */
+    copy_job_t copy;
+
+    bool valid;
+} ping_record_t;
+
+/**
+ * Defines a ring of the most recent located pings, which may be fetched by
+ * sequence number when the results of a ping need investigating.
+ */
+typedef struct ping_history_t
+{
+    ping_record_t records[PING_HISTORY_DEPTH];
+    size_t next;
+
+    /*
+     * The largest window and number of correlations that a record holds.
+     */
+    size_t window_capacity;
+    size_t correlation_capacity;
+
+    /*
+     * The engine that windows are copied in with, or NULL to copy them with
+     * the processor, and the cache maintenance that they need.
+     */
+    copy_engine_t *copy_engine;
+    uint32_t copy_flags;
+
+    uint32_t stored;
+} ping_history_t;
+
+result_t init_ping_history(ping_history_t *history,
+                           sample_t *sample_storage,
+                           const size_t window_capacity,
+                           correlation_t *correlation_storage,
+                           const size_t correlation_capacity,
+                           copy_engine_t *copy_engine,
+                           const uint32_t copy_flags);
+
+result_t push_ping_history(ping_history_t *history,
+                           const uint32_t sequence,
+                           const tick_t ping_tick,
+                           const trigger_mark_t *trigger,
+                           const bearing_estimate_t *track,
+                           const correlation_result_t *result,
+                           const sample_t *samples,
+                           const size_t num_samples,
+                           const correlation_t *correlations,
+                           const size_t num_correlations);
+
+result_t finish_ping_history_copies(ping_history_t *history);
+
+const ping_record_t *find_ping_history(const ping_history_t *history, const uint32_t sequence);
+
+#endif
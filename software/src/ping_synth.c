@@ -0,0 +1,230 @@
+#include "ping_synth.h"
+
+#include "abort.h"
+#include "sample_clock.h"
+#include "system_params.h"
+#include "time_util.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#define PI 3.14159265358979323846
+
+/**
+ * Draws the next value of the noise of a synthetic pinger.
+ *
+ * @param synth The synthetic pinger.
+ *
+ * @return A value between -1 and 1.
+ */
+static float next_noise(ping_synth_t *synth)
+{
+    synth->noise_state = synth->noise_state * 1664525 + 1013904223;
+    return (float)synth->noise_state / UINT32_MAX * 2 - 1;
+}
+
+/**
+ * Moves a synthetic pinger on to its next ping.
+ *
+ * @param synth The synthetic pinger.
+ *
+ * @return None.
+ */
+static void advance_synthetic_ping(ping_synth_t *synth)
+{
+    const ping_synth_config_t *config = &synth->config;
+    const tick_t period = ms_to_ticks(config->period_ms);
+    int64_t next = (int64_t)period + (int64_t)period * config->drift_ppm / 1000000;
+    if (config->jitter_us)
+    {
+        next += (int64_t)(next_noise(synth) * micros_to_ticks(config->jitter_us));
+    }
+
+    synth->next_ping += (next > 0)? (tick_t)next : 1;
+}
+
+/**
+ * Finds the value of a ping at a sample.
+ *
+ * @param start The sample at which the ping starts.
+ * @param i The sample.
+ * @param ping_len The length of the ping in samples.
+ * @param w The frequency of the ping in radians per sample.
+ *
+ * @return The value of a ping of unit amplitude, or zero outside of it.
+ */
+static float ping_value(const double start, const size_t i, const double ping_len, const float w)
+{
+    const double t = (double)i - start;
+    return (t >= 0 && t < ping_len)? sinf(w * (float)t) : 0;
+}
+
+/**
+ * Initializes a synthetic pinger whose first ping arrives one period from
+ * now, and clears the totals of its soak run.
+ *
+ * @param[out] synth The synthetic pinger to initialize.
+ * @param config The pinger to synthesize.
+ * @param now The current system time.
+ *
+ * @return Success or fail.
+ */
+result_t init_ping_synth(ping_synth_t *synth, const ping_synth_config_t *config, const tick_t now)
+{
+    AbortIfNot(synth, fail);
+    AbortIfNot(config, fail);
+    AbortIfNot(config->period_ms, fail);
+
+    memset(synth, 0, sizeof(*synth));
+    synth->config = *config;
+    synth->noise_state = 1;
+    synth->start_tick = now;
+    synth->next_ping = now;
+    advance_synthetic_ping(synth);
+
+    return success;
+}
+
+/**
+ * Generates the samples a capture window would have recorded from the
+ * synthetic pinger, and moves the pinger on past the window.
+ *
+ * @note Pings that ended before the window opened are counted as skipped.
+ *
+ * @param synth The synthetic pinger.
+ * @param[out] data The samples of the window.
+ * @param len The number of samples of the window.
+ * @param start_tick The time of the first sample of the window.
+ * @param sampling_frequency The sampling frequency of the window.
+ * @param ping_frequency The frequency of the ping.
+ * @param[out] contains Set true if a ping falls within the window.
+ * @param[out] ping_tick The arrival time of the ping within the window.
+ *
+ * @return Success or fail.
+ */
+result_t synthesize_ping_window(ping_synth_t *synth,
+                                sample_t *data,
+                                const size_t len,
+                                const tick_t start_tick,
+                                const uint32_t sampling_frequency,
+                                const uint32_t ping_frequency,
+                                bool *contains,
+                                tick_t *ping_tick)
+{
+    AbortIfNot(synth, fail);
+    AbortIfNot(data, fail);
+    AbortIfNot(sampling_frequency, fail);
+    AbortIfNot(contains, fail);
+    AbortIfNot(ping_tick, fail);
+
+    const ping_synth_config_t *config = &synth->config;
+    const tick_t ping_ticks = micros_to_ticks(SYNTH_PING_LENGTH_US);
+    while (synth->next_ping + ping_ticks <= start_tick)
+    {
+        synth->pings++;
+        synth->skipped++;
+        advance_synthetic_ping(synth);
+    }
+
+    const tick_t end_tick = start_tick + samples_to_ticks(len, sampling_frequency);
+    *contains = (synth->next_ping < end_tick)? true : false;
+    *ping_tick = synth->next_ping;
+
+    /*
+     * The start of the ping and of its echo on each channel, in samples of
+     * the window. A channel the correlation reports a negative delay for
+     * lags channel A.
+     */
+    const double ping_len = (double)sampling_frequency * SYNTH_PING_LENGTH_US / 1000000;
+    const float w = 2 * PI * (float)ping_frequency / sampling_frequency;
+    const double onset = (double)((int64_t)(synth->next_ping - start_tick)) *
+            sampling_frequency / CPU_CLOCK_HZ;
+    const double echo = (double)config->echo_delay_us * sampling_frequency / 1000000;
+    const float echo_amplitude = (float)config->amplitude * config->echo_percent / 100;
+    double starts[4];
+    for (size_t k = 0; k < 4; ++k)
+    {
+        starts[k] = onset - ((k)? (double)config->delays_ns[k - 1] * sampling_frequency / 1e9 : 0);
+    }
+
+    for (size_t i = 0; i < len; ++i)
+    {
+        for (size_t k = 0; k < 4; ++k)
+        {
+            float value = config->noise_amplitude * next_noise(synth);
+            if (*contains)
+            {
+                value += config->amplitude * ping_value(starts[k], i, ping_len, w) +
+                         echo_amplitude * ping_value(starts[k] + echo, i, ping_len, w);
+            }
+
+            value = (value > INT16_MAX)? INT16_MAX : (value < INT16_MIN)? INT16_MIN : value;
+            data[i].sample[k] = (analog_sample_t)value;
+        }
+    }
+
+    if (*contains)
+    {
+        synth->pings++;
+        advance_synthetic_ping(synth);
+    }
+
+    return success;
+}
+
+/**
+ * Adds the outcome of processing a synthetic ping to the totals of the soak
+ * run.
+ *
+ * @param synth The synthetic pinger.
+ * @param processed Specified true if the window was processed.
+ * @param located Specified true if the ping was located.
+ * @param delays_ns The delays located, which are compared with the delays
+ *        synthesized.
+ * @param latency The time from the close of the window to its outcome.
+ *
+ * @return Success or fail.
+ */
+result_t score_synthetic_ping(ping_synth_t *synth,
+                              const bool processed,
+                              const bool located,
+                              const int32_t delays_ns[3],
+                              const tick_t latency)
+{
+    AbortIfNot(synth, fail);
+    AbortIfNot(delays_ns || !located, fail);
+
+    const uint32_t latency_us = (uint32_t)ticks_to_micros(latency);
+    synth->latency_total_us += latency_us;
+    if (latency_us > synth->latency_max_us)
+    {
+        synth->latency_max_us = latency_us;
+    }
+
+    if (!processed)
+    {
+        synth->failed++;
+        return success;
+    }
+
+    if (!located)
+    {
+        synth->missed++;
+        return success;
+    }
+
+    synth->located++;
+    for (size_t k = 0; k < 3; ++k)
+    {
+        const int64_t error = (int64_t)delays_ns[k] - synth->config.delays_ns[k];
+        const uint32_t magnitude = (uint32_t)((error < 0)? -error : error);
+        synth->delay_error_total_ns += magnitude;
+        if (magnitude > synth->delay_error_max_ns)
+        {
+            synth->delay_error_max_ns = magnitude;
+        }
+    }
+
+    return success;
+}
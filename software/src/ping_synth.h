@@ -0,0 +1,97 @@
+#ifndef PING_SYNTH_H
+#define PING_SYNTH_H
+
+#include "types.h"
+
+/**
+ * Defines the pinger that synthetic pings are generated from.
+ */
+typedef struct ping_synth_config_t
+{
+    /*
+     * The nominal ping period, the drift of the pinger clock from it in parts
+     * per million, and the spread of each period about the drifted period.
+     */
+    uint32_t period_ms;
+    int32_t drift_ppm;
+    uint32_t jitter_us;
+
+    /*
+     * The delays of channels B to D from channel A as the correlation
+     * reports them, in nanoseconds.
+     */
+    int32_t delays_ns[3];
+
+    /*
+     * The peak amplitude of the ping and of the noise of each channel, in
+     * ADC codes.
+     */
+    int32_t amplitude;
+    int32_t noise_amplitude;
+
+    /*
+     * The delay of a single echo of each ping behind it, and its amplitude as
+     * a percentage of the ping. An echo of zero percent is not generated.
+     */
+    uint32_t echo_delay_us;
+    uint32_t echo_percent;
+} ping_synth_config_t;
+
+/**
+ * Defines a generator of synthetic pings that stand in for the ADC, and the
+ * totals of a soak run against it.
+ *
+ * @note Pings are generated on the system clock, so a capture window
+ *       receives the pings that fell within it as if it had been recorded.
+ */
+typedef struct ping_synth_t
+{
+    ping_synth_config_t config;
+    uint32_t noise_state;
+
+    /*
+     * The arrival time of the next ping.
+     */
+    tick_t next_ping;
+
+    /*
+     * The pings generated, the pings that fell between capture windows, and
+     * of those captured, the pings located, not located, and that failed to
+     * be processed.
+     */
+    uint32_t pings;
+    uint32_t skipped;
+    uint32_t located;
+    uint32_t missed;
+    uint32_t failed;
+
+    /*
+     * The totals and maxima of the time from the close of each window to
+     * its outcome, and of the error of each located delay.
+     */
+    uint64_t latency_total_us;
+    uint32_t latency_max_us;
+    uint64_t delay_error_total_ns;
+    uint32_t delay_error_max_ns;
+
+    tick_t start_tick;
+} ping_synth_t;
+
+result_t init_ping_synth(ping_synth_t *synth, const ping_synth_config_t *config, const tick_t now);
+
+result_t synthesize_ping_window(ping_synth_t *synth,
+                                sample_t *data,
+                                const size_t len,
+                                const tick_t start_tick,
+                                const uint32_t sampling_frequency,
+                                const uint32_t ping_frequency,
+                                bool *contains,
+                                tick_t *ping_tick);
+
+result_t score_synthetic_ping(ping_synth_t *synth,
+                              const bool processed,
+                              const bool located,
+                              const int32_t delays_ns[3],
+                              const tick_t latency);
+
+#endif
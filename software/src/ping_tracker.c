@@ -0,0 +1,313 @@
+#include "ping_tracker.h"
+
+#include "abort.h"
+#include "system_params.h"
+#include "time_util.h"
+#include "types.h"
+
+#include <math.h>
+
+/**
+ * The number of pings required before the period estimate is trusted.
+ */
+#define PING_TRACKER_LOCK_COUNT 3
+
+/**
+ * The number of consecutive rejected pings after which a locked tracker
+ * assumes that the pinger has moved and starts over.
+ */
+#define PING_TRACKER_MAX_OUTLIERS 2
+
+/**
+ * Initializes a ping tracker.
+ *
+ * @param[out] tracker The tracker to initialize.
+ * @param nominal_period The expected period of the pinger.
+ *
+ * @return Success or fail.
+ */
+result_t init_ping_tracker(ping_tracker_t *tracker, const tick_t nominal_period)
+{
+    AbortIfNot(tracker, fail);
+    AbortIfNot(nominal_period, fail);
+
+    tracker->nominal_period = nominal_period;
+    AbortIfNot(reset_ping_tracker(tracker), fail);
+
+    return success;
+}
+
+/**
+ * Discards the ping history of a tracker.
+ *
+ * @param tracker The tracker to reset.
+ *
+ * @return Success or fail.
+ */
+result_t reset_ping_tracker(ping_tracker_t *tracker)
+{
+    AbortIfNot(tracker, fail);
+
+    tracker->count = 0;
+    tracker->period = tracker->nominal_period;
+    tracker->phase = 0;
+    tracker->mean_index = 0;
+    tracker->index_spread = 0;
+    tracker->residual = 0;
+    tracker->locked = false;
+    tracker->outliers = 0;
+
+    return success;
+}
+
+/**
+ * Fits the period and phase to the ping history by least squares.
+ *
+ * @param tracker The tracker to fit.
+ *
+ * @return None.
+ */
+static void fit_ping_tracker(ping_tracker_t *tracker)
+{
+    const tick_t reference = tracker->ticks[tracker->count - 1];
+    const double period = tracker->period;
+
+    /*
+     * Number each ping relative to the most recent so that missed pings
+     * leave gaps rather than corrupting the period.
+     */
+    double index[PING_TRACKER_HISTORY];
+    double offset[PING_TRACKER_HISTORY];
+    double mean_index = 0, mean_offset = 0;
+    for (size_t i = 0; i < tracker->count; ++i)
+    {
+        offset[i] = -1 * (double)(reference - tracker->ticks[i]);
+        index[i] = round(offset[i] / period);
+        mean_index += index[i];
+        mean_offset += offset[i];
+    }
+
+    mean_index /= tracker->count;
+    mean_offset /= tracker->count;
+
+    double sxx = 0, sxy = 0;
+    for (size_t i = 0; i < tracker->count; ++i)
+    {
+        sxx += (index[i] - mean_index) * (index[i] - mean_index);
+        sxy += (index[i] - mean_index) * (offset[i] - mean_offset);
+    }
+
+    if (sxx == 0)
+    {
+        tracker->phase = reference;
+        tracker->mean_index = 0;
+        tracker->index_spread = 0;
+        tracker->residual = 0;
+        return;
+    }
+
+    const double slope = sxy / sxx;
+    const double intercept = mean_offset - slope * mean_index;
+
+    double sse = 0;
+    for (size_t i = 0; i < tracker->count; ++i)
+    {
+        const double error = offset[i] - (intercept + slope * index[i]);
+        sse += error * error;
+    }
+
+    tracker->period = slope;
+    tracker->phase = reference + intercept;
+    tracker->mean_index = mean_index;
+    tracker->index_spread = sxx;
+    tracker->residual = (tracker->count > 2)? sqrt(sse / (tracker->count - 2)) : 0;
+}
+
+/**
+ * Adds a received ping to a tracker and refits the period and phase.
+ *
+ * @note A ping that disagrees with a locked estimate by more than the outlier
+ *       limit is rejected. Repeated disagreement restarts the history.
+ *
+ * @param tracker The tracker to update.
+ * @param ping_tick The system time at which the ping was received.
+ *
+ * @return Success or fail.
+ */
+result_t update_ping_tracker(ping_tracker_t *tracker, const tick_t ping_tick)
+{
+    AbortIfNot(tracker, fail);
+
+    if (tracker->count > 0)
+    {
+        const double elapsed = (double)ping_tick - tracker->phase;
+        const double pings = round(elapsed / tracker->period);
+
+        /*
+         * Ignore pings that are not later than the most recent one.
+         */
+        if (pings < 1)
+        {
+            return success;
+        }
+
+        const double error = fabs(elapsed - pings * tracker->period);
+        if (tracker->locked && error > ms_to_ticks(PING_TRACKER_OUTLIER_MS))
+        {
+            if (++tracker->outliers < PING_TRACKER_MAX_OUTLIERS)
+            {
+                return success;
+            }
+
+            AbortIfNot(reset_ping_tracker(tracker), fail);
+        }
+
+        tracker->outliers = 0;
+    }
+
+    if (tracker->count == PING_TRACKER_HISTORY)
+    {
+        for (size_t i = 1; i < PING_TRACKER_HISTORY; ++i)
+        {
+            tracker->ticks[i - 1] = tracker->ticks[i];
+        }
+
+        tracker->count--;
+    }
+
+    tracker->ticks[tracker->count++] = ping_tick;
+    fit_ping_tracker(tracker);
+
+    /*
+     * Pinger clocks drift by far less than a percent, so a period outside of
+     * that range indicates that a false detection entered the fit.
+     */
+    const double drift = fabs(tracker->period - tracker->nominal_period);
+    if (drift > tracker->nominal_period / 100.0)
+    {
+        AbortIfNot(reset_ping_tracker(tracker), fail);
+        tracker->ticks[tracker->count++] = ping_tick;
+        fit_ping_tracker(tracker);
+    }
+
+    tracker->locked = (tracker->count >= PING_TRACKER_LOCK_COUNT)? true : false;
+
+    return success;
+}
+
+/**
+ * Predicts the arrival of the first ping at or after a given time.
+ *
+ * @param tracker The tracker to predict from.
+ * @param after The earliest time of interest.
+ * @param[out] ping_tick The predicted arrival time of the ping.
+ * @param[out] uncertainty The standard error of the prediction. This is zero
+ *             if the tracker is not locked and the error is unknown.
+ *
+ * @return Success or fail.
+ */
+result_t predict_next_ping(const ping_tracker_t *tracker,
+                           const tick_t after,
+                           tick_t *ping_tick,
+                           tick_t *uncertainty)
+{
+    AbortIfNot(tracker, fail);
+    AbortIfNot(ping_tick, fail);
+    AbortIfNot(uncertainty, fail);
+    AbortIfNot(tracker->count > 0, fail);
+
+    double pings = ceil(((double)after - tracker->phase) / tracker->period);
+    if (pings < 0)
+    {
+        pings = 0;
+    }
+
+    *ping_tick = tracker->phase + pings * tracker->period;
+
+    *uncertainty = 0;
+    if (tracker->locked && tracker->index_spread > 0)
+    {
+        const double distance = pings - tracker->mean_index;
+        *uncertainty = tracker->residual *
+                sqrt(1 + 1.0 / tracker->count + distance * distance / tracker->index_spread);
+    }
+
+    return success;
+}
+
+/**
+ * Plans the capture of the next ping that can still be recorded.
+ *
+ * @note Until the tracker is locked the widest window is used. Once locked,
+ *       the window spans four standard errors of the prediction on each side.
+ *       Each miss doubles the margin, and after CAPTURE_MAX_MISSES misses the
+ *       window spans the re-acquisition margin around the predicted phase,
+ *       which is only as old as the last ping received.
+ *
+ * @param tracker The tracker to predict from.
+ * @param after The earliest time at which the capture may begin.
+ * @param misses The number of consecutive pings that were not found.
+ * @param[out] window The planned capture window.
+ *
+ * @return Success or fail.
+ */
+result_t plan_ping_window(const ping_tracker_t *tracker,
+                          const tick_t after,
+                          const uint32_t misses,
+                          ping_window_t *window)
+{
+    AbortIfNot(tracker, fail);
+    AbortIfNot(window, fail);
+
+    const tick_t min_margin = micros_to_ticks(CAPTURE_MARGIN_MIN_US);
+    const tick_t max_margin = micros_to_ticks(CAPTURE_MARGIN_MAX_US);
+    const tick_t max_duration = micros_to_ticks(CAPTURE_DURATION_MAX_US);
+    const bool reacquire = (misses > CAPTURE_MAX_MISSES)? true : false;
+    const tick_t limit = (reacquire)? micros_to_ticks(CAPTURE_REACQUIRE_MARGIN_US) : max_margin;
+
+    /*
+     * The margin depends on which ping is chosen, so a ping that is too close
+     * for its margin is skipped in favor of the one after it.
+     */
+    tick_t margin = min_margin;
+    tick_t earliest = after + min_margin;
+    for (size_t attempt = 0; attempt < 2; ++attempt)
+    {
+        tick_t uncertainty;
+        AbortIfNot(predict_next_ping(tracker, earliest, &window->ping_tick, &uncertainty), fail);
+
+        margin = (reacquire)? limit : (tracker->locked)? min_margin + 4 * uncertainty : max_margin;
+        for (uint32_t i = 0; i < misses && margin < limit; ++i)
+        {
+            margin *= 2;
+        }
+
+        if (margin > limit)
+        {
+            margin = limit;
+        }
+
+        if (window->ping_tick >= after + margin)
+        {
+            break;
+        }
+
+        earliest = after + margin;
+    }
+
+    window->start_tick = window->ping_tick - margin;
+    window->duration = (tracker->locked || reacquire)?
+            2 * margin + micros_to_ticks(CAPTURE_PING_LENGTH_US) : max_duration;
+    if (window->duration > max_duration)
+    {
+        window->duration = max_duration;
+    }
+
+    window->silence_duration = window->duration;
+    if (window->silence_duration > micros_to_ticks(THRUSTER_SILENCE_MAX_US))
+    {
+        window->silence_duration = micros_to_ticks(THRUSTER_SILENCE_MAX_US);
+    }
+
+    return success;
+}
@@ -0,0 +1,79 @@
+#ifndef PING_TRACKER_H
+#define PING_TRACKER_H
+
+#include "types.h"
+
+/**
+ * The number of recent pings used to estimate the ping period and phase.
+ */
+#define PING_TRACKER_HISTORY 8
+
+/**
+ * Defines an estimator of the period and phase of a pinger from the times at
+ * which its pings were received.
+ */
+typedef struct ping_tracker_t
+{
+    /*
+     * The arrival times of recent pings, oldest first.
+     */
+    tick_t ticks[PING_TRACKER_HISTORY];
+    size_t count;
+
+    /*
+     * The period assumed until enough pings have been received to estimate
+     * one, and the current estimate.
+     */
+    tick_t nominal_period;
+    double period;
+
+    /*
+     * The fitted arrival time of the most recent ping, and the mean and spread
+     * of the ping numbers in the fit relative to the most recent ping.
+     */
+    double phase;
+    double mean_index;
+    double index_spread;
+
+    /*
+     * The root-mean-square error of the fit in ticks, and whether enough
+     * pings have been received for it to be meaningful.
+     */
+    double residual;
+    bool locked;
+
+    /*
+     * The number of consecutive pings rejected by a locked tracker.
+     */
+    size_t outliers;
+} ping_tracker_t;
+
+/**
+ * Defines when a ping capture should be taken and for how long thrusters
+ * should be silenced around it.
+ */
+typedef struct ping_window_t
+{
+    tick_t ping_tick;
+    tick_t start_tick;
+    tick_t duration;
+    tick_t silence_duration;
+} ping_window_t;
+
+result_t init_ping_tracker(ping_tracker_t *tracker, const tick_t nominal_period);
+
+result_t reset_ping_tracker(ping_tracker_t *tracker);
+
+result_t update_ping_tracker(ping_tracker_t *tracker, const tick_t ping_tick);
+
+result_t predict_next_ping(const ping_tracker_t *tracker,
+                           const tick_t after,
+                           tick_t *ping_tick,
+                           tick_t *uncertainty);
+
+result_t plan_ping_window(const ping_tracker_t *tracker,
+                          const tick_t after,
+                          const uint32_t misses,
+                          ping_window_t *window);
+
+#endif
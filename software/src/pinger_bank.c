@@ -0,0 +1,250 @@
+#include "pinger_bank.h"
+
+#include "abort.h"
+#include "correlation_util.h"
+#include "db.h"
+#include "sample_clock.h"
+#include "sample_util.h"
+#include "system_params.h"
+#include "types.h"
+
+#include <math.h>
+#include <string.h>
+
+#define PI 3.14159265358979323846
+
+/**
+ * The number of samples the bank processes at a time. Each block is read from
+ * the capture once and stays in the L1 cache while every pinger filters it.
+ */
+#define PINGER_BANK_BLOCK 256
+
+/**
+ * Scratch storage for the block being filtered by a single pinger.
+ */
+static sample_t pinger_scratch[PINGER_BANK_BLOCK];
+
+/**
+ * Designs a bandpass biquad section with unity gain at the center frequency.
+ *
+ * @param[out] coeffs The section coefficients.
+ * @param frequency The center frequency of the pass band.
+ * @param sampling_frequency The sampling frequency of the data.
+ *
+ * @return Success or fail.
+ */
+static result_t design_bandpass(filter_coefficients_t *coeffs,
+                                const uint32_t frequency,
+                                const uint32_t sampling_frequency)
+{
+    AbortIfNot(coeffs, fail);
+    AbortIfNot(frequency > 0, fail);
+    AbortIfNot(frequency < sampling_frequency / 2, fail);
+
+    const double w = 2 * PI * frequency / sampling_frequency;
+    const double q = (double)frequency / PINGER_BANDWIDTH_HZ;
+    const double alpha = sin(w) / (2 * q);
+
+    coeffs->coefficients[0] = alpha;
+    coeffs->coefficients[1] = 0;
+    coeffs->coefficients[2] = -1 * alpha;
+    coeffs->coefficients[3] = 1 + alpha;
+    coeffs->coefficients[4] = -2 * cos(w);
+    coeffs->coefficients[5] = 1 - alpha;
+
+    return success;
+}
+
+/**
+ * Configures the pingers of a bank.
+ *
+ * @param[out] bank The bank to initialize.
+ * @param frequencies The frequency of each pinger in Hz.
+ * @param num_pingers The number of pingers.
+ * @param sampling_frequency The sampling frequency of acquisition.
+ *
+ * @return Success or fail.
+ */
+result_t init_pinger_bank(pinger_bank_t *bank,
+                          const uint32_t *frequencies,
+                          const size_t num_pingers,
+                          const uint32_t sampling_frequency)
+{
+    AbortIfNot(bank, fail);
+    AbortIfNot(frequencies || num_pingers == 0, fail);
+    AbortIfNot(num_pingers <= MAX_PINGERS, fail);
+    AbortIfNot(sampling_frequency, fail);
+
+    bank->num_pingers = num_pingers;
+    bank->sampling_frequency = sampling_frequency;
+    for (size_t p = 0; p < num_pingers; ++p)
+    {
+        pinger_channel_t *pinger = &bank->pingers[p];
+        pinger->frequency = frequencies[p];
+        for (size_t s = 0; s < PINGER_BANDPASS_SECTIONS; ++s)
+        {
+            AbortIfNot(design_bandpass(&pinger->bandpass_coefficients[s],
+                                       frequencies[p],
+                                       sampling_frequency), fail);
+        }
+
+        pinger->found = false;
+        pinger->window_len = 0;
+        pinger->previous_ping_tick = 0;
+        pinger->previous_ping_sample = 0;
+    }
+
+    return success;
+}
+
+/**
+ * Copies filtered samples from a pinger's history into its ping window.
+ *
+ * @param pinger The pinger to update.
+ * @param available The number of samples of the capture that have been filtered.
+ *
+ * @return None.
+ */
+static void fill_window(pinger_channel_t *pinger, const size_t available)
+{
+    while (pinger->window_len < pinger->window_target &&
+           pinger->start_index + pinger->window_len < available)
+    {
+        const size_t i = pinger->start_index + pinger->window_len;
+        pinger->window[pinger->window_len++] = pinger->history[i % PINGER_HISTORY_SAMPLES];
+    }
+}
+
+/**
+ * Separates each pinger from a capture, detects its ping, and extracts the
+ * window around the ping for correlation.
+ *
+ * @note The capture is traversed once. Each block is filtered by every pinger
+ *       while it is resident in the cache.
+ *
+ * @param bank The bank of pingers to search for.
+ * @param data The normalized capture.
+ * @param len The number of samples in the capture.
+ * @param params The current operating parameters.
+ * @param timing The hardware timestamps of the capture, or NULL.
+ *
+ * @return Success or fail.
+ */
+result_t run_pinger_bank(pinger_bank_t *bank,
+                         const sample_t *data,
+                         const size_t len,
+                         const HydroZynqParams params,
+                         sample_timing_t *timing)
+{
+    AbortIfNot(bank, fail);
+    AbortIfNot(data, fail);
+
+    const uint32_t sampling_frequency = bank->sampling_frequency;
+    const size_t pre_samples = ticks_to_samples(params.pre_ping_duration, sampling_frequency);
+    const size_t post_samples = ticks_to_samples(params.post_ping_duration, sampling_frequency);
+    AbortIfNot(pre_samples + PINGER_BANK_BLOCK <= PINGER_HISTORY_SAMPLES, fail);
+    AbortIfNot(pre_samples + post_samples <= PINGER_MAX_WINDOW, fail);
+
+    for (size_t p = 0; p < bank->num_pingers; ++p)
+    {
+        pinger_channel_t *pinger = &bank->pingers[p];
+        AbortIfNot(init_biquad_cascade(&pinger->bandpass,
+                                       pinger->bandpass_coefficients,
+                                       PINGER_BANDPASS_SECTIONS), fail);
+        AbortIfNot(init_tone_detector(&pinger->tone,
+                                      pinger->frequency,
+                                      sampling_frequency), fail);
+        pinger->max_amplitude = 0;
+        pinger->found = false;
+        pinger->window_len = 0;
+        pinger->window_target = 0;
+    }
+
+    size_t remaining = bank->num_pingers;
+    for (size_t block = 0; block < len && remaining > 0; block += PINGER_BANK_BLOCK)
+    {
+        const size_t block_len = (len - block < PINGER_BANK_BLOCK)?
+                len - block : PINGER_BANK_BLOCK;
+
+        for (size_t p = 0; p < bank->num_pingers; ++p)
+        {
+            pinger_channel_t *pinger = &bank->pingers[p];
+            if (pinger->found && pinger->window_len == pinger->window_target)
+            {
+                continue;
+            }
+
+            memcpy(pinger_scratch, &data[block], block_len * sizeof(sample_t));
+            AbortIfNot(run_biquad_cascade(&pinger->bandpass, pinger_scratch, block_len), fail);
+
+            for (size_t i = 0; i < block_len; ++i)
+            {
+                pinger->history[(block + i) % PINGER_HISTORY_SAMPLES] = pinger_scratch[i];
+            }
+
+            if (!pinger->found)
+            {
+                bool found = false;
+                size_t index = 0;
+                AbortIfNot(detect_tone(&pinger->tone,
+                                       pinger_scratch,
+                                       block_len,
+                                       params.ping_threshold,
+                                       &found,
+                                       &index,
+                                       &pinger->max_amplitude), fail);
+                if (found)
+                {
+                    pinger->found = true;
+                    pinger->found_index = block + index;
+                    pinger->start_index = (pinger->found_index > pre_samples)?
+                            pinger->found_index - pre_samples : 0;
+
+                    size_t end_index = pinger->found_index + post_samples;
+                    if (end_index >= len)
+                    {
+                        end_index = len - 1;
+                    }
+
+                    pinger->window_target = end_index - pinger->start_index;
+                }
+            }
+
+            if (pinger->found)
+            {
+                fill_window(pinger, block + block_len);
+                if (pinger->window_len == pinger->window_target)
+                {
+                    remaining--;
+                }
+            }
+        }
+    }
+
+    /*
+     * Track the phase of each pinger that was heard.
+     */
+    for (size_t p = 0; p < bank->num_pingers; ++p)
+    {
+        pinger_channel_t *pinger = &bank->pingers[p];
+        if (!pinger->found || !timing)
+        {
+            pinger->previous_ping_sample = 0;
+            continue;
+        }
+
+        const uint64_t ping_sample = get_sample_index(timing, pinger->found_index);
+        pinger->previous_ping_tick = sample_index_to_tick(timing, ping_sample, sampling_frequency);
+        if (pinger->previous_ping_sample)
+        {
+            dbprintf("Pinger %u Hz period: %d us\n",
+                    pinger->frequency,
+                    (uint32_t)((ping_sample - pinger->previous_ping_sample) *
+                               1000000 / sampling_frequency));
+        }
+
+        pinger->previous_ping_sample = ping_sample;
+    }
+
+    return success;
+}
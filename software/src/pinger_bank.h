@@ -0,0 +1,87 @@
+#ifndef PINGER_BANK_H
+#define PINGER_BANK_H
+
+#include "correlation_util.h"
+#include "sample_util.h"
+#include "types.h"
+
+/**
+ * The number of bandpass sections used to isolate each pinger.
+ */
+#define PINGER_BANDPASS_SECTIONS 2
+
+/**
+ * The number of filtered samples retained before a ping is detected. This must
+ * cover the pre-ping duration.
+ */
+#define PINGER_HISTORY_SAMPLES 2048
+
+/**
+ * The largest ping window that can be extracted for a single pinger.
+ */
+#define PINGER_MAX_WINDOW 4096
+
+/**
+ * Defines the detection and correlation state of a single pinger frequency.
+ */
+typedef struct pinger_channel_t
+{
+    uint32_t frequency;
+    filter_coefficients_t bandpass_coefficients[PINGER_BANDPASS_SECTIONS];
+
+    /*
+     * Per-capture filter and detector state.
+     */
+    biquad_cascade_t bandpass;
+    tone_detector_t tone;
+    analog_sample_t max_amplitude;
+
+    /*
+     * The most recent filtered samples indexed by their position in the
+     * capture, and the window extracted around the ping.
+     */
+    sample_t history[PINGER_HISTORY_SAMPLES];
+    sample_t window[PINGER_MAX_WINDOW];
+    size_t window_len;
+    size_t window_target;
+
+    /*
+     * The position of the threshold crossing and of the start of the window
+     * within the capture.
+     */
+    bool found;
+    size_t found_index;
+    size_t start_index;
+
+    /*
+     * The ping phase, which persists between captures.
+     */
+    tick_t previous_ping_tick;
+    uint64_t previous_ping_sample;
+
+    correlation_result_t result;
+} pinger_channel_t;
+
+/**
+ * Defines a bank of pingers at different frequencies that are demultiplexed
+ * from a single capture.
+ */
+typedef struct pinger_bank_t
+{
+    pinger_channel_t pingers[MAX_PINGERS];
+    size_t num_pingers;
+    uint32_t sampling_frequency;
+} pinger_bank_t;
+
+result_t init_pinger_bank(pinger_bank_t *bank,
+                          const uint32_t *frequencies,
+                          const size_t num_pingers,
+                          const uint32_t sampling_frequency);
+
+result_t run_pinger_bank(pinger_bank_t *bank,
+                         const sample_t *data,
+                         const size_t len,
+                         const HydroZynqParams params,
+                         sample_timing_t *timing);
+
+#endif
@@ -0,0 +1,197 @@
+#include "profile.h"
+
+#include "abort.h"
+#include "cycle_counter.h"
+#include "system_params.h"
+#include "trace.h"
+#include "types.h"
+#include "udp.h"
+
+#include <string.h>
+
+/**
+ * The Cortex-A9 events counted alongside the cycle counter. The A9 does not
+ * count retired instructions, so instructions leaving register renaming are
+ * counted instead. The fixed event sets of xpm_counter.h do not pair these
+ * with L1 data cache refills, so the counters are programmed directly.
+ */
+#define PMU_EVENT_DATA_CACHE_REFILL 0x03
+#define PMU_EVENT_INSTRUCTION_RENAME 0x68
+
+/**
+ * Accumulated counters of each stage. Stages run on either core, but each
+ * stage is only updated by one core at a time.
+ */
+static profile_stats_t profile_stats[PROFILE_STAGES];
+
+/**
+ * Reads an event counter of the calling core.
+ *
+ * @param counter The index of the event counter.
+ *
+ * @return The number of events counted.
+ */
+static inline uint32_t read_event_counter(const uint32_t counter)
+{
+    uint32_t value;
+    __asm volatile("mcr p15, 0, %1, c9, c12, 5\n"
+                   "isb\n"
+                   "mrc p15, 0, %0, c9, c13, 2" : "=r"(value) : "r"(counter));
+
+    return value;
+}
+
+/**
+ * Programs an event counter of the calling core.
+ *
+ * @param counter The index of the event counter.
+ * @param event The event to count.
+ *
+ * @return None.
+ */
+static inline void set_event_counter(const uint32_t counter, const uint32_t event)
+{
+    __asm volatile("mcr p15, 0, %0, c9, c12, 5\n"
+                   "isb\n"
+                   "mcr p15, 0, %1, c9, c13, 1" :: "r"(counter), "r"(event));
+}
+
+/**
+ * Starts the performance counters of the calling core.
+ *
+ * @note Each core has its own counters, so this must be called on every core
+ *       that runs a profiled stage.
+ *
+ * @return None.
+ */
+void init_profiler()
+{
+    set_event_counter(0, PMU_EVENT_DATA_CACHE_REFILL);
+    set_event_counter(1, PMU_EVENT_INSTRUCTION_RENAME);
+
+    /*
+     * Enable and reset all counters with the cycle counter counting every
+     * cycle, then enable the cycle counter and the two event counters.
+     */
+    __asm volatile("mcr p15, 0, %0, c9, c12, 0\n"
+                   "mcr p15, 0, %1, c9, c12, 1\n"
+                   "isb" :: "r"(0x7), "r"((1u << 31) | 0x3));
+}
+
+/**
+ * Marks the start of a stage.
+ *
+ * @param[out] mark The counters at the start of the stage.
+ *
+ * @return None.
+ */
+void profile_begin(profile_mark_t *mark)
+{
+    mark->data_cache_misses = read_event_counter(0);
+    mark->instructions = read_event_counter(1);
+    mark->cycles = read_cycle_counter();
+}
+
+/**
+ * Records a completed stage.
+ *
+ * @note The same core must have called profile_begin().
+ *
+ * @param stage The stage that completed.
+ * @param mark The counters at the start of the stage.
+ *
+ * @return None.
+ */
+void profile_end(const profile_stage_t stage, const profile_mark_t *mark)
+{
+    const uint32_t cycles = read_cycle_counter() - mark->cycles;
+    const uint32_t instructions = read_event_counter(1) - mark->instructions;
+    const uint32_t data_cache_misses = read_event_counter(0) - mark->data_cache_misses;
+
+    if (stage >= PROFILE_STAGES)
+    {
+        return;
+    }
+
+    trace(TRACE_STAGE, TRACE_COMPLETE, stage, cycles);
+
+    profile_stats_t *stats = &profile_stats[stage];
+    stats->count++;
+    stats->cycles += cycles;
+    stats->data_cache_misses += data_cache_misses;
+    stats->instructions += instructions;
+    if (cycles > stats->max_cycles)
+    {
+        stats->max_cycles = cycles;
+    }
+
+    /*
+     * Find the octave of the stage duration.
+     */
+    const int log2 = (cycles)? 31 - __builtin_clz(cycles) : 0;
+    int bin = log2 - PROFILE_HISTOGRAM_MIN_LOG2;
+    if (bin < 0)
+    {
+        bin = 0;
+    }
+    else if (bin >= PROFILE_HISTOGRAM_BINS)
+    {
+        bin = PROFILE_HISTOGRAM_BINS - 1;
+    }
+
+    stats->histogram[bin]++;
+}
+
+/**
+ * Gets the accumulated counters of a stage.
+ *
+ * @param stage The stage to get.
+ * @param[out] stats The counters of the stage.
+ *
+ * @return None.
+ */
+void get_profile_stats(const profile_stage_t stage, profile_stats_t *stats)
+{
+    if (stage >= PROFILE_STAGES)
+    {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+
+    *stats = profile_stats[stage];
+}
+
+/**
+ * Clears the counters of every stage.
+ *
+ * @return None.
+ */
+void reset_profile()
+{
+    memset(profile_stats, 0, sizeof(profile_stats));
+}
+
+/**
+ * Transmits the counters of every stage.
+ *
+ * @note Stages running on the DSP core may update while the report is being
+ *       copied, so a stage may be reported partially updated.
+ *
+ * @param socket The connected socket to send the report over.
+ *
+ * @return Success or fail.
+ */
+result_t send_profile(udp_socket_t *socket)
+{
+    AbortIfNot(socket, fail);
+
+    static profile_report_t report;
+    report.version = PROFILE_REPORT_VERSION;
+    report.num_stages = PROFILE_STAGES;
+    report.cycle_clock_hz = get_cycle_clock_hz();
+    memcpy(report.stages, profile_stats, sizeof(profile_stats));
+
+    AbortIfNot(send_udp(socket, (char *)&report, sizeof(report)), fail);
+
+    return success;
+}
@@ -0,0 +1,82 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "types.h"
+
+struct udp_socket_t;
+
+/**
+ * The processing stages that are profiled.
+ */
+typedef enum profile_stage_t
+{
+    PROFILE_RECORD = 0,
+    PROFILE_NORMALIZE = 1,
+    PROFILE_FILTER = 2,
+    PROFILE_TRUNCATE = 3,
+    PROFILE_CORRELATE = 4,
+    PROFILE_SEND = 5,
+    PROFILE_STAGES = 6
+} profile_stage_t;
+
+/**
+ * The number of bins in the cycle histogram of each stage. Bins are one octave
+ * wide, starting with the bin of stages shorter than
+ * 2^(PROFILE_HISTOGRAM_MIN_LOG2 + 1) cycles. The last bin also holds every
+ * longer stage.
+ */
+#define PROFILE_HISTOGRAM_BINS 16
+#define PROFILE_HISTOGRAM_MIN_LOG2 14
+
+/**
+ * The version of the profile report layout.
+ */
+#define PROFILE_REPORT_VERSION 1
+
+/**
+ * Holds the performance counters of the calling core at the start of a stage.
+ */
+typedef struct profile_mark_t
+{
+    uint32_t cycles;
+    uint32_t data_cache_misses;
+    uint32_t instructions;
+} profile_mark_t;
+
+/**
+ * Defines the accumulated counters of a stage.
+ */
+typedef struct __attribute__((packed)) profile_stats_t
+{
+    uint32_t count;
+    uint32_t max_cycles;
+    uint64_t cycles;
+    uint64_t data_cache_misses;
+    uint64_t instructions;
+    uint32_t histogram[PROFILE_HISTOGRAM_BINS];
+} profile_stats_t;
+
+/**
+ * Defines the report sent over the telemetry port.
+ */
+typedef struct __attribute__((packed)) profile_report_t
+{
+    uint16_t version;
+    uint16_t num_stages;
+    uint32_t cycle_clock_hz;
+    profile_stats_t stages[PROFILE_STAGES];
+} profile_report_t;
+
+void init_profiler();
+
+void profile_begin(profile_mark_t *mark);
+
+void profile_end(const profile_stage_t stage, const profile_mark_t *mark);
+
+void get_profile_stats(const profile_stage_t stage, profile_stats_t *stats);
+
+void reset_profile();
+
+result_t send_profile(struct udp_socket_t *socket);
+
+#endif
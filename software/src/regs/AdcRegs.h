@@ -5,6 +5,224 @@ struct AdcRegs
 {
     uint32_t clk_div;
     uint32_t samples_per_packet;
+    volatile uint32_t trigger_control;
+    volatile uint32_t trigger_window;
+    volatile uint32_t stream_control;
+    uint32_t decimation_control;
+    volatile uint32_t correlator_control;
+    volatile uint32_t correlator_data;
+    volatile uint32_t stream_status;
+    volatile uint32_t dropped_samples;
+    volatile uint32_t total_samples_low;
+    volatile uint32_t total_samples_high;
+    volatile uint32_t sync_control;
+    volatile uint32_t sync_count;
+    volatile uint32_t sync_sample_low;
+    volatile uint32_t sync_sample_high;
+    volatile uint32_t ext_trigger_control;
+    volatile uint32_t ext_trigger_count;
+    volatile uint32_t ext_trigger_sample_low;
+    volatile uint32_t ext_trigger_sample_high;
+    volatile uint32_t ext_output_start_low;
+    volatile uint32_t ext_output_start_high;
+    volatile uint32_t ext_output_end_low;
+    volatile uint32_t ext_output_end_high;
+    volatile uint32_t envelope_control;
+    volatile uint32_t envelope_decimation;
+    volatile uint32_t envelope_status;
+    volatile uint32_t envelope_data_low;
+    volatile uint32_t envelope_data_high;
+    volatile uint32_t envelope_start_low;
+    volatile uint32_t envelope_start_high;
 };
 
+/*
+ * trigger_control bit definitions.
+ */
+#define ADC_TRIGGER_THRESHOLD_MASK 0x3FFF
+#define ADC_TRIGGER_BASELINE_SHIFT 16
+#define ADC_TRIGGER_BASELINE_MASK (0x3FFF << ADC_TRIGGER_BASELINE_SHIFT)
+#define ADC_TRIGGER_ENABLE (1 << 31)
+
+/*
+ * trigger_window bit definitions. The core clamps the pre-trigger samples to
+ * ADC_TRIGGER_MAX_PRE_SAMPLES of adc.h, however wide the field is.
+ */
+#define ADC_TRIGGER_PRE_MASK 0xFFFF
+#define ADC_TRIGGER_POST_SHIFT 16
+#define ADC_TRIGGER_POST_MASK (0xFFFF << ADC_TRIGGER_POST_SHIFT)
+
+/*
+ * stream_control bit definitions.
+ */
+#define ADC_STREAM_TIMESTAMPS (1 << 0)
+#define ADC_STREAM_PACKED (1 << 1)
+#define ADC_STREAM_PLANAR (1 << 2)
+#define ADC_STREAM_STATS (1 << 3)
+#define ADC_STREAM_CHANNEL_SHIFT 4
+#define ADC_STREAM_CHANNEL_MASK (0xF << ADC_STREAM_CHANNEL_SHIFT)
+
+/*
+ * Packed samples keep the upper 12 bits of each channel in 6 bytes. They
+ * follow the header samples of each packet in groups of four, and are only
+ * sent by a continuous 64-bit stream.
+ */
+#define ADC_PACKED_SAMPLE_BYTES 6
+#define ADC_PACKED_GROUP_SAMPLES 4
+#define ADC_PACKED_SHIFT 2
+
+/*
+ * Planar packets carry every sample of channel A, then those of channels B,
+ * C and D, four samples of one channel per 8-byte beat, so that a packet may
+ * be written through one descriptor per channel. The stream runs one packet
+ * behind while they are enabled. They are only sent by a continuous 64-bit
+ * stream whose samples are neither packed nor masked, and the packet length
+ * must be a whole number of groups and at most ADC_PLANAR_MAX_SAMPLES, the
+ * size of the packet buffer of the FPGA.
+ */
+#define ADC_PLANAR_GROUP_SAMPLES 4
+#define ADC_PLANAR_MAX_SAMPLES 512
+
+/*
+ * Packet statistics follow the samples of each packet as a trailer of two
+ * words per channel, channel A first. The first word holds the sum of the
+ * squares of the 14-bit samples and the number of samples at either rail,
+ * and the second their sum, minimum and maximum. Trailers are only sent by a
+ * continuous 64-bit stream whose packets are neither packed, masked nor
+ * planar. They are sent between samples, so the sample period must be at
+ * least ADC_STATS_MIN_PERIOD_CYCLES of the stream clock, and the sums are
+ * exact for packets of up to ADC_STATS_MAX_SAMPLES.
+ */
+#define ADC_STATS_TRAILER_WORDS 8
+#define ADC_STATS_SQUARES_MASK 0xFFFFFFFFFFFFull
+#define ADC_STATS_CLIPPED_SHIFT 48
+#define ADC_STATS_SUM_MASK 0xFFFFFFFFull
+#define ADC_STATS_MIN_SHIFT 32
+#define ADC_STATS_MAX_SHIFT 48
+#define ADC_STATS_MIN_PERIOD_CYCLES 12
+#define ADC_STATS_MAX_SAMPLES 65536
+
+/*
+ * Channel masks select channels by bit, channel A first. The samples after
+ * the header of each packet of a masked stream carry only the enabled
+ * channels, two bytes each in ascending order, gathered into 8-byte beats.
+ * Only masks of one or two channels are honored, and only by a continuous
+ * 64-bit stream, where they take precedence over packing.
+ */
+#define ADC_CHANNEL_A (1 << 0)
+#define ADC_ALL_CHANNELS 0xF
+#define ADC_MAX_MASKED_CHANNELS 2
+#define ADC_MASKED_BEAT_BYTES 8
+
+/*
+ * decimation_control bit definitions. The decimation rate is a power of two
+ * given by its base two logarithm.
+ */
+#define ADC_DECIMATION_RATE_LOG2_MASK 0x7
+#define ADC_MAX_DECIMATION_RATE_LOG2 5
+#define ADC_DECIMATION_DC_BLOCK (1 << 8)
+
+/*
+ * correlator_control bit definitions. The offset is subtracted from every
+ * sample before it is correlated. The status bits are read-only and report on
+ * the most recent triggered window.
+ */
+#define ADC_CORRELATOR_SHIFT_MASK 0xFF
+#define ADC_CORRELATOR_OFFSET_SHIFT 8
+#define ADC_CORRELATOR_OFFSET_MASK (0x3FFF << ADC_CORRELATOR_OFFSET_SHIFT)
+#define ADC_CORRELATOR_BUSY (1 << 29)
+#define ADC_CORRELATOR_DONE (1 << 30)
+#define ADC_CORRELATOR_ENABLE (1 << 31)
+
+/*
+ * correlator_data selects a result when written and returns it when read. The
+ * results of each lag occupy four words, of which the first three hold
+ * channels A, B, and C.
+ */
+#define ADC_CORRELATOR_MAX_SHIFT 128
+#define ADC_CORRELATOR_MAX_LAGS (2 * ADC_CORRELATOR_MAX_SHIFT)
+#define ADC_CORRELATOR_MAX_WINDOW 4096
+
+/*
+ * stream_status bit definitions. Writing ADC_STREAM_SNAPSHOT latches the
+ * stream counters into dropped_samples and the total_samples words, and it
+ * reads back as set until they are valid. Writing ADC_STREAM_CLEAR clears the
+ * overrun flag and the dropped sample count. ADC_STREAM_OVERRUN is sticky and
+ * reports whether a sample was lost to a full FIFO, as of the last snapshot.
+ */
+#define ADC_STREAM_SNAPSHOT (1 << 0)
+#define ADC_STREAM_CLEAR (1 << 1)
+#define ADC_STREAM_OVERRUN (1 << 2)
+
+/*
+ * sync_control bit definitions. ADC_SYNC_OUTPUT_ENABLE lets the board drive
+ * the sync line, and writing ADC_SYNC_FIRE with it set sends a pulse. Every
+ * edge on the line, including one the board sends, increments sync_count and
+ * latches the timestamp of the sample being taken into the sync_sample words.
+ */
+#define ADC_SYNC_OUTPUT_ENABLE (1 << 0)
+#define ADC_SYNC_FIRE (1 << 1)
+
+/*
+ * ext_trigger_control bit definitions. Every rising edge of the external
+ * trigger input, or falling edge if ADC_EXT_TRIGGER_INVERT is set, increments
+ * ext_trigger_count and latches the timestamp of the sample being taken into
+ * the ext_trigger_sample words. The trigger output is high while the stream
+ * timestamp lies in the window of the ext_output words, from the start up to
+ * but excluding the end, which takes effect on a write of ADC_EXT_OUTPUT_LOAD,
+ * or always if ADC_EXT_OUTPUT_FORCE is set.
+ */
+#define ADC_EXT_TRIGGER_INVERT (1 << 0)
+#define ADC_EXT_OUTPUT_FORCE (1 << 1)
+#define ADC_EXT_OUTPUT_LOAD (1 << 2)
+
+/*
+ * envelope_control bit definitions. While enabled, the FPGA removes the
+ * offset from each channel, squares it, smooths the power with a time
+ * constant of 2^smoothing samples, and every envelope_decimation samples
+ * pushes the power of every channel, shifted right by the output shift and
+ * saturated to 16 bits, to a FIFO. Clearing ADC_ENVELOPE_ENABLE empties the
+ * FIFO, which is idle again once ADC_ENVELOPE_IDLE reads back as set.
+ */
+#define ADC_ENVELOPE_OFFSET_MASK 0x3FFF
+#define ADC_ENVELOPE_SMOOTHING_SHIFT 16
+#define ADC_ENVELOPE_SMOOTHING_MASK (0xF << ADC_ENVELOPE_SMOOTHING_SHIFT)
+#define ADC_ENVELOPE_OUTPUT_SHIFT 24
+#define ADC_ENVELOPE_OUTPUT_MASK (0xF << ADC_ENVELOPE_OUTPUT_SHIFT)
+#define ADC_ENVELOPE_ENABLE (1 << 31)
+#define ADC_ENVELOPE_MAX_DECIMATION 0xFFFF
+
+/*
+ * envelope_status bit definitions. The level is the number of envelope
+ * samples waiting in the FIFO. The oldest is read from envelope_data_low,
+ * which holds channels A and B, and then envelope_data_high, which holds
+ * channels C and D and discards it. ADC_ENVELOPE_OVERFLOW is sticky and
+ * reports whether a sample was lost to a full FIFO since the envelope was
+ * enabled. The envelope_start words hold the stream timestamp of the first
+ * envelope sample.
+ */
+#define ADC_ENVELOPE_LEVEL_MASK 0xFFFF
+#define ADC_ENVELOPE_IDLE (1 << 29)
+#define ADC_ENVELOPE_OVERFLOW (1 << 30)
+#define ADC_ENVELOPE_FIFO_DEPTH 1024
+
+/*
+ * Embedded timestamps occupy the upper two bits of every channel in the first
+ * eight samples of each packet, and a header word occupies the same bits of
+ * the next eight. The header holds the packet sequence number in its low 32
+ * bits and the status bits above it.
+ */
+#define ADC_TIMESTAMP_SAMPLES 8
+#define ADC_HEADER_SAMPLES 16
+#define ADC_HEADER_SEQUENCE_MASK 0xFFFFFFFFull
+#define ADC_HEADER_STATUS_SHIFT 32
+
+/*
+ * Packet header status bits. ADC_PACKET_OVERRUN is set if a sample was lost
+ * to a full FIFO since the previous packet began.
+ */
+#define ADC_PACKET_OVERRUN (1 << 0)
+#define ADC_PACKET_TRIGGERED (1 << 1)
+#define ADC_SAMPLE_MASK 0x3FFF
+
 #endif
@@ -0,0 +1,60 @@
+#ifndef CLK_WIZ_REGS_H
+#define CLK_WIZ_REGS_H
+
+#include "regs/defines.h"
+#include "types.h"
+
+/**
+ * The dynamic reconfiguration registers of the clocking wizard, of which only
+ * the feedback and the first output are used.
+ */
+struct ClkWizRegs
+{
+    volatile uint32_t SRR;
+    volatile uint32_t SR;
+    RESERVE(uint8_t, 0x200 - 4 * 2);
+    volatile uint32_t clock_config;
+    volatile uint32_t feedback_phase;
+    volatile uint32_t clkout0_divide;
+    volatile uint32_t clkout0_phase;
+    volatile uint32_t clkout0_duty;
+    RESERVE(uint8_t, 0x25C - 0x214);
+    volatile uint32_t load;
+};
+
+/*
+ * SR bit definitions.
+ */
+#define CLK_WIZ_LOCKED (1 << 0)
+
+/*
+ * clock_config bit definitions. The fractional part of the multiplier is in
+ * thousandths.
+ */
+#define CLK_WIZ_DIVCLK_MASK 0xFF
+#define CLK_WIZ_MULT_SHIFT 8
+#define CLK_WIZ_MULT_MASK (0xFF << CLK_WIZ_MULT_SHIFT)
+#define CLK_WIZ_MULT_FRAC_SHIFT 16
+#define CLK_WIZ_MULT_FRAC_MASK (0x3FF << CLK_WIZ_MULT_FRAC_SHIFT)
+
+/*
+ * clkout0_divide bit definitions. The fractional part of the divider is in
+ * thousandths.
+ */
+#define CLK_WIZ_DIVIDE_MASK 0xFF
+#define CLK_WIZ_DIVIDE_FRAC_SHIFT 8
+#define CLK_WIZ_DIVIDE_FRAC_MASK (0x3FF << CLK_WIZ_DIVIDE_FRAC_SHIFT)
+
+/*
+ * clkout0_duty is in thousandths of a percent.
+ */
+#define CLK_WIZ_DUTY_50_PERCENT 50000
+
+/*
+ * load bit definitions. The configuration is loaded from the registers
+ * rather than the defaults when SADDR is set.
+ */
+#define CLK_WIZ_LOAD (1 << 0)
+#define CLK_WIZ_SADDR (1 << 1)
+
+#endif
@@ -10,11 +10,61 @@ struct DmaRegs
     RESERVE(uint8_t, 0x30);
     volatile uint32_t S2MM_DMACR;
     volatile uint32_t S2MM_DMASR;
-    RESERVE(uint8_t, 0x44 - 0x38 + 0x4);
+    volatile uint32_t S2MM_CURDESC;
+    volatile uint32_t S2MM_CURDESC_MSB;
+    volatile uint32_t S2MM_TAILDESC;
+    volatile uint32_t S2MM_TAILDESC_MSB;
     volatile uint32_t S2MM_DA;
     volatile uint32_t S2MM_DA_MSB;
     RESERVE(uint8_t, 0x58 - (0x4C + 0x4));
     volatile uint32_t S2MM_LENGTH;
 };
 
+/*
+ * S2MM_DMACR bit definitions.
+ */
+#define DMACR_RUN_STOP (1 << 0)
+#define DMACR_RESET (1 << 2)
+#define DMACR_IOC_IRQ_EN (1 << 12)
+#define DMACR_DLY_IRQ_EN (1 << 13)
+#define DMACR_ERR_IRQ_EN (1 << 14)
+#define DMACR_IRQ_THRESHOLD_SHIFT 16
+#define DMACR_IRQ_DELAY_SHIFT 24
+#define DMACR_IRQ_COALESCE_MASK (0xFFFFu << 16)
+
+/*
+ * The number of scatter-gather clock cycles in each unit of the interrupt
+ * delay timer, and the most units it counts.
+ */
+#define DMA_IRQ_DELAY_CYCLES 125
+#define DMA_IRQ_DELAY_MAX 255
+#define DMA_IRQ_THRESHOLD_MAX 255
+
+/*
+ * S2MM_DMASR bit definitions.
+ */
+#define DMASR_HALTED (1 << 0)
+#define DMASR_IDLE (1 << 1)
+#define DMASR_SG_INCLUDED (1 << 3)
+#define DMASR_ERROR_MASK (0x770)
+#define DMASR_IOC_IRQ (1 << 12)
+#define DMASR_DLY_IRQ (1 << 13)
+#define DMASR_ERR_IRQ (1 << 14)
+#define DMASR_IRQ_MASK (DMASR_IOC_IRQ | DMASR_DLY_IRQ | DMASR_ERR_IRQ)
+
+/*
+ * The width of the buffer length register when the engine is built with the
+ * default c_sg_length_width.
+ */
+#define DMA_DEFAULT_LENGTH_WIDTH 14
+#define DMA_MAX_LENGTH_WIDTH 26
+
+/*
+ * Scatter-gather descriptor status and control bit definitions.
+ */
+#define DMA_DESC_LENGTH_MASK 0x3FFFFFF
+#define DMA_DESC_STATUS_RXEOF (1 << 26)
+#define DMA_DESC_STATUS_ERROR_MASK (0x7 << 28)
+#define DMA_DESC_STATUS_COMPLETE (1 << 31)
+
 #endif
@@ -0,0 +1,19 @@
+#ifndef SCU_WDT_REGS_H
+#define SCU_WDT_REGS_H
+
+#include "types.h"
+
+/**
+ * The registers of the Cortex-A9 private watchdog.
+ */
+struct ScuWdtRegs
+{
+    volatile uint32_t LOAD;
+    volatile uint32_t COUNTER;
+    volatile uint32_t CONTROL;
+    volatile uint32_t INTERRUPT_STATUS;
+    volatile uint32_t RESET_STATUS;
+    volatile uint32_t DISABLE;
+};
+
+#endif
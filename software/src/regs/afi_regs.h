@@ -0,0 +1,39 @@
+#ifndef AFI_REGS_H
+#define AFI_REGS_H
+
+#include "regs/defines.h"
+#include "types.h"
+
+/*
+ * The AXI FIFO interface of an S_AXI_HP port.
+ */
+struct AfiRegs
+{
+    volatile uint32_t RDCHAN_CTRL;
+    volatile uint32_t RDCHAN_ISSUINGCAP;
+    volatile uint32_t RDQOS;
+    volatile uint32_t RDDATAFIFO_LEVEL;
+    volatile uint32_t RDDEBUG;
+    volatile uint32_t WRCHAN_CTRL;
+    volatile uint32_t WRCHAN_ISSUINGCAP;
+    volatile uint32_t WRQOS;
+    volatile uint32_t WRDATAFIFO_LEVEL;
+    volatile uint32_t WRDEBUG;
+};
+
+/*
+ * WRCHAN_CTRL bit definitions.
+ */
+#define AFI_CTRL_32BIT_EN (1 << 0)
+#define AFI_CTRL_FABRIC_QOS_EN (1 << 1)
+#define AFI_CTRL_FABRIC_OUT_CMD_EN (1 << 2)
+
+#define AFI_ISSUINGCAP_MASK 0x7
+#define AFI_QOS_MASK 0xF
+#define AFI_FIFO_LEVEL_MASK 0xFF
+
+#define AFI_BASE_ADDRESS 0xF8008000
+#define AFI_PORT_STRIDE 0x1000
+#define AFI_PORTS 4
+
+#endif
@@ -10,10 +10,22 @@ struct SLCR_Regs
     uint32_t SLCR_LOCK;
     uint32_t SLCR_UNLOCK;
     uint32_t SLCR_LOCKSTA;
-    RESERVE(uint8_t, 0x200 - 0x10);
+    RESERVE(uint8_t, 0x140 - 0x10);
+    uint32_t GEM0_CLK_CTRL;
+    RESERVE(uint8_t, 0x200 - 0x144);
     uint32_t PSS_RST_CTRL;
+    RESERVE(uint8_t, 0x258 - 0x204);
+    uint32_t REBOOT_STATUS;
 };
 
+/*
+ * GEM0_CLK_CTRL bit definitions. The reference clock of the Ethernet MAC is
+ * its source divided by both divisors.
+ */
+#define GEM_CLK_DIVISOR0_SHIFT 8
+#define GEM_CLK_DIVISOR1_SHIFT 20
+#define GEM_CLK_DIVISOR_MASK ((0x3F << GEM_CLK_DIVISOR0_SHIFT) | (0x3F << GEM_CLK_DIVISOR1_SHIFT))
+
 static struct SLCR_Regs *SLCR = (struct SLCR_Regs *)(0xF8000000);
 
 #endif
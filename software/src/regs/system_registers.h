@@ -7,8 +7,31 @@ struct GlobalTimerRegs
 {
     uint32_t Counter_Register[2];
     uint32_t Control_Register;
+    uint32_t Interrupt_Status_Register;
+    uint32_t Comparator_Value_Register[2];
+    uint32_t Auto_increment_Register;
 };
 
+#define GLOBAL_TIMER_ENABLE (1 << 0)
+#define GLOBAL_TIMER_COMP_ENABLE (1 << 1)
+#define GLOBAL_TIMER_IRQ_ENABLE (1 << 2)
+#define GLOBAL_TIMER_EVENT_FLAG (1 << 0)
+
 static struct GlobalTimerRegs *global_timer_regs = (struct GlobalTimerRegs *)(0xf8f00200);
 
+struct PrivateTimerRegs
+{
+    uint32_t Load_Register;
+    uint32_t Counter_Register;
+    uint32_t Control_Register;
+    uint32_t Interrupt_Status_Register;
+};
+
+#define PRIVATE_TIMER_ENABLE (1 << 0)
+#define PRIVATE_TIMER_AUTO_RELOAD (1 << 1)
+#define PRIVATE_TIMER_IRQ_ENABLE (1 << 2)
+#define PRIVATE_TIMER_EVENT_FLAG (1 << 0)
+
+static struct PrivateTimerRegs *private_timer_regs = (struct PrivateTimerRegs *)(0xf8f00600);
+
 #endif
@@ -5,11 +5,28 @@
 
 struct UartRegs
 {
-    volatile uint32_t UNUSED[11];
+    volatile uint32_t Control_Register;
+    volatile uint32_t Mode_Register;
+    volatile uint32_t Interrupt_Enable;
+    volatile uint32_t Interrupt_Disable;
+    volatile uint32_t Interrupt_Mask;
+    volatile uint32_t Channel_Interrupt_Status;
+    volatile uint32_t UNUSED[5];
     volatile uint32_t Status_Register;
     volatile uint32_t TX_RX_FIFO;
 };
 
 static struct UartRegs *uart_regs = (struct UartRegs *)(0xe0001000);
 
+/**
+ * The GIC interrupt ID of UART1.
+ */
+#define UART_IRQ_ID 82
+
+/**
+ * Status and interrupt bits shared by the status and interrupt registers.
+ */
+#define UART_TX_EMPTY (1 << 3)
+#define UART_TX_FULL (1 << 4)
+
 #endif
@@ -0,0 +1,273 @@
+#include "replay.h"
+
+#include "abort.h"
+#include "db.h"
+#include "network_stack.h"
+#include "system.h"
+#include "time_util.h"
+
+#include <string.h>
+
+/**
+ * The time to wait for the send buffer to accept a summary before it is
+ * dropped.
+ */
+#define REPLAY_SUMMARY_TIMEOUT_MS 100
+
+/**
+ * Returns the receiver to waiting for the header of the next capture.
+ *
+ * @param replay The receiver to reset.
+ *
+ * @return None.
+ */
+static void reset_replay(replay_receiver_t *replay)
+{
+    replay->received = 0;
+    replay->state = REPLAY_HEADER;
+}
+
+/**
+ * Checks the header of a capture against the buffer it is received into.
+ *
+ * @param replay The receiver whose header to check.
+ *
+ * @return True if the capture can be received.
+ */
+static bool replay_header_valid(const replay_receiver_t *replay)
+{
+    const replay_header_t *header = &replay->header;
+
+    return (header->version == REPLAY_VERSION &&
+            header->sample_count > 0 &&
+            header->sample_count <= replay->capacity &&
+            header->sampling_frequency > 0)? true : false;
+}
+
+/**
+ * Handles data received from the replay client.
+ *
+ * @note Data that arrives while no capture is accepted, or after a capture
+ *       was rejected, is discarded until the client reconnects.
+ *
+ * @param arg The replay receiver.
+ * @param data The received data, or NULL if the client disconnected.
+ * @param len The number of bytes received.
+ *
+ * @return None.
+ */
+static void receive_replay(void *arg, const void *data, const size_t len)
+{
+    replay_receiver_t *replay = arg;
+
+    if (!data)
+    {
+        /*
+         * A complete capture is still processed, but its summary cannot be
+         * returned.
+         */
+        if (replay->state != REPLAY_READY)
+        {
+            reset_replay(replay);
+        }
+        return;
+    }
+
+    const uint8_t *bytes = data;
+    size_t remaining = len;
+    while (remaining)
+    {
+        size_t consumed = 0;
+        switch (replay->state)
+        {
+            case REPLAY_HEADER:
+                if (!replay->buffer)
+                {
+                    replay->state = REPLAY_DISCARD;
+                    break;
+                }
+
+                if (replay->received == 0)
+                {
+                    replay->start_tick = get_system_time();
+                }
+
+                consumed = sizeof(replay->header) - replay->received;
+                if (consumed > remaining)
+                {
+                    consumed = remaining;
+                }
+                memcpy((uint8_t *)&replay->header + replay->received, bytes, consumed);
+                replay->received += consumed;
+
+                if (replay->received == sizeof(replay->header))
+                {
+                    replay->received = 0;
+                    if (replay_header_valid(replay))
+                    {
+                        replay->state = REPLAY_SAMPLES;
+                    }
+                    else
+                    {
+                        dbprintf("Replay capture rejected: version %u, %u samples at %u Hz\n",
+                                replay->header.version,
+                                replay->header.sample_count,
+                                replay->header.sampling_frequency);
+                        replay->state = REPLAY_DISCARD;
+                    }
+                }
+                break;
+
+            case REPLAY_SAMPLES:
+                consumed = replay->header.sample_count * sizeof(sample_t) - replay->received;
+                if (consumed > remaining)
+                {
+                    consumed = remaining;
+                }
+                memcpy((uint8_t *)replay->buffer + replay->received, bytes, consumed);
+                replay->received += consumed;
+
+                if (replay->received == replay->header.sample_count * sizeof(sample_t))
+                {
+                    replay->end_tick = get_system_time();
+                    replay->state = REPLAY_READY;
+                }
+                break;
+
+            default:
+                replay->discarded_bytes += remaining;
+                consumed = remaining;
+                break;
+        }
+
+        bytes += consumed;
+        remaining -= consumed;
+    }
+}
+
+/**
+ * Initializes a replay receiver and listens for a client.
+ *
+ * @param replay The receiver to initialize.
+ * @param port The port to accept the client on.
+ *
+ * @return Success or fail.
+ */
+result_t init_replay(replay_receiver_t *replay, const uint16_t port)
+{
+    AbortIfNot(replay, fail);
+
+    replay->buffer = NULL;
+    replay->capacity = 0;
+    replay->discarded_bytes = 0;
+    reset_replay(replay);
+
+    AbortIfNot(init_tcp(&replay->socket), fail);
+    AbortIfNot(set_tcp_receiver(&replay->socket, receive_replay, replay), fail);
+    AbortIfNot(listen_tcp(&replay->socket, port), fail);
+
+    return success;
+}
+
+/**
+ * Accepts captures into a buffer.
+ *
+ * @note A capture that is partially received into a different buffer is
+ *       discarded.
+ *
+ * @param replay The receiver to accept captures with.
+ * @param buffer The buffer to receive samples into.
+ * @param capacity The number of samples the buffer holds.
+ *
+ * @return Success or fail.
+ */
+result_t arm_replay(replay_receiver_t *replay, sample_t *buffer, const size_t capacity)
+{
+    AbortIfNot(replay, fail);
+    AbortIfNot(buffer, fail);
+    AbortIfNot(capacity, fail);
+
+    if (replay->buffer == buffer && replay->capacity == capacity)
+    {
+        return success;
+    }
+
+    if (replay->state != REPLAY_HEADER || replay->received)
+    {
+        replay->state = REPLAY_DISCARD;
+    }
+
+    replay->buffer = buffer;
+    replay->capacity = capacity;
+
+    return success;
+}
+
+/**
+ * Stops accepting captures. A capture in progress is discarded.
+ *
+ * @param replay The receiver to stop.
+ *
+ * @return None.
+ */
+void disarm_replay(replay_receiver_t *replay)
+{
+    if (replay->state != REPLAY_HEADER || replay->received)
+    {
+        replay->state = REPLAY_DISCARD;
+    }
+
+    replay->buffer = NULL;
+    replay->capacity = 0;
+}
+
+/**
+ * Checks if a complete capture is waiting to be processed.
+ *
+ * @param replay The receiver to check.
+ *
+ * @return True if a capture has been received.
+ */
+bool replay_ready(const replay_receiver_t *replay)
+{
+    return (replay && replay->state == REPLAY_READY)? true : false;
+}
+
+/**
+ * Returns the summary of the received capture to the client and accepts the
+ * next capture.
+ *
+ * @param replay The receiver holding the processed capture.
+ * @param summary The outcome of processing the capture.
+ *
+ * @return Success or fail.
+ */
+result_t finish_replay(replay_receiver_t *replay, const replay_summary_t *summary)
+{
+    AbortIfNot(replay, fail);
+    AbortIfNot(summary, fail);
+    AbortIfNot(replay->state == REPLAY_READY, fail);
+
+    reset_replay(replay);
+
+    size_t sent = 0;
+    const tick_t start_time = get_system_time();
+    while (sent < sizeof(*summary) && tcp_connected(&replay->socket))
+    {
+        size_t written = 0;
+        AbortIfNot(send_tcp(&replay->socket,
+                            (const uint8_t *)summary + sent,
+                            sizeof(*summary) - sent,
+                            true,
+                            &written), fail);
+        sent += written;
+
+        if (sent < sizeof(*summary))
+        {
+            AbortIf(get_system_time() - start_time > ms_to_ticks(REPLAY_SUMMARY_TIMEOUT_MS), fail);
+            dispatch_network_stack();
+        }
+    }
+
+    return success;
+}
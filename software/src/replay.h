@@ -0,0 +1,111 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "tcp.h"
+#include "types.h"
+
+/**
+ * The version of the replay header and summary layouts.
+ */
+#define REPLAY_VERSION 1
+
+/**
+ * Defines the header that precedes the samples of a replayed capture. All
+ * fields are little endian.
+ */
+typedef struct __attribute__((packed)) replay_header_t
+{
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t sample_count;
+    uint32_t sampling_frequency;
+} replay_header_t;
+
+/**
+ * Defines the outcome of processing a replayed capture, which is returned to
+ * the client once the capture has been processed.
+ */
+typedef struct __attribute__((packed)) replay_summary_t
+{
+    uint16_t version;
+
+    /*
+     * Nonzero if the ping was located, and zero if processing failed.
+     */
+    uint8_t located;
+    uint8_t status;
+
+    uint32_t sequence;
+    uint32_t start_index;
+    uint32_t end_index;
+    int32_t channel_delay_ns[3];
+    float confidence[3];
+    float bearing_deg;
+    float elevation_deg;
+
+    /*
+     * The time taken to receive the capture, and to process it in total and
+     * in its filter and correlation stages.
+     */
+    uint32_t receive_duration_us;
+    uint32_t processing_duration_us;
+    uint32_t filter_duration_us;
+    uint32_t correlation_duration_us;
+} replay_summary_t;
+
+/**
+ * Defines the state of a replay receiver.
+ */
+typedef enum replay_state_t
+{
+    REPLAY_HEADER,
+    REPLAY_SAMPLES,
+    REPLAY_READY,
+    REPLAY_DISCARD
+} replay_state_t;
+
+/**
+ * Defines a receiver of captures streamed by a client over TCP. Captures are
+ * received one at a time: the client waits for the summary of a capture
+ * before sending the next.
+ */
+typedef struct replay_receiver_t
+{
+    tcp_socket_t socket;
+
+    /*
+     * The buffer that samples are received into, or NULL if captures are
+     * not accepted.
+     */
+    sample_t *buffer;
+    size_t capacity;
+
+    volatile replay_state_t state;
+    replay_header_t header;
+    size_t received;
+
+    /*
+     * The time the first byte of the capture was received and the time the
+     * capture was complete.
+     */
+    tick_t start_tick;
+    tick_t end_tick;
+
+    /*
+     * The number of bytes that were discarded because no capture was
+     * accepted.
+     */
+    uint32_t discarded_bytes;
+} replay_receiver_t;
+
+result_t init_replay(replay_receiver_t *replay, const uint16_t port);
+
+result_t arm_replay(replay_receiver_t *replay, sample_t *buffer, const size_t capacity);
+
+void disarm_replay(replay_receiver_t *replay);
+
+bool replay_ready(const replay_receiver_t *replay);
+
+result_t finish_replay(replay_receiver_t *replay, const replay_summary_t *summary);
+
+#endif
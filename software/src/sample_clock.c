@@ -0,0 +1,160 @@
+#include "sample_clock.h"
+
+#include "abort.h"
+#include "system_params.h"
+#include "types.h"
+
+/**
+ * Initializes an exact conversion that scales by num / den.
+ *
+ * @param[out] ratio The ratio to initialize.
+ * @param num The numerator.
+ * @param den The denominator.
+ *
+ * @return Success or fail.
+ */
+result_t init_clock_ratio(clock_ratio_t *ratio, const uint32_t num, const uint32_t den)
+{
+    AbortIfNot(ratio, fail);
+    AbortIfNot(den, fail);
+
+    ratio->num = num;
+    ratio->den = den;
+    ratio->whole = num / den;
+    ratio->fraction = ((uint64_t)(num % den) << 32) / den;
+
+    return success;
+}
+
+/**
+ * Scales a value by a clock ratio, rounding down.
+ *
+ * @note The fraction of the ratio is truncated to 32 bits, so the estimate
+ *       from it is at most one short for values below 2^32 and is corrected
+ *       exactly. Larger values are split into whole multiples of the
+ *       denominator, which takes a 64 bit division.
+ *
+ * @param ratio The ratio to scale by.
+ * @param value The value to scale.
+ *
+ * @return value * num / den.
+ */
+uint64_t scale_clock(const clock_ratio_t *ratio, const uint64_t value)
+{
+    if (value >> 32)
+    {
+        return value / ratio->den * ratio->num + (value % ratio->den) * ratio->num / ratio->den;
+    }
+
+    uint64_t scaled = value * ratio->whole + ((value * ratio->fraction) >> 32);
+    if ((scaled + 1) * ratio->den <= value * ratio->num)
+    {
+        scaled++;
+    }
+
+    return scaled;
+}
+
+/**
+ * Precomputes the conversions of a sampling frequency.
+ *
+ * @param[out] clock The conversions to initialize.
+ * @param sampling_frequency The sampling frequency in Hz.
+ *
+ * @return Success or fail.
+ */
+result_t init_sample_clock(sample_clock_t *clock, const uint32_t sampling_frequency)
+{
+    AbortIfNot(clock, fail);
+    AbortIfNot(sampling_frequency, fail);
+
+    AbortIfNot(init_clock_ratio(&clock->samples_per_tick, sampling_frequency, CPU_CLOCK_HZ), fail);
+    AbortIfNot(init_clock_ratio(&clock->ticks_per_sample, CPU_CLOCK_HZ, sampling_frequency), fail);
+    AbortIfNot(init_clock_ratio(&clock->ns_per_sample, 1000000000, sampling_frequency), fail);
+    AbortIfNot(init_clock_ratio(&clock->samples_per_ns, sampling_frequency, 1000000000), fail);
+    clock->sampling_frequency = sampling_frequency;
+
+    return success;
+}
+
+/**
+ * Converts a duration in system ticks into whole samples.
+ *
+ * @param clock The conversions of the sampling frequency.
+ * @param ticks The duration to convert.
+ *
+ * @return The number of samples taken within the duration.
+ */
+uint64_t clock_ticks_to_samples(const sample_clock_t *clock, const tick_t ticks)
+{
+    return scale_clock(&clock->samples_per_tick, ticks);
+}
+
+/**
+ * Converts a number of samples into system ticks.
+ *
+ * @param clock The conversions of the sampling frequency.
+ * @param samples The number of samples to convert.
+ *
+ * @return The duration of the samples, rounded down.
+ */
+tick_t clock_samples_to_ticks(const sample_clock_t *clock, const uint64_t samples)
+{
+    return scale_clock(&clock->ticks_per_sample, samples);
+}
+
+/**
+ * Converts a number of samples into nanoseconds.
+ *
+ * @param clock The conversions of the sampling frequency.
+ * @param samples The number of samples to convert.
+ *
+ * @return The duration of the samples, rounded down.
+ */
+uint64_t clock_samples_to_ns(const sample_clock_t *clock, const uint64_t samples)
+{
+    return scale_clock(&clock->ns_per_sample, samples);
+}
+
+/**
+ * Converts a duration in nanoseconds into whole samples.
+ *
+ * @param clock The conversions of the sampling frequency.
+ * @param ns The duration to convert.
+ *
+ * @return The number of samples taken within the duration.
+ */
+uint64_t clock_ns_to_samples(const sample_clock_t *clock, const uint64_t ns)
+{
+    return scale_clock(&clock->samples_per_ns, ns);
+}
+
+/**
+ * Converts a duration in system ticks into whole samples at a sampling
+ * frequency without precomputed conversions.
+ *
+ * @param ticks The duration to convert.
+ * @param sampling_frequency The sampling frequency in Hz.
+ *
+ * @return The number of samples taken within the duration.
+ */
+size_t ticks_to_samples(const tick_t ticks, const uint32_t sampling_frequency)
+{
+    return ticks / CPU_CLOCK_HZ * sampling_frequency +
+           (ticks % CPU_CLOCK_HZ) * sampling_frequency / CPU_CLOCK_HZ;
+}
+
+/**
+ * Converts a number of samples into system ticks at a sampling frequency
+ * without precomputed conversions.
+ *
+ * @param samples The number of samples to convert.
+ * @param sampling_frequency The sampling frequency in Hz.
+ *
+ * @return The duration of the samples, rounded down.
+ */
+tick_t samples_to_ticks(const uint64_t samples, const uint32_t sampling_frequency)
+{
+    return samples / sampling_frequency * CPU_CLOCK_HZ +
+           (samples % sampling_frequency) * CPU_CLOCK_HZ / sampling_frequency;
+}
@@ -0,0 +1,57 @@
+#ifndef SAMPLE_CLOCK_H
+#define SAMPLE_CLOCK_H
+
+#include "system_params.h"
+#include "types.h"
+
+/**
+ * Defines an exact conversion between two integer clocks, which scales by
+ * num / den. The whole part and the fraction of the ratio are precomputed so
+ * that values below 2^32 are scaled with multiplications only.
+ */
+typedef struct clock_ratio_t
+{
+    uint32_t num;
+    uint32_t den;
+    uint32_t whole;
+    uint32_t fraction;
+} clock_ratio_t;
+
+/**
+ * Initializes a clock ratio at compile time.
+ */
+#define CLOCK_RATIO(num, den) \
+    {(num), (den), (num) / (den), (uint32_t)(((uint64_t)((num) % (den)) << 32) / (den))}
+
+/**
+ * Defines the conversions between system ticks, samples and nanoseconds at
+ * a sampling frequency.
+ */
+typedef struct sample_clock_t
+{
+    uint32_t sampling_frequency;
+    clock_ratio_t samples_per_tick;
+    clock_ratio_t ticks_per_sample;
+    clock_ratio_t ns_per_sample;
+    clock_ratio_t samples_per_ns;
+} sample_clock_t;
+
+result_t init_clock_ratio(clock_ratio_t *ratio, const uint32_t num, const uint32_t den);
+
+uint64_t scale_clock(const clock_ratio_t *ratio, const uint64_t value);
+
+result_t init_sample_clock(sample_clock_t *clock, const uint32_t sampling_frequency);
+
+uint64_t clock_ticks_to_samples(const sample_clock_t *clock, const tick_t ticks);
+
+tick_t clock_samples_to_ticks(const sample_clock_t *clock, const uint64_t samples);
+
+uint64_t clock_samples_to_ns(const sample_clock_t *clock, const uint64_t samples);
+
+uint64_t clock_ns_to_samples(const sample_clock_t *clock, const uint64_t ns);
+
+size_t ticks_to_samples(const tick_t ticks, const uint32_t sampling_frequency);
+
+tick_t samples_to_ticks(const uint64_t samples, const uint32_t sampling_frequency);
+
+#endif
@@ -0,0 +1,196 @@
+#include "sample_codec.h"
+
+#include "abort.h"
+#include "types.h"
+
+#include <string.h>
+
+/**
+ * Maps a signed residual onto an unsigned value so that residuals of small
+ * magnitude have few significant bits.
+ *
+ * @param residual The residual to map.
+ *
+ * @return The zigzag encoded residual.
+ */
+static uint32_t zigzag(const int32_t residual)
+{
+    return ((uint32_t)residual << 1) ^ (uint32_t)(residual >> 31);
+}
+
+/**
+ * Finds the number of bits needed to represent a value.
+ *
+ * @param value The value to measure.
+ *
+ * @return The number of significant bits.
+ */
+static uint8_t bit_width(uint32_t value)
+{
+    uint8_t width = 0;
+    while (value)
+    {
+        width++;
+        value >>= 1;
+    }
+
+    return width;
+}
+
+/**
+ * Losslessly compresses samples with a per-channel delta coder.
+ *
+ * @note The output begins with the first sample of each channel. It is
+ *       followed by blocks of up to SAMPLE_CODEC_BLOCK residuals between
+ *       consecutive samples. Each block holds, for each channel in turn, a
+ *       byte giving the bit width followed by the zigzag encoded residuals
+ *       packed least significant bit first. Only whole blocks are emitted, so
+ *       fewer samples than requested are consumed if the output fills.
+ *
+ * @param data The samples to encode.
+ * @param count The number of samples available.
+ * @param[out] out The buffer to encode into.
+ * @param capacity The size of the output buffer in bytes.
+ * @param[out] consumed The number of samples encoded.
+ * @param[out] encoded_len The number of bytes written.
+ *
+ * @return Success or fail.
+ */
+result_t encode_samples(const sample_t *data,
+                        const size_t count,
+                        uint8_t *out,
+                        const size_t capacity,
+                        size_t *consumed,
+                        size_t *encoded_len)
+{
+    AbortIfNot(data, fail);
+    AbortIfNot(count, fail);
+    AbortIfNot(out, fail);
+    AbortIfNot(consumed, fail);
+    AbortIfNot(encoded_len, fail);
+    AbortIfNot(capacity >= sizeof(sample_t), fail);
+
+    memcpy(out, data[0].sample, sizeof(sample_t));
+    size_t len = sizeof(sample_t);
+    size_t i = 1;
+
+    while (i < count)
+    {
+        const size_t block = (count - i < SAMPLE_CODEC_BLOCK)? count - i : SAMPLE_CODEC_BLOCK;
+
+        /*
+         * Size the block before writing it so that a block that does not fit
+         * leaves the output intact.
+         */
+        uint8_t widths[4];
+        size_t block_len = 0;
+        for (size_t k = 0; k < 4; ++k)
+        {
+            uint32_t bits = 0;
+            for (size_t j = i; j < i + block; ++j)
+            {
+                bits |= zigzag((int32_t)data[j].sample[k] - data[j - 1].sample[k]);
+            }
+
+            widths[k] = bit_width(bits);
+            block_len += 1 + (block * widths[k] + 7) / 8;
+        }
+
+        if (len + block_len > capacity)
+        {
+            break;
+        }
+
+        for (size_t k = 0; k < 4; ++k)
+        {
+            out[len++] = widths[k];
+
+            uint32_t accumulator = 0;
+            uint8_t pending = 0;
+            for (size_t j = i; j < i + block; ++j)
+            {
+                accumulator |= zigzag((int32_t)data[j].sample[k] - data[j - 1].sample[k]) << pending;
+                pending += widths[k];
+                while (pending >= 8)
+                {
+                    out[len++] = accumulator & 0xFF;
+                    accumulator >>= 8;
+                    pending -= 8;
+                }
+            }
+
+            if (pending)
+            {
+                out[len++] = accumulator & 0xFF;
+            }
+        }
+
+        i += block;
+    }
+
+    *consumed = i;
+    *encoded_len = len;
+
+    return success;
+}
+
+/**
+ * Decompresses samples encoded by encode_samples().
+ *
+ * @param data The encoded samples.
+ * @param len The number of encoded bytes.
+ * @param[out] out The decoded samples.
+ * @param count The number of samples that were encoded.
+ *
+ * @return Success or fail if the encoding is truncated or malformed.
+ */
+result_t decode_samples(const uint8_t *data,
+                        const size_t len,
+                        sample_t *out,
+                        const size_t count)
+{
+    AbortIfNot(data, fail);
+    AbortIfNot(out, fail);
+    AbortIfNot(count, fail);
+    AbortIfNot(len >= sizeof(sample_t), fail);
+
+    memcpy(out[0].sample, data, sizeof(sample_t));
+    size_t offset = sizeof(sample_t);
+    size_t i = 1;
+
+    while (i < count)
+    {
+        const size_t block = (count - i < SAMPLE_CODEC_BLOCK)? count - i : SAMPLE_CODEC_BLOCK;
+        for (size_t k = 0; k < 4; ++k)
+        {
+            AbortIfNot(offset < len, fail);
+            const uint8_t width = data[offset++];
+            AbortIfNot(width <= SAMPLE_CODEC_MAX_WIDTH, fail);
+            AbortIfNot(offset + (block * width + 7) / 8 <= len, fail);
+
+            const uint32_t mask = (width)? (1u << width) - 1 : 0;
+            uint32_t accumulator = 0;
+            uint8_t pending = 0;
+            int32_t current = out[i - 1].sample[k];
+            for (size_t j = i; j < i + block; ++j)
+            {
+                while (pending < width)
+                {
+                    accumulator |= (uint32_t)data[offset++] << pending;
+                    pending += 8;
+                }
+
+                const uint32_t value = accumulator & mask;
+                accumulator = (width < 32)? accumulator >> width : 0;
+                pending -= width;
+
+                current += (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+                out[j].sample[k] = current;
+            }
+        }
+
+        i += block;
+    }
+
+    return success;
+}
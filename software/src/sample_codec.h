@@ -0,0 +1,29 @@
+#ifndef SAMPLE_CODEC_H
+#define SAMPLE_CODEC_H
+
+#include "types.h"
+
+/**
+ * The number of samples of each channel that share a residual bit width.
+ */
+#define SAMPLE_CODEC_BLOCK 32
+
+/**
+ * The largest bit width of a residual. Differences of 16-bit samples need up
+ * to 17 bits after zigzag mapping.
+ */
+#define SAMPLE_CODEC_MAX_WIDTH 17
+
+result_t encode_samples(const sample_t *data,
+                        const size_t count,
+                        uint8_t *out,
+                        const size_t capacity,
+                        size_t *consumed,
+                        size_t *encoded_len);
+
+result_t decode_samples(const uint8_t *data,
+                        const size_t len,
+                        sample_t *out,
+                        const size_t count);
+
+#endif
@@ -0,0 +1,1225 @@
+#include "sample_ops.h"
+
+#include "abort.h"
+#include "regs/AdcRegs.h"
+#include "l2_lockdown.h"
+#include "system_params.h"
+#include "types.h"
+
+#include <math.h>
+#include <string.h>
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+/**
+ * Expands one packed sample in place.
+ *
+ * @param data The packed samples.
+ * @param i The index of the sample to expand.
+ *
+ * @return None.
+ */
+static void unpack_sample(sample_t *data, const size_t i)
+{
+    const uint8_t *in = (const uint8_t *)data + i * ADC_PACKED_SAMPLE_BYTES;
+    const uint32_t low = in[0] | (in[1] << 8) | (in[2] << 16);
+    const uint32_t high = in[3] | (in[4] << 8) | (in[5] << 16);
+
+    data[i].sample[0] = (low & 0xFFF) << ADC_PACKED_SHIFT;
+    data[i].sample[1] = (low >> 12) << ADC_PACKED_SHIFT;
+    data[i].sample[2] = (high & 0xFFF) << ADC_PACKED_SHIFT;
+    data[i].sample[3] = (high >> 12) << ADC_PACKED_SHIFT;
+}
+
+/**
+ * Expands samples that the FPGA packed to 12 bits per channel into whole
+ * samples in place. The expanded samples are on the same scale as unpacked
+ * ones, with the two least significant bits cleared.
+ *
+ * @note Samples are expanded from the last to the first, so each is read
+ *       before the expanded samples after it overwrite it.
+ *
+ * @param data The packed samples, which occupy the first
+ *        len * ADC_PACKED_SAMPLE_BYTES bytes of a buffer of len samples.
+ * @param len The number of samples.
+ *
+ * @return Success or fail.
+ */
+result_t unpack_samples(sample_t *data, const size_t len)
+{
+    AbortIfNot(data, fail);
+
+    size_t i = len;
+    while (i % 8)
+    {
+        unpack_sample(data, --i);
+    }
+
+#ifdef __ARM_NEON
+    /*
+     * Every three bytes hold two channels, so eight samples are loaded as
+     * sixteen three-byte groups and each group is split into its channels.
+     */
+    const uint8x16_t nibble = vdupq_n_u8(0x0F);
+    while (i)
+    {
+        i -= 8;
+        const uint8x16x3_t in = vld3q_u8((const uint8_t *)data + i * ADC_PACKED_SAMPLE_BYTES);
+        const uint8x16_t middle_low = vandq_u8(in.val[1], nibble);
+        const uint8x16_t middle_high = vshrq_n_u8(in.val[1], 4);
+
+        const uint16x8_t even_lo = vorrq_u16(vmovl_u8(vget_low_u8(in.val[0])),
+                                             vshll_n_u8(vget_low_u8(middle_low), 8));
+        const uint16x8_t even_hi = vorrq_u16(vmovl_u8(vget_high_u8(in.val[0])),
+                                             vshll_n_u8(vget_high_u8(middle_low), 8));
+        const uint16x8_t odd_lo = vorrq_u16(vmovl_u8(vget_low_u8(middle_high)),
+                                            vshll_n_u8(vget_low_u8(in.val[2]), 4));
+        const uint16x8_t odd_hi = vorrq_u16(vmovl_u8(vget_high_u8(middle_high)),
+                                            vshll_n_u8(vget_high_u8(in.val[2]), 4));
+
+        const uint16x8x2_t first = vzipq_u16(even_lo, odd_lo);
+        const uint16x8x2_t second = vzipq_u16(even_hi, odd_hi);
+        int16_t *out = data[i].sample;
+        vst1q_s16(out, vreinterpretq_s16_u16(vshlq_n_u16(first.val[0], ADC_PACKED_SHIFT)));
+        vst1q_s16(out + 8, vreinterpretq_s16_u16(vshlq_n_u16(first.val[1], ADC_PACKED_SHIFT)));
+        vst1q_s16(out + 16, vreinterpretq_s16_u16(vshlq_n_u16(second.val[0], ADC_PACKED_SHIFT)));
+        vst1q_s16(out + 24, vreinterpretq_s16_u16(vshlq_n_u16(second.val[1], ADC_PACKED_SHIFT)));
+    }
+#endif
+
+    while (i)
+    {
+        unpack_sample(data, --i);
+    }
+
+    return success;
+}
+
+/**
+ * Expands one masked sample in place.
+ *
+ * @param data The masked samples.
+ * @param i The index of the sample to expand.
+ * @param channels The index of each enabled channel, in ascending order.
+ * @param count The number of enabled channels.
+ *
+ * @return None.
+ */
+static void expand_sample(sample_t *data, const size_t i, const size_t *channels, const size_t count)
+{
+    const analog_sample_t *in = (const analog_sample_t *)data + i * count;
+    analog_sample_t values[4];
+    for (size_t j = 0; j < count; ++j)
+    {
+        values[j] = in[j];
+    }
+
+    memset(&data[i], 0, sizeof(data[i]));
+    for (size_t j = 0; j < count; ++j)
+    {
+        data[i].sample[channels[j]] = values[j];
+    }
+}
+
+/**
+ * Expands samples that the FPGA masked to some of their channels into whole
+ * samples in place. The channels that were left out are zero.
+ *
+ * @note Samples are expanded from the last to the first, so each is read
+ *       before the expanded samples after it overwrite it.
+ *
+ * @param data The masked samples, which occupy the first
+ *        len * sizeof(analog_sample_t) bytes per enabled channel of a buffer
+ *        of len samples.
+ * @param len The number of samples.
+ * @param mask The channels that were sent, channel A in the lowest bit.
+ *
+ * @return Success or fail.
+ */
+result_t expand_channels(sample_t *data, const size_t len, const uint32_t mask)
+{
+    AbortIfNot(data, fail);
+
+    size_t channels[4];
+    size_t count = 0;
+    for (size_t k = 0; k < 4; ++k)
+    {
+        if (mask & (1 << k))
+        {
+            channels[count++] = k;
+        }
+    }
+    AbortIfNot(count, fail);
+
+    if (count == 4)
+    {
+        return success;
+    }
+
+    size_t i = len;
+    while (i % 8)
+    {
+        expand_sample(data, --i, channels, count);
+    }
+
+#ifdef __ARM_NEON
+    /*
+     * One or two channels are loaded for eight samples at once and stored
+     * among zeroed channels.
+     */
+    const int16x8_t zero = vdupq_n_s16(0);
+    while (count <= 2 && i)
+    {
+        i -= 8;
+        int16x8x4_t out = {{zero, zero, zero, zero}};
+        if (count == 1)
+        {
+            out.val[channels[0]] = vld1q_s16((const int16_t *)data + i);
+        }
+        else
+        {
+            const int16x8x2_t in = vld2q_s16((const int16_t *)data + 2 * i);
+            out.val[channels[0]] = in.val[0];
+            out.val[channels[1]] = in.val[1];
+        }
+        vst4q_s16(data[i].sample, out);
+    }
+#endif
+
+    while (i)
+    {
+        expand_sample(data, --i, channels, count);
+    }
+
+    return success;
+}
+
+/**
+ * Copies interleaved samples into a contiguous array per channel so that
+ * kernels reading only some channels touch less memory.
+ *
+ * @param data The samples to de-interleave.
+ * @param len The number of samples.
+ * @param[out] planar The per-channel copy of the samples.
+ *
+ * @return Success or fail.
+ */
+result_t deinterleave_samples(const sample_t *data,
+                              const size_t len,
+                              planar_samples_t *planar)
+{
+    AbortIfNot(data, fail);
+    AbortIfNot(planar, fail);
+    AbortIfNot(len <= planar->capacity, fail);
+
+    size_t i = 0;
+#ifdef __ARM_NEON
+    for (; i + 8 <= len; i += 8)
+    {
+        const int16x8x4_t channels = vld4q_s16(data[i].sample);
+        vst1q_s16(&planar->channel[0][i], channels.val[0]);
+        vst1q_s16(&planar->channel[1][i], channels.val[1]);
+        vst1q_s16(&planar->channel[2][i], channels.val[2]);
+        vst1q_s16(&planar->channel[3][i], channels.val[3]);
+    }
+#endif
+
+    for (; i < len; ++i)
+    {
+        for (size_t k = 0; k < 4; ++k)
+        {
+            planar->channel[k][i] = data[i].sample[k];
+        }
+    }
+
+    planar->len = len;
+
+    return success;
+}
+
+/**
+ * Copies a range of separated channels back into interleaved samples, the
+ * inverse of deinterleave_samples().
+ *
+ * @param planar The per-channel samples.
+ * @param start The first sample to copy.
+ * @param len The number of samples to copy.
+ * @param[out] data The interleaved samples, whose first entry receives the
+ *             sample at start.
+ *
+ * @return Success or fail.
+ */
+result_t interleave_samples(const planar_samples_t *planar,
+                            const size_t start,
+                            const size_t len,
+                            sample_t *data)
+{
+    AbortIfNot(planar, fail);
+    AbortIfNot(data, fail);
+    AbortIfNot(start + len <= planar->len, fail);
+
+    size_t i = 0;
+#ifdef __ARM_NEON
+    for (; i + 8 <= len; i += 8)
+    {
+        int16x8x4_t channels;
+        channels.val[0] = vld1q_s16(&planar->channel[0][start + i]);
+        channels.val[1] = vld1q_s16(&planar->channel[1][start + i]);
+        channels.val[2] = vld1q_s16(&planar->channel[2][start + i]);
+        channels.val[3] = vld1q_s16(&planar->channel[3][start + i]);
+        vst4q_s16(data[i].sample, channels);
+    }
+#endif
+
+    for (; i < len; ++i)
+    {
+        for (size_t k = 0; k < 4; ++k)
+        {
+            data[i].sample[k] = planar->channel[k][start + i];
+        }
+    }
+
+    return success;
+}
+
+/**
+ * Scans one channel for the first sample above a threshold and for its
+ * largest sample.
+ *
+ * @note The channel is compared sixteen samples at a time. When the maximum
+ *       is not requested the scan stops at the first crossing, and otherwise
+ *       it stops comparing against the threshold once a crossing is found.
+ *
+ * @param channel The first sample of the channel.
+ * @param stride The distance between consecutive samples of the channel.
+ * @param len The number of samples to scan.
+ * @param threshold The value that a sample must exceed.
+ * @param[out] found Set true if a sample exceeded the threshold. May be NULL
+ *             along with index to only find the maximum.
+ * @param[out] index The index of the first sample that exceeded the threshold.
+ * @param[in,out] max The largest sample, which is only raised. May be NULL.
+ *
+ * @return Success or fail.
+ */
+HOT_CODE
+result_t scan_channel(const analog_sample_t *channel,
+                      const size_t stride,
+                      const size_t len,
+                      const analog_sample_t threshold,
+                      bool *found,
+                      size_t *index,
+                      analog_sample_t *max)
+{
+    AbortIfNot(channel, fail);
+    AbortIfNot(stride, fail);
+    AbortIf((found && !index) || (index && !found), fail);
+    AbortIfNot(found || max, fail);
+
+    bool searching = (found)? true : false;
+    if (found)
+    {
+        *found = false;
+    }
+
+    size_t i = 0;
+#ifdef __ARM_NEON
+    if (stride == 4 || stride == 1)
+    {
+        const int16x8_t limit = vdupq_n_s16(threshold);
+        int16x8_t maximum = vdupq_n_s16((max)? *max : INT16_MIN);
+
+        /*
+         * A de-interleaving load starting inside a sample reads up to three
+         * values past the last sample of the block, so interleaved channels
+         * stop one sample short of the end.
+         */
+        const size_t reserve = (stride == 4)? 1 : 0;
+        for (; i + 16 + reserve <= len; i += 16)
+        {
+            int16x8_t low, high;
+            if (stride == 4)
+            {
+                low = vld4q_s16(&channel[i * 4]).val[0];
+                high = vld4q_s16(&channel[(i + 8) * 4]).val[0];
+            }
+            else
+            {
+                low = vld1q_s16(&channel[i]);
+                high = vld1q_s16(&channel[i + 8]);
+            }
+
+            if (searching)
+            {
+                const uint64x2_t crossed = vreinterpretq_u64_u16(
+                        vorrq_u16(vcgtq_s16(low, limit), vcgtq_s16(high, limit)));
+                if (vgetq_lane_u64(crossed, 0) | vgetq_lane_u64(crossed, 1))
+                {
+                    /*
+                     * Resolve the crossing within the block one sample at
+                     * a time.
+                     */
+                    size_t j = i;
+                    while (channel[j * stride] <= threshold)
+                    {
+                        j++;
+                    }
+
+                    *found = true;
+                    *index = j;
+                    searching = false;
+                    if (!max)
+                    {
+                        return success;
+                    }
+                }
+            }
+
+            maximum = vmaxq_s16(maximum, vmaxq_s16(low, high));
+        }
+
+        if (max)
+        {
+            int16x4_t reduced = vmax_s16(vget_low_s16(maximum), vget_high_s16(maximum));
+            reduced = vpmax_s16(reduced, reduced);
+            reduced = vpmax_s16(reduced, reduced);
+            *max = vget_lane_s16(reduced, 0);
+        }
+    }
+#endif
+
+    for (; i < len; ++i)
+    {
+        const analog_sample_t value = channel[i * stride];
+        if (searching && value > threshold)
+        {
+            *found = true;
+            *index = i;
+            searching = false;
+            if (!max)
+            {
+                return success;
+            }
+        }
+
+        if (max && value > *max)
+        {
+            *max = value;
+        }
+    }
+
+    return success;
+}
+
+/**
+ * The number of samples whose sums fit in the 16-bit and 32-bit lanes of the
+ * vectorized accumulation before they are widened.
+ */
+#define NORMALIZE_BLOCK_SAMPLES 8192
+
+/**
+ * Sums each channel of a number of samples, and optionally their squares and
+ * the samples at the ADC rails, in a single pass.
+ *
+ * @param data The samples to sum.
+ * @param len The number of samples.
+ * @param[out] sums The sum of each channel.
+ * @param[out] squares The sum of the squares of each channel, or NULL.
+ * @param[out] clipped The number of samples of each channel at either rail of
+ *             the ADC, or NULL. Must be specified along with squares.
+ *
+ * @return None.
+ */
+HOT_CODE
+static void sum_channels(const sample_t *data,
+                         const size_t len,
+                         int64_t sums[4],
+                         int64_t squares[4],
+                         uint32_t clipped[4])
+{
+    const bool measure = (squares && clipped)? true : false;
+    for (size_t k = 0; k < 4; ++k)
+    {
+        sums[k] = 0;
+        if (measure)
+        {
+            squares[k] = 0;
+            clipped[k] = 0;
+        }
+    }
+
+    size_t i = 0;
+#ifdef __ARM_NEON
+    const int16x8_t low_rail = vdupq_n_s16(ADC_MIN_CODE);
+    const int16x8_t high_rail = vdupq_n_s16(ADC_MAX_CODE);
+    int64x2_t square_accumulators[4] = {vdupq_n_s64(0), vdupq_n_s64(0), vdupq_n_s64(0), vdupq_n_s64(0)};
+    while (i + 8 <= len)
+    {
+        /*
+         * Each lane pairwise accumulates two samples per step, and the block
+         * is widened into 64-bit totals before the lanes can overflow.
+         */
+        const size_t block_end = (len - i > NORMALIZE_BLOCK_SAMPLES)? i + NORMALIZE_BLOCK_SAMPLES : len;
+        int32x4_t sum_accumulators[4] = {vdupq_n_s32(0), vdupq_n_s32(0), vdupq_n_s32(0), vdupq_n_s32(0)};
+        uint16x8_t clip_accumulators[4] = {vdupq_n_u16(0), vdupq_n_u16(0), vdupq_n_u16(0), vdupq_n_u16(0)};
+        for (; i + 8 <= block_end; i += 8)
+        {
+            const int16x8x4_t samples = vld4q_s16(data[i].sample);
+            for (size_t k = 0; k < 4; ++k)
+            {
+                const int16x8_t values = samples.val[k];
+                sum_accumulators[k] = vpadalq_s16(sum_accumulators[k], values);
+                if (measure)
+                {
+                    square_accumulators[k] = vpadalq_s32(square_accumulators[k],
+                            vmull_s16(vget_low_s16(values), vget_low_s16(values)));
+                    square_accumulators[k] = vpadalq_s32(square_accumulators[k],
+                            vmull_s16(vget_high_s16(values), vget_high_s16(values)));
+
+                    /*
+                     * A true comparison is all ones, so subtracting it counts
+                     * the sample.
+                     */
+                    clip_accumulators[k] = vsubq_u16(clip_accumulators[k],
+                            vorrq_u16(vcleq_s16(values, low_rail), vcgeq_s16(values, high_rail)));
+                }
+            }
+        }
+
+        for (size_t k = 0; k < 4; ++k)
+        {
+            const int64x2_t sum = vpaddlq_s32(sum_accumulators[k]);
+            sums[k] += vgetq_lane_s64(sum, 0) + vgetq_lane_s64(sum, 1);
+            if (measure)
+            {
+                const uint64x2_t count = vpaddlq_u32(vpaddlq_u16(clip_accumulators[k]));
+                clipped[k] += vgetq_lane_u64(count, 0) + vgetq_lane_u64(count, 1);
+            }
+        }
+    }
+
+    if (measure)
+    {
+        for (size_t k = 0; k < 4; ++k)
+        {
+            squares[k] = vgetq_lane_s64(square_accumulators[k], 0) +
+                         vgetq_lane_s64(square_accumulators[k], 1);
+        }
+    }
+#endif
+
+    for (; i < len; ++i)
+    {
+        for (size_t k = 0; k < 4; ++k)
+        {
+            const int32_t value = data[i].sample[k];
+            sums[k] += value;
+            if (measure)
+            {
+                squares[k] += value * value;
+                clipped[k] += (value <= ADC_MIN_CODE || value >= ADC_MAX_CODE)? 1 : 0;
+            }
+        }
+    }
+}
+
+/**
+ * Normalize a number of samples.
+ *
+ * @note This function finds the mean for each channel and subtracts it from
+ *       each measurement of the respective channel.
+ *
+ * @param data A pointer to the data to normalize.
+ * @param len The length of samples to normalize.
+ *
+ * @return Success or fail.
+ */
+result_t normalize(sample_t *data, const size_t len)
+{
+    return normalize_channels(data, len, NULL);
+}
+
+/**
+ * Subtracts the offset of each channel from a number of samples.
+ *
+ * @param data The samples to correct.
+ * @param len The number of samples to correct.
+ * @param offset The offset of each channel.
+ *
+ * @return None.
+ */
+static void subtract_channel_offsets(sample_t *data, const size_t len, const analog_sample_t offset[4])
+{
+    size_t i = 0;
+#ifdef __ARM_NEON
+    int16x8_t offsets[4];
+    for (size_t k = 0; k < 4; ++k)
+    {
+        offsets[k] = vdupq_n_s16(offset[k]);
+    }
+
+    for (; i + 8 <= len; i += 8)
+    {
+        int16x8x4_t samples = vld4q_s16(data[i].sample);
+        for (size_t k = 0; k < 4; ++k)
+        {
+            samples.val[k] = vsubq_s16(samples.val[k], offsets[k]);
+        }
+        vst4q_s16(data[i].sample, samples);
+    }
+#endif
+
+    for (; i < len; ++i)
+    {
+        for (size_t k = 0; k < 4; ++k)
+        {
+            data[i].sample[k] -= offset[k];
+        }
+    }
+}
+
+/**
+ * Removes the mean of each channel from a number of samples, and optionally
+ * measures each channel on the way.
+ *
+ * @note The statistics are gathered by the same pass that finds the means,
+ *       so they cost no extra pass over memory.
+ *
+ * @param data A pointer to the data to normalize.
+ * @param len The length of samples to normalize.
+ * @param[out] stats The offset, RMS about the offset, and clipping of each
+ *             channel before normalization, or NULL.
+ *
+ * @return Success or fail.
+ */
+result_t normalize_channels(sample_t *data, const size_t len, channel_stats_t *stats)
+{
+    AbortIfNot(data, fail);
+
+    if (stats)
+    {
+        memset(stats, 0, sizeof(*stats));
+    }
+
+    if (len == 0)
+    {
+        return success;
+    }
+
+    /*
+     * Accumulate the signed total of each channel to find the average value.
+     */
+    int64_t sums[4], squares[4];
+    uint32_t clipped[4];
+    sum_channels(data, len, sums, (stats)? squares : NULL, (stats)? clipped : NULL);
+
+    analog_sample_t offset[4];
+    for (size_t k = 0; k < 4; ++k)
+    {
+        offset[k] = sums[k] / (int64_t)len;
+    }
+
+    if (stats)
+    {
+        stats->count = len;
+        for (size_t k = 0; k < 4; ++k)
+        {
+            const double mean = (double)sums[k] / len;
+            const double variance = (double)squares[k] / len - mean * mean;
+            stats->offset[k] = offset[k];
+            stats->rms[k] = (variance > 0)? sqrt(variance) : 0;
+            stats->clipped_samples[k] = clipped[k];
+        }
+    }
+
+    /*
+     * Remove the average value from each sample.
+     */
+    subtract_channel_offsets(data, len, offset);
+
+    return success;
+}
+
+/**
+ * Normalizes the channels of a capture by the statistics already measured
+ * over it, such as those the ADC appends to its packets, so that the samples
+ * are only passed over once to remove the offsets.
+ *
+ * @param data A pointer to the data to normalize.
+ * @param len The length of samples to normalize.
+ * @param measured The statistics of the same samples before normalization.
+ *
+ * @return Success or fail.
+ */
+result_t normalize_measured_channels(sample_t *data, const size_t len, const channel_stats_t *measured)
+{
+    AbortIfNot(data, fail);
+    AbortIfNot(measured, fail);
+    AbortIfNot(measured->count == len, fail);
+
+    subtract_channel_offsets(data, len, measured->offset);
+
+    return success;
+}
+
+/**
+ * Sums one channel of a number of separated samples, and its squares and the
+ * samples at the ADC rails, in a single pass.
+ *
+ * @param channel The samples of the channel.
+ * @param len The number of samples.
+ * @param[out] sum The sum of the samples.
+ * @param[out] square The sum of their squares.
+ * @param[out] clipped The number of samples at either rail of the ADC.
+ *
+ * @return None.
+ */
+HOT_CODE
+static void sum_planar_channel(const analog_sample_t *channel,
+                               const size_t len,
+                               int64_t *sum,
+                               int64_t *square,
+                               uint32_t *clipped)
+{
+    *sum = 0;
+    *square = 0;
+    *clipped = 0;
+
+    size_t i = 0;
+#ifdef __ARM_NEON
+    const int16x8_t low_rail = vdupq_n_s16(ADC_MIN_CODE);
+    const int16x8_t high_rail = vdupq_n_s16(ADC_MAX_CODE);
+    int64x2_t square_accumulator = vdupq_n_s64(0);
+    while (i + 8 <= len)
+    {
+        const size_t block_end = (len - i > NORMALIZE_BLOCK_SAMPLES)? i + NORMALIZE_BLOCK_SAMPLES : len;
+        int32x4_t sum_accumulator = vdupq_n_s32(0);
+        uint16x8_t clip_accumulator = vdupq_n_u16(0);
+        for (; i + 8 <= block_end; i += 8)
+        {
+            const int16x8_t values = vld1q_s16(&channel[i]);
+            sum_accumulator = vpadalq_s16(sum_accumulator, values);
+            square_accumulator = vpadalq_s32(square_accumulator,
+                    vmull_s16(vget_low_s16(values), vget_low_s16(values)));
+            square_accumulator = vpadalq_s32(square_accumulator,
+                    vmull_s16(vget_high_s16(values), vget_high_s16(values)));
+            clip_accumulator = vsubq_u16(clip_accumulator,
+                    vorrq_u16(vcleq_s16(values, low_rail), vcgeq_s16(values, high_rail)));
+        }
+
+        const int64x2_t block_sum = vpaddlq_s32(sum_accumulator);
+        *sum += vgetq_lane_s64(block_sum, 0) + vgetq_lane_s64(block_sum, 1);
+        const uint64x2_t count = vpaddlq_u32(vpaddlq_u16(clip_accumulator));
+        *clipped += vgetq_lane_u64(count, 0) + vgetq_lane_u64(count, 1);
+    }
+    *square = vgetq_lane_s64(square_accumulator, 0) + vgetq_lane_s64(square_accumulator, 1);
+#endif
+
+    for (; i < len; ++i)
+    {
+        const int32_t value = channel[i];
+        *sum += value;
+        *square += value * value;
+        *clipped += (value <= ADC_MIN_CODE || value >= ADC_MAX_CODE)? 1 : 0;
+    }
+}
+
+/**
+ * Removes the mean of each channel from a number of separated samples and
+ * measures each channel on the way, as normalize_channels() does for
+ * interleaved samples.
+ *
+ * @param planar The channels to normalize.
+ * @param len The number of samples of each channel to normalize.
+ * @param[out] stats The offset, RMS about the offset, and clipping of each
+ *             channel before normalization, or NULL.
+ *
+ * @return Success or fail.
+ */
+result_t normalize_planar_channels(planar_samples_t *planar, const size_t len, channel_stats_t *stats)
+{
+    AbortIfNot(planar, fail);
+    AbortIfNot(len <= planar->len, fail);
+
+    if (stats)
+    {
+        memset(stats, 0, sizeof(*stats));
+    }
+
+    if (len == 0)
+    {
+        return success;
+    }
+
+    if (stats)
+    {
+        stats->count = len;
+    }
+
+    for (size_t k = 0; k < 4; ++k)
+    {
+        analog_sample_t *channel = planar->channel[k];
+
+        int64_t sum, square;
+        uint32_t clipped;
+        sum_planar_channel(channel, len, &sum, &square, &clipped);
+
+        const analog_sample_t offset = sum / (int64_t)len;
+        if (stats)
+        {
+            const double mean = (double)sum / len;
+            const double variance = (double)square / len - mean * mean;
+            stats->offset[k] = offset;
+            stats->rms[k] = (variance > 0)? sqrt(variance) : 0;
+            stats->clipped_samples[k] = clipped;
+        }
+
+        size_t i = 0;
+#ifdef __ARM_NEON
+        const int16x8_t offsets = vdupq_n_s16(offset);
+        for (; i + 8 <= len; i += 8)
+        {
+            vst1q_s16(&channel[i], vsubq_s16(vld1q_s16(&channel[i]), offsets));
+        }
+#endif
+
+        for (; i < len; ++i)
+        {
+            channel[i] -= offset;
+        }
+    }
+
+    return success;
+}
+
+/**
+ * The number of training cells of a CFAR detector.
+ */
+#define CFAR_TRAINING_SAMPLES (1 << CFAR_TRAINING_SHIFT)
+
+/**
+ * Prepares a CFAR detector for a new stream.
+ *
+ * @param[out] cfar The detector to prepare.
+ * @param scale The multiple of the mean level of the training cells that a
+ *        sample must exceed.
+ * @param offset The offset of the channel, which is removed before samples
+ *        are rectified.
+ *
+ * @return None.
+ */
+void init_cfar_detector(cfar_detector_t *cfar, const uint32_t scale, const analog_sample_t offset)
+{
+    cfar->scale = scale;
+    cfar->offset = offset;
+    cfar->sum = 0;
+    cfar->processed = 0;
+}
+
+/**
+ * Finds the rectified level of a sample about the offset of a channel.
+ *
+ * @param sample The sample.
+ * @param offset The offset of the channel.
+ *
+ * @return The magnitude of the sample about the offset.
+ */
+static inline uint32_t cfar_cell(const analog_sample_t sample, const analog_sample_t offset)
+{
+    const int32_t value = (int32_t)sample - offset;
+
+    return (value < 0)? -value : value;
+}
+
+/**
+ * Searches the next samples of a stream for the first that exceeds the CFAR
+ * threshold.
+ *
+ * @note The training cells are read back from the samples that precede the
+ *       chunk, so every sample of the stream searched so far must still be
+ *       in place immediately before it. No sample is tested until the
+ *       training and guard cells are filled, and the search stops at the
+ *       first crossing.
+ *
+ * @param cfar The detector of the channel.
+ * @param channel The first sample of the chunk on the channel.
+ * @param stride The distance between consecutive samples of the channel.
+ * @param len The number of samples in the chunk.
+ * @param[out] found Set true if a sample exceeded the threshold.
+ * @param[out] index The index within the chunk of the sample that exceeded
+ *             the threshold.
+ *
+ * @return Success or fail.
+ */
+HOT_CODE
+result_t run_cfar_detector(cfar_detector_t *cfar,
+                           const analog_sample_t *channel,
+                           const size_t stride,
+                           const size_t len,
+                           bool *found,
+                           size_t *index)
+{
+    AbortIfNot(cfar, fail);
+    AbortIfNot(channel, fail);
+    AbortIfNot(stride, fail);
+    AbortIfNot(found, fail);
+    AbortIfNot(index, fail);
+
+    *found = false;
+
+    /*
+     * The cells are addressed relative to the start of the stream, which
+     * lies before the chunk.
+     */
+    const analog_sample_t *stream = channel - (ptrdiff_t)(cfar->processed * stride);
+    const analog_sample_t offset = cfar->offset;
+    const uint32_t floor = CFAR_MIN_LEVEL << CFAR_TRAINING_SHIFT;
+    const size_t primed = CFAR_GUARD_SAMPLES + CFAR_TRAINING_SAMPLES;
+    uint32_t sum = cfar->sum;
+    size_t i = cfar->processed;
+    const size_t end = cfar->processed + len;
+
+    /*
+     * Fill the training cells before any sample is tested.
+     */
+    for (; i < end && i < primed; ++i)
+    {
+        if (i > CFAR_GUARD_SAMPLES)
+        {
+            sum += cfar_cell(stream[(i - CFAR_GUARD_SAMPLES - 1) * stride], offset);
+        }
+    }
+
+    for (; i < end; ++i)
+    {
+        sum += cfar_cell(stream[(i - CFAR_GUARD_SAMPLES - 1) * stride], offset);
+        if (i > primed)
+        {
+            sum -= cfar_cell(stream[(i - primed - 1) * stride], offset);
+        }
+
+        const uint32_t level = (sum > floor)? sum : floor;
+        if (cfar_cell(stream[i * stride], offset) > cfar->scale * (level >> CFAR_TRAINING_SHIFT))
+        {
+            *found = true;
+            *index = i - cfar->processed;
+            break;
+        }
+    }
+
+    cfar->sum = sum;
+    cfar->processed = i;
+
+    return success;
+}
+
+/**
+ * Finds the mean rectified level of the training cells of a CFAR detector,
+ * which tracks the noise floor of its channel.
+ *
+ * @param cfar The detector.
+ *
+ * @return The mean level, saturated to the range of a sample.
+ */
+analog_sample_t get_cfar_level(const cfar_detector_t *cfar)
+{
+    const uint32_t level = cfar->sum >> CFAR_TRAINING_SHIFT;
+
+    return (level > INT16_MAX)? INT16_MAX : (analog_sample_t)level;
+}
+
+/**
+ * The fractional bits of the reciprocal that the sums of a boxcar decimator
+ * are scaled by.
+ */
+#define BOXCAR_RECIPROCAL_SHIFT 12
+
+/**
+ * Prepares a boxcar decimator for a new stream.
+ *
+ * @param[out] decimator The decimator to prepare.
+ * @param factor The number of samples averaged into each output sample,
+ *        which is at most DUAL_RATE_MAX_DECIMATION.
+ *
+ * @return Success or fail.
+ */
+result_t init_boxcar_decimator(boxcar_decimator_t *decimator, const size_t factor)
+{
+    AbortIfNot(decimator, fail);
+    AbortIfNot(factor > 0 && factor <= DUAL_RATE_MAX_DECIMATION, fail);
+
+    decimator->factor = factor;
+    decimator->reciprocal = ((1 << BOXCAR_RECIPROCAL_SHIFT) + factor / 2) / factor;
+    for (size_t k = 0; k < 4; ++k)
+    {
+        decimator->sum[k] = 0;
+    }
+    decimator->count = 0;
+
+    return success;
+}
+
+/**
+ * Averages each run of samples of a stream into one output sample.
+ *
+ * @note The average is a low-pass filter whose first null is at the
+ *       decimated sampling frequency, which is enough ahead of a threshold
+ *       or tone detector. A run that is not complete at the end of the chunk
+ *       is completed by the next chunk.
+ *
+ * @param decimator The decimator to run.
+ * @param data The next chunk of the stream.
+ * @param len The number of samples in the chunk.
+ * @param[out] out The decimated samples.
+ * @param capacity The number of samples that out can hold.
+ * @param[out] produced The number of decimated samples.
+ *
+ * @return Success or fail if the decimated samples do not fit.
+ */
+result_t run_boxcar_decimator(boxcar_decimator_t *decimator,
+                              const sample_t *data,
+                              const size_t len,
+                              sample_t *out,
+                              const size_t capacity,
+                              size_t *produced)
+{
+    AbortIfNot(decimator, fail);
+    AbortIfNot(data || !len, fail);
+    AbortIfNot(out, fail);
+    AbortIfNot(produced, fail);
+    AbortIfNot((decimator->count + len) / decimator->factor <= capacity, fail);
+
+    const size_t factor = decimator->factor;
+    const int32_t reciprocal = decimator->reciprocal;
+    size_t count = decimator->count;
+    size_t n = 0;
+
+#ifdef __ARM_NEON
+    int32x4_t sum = vld1q_s32(decimator->sum);
+    for (size_t i = 0; i < len; ++i)
+    {
+        sum = vaddw_s16(sum, vld1_s16(data[i].sample));
+        if (++count == factor)
+        {
+            vst1_s16(out[n++].sample, vqrshrn_n_s32(vmulq_n_s32(sum, reciprocal), BOXCAR_RECIPROCAL_SHIFT));
+            sum = vdupq_n_s32(0);
+            count = 0;
+        }
+    }
+    vst1q_s32(decimator->sum, sum);
+#else
+    int32_t *sum = decimator->sum;
+    for (size_t i = 0; i < len; ++i)
+    {
+        for (size_t k = 0; k < 4; ++k)
+        {
+            sum[k] += data[i].sample[k];
+        }
+
+        if (++count == factor)
+        {
+            for (size_t k = 0; k < 4; ++k)
+            {
+                const int32_t average = (sum[k] * reciprocal + (1 << (BOXCAR_RECIPROCAL_SHIFT - 1))) >>
+                        BOXCAR_RECIPROCAL_SHIFT;
+                out[n].sample[k] = (average > INT16_MAX)? INT16_MAX :
+                                   (average < INT16_MIN)? INT16_MIN : average;
+                sum[k] = 0;
+            }
+            n++;
+            count = 0;
+        }
+    }
+#endif
+
+    decimator->count = count;
+    *produced = n;
+
+    return success;
+}
+
+/**
+ * Resets running noise estimates.
+ *
+ * @param[out] stats The estimates to reset.
+ *
+ * @return None.
+ */
+void init_noise_stats(noise_stats_t *stats)
+{
+    stats->count = 0;
+    for (size_t k = 0; k < 4; ++k)
+    {
+        stats->mean[k] = 0;
+        stats->m2[k] = 0;
+    }
+}
+
+/**
+ * Accumulates samples into the running offset and noise estimates.
+ *
+ * @note The mean and variance are updated one sample at a time, so samples
+ *       can be added in chunks without a second pass.
+ *
+ * @param stats The estimates to update.
+ * @param view The channels to read.
+ * @param start The first sample to accumulate.
+ * @param len The number of samples to accumulate.
+ *
+ * @return Success or fail.
+ */
+result_t update_noise_stats(noise_stats_t *stats,
+                            const channel_view_t *view,
+                            const size_t start,
+                            const size_t len)
+{
+    AbortIfNot(stats, fail);
+    AbortIfNot(view, fail);
+    AbortIfNot(start + len <= view->len, fail);
+
+    for (size_t i = start; i < start + len; ++i)
+    {
+        stats->count++;
+        for (size_t k = 0; k < 4; ++k)
+        {
+            const float x = view->channel[k][i * view->stride];
+            const float delta = x - stats->mean[k];
+            stats->mean[k] += delta / stats->count;
+            stats->m2[k] += delta * (x - stats->mean[k]);
+        }
+    }
+
+    return success;
+}
+
+/**
+ * Finds the noise RMS of a channel from the running estimates.
+ *
+ * @param stats The estimates to read.
+ * @param channel The channel to find the noise of.
+ *
+ * @return The standard deviation of the accumulated samples.
+ */
+float get_noise_rms(const noise_stats_t *stats, const size_t channel)
+{
+    if (stats->count < 2)
+    {
+        return 0;
+    }
+
+    return sqrtf(stats->m2[channel] / (stats->count - 1));
+}
+
+/**
+ * Removes the estimated offset of each channel from a window of samples.
+ *
+ * @param data The samples to correct.
+ * @param len The number of samples to correct.
+ * @param stats The offset estimates.
+ *
+ * @return Success or fail.
+ */
+result_t remove_offset(sample_t *data, const size_t len, const noise_stats_t *stats)
+{
+    AbortIfNot(data, fail);
+    AbortIfNot(stats, fail);
+
+    analog_sample_t offset[4];
+    for (size_t k = 0; k < 4; ++k)
+    {
+        offset[k] = lroundf(stats->mean[k]);
+    }
+
+    for (size_t i = 0; i < len; ++i)
+    {
+        for (size_t k = 0; k < 4; ++k)
+        {
+            data[i].sample[k] -= offset[k];
+        }
+    }
+
+    return success;
+}
+
+/**
+ * Removes the estimated offset of each channel from a window of separated
+ * channels.
+ *
+ * @param planar The channels to correct.
+ * @param start The first sample to correct.
+ * @param len The number of samples to correct.
+ * @param stats The offset estimates.
+ *
+ * @return Success or fail.
+ */
+result_t remove_planar_offset(planar_samples_t *planar,
+                              const size_t start,
+                              const size_t len,
+                              const noise_stats_t *stats)
+{
+    AbortIfNot(planar, fail);
+    AbortIfNot(stats, fail);
+    AbortIfNot(start + len <= planar->len, fail);
+
+    for (size_t k = 0; k < 4; ++k)
+    {
+        const analog_sample_t offset = lroundf(stats->mean[k]);
+        analog_sample_t *channel = &planar->channel[k][start];
+        for (size_t i = 0; i < len; ++i)
+        {
+            channel[i] -= offset;
+        }
+    }
+
+    return success;
+}
+
+/**
+ * Decimates a capture into the minimum and maximum of each channel over
+ * consecutive spans, so that pings remain visible at a low resolution.
+ *
+ * @param data The samples to decimate.
+ * @param len The number of samples.
+ * @param[out] points The envelope, which covers the samples in equal spans
+ *             with the remainder added to the last point.
+ * @param num_points The number of points, which may not exceed len.
+ *
+ * @return Success or fail.
+ */
+result_t compute_envelope(const sample_t *data,
+                          const size_t len,
+                          preview_point_t *points,
+                          const size_t num_points)
+{
+    AbortIfNot(data, fail);
+    AbortIfNot(points, fail);
+    AbortIfNot(num_points, fail);
+    AbortIfNot(num_points <= len, fail);
+
+    const size_t span = len / num_points;
+    for (size_t p = 0; p < num_points; ++p)
+    {
+        const size_t start = p * span;
+        const size_t end = (p == num_points - 1)? len : start + span;
+
+        preview_point_t *point = &points[p];
+        for (size_t k = 0; k < 4; ++k)
+        {
+            point->min[k] = data[start].sample[k];
+            point->max[k] = data[start].sample[k];
+        }
+
+        for (size_t i = start + 1; i < end; ++i)
+        {
+            for (size_t k = 0; k < 4; ++k)
+            {
+                const analog_sample_t value = data[i].sample[k];
+                point->min[k] = (value < point->min[k])? value : point->min[k];
+                point->max[k] = (value > point->max[k])? value : point->max[k];
+            }
+        }
+    }
+
+    return success;
+}
@@ -0,0 +1,77 @@
+#ifndef SAMPLE_OPS_H
+#define SAMPLE_OPS_H
+
+#include "stream_format.h"
+#include "types.h"
+
+result_t unpack_samples(sample_t *data, const size_t len);
+
+result_t expand_channels(sample_t *data, const size_t len, const uint32_t mask);
+
+result_t deinterleave_samples(const sample_t *data,
+                              const size_t len,
+                              planar_samples_t *planar);
+
+result_t interleave_samples(const planar_samples_t *planar,
+                            const size_t start,
+                            const size_t len,
+                            sample_t *data);
+
+result_t scan_channel(const analog_sample_t *channel,
+                      const size_t stride,
+                      const size_t len,
+                      const analog_sample_t threshold,
+                      bool *found,
+                      size_t *index,
+                      analog_sample_t *max);
+
+void init_cfar_detector(cfar_detector_t *cfar, const uint32_t scale, const analog_sample_t offset);
+
+result_t run_cfar_detector(cfar_detector_t *cfar,
+                           const analog_sample_t *channel,
+                           const size_t stride,
+                           const size_t len,
+                           bool *found,
+                           size_t *index);
+
+analog_sample_t get_cfar_level(const cfar_detector_t *cfar);
+
+result_t init_boxcar_decimator(boxcar_decimator_t *decimator, const size_t factor);
+
+result_t run_boxcar_decimator(boxcar_decimator_t *decimator,
+                              const sample_t *data,
+                              const size_t len,
+                              sample_t *out,
+                              const size_t capacity,
+                              size_t *produced);
+
+result_t normalize(sample_t *data, const size_t len);
+
+result_t normalize_channels(sample_t *data, const size_t len, channel_stats_t *stats);
+
+result_t normalize_measured_channels(sample_t *data, const size_t len, const channel_stats_t *measured);
+
+result_t normalize_planar_channels(planar_samples_t *planar, const size_t len, channel_stats_t *stats);
+
+void init_noise_stats(noise_stats_t *stats);
+
+result_t update_noise_stats(noise_stats_t *stats,
+                            const channel_view_t *view,
+                            const size_t start,
+                            const size_t len);
+
+float get_noise_rms(const noise_stats_t *stats, const size_t channel);
+
+result_t remove_offset(sample_t *data, const size_t len, const noise_stats_t *stats);
+
+result_t remove_planar_offset(planar_samples_t *planar,
+                              const size_t start,
+                              const size_t len,
+                              const noise_stats_t *stats);
+
+result_t compute_envelope(const sample_t *data,
+                          const size_t len,
+                          preview_point_t *points,
+                          const size_t num_points);
+
+#endif
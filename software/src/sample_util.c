@@ -3,205 +3,3083 @@
 #include "abort.h"
 #include "adc.h"
 #include "correlation_util.h"
+#include "cycle_counter.h"
 #include "dma.h"
+#include "network_stack.h"
+#include "sample_clock.h"
+#include "sample_ops.h"
 #include "system.h"
 #include "system_params.h"
 #include "time_util.h"
 #include "types.h"
-#include "xil_cache.h"
+
+#include <math.h>
+#include <string.h>
+
+/**
+ * Totals of every capture since boot.
+ */
+static sample_stats_t sample_stats;
+
+/**
+ * Adds the samples that the FPGA dropped during a capture to the totals.
+ *
+ * @param adc The QuadADC driver that is connected to the DMA.
+ * @param dropped_at_start The dropped sample count when the capture started.
+ * @param[out] dropped The samples dropped during the capture.
+ *
+ * @return Success or fail.
+ */
+static result_t account_dropped_samples(const adc_driver_t *adc,
+                                        const uint32_t dropped_at_start,
+                                        uint32_t *dropped)
+{
+    adc_stream_counters_t counters;
+    AbortIfNot(read_adc_stream_counters(adc, &counters), fail);
+
+    /*
+     * The count wraps, so the difference is taken modulo its width.
+     */
+    *dropped = counters.dropped_samples - dropped_at_start;
+    sample_stats.dropped_samples += *dropped;
+    sample_stats.adc_samples = counters.total_samples;
+    if (*dropped)
+    {
+        sample_stats.overrun_captures++;
+    }
+
+    return success;
+}
+
+/**
+ * Expands the packed or masked samples of consecutive packets in place.
+ *
+ * @param data The first packet.
+ * @param packets The number of packets.
+ * @param samples_per_packet The number of samples in each packet.
+ * @param packed Specified true if the samples are packed.
+ * @param channel_mask The channels that the samples carry.
+ *
+ * @return Success or fail.
+ */
+static result_t unpack_packets(sample_t *data,
+                               const size_t packets,
+                               const size_t samples_per_packet,
+                               const bool packed,
+                               const uint32_t channel_mask)
+{
+    for (size_t i = 0; i < packets; ++i)
+    {
+        sample_t *samples = &data[i * samples_per_packet + ADC_HEADER_SAMPLES];
+        if (channel_mask != ADC_ALL_CHANNELS)
+        {
+            AbortIfNot(expand_channels(samples, samples_per_packet - ADC_HEADER_SAMPLES, channel_mask), fail);
+        }
+        else if (packed)
+        {
+            AbortIfNot(unpack_samples(samples, samples_per_packet - ADC_HEADER_SAMPLES), fail);
+        }
+    }
+
+    return success;
+}
+
+/**
+ * Gets where a sample of a capture is stored.
+ *
+ * @param capture The capture.
+ * @param offset The index of the sample within the buffer of the capture.
+ *
+ * @return A pointer to the sample.
+ */
+static sample_t *capture_slot(const capture_t *capture, const size_t offset)
+{
+    if (!capture->segment_samples)
+    {
+        return &capture->data[offset];
+    }
+
+    return &capture->data[(offset / capture->segment_samples) * capture->segment_stride +
+                          offset % capture->segment_samples];
+}
+
+/**
+ * Publishes a run of contiguous packets that the DMA engine has completed.
+ *
+ * @param capture The capture that the packets belong to.
+ * @param completed The first packet.
+ * @param completed_samples The number of samples of the packets.
+ *
+ * @return Success or fail.
+ */
+static result_t publish_packets(capture_t *capture,
+                                sample_t *completed,
+                                const size_t completed_samples)
+{
+    complete_dma_buffer(capture->dma, completed, sizeof(sample_t) * completed_samples);
+    if ((capture->packed || capture->channel_mask != ADC_ALL_CHANNELS) && completed_samples)
+    {
+        AbortIfNot(unpack_packets(completed,
+                                  completed_samples / capture->samples_per_packet,
+                                  capture->samples_per_packet,
+                                  capture->packed,
+                                  capture->channel_mask), fail);
+    }
+    capture->total_samples += completed_samples;
+    sample_stats.samples_captured += completed_samples;
+
+    return success;
+}
+
+/**
+ * Ends a capture once every sample has been received.
+ *
+ * @param capture The capture.
+ *
+ * @return Success or fail.
+ */
+static result_t finish_capture(capture_t *capture)
+{
+    /*
+     * Halt the engine so the next capture starts from a clean ring.
+     */
+    AbortIfNot(reset_dma_sg_ring(capture->dma), fail);
+    capture->active = false;
+
+    uint32_t dropped = 0;
+    if (!account_dropped_samples(&capture->adc, capture->dropped_at_start, &dropped))
+    {
+        capture->error = true;
+        return fail;
+    }
+    capture->dropped_samples = dropped;
+    capture->complete = true;
+
+    return success;
+}
+
+/**
+ * Gets where one part of a packet of a split capture is written and its
+ * length. The same part of consecutive packets is contiguous.
+ *
+ * @param capture The capture, which is planar or receives trailers.
+ * @param packet The index of the packet within the capture.
+ * @param part The part of the packet: a channel of a planar packet, or the
+ *        samples and then the trailer of a packet with statistics.
+ * @param[out] dest The destination of the part.
+ * @param[out] len The length of the part in bytes.
+ *
+ * @return None.
+ */
+static void get_packet_part(const capture_t *capture,
+                            const size_t packet,
+                            const size_t part,
+                            void **dest,
+                            uint32_t *len)
+{
+    const size_t offset = packet * capture->samples_per_packet;
+    if (capture->planar)
+    {
+        *dest = &capture->planar->channel[part][offset];
+        *len = sizeof(analog_sample_t) * capture->samples_per_packet;
+    }
+    else if (part == 0)
+    {
+        *dest = &capture->data[offset];
+        *len = sizeof(sample_t) * capture->samples_per_packet;
+    }
+    else
+    {
+        *dest = &capture->trailers[packet];
+        *len = sizeof(adc_packet_trailer_t);
+    }
+}
+
+/**
+ * Services an in-flight split capture, whose packets are each written
+ * through one descriptor per part: per channel for a planar packet, or for
+ * the samples and the trailer of a packet with statistics.
+ *
+ * @note A packet is only received once the descriptor of its last part
+ *       completes. A descriptor whose part is not filled ends a short
+ *       packet, so the ring is reset and the packet is recorded again from
+ *       its first part.
+ *
+ * @param capture The capture to service.
+ *
+ * @return Success or fail.
+ */
+static result_t service_split_capture(capture_t *capture)
+{
+    dma_engine_t *dma = capture->dma;
+    const size_t samples_per_packet = capture->samples_per_packet;
+    const size_t parts = capture->packet_parts;
+
+    size_t completed_samples = 0;
+    bool short_packet = false;
+    while (1)
+    {
+        bool complete;
+        void *dest;
+        uint32_t len;
+        if (!reclaim_dma_descriptor(dma, &complete, &dest, &len))
+        {
+            capture->error = true;
+            capture->active = false;
+            return fail;
+        }
+
+        if (!complete)
+        {
+            break;
+        }
+
+        capture->last_progress = get_system_time();
+        if (capture->total_samples == 0 && completed_samples == 0 && capture->packet_part == 0)
+        {
+            capture->first_packet_time = capture->last_progress;
+        }
+
+        void *expected_dest;
+        uint32_t part_bytes;
+        get_packet_part(capture,
+                        (capture->total_samples + completed_samples) / samples_per_packet,
+                        capture->packet_part,
+                        &expected_dest,
+                        &part_bytes);
+        if (len != part_bytes)
+        {
+            capture->invalid_packets++;
+            sample_stats.short_packets++;
+            short_packet = true;
+            break;
+        }
+
+        if (++capture->packet_part == parts)
+        {
+            capture->packet_part = 0;
+            completed_samples += samples_per_packet;
+        }
+    }
+
+    /*
+     * The packets received in this pass are contiguous in every part.
+     */
+    if (completed_samples)
+    {
+        const size_t packets = completed_samples / samples_per_packet;
+        for (size_t part = 0; part < parts; ++part)
+        {
+            void *dest;
+            uint32_t part_bytes;
+            get_packet_part(capture, capture->total_samples / samples_per_packet, part, &dest, &part_bytes);
+            complete_dma_buffer(dma, dest, packets * part_bytes);
+        }
+        capture->total_samples += completed_samples;
+        sample_stats.samples_captured += completed_samples;
+    }
+
+    if (short_packet)
+    {
+        AbortIfNot(reset_dma_sg_ring(dma), fail);
+        capture->packet_part = 0;
+        capture->queued_samples = capture->total_samples;
+    }
+
+    if (capture->total_samples >= capture->sample_count)
+    {
+        if (capture->planar)
+        {
+            capture->planar->len = capture->total_samples;
+        }
+        return finish_capture(capture);
+    }
+
+    size_t packets = (capture->sample_count - capture->queued_samples) / samples_per_packet;
+    if (packets > get_dma_free_descriptors(dma) / parts)
+    {
+        packets = get_dma_free_descriptors(dma) / parts;
+    }
+
+    if (packets)
+    {
+        const size_t first = capture->queued_samples / samples_per_packet;
+        for (size_t part = 0; part < parts; ++part)
+        {
+            void *dest;
+            uint32_t part_bytes;
+            get_packet_part(capture, first, part, &dest, &part_bytes);
+            prepare_dma_buffer(dma, dest, packets * part_bytes);
+        }
+
+        for (size_t i = 0; i < packets; ++i)
+        {
+            for (size_t part = 0; part < parts; ++part)
+            {
+                void *dest;
+                uint32_t part_bytes;
+                get_packet_part(capture, first + i, part, &dest, &part_bytes);
+                AbortIfNot(queue_dma_descriptor(dma, dest, part_bytes), fail);
+            }
+            capture->queued_samples += samples_per_packet;
+        }
+    }
+
+    return success;
+}
+
+/**
+ * Services an in-flight capture by reclaiming completed descriptors and
+ * queueing the remainder of the destination buffer.
+ *
+ * @note If a short packet is received, the ring is reset and recording resumes
+ *       at the location of the short packet, matching the behavior of the
+ *       simple-mode recording. Packed and masked packets occupy the start of their
+ *       place in the buffer until they are expanded. A circular capture
+ *       queues the start of its buffer again once the end has been queued,
+ *       and a segmented capture queues each segment after the gap that
+ *       precedes it.
+ *
+ * @param capture The capture to service.
+ *
+ * @return Success or fail.
+ */
+result_t service_capture(capture_t *capture)
+{
+    AbortIfNot(capture, fail);
+
+    if (!capture->active)
+    {
+        return success;
+    }
+
+    if (capture->packet_parts > 1)
+    {
+        return service_split_capture(capture);
+    }
+
+    dma_engine_t *dma = capture->dma;
+    const uint32_t packet_bytes = capture->packet_bytes;
+    const uint32_t slot_bytes = sizeof(sample_t) * capture->samples_per_packet;
+
+    /*
+     * Completed packets are contiguous, apart from where a circular capture
+     * wraps, so the cache maintenance for every run of packets reclaimed in
+     * this pass is performed once before the samples are published.
+     */
+    sample_t *completed = NULL;
+    size_t completed_samples = 0;
+    bool short_packet = false;
+
+    while (1)
+    {
+        bool complete;
+        void *dest;
+        uint32_t len;
+        if (!reclaim_dma_descriptor(dma, &complete, &dest, &len))
+        {
+            capture->error = true;
+            capture->active = false;
+            return fail;
+        }
+
+        if (!complete)
+        {
+            break;
+        }
+
+        capture->last_progress = get_system_time();
+        if (capture->total_samples == 0 && !completed)
+        {
+            capture->first_packet_time = capture->last_progress;
+        }
+
+        if (completed && (sample_t *)dest != &completed[completed_samples])
+        {
+            AbortIfNot(publish_packets(capture, completed, completed_samples), fail);
+            completed = NULL;
+            completed_samples = 0;
+        }
+
+        if (!completed)
+        {
+            completed = (sample_t *)dest;
+        }
+
+        if (len == packet_bytes)
+        {
+            completed_samples += capture->samples_per_packet;
+        }
+        else
+        {
+            capture->invalid_packets++;
+            sample_stats.short_packets++;
+            short_packet = true;
+            break;
+        }
+    }
+
+    AbortIfNot(publish_packets(capture, completed, completed_samples), fail);
+
+    if (short_packet)
+    {
+        /*
+         * A short packet breaks the contiguity of every descriptor that was
+         * queued behind it. Reset the ring and record again into the location
+         * of the short packet.
+         */
+        AbortIfNot(reset_dma_sg_ring(dma), fail);
+        capture->queued_samples = capture->total_samples;
+    }
+
+    if (!capture->circular && capture->total_samples >= capture->sample_count)
+    {
+        return finish_capture(capture);
+    }
+
+    /*
+     * Keep every free descriptor queued so that the DMA engine always has
+     * a destination for the next packet. The buffers of the whole segment
+     * are prepared together before any of them is handed to the engine.
+     */
+    size_t packets = (capture->circular)? get_dma_free_descriptors(dma) :
+            (capture->sample_count - capture->queued_samples) / capture->samples_per_packet;
+    if (packets > get_dma_free_descriptors(dma))
+    {
+        packets = get_dma_free_descriptors(dma);
+    }
+
+    while (packets)
+    {
+        const size_t offset = (capture->circular)?
+                capture->queued_samples % capture->sample_count : capture->queued_samples;
+        size_t segment_packets = (capture->sample_count - offset) / capture->samples_per_packet;
+        if (capture->segment_samples)
+        {
+            segment_packets = (capture->segment_samples - offset % capture->segment_samples) /
+                    capture->samples_per_packet;
+        }
+        if (segment_packets > packets)
+        {
+            segment_packets = packets;
+        }
+
+        sample_t *segment = capture_slot(capture, offset);
+        prepare_dma_buffer(dma, segment, segment_packets * slot_bytes);
+        for (size_t i = 0; i < segment_packets; ++i)
+        {
+            AbortIfNot(queue_dma_descriptor(dma,
+                                            &segment[i * capture->samples_per_packet],
+                                            packet_bytes), fail);
+            capture->queued_samples += capture->samples_per_packet;
+        }
+
+        packets -= segment_packets;
+    }
+
+    return success;
+}
+
+/**
+ * DMA completion callback that services the capture in interrupt context.
+ *
+ * @param dma The DMA engine that completed a descriptor.
+ * @param arg The capture being recorded.
+ *
+ * @return None.
+ */
+static void capture_dma_callback(dma_engine_t *dma, void *arg)
+{
+    service_capture((capture_t *)arg);
+}
+
+/**
+ * Begins an asynchronous capture with interrupts masked.
+ *
+ * @param[out] capture The capture to start.
+ * @param dma A pointer to the AXI DMA driver with an initialized ring.
+ * @param data A pointer to where analog samples should be stored.
+ * @param sample_count The number of samples to take, or the length of the
+ *        ring of a circular capture.
+ * @param adc The QuadADC driver that is connected to the DMA.
+ * @param circular Specified true to record into data as a ring until the
+ *        capture is aborted.
+ * @param layout The layout of a segmented capture, whose first segment is
+ *        data, or NULL if the samples are contiguous.
+ * @param planar The channels to record a planar capture into in place of
+ *        data, or NULL to record interleaved samples.
+ * @param trailers Storage for the statistics trailer of each packet, or NULL
+ *        if the packets have none.
+ *
+ * @return Success or fail.
+ */
+static result_t begin_capture(capture_t *capture,
+                              dma_engine_t *dma,
+                              sample_t *data,
+                              const size_t sample_count,
+                              const adc_driver_t adc,
+                              const bool circular,
+                              const segmented_layout_t *layout,
+                              planar_samples_t *planar,
+                              adc_packet_trailer_t *trailers)
+{
+    AbortIfNot(capture, fail);
+    AbortIfNot(dma, fail);
+    AbortIfNot(dma->ring.descriptors, fail);
+    AbortIfNot(data || planar, fail);
+    AbortIfNot(adc.regs, fail);
+    AbortIfNot(sample_count > 0, fail);
+    AbortIfNot(sample_count % adc.regs->samples_per_packet == 0, fail);
+
+    /*
+     * Every channel of a planar packet takes a descriptor, as does the
+     * trailer of a packet with statistics, so the ring must hold at least
+     * one whole packet.
+     */
+    const size_t packet_parts = (planar)? 4 : (trailers)? 2 : 1;
+    if (packet_parts > 1)
+    {
+        AbortIf(circular || layout, fail);
+        AbortIf(planar && trailers, fail);
+        AbortIfNot(dma->ring.count >= packet_parts, fail);
+    }
+    if (planar)
+    {
+        AbortIfNot(adc_packets_planar(&adc), fail);
+        AbortIfNot(sample_count <= planar->capacity, fail);
+    }
+    if (trailers)
+    {
+        AbortIfNot(data, fail);
+    }
+
+    /*
+     * A trailer has no place among the samples, so packets with statistics
+     * are only received through their own descriptors.
+     */
+    AbortIfNot(adc_packets_have_stats(&adc) == (trailers != NULL), fail);
+
+    /*
+     * Samples are dropped whenever no capture is draining the FIFO, so only
+     * those dropped while the capture runs are counted against it.
+     */
+    adc_stream_counters_t counters;
+    AbortIfNot(read_adc_stream_counters(&adc, &counters), fail);
+
+    capture->dma = dma;
+    capture->adc = adc;
+    capture->dropped_at_start = counters.dropped_samples;
+    capture->dropped_samples = 0;
+    capture->data = data;
+    capture->sample_count = sample_count;
+    capture->samples_per_packet = adc.regs->samples_per_packet;
+    capture->circular = circular;
+    capture->segment_samples = (layout)? layout->segment_samples : 0;
+    capture->segment_stride = (layout)? layout->stride_bytes / sizeof(sample_t) : 0;
+    capture->packet_bytes = get_adc_packet_bytes(&adc, capture->samples_per_packet);
+    capture->packed = adc_samples_packed(&adc);
+    capture->channel_mask = get_adc_channel_mask(&adc);
+    capture->planar = planar;
+    capture->trailers = trailers;
+    capture->packet_parts = packet_parts;
+    capture->packet_part = 0;
+    capture->queued_samples = 0;
+    capture->total_samples = 0;
+    capture->invalid_packets = 0;
+    capture->complete = false;
+    capture->error = false;
+    capture->start_time = get_system_time();
+    capture->first_packet_time = capture->start_time;
+    capture->last_progress = capture->start_time;
+    capture->timeout = ms_to_ticks(500);
+
+    if (dma->interrupts_enabled)
+    {
+        AbortIfNot(set_dma_callback(dma, capture_dma_callback, capture), fail);
+    }
+
+    capture->active = true;
+
+    return service_capture(capture);
+}
+
+/**
+ * Begins an asynchronous capture without unmasking interrupts, so that a
+ * capture can be started from an interrupt handler.
+ *
+ * @note Interrupts must already be masked, as they are within a handler.
+ *
+ * @param[out] capture The capture to start.
+ * @param dma A pointer to the AXI DMA driver with an initialized ring.
+ * @param data A pointer to where analog samples should be stored.
+ * @param sample_count The number of samples to take.
+ * @param adc The QuadADC driver that is connected to the DMA.
+ *
+ * @return Success or fail.
+ */
+result_t start_capture_from_interrupt(capture_t *capture,
+                                      dma_engine_t *dma,
+                                      sample_t *data,
+                                      const size_t sample_count,
+                                      const adc_driver_t adc)
+{
+    return begin_capture(capture, dma, data, sample_count, adc, false, NULL, NULL, NULL);
+}
+
+/**
+ * Begins an asynchronous capture through the scatter-gather descriptor ring.
+ *
+ * @note When DMA interrupts are enabled, the capture is serviced from the
+ *       completion interrupt and runs in the background. Otherwise,
+ *       service_capture() must be called periodically.
+ *
+ * @param[out] capture The capture to start.
+ * @param dma A pointer to the AXI DMA driver with an initialized ring.
+ * @param data A pointer to where analog samples should be stored.
+ * @param sample_count The number of samples to take.
+ * @param adc The QuadADC driver that is connected to the DMA.
+ *
+ * @return Success or fail.
+ */
+result_t start_capture(capture_t *capture,
+                       dma_engine_t *dma,
+                       sample_t *data,
+                       const size_t sample_count,
+                       const adc_driver_t adc)
+{
+    /*
+     * Prime the ring. Interrupts are masked while the ring is being filled
+     * so that the completion handler does not race the initial queueing.
+     */
+    set_interrupts(false);
+    const result_t ret = start_capture_from_interrupt(capture, dma, data, sample_count, adc);
+    set_interrupts(true);
+
+    return ret;
+}
+
+/**
+ * Begins a capture that records into a ring of samples until it is aborted.
+ *
+ * @note Samples are overwritten a ring length after they were recorded, and
+ *       the DMA engine writes up to a descriptor ring of packets ahead of the
+ *       samples that have been received. The capture never completes, so it
+ *       must be ended by abort_capture().
+ *
+ * @param[out] capture The capture to start.
+ * @param dma A pointer to the AXI DMA driver with an initialized ring.
+ * @param ring A pointer to the ring of samples.
+ * @param ring_len The number of samples of the ring, a whole number of
+ *        packets.
+ * @param adc The QuadADC driver that is connected to the DMA.
+ *
+ * @return Success or fail.
+ */
+result_t start_ring_capture(capture_t *capture,
+                            dma_engine_t *dma,
+                            sample_t *ring,
+                            const size_t ring_len,
+                            const adc_driver_t adc)
+{
+    set_interrupts(false);
+    const result_t ret = begin_capture(capture, dma, ring, ring_len, adc, true, NULL, NULL, NULL);
+    set_interrupts(true);
+
+    return ret;
+}
+
+/**
+ * Divides a buffer into segments that are each preceded by reserved bytes.
+ *
+ * @note The reserved bytes are placed at the end of each gap, directly ahead
+ *       of the samples, and every segment starts on a cache line so that
+ *       writes to a gap are not lost when the segment after it is recorded.
+ *
+ * @param[out] layout The layout.
+ * @param buffer The buffer, aligned to a cache line.
+ * @param bytes The length of the buffer in bytes.
+ * @param segment_samples The number of samples of each segment.
+ * @param reserved_bytes The number of bytes to reserve ahead of each segment.
+ *
+ * @return Success or fail if not even one segment fits.
+ */
+result_t init_segmented_layout(segmented_layout_t *layout,
+                               void *buffer,
+                               const size_t bytes,
+                               const size_t segment_samples,
+                               const size_t reserved_bytes)
+{
+    AbortIfNot(layout, fail);
+    AbortIfNot(buffer, fail);
+    AbortIfNot((uintptr_t)buffer % CACHE_LINE_BYTES == 0, fail);
+    AbortIfNot(segment_samples, fail);
+
+    const size_t segment_bytes = segment_samples * sizeof(sample_t);
+    layout->base = buffer;
+    layout->segment_samples = segment_samples;
+    layout->gap_bytes = (reserved_bytes + CACHE_LINE_BYTES - 1) / CACHE_LINE_BYTES * CACHE_LINE_BYTES;
+    layout->stride_bytes = layout->gap_bytes +
+            (segment_bytes + CACHE_LINE_BYTES - 1) / CACHE_LINE_BYTES * CACHE_LINE_BYTES;
+    layout->num_segments = bytes / layout->stride_bytes;
+    AbortIfNot(layout->num_segments, fail);
+
+    return success;
+}
+
+/**
+ * Gets the samples of a segment of a layout.
+ *
+ * @param layout The layout.
+ * @param segment The index of the segment.
+ *
+ * @return A pointer to the first sample of the segment.
+ */
+sample_t *get_layout_segment(const segmented_layout_t *layout, const size_t segment)
+{
+    return (sample_t *)&layout->base[segment * layout->stride_bytes + layout->gap_bytes];
+}
+
+/**
+ * Begins a capture into the segments of a layout, skipping the gap ahead of
+ * each segment.
+ *
+ * @note Each segment must be a whole number of packets, so that no packet
+ *       straddles a gap.
+ *
+ * @param[out] capture The capture to start.
+ * @param dma A pointer to the AXI DMA driver with an initialized ring.
+ * @param layout The layout to record into.
+ * @param sample_count The number of samples to take, at most the samples of
+ *        every segment of the layout.
+ * @param adc The QuadADC driver that is connected to the DMA.
+ *
+ * @return Success or fail.
+ */
+result_t start_segmented_capture(capture_t *capture,
+                                 dma_engine_t *dma,
+                                 const segmented_layout_t *layout,
+                                 const size_t sample_count,
+                                 const adc_driver_t adc)
+{
+    AbortIfNot(layout, fail);
+    AbortIfNot(adc.regs, fail);
+    AbortIfNot(layout->segment_samples % adc.regs->samples_per_packet == 0, fail);
+    AbortIfNot(layout->stride_bytes % sizeof(sample_t) == 0, fail);
+    AbortIfNot(sample_count <= layout->num_segments * layout->segment_samples, fail);
+
+    set_interrupts(false);
+    const result_t ret = begin_capture(capture,
+                                       dma,
+                                       get_layout_segment(layout, 0),
+                                       sample_count,
+                                       adc,
+                                       false,
+                                       layout,
+                                       NULL,
+                                       NULL);
+    set_interrupts(true);
+
+    return ret;
+}
+
+/**
+ * Begins a capture whose packets are recorded into a separate buffer per
+ * channel through the descriptor ring.
+ *
+ * @note The stream must be sending planar packets, which the FPGA transposes
+ *       so that the DMA engine writes each channel of a packet through its
+ *       own descriptor. The channels are then never separated by the
+ *       processor.
+ *
+ * @param[out] capture The capture to start.
+ * @param dma A pointer to the AXI DMA driver with an initialized ring.
+ * @param planar The channels to record into, whose length is set once the
+ *        capture completes.
+ * @param sample_count The number of samples to take.
+ * @param adc The QuadADC driver that is connected to the DMA.
+ *
+ * @return Success or fail.
+ */
+result_t start_planar_capture(capture_t *capture,
+                              dma_engine_t *dma,
+                              planar_samples_t *planar,
+                              const size_t sample_count,
+                              const adc_driver_t adc)
+{
+    AbortIfNot(planar, fail);
+
+    set_interrupts(false);
+    const result_t ret = begin_capture(capture, dma, NULL, sample_count, adc, false, NULL, planar, NULL);
+    set_interrupts(true);
+
+    return ret;
+}
+
+/**
+ * Begins a capture that keeps the statistics trailer of each packet, which
+ * the DMA engine writes apart from the samples through a descriptor of its
+ * own.
+ *
+ * @note The stream must be appending statistics to its packets. The samples
+ *       land in data as they would without the trailers.
+ *
+ * @param[out] capture The capture to start.
+ * @param dma A pointer to the AXI DMA driver with an initialized ring.
+ * @param data A pointer to where analog samples should be stored.
+ * @param trailers Storage for the trailer of every packet of the capture.
+ * @param sample_count The number of samples to take.
+ * @param adc The QuadADC driver that is connected to the DMA.
+ *
+ * @return Success or fail.
+ */
+result_t start_stats_capture(capture_t *capture,
+                             dma_engine_t *dma,
+                             sample_t *data,
+                             adc_packet_trailer_t *trailers,
+                             const size_t sample_count,
+                             const adc_driver_t adc)
+{
+    AbortIfNot(trailers, fail);
+
+    set_interrupts(false);
+    const result_t ret = begin_capture(capture, dma, data, sample_count, adc, false, NULL, NULL, trailers);
+    set_interrupts(true);
+
+    return ret;
+}
+
+/**
+ * Checks if a capture has finished.
+ *
+ * @param capture The capture to check.
+ *
+ * @return True if the capture is complete or has failed.
+ */
+bool capture_done(capture_t *capture)
+{
+    return (!capture || capture->complete || capture->error)? true : false;
+}
+
+/**
+ * Blocks until a capture completes.
+ *
+ * @param capture The capture to wait for.
+ *
+ * @return Success or fail.
+ */
+result_t wait_for_capture(capture_t *capture)
+{
+    AbortIfNot(capture, fail);
+    AbortIfNot(capture->dma, fail);
+
+    while (!capture_done(capture))
+    {
+        if (!capture->dma->interrupts_enabled)
+        {
+            AbortIfNot(service_capture(capture), fail);
+        }
+
+        if (get_system_time() - capture->last_progress > capture->timeout)
+        {
+            AbortIfNot(abort_capture(capture), fail);
+            AbortIfNot(false, fail);
+        }
+
+        dispatch_network_stack();
+
+        /*
+         * Sleep until the next packet completes rather than spinning.
+         */
+        if (capture->dma->interrupts_enabled && !capture_done(capture))
+        {
+            wait_for_interrupt();
+        }
+    }
+
+    AbortIf(capture->error, fail);
+
+    return success;
+}
+
+/**
+ * Stops an in-flight capture and returns the descriptor ring to software.
+ *
+ * @param capture The capture to stop.
+ *
+ * @return Success or fail.
+ */
+result_t abort_capture(capture_t *capture)
+{
+    AbortIfNot(capture, fail);
+
+    if (capture->active)
+    {
+        set_interrupts(false);
+        capture->active = false;
+        const result_t ret = reset_dma_sg_ring(capture->dma);
+        set_interrupts(true);
+        AbortIfNot(ret, fail);
+    }
+
+    return success;
+}
+
+/**
+ * Records a number of analog samples using the scatter-gather descriptor ring.
+ *
+ * @param dma A pointer to the AXI DMA driver with an initialized ring.
+ * @param data A pointer to where analog samples should be stored.
+ * @param sample_count The number of samples to take.
+ * @param adc The QuadADC driver that is connected to the DMA.
+ *
+ * @return Success or fail.
+ */
+static result_t record_sg(dma_engine_t *dma,
+                          sample_t *data,
+                          const size_t sample_count,
+                          const adc_driver_t adc)
+{
+    capture_t capture;
+    result_t ret = start_capture(&capture, dma, data, sample_count, adc);
+    if (ret == success)
+    {
+        ret = wait_for_capture(&capture);
+    }
+
+    /*
+     * The capture lives on the stack, so detach it from the interrupt handler
+     * before returning.
+     */
+    AbortIfNot(set_dma_callback(dma, NULL, NULL), fail);
+
+    return ret;
+}
+
+/**
+ * Records a number of analog samples.
+ *
+ * @note Samples that the FPGA drops while recording are counted in the
+ *       sample statistics.
+ *
+ * @param dma A pointer to the AXI DMA driver to use for sample acquisition.
+ * @param data A pointer to where analog samples should be stored.
+ * @param sample_count The number of samples to take.
+ * @param adc The QuadADC driver that is connected to the DMA.
+ *
+ * @return Success or fail.
+ */
+result_t record(dma_engine_t *dma,
+                sample_t *data,
+                const size_t sample_count,
+                const adc_driver_t adc)
+{
+    AbortIfNot(dma, fail);
+    AbortIfNot(data, fail);
+    AbortIfNot(adc.regs, fail);
+    AbortIfNot(sample_count % adc.regs->samples_per_packet == 0, fail);
+    AbortIf(adc_packets_have_stats(&adc), fail);
+
+    if (dma->ring.descriptors)
+    {
+        return record_sg(dma, data, sample_count, adc);
+    }
+
+    /*
+     * Write back the cache lines of the whole destination once before
+     * allowing DMA to avoid any corruption when we later invalidate them.
+     * Packets that are too short are recorded again in place, so the
+     * destination is not read until every packet has arrived.
+     */
+    const size_t samples_per_packet = adc.regs->samples_per_packet;
+    const uint32_t packet_bytes = get_adc_packet_bytes(&adc, samples_per_packet);
+    prepare_dma_buffer(dma, data, sizeof(sample_t) * sample_count);
+
+    adc_stream_counters_t counters;
+    AbortIfNot(read_adc_stream_counters(&adc, &counters), fail);
+
+    size_t total_samples = 0;
+    while (total_samples < sample_count)
+    {
+        AbortIfNot(init_dma_transfer(dma, &data[total_samples], packet_bytes), fail);
+        AbortIfNot(wait_for_dma_transfer(dma), fail);
+
+        if (dma->regs->S2MM_LENGTH == packet_bytes)
+        {
+            total_samples += samples_per_packet;
+            sample_stats.samples_captured += samples_per_packet;
+        }
+        else
+        {
+            sample_stats.short_packets++;
+        }
+    }
+
+    /*
+     * Invalidate cache lines associated with data samples. Beware that this
+     * can potentially wipe out cached values stored _around_ the buffer we
+     * are invalidating, so it was written back earlier using a cache flush
+     * operation.
+     */
+    complete_dma_buffer(dma, data, sizeof(sample_t) * sample_count);
+    const bool packed = adc_samples_packed(&adc);
+    const uint32_t channel_mask = get_adc_channel_mask(&adc);
+    if (packed || channel_mask != ADC_ALL_CHANNELS)
+    {
+        AbortIfNot(unpack_packets(data,
+                                  sample_count / samples_per_packet,
+                                  samples_per_packet,
+                                  packed,
+                                  channel_mask), fail);
+    }
+
+    uint32_t dropped;
+    AbortIfNot(account_dropped_samples(&adc, counters.dropped_samples, &dropped), fail);
+
+    return success;
+}
+
+/**
+ * Records a number of analog samples into the segments of a layout.
+ *
+ * @note Only the descriptor ring can skip the gaps, so the DMA engine must
+ *       have one.
+ *
+ * @param dma A pointer to the AXI DMA driver to use for sample acquisition.
+ * @param layout The layout to record into.
+ * @param sample_count The number of samples to take.
+ * @param adc The QuadADC driver that is connected to the DMA.
+ *
+ * @return Success or fail.
+ */
+result_t record_segmented(dma_engine_t *dma,
+                          const segmented_layout_t *layout,
+                          const size_t sample_count,
+                          const adc_driver_t adc)
+{
+    AbortIfNot(dma, fail);
+    AbortIfNot(dma->ring.descriptors, fail);
+
+    capture_t capture;
+    result_t ret = start_segmented_capture(&capture, dma, layout, sample_count, adc);
+    if (ret == success)
+    {
+        ret = wait_for_capture(&capture);
+    }
+
+    AbortIfNot(set_dma_callback(dma, NULL, NULL), fail);
+
+    return ret;
+}
+
+/**
+ * Records a number of analog samples into a separate buffer per channel.
+ *
+ * @param dma A pointer to the AXI DMA driver with an initialized ring.
+ * @param planar The channels to record into.
+ * @param sample_count The number of samples to take.
+ * @param adc The QuadADC driver that is connected to the DMA, which must be
+ *        sending planar packets.
+ *
+ * @return Success or fail.
+ */
+result_t record_planar(dma_engine_t *dma,
+                       planar_samples_t *planar,
+                       const size_t sample_count,
+                       const adc_driver_t adc)
+{
+    AbortIfNot(dma, fail);
+    AbortIfNot(dma->ring.descriptors, fail);
+
+    capture_t capture;
+    result_t ret = start_planar_capture(&capture, dma, planar, sample_count, adc);
+    if (ret == success)
+    {
+        ret = wait_for_capture(&capture);
+    }
+
+    AbortIfNot(set_dma_callback(dma, NULL, NULL), fail);
+
+    return ret;
+}
+
+/**
+ * Records a number of analog samples and the statistics trailer of each of
+ * their packets.
+ *
+ * @param dma A pointer to the AXI DMA driver with an initialized ring.
+ * @param data A pointer to where analog samples should be stored.
+ * @param trailers Storage for the trailer of every packet.
+ * @param sample_count The number of samples to take.
+ * @param adc The QuadADC driver that is connected to the DMA, which must be
+ *        appending statistics to its packets.
+ *
+ * @return Success or fail.
+ */
+result_t record_with_stats(dma_engine_t *dma,
+                           sample_t *data,
+                           adc_packet_trailer_t *trailers,
+                           const size_t sample_count,
+                           const adc_driver_t adc)
+{
+    AbortIfNot(dma, fail);
+    AbortIfNot(dma->ring.descriptors, fail);
+
+    capture_t capture;
+    result_t ret = start_stats_capture(&capture, dma, data, trailers, sample_count, adc);
+    if (ret == success)
+    {
+        ret = wait_for_capture(&capture);
+    }
+
+    AbortIfNot(set_dma_callback(dma, NULL, NULL), fail);
+
+    return ret;
+}
+
+/**
+ * Gets the totals of every capture since boot.
+ *
+ * @param[out] stats The totals.
+ *
+ * @return None.
+ */
+void get_sample_stats(sample_stats_t *stats)
+{
+    *stats = sample_stats;
+}
+
+/**
+ * Initializes storage for hardware sample timestamps.
+ *
+ * @param[out] timing The timing record to initialize.
+ * @param timestamps Storage for one timestamp per packet.
+ * @param max_packets The number of entries in the timestamp storage.
+ *
+ * @return Success or fail.
+ */
+result_t init_sample_timing(sample_timing_t *timing,
+                            uint64_t *timestamps,
+                            const size_t max_packets)
+{
+    AbortIfNot(timing, fail);
+    AbortIfNot(timestamps, fail);
+    AbortIfNot(max_packets, fail);
+
+    timing->timestamps = timestamps;
+    timing->max_packets = max_packets;
+    timing->packets = 0;
+    timing->samples_per_packet = 0;
+    timing->sequence = 0;
+    timing->discontinuities = 0;
+    timing->dropped_samples = 0;
+    timing->lost_packets = 0;
+    timing->overrun_packets = 0;
+    timing->anchor_tick = 0;
+    timing->anchor_sample = 0;
+    timing->clock.sampling_frequency = 0;
+
+    return success;
+}
+
+/**
+ * Precomputes the conversions used to time the samples of a sampling
+ * frequency.
+ *
+ * @param timing The timing record.
+ * @param sampling_frequency The sampling frequency of acquisition.
+ *
+ * @return Success or fail.
+ */
+result_t set_sample_timing_rate(sample_timing_t *timing, const uint32_t sampling_frequency)
+{
+    AbortIfNot(timing, fail);
+    AbortIfNot(init_sample_clock(&timing->clock, sampling_frequency), fail);
+
+    return success;
+}
+
+/**
+ * Begins recovering timestamps for a new capture.
+ *
+ * @param timing The timing record to reset.
+ * @param samples_per_packet The number of samples in each packet.
+ *
+ * @return Success or fail.
+ */
+static result_t begin_timestamps(sample_timing_t *timing,
+                                 const size_t samples_per_packet)
+{
+    AbortIfNot(timing, fail);
+    AbortIfNot(timing->timestamps, fail);
+    AbortIfNot(samples_per_packet >= ADC_HEADER_SAMPLES, fail);
+
+    timing->packets = 0;
+    timing->samples_per_packet = samples_per_packet;
+    timing->discontinuities = 0;
+    timing->dropped_samples = 0;
+    timing->lost_packets = 0;
+    timing->overrun_packets = 0;
+
+    return success;
+}
+
+/**
+ * Recovers the word embedded in the upper two bits of every channel over
+ * eight samples and strips it from the sample data.
+ *
+ * @param samples The first of the samples. The embedded bits are cleared in
+ *        place.
+ *
+ * @return The embedded word.
+ */
+static uint64_t strip_embedded_word(sample_t *samples)
+{
+    uint64_t word = 0;
+    for (size_t i = 0; i < 8; ++i)
+    {
+        uint64_t byte = 0;
+        for (size_t k = 0; k < 4; ++k)
+        {
+            const uint16_t value = samples[i].sample[k];
+            byte |= ((value >> 14) & 0x3) << (2 * k);
+            samples[i].sample[k] = value & ADC_SAMPLE_MASK;
+        }
+
+        word |= byte << (8 * i);
+    }
+
+    return word;
+}
+
+/**
+ * Recovers the timestamp and header of one packet and strips them from the
+ * sample data.
+ *
+ * @param timing The timing record to fill.
+ * @param packet The first sample of the packet. Timestamp bits are cleared in
+ *        place.
+ * @param slot The entry of the timestamps that the packet is recorded in.
+ * @param previous The entry of the packet before it, or SIZE_MAX if it is the
+ *        first packet.
+ *
+ * @return None.
+ */
+static void decode_packet(sample_timing_t *timing,
+                          sample_t *packet,
+                          const size_t slot,
+                          const size_t previous)
+{
+    const uint64_t timestamp = strip_embedded_word(packet);
+    const uint64_t header = strip_embedded_word(&packet[ADC_TIMESTAMP_SAMPLES]);
+    const uint32_t sequence = header & ADC_HEADER_SEQUENCE_MASK;
+    const uint32_t status = header >> ADC_HEADER_STATUS_SHIFT;
+
+    timing->timestamps[slot] = timestamp;
+    if (status & ADC_PACKET_OVERRUN)
+    {
+        timing->overrun_packets++;
+    }
+
+    /*
+     * A break in the sequence numbers means whole packets were lost, while a
+     * break in the sample indices alone means samples were lost within the
+     * FPGA. The count wraps, so the difference is taken modulo its width.
+     */
+    if (previous != SIZE_MAX && sequence != (uint32_t)(timing->sequence + 1))
+    {
+        timing->lost_packets += (uint32_t)(sequence - timing->sequence - 1);
+    }
+    timing->sequence = sequence;
+
+    if (previous != SIZE_MAX)
+    {
+        const uint64_t expected = timing->timestamps[previous] + timing->samples_per_packet;
+        if (timestamp != expected)
+        {
+            timing->discontinuities++;
+            if (timestamp > expected)
+            {
+                timing->dropped_samples += timestamp - expected;
+            }
+        }
+    }
+}
+
+/**
+ * Recovers the timestamps and headers of packets received since the previous
+ * call and strips them from the sample data.
+ *
+ * @param timing The timing record to fill.
+ * @param data The start of the capture. Timestamp bits are cleared in place.
+ * @param packets The total number of packets received so far.
+ * @param end_tick The system time at which the last packet arrived.
+ *
+ * @return Success or fail.
+ */
+static result_t decode_timestamps(sample_timing_t *timing,
+                                  sample_t *data,
+                                  const size_t packets,
+                                  const tick_t end_tick)
+{
+    AbortIfNot(packets <= timing->max_packets, fail);
+
+    const size_t samples_per_packet = timing->samples_per_packet;
+    for (size_t p = timing->packets; p < packets; ++p)
+    {
+        decode_packet(timing, &data[p * samples_per_packet], p, (p > 0)? p - 1 : SIZE_MAX);
+    }
+
+    if (packets > timing->packets)
+    {
+        timing->packets = packets;
+        timing->anchor_tick = end_tick;
+        timing->anchor_sample = timing->timestamps[packets - 1] + samples_per_packet;
+    }
+
+    return success;
+}
+
+/**
+ * Recovers the timestamps and headers of packets received into a ring since
+ * the previous call and strips them from the sample data.
+ *
+ * @note The timestamps are held by the slot of their packet in the ring, so
+ *       get_sample_index() takes the position of a sample within the ring.
+ *       The packet count of the timing record runs on with the capture.
+ *
+ * @param timing The timing record to fill.
+ * @param ring The ring of samples. Timestamp bits are cleared in place.
+ * @param ring_packets The number of packets that the ring holds.
+ * @param first_packet The first packet whose timestamp was recovered, which
+ *        is not compared with the packet before it.
+ * @param packets The total number of packets received so far.
+ * @param end_tick The system time at which the last packet arrived.
+ *
+ * @return Success or fail.
+ */
+static result_t decode_ring_timestamps(sample_timing_t *timing,
+                                       sample_t *ring,
+                                       const size_t ring_packets,
+                                       const size_t first_packet,
+                                       const size_t packets,
+                                       const tick_t end_tick)
+{
+    AbortIfNot(ring_packets <= timing->max_packets, fail);
+
+    const size_t samples_per_packet = timing->samples_per_packet;
+    for (size_t p = timing->packets; p < packets; ++p)
+    {
+        const size_t slot = p % ring_packets;
+        const size_t previous = (p == first_packet)? SIZE_MAX : (slot)? slot - 1 : ring_packets - 1;
+        decode_packet(timing, &ring[slot * samples_per_packet], slot, previous);
+    }
+
+    if (packets > timing->packets)
+    {
+        timing->packets = packets;
+        timing->anchor_tick = end_tick;
+        timing->anchor_sample = timing->timestamps[(packets - 1) % ring_packets] + samples_per_packet;
+    }
+
+    return success;
+}
+
+/**
+ * Recovers the hardware timestamps embedded in a capture and strips them from
+ * the sample data.
+ *
+ * @note Each packet carries the index of its first sample in the upper two
+ *       bits of every channel of its first eight samples, and its sequence
+ *       number and status in the next eight. A break in the sequence of
+ *       indices indicates that samples were dropped.
+ *
+ * @param timing The timing record to fill.
+ * @param data The captured samples. Timestamp bits are cleared in place.
+ * @param len The number of samples captured.
+ * @param samples_per_packet The number of samples in each packet.
+ * @param end_tick The system time at which the last sample arrived.
+ *
+ * @return Success or fail.
+ */
+result_t extract_timestamps(sample_timing_t *timing,
+                            sample_t *data,
+                            const size_t len,
+                            const size_t samples_per_packet,
+                            const tick_t end_tick)
+{
+    AbortIfNot(data, fail);
+    AbortIfNot(begin_timestamps(timing, samples_per_packet), fail);
+    AbortIfNot(len % samples_per_packet == 0, fail);
+
+    const size_t packets = len / samples_per_packet;
+    AbortIfNot(packets > 0, fail);
+    AbortIfNot(decode_timestamps(timing, data, packets, end_tick), fail);
+
+    return success;
+}
+
+/**
+ * Recovers the hardware timestamps embedded in a planar capture and strips
+ * them from the channels.
+ *
+ * @note The embedded bits of each packet occupy the first samples of every
+ *       channel, as they do when the packet is interleaved, so each header
+ *       is gathered from the channels to be decoded and returned stripped.
+ *
+ * @param timing The timing record to fill.
+ * @param planar The captured channels. Timestamp bits are cleared in place.
+ * @param len The number of samples captured.
+ * @param samples_per_packet The number of samples in each packet.
+ * @param end_tick The system time at which the last sample arrived.
+ *
+ * @return Success or fail.
+ */
+result_t extract_planar_timestamps(sample_timing_t *timing,
+                                   planar_samples_t *planar,
+                                   const size_t len,
+                                   const size_t samples_per_packet,
+                                   const tick_t end_tick)
+{
+    AbortIfNot(planar, fail);
+    AbortIfNot(len <= planar->len, fail);
+    AbortIfNot(begin_timestamps(timing, samples_per_packet), fail);
+    AbortIfNot(len % samples_per_packet == 0, fail);
+
+    const size_t packets = len / samples_per_packet;
+    AbortIfNot(packets > 0, fail);
+    AbortIfNot(packets <= timing->max_packets, fail);
+
+    for (size_t p = 0; p < packets; ++p)
+    {
+        const size_t first = p * samples_per_packet;
+        sample_t header[ADC_HEADER_SAMPLES];
+        for (size_t i = 0; i < ADC_HEADER_SAMPLES; ++i)
+        {
+            for (size_t k = 0; k < 4; ++k)
+            {
+                header[i].sample[k] = planar->channel[k][first + i];
+            }
+        }
+
+        decode_packet(timing, header, p, (p > 0)? p - 1 : SIZE_MAX);
+
+        for (size_t i = 0; i < ADC_HEADER_SAMPLES; ++i)
+        {
+            for (size_t k = 0; k < 4; ++k)
+            {
+                planar->channel[k][first + i] = header[i].sample[k];
+            }
+        }
+    }
+
+    timing->packets = packets;
+    timing->anchor_tick = end_tick;
+    timing->anchor_sample = timing->timestamps[packets - 1] + samples_per_packet;
+
+    return success;
+}
+
+/**
+ * Gets the hardware sample index of a sample in the last capture.
+ *
+ * @param timing The timing record of the capture.
+ * @param i The position of the sample in the capture.
+ *
+ * @return The index of the sample since the ADC stream was reset.
+ */
+uint64_t get_sample_index(const sample_timing_t *timing, const size_t i)
+{
+    const size_t packet = i / timing->samples_per_packet;
+    return timing->timestamps[packet] + (i % timing->samples_per_packet);
+}
+
+/**
+ * Finds the span of samples that parallel captures from several ADCs have in
+ * common, so that their channels can be processed as one array.
+ *
+ * @note The ADCs must share an encode clock reference and be reset together,
+ *       so that equal sample indices were taken at the same instant. A
+ *       capture with a break in its samples cannot be aligned.
+ *
+ * @param timings The timing record of each capture.
+ * @param count The number of captures.
+ * @param[out] offsets The position in each capture of the first common sample.
+ * @param[out] len The number of samples that every capture holds.
+ *
+ * @return Success or fail.
+ */
+result_t align_captures(const sample_timing_t *timings,
+                        const size_t count,
+                        size_t *offsets,
+                        size_t *len)
+{
+    AbortIfNot(timings, fail);
+    AbortIfNot(count, fail);
+    AbortIfNot(offsets, fail);
+    AbortIfNot(len, fail);
+
+    uint64_t start = 0, end = UINT64_MAX;
+    for (size_t k = 0; k < count; ++k)
+    {
+        const sample_timing_t *timing = &timings[k];
+        AbortIfNot(timing->packets, fail);
+        AbortIfNot(timing->discontinuities == 0, fail);
+
+        const uint64_t first = timing->timestamps[0];
+        const uint64_t last = first + timing->packets * timing->samples_per_packet;
+        start = (first > start)? first : start;
+        end = (last < end)? last : end;
+    }
+    AbortIfNot(end > start, fail);
+
+    for (size_t k = 0; k < count; ++k)
+    {
+        offsets[k] = start - timings[k].timestamps[0];
+    }
+    *len = end - start;
+
+    return success;
+}
+
+/**
+ * Converts a hardware sample index into system time.
+ *
+ * @param timing The timing record providing the time reference.
+ * @param index The sample index to convert.
+ * @param sampling_frequency The sampling frequency of acquisition.
+ *
+ * @return The system time at which the sample was taken.
+ */
+tick_t sample_index_to_tick(const sample_timing_t *timing,
+                            const uint64_t index,
+                            const uint32_t sampling_frequency)
+{
+    /*
+     * Samples before the anchor are rounded towards it, as are those after.
+     */
+    const bool before = index < timing->anchor_sample;
+    const uint64_t offset = (before)? timing->anchor_sample - index : index - timing->anchor_sample;
+    const tick_t ticks = (timing->clock.sampling_frequency == sampling_frequency)?
+            clock_samples_to_ticks(&timing->clock, offset) : samples_to_ticks(offset, sampling_frequency);
+
+    return (before)? timing->anchor_tick - ticks : timing->anchor_tick + ticks;
+}
+
+/**
+ * The number of samples the ping detector processes at a time. Blocks are
+ * small enough to remain in the L1 cache between the detector stages.
+ */
+#define PING_DETECTOR_BLOCK 256
+
+/**
+ * The time constant of the running DC estimate as a power of two samples.
+ */
+#define DC_TRACKING_SHIFT 16
+
+/**
+ * Initializes a streaming ping detector.
+ *
+ * @param[out] detector The detector to initialize.
+ * @param threshold The threshold on the reference channel that denotes a ping.
+ * @param cfar_threshold The multiple of the noise floor tracked by a CFAR
+ *        detector that denotes a ping in place of the threshold, or zero.
+ * @param ping_frequency The frequency of the pinger in Hz, or zero to detect
+ *        pings with a broadband threshold.
+ * @param sampling_frequency The sampling frequency of acquisition.
+ * @param filter The prepared IIR filter to apply, or NULL to skip filtering.
+ * @param matched The matched filter to search with, or NULL.
+ * @param matched_threshold The normalized correlation, in percent, with the
+ *        template of the matched filter that denotes a ping, or zero.
+ *
+ * @return Success or fail.
+ */
+result_t init_ping_detector(ping_detector_t *detector,
+                            const analog_sample_t threshold,
+                            const uint8_t cfar_threshold,
+                            const uint32_t ping_frequency,
+                            const uint32_t sampling_frequency,
+                            const biquad_cascade_t *filter,
+                            matched_filter_t *matched,
+                            const uint8_t matched_threshold)
+{
+    AbortIfNot(detector, fail);
+    AbortIfNot(init_tone_detector(&detector->tone, ping_frequency, sampling_frequency), fail);
+
+    detector->filter = (filter && filter->num_sections > 0)? true : false;
+    if (detector->filter)
+    {
+        detector->cascade = *filter;
+        reset_biquad_cascade(&detector->cascade);
+    }
+
+    for (size_t k = 0; k < 4; ++k)
+    {
+        detector->dc[k] = 0;
+    }
+
+    detector->dc_initialized = false;
+    detector->threshold = threshold;
+    detector->max_value = INT16_MIN;
+
+    /*
+     * The DC estimate is removed before the samples are searched, so the
+     * CFAR detector rectifies about zero.
+     */
+    detector->cfar_enabled = (cfar_threshold)? true : false;
+    init_cfar_detector(&detector->cfar, cfar_threshold, 0);
+
+    /*
+     * The matched filter counts samples from the start of the capture, as
+     * the detector does.
+     */
+    detector->matched = (matched && matched->ready && matched_threshold)? matched : NULL;
+    detector->matched_threshold = matched_threshold;
+    if (detector->matched)
+    {
+        reset_matched_filter(detector->matched);
+    }
+
+    detector->processed = 0;
+    detector->found = false;
+    detector->found_index = 0;
+
+    return success;
+}
+
+/**
+ * Removes DC, filters, and searches a chunk of samples for a ping in a single
+ * pass over memory.
+ *
+ * @note The DC offset is tracked with a running mean that is seeded from the
+ *       first chunk. The first threshold crossing on the reference channel is
+ *       latched and later samples continue to be conditioned so that the
+ *       post-ping window is available to the caller.
+ *
+ * @param detector The detector to run.
+ * @param data The next chunk of samples, which are processed in place.
+ * @param len The number of samples in the chunk.
+ *
+ * @return Success or fail.
+ */
+result_t run_ping_detector(ping_detector_t *detector,
+                           sample_t *data,
+                           const size_t len)
+{
+    AbortIfNot(detector, fail);
+    AbortIfNot(data, fail);
+
+    if (len == 0)
+    {
+        return success;
+    }
+
+    if (!detector->dc_initialized)
+    {
+        int64_t accumulators[4] = {0, 0, 0, 0};
+        for (size_t i = 0; i < len; ++i)
+        {
+            for (size_t k = 0; k < 4; ++k)
+            {
+                accumulators[k] += data[i].sample[k];
+            }
+        }
+
+        for (size_t k = 0; k < 4; ++k)
+        {
+            detector->dc[k] = (accumulators[k] * (1 << 16)) / (int64_t)len;
+        }
+
+        detector->dc_initialized = true;
+    }
+
+    for (size_t block = 0; block < len; block += PING_DETECTOR_BLOCK)
+    {
+        const size_t block_len = (len - block < PING_DETECTOR_BLOCK)?
+                len - block : PING_DETECTOR_BLOCK;
+        sample_t *samples = &data[block];
+
+        /*
+         * Remove the running DC estimate.
+         */
+        for (size_t i = 0; i < block_len; ++i)
+        {
+            for (size_t k = 0; k < 4; ++k)
+            {
+                const int64_t value = samples[i].sample[k];
+                detector->dc[k] += (value * (1 << 16) - detector->dc[k]) >> DC_TRACKING_SHIFT;
+                samples[i].sample[k] = value - ((detector->dc[k] + (1 << 15)) >> 16);
+            }
+        }
+
+        if (detector->filter)
+        {
+            AbortIfNot(run_biquad_cascade(&detector->cascade, samples, block_len), fail);
+        }
+
+        /*
+         * Search the reference channel for the pinger waveform or tone while
+         * it is hot in the cache, or for the broadband threshold crossing.
+         */
+        if (detector->matched)
+        {
+            if (!detector->found)
+            {
+                bool found = false;
+                uint64_t index = 0;
+                AbortIfNot(run_matched_filter(detector->matched,
+                                              samples[0].sample,
+                                              4,
+                                              block_len,
+                                              detector->matched_threshold,
+                                              &found,
+                                              &index), fail);
+                if (found)
+                {
+                    detector->found = true;
+                    detector->found_index = index;
+                }
+            }
+            AbortIfNot(scan_channel(samples[0].sample,
+                                    4,
+                                    block_len,
+                                    0,
+                                    NULL,
+                                    NULL,
+                                    &detector->max_value), fail);
+
+            continue;
+        }
+
+        if (detector->tone.enabled)
+        {
+            if (!detector->found)
+            {
+                bool found = false;
+                size_t index = 0;
+                AbortIfNot(detect_tone(&detector->tone,
+                                       samples,
+                                       block_len,
+                                       detector->threshold,
+                                       &found,
+                                       &index,
+                                       &detector->max_value), fail);
+                if (found)
+                {
+                    detector->found = true;
+                    detector->found_index = detector->processed + block + index;
+                }
+            }
+
+            continue;
+        }
+
+        bool found = false;
+        size_t index = 0;
+        if (detector->cfar_enabled)
+        {
+            if (!detector->found)
+            {
+                AbortIfNot(run_cfar_detector(&detector->cfar,
+                                             samples[0].sample,
+                                             4,
+                                             block_len,
+                                             &found,
+                                             &index), fail);
+            }
+            AbortIfNot(scan_channel(samples[0].sample,
+                                    4,
+                                    block_len,
+                                    0,
+                                    NULL,
+                                    NULL,
+                                    &detector->max_value), fail);
+        }
+        else
+        {
+            AbortIfNot(scan_channel(samples[0].sample,
+                                    4,
+                                    block_len,
+                                    detector->threshold,
+                                    (detector->found)? NULL : &found,
+                                    (detector->found)? NULL : &index,
+                                    &detector->max_value), fail);
+        }
+        if (found)
+        {
+            detector->found = true;
+            detector->found_index = detector->processed + block + index;
+        }
+    }
+
+    detector->processed += len;
+
+    return success;
+}
+
+/**
+ * Acquire sync with the ping.
+ *
+ * @note When the scatter-gather ring is available, samples are run through
+ *       the ping detector as they arrive and recording stops as soon as the
+ *       post-ping window following the first threshold crossing is in hand.
+ *
+ * @param dma A pointer to the DMA driver to use for sampling.
+ * @param data A pointer to the location to store data.
+ * @param max_len The maximum number of samples pointed to by data.
+ * @param[out] start_time The tick that the ping started at.
+ * @param[out] found Specified true if the ping was found.
+ * @param[out] max_value The maximum value encountered on the reference channel.
+ * @param adc The QuadADC driver used for acquiring samples.
+ * @param sampling_frequency The sampling frequency of acquisition.
+ * @param sample_threshold The threshold to use for ping detection.
+ * @param filter The prepared IIR filter to use for filtering received data.
+ * @param matched The matched filter that holds the pinger waveform template,
+ *        or NULL.
+ * @param timing The hardware timestamps of the capture, or NULL if the stream
+ *        does not carry timestamps.
+ *
+ * @return Success or fail.
+ */
+result_t acquire_sync(dma_engine_t *dma,
+                      sample_t *data,
+                      size_t max_len,
+                      tick_t *start_time,
+                      bool *found,
+                      analog_sample_t *max_value,
+                      const adc_driver_t adc,
+                      const uint32_t sampling_frequency,
+                      HydroZynqParams *params,
+                      const biquad_cascade_t *filter,
+                      matched_filter_t *matched,
+                      sample_timing_t *timing)
+{
+    AbortIfNot(dma, fail);
+    AbortIfNot(data, fail);
+    AbortIfNot(params, fail);
+    AbortIfNot(start_time, fail);
+    AbortIfNot(found, fail);
+    AbortIfNot(max_value, fail);
+    AbortIfNot(adc.regs, fail);
+    AbortIfNot(sampling_frequency, fail);
+
+    const size_t samples_per_packet = adc.regs->samples_per_packet;
+    if (max_len % samples_per_packet)
+    {
+        max_len -= max_len % samples_per_packet;
+    }
+
+    ping_detector_t detector;
+    AbortIfNot(init_ping_detector(&detector,
+                                  params->ping_threshold,
+                                  params->cfar_threshold,
+                                  params->ping_frequency,
+                                  sampling_frequency,
+                                  (params->filter)? filter : NULL,
+                                  matched,
+                                  params->matched_threshold), fail);
+
+    if (timing)
+    {
+        AbortIfNot(begin_timestamps(timing, samples_per_packet), fail);
+    }
+
+    tick_t record_start = get_system_time();
+    if (dma->ring.descriptors)
+    {
+        /*
+         * Process packets as they arrive and stop once the ping and the
+         * window that follows it have been received.
+         */
+        capture_t capture;
+        AbortIfNot(start_capture(&capture, dma, data, max_len, adc), fail);
+        record_start = capture.start_time;
+
+        const size_t post_ping_samples = ticks_to_samples(params->post_ping_duration,
+                                                          sampling_frequency);
+        result_t ret = success;
+        while (ret == success &&
+               !(detector.found &&
+                 detector.processed >= detector.found_index + post_ping_samples))
+        {
+            if (!dma->interrupts_enabled)
+            {
+                ret = service_capture(&capture);
+            }
+
+            set_interrupts(false);
+            const size_t available = capture.total_samples;
+            const tick_t available_tick = capture.last_progress;
+            set_interrupts(true);
+
+            if (available > detector.processed)
+            {
+                if (timing && ret == success)
+                {
+                    ret = decode_timestamps(timing,
+                                            data,
+                                            available / samples_per_packet,
+                                            available_tick);
+                }
+
+                if (ret == success)
+                {
+                    ret = run_ping_detector(&detector,
+                                            &data[detector.processed],
+                                            available - detector.processed);
+                }
+            }
+            else if (capture_done(&capture))
+            {
+                break;
+            }
+            else if (get_system_time() - capture.last_progress > capture.timeout)
+            {
+                ret = fail;
+            }
+
+            dispatch_network_stack();
+        }
+
+        if (!capture_done(&capture))
+        {
+            AbortIfNot(abort_capture(&capture), fail);
+        }
+
+        AbortIfNot(set_dma_callback(dma, NULL, NULL), fail);
+        AbortIfNot(ret, fail);
+        AbortIf(capture.error, fail);
+    }
+    else
+    {
+        AbortIfNot(record(dma, data, max_len, adc), fail);
+        if (timing)
+        {
+            AbortIfNot(decode_timestamps(timing,
+                                         data,
+                                         max_len / samples_per_packet,
+                                         get_system_time()), fail);
+        }
+
+        AbortIfNot(run_ping_detector(&detector, data, max_len), fail);
+    }
+
+    *max_value = detector.max_value;
+    *found = detector.found;
+
+    if (detector.found)
+    {
+        if (timing)
+        {
+            *start_time = sample_index_to_tick(timing,
+                                               get_sample_index(timing, detector.found_index),
+                                               sampling_frequency);
+        }
+        else
+        {
+            *start_time = record_start + samples_to_ticks(detector.found_index, sampling_frequency);
+        }
+    }
+
+    return success;
+}
+
+/**
+ * Acquires sync with the ping from a decimated detection stream while the
+ * samples are recorded at the full rate into a bounded ring.
+ *
+ * @note The ring is read as it fills and decimated by a boxcar average, and
+ *       the detection stream is searched without filtering. Only the window
+ *       around the first flagged crossing is then run through the ping
+ *       detector at the full rate, with the filter and matched filter, to
+ *       confirm the ping and locate it. A detection stream that falls a ring
+ *       behind the DMA engine is restarted at the newest samples.
+ *
+ * @param dma A pointer to the AXI DMA driver with an initialized ring.
+ * @param data A pointer to the location to store data.
+ * @param max_len The maximum number of samples pointed to by data, of which
+ *        at most DUAL_RATE_RING_SAMPLES are used for the ring.
+ * @param[out] start_time The tick that the ping started at.
+ * @param[out] found Specified true if the ping was found.
+ * @param[out] max_value The maximum value encountered on the reference channel.
+ * @param adc The QuadADC driver used for acquiring samples.
+ * @param sampling_frequency The sampling frequency of acquisition.
+ * @param params The current HydroZynq parameters.
+ * @param filter The prepared IIR filter to use for filtering received data.
+ * @param matched The matched filter that holds the pinger waveform template,
+ *        or NULL.
+ * @param timing The hardware timestamps of the capture, or NULL if the stream
+ *        does not carry timestamps. Its timestamps are left indexed by the
+ *        position of each sample in the ring.
+ *
+ * @return Success or fail.
+ */
+result_t acquire_dual_rate_sync(dma_engine_t *dma,
+                                sample_t *data,
+                                size_t max_len,
+                                tick_t *start_time,
+                                bool *found,
+                                analog_sample_t *max_value,
+                                const adc_driver_t adc,
+                                const uint32_t sampling_frequency,
+                                HydroZynqParams *params,
+                                const biquad_cascade_t *filter,
+                                matched_filter_t *matched,
+                                sample_timing_t *timing)
+{
+    AbortIfNot(dma, fail);
+    AbortIfNot(dma->ring.descriptors, fail);
+    AbortIfNot(data, fail);
+    AbortIfNot(params, fail);
+    AbortIfNot(start_time, fail);
+    AbortIfNot(found, fail);
+    AbortIfNot(max_value, fail);
+    AbortIfNot(adc.regs, fail);
+    AbortIfNot(sampling_frequency, fail);
+
+    const size_t samples_per_packet = adc.regs->samples_per_packet;
+    size_t ring_len = (max_len < DUAL_RATE_RING_SAMPLES)? max_len : DUAL_RATE_RING_SAMPLES;
+    ring_len -= ring_len % samples_per_packet;
+    const size_t ring_packets = ring_len / samples_per_packet;
+
+    /*
+     * The detection stream keeps enough samples per cycle of the pinger, or
+     * of the highest pinger frequency when it is not known.
+     */
+    const uint32_t max_hz = (params->ping_frequency)? params->ping_frequency : COARSE_SEARCH_MAX_PINGER_HZ;
+    size_t factor = sampling_frequency / (DECIMATION_SAMPLES_PER_CYCLE * max_hz);
+    factor = (factor > DUAL_RATE_MAX_DECIMATION)? DUAL_RATE_MAX_DECIMATION : (factor)? factor : 1;
+
+    /*
+     * The window must stay in the ring, clear of the packets that the DMA
+     * engine may be writing, until the samples after the crossing arrive.
+     */
+    const size_t in_flight = dma->ring.count * samples_per_packet;
+    const size_t post_ping_samples = ticks_to_samples(params->post_ping_duration, sampling_frequency) +
+            factor;
+    AbortIfNot(ring_packets > dma->ring.count, fail);
+    AbortIfNot(post_ping_samples + in_flight < ring_len, fail);
+
+    size_t pre_ping_samples = (uint64_t)sampling_frequency * DUAL_RATE_PRE_PING_US / 1000000;
+    if (params->filter && filter)
+    {
+        pre_ping_samples += filter_settling_samples(filter);
+    }
+    if (pre_ping_samples > ring_len - in_flight - post_ping_samples)
+    {
+        pre_ping_samples = ring_len - in_flight - post_ping_samples;
+    }
+
+    boxcar_decimator_t decimator;
+    ping_detector_t detector;
+    AbortIfNot(init_boxcar_decimator(&decimator, factor), fail);
+    AbortIfNot(init_ping_detector(&detector,
+                                  params->ping_threshold,
+                                  params->cfar_threshold,
+                                  params->ping_frequency,
+                                  sampling_frequency / factor,
+                                  NULL,
+                                  NULL,
+                                  0), fail);
+
+    if (timing)
+    {
+        AbortIfNot(begin_timestamps(timing, samples_per_packet), fail);
+    }
+
+    capture_t capture;
+    AbortIfNot(start_ring_capture(&capture, dma, data, ring_len, adc), fail);
+    const tick_t record_start = capture.start_time;
+
+    /*
+     * Samples are counted from the start of the capture. The detection
+     * stream begins at origin, and timestamps were recovered from the
+     * packet at first_packet.
+     */
+    sample_t decimated[PING_DETECTOR_BLOCK];
+    size_t received = 0;
+    size_t processed = 0;
+    size_t origin = 0;
+    size_t first_packet = 0;
+    bool flagged = false;
+    size_t window_start = 0;
+    size_t window_end = 0;
+    result_t ret = success;
+    while (ret == success)
+    {
+        if (!dma->interrupts_enabled)
+        {
+            ret = service_capture(&capture);
+        }
+
+        set_interrupts(false);
+        const size_t available = capture.total_samples;
+        const size_t queued = capture.queued_samples;
+        const tick_t available_tick = capture.last_progress;
+        set_interrupts(true);
+
+        if (flagged && available >= window_end)
+        {
+            break;
+        }
+
+        if (queued - ((flagged)? window_start : processed) > ring_len)
+        {
+            dblog(LOG_WARN, "Detection stream fell behind the ring, restarting\n");
+            received = available;
+            processed = available;
+            origin = available;
+            first_packet = available / samples_per_packet;
+            flagged = false;
+            if (timing)
+            {
+                timing->packets = first_packet;
+            }
+
+            ret = init_boxcar_decimator(&decimator, factor);
+            if (ret == success)
+            {
+                ret = init_ping_detector(&detector,
+                                         params->ping_threshold,
+                                         params->cfar_threshold,
+                                         params->ping_frequency,
+                                         sampling_frequency / factor,
+                                         NULL,
+                                         NULL,
+                                         0);
+            }
+            continue;
+        }
+
+        if (available > received)
+        {
+            received = available;
+            if (timing && ret == success)
+            {
+                ret = decode_ring_timestamps(timing,
+                                             data,
+                                             ring_packets,
+                                             first_packet,
+                                             available / samples_per_packet,
+                                             available_tick);
+            }
+
+            /*
+             * Decimate and search the new samples in chunks that do not
+             * cross the end of the ring.
+             */
+            while (ret == success && !flagged && processed < available)
+            {
+                const size_t offset = processed % ring_len;
+                size_t len = available - processed;
+                if (len > ring_len - offset)
+                {
+                    len = ring_len - offset;
+                }
+                if (len > PING_DETECTOR_BLOCK * factor)
+                {
+                    len = PING_DETECTOR_BLOCK * factor;
+                }
+
+                size_t produced = 0;
+                ret = run_boxcar_decimator(&decimator, &data[offset], len, decimated, PING_DETECTOR_BLOCK, &produced);
+                if (ret == success)
+                {
+                    ret = run_ping_detector(&detector, decimated, produced);
+                }
+                processed += len;
+
+                if (ret == success && detector.found)
+                {
+                    /*
+                     * Samples whose timestamps were not recovered still hold
+                     * the embedded bits, so the window starts after them.
+                     */
+                    const size_t crossing = origin + detector.found_index * factor;
+                    window_start = (crossing > pre_ping_samples)? crossing - pre_ping_samples : 0;
+                    window_start -= window_start % samples_per_packet;
+                    if (timing && window_start < first_packet * samples_per_packet)
+                    {
+                        window_start = first_packet * samples_per_packet;
+                    }
+                    window_end = crossing + post_ping_samples;
+                    flagged = true;
+                }
+            }
+        }
+        else if (get_system_time() - capture.last_progress > capture.timeout)
+        {
+            ret = fail;
+        }
+
+        if (!flagged && get_system_time() - record_start > ms_to_ticks(2100))
+        {
+            break;
+        }
+
+        dispatch_network_stack();
+    }
+
+    AbortIfNot(abort_capture(&capture), fail);
+    AbortIfNot(set_dma_callback(dma, NULL, NULL), fail);
+    AbortIfNot(ret, fail);
+    AbortIf(capture.error, fail);
+
+    *max_value = detector.max_value;
+    *found = false;
+    if (!flagged)
+    {
+        return success;
+    }
+
+    /*
+     * Locate the ping at the full rate within the flagged window, which no
+     * longer changes now that the capture is stopped.
+     */
+    ping_detector_t window_detector;
+    AbortIfNot(init_ping_detector(&window_detector,
+                                  params->ping_threshold,
+                                  params->cfar_threshold,
+                                  params->ping_frequency,
+                                  sampling_frequency,
+                                  (params->filter)? filter : NULL,
+                                  matched,
+                                  params->matched_threshold), fail);
+
+    size_t position = window_start;
+    while (position < window_end)
+    {
+        const size_t offset = position % ring_len;
+        size_t len = window_end - position;
+        if (len > ring_len - offset)
+        {
+            len = ring_len - offset;
+        }
+
+        AbortIfNot(run_ping_detector(&window_detector, &data[offset], len), fail);
+        position += len;
+    }
+
+    if (!window_detector.found)
+    {
+        dblog(LOG_INFO, "Flagged crossing was not confirmed at the full rate\n");
+        return success;
+    }
+
+    *found = true;
+    *max_value = window_detector.max_value;
+    const size_t index = window_start + window_detector.found_index;
+    if (timing)
+    {
+        *start_time = sample_index_to_tick(timing,
+                                           get_sample_index(timing, index % ring_len),
+                                           sampling_frequency);
+    }
+    else
+    {
+        *start_time = record_start + samples_to_ticks(index, sampling_frequency);
+    }
+
+    return success;
+}
 
 /**
- * Records a number of analog samples.
+ * Restarts the detection stream of a continuous capture at a sample.
  *
- * @param dma A pointer to the AXI DMA driver to use for sample acquisition.
- * @param data A pointer to where analog samples should be stored.
- * @param sample_count The number of samples to take.
- * @param adc The QuadADC driver that is connected to the DMA.
+ * @param continuous The continuous capture.
+ * @param start The sample that the detection stream begins at.
  *
  * @return Success or fail.
  */
-result_t record(dma_engine_t *dma,
-                sample_t *data,
-                const size_t sample_count,
-                const adc_driver_t adc)
+static result_t restart_continuous_detection(continuous_capture_t *continuous, const size_t start)
+{
+    continuous->processed = start;
+    continuous->origin = start;
+    continuous->flagged = false;
+
+    AbortIfNot(init_boxcar_decimator(&continuous->decimator, continuous->factor), fail);
+    AbortIfNot(init_ping_detector(&continuous->detector,
+                                  continuous->ping_threshold,
+                                  continuous->cfar_threshold,
+                                  continuous->ping_frequency,
+                                  continuous->sampling_frequency / continuous->factor,
+                                  NULL,
+                                  NULL,
+                                  0), fail);
+
+    return success;
+}
+
+/**
+ * Rebases the sample counts of a continuous capture by a whole number of
+ * rings once they grow large, so that they never wrap.
+ *
+ * @note Interrupts must be masked, since the completion handler advances the
+ *       counts of the capture. A flagged window is extracted first.
+ *
+ * @param continuous The continuous capture.
+ *
+ * @return None.
+ */
+static void rebase_continuous_capture(continuous_capture_t *continuous)
+{
+    const size_t samples_per_packet = continuous->samples_per_packet;
+    const size_t first_sample = continuous->first_packet * samples_per_packet;
+    const size_t oldest = (first_sample < continuous->origin)? first_sample : continuous->origin;
+    if (continuous->flagged || oldest < CONTINUOUS_REBASE_SAMPLES)
+    {
+        return;
+    }
+
+    const size_t base = oldest - oldest % continuous->ring_len;
+    continuous->capture.queued_samples -= base;
+    continuous->capture.total_samples -= base;
+    continuous->received -= base;
+    continuous->processed -= base;
+    continuous->origin -= base;
+    continuous->first_packet -= base / samples_per_packet;
+    continuous->timing->packets -= base / samples_per_packet;
+}
+
+/**
+ * Begins recording into a ring at all times while a decimated detection
+ * stream read from the ring is searched for pings.
+ *
+ * @note The ring is read as it fills, as in dual-rate sync, but the capture is
+ *       never stopped for a ping. The window around each crossing is copied
+ *       out by extract_continuous_ping() once its samples have arrived, so
+ *       no ping depends on a predicted capture window.
+ *
+ * @param[out] continuous The continuous capture to start.
+ * @param dma A pointer to the AXI DMA driver with an initialized ring.
+ * @param ring A pointer to the ring of samples.
+ * @param ring_len The number of samples of the ring, a whole number of
+ *        packets.
+ * @param adc The QuadADC driver that is connected to the DMA.
+ * @param sampling_frequency The sampling frequency of acquisition.
+ * @param params The current HydroZynq parameters.
+ * @param filter The prepared IIR filter that the extracted windows are
+ *        filtered with, or NULL.
+ * @param timing Storage for the timestamps of the packets of the ring, which
+ *        are indexed by their slot in the ring.
+ *
+ * @return Success or fail if the window around a ping does not fit in the
+ *         ring.
+ */
+result_t start_continuous_capture(continuous_capture_t *continuous,
+                                  dma_engine_t *dma,
+                                  sample_t *ring,
+                                  const size_t ring_len,
+                                  const adc_driver_t adc,
+                                  const uint32_t sampling_frequency,
+                                  const HydroZynqParams *params,
+                                  const biquad_cascade_t *filter,
+                                  sample_timing_t *timing)
 {
+    AbortIfNot(continuous, fail);
     AbortIfNot(dma, fail);
-    AbortIfNot(data, fail);
+    AbortIfNot(dma->ring.descriptors, fail);
+    AbortIfNot(ring, fail);
     AbortIfNot(adc.regs, fail);
-    AbortIfNot(sample_count % adc.regs->samples_per_packet == 0, fail);
+    AbortIfNot(sampling_frequency, fail);
+    AbortIfNot(params, fail);
+    AbortIfNot(timing, fail);
 
-    size_t total_samples = 0;
-    size_t invalid_packets = 0;
-    while (total_samples < sample_count)
+    const size_t samples_per_packet = adc.regs->samples_per_packet;
+    AbortIfNot(ring_len % samples_per_packet == 0, fail);
+    const size_t ring_packets = ring_len / samples_per_packet;
+    AbortIfNot(ring_packets > dma->ring.count, fail);
+    AbortIfNot(ring_packets <= timing->max_packets, fail);
+
+    const uint32_t max_hz = (params->ping_frequency)? params->ping_frequency : COARSE_SEARCH_MAX_PINGER_HZ;
+    size_t factor = sampling_frequency / (DECIMATION_SAMPLES_PER_CYCLE * max_hz);
+    factor = (factor > DUAL_RATE_MAX_DECIMATION)? DUAL_RATE_MAX_DECIMATION : (factor)? factor : 1;
+
+    /*
+     * The window must fit in the ring clear of the packets that the DMA
+     * engine may be writing.
+     */
+    const size_t in_flight = dma->ring.count * samples_per_packet;
+    size_t pre_ping_samples = (uint64_t)sampling_frequency * CONTINUOUS_PRE_PING_US / 1000000;
+    if (params->filter && filter)
     {
-        /*
-         * Write back the cache lines before allowing DMA to avoid any
-         * corruption when we later invalidate the cache lines.
-         */
-        Xil_DCacheFlushRange((INTPTR)&data[total_samples],
-                             2 * 8 * adc.regs->samples_per_packet);
+        pre_ping_samples += filter_settling_samples(filter);
+    }
+    const size_t post_ping_samples = ticks_to_samples(params->post_ping_duration, sampling_frequency) +
+            (uint64_t)sampling_frequency * CONTINUOUS_POST_PING_US / 1000000 + factor;
+    AbortIfNot(pre_ping_samples + post_ping_samples + in_flight + samples_per_packet < ring_len, fail);
 
-        AbortIfNot(init_dma_transfer(dma, &data[total_samples],
-                    2 * 8 * adc.regs->samples_per_packet), fail);
-        AbortIfNot(wait_for_dma_transfer(dma), fail);
+    continuous->ring = ring;
+    continuous->ring_len = ring_len;
+    continuous->ring_packets = ring_packets;
+    continuous->samples_per_packet = samples_per_packet;
+    continuous->sampling_frequency = sampling_frequency;
+    continuous->timing = timing;
+    continuous->reported_lost_packets = 0;
+    continuous->reported_overrun_packets = 0;
+    continuous->factor = factor;
+    continuous->ping_threshold = params->ping_threshold;
+    continuous->cfar_threshold = params->cfar_threshold;
+    continuous->ping_frequency = params->ping_frequency;
+    continuous->pre_ping_samples = pre_ping_samples;
+    continuous->post_ping_samples = post_ping_samples;
+    continuous->received = 0;
+    continuous->first_packet = 0;
+
+    AbortIfNot(begin_timestamps(timing, samples_per_packet), fail);
+    AbortIfNot(restart_continuous_detection(continuous, 0), fail);
+    AbortIfNot(start_ring_capture(&continuous->capture, dma, ring, ring_len, adc), fail);
+
+    return success;
+}
+
+/**
+ * Recovers the timestamps of the packets that reached the ring of a
+ * continuous capture and searches their samples for a crossing.
+ *
+ * @note The detection stream pauses once a crossing is flagged, until its
+ *       window is extracted. A detection stream or flagged window that falls
+ *       a ring behind the DMA engine is abandoned and detection restarts at
+ *       the newest samples.
+ *
+ * @param continuous The continuous capture.
+ *
+ * @return Success or fail if the capture stopped.
+ */
+result_t service_continuous_capture(continuous_capture_t *continuous)
+{
+    AbortIfNot(continuous, fail);
+
+    capture_t *capture = &continuous->capture;
+    AbortIfNot(capture->active, fail);
+    if (!capture->dma->interrupts_enabled)
+    {
+        AbortIfNot(service_capture(capture), fail);
+    }
+
+    set_interrupts(false);
+    rebase_continuous_capture(continuous);
+    const size_t available = capture->total_samples;
+    const size_t queued = capture->queued_samples;
+    const tick_t available_tick = capture->last_progress;
+    set_interrupts(true);
+    AbortIf(capture->error, fail);
 
-        size_t samples = dma->regs->S2MM_LENGTH / 8;
-        if (samples == adc.regs->samples_per_packet)
+    const size_t samples_per_packet = continuous->samples_per_packet;
+    const size_t oldest = (continuous->flagged)? continuous->window_start : continuous->processed;
+    if (queued - oldest > continuous->ring_len)
+    {
+        dblog(LOG_WARN, "%s fell behind the ring, restarting\n",
+                (continuous->flagged)? "Ping window" : "Detection stream");
+        continuous->received = available;
+        continuous->first_packet = available / samples_per_packet;
+        continuous->timing->packets = continuous->first_packet;
+        return restart_continuous_detection(continuous, available);
+    }
+
+    if (available == continuous->received)
+    {
+        AbortIf(get_system_time() - capture->last_progress > capture->timeout, fail);
+        return success;
+    }
+
+    continuous->received = available;
+    AbortIfNot(decode_ring_timestamps(continuous->timing,
+                                      continuous->ring,
+                                      continuous->ring_packets,
+                                      continuous->first_packet,
+                                      available / samples_per_packet,
+                                      available_tick), fail);
+
+    /*
+     * Decimate and search the new samples in chunks that do not cross the
+     * end of the ring.
+     */
+    sample_t decimated[PING_DETECTOR_BLOCK];
+    const size_t factor = continuous->factor;
+    while (!continuous->flagged && continuous->processed < available)
+    {
+        const size_t offset = continuous->processed % continuous->ring_len;
+        size_t len = available - continuous->processed;
+        if (len > continuous->ring_len - offset)
+        {
+            len = continuous->ring_len - offset;
+        }
+        if (len > PING_DETECTOR_BLOCK * factor)
+        {
+            len = PING_DETECTOR_BLOCK * factor;
+        }
+
+        size_t produced = 0;
+        AbortIfNot(run_boxcar_decimator(&continuous->decimator,
+                                        &continuous->ring[offset],
+                                        len,
+                                        decimated,
+                                        PING_DETECTOR_BLOCK,
+                                        &produced), fail);
+        AbortIfNot(run_ping_detector(&continuous->detector, decimated, produced), fail);
+        continuous->processed += len;
+
+        if (continuous->detector.found)
         {
             /*
-             * Invalidate cache lines associated with data samples. Beware that
-             * this can potentially wipe out cached values stored _around_ the
-             * buffer we are invalidating, so it should have been written back
-             * earlier using a cache flush opertion.
+             * The window holds whole packets whose timestamps were recovered.
              */
-            Xil_DCacheInvalidateRange((INTPTR)&data[total_samples],
-                                      8 * samples);
-            total_samples += samples;
+            const size_t crossing = continuous->origin + continuous->detector.found_index * factor;
+            size_t window_start = (crossing > continuous->pre_ping_samples)?
+                    crossing - continuous->pre_ping_samples : 0;
+            window_start -= window_start % samples_per_packet;
+            if (window_start < continuous->first_packet * samples_per_packet)
+            {
+                window_start = continuous->first_packet * samples_per_packet;
+            }
+
+            size_t window_end = crossing + continuous->post_ping_samples;
+            window_end += (samples_per_packet - window_end % samples_per_packet) % samples_per_packet;
+
+            continuous->window_start = window_start;
+            continuous->window_end = window_end;
+            continuous->flagged = true;
         }
-        else
+    }
+
+    return success;
+}
+
+/**
+ * Checks if the window around a flagged crossing has arrived in the ring of a
+ * continuous capture.
+ *
+ * @param continuous The continuous capture.
+ *
+ * @return True if the window may be extracted.
+ */
+bool continuous_ping_ready(const continuous_capture_t *continuous)
+{
+    return (continuous->flagged && continuous->received >= continuous->window_end)? true : false;
+}
+
+/**
+ * Copies the window around a flagged crossing out of the ring of a continuous
+ * capture, with its timestamps, and resumes detection after it.
+ *
+ * @note The capture keeps recording while the window is copied. A window that
+ *       the DMA engine reached during the copy is discarded. The lost and
+ *       overrun packet counts of the window are those of the ring since the
+ *       previous window.
+ *
+ * @param continuous The continuous capture, whose window is ready.
+ * @param[out] data The location to store the window.
+ * @param capacity The number of samples pointed to by data.
+ * @param[out] timing The timing record of the window, as if it had been
+ *        captured on its own.
+ * @param[out] len The number of samples of the window.
+ * @param[out] extracted Specified true if the window was intact.
+ *
+ * @return Success or fail.
+ */
+result_t extract_continuous_ping(continuous_capture_t *continuous,
+                                 sample_t *data,
+                                 const size_t capacity,
+                                 sample_timing_t *timing,
+                                 size_t *len,
+                                 bool *extracted)
+{
+    AbortIfNot(continuous, fail);
+    AbortIfNot(data, fail);
+    AbortIfNot(timing, fail);
+    AbortIfNot(len, fail);
+    AbortIfNot(extracted, fail);
+    AbortIfNot(continuous_ping_ready(continuous), fail);
+
+    const size_t samples_per_packet = continuous->samples_per_packet;
+    const size_t window_start = continuous->window_start;
+    const size_t window_end = continuous->window_end;
+    const size_t count = window_end - window_start;
+    AbortIfNot(count <= capacity, fail);
+    AbortIfNot(count / samples_per_packet <= timing->max_packets, fail);
+
+    size_t position = window_start;
+    sample_t *out = data;
+    while (position < window_end)
+    {
+        const size_t offset = position % continuous->ring_len;
+        size_t run = window_end - position;
+        if (run > continuous->ring_len - offset)
+        {
+            run = continuous->ring_len - offset;
+        }
+
+        memcpy(out, &continuous->ring[offset], run * sizeof(sample_t));
+        out += run;
+        position += run;
+    }
+
+    set_interrupts(false);
+    const size_t queued = continuous->capture.queued_samples;
+    set_interrupts(true);
+
+    *len = 0;
+    *extracted = (queued - window_start <= continuous->ring_len)? true : false;
+    if (*extracted)
+    {
+        const sample_timing_t *ring_timing = continuous->timing;
+        AbortIfNot(begin_timestamps(timing, samples_per_packet), fail);
+
+        const size_t packets = count / samples_per_packet;
+        const size_t first_slot = window_start / samples_per_packet;
+        for (size_t p = 0; p < packets; ++p)
         {
-            invalid_packets++;
+            const uint64_t timestamp = ring_timing->timestamps[(first_slot + p) % continuous->ring_packets];
+            if (p > 0)
+            {
+                const uint64_t expected = timing->timestamps[p - 1] + samples_per_packet;
+                if (timestamp != expected)
+                {
+                    timing->discontinuities++;
+                    if (timestamp > expected)
+                    {
+                        timing->dropped_samples += timestamp - expected;
+                    }
+                }
+            }
+            timing->timestamps[p] = timestamp;
         }
+
+        timing->packets = packets;
+        timing->sequence = ring_timing->sequence;
+        timing->lost_packets = ring_timing->lost_packets - continuous->reported_lost_packets;
+        timing->overrun_packets = ring_timing->overrun_packets - continuous->reported_overrun_packets;
+        timing->anchor_tick = ring_timing->anchor_tick;
+        timing->anchor_sample = ring_timing->anchor_sample;
+        continuous->reported_lost_packets = ring_timing->lost_packets;
+        continuous->reported_overrun_packets = ring_timing->overrun_packets;
+        *len = count;
+    }
+    else
+    {
+        dblog(LOG_WARN, "Ping window was overwritten while it was extracted\n");
+    }
+
+    AbortIfNot(restart_continuous_detection(continuous, window_end), fail);
+
+    return success;
+}
+
+/**
+ * Stops a continuous capture and returns the descriptor ring to software.
+ *
+ * @param continuous The continuous capture, which may never have started.
+ *
+ * @return Success or fail.
+ */
+result_t stop_continuous_capture(continuous_capture_t *continuous)
+{
+    AbortIfNot(continuous, fail);
+
+    capture_t *capture = &continuous->capture;
+    if (capture->active)
+    {
+        AbortIfNot(abort_capture(capture), fail);
+        AbortIfNot(set_dma_callback(capture->dma, NULL, NULL), fail);
     }
+    continuous->flagged = false;
 
     return success;
 }
 
 /**
- * Normalize a number of samples.
+ * Discards packets that were buffered in the stream FIFO while the DMA engine
+ * was idle.
+ *
+ * @param dma A pointer to the AXI DMA driver with an initialized ring.
+ * @param data A scratch buffer of at least one packet.
+ * @param adc The QuadADC driver that is connected to the DMA.
+ *
+ * @return Success or fail.
+ */
+static result_t drain_stream(dma_engine_t *dma,
+                             sample_t *data,
+                             const adc_driver_t adc)
+{
+    capture_t capture;
+    bool drained = false;
+    result_t ret = success;
+
+    /*
+     * Keep reading single packets until the stream stays quiet for a
+     * millisecond.
+     */
+    while (!drained && ret == success)
+    {
+        ret = start_capture(&capture, dma, data, adc.regs->samples_per_packet, adc);
+
+        const uint32_t start_cycles = read_cycle_counter();
+        const uint32_t quiet_cycles = ticks_to_cycles(ms_to_ticks(1));
+        while (ret == success && !capture_done(&capture) &&
+               read_cycle_counter() - start_cycles < quiet_cycles)
+        {
+            if (!dma->interrupts_enabled)
+            {
+                ret = service_capture(&capture);
+            }
+        }
+
+        if (ret == success && !capture_done(&capture))
+        {
+            ret = abort_capture(&capture);
+            drained = true;
+        }
+
+        if (capture.error)
+        {
+            ret = fail;
+        }
+    }
+
+    AbortIfNot(set_dma_callback(dma, NULL, NULL), fail);
+
+    return ret;
+}
+
+/**
+ * Acquires sync on the ping using the threshold trigger in the QuadADC.
  *
- * @note This function finds the mean for each channel and subtracts it from
- *       each measurement of the respective channel.
+ * @note The FPGA compares the deviation of each channel from a common baseline
+ *       against the ping threshold and streams a single window of two packets
+ *       around the crossing, so no software scan of the capture is needed.
  *
- * @param data A pointer to the data to normalize.
- * @param len The length of samples to normalize.
+ * @param dma A pointer to the AXI DMA driver with an initialized ring.
+ * @param data A pointer to where the triggered window should be stored.
+ * @param[out] start_time The system time of the threshold crossing.
+ * @param[out] found Specified true if a ping was found.
+ * @param[out] max_value The maximum value of the triggered window.
+ * @param adc The QuadADC driver used for acquiring samples.
+ * @param params The current HydroZynq parameters.
+ * @param timing The hardware timestamps of the capture, or NULL if the stream
+ *        does not carry timestamps.
  *
  * @return Success or fail.
  */
-result_t normalize(sample_t *data, const size_t len)
+result_t acquire_triggered_sync(dma_engine_t *dma,
+                                sample_t *data,
+                                tick_t *start_time,
+                                bool *found,
+                                analog_sample_t *max_value,
+                                const adc_driver_t adc,
+                                HydroZynqParams *params,
+                                sample_timing_t *timing)
 {
+    AbortIfNot(dma, fail);
+    AbortIfNot(dma->ring.descriptors, fail);
     AbortIfNot(data, fail);
+    AbortIfNot(start_time, fail);
+    AbortIfNot(found, fail);
+    AbortIfNot(max_value, fail);
+    AbortIfNot(adc.regs, fail);
+    AbortIfNot(params, fail);
+
+    const uint32_t samples_per_packet = adc.regs->samples_per_packet;
+    AbortIfNot(samples_per_packet <= ADC_TRIGGER_MAX_PRE_SAMPLES, fail);
 
     /*
-     * Accumulate the total value of each channel to find the average value.
+     * Measure the baseline of the signal with the trigger disabled.
      */
-    uint64_t accumulators[4] = {0, 0, 0, 0};
-    for (size_t i = 0; i < len; ++i)
+    adc.regs->trigger_control = 0;
+    AbortIfNot(record(dma, data, samples_per_packet, adc), fail);
+    if (timing)
+    {
+        AbortIfNot(extract_timestamps(timing,
+                                      data,
+                                      samples_per_packet,
+                                      samples_per_packet,
+                                      get_system_time()), fail);
+    }
+
+    uint64_t accumulator = 0;
+    for (size_t i = 0; i < samples_per_packet; ++i)
     {
         for (size_t k = 0; k < 4; ++k)
         {
-            accumulators[k] += data[i].sample[k];
+            accumulator += data[i].sample[k];
         }
     }
 
+    const uint32_t baseline = accumulator / (samples_per_packet * 4);
+
     /*
-     * Calculate the average of the channel as the offset.
+     * Arm the trigger for a window of one packet before and one packet after
+     * the crossing and discard anything streamed before it was armed.
      */
-    analog_sample_t offset[4];
-    for (size_t k = 0; k < 4; ++k)
+    adc.regs->trigger_window = (samples_per_packet << ADC_TRIGGER_POST_SHIFT) |
+                               samples_per_packet;
+    adc.regs->trigger_control = ADC_TRIGGER_ENABLE |
+            ((baseline << ADC_TRIGGER_BASELINE_SHIFT) & ADC_TRIGGER_BASELINE_MASK) |
+            (params->ping_threshold & ADC_TRIGGER_THRESHOLD_MASK);
+
+    /*
+     * Correlate the window in the FPGA as it is streamed, removing the same
+     * baseline that the trigger measures against.
+     */
+    if (params->hw_correlate)
     {
-        offset[k] = accumulators[k] / len;
+        int32_t max_shift = correlation_max_shift(get_adc_sampling_frequency(&adc));
+        if (max_shift > ADC_CORRELATOR_MAX_SHIFT)
+        {
+            max_shift = ADC_CORRELATOR_MAX_SHIFT;
+        }
+        AbortIfNot(arm_adc_correlator(&adc, max_shift, baseline), fail);
     }
 
+    AbortIfNot(drain_stream(dma, data, adc), fail);
+
     /*
-     * Remove the average value from each sample.
+     * Wait up to a full ping period for the window to arrive.
      */
-    for (size_t i = 0; i < len; ++i)
+    capture_t capture;
+    const size_t window_samples = samples_per_packet * 2;
+    AbortIfNot(start_capture(&capture, dma, data, window_samples, adc), fail);
+
+    result_t ret = success;
+    while (ret == success && !capture_done(&capture) &&
+           get_system_time() - capture.start_time < ms_to_ticks(2100))
     {
-        for (size_t k = 0; k < 4; ++k)
+        if (!dma->interrupts_enabled)
+        {
+            ret = service_capture(&capture);
+        }
+
+        dispatch_network_stack();
+    }
+
+    *found = false;
+    if (ret == success && !capture_done(&capture))
+    {
+        ret = abort_capture(&capture);
+    }
+    else if (ret == success && capture.complete)
+    {
+        /*
+         * The pre-trigger packet is drained out of the history buffer as soon
+         * as the trigger fires, so its arrival marks the crossing.
+         */
+        *found = true;
+        *start_time = capture.first_packet_time;
+    }
+
+    adc.regs->trigger_control = 0;
+    AbortIfNot(set_dma_callback(dma, NULL, NULL), fail);
+    AbortIfNot(ret, fail);
+    AbortIf(capture.error, fail);
+
+    /*
+     * Report the maximum value of the window for diagnostics.
+     */
+    *max_value = 0;
+    if (*found)
+    {
+        /*
+         * The window timestamp locates the crossing exactly: it is the first
+         * sample after the pre-trigger history.
+         */
+        if (timing)
         {
-            data[i].sample[k] -= offset[k];
+            AbortIfNot(extract_timestamps(timing,
+                                          data,
+                                          window_samples,
+                                          samples_per_packet,
+                                          capture.last_progress), fail);
+            *start_time = sample_index_to_tick(timing,
+                                               timing->timestamps[0] + samples_per_packet,
+                                               get_adc_sampling_frequency(&adc));
         }
+
+        AbortIfNot(normalize(data, window_samples), fail);
+        AbortIfNot(scan_channel(data[0].sample,
+                                4,
+                                window_samples,
+                                0,
+                                NULL,
+                                NULL,
+                                max_value), fail);
     }
 
     return success;
 }
 
 /**
- * Acquire sync with the ping.
+ * Acquires sync on the ping from the envelope that the QuadADC streams.
  *
- * @param dma A pointer to the DMA driver to use for sampling.
- * @param data A pointer to the location to store data.
- * @param max_len The maximum number of samples pointed to by data.
- * @param[out] start_time The tick that the ping started at.
- * @param[out] found Specified true if the ping was found.
- * @param[out] max_value The maximum value encountered on the reference channel.
+ * @note Only the smoothed power of each channel, decimated by
+ *       ENVELOPE_SYNC_DECIMATION, is read while waiting for the ping, so no
+ *       samples are transferred or scanned. A steady tone whose amplitude is
+ *       the ping threshold has a mean power of half its square, which is the
+ *       power that denotes a ping. The crossing is located to within one
+ *       envelope sample and lags the onset by up to the smoothing time
+ *       constant, which is much shorter than the window around the ping.
+ *
+ * @param dma A pointer to the AXI DMA driver with an initialized ring.
+ * @param data A pointer to where the baseline packet should be stored.
+ * @param[out] start_time The system time of the threshold crossing.
+ * @param[out] found Specified true if a ping was found.
+ * @param[out] max_value The amplitude of a tone with the highest power seen.
  * @param adc The QuadADC driver used for acquiring samples.
- * @param sampling_frequency The sampling frequency of acquisition.
- * @param sample_threshold The threshold to use for ping detection.
- * @param filter The IIR filter to use for filtering received data.
- * @param filter_order The order of the IIR filter.
+ * @param params The current HydroZynq parameters.
+ * @param timing The hardware timestamps of the capture, or NULL if the stream
+ *        does not carry timestamps.
  *
  * @return Success or fail.
  */
-result_t acquire_sync(dma_engine_t *dma,
-                      sample_t *data,
-                      size_t max_len,
-                      tick_t *start_time,
-                      bool *found,
-                      analog_sample_t *max_value,
-                      const adc_driver_t adc,
-                      const uint32_t sampling_frequency,
-                      HydroZynqParams *params,
-                      filter_coefficients_t *iir_filter,
-                      const size_t filter_order)
+result_t acquire_envelope_sync(dma_engine_t *dma,
+                               sample_t *data,
+                               tick_t *start_time,
+                               bool *found,
+                               analog_sample_t *max_value,
+                               const adc_driver_t adc,
+                               HydroZynqParams *params,
+                               sample_timing_t *timing)
 {
     AbortIfNot(dma, fail);
+    AbortIfNot(dma->ring.descriptors, fail);
     AbortIfNot(data, fail);
-    AbortIfNot(params, fail);
     AbortIfNot(start_time, fail);
     AbortIfNot(found, fail);
     AbortIfNot(max_value, fail);
     AbortIfNot(adc.regs, fail);
-    AbortIfNot(sampling_frequency, fail);
+    AbortIfNot(params, fail);
+    AbortIfNot(params->reference_channel < 4, fail);
 
-    const analog_sample_t sample_threshold = params->ping_threshold;
+    /*
+     * Measure the baseline of the signal, which the FPGA removes before the
+     * power of each channel is taken.
+     */
+    const uint32_t samples_per_packet = adc.regs->samples_per_packet;
+    AbortIfNot(record(dma, data, samples_per_packet, adc), fail);
+    if (timing)
+    {
+        AbortIfNot(extract_timestamps(timing,
+                                      data,
+                                      samples_per_packet,
+                                      samples_per_packet,
+                                      get_system_time()), fail);
+    }
 
-    tick_t record_start = get_system_time();
-    if (max_len % adc.regs->samples_per_packet)
+    uint64_t accumulator = 0;
+    for (size_t i = 0; i < samples_per_packet; ++i)
     {
-        max_len -= max_len % adc.regs->samples_per_packet;
+        for (size_t k = 0; k < 4; ++k)
+        {
+            accumulator += data[i].sample[k];
+        }
     }
 
-    /*
-     * Record and normalize the signal.
-     */
-    AbortIfNot(record(dma, data, max_len, adc), fail);
-    AbortIfNot(normalize(data, max_len), fail);
+    const uint32_t baseline = accumulator / (samples_per_packet * 4);
 
     /*
-     * Filter the received signal using the provided filter.
+     * Scale the power so that the threshold sits well within the 16 bits of
+     * each envelope sample, and smooth it over about one envelope sample.
      */
-    if (filter_order > 0 && params->filter)
+    const uint32_t threshold_power = ((uint32_t)params->ping_threshold * params->ping_threshold) / 2;
+    uint32_t output_shift = 0;
+    while ((threshold_power >> output_shift) >= (1u << ENVELOPE_SYNC_THRESHOLD_BITS) &&
+           output_shift < (ADC_ENVELOPE_OUTPUT_MASK >> ADC_ENVELOPE_OUTPUT_SHIFT))
+    {
+        output_shift++;
+    }
+
+    uint16_t threshold = threshold_power >> output_shift;
+    if (!threshold)
+    {
+        threshold = 1;
+    }
+
+    uint32_t smoothing_log2 = 0;
+    while ((2u << smoothing_log2) <= ENVELOPE_SYNC_DECIMATION &&
+           smoothing_log2 < (ADC_ENVELOPE_SMOOTHING_MASK >> ADC_ENVELOPE_SMOOTHING_SHIFT))
     {
-        AbortIfNot(filter(data, max_len, iir_filter, filter_order), fail);
+        smoothing_log2++;
     }
 
+    const uint32_t sampling_frequency = get_adc_sampling_frequency(&adc);
+    uint64_t armed_sample;
+    tick_t armed_tick;
+    AbortIfNot(read_adc_stream_time(&adc, &armed_sample, &armed_tick), fail);
+    AbortIfNot(arm_adc_envelope(&adc,
+                                ENVELOPE_SYNC_DECIMATION,
+                                smoothing_log2,
+                                output_shift,
+                                baseline), fail);
+
     /*
-     * Search the filtered signal for the maximum value. If it is
-     * above the threshold, indicate that sync was found.
+     * Wait up to a full ping period for the power to cross the threshold. An
+     * envelope that overflows its FIFO no longer has a known timestamp for
+     * each sample, so it is restarted.
      */
-    *max_value = data[0].sample[0];
-
-    for (size_t i = 0; i < max_len; ++i)
+    adc_envelope_t envelope[ENVELOPE_SYNC_READ_SAMPLES];
+    uint64_t envelope_index = 0;
+    uint16_t max_power = 0;
+    const tick_t start = get_system_time();
+    result_t ret = success;
+    *found = false;
+    while (ret == success && !*found && get_system_time() - start < ms_to_ticks(2100))
     {
-        for (size_t k = 0; k < 1; ++k)
+        size_t count = 0;
+        bool overflow = false;
+        ret = read_adc_envelope(&adc, envelope, ENVELOPE_SYNC_READ_SAMPLES, &count, &overflow);
+        if (ret == success && overflow)
         {
-            if (data[i].sample[k] > *max_value)
-            {
-                *max_value = data[i].sample[k];
-            }
+            dblog(LOG_WARN, "Envelope FIFO overflowed, restarting\n");
+            envelope_index = 0;
+            ret = arm_adc_envelope(&adc,
+                                   ENVELOPE_SYNC_DECIMATION,
+                                   smoothing_log2,
+                                   output_shift,
+                                   baseline);
+            continue;
+        }
 
-            if (data[i].sample[k] > sample_threshold)
+        for (size_t i = 0; ret == success && i < count && !*found; ++i)
+        {
+            for (size_t k = 0; k < 4; ++k)
             {
-                *start_time = record_start +
-                              i * (CPU_CLOCK_HZ / (float)sampling_frequency);
-                *found = true;
-                return success;
+                if (k != params->reference_channel && !params->trigger_any_channel)
+                {
+                    continue;
+                }
+
+                const uint16_t power = envelope[i].power[k];
+                if (power > max_power)
+                {
+                    max_power = power;
+                }
+
+                if (power >= threshold && !*found)
+                {
+                    *found = true;
+                    uint64_t first_sample;
+                    ret = read_adc_envelope_start(&adc, &first_sample);
+                    const uint64_t crossing = first_sample +
+                            (envelope_index + i) * ENVELOPE_SYNC_DECIMATION;
+                    *start_time = armed_tick;
+                    if (crossing > armed_sample)
+                    {
+                        *start_time += samples_to_ticks(crossing - armed_sample, sampling_frequency);
+                    }
+                }
             }
         }
+
+        envelope_index += count;
+        dispatch_network_stack();
     }
 
-    *found = false;
+    AbortIfNot(disarm_adc_envelope(&adc), fail);
+    AbortIfNot(ret, fail);
+
+    /*
+     * Report the amplitude of a tone with the highest power for diagnostics.
+     */
+    const float amplitude = sqrtf(2.0f * ((uint32_t)max_power << output_shift));
+    *max_value = (amplitude > INT16_MAX)? INT16_MAX : (analog_sample_t)amplitude;
+
     return success;
 }
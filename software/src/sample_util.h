@@ -2,14 +2,351 @@
 #define SAMPLE_UTIL_H
 
 #include "adc.h"
+#include "correlation_util.h"
 #include "dma.h"
+#include "matched_filter.h"
+#include "sample_clock.h"
+#include "sample_ops.h"
 #include "types.h"
 
+/**
+ * Defines the totals of every capture since boot.
+ */
+typedef struct sample_stats_t
+{
+    volatile uint64_t samples_captured;
+
+    /*
+     * Packets shorter than the configured packet length, which are discarded.
+     */
+    volatile uint32_t short_packets;
+
+    /*
+     * Samples that the FPGA lost to a full FIFO while a capture was in
+     * progress, and the number of captures that lost any.
+     */
+    volatile uint64_t dropped_samples;
+    volatile uint32_t overrun_captures;
+
+    /*
+     * The samples produced by the ADC as of the end of the last capture.
+     */
+    volatile uint64_t adc_samples;
+} sample_stats_t;
+
+/**
+ * Defines an asynchronous capture into a sample buffer through the DMA
+ * scatter-gather ring.
+ */
+typedef struct capture_t
+{
+    dma_engine_t *dma;
+    adc_driver_t adc;
+    sample_t *data;
+    size_t sample_count;
+    size_t samples_per_packet;
+
+    /*
+     * Specified true if the buffer is a ring that is recorded into until the
+     * capture is aborted. The sample counts then run on past the length of
+     * the ring, and sample i is held at i modulo its length.
+     */
+    bool circular;
+
+    /*
+     * The number of samples of each segment of a segmented capture and the
+     * distance in samples from one segment to the next, or zero if the
+     * samples are contiguous.
+     */
+    size_t segment_samples;
+    size_t segment_stride;
+
+    /*
+     * The length of each packet as it is received, whether its samples are
+     * packed, and the channels they carry. Packed and masked samples are
+     * expanded in place once the packet arrives.
+     */
+    uint32_t packet_bytes;
+    bool packed;
+    uint32_t channel_mask;
+
+    /*
+     * The channels that a planar capture is recorded into in place of data,
+     * or NULL if the samples are interleaved, and the statistics trailer of
+     * each packet, or NULL if the packets have none.
+     */
+    planar_samples_t *planar;
+    adc_packet_trailer_t *trailers;
+
+    /*
+     * The number of descriptors that each packet is written through, which
+     * is one unless the capture is planar or receives trailers, and the part
+     * of the packet arriving.
+     */
+    size_t packet_parts;
+    size_t packet_part;
+
+    /*
+     * The number of samples handed to the DMA engine and the number of
+     * samples that have been received.
+     */
+    size_t queued_samples;
+    volatile size_t total_samples;
+    volatile size_t invalid_packets;
+
+    /*
+     * The dropped sample count of the FPGA when the capture started, and the
+     * samples it dropped during the capture.
+     */
+    uint32_t dropped_at_start;
+    volatile uint32_t dropped_samples;
+
+    volatile bool active;
+    volatile bool complete;
+    volatile bool error;
+
+    /*
+     * The time the capture started, the time the first packet was received,
+     * and the time of the most recently received packet.
+     */
+    tick_t start_time;
+    volatile tick_t first_packet_time;
+    volatile tick_t last_progress;
+
+    /*
+     * The maximum time allowed between received packets.
+     */
+    tick_t timeout;
+} capture_t;
+
+/**
+ * Defines the hardware sample timestamps recovered from a capture.
+ */
+typedef struct sample_timing_t
+{
+    /*
+     * Storage for the sample index of the first sample of each packet.
+     */
+    uint64_t *timestamps;
+    size_t max_packets;
+
+    /*
+     * The sequence number of the last packet decoded.
+     */
+    uint32_t sequence;
+
+    /*
+     * The number of packets and samples per packet of the last capture.
+     */
+    size_t packets;
+    size_t samples_per_packet;
+
+    /*
+     * The number of breaks in the sample sequence and the number of samples
+     * that were lost across them.
+     */
+    size_t discontinuities;
+    uint64_t dropped_samples;
+
+    /*
+     * The number of packets that were lost whole, found from breaks in the
+     * packet sequence numbers, and the number of packets whose header
+     * reported that the FIFO had overrun since the previous packet.
+     */
+    size_t lost_packets;
+    size_t overrun_packets;
+
+    /*
+     * The system time at which the sample with index anchor_sample arrived.
+     */
+    tick_t anchor_tick;
+    uint64_t anchor_sample;
+
+    /*
+     * The precomputed conversions of the sampling frequency, if it has been
+     * set.
+     */
+    sample_clock_t clock;
+} sample_timing_t;
+
+/**
+ * Defines a streaming ping detector that removes DC, filters, and searches for
+ * the threshold crossing as chunks of samples arrive.
+ */
+typedef struct ping_detector_t
+{
+    biquad_cascade_t cascade;
+    bool filter;
+
+    /*
+     * The running DC estimate of each channel with 16 fractional bits.
+     */
+    int64_t dc[4];
+    bool dc_initialized;
+
+    /*
+     * The narrowband detector used in place of the broadband threshold when
+     * a pinger frequency is configured.
+     */
+    tone_detector_t tone;
+
+    analog_sample_t threshold;
+    analog_sample_t max_value;
+
+    /*
+     * The CFAR detector used in place of the fixed threshold when enabled.
+     */
+    cfar_detector_t cfar;
+    bool cfar_enabled;
+
+    /*
+     * The matched filter used in place of the other detectors when it holds
+     * a template and a threshold is set, or NULL.
+     */
+    matched_filter_t *matched;
+    uint32_t matched_threshold;
+
+    /*
+     * The number of samples processed, and the index of the crossing if one
+     * was found.
+     */
+    size_t processed;
+    bool found;
+    size_t found_index;
+} ping_detector_t;
+
+/**
+ * Defines a capture that records into a ring at all times while a decimated
+ * detection stream is searched for pings, so that the window around each
+ * ping is extracted from the history of the ring once it has arrived.
+ */
+typedef struct continuous_capture_t
+{
+    capture_t capture;
+    sample_t *ring;
+    size_t ring_len;
+    size_t ring_packets;
+    size_t samples_per_packet;
+    uint32_t sampling_frequency;
+
+    /*
+     * The timestamps of the packets in the ring, indexed by their slot, and
+     * its lost and overrun packet counts when the last window was extracted.
+     */
+    sample_timing_t *timing;
+    size_t reported_lost_packets;
+    size_t reported_overrun_packets;
+
+    /*
+     * The detection stream, the rate it is decimated by, and the thresholds
+     * its detector is restarted with.
+     */
+    boxcar_decimator_t decimator;
+    ping_detector_t detector;
+    size_t factor;
+    analog_sample_t ping_threshold;
+    uint8_t cfar_threshold;
+    uint32_t ping_frequency;
+
+    /*
+     * The samples that the window reaches before and after a crossing.
+     */
+    size_t pre_ping_samples;
+    size_t post_ping_samples;
+
+    /*
+     * Samples are counted from the start of the capture: those received and
+     * searched, where the detection stream began, and the first packet whose
+     * timestamp was recovered.
+     */
+    size_t received;
+    size_t processed;
+    size_t origin;
+    size_t first_packet;
+
+    /*
+     * Specified true once a crossing is found, until the window around it
+     * has been extracted.
+     */
+    bool flagged;
+    size_t window_start;
+    size_t window_end;
+} continuous_capture_t;
+
+result_t start_capture(capture_t *capture,
+                       dma_engine_t *dma,
+                       sample_t *data,
+                       const size_t sample_count,
+                       const adc_driver_t adc);
+
+result_t start_capture_from_interrupt(capture_t *capture,
+                                      dma_engine_t *dma,
+                                      sample_t *data,
+                                      const size_t sample_count,
+                                      const adc_driver_t adc);
+
+result_t start_ring_capture(capture_t *capture,
+                            dma_engine_t *dma,
+                            sample_t *ring,
+                            const size_t ring_len,
+                            const adc_driver_t adc);
+
+result_t init_segmented_layout(segmented_layout_t *layout,
+                               void *buffer,
+                               const size_t bytes,
+                               const size_t segment_samples,
+                               const size_t reserved_bytes);
+
+sample_t *get_layout_segment(const segmented_layout_t *layout, const size_t segment);
+
+result_t start_segmented_capture(capture_t *capture,
+                                 dma_engine_t *dma,
+                                 const segmented_layout_t *layout,
+                                 const size_t sample_count,
+                                 const adc_driver_t adc);
+
+result_t start_planar_capture(capture_t *capture,
+                              dma_engine_t *dma,
+                              planar_samples_t *planar,
+                              const size_t sample_count,
+                              const adc_driver_t adc);
+
+result_t start_stats_capture(capture_t *capture,
+                             dma_engine_t *dma,
+                             sample_t *data,
+                             adc_packet_trailer_t *trailers,
+                             const size_t sample_count,
+                             const adc_driver_t adc);
+
+result_t service_capture(capture_t *capture);
+
+bool capture_done(capture_t *capture);
+
+result_t wait_for_capture(capture_t *capture);
+
+result_t abort_capture(capture_t *capture);
+
 result_t record(dma_engine_t *dma,
                 sample_t *data,
                 const size_t max_len,
                 const adc_driver_t adc);
 
+result_t record_segmented(dma_engine_t *dma,
+                          const segmented_layout_t *layout,
+                          const size_t sample_count,
+                          const adc_driver_t adc);
+
+result_t record_planar(dma_engine_t *dma,
+                       planar_samples_t *planar,
+                       const size_t sample_count,
+                       const adc_driver_t adc);
+
+result_t record_with_stats(dma_engine_t *dma,
+                           sample_t *data,
+                           adc_packet_trailer_t *trailers,
+                           const size_t sample_count,
+                           const adc_driver_t adc);
+
 result_t acquire_sync(dma_engine_t *dma,
                       sample_t *data,
                       size_t max_len,
@@ -19,9 +356,106 @@ result_t acquire_sync(dma_engine_t *dma,
                       const adc_driver_t adc,
                       const uint32_t sampling_frequency,
                       HydroZynqParams *params,
-                      filter_coefficients_t *filter,
-                      const size_t filter_order);
+                      const biquad_cascade_t *filter,
+                      matched_filter_t *matched,
+                      sample_timing_t *timing);
+
+result_t acquire_dual_rate_sync(dma_engine_t *dma,
+                                sample_t *data,
+                                size_t max_len,
+                                tick_t *ping_start,
+                                bool *found,
+                                analog_sample_t *max_value,
+                                const adc_driver_t adc,
+                                const uint32_t sampling_frequency,
+                                HydroZynqParams *params,
+                                const biquad_cascade_t *filter,
+                                matched_filter_t *matched,
+                                sample_timing_t *timing);
+
+result_t acquire_triggered_sync(dma_engine_t *dma,
+                                sample_t *data,
+                                tick_t *ping_start,
+                                bool *found,
+                                analog_sample_t *max_value,
+                                const adc_driver_t adc,
+                                HydroZynqParams *params,
+                                sample_timing_t *timing);
+
+result_t acquire_envelope_sync(dma_engine_t *dma,
+                               sample_t *data,
+                               tick_t *ping_start,
+                               bool *found,
+                               analog_sample_t *max_value,
+                               const adc_driver_t adc,
+                               HydroZynqParams *params,
+                               sample_timing_t *timing);
+
+result_t start_continuous_capture(continuous_capture_t *continuous,
+                                  dma_engine_t *dma,
+                                  sample_t *ring,
+                                  const size_t ring_len,
+                                  const adc_driver_t adc,
+                                  const uint32_t sampling_frequency,
+                                  const HydroZynqParams *params,
+                                  const biquad_cascade_t *filter,
+                                  sample_timing_t *timing);
+
+result_t service_continuous_capture(continuous_capture_t *continuous);
+
+bool continuous_ping_ready(const continuous_capture_t *continuous);
+
+result_t extract_continuous_ping(continuous_capture_t *continuous,
+                                 sample_t *data,
+                                 const size_t capacity,
+                                 sample_timing_t *timing,
+                                 size_t *len,
+                                 bool *extracted);
+
+result_t stop_continuous_capture(continuous_capture_t *continuous);
+
+result_t init_ping_detector(ping_detector_t *detector,
+                            const analog_sample_t threshold,
+                            const uint8_t cfar_threshold,
+                            const uint32_t ping_frequency,
+                            const uint32_t sampling_frequency,
+                            const biquad_cascade_t *filter,
+                            matched_filter_t *matched,
+                            const uint8_t matched_threshold);
+
+result_t run_ping_detector(ping_detector_t *detector,
+                           sample_t *data,
+                           const size_t len);
+
+void get_sample_stats(sample_stats_t *stats);
+
+result_t init_sample_timing(sample_timing_t *timing,
+                            uint64_t *timestamps,
+                            const size_t max_packets);
+
+result_t extract_timestamps(sample_timing_t *timing,
+                            sample_t *data,
+                            const size_t len,
+                            const size_t samples_per_packet,
+                            const tick_t end_tick);
+
+result_t extract_planar_timestamps(sample_timing_t *timing,
+                                   planar_samples_t *planar,
+                                   const size_t len,
+                                   const size_t samples_per_packet,
+                                   const tick_t end_tick);
+
+result_t set_sample_timing_rate(sample_timing_t *timing, const uint32_t sampling_frequency);
+
+uint64_t get_sample_index(const sample_timing_t *timing, const size_t i);
+
+result_t align_captures(const sample_timing_t *timings,
+                        const size_t count,
+                        size_t *offsets,
+                        size_t *len);
 
-result_t normalize(sample_t *data, const size_t len);
+tick_t sample_index_to_tick(const sample_timing_t *timing,
+                            const uint64_t index,
+                            const uint32_t sampling_frequency);
 
 #endif
@@ -0,0 +1,141 @@
+#include "scheduler.h"
+
+#include "abort.h"
+#include "system.h"
+
+#include <string.h>
+
+/**
+ * Initializes a scheduler without any tasks.
+ *
+ * @param[out] scheduler The scheduler to initialize.
+ *
+ * @return Success or fail.
+ */
+result_t init_scheduler(scheduler_t *scheduler)
+{
+    AbortIfNot(scheduler, fail);
+
+    memset(scheduler, 0, sizeof(*scheduler));
+
+    return success;
+}
+
+/**
+ * Adds a task to a scheduler. A periodic task is first due one period after
+ * it is added.
+ *
+ * @param scheduler The scheduler to add to.
+ * @param name The name of the task.
+ * @param priority The priority of the task.
+ * @param period The time between runs, or zero to run every turn.
+ * @param function The function of the task.
+ * @param arg The argument provided to the function.
+ *
+ * @return Success or fail.
+ */
+result_t add_task(scheduler_t *scheduler,
+                  const char *name,
+                  const task_priority_t priority,
+                  const tick_t period,
+                  task_function_t function,
+                  void *arg)
+{
+    AbortIfNot(scheduler, fail);
+    AbortIfNot(function, fail);
+    AbortIfNot(priority < TASK_PRIORITIES, fail);
+    AbortIfNot(scheduler->num_tasks < SCHEDULER_MAX_TASKS, fail);
+
+    task_t *task = &scheduler->tasks[scheduler->num_tasks++];
+    memset(task, 0, sizeof(*task));
+    task->name = name;
+    task->function = function;
+    task->arg = arg;
+    task->priority = priority;
+    task->period = period;
+    task->next_due = get_system_time() + period;
+
+    return success;
+}
+
+/**
+ * Runs one turn of a scheduler. Each task of the selected priorities that is
+ * due runs once, in order of priority and then of deadline.
+ *
+ * @param scheduler The scheduler to run.
+ * @param priorities The mask of priorities that may run, from TASK_MASK().
+ *
+ * @return Success or fail.
+ */
+result_t run_tasks(scheduler_t *scheduler, const uint32_t priorities)
+{
+    AbortIfNot(scheduler, fail);
+
+    bool ran[SCHEDULER_MAX_TASKS] = {false};
+    while (1)
+    {
+        const tick_t now = get_system_time();
+
+        /*
+         * There are few tasks, so the next one is found by a scan rather than
+         * by keeping a queue ordered.
+         */
+        task_t *next = NULL;
+        size_t next_index = 0;
+        for (size_t i = 0; i < scheduler->num_tasks; ++i)
+        {
+            task_t *task = &scheduler->tasks[i];
+            if (ran[i] || task->running || !(priorities & TASK_MASK(task->priority)) ||
+                task->next_due > now)
+            {
+                continue;
+            }
+
+            if (!next || task->priority < next->priority ||
+                (task->priority == next->priority && task->next_due < next->next_due))
+            {
+                next = task;
+                next_index = i;
+            }
+        }
+
+        if (!next)
+        {
+            break;
+        }
+
+        ran[next_index] = true;
+
+        /*
+         * A periodic task that has fallen behind skips the periods it missed
+         * rather than running repeatedly to catch up.
+         */
+        if (next->period)
+        {
+            next->next_due += next->period;
+            if (next->next_due <= now)
+            {
+                next->next_due = now + next->period;
+            }
+        }
+        else
+        {
+            next->next_due = now;
+        }
+
+        next->running = true;
+        const result_t ret = next->function(next->arg);
+        next->running = false;
+
+        const tick_t duration = get_system_time() - now;
+        next->runs++;
+        if (duration > next->max_duration)
+        {
+            next->max_duration = duration;
+        }
+
+        AbortIfNot(ret, fail);
+    }
+
+    return success;
+}
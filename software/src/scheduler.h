@@ -0,0 +1,87 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "types.h"
+
+/**
+ * The most tasks that a scheduler holds.
+ */
+#define SCHEDULER_MAX_TASKS 16
+
+/**
+ * Defines the priorities of background tasks, from most to least urgent.
+ */
+typedef enum task_priority_t
+{
+    TASK_ACQUISITION = 0,
+    TASK_DSP = 1,
+    TASK_RESULT_TX = 2,
+    TASK_DEBUG_TX = 3,
+    TASK_LOGGING = 4,
+    TASK_PRIORITIES = 5
+} task_priority_t;
+
+/**
+ * Selects the priorities of the tasks that a turn of the scheduler may run.
+ */
+#define TASK_MASK(priority) (1u << (priority))
+#define TASKS_ALL ((1u << TASK_PRIORITIES) - 1)
+
+/**
+ * Defines the function of a task, which runs to completion.
+ */
+typedef result_t (*task_function_t)(void *arg);
+
+/**
+ * Defines a background task and its timing.
+ */
+typedef struct task_t
+{
+    const char *name;
+    task_function_t function;
+    void *arg;
+    task_priority_t priority;
+
+    /*
+     * The time between runs, or zero for a task that runs every turn, and
+     * the time the task is next due. A task that runs every turn is due from
+     * its previous run, so the longest waiting runs first.
+     */
+    tick_t period;
+    tick_t next_due;
+
+    /*
+     * Specified true while the task runs, so a task that enters the
+     * scheduler is not run again within itself.
+     */
+    bool running;
+
+    uint32_t runs;
+    tick_t max_duration;
+} task_t;
+
+/**
+ * Defines a run-to-completion scheduler of background tasks.
+ *
+ * @note The capture, DSP and send sequence of go() is not a task. It runs in
+ *       the foreground and turns the scheduler at its waits and at the
+ *       boundaries between its stages.
+ */
+typedef struct scheduler_t
+{
+    task_t tasks[SCHEDULER_MAX_TASKS];
+    size_t num_tasks;
+} scheduler_t;
+
+result_t init_scheduler(scheduler_t *scheduler);
+
+result_t add_task(scheduler_t *scheduler,
+                  const char *name,
+                  const task_priority_t priority,
+                  const tick_t period,
+                  task_function_t function,
+                  void *arg);
+
+result_t run_tasks(scheduler_t *scheduler, const uint32_t priorities);
+
+#endif
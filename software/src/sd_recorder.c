@@ -0,0 +1,308 @@
+#include "sd_recorder.h"
+
+#include "abort.h"
+#include "db.h"
+#include "types.h"
+#include "xparameters.h"
+#include "xsdps.h"
+#include "xstatus.h"
+
+#include <string.h>
+
+/**
+ * Writes blocks of the recording region.
+ *
+ * @note The write is a single multi-block transfer by the controller's
+ *       ADMA2 engine, which flushes the buffer from the cache itself.
+ *
+ * @param recorder The SD card recorder.
+ * @param block The first block to write, relative to the region.
+ * @param count The number of blocks to write.
+ * @param data The data to write, which must be 32 byte aligned.
+ *
+ * @return Success or fail.
+ */
+static result_t write_sd_blocks(sd_recorder_t *recorder,
+                                const uint32_t block,
+                                const uint32_t count,
+                                const void *data)
+{
+    AbortIfNot(block + count <= SD_RECORD_BLOCKS, fail);
+
+    /*
+     * Standard capacity cards are addressed in bytes rather than blocks.
+     */
+    const uint32_t address = SD_RECORD_FIRST_BLOCK + block;
+    const uint32_t arg = (recorder->sd.HCS)? address : address * SD_BLOCK_BYTES;
+    if (XSdPs_WritePolled(&recorder->sd, arg, count, (const u8 *)data) != XST_SUCCESS)
+    {
+        recorder->write_errors++;
+        AbortIfNot(false, fail);
+    }
+
+    return success;
+}
+
+/**
+ * Writes the index entries not yet on the card and then the header, so that
+ * the region reads as a complete capture file.
+ *
+ * @param recorder The SD card recorder.
+ *
+ * @return Success or fail.
+ */
+static result_t write_sd_index(sd_recorder_t *recorder)
+{
+    const uint32_t num_pings = recorder->header.header.num_pings;
+    const size_t per_block = SD_BLOCK_BYTES / sizeof(capture_file_ping_t);
+    const uint32_t first = recorder->indexed_pings / per_block;
+    const uint32_t last = (num_pings + per_block - 1) / per_block;
+    if (last > first)
+    {
+        AbortIfNot(write_sd_blocks(recorder,
+                                   SD_RECORD_BLOCKS - SD_RECORD_INDEX_BLOCKS + first,
+                                   last - first,
+                                   &recorder->pings[first * per_block]), fail);
+    }
+    recorder->indexed_pings = num_pings;
+
+    AbortIfNot(write_sd_blocks(recorder, 0, 1, recorder->header.block), fail);
+
+    return success;
+}
+
+/**
+ * Brings up the SD card controller and the card.
+ *
+ * @param recorder The SD card recorder.
+ *
+ * @return Success or fail.
+ */
+static result_t init_sd_card(sd_recorder_t *recorder)
+{
+    XSdPs_Config *config = XSdPs_LookupConfig(XPAR_PS7_SD_0_DEVICE_ID);
+    AbortIfNot(config, fail);
+    AbortIfNot(XSdPs_CfgInitialize(&recorder->sd, config, config->BaseAddress) == XST_SUCCESS, fail);
+    AbortIfNot(XSdPs_CardInitialize(&recorder->sd) == XST_SUCCESS, fail);
+
+    /*
+     * The sector count is only known to drivers that read it from the card.
+     */
+    AbortIf(recorder->sd.SectorCount &&
+            recorder->sd.SectorCount < SD_RECORD_FIRST_BLOCK + SD_RECORD_BLOCKS, fail);
+
+    recorder->card_ready = true;
+
+    return success;
+}
+
+/**
+ * Begins a recording to the SD card, which replaces any previous recording.
+ *
+ * @param recorder The SD card recorder.
+ * @param mode What to record.
+ * @param header The header of the recording, initialized by
+ *        init_capture_file_header(). Its layout fields are assigned.
+ *
+ * @return Success or fail.
+ */
+result_t start_sd_recorder(sd_recorder_t *recorder,
+                           const sd_record_mode_t mode,
+                           const capture_file_header_t *header)
+{
+    AbortIfNot(recorder, fail);
+    AbortIfNot(header, fail);
+    AbortIfNot(mode != SD_RECORD_OFF, fail);
+
+    AbortIfNot(stop_sd_recorder(recorder), fail);
+    if (!recorder->card_ready)
+    {
+        AbortIfNot(init_sd_card(recorder), fail);
+    }
+
+    /*
+     * The samples start at the second block so that every write of them is
+     * block aligned.
+     */
+    memset(recorder->header.block, 0, sizeof(recorder->header.block));
+    recorder->header.header = *header;
+    recorder->header.header.header_bytes = SD_BLOCK_BYTES;
+    recorder->header.header.total_samples = 0;
+    recorder->header.header.num_pings = 0;
+    recorder->header.header.index_offset = (uint64_t)(SD_RECORD_BLOCKS - SD_RECORD_INDEX_BLOCKS) * SD_BLOCK_BYTES;
+
+    recorder->fill_chunk = 0;
+    recorder->fill_bytes = 0;
+    recorder->write_chunk = 0;
+    recorder->full_chunks = 0;
+    recorder->next_block = 1;
+    recorder->end_block = SD_RECORD_BLOCKS - SD_RECORD_INDEX_BLOCKS;
+    recorder->indexed_pings = 0;
+    recorder->recorded = 0;
+    recorder->dropped = 0;
+
+    AbortIfNot(write_sd_index(recorder), fail);
+    recorder->mode = mode;
+
+    return success;
+}
+
+/**
+ * Copies a window into the staging chunks of the recorder to be written to
+ * the card in the background.
+ *
+ * @note A window is dropped rather than waiting when the staging chunks or
+ *       the region cannot hold it.
+ *
+ * @param recorder The SD card recorder.
+ * @param data The window to record.
+ * @param count The number of samples in the window.
+ * @param start_tick The system time of the first sample, or zero if it is
+ *        not known.
+ *
+ * @return Success or fail.
+ */
+result_t push_sd_record(sd_recorder_t *recorder,
+                        const sample_t *data,
+                        const size_t count,
+                        const tick_t start_tick)
+{
+    AbortIfNot(recorder, fail);
+    AbortIfNot(data, fail);
+
+    if (recorder->mode == SD_RECORD_OFF || count == 0)
+    {
+        return success;
+    }
+
+    capture_file_header_t *header = &recorder->header.header;
+    const size_t bytes = count * sizeof(sample_t);
+    const size_t staged_free = (SD_RECORD_STAGE_CHUNKS - recorder->full_chunks) * SD_RECORD_CHUNK_BYTES -
+            recorder->fill_bytes;
+    const uint64_t region_free = (uint64_t)(recorder->end_block - recorder->next_block) * SD_BLOCK_BYTES -
+            (uint64_t)recorder->full_chunks * SD_RECORD_CHUNK_BYTES - recorder->fill_bytes;
+    if (bytes > staged_free || bytes > region_free || header->num_pings == SD_RECORD_MAX_PINGS)
+    {
+        recorder->dropped++;
+        return success;
+    }
+
+    const uint8_t *source = (const uint8_t *)data;
+    size_t remaining = bytes;
+    while (remaining)
+    {
+        const size_t space = SD_RECORD_CHUNK_BYTES - recorder->fill_bytes;
+        const size_t len = (remaining < space)? remaining : space;
+        memcpy(&recorder->stage[recorder->fill_chunk][recorder->fill_bytes], source, len);
+        source += len;
+        remaining -= len;
+        recorder->fill_bytes += len;
+
+        if (recorder->fill_bytes == SD_RECORD_CHUNK_BYTES)
+        {
+            recorder->full_chunks++;
+            recorder->fill_chunk = (recorder->fill_chunk + 1) % SD_RECORD_STAGE_CHUNKS;
+            recorder->fill_bytes = 0;
+        }
+    }
+
+    capture_file_ping_t *ping = &recorder->pings[header->num_pings++];
+    ping->first_sample = header->total_samples;
+    ping->sample_count = count;
+    ping->transfer_id = recorder->recorded++;
+    ping->hw_timestamp = start_tick;
+    ping->host_time_ns = 0;
+    header->total_samples += count;
+
+    return success;
+}
+
+/**
+ * Writes the next full staging chunk to the card, or rewrites the index once
+ * enough pings have been recorded since it was last written.
+ *
+ * @note A write that fails ends the recording, so that the card is not
+ *       retried at the cost of acquisition.
+ *
+ * @param recorder The SD card recorder.
+ *
+ * @return Success or fail.
+ */
+result_t service_sd_recorder(sd_recorder_t *recorder)
+{
+    AbortIfNot(recorder, fail);
+
+    if (recorder->mode == SD_RECORD_OFF)
+    {
+        return success;
+    }
+
+    result_t ret = success;
+    if (recorder->full_chunks)
+    {
+        ret = write_sd_blocks(recorder,
+                              recorder->next_block,
+                              SD_RECORD_CHUNK_BLOCKS,
+                              recorder->stage[recorder->write_chunk]);
+        recorder->next_block += SD_RECORD_CHUNK_BLOCKS;
+        recorder->write_chunk = (recorder->write_chunk + 1) % SD_RECORD_STAGE_CHUNKS;
+        recorder->full_chunks--;
+    }
+    else if (recorder->header.header.num_pings - recorder->indexed_pings >= SD_RECORD_INDEX_INTERVAL)
+    {
+        ret = write_sd_index(recorder);
+    }
+
+    if (ret != success)
+    {
+        recorder->mode = SD_RECORD_OFF;
+        AbortIfNot(false, fail);
+    }
+
+    return success;
+}
+
+/**
+ * Writes every staged sample and the index to the card and ends the
+ * recording.
+ *
+ * @note The final chunk is padded to a whole block.
+ *
+ * @param recorder The SD card recorder.
+ *
+ * @return Success or fail.
+ */
+result_t stop_sd_recorder(sd_recorder_t *recorder)
+{
+    AbortIfNot(recorder, fail);
+
+    if (recorder->mode == SD_RECORD_OFF)
+    {
+        return success;
+    }
+
+    while (recorder->full_chunks)
+    {
+        AbortIfNot(service_sd_recorder(recorder), fail);
+    }
+
+    recorder->mode = SD_RECORD_OFF;
+    if (recorder->fill_bytes)
+    {
+        const uint32_t blocks = (recorder->fill_bytes + SD_BLOCK_BYTES - 1) / SD_BLOCK_BYTES;
+        memset(&recorder->stage[recorder->fill_chunk][recorder->fill_bytes],
+               0,
+               blocks * SD_BLOCK_BYTES - recorder->fill_bytes);
+        AbortIfNot(write_sd_blocks(recorder,
+                                   recorder->next_block,
+                                   blocks,
+                                   recorder->stage[recorder->fill_chunk]), fail);
+        recorder->next_block += blocks;
+        recorder->fill_bytes = 0;
+    }
+
+    AbortIfNot(write_sd_index(recorder), fail);
+    dbprintf("Recorded %u windows to the SD card, dropped %u.\n", recorder->recorded, recorder->dropped);
+
+    return success;
+}
@@ -0,0 +1,102 @@
+#ifndef SD_RECORDER_H
+#define SD_RECORDER_H
+
+#include "capture_format.h"
+#include "system_params.h"
+#include "types.h"
+#include "xsdps.h"
+
+/**
+ * The size of an SD card block and of each multi-block write of samples.
+ */
+#define SD_BLOCK_BYTES 512
+#define SD_RECORD_CHUNK_BYTES (SD_RECORD_CHUNK_BLOCKS * SD_BLOCK_BYTES)
+
+/**
+ * The blocks of the recording region that hold the ping index, which is
+ * kept at the end of the region so that it never moves as samples grow.
+ */
+#define SD_RECORD_INDEX_BLOCKS ((SD_RECORD_MAX_PINGS * sizeof(capture_file_ping_t) + SD_BLOCK_BYTES - 1) / \
+                                SD_BLOCK_BYTES)
+
+/**
+ * Defines what is recorded to the SD card.
+ */
+typedef enum sd_record_mode_t
+{
+    SD_RECORD_OFF = 0,
+
+    /*
+     * The window around each located ping.
+     */
+    SD_RECORD_PINGS = 1,
+
+    /*
+     * Every capture in full.
+     */
+    SD_RECORD_CAPTURES = 2
+} sd_record_mode_t;
+
+/**
+ * Defines a recorder that writes captures to a preallocated region of the SD
+ * card in the capture file format.
+ *
+ * @note The region holds a capture file whose header is padded to a block,
+ *       and may be copied off the card as is, for example with
+ *       dd if=<card> of=<file> bs=512 skip=SD_RECORD_FIRST_BLOCK
+ *       count=SD_RECORD_BLOCKS.
+ */
+typedef struct sd_recorder_t
+{
+    XSdPs sd;
+    bool card_ready;
+    sd_record_mode_t mode;
+
+    /*
+     * The block header and the ping index, which are rewritten in place.
+     */
+    union
+    {
+        capture_file_header_t header;
+        uint8_t block[SD_BLOCK_BYTES];
+    } header __attribute__((aligned(32)));
+    capture_file_ping_t pings[SD_RECORD_INDEX_BLOCKS * SD_BLOCK_BYTES / sizeof(capture_file_ping_t)]
+            __attribute__((aligned(32)));
+
+    /*
+     * The ring of staging chunks. Samples are copied into the chunk being
+     * filled, and each full chunk is written with one multi-block write.
+     */
+    uint8_t stage[SD_RECORD_STAGE_CHUNKS][SD_RECORD_CHUNK_BYTES] __attribute__((aligned(32)));
+    size_t fill_chunk;
+    size_t fill_bytes;
+    size_t write_chunk;
+    size_t full_chunks;
+
+    /*
+     * The next block of the sample area to write, the block after the last
+     * block of the area, and the pings whose index entries are on the card.
+     */
+    uint32_t next_block;
+    uint32_t end_block;
+    uint32_t indexed_pings;
+
+    uint32_t recorded;
+    uint32_t dropped;
+    uint32_t write_errors;
+} sd_recorder_t;
+
+result_t start_sd_recorder(sd_recorder_t *recorder,
+                           const sd_record_mode_t mode,
+                           const capture_file_header_t *header);
+
+result_t push_sd_record(sd_recorder_t *recorder,
+                        const sample_t *data,
+                        const size_t count,
+                        const tick_t start_tick);
+
+result_t service_sd_recorder(sd_recorder_t *recorder);
+
+result_t stop_sd_recorder(sd_recorder_t *recorder);
+
+#endif
@@ -0,0 +1,173 @@
+#include "sliding_correlation.h"
+
+#include "abort.h"
+#include "types.h"
+
+#include <string.h>
+
+/**
+ * Initializes an empty sliding correlation.
+ *
+ * @param[out] correlation The correlation to initialize.
+ * @param history The storage of the window, which must hold window samples.
+ * @param window The number of samples to correlate over, which must be a
+ *        power of two longer than the largest shift.
+ * @param sums The storage of the sums, which must hold
+ *        SLIDING_CORRELATION_SUMS(max_shift) values.
+ * @param max_shift The largest shift to correlate.
+ *
+ * @return Success or fail.
+ */
+result_t init_sliding_correlation(sliding_correlation_t *correlation,
+                                  sample_t *history,
+                                  const size_t window,
+                                  int64_t *sums,
+                                  const int32_t max_shift)
+{
+    AbortIfNot(correlation, fail);
+    AbortIfNot(history, fail);
+    AbortIfNot(sums, fail);
+    AbortIfNot(max_shift > 0, fail);
+    AbortIfNot(window > (size_t)max_shift, fail);
+    AbortIfNot((window & (window - 1)) == 0, fail);
+
+    correlation->history = history;
+    correlation->window = window;
+    correlation->sums = sums;
+    correlation->max_shift = max_shift;
+    reset_sliding_correlation(correlation);
+
+    return success;
+}
+
+/**
+ * Discards every sample from a sliding correlation.
+ *
+ * @param correlation The correlation to reset.
+ *
+ * @return None.
+ */
+void reset_sliding_correlation(sliding_correlation_t *correlation)
+{
+    correlation->count = 0;
+    memset(correlation->sums, 0, SLIDING_CORRELATION_SUMS(correlation->max_shift) * sizeof(int64_t));
+}
+
+/**
+ * Adds samples to a sliding correlation, removing the oldest samples once
+ * the window is full.
+ *
+ * @note For a left shift s, the window holds the products of reference
+ *       sample i with sample i + s of each channel where both lie in the
+ *       window. A new sample n adds the products that pair it with the
+ *       window, and the sample n - window that leaves removes the products
+ *       pairing it with the rest of the window.
+ *
+ * @param correlation The correlation to update.
+ * @param view The samples to add, in order of arrival.
+ *
+ * @return Success or fail.
+ */
+result_t slide_correlation(sliding_correlation_t *correlation, const channel_view_t *view)
+{
+    AbortIfNot(correlation, fail);
+    AbortIfNot(view, fail);
+
+    const uint64_t mask = correlation->window - 1;
+    const int32_t max_shift = correlation->max_shift;
+    const sample_t *history = correlation->history;
+    int64_t *sums = correlation->sums;
+
+    for (size_t i = 0; i < view->len; ++i)
+    {
+        const uint64_t n = correlation->count;
+
+        /*
+         * Products of the sample that leaves are removed before its slot is
+         * reused by the new sample.
+         */
+        if (n >= correlation->window)
+        {
+            const uint64_t oldest = n - correlation->window;
+            const sample_t *leaving = &history[oldest & mask];
+            for (int32_t lshift = max_shift; lshift > -1 * max_shift; lshift--)
+            {
+                int64_t *sum = &sums[(max_shift - lshift) * 3];
+                const sample_t *reference = (lshift >= 0)? leaving : &history[(oldest - lshift) & mask];
+                const sample_t *shifted = (lshift >= 0)? &history[(oldest + lshift) & mask] : leaving;
+                for (size_t k = 0; k < 3; ++k)
+                {
+                    sum[k] -= (int32_t)reference->sample[0] * shifted->sample[k + 1];
+                }
+            }
+        }
+
+        sample_t *newest = &correlation->history[n & mask];
+        for (size_t k = 0; k < 4; ++k)
+        {
+            newest->sample[k] = view->channel[k][i * view->stride];
+        }
+
+        /*
+         * The new sample is paired with the samples of the window up to the
+         * largest shift that has arrived.
+         */
+        for (int32_t lshift = max_shift; lshift > -1 * max_shift; lshift--)
+        {
+            const uint64_t distance = (lshift >= 0)? lshift : -1 * lshift;
+            if (distance > n)
+            {
+                continue;
+            }
+
+            int64_t *sum = &sums[(max_shift - lshift) * 3];
+            const sample_t *reference = (lshift >= 0)? &history[(n - distance) & mask] : newest;
+            const sample_t *shifted = (lshift >= 0)? newest : &history[(n - distance) & mask];
+            for (size_t k = 0; k < 3; ++k)
+            {
+                sum[k] += (int32_t)reference->sample[0] * shifted->sample[k + 1];
+            }
+        }
+
+        correlation->count++;
+    }
+
+    return success;
+}
+
+/**
+ * Converts the sums of a sliding correlation into correlations in the order
+ * and scale of a direct correlation over the window.
+ *
+ * @param correlation The correlation to read.
+ * @param[out] correlations The correlation for each shift.
+ * @param correlation_len The number of correlations that can be stored.
+ * @param[out] num_correlations The number of correlations stored.
+ *
+ * @return Success or fail.
+ */
+result_t get_sliding_correlations(const sliding_correlation_t *correlation,
+                                  correlation_t *correlations,
+                                  const size_t correlation_len,
+                                  size_t *num_correlations)
+{
+    AbortIfNot(correlation, fail);
+    AbortIfNot(correlations, fail);
+    AbortIfNot(num_correlations, fail);
+
+    const int32_t max_shift = correlation->max_shift;
+    AbortIfNot(2 * (size_t)max_shift <= correlation_len, fail);
+
+    for (int32_t lshift = max_shift; lshift > -1 * max_shift; lshift--)
+    {
+        const size_t index = max_shift - lshift;
+        correlations[index].left_shift = lshift;
+        for (size_t k = 0; k < 3; ++k)
+        {
+            correlations[index].result[k] = correlation->sums[index * 3 + k] / ((2 << 13));
+        }
+    }
+    *num_correlations = 2 * max_shift;
+
+    return success;
+}
@@ -0,0 +1,60 @@
+#ifndef SLIDING_CORRELATION_H
+#define SLIDING_CORRELATION_H
+
+#include "types.h"
+
+/**
+ * Defines the correlation of channel 0 against channels A, B, and C over the
+ * most recent window of a stream of samples. The sum of products at every
+ * lag is updated as each sample arrives by adding the products of the newest
+ * sample and removing those of the sample that leaves the window, so the
+ * correlation is always available at a cost proportional to the number of
+ * lags per sample.
+ *
+ * @note The sums are exact integers, so they never drift from a correlation
+ *       computed over the window from scratch.
+ */
+typedef struct sliding_correlation_t
+{
+    /*
+     * The samples of the current window, used as a ring whose length is a
+     * power of two.
+     */
+    sample_t *history;
+    size_t window;
+
+    /*
+     * The sum of products of each channel with the reference for each shift,
+     * ordered by decreasing shift.
+     */
+    int64_t *sums;
+    int32_t max_shift;
+
+    /*
+     * The number of samples that have been added.
+     */
+    uint64_t count;
+} sliding_correlation_t;
+
+/**
+ * The number of sums that a sliding correlation over shifts up to max_shift
+ * needs.
+ */
+#define SLIDING_CORRELATION_SUMS(max_shift) (2 * (max_shift) * 3)
+
+result_t init_sliding_correlation(sliding_correlation_t *correlation,
+                                  sample_t *history,
+                                  const size_t window,
+                                  int64_t *sums,
+                                  const int32_t max_shift);
+
+void reset_sliding_correlation(sliding_correlation_t *correlation);
+
+result_t slide_correlation(sliding_correlation_t *correlation, const channel_view_t *view);
+
+result_t get_sliding_correlations(const sliding_correlation_t *correlation,
+                                  correlation_t *correlations,
+                                  const size_t correlation_len,
+                                  size_t *num_correlations);
+
+#endif
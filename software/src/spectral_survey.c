@@ -0,0 +1,196 @@
+#include "spectral_survey.h"
+
+#include "abort.h"
+#include "fft.h"
+#include "types.h"
+
+#include <math.h>
+#include <string.h>
+
+#define PI 3.14159265358979323846
+
+/**
+ * Prepares an empty survey.
+ *
+ * @param[out] survey The survey to prepare.
+ * @param fft_len The length of each segment, which must be a power of two.
+ * @param window The storage of the window, which holds fft_len values.
+ * @param work The storage of the segment being transformed, which holds
+ *        fft_len values.
+ * @param power The storage of the spectra, which holds four channels of
+ *        SURVEY_BINS(fft_len) values.
+ *
+ * @return Success or fail.
+ */
+result_t init_spectral_survey(spectral_survey_t *survey,
+                              const size_t fft_len,
+                              float *window,
+                              complex_t *work,
+                              float *power)
+{
+    AbortIfNot(survey, fail);
+    AbortIfNot(window, fail);
+    AbortIfNot(work, fail);
+    AbortIfNot(power, fail);
+    AbortIfNot(fft_len >= 4 && fft_size(fft_len) == fft_len, fail);
+    AbortIfNot(fft_len <= FFT_MAX_SIZE, fail);
+
+    float window_power = 0;
+    for (size_t k = 0; k < fft_len; ++k)
+    {
+        window[k] = 0.5 - 0.5 * cos(2 * PI * k / fft_len);
+        window_power += window[k] * window[k];
+    }
+
+    survey->fft_len = fft_len;
+    survey->window = window;
+    survey->window_power = window_power;
+    survey->work = work;
+    survey->power = power;
+    survey->segments = 0;
+    memset(power, 0, 4 * SURVEY_BINS(fft_len) * sizeof(float));
+
+    return success;
+}
+
+/**
+ * Adds the power spectra of a pair of channels of a segment to a survey.
+ *
+ * @note The two real channels are transformed together as the real and
+ *       imaginary parts of one complex segment, and separated by the
+ *       symmetry of the spectrum of a real signal.
+ *
+ * @param survey The survey.
+ * @param data The first sample of the segment.
+ * @param first The first channel of the pair.
+ *
+ * @return Success or fail.
+ */
+static result_t add_channel_pair(spectral_survey_t *survey,
+                                 const sample_t *data,
+                                 const size_t first)
+{
+    const size_t n = survey->fft_len;
+    complex_t *work = survey->work;
+
+    /*
+     * The mean of each channel is removed so that the offset of the ADC
+     * does not leak into the low bins through the window.
+     */
+    int64_t sums[2] = {0, 0};
+    for (size_t k = 0; k < n; ++k)
+    {
+        sums[0] += data[k].sample[first];
+        sums[1] += data[k].sample[first + 1];
+    }
+
+    const float mean_a = (float)sums[0] / n;
+    const float mean_b = (float)sums[1] / n;
+    for (size_t k = 0; k < n; ++k)
+    {
+        work[k].re = survey->window[k] * (data[k].sample[first] - mean_a);
+        work[k].im = survey->window[k] * (data[k].sample[first + 1] - mean_b);
+    }
+    AbortIfNot(fft(work, n, false), fail);
+
+    float *power_a = &survey->power[first * SURVEY_BINS(n)];
+    float *power_b = &survey->power[(first + 1) * SURVEY_BINS(n)];
+    for (size_t k = 0; k < SURVEY_BINS(n); ++k)
+    {
+        const complex_t z = work[k];
+        const complex_t mirror = work[(n - k) % n];
+        const float a_re = z.re + mirror.re;
+        const float a_im = z.im - mirror.im;
+        const float b_re = z.im + mirror.im;
+        const float b_im = mirror.re - z.re;
+        power_a[k] += 0.25f * (a_re * a_re + a_im * a_im);
+        power_b[k] += 0.25f * (b_re * b_re + b_im * b_im);
+    }
+
+    return success;
+}
+
+/**
+ * Adds the segments of a chunk of samples to a survey.
+ *
+ * @note Segments do not span chunks, so a chunk holds at least one segment
+ *       to be counted and the samples after its last segment are dropped.
+ *
+ * @param survey The survey.
+ * @param data The samples of the chunk.
+ * @param len The number of samples in the chunk.
+ *
+ * @return Success or fail.
+ */
+result_t add_survey_samples(spectral_survey_t *survey,
+                            const sample_t *data,
+                            const size_t len)
+{
+    AbortIfNot(survey, fail);
+    AbortIfNot(data, fail);
+
+    const size_t n = survey->fft_len;
+    for (size_t start = 0; start + n <= len; start += n / 2)
+    {
+        AbortIfNot(add_channel_pair(survey, &data[start], 0), fail);
+        AbortIfNot(add_channel_pair(survey, &data[start], 2), fail);
+        survey->segments++;
+    }
+
+    return success;
+}
+
+/**
+ * Finds the one-sided power spectral density of a channel of a survey.
+ *
+ * @param survey The survey, which holds at least one segment.
+ * @param channel The channel.
+ * @param sampling_frequency The sampling frequency of the samples surveyed.
+ * @param[out] density The density of each bin in hundredths of a decibel
+ *             relative to one square ADC count per Hz.
+ * @param bins The number of bins to find, which must be at most
+ *        SURVEY_BINS(fft_len).
+ *
+ * @return Success or fail.
+ */
+result_t get_survey_density(const spectral_survey_t *survey,
+                            const size_t channel,
+                            const uint32_t sampling_frequency,
+                            int16_t *density,
+                            const size_t bins)
+{
+    AbortIfNot(survey, fail);
+    AbortIfNot(density, fail);
+    AbortIfNot(channel < 4, fail);
+    AbortIfNot(sampling_frequency, fail);
+    AbortIfNot(survey->segments, fail);
+    AbortIfNot(bins <= SURVEY_BINS(survey->fft_len), fail);
+
+    const float scale = 1.0f / ((float)survey->segments *
+                                survey->window_power *
+                                sampling_frequency);
+    const float *power = &survey->power[channel * SURVEY_BINS(survey->fft_len)];
+    for (size_t k = 0; k < bins; ++k)
+    {
+        /*
+         * Every bin within the band holds the power of its negative
+         * frequency as well, so it is doubled.
+         */
+        const bool edge = (k == 0 || k == survey->fft_len / 2)? true : false;
+        const float value = power[k] * scale * ((edge)? 1 : 2);
+
+        float centi_db = (value > 0)? 1000 * log10f(value) : INT16_MIN;
+        if (centi_db < INT16_MIN)
+        {
+            centi_db = INT16_MIN;
+        }
+        else if (centi_db > INT16_MAX)
+        {
+            centi_db = INT16_MAX;
+        }
+
+        density[k] = lrintf(centi_db);
+    }
+
+    return success;
+}
@@ -0,0 +1,53 @@
+#ifndef SPECTRAL_SURVEY_H
+#define SPECTRAL_SURVEY_H
+
+#include "fft.h"
+#include "types.h"
+
+/**
+ * The number of bins of the one-sided spectrum of a transform length, from
+ * DC to the Nyquist frequency.
+ */
+#define SURVEY_BINS(fft_len) ((fft_len) / 2 + 1)
+
+/**
+ * Defines the averaged power spectrum of each channel of a stream, found by
+ * Welch's method with Hann windowed segments that overlap by half.
+ */
+typedef struct spectral_survey_t
+{
+    size_t fft_len;
+
+    /*
+     * The window and the sum of its squares, and the storage of the segment
+     * being transformed.
+     */
+    float *window;
+    float window_power;
+    complex_t *work;
+
+    /*
+     * The summed power of each bin, SURVEY_BINS(fft_len) to a channel, and
+     * the number of segments summed.
+     */
+    float *power;
+    uint32_t segments;
+} spectral_survey_t;
+
+result_t init_spectral_survey(spectral_survey_t *survey,
+                              const size_t fft_len,
+                              float *window,
+                              complex_t *work,
+                              float *power);
+
+result_t add_survey_samples(spectral_survey_t *survey,
+                            const sample_t *data,
+                            const size_t len);
+
+result_t get_survey_density(const spectral_survey_t *survey,
+                            const size_t channel,
+                            const uint32_t sampling_frequency,
+                            int16_t *density,
+                            const size_t bins);
+
+#endif
@@ -6,7 +6,7 @@
 #include "system.h"
 #include "uart.h"
 
-result_t init_spi(spi_driver_t *spi, uint32_t base_address)
+result_t init_spi(spi_driver_t *spi, uint32_t base_address, const bool self_test)
 {
     AbortIfNot(spi, fail);
     AbortIfNot(base_address, fail);
@@ -27,21 +27,25 @@ result_t init_spi(spi_driver_t *spi, uint32_t base_address)
     uint16_t phase = 0;
     spi->regs->SPICR = 0x1E0 | phase << 4 | polarity << 3 | 0b110;
 
-    /*
-     * Set the SPI driver into loop-back mode and test for a proper read/write.
-     */
-    spi->regs->SPICR |= 1;
-
-    uint16_t data = 0xab;
-    uint16_t result = 0;
-    AbortIfNot(transact_spi(spi, data, &result), fail);
-
-    AbortIfNot(result == data, fail);
-
-    /*
-     * Set the SPI driver back into a normal mode.
-     */
-    spi->regs->SPICR &= ~1;
+    if (self_test)
+    {
+        /*
+         * Set the SPI driver into loop-back mode and test for a proper
+         * read/write.
+         */
+        spi->regs->SPICR |= 1;
+
+        uint16_t data = 0xab;
+        uint16_t result = 0;
+        AbortIfNot(transact_spi(spi, data, &result), fail);
+
+        AbortIfNot(result == data, fail);
+
+        /*
+         * Set the SPI driver back into a normal mode.
+         */
+        spi->regs->SPICR &= ~1;
+    }
 
     return success;
 }
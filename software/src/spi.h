@@ -9,7 +9,7 @@ typedef struct spi_driver_t
     struct SpiRegs * regs;
 } spi_driver_t;
 
-result_t init_spi(spi_driver_t *spi, uint32_t base_address);
+result_t init_spi(spi_driver_t *spi, uint32_t base_address, const bool self_test);
 
 result_t write_spi(spi_driver_t *spi, const uint16_t data);
 
@@ -0,0 +1,110 @@
+#include "spsc_queue.h"
+
+#include "abort.h"
+#include "system.h"
+#include "types.h"
+
+#include <string.h>
+
+/**
+ * Initializes a single-producer, single-consumer queue.
+ *
+ * @note This must complete before either side uses the queue.
+ *
+ * @param[out] queue The queue to initialize.
+ * @param storage Storage for capacity elements.
+ * @param element_size The size of each element in bytes.
+ * @param capacity The number of elements, which must be a power of two.
+ *
+ * @return Success or fail.
+ */
+result_t init_spsc_queue(spsc_queue_t *queue,
+                         void *storage,
+                         const size_t element_size,
+                         const size_t capacity)
+{
+    AbortIfNot(queue, fail);
+    AbortIfNot(storage, fail);
+    AbortIfNot(element_size, fail);
+    AbortIfNot(capacity && (capacity & (capacity - 1)) == 0, fail);
+
+    queue->head = 0;
+    queue->tail = 0;
+    queue->storage = storage;
+    queue->element_size = element_size;
+    queue->capacity = capacity;
+    data_sync_barrier();
+
+    return success;
+}
+
+/**
+ * Adds an element to a queue. Only the producer may call this.
+ *
+ * @param queue The queue to add to.
+ * @param element The element to copy into the queue.
+ *
+ * @return True if the element was added or false if the queue was full.
+ */
+bool spsc_push(spsc_queue_t *queue, const void *element)
+{
+    const uint32_t head = queue->head;
+    if (head - queue->tail == queue->capacity)
+    {
+        return false;
+    }
+
+    memcpy(&queue->storage[(head & (queue->capacity - 1)) * queue->element_size],
+           element,
+           queue->element_size);
+
+    /*
+     * Publish the element before the index that makes it visible.
+     */
+    data_memory_barrier();
+    queue->head = head + 1;
+
+    return true;
+}
+
+/**
+ * Removes the oldest element from a queue. Only the consumer may call this.
+ *
+ * @param queue The queue to remove from.
+ * @param[out] element The location to copy the element to.
+ *
+ * @return True if an element was removed or false if the queue was empty.
+ */
+bool spsc_pop(spsc_queue_t *queue, void *element)
+{
+    const uint32_t tail = queue->tail;
+    if (queue->head == tail)
+    {
+        return false;
+    }
+
+    /*
+     * Read the element only after observing the index that published it, and
+     * release the slot only after the element has been read.
+     */
+    data_memory_barrier();
+    memcpy(element,
+           &queue->storage[(tail & (queue->capacity - 1)) * queue->element_size],
+           queue->element_size);
+    data_memory_barrier();
+    queue->tail = tail + 1;
+
+    return true;
+}
+
+/**
+ * Checks if a queue is empty.
+ *
+ * @param queue The queue to check.
+ *
+ * @return True if the queue holds no elements.
+ */
+bool spsc_empty(spsc_queue_t *queue)
+{
+    return (queue->head == queue->tail)? true : false;
+}
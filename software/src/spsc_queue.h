@@ -0,0 +1,43 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include "types.h"
+
+/**
+ * Defines a lock-free queue with a single producer and a single consumer,
+ * which may be on different cores or in interrupt and thread context. The
+ * producer and consumer indices occupy separate cache lines.
+ */
+typedef struct spsc_queue_t
+{
+    /*
+     * The number of elements pushed, written only by the producer.
+     */
+    volatile uint32_t head __attribute__((aligned(32)));
+
+    /*
+     * The number of elements popped, written only by the consumer.
+     */
+    volatile uint32_t tail __attribute__((aligned(32)));
+
+    /*
+     * The element storage, the size of each element, and the number of
+     * elements, which is a power of two.
+     */
+    uint8_t *storage __attribute__((aligned(32)));
+    size_t element_size;
+    size_t capacity;
+} spsc_queue_t;
+
+result_t init_spsc_queue(spsc_queue_t *queue,
+                         void *storage,
+                         const size_t element_size,
+                         const size_t capacity);
+
+bool spsc_push(spsc_queue_t *queue, const void *element);
+
+bool spsc_pop(spsc_queue_t *queue, void *element);
+
+bool spsc_empty(spsc_queue_t *queue);
+
+#endif
@@ -0,0 +1,387 @@
+#ifndef STREAM_FORMAT_H
+#define STREAM_FORMAT_H
+
+#include "types.h"
+
+/**
+ * The version of the result record layout. This must be incremented whenever
+ * the layout changes.
+ */
+#define RESULT_RECORD_VERSION 8
+
+/**
+ * The sources of the delays of a result record.
+ */
+#define RESULT_DELAYS_CORRELATED 0
+#define RESULT_DELAYS_LEADING_EDGE 1
+
+/**
+ * Defines the binary record sent on the result port for each ping. All fields
+ * are little endian.
+ */
+typedef struct __attribute__((packed)) result_record_t
+{
+    uint16_t version;
+
+    /*
+     * The size of the record in bytes.
+     */
+    uint16_t length;
+
+    uint32_t sequence;
+
+    /*
+     * The frequency of the pinger in Hz, or zero for the primary result.
+     */
+    uint32_t frequency;
+
+    /*
+     * The time that the ping arrived in microseconds since boot.
+     */
+    uint64_t timestamp_us;
+
+    int32_t channel_delay_ns[3];
+    int16_t peak_amplitude[4];
+    float confidence[3];
+    uint32_t filter_duration_us;
+    uint32_t correlation_duration_us;
+
+    /*
+     * The direction of the pinger in degrees, and the length of the solved
+     * direction, which is zero if no direction was solved.
+     */
+    float bearing_deg;
+    float elevation_deg;
+    float direction_norm;
+
+    /*
+     * The quality score of the ping between 0 and 1.
+     */
+    float quality;
+
+    /*
+     * The delays and confidences at the peaks of the correlations averaged
+     * over recent pings, and the number of pings averaged, which is zero if
+     * no average was kept.
+     */
+    int32_t averaged_delay_ns[3];
+    float averaged_confidence[3];
+    uint32_t averaged_pings;
+
+    /*
+     * The latest edge of the external trigger input when the ping was
+     * captured, as its stream timestamp and its time in microseconds since
+     * boot, and the number of edges since boot, which is zero if there was
+     * none.
+     */
+    uint64_t trigger_sample;
+    uint64_t trigger_timestamp_us;
+    uint32_t trigger_count;
+
+    /*
+     * The estimate of the bearing tracker after the ping: the filtered delays
+     * with their rates and variances, and the direction solved from them,
+     * which are zero unless the BEARING_TRACK_LOCKED flag is set.
+     */
+    float tracked_delay_ns[3];
+    float tracked_delay_rate_ns_per_s[3];
+    float tracked_delay_variance_ns2[3];
+    float tracked_bearing_deg;
+    float tracked_elevation_deg;
+    uint16_t track_flags;
+    uint16_t track_outliers;
+
+    /*
+     * The time in microseconds after the ping arrived at which each stage of
+     * its processing finished: the capture holding it completed, its window
+     * was located and cut from the capture, its correlations were evaluated,
+     * its bearing was solved and tracked, and the record was handed to the
+     * network stack. A stage that was not timed is zero.
+     */
+    uint32_t capture_latency_us;
+    uint32_t window_latency_us;
+    uint32_t process_latency_us;
+    uint32_t solve_latency_us;
+    uint32_t queue_latency_us;
+
+    /*
+     * How the delays were found, and for delays taken from the leading edges
+     * of the channels, the largest timing uncertainty of a pair in
+     * nanoseconds. Each confidence of leading edges falls from one as the
+     * uncertainty of its pair grows.
+     */
+    uint32_t delay_source;
+    float edge_uncertainty_ns;
+} result_record_t;
+
+/**
+ * The marker that begins a datagram of batched messages in place of the
+ * version of a single message. A batch of one message is sent as the message
+ * alone, so receivers only see the batch format when messages were
+ * coalesced.
+ */
+#define MESSAGE_BATCH_MARKER 0xBA7C
+
+/**
+ * Defines the types of the messages that are batched.
+ */
+typedef enum message_type_t
+{
+    MESSAGE_RESULT = 1
+} message_type_t;
+
+/**
+ * Defines the header of a datagram of batched messages, which is followed by
+ * count messages, each with a message header. All fields are little endian.
+ */
+typedef struct __attribute__((packed)) message_batch_header_t
+{
+    uint16_t marker;
+    uint16_t count;
+} message_batch_header_t;
+
+/**
+ * Defines the header of each message of a batch, which is followed by length
+ * bytes of the message.
+ */
+typedef struct __attribute__((packed)) message_header_t
+{
+    uint16_t type;
+    uint16_t length;
+} message_header_t;
+
+/**
+ * Defines the request for thruster silence sent ahead of each capture window.
+ * All fields are little endian.
+ *
+ * @note The relative fields are kept for receivers that do not synchronize
+ *       their clock with the board. Receivers that do use the absolute start
+ *       time, which network latency does not skew.
+ */
+typedef struct __attribute__((packed)) silence_request_t
+{
+    /*
+     * The time until the window opens and its length in milliseconds.
+     */
+    int32_t when_ms;
+    int32_t duration_ms;
+
+    /*
+     * The time that the window opens in microseconds since boot, and its
+     * length in microseconds.
+     */
+    uint64_t start_us;
+    uint32_t duration_us;
+} silence_request_t;
+
+/**
+ * Defines the header that precedes the elements of each data or correlation
+ * stream datagram.
+ */
+typedef struct __attribute__((packed)) stream_header_t
+{
+    /*
+     * The index of the datagram within the transfer. Zero marks the start of
+     * a new transfer.
+     */
+    int32_t packet_number;
+
+    /*
+     * The index of the first element of the datagram within the transfer.
+     */
+    uint32_t first_element;
+
+    uint16_t element_size;
+    uint16_t element_count;
+
+    /*
+     * The stream_encoding_t of the elements that follow.
+     */
+    uint16_t encoding;
+
+    /*
+     * Identifies the transfer for acknowledgement and retransmit requests.
+     */
+    uint16_t transfer_id;
+
+    /*
+     * The number of elements in the whole transfer, so that the receiver can
+     * detect lost datagrams at the end.
+     */
+    uint32_t total_elements;
+} stream_header_t;
+
+/**
+ * Defines the encodings of stream datagram payloads.
+ */
+typedef enum stream_encoding_t
+{
+    /*
+     * The elements are sent as they are stored in memory.
+     */
+    STREAM_ENCODING_RAW = 0,
+
+    /*
+     * The samples are compressed by encode_samples().
+     */
+    STREAM_ENCODING_DELTA = 1
+} stream_encoding_t;
+
+/**
+ * The EtherType of the raw sample frames, which is the first of the local
+ * experimental EtherTypes of IEEE 802, and the version of their header.
+ */
+#define RAW_FRAME_ETHERTYPE 0x88B5
+#define RAW_FRAME_VERSION 1
+
+/**
+ * The most sample bytes that a raw frame carries, which fills a standard
+ * 1500 byte payload with whole samples after the raw frame header.
+ */
+#define RAW_FRAME_PAYLOAD_MAX 1480
+
+/**
+ * Marks the last frame of a transfer.
+ */
+#define RAW_FRAME_LAST (1 << 0)
+
+/**
+ * Defines the header that follows the Ethernet header of each raw sample
+ * frame, which is sent without UDP or IP headers on a dedicated link. All
+ * fields are little endian.
+ */
+typedef struct __attribute__((packed)) raw_frame_header_t
+{
+    uint8_t version;
+    uint8_t flags;
+
+    /*
+     * Identifies the capture that the frame belongs to.
+     */
+    uint16_t transfer_id;
+
+    /*
+     * The index of the frame since the stream started, so that the receiver
+     * can count lost frames across transfers.
+     */
+    uint32_t sequence;
+
+    /*
+     * The offset of the payload within the transfer, and the length of the
+     * whole transfer, in bytes.
+     */
+    uint32_t offset;
+    uint32_t total_bytes;
+} raw_frame_header_t;
+
+/**
+ * Defines the header that precedes each block of samples on the TCP capture
+ * stream.
+ */
+typedef struct __attribute__((packed)) stream_block_header_t
+{
+    /*
+     * The index of the block since streaming started.
+     */
+    uint32_t sequence;
+    uint32_t sample_count;
+} stream_block_header_t;
+
+/**
+ * The version of the preview datagram layout.
+ */
+#define PREVIEW_VERSION 1
+
+/**
+ * Defines the range of the samples of each channel that one preview point
+ * covers.
+ */
+typedef struct __attribute__((packed)) preview_point_t
+{
+    analog_sample_t min[4];
+    analog_sample_t max[4];
+} preview_point_t;
+
+/**
+ * Defines the header of each preview datagram, which is followed by
+ * point_count points. The points of one capture may span several datagrams.
+ */
+typedef struct __attribute__((packed)) preview_header_t
+{
+    uint16_t version;
+    uint16_t length;
+
+    /*
+     * The index of the capture since boot.
+     */
+    uint32_t sequence;
+
+    /*
+     * The time of the first sample of the capture in microseconds since boot.
+     */
+    uint64_t timestamp_us;
+
+    /*
+     * The number of samples in the capture and the number of samples that
+     * each point covers.
+     */
+    uint32_t capture_samples;
+    uint32_t samples_per_point;
+
+    /*
+     * The number of points of the capture, the index of the first point in
+     * this datagram, and the number of points in this datagram.
+     */
+    uint16_t total_points;
+    uint16_t first_point;
+    uint16_t point_count;
+    uint16_t reserved;
+} preview_header_t;
+
+/**
+ * The version of the survey datagram layout.
+ */
+#define SURVEY_VERSION 1
+
+/**
+ * Defines the header of each survey datagram, which is followed by bin_count
+ * densities. Each density is an int16_t in hundredths of a decibel relative
+ * to one square ADC count per Hz. The bins of one channel may span several
+ * datagrams.
+ */
+typedef struct __attribute__((packed)) survey_header_t
+{
+    uint16_t version;
+    uint16_t length;
+
+    /*
+     * The index of the survey since boot.
+     */
+    uint32_t sequence;
+
+    /*
+     * The time of the first sample surveyed in microseconds since boot, and
+     * the sampling frequency of the samples.
+     */
+    uint64_t timestamp_us;
+    uint32_t sampling_frequency;
+
+    /*
+     * The number of samples of each segment, and the number of segments
+     * averaged.
+     */
+    uint32_t fft_len;
+    uint32_t segments;
+
+    /*
+     * The channel of this datagram, the number of bins of each channel, the
+     * index of the first bin in this datagram, and the number of bins in
+     * this datagram.
+     */
+    uint16_t channel;
+    uint16_t total_bins;
+    uint16_t first_bin;
+    uint16_t bin_count;
+} survey_header_t;
+
+#endif
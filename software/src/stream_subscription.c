@@ -0,0 +1,239 @@
+#include "stream_subscription.h"
+
+#include "abort.h"
+#include "db.h"
+#include "network_stack.h"
+
+#include <string.h>
+
+/**
+ * Initializes the subscriptions with no subscribers.
+ *
+ * @param[out] subscriptions The subscriptions to initialize.
+ *
+ * @return Success or fail.
+ */
+result_t init_stream_subscriptions(stream_subscriptions_t *subscriptions)
+{
+    AbortIfNot(subscriptions, fail);
+
+    memset(subscriptions, 0, sizeof(*subscriptions));
+
+    return success;
+}
+
+/**
+ * Finds the subscriber of a stream at a destination.
+ *
+ * @param subscriptions The subscriptions to search.
+ * @param stream The stream subscribed to.
+ * @param address The address of the subscriber.
+ * @param port The port of the subscriber.
+ *
+ * @return The subscriber, or NULL if there is none.
+ */
+static stream_subscriber_t *find_subscriber(stream_subscriptions_t *subscriptions,
+                                            const subscribed_stream_t stream,
+                                            struct ip_addr *address,
+                                            const uint16_t port)
+{
+    for (size_t i = 0; i < STREAM_MAX_SUBSCRIBERS; ++i)
+    {
+        stream_subscriber_t *subscriber = &subscriptions->subscribers[stream][i];
+        if (subscriber->active &&
+            subscriber->port == port &&
+            ip_addr_cmp(&subscriber->address, address))
+        {
+            return subscriber;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Subscribes a destination to a stream, or changes the rate of an existing
+ * subscription to it.
+ *
+ * @param subscriptions The subscriptions to add to.
+ * @param stream The stream to subscribe to.
+ * @param address The address to send the stream to, which may be a unicast,
+ *        broadcast, or multicast address.
+ * @param port The port to send the stream to.
+ * @param decimation The subscriber is sent every decimation-th ping.
+ * @param min_interval The least time between the pings sent, or zero.
+ *
+ * @return Success or fail.
+ */
+result_t subscribe_stream(stream_subscriptions_t *subscriptions,
+                          const subscribed_stream_t stream,
+                          struct ip_addr *address,
+                          const uint16_t port,
+                          const uint32_t decimation,
+                          const tick_t min_interval)
+{
+    AbortIfNot(subscriptions, fail);
+    AbortIfNot(stream < SUBSCRIBED_STREAMS, fail);
+    AbortIfNot(address, fail);
+    AbortIfNot(port, fail);
+    AbortIfNot(decimation, fail);
+
+    stream_subscriber_t *subscriber = find_subscriber(subscriptions, stream, address, port);
+    if (!subscriber)
+    {
+        for (size_t i = 0; i < STREAM_MAX_SUBSCRIBERS && !subscriber; ++i)
+        {
+            if (!subscriptions->subscribers[stream][i].active)
+            {
+                subscriber = &subscriptions->subscribers[stream][i];
+            }
+        }
+
+        if (!subscriber)
+        {
+            dblog(LOG_WARN, "Stream %d already has %d subscribers.\n", stream, STREAM_MAX_SUBSCRIBERS);
+            return fail;
+        }
+
+        memset(subscriber, 0, sizeof(*subscriber));
+        AbortIfNot(init_udp(&subscriber->socket), fail);
+        if (!connect_udp(&subscriber->socket, address, port))
+        {
+            deinit_udp(&subscriber->socket);
+            return fail;
+        }
+
+        if (!add_arp_destination(address))
+        {
+            dblog(LOG_WARN, "Too many destinations to keep resolved.\n");
+        }
+
+        subscriber->address = *address;
+        subscriber->port = port;
+        subscriber->active = true;
+    }
+
+    /*
+     * The next ping offered is sent so that a new subscriber hears at once.
+     */
+    subscriber->decimation = decimation;
+    subscriber->min_interval = min_interval;
+    subscriber->skipped = decimation - 1;
+    subscriber->last_sent = 0;
+
+    return success;
+}
+
+/**
+ * Removes the subscription of a destination to a stream.
+ *
+ * @param subscriptions The subscriptions to remove from.
+ * @param stream The stream subscribed to.
+ * @param address The address of the subscriber.
+ * @param port The port of the subscriber.
+ *
+ * @return Success or fail.
+ */
+result_t unsubscribe_stream(stream_subscriptions_t *subscriptions,
+                            const subscribed_stream_t stream,
+                            struct ip_addr *address,
+                            const uint16_t port)
+{
+    AbortIfNot(subscriptions, fail);
+    AbortIfNot(stream < SUBSCRIBED_STREAMS, fail);
+    AbortIfNot(address, fail);
+
+    stream_subscriber_t *subscriber = find_subscriber(subscriptions, stream, address, port);
+    AbortIfNot(subscriber, fail);
+
+    AbortIfNot(deinit_udp(&subscriber->socket), fail);
+    subscriber->active = false;
+
+    return success;
+}
+
+/**
+ * Offers a ping to the subscribers of a stream and selects those that are
+ * due to be sent it.
+ *
+ * @note This is called once for each ping the stream carries, since the
+ *       decimation of every subscriber counts the pings offered.
+ *
+ * @param subscriptions The subscriptions of the stream.
+ * @param stream The stream that carries the ping.
+ * @param now The current system time.
+ * @param[out] sockets The sockets of the subscribers that are due.
+ * @param max_sockets The most sockets that may be selected.
+ *
+ * @return The number of subscribers selected.
+ */
+size_t select_stream_subscribers(stream_subscriptions_t *subscriptions,
+                                 const subscribed_stream_t stream,
+                                 const tick_t now,
+                                 udp_socket_t **sockets,
+                                 const size_t max_sockets)
+{
+    AbortIfNot(subscriptions, 0);
+    AbortIfNot(stream < SUBSCRIBED_STREAMS, 0);
+    AbortIfNot(sockets, 0);
+
+    size_t selected = 0;
+    for (size_t i = 0; i < STREAM_MAX_SUBSCRIBERS && selected < max_sockets; ++i)
+    {
+        stream_subscriber_t *subscriber = &subscriptions->subscribers[stream][i];
+        if (!subscriber->active)
+        {
+            continue;
+        }
+
+        subscriber->skipped++;
+        if (subscriber->skipped < subscriber->decimation)
+        {
+            continue;
+        }
+
+        if (subscriber->last_sent && now - subscriber->last_sent < subscriber->min_interval)
+        {
+            continue;
+        }
+
+        subscriber->skipped = 0;
+        subscriber->last_sent = now;
+        subscriber->sent++;
+        sockets[selected++] = &subscriber->socket;
+    }
+
+    return selected;
+}
+
+/**
+ * Gets every subscriber of a stream regardless of its rate, for the pings
+ * that were requested explicitly.
+ *
+ * @param subscriptions The subscriptions of the stream.
+ * @param stream The stream subscribed to.
+ * @param[out] sockets The sockets of the subscribers.
+ * @param max_sockets The most sockets that may be returned.
+ *
+ * @return The number of subscribers.
+ */
+size_t get_stream_subscribers(stream_subscriptions_t *subscriptions,
+                              const subscribed_stream_t stream,
+                              udp_socket_t **sockets,
+                              const size_t max_sockets)
+{
+    AbortIfNot(subscriptions, 0);
+    AbortIfNot(stream < SUBSCRIBED_STREAMS, 0);
+    AbortIfNot(sockets, 0);
+
+    size_t found = 0;
+    for (size_t i = 0; i < STREAM_MAX_SUBSCRIBERS && found < max_sockets; ++i)
+    {
+        if (subscriptions->subscribers[stream][i].active)
+        {
+            sockets[found++] = &subscriptions->subscribers[stream][i].socket;
+        }
+    }
+
+    return found;
+}
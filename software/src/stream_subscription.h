@@ -0,0 +1,78 @@
+#ifndef STREAM_SUBSCRIPTION_H
+#define STREAM_SUBSCRIPTION_H
+
+#include "system_params.h"
+#include "types.h"
+#include "udp.h"
+
+/**
+ * Defines the streams that consumers subscribe to.
+ */
+typedef enum subscribed_stream_t
+{
+    SUBSCRIBED_DATA = 0,
+    SUBSCRIBED_XCORR = 1,
+    SUBSCRIBED_STREAMS = 2
+} subscribed_stream_t;
+
+/**
+ * Defines a consumer of a stream and the pings it is sent.
+ */
+typedef struct stream_subscriber_t
+{
+    bool active;
+    struct ip_addr address;
+    uint16_t port;
+    udp_socket_t socket;
+
+    /*
+     * The subscriber is sent every decimation-th ping, no sooner than the
+     * minimum interval after the last ping it was sent.
+     */
+    uint32_t decimation;
+    tick_t min_interval;
+
+    /*
+     * The pings offered since the last one sent, when the last was sent, and
+     * the pings sent.
+     */
+    uint32_t skipped;
+    tick_t last_sent;
+    uint32_t sent;
+} stream_subscriber_t;
+
+/**
+ * Defines the subscribers of every stream. A stream without subscribers is
+ * neither formatted nor sent.
+ */
+typedef struct stream_subscriptions_t
+{
+    stream_subscriber_t subscribers[SUBSCRIBED_STREAMS][STREAM_MAX_SUBSCRIBERS];
+} stream_subscriptions_t;
+
+result_t init_stream_subscriptions(stream_subscriptions_t *subscriptions);
+
+result_t subscribe_stream(stream_subscriptions_t *subscriptions,
+                          const subscribed_stream_t stream,
+                          struct ip_addr *address,
+                          const uint16_t port,
+                          const uint32_t decimation,
+                          const tick_t min_interval);
+
+result_t unsubscribe_stream(stream_subscriptions_t *subscriptions,
+                            const subscribed_stream_t stream,
+                            struct ip_addr *address,
+                            const uint16_t port);
+
+size_t select_stream_subscribers(stream_subscriptions_t *subscriptions,
+                                 const subscribed_stream_t stream,
+                                 const tick_t now,
+                                 udp_socket_t **sockets,
+                                 const size_t max_sockets);
+
+size_t get_stream_subscribers(stream_subscriptions_t *subscriptions,
+                              const subscribed_stream_t stream,
+                              udp_socket_t **sockets,
+                              const size_t max_sockets);
+
+#endif
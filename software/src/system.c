@@ -6,6 +6,145 @@
 #include "types.h"
 #include "regs/gpio_regs.h"
 #include "regs/slcr_regs.h"
+#include "regs/system_registers.h"
+#include "time_util.h"
+
+#include <string.h>
+
+/**
+ * The time that the main core has spent waiting for interrupts.
+ */
+static tick_t idle_ticks = 0;
+
+/**
+ * The configuration of the GIC, whose vector table holds the handlers of
+ * both register_interrupt() and the Xilinx drivers that connect their own.
+ */
+static XScuGic_Config *gic_config = NULL;
+
+/**
+ * Specified true if handlers below IRQ_PRIORITY_PROFILE may be preempted.
+ */
+static bool interrupt_nesting = false;
+
+/**
+ * The number of handlers currently running on the main core.
+ */
+static volatile uint32_t interrupt_depth = 0;
+
+/**
+ * The counters of each interrupt.
+ */
+static irq_stats_t interrupt_stats[NUM_INTERRUPT_IDS];
+
+/**
+ * The top of the IRQ stack, defined by the linker script.
+ */
+extern uint32_t __irq_stack;
+
+/**
+ * The position on the IRQ stack where the exception frame of the next IRQ is
+ * pushed. It moves down while preemptible handlers run, and is written from
+ * call_nested_handler().
+ */
+__attribute__((used)) volatile uintptr_t interrupt_frame = 0;
+
+/**
+ * Calls an interrupt handler with IRQs unmasked, in system mode so that a
+ * nested interrupt does not overwrite the IRQ mode link register.
+ *
+ * @note The return address and the saved program status of the interrupted
+ *       code are kept on the IRQ stack, and IRQs are masked again before
+ *       they are restored. The position of the frame that a nested IRQ
+ *       pushes is recorded for get_interrupted_pc().
+ *
+ * @param handler The handler to call.
+ * @param arg The argument provided to the handler.
+ *
+ * @return None.
+ */
+static void __attribute__((naked)) call_nested_handler(Xil_InterruptHandler handler, void *arg)
+{
+    __asm volatile("push {lr}\n"
+                   "mrs lr, spsr\n"
+                   "push {lr}\n"
+                   "movw r2, #:lower16:interrupt_frame\n"
+                   "movt r2, #:upper16:interrupt_frame\n"
+                   "ldr r3, [r2]\n"
+                   "push {r2, r3}\n"
+                   "str sp, [r2]\n"
+                   "cps #0x1F\n"
+                   "push {r4, lr}\n"
+                   "mov r4, r0\n"
+                   "mov r0, r1\n"
+                   "cpsie i\n"
+                   "blx r4\n"
+                   "cpsid i\n"
+                   "pop {r4, lr}\n"
+                   "cps #0x12\n"
+                   "pop {r2, r3}\n"
+                   "str r3, [r2]\n"
+                   "pop {lr}\n"
+                   "msr spsr_cxsf, lr\n"
+                   "pop {pc}\n");
+}
+
+/**
+ * Dispatches the pending interrupt of the highest priority to its handler
+ * and accounts the time spent in it.
+ *
+ * @note The GIC raises the running priority to that of the acknowledged
+ *       interrupt, so only interrupts of a higher priority preempt a handler
+ *       that runs with IRQs unmasked.
+ *
+ * @param arg Unused.
+ *
+ * @return None.
+ */
+static void dispatch_interrupt(void *arg)
+{
+    const uint32_t ack = XScuGic_ReadReg(XPAR_SCUGIC_CPU_BASEADDR, XSCUGIC_INT_ACK_OFFSET);
+    const uint32_t id = ack & XSCUGIC_ACK_INTID_MASK;
+
+    /*
+     * A spurious interrupt is not ended.
+     */
+    if (id >= NUM_INTERRUPT_IDS)
+    {
+        return;
+    }
+
+    const XScuGic_VectorTableEntry *entry = &gic_config->HandlerTable[id];
+    irq_stats_t *stats = &interrupt_stats[id];
+    if (interrupt_depth)
+    {
+        stats->nested++;
+    }
+
+    interrupt_depth++;
+    const tick_t start = get_system_time();
+    if (interrupt_nesting &&
+        XScuGic_ReadReg(XPAR_SCUGIC_CPU_BASEADDR, XSCUGIC_RUN_PRIOR_OFFSET) > IRQ_PRIORITY_PROFILE)
+    {
+        call_nested_handler(entry->Handler, entry->CallBackRef);
+    }
+    else
+    {
+        entry->Handler(entry->CallBackRef);
+    }
+
+    const tick_t elapsed = get_system_time() - start;
+    interrupt_depth--;
+
+    stats->count++;
+    stats->total_ticks += elapsed;
+    if (elapsed > stats->max_ticks)
+    {
+        stats->max_ticks = elapsed;
+    }
+
+    XScuGic_WriteReg(XPAR_SCUGIC_CPU_BASEADDR, XSCUGIC_EOI_OFFSET, ack);
+}
 
 /**
  * Initializes the processing system.
@@ -33,13 +172,21 @@ result_t init_system()
      */
     set_interrupts(false);
     XScuGic_DeviceInitialize(XPAR_SCUGIC_SINGLE_DEVICE_ID);
+    gic_config = XScuGic_LookupConfig(XPAR_SCUGIC_SINGLE_DEVICE_ID);
+    AbortIfNot(gic_config, fail);
+    interrupt_frame = (uintptr_t)&__irq_stack;
+
+    /*
+     * Preempt on all five implemented priority bits.
+     */
+    XScuGic_WriteReg(XPAR_SCUGIC_CPU_BASEADDR, XSCUGIC_BIN_PT_OFFSET, 2);
 
     /*
-     * Register the GIC handler with the zynq trampoline.
+     * Register the dispatcher with the zynq trampoline.
      */
     Xil_ExceptionRegisterHandler(XIL_EXCEPTION_ID_IRQ_INT,
-            (Xil_ExceptionHandler)XScuGic_DeviceInterruptHandler,
-            (void *)XPAR_SCUGIC_SINGLE_DEVICE_ID);
+            (Xil_ExceptionHandler)dispatch_interrupt,
+            NULL);
 
     return success;
 }
@@ -89,6 +236,150 @@ void set_interrupts(bool enabled)
     }
 }
 
+/**
+ * Registers and enables a shared peripheral interrupt with the GIC.
+ *
+ * @note Interrupts are configured as active-high level sensitive.
+ *
+ * @param id The GIC interrupt ID.
+ * @param handler The handler to call when the interrupt fires.
+ * @param arg The argument provided to the handler.
+ * @param priority The priority of the interrupt.
+ *
+ * @return Success or fail.
+ */
+result_t register_interrupt(const uint32_t id,
+                            void (*handler)(void *),
+                            void *arg,
+                            const irq_priority_t priority)
+{
+    AbortIfNot(handler, fail);
+    AbortIfNot(id < XSCUGIC_MAX_NUM_INTR_INPUTS, fail);
+
+    XScuGic_RegisterHandler(XPAR_SCUGIC_CPU_BASEADDR, id,
+            (Xil_InterruptHandler)handler, arg);
+
+    XScuGic_SetPriTrigTypeByDistAddr(XPAR_SCUGIC_DIST_BASEADDR, id, priority, 0x1);
+    XScuGic_EnableIntr(XPAR_SCUGIC_DIST_BASEADDR, id);
+
+    return success;
+}
+
+/**
+ * Changes the priority of an interrupt, such as one that a Xilinx driver
+ * connected itself.
+ *
+ * @param id The GIC interrupt ID.
+ * @param priority The priority of the interrupt.
+ *
+ * @return Success or fail.
+ */
+result_t set_interrupt_priority(const uint32_t id, const irq_priority_t priority)
+{
+    AbortIfNot(id < XSCUGIC_MAX_NUM_INTR_INPUTS, fail);
+
+    uint8_t current, trigger;
+    XScuGic_GetPriTrigTypeByDistAddr(XPAR_SCUGIC_DIST_BASEADDR, id, &current, &trigger);
+    XScuGic_SetPriTrigTypeByDistAddr(XPAR_SCUGIC_DIST_BASEADDR, id, priority, trigger);
+
+    return success;
+}
+
+/**
+ * Gets the address of the instruction that the interrupt being handled
+ * interrupted, which lies in a preempted handler if it nested.
+ *
+ * @note The IRQ vector of the Xilinx runtime first pushes r0-r3, r12 and the
+ *       IRQ mode link register, which holds the interrupted instruction plus
+ *       four, so the link register is the last word below the frame.
+ *
+ * @return The interrupted instruction. This must be called from a handler.
+ */
+uint32_t get_interrupted_pc()
+{
+    return ((const uint32_t *)interrupt_frame)[-1] - 4;
+}
+
+/**
+ * Allows the handlers of interrupts below IRQ_PRIORITY_PROFILE to be preempted
+ * by those of a higher priority.
+ *
+ * @note Each level of nesting takes another exception frame from the IRQ
+ *       stack.
+ *
+ * @param enabled True if handlers may be preempted.
+ *
+ * @return None.
+ */
+void set_interrupt_nesting(const bool enabled)
+{
+    interrupt_nesting = enabled;
+}
+
+/**
+ * Gets the counters of an interrupt.
+ *
+ * @param id The GIC interrupt ID.
+ * @param[out] stats The counters of the interrupt.
+ *
+ * @return Success or fail.
+ */
+result_t get_interrupt_stats(const uint32_t id, irq_stats_t *stats)
+{
+    AbortIfNot(id < XSCUGIC_MAX_NUM_INTR_INPUTS, fail);
+    AbortIfNot(stats, fail);
+
+    const uint32_t cpsr = save_and_disable_interrupts();
+    *stats = interrupt_stats[id];
+    restore_interrupts(cpsr);
+
+    return success;
+}
+
+/**
+ * Clears the counters of all interrupts.
+ *
+ * @return None.
+ */
+void reset_interrupt_stats()
+{
+    const uint32_t cpsr = save_and_disable_interrupts();
+    memset(interrupt_stats, 0, sizeof(interrupt_stats));
+    restore_interrupts(cpsr);
+}
+
+/**
+ * Enables an interrupt at the GIC distributor.
+ *
+ * @param id The GIC interrupt ID.
+ *
+ * @return Success or fail.
+ */
+result_t enable_interrupt(const uint32_t id)
+{
+    AbortIfNot(id < XSCUGIC_MAX_NUM_INTR_INPUTS, fail);
+
+    XScuGic_EnableIntr(XPAR_SCUGIC_DIST_BASEADDR, id);
+
+    return success;
+}
+
+/**
+ * Disables an interrupt at the GIC distributor.
+ *
+ * @param id The GIC interrupt ID.
+ *
+ * @return Success or fail.
+ */
+result_t disable_interrupt(const uint32_t id)
+{
+    AbortIfNot(id < XSCUGIC_MAX_NUM_INTR_INPUTS, fail);
+
+    XScuGic_DisableIntr(XPAR_SCUGIC_DIST_BASEADDR, id);
+
+    return success;
+}
+
 /**
  * Sets the status of the on-board LED for the MicroZed.
  *
@@ -114,3 +405,82 @@ tick_t get_system_time()
      */
     return get_global_timer_count();
 }
+
+/**
+ * Gets the index of the processor core executing the caller.
+ *
+ * @return Zero for CPU0 or one for CPU1.
+ */
+uint32_t get_cpu_id()
+{
+    uint32_t mpidr;
+    __asm volatile("mrc p15, 0, %0, c0, c0, 5" : "=r"(mpidr));
+
+    return mpidr & 0x3;
+}
+
+/**
+ * Acknowledges the periodic wakeup of the private timer.
+ *
+ * @param arg Unused.
+ *
+ * @return None.
+ */
+static void idle_wakeup_handler(void *arg)
+{
+    private_timer_regs->Interrupt_Status_Register = PRIVATE_TIMER_EVENT_FLAG;
+}
+
+/**
+ * Starts the private timer interrupting periodically, which bounds how long
+ * wait_for_interrupt() sleeps when no other interrupt arrives.
+ *
+ * @note Interrupts must be registered before they are globally enabled with
+ *       set_interrupts().
+ *
+ * @return Success or fail.
+ */
+result_t enable_idle_wakeup()
+{
+    private_timer_regs->Control_Register = 0;
+    private_timer_regs->Interrupt_Status_Register = PRIVATE_TIMER_EVENT_FLAG;
+    AbortIfNot(register_interrupt(PRIVATE_TIMER_IRQ_ID, idle_wakeup_handler, NULL, IRQ_PRIORITY_BACKGROUND), fail);
+
+    /*
+     * The private timer is clocked at the same rate as the global timer.
+     */
+    private_timer_regs->Load_Register = micros_to_ticks(IDLE_WAKEUP_PERIOD_US) - 1;
+    private_timer_regs->Control_Register = PRIVATE_TIMER_ENABLE |
+                                           PRIVATE_TIMER_AUTO_RELOAD |
+                                           PRIVATE_TIMER_IRQ_ENABLE;
+
+    return success;
+}
+
+/**
+ * Sleeps the calling core until an interrupt arrives, and counts the time
+ * slept as idle.
+ *
+ * @note An interrupt that arrives just before the sleep is handled first, so
+ *       the sleep then lasts until the next interrupt, which is at most the
+ *       wakeup period once enable_idle_wakeup() has been called.
+ *
+ * @return None.
+ */
+void wait_for_interrupt()
+{
+    const tick_t start = get_system_time();
+    __asm volatile("dsb\n"
+                   "wfi" ::: "memory");
+    idle_ticks += get_system_time() - start;
+}
+
+/**
+ * Gets the time that the main core has spent in wait_for_interrupt().
+ *
+ * @return The idle time in ticks.
+ */
+tick_t get_idle_time()
+{
+    return idle_ticks;
+}
@@ -3,6 +3,47 @@
 
 #include "types.h"
 
+/**
+ * The private peripheral interrupt of the CPU private timer, and the period
+ * at which it wakes an idle core.
+ */
+#define PRIVATE_TIMER_IRQ_ID 29
+#define IDLE_WAKEUP_PERIOD_US 1000
+
+/**
+ * The number of GIC interrupt IDs of the Zynq-7000.
+ */
+#define NUM_INTERRUPT_IDS 95
+
+/**
+ * The GIC priorities of the interrupts, where a lower value is served first.
+ * The GIC implements the upper five bits. While nesting is enabled, handlers
+ * below IRQ_PRIORITY_PROFILE run with IRQs unmasked and are preempted by any
+ * interrupt of a higher priority.
+ */
+typedef enum irq_priority_t
+{
+    IRQ_PRIORITY_CAPTURE = 0x20,
+    IRQ_PRIORITY_DMA = 0x40,
+    IRQ_PRIORITY_PROFILE = 0x60,
+    IRQ_PRIORITY_TIMER = 0x80,
+    IRQ_PRIORITY_DEFAULT = 0xA0,
+    IRQ_PRIORITY_NETWORK = 0xC0,
+    IRQ_PRIORITY_BACKGROUND = 0xD0
+} irq_priority_t;
+
+/**
+ * The counters of one interrupt. The time spent includes that of any
+ * interrupts that preempted its handler.
+ */
+typedef struct irq_stats_t
+{
+    uint32_t count;
+    uint32_t nested;
+    tick_t max_ticks;
+    tick_t total_ticks;
+} irq_stats_t;
+
 result_t init_system();
 
 void give_up();
@@ -11,6 +52,103 @@ void set_board_led(bool enabled);
 
 void set_interrupts(bool enabled);
 
+result_t register_interrupt(const uint32_t id,
+                            void (*handler)(void *),
+                            void *arg,
+                            const irq_priority_t priority);
+
+result_t set_interrupt_priority(const uint32_t id, const irq_priority_t priority);
+
+void set_interrupt_nesting(const bool enabled);
+
+uint32_t get_interrupted_pc();
+
+result_t get_interrupt_stats(const uint32_t id, irq_stats_t *stats);
+
+void reset_interrupt_stats();
+
+result_t enable_interrupt(const uint32_t id);
+
+result_t disable_interrupt(const uint32_t id);
+
 tick_t get_system_time();
 
+uint32_t get_cpu_id();
+
+result_t enable_idle_wakeup();
+
+void wait_for_interrupt();
+
+tick_t get_idle_time();
+
+/**
+ * Waits for all outstanding memory accesses to complete.
+ *
+ * @return None.
+ */
+static inline void data_sync_barrier()
+{
+    __asm volatile("dsb" ::: "memory");
+}
+
+/**
+ * Orders memory accesses before the barrier ahead of those after it.
+ *
+ * @return None.
+ */
+static inline void data_memory_barrier()
+{
+    __asm volatile("dmb" ::: "memory");
+}
+
+/**
+ * Wakes any core waiting for an event.
+ *
+ * @return None.
+ */
+static inline void send_event()
+{
+    __asm volatile("sev" ::: "memory");
+}
+
+/**
+ * Sleeps until an event is signalled by another core.
+ *
+ * @return None.
+ */
+static inline void wait_for_event()
+{
+    __asm volatile("wfe" ::: "memory");
+}
+
+/**
+ * Masks IRQs on the calling core.
+ *
+ * @return The previous program status, to be passed to restore_interrupts().
+ */
+static inline uint32_t save_and_disable_interrupts()
+{
+    uint32_t cpsr;
+    __asm volatile("mrs %0, cpsr\n"
+                   "cpsid i\n" : "=r"(cpsr) :: "memory");
+
+    return cpsr;
+}
+
+/**
+ * Unmasks IRQs if they were unmasked when save_and_disable_interrupts() was
+ * called.
+ *
+ * @param cpsr The program status returned by save_and_disable_interrupts().
+ *
+ * @return None.
+ */
+static inline void restore_interrupts(const uint32_t cpsr)
+{
+    if (!(cpsr & 0x80))
+    {
+        __asm volatile("cpsie i" ::: "memory");
+    }
+}
+
 #endif
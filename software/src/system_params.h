@@ -12,6 +12,32 @@
 
 #define FPGA_CLK 100000000
 
+/**
+ * The time that the cycle counter of each core is measured against the global
+ * timer for at boot, and how far from the core clock its measured rate may be
+ * while still being taken as the core clock.
+ */
+#define CYCLE_COUNTER_CALIBRATION_US 1000
+#define CYCLE_COUNTER_TOLERANCE_PERCENT 1
+
+/**
+ * The rate at which the ADC samples at boot, before decimation.
+ */
+#define INITIAL_SAMPLING_FREQUENCY_HZ 5000000
+
+/**
+ * The size in bytes of a line of the L1 and L2 caches.
+ */
+#define CACHE_LINE_BYTES 32
+
+/**
+ * The number of ways of the 512 KB L2 cache and the size of each, and the
+ * number of ways locked to hold the hot section.
+ */
+#define L2_WAYS 8
+#define L2_WAY_BYTES 0x10000
+#define L2_LOCKED_WAYS 1
+
 /*
  * UDP port definitions.
  */
@@ -22,9 +48,520 @@
 #define XCORR_STREAM_PORT 3003
 #define DEBUG_PORT 3004
 #define SILENT_REQUEST_PORT 3005
+#define TELEMETRY_PORT 3007
+#define PREVIEW_PORT 3010
+#define RECORD_PORT 3011
+#define SURVEY_PORT 3012
+#define BOARD_SYNC_PORT 3014
+#define UPLOAD_PORT 3015
+
+/*
+ * TCP port definitions.
+ */
+#define CAPTURE_STREAM_PORT 3006
+#define REPLAY_PORT 3009
+
+/**
+ * The number of points in the envelope of each capture sent on the preview
+ * stream.
+ */
+#define PREVIEW_POINTS 256
 
 #define INITIAL_ADC_THRESHOLD 500
 
+#define INITIAL_PING_FREQUENCY_HZ 25000
+
+/**
+ * Defines the bandwidth of the narrowband ping detector. Narrower bandwidths
+ * reject more noise but delay detection of the ping onset.
+ */
+#define TONE_DETECTOR_BANDWIDTH_HZ 5000
+
+/**
+ * Defines the duration at the start of a capture, before the ping is expected, that
+ * the offset and noise of each channel are estimated from.
+ */
+#define NOISE_ESTIMATE_DURATION_US 200
+
+/**
+ * The CFAR detector averages this power of two of training cells, which end
+ * the number of guard cells before the sample under test, and treats a mean
+ * level below the minimum as the minimum.
+ */
+#define CFAR_TRAINING_SHIFT 10
+#define CFAR_GUARD_SAMPLES 64
+#define CFAR_MIN_LEVEL 4
+
+/**
+ * The longest pinger waveform template that the matched filter correlates
+ * against, which must be a power of two.
+ */
+#define MATCHED_TEMPLATE_MAX 4096
+
+/**
+ * The longest FIR filter that captures can be filtered with in the frequency
+ * domain, which must be a power of two.
+ */
+#define FIR_FILTER_MAX_TAPS 4096
+
+/**
+ * Defines the fewest samples before the onset of a ping that its noise is
+ * measured from when its quality is estimated.
+ */
+#define PING_QUALITY_MIN_NOISE_SAMPLES 32
+
+/**
+ * Defines the SNR at which a ping scores nothing and the SNR at which it
+ * scores fully.
+ */
+#define PING_QUALITY_FLOOR_SNR_DB 6
+#define PING_QUALITY_FULL_SNR_DB 26
+
+/**
+ * Defines the lowest and highest codes of the 14-bit ADC, at which a raw
+ * sample is counted as clipped.
+ */
+#define ADC_MIN_CODE 0
+#define ADC_MAX_CODE 16383
+
+/**
+ * The ADC test pattern self test at boot: the capture taken of each pattern,
+ * the packets discarded around it while the pattern takes effect, and how far
+ * the rate of the stream may be from the rate set by the clock divider.
+ */
+#define ADC_SELF_TEST_MS 20
+#define ADC_SELF_TEST_SETTLE_PACKETS 16
+#define ADC_SELF_TEST_RATE_TOLERANCE_PERCENT 1
+
+/**
+ * The fewest samples per packet with which planned windows are recorded with
+ * the statistics trailers of the ADC, which bounds the storage they take.
+ */
+#define ADC_STATS_MIN_PACKET_SAMPLES 64
+
+/**
+ * Defines the number of clipped samples at which a ping scores nothing.
+ */
+#define PING_QUALITY_CLIP_LIMIT 64
+
+/**
+ * Defines the duration after the onset of a ping that the direct path is
+ * expected to peak within.
+ */
+#define PING_QUALITY_ONSET_US 500
+
+/**
+ * Defines the time constant of the envelope that the leading edge of the
+ * direct path is found on. It spans about a cycle of the pinger.
+ */
+#define ENVELOPE_SMOOTHING_US 20
+
+/**
+ * Defines the fraction of the peak envelope, in percent, at which the leading
+ * edge of a channel is taken.
+ */
+#define ENVELOPE_ONSET_PERCENT 10
+
+/**
+ * Defines the duration kept before the earliest leading edge and after the
+ * latest one when the window is trimmed to the direct path. Reflections that
+ * arrive later are excluded from the correlation.
+ */
+#define ENVELOPE_GUARD_US 40
+#define ENVELOPE_DIRECT_PATH_US 200
+
+/**
+ * Defines the largest timing uncertainty of a pair of leading edges at which
+ * their difference is reported as the delay of the pair without correlating
+ * the ping.
+ */
+#define FAST_TDOA_MAX_UNCERTAINTY_NS 250
+
+/**
+ * Defines how far the transient of the biquad cascade must have decayed, in
+ * dB, before the samples that follow it are treated as filtered when only
+ * the located window of a capture is filtered.
+ */
+#define FILTER_SETTLING_DB 60
+
+/**
+ * Defines the bandwidth of each bandpass stage of the pinger filter bank.
+ */
+#define PINGER_BANDWIDTH_HZ 8000
+
+/**
+ * Defines the band around the pinger frequency that is kept when the
+ * correlation is whitened by the phase transform.
+ */
+#define PHAT_BANDWIDTH_HZ 10000
+
+/**
+ * Defines the number of samples per sample of the envelope that the FPGA
+ * streams while sync is acquired from it, the number of envelope samples read
+ * from the FPGA at once, and the level that the power threshold is scaled to
+ * within the 16 bits of each envelope sample.
+ */
+#define ENVELOPE_SYNC_DECIMATION 128
+#define ENVELOPE_SYNC_READ_SAMPLES 256
+#define ENVELOPE_SYNC_THRESHOLD_BITS 12
+
+/**
+ * Defines the full-rate ring in samples that dual-rate sync records into,
+ * the most that the detection stream read from the ring is decimated by, and
+ * how far ahead of a flagged crossing the window that is located again at
+ * the full rate starts, before the filter settling time is added.
+ */
+#define DUAL_RATE_RING_SAMPLES (1 << 18)
+#define DUAL_RATE_MAX_DECIMATION 8
+#define DUAL_RATE_PRE_PING_US 2000
+
+/**
+ * Defines the history that continuous capture keeps in its ring, how far the
+ * window extracted around a detected crossing reaches before it, before the
+ * filter settling time is added, and after it, and the sample count past
+ * which the counters of the ring are rebased so that they never wrap.
+ */
+#define CONTINUOUS_RING_MS 400
+#define CONTINUOUS_PRE_PING_US 10000
+#define CONTINUOUS_POST_PING_US 10000
+#define CONTINUOUS_REBASE_SAMPLES (1u << 30)
+
+/**
+ * Defines how far the channels are decimated for the coarse lag search. The
+ * highest frequency of the ping keeps at least the given number of samples
+ * per cycle, and the highest pinger frequency is assumed when the frequency
+ * of the pinger is unknown.
+ */
+#define COARSE_SEARCH_SAMPLES_PER_CYCLE 8
+#define COARSE_SEARCH_MAX_DECIMATION 8
+
+/**
+ * Defines the fewest samples per cycle of the highest ping frequency that the
+ * channels keep when they are decimated before the ping is located.
+ */
+#define DECIMATION_SAMPLES_PER_CYCLE 16
+#define COARSE_SEARCH_MAX_PINGER_HZ 45000
+
+/**
+ * Defines the window of lags searched on each side of the lag predicted from
+ * recent pings, and the lowest confidence of a ping that lags are predicted
+ * from or that a search of the window is trusted at.
+ */
+#define LAG_TRACK_RADIUS_NS 1000
+#define LAG_TRACK_MIN_RADIUS 2
+#define LAG_TRACK_MIN_CONFIDENCE_PERCENT 50
+
+/**
+ * Defines the bearing tracker: the noise of a delay measured with full
+ * confidence, the random acceleration of the delays, and the uncertainty of
+ * their rate when the tracker starts. A delay further from the prediction
+ * than the gate is an outlier, and the tracker restarts after too many
+ * consecutive outliers or too long without a ping.
+ */
+#define BEARING_TRACK_MEASUREMENT_NS 200
+#define BEARING_TRACK_ACCELERATION_NS_PER_S2 100
+#define BEARING_TRACK_INITIAL_RATE_NS_PER_S 5000
+#define BEARING_TRACK_GATE_SIGMA 3
+#define BEARING_TRACK_MAX_OUTLIERS 3
+#define BEARING_TRACK_STALE_MS 10000
+#define BEARING_TRACK_MIN_UPDATES 3
+
+/**
+ * Defines the channel health monitor. A channel is stuck if its RMS in ADC
+ * counts is below the stuck level, dead or noisy if its RMS is below or above
+ * a percentage of the median RMS of the channels, and saturated if more than
+ * a fraction of its samples in parts per million are at either rail. A fault
+ * must be seen in consecutive captures before the channel is flagged, and the
+ * flag is only cleared after more consecutive healthy captures.
+ */
+#define CHANNEL_HEALTH_STUCK_RMS 0.5f
+#define CHANNEL_HEALTH_DEAD_PERCENT 10
+#define CHANNEL_HEALTH_NOISY_PERCENT 400
+#define CHANNEL_HEALTH_SATURATED_PPM 10000
+#define CHANNEL_HEALTH_FLAG_CAPTURES 3
+#define CHANNEL_HEALTH_CLEAR_CAPTURES 10
+
+/**
+ * Defines the calibration of the channel delays and gains. A calibration
+ * averages at most the maximum pings, and is rejected if the skew of any
+ * channel in nanoseconds or the ratio of its gain to the reference's is
+ * beyond the limits, which no working front end reaches.
+ */
+#define CALIBRATION_MAX_PINGS 1000
+#define CALIBRATION_MAX_SKEW_NS 5000
+#define CALIBRATION_MAX_GAIN 8
+
+/**
+ * Defines the nominal period of the pinger and the largest error in a ping
+ * arrival time that is attributed to the pinger rather than a false detection.
+ */
+#define PING_PERIOD_MS 2000
+#define PING_TRACKER_OUTLIER_MS 20
+
+/**
+ * Bounds on the capture window around a predicted ping. The margin on each
+ * side of the prediction shrinks with the tracker's prediction error and
+ * doubles for each consecutive missed ping. Once more than
+ * CAPTURE_MAX_MISSES pings are missed, the window opens to the
+ * re-acquisition margin instead.
+ */
+#define CAPTURE_MARGIN_MIN_US 2000
+#define CAPTURE_MARGIN_MAX_US 50000
+#define CAPTURE_REACQUIRE_MARGIN_US 140000
+#define CAPTURE_PING_LENGTH_US 10000
+#define CAPTURE_DURATION_MAX_US 300000
+#define THRUSTER_SILENCE_MAX_US 100000
+
+/**
+ * The window recorded around each located ping in record mode, which starts
+ * before the ping so that the noise floor is kept, and the number of windows
+ * that may wait to be streamed.
+ */
+#define RECORD_PRE_PING_US 2000
+#define RECORD_WINDOW_US 16000
+#define RECORD_QUEUE_DEPTH 8
+
+/**
+ * The number of located pings kept on board to be fetched on demand, and the
+ * length of the window kept from the start of each.
+ */
+#define PING_HISTORY_DEPTH 32
+#define PING_HISTORY_WINDOW_US 4000
+
+/**
+ * The number of pings that may be in flight between the stages of the
+ * pipeline at once, which is at most 32.
+ */
+#define PING_CONTEXT_POOL_SIZE 4
+
+/**
+ * The most consumers that may subscribe to each of the data and correlation
+ * streams at once.
+ */
+#define STREAM_MAX_SUBSCRIBERS 4
+
+/**
+ * The longest and default segments of the spectral survey, which must be
+ * powers of two, the longest survey, and the most samples captured into
+ * each half of the sample array while the other half is averaged.
+ */
+#define SURVEY_MAX_FFT_LEN 4096
+#define SURVEY_DEFAULT_FFT_LEN 1024
+#define SURVEY_MAX_DURATION_MS 60000
+#define SURVEY_BLOCK_SAMPLES 262144
+
+/**
+ * The number of events held by the trace, which must be a power of two, and
+ * the pause between the datagrams of a trace dump.
+ */
+#define TRACE_DEPTH 4096
+#define TRACE_PACKET_INTERVAL_US 200
+
+/**
+ * The number of distinct instructions that the PC sampler counts on each
+ * core, which must be a power of two, the default period between samples,
+ * and the pause between the datagrams of a sample dump.
+ */
+#define PC_SAMPLE_BUCKETS 4096
+#define PC_SAMPLE_DEFAULT_PERIOD_US 100
+#define PC_SAMPLE_PACKET_INTERVAL_US 200
+
+/**
+ * The most blocks a copy of the DMA controller may gather, the shortest copy
+ * that is offloaded rather than made by the processor, and the time allowed
+ * for a copy to complete.
+ */
+#define COPY_MAX_SEGMENTS 4
+#define COPY_ENGINE_MIN_BYTES 4096
+#define COPY_ENGINE_TIMEOUT_MS 50
+
+/**
+ * The region of the SD card that recordings are written to, in blocks. The
+ * region must lie outside the boot partition, and is read back as a single
+ * capture file.
+ */
+#define SD_RECORD_FIRST_BLOCK 2097152
+#define SD_RECORD_BLOCKS 4194304
+
+/**
+ * The SD card recorder writes samples in chunks of this many blocks from a
+ * ring of staging chunks, indexes up to a number of pings, and rewrites the
+ * index on the card after every few pings.
+ */
+#define SD_RECORD_CHUNK_BLOCKS 128
+#define SD_RECORD_STAGE_CHUNKS 16
+#define SD_RECORD_MAX_PINGS 4096
+#define SD_RECORD_INDEX_INTERVAL 16
+
+/**
+ * The USB capture stream queues up to this many transfer descriptors on its
+ * bulk endpoint, sends at most this many bytes of elements after each stream
+ * header, and gives up on a transfer the host stops reading.
+ */
+#define USB_STREAM_DESCRIPTORS 32
+#define USB_STREAM_PACKET_BYTES 16384
+#define USB_STREAM_TIMEOUT_MS 500
+
+/**
+ * The interval between the pulses the master board drives on the sync line,
+ * the time allowed for a pulse to be latched and announced, and the time
+ * without a pulse after which a follower is no longer aligned.
+ */
+#define BOARD_SYNC_PERIOD_MS 1000
+#define BOARD_SYNC_LATCH_TIMEOUT_MS 20
+#define BOARD_SYNC_STALE_MS 5000
+
+/**
+ * The number of datagrams of a bulk upload received in order between
+ * acknowledgements.
+ */
+#define BULK_UPLOAD_ACK_BATCH 16
+
+/**
+ * The default coalescing of the DMA completion interrupts, and the longest
+ * delay its timer counts, which is 255 units of 125 cycles of the
+ * scatter-gather clock.
+ */
+#define DMA_IRQ_THRESHOLD 1
+#define DMA_IRQ_DELAY_US 100
+#define DMA_IRQ_DELAY_MAX_US (255 * 125 / (FPGA_CLK / 1000000))
+
+/**
+ * The length of each synthetic ping, the defaults of the synthetic pinger
+ * in ADC codes, and the number of synthetic pings between soak reports.
+ */
+#define SYNTH_PING_LENGTH_US 4000
+#define SYNTH_AMPLITUDE 2000
+#define SYNTH_NOISE_AMPLITUDE 50
+#define SYNTH_REPORT_PINGS 32
+
+/**
+ * The time a gated capture waits for an edge of the external trigger input,
+ * and the length of the window captured from the edge.
+ */
+#define TRIGGER_GATE_TIMEOUT_MS 2000
+#define TRIGGER_GATE_WINDOW_MS 250
+
+/**
+ * The number of consecutive pings that may be missed in the widened window
+ * around the tracked ping, and the number after which re-acquisition around
+ * the predicted phase gives up and sync is dropped.
+ */
+#define CAPTURE_MAX_MISSES 3
+#define CAPTURE_REACQUIRE_MISSES 6
+
+/**
+ * The default budget of a single call to dispatch the network stack, which
+ * bounds how long a burst of inbound traffic can delay acquisition.
+ */
+#define NETWORK_DISPATCH_MAX_PACKETS 8
+#define NETWORK_DISPATCH_MAX_US 200
+
+/**
+ * The requests the network core runs between dispatches of the network
+ * stack, the transmit descriptors it keeps free ahead of a send, and the
+ * longest it waits for the driver to free them.
+ */
+#define NET_CORE_REQUEST_BATCH 8
+#define NET_CORE_MIN_FREE_DESCRIPTORS 2
+#define NET_CORE_SEND_WAIT_US 2000
+
+/**
+ * The number of destinations whose ARP entries are kept resolved, the
+ * intervals at which a resolved entry is refreshed and an unresolved one is
+ * requested again, and the longest a transfer waits for its destination to
+ * be resolved before it is dropped. Entries age out after twenty minutes.
+ */
+#define MAX_ARP_DESTINATIONS 8
+#define ARP_REFRESH_INTERVAL_MS 60000
+#define ARP_RETRY_INTERVAL_MS 1000
+#define ARP_PREWARM_TIMEOUT_MS 20
+
+/**
+ * The number of buffered log bytes written out at each idle point.
+ */
+#define LOG_DRAIN_BYTES_PER_CALL 512
+
+/**
+ * The interval between telemetry reports.
+ */
+#define TELEMETRY_PERIOD_MS 1000
+
+/**
+ * The time without progress in the main loop after which the watchdog resets
+ * the processor.
+ */
+#define WATCHDOG_TIMEOUT_MS 4000
+
+/**
+ * The deadlines of the stages of the main loop. A capture may take its
+ * planned duration plus the slack, processing may take a multiple of the
+ * capture duration plus a fixed allowance, and sending may take the time the
+ * rate limit requires plus the slack. A stage that overruns more times in a
+ * row than is tolerated escalates to a warm restart.
+ */
+#define DEADLINE_CAPTURE_SLACK_MS 50
+#define DEADLINE_DSP_CAPTURE_FACTOR 2
+#define DEADLINE_DSP_MIN_MS 200
+#define DEADLINE_SEND_SLACK_MS 200
+#define DEADLINE_MAX_CONSECUTIVE_OVERRUNS 3
+
+/**
+ * The load governor sheds a feature when a ping costs more than a share of
+ * the ping period, and restores one once the smoothed cost has stayed below a
+ * smaller share for a number of pings. The newest ping is weighted by the
+ * given percentage in the smoothed cost.
+ */
+#define LOAD_GOVERNOR_SHED_PERCENT 80
+#define LOAD_GOVERNOR_RESTORE_PERCENT 50
+#define LOAD_GOVERNOR_RESTORE_PINGS 8
+#define LOAD_GOVERNOR_SMOOTHING_PERCENT 25
+
+/**
+ * The initial rate limit of the data and correlation streams. A rate of zero
+ * only limits transmission by the space in the Ethernet transmit ring.
+ */
+#define INITIAL_TRANSMIT_RATE_BYTES_PER_SECOND 20000000
+#define INITIAL_TRANSMIT_BURST_BYTES 16384
+
+/**
+ * The period the PHY is polled for the state of the Ethernet link at, and the
+ * share of the link rate the streams are limited to. The rest is left for
+ * results, telemetry and the frame overhead the limit does not count.
+ */
+#define NETWORK_LINK_POLL_MS 1000
+#define NETWORK_LINK_TRANSMIT_PERCENT 90
+
+/**
+ * How long before a planned capture window the streams stop queueing data,
+ * so that the transmit ring has drained when the capture is armed, and how
+ * long after the predicted end of the window they are held at most.
+ */
+#define TRANSMIT_QUIET_LEAD_US 3000
+#define TRANSMIT_QUIET_SLACK_MS 20
+
+/**
+ * The device that accelerator modules must be built for, as the bitstream
+ * header names it, and the longest time a module may take to load through
+ * the configuration port.
+ */
+#define ACCELERATOR_PART "7z010"
+#define ACCELERATOR_LOAD_TIMEOUT_MS 50
+
+/**
+ * The largest datagram that small messages are coalesced into, which fits a
+ * single Ethernet frame, and the longest that a result waits for others to
+ * share its datagram. A delay of zero sends every result alone.
+ */
+#define MESSAGE_BATCH_BYTES 1400
+#define INITIAL_RESULT_BATCH_DELAY_MS 2
+
+/**
+ * The number of results that may wait to be resent while the link cannot
+ * take them. The oldest is lost if another arrives while the queue is full.
+ */
+#define RESULT_RETRY_DEPTH 16
+
 /**
  * Geometric constraints on the hydrophone sample shifts
  */
@@ -33,8 +570,14 @@
 #define MAX_TIME_BETWEEN_PHONES (HYDROPHONE_SPACING_METERS / SPEED_SOUND_WATER_METERS_PER_SECOND)
 
 /**
- * Defines the maximum samples that can occur between two hydrophones at a sampling rate of 5Msps.
+ * The most correlation results that a correlation view may stream.
+ */
+#define XCORR_VIEW_MAX_CORRELATIONS 512
+
+/**
+ * Defines the number of lags multiplied by the correlation length above which
+ * cross correlation is computed with FFTs rather than directly.
  */
-#define MAX_SAMPLES_BETWEEN_PHONES ((MAX_TIME_BETWEEN_PHONES * 5000000))
+#define FFT_CORRELATION_THRESHOLD 1000000
 
 #endif
@@ -0,0 +1,353 @@
+#include "tcp.h"
+
+#include "abort.h"
+#include "db.h"
+#include "system.h"
+#include "time_util.h"
+#include "types.h"
+#include "lwip/tcp.h"
+#include "lwip/tcp_impl.h"
+
+/**
+ * Closes the connection of a socket, or aborts it if it cannot be closed,
+ * and notifies the receive handler.
+ *
+ * @param socket The socket, which must have a connection.
+ *
+ * @return ERR_ABRT if the pcb was aborted, or ERR_OK if it was closed.
+ */
+static err_t release_pcb(tcp_socket_t *socket)
+{
+    err_t ret = ERR_OK;
+
+    tcp_arg(socket->pcb, NULL);
+    tcp_sent(socket->pcb, NULL);
+    tcp_recv(socket->pcb, NULL);
+    tcp_err(socket->pcb, NULL);
+    if (tcp_close(socket->pcb) != ERR_OK)
+    {
+        tcp_abort(socket->pcb);
+        ret = ERR_ABRT;
+    }
+
+    socket->pcb = NULL;
+
+    if (socket->receive)
+    {
+        socket->receive(socket->receive_arg, NULL, 0);
+    }
+
+    return ret;
+}
+
+/**
+ * Callback for data acknowledged by the client.
+ *
+ * @return ERR_OK.
+ */
+static err_t tcp_sent_callback(void *arg, struct tcp_pcb *pcb, u16_t len)
+{
+    tcp_socket_t *socket = arg;
+    socket->acknowledged += len;
+
+    return ERR_OK;
+}
+
+/**
+ * Callback for data received from the client. Received data is passed to the
+ * receive handler of the socket, or discarded if it has none.
+ *
+ * @return ERR_ABRT if the pcb was aborted while closing it, or ERR_OK.
+ */
+static err_t tcp_recv_callback(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err)
+{
+    tcp_socket_t *socket = arg;
+
+    if (!p)
+    {
+        /*
+         * The client closed the connection. The network stack must not touch
+         * the pcb again if it had to be aborted.
+         */
+        if (!socket->pcb)
+        {
+            return ERR_OK;
+        }
+
+        return release_pcb(socket);
+    }
+
+    if (socket->receive)
+    {
+        for (struct pbuf *q = p; q; q = q->next)
+        {
+            socket->receive(socket->receive_arg, q->payload, q->len);
+        }
+    }
+
+    tcp_recved(pcb, p->tot_len);
+    pbuf_free(p);
+
+    return ERR_OK;
+}
+
+/**
+ * Callback for a fatal error on the connection. The pcb has already been
+ * freed by the network stack.
+ *
+ * @return None.
+ */
+static void tcp_err_callback(void *arg, err_t err)
+{
+    tcp_socket_t *socket = arg;
+    socket->pcb = NULL;
+    if (socket->receive)
+    {
+        socket->receive(socket->receive_arg, NULL, 0);
+    }
+
+    dbprintf("TCP connection lost: %d\n", err);
+}
+
+/**
+ * Callback for a new client connection.
+ *
+ * @return ERR_OK if the connection was accepted.
+ */
+static err_t tcp_accept_callback(void *arg, struct tcp_pcb *pcb, err_t err)
+{
+    tcp_socket_t *socket = arg;
+
+    /*
+     * Only a single client is served at a time.
+     */
+    if (socket->pcb)
+    {
+        return ERR_MEM;
+    }
+
+    tcp_accepted(socket->listen_pcb);
+
+    socket->pcb = pcb;
+    socket->written = 0;
+    socket->acknowledged = 0;
+
+    tcp_arg(pcb, socket);
+    tcp_sent(pcb, tcp_sent_callback);
+    tcp_recv(pcb, tcp_recv_callback);
+    tcp_err(pcb, tcp_err_callback);
+    tcp_nagle_disable(pcb);
+
+    dbprintf("TCP client connected.\n");
+
+    return ERR_OK;
+}
+
+/**
+ * Initializes a TCP socket.
+ *
+ * @return Success or fail.
+ */
+result_t init_tcp(tcp_socket_t *socket)
+{
+    AbortIfNot(socket, fail);
+
+    socket->listen_pcb = NULL;
+    socket->pcb = NULL;
+    socket->written = 0;
+    socket->acknowledged = 0;
+    socket->receive = NULL;
+    socket->receive_arg = NULL;
+
+    return success;
+}
+
+/**
+ * Listens for a client connection on a port.
+ *
+ * @param socket The socket to listen with.
+ * @param port The port to accept connections on.
+ *
+ * @return Success or fail.
+ */
+result_t listen_tcp(tcp_socket_t *socket, const uint16_t port)
+{
+    AbortIfNot(socket, fail);
+
+    struct tcp_pcb *pcb = tcp_new();
+    AbortIfNot(pcb, fail);
+
+    if (tcp_bind(pcb, IP_ADDR_ANY, port) != ERR_OK)
+    {
+        tcp_close(pcb);
+        AbortIfNot(false, fail);
+    }
+
+    socket->listen_pcb = tcp_listen(pcb);
+    if (!socket->listen_pcb)
+    {
+        tcp_close(pcb);
+        AbortIfNot(false, fail);
+    }
+
+    tcp_arg(socket->listen_pcb, socket);
+    tcp_accept(socket->listen_pcb, tcp_accept_callback);
+
+    return success;
+}
+
+/**
+ * Checks if a client is connected.
+ *
+ * @return True if data can be sent.
+ */
+bool tcp_connected(const tcp_socket_t *socket)
+{
+    return (socket && socket->pcb)? true : false;
+}
+
+/**
+ * Sets the handler of data received from the client.
+ *
+ * @note The handler is called from the network stack.
+ *
+ * @param socket The socket to receive data on.
+ * @param receive The handler of received data, or NULL to discard it.
+ * @param arg The argument passed to the handler.
+ *
+ * @return Success or fail.
+ */
+result_t set_tcp_receiver(tcp_socket_t *socket, tcp_receive_t receive, void *arg)
+{
+    AbortIfNot(socket, fail);
+
+    socket->receive = receive;
+    socket->receive_arg = arg;
+
+    return success;
+}
+
+/**
+ * Queues as much data as the send buffer allows.
+ *
+ * @note Without copying, the data is referenced by the queued segments and
+ *       must not be modified until tcp_acknowledged() reports the offset
+ *       returned in socket->written.
+ *
+ * @param socket The connected socket to send data over.
+ * @param data The data to send.
+ * @param len The number of bytes to send.
+ * @param copy Specified true to copy the data into the send buffer.
+ * @param[out] written The number of bytes queued, which may be zero if the
+ *             send window is full.
+ *
+ * @return Success or fail.
+ */
+result_t send_tcp(tcp_socket_t *socket,
+                  const void *data,
+                  const size_t len,
+                  const bool copy,
+                  size_t *written)
+{
+    AbortIfNot(socket, fail);
+    AbortIfNot(data, fail);
+    AbortIfNot(written, fail);
+    AbortIfNot(tcp_connected(socket), fail);
+
+    *written = 0;
+
+    size_t to_write = len;
+    if (to_write > tcp_sndbuf(socket->pcb))
+    {
+        to_write = tcp_sndbuf(socket->pcb);
+    }
+
+    if (to_write > 0xFFFF)
+    {
+        to_write = 0xFFFF;
+    }
+
+    if (to_write == 0 || tcp_sndqueuelen(socket->pcb) >= TCP_SND_QUEUELEN)
+    {
+        return success;
+    }
+
+    const err_t err = tcp_write(socket->pcb,
+                                data,
+                                to_write,
+                                (copy)? TCP_WRITE_FLAG_COPY : 0);
+
+    /*
+     * ERR_MEM indicates that the segment queue is full, which is the same
+     * backpressure as a full window.
+     */
+    if (err == ERR_MEM)
+    {
+        tcp_output(socket->pcb);
+        return success;
+    }
+
+    AbortIfNot(err == ERR_OK, fail);
+
+    socket->written += to_write;
+    *written = to_write;
+
+    /*
+     * The data is queued once it is written, so a failure to send it now is
+     * only backpressure. It is sent by the next call or when the client
+     * acknowledges earlier segments.
+     */
+    tcp_output(socket->pcb);
+
+    return success;
+}
+
+/**
+ * Checks if the client has acknowledged the stream up to an offset.
+ *
+ * @param socket The socket to check.
+ * @param offset The stream offset, as a previous value of socket->written.
+ *
+ * @return True if all data before the offset has been acknowledged.
+ */
+bool tcp_acknowledged(const tcp_socket_t *socket, const uint64_t offset)
+{
+    return (socket->acknowledged >= offset)? true : false;
+}
+
+/**
+ * Closes the client connection. The socket continues to listen.
+ *
+ * @return Success or fail.
+ */
+result_t close_tcp(tcp_socket_t *socket)
+{
+    AbortIfNot(socket, fail);
+
+    if (socket->pcb)
+    {
+        release_pcb(socket);
+    }
+
+    return success;
+}
+
+/**
+ * Runs the TCP retransmission and delayed acknowledgement timers.
+ *
+ * @note The network stack is built without its own timers, so this must be
+ *       called regularly for TCP connections to make progress.
+ *
+ * @return None.
+ */
+void service_tcp_timers()
+{
+    static tick_t last_tick = 0;
+
+    const tick_t now = get_system_time();
+    if (now - last_tick >= ms_to_ticks(TCP_TMR_INTERVAL))
+    {
+        last_tick = now;
+        tcp_tmr();
+    }
+}
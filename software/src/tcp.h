@@ -0,0 +1,56 @@
+#ifndef TCP_H
+#define TCP_H
+
+#include "lwip/tcp.h"
+#include "types.h"
+
+/**
+ * Defines a handler of data received from the client.
+ */
+typedef void (*tcp_receive_t)(void *arg, const void *data, const size_t len);
+
+/**
+ * Defines a TCP stream that accepts a single client connection.
+ */
+typedef struct tcp_socket_t
+{
+    struct tcp_pcb *listen_pcb;
+    struct tcp_pcb *pcb;
+
+    /*
+     * The number of bytes queued and acknowledged over the lifetime of the
+     * current connection.
+     */
+    uint64_t written;
+    volatile uint64_t acknowledged;
+
+    /*
+     * The handler of data received from the client and its argument, or NULL
+     * if received data is discarded. The handler is called with no data when
+     * the connection is closed or lost.
+     */
+    tcp_receive_t receive;
+    void *receive_arg;
+} tcp_socket_t;
+
+result_t init_tcp(tcp_socket_t *socket);
+
+result_t listen_tcp(tcp_socket_t *socket, const uint16_t port);
+
+bool tcp_connected(const tcp_socket_t *socket);
+
+result_t set_tcp_receiver(tcp_socket_t *socket, tcp_receive_t receive, void *arg);
+
+result_t send_tcp(tcp_socket_t *socket,
+                  const void *data,
+                  const size_t len,
+                  const bool copy,
+                  size_t *written);
+
+bool tcp_acknowledged(const tcp_socket_t *socket, const uint64_t offset);
+
+result_t close_tcp(tcp_socket_t *socket);
+
+void service_tcp_timers();
+
+#endif
@@ -0,0 +1,188 @@
+#include "telemetry.h"
+
+#include "abort.h"
+#include "db.h"
+#include "network_stack.h"
+#include "profile.h"
+#include "sample_util.h"
+#include "system.h"
+#include "system_params.h"
+#include "time_util.h"
+#include "types.h"
+#include "uart.h"
+#include "udp.h"
+#include "lwip/memp.h"
+#include "lwip/stats.h"
+
+#include <string.h>
+
+/**
+ * Transmits a health and throughput report.
+ *
+ * @param socket The connected socket to send the report over.
+ * @param pings The ping acquisition counters.
+ * @param dma The DMA engine used for acquisition.
+ * @param watchdog The watchdog that supervises the main loop, or NULL.
+ * @param health The monitor of the hydrophone channels, or NULL.
+ * @param adc_test The result of the ADC self test at boot, or NULL.
+ * @param governor The load governor of the main loop, or NULL.
+ * @param xadc The system monitor to read the FPGA temperature from, or NULL.
+ *
+ * @return Success or fail.
+ */
+result_t send_telemetry(udp_socket_t *socket,
+                        const ping_stats_t *pings,
+                        const dma_engine_t *dma,
+                        const watchdog_t *watchdog,
+                        const channel_health_t *health,
+                        const adc_self_test_t *adc_test,
+                        const load_governor_t *governor,
+                        xsystem_monitor_t *xadc)
+{
+    AbortIfNot(socket, fail);
+    AbortIfNot(pings, fail);
+    AbortIfNot(dma, fail);
+
+    static uint32_t sequence = 0;
+    static tick_t previous_time = 0;
+    static tick_t previous_idle = 0;
+
+    telemetry_report_t report;
+    memset(&report, 0, sizeof(report));
+    report.version = TELEMETRY_REPORT_VERSION;
+    report.length = sizeof(report);
+    report.sequence = sequence++;
+    const tick_t now = get_system_time();
+    report.uptime_us = ticks_to_micros(now);
+
+    const tick_t idle = get_idle_time();
+    report.idle_us = ticks_to_micros(idle);
+    if (now > previous_time)
+    {
+        report.idle_percent = 100.0f * (idle - previous_idle) / (now - previous_time);
+    }
+    previous_time = now;
+    previous_idle = idle;
+
+    sample_stats_t samples;
+    get_sample_stats(&samples);
+    report.samples_captured = samples.samples_captured;
+    report.short_packets = samples.short_packets;
+    report.dma_errors = dma->errors;
+    report.adc_samples = samples.adc_samples;
+    report.fifo_dropped_samples = samples.dropped_samples;
+    report.overrun_captures = samples.overrun_captures;
+
+    report.sync_attempts = pings->sync_attempts;
+    report.pings_found = pings->pings_found;
+    report.pings_missed = pings->pings_missed;
+    report.pings_rejected = pings->pings_rejected;
+
+    report.trigger_count = pings->trigger.count;
+    report.trigger_sample = pings->trigger.sample;
+    report.trigger_timestamp_us = ticks_to_micros(pings->trigger.tick);
+    report.trigger_timeouts = pings->trigger_timeouts;
+    report.pings_excluded = pings->pings_excluded;
+
+    if (health)
+    {
+        for (size_t k = 0; k < 4; ++k)
+        {
+            report.channel_flags[k] = health->flags[k];
+            report.channel_faults[k] = health->faults[k];
+            report.channel_rms[k] = health->latest.rms[k];
+            report.channel_offset[k] = health->latest.offset[k];
+            report.channel_clipped[k] = health->latest.clipped_samples[k];
+        }
+    }
+
+    if (adc_test)
+    {
+        report.adc_test_flags = adc_test->flags;
+        report.adc_test_clk_div = adc_test->clk_div;
+        report.adc_test_expected_hz = adc_test->expected_hz;
+        report.adc_test_measured_hz = adc_test->measured_hz;
+        report.adc_test_capture_hz = adc_test->capture_hz;
+        report.adc_test_samples = adc_test->samples;
+        report.adc_test_pattern_errors = adc_test->pattern_errors;
+        report.adc_test_discontinuities = adc_test->discontinuities;
+        report.adc_test_dropped_samples = adc_test->dropped_samples;
+    }
+
+    if (governor)
+    {
+        report.shed_level = governor->level;
+        report.shed_count = governor->sheds;
+        report.restore_count = governor->restores;
+        report.ping_cost_us = ticks_to_micros(governor->cost);
+        report.ping_budget_us = ticks_to_micros(governor->budget);
+    }
+
+    network_link_t link;
+    get_network_link(&link);
+    report.link_flags = ((link.up)? NETWORK_LINK_UP : 0) |
+                        ((link.full_duplex)? NETWORK_LINK_FULL_DUPLEX : 0) |
+                        ((link.phy_found)? NETWORK_LINK_PHY_FOUND : 0);
+    report.link_speed_mbps = (uint16_t)link.speed_mbps;
+    report.link_changes = link.changes;
+    report.transmit_rate_bytes_per_second = get_transmit_rate();
+
+    for (size_t i = 0; i < PROFILE_STAGES; ++i)
+    {
+        profile_stats_t stage;
+        get_profile_stats((profile_stage_t)i, &stage);
+        if (stage.count)
+        {
+            report.stage_mean_us[i] = stage.cycles / stage.count * 1000000 / ARM_CLK_PLL;
+        }
+        report.stage_max_us[i] = (uint64_t)stage.max_cycles * 1000000 / ARM_CLK_PLL;
+    }
+
+    report.pbuf_pool_used = lwip_stats.memp[MEMP_PBUF_POOL].used;
+    report.pbuf_pool_max = lwip_stats.memp[MEMP_PBUF_POOL].max;
+    report.pbuf_pool_errors = lwip_stats.memp[MEMP_PBUF_POOL].err;
+    report.heap_used = lwip_stats.mem.used;
+    report.heap_max = lwip_stats.mem.max;
+    report.heap_errors = lwip_stats.mem.err;
+
+    udp_pool_stats_t pools;
+    get_udp_pool_stats(&pools);
+    report.tx_pool_used = pools.tx_used;
+    report.tx_pool_max = pools.tx_max;
+    report.tx_pool_misses = pools.tx_misses;
+    report.ref_pool_used = pools.ref_used;
+    report.ref_pool_max = pools.ref_max;
+
+    backpressure_stats_t backpressure;
+    get_backpressure_stats(&backpressure);
+    memcpy(report.stream_dropped, backpressure.dropped, sizeof(report.stream_dropped));
+    report.results_deferred = backpressure.results_deferred;
+    report.results_retried = backpressure.results_retried;
+    report.results_pending = backpressure.results_pending;
+    report.results_lost = backpressure.results_lost;
+
+    report.udp_send_failures = get_udp_send_failures();
+    report.log_dropped = get_log_dropped();
+    report.uart_dropped = get_uart_dropped();
+
+    if (watchdog)
+    {
+        for (size_t i = 0; i < DEADLINE_STAGES; ++i)
+        {
+            report.deadline_overruns[i] = watchdog->deadlines[i].overruns;
+            report.deadline_max_overrun_us[i] = ticks_to_micros(watchdog->deadlines[i].max_overrun);
+        }
+        report.watchdog_reset = watchdog->caused_reset;
+    }
+
+    if (xadc)
+    {
+        float temperature = 0;
+        AbortIfNot(read_fpga_temperature(xadc, &temperature), fail);
+        report.fpga_temperature_c = temperature;
+    }
+
+    AbortIfNot(send_udp(socket, (char *)&report, sizeof(report)), fail);
+
+    return success;
+}
@@ -0,0 +1,211 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "adc_self_test.h"
+#include "channel_health.h"
+#include "dma.h"
+#include "load_governor.h"
+#include "profile.h"
+#include "transmission_util.h"
+#include "types.h"
+#include "udp.h"
+#include "watchdog.h"
+#include "xsystem_monitor.h"
+
+/**
+ * The version of the telemetry report layout.
+ */
+#define TELEMETRY_REPORT_VERSION 12
+
+/**
+ * Defines the ping acquisition counters kept by the application.
+ */
+typedef struct ping_stats_t
+{
+    uint32_t sync_attempts;
+    uint32_t pings_found;
+    uint32_t pings_missed;
+
+    /*
+     * The located pings that failed the quality gate.
+     */
+    uint32_t pings_rejected;
+
+    /*
+     * The located pings that were not correlated because a channel was
+     * flagged as unhealthy.
+     */
+    uint32_t pings_excluded;
+
+    /*
+     * The captures that waited in vain for an edge of the external trigger
+     * input, and the latest edge.
+     */
+    uint32_t trigger_timeouts;
+    trigger_mark_t trigger;
+} ping_stats_t;
+
+/**
+ * Defines the health and throughput report sent over the telemetry port.
+ */
+typedef struct __attribute__((packed)) telemetry_report_t
+{
+    uint16_t version;
+
+    /*
+     * The size of the report in bytes.
+     */
+    uint16_t length;
+
+    uint32_t sequence;
+    uint64_t uptime_us;
+
+    uint64_t samples_captured;
+    uint32_t short_packets;
+    uint32_t dma_errors;
+
+    uint32_t sync_attempts;
+    uint32_t pings_found;
+    uint32_t pings_missed;
+    uint32_t pings_rejected;
+
+    /*
+     * The mean and worst case duration of each profile_stage_t.
+     */
+    uint32_t stage_mean_us[PROFILE_STAGES];
+    uint32_t stage_max_us[PROFILE_STAGES];
+
+    /*
+     * Usage of the lwIP packet buffer pool and heap.
+     */
+    uint32_t pbuf_pool_used;
+    uint32_t pbuf_pool_max;
+    uint32_t pbuf_pool_errors;
+    uint32_t heap_used;
+    uint32_t heap_max;
+    uint32_t heap_errors;
+
+    /*
+     * Usage of the preallocated pools of transmitted datagrams, and the
+     * copied datagrams that fell back to the heap.
+     */
+    uint32_t tx_pool_used;
+    uint32_t tx_pool_max;
+    uint32_t tx_pool_misses;
+    uint32_t ref_pool_used;
+    uint32_t ref_pool_max;
+
+    /*
+     * Output that was dropped.
+     */
+    uint32_t udp_send_failures;
+    uint32_t log_dropped;
+    uint32_t uart_dropped;
+
+    float fpga_temperature_c;
+
+    /*
+     * The number of times each deadline_stage_t finished late and its worst
+     * overrun, and whether the last reset was caused by the watchdog.
+     */
+    uint32_t deadline_overruns[DEADLINE_STAGES];
+    uint32_t deadline_max_overrun_us[DEADLINE_STAGES];
+    uint32_t watchdog_reset;
+
+    /*
+     * The samples produced by the ADC, the samples the FPGA lost to a full
+     * FIFO during captures, and the captures that lost any.
+     */
+    uint64_t adc_samples;
+    uint64_t fifo_dropped_samples;
+    uint32_t overrun_captures;
+
+    /*
+     * The time the main core has slept waiting for interrupts, and the
+     * percentage of the time since the previous report that it slept.
+     */
+    uint64_t idle_us;
+    float idle_percent;
+
+    /*
+     * The transfers of each stream_class_t dropped under backpressure, and
+     * the results deferred, resent, waiting and lost.
+     */
+    uint32_t stream_dropped[STREAM_CLASSES];
+    uint32_t results_deferred;
+    uint32_t results_retried;
+    uint32_t results_pending;
+    uint32_t results_lost;
+
+    /*
+     * The edges of the external trigger input since boot, the latest as its
+     * stream timestamp and its time in microseconds since boot, and the
+     * captures that waited for an edge in vain.
+     */
+    uint32_t trigger_count;
+    uint64_t trigger_sample;
+    uint64_t trigger_timestamp_us;
+    uint32_t trigger_timeouts;
+
+    /*
+     * The faults that each channel is flagged with, the times it has been
+     * flagged since boot, its RMS and offset in ADC counts and its samples
+     * at either rail in the latest capture, and the located pings that were
+     * not correlated because a channel was flagged.
+     */
+    uint8_t channel_flags[4];
+    uint32_t channel_faults[4];
+    float channel_rms[4];
+    int16_t channel_offset[4];
+    uint32_t channel_clipped[4];
+    uint32_t pings_excluded;
+
+    /*
+     * The result of the ADC test pattern self test at boot: its flags, which
+     * are zero if it did not run, the clock divider tested, the rate that it
+     * sets, the rates measured from the stream counters and from the
+     * capture, and the samples checked, the samples that differed from the
+     * pattern, the breaks in their sequence and the samples lost to the FIFO.
+     */
+    uint8_t adc_test_flags;
+    uint32_t adc_test_clk_div;
+    uint32_t adc_test_expected_hz;
+    uint32_t adc_test_measured_hz;
+    uint32_t adc_test_capture_hz;
+    uint32_t adc_test_samples;
+    uint32_t adc_test_pattern_errors;
+    uint32_t adc_test_discontinuities;
+    uint32_t adc_test_dropped_samples;
+
+    /*
+     * The features shed by the load governor as a shed_level_t, the times a
+     * feature was shed and restored, and the cost of the latest ping against
+     * the share of the ping period that it may take.
+     */
+    uint8_t shed_level;
+    uint32_t shed_count;
+    uint32_t restore_count;
+    uint32_t ping_cost_us;
+    uint32_t ping_budget_us;
+
+    /*
+     * The state of the Ethernet link as NETWORK_LINK flags, its speed, the
+     * times it went down or renegotiated, and the rate limit of the streams
+     * that follows from it.
+     */
+    uint8_t link_flags;
+    uint16_t link_speed_mbps;
+    uint32_t link_changes;
+    uint32_t transmit_rate_bytes_per_second;
+} telemetry_report_t;
+
+result_t send_telemetry(udp_socket_t *socket,
+                        const ping_stats_t *pings,
+                        const dma_engine_t *dma,
+                        const watchdog_t *watchdog,
+                        const channel_health_t *health,
+                        const adc_self_test_t *adc_test,
+                        const load_governor_t *governor,
+                        xsystem_monitor_t *xadc);
+
+#endif
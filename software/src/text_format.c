@@ -0,0 +1,663 @@
+#include "text_format.h"
+
+#include "abort.h"
+#include "types.h"
+
+#include <stdarg.h>
+
+/**
+ * The most digits after the point of a formatted floating point value.
+ */
+#define MAX_FRACTION_DIGITS 9
+
+/**
+ * Defines a conversion of a format, such as "%-08.3lu".
+ */
+typedef struct conversion_t
+{
+    bool left;
+    bool zero;
+    bool plus;
+    bool space;
+    size_t width;
+
+    /*
+     * The precision, or negative if none was given.
+     */
+    int32_t precision;
+
+    /*
+     * The length modifier: 'h' and 'H' for short and char, 'l' and 'L' for
+     * long and long long, 'z' for size_t, or zero for int.
+     */
+    char length;
+    char type;
+} conversion_t;
+
+/**
+ * Defines the string being formatted into, which holds as much of the output
+ * as fits and is always terminated.
+ */
+typedef struct text_writer_t
+{
+    char *str;
+    size_t size;
+    size_t len;
+} text_writer_t;
+
+/**
+ * Parses a conversion of a format after its '%'.
+ *
+ * @param fmt The conversion.
+ * @param[out] conversion The parsed conversion.
+ *
+ * @return The character after the conversion.
+ */
+static const char *parse_conversion(const char *fmt, conversion_t *conversion)
+{
+    conversion->left = false;
+    conversion->zero = false;
+    conversion->plus = false;
+    conversion->space = false;
+    conversion->width = 0;
+    conversion->precision = -1;
+    conversion->length = 0;
+
+    for (;; ++fmt)
+    {
+        if (*fmt == '-')
+        {
+            conversion->left = true;
+        }
+        else if (*fmt == '0')
+        {
+            conversion->zero = true;
+        }
+        else if (*fmt == '+')
+        {
+            conversion->plus = true;
+        }
+        else if (*fmt == ' ')
+        {
+            conversion->space = true;
+        }
+        else if (*fmt != '#')
+        {
+            break;
+        }
+    }
+
+    while (*fmt >= '0' && *fmt <= '9')
+    {
+        conversion->width = conversion->width * 10 + (*fmt++ - '0');
+    }
+
+    if (*fmt == '.')
+    {
+        fmt++;
+        conversion->precision = 0;
+        while (*fmt >= '0' && *fmt <= '9')
+        {
+            conversion->precision = conversion->precision * 10 + (*fmt++ - '0');
+        }
+    }
+
+    if (*fmt == 'h')
+    {
+        fmt++;
+        conversion->length = (*fmt == 'h')? (fmt++, 'H') : 'h';
+    }
+    else if (*fmt == 'l')
+    {
+        fmt++;
+        conversion->length = (*fmt == 'l')? (fmt++, 'L') : 'l';
+    }
+    else if (*fmt == 'z' || *fmt == 'j' || *fmt == 't')
+    {
+        conversion->length = (*fmt == 'j')? 'L' : 'z';
+        fmt++;
+    }
+
+    conversion->type = *fmt;
+    if (*fmt)
+    {
+        fmt++;
+    }
+
+    return fmt;
+}
+
+/**
+ * Reads the argument of a signed integer conversion.
+ *
+ * @param conversion The conversion.
+ * @param args The arguments of the format.
+ *
+ * @return The argument.
+ */
+static int64_t signed_argument(const conversion_t *conversion, va_list *args)
+{
+    switch (conversion->length)
+    {
+        case 'L':
+            return va_arg(*args, long long);
+        case 'l':
+            return va_arg(*args, long);
+        case 'z':
+            return (ptrdiff_t)va_arg(*args, size_t);
+        case 'h':
+            return (short)va_arg(*args, int);
+        case 'H':
+            return (signed char)va_arg(*args, int);
+        default:
+            return va_arg(*args, int);
+    }
+}
+
+/**
+ * Reads the argument of an unsigned integer conversion.
+ *
+ * @param conversion The conversion.
+ * @param args The arguments of the format.
+ *
+ * @return The argument.
+ */
+static uint64_t unsigned_argument(const conversion_t *conversion, va_list *args)
+{
+    switch (conversion->length)
+    {
+        case 'L':
+            return va_arg(*args, unsigned long long);
+        case 'l':
+            return va_arg(*args, unsigned long);
+        case 'z':
+            return va_arg(*args, size_t);
+        case 'h':
+            return (unsigned short)va_arg(*args, unsigned int);
+        case 'H':
+            return (unsigned char)va_arg(*args, unsigned int);
+        default:
+            return va_arg(*args, unsigned int);
+    }
+}
+
+/**
+ * Adds a character to the output, if it fits with the terminator.
+ *
+ * @param writer The output.
+ * @param c The character.
+ *
+ * @return None.
+ */
+static void put_char(text_writer_t *writer, const char c)
+{
+    if (writer->len + 1 < writer->size)
+    {
+        writer->str[writer->len++] = c;
+    }
+}
+
+/**
+ * Adds a character to the output a number of times.
+ *
+ * @param writer The output.
+ * @param c The character.
+ * @param count The number of times.
+ *
+ * @return None.
+ */
+static void put_repeated(text_writer_t *writer, const char c, const size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        put_char(writer, c);
+    }
+}
+
+/**
+ * Adds a field to the output, padded to the width of its conversion.
+ *
+ * @param writer The output.
+ * @param conversion The conversion.
+ * @param prefix The sign or radix prefix, which precedes zero padding.
+ * @param zeros The leading zeros of the digits.
+ * @param body The field.
+ * @param len The length of the field.
+ *
+ * @return None.
+ */
+static void put_field(text_writer_t *writer,
+                      const conversion_t *conversion,
+                      const char *prefix,
+                      const size_t zeros,
+                      const char *body,
+                      const size_t len)
+{
+    size_t prefix_len = 0;
+    while (prefix[prefix_len])
+    {
+        prefix_len++;
+    }
+
+    const size_t used = prefix_len + zeros + len;
+    const size_t padding = (conversion->width > used)? conversion->width - used : 0;
+    const bool zero_pad = (conversion->zero && !conversion->left)? true : false;
+
+    if (!conversion->left && !zero_pad)
+    {
+        put_repeated(writer, ' ', padding);
+    }
+
+    for (size_t i = 0; i < prefix_len; ++i)
+    {
+        put_char(writer, prefix[i]);
+    }
+
+    put_repeated(writer, '0', zeros + ((zero_pad)? padding : 0));
+    for (size_t i = 0; i < len; ++i)
+    {
+        put_char(writer, body[i]);
+    }
+
+    if (conversion->left)
+    {
+        put_repeated(writer, ' ', padding);
+    }
+}
+
+/**
+ * Writes the digits of an integer in a radix.
+ *
+ * @param value The integer.
+ * @param radix Ten or sixteen.
+ * @param upper Specified true for upper case hexadecimal digits.
+ * @param[out] digits The digits, which hold at least 20 characters.
+ *
+ * @return The number of digits.
+ */
+static size_t integer_digits(uint64_t value, const uint32_t radix, const bool upper, char *digits)
+{
+    const char *symbols = (upper)? "0123456789ABCDEF" : "0123456789abcdef";
+    char reversed[20];
+    size_t len = 0;
+    do
+    {
+        reversed[len++] = symbols[value % radix];
+        value /= radix;
+    } while (value);
+
+    for (size_t i = 0; i < len; ++i)
+    {
+        digits[i] = reversed[len - 1 - i];
+    }
+
+    return len;
+}
+
+/**
+ * Finds the sign prefix of a signed conversion.
+ *
+ * @param conversion The conversion.
+ * @param negative Specified true if the value is negative.
+ *
+ * @return The prefix.
+ */
+static const char *sign_prefix(const conversion_t *conversion, const bool negative)
+{
+    return (negative)? "-" : (conversion->plus)? "+" : (conversion->space)? " " : "";
+}
+
+/**
+ * Adds an integer conversion to the output.
+ *
+ * @param writer The output.
+ * @param conversion The conversion.
+ * @param magnitude The magnitude of the value.
+ * @param prefix The sign or radix prefix.
+ *
+ * @return None.
+ */
+static void put_integer(text_writer_t *writer,
+                        const conversion_t *conversion,
+                        const uint64_t magnitude,
+                        const char *prefix)
+{
+    const uint32_t radix = (conversion->type == 'x' || conversion->type == 'X' ||
+                            conversion->type == 'p')? 16 : 10;
+    char digits[20];
+    size_t len = integer_digits(magnitude, radix, (conversion->type == 'X')? true : false, digits);
+
+    /*
+     * A precision sets the least number of digits, and a zero precision
+     * prints nothing for zero.
+     */
+    size_t zeros = 0;
+    if (conversion->precision >= 0)
+    {
+        if (conversion->precision == 0 && magnitude == 0)
+        {
+            len = 0;
+        }
+        else if ((size_t)conversion->precision > len)
+        {
+            zeros = conversion->precision - len;
+        }
+    }
+
+    conversion_t padded = *conversion;
+    padded.zero = (conversion->precision < 0)? conversion->zero : false;
+    put_field(writer, &padded, prefix, zeros, digits, len);
+}
+
+/**
+ * Adds a floating point conversion to the output as a fixed point value. The
+ * whole and fractional parts are converted to integers, which is much
+ * cheaper than exact decimal conversion and exact to the precision for the
+ * values that are logged.
+ *
+ * @param writer The output.
+ * @param conversion The conversion, whose precision is at most nine digits.
+ * @param value The value.
+ *
+ * @return None.
+ */
+static void put_fixed(text_writer_t *writer, const conversion_t *conversion, const double value)
+{
+    const bool negative = (value < 0)? true : false;
+    const double magnitude = (negative)? -value : value;
+    const char *prefix = sign_prefix(conversion, negative);
+
+    if (magnitude != magnitude || magnitude >= 18446744073709551616.0)
+    {
+        conversion_t unpadded = *conversion;
+        unpadded.zero = false;
+        put_field(writer, &unpadded, prefix, 0, (magnitude != magnitude)? "nan" : "inf", 3);
+        return;
+    }
+
+    const int32_t precision = (conversion->precision < 0)? 6 :
+                              (conversion->precision > MAX_FRACTION_DIGITS)? MAX_FRACTION_DIGITS :
+                              conversion->precision;
+    uint64_t scale = 1;
+    for (int32_t i = 0; i < precision; ++i)
+    {
+        scale *= 10;
+    }
+
+    uint64_t whole = (uint64_t)magnitude;
+    uint64_t fraction = (uint64_t)((magnitude - whole) * scale + 0.5);
+    if (fraction >= scale)
+    {
+        whole++;
+        fraction -= scale;
+    }
+
+    char body[20 + 1 + MAX_FRACTION_DIGITS];
+    size_t len = integer_digits(whole, 10, false, body);
+    if (precision > 0)
+    {
+        body[len++] = '.';
+        for (int32_t i = precision - 1; i >= 0; --i)
+        {
+            body[len + i] = '0' + fraction % 10;
+            fraction /= 10;
+        }
+        len += precision;
+    }
+
+    put_field(writer, conversion, prefix, 0, body, len);
+}
+
+/**
+ * Formats a string into a buffer, without allocating and without writing
+ * past its end. The conversions %d, %i, %u, %x, %X, %c, %s, %p, %% and %f,
+ * with flags, widths, precisions and length modifiers, are formatted as
+ * printf() would, except that %e and %g are formatted as %f and at most nine
+ * digits follow the point.
+ *
+ * @param[out] str The buffer.
+ * @param size The size of the buffer.
+ * @param fmt The format.
+ *
+ * @return The length of the formatted string, which is truncated to fit the
+ *         buffer with its terminator.
+ */
+size_t format_text(char *str, const size_t size, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    const size_t len = vformat_text(str, size, fmt, args);
+    va_end(args);
+
+    return len;
+}
+
+/**
+ * Formats a string into a buffer, as format_text() does, from a list of
+ * arguments.
+ *
+ * @param[out] str The buffer.
+ * @param size The size of the buffer.
+ * @param fmt The format.
+ * @param args The arguments of the format.
+ *
+ * @return The length of the formatted string.
+ */
+size_t vformat_text(char *str, const size_t size, const char *fmt, va_list args)
+{
+    text_writer_t writer;
+    writer.str = str;
+    writer.size = size;
+    writer.len = 0;
+    if (!str || !size)
+    {
+        return 0;
+    }
+
+    va_list ap;
+    va_copy(ap, args);
+    while (*fmt)
+    {
+        if (*fmt != '%')
+        {
+            put_char(&writer, *fmt++);
+            continue;
+        }
+
+        conversion_t conversion;
+        fmt = parse_conversion(fmt + 1, &conversion);
+        switch (conversion.type)
+        {
+            case 'd':
+            case 'i':
+            {
+                const int64_t value = signed_argument(&conversion, &ap);
+                const uint64_t magnitude = (value < 0)? -(uint64_t)value : (uint64_t)value;
+                put_integer(&writer, &conversion, magnitude, sign_prefix(&conversion, (value < 0)? true : false));
+                break;
+            }
+            case 'u':
+            case 'x':
+            case 'X':
+                put_integer(&writer, &conversion, unsigned_argument(&conversion, &ap), "");
+                break;
+            case 'p':
+                put_integer(&writer, &conversion, (uintptr_t)va_arg(ap, void *), "0x");
+                break;
+            case 'c':
+            {
+                const char c = (char)va_arg(ap, int);
+                put_field(&writer, &conversion, "", 0, &c, 1);
+                break;
+            }
+            case 's':
+            {
+                const char *s = va_arg(ap, const char *);
+                if (!s)
+                {
+                    s = "(null)";
+                }
+
+                size_t len = 0;
+                while (s[len] && (conversion.precision < 0 || len < (size_t)conversion.precision))
+                {
+                    len++;
+                }
+
+                conversion.zero = false;
+                put_field(&writer, &conversion, "", 0, s, len);
+                break;
+            }
+            case 'f':
+            case 'F':
+            case 'e':
+            case 'E':
+            case 'g':
+            case 'G':
+                put_fixed(&writer, &conversion, va_arg(ap, double));
+                break;
+            case '%':
+                put_char(&writer, '%');
+                break;
+            case '\0':
+                break;
+            default:
+                put_char(&writer, '%');
+                put_char(&writer, conversion.type);
+                break;
+        }
+    }
+    va_end(ap);
+
+    str[writer.len] = 0;
+
+    return writer.len;
+}
+
+/**
+ * Adds bytes to an encoded argument list, if they fit.
+ *
+ * @param record The encoded arguments.
+ * @param size The size of the encoding.
+ * @param len The bytes used so far, which is advanced.
+ * @param value The little endian value.
+ * @param bytes The number of bytes of the value.
+ *
+ * @return Success or fail.
+ */
+static result_t put_bytes(uint8_t *record, const size_t size, size_t *len, uint64_t value, const size_t bytes)
+{
+    if (*len + bytes > size)
+    {
+        return fail;
+    }
+
+    for (size_t i = 0; i < bytes; ++i)
+    {
+        record[(*len)++] = value & 0xFF;
+        value >>= 8;
+    }
+
+    return success;
+}
+
+/**
+ * Encodes the arguments of a format, so that it can be formatted later from
+ * the format and the encoding. Each argument is encoded little endian in the
+ * order of the format: double and long long arguments in eight bytes,
+ * strings as their characters and a terminator, and every other argument in
+ * four bytes.
+ *
+ * @param[out] record The encoded arguments.
+ * @param size The size of the encoding.
+ * @param fmt The format.
+ * @param args The arguments of the format.
+ * @param[out] encoded The number of bytes encoded.
+ *
+ * @return Success, or fail if the arguments do not fit.
+ */
+result_t vencode_format_args(uint8_t *record,
+                             const size_t size,
+                             const char *fmt,
+                             va_list args,
+                             size_t *encoded)
+{
+    AbortIfNot(record, fail);
+    AbortIfNot(encoded, fail);
+
+    size_t len = 0;
+    va_list ap;
+    va_copy(ap, args);
+    result_t fits = success;
+    while (*fmt && fits)
+    {
+        if (*fmt++ != '%')
+        {
+            continue;
+        }
+
+        conversion_t conversion;
+        fmt = parse_conversion(fmt, &conversion);
+        switch (conversion.type)
+        {
+            case 'd':
+            case 'i':
+                fits = put_bytes(record, size, &len, signed_argument(&conversion, &ap),
+                                 (conversion.length == 'L')? 8 : 4);
+                break;
+            case 'u':
+            case 'x':
+            case 'X':
+                fits = put_bytes(record, size, &len, unsigned_argument(&conversion, &ap),
+                                 (conversion.length == 'L')? 8 : 4);
+                break;
+            case 'p':
+                fits = put_bytes(record, size, &len, (uintptr_t)va_arg(ap, void *), 4);
+                break;
+            case 'c':
+                fits = put_bytes(record, size, &len, (uint32_t)va_arg(ap, int), 4);
+                break;
+            case 's':
+            {
+                const char *s = va_arg(ap, const char *);
+                if (!s)
+                {
+                    s = "(null)";
+                }
+
+                for (size_t i = 0; fits && s[i] && (conversion.precision < 0 || i < (size_t)conversion.precision); ++i)
+                {
+                    fits = put_bytes(record, size, &len, (uint8_t)s[i], 1);
+                }
+                if (fits)
+                {
+                    fits = put_bytes(record, size, &len, 0, 1);
+                }
+                break;
+            }
+            case 'f':
+            case 'F':
+            case 'e':
+            case 'E':
+            case 'g':
+            case 'G':
+            {
+                union
+                {
+                    double value;
+                    uint64_t bits;
+                } u;
+                u.value = va_arg(ap, double);
+                fits = put_bytes(record, size, &len, u.bits, 8);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    va_end(ap);
+
+    *encoded = len;
+
+    return fits;
+}
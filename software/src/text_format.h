@@ -0,0 +1,18 @@
+#ifndef TEXT_FORMAT_H
+#define TEXT_FORMAT_H
+
+#include "types.h"
+
+#include <stdarg.h>
+
+size_t format_text(char *str, const size_t size, const char *fmt, ...);
+
+size_t vformat_text(char *str, const size_t size, const char *fmt, va_list args);
+
+result_t vencode_format_args(uint8_t *record,
+                             const size_t size,
+                             const char *fmt,
+                             va_list args,
+                             size_t *encoded);
+
+#endif
@@ -1,20 +1,48 @@
 #include "time_util.h"
 
+#include "sample_clock.h"
 #include "system.h"
 
+/**
+ * The exact conversions between system ticks and milliseconds, microseconds
+ * and nanoseconds. The tick rate is not a whole number of ticks per
+ * microsecond, so a truncated divisor would drift.
+ */
+static const clock_ratio_t ticks_per_ms = CLOCK_RATIO(CPU_CLOCK_HZ, 1000);
+static const clock_ratio_t ms_per_tick = CLOCK_RATIO(1000, CPU_CLOCK_HZ);
+static const clock_ratio_t ticks_per_us = CLOCK_RATIO(CPU_CLOCK_HZ, 1000000);
+static const clock_ratio_t us_per_tick = CLOCK_RATIO(1000000, CPU_CLOCK_HZ);
+static const clock_ratio_t ticks_per_ns = CLOCK_RATIO(CPU_CLOCK_HZ, 1000000000);
+static const clock_ratio_t ns_per_tick = CLOCK_RATIO(1000000000, CPU_CLOCK_HZ);
+
 tick_t ms_to_ticks(uint32_t milliseconds)
 {
-    return (CPU_CLOCK_HZ / 1000 * milliseconds);
+    return scale_clock(&ticks_per_ms, milliseconds);
 }
 
 uint32_t ticks_to_ms(tick_t ticks)
 {
-    return 1000 * ticks_to_seconds(ticks);
+    return scale_clock(&ms_per_tick, ticks);
 }
 
 tick_t micros_to_ticks(uint32_t microseconds)
 {
-    return (CPU_CLOCK_HZ / 1000000 * microseconds);
+    return scale_clock(&ticks_per_us, microseconds);
+}
+
+uint64_t ticks_to_micros(tick_t ticks)
+{
+    return scale_clock(&us_per_tick, ticks);
+}
+
+tick_t ns_to_ticks(uint64_t ns)
+{
+    return scale_clock(&ticks_per_ns, ns);
+}
+
+uint64_t ticks_to_ns(tick_t ticks)
+{
+    return scale_clock(&ns_per_tick, ticks);
 }
 
 float ticks_to_seconds(tick_t ticks)
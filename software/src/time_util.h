@@ -10,6 +10,12 @@ tick_t micros_to_ticks(uint32_t microseconds);
 
 uint32_t ticks_to_ms(tick_t ticks);
 
+uint64_t ticks_to_micros(tick_t ticks);
+
+tick_t ns_to_ticks(uint64_t ns);
+
+uint64_t ticks_to_ns(tick_t ticks);
+
 float ticks_to_seconds(tick_t ticks);
 
 void busywait(tick_t wait);
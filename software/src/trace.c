@@ -0,0 +1,134 @@
+#include "trace.h"
+#include "regs/system_registers.h"
+
+#include "abort.h"
+#include "cycle_counter.h"
+#include "l2_lockdown.h"
+#include "system.h"
+#include "system_params.h"
+#include "time_util.h"
+#include "types.h"
+#include "udp.h"
+
+#include <string.h>
+
+_Static_assert((TRACE_DEPTH & (TRACE_DEPTH - 1)) == 0, "The trace depth must be a power of two.");
+
+/**
+ * The ring of events and the number of events recorded since the trace was
+ * started, of which the last TRACE_DEPTH are held.
+ */
+static trace_event_t trace_events[TRACE_DEPTH];
+static volatile uint32_t trace_next = 0;
+static volatile bool trace_enabled = false;
+
+/**
+ * Records an event if tracing is enabled.
+ *
+ * @note This may be called from either core and from interrupt context. Each
+ *       caller claims its own slot of the ring, so no lock is taken.
+ *
+ * @param id The event.
+ * @param phase The phase of the event.
+ * @param arg0 The first argument of the event.
+ * @param arg1 The second argument of the event.
+ *
+ * @return None.
+ */
+HOT_CODE
+void trace(const trace_event_id_t id, const trace_phase_t phase, const uint32_t arg0, const uint32_t arg1)
+{
+    if (!trace_enabled)
+    {
+        return;
+    }
+
+    const uint32_t index = __atomic_fetch_add(&trace_next, 1, __ATOMIC_RELAXED);
+    trace_event_t *event = &trace_events[index & (TRACE_DEPTH - 1)];
+    event->timestamp = global_timer_regs->Counter_Register[0];
+    event->id = id;
+    event->phase = phase;
+    event->cpu = get_cpu_id();
+    event->arg[0] = arg0;
+    event->arg[1] = arg1;
+}
+
+/**
+ * Discards the events held and starts tracing.
+ *
+ * @return None.
+ */
+void start_trace()
+{
+    trace_enabled = false;
+    data_memory_barrier();
+    trace_next = 0;
+    data_memory_barrier();
+    trace_enabled = true;
+}
+
+/**
+ * Stops tracing, keeping the events held.
+ *
+ * @note An event being recorded by the other core as tracing stops may not
+ *       have been written completely.
+ *
+ * @return None.
+ */
+void stop_trace()
+{
+    trace_enabled = false;
+    data_memory_barrier();
+}
+
+/**
+ * Stops tracing and sends the events held, oldest first.
+ *
+ * @note The datagrams are paced so that the dump does not exhaust the
+ *       transmit buffers.
+ *
+ * @param socket The socket to send the dump on.
+ *
+ * @return Success or fail.
+ */
+result_t send_trace(udp_socket_t *socket)
+{
+    AbortIfNot(socket, fail);
+
+    stop_trace();
+
+    const uint32_t recorded = trace_next;
+    const uint32_t total = (recorded < TRACE_DEPTH)? recorded : TRACE_DEPTH;
+    const uint32_t oldest = recorded - total;
+
+    static struct __attribute__((packed))
+    {
+        trace_packet_header_t header;
+        trace_event_t events[TRACE_PACKET_EVENTS];
+    } packet;
+    packet.header.magic = TRACE_MAGIC;
+    packet.header.version = TRACE_REPORT_VERSION;
+    packet.header.timer_clock_hz = CPU_CLOCK_HZ;
+    packet.header.cycle_clock_hz = get_cycle_clock_hz();
+    packet.header.total = total;
+
+    uint32_t first = 0;
+    do
+    {
+        const uint32_t count = (total - first < TRACE_PACKET_EVENTS)? total - first : TRACE_PACKET_EVENTS;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            packet.events[i] = trace_events[(oldest + first + i) & (TRACE_DEPTH - 1)];
+        }
+
+        packet.header.num_events = count;
+        packet.header.first = first;
+        AbortIfNot(send_udp(socket,
+                            (char *)&packet,
+                            sizeof(packet.header) + count * sizeof(trace_event_t)), fail);
+        busywait(micros_to_ticks(TRACE_PACKET_INTERVAL_US));
+        first += count;
+    } while (first < total);
+
+    return success;
+}
@@ -0,0 +1,123 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "types.h"
+#include "udp.h"
+
+/**
+ * Identifies the datagrams of a trace dump on the telemetry port, and the
+ * version of their layout.
+ */
+#define TRACE_MAGIC 0x52545A48
+#define TRACE_REPORT_VERSION 1
+
+/**
+ * The number of events sent in each datagram of a trace dump.
+ */
+#define TRACE_PACKET_EVENTS 64
+
+/**
+ * The events that are traced.
+ */
+typedef enum trace_event_id_t
+{
+    /*
+     * A DMA interrupt. The arguments are the number of completions and the
+     * status register.
+     */
+    TRACE_DMA_COMPLETE = 0,
+    TRACE_DMA_ERROR = 1,
+
+    /*
+     * A profiled processing stage. The arguments are the stage and its
+     * duration in cycles of the core that ran it.
+     */
+    TRACE_STAGE = 2,
+
+    /*
+     * A dispatch of received frames into the network stack. The first
+     * argument of its end is the number of frames handled.
+     */
+    TRACE_NETWORK_DISPATCH = 3,
+
+    /*
+     * A datagram handed to the network stack, either copied or referencing
+     * its payload. The arguments are its length and whether it was sent.
+     */
+    TRACE_UDP_SEND = 4,
+    TRACE_UDP_SEND_REF = 5,
+
+    /*
+     * A request for the thrusters to be silenced. The arguments are the
+     * start of the silence relative to the request and its duration, in
+     * microseconds.
+     */
+    TRACE_SILENCE_REQUEST = 6,
+
+    /*
+     * A located ping. The argument is the sequence number of its result.
+     */
+    TRACE_PING = 7,
+
+    /*
+     * A segment of a copy started or completed on the DMA controller. The
+     * arguments are the channel and the length of the segment in bytes.
+     */
+    TRACE_COPY_START = 8,
+    TRACE_COPY_DONE = 9
+} trace_event_id_t;
+
+/**
+ * Defines whether an event marks a moment, the start or end of a span, or a
+ * whole span that ends at its timestamp.
+ */
+typedef enum trace_phase_t
+{
+    TRACE_INSTANT = 0,
+    TRACE_BEGIN = 1,
+    TRACE_END = 2,
+    TRACE_COMPLETE = 3
+} trace_phase_t;
+
+/**
+ * Defines an event of the trace. The timestamp is the low word of the global
+ * timer, which both cores share.
+ */
+typedef struct __attribute__((packed)) trace_event_t
+{
+    uint32_t timestamp;
+    uint16_t id;
+    uint8_t phase;
+    uint8_t cpu;
+    uint32_t arg[2];
+} trace_event_t;
+
+/**
+ * Defines the header of each datagram of a trace dump, which is followed by
+ * num_events events, oldest first.
+ */
+typedef struct __attribute__((packed)) trace_packet_header_t
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t num_events;
+    uint32_t timer_clock_hz;
+    uint32_t cycle_clock_hz;
+
+    /*
+     * The index of the first event of the datagram within the dump, and the
+     * number of events in the dump.
+     */
+    uint32_t first;
+    uint32_t total;
+} trace_packet_header_t;
+
+void trace(const trace_event_id_t id, const trace_phase_t phase, const uint32_t arg0, const uint32_t arg1);
+
+void start_trace();
+
+void stop_trace();
+
+result_t send_trace(udp_socket_t *socket);
+
+#endif
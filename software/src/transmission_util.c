@@ -1,157 +1,2234 @@
 #include "transmission_util.h"
 
+#include "message_batch.h"
 #include "network_stack.h"
+#include "sample_codec.h"
+#include "sample_ops.h"
+#include "sample_util.h"
 
 #include "types.h"
 #include "time_util.h"
 #include "abort.h"
+#include "db.h"
+#include "system.h"
+#include "system_params.h"
 #include "udp.h"
+#include "lwip/ip.h"
+#include "lwip/netif.h"
+#include "netif/etharp.h"
+#include "lwip/udp.h"
 
+#include <stdlib.h>
 #include <string.h>
 #include "inttypes.h"
 
 /**
- * Transmits a cross correlation result.
+ * The time to wait for the Ethernet driver to release descriptors or
+ * referenced memory.
+ */
+#define TRANSMIT_RELEASE_TIMEOUT_MS 100
+
+/**
+ * The number of free transmit descriptors required to queue a datagram. A
+ * fragmented datagram uses a descriptor for each pbuf of each fragment.
+ */
+#define TRANSMIT_MIN_FREE_DESCRIPTORS 8
+
+/**
+ * Defines a result waiting to be resent.
+ */
+typedef struct pending_result_t
+{
+    udp_socket_t *socket;
+    result_record_t record;
+} pending_result_t;
+
+/**
+ * The results waiting to be resent, oldest first. The number waiting is kept
+ * in the backpressure counters.
+ */
+static pending_result_t pending_results[RESULT_RETRY_DEPTH];
+static size_t pending_results_head = 0;
+
+/**
+ * The results waiting to share a datagram, which is bound to the socket of
+ * the first result sent, and the longest that a result waits.
+ */
+static message_batch_t result_batch;
+static bool result_batch_ready = false;
+static uint32_t result_batch_delay_ms = INITIAL_RESULT_BATCH_DELAY_MS;
+
+/**
+ * The outcome of sends made while the link could not keep up.
+ */
+static backpressure_stats_t backpressure_stats = {0};
+
+/**
+ * Specified true when a send failed because the Ethernet driver did not
+ * release descriptors or memory in time, rather than because of a fault.
+ */
+static bool transmit_congested = false;
+
+/**
+ * The names of the stream classes, for the log.
+ */
+static const char *stream_class_names[STREAM_CLASSES] = {
+    "results",
+    "samples",
+    "correlations",
+    "preview"
+};
+
+/**
+ * Resends the waiting results, oldest first, until one cannot be sent.
+ *
+ * @note This runs as a result transmit task, so results go out as soon as
+ *       the link recovers.
+ *
+ * @return Success.
+ */
+result_t service_result_retries()
+{
+    while (backpressure_stats.results_pending)
+    {
+        if (get_free_tx_descriptors() < TRANSMIT_MIN_FREE_DESCRIPTORS)
+        {
+            return success;
+        }
+
+        pending_result_t *pending = &pending_results[pending_results_head];
+        if (!send_udp(pending->socket, (char *)&pending->record, sizeof(pending->record)))
+        {
+            return success;
+        }
+
+        pending_results_head = (pending_results_head + 1) % RESULT_RETRY_DEPTH;
+        backpressure_stats.results_pending--;
+        backpressure_stats.results_retried++;
+    }
+
+    return success;
+}
+
+/**
+ * Queues a result that could not be sent, losing the oldest waiting result if
+ * the queue is full.
+ *
+ * @param socket The connected socket to resend the result over.
+ * @param record The result record.
+ *
+ * @return None.
+ */
+static void defer_result(udp_socket_t *socket, const result_record_t *record)
+{
+    if (backpressure_stats.results_pending == RESULT_RETRY_DEPTH)
+    {
+        pending_results_head = (pending_results_head + 1) % RESULT_RETRY_DEPTH;
+        backpressure_stats.results_pending--;
+        backpressure_stats.results_lost++;
+    }
+
+    pending_result_t *pending = &pending_results[(pending_results_head + backpressure_stats.results_pending) %
+                                                 RESULT_RETRY_DEPTH];
+    pending->socket = socket;
+    pending->record = *record;
+    backpressure_stats.results_pending++;
+    backpressure_stats.results_deferred++;
+}
+
+/**
+ * Queues the results of a batch that could not be sent to be resent alone.
+ *
+ * @param socket The connected socket of the batch.
+ * @param type The type of the message.
+ * @param data The message.
+ * @param len The length of the message.
+ *
+ * @return None.
+ */
+static void reject_result(udp_socket_t *socket, const message_type_t type, const void *data, const size_t len)
+{
+    if (type != MESSAGE_RESULT || len != sizeof(result_record_t))
+    {
+        return;
+    }
+
+    result_record_t record;
+    memcpy(&record, data, sizeof(record));
+    defer_result(socket, &record);
+}
+
+/**
+ * Sets the longest that a result waits for others to share its datagram.
+ *
+ * @param delay_ms The longest delay, or zero to send every result alone.
+ *
+ * @return Success or fail.
+ */
+result_t set_result_batch_delay(const uint32_t delay_ms)
+{
+    result_batch_delay_ms = delay_ms;
+    if (result_batch_ready)
+    {
+        set_message_batch_delay(&result_batch, ms_to_ticks(delay_ms));
+    }
+
+    return success;
+}
+
+/**
+ * Sends the results that wait to share a datagram, for when no more results
+ * are expected soon.
+ *
+ * @return Success or fail.
+ */
+result_t flush_results()
+{
+    if (result_batch_ready)
+    {
+        flush_message_batch(&result_batch);
+    }
+
+    return success;
+}
+
+/**
+ * Sends the results that wait to share a datagram once the first has waited
+ * the longest delay.
+ *
+ * @note This runs as a result transmit task.
+ *
+ * @return Success.
+ */
+result_t service_result_batch()
+{
+    if (result_batch_ready)
+    {
+        service_message_batch(&result_batch);
+    }
+
+    return success;
+}
+
+/**
+ * Checks if a stream must give way to results that are waiting to be resent,
+ * or is sent to a destination that does not answer ARP, and counts its
+ * transfer as dropped if so.
+ *
+ * @note lwIP holds only a few datagrams while a destination is resolved, so
+ *       the rest of a burst sent before then would be lost.
+ *
+ * @param stream The stream about to send.
+ * @param socket The connected socket the stream is sent over.
+ *
+ * @return True if the transfer must be dropped.
+ */
+static bool shed_stream(const stream_class_t stream, udp_socket_t *socket)
+{
+    transmit_congested = false;
+    service_result_retries();
+
+    bool resolved = true;
+    if (socket && socket->pcb &&
+        (!prewarm_arp(&socket->pcb->remote_ip, ARP_PREWARM_TIMEOUT_MS, &resolved) || !resolved))
+    {
+        backpressure_stats.dropped[stream]++;
+        dblog(LOG_WARN, "Dropped %s, the destination did not answer ARP.\n", stream_class_names[stream]);
+        return true;
+    }
+
+    if (!backpressure_stats.results_pending)
+    {
+        return false;
+    }
+
+    backpressure_stats.dropped[stream]++;
+    return true;
+}
+
+/**
+ * Resolves the outcome of a transfer of a stream that may be dropped.
+ *
+ * @note A transfer that failed because the link could not keep up is counted
+ *       as dropped rather than failing the caller, so that overload sheds
+ *       data instead of resetting the board.
+ *
+ * @param stream The stream that sent the transfer.
+ * @param ret The outcome of the transfer.
+ *
+ * @return Success, or fail if the transfer failed for another reason.
+ */
+static result_t resolve_send(const stream_class_t stream, const result_t ret)
+{
+    const bool congested = transmit_congested;
+    transmit_congested = false;
+
+    if (ret == success)
+    {
+        return success;
+    }
+
+    AbortIfNot(congested, fail);
+    backpressure_stats.dropped[stream]++;
+    dblog(LOG_WARN, "Dropped %s, the link could not keep up.\n", stream_class_names[stream]);
+
+    return success;
+}
+
+/**
+ * Gets the outcome of sends made while the link could not keep up.
+ *
+ * @param[out] stats The backpressure counters.
+ *
+ * @return None.
+ */
+void get_backpressure_stats(backpressure_stats_t *stats)
+{
+    *stats = backpressure_stats;
+}
+
+/**
+ * Finds the time after the arrival of a ping at which a stage of its
+ * processing finished.
+ *
+ * @param ping_tick The system time at which the ping arrived.
+ * @param stage_tick The system time at which the stage finished, or zero if
+ *        the stage was not timed.
+ *
+ * @return The latency of the stage in microseconds, or zero if it was not
+ *         timed or finished before the ping arrived.
+ */
+static uint32_t stage_latency_us(const tick_t ping_tick, const tick_t stage_tick)
+{
+    if (!stage_tick || stage_tick < ping_tick)
+    {
+        return 0;
+    }
+
+    return (uint32_t)ticks_to_micros(stage_tick - ping_tick);
+}
+
+/**
+ * Transmits a cross correlation result as a binary result record.
+ *
+ * @param socket The connected socket to send data over.
+ * @param frequency The frequency of the pinger in Hz, or zero if the result
+ *        is not specific to a pinger.
+ * @param sequence The sequence number of the ping.
+ * @param ping_tick The system time at which the ping was received.
+ * @param trigger The latest edge of the external trigger input, or NULL.
+ * @param track The estimate of the bearing tracker after the ping, or NULL.
+ * @param result The result to transmit.
+ * @param average The result of the correlations averaged over recent pings,
+ *        or NULL if no average was kept.
+ * @param averaged_pings The number of pings in the average.
+ * @param filter_duration The time spent filtering the capture.
+ * @param correlation_duration The time spent correlating the ping.
+ * @param stages The times at which the stages of processing the ping
+ *        finished, or NULL if the ping was not timed.
+ *
+ * @note A result that the link cannot take is queued and resent later rather
+ *       than failing the caller.
+ *
+ * @return Success or fail.
+ */
+result_t send_result(udp_socket_t *socket,
+                     const uint32_t frequency,
+                     const uint32_t sequence,
+                     const tick_t ping_tick,
+                     const trigger_mark_t *trigger,
+                     const bearing_estimate_t *track,
+                     const correlation_result_t *result,
+                     const correlation_result_t *average,
+                     const uint32_t averaged_pings,
+                     const tick_t filter_duration,
+                     const tick_t correlation_duration,
+                     const ping_stages_t *stages)
+{
+    AbortIfNot(socket, fail);
+    AbortIfNot(result, fail);
+
+    result_record_t record;
+    record.version = RESULT_RECORD_VERSION;
+    record.length = sizeof(record);
+    record.sequence = sequence;
+    record.frequency = frequency;
+    record.timestamp_us = ticks_to_micros(ping_tick);
+    memcpy(record.channel_delay_ns, result->channel_delay_ns, sizeof(record.channel_delay_ns));
+    memcpy(record.peak_amplitude, result->peak_amplitude, sizeof(record.peak_amplitude));
+    memcpy(record.confidence, result->confidence, sizeof(record.confidence));
+    record.filter_duration_us = ticks_to_micros(filter_duration);
+    record.correlation_duration_us = ticks_to_micros(correlation_duration);
+    record.bearing_deg = result->bearing_deg;
+    record.elevation_deg = result->elevation_deg;
+    record.direction_norm = result->direction_norm;
+    record.quality = result->quality;
+    record.delay_source = (result->leading_edge)? RESULT_DELAYS_LEADING_EDGE : RESULT_DELAYS_CORRELATED;
+    record.edge_uncertainty_ns = (result->leading_edge)? result->edge_uncertainty_ns : 0;
+
+    record.trigger_sample = 0;
+    record.trigger_timestamp_us = 0;
+    record.trigger_count = 0;
+    if (trigger && trigger->count)
+    {
+        record.trigger_sample = trigger->sample;
+        record.trigger_timestamp_us = ticks_to_micros(trigger->tick);
+        record.trigger_count = trigger->count;
+    }
+
+    memset(record.tracked_delay_ns, 0, sizeof(record.tracked_delay_ns));
+    memset(record.tracked_delay_rate_ns_per_s, 0, sizeof(record.tracked_delay_rate_ns_per_s));
+    memset(record.tracked_delay_variance_ns2, 0, sizeof(record.tracked_delay_variance_ns2));
+    record.tracked_bearing_deg = 0;
+    record.tracked_elevation_deg = 0;
+    record.track_flags = 0;
+    record.track_outliers = 0;
+    if (track)
+    {
+        memcpy(record.tracked_delay_ns, track->delay_ns, sizeof(record.tracked_delay_ns));
+        memcpy(record.tracked_delay_rate_ns_per_s,
+               track->delay_rate_ns_per_s,
+               sizeof(record.tracked_delay_rate_ns_per_s));
+        memcpy(record.tracked_delay_variance_ns2,
+               track->delay_variance_ns2,
+               sizeof(record.tracked_delay_variance_ns2));
+        record.tracked_bearing_deg = track->bearing_deg;
+        record.tracked_elevation_deg = track->elevation_deg;
+        record.track_flags = track->flags;
+        record.track_outliers = track->outliers;
+    }
+
+    memset(record.averaged_delay_ns, 0, sizeof(record.averaged_delay_ns));
+    memset(record.averaged_confidence, 0, sizeof(record.averaged_confidence));
+    record.averaged_pings = 0;
+    if (average && averaged_pings)
+    {
+        memcpy(record.averaged_delay_ns, average->channel_delay_ns, sizeof(record.averaged_delay_ns));
+        memcpy(record.averaged_confidence, average->confidence, sizeof(record.averaged_confidence));
+        record.averaged_pings = averaged_pings;
+    }
+
+    record.capture_latency_us = 0;
+    record.window_latency_us = 0;
+    record.process_latency_us = 0;
+    record.solve_latency_us = 0;
+    record.queue_latency_us = 0;
+    if (stages)
+    {
+        record.queue_latency_us = stage_latency_us(ping_tick, get_system_time());
+        record.capture_latency_us = stage_latency_us(ping_tick, stages->capture_complete);
+        record.window_latency_us = stage_latency_us(ping_tick, stages->window_located);
+        record.process_latency_us = stage_latency_us(ping_tick, stages->processed);
+        record.solve_latency_us = stage_latency_us(ping_tick, stages->solved);
+    }
+
+    /*
+     * A result is never sent ahead of those already waiting, so that the
+     * receiver sees them in order. Results that share a datagram which
+     * cannot be sent are queued to be resent alone.
+     */
+    AbortIfNot(service_result_retries(), fail);
+    if (!result_batch_ready)
+    {
+        AbortIfNot(init_message_batch(&result_batch,
+                                      socket,
+                                      ms_to_ticks(result_batch_delay_ms),
+                                      reject_result), fail);
+        result_batch_ready = true;
+    }
+
+    if (backpressure_stats.results_pending)
+    {
+        flush_message_batch(&result_batch);
+        defer_result(socket, &record);
+        return success;
+    }
+
+    set_message_batch_destination(&result_batch, socket);
+    add_batched_message(&result_batch, MESSAGE_RESULT, &record, sizeof(record), false);
+
+    return success;
+}
+
+/**
+ * The rate limit applied to streamed data.
+ */
+static transmit_rate_t transmit_rate = {
+    .bytes_per_second = INITIAL_TRANSMIT_RATE_BYTES_PER_SECOND,
+    .burst_bytes = INITIAL_TRANSMIT_BURST_BYTES,
+    .tokens = INITIAL_TRANSMIT_BURST_BYTES,
+    .last_refill = 0,
+    .idle = NULL,
+    .idle_arg = NULL
+};
+
+/**
+ * The period around the next capture window in which streamed data is held.
+ */
+static transmit_quiet_t transmit_quiet = {
+    .enabled = true,
+    .scheduled = false,
+    .start = 0,
+    .end = 0,
+    .held = 0
+};
+
+/**
+ * Sets the rate limit applied to streamed data.
+ *
+ * @param bytes_per_second The sustained rate, or zero for no limit.
+ * @param burst_bytes The number of bytes that may be sent back to back.
+ *
+ * @return Success or fail.
+ */
+result_t set_transmit_rate(const uint32_t bytes_per_second, const uint32_t burst_bytes)
+{
+    AbortIfNot(burst_bytes, fail);
+
+    transmit_rate.bytes_per_second = bytes_per_second;
+    transmit_rate.burst_bytes = burst_bytes;
+    transmit_rate.tokens = burst_bytes;
+    transmit_rate.last_refill = get_system_time();
+
+    return success;
+}
+
+/**
+ * Gets the rate limit of the data and correlation streams.
+ *
+ * @return The rate in bytes per second, or zero if unlimited.
+ */
+uint32_t get_transmit_rate()
+{
+    return transmit_rate.bytes_per_second;
+}
+
+/**
+ * The encoding applied to the sample stream.
+ */
+static stream_encoding_t data_encoding = STREAM_ENCODING_RAW;
+
+/**
+ * The time after the last transmission or request at which an unacknowledged
+ * reliable transfer is abandoned.
+ */
+#define TRANSFER_IDLE_TIMEOUT_MS 1000
+
+/**
+ * The reliable sample transfer and whether sample data is sent reliably.
+ */
+static stream_transfer_t reliable_transfer = {0};
+static bool reliable_transfer_enabled = false;
+
+/**
+ * The correlation results that are streamed, the decimation factor or peak
+ * radius of the view, and the staging buffer of the selected results.
+ */
+static xcorr_view_t xcorr_view = XCORR_VIEW_FULL;
+static uint32_t xcorr_view_parameter = 0;
+static correlation_t xcorr_view_buffer[XCORR_VIEW_MAX_CORRELATIONS];
+
+/**
+ * The largest datagram payload that can be encoded, which bounds the MTU at
+ * which compressed samples are sent.
+ */
+#define ENCODED_PAYLOAD_MAX 9000
+
+/**
+ * Sets the encoding applied to the sample stream.
+ *
+ * @param encoding The encoding to use.
+ *
+ * @return None.
+ */
+void set_data_encoding(const stream_encoding_t encoding)
+{
+    data_encoding = encoding;
+}
+
+/**
+ * Selects the correlation results that are streamed by send_xcorr().
+ *
+ * @param view The view to stream.
+ * @param parameter The decimation factor of a decimated view or the number
+ *        of lags either side of each peak of a peak view.
+ *
+ * @return Success or fail.
+ */
+result_t set_xcorr_view(const xcorr_view_t view, const uint32_t parameter)
+{
+    AbortIf(view == XCORR_VIEW_DECIMATED && parameter == 0, fail);
+    AbortIf(view == XCORR_VIEW_PEAK &&
+            3 * (2 * (size_t)parameter + 1) > XCORR_VIEW_MAX_CORRELATIONS, fail);
+    AbortIf(view > XCORR_VIEW_PEAK, fail);
+
+    xcorr_view = view;
+    xcorr_view_parameter = parameter;
+
+    return success;
+}
+
+/**
+ * Sets the work performed while streaming waits for the link.
+ *
+ * @param idle The function to call, or NULL to only service the network stack.
+ * @param arg The argument to pass to the function.
+ *
+ * @return None.
+ */
+void set_transmit_idle(result_t (*idle)(void *arg), void *arg)
+{
+    transmit_rate.idle = idle;
+    transmit_rate.idle_arg = arg;
+}
+
+/**
+ * Sets whether streamed data is held around planned capture windows.
+ *
+ * @param enabled Specified true to hold streams around capture windows.
+ *
+ * @return None.
+ */
+void set_transmit_quiet_enabled(const bool enabled)
+{
+    transmit_quiet.enabled = enabled;
+    if (!enabled)
+    {
+        transmit_quiet.scheduled = false;
+    }
+}
+
+/**
+ * Holds streamed data from shortly before a planned capture window until it
+ * has been captured. Results and telemetry are not held.
+ *
+ * @note A stream waiting for the period to end keeps servicing the other
+ *       tasks, so the capture of the window itself is not delayed.
+ *
+ * @param window_start The time the window opens.
+ * @param window_end The time the window is predicted to close.
+ *
+ * @return None.
+ */
+void schedule_transmit_quiet(const tick_t window_start, const tick_t window_end)
+{
+    if (!transmit_quiet.enabled)
+    {
+        return;
+    }
+
+    const tick_t lead = micros_to_ticks(TRANSMIT_QUIET_LEAD_US);
+    transmit_quiet.start = (window_start > lead)? window_start - lead : 0;
+    transmit_quiet.end = window_end + ms_to_ticks(TRANSMIT_QUIET_SLACK_MS);
+    transmit_quiet.scheduled = true;
+}
+
+/**
+ * Ends the quiet period once its window has been captured, so that streams
+ * resume without waiting for the slack after the predicted end.
+ *
+ * @return None.
+ */
+void end_transmit_quiet()
+{
+    transmit_quiet.scheduled = false;
+}
+
+/**
+ * Checks if streamed data is held at a time, ending a period that has
+ * passed.
+ *
+ * @param now The time to check.
+ *
+ * @return True if streamed data must not be queued.
+ */
+static bool transmit_quiet_at(const tick_t now)
+{
+    if (!transmit_quiet.scheduled)
+    {
+        return false;
+    }
+
+    if (now >= transmit_quiet.end)
+    {
+        transmit_quiet.scheduled = false;
+        return false;
+    }
+
+    return (now >= transmit_quiet.start)? true : false;
+}
+
+/**
+ * Gets the time that streams may yet be held by the scheduled quiet period,
+ * which a deadline on sending must allow for.
+ *
+ * @return The time until the period ends, or zero if none is scheduled.
+ */
+tick_t get_transmit_quiet_remaining()
+{
+    const tick_t now = get_system_time();
+    if (!transmit_quiet.scheduled || now >= transmit_quiet.end)
+    {
+        return 0;
+    }
+
+    const tick_t from = (now > transmit_quiet.start)? now : transmit_quiet.start;
+
+    return transmit_quiet.end - from;
+}
+
+/**
+ * Gets the total time that streams have been held around capture windows.
+ *
+ * @return The time held since boot.
+ */
+tick_t get_transmit_held_ticks()
+{
+    return transmit_quiet.held;
+}
+
+/**
+ * Services the network stack and any other work while streaming waits.
+ *
+ * @return Success or fail.
+ */
+static result_t transmit_yield()
+{
+    dispatch_network_stack();
+    service_log(LOG_DRAIN_BYTES_PER_CALL);
+
+    if (transmit_rate.idle)
+    {
+        AbortIfNot(transmit_rate.idle(transmit_rate.idle_arg), fail);
+    }
+
+    return success;
+}
+
+/**
+ * Adds the tokens earned since the last refill, up to the burst size.
+ *
+ * @return None.
+ */
+static void refill_transmit_tokens()
+{
+    const tick_t now = get_system_time();
+    const tick_t elapsed = now - transmit_rate.last_refill;
+    transmit_rate.last_refill = now;
+
+    /*
+     * Limit the elapsed time so that a long idle period cannot overflow.
+     */
+    if (elapsed > CPU_CLOCK_HZ)
+    {
+        transmit_rate.tokens = transmit_rate.burst_bytes;
+        return;
+    }
+
+    transmit_rate.tokens += elapsed * transmit_rate.bytes_per_second / CPU_CLOCK_HZ;
+    if (transmit_rate.tokens > transmit_rate.burst_bytes)
+    {
+        transmit_rate.tokens = transmit_rate.burst_bytes;
+    }
+}
+
+/**
+ * Takes tokens for a datagram if it may be queued now without exceeding the
+ * rate limit or the capacity of the Ethernet transmit ring.
+ *
+ * @note A datagram larger than the burst size is sent once the bucket is full
+ *       and leaves it in debt.
+ *
+ * @param bytes The size of the datagram.
+ * @param[out] link_ready Specified true if the Ethernet driver could accept
+ *             the datagram.
+ *
+ * @return True if the datagram may be sent.
+ */
+static bool reserve_transmit(const size_t bytes, bool *link_ready)
+{
+    refill_transmit_tokens();
+
+    /*
+     * A held stream waits as it would for tokens, without the timeout of
+     * waiting on the driver.
+     */
+    if (transmit_quiet_at(get_system_time()))
+    {
+        *link_ready = true;
+        return false;
+    }
+
+    *link_ready = (get_free_tx_descriptors() >= TRANSMIT_MIN_FREE_DESCRIPTORS &&
+                   udp_ref_available())? true : false;
+    if (!*link_ready)
+    {
+        return false;
+    }
+
+    if (!transmit_rate.bytes_per_second)
+    {
+        return true;
+    }
+
+    const int64_t needed = (bytes < transmit_rate.burst_bytes)? bytes : transmit_rate.burst_bytes;
+    if (transmit_rate.tokens >= needed)
+    {
+        transmit_rate.tokens -= bytes;
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * Waits until a datagram may be queued without exceeding the rate limit or
+ * the capacity of the Ethernet transmit ring.
+ *
+ * @param bytes The size of the datagram.
+ *
+ * @return Success or fail.
+ */
+static result_t wait_for_transmit(const size_t bytes)
+{
+    tick_t start_time = get_system_time();
+    while (1)
+    {
+        bool link_ready;
+        if (reserve_transmit(bytes, &link_ready))
+        {
+            return success;
+        }
+
+        /*
+         * Only waiting on the driver is bounded by the timeout.
+         */
+        if (link_ready)
+        {
+            start_time = get_system_time();
+        }
+
+        if (get_system_time() - start_time > ms_to_ticks(TRANSMIT_RELEASE_TIMEOUT_MS))
+        {
+            transmit_congested = true;
+            return fail;
+        }
+
+        const tick_t yield_start = get_system_time();
+        const bool held = transmit_quiet_at(yield_start);
+        AbortIfNot(transmit_yield(), fail);
+        if (held)
+        {
+            transmit_quiet.held += get_system_time() - yield_start;
+        }
+    }
+}
+
+/**
+ * Waits for the Ethernet driver to release all datagrams charged to a tracker.
+ *
+ * @param tracker The tracker to wait on.
+ *
+ * @return Success or fail.
+ */
+static result_t wait_for_release(udp_ref_tracker_t *tracker)
+{
+    const tick_t start_time = get_system_time();
+    while (!udp_refs_released(tracker))
+    {
+        if (get_system_time() - start_time > ms_to_ticks(TRANSMIT_RELEASE_TIMEOUT_MS))
+        {
+            transmit_congested = true;
+            return fail;
+        }
+        AbortIfNot(transmit_yield(), fail);
+    }
+
+    return success;
+}
+
+/**
+ * Sends one datagram of a transfer if the rate limit and the Ethernet driver
+ * allow it without waiting.
+ *
+ * @param transfer The transfer to send from.
+ * @param packet The packet number to send.
+ * @param tracker The tracker to charge the datagram to.
+ * @param[out] sent Specified true if the datagram was queued.
+ *
+ * @return Success or fail.
+ */
+static result_t try_send_transfer_packet(stream_transfer_t *transfer,
+                                         const size_t packet,
+                                         udp_ref_tracker_t *tracker,
+                                         bool *sent)
+{
+    *sent = false;
+
+    const size_t i = packet * transfer->per_packet;
+    const size_t elements = (transfer->count - i < transfer->per_packet)?
+            transfer->count - i : transfer->per_packet;
+    const stream_header_t header = {
+        .packet_number = packet,
+        .first_element = i,
+        .element_size = transfer->element_size,
+        .element_count = elements,
+        .encoding = STREAM_ENCODING_RAW,
+        .transfer_id = transfer->transfer_id,
+        .total_elements = transfer->count
+    };
+
+    bool link_ready;
+    if (!reserve_transmit(sizeof(header) + elements * transfer->element_size, &link_ready))
+    {
+        return success;
+    }
+
+    AbortIfNot(send_udp_ref(transfer->socket,
+                            &header,
+                            sizeof(header),
+                            &transfer->data[i * transfer->element_size],
+                            elements * transfer->element_size,
+                            tracker), fail);
+    *sent = true;
+
+    return success;
+}
+
+/**
+ * Prepares a transfer of an array as a sequence of numbered datagrams.
+ *
+ * @param[out] transfer The transfer to prepare.
+ * @param socket The connected socket to send data over.
+ * @param data The array to send.
+ * @param element_size The size of each element in bytes.
+ * @param count The number of elements to transmit.
+ *
+ * @return Success or fail.
+ */
+static result_t init_transfer(stream_transfer_t *transfer,
+                              udp_socket_t *socket,
+                              const void *data,
+                              const size_t element_size,
+                              const size_t count)
+{
+    AbortIfNot(transfer, fail);
+    AbortIfNot(socket, fail);
+    AbortIfNot(data, fail);
+    AbortIfNot(element_size, fail);
+
+    /*
+     * Fill each datagram up to the interface MTU so that none of them are
+     * fragmented by IP.
+     */
+    const size_t mtu = get_network_mtu();
+    AbortIfNot(mtu > IP_HLEN + UDP_HLEN + sizeof(stream_header_t) + element_size, fail);
+
+    transfer->socket = socket;
+    transfer->data = data;
+    transfer->element_size = element_size;
+    transfer->count = count;
+    transfer->per_packet = (mtu - IP_HLEN - UDP_HLEN - sizeof(stream_header_t)) / element_size;
+    transfer->num_packets = (count + transfer->per_packet - 1) / transfer->per_packet;
+    transfer->transfer_id++;
+    transfer->active = false;
+    transfer->acknowledged = false;
+    transfer->num_resend = 0;
+    transfer->last_activity = get_system_time();
+
+    return success;
+}
+
+/**
+ * Transmits a range of the datagrams of a transfer without copying the array.
+ *
+ * @note The array is referenced by the outgoing pbufs and this does not
+ *       return until the Ethernet driver has released all of them, so the
+ *       array may be reused as soon as this returns.
+ *
+ * @param transfer The transfer to send from.
+ * @param first_packet The first packet number to send.
+ * @param last_packet The last packet number to send, inclusive.
+ *
+ * @return Success or fail.
+ */
+static result_t send_transfer_packets(stream_transfer_t *transfer,
+                                      const size_t first_packet,
+                                      const size_t last_packet)
+{
+    AbortIfNot(transfer, fail);
+
+    /*
+     * The tracker is static so that a datagram released after a timeout
+     * does not write to a stale stack frame.
+     */
+    static udp_ref_tracker_t tracker = {0};
+    result_t ret = success;
+
+    for (size_t packet = first_packet;
+         packet <= last_packet && packet < transfer->num_packets && ret == success;
+         ++packet)
+    {
+        const size_t i = packet * transfer->per_packet;
+        const size_t elements = (transfer->count - i < transfer->per_packet)?
+                transfer->count - i : transfer->per_packet;
+
+        /*
+         * The header is the only part that is copied.
+         */
+        const stream_header_t header = {
+            .packet_number = packet,
+            .first_element = i,
+            .element_size = transfer->element_size,
+            .element_count = elements,
+            .encoding = STREAM_ENCODING_RAW,
+            .transfer_id = transfer->transfer_id,
+            .total_elements = transfer->count
+        };
+
+        ret = wait_for_transmit(sizeof(header) + elements * transfer->element_size);
+        if (ret == success)
+        {
+            ret = send_udp_ref(transfer->socket,
+                               &header,
+                               sizeof(header),
+                               &transfer->data[i * transfer->element_size],
+                               elements * transfer->element_size,
+                               &tracker);
+            if (ret != success)
+            {
+                transmit_congested = true;
+            }
+        }
+
+        dispatch_network_stack();
+    }
+
+    /*
+     * Datagrams that were queued must be released before the caller may
+     * reuse the array, even if a later send failed.
+     */
+    AbortIfNot(wait_for_release(&tracker), fail);
+    AbortIfNot(ret, fail);
+
+    return success;
+}
+
+/**
+ * Transmits an array as a sequence of numbered datagrams without copying it.
+ *
+ * @param socket The connected socket to send data over.
+ * @param data The array to send.
+ * @param element_size The size of each element in bytes.
+ * @param count The number of elements to transmit.
+ *
+ * @return Success or fail.
+ */
+static result_t send_array(udp_socket_t *socket,
+                           const void *data,
+                           const size_t element_size,
+                           const size_t count)
+{
+    static stream_transfer_t transfer = {0};
+
+    AbortIfNot(init_transfer(&transfer, socket, data, element_size, count), fail);
+    AbortIfNot(send_transfer_packets(&transfer, 0, transfer.num_packets), fail);
+
+    return success;
+}
+
+/**
+ * Transmits an array and then holds it for retransmission until the receiver
+ * acknowledges it or stops responding.
+ *
+ * @note Retransmit requests and acknowledgements are delivered through
+ *       handle_transfer_command() while the network stack is serviced.
+ *
+ * @param socket The connected socket to send data over.
+ * @param data The array to send.
+ * @param element_size The size of each element in bytes.
+ * @param count The number of elements to transmit.
+ *
+ * @return Success or fail.
+ */
+static result_t send_array_reliable(udp_socket_t *socket,
+                                    const void *data,
+                                    const size_t element_size,
+                                    const size_t count)
+{
+    stream_transfer_t *transfer = &reliable_transfer;
+
+    AbortIfNot(init_transfer(transfer, socket, data, element_size, count), fail);
+    transfer->active = true;
+
+    result_t ret = send_transfer_packets(transfer, 0, transfer->num_packets);
+    transfer->last_activity = get_system_time();
+
+    while (ret == success && !transfer->acknowledged)
+    {
+        if (transfer->num_resend)
+        {
+            /*
+             * Take the oldest range first. New ranges may be added while it
+             * is sent.
+             */
+            const uint32_t first = transfer->resend_first[0];
+            const uint32_t last = transfer->resend_last[0];
+            transfer->num_resend--;
+            for (size_t i = 0; i < transfer->num_resend; ++i)
+            {
+                transfer->resend_first[i] = transfer->resend_first[i + 1];
+                transfer->resend_last[i] = transfer->resend_last[i + 1];
+            }
+
+            ret = send_transfer_packets(transfer, first, last);
+            transfer->last_activity = get_system_time();
+            continue;
+        }
+
+        if (get_system_time() - transfer->last_activity > ms_to_ticks(TRANSFER_IDLE_TIMEOUT_MS))
+        {
+            dbprintf("Transfer %u was not acknowledged.\n", transfer->transfer_id);
+            break;
+        }
+
+        ret = transmit_yield();
+    }
+
+    transfer->active = false;
+    AbortIfNot(ret, fail);
+
+    return success;
+}
+
+/**
+ * Enables holding sample transfers for retransmission.
+ *
+ * @note Reliable transfers are always sent without compression so that each
+ *       packet number covers a fixed range of samples.
+ *
+ * @param enabled Specified true to wait for acknowledgement of each transfer.
+ *
+ * @return None.
+ */
+void set_reliable_transfer(const bool enabled)
+{
+    reliable_transfer_enabled = enabled;
+}
+
+/**
+ * Handles an acknowledgement or retransmit request for the active transfer.
+ *
+ * @note Requests are formatted as "ack:<transfer>" or
+ *       "resend:<transfer>/<first>-<last>/<packet>/..." and are handled from
+ *       the network stack so that they reach a transfer that is in progress.
+ *
+ * @param text The received command.
+ *
+ * @return True if the command was a transfer request and has been consumed.
+ */
+bool handle_transfer_command(const char *text)
+{
+    stream_transfer_t *transfer = &reliable_transfer;
+    unsigned int transfer_id = 0;
+
+    if (strncmp(text, "ack:", 4) == 0)
+    {
+        if (sscanf(&text[4], "%u", &transfer_id) == 1 &&
+            transfer->active && transfer_id == transfer->transfer_id)
+        {
+            transfer->acknowledged = true;
+        }
+
+        return true;
+    }
+
+    if (strncmp(text, "resend:", 7) != 0)
+    {
+        return false;
+    }
+
+    char *next = NULL;
+    transfer_id = strtoul(&text[7], &next, 10);
+    if (!transfer->active || transfer_id != transfer->transfer_id)
+    {
+        return true;
+    }
+
+    transfer->last_activity = get_system_time();
+    while (*next == '/' && transfer->num_resend < TRANSFER_MAX_RESEND_RANGES)
+    {
+        const uint32_t first = strtoul(next + 1, &next, 10);
+        uint32_t last = first;
+        if (*next == '-')
+        {
+            last = strtoul(next + 1, &next, 10);
+        }
+
+        if (last >= first && first < transfer->num_packets)
+        {
+            transfer->resend_first[transfer->num_resend] = first;
+            transfer->resend_last[transfer->num_resend] = last;
+            transfer->num_resend++;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Transmits samples compressed by the delta coder.
+ *
+ * @note Each datagram is encoded independently so that a lost datagram does
+ *       not prevent the others from being decoded.
+ *
+ * @param socket The connected socket to send data over.
+ * @param data The sample data to send.
+ * @param count The number of samples to transmit.
+ *
+ * @return Success or fail.
+ */
+static result_t send_encoded_samples(udp_socket_t *socket, const sample_t *data, const size_t count)
+{
+    AbortIfNot(socket, fail);
+    AbortIfNot(data, fail);
+
+    static uint8_t datagram[sizeof(stream_header_t) + ENCODED_PAYLOAD_MAX];
+
+    const size_t mtu = get_network_mtu();
+    AbortIfNot(mtu > IP_HLEN + UDP_HLEN + sizeof(stream_header_t), fail);
+    size_t capacity = mtu - IP_HLEN - UDP_HLEN - sizeof(stream_header_t);
+    if (capacity > ENCODED_PAYLOAD_MAX)
+    {
+        capacity = ENCODED_PAYLOAD_MAX;
+    }
+
+    /*
+     * Each capture is numbered so that receivers can tell consecutive
+     * captures of the same length apart.
+     */
+    static uint16_t transfer_id = 0;
+    transfer_id++;
+
+    size_t i = 0;
+    for (int32_t packet_number = 0; i < count; ++packet_number)
+    {
+        size_t consumed, encoded_len;
+        AbortIfNot(encode_samples(&data[i],
+                                  count - i,
+                                  &datagram[sizeof(stream_header_t)],
+                                  capacity,
+                                  &consumed,
+                                  &encoded_len), fail);
+
+        const stream_header_t header = {
+            .packet_number = packet_number,
+            .first_element = i,
+            .element_size = sizeof(sample_t),
+            .element_count = consumed,
+            .encoding = STREAM_ENCODING_DELTA,
+            .transfer_id = transfer_id,
+            .total_elements = count
+        };
+        memcpy(datagram, &header, sizeof(header));
+
+        AbortIfNot(wait_for_transmit(sizeof(header) + encoded_len), fail);
+        if (!send_udp(socket, (char *)datagram, sizeof(header) + encoded_len))
+        {
+            transmit_congested = true;
+            return fail;
+        }
+        dispatch_network_stack();
+
+        i += consumed;
+    }
+
+    return success;
+}
+
+/**
+ * Transmits sampled data.
+ *
+ * @param socket The connected socket to send data over.
+ * @param data The sample data to send.
+ * @param count The number of samples to transmit.
+ *
+ * @note Samples that the link cannot keep up with are dropped.
+ *
+ * @return Success or fail.
+ */
+result_t send_data(udp_socket_t *socket, sample_t *data, const size_t count)
+{
+    AbortIfNot(socket, fail);
+    AbortIfNot(data, fail);
+
+    if (shed_stream(STREAM_CLASS_SAMPLES, socket))
+    {
+        return success;
+    }
+
+    result_t ret;
+    if (reliable_transfer_enabled)
+    {
+        ret = send_array_reliable(socket, data, sizeof(sample_t), count);
+    }
+    else if (data_encoding == STREAM_ENCODING_DELTA)
+    {
+        ret = send_encoded_samples(socket, data, count);
+    }
+    else
+    {
+        ret = send_array(socket, data, sizeof(sample_t), count);
+    }
+
+    AbortIfNot(resolve_send(STREAM_CLASS_SAMPLES, ret), fail);
+
+    return success;
+}
+
+/**
+ * The stream of samples sent as raw Ethernet frames.
+ */
+static raw_stream_t raw_stream = {0};
+
+/**
+ * Sends the data stream as raw Ethernet frames to one station, or returns it
+ * to UDP.
+ *
+ * @param enabled Specified true to send raw frames.
+ * @param destination The MAC address of the station.
+ *
+ * @return None.
+ */
+void set_raw_stream(const bool enabled, const uint8_t destination[6])
+{
+    raw_stream.enabled = enabled;
+    if (enabled)
+    {
+        memcpy(raw_stream.destination, destination, sizeof(raw_stream.destination));
+    }
+}
+
+/**
+ * Checks if the data stream is sent as raw Ethernet frames.
+ *
+ * @return True if raw frames are sent.
+ */
+bool raw_stream_enabled()
+{
+    return raw_stream.enabled;
+}
+
+/**
+ * Transmits samples as raw Ethernet frames to the station of the raw stream,
+ * without copying them and without the UDP, IP and ARP processing of lwIP.
+ *
+ * @note The samples are referenced by the outgoing frames and this does not
+ *       return until the Ethernet driver has released all of them. Frames
+ *       are paced by the same rate limit as the UDP streams.
+ *
+ * @param data The samples to send.
+ * @param count The number of samples to transmit.
+ *
+ * @return Success or fail.
+ */
+result_t send_raw_data(const sample_t *data, const size_t count)
+{
+    AbortIfNot(data, fail);
+    AbortIfNot(raw_stream.enabled, fail);
+    AbortIfNot(netif_default, fail);
+
+    /*
+     * The tracker is static so that a frame released after a timeout does
+     * not write to a stale stack frame.
+     */
+    static udp_ref_tracker_t tracker = {0};
+
+    struct __attribute__((packed))
+    {
+        struct eth_hdr eth;
+        raw_frame_header_t raw;
+    } header;
+    memcpy(header.eth.dest.addr, raw_stream.destination, sizeof(header.eth.dest.addr));
+    memcpy(header.eth.src.addr, netif_default->hwaddr, sizeof(header.eth.src.addr));
+    header.eth.type = htons(RAW_FRAME_ETHERTYPE);
+    header.raw.version = RAW_FRAME_VERSION;
+    header.raw.transfer_id = ++raw_stream.transfer_id;
+
+    const uint8_t *bytes = (const uint8_t *)data;
+    const size_t total = count * sizeof(sample_t);
+    header.raw.total_bytes = total;
+
+    result_t ret = success;
+    for (size_t offset = 0; offset < total && ret == success; offset += RAW_FRAME_PAYLOAD_MAX)
+    {
+        const size_t len = (total - offset < RAW_FRAME_PAYLOAD_MAX)? total - offset : RAW_FRAME_PAYLOAD_MAX;
+        header.raw.flags = (offset + len == total)? RAW_FRAME_LAST : 0;
+        header.raw.sequence = raw_stream.sequence;
+        header.raw.offset = offset;
+
+        ret = wait_for_transmit(sizeof(header) + len);
+        if (ret == success)
+        {
+            ret = send_raw_frame_ref(&header, sizeof(header), &bytes[offset], len, &tracker);
+            if (ret == success)
+            {
+                raw_stream.sequence++;
+            }
+            else
+            {
+                transmit_congested = true;
+            }
+        }
+    }
+
+    /*
+     * Frames that were queued must be released before the caller may reuse
+     * the samples, even if a later send failed.
+     */
+    const result_t released = wait_for_release(&tracker);
+    AbortIfNot(resolve_send(STREAM_CLASS_SAMPLES, (ret && released)? success : fail), fail);
+
+    return success;
+}
+
+/**
+ * Divides a buffer into segments of samples that each fill one data stream
+ * datagram, with room reserved ahead of each segment for the stream header
+ * and the pbuf and protocol headers of the datagram.
+ *
+ * @note A segment is a whole number of ADC packets, and at least one even if
+ *       a single packet is fragmented by IP.
+ *
+ * @param[out] layout The layout.
+ * @param buffer The buffer, aligned to a cache line.
+ * @param bytes The length of the buffer in bytes.
+ * @param samples_per_packet The number of samples in each ADC packet.
+ *
+ * @return Success or fail.
+ */
+result_t init_transmit_layout(segmented_layout_t *layout,
+                              void *buffer,
+                              const size_t bytes,
+                              const size_t samples_per_packet)
+{
+    AbortIfNot(samples_per_packet, fail);
+
+    const size_t mtu = get_network_mtu();
+    AbortIfNot(mtu > IP_HLEN + UDP_HLEN + sizeof(stream_header_t), fail);
+    const size_t per_datagram = (mtu - IP_HLEN - UDP_HLEN - sizeof(stream_header_t)) / sizeof(sample_t);
+    size_t segment_samples = per_datagram - per_datagram % samples_per_packet;
+    if (!segment_samples)
+    {
+        segment_samples = samples_per_packet;
+    }
+
+    AbortIfNot(init_segmented_layout(layout,
+                                     buffer,
+                                     bytes,
+                                     segment_samples,
+                                     UDP_IN_PLACE_HEADROOM + sizeof(stream_header_t)), fail);
+
+    return success;
+}
+
+/**
+ * Transmits samples captured into a transmit layout, sending each segment
+ * from where it was captured with its header written into the gap ahead of
+ * it.
+ *
+ * @note The samples are always sent raw and unacknowledged, since the delta
+ *       coding and the retransmit buffer both need the samples to be
+ *       contiguous. This does not return until the Ethernet driver has
+ *       released every datagram, so the layout may then be captured into
+ *       again.
+ *
+ * @param socket The connected socket to send data over.
+ * @param layout The layout the samples were captured into.
+ * @param count The number of samples to transmit.
+ *
+ * @return Success or fail.
+ */
+result_t send_segmented_data(udp_socket_t *socket, const segmented_layout_t *layout, const size_t count)
+{
+    AbortIfNot(socket, fail);
+    AbortIfNot(layout, fail);
+    AbortIfNot(count <= layout->num_segments * layout->segment_samples, fail);
+    AbortIfNot(layout->gap_bytes >= UDP_IN_PLACE_HEADROOM + sizeof(stream_header_t), fail);
+
+    if (shed_stream(STREAM_CLASS_SAMPLES, socket))
+    {
+        return success;
+    }
+
+    /*
+     * The tracker is static so that a datagram released after a timeout
+     * does not write to a stale stack frame.
+     */
+    static udp_ref_tracker_t tracker = {0};
+    static uint16_t transfer_id = 0;
+    transfer_id++;
+
+    result_t ret = success;
+    for (size_t packet = 0; packet * layout->segment_samples < count && ret == success; ++packet)
+    {
+        const size_t i = packet * layout->segment_samples;
+        const size_t elements = (count - i < layout->segment_samples)? count - i : layout->segment_samples;
+        const stream_header_t header = {
+            .packet_number = packet,
+            .first_element = i,
+            .element_size = sizeof(sample_t),
+            .element_count = elements,
+            .encoding = STREAM_ENCODING_RAW,
+            .transfer_id = transfer_id,
+            .total_elements = count
+        };
+
+        uint8_t *datagram = (uint8_t *)get_layout_segment(layout, packet) - sizeof(header);
+        memcpy(datagram, &header, sizeof(header));
+
+        const size_t len = sizeof(header) + elements * sizeof(sample_t);
+        ret = wait_for_transmit(len);
+        if (ret == success)
+        {
+            ret = send_udp_in_place(socket, datagram, len, &tracker);
+            if (ret != success)
+            {
+                transmit_congested = true;
+            }
+        }
+
+        dispatch_network_stack();
+    }
+
+    AbortIfNot(wait_for_release(&tracker), fail);
+    AbortIfNot(resolve_send(STREAM_CLASS_SAMPLES, ret), fail);
+
+    return success;
+}
+
+/**
+ * Copies the correlations of the current view into the view buffer.
+ *
+ * @note Every result carries its shift, so a sparse selection can be placed
+ *       by the receiver.
+ *
+ * @param data The correlations to select from.
+ * @param count The number of correlations.
+ *
+ * @return The number of correlations selected.
+ */
+static size_t select_xcorr_view(const correlation_t *data, const size_t count)
+{
+    size_t selected = 0;
+    if (xcorr_view == XCORR_VIEW_DECIMATED)
+    {
+        for (size_t i = 0; i < count && selected < XCORR_VIEW_MAX_CORRELATIONS;
+                i += xcorr_view_parameter)
+        {
+            xcorr_view_buffer[selected++] = data[i];
+        }
+    }
+    else
+    {
+        size_t peaks[3] = {0, 0, 0};
+        for (size_t i = 0; i < count; ++i)
+        {
+            for (size_t k = 0; k < 3; ++k)
+            {
+                if (data[i].result[k] > data[peaks[k]].result[k])
+                {
+                    peaks[k] = i;
+                }
+            }
+        }
+
+        /*
+         * Send the union of the neighborhoods in lag order.
+         */
+        for (size_t i = 0; i < count && selected < XCORR_VIEW_MAX_CORRELATIONS; ++i)
+        {
+            for (size_t k = 0; k < 3; ++k)
+            {
+                const size_t distance = (i > peaks[k])? i - peaks[k] : peaks[k] - i;
+                if (distance <= xcorr_view_parameter)
+                {
+                    xcorr_view_buffer[selected++] = data[i];
+                    break;
+                }
+            }
+        }
+    }
+
+    return selected;
+}
+
+/**
+ * Transmits cross correlation data.
+ *
+ * @param socket The connected socket to send data over.
+ * @param data The correlations to send.
+ * @param count The number of correlations to transmit.
+ *
+ * @note Correlations that the link cannot keep up with are dropped.
+ *
+ * @return Success or fail.
+ */
+result_t send_xcorr(udp_socket_t *socket, correlation_t *data, const size_t count)
+{
+    AbortIfNot(data || count == 0, fail);
+
+    if (shed_stream(STREAM_CLASS_XCORR, socket))
+    {
+        return success;
+    }
+
+    result_t ret;
+    if (xcorr_view == XCORR_VIEW_FULL || count == 0)
+    {
+        ret = send_array(socket, data, sizeof(correlation_t), count);
+    }
+    else
+    {
+        const size_t selected = select_xcorr_view(data, count);
+        ret = send_array(socket, xcorr_view_buffer, sizeof(correlation_t), selected);
+    }
+
+    AbortIfNot(resolve_send(STREAM_CLASS_XCORR, ret), fail);
+
+    return success;
+}
+
+/**
+ * The number of datagrams of a stream job sent by each call to
+ * service_stream_job(), which bounds how long a call can take.
+ */
+#define STREAM_JOB_PACKETS_PER_SERVICE 8
+
+/**
+ * Sets the callbacks of a stream job, which apply to the jobs started on it
+ * afterwards.
+ *
+ * @param job The stream job.
+ * @param progress Called after each service that sent datagrams, or NULL.
+ * @param complete Called with the outcome once the job is done, or NULL.
+ * @param arg The argument provided to the callbacks.
+ *
+ * @return None.
+ */
+void set_stream_job_callbacks(stream_job_t *job,
+                              void (*progress)(stream_job_t *job, void *arg),
+                              void (*complete)(stream_job_t *job, const result_t result, void *arg),
+                              void *arg)
+{
+    job->progress = progress;
+    job->complete = complete;
+    job->callback_arg = arg;
+}
+
+/**
+ * Begins sending an array in the background. A job still in progress is
+ * finished first.
  *
+ * @param job The stream job to start.
  * @param socket The connected socket to send data over.
- * @param result The result to transmit.
+ * @param data The array to send.
+ * @param element_size The size of each element in bytes.
+ * @param count The number of elements to transmit.
+ * @param stream The stream that a failure of the job is counted against.
  *
  * @return Success or fail.
  */
-result_t send_result(udp_socket_t *socket, correlation_result_t *result)
+static result_t start_stream_job(stream_job_t *job,
+                                 udp_socket_t *socket,
+                                 const void *data,
+                                 const size_t element_size,
+                                 const size_t count,
+                                 const stream_class_t stream)
 {
-    AbortIfNot(socket, fail);
-    AbortIfNot(result, fail);
+    AbortIfNot(job, fail);
+    AbortIfNot(finish_stream_job(job), fail);
 
-    char str[200];
+    AbortIfNot(init_transfer(&job->transfer, socket, data, element_size, count), fail);
+    job->stream = stream;
+    job->next_packet = 0;
+    job->failed = false;
+    job->last_progress = get_system_time();
+    job->active = true;
 
-    /*
-     * Format the result into an standard message.
-     */
-    sprintf(str, "Result - 1: %"PRId32" 2: %"PRId32" 3: %"PRId32"\n",
-            result->channel_delay_ns[0],
-            result->channel_delay_ns[1],
-            result->channel_delay_ns[2]);
+    return success;
+}
+
+/**
+ * Completes a stream job whose packets have all been released.
+ *
+ * @note A job can only fail because the link could not keep up, so a failed
+ *       job is counted as a dropped transfer of its stream.
+ *
+ * @param job The stream job.
+ *
+ * @return None.
+ */
+static void complete_stream_job(stream_job_t *job)
+{
+    job->active = false;
+    if (job->failed)
+    {
+        backpressure_stats.dropped[job->stream]++;
+    }
+
+    if (job->complete)
+    {
+        job->complete(job, (job->failed)? fail : success, job->callback_arg);
+    }
+}
+
+/**
+ * Begins sending sampled data in the background.
+ *
+ * @note Only raw transfers are resumable. Delta coded and reliable transfers
+ *       are sent before this returns, and the job completes immediately.
+ *
+ * @param job The stream job to start.
+ * @param socket The connected socket to send data over.
+ * @param data The sample data to send, which must not be modified until the
+ *        job is done.
+ * @param count The number of samples to transmit.
+ *
+ * @return Success or fail.
+ */
+result_t start_send_data(stream_job_t *job, udp_socket_t *socket, sample_t *data, const size_t count)
+{
+    AbortIfNot(job, fail);
+
+    if (reliable_transfer_enabled || data_encoding == STREAM_ENCODING_DELTA)
+    {
+        AbortIfNot(finish_stream_job(job), fail);
+        AbortIfNot(send_data(socket, data, count), fail);
+        return success;
+    }
+
+    AbortIfNot(finish_stream_job(job), fail);
+    if (shed_stream(STREAM_CLASS_SAMPLES, socket))
+    {
+        return success;
+    }
+
+    AbortIfNot(start_stream_job(job, socket, data, sizeof(sample_t), count, STREAM_CLASS_SAMPLES), fail);
+
+    return success;
+}
+
+/**
+ * Begins sending cross correlation data in the background.
+ *
+ * @param job The stream job to start.
+ * @param socket The connected socket to send data over.
+ * @param data The correlations to send, which must not be modified until the
+ *        job is done.
+ * @param count The number of correlations to transmit.
+ *
+ * @return Success or fail.
+ */
+result_t start_send_xcorr(stream_job_t *job, udp_socket_t *socket, correlation_t *data, const size_t count)
+{
+    AbortIfNot(job, fail);
+    AbortIfNot(data || count == 0, fail);
 
     /*
-     * Send the data over the socket.
+     * The selection shares the view buffer, so the previous job must be done
+     * before it is overwritten.
      */
-    AbortIfNot(send_udp(socket, str, strlen(str)), fail);
+    AbortIfNot(finish_stream_job(job), fail);
+    if (shed_stream(STREAM_CLASS_XCORR, socket))
+    {
+        return success;
+    }
+
+    if (xcorr_view == XCORR_VIEW_FULL || count == 0)
+    {
+        AbortIfNot(start_stream_job(job, socket, data, sizeof(correlation_t), count, STREAM_CLASS_XCORR), fail);
+        return success;
+    }
+
+    const size_t selected = select_xcorr_view(data, count);
+    AbortIfNot(start_stream_job(job,
+                                socket,
+                                xcorr_view_buffer,
+                                sizeof(correlation_t),
+                                selected,
+                                STREAM_CLASS_XCORR), fail);
 
     return success;
 }
 
 /**
- * Transmits sampled data.
+ * Sends the next datagrams of a stream job that the rate limit allows without
+ * waiting.
  *
- * @param socket The connected socket to send data over.
- * @param data The sample data to send.
- * @param count The number of samples to transmit.
+ * @note A datagram that cannot be sent fails the job, which is reported once
+ *       its queued datagrams are released.
+ *
+ * @param job The stream job to service.
  *
  * @return Success or fail.
  */
-result_t send_data(udp_socket_t *socket, sample_t *data, const size_t count)
+result_t service_stream_job(stream_job_t *job)
 {
-    #define samples_per_packet 300
-    char buf[8 * samples_per_packet + 5];
+    AbortIfNot(job, fail);
 
-    int i;
-    for (i = 0; (i + samples_per_packet) < count; i += samples_per_packet)
+    if (!job->active)
     {
-        /*
-         * First, packet number in.
-         */
-        int packet_number = i / samples_per_packet;
-        memcpy(buf, &packet_number, 4);
-        for (int j = 0; j < samples_per_packet; ++j)
+        return success;
+    }
+
+    stream_transfer_t *transfer = &job->transfer;
+    size_t sent_packets = 0;
+    while (sent_packets < STREAM_JOB_PACKETS_PER_SERVICE && job->next_packet < transfer->num_packets)
+    {
+        bool sent;
+        if (!try_send_transfer_packet(transfer, job->next_packet, &job->tracker, &sent))
         {
-            memcpy(&buf[4 + j * 8], data[i + j].sample, 8);
+            job->failed = true;
+            job->next_packet = transfer->num_packets;
+            break;
         }
 
-        /*
-         * Send the data.
-         */
-        AbortIfNot(send_udp(socket, buf, 8 * samples_per_packet + 4), fail);
-        dispatch_network_stack();
-        busywait(micros_to_ticks(100));
+        if (!sent)
+        {
+            break;
+        }
+
+        job->next_packet++;
+        sent_packets++;
     }
 
-    /*
-     * If there is still data to send, send it in a smaller packet.
-     */
-    if (i < count)
+    if (sent_packets)
+    {
+        job->last_progress = get_system_time();
+        if (job->progress)
+        {
+            job->progress(job, job->callback_arg);
+        }
+    }
+
+    if (job->next_packet == transfer->num_packets && udp_refs_released(&job->tracker))
     {
-        size_t remainder = count - i;
+        complete_stream_job(job);
+    }
+
+    return success;
+}
+
+/**
+ * Checks if a stream job has finished.
+ *
+ * @param job The stream job to check.
+ *
+ * @return True if every datagram has been released.
+ */
+bool stream_job_done(const stream_job_t *job)
+{
+    return (!job || !job->active)? true : false;
+}
+
+/**
+ * Sends the rest of a stream job and waits for its datagrams to be released,
+ * so that its array may be reused.
+ *
+ * @note A job that stalls or fails because the link cannot keep up is
+ *       dropped rather than failing the caller.
+ *
+ * @param job The stream job to finish.
+ *
+ * @return Success or fail.
+ */
+result_t finish_stream_job(stream_job_t *job)
+{
+    AbortIfNot(job, fail);
 
-        int packet_number = i / samples_per_packet;
-        memcpy(buf, &packet_number, 4);
-        for (int j = 0; j < remainder; ++j)
+    while (job->active)
+    {
+        AbortIfNot(service_stream_job(job), fail);
+        if (!job->active)
         {
-            memcpy(&buf[4 + j * 8], data[i + j].sample, 8);
+            break;
         }
 
         /*
-         * Send the data.
+         * The rate limit releases a datagram well within the timeout, so a
+         * job that makes no progress has stalled in the driver. Its array is
+         * given up on, so datagrams the driver still holds may carry data of
+         * the next job.
          */
-        AbortIfNot(send_udp(socket, buf, 8 * remainder + 4), fail);
-        dispatch_network_stack();
+        if (get_system_time() - job->last_progress > ms_to_ticks(TRANSFER_IDLE_TIMEOUT_MS))
+        {
+            job->failed = true;
+            complete_stream_job(job);
+            break;
+        }
+
+        AbortIfNot(transmit_yield(), fail);
     }
 
+    job->failed = false;
+
     return success;
 }
 
-result_t send_xcorr(udp_socket_t *socket, correlation_t *data, const size_t count)
+/**
+ * The envelope of the most recent preview and the datagram it is sent in.
+ */
+static preview_point_t preview_points[PREVIEW_POINTS];
+static uint8_t preview_datagram[sizeof(preview_header_t) + sizeof(preview_points)];
+
+/**
+ * Transmits the envelope of a capture on the preview stream.
+ *
+ * @note The preview is a few kilobytes and is sent without the rate limit so
+ *       that it arrives ahead of any debug data from the same capture.
+ *
+ * @param socket The connected socket to send the preview over.
+ * @param start_tick The system time of the first sample.
+ * @param data The capture.
+ * @param count The number of samples in the capture.
+ *
+ * @return Success or fail.
+ */
+result_t send_preview(udp_socket_t *socket,
+                      const tick_t start_tick,
+                      const sample_t *data,
+                      const size_t count)
 {
+    static uint32_t sequence = 0;
+
     AbortIfNot(socket, fail);
     AbortIfNot(data, fail);
 
-    #define correlations_per_packet 50
-    char buf[16 * correlations_per_packet + 4];
+    if (shed_stream(STREAM_CLASS_PREVIEW, socket))
+    {
+        return success;
+    }
+
+    const size_t num_points = (count < PREVIEW_POINTS)? count : PREVIEW_POINTS;
+    AbortIfNot(compute_envelope(data, count, preview_points, num_points), fail);
+
+    const size_t mtu = get_network_mtu();
+    AbortIfNot(mtu > IP_HLEN + UDP_HLEN + sizeof(preview_header_t) + sizeof(preview_point_t), fail);
+    const size_t per_packet = (mtu - IP_HLEN - UDP_HLEN - sizeof(preview_header_t)) / sizeof(preview_point_t);
 
-    int i;
-    for (i = 0; (i + correlations_per_packet) < count; i += correlations_per_packet)
+    preview_header_t header;
+    header.version = PREVIEW_VERSION;
+    header.length = sizeof(header);
+    header.sequence = sequence++;
+    header.timestamp_us = ticks_to_micros(start_tick);
+    header.capture_samples = count;
+    header.samples_per_point = count / num_points;
+    header.total_points = num_points;
+    header.reserved = 0;
+
+    result_t ret = success;
+    for (size_t i = 0; i < num_points && ret == success; i += per_packet)
     {
-        /*
-         * First, packet number in.
-         */
-        int packet_number = i / correlations_per_packet;
-        memcpy(buf, &packet_number, 4);
-        for (int j = 0; j < correlations_per_packet; ++j)
+        header.first_point = i;
+        header.point_count = (num_points - i < per_packet)? num_points - i : per_packet;
+
+        const size_t points_len = header.point_count * sizeof(preview_point_t);
+        memcpy(preview_datagram, &header, sizeof(header));
+        memcpy(&preview_datagram[sizeof(header)], &preview_points[i], points_len);
+        ret = send_udp(socket, (char *)preview_datagram, sizeof(header) + points_len);
+        if (ret != success)
         {
-            memcpy(&buf[4 + j * 16], &data[i + j].left_shift, 4);
-            memcpy(&buf[4 + j * 16 + 4], data[i + j].result, 12);
+            transmit_congested = true;
         }
+    }
 
-        /*
-         * Send the data.
-         */
-        AbortIfNot(send_udp(socket, buf, 16 * correlations_per_packet + 4), fail);
-        dispatch_network_stack();
-        busywait(micros_to_ticks(100));
+    AbortIfNot(resolve_send(STREAM_CLASS_PREVIEW, ret), fail);
+
+    return success;
+}
+
+/**
+ * The densities of one channel of a survey and the datagram they are sent in.
+ */
+static int16_t survey_density[SURVEY_BINS(SURVEY_MAX_FFT_LEN)];
+static uint8_t survey_datagram[sizeof(survey_header_t) + sizeof(survey_density)];
+
+/**
+ * Transmits the averaged power spectral density of each channel of a survey.
+ *
+ * @note A survey is requested by the operator and is a few kilobytes, so it
+ *       is sent without the rate limit or shedding.
+ *
+ * @param socket The connected socket to send the survey over.
+ * @param survey The survey, which holds at least one segment.
+ * @param start_tick The system time of the first sample surveyed.
+ * @param sampling_frequency The sampling frequency of the samples surveyed.
+ *
+ * @return Success or fail.
+ */
+result_t send_survey(udp_socket_t *socket,
+                     const spectral_survey_t *survey,
+                     const tick_t start_tick,
+                     const uint32_t sampling_frequency)
+{
+    static uint32_t sequence = 0;
+
+    AbortIfNot(socket, fail);
+    AbortIfNot(survey, fail);
+
+    const size_t bins = SURVEY_BINS(survey->fft_len);
+    AbortIfNot(bins <= SURVEY_BINS(SURVEY_MAX_FFT_LEN), fail);
+
+    const size_t mtu = get_network_mtu();
+    AbortIfNot(mtu > IP_HLEN + UDP_HLEN + sizeof(survey_header_t) + sizeof(int16_t), fail);
+    const size_t per_packet = (mtu - IP_HLEN - UDP_HLEN - sizeof(survey_header_t)) / sizeof(int16_t);
+
+    survey_header_t header;
+    header.version = SURVEY_VERSION;
+    header.length = sizeof(header);
+    header.sequence = sequence++;
+    header.timestamp_us = ticks_to_micros(start_tick);
+    header.sampling_frequency = sampling_frequency;
+    header.fft_len = survey->fft_len;
+    header.segments = survey->segments;
+    header.total_bins = bins;
+
+    for (size_t channel = 0; channel < 4; ++channel)
+    {
+        AbortIfNot(get_survey_density(survey, channel, sampling_frequency, survey_density, bins), fail);
+
+        header.channel = channel;
+        for (size_t i = 0; i < bins; i += per_packet)
+        {
+            header.first_bin = i;
+            header.bin_count = (bins - i < per_packet)? bins - i : per_packet;
+
+            const size_t bins_len = header.bin_count * sizeof(int16_t);
+            memcpy(survey_datagram, &header, sizeof(header));
+            memcpy(&survey_datagram[sizeof(header)], &survey_density[i], bins_len);
+            AbortIfNot(send_udp(socket, (char *)survey_datagram, sizeof(header) + bins_len), fail);
+        }
     }
 
-    /*
-     * If there is still data to send, send it in a smaller packet.
-     */
-    if (i < count)
+    return success;
+}
+
+/**
+ * The number of datagrams of a recording sent by each call to
+ * service_record_queue(), which bounds how long a call can take.
+ */
+#define RECORD_PACKETS_PER_SERVICE 8
+
+/**
+ * Prepares an empty record queue.
+ *
+ * @param[out] queue The queue to prepare.
+ * @param socket The connected socket to stream recordings over.
+ * @param buffer The storage of the queue, which holds RECORD_QUEUE_DEPTH
+ *        windows of capacity samples.
+ * @param capacity The largest window that can be recorded in samples.
+ * @param copy_engine The engine that windows are copied in with, or NULL to
+ *        copy them with the processor.
+ * @param copy_flags The cache maintenance that recorded windows need before
+ *        the engine reads them, as copy_flags_t.
+ *
+ * @return Success or fail.
+ */
+result_t init_record_queue(record_queue_t *queue,
+                           udp_socket_t *socket,
+                           sample_t *buffer,
+                           const size_t capacity,
+                           copy_engine_t *copy_engine,
+                           const uint32_t copy_flags)
+{
+    AbortIfNot(queue, fail);
+    AbortIfNot(socket, fail);
+    AbortIfNot(buffer, fail);
+    AbortIfNot(capacity, fail);
+
+    queue->socket = socket;
+    for (size_t i = 0; i < RECORD_QUEUE_DEPTH; ++i)
+    {
+        queue->slots[i].data = &buffer[i * capacity];
+        queue->slots[i].count = 0;
+        init_copy_job(&queue->slots[i].copy);
+    }
+    queue->copy_engine = copy_engine;
+    queue->copy_flags = copy_flags;
+    queue->capacity = capacity;
+    queue->head = 0;
+    queue->len = 0;
+    queue->sending = false;
+    queue->next_packet = 0;
+    queue->recorded = 0;
+    queue->dropped = 0;
+
+    return success;
+}
+
+/**
+ * Discards every queued recording so that the storage of the queue can be
+ * released.
+ *
+ * @param queue The queue to flush.
+ *
+ * @return Success or fail.
+ */
+result_t flush_record_queue(record_queue_t *queue)
+{
+    AbortIfNot(queue, fail);
+
+    AbortIfNot(finish_record_copies(queue), fail);
+    AbortIfNot(wait_for_release(&queue->tracker), fail);
+    queue->dropped += queue->len;
+    queue->head = 0;
+    queue->len = 0;
+    queue->sending = false;
+
+    return success;
+}
+
+/**
+ * Waits for the windows being copied into a record queue, so that the
+ * buffers they are copied from may be overwritten.
+ *
+ * @note A window whose copy failed is sent as it is rather than faulting
+ *       acquisition.
+ *
+ * @param queue The queue to wait for.
+ *
+ * @return Success or fail.
+ */
+result_t finish_record_copies(record_queue_t *queue)
+{
+    AbortIfNot(queue, fail);
+
+    for (size_t i = 0; i < RECORD_QUEUE_DEPTH; ++i)
+    {
+        if (!finish_copy(&queue->slots[i].copy))
+        {
+            dblog(LOG_WARN, "Failed to copy a recording.\n");
+            init_copy_job(&queue->slots[i].copy);
+        }
+    }
+
+    return success;
+}
+
+/**
+ * Copies a window into a record queue to be streamed in the background.
+ *
+ * @note A window is dropped rather than waiting when the queue is full. The
+ *       copy may complete in the background, so the window must not be
+ *       overwritten until finish_record_copies() returns.
+ *
+ * @param queue The queue to record into.
+ * @param data The window to record.
+ * @param count The number of samples in the window, which may not exceed the
+ *        capacity of the queue.
+ *
+ * @return Success or fail.
+ */
+result_t push_record(record_queue_t *queue, const sample_t *data, const size_t count)
+{
+    AbortIfNot(queue, fail);
+    AbortIfNot(data, fail);
+    AbortIfNot(count, fail);
+    AbortIfNot(count <= queue->capacity, fail);
+
+    if (queue->len == RECORD_QUEUE_DEPTH)
+    {
+        queue->dropped++;
+        return success;
+    }
+
+    record_slot_t *slot = &queue->slots[(queue->head + queue->len) % RECORD_QUEUE_DEPTH];
+    AbortIfNot(start_copy(queue->copy_engine,
+                          &slot->copy,
+                          slot->data,
+                          data,
+                          count * sizeof(sample_t),
+                          queue->copy_flags), fail);
+    slot->count = count;
+    queue->len++;
+    queue->recorded++;
+
+    return success;
+}
+
+/**
+ * Sends the next datagrams of the queued recordings that the rate limit
+ * allows without waiting.
+ *
+ * @note Rate limit tokens are shared with the other streams, so a recording
+ *       only takes the bandwidth they leave, and it waits while results are
+ *       waiting to be resent.
+ *
+ * @param queue The queue to service.
+ *
+ * @return Success or fail.
+ */
+result_t service_record_queue(record_queue_t *queue)
+{
+    AbortIfNot(queue, fail);
+
+    if (backpressure_stats.results_pending)
+    {
+        return success;
+    }
+
+    for (size_t budget = RECORD_PACKETS_PER_SERVICE; budget && queue->len; --budget)
     {
-        size_t remainder = count - i;
+        record_slot_t *slot = &queue->slots[queue->head];
+        if (!queue->sending)
+        {
+            if (!copy_done(&slot->copy))
+            {
+                return success;
+            }
+
+            AbortIfNot(init_transfer(&queue->transfer,
+                                     queue->socket,
+                                     slot->data,
+                                     sizeof(sample_t),
+                                     slot->count), fail);
+            queue->sending = true;
+            queue->next_packet = 0;
+        }
 
-        int packet_number = i / correlations_per_packet;
-        memcpy(buf, &packet_number, 4);
-        for (int j = 0; j < remainder; ++j)
+        stream_transfer_t *transfer = &queue->transfer;
+        if (queue->next_packet == transfer->num_packets)
         {
-            memcpy(&buf[4 + j * 16], &data[i + j].left_shift, 4);
-            memcpy(&buf[4 + j * 16 + 4], data[i + j].result, 12);
+            if (!udp_refs_released(&queue->tracker))
+            {
+                return success;
+            }
+
+            queue->head = (queue->head + 1) % RECORD_QUEUE_DEPTH;
+            queue->len--;
+            queue->sending = false;
+            continue;
         }
 
         /*
-         * Send the data.
+         * A recording that cannot be sent is abandoned rather than faulting
+         * acquisition.
          */
-        AbortIfNot(send_udp(socket, buf, 16 * remainder + 4), fail);
-        dispatch_network_stack();
+        bool sent;
+        if (!try_send_transfer_packet(transfer, queue->next_packet, &queue->tracker, &sent))
+        {
+            queue->dropped++;
+            queue->next_packet = transfer->num_packets;
+            continue;
+        }
+
+        if (!sent)
+        {
+            return success;
+        }
+        queue->next_packet++;
     }
 
     return success;
-
 }
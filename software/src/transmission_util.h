@@ -1,13 +1,369 @@
 #ifndef TRANSMISSION_UTIL_H
 #define TRANSMISSION_UTIL_H
 
+#include "copy_engine.h"
+#include "spectral_survey.h"
+#include "stream_format.h"
+#include "system_params.h"
 #include "types.h"
 #include "udp.h"
 
-result_t send_result(udp_socket_t *socket, correlation_result_t *result);
+/**
+ * Defines the correlation results that are streamed.
+ */
+typedef enum xcorr_view_t
+{
+    /*
+     * Every lag is sent.
+     */
+    XCORR_VIEW_FULL = 0,
+
+    /*
+     * Every Nth lag is sent.
+     */
+    XCORR_VIEW_DECIMATED = 1,
+
+    /*
+     * The lags within N of the peak of any channel are sent.
+     */
+    XCORR_VIEW_PEAK = 2
+} xcorr_view_t;
+
+/**
+ * Defines the streams that share the link. Results are never dropped. They
+ * are queued and resent when the link cannot take them, and the other
+ * streams are shed while any are waiting.
+ */
+typedef enum stream_class_t
+{
+    STREAM_CLASS_RESULTS = 0,
+    STREAM_CLASS_SAMPLES = 1,
+    STREAM_CLASS_XCORR = 2,
+    STREAM_CLASS_PREVIEW = 3,
+    STREAM_CLASSES = 4
+} stream_class_t;
+
+/**
+ * Defines the outcome of sends made while the link could not keep up.
+ */
+typedef struct backpressure_stats_t
+{
+    /*
+     * The transfers of each stream_class_t that were dropped, either because
+     * the link timed out or because results were waiting.
+     */
+    uint32_t dropped[STREAM_CLASSES];
+
+    /*
+     * The results that could not be sent immediately, those later resent,
+     * those waiting now, and those lost because the queue overflowed.
+     */
+    uint32_t results_deferred;
+    uint32_t results_retried;
+    uint32_t results_pending;
+    uint32_t results_lost;
+} backpressure_stats_t;
+
+/**
+ * The number of retransmit ranges that may be pending at once.
+ */
+#define TRANSFER_MAX_RESEND_RANGES 32
+
+/**
+ * Defines a transfer of an array whose datagrams can be retransmitted until
+ * the receiver acknowledges it.
+ */
+typedef struct stream_transfer_t
+{
+    udp_socket_t *socket;
+    const uint8_t *data;
+    size_t element_size;
+    size_t count;
+    size_t per_packet;
+    size_t num_packets;
+    uint16_t transfer_id;
+
+    /*
+     * Specified true while the array is held for retransmission.
+     */
+    bool active;
+    bool acknowledged;
+
+    /*
+     * Inclusive ranges of packet numbers requested by the receiver.
+     */
+    uint32_t resend_first[TRANSFER_MAX_RESEND_RANGES];
+    uint32_t resend_last[TRANSFER_MAX_RESEND_RANGES];
+    size_t num_resend;
+
+    tick_t last_activity;
+} stream_transfer_t;
+
+/**
+ * Defines a transfer of an array that is sent in the background, a bounded
+ * number of datagrams at a time. The array must not be modified until the
+ * job is done.
+ */
+typedef struct stream_job_t
+{
+    stream_transfer_t transfer;
+    size_t next_packet;
+    udp_ref_tracker_t tracker;
+
+    /*
+     * Specified true from the start of the job until every datagram has been
+     * released, and specified true if a datagram could not be sent.
+     */
+    bool active;
+    bool failed;
+    tick_t last_progress;
+
+    /*
+     * The stream that a failed job is counted against.
+     */
+    stream_class_t stream;
+
+    /*
+     * Called after each service that sent datagrams, and once all of them
+     * are released with the outcome of the job. Either may be NULL.
+     */
+    void (*progress)(struct stream_job_t *job, void *arg);
+    void (*complete)(struct stream_job_t *job, const result_t result, void *arg);
+    void *callback_arg;
+} stream_job_t;
+
+/**
+ * Defines the times at which the stages of processing a ping finished. A time
+ * of zero marks a stage that was not timed.
+ */
+typedef struct ping_stages_t
+{
+    /*
+     * The capture holding the ping completed.
+     */
+    tick_t capture_complete;
+
+    /*
+     * The window of the ping was located and cut from the capture.
+     */
+    tick_t window_located;
+
+    /*
+     * The correlations of the ping were evaluated.
+     */
+    tick_t processed;
+
+    /*
+     * The bearing of the ping was solved and tracked.
+     */
+    tick_t solved;
+} ping_stages_t;
+
+/**
+ * Defines a window of samples waiting in a record queue, and the copy that
+ * fills it.
+ */
+typedef struct record_slot_t
+{
+    sample_t *data;
+    size_t count;
+    copy_job_t copy;
+} record_slot_t;
+
+/**
+ * Defines a queue of recorded windows that are streamed in the background, a
+ * few datagrams at a time, so that recording never delays a capture.
+ */
+typedef struct record_queue_t
+{
+    udp_socket_t *socket;
+    record_slot_t slots[RECORD_QUEUE_DEPTH];
+
+    /*
+     * The engine that windows are copied in with, or NULL to copy them with
+     * the processor, and the cache maintenance that their source needs.
+     */
+    copy_engine_t *copy_engine;
+    uint32_t copy_flags;
+
+    size_t capacity;
+    size_t head;
+    size_t len;
+
+    /*
+     * The transfer of the window at the head of the queue and the next of
+     * its packets to send. The window is released once the Ethernet driver
+     * has released every packet.
+     */
+    stream_transfer_t transfer;
+    bool sending;
+    size_t next_packet;
+    udp_ref_tracker_t tracker;
+
+    uint32_t recorded;
+    uint32_t dropped;
+} record_queue_t;
+
+/**
+ * Defines a token bucket that limits the rate of streamed data.
+ */
+typedef struct transmit_rate_t
+{
+    uint32_t bytes_per_second;
+    uint32_t burst_bytes;
+    int64_t tokens;
+    tick_t last_refill;
+
+    /*
+     * Called repeatedly while a stream waits for tokens or the Ethernet
+     * driver, so that other work is not stalled.
+     */
+    result_t (*idle)(void *arg);
+    void *idle_arg;
+} transmit_rate_t;
+
+/**
+ * Defines the period around a planned capture window in which streamed data
+ * is held, so that the capture does not share the CPU, the interrupt
+ * controller and DDR with bulk transmissions.
+ */
+typedef struct transmit_quiet_t
+{
+    bool enabled;
+
+    /*
+     * The period of the next window, which opens TRANSMIT_QUIET_LEAD_US
+     * before it and is ended early once the window has been captured.
+     */
+    bool scheduled;
+    tick_t start;
+    tick_t end;
+
+    /*
+     * The total time that streams have waited for a quiet period to end.
+     */
+    tick_t held;
+} transmit_quiet_t;
+
+/**
+ * Defines the stream of samples sent as raw Ethernet frames to one station
+ * on a dedicated link.
+ */
+typedef struct raw_stream_t
+{
+    bool enabled;
+    uint8_t destination[6];
+
+    /*
+     * The sequence number of the next frame and the identifier of the last
+     * transfer.
+     */
+    uint32_t sequence;
+    uint16_t transfer_id;
+} raw_stream_t;
+
+result_t set_transmit_rate(const uint32_t bytes_per_second, const uint32_t burst_bytes);
+
+uint32_t get_transmit_rate();
+
+void set_transmit_idle(result_t (*idle)(void *arg), void *arg);
+
+void set_transmit_quiet_enabled(const bool enabled);
+
+void schedule_transmit_quiet(const tick_t window_start, const tick_t window_end);
+
+void end_transmit_quiet();
+
+tick_t get_transmit_quiet_remaining();
+
+tick_t get_transmit_held_ticks();
+
+void set_data_encoding(const stream_encoding_t encoding);
+
+void set_reliable_transfer(const bool enabled);
+
+result_t set_xcorr_view(const xcorr_view_t view, const uint32_t parameter);
+
+bool handle_transfer_command(const char *text);
+
+result_t service_result_retries();
+
+result_t set_result_batch_delay(const uint32_t delay_ms);
+
+result_t flush_results();
+
+result_t service_result_batch();
+
+void get_backpressure_stats(backpressure_stats_t *stats);
+
+result_t send_result(udp_socket_t *socket,
+                     const uint32_t frequency,
+                     const uint32_t sequence,
+                     const tick_t ping_tick,
+                     const trigger_mark_t *trigger,
+                     const bearing_estimate_t *track,
+                     const correlation_result_t *result,
+                     const correlation_result_t *average,
+                     const uint32_t averaged_pings,
+                     const tick_t filter_duration,
+                     const tick_t correlation_duration,
+                     const ping_stages_t *stages);
 
 result_t send_data(udp_socket_t *socket, sample_t *data, const size_t count);
 
+void set_raw_stream(const bool enabled, const uint8_t destination[6]);
+
+bool raw_stream_enabled();
+
+result_t send_raw_data(const sample_t *data, const size_t count);
+
+result_t init_transmit_layout(segmented_layout_t *layout,
+                              void *buffer,
+                              const size_t bytes,
+                              const size_t samples_per_packet);
+
+result_t send_segmented_data(udp_socket_t *socket, const segmented_layout_t *layout, const size_t count);
+
 result_t send_xcorr(udp_socket_t *socket, correlation_t *correlation, const size_t count);
 
+void set_stream_job_callbacks(stream_job_t *job,
+                              void (*progress)(stream_job_t *job, void *arg),
+                              void (*complete)(stream_job_t *job, const result_t result, void *arg),
+                              void *arg);
+
+result_t start_send_data(stream_job_t *job, udp_socket_t *socket, sample_t *data, const size_t count);
+
+result_t start_send_xcorr(stream_job_t *job, udp_socket_t *socket, correlation_t *data, const size_t count);
+
+result_t service_stream_job(stream_job_t *job);
+
+bool stream_job_done(const stream_job_t *job);
+
+result_t finish_stream_job(stream_job_t *job);
+
+result_t send_survey(udp_socket_t *socket,
+                     const spectral_survey_t *survey,
+                     const tick_t start_tick,
+                     const uint32_t sampling_frequency);
+
+result_t send_preview(udp_socket_t *socket,
+                      const tick_t start_tick,
+                      const sample_t *data,
+                      const size_t count);
+
+result_t init_record_queue(record_queue_t *queue,
+                           udp_socket_t *socket,
+                           sample_t *buffer,
+                           const size_t capacity,
+                           copy_engine_t *copy_engine,
+                           const uint32_t copy_flags);
+
+result_t flush_record_queue(record_queue_t *queue);
+
+result_t finish_record_copies(record_queue_t *queue);
+
+result_t push_record(record_queue_t *queue, const sample_t *data, const size_t count);
+
+result_t service_record_queue(record_queue_t *queue);
+
 #endif
@@ -40,6 +40,119 @@ typedef struct sample
     analog_sample_t sample[4];
 } sample_t;
 
+/**
+ * Defines a read-only view of the channels of a capture, which may be stored
+ * as interleaved samples or as a separate array per channel. Sample i of
+ * channel k is channel[k][i * stride].
+ */
+typedef struct channel_view_t
+{
+    const analog_sample_t *channel[4];
+    size_t stride;
+    size_t len;
+} channel_view_t;
+
+/**
+ * Defines running estimates of the offset and noise of each channel, which
+ * are accumulated one sample at a time.
+ */
+typedef struct noise_stats_t
+{
+    size_t count;
+    float mean[4];
+
+    /*
+     * The sum of squared differences from the running mean.
+     */
+    float m2[4];
+} noise_stats_t;
+
+/**
+ * Defines a cell-averaging CFAR detector on one channel of a stream. Each
+ * sample is compared against a multiple of the mean rectified level of the
+ * training cells that precede it, which are separated from it by guard
+ * cells so that the leading edge of a ping does not raise its own threshold.
+ */
+typedef struct cfar_detector_t
+{
+    /*
+     * The multiple of the mean level that a sample must exceed, and the
+     * offset removed from each sample before it is rectified.
+     */
+    uint32_t scale;
+    analog_sample_t offset;
+
+    /*
+     * The sum of the rectified training cells of the next sample, and the
+     * number of samples of the stream that have been searched.
+     */
+    uint32_t sum;
+    size_t processed;
+} cfar_detector_t;
+
+/**
+ * Defines a decimator that averages each run of factor samples of the four
+ * channels of a stream into one sample, carrying a partial run from one
+ * chunk of the stream to the next.
+ */
+typedef struct boxcar_decimator_t
+{
+    size_t factor;
+
+    /*
+     * The reciprocal of the factor in Q12.
+     */
+    int32_t reciprocal;
+
+    /*
+     * The sum of each channel over the partial run and its length.
+     */
+    int32_t sum[4];
+    size_t count;
+} boxcar_decimator_t;
+
+/**
+ * Defines a capture buffer that is divided into segments of samples, each
+ * preceded by a gap of reserved bytes. Sample i of the capture is held in
+ * segment i / segment_samples.
+ */
+typedef struct segmented_layout_t
+{
+    uint8_t *base;
+    size_t segment_samples;
+    size_t num_segments;
+
+    /*
+     * The bytes reserved ahead of each segment, and the distance in bytes
+     * from the start of one segment to the next. Both are whole cache lines.
+     */
+    size_t gap_bytes;
+    size_t stride_bytes;
+} segmented_layout_t;
+
+/**
+ * Defines the offset, the RMS about the offset, and the number of samples at
+ * either rail of the ADC of each channel of a capture, measured while it is
+ * normalized.
+ */
+typedef struct channel_stats_t
+{
+    size_t count;
+    analog_sample_t offset[4];
+    float rms[4];
+    uint32_t clipped_samples[4];
+} channel_stats_t;
+
+/**
+ * Defines a capture stored as a contiguous array per channel.
+ */
+typedef struct planar_samples_t
+{
+    analog_sample_t *channel[4];
+    size_t capacity;
+    size_t len;
+} planar_samples_t;
+
 typedef struct correlation_t
 {
     int32_t left_shift;
@@ -56,14 +169,172 @@ typedef struct correlation_result_t
      */
     int32_t channel_delay_ns[3];
 
+    /**
+     * Specifies the normalized correlation peak of each channel with the
+     * reference channel, between -1 and 1.
+     */
+    float confidence[3];
+
+    /**
+     * Specifies the largest absolute sample of each channel in the
+     * correlated window.
+     */
+    analog_sample_t peak_amplitude[4];
+
+    /**
+     * Specifies the direction of the pinger in degrees. The bearing is
+     * measured from the x axis towards the y axis of the array, and the
+     * elevation above its x-y plane.
+     */
+    float bearing_deg;
+    float elevation_deg;
+
+    /**
+     * Specifies the length of the direction solved from the delays, which is
+     * near one when the delays agree with the array geometry, or zero if no
+     * direction was solved.
+     */
+    float direction_norm;
+
+    /**
+     * Specifies the quality score of the ping between 0 and 1, which is
+     * estimated from the window before it is correlated.
+     */
+    float quality;
+
+    /**
+     * Specified true if the delays were taken from the leading edges of the
+     * channels rather than from their correlations, in which case each
+     * confidence falls from one as the timing uncertainty of the pair grows,
+     * and the largest uncertainty of a pair in nanoseconds.
+     */
+    bool leading_edge;
+    float edge_uncertainty_ns;
+
 } correlation_result_t;
 
+/**
+ * Flags of a bearing estimate. The estimate is only valid once the tracker
+ * is locked, and an outlier is a ping whose delays fell outside the gate
+ * around the prediction and were left out of the estimate.
+ */
+#define BEARING_TRACK_LOCKED (1 << 0)
+#define BEARING_TRACK_OUTLIER (1 << 1)
+#define BEARING_TRACK_RESTARTED (1 << 2)
+
+/**
+ * Defines the estimate of the bearing tracker after a ping.
+ */
+typedef struct bearing_estimate_t
+{
+    /*
+     * The filtered delay of channels A, B, and C from channel 0, its rate of
+     * change, and its variance, which are independent between channels.
+     */
+    float delay_ns[3];
+    float delay_rate_ns_per_s[3];
+    float delay_variance_ns2[3];
+
+    /*
+     * The direction solved from the filtered delays.
+     */
+    float bearing_deg;
+    float elevation_deg;
+
+    uint16_t flags;
+
+    /*
+     * The number of consecutive outliers.
+     */
+    uint16_t outliers;
+} bearing_estimate_t;
+
+/**
+ * Defines an edge of the external trigger input, latched by the FPGA in the
+ * timestamps of the sample stream.
+ */
+typedef struct trigger_mark_t
+{
+    /*
+     * The number of edges since reset, which is zero if there was none.
+     */
+    uint32_t count;
+
+    /*
+     * The timestamp of the sample taken as the edge arrived, and the system
+     * time of that sample.
+     */
+    uint64_t sample;
+    tick_t tick;
+} trigger_mark_t;
+
+/**
+ * Defines the estimated quality of a located ping. It is measured from the
+ * truncated window so that poor pings can be rejected before correlation.
+ */
+typedef struct ping_quality_t
+{
+    /**
+     * Specifies the ratio of the power after the onset to the power before
+     * it on the weakest channel in dB, or zero if too few samples precede
+     * the onset to measure the noise.
+     */
+    float snr_db;
+
+    /**
+     * Specifies the number of samples, over all channels, that repeat the
+     * previous sample at the extreme of their channel, which is where a
+     * clipped ping flattens.
+     */
+    uint32_t clipped_samples;
+
+    /**
+     * Specifies the peak of the reference channel shortly after the onset as
+     * a fraction of its peak after the onset. The direct path arrives first,
+     * so a ping that builds up slowly is dominated by reflections.
+     */
+    float onset_sharpness;
+
+    /**
+     * Specifies the combined quality score between 0 and 1.
+     */
+    float score;
+
+} ping_quality_t;
+
+/**
+ * Defines the leading edge of the direct path on each channel, where its
+ * rectified and smoothed envelope first reaches a fraction of its peak.
+ */
+typedef struct leading_edges_t
+{
+    /**
+     * Specifies the first sample at or above the fraction of the peak, and
+     * the crossing interpolated between it and the sample before.
+     */
+    size_t index[4];
+    float position[4];
+
+    /**
+     * Specifies the timing uncertainty of each crossing in samples, which is
+     * the deviation of the smoothed noise before it over the rise of the
+     * envelope at it.
+     */
+    float uncertainty[4];
+
+} leading_edges_t;
+
 typedef struct filter_coefficients_t
 {
     float coefficients[6];
 
 } filter_coefficients_t;
 
+/**
+ * The maximum number of pingers that can be tracked simultaneously.
+ */
+#define MAX_PINGERS 4
+
 /**
  * Defines configurable parameters of the board.
  */
@@ -75,15 +346,28 @@ typedef struct HydroZynqParameters
     uint32_t samples_per_packet;
 
     /**
-     * Specifies the sampling frequency divider.
+     * Specifies the rate at which the ADC samples before decimation, in Hz.
      */
-    uint32_t sample_clk_div;
+    uint32_t sampling_frequency;
 
     /**
      * Specifies the threshold value that denotes a ping.
      */
     analog_sample_t ping_threshold;
 
+    /**
+     * Specifies the frequency of the pinger in Hz. Zero specifies that pings
+     * are detected by a broadband threshold.
+     */
+    uint32_t ping_frequency;
+
+    /**
+     * Specifies the frequencies of additional pingers that are separated from
+     * each capture by a filter bank.
+     */
+    uint32_t pinger_frequencies[MAX_PINGERS];
+    uint32_t num_pingers;
+
     /*
      * Specifies the number of ticks before the threshold detection of a ping
      * to perform a correlation for.
@@ -101,6 +385,163 @@ typedef struct HydroZynqParameters
      */
     bool filter;
 
+    /**
+     * Specified true if the FPGA threshold trigger should be used for sync.
+     */
+    bool hw_trigger;
+
+    /**
+     * Specified true if the FPGA should correlate the triggered window.
+     */
+    bool hw_correlate;
+
+    /**
+     * Specifies the channel that the other channels are correlated against
+     * and that the ping is detected on.
+     */
+    uint8_t reference_channel;
+
+    /**
+     * Specified true if every pair of channels should be correlated and the
+     * delays combined by least squares.
+     */
+    bool all_pairs;
+
+    /**
+     * Specified true if the ping may be detected on any channel.
+     */
+    bool trigger_any_channel;
+
+    /**
+     * Specified true if the offset should be estimated from the start of the
+     * capture and removed only from the correlated window.
+     */
+    bool window_normalize;
+
+    /**
+     * Specifies the ping threshold as a multiple of the noise RMS measured at
+     * the start of the capture. Zero uses the fixed ping threshold.
+     */
+    uint8_t noise_threshold;
+
+    /**
+     * Specifies the ping threshold as a multiple of the mean rectified level
+     * of the samples shortly before each sample, so that it follows the noise
+     * floor of each channel through the capture (cell-averaging CFAR). Zero
+     * uses the noise or fixed ping threshold.
+     */
+    uint8_t cfar_threshold;
+
+    /**
+     * Specifies the lowest normalized correlation, in percent, between the
+     * reference channel and the uploaded pinger waveform template that
+     * denotes a ping while acquiring sync. Zero, or no template, uses the
+     * other detectors.
+     */
+    uint8_t matched_threshold;
+
+    /**
+     * Specifies the lowest quality score, in percent, of a ping that is
+     * correlated and relayed. Zero correlates every located ping.
+     */
+    uint8_t min_ping_quality;
+
+    /**
+     * Specified true if the cross spectra are whitened by the phase transform
+     * (GCC-PHAT) so that reflections smear the correlation peak less.
+     */
+    bool phat;
+
+    /**
+     * Specified true if the window is trimmed to the leading edge of the
+     * direct path found on the envelope of each channel.
+     */
+    bool envelope_onset;
+
+    /**
+     * Specifies the number of pings that correlations are averaged over, or
+     * zero to keep no average, and whether the average is exponential with a
+     * time constant of that many pings rather than the mean of the window.
+     */
+    uint8_t average_pings;
+    bool average_exponential;
+
+    /**
+     * Specifies the number of pings between full correlations while the
+     * delays are taken from the leading edges of the channels, or zero or
+     * one to correlate every ping. A ping whose leading edges are uncertain
+     * is always correlated.
+     */
+    uint8_t fast_tdoa_interval;
+
+    /**
+     * Specified true if the ping is located on the unfiltered capture and
+     * only its window, after a margin that the filter settles over, is
+     * filtered and located again. The rest of the capture is left
+     * unfiltered.
+     */
+    bool lazy_filter;
+
+    /**
+     * Specified true if the lags are first searched on decimated channels
+     * and only refined at the full rate around the coarse peaks.
+     */
+    bool coarse_search;
+
+    /**
+     * Specified true if only the lags around those predicted from recent
+     * confident pings are searched.
+     */
+    bool track_lags;
+
+    /**
+     * Specifies the factor that the filtered channels are decimated by before
+     * the ping is located and correlated, or zero or one to process them at
+     * the full rate.
+     */
+    uint8_t dsp_decimation;
+
+    /**
+     * Specified true if sync is acquired from the envelope streamed by the
+     * FPGA rather than from captured samples.
+     */
+    bool hw_envelope;
+
+    /**
+     * Specified true if sync is acquired from a decimated detection stream
+     * while the samples are recorded into a bounded full-rate ring, of which
+     * only the window around a flagged crossing is processed at the full
+     * rate.
+     */
+    bool dual_rate;
+
+    /**
+     * Specified true if the stream carries only the reference channel while
+     * sync is acquired, which the bitstream must support.
+     */
+    bool masked_sync;
+
+    /**
+     * Specified true if the ADC is recorded into a ring at all times and each
+     * ping is extracted from its history once it is detected, rather than
+     * captured in a window planned around the predicted ping.
+     */
+    bool continuous_capture;
+
+    /**
+     * Specifies the number of DMA descriptor completions coalesced into each
+     * interrupt, and the longest time in microseconds that a completion waits
+     * for the rest once the stream idles.
+     */
+    uint32_t dma_irq_threshold;
+    uint32_t dma_irq_delay_us;
+
+    /**
+     * Specifies the accelerator module loaded into the reconfigurable region
+     * of the fabric, or zero to leave the region as it is.
+     */
+    uint32_t accelerator_module;
+
 } HydroZynqParams;
 
 #endif
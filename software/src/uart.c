@@ -3,23 +3,141 @@
 
 #include "stdarg.h"
 #include "string.h"
-#include "stdio.h"
+#include "system.h"
 #include "system_params.h"
+#include "text_format.h"
 #include "abort.h"
 #include "udp.h"
 #include "lwip/ip.h"
 
-void uart_putchar(char c)
+/**
+ * Characters waiting for room in the UART FIFO. The ring is only used once
+ * enable_uart_interrupts() has been called.
+ */
+static char uart_tx_buffer[UART_TX_BUFFER_SIZE];
+static volatile size_t uart_tx_head = 0;
+static volatile size_t uart_tx_tail = 0;
+static volatile uint32_t uart_tx_dropped = 0;
+static bool uart_interrupts_enabled = false;
+
+/**
+ * Moves buffered characters into the UART FIFO until either is exhausted.
+ *
+ * @note Must be called with interrupts masked or from the UART interrupt.
+ *
+ * @return None.
+ */
+static void fill_uart_fifo()
 {
-    /*
-     * Wait for the UART FIFO to not be full.
-     */
-    while (uart_regs->Status_Register & (1 << 4));
+    while (uart_tx_tail != uart_tx_head &&
+            !(uart_regs->Status_Register & UART_TX_FULL))
+    {
+        uart_regs->TX_RX_FIFO = uart_tx_buffer[uart_tx_tail];
+        uart_tx_tail = (uart_tx_tail + 1) % UART_TX_BUFFER_SIZE;
+    }
 
     /*
-     * Write the character to the UART FIFO.
+     * Only interrupt on an empty FIFO while there is more to send.
      */
-    uart_regs->TX_RX_FIFO = c;
+    if (uart_tx_tail == uart_tx_head)
+    {
+        uart_regs->Interrupt_Disable = UART_TX_EMPTY;
+    }
+    else
+    {
+        uart_regs->Interrupt_Enable = UART_TX_EMPTY;
+    }
+}
+
+/**
+ * Refills the UART FIFO once it has emptied.
+ *
+ * @param arg Unused.
+ *
+ * @return None.
+ */
+static void uart_interrupt_handler(void *arg)
+{
+    uart_regs->Channel_Interrupt_Status = uart_regs->Channel_Interrupt_Status;
+
+    fill_uart_fifo();
+}
+
+/**
+ * Drains UART output from the TX FIFO empty interrupt so that writing a
+ * character never waits on the serial line.
+ *
+ * @note Characters that do not fit in the buffer are dropped and counted.
+ *
+ * @return Success or fail.
+ */
+result_t enable_uart_interrupts()
+{
+    uart_regs->Interrupt_Disable = UART_TX_EMPTY;
+    uart_regs->Channel_Interrupt_Status = UART_TX_EMPTY;
+
+    AbortIfNot(register_interrupt(UART_IRQ_ID, uart_interrupt_handler, NULL, IRQ_PRIORITY_BACKGROUND), fail);
+
+    uart_interrupts_enabled = true;
+
+    return success;
+}
+
+/**
+ * Gets the number of characters dropped because the TX buffer was full.
+ *
+ * @return The number of dropped characters.
+ */
+uint32_t get_uart_dropped()
+{
+    return uart_tx_dropped;
+}
+
+/**
+ * Waits for every buffered character to be written to the UART FIFO.
+ *
+ * @return None.
+ */
+void flush_uart()
+{
+    const uint32_t state = save_and_disable_interrupts();
+    while (uart_tx_tail != uart_tx_head)
+    {
+        fill_uart_fifo();
+    }
+    restore_interrupts(state);
+}
+
+void uart_putchar(char c)
+{
+    if (!uart_interrupts_enabled || get_cpu_id() != 0)
+    {
+        /*
+         * Wait for the UART FIFO to not be full.
+         */
+        while (uart_regs->Status_Register & UART_TX_FULL);
+
+        /*
+         * Write the character to the UART FIFO.
+         */
+        uart_regs->TX_RX_FIFO = c;
+        return;
+    }
+
+    const uint32_t state = save_and_disable_interrupts();
+    const size_t next = (uart_tx_head + 1) % UART_TX_BUFFER_SIZE;
+    if (next == uart_tx_tail)
+    {
+        uart_tx_dropped++;
+    }
+    else
+    {
+        uart_tx_buffer[uart_tx_head] = c;
+        uart_tx_head = next;
+    }
+
+    fill_uart_fifo();
+    restore_interrupts(state);
 }
 
 void print_string(char *str)
@@ -35,7 +153,7 @@ void uprintf(const char fmt[], ...)
     char str[256];
     va_list args;
     va_start(args, fmt);
-    vsprintf(str, fmt, args);
+    vformat_text(str, sizeof(str), fmt, args);
     va_end(args);
 
     print_string(str);
@@ -3,6 +3,17 @@
 
 #include "types.h"
 
+/**
+ * The number of characters buffered for the UART transmitter.
+ */
+#define UART_TX_BUFFER_SIZE 4096
+
+result_t enable_uart_interrupts();
+
+uint32_t get_uart_dropped();
+
+void flush_uart();
+
 void print_string(char *str);
 
 void uprintf(const char fmt[], ...);
@@ -1,10 +1,252 @@
 #include "udp.h"
 
 #include "abort.h"
+#include "l2_lockdown.h"
+#include "net_core.h"
+#include "system.h"
+#include "trace.h"
 #include "types.h"
+#include "lwip/mem.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "lwip/sys.h"
 #include "lwip/udp.h"
 #include <string.h>
 
+/**
+ * The number of datagrams that may reference caller memory at once.
+ */
+#define UDP_REF_POOL_SIZE 32
+
+/**
+ * The largest header that may be prepended to a referenced payload, and the
+ * storage of each header, which leaves room ahead of it for the UDP, IP and
+ * Ethernet headers at the alignment of the lwIP heap.
+ */
+#define UDP_REF_HEADER_MAX 64
+#define UDP_REF_HEADER_STORAGE (LWIP_MEM_ALIGN_SIZE(PBUF_LINK_HLEN + PBUF_IP_HLEN + PBUF_TRANSPORT_HLEN) + \
+                                UDP_REF_HEADER_MAX)
+
+/**
+ * Defines a pbuf that references caller memory. The pbuf must be the first
+ * member so that the free callback can recover the entry.
+ */
+typedef struct udp_ref_t
+{
+    struct pbuf_custom custom;
+    udp_ref_tracker_t *tracker;
+    struct udp_ref_t *next;
+
+    /*
+     * The header and payload pbufs are freed separately, so the entry is
+     * returned once neither is in use.
+     */
+    uint32_t pending;
+} udp_ref_t;
+
+/**
+ * Defines the preallocated header pbuf of a referencing datagram. The pbuf
+ * must be first and the storage after it, because lwIP only prepends
+ * headers to memory that follows the pbuf.
+ */
+typedef struct udp_ref_header_t
+{
+    struct pbuf_custom custom;
+    udp_ref_t *ref;
+    uint8_t storage[UDP_REF_HEADER_STORAGE] __attribute__((aligned(MEM_ALIGNMENT)));
+} udp_ref_header_t;
+
+/**
+ * The pool of referencing pbufs and the list of those not in use.
+ */
+HOT_DATA static udp_ref_t udp_ref_pool[UDP_REF_POOL_SIZE];
+HOT_DATA static udp_ref_t * volatile udp_ref_free_list = NULL;
+HOT_DATA static bool udp_ref_pool_initialized = false;
+
+/**
+ * The header of each entry of the pool. Headers are cleaned from the cache
+ * for every datagram, so they are kept out of the locked hot section.
+ */
+static udp_ref_header_t udp_ref_headers[UDP_REF_POOL_SIZE];
+
+/**
+ * The number of datagrams that could not be sent.
+ */
+static uint32_t udp_send_failures = 0;
+
+/**
+ * The number of buffers for copied datagrams.
+ */
+#define UDP_TX_POOL_SIZE 32
+
+/**
+ * Defines a preallocated buffer of a copied datagram. As for the headers of
+ * referencing datagrams, the storage must follow the pbuf.
+ */
+typedef struct udp_tx_buffer_t
+{
+    struct pbuf_custom custom;
+    struct udp_tx_buffer_t *next;
+    uint8_t storage[LWIP_MEM_ALIGN_SIZE(PBUF_LINK_HLEN + PBUF_IP_HLEN + PBUF_TRANSPORT_HLEN) +
+                    UDP_TX_PAYLOAD_MAX] __attribute__((aligned(MEM_ALIGNMENT)));
+} udp_tx_buffer_t;
+
+/**
+ * The pool of buffers for copied datagrams and the list of those not in use.
+ */
+static udp_tx_buffer_t udp_tx_pool[UDP_TX_POOL_SIZE];
+static udp_tx_buffer_t * volatile udp_tx_free_list = NULL;
+static bool udp_tx_pool_initialized = false;
+
+/**
+ * The usage of the transmit pools.
+ */
+static udp_pool_stats_t udp_pool_stats = {0};
+
+/**
+ * The request that a send from CPU0 is built in while the network core owns
+ * the network stack. It is used with interrupts disabled, so that a send from
+ * a handler does not overwrite it.
+ */
+static net_request_t udp_request;
+
+/**
+ * Hands a send or connection to the network core.
+ *
+ * @param op The operation requested.
+ * @param socket The socket.
+ * @param ip The destination, or NULL for the connected destination.
+ * @param port The destination port.
+ * @param copied The bytes copied into the request.
+ * @param copied_len The number of bytes copied.
+ * @param data The memory of the caller referenced by the request, or NULL.
+ * @param len The length of the referenced memory.
+ * @param tracker The tracker to charge the reference to, or NULL.
+ *
+ * @return Success or fail if the request is not queued.
+ */
+static result_t post_udp_request(const net_request_op_t op,
+                                 udp_socket_t *socket,
+                                 struct ip_addr *ip,
+                                 const uint16_t port,
+                                 const void *copied,
+                                 const size_t copied_len,
+                                 const void *data,
+                                 const size_t len,
+                                 udp_ref_tracker_t *tracker)
+{
+    if (copied_len > sizeof(udp_request.copied))
+    {
+        udp_send_failures++;
+    }
+    AbortIfNot(copied_len <= sizeof(udp_request.copied), fail);
+
+    const uint32_t cpsr = save_and_disable_interrupts();
+    udp_request.op = op;
+    udp_request.socket = socket;
+    udp_request.addressed = (ip)? true : false;
+    if (ip)
+    {
+        ip_addr_copy(udp_request.addr, *ip);
+    }
+    udp_request.port = port;
+    udp_request.data = data;
+    udp_request.len = len;
+    udp_request.tracker = tracker;
+    udp_request.copied_len = copied_len;
+    if (copied_len)
+    {
+        memcpy(udp_request.copied, copied, copied_len);
+    }
+
+    const result_t ret = post_network_request(&udp_request);
+    if (!ret)
+    {
+        udp_send_failures++;
+    }
+    restore_interrupts(cpsr);
+
+    return ret;
+}
+
+/**
+ * Returns the buffer of a copied datagram to the pool once the driver has
+ * released it.
+ *
+ * @note This is called from the Ethernet transmit interrupt.
+ *
+ * @param p The pbuf being freed.
+ *
+ * @return None.
+ */
+static void release_udp_tx_buffer(struct pbuf *p)
+{
+    udp_tx_buffer_t *buffer = (udp_tx_buffer_t *)p;
+
+    SYS_ARCH_DECL_PROTECT(lev);
+    SYS_ARCH_PROTECT(lev);
+    buffer->next = udp_tx_free_list;
+    udp_tx_free_list = buffer;
+    udp_pool_stats.tx_used--;
+    SYS_ARCH_UNPROTECT(lev);
+}
+
+/**
+ * Allocates a pbuf for a copied datagram, from the preallocated pool when it
+ * fits and otherwise from the lwIP heap.
+ *
+ * @param len The length of the datagram.
+ *
+ * @return The pbuf, or NULL if none could be allocated.
+ */
+static struct pbuf *alloc_udp_tx_pbuf(const size_t len)
+{
+    udp_tx_buffer_t *buffer = NULL;
+
+    SYS_ARCH_DECL_PROTECT(lev);
+    SYS_ARCH_PROTECT(lev);
+
+    if (!udp_tx_pool_initialized)
+    {
+        for (size_t i = 0; i < UDP_TX_POOL_SIZE; ++i)
+        {
+            udp_tx_pool[i].next = udp_tx_free_list;
+            udp_tx_free_list = &udp_tx_pool[i];
+        }
+
+        udp_tx_pool_initialized = true;
+    }
+
+    if (len <= UDP_TX_PAYLOAD_MAX && udp_tx_free_list)
+    {
+        buffer = udp_tx_free_list;
+        udp_tx_free_list = buffer->next;
+        if (++udp_pool_stats.tx_used > udp_pool_stats.tx_max)
+        {
+            udp_pool_stats.tx_max = udp_pool_stats.tx_used;
+        }
+    }
+    else
+    {
+        udp_pool_stats.tx_misses++;
+    }
+
+    SYS_ARCH_UNPROTECT(lev);
+
+    if (!buffer)
+    {
+        return pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+    }
+
+    buffer->custom.custom_free_function = release_udp_tx_buffer;
+    return pbuf_alloced_custom(PBUF_TRANSPORT,
+                               len,
+                               PBUF_RAM,
+                               &buffer->custom,
+                               buffer->storage,
+                               sizeof(buffer->storage));
+}
+
 /**
  * Initializes a UDP socket.
  *
@@ -43,7 +285,12 @@ result_t sendto_udp(udp_socket_t *socket, struct ip_addr *ip, const uint16_t por
     AbortIfNot(ip, fail);
     AbortIfNot(data, fail);
 
-    struct pbuf *packet_buffer = pbuf_alloc(PBUF_TRANSPORT, strlen(data), PBUF_RAM);
+    if (!network_stack_owned())
+    {
+        return post_udp_request(NET_REQUEST_SEND, socket, ip, port, data, strlen(data), NULL, 0, NULL);
+    }
+
+    struct pbuf *packet_buffer = alloc_udp_tx_pbuf(strlen(data));
     AbortIfNot(packet_buffer, fail);
     memcpy(packet_buffer->payload, data, strlen(data));
 
@@ -54,34 +301,482 @@ result_t sendto_udp(udp_socket_t *socket, struct ip_addr *ip, const uint16_t por
     return ((ret == ERR_OK)? success : fail);
 }
 
+/**
+ * Sends a datagram to an address other than the one the socket is connected
+ * to.
+ *
+ * @param socket The socket to send from.
+ * @param ip The destination address.
+ * @param port The destination port.
+ * @param data The datagram to send.
+ * @param len The length of the datagram.
+ *
+ * @return Success or fail.
+ */
+result_t send_udp_to(udp_socket_t *socket, struct ip_addr *ip, const uint16_t port, const void *data, const size_t len)
+{
+    AbortIfNot(socket, fail);
+    AbortIfNot(ip, fail);
+    AbortIfNot(data, fail);
+
+    if (!network_stack_owned())
+    {
+        return post_udp_request(NET_REQUEST_SEND, socket, ip, port, data, len, NULL, 0, NULL);
+    }
+
+    struct pbuf *packet_buffer = alloc_udp_tx_pbuf(len);
+    AbortIfNot(packet_buffer, fail);
+    memcpy(packet_buffer->payload, data, len);
+
+    const err_t ret = udp_sendto(socket->pcb, packet_buffer, ip, port);
+
+    pbuf_free(packet_buffer);
+
+    return (ret == ERR_OK)? success : fail;
+}
+
 result_t connect_udp(udp_socket_t *socket, struct ip_addr *ip, const uint16_t port)
 {
     AbortIfNot(socket, fail);
     AbortIfNot(ip, fail);
 
+    if (!network_stack_owned())
+    {
+        return post_udp_request(NET_REQUEST_CONNECT, socket, ip, port, NULL, 0, NULL, 0, NULL);
+    }
+
     AbortIfNot(udp_connect(socket->pcb, ip, port) == ERR_OK, fail);
 
     return success;
 }
 
+HOT_CODE
 result_t send_udp(udp_socket_t *socket, char *data, size_t len)
 {
     AbortIfNot(socket, fail);
     AbortIfNot(data, fail);
 
-    struct pbuf *packet_buffer = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+    if (!network_stack_owned())
+    {
+        return post_udp_request(NET_REQUEST_SEND, socket, NULL, 0, data, len, NULL, 0, NULL);
+    }
+
+    struct pbuf *packet_buffer = alloc_udp_tx_pbuf(len);
+    if (!packet_buffer)
+    {
+        udp_send_failures++;
+    }
     AbortIfNot(packet_buffer, fail);
     memcpy(packet_buffer->payload, data, len);
 
     int ret = udp_send(socket->pcb, packet_buffer);
 
     pbuf_free(packet_buffer);
+    trace(TRACE_UDP_SEND, TRACE_INSTANT, len, ret == ERR_OK);
+
+    if (ret != ERR_OK)
+    {
+        udp_send_failures++;
+    }
+    AbortIfNot(ret == ERR_OK, fail);
+
+    return success;
+}
+
+/**
+ * Returns an entry to the pool once its header and payload have both been
+ * released by the driver.
+ *
+ * @note This is called from the Ethernet transmit interrupt.
+ *
+ * @param ref The entry whose pbuf is being freed.
+ *
+ * @return None.
+ */
+HOT_CODE
+static void put_udp_ref(udp_ref_t *ref)
+{
+    SYS_ARCH_DECL_PROTECT(lev);
+    SYS_ARCH_PROTECT(lev);
+    if (--ref->pending == 0)
+    {
+        udp_pool_stats.ref_used--;
+        __atomic_fetch_sub(&ref->tracker->outstanding, 1, __ATOMIC_SEQ_CST);
+        ref->next = udp_ref_free_list;
+        udp_ref_free_list = ref;
+    }
+    SYS_ARCH_UNPROTECT(lev);
+}
+
+/**
+ * Releases the payload of a referencing datagram.
+ *
+ * @param p The pbuf being freed.
+ *
+ * @return None.
+ */
+HOT_CODE
+static void release_udp_ref(struct pbuf *p)
+{
+    put_udp_ref((udp_ref_t *)p);
+}
+
+/**
+ * Releases the header of a referencing datagram.
+ *
+ * @param p The pbuf being freed.
+ *
+ * @return None.
+ */
+HOT_CODE
+static void release_udp_ref_header(struct pbuf *p)
+{
+    put_udp_ref(((udp_ref_header_t *)p)->ref);
+}
+
+/**
+ * Takes a referencing pbuf from the pool.
+ *
+ * @param tracker The tracker to charge the reference to.
+ *
+ * @return The entry, or NULL if the pool is exhausted.
+ */
+HOT_CODE
+static udp_ref_t *acquire_udp_ref(udp_ref_tracker_t *tracker)
+{
+    SYS_ARCH_DECL_PROTECT(lev);
+    SYS_ARCH_PROTECT(lev);
+
+    if (!udp_ref_pool_initialized)
+    {
+        for (size_t i = 0; i < UDP_REF_POOL_SIZE; ++i)
+        {
+            udp_ref_pool[i].next = udp_ref_free_list;
+            udp_ref_free_list = &udp_ref_pool[i];
+        }
+
+        udp_ref_pool_initialized = true;
+    }
+
+    udp_ref_t *ref = udp_ref_free_list;
+    if (ref)
+    {
+        udp_ref_free_list = ref->next;
+        ref->tracker = tracker;
+        ref->pending = 2;
+        __atomic_fetch_add(&tracker->outstanding, 1, __ATOMIC_SEQ_CST);
+        if (++udp_pool_stats.ref_used > udp_pool_stats.ref_max)
+        {
+            udp_pool_stats.ref_max = udp_pool_stats.ref_used;
+        }
+    }
+
+    SYS_ARCH_UNPROTECT(lev);
+
+    return ref;
+}
+
+/**
+ * Sends a datagram whose payload is transmitted directly from caller memory.
+ *
+ * @note Only the header is copied, into storage preallocated with the
+ *       reference. The payload is chained to it by reference, so it must not
+ *       be modified until the tracker reports that all references have been
+ *       released by the Ethernet driver.
+ *
+ * @param socket The connected socket to send data over.
+ * @param header The header to prepend to the payload.
+ * @param header_len The length of the header in bytes.
+ * @param data The payload to reference.
+ * @param len The length of the payload in bytes.
+ * @param tracker The tracker to count the reference against.
+ *
+ * @return Success or fail.
+ */
+HOT_CODE
+result_t send_udp_ref(udp_socket_t *socket,
+                      const void *header,
+                      const size_t header_len,
+                      const void *data,
+                      const size_t len,
+                      udp_ref_tracker_t *tracker)
+{
+    AbortIfNot(socket, fail);
+    AbortIfNot(header, fail);
+    AbortIfNot(data, fail);
+    AbortIfNot(tracker, fail);
+    AbortIfNot(header_len <= UDP_REF_HEADER_MAX, fail);
+
+    if (!network_stack_owned())
+    {
+        return post_udp_request(NET_REQUEST_SEND_REF, socket, NULL, 0, header, header_len, data, len, tracker);
+    }
+
+    udp_ref_t *ref = acquire_udp_ref(tracker);
+    if (!ref)
+    {
+        udp_send_failures++;
+    }
+    AbortIfNot(ref, fail);
+
+    ref->custom.custom_free_function = release_udp_ref;
+    struct pbuf *payload = pbuf_alloced_custom(PBUF_RAW,
+                                               len,
+                                               PBUF_REF,
+                                               &ref->custom,
+                                               (void *)data,
+                                               len);
+    AbortIfNot(payload, fail);
+
+    /*
+     * The header is taken with the entry rather than from the lwIP heap, so
+     * that a datagram cannot fail for lack of heap while the stream runs.
+     */
+    udp_ref_header_t *header_buffer = &udp_ref_headers[ref - udp_ref_pool];
+    header_buffer->ref = ref;
+    header_buffer->custom.custom_free_function = release_udp_ref_header;
+    struct pbuf *packet_buffer = pbuf_alloced_custom(PBUF_TRANSPORT,
+                                                     header_len,
+                                                     PBUF_RAM,
+                                                     &header_buffer->custom,
+                                                     header_buffer->storage,
+                                                     sizeof(header_buffer->storage));
+    if (!packet_buffer)
+    {
+        put_udp_ref(ref);
+        pbuf_free(payload);
+        AbortIfNot(packet_buffer, fail);
+    }
+
+    memcpy(packet_buffer->payload, header, header_len);
+
+    /*
+     * The header takes over the reference to the payload, so freeing the
+     * chain only releases the payload once the driver has also freed it.
+     */
+    pbuf_cat(packet_buffer, payload);
+
+    int ret = udp_send(socket->pcb, packet_buffer);
+
+    pbuf_free(packet_buffer);
+    trace(TRACE_UDP_SEND_REF, TRACE_INSTANT, header_len + len, ret == ERR_OK);
+
+    if (ret != ERR_OK)
+    {
+        udp_send_failures++;
+    }
+    AbortIfNot(ret == ERR_OK, fail);
+
+    return success;
+}
+
+/**
+ * Sends an Ethernet frame straight to the driver of the default interface,
+ * without passing through UDP, IP or ARP. The payload is transmitted directly
+ * from caller memory as for send_udp_ref().
+ *
+ * @note The header must begin with the Ethernet header of the frame, which
+ *       the caller addresses. The frame must fit the MTU of the link, as it
+ *       is not fragmented.
+ *
+ * @param header The Ethernet header and any header that follows it.
+ * @param header_len The length of the header in bytes.
+ * @param data The payload to reference.
+ * @param len The length of the payload in bytes.
+ * @param tracker The tracker to count the reference against.
+ *
+ * @return Success or fail.
+ */
+HOT_CODE
+result_t send_raw_frame_ref(const void *header,
+                            const size_t header_len,
+                            const void *data,
+                            const size_t len,
+                            udp_ref_tracker_t *tracker)
+{
+    AbortIfNot(header, fail);
+    AbortIfNot(data, fail);
+    AbortIfNot(tracker, fail);
+    AbortIfNot(header_len <= UDP_REF_HEADER_MAX, fail);
+    AbortIfNot(netif_default, fail);
+
+    if (!network_stack_owned())
+    {
+        return post_udp_request(NET_REQUEST_SEND_RAW, NULL, NULL, 0, header, header_len, data, len, tracker);
+    }
+
+    udp_ref_t *ref = acquire_udp_ref(tracker);
+    if (!ref)
+    {
+        udp_send_failures++;
+    }
+    AbortIfNot(ref, fail);
+
+    ref->custom.custom_free_function = release_udp_ref;
+    struct pbuf *payload = pbuf_alloced_custom(PBUF_RAW,
+                                               len,
+                                               PBUF_REF,
+                                               &ref->custom,
+                                               (void *)data,
+                                               len);
+    AbortIfNot(payload, fail);
+
+    udp_ref_header_t *header_buffer = &udp_ref_headers[ref - udp_ref_pool];
+    header_buffer->ref = ref;
+    header_buffer->custom.custom_free_function = release_udp_ref_header;
+    struct pbuf *frame = pbuf_alloced_custom(PBUF_RAW,
+                                             header_len,
+                                             PBUF_RAM,
+                                             &header_buffer->custom,
+                                             header_buffer->storage,
+                                             sizeof(header_buffer->storage));
+    if (!frame)
+    {
+        put_udp_ref(ref);
+        pbuf_free(payload);
+        AbortIfNot(frame, fail);
+    }
+
+    memcpy(frame->payload, header, header_len);
+    pbuf_cat(frame, payload);
+
+    int ret = netif_default->linkoutput(netif_default, frame);
+
+    pbuf_free(frame);
+    trace(TRACE_UDP_SEND_REF, TRACE_INSTANT, header_len + len, ret == ERR_OK);
+
+    if (ret != ERR_OK)
+    {
+        udp_send_failures++;
+    }
+    AbortIfNot(ret == ERR_OK, fail);
+
+    return success;
+}
+
+/**
+ * Releases a datagram that was sent in place.
+ *
+ * @note This is called from the Ethernet transmit interrupt.
+ *
+ * @param p The pbuf being freed.
+ *
+ * @return None.
+ */
+HOT_CODE
+static void release_udp_in_place(struct pbuf *p)
+{
+    SYS_ARCH_DECL_PROTECT(lev);
+    SYS_ARCH_PROTECT(lev);
+    __atomic_fetch_sub(&((udp_in_place_t *)p)->tracker->outstanding, 1, __ATOMIC_SEQ_CST);
+    SYS_ARCH_UNPROTECT(lev);
+}
+
+/**
+ * Sends a datagram from the memory it was written to, without copying it or
+ * chaining it to a separate header.
+ *
+ * @note The UDP_IN_PLACE_HEADROOM bytes ahead of the datagram hold its pbuf
+ *       and the headers that lwIP prepends, so neither they nor the datagram
+ *       may be modified until the tracker reports that the Ethernet driver
+ *       has released it.
+ *
+ * @param socket The connected socket to send data over.
+ * @param datagram The datagram, aligned to the lwIP heap.
+ * @param len The length of the datagram in bytes.
+ * @param tracker The tracker to count the datagram against.
+ *
+ * @return Success or fail.
+ */
+HOT_CODE
+result_t send_udp_in_place(udp_socket_t *socket,
+                           void *datagram,
+                           const size_t len,
+                           udp_ref_tracker_t *tracker)
+{
+    AbortIfNot(socket, fail);
+    AbortIfNot(datagram, fail);
+    AbortIfNot(tracker, fail);
+    AbortIfNot((uintptr_t)datagram % MEM_ALIGNMENT == 0, fail);
+
+    if (!network_stack_owned())
+    {
+        return post_udp_request(NET_REQUEST_SEND_IN_PLACE, socket, NULL, 0, NULL, 0, datagram, len, tracker);
+    }
+
+    uint8_t *headroom = (uint8_t *)datagram - UDP_IN_PLACE_HEADROOM;
+    udp_in_place_t *slot = (udp_in_place_t *)headroom;
+    slot->tracker = tracker;
+    slot->custom.custom_free_function = release_udp_in_place;
+
+    /*
+     * The headers are prepended into the memory between the pbuf and the
+     * datagram, which lwIP places at the aligned offset of a transport pbuf.
+     */
+    uint8_t *storage = headroom + LWIP_MEM_ALIGN_SIZE(sizeof(udp_in_place_t));
+    struct pbuf *packet_buffer = pbuf_alloced_custom(PBUF_TRANSPORT,
+                                                     len,
+                                                     PBUF_RAM,
+                                                     &slot->custom,
+                                                     storage,
+                                                     (uint8_t *)datagram - storage + len);
+    if (!packet_buffer)
+    {
+        udp_send_failures++;
+    }
+    AbortIfNot(packet_buffer, fail);
+
+    SYS_ARCH_DECL_PROTECT(lev);
+    SYS_ARCH_PROTECT(lev);
+    __atomic_fetch_add(&tracker->outstanding, 1, __ATOMIC_SEQ_CST);
+    SYS_ARCH_UNPROTECT(lev);
+
+    int ret = udp_send(socket->pcb, packet_buffer);
+
+    pbuf_free(packet_buffer);
+    trace(TRACE_UDP_SEND_REF, TRACE_INSTANT, len, ret == ERR_OK);
 
+    if (ret != ERR_OK)
+    {
+        udp_send_failures++;
+    }
     AbortIfNot(ret == ERR_OK, fail);
 
     return success;
 }
 
+/**
+ * Checks if a referencing datagram can be sent.
+ *
+ * @return True if the pool has a free entry.
+ */
+bool udp_ref_available()
+{
+    return (udp_ref_free_list || !udp_ref_pool_initialized)? true : false;
+}
+
+/**
+ * Checks if the driver has released all datagrams charged to a tracker.
+ *
+ * @param tracker The tracker to check.
+ *
+ * @return True if the referenced memory may be reused.
+ */
+bool udp_refs_released(const udp_ref_tracker_t *tracker)
+{
+    return (tracker->outstanding == 0)? true : false;
+}
+
+/**
+ * Gets the number of datagrams that could not be sent.
+ *
+ * @return The number of failed sends.
+ */
+uint32_t get_udp_send_failures()
+{
+    return udp_send_failures;
+}
+
 result_t bind_udp(udp_socket_t *socket, struct ip_addr *ip, uint16_t port, void (*recv)(void *arg, struct udp_pcb * upcb, struct pbuf *p, struct ip_addr *addr, uint16_t port))
 {
     AbortIfNot(socket, fail);
@@ -96,3 +791,18 @@ result_t bind_udp(udp_socket_t *socket, struct ip_addr *ip, uint16_t port, void
 
     return success;
 }
+
+/**
+ * Gets the usage of the preallocated transmit pools.
+ *
+ * @param[out] stats The usage of the pools.
+ *
+ * @return None.
+ */
+void get_udp_pool_stats(udp_pool_stats_t *stats)
+{
+    SYS_ARCH_DECL_PROTECT(lev);
+    SYS_ARCH_PROTECT(lev);
+    *stats = udp_pool_stats;
+    SYS_ARCH_UNPROTECT(lev);
+}
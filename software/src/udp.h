@@ -1,6 +1,8 @@
 #ifndef UDP_H
 #define UDP_H
 
+#include "lwip/mem.h"
+#include "lwip/pbuf.h"
 #include "lwip/udp.h"
 #include "types.h"
 
@@ -9,12 +11,95 @@ typedef struct udp_socket_t
     struct udp_pcb *pcb;
 } udp_socket_t;
 
+/**
+ * Counts the datagrams that still reference memory owned by the caller. The
+ * count is updated atomically, because the network core may release
+ * references while CPU0 charges new ones.
+ */
+typedef struct udp_ref_tracker_t
+{
+    volatile uint32_t outstanding;
+} udp_ref_tracker_t;
+
+/**
+ * Defines the pbuf of a datagram that is sent from the memory it was written
+ * to. The pbuf is stored in the headroom ahead of the datagram and must be
+ * the first member so that the free callback can recover it.
+ */
+typedef struct udp_in_place_t
+{
+    struct pbuf_custom custom;
+    udp_ref_tracker_t *tracker;
+} udp_in_place_t;
+
+/**
+ * The headroom that must directly precede a datagram sent in place, which
+ * holds its pbuf and the UDP, IP and Ethernet headers at the alignment of
+ * the lwIP heap.
+ */
+#define UDP_IN_PLACE_HEADROOM (LWIP_MEM_ALIGN_SIZE(sizeof(udp_in_place_t)) + \
+                               LWIP_MEM_ALIGN_SIZE(PBUF_LINK_HLEN + PBUF_IP_HLEN + PBUF_TRANSPORT_HLEN))
+
+/**
+ * The largest datagram that fits a buffer of a copied datagram without IP
+ * fragmentation.
+ */
+#define UDP_TX_PAYLOAD_MAX (IP_FRAG_MAX_MTU - PBUF_IP_HLEN - PBUF_TRANSPORT_HLEN)
+
+/**
+ * Defines the usage of the preallocated transmit pools.
+ */
+typedef struct udp_pool_stats_t
+{
+    /*
+     * The buffers of copied datagrams in use, the most in use at once, and
+     * the datagrams that fell back to the lwIP heap.
+     */
+    uint32_t tx_used;
+    uint32_t tx_max;
+    uint32_t tx_misses;
+
+    /*
+     * The entries of zero-copy datagrams in use and the most in use at once.
+     */
+    uint32_t ref_used;
+    uint32_t ref_max;
+} udp_pool_stats_t;
+
 result_t init_udp(udp_socket_t *socket);
 
 result_t sendto_udp(udp_socket_t *socket, struct ip_addr *ip, const uint16_t port, char *data);
 
 result_t send_udp(udp_socket_t *socket, char *data, size_t len);
 
+result_t send_udp_to(udp_socket_t *socket, struct ip_addr *ip, const uint16_t port, const void *data, const size_t len);
+
+result_t send_udp_ref(udp_socket_t *socket,
+                      const void *header,
+                      const size_t header_len,
+                      const void *data,
+                      const size_t len,
+                      udp_ref_tracker_t *tracker);
+
+result_t send_raw_frame_ref(const void *header,
+                            const size_t header_len,
+                            const void *data,
+                            const size_t len,
+                            udp_ref_tracker_t *tracker);
+
+result_t send_udp_in_place(udp_socket_t *socket,
+                           void *datagram,
+                           const size_t len,
+                           udp_ref_tracker_t *tracker);
+
+bool udp_ref_available();
+
+bool udp_refs_released(const udp_ref_tracker_t *tracker);
+
+uint32_t get_udp_send_failures();
+
+void get_udp_pool_stats(udp_pool_stats_t *stats);
+
 result_t connect_udp(udp_socket_t *socket, struct ip_addr *ip, const uint16_t port);
 
 result_t bind_udp(udp_socket_t *socket, struct ip_addr *ip, uint16_t port, void (*recv)(void *arg, struct udp_pcb * upcb, struct pbuf *p, struct ip_addr *addr, uint16_t port));
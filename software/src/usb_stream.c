@@ -0,0 +1,547 @@
+#include "usb_stream.h"
+
+#include "abort.h"
+#include "db.h"
+#include "system.h"
+#include "system_params.h"
+#include "time_util.h"
+#include "types.h"
+#include "xparameters.h"
+#include "xstatus.h"
+#include "xusbps.h"
+
+#include <string.h>
+
+/**
+ * The identity of the device. The vendor and product are the pid.codes test
+ * identifiers, which may be used for devices that are not distributed.
+ */
+#define USB_VENDOR_ID 0x1209
+#define USB_PRODUCT_ID 0x0001
+#define USB_DEVICE_RELEASE 0x0100
+
+/**
+ * The packet sizes of the control endpoint and of the high speed bulk
+ * endpoint.
+ */
+#define USB_CONTROL_PACKET_BYTES 64
+#define USB_BULK_PACKET_BYTES 512
+
+/**
+ * The standard requests and descriptor types of chapter 9 of the USB 2.0
+ * specification that the device answers.
+ */
+#define USB_REQ_GET_STATUS 0x00
+#define USB_REQ_CLEAR_FEATURE 0x01
+#define USB_REQ_SET_FEATURE 0x03
+#define USB_REQ_SET_ADDRESS 0x05
+#define USB_REQ_GET_DESCRIPTOR 0x06
+#define USB_REQ_GET_CONFIGURATION 0x08
+#define USB_REQ_SET_CONFIGURATION 0x09
+#define USB_REQ_GET_INTERFACE 0x0A
+#define USB_REQ_SET_INTERFACE 0x0B
+
+#define USB_REQ_TYPE_MASK 0x60
+#define USB_REQ_TYPE_STANDARD 0x00
+
+#define USB_DESC_DEVICE 0x01
+#define USB_DESC_CONFIGURATION 0x02
+#define USB_DESC_STRING 0x03
+
+/**
+ * The memory the controller reads its queue heads and transfer descriptors
+ * from. The queue heads must be 2 KiB aligned.
+ */
+static uint8_t usb_dma_memory[16384] __attribute__((aligned(2048)));
+
+/**
+ * The buffer that replies to control requests are sent from, which must stay
+ * valid until the controller has sent them.
+ */
+static uint8_t usb_control_reply[USB_CONTROL_PACKET_BYTES * 4] __attribute__((aligned(32)));
+
+static const uint8_t usb_device_descriptor[] = {
+    18, USB_DESC_DEVICE,
+    0x00, 0x02,
+    0xFF, 0x00, 0x00,
+    USB_CONTROL_PACKET_BYTES,
+    USB_VENDOR_ID & 0xFF, USB_VENDOR_ID >> 8,
+    USB_PRODUCT_ID & 0xFF, USB_PRODUCT_ID >> 8,
+    USB_DEVICE_RELEASE & 0xFF, USB_DEVICE_RELEASE >> 8,
+    1, 2, 0,
+    1
+};
+
+/**
+ * The only configuration, which has one vendor specific interface with the
+ * bulk IN endpoint.
+ */
+static const uint8_t usb_configuration_descriptor[] = {
+    9, USB_DESC_CONFIGURATION, 25, 0, 1, 1, 0, 0xC0, 1,
+    9, 0x04, 0, 0, 1, 0xFF, 0x00, 0x00, 0,
+    7, 0x05, 0x80 | USB_STREAM_ENDPOINT, 0x02, USB_BULK_PACKET_BYTES & 0xFF, USB_BULK_PACKET_BYTES >> 8, 0
+};
+
+static const uint8_t usb_language_descriptor[] = {4, USB_DESC_STRING, 0x09, 0x04};
+
+static const char *usb_strings[] = {
+    "HydroZynq",
+    "HydroZynq Capture Stream"
+};
+
+/**
+ * Queues a reply to a control request on the control endpoint.
+ *
+ * @param stream The USB stream.
+ * @param reply The reply, or NULL for the zero length status of a request
+ *        without data.
+ * @param len The length of the reply.
+ * @param requested The length the host asked for, which truncates the reply.
+ *
+ * @return None.
+ */
+static void send_control_reply(usb_stream_t *stream, const void *reply, size_t len, const size_t requested)
+{
+    if (len > requested)
+    {
+        len = requested;
+    }
+
+    if (len > sizeof(usb_control_reply))
+    {
+        len = sizeof(usb_control_reply);
+    }
+
+    if (reply && len)
+    {
+        memcpy(usb_control_reply, reply, len);
+        XUsbPs_EpBufferSend(&stream->usb, 0, usb_control_reply, len);
+    }
+    else
+    {
+        XUsbPs_EpBufferSend(&stream->usb, 0, NULL, 0);
+    }
+}
+
+/**
+ * Answers a request for a descriptor.
+ *
+ * @param stream The USB stream.
+ * @param setup The request.
+ *
+ * @return Success, or fail if the descriptor does not exist.
+ */
+static result_t send_descriptor(usb_stream_t *stream, const XUsbPs_SetupData *setup)
+{
+    const uint8_t type = setup->wValue >> 8;
+    const uint8_t index = setup->wValue & 0xFF;
+
+    switch (type)
+    {
+        case USB_DESC_DEVICE:
+            send_control_reply(stream, usb_device_descriptor, sizeof(usb_device_descriptor), setup->wLength);
+            return success;
+
+        case USB_DESC_CONFIGURATION:
+            send_control_reply(stream,
+                               usb_configuration_descriptor,
+                               sizeof(usb_configuration_descriptor),
+                               setup->wLength);
+            return success;
+
+        case USB_DESC_STRING:
+            if (index == 0)
+            {
+                send_control_reply(stream, usb_language_descriptor, sizeof(usb_language_descriptor), setup->wLength);
+                return success;
+            }
+
+            if (index <= sizeof(usb_strings) / sizeof(usb_strings[0]))
+            {
+                /*
+                 * Strings are sent as UTF-16, which for ASCII only widens
+                 * each character.
+                 */
+                uint8_t descriptor[2 + 2 * 32];
+                const char *string = usb_strings[index - 1];
+                size_t len = strlen(string);
+                if (len > 32)
+                {
+                    len = 32;
+                }
+
+                descriptor[0] = 2 + 2 * len;
+                descriptor[1] = USB_DESC_STRING;
+                for (size_t i = 0; i < len; ++i)
+                {
+                    descriptor[2 + 2 * i] = string[i];
+                    descriptor[3 + 2 * i] = 0;
+                }
+                send_control_reply(stream, descriptor, descriptor[0], setup->wLength);
+                return success;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    return fail;
+}
+
+/**
+ * Handles a standard request of chapter 9 on the control endpoint.
+ *
+ * @note This is called from the USB interrupt.
+ *
+ * @param stream The USB stream.
+ * @param setup The request.
+ *
+ * @return None.
+ */
+static void handle_setup(usb_stream_t *stream, const XUsbPs_SetupData *setup)
+{
+    result_t ret = success;
+    if ((setup->bmRequestType & USB_REQ_TYPE_MASK) != USB_REQ_TYPE_STANDARD)
+    {
+        ret = fail;
+    }
+    else
+    {
+        static const uint8_t zero_status[2] = {0, 0};
+        uint8_t configuration = (stream->configured)? 1 : 0;
+        switch (setup->bRequest)
+        {
+            case USB_REQ_GET_DESCRIPTOR:
+                ret = send_descriptor(stream, setup);
+                break;
+
+            case USB_REQ_SET_ADDRESS:
+                XUsbPs_SetDeviceAddress(&stream->usb, setup->wValue);
+                send_control_reply(stream, NULL, 0, 0);
+                break;
+
+            case USB_REQ_SET_CONFIGURATION:
+                if ((setup->wValue & 0xFF) == 1)
+                {
+                    XUsbPs_EpEnable(&stream->usb, USB_STREAM_ENDPOINT, XUSBPS_EP_DIRECTION_IN);
+                    stream->configured = true;
+                }
+                else
+                {
+                    XUsbPs_EpDisable(&stream->usb, USB_STREAM_ENDPOINT, XUSBPS_EP_DIRECTION_IN);
+                    stream->configured = false;
+                }
+                send_control_reply(stream, NULL, 0, 0);
+                break;
+
+            case USB_REQ_GET_CONFIGURATION:
+                send_control_reply(stream, &configuration, 1, setup->wLength);
+                break;
+
+            case USB_REQ_GET_STATUS:
+                send_control_reply(stream, zero_status, sizeof(zero_status), setup->wLength);
+                break;
+
+            case USB_REQ_GET_INTERFACE:
+                send_control_reply(stream, zero_status, 1, setup->wLength);
+                break;
+
+            case USB_REQ_CLEAR_FEATURE:
+                /*
+                 * The only feature is the halt of the bulk endpoint.
+                 */
+                XUsbPs_EpUnStall(&stream->usb, USB_STREAM_ENDPOINT, XUSBPS_EP_DIRECTION_IN);
+                send_control_reply(stream, NULL, 0, 0);
+                break;
+
+            case USB_REQ_SET_FEATURE:
+            case USB_REQ_SET_INTERFACE:
+                send_control_reply(stream, NULL, 0, 0);
+                break;
+
+            default:
+                ret = fail;
+                break;
+        }
+    }
+
+    if (ret != success)
+    {
+        XUsbPs_EpStall(&stream->usb, 0, XUSBPS_EP_DIRECTION_IN | XUSBPS_EP_DIRECTION_OUT);
+    }
+}
+
+/**
+ * Handles events of the control endpoint.
+ *
+ * @note This is called from the USB interrupt.
+ *
+ * @param arg The USB stream.
+ * @param endpoint The endpoint number.
+ * @param event The event that occurred.
+ * @param data Unused.
+ *
+ * @return None.
+ */
+static void usb_control_handler(void *arg, u8 endpoint, u8 event, void *data)
+{
+    usb_stream_t *stream = (usb_stream_t *)arg;
+
+    if (event == XUSBPS_EP_EVENT_SETUP_DATA_RECEIVED)
+    {
+        XUsbPs_SetupData setup;
+        if (XUsbPs_EpGetSetupData(&stream->usb, endpoint, &setup) == XST_SUCCESS)
+        {
+            handle_setup(stream, &setup);
+        }
+    }
+    else if (event == XUSBPS_EP_EVENT_DATA_RX)
+    {
+        /*
+         * Only the zero length status of control reads is received.
+         */
+        u8 *buffer;
+        u32 len;
+        u32 handle;
+        if (XUsbPs_EpBufferReceive(&stream->usb, endpoint, &buffer, &len, &handle) == XST_SUCCESS)
+        {
+            XUsbPs_EpBufferRelease(handle);
+        }
+    }
+}
+
+/**
+ * Counts the transfer descriptors of the bulk endpoint that completed.
+ *
+ * @note This is called from the USB interrupt.
+ *
+ * @param arg The USB stream.
+ * @param endpoint The endpoint number.
+ * @param event The event that occurred.
+ * @param data Unused.
+ *
+ * @return None.
+ */
+static void usb_bulk_handler(void *arg, u8 endpoint, u8 event, void *data)
+{
+    usb_stream_t *stream = (usb_stream_t *)arg;
+
+    if (event == XUSBPS_EP_EVENT_DATA_TX && stream->outstanding)
+    {
+        stream->outstanding--;
+    }
+}
+
+/**
+ * Forgets the configuration when the host resets the bus.
+ *
+ * @note This is called from the USB interrupt.
+ *
+ * @param arg The USB stream.
+ * @param mask The interrupt status.
+ *
+ * @return None.
+ */
+static void usb_reset_handler(void *arg, u32 mask)
+{
+    usb_stream_t *stream = (usb_stream_t *)arg;
+
+    if (mask & XUSBPS_IXR_UR_MASK)
+    {
+        stream->configured = false;
+        stream->outstanding = 0;
+    }
+}
+
+/**
+ * Brings up the USB controller as a device with a bulk IN endpoint.
+ *
+ * @note The device enumerates at high speed only.
+ *
+ * @param stream The USB stream.
+ *
+ * @return Success or fail.
+ */
+result_t init_usb_stream(usb_stream_t *stream)
+{
+    AbortIfNot(stream, fail);
+
+    memset(stream, 0, sizeof(*stream));
+
+    XUsbPs_Config *config = XUsbPs_LookupConfig(XPAR_XUSBPS_0_DEVICE_ID);
+    AbortIfNot(config, fail);
+    AbortIfNot(XUsbPs_CfgInitialize(&stream->usb, config, config->BaseAddress) == XST_SUCCESS, fail);
+
+    XUsbPs_DeviceConfig *device = &stream->device_config;
+    device->NumEndpoints = 2;
+    device->EpCfg[0].Out.Type = XUSBPS_EP_TYPE_CONTROL;
+    device->EpCfg[0].Out.NumBufs = 2;
+    device->EpCfg[0].Out.BufSize = USB_CONTROL_PACKET_BYTES;
+    device->EpCfg[0].Out.MaxPacketSize = USB_CONTROL_PACKET_BYTES;
+    device->EpCfg[0].In.Type = XUSBPS_EP_TYPE_CONTROL;
+    device->EpCfg[0].In.NumBufs = 2;
+    device->EpCfg[0].In.MaxPacketSize = USB_CONTROL_PACKET_BYTES;
+    device->EpCfg[USB_STREAM_ENDPOINT].Out.Type = XUSBPS_EP_TYPE_NONE;
+    device->EpCfg[USB_STREAM_ENDPOINT].In.Type = XUSBPS_EP_TYPE_BULK;
+    device->EpCfg[USB_STREAM_ENDPOINT].In.NumBufs = USB_STREAM_DESCRIPTORS;
+    device->EpCfg[USB_STREAM_ENDPOINT].In.MaxPacketSize = USB_BULK_PACKET_BYTES;
+    device->DMAMemPhys = (u32)(uintptr_t)usb_dma_memory;
+    AbortIfNot(XUsbPs_ConfigureDevice(&stream->usb, device) == XST_SUCCESS, fail);
+
+    AbortIfNot(XUsbPs_IntrSetHandler(&stream->usb, usb_reset_handler, stream, XUSBPS_IXR_UR_MASK) == XST_SUCCESS,
+               fail);
+    AbortIfNot(XUsbPs_EpSetHandler(&stream->usb, 0, XUSBPS_EP_DIRECTION_OUT,
+                                   usb_control_handler, stream) == XST_SUCCESS, fail);
+    AbortIfNot(XUsbPs_EpSetHandler(&stream->usb, USB_STREAM_ENDPOINT, XUSBPS_EP_DIRECTION_IN,
+                                   usb_bulk_handler, stream) == XST_SUCCESS, fail);
+
+    AbortIfNot(register_interrupt(XPAR_XUSBPS_0_INTR, XUsbPs_IntrHandler, &stream->usb, IRQ_PRIORITY_NETWORK), fail);
+    XUsbPs_IntrEnable(&stream->usb, XUSBPS_IXR_UR_MASK | XUSBPS_IXR_UI_MASK);
+    XUsbPs_Start(&stream->usb);
+
+    return success;
+}
+
+/**
+ * Checks if the host has configured the device, so that arrays may be sent.
+ *
+ * @param stream The USB stream.
+ *
+ * @return True if the bulk endpoint is enabled.
+ */
+bool usb_stream_ready(const usb_stream_t *stream)
+{
+    return (stream && stream->configured)? true : false;
+}
+
+/**
+ * Waits until the controller has completed enough transfer descriptors.
+ *
+ * @param stream The USB stream.
+ * @param limit The most descriptors that may still be outstanding.
+ * @param idle Called while waiting, or NULL.
+ * @param arg The argument provided to the idle function.
+ *
+ * @return Success, or fail if the host stopped reading.
+ */
+static result_t wait_for_descriptors(usb_stream_t *stream,
+                                     const uint32_t limit,
+                                     result_t (*idle)(void *arg),
+                                     void *arg)
+{
+    const tick_t start_time = get_system_time();
+    while (stream->outstanding > limit)
+    {
+        AbortIfNot(stream->configured, fail);
+        AbortIf(get_system_time() - start_time > ms_to_ticks(USB_STREAM_TIMEOUT_MS), fail);
+        if (idle)
+        {
+            AbortIfNot(idle(arg), fail);
+        }
+    }
+
+    return success;
+}
+
+/**
+ * Queues one transfer descriptor on the bulk endpoint.
+ *
+ * @note The driver cleans the buffer from the cache before the controller
+ *       reads it.
+ *
+ * @param stream The USB stream.
+ * @param data The data to send, which must not change until it is sent.
+ * @param len The length of the data, at most one descriptor's worth.
+ *
+ * @return Success or fail.
+ */
+static result_t queue_usb_buffer(usb_stream_t *stream, const void *data, const size_t len)
+{
+    const uint32_t cpsr = save_and_disable_interrupts();
+    stream->outstanding++;
+    restore_interrupts(cpsr);
+
+    if (XUsbPs_EpBufferSend(&stream->usb, USB_STREAM_ENDPOINT, (const u8 *)data, len) != XST_SUCCESS)
+    {
+        const uint32_t cpsr = save_and_disable_interrupts();
+        stream->outstanding--;
+        restore_interrupts(cpsr);
+        AbortIfNot(false, fail);
+    }
+
+    return success;
+}
+
+/**
+ * Streams an array to the host in the packet format of the UDP streams.
+ *
+ * @note This does not return until the controller has sent every packet, so
+ *       the array may be reused as soon as it returns.
+ *
+ * @param stream The USB stream.
+ * @param data The array to send.
+ * @param element_size The size of each element in bytes.
+ * @param count The number of elements.
+ * @param idle Called while waiting for the controller, or NULL.
+ * @param arg The argument provided to the idle function.
+ *
+ * @return Success or fail.
+ */
+result_t send_usb_array(usb_stream_t *stream,
+                        const void *data,
+                        const size_t element_size,
+                        const size_t count,
+                        result_t (*idle)(void *arg),
+                        void *arg)
+{
+    AbortIfNot(stream, fail);
+    AbortIfNot(data, fail);
+    AbortIfNot(element_size && element_size <= USB_STREAM_PACKET_BYTES, fail);
+    AbortIfNot(usb_stream_ready(stream), fail);
+
+    const size_t per_packet = USB_STREAM_PACKET_BYTES / element_size;
+    const uint8_t *bytes = (const uint8_t *)data;
+    stream->transfer_id++;
+    stream->transfers++;
+
+    result_t ret = success;
+    for (size_t i = 0, packet = 0; i < count && ret == success; i += per_packet, ++packet)
+    {
+        const size_t elements = (count - i < per_packet)? count - i : per_packet;
+
+        ret = wait_for_descriptors(stream, USB_STREAM_DESCRIPTORS - 2, idle, arg);
+        if (ret != success)
+        {
+            break;
+        }
+
+        stream_header_t *header = &stream->headers[stream->next_header];
+        stream->next_header = (stream->next_header + 1) % (USB_STREAM_DESCRIPTORS / 2);
+        header->packet_number = packet;
+        header->first_element = i;
+        header->element_size = element_size;
+        header->element_count = elements;
+        header->encoding = STREAM_ENCODING_RAW;
+        header->transfer_id = stream->transfer_id;
+        header->total_elements = count;
+
+        ret = queue_usb_buffer(stream, header, sizeof(*header));
+        if (ret == success)
+        {
+            ret = queue_usb_buffer(stream, &bytes[i * element_size], elements * element_size);
+        }
+    }
+
+    /*
+     * Descriptors that were queued must complete before the caller may
+     * reuse the array, even if a later one failed.
+     */
+    if (wait_for_descriptors(stream, 0, idle, arg) != success || ret != success)
+    {
+        stream->failures++;
+        AbortIfNot(false, fail);
+    }
+
+    return success;
+}
@@ -0,0 +1,57 @@
+#ifndef USB_STREAM_H
+#define USB_STREAM_H
+
+#include "stream_format.h"
+#include "system_params.h"
+#include "types.h"
+#include "xusbps.h"
+
+/**
+ * The bulk IN endpoint that captures are streamed on.
+ */
+#define USB_STREAM_ENDPOINT 1
+
+/**
+ * Defines a USB device that streams arrays to the host over a bulk endpoint.
+ *
+ * @note Each packet is a stream_header_t followed by its elements, as on the
+ *       UDP streams. The elements are sent by the controller's DMA directly
+ *       from the array, and only the header is copied.
+ */
+typedef struct usb_stream_t
+{
+    XUsbPs usb;
+    XUsbPs_DeviceConfig device_config;
+
+    /*
+     * Specified true once the host has selected the configuration, and the
+     * number of transfer descriptors queued on the bulk endpoint that the
+     * controller has not completed. Both are updated from the USB interrupt.
+     */
+    volatile bool configured;
+    volatile uint32_t outstanding;
+
+    /*
+     * The headers of the packets in flight. Each packet uses two transfer
+     * descriptors, so a header is only reused once it has been sent.
+     */
+    stream_header_t headers[USB_STREAM_DESCRIPTORS / 2];
+    size_t next_header;
+    uint16_t transfer_id;
+
+    uint32_t transfers;
+    uint32_t failures;
+} usb_stream_t;
+
+result_t init_usb_stream(usb_stream_t *stream);
+
+bool usb_stream_ready(const usb_stream_t *stream);
+
+result_t send_usb_array(usb_stream_t *stream,
+                        const void *data,
+                        const size_t element_size,
+                        const size_t count,
+                        result_t (*idle)(void *arg),
+                        void *arg);
+
+#endif
@@ -0,0 +1,172 @@
+#include "watchdog.h"
+
+#include "abort.h"
+#include "db.h"
+#include "system.h"
+#include "system_params.h"
+#include "time_util.h"
+#include "types.h"
+#include "regs/slcr_regs.h"
+
+#include <string.h>
+
+/**
+ * The control register bits of the private watchdog.
+ */
+#define WDT_CONTROL_ENABLE (1 << 0)
+#define WDT_CONTROL_AUTO_RELOAD (1 << 1)
+#define WDT_CONTROL_WATCHDOG_MODE (1 << 3)
+
+/**
+ * The reset reason recorded by the SLCR when the watchdog of CPU 0 expires.
+ */
+#define REBOOT_STATUS_AWDT0 (1 << 17)
+
+/**
+ * Starts the private watchdog, which resets the processor unless it is
+ * kicked within the timeout.
+ *
+ * @note The watchdog is clocked with the global timer, so the timeout is
+ *       converted with the same tick rate.
+ *
+ * @param[out] watchdog The watchdog to start.
+ * @param base_address The base address of the watchdog registers.
+ * @param timeout_ms The time without a kick before the processor is reset.
+ *
+ * @return Success or fail.
+ */
+result_t init_watchdog(watchdog_t *watchdog, const uintptr_t base_address, const uint32_t timeout_ms)
+{
+    AbortIfNot(watchdog, fail);
+    AbortIfNot(base_address, fail);
+    AbortIfNot(timeout_ms, fail);
+
+    const tick_t load = ms_to_ticks(timeout_ms);
+    AbortIf(load > UINT32_MAX, fail);
+
+    memset(watchdog, 0, sizeof(*watchdog));
+    watchdog->regs = (struct ScuWdtRegs *)base_address;
+    watchdog->load = load;
+    watchdog->caused_reset = (SLCR->REBOOT_STATUS & REBOOT_STATUS_AWDT0)? true : false;
+
+    /*
+     * Clear the reset reason so that the next boot reports only its own.
+     */
+    SLCR->SLCR_UNLOCK = 0xDF0D;
+    SLCR->REBOOT_STATUS &= ~REBOOT_STATUS_AWDT0;
+    SLCR->SLCR_LOCK = 0x767B;
+    watchdog->regs->RESET_STATUS = 1;
+
+    watchdog->regs->LOAD = watchdog->load;
+    watchdog->regs->CONTROL = WDT_CONTROL_ENABLE | WDT_CONTROL_AUTO_RELOAD | WDT_CONTROL_WATCHDOG_MODE;
+
+    return success;
+}
+
+/**
+ * Restarts the countdown of the watchdog.
+ *
+ * @param watchdog The watchdog to kick.
+ *
+ * @return None.
+ */
+void kick_watchdog(watchdog_t *watchdog)
+{
+    if (watchdog->regs)
+    {
+        watchdog->regs->LOAD = watchdog->load;
+    }
+}
+
+/**
+ * Marks the start of a stage with a deadline.
+ *
+ * @param watchdog The watchdog that supervises the stage.
+ * @param stage The stage that is starting.
+ * @param budget The time the stage is expected to take at most.
+ *
+ * @return None.
+ */
+void begin_deadline(watchdog_t *watchdog, const deadline_stage_t stage, const tick_t budget)
+{
+    deadline_t *deadline = &watchdog->deadlines[stage];
+    deadline->start = get_system_time();
+    deadline->budget = budget;
+    deadline->running = true;
+}
+
+/**
+ * Marks the end of a stage with a deadline. The duration is checked by the
+ * next call to check_deadlines().
+ *
+ * @param watchdog The watchdog that supervises the stage.
+ * @param stage The stage that has finished.
+ *
+ * @return None.
+ */
+void end_deadline(watchdog_t *watchdog, const deadline_stage_t stage)
+{
+    deadline_t *deadline = &watchdog->deadlines[stage];
+    if (deadline->running)
+    {
+        deadline->duration = get_system_time() - deadline->start;
+        deadline->running = false;
+        deadline->finished = true;
+    }
+}
+
+/**
+ * Counts the stages that finished past their deadline since the last check.
+ *
+ * @param watchdog The watchdog that supervises the stages.
+ * @param max_consecutive_overruns The number of consecutive overruns of a
+ *        stage that are tolerated.
+ *
+ * @return Success, or fail if a stage has overrun more times in a row than
+ *         is tolerated.
+ */
+result_t check_deadlines(watchdog_t *watchdog, const uint32_t max_consecutive_overruns)
+{
+    AbortIfNot(watchdog, fail);
+
+    static const char *stage_names[DEADLINE_STAGES] = {"capture", "DSP", "send"};
+
+    result_t ret = success;
+    for (size_t i = 0; i < DEADLINE_STAGES; ++i)
+    {
+        deadline_t *deadline = &watchdog->deadlines[i];
+        if (!deadline->finished)
+        {
+            continue;
+        }
+        deadline->finished = false;
+
+        if (deadline->duration <= deadline->budget)
+        {
+            deadline->consecutive_overruns = 0;
+            continue;
+        }
+
+        const tick_t overrun = deadline->duration - deadline->budget;
+        deadline->overruns++;
+        deadline->consecutive_overruns++;
+        if (overrun > deadline->max_overrun)
+        {
+            deadline->max_overrun = overrun;
+        }
+
+        dblog(LOG_WARN, "The %s stage took %u ms of a %u ms budget.\n",
+              stage_names[i], ticks_to_ms(deadline->duration), ticks_to_ms(deadline->budget));
+
+        /*
+         * Each escalation must be earned by a new run of overruns.
+         */
+        if (deadline->consecutive_overruns > max_consecutive_overruns)
+        {
+            deadline->consecutive_overruns = 0;
+            ret = fail;
+        }
+    }
+
+    return ret;
+}
@@ -0,0 +1,70 @@
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include "regs/ScuWdtRegs.h"
+#include "types.h"
+
+/**
+ * The base address of the private watchdog of CPU 0.
+ */
+#define SCU_WATCHDOG_BASE_ADDRESS 0xF8F00620
+
+/**
+ * Defines the stages of the main loop that have deadlines.
+ */
+typedef enum deadline_stage_t
+{
+    DEADLINE_CAPTURE = 0,
+    DEADLINE_DSP = 1,
+    DEADLINE_SEND = 2,
+    DEADLINE_STAGES = 3
+} deadline_stage_t;
+
+/**
+ * Defines the deadline and the overruns of a stage.
+ */
+typedef struct deadline_t
+{
+    tick_t start;
+    tick_t budget;
+    tick_t duration;
+
+    /*
+     * Specified true while the stage runs and once it has finished but has
+     * not yet been checked.
+     */
+    bool running;
+    bool finished;
+
+    uint32_t overruns;
+    uint32_t consecutive_overruns;
+    tick_t max_overrun;
+} deadline_t;
+
+/**
+ * Defines the private watchdog and the deadlines it supervises.
+ */
+typedef struct watchdog_t
+{
+    struct ScuWdtRegs *regs;
+    uint32_t load;
+
+    /*
+     * Specified true if the processor was last reset by the watchdog.
+     */
+    bool caused_reset;
+
+    deadline_t deadlines[DEADLINE_STAGES];
+} watchdog_t;
+
+result_t init_watchdog(watchdog_t *watchdog, const uintptr_t base_address, const uint32_t timeout_ms);
+
+void kick_watchdog(watchdog_t *watchdog);
+
+void begin_deadline(watchdog_t *watchdog, const deadline_stage_t stage, const tick_t budget);
+
+void end_deadline(watchdog_t *watchdog, const deadline_stage_t stage);
+
+result_t check_deadlines(watchdog_t *watchdog, const uint32_t max_consecutive_overruns);
+
+#endif
@@ -3,6 +3,12 @@
 #include "abort.h"
 #include "uart.h"
 #include "time_util.h"
+#include "system.h"
+
+/**
+ * The longest time to wait for a new measurement.
+ */
+#define XADC_MEASUREMENT_TIMEOUT_US 100
 
 result_t init_xsystem_monitor(xsystem_monitor_t *xsystem_monitor, uint32_t base_address)
 {
@@ -34,7 +40,11 @@ result_t read_fpga_temperature(xsystem_monitor_t *xsystem_monitor, float *temp_c
     /*
      * Wait for a new measurement.
      */
-    while((xsystem_monitor->regs->SR & (1 << 5)) == 0);
+    const tick_t start_time = get_system_time();
+    while((xsystem_monitor->regs->SR & (1 << 5)) == 0)
+    {
+        AbortIf(get_system_time() - start_time > micros_to_ticks(XADC_MEASUREMENT_TIMEOUT_US), fail);
+    }
 
     /*
      * Read the temperature measurement.